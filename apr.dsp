@@ -146,6 +146,10 @@ SOURCE=.\atomic\win32\apr_atomic.c
 
 SOURCE=.\atomic\win32\apr_atomic64.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\atomic\unix\tagptr.c
+# End Source File
 # End Group
 # Begin Group "buckets"
 
@@ -156,6 +160,10 @@ SOURCE=.\buckets\apr_brigade.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\buckets\apr_brigade_compress.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\buckets\apr_buckets.c
 # End Source File
 # Begin Source File
@@ -164,6 +172,10 @@ SOURCE=.\buckets\apr_buckets_alloc.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\buckets\apr_buckets_buffer.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\buckets\apr_buckets_eos.c
 # End Source File
 # Begin Source File
@@ -208,6 +220,10 @@ SOURCE=.\buckets\apr_buckets_socket.c
 # PROP Default_Filter ""
 # Begin Source File
 
+SOURCE=.\crypto\apr_crc32.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\crypto\apr_crypto.c
 # End Source File
 # Begin Source File
@@ -291,6 +307,10 @@ SOURCE=.\dbm\apr_dbm_berkeleydb.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\dbm\apr_dbm_cdb.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\dbm\apr_dbm_gdbm.c
 # End Source File
 # Begin Source File
@@ -317,6 +337,10 @@ SOURCE=.\encoding\apr_base64.c
 
 SOURCE=.\encoding\apr_escape.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\encoding\apr_utf8.c
+# End Source File
 # End Group
 # Begin Group "file_io"
 
@@ -335,6 +359,10 @@ SOURCE=.\file_io\win32\dir.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\file_io\unix\dirwalk.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file_io\unix\fileacc.c
 # End Source File
 # Begin Source File
@@ -403,6 +431,10 @@ SOURCE=.\hooks\apr_hooks.c
 # PROP Default_Filter ""
 # Begin Source File
 
+SOURCE=.\locks\unix\mutex_stats.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\locks\win32\proc_mutex.c
 # End Source File
 # Begin Source File
@@ -417,6 +449,10 @@ SOURCE=.\locks\win32\thread_mutex.c
 
 SOURCE=.\locks\win32\thread_rwlock.c
 # End Source File
+# Begin Source File
+
+SOURCE=.\locks\win32\thread_sema.c
+# End Source File
 # End Group
 # Begin Group "memcache"
 
@@ -632,6 +668,10 @@ SOURCE=.\strings\apr_cpystrn.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\strings\apr_dtoa.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\strings\apr_fnmatch.c
 # End Source File
 # Begin Source File
@@ -640,6 +680,10 @@ SOURCE=.\strings\apr_snprintf.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\strings\apr_strbuf.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\strings\apr_strings.c
 # End Source File
 # Begin Source File
@@ -672,6 +716,14 @@ SOURCE=.\tables\apr_tables.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\tables\apr_hamt.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\tables\apr_heap.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\tables\apr_skiplist.c
 # End Source File
 # End Group
@@ -744,6 +796,54 @@ SOURCE=.\util-misc\apr_queue.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\util-misc\apr_reactor.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_resolver.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_nearcache.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_cache.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_bloom.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_stat_cache.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_file_appender.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_counter.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_shm_hash.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_shm_ring.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_epoch.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\util-misc\apr_fiber.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\util-misc\apr_reslist.c
 # End Source File
 # Begin Source File
@@ -979,6 +1079,10 @@ InputPath=.\include\apr_escape.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_fiber.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_file_info.h
 # End Source File
 # Begin Source File
@@ -1019,6 +1123,10 @@ SOURCE=.\include\apr_mmap.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_mutex_stats.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_network_io.h
 # End Source File
 # Begin Source File
@@ -1043,6 +1151,50 @@ SOURCE=.\include\apr_random.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_reactor.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_resolver.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_nearcache.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_cache.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_bloom.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_stat_cache.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_file_appender.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_counter.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_shm_hash.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_shm_ring.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_epoch.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_ring.h
 # End Source File
 # Begin Source File
@@ -1055,10 +1207,22 @@ SOURCE=.\include\apr_signal.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_hamt.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\apr_heap.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_skiplist.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_strbuf.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_strings.h
 # End Source File
 # Begin Source File
@@ -1087,6 +1251,10 @@ SOURCE=.\include\apr_thread_rwlock.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\apr_thread_sema.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\apr_time.h
 # End Source File
 # Begin Source File
@@ -137,3 +137,71 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem_ptr, void *new_ptr)
 
     return old_ptr;
 }
+
+apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t prev = *mem, old;
+
+    while ((old = apr_atomic_cas32(mem, prev | val, prev)) != prev) {
+        prev = old;
+    }
+    return prev;
+}
+
+apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t prev = *mem, old;
+
+    while ((old = apr_atomic_cas32(mem, prev & val, prev)) != prev) {
+        prev = old;
+    }
+    return prev;
+}
+
+/* Only relaxed accesses are cheaper than the fully fenced ones here */
+
+apr_uint32_t apr_atomic_read32_explicit(volatile apr_uint32_t *mem,
+                                                     apr_atomic_order_e order)
+{
+    if (order == APR_ATOMIC_RELAXED) {
+        return *mem;
+    }
+    return apr_atomic_read32(mem);
+}
+
+void apr_atomic_set32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    if (order == APR_ATOMIC_RELAXED) {
+        *mem = val;
+    }
+    else {
+        apr_atomic_set32(mem, val);
+    }
+}
+
+apr_uint32_t apr_atomic_add32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                                    apr_atomic_order_e order)
+{
+    return apr_atomic_add32(mem, val);
+}
+
+void *apr_atomic_readptr_explicit(void *volatile *mem,
+                                               apr_atomic_order_e order)
+{
+    if (order == APR_ATOMIC_RELAXED) {
+        return *mem;
+    }
+    return apr_atomic_casptr(mem, NULL, NULL);
+}
+
+void apr_atomic_setptr_explicit(void *volatile *mem, void *with,
+                                             apr_atomic_order_e order)
+{
+    if (order == APR_ATOMIC_RELAXED) {
+        *mem = with;
+    }
+    else {
+        apr_atomic_xchgptr(mem, with);
+    }
+}
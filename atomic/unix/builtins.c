@@ -131,4 +131,72 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *ptr)
 #endif
 }
 
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return __atomic_fetch_or(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_or(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return __atomic_fetch_and(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_and(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_explicit(volatile apr_uint32_t *mem,
+                                                     apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return ATOMIC_LOAD_EXPLICIT(mem, order);
+#else
+    return apr_atomic_read32(mem);
+#endif
+}
+
+APR_DECLARE(void) apr_atomic_set32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    ATOMIC_STORE_EXPLICIT(mem, val, order);
+#else
+    apr_atomic_set32(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                                    apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return ATOMIC_FETCH_ADD_EXPLICIT(mem, val, order);
+#else
+    return apr_atomic_add32(mem, val);
+#endif
+}
+
+APR_DECLARE(void*) apr_atomic_readptr_explicit(void *volatile *mem,
+                                               apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return ATOMIC_LOAD_EXPLICIT(mem, order);
+#else
+    return apr_atomic_casptr(mem, NULL, NULL);
+#endif
+}
+
+APR_DECLARE(void) apr_atomic_setptr_explicit(void *volatile *mem, void *with,
+                                             apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    ATOMIC_STORE_EXPLICIT(mem, with, order);
+#else
+    apr_atomic_xchgptr(mem, with);
+#endif
+}
+
 #endif /* USE_ATOMICS_BUILTINS */
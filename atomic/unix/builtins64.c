@@ -106,4 +106,52 @@ APR_DECLARE(apr_uint64_t) apr_atomic_xchg64(volatile apr_uint64_t *mem, apr_uint
 #endif
 }
 
+APR_DECLARE(apr_uint64_t) apr_atomic_or64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return __atomic_fetch_or(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_or(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_and64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return __atomic_fetch_and(mem, val, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_and(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_explicit(volatile apr_uint64_t *mem,
+                                                     apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return ATOMIC_LOAD_EXPLICIT(mem, order);
+#else
+    return apr_atomic_read64(mem);
+#endif
+}
+
+APR_DECLARE(void) apr_atomic_set64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    ATOMIC_STORE_EXPLICIT(mem, val, order);
+#else
+    apr_atomic_set64(mem, val);
+#endif
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                                    apr_atomic_order_e order)
+{
+#if HAVE__ATOMIC_BUILTINS
+    return ATOMIC_FETCH_ADD_EXPLICIT(mem, val, order);
+#else
+    return apr_atomic_add64(mem, val);
+#endif
+}
+
 #endif /* USE_ATOMICS_BUILTINS64 */
@@ -128,4 +128,77 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with)
     return prev;
 }
 
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t prev = *mem, old;
+
+    while ((old = apr_atomic_cas32(mem, prev | val, prev)) != prev) {
+        prev = old;
+    }
+    return prev;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t prev = *mem, old;
+
+    while ((old = apr_atomic_cas32(mem, prev & val, prev)) != prev) {
+        prev = old;
+    }
+    return prev;
+}
+
+/* Loads acquire and stores release on x86, such that only the compiler
+ * needs a barrier for these orders, and sequentially consistent stores
+ * an exchange.
+ */
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_explicit(volatile apr_uint32_t *mem,
+                                                     apr_atomic_order_e order)
+{
+    apr_uint32_t val = *mem;
+
+    asm volatile ("" ::: "memory");
+    return val;
+}
+
+APR_DECLARE(void) apr_atomic_set32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    if (order == APR_ATOMIC_RELAXED || order == APR_ATOMIC_RELEASE) {
+        asm volatile ("" ::: "memory");
+        *mem = val;
+    }
+    else {
+        apr_atomic_xchg32(mem, val);
+    }
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                                    apr_atomic_order_e order)
+{
+    return apr_atomic_add32(mem, val);
+}
+
+APR_DECLARE(void*) apr_atomic_readptr_explicit(void *volatile *mem,
+                                               apr_atomic_order_e order)
+{
+    void *val = *mem;
+
+    asm volatile ("" ::: "memory");
+    return val;
+}
+
+APR_DECLARE(void) apr_atomic_setptr_explicit(void *volatile *mem, void *with,
+                                             apr_atomic_order_e order)
+{
+    if (order == APR_ATOMIC_RELAXED || order == APR_ATOMIC_RELEASE) {
+        asm volatile ("" ::: "memory");
+        *mem = with;
+    }
+    else {
+        apr_atomic_xchgptr(mem, with);
+    }
+}
+
 #endif /* USE_ATOMICS_IA32 */
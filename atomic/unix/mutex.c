@@ -203,4 +203,62 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with)
     return prev;
 }
 
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t prev;
+    DECLARE_MUTEX_LOCKED(mutex, mem);
+
+    prev = *mem;
+    *mem |= val;
+
+    MUTEX_UNLOCK(mutex);
+
+    return prev;
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    apr_uint32_t prev;
+    DECLARE_MUTEX_LOCKED(mutex, mem);
+
+    prev = *mem;
+    *mem &= val;
+
+    MUTEX_UNLOCK(mutex);
+
+    return prev;
+}
+
+/* The mutexes order everything anyway */
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_explicit(volatile apr_uint32_t *mem,
+                                                     apr_atomic_order_e order)
+{
+    return apr_atomic_read32(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    apr_atomic_set32(mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                                    apr_atomic_order_e order)
+{
+    return apr_atomic_add32(mem, val);
+}
+
+APR_DECLARE(void*) apr_atomic_readptr_explicit(void *volatile *mem,
+                                               apr_atomic_order_e order)
+{
+    return *mem;
+}
+
+APR_DECLARE(void) apr_atomic_setptr_explicit(void *volatile *mem, void *with,
+                                             apr_atomic_order_e order)
+{
+    apr_atomic_xchgptr(mem, with);
+}
+
 #endif /* USE_ATOMICS_GENERIC */
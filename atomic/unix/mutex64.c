@@ -175,4 +175,50 @@ APR_DECLARE(apr_uint64_t) apr_atomic_xchg64(volatile apr_uint64_t *mem, apr_uint
     return prev;
 }
 
+APR_DECLARE(apr_uint64_t) apr_atomic_or64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+    apr_uint64_t prev;
+    DECLARE_MUTEX_LOCKED(mutex, mem);
+
+    prev = *mem;
+    *mem |= val;
+
+    MUTEX_UNLOCK(mutex);
+
+    return prev;
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_and64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+    apr_uint64_t prev;
+    DECLARE_MUTEX_LOCKED(mutex, mem);
+
+    prev = *mem;
+    *mem &= val;
+
+    MUTEX_UNLOCK(mutex);
+
+    return prev;
+}
+
+/* The mutexes order everything anyway */
+
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_explicit(volatile apr_uint64_t *mem,
+                                                     apr_atomic_order_e order)
+{
+    return apr_atomic_read64(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order)
+{
+    apr_atomic_set64(mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                                    apr_atomic_order_e order)
+{
+    return apr_atomic_add64(mem, val);
+}
+
 #endif /* USE_ATOMICS_GENERIC64 */
@@ -0,0 +1,170 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+
+/* The double-width compare and swap of the tagged pointers, shared by all
+ * the atomics implementations since it depends on the processor only.
+ */
+#if defined(WIN32) && defined(_WIN64)
+#define USE_TAGPTR_WIN64
+#elif defined(__GNUC__) && !defined(__STRICT_ANSI__) && defined(__x86_64__)
+#include <cpuid.h>
+#define USE_TAGPTR_CMPXCHG16B
+#elif defined(__GNUC__) && !defined(__STRICT_ANSI__) && defined(__aarch64__)
+#define USE_TAGPTR_LDXP
+#elif APR_SIZEOF_VOIDP == 4
+#define USE_TAGPTR_CAS64
+#endif
+
+/* Objects not aligned on their size, or processors without the double-width
+ * instruction, are serialized by spinlocks hashed on their address: all the
+ * operations on a given object take the same path this way.
+ */
+#define NUM_TAGPTR_LOCKS 16
+#define TAGPTR_HASH(x) \
+    (unsigned int)(((apr_uintptr_t)(x) >> 4) % NUM_TAGPTR_LOCKS)
+
+static apr_uint32_t tagptr_locks[NUM_TAGPTR_LOCKS];
+
+static apr_atomic_tagptr_t tagptr_cas_locked(volatile apr_atomic_tagptr_t *mem,
+                                             apr_atomic_tagptr_t with,
+                                             apr_atomic_tagptr_t cmp)
+{
+    apr_uint32_t *lock = &tagptr_locks[TAGPTR_HASH(mem)];
+    apr_atomic_tagptr_t prev;
+
+    while (apr_atomic_cas32(lock, 1, 0) != 0) {
+#if APR_HAS_THREADS
+        apr_thread_yield();
+#endif
+    }
+
+    prev.ptr = mem->ptr;
+    prev.tag = mem->tag;
+    if (prev.ptr == cmp.ptr && prev.tag == cmp.tag) {
+        mem->ptr = with.ptr;
+        mem->tag = with.tag;
+    }
+
+    apr_atomic_xchg32(lock, 0);
+
+    return prev;
+}
+
+#define TAGPTR_ALIGNED(mem) \
+    (((apr_uintptr_t)(mem) & (sizeof(apr_atomic_tagptr_t) - 1)) == 0)
+
+#if defined(USE_TAGPTR_CMPXCHG16B)
+/* Whether the CPU has cmpxchg16b (the first x86-64 ones had not), a benign
+ * race.
+ */
+static int have_cmpxchg16b(void)
+{
+    static int have = -1;
+
+    if (have < 0) {
+        unsigned int a, b, c, d;
+
+        have = __get_cpuid(1, &a, &b, &c, &d) && (c & bit_CMPXCHG16B);
+    }
+
+    return have;
+}
+#endif
+
+APR_DECLARE(apr_atomic_tagptr_t) apr_atomic_cas_tagptr(
+                                        volatile apr_atomic_tagptr_t *mem,
+                                        apr_atomic_tagptr_t with,
+                                        apr_atomic_tagptr_t cmp)
+{
+#if defined(USE_TAGPTR_WIN64)
+    if (TAGPTR_ALIGNED(mem)) {
+        LONG64 prev[2];
+
+        prev[0] = (LONG64)cmp.ptr;
+        prev[1] = (LONG64)cmp.tag;
+        InterlockedCompareExchange128((volatile LONG64 *)mem,
+                                      (LONG64)with.tag, (LONG64)with.ptr,
+                                      prev);
+        cmp.ptr = (void *)prev[0];
+        cmp.tag = (apr_uintptr_t)prev[1];
+        return cmp;
+    }
+#elif defined(USE_TAGPTR_CMPXCHG16B)
+    if (TAGPTR_ALIGNED(mem) && have_cmpxchg16b()) {
+        asm volatile ("lock; cmpxchg16b %0"
+                      : "+m" (*mem), "+a" (cmp.ptr), "+d" (cmp.tag)
+                      : "b" (with.ptr), "c" (with.tag)
+                      : "memory", "cc");
+        return cmp;
+    }
+#elif defined(USE_TAGPTR_LDXP)
+    if (TAGPTR_ALIGNED(mem)) {
+        apr_atomic_tagptr_t prev, store;
+        unsigned int failed;
+
+        do {
+            asm volatile ("ldaxp %0, %1, %2"
+                          : "=&r" (prev.ptr), "=&r" (prev.tag)
+                          : "Q" (*mem)
+                          : "memory");
+            if (prev.ptr == cmp.ptr && prev.tag == cmp.tag) {
+                store = with;
+            }
+            else {
+                /* Store back what was read to release the exclusive
+                 * monitor, and make the failure as ordered as a success.
+                 */
+                store = prev;
+            }
+            asm volatile ("stlxp %w0, %2, %3, %1"
+                          : "=&r" (failed), "=Q" (*mem)
+                          : "r" (store.ptr), "r" (store.tag)
+                          : "memory");
+        } while (failed);
+
+        return prev;
+    }
+#elif defined(USE_TAGPTR_CAS64)
+    if (TAGPTR_ALIGNED(mem)) {
+        union {
+            apr_atomic_tagptr_t tp;
+            apr_uint64_t u64;
+        } w, c;
+
+        w.tp = with;
+        c.tp = cmp;
+        c.u64 = apr_atomic_cas64((volatile apr_uint64_t *)mem, w.u64, c.u64);
+        return c.tp;
+    }
+#endif
+
+    return tagptr_cas_locked(mem, with, cmp);
+}
+
+APR_DECLARE(apr_atomic_tagptr_t) apr_atomic_read_tagptr(
+                                        volatile apr_atomic_tagptr_t *mem)
+{
+    apr_atomic_tagptr_t none;
+
+    /* Swapping the value with itself, if ever, reads it in a single shot */
+    none.ptr = NULL;
+    none.tag = 0;
+    return apr_atomic_cas_tagptr(mem, none, none);
+}
@@ -109,3 +109,69 @@ APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with)
 {
     return InterlockedExchangePointer(mem, with);
 }
+
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    return InterlockedOr((long volatile *)mem, val);
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val)
+{
+    return InterlockedAnd((long volatile *)mem, val);
+}
+
+/* Volatile accesses acquire and release on x86 and x64 (see /volatile:ms),
+ * elsewhere only the relaxed ones avoid the interlocked functions.
+ */
+#if defined(_M_IX86) || defined(_M_X64)
+#define WEAK_ORDER(order) ((order) != APR_ATOMIC_SEQ_CST \
+                           && (order) != APR_ATOMIC_ACQ_REL)
+#else
+#define WEAK_ORDER(order) ((order) == APR_ATOMIC_RELAXED)
+#endif
+
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_explicit(volatile apr_uint32_t *mem,
+                                                     apr_atomic_order_e order)
+{
+    if (WEAK_ORDER(order)) {
+        return *mem;
+    }
+    return apr_atomic_cas32(mem, 0, 0);
+}
+
+APR_DECLARE(void) apr_atomic_set32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order)
+{
+    if (WEAK_ORDER(order)) {
+        *mem = val;
+    }
+    else {
+        apr_atomic_set32(mem, val);
+    }
+}
+
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                                    apr_atomic_order_e order)
+{
+    return apr_atomic_add32(mem, val);
+}
+
+APR_DECLARE(void*) apr_atomic_readptr_explicit(void *volatile *mem,
+                                               apr_atomic_order_e order)
+{
+    if (WEAK_ORDER(order)) {
+        return *mem;
+    }
+    return InterlockedCompareExchangePointer(mem, NULL, NULL);
+}
+
+APR_DECLARE(void) apr_atomic_setptr_explicit(void *volatile *mem, void *with,
+                                             apr_atomic_order_e order)
+{
+    if (WEAK_ORDER(order)) {
+        *mem = with;
+    }
+    else {
+        InterlockedExchangePointer(mem, with);
+    }
+}
@@ -80,3 +80,42 @@ APR_DECLARE(apr_uint64_t) apr_atomic_xchg64(volatile apr_uint64_t *mem, apr_uint
 {
     return InterlockedExchange64((volatile LONG64 *)mem, val);
 }
+
+APR_DECLARE(apr_uint64_t) apr_atomic_or64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+    return InterlockedOr64((volatile LONG64 *)mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_and64(volatile apr_uint64_t *mem, apr_uint64_t val)
+{
+    return InterlockedAnd64((volatile LONG64 *)mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_explicit(volatile apr_uint64_t *mem,
+                                                     apr_atomic_order_e order)
+{
+#if defined(_M_X64)
+    if (order != APR_ATOMIC_SEQ_CST && order != APR_ATOMIC_ACQ_REL) {
+        return *mem;
+    }
+#endif
+    return apr_atomic_read64(mem);
+}
+
+APR_DECLARE(void) apr_atomic_set64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order)
+{
+#if defined(_M_X64)
+    if (order != APR_ATOMIC_SEQ_CST && order != APR_ATOMIC_ACQ_REL) {
+        *mem = val;
+        return;
+    }
+#endif
+    InterlockedExchange64((volatile LONG64 *)mem, val);
+}
+
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                                    apr_atomic_order_e order)
+{
+    return apr_atomic_add64(mem, val);
+}
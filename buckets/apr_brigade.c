@@ -62,16 +62,28 @@ APR_DECLARE(apr_status_t) apr_brigade_cleanup(void *data)
     return APR_SUCCESS;
 }
 
+static APR_INLINE apr_status_t brigade_destroy(apr_bucket_brigade *b)
+{
+    apr_pool_cleanup_t *cleanup = b->cleanup;
+
+    /* Destroyed already, the handle may have been reused */
+    if (!cleanup) {
+        return apr_brigade_cleanup(b);
+    }
+    b->cleanup = NULL;
+    return apr_pool_cleanup_run_handle(b->p, cleanup);
+}
+
 APR_DECLARE(apr_status_t) apr_brigade_destroy(apr_bucket_brigade *b)
 {
 #ifndef APR_BUCKET_DEBUG
-    return apr_pool_cleanup_run(b->p, b, brigade_cleanup);
+    return brigade_destroy(b);
 #else
     apr_status_t rv;
     
     APR_BRIGADE_CHECK_CONSISTENCY(b);
 
-    rv = apr_pool_cleanup_run(b->p, b, brigade_cleanup);
+    rv = brigade_destroy(b);
 
     /* Trigger consistency check failures if the brigade is
      * re-used. */
@@ -93,7 +105,8 @@ APR_DECLARE(apr_bucket_brigade *) apr_brigade_create(apr_pool_t *p,
 
     APR_RING_INIT(&b->list, apr_bucket, link);
 
-    apr_pool_cleanup_register(b->p, b, brigade_cleanup, apr_pool_cleanup_null);
+    b->cleanup = apr_pool_cleanup_register_ex(b->p, b, brigade_cleanup,
+                                              apr_pool_cleanup_null);
     return b;
 }
 
@@ -415,15 +428,59 @@ memmem(const void *_hay, size_t hay_len, const void *needle, size_t needle_len)
 }
 #endif
 
+/*
+ * Return the offset from which the end of str (len bytes) matches the start
+ * of the boundary, searching from off, or len if there is no partial match.
+ * Only the candidates starting with the first byte of the boundary are
+ * compared, they are found with memchr().
+ */
+static apr_size_t boundary_partial(const char *str, apr_size_t off,
+                                   apr_size_t len, const char *boundary,
+                                   apr_size_t boundary_len)
+{
+    const char *pos;
+
+    if (len - off >= boundary_len) {
+        off = len - (boundary_len - 1);
+    }
+    while (off < len && (pos = memchr(str + off, boundary[0], len - off))) {
+        off = pos - str;
+        if (!memcmp(pos, boundary, len - off)) {
+            return off;
+        }
+        off++;
+    }
+
+    return len;
+}
+
 APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
                                                      apr_bucket_brigade *bbIn,
                                                      apr_read_type_e block,
                                                      const char *boundary,
                                                      apr_size_t boundary_len,
                                                      apr_off_t maxbytes)
+{
+    return apr_brigade_split_boundary_ex(bbOut, bbIn, block, boundary,
+                                         boundary_len, maxbytes, NULL);
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_split_boundary_ex(
+                                                 apr_bucket_brigade *bbOut,
+                                                 apr_bucket_brigade *bbIn,
+                                                 apr_read_type_e block,
+                                                 const char *boundary,
+                                                 apr_size_t boundary_len,
+                                                 apr_off_t maxbytes,
+                                                 apr_off_t *scanned)
 {
     apr_off_t outbytes = 0;
     apr_size_t ignore = 0;
+    apr_status_t rv;
+
+    if (scanned) {
+        *scanned = 0;
+    }
 
     if (!boundary || !boundary[0]) {
         return APR_EINVAL;
@@ -448,24 +505,25 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
         apr_bucket *e, *next, *prev;
         apr_size_t inbytes = 0;
         apr_size_t len;
-        apr_status_t rv;
 
         /* We didn't find a boundary within the maximum line length. */
         if (outbytes >= maxbytes) {
-            return APR_INCOMPLETE;
+            rv = APR_INCOMPLETE;
+            goto done;
         }
 
         e = APR_BRIGADE_FIRST(bbIn);
 
         /* We hit a metadata bucket, stop and let the caller handle it */
         if (APR_BUCKET_IS_METADATA(e)) {
-            return APR_INCOMPLETE;
+            rv = APR_INCOMPLETE;
+            goto done;
         }
 
         rv = apr_bucket_read(e, &str, &len, block);
 
         if (rv != APR_SUCCESS) {
-            return rv;
+            goto done;
         }
 
         inbytes += len;
@@ -479,7 +537,6 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
         if ((len - ignore) >= boundary_len) {
 
             apr_size_t off;
-            apr_size_t leftover;
 
             pos = memmem(str + ignore, len - ignore, boundary, boundary_len);
 
@@ -495,6 +552,8 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
                     APR_BUCKET_REMOVE(e);
                     APR_BRIGADE_INSERT_TAIL(bbOut, e);
 
+                    outbytes += off;
+
                     e = APR_BRIGADE_FIRST(bbIn);
                 }
 
@@ -502,33 +561,28 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
                 apr_bucket_split(e, boundary_len);
                 apr_bucket_delete(e);
 
-                return APR_SUCCESS;
+                rv = APR_SUCCESS;
+                goto done;
             }
 
             /* any partial matches at the end? */
-            leftover = boundary_len - 1;
-            off = (len - leftover);
-
-            while (leftover) {
-                if (!memcmp(str + off, boundary, leftover)) {
+            off = boundary_partial(str, ignore, len, boundary, boundary_len);
+            if (off < len) {
 
-                    if (off) {
+                if (off) {
 
-                        apr_bucket_split(e, off);
-                        APR_BUCKET_REMOVE(e);
-                        APR_BRIGADE_INSERT_TAIL(bbOut, e);
-                        ignore = 0;
+                    apr_bucket_split(e, off);
+                    APR_BUCKET_REMOVE(e);
+                    APR_BRIGADE_INSERT_TAIL(bbOut, e);
+                    ignore = 0;
 
-                        e = APR_BRIGADE_FIRST(bbIn);
-                    }
+                    e = APR_BRIGADE_FIRST(bbIn);
+                }
 
-                    outbytes += off;
-                    inbytes -= off;
+                outbytes += off;
+                inbytes -= off;
 
-                    goto skip;
-                }
-                off++;
-                leftover--;
+                goto skip;
             }
 
             APR_BUCKET_REMOVE(e);
@@ -549,32 +603,27 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
          */
         else {
 
-            apr_size_t off = ignore;
-
-            len -= ignore;
-
             /* find all definite non matches */
-            while (len) {
-                if (!memcmp(str + off, boundary, len)) {
-
-                    if (off) {
+            apr_size_t off = boundary_partial(str, ignore, len, boundary,
+                                              boundary_len);
 
-                        apr_bucket_split(e, off);
-                        APR_BUCKET_REMOVE(e);
-                        APR_BRIGADE_INSERT_TAIL(bbOut, e);
-                        ignore = 0;
+            if (off < len) {
 
-                        outbytes += off;
+                if (off) {
 
-                        e = APR_BRIGADE_FIRST(bbIn);
-                    }
+                    apr_bucket_split(e, off);
+                    APR_BUCKET_REMOVE(e);
+                    APR_BRIGADE_INSERT_TAIL(bbOut, e);
+                    ignore = 0;
 
-                    inbytes -= off;
+                    outbytes += off;
 
-                    goto skip;
+                    e = APR_BRIGADE_FIRST(bbIn);
                 }
-                off++;
-                len--;
+
+                inbytes -= off;
+
+                goto skip;
             }
 
             APR_BUCKET_REMOVE(e);
@@ -611,7 +660,7 @@ skip:
             rv = apr_bucket_read(next, &str, &len, block);
 
             if (rv != APR_SUCCESS) {
-                return rv;
+                goto done;
             }
 
             off = boundary_len - inbytes;
@@ -636,7 +685,8 @@ skip:
 
                 }
 
-                return APR_SUCCESS;
+                rv = APR_SUCCESS;
+                goto done;
 
             }
             if (len == off) {
@@ -657,7 +707,8 @@ skip:
 
                 }
 
-                return APR_SUCCESS;
+                rv = APR_SUCCESS;
+                goto done;
 
             }
             else if (len) {
@@ -682,10 +733,175 @@ skip:
         ignore++;
 
     }
+    rv = APR_INCOMPLETE;
 
-    return APR_INCOMPLETE;
+done:
+    if (scanned) {
+        *scanned = outbytes;
+    }
+    return rv;
+}
+
+
+/* The buckets whose data are in memory, and cheap to read */
+#define BUCKET_IS_MEMORY(e) (APR_BUCKET_IS_HEAP(e) \
+                             || APR_BUCKET_IS_TRANSIENT(e) \
+                             || APR_BUCKET_IS_POOL(e) \
+                             || APR_BUCKET_IS_IMMORTAL(e))
+
+APR_DECLARE(apr_status_t) apr_brigade_coalesce(apr_bucket_brigade *bb,
+                                               apr_size_t size)
+{
+    apr_bucket *e = APR_BRIGADE_FIRST(bb);
+    apr_status_t rv;
+
+    if (!size) {
+        size = APR_BUCKET_BUFF_SIZE;
+    }
+
+    while (e != APR_BRIGADE_SENTINEL(bb)) {
+        apr_bucket *first = e, *m;
+        apr_size_t total = 0, n;
+        const char *data;
+        int count = 0;
+        char *buf;
+
+        /* The run of small buckets which fits in one */
+        while (e != APR_BRIGADE_SENTINEL(bb) && BUCKET_IS_MEMORY(e)
+               && e->length < size && total + e->length <= size) {
+            total += e->length;
+            count++;
+            e = APR_BUCKET_NEXT(e);
+        }
+
+        if (!count || (count == 1 && total)) {
+            if (!count) {
+                m = e;
+                e = APR_BUCKET_NEXT(e);
+            }
+            else {
+                m = first;
+            }
+            if (APR_BUCKET_IS_TRANSIENT(m)) {
+                rv = apr_bucket_setaside(m, bb->p);
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+            }
+            continue;
+        }
+
+        if (!total) {
+            for (m = first; m != e; m = first) {
+                first = APR_BUCKET_NEXT(m);
+                apr_bucket_delete(m);
+            }
+            continue;
+        }
+
+        buf = apr_bucket_alloc(total, bb->bucket_alloc);
+        if (!buf) {
+            return APR_ENOMEM;
+        }
+        for (n = 0, m = first; m != e; m = APR_BUCKET_NEXT(m)) {
+            apr_size_t len;
+
+            rv = apr_bucket_read(m, &data, &len, APR_NONBLOCK_READ);
+            if (rv != APR_SUCCESS) {
+                apr_bucket_free(buf);
+                return rv;
+            }
+            memcpy(buf + n, data, len);
+            n += len;
+        }
+        for (m = first; m != e; m = first) {
+            first = APR_BUCKET_NEXT(m);
+            apr_bucket_delete(m);
+        }
+        m = apr_bucket_heap_create(buf, n, apr_bucket_free, bb->bucket_alloc);
+        APR_BUCKET_INSERT_BEFORE(e, m);
+    }
+
+    return APR_SUCCESS;
 }
 
+/* Copy a run of TRANSIENT buckets into one buffer, and make each of them
+ * a HEAP bucket sharing it, as split HEAP buckets do.
+ */
+static apr_status_t setaside_transients(apr_bucket *first, apr_bucket *last,
+                                        apr_size_t total)
+{
+    apr_bucket *e, *next;
+    apr_bucket_heap *h;
+    apr_size_t n = 0;
+    char *buf;
+
+    buf = apr_bucket_alloc(total, first->list);
+    if (!buf) {
+        return APR_ENOMEM;
+    }
+    for (e = first; ; e = APR_BUCKET_NEXT(e)) {
+        memcpy(buf + n, (char *)e->data + e->start, e->length);
+        n += e->length;
+        if (e == last) {
+            break;
+        }
+    }
+
+    n = first->length;
+    if (!apr_bucket_heap_make(first, buf, total, apr_bucket_free)) {
+        apr_bucket_free(buf);
+        return APR_ENOMEM;
+    }
+    first->length = n;
+    h = first->data;
+
+    for (e = first; e != last; e = next) {
+        next = APR_BUCKET_NEXT(e);
+        apr_bucket_shared_make(next, h, n, next->length);
+        next->type = &apr_bucket_type_heap;
+        n += next->length;
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_setaside(apr_bucket_brigade *bb,
+                                               apr_pool_t *pool)
+{
+    apr_bucket *e = APR_BRIGADE_FIRST(bb);
+    apr_status_t rv;
+
+    while (e != APR_BRIGADE_SENTINEL(bb)) {
+        apr_bucket *first = e, *last = e;
+        apr_size_t total = 0;
+        int count = 0;
+
+        /* The run of TRANSIENT buckets which fits in one buffer */
+        while (e != APR_BRIGADE_SENTINEL(bb) && APR_BUCKET_IS_TRANSIENT(e)
+               && total + e->length <= APR_BUCKET_BUFF_SIZE) {
+            total += e->length;
+            count++;
+            last = e;
+            e = APR_BUCKET_NEXT(e);
+        }
+
+        if (count > 1) {
+            rv = setaside_transients(first, last, total);
+        }
+        else {
+            if (!count) {
+                e = APR_BUCKET_NEXT(e);
+            }
+            rv = apr_bucket_setaside(first, pool);
+        }
+        if (rv != APR_SUCCESS && rv != APR_ENOTIMPL) {
+            return rv;
+        }
+    }
+
+    return APR_SUCCESS;
+}
 
 APR_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b, 
                                                struct iovec *vec, int *nvec)
@@ -790,13 +1006,16 @@ APR_DECLARE(apr_status_t) apr_brigade_write(apr_bucket_brigade *b,
             APR_BRIGADE_INSERT_TAIL(b, e);
             return flush(b, ctx);
         }
-        else {
+        else if (nbyte > APR_BUCKET_BUFF_SIZE) {
             e = apr_bucket_heap_create(str, nbyte, NULL, b->bucket_alloc);
             APR_BRIGADE_INSERT_TAIL(b, e);
             return APR_SUCCESS;
         }
+        /* the buffer bucket is full, start another one rather than a
+         * bucket of this size, which the next writes could not fill */
+        buf = NULL;
     }
-    else if (!buf) {
+    if (!buf) {
         /* we don't have a buffer, but the data is small enough
          * that we don't mind making a new buffer */
         buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, b->bucket_alloc);
@@ -1007,10 +1226,11 @@ static apr_status_t brigade_flush(apr_vformatter_buff_t *buff)
     return res;
 }
 
-APR_DECLARE(apr_status_t) apr_brigade_vprintf(apr_bucket_brigade *b,
-                                              apr_brigade_flush flush,
-                                              void *ctx,
-                                              const char *fmt, va_list va)
+/* Format to the brigade from fmt, or from the compiled format */
+static apr_status_t brigade_vformat(apr_bucket_brigade *b,
+                                    apr_brigade_flush flush, void *ctx,
+                                    const char *fmt,
+                                    const apr_format_t *format, va_list va)
 {
     /* the cast, in order of appearance */
     struct brigade_vprintf_data_t vd;
@@ -1024,7 +1244,12 @@ APR_DECLARE(apr_status_t) apr_brigade_vprintf(apr_bucket_brigade *b,
     vd.ctx = ctx;
     vd.cbuff = buf;
 
-    written = apr_vformatter(brigade_flush, &vd.vbuff, fmt, va);
+    if (format) {
+        written = apr_format_vformatter(brigade_flush, &vd.vbuff, format, va);
+    }
+    else {
+        written = apr_vformatter(brigade_flush, &vd.vbuff, fmt, va);
+    }
 
     if (written == -1) {
       return -1;
@@ -1034,6 +1259,38 @@ APR_DECLARE(apr_status_t) apr_brigade_vprintf(apr_bucket_brigade *b,
     return apr_brigade_write(b, flush, ctx, buf, vd.vbuff.curpos - buf);
 }
 
+APR_DECLARE(apr_status_t) apr_brigade_vprintf(apr_bucket_brigade *b,
+                                              apr_brigade_flush flush,
+                                              void *ctx,
+                                              const char *fmt, va_list va)
+{
+    return brigade_vformat(b, flush, ctx, fmt, NULL, va);
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_vformat(apr_bucket_brigade *b,
+                                              apr_brigade_flush flush,
+                                              void *ctx,
+                                              const apr_format_t *format,
+                                              va_list va)
+{
+    return brigade_vformat(b, flush, ctx, NULL, format, va);
+}
+
+APR_DECLARE_NONSTD(apr_status_t) apr_brigade_format(apr_bucket_brigade *b,
+                                                    apr_brigade_flush flush,
+                                                    void *ctx,
+                                                    const apr_format_t *format,
+                                                    ...)
+{
+    va_list ap;
+    apr_status_t rv;
+
+    va_start(ap, format);
+    rv = brigade_vformat(b, flush, ctx, NULL, format, ap);
+    va_end(ap);
+    return rv;
+}
+
 /* A "safe" maximum bucket size, 1Gb */
 #define MAX_BUCKET_SIZE (0x40000000)
 
@@ -1067,3 +1324,187 @@ APR_DECLARE(apr_bucket *) apr_brigade_insert_file(apr_bucket_brigade *bb,
     APR_BRIGADE_INSERT_TAIL(bb, e);
     return e;
 }
+
+/* The most buckets written at once by apr_brigade_write_socket() */
+#define WRITE_IOVEC_MAX 64
+/* Buckets smaller than this are copied together in a buffer of
+ * WRITE_COALESCE_SIZE bytes, saving iovecs.
+ */
+#define WRITE_COALESCE_MAX 256
+#define WRITE_COALESCE_SIZE 4096
+#if APR_HAS_SENDFILE
+/* Smaller files are not worth a sendfile() */
+#define WRITE_SENDFILE_MIN 256
+
+static APR_INLINE int bucket_sendfile(apr_bucket *e)
+{
+    if (APR_BUCKET_IS_FILE(e) && e->length >= WRITE_SENDFILE_MIN
+        && e->length != (apr_size_t)-1) {
+        apr_bucket_file *f = e->data;
+        return (apr_file_flags_get(f->fd) & APR_FOPEN_SENDFILE_ENABLED) != 0;
+    }
+    return 0;
+}
+#endif
+
+/* Delete the first buckets of bb which were written, splitting the
+ * last one if it was partially written.
+ */
+static void brigade_consume(apr_bucket_brigade *bb, apr_size_t written)
+{
+    while (written && !APR_BRIGADE_EMPTY(bb)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(bb);
+
+        if (e->length > written) {
+            apr_bucket_split(e, written);
+            written = e->length;
+        }
+        written -= e->length;
+        apr_bucket_delete(e);
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_write_socket(apr_bucket_brigade *bb,
+                                                   apr_socket_t *sock,
+                                                   apr_size_t *len)
+{
+    struct iovec vec[WRITE_IOVEC_MAX];
+    char buf[WRITE_COALESCE_SIZE];
+    apr_status_t rv = APR_SUCCESS;
+
+    *len = 0;
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(bb);
+        apr_size_t nvec = 0, nbuf = 0, total = 0, n;
+        const char *data;
+
+        /* Gather the data buckets up to the next one which is written
+         * on its own (or a metadata bucket).
+         */
+        while (e != APR_BRIGADE_SENTINEL(bb) && nvec < WRITE_IOVEC_MAX) {
+            if (APR_BUCKET_IS_METADATA(e)) {
+                break;
+            }
+#if APR_HAS_SPLICE
+            if (APR_BUCKET_IS_SOCKET(e) || APR_BUCKET_IS_PIPE(e)) {
+                break;
+            }
+#endif
+#if APR_HAS_SENDFILE
+            if (bucket_sendfile(e)) {
+                break;
+            }
+#endif
+            rv = apr_bucket_read(e, &data, &n, APR_BLOCK_READ);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            if (!n) {
+                apr_bucket *next = APR_BUCKET_NEXT(e);
+                apr_bucket_delete(e);
+                e = next;
+                continue;
+            }
+            if (n <= WRITE_COALESCE_MAX && nbuf + n <= sizeof(buf)) {
+                memcpy(buf + nbuf, data, n);
+                if (nvec && (char *)vec[nvec - 1].iov_base
+                            + vec[nvec - 1].iov_len == buf + nbuf) {
+                    vec[nvec - 1].iov_len += n;
+                }
+                else {
+                    vec[nvec].iov_base = buf + nbuf;
+                    vec[nvec].iov_len = n;
+                    nvec++;
+                }
+                nbuf += n;
+            }
+            else {
+                vec[nvec].iov_base = (char *)data;
+                vec[nvec].iov_len = n;
+                nvec++;
+            }
+            total += n;
+            e = APR_BUCKET_NEXT(e);
+        }
+
+        if (nvec) {
+#if APR_HAS_SENDFILE
+            if (rv == APR_SUCCESS && e != APR_BRIGADE_SENTINEL(bb)
+                && bucket_sendfile(e)) {
+                /* The gathered data go as headers of the file */
+                apr_bucket_file *f = e->data;
+                apr_hdtr_t hdtr;
+                apr_off_t offset = e->start;
+
+                memset(&hdtr, 0, sizeof(hdtr));
+                hdtr.headers = vec;
+                hdtr.numheaders = (int)nvec;
+                total += e->length;
+                n = e->length;
+                rv = apr_socket_sendfile(sock, f->fd, &hdtr, &offset, &n, 0);
+            }
+            else
+#endif
+            {
+                rv = apr_socket_sendv(sock, vec, (apr_int32_t)nvec, &n);
+            }
+            *len += n;
+            brigade_consume(bb, n);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            continue;
+        }
+        if (rv != APR_SUCCESS || e == APR_BRIGADE_SENTINEL(bb)
+            || APR_BUCKET_IS_METADATA(e)) {
+            break;
+        }
+
+#if APR_HAS_SPLICE
+        if (APR_BUCKET_IS_SOCKET(e) || APR_BUCKET_IS_PIPE(e)) {
+            n = APR_SIZE_MAX;
+            if (APR_BUCKET_IS_SOCKET(e)) {
+                rv = apr_socket_splice(sock, e->data, &n);
+            }
+            else {
+                rv = apr_socket_splice_file(sock, e->data, &n);
+            }
+            *len += n;
+            if (rv == APR_EOF) {
+                /* Like the read of a socket or pipe bucket at EOF */
+                apr_bucket_delete(e);
+                rv = APR_SUCCESS;
+                continue;
+            }
+            if (rv == APR_SUCCESS) {
+                continue;
+            }
+            if (n || (rv != APR_ENOTIMPL && !APR_STATUS_IS_EINVAL(rv))) {
+                return rv;
+            }
+            /* Not spliceable, read it into the next batch */
+            rv = apr_bucket_read(e, &data, &n, APR_BLOCK_READ);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            continue;
+        }
+#endif
+#if APR_HAS_SENDFILE
+        {
+            apr_bucket_file *f = e->data;
+            apr_off_t offset = e->start;
+
+            n = e->length;
+            rv = apr_socket_sendfile(sock, f->fd, NULL, &offset, &n, 0);
+            *len += n;
+            brigade_consume(bb, n);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+#endif
+    }
+
+    return rv;
+}
@@ -0,0 +1,371 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_buckets.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if APU_HAVE_ZLIB
+#include <zlib.h>
+
+/* Fed to zlib at once, for its uInt lengths */
+#define CODEC_CHUNK_MAX (1U << 30)
+
+struct apr_brigade_codec_t {
+    apr_pool_t *pool;
+    apr_bucket_alloc_t *list;
+    apr_brigade_codec_type_e type;
+    apr_uint32_t flags;
+    z_stream zs;
+    /* The output buffer being filled, if any */
+    char *buf;
+    /* Whether the (de)compression of a stream has started, and for
+     * decompression whether it has ended */
+    unsigned int started:1,
+                 ended:1;
+};
+
+#define CODEC_IS_DECODE(ctx) ((ctx)->flags & APR_BRIGADE_CODEC_DECODE)
+
+static apr_status_t zlib_status(int zrv)
+{
+    switch (zrv) {
+    case Z_OK:
+    case Z_STREAM_END:
+        return APR_SUCCESS;
+    case Z_MEM_ERROR:
+        return APR_ENOMEM;
+    case Z_STREAM_ERROR:
+        return APR_EINVAL;
+    default:
+        return APR_EGENERAL;
+    }
+}
+
+static apr_status_t codec_cleanup(void *data)
+{
+    apr_brigade_codec_t *ctx = data;
+
+    if (CODEC_IS_DECODE(ctx)) {
+        inflateEnd(&ctx->zs);
+    }
+    else {
+        deflateEnd(&ctx->zs);
+    }
+    if (ctx->buf) {
+        apr_bucket_free(ctx->buf);
+        ctx->buf = NULL;
+    }
+
+    return APR_SUCCESS;
+}
+
+/* Pass the output produced so far to the brigade, as a HEAP bucket owning
+ * the buffer */
+static void codec_emit(apr_brigade_codec_t *ctx, apr_bucket_brigade *out)
+{
+    apr_size_t len;
+
+    if (ctx->buf) {
+        len = (char *)ctx->zs.next_out - ctx->buf;
+        if (len) {
+            APR_BRIGADE_INSERT_TAIL(out,
+                    apr_bucket_heap_create(ctx->buf, len, apr_bucket_free,
+                                           ctx->list));
+        }
+        else {
+            apr_bucket_free(ctx->buf);
+        }
+        ctx->buf = NULL;
+    }
+}
+
+static apr_status_t codec_run(apr_brigade_codec_t *ctx,
+                              apr_bucket_brigade *out, int flush)
+{
+    int zrv;
+
+    for (;;) {
+        if (!ctx->buf) {
+            ctx->buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ctx->list);
+            if (!ctx->buf) {
+                return APR_ENOMEM;
+            }
+            ctx->zs.next_out = (Bytef *)ctx->buf;
+            ctx->zs.avail_out = APR_BUCKET_BUFF_SIZE;
+        }
+
+        if (CODEC_IS_DECODE(ctx)) {
+            if (ctx->zs.avail_in) {
+                ctx->ended = 0;
+            }
+            zrv = inflate(&ctx->zs, Z_NO_FLUSH);
+        }
+        else {
+            zrv = deflate(&ctx->zs, flush);
+        }
+
+        if (!ctx->zs.avail_out) {
+            codec_emit(ctx, out);
+        }
+
+        if (zrv == Z_STREAM_END) {
+            if (!CODEC_IS_DECODE(ctx)) {
+                return APR_SUCCESS;
+            }
+            /* Be ready for the next stream (e.g. gzip members) */
+            ctx->ended = 1;
+            zrv = inflateReset(&ctx->zs);
+            if (zrv != Z_OK || !ctx->zs.avail_in) {
+                return zlib_status(zrv);
+            }
+            continue;
+        }
+        if (zrv != Z_OK && (zrv != Z_BUF_ERROR || !ctx->zs.avail_out)) {
+            return zlib_status(zrv);
+        }
+
+        /* Room left in the output buffer means that all the input was
+         * consumed and all the output flushed, but for Z_FINISH which
+         * completes with Z_STREAM_END only.
+         */
+        if (ctx->zs.avail_out && flush != Z_FINISH) {
+            return APR_SUCCESS;
+        }
+    }
+}
+
+static apr_status_t codec_feed(apr_brigade_codec_t *ctx,
+                               apr_bucket_brigade *out,
+                               const char *data, apr_size_t len)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    ctx->started = 1;
+    while (len && rv == APR_SUCCESS) {
+        apr_size_t n = len < CODEC_CHUNK_MAX ? len : CODEC_CHUNK_MAX;
+
+        ctx->zs.next_in = (Bytef *)data;
+        ctx->zs.avail_in = (uInt)n;
+        rv = codec_run(ctx, out, Z_NO_FLUSH);
+        if (rv == APR_SUCCESS && ctx->zs.avail_in) {
+            /* Trailing garbage after the end of the stream */
+            rv = APR_EGENERAL;
+        }
+        ctx->zs.next_in = NULL;
+        ctx->zs.avail_in = 0;
+
+        data += n;
+        len -= n;
+    }
+
+    return rv;
+}
+
+static apr_status_t codec_init(apr_brigade_codec_t *ctx, int level,
+                               int window)
+{
+    int zrv;
+
+    if (!window) {
+        window = MAX_WBITS;
+    }
+    else if (window < 9 || window > MAX_WBITS) {
+        return APR_EINVAL;
+    }
+    if (level == APR_BRIGADE_CODEC_LEVEL_DEFAULT) {
+        level = Z_DEFAULT_COMPRESSION;
+    }
+    else if (level < 0 || level > 9) {
+        return APR_EINVAL;
+    }
+
+    switch (ctx->type) {
+    case APR_BRIGADE_CODEC_DEFLATE:
+        window = -window;
+        break;
+    case APR_BRIGADE_CODEC_GZIP:
+        window += 16;
+        break;
+    default:
+        break;
+    }
+
+    if (CODEC_IS_DECODE(ctx)) {
+        zrv = inflateInit2(&ctx->zs, window);
+    }
+    else {
+        zrv = deflateInit2(&ctx->zs, level, Z_DEFLATED, window,
+                           8 /* zlib's default memLevel */,
+                           Z_DEFAULT_STRATEGY);
+    }
+
+    return zlib_status(zrv);
+}
+
+#endif /* APU_HAVE_ZLIB */
+
+APR_DECLARE(int) apr_brigade_codec_supported(apr_brigade_codec_type_e type)
+{
+#if APU_HAVE_ZLIB
+    switch (type) {
+    case APR_BRIGADE_CODEC_DEFLATE:
+    case APR_BRIGADE_CODEC_ZLIB:
+    case APR_BRIGADE_CODEC_GZIP:
+        return 1;
+    default:
+        break;
+    }
+#endif
+
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_codec_create(apr_brigade_codec_t **ctx,
+                                                   apr_brigade_codec_type_e type,
+                                                   apr_uint32_t flags,
+                                                   int level, int window,
+                                                   apr_bucket_alloc_t *list,
+                                                   apr_pool_t *p)
+{
+#if APU_HAVE_ZLIB
+    apr_brigade_codec_t *c;
+    apr_status_t rv;
+
+    *ctx = NULL;
+
+    if (!apr_brigade_codec_supported(type)) {
+        return APR_ENOTIMPL;
+    }
+    if (flags & ~APR_BRIGADE_CODEC_DECODE) {
+        return APR_EINVAL;
+    }
+
+    c = apr_pcalloc(p, sizeof(*c));
+    c->pool = p;
+    c->list = list;
+    c->type = type;
+    c->flags = flags;
+
+    rv = codec_init(c, level, window);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_pool_cleanup_register(p, c, codec_cleanup, apr_pool_cleanup_null);
+
+    *ctx = c;
+    return APR_SUCCESS;
+#else
+    *ctx = NULL;
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_codec_reset(apr_brigade_codec_t *ctx)
+{
+#if APU_HAVE_ZLIB
+    int zrv;
+
+    if (ctx->buf) {
+        apr_bucket_free(ctx->buf);
+        ctx->buf = NULL;
+    }
+    ctx->zs.next_out = NULL;
+    ctx->zs.avail_out = 0;
+    ctx->started = ctx->ended = 0;
+
+    if (CODEC_IS_DECODE(ctx)) {
+        zrv = inflateReset(&ctx->zs);
+    }
+    else {
+        zrv = deflateReset(&ctx->zs);
+    }
+
+    return zlib_status(zrv);
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_brigade_codec_process(apr_brigade_codec_t *ctx,
+                                                    apr_bucket_brigade *out,
+                                                    apr_bucket_brigade *in,
+                                                    apr_read_type_e block)
+{
+#if APU_HAVE_ZLIB
+    apr_status_t rv = APR_SUCCESS;
+
+    while (!APR_BRIGADE_EMPTY(in)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(in);
+        const char *data;
+        apr_size_t len;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            if (APR_BUCKET_IS_EOS(e)) {
+                if (!CODEC_IS_DECODE(ctx)) {
+                    rv = codec_run(ctx, out, Z_FINISH);
+                }
+                else if (ctx->started && !ctx->ended) {
+                    /* Truncated stream */
+                    codec_emit(ctx, out);
+                    return APR_INCOMPLETE;
+                }
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+                codec_emit(ctx, out);
+                rv = apr_brigade_codec_reset(ctx);
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+            }
+            else if (APR_BUCKET_IS_FLUSH(e)) {
+                if (!CODEC_IS_DECODE(ctx) && ctx->started) {
+                    rv = codec_run(ctx, out, Z_SYNC_FLUSH);
+                    if (rv != APR_SUCCESS) {
+                        return rv;
+                    }
+                }
+                codec_emit(ctx, out);
+            }
+            else {
+                /* Keep the order of what's been produced already */
+                codec_emit(ctx, out);
+            }
+
+            APR_BUCKET_REMOVE(e);
+            APR_BRIGADE_INSERT_TAIL(out, e);
+            continue;
+        }
+
+        rv = apr_bucket_read(e, &data, &len, block);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (len) {
+            rv = codec_feed(ctx, out, data, len);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        apr_bucket_delete(e);
+    }
+
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
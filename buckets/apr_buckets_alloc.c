@@ -20,6 +20,9 @@
 #include "apr_allocator.h"
 #include "apr_support.h"
 
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
 #define ALLOC_AMT (8192 - APR_MEMNODE_T_SIZE)
 
 typedef struct node_header_t {
@@ -32,6 +35,14 @@ typedef struct node_header_t {
 #define SIZEOF_NODE_HEADER_T  APR_ALIGN_DEFAULT(sizeof(node_header_t))
 #define SMALL_NODE_SIZE       (APR_BUCKET_ALLOC_SIZE + SIZEOF_NODE_HEADER_T)
 
+/* Larger nodes are recycled on free lists by the size of their memnode,
+ * in units of LARGE_CLASS_SIZE, below LARGE_CLASSES units (128K).
+ */
+#define LARGE_CLASS_SHIFT     12
+#define LARGE_CLASS_SIZE      ((apr_size_t)1 << LARGE_CLASS_SHIFT)
+#define LARGE_CLASSES         32
+#define LARGE_MAX_FREE        (128 * 1024)
+
 /** A list of free memory from which new buckets or private bucket
  *  structures can be allocated.
  */
@@ -40,8 +51,27 @@ struct apr_bucket_alloc_t {
     apr_allocator_t *allocator;
     node_header_t *freelist;
     apr_memnode_t *blocks;
+    apr_memnode_t *large[LARGE_CLASSES];
+    apr_size_t large_free;
+    apr_size_t large_max;
 };
 
+static void large_trim(apr_bucket_alloc_t *list, apr_size_t max)
+{
+    int i;
+
+    for (i = LARGE_CLASSES - 1; i >= 0 && list->large_free > max; i--) {
+        while (list->large[i] && list->large_free > max) {
+            apr_memnode_t *memnode = list->large[i];
+
+            list->large[i] = memnode->next;
+            memnode->next = NULL;
+            list->large_free -= (apr_size_t)i << LARGE_CLASS_SHIFT;
+            apr_allocator_free(list->allocator, memnode);
+        }
+    }
+}
+
 static apr_status_t alloc_cleanup(void *data)
 {
     apr_bucket_alloc_t *list = data;
@@ -55,6 +85,7 @@ static apr_status_t alloc_cleanup(void *data)
     }
 #endif
 
+    large_trim(list, 0);
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -111,6 +142,9 @@ APR_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(
     list->allocator = allocator;
     list->freelist = NULL;
     list->blocks = block;
+    memset(list->large, 0, sizeof(list->large));
+    list->large_free = 0;
+    list->large_max = LARGE_MAX_FREE;
     block->first_avail += APR_ALIGN_DEFAULT(sizeof(*list));
     APR_VALGRIND_NOACCESS(block->first_avail,
                           block->endp - block->first_avail);
@@ -123,6 +157,7 @@ APR_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
         apr_pool_cleanup_kill(list->pool, list, alloc_cleanup);
     }
 
+    large_trim(list, 0);
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -132,6 +167,13 @@ APR_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
 #endif
 }
 
+APR_DECLARE_NONSTD(void) apr_bucket_alloc_max_free_set(apr_bucket_alloc_t *list,
+                                                       apr_size_t size)
+{
+    list->large_max = size;
+    large_trim(list, size);
+}
+
 APR_DECLARE_NONSTD(apr_size_t) apr_bucket_alloc_aligned_floor(apr_bucket_alloc_t *list,
                                                               apr_size_t size)
 {
@@ -191,9 +233,24 @@ APR_DECLARE_NONSTD(void *) apr_bucket_alloc(apr_size_t in_size,
         }
     }
     else {
-        apr_memnode_t *memnode = apr_allocator_alloc(list->allocator, size);
-        if (!memnode) {
-            return NULL;
+        apr_memnode_t *memnode = NULL;
+        apr_size_t aligned = apr_allocator_align(list->allocator, size);
+        apr_size_t index = aligned >> LARGE_CLASS_SHIFT;
+
+        if (index < LARGE_CLASSES && list->large[index]
+            && !(aligned & (LARGE_CLASS_SIZE - 1))) {
+            memnode = list->large[index];
+            list->large[index] = memnode->next;
+            memnode->next = NULL;
+            list->large_free -= aligned;
+            APR_VALGRIND_UNDEFINED(memnode->first_avail,
+                                   memnode->endp - memnode->first_avail);
+        }
+        else {
+            memnode = apr_allocator_alloc(list->allocator, size);
+            if (!memnode) {
+                return NULL;
+            }
         }
         node = (node_header_t *)memnode->first_avail;
         node->alloc = list;
@@ -235,6 +292,20 @@ APR_DECLARE_NONSTD(void) apr_bucket_free(void *mem)
         APR_VALGRIND_NOACCESS(mem, SMALL_NODE_SIZE - SIZEOF_NODE_HEADER_T);
     }
     else {
-        apr_allocator_free(list->allocator, node->memnode);
+        apr_memnode_t *memnode = node->memnode;
+        apr_size_t aligned = memnode->endp - (char *)memnode;
+        apr_size_t index = aligned >> LARGE_CLASS_SHIFT;
+
+        if (index < LARGE_CLASSES && !(aligned & (LARGE_CLASS_SIZE - 1))
+            && list->large_free + aligned <= list->large_max) {
+            memnode->next = list->large[index];
+            list->large[index] = memnode;
+            list->large_free += aligned;
+            APR_VALGRIND_NOACCESS(memnode->first_avail,
+                                  memnode->endp - memnode->first_avail);
+        }
+        else {
+            apr_allocator_free(list->allocator, memnode);
+        }
     }
 }
@@ -0,0 +1,140 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_buckets.h"
+#include "apr_atomic.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#include <stdlib.h>
+
+static apr_status_t buffer_bucket_read(apr_bucket *b, const char **str,
+                                       apr_size_t *len, apr_read_type_e block)
+{
+    apr_bucket_buffer *buffer = b->data;
+
+    *str = buffer->base + b->start;
+    *len = b->length;
+    return APR_SUCCESS;
+}
+
+static apr_status_t buffer_bucket_split(apr_bucket *a, apr_size_t point)
+{
+    apr_bucket_buffer *buffer = a->data;
+    apr_status_t rv;
+
+    if ((rv = apr_bucket_simple_split(a, point)) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_atomic_inc32(&buffer->refcount);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t buffer_bucket_copy(apr_bucket *a, apr_bucket **b)
+{
+    apr_bucket_buffer *buffer = a->data;
+
+    apr_atomic_inc32(&buffer->refcount);
+
+    return apr_bucket_simple_copy(a, b);
+}
+
+static void buffer_bucket_destroy(void *data)
+{
+    apr_bucket_buffer_release(data);
+}
+
+APR_DECLARE(apr_bucket_buffer *) apr_bucket_buffer_alloc(const char *buf,
+                                                         apr_size_t length,
+                                                 void (*free_func)(void *data))
+{
+    apr_bucket_buffer *buffer;
+
+    if (!free_func) {
+        apr_size_t size = APR_ALIGN_DEFAULT(sizeof(*buffer));
+
+        if (length > APR_SIZE_MAX - size) {
+            return NULL;
+        }
+        buffer = malloc(size + length);
+        if (!buffer) {
+            return NULL;
+        }
+        memcpy((char *)buffer + size, buf, length);
+        buffer->base = (char *)buffer + size;
+    }
+    else {
+        buffer = malloc(sizeof(*buffer));
+        if (!buffer) {
+            return NULL;
+        }
+        buffer->base = buf;
+    }
+    buffer->length = length;
+    buffer->free_func = free_func;
+    apr_atomic_set32(&buffer->refcount, 1);
+
+    return buffer;
+}
+
+APR_DECLARE(void) apr_bucket_buffer_release(apr_bucket_buffer *buffer)
+{
+    if (!apr_atomic_dec32(&buffer->refcount)) {
+        if (buffer->free_func) {
+            /* XXX: the const qualifier is lost, as for heap buckets */
+            (*buffer->free_func)((char *)buffer->base);
+        }
+        free(buffer);
+    }
+}
+
+APR_DECLARE(apr_bucket *) apr_bucket_buffer_make(apr_bucket *b,
+                                                 apr_bucket_buffer *buffer,
+                                                 apr_off_t start,
+                                                 apr_size_t length)
+{
+    apr_atomic_inc32(&buffer->refcount);
+
+    b->data = buffer;
+    b->start = start;
+    b->length = length;
+    b->type = &apr_bucket_type_buffer;
+
+    return b;
+}
+
+APR_DECLARE(apr_bucket *) apr_bucket_buffer_create(apr_bucket_buffer *buffer,
+                                                   apr_off_t start,
+                                                   apr_size_t length,
+                                                   apr_bucket_alloc_t *list)
+{
+    apr_bucket *b = apr_bucket_alloc(sizeof(*b), list);
+
+    APR_BUCKET_INIT(b);
+    b->free = apr_bucket_free;
+    b->list = list;
+    return apr_bucket_buffer_make(b, buffer, start, length);
+}
+
+APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_buffer = {
+    "BUFFER", 5, APR_BUCKET_DATA,
+    buffer_bucket_destroy,
+    buffer_bucket_read,
+    apr_bucket_setaside_noop,
+    buffer_bucket_split,
+    buffer_bucket_copy
+};
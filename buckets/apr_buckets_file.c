@@ -14,10 +14,36 @@
  * limitations under the License.
  */
 
+#include "apr_private.h"
+
 #include "apr.h"
 #include "apr_general.h"
 #include "apr_file_io.h"
+#include "apr_portable.h"
 #include "apr_buckets.h"
+#include "apr_probes.h"
+
+#ifdef HAVE_POSIX_FADVISE
+#if APR_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#endif
+
+#if APR_HAS_THREADS
+#include "apr_atomic.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+#include "apr_thread_pool.h"
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if APR_HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#endif
 
 #if APR_HAS_MMAP
 #include "apr_mmap.h"
@@ -29,11 +55,22 @@
 
 #endif /* APR_HAS_MMAP */
 
+#if APR_HAS_THREADS
+typedef struct file_aio_req_t file_aio_req_t;
+static void file_aio_release(file_aio_req_t *req);
+#endif
+
 static void file_bucket_destroy(void *data)
 {
     apr_bucket_file *f = data;
 
     if (apr_bucket_shared_destroy(f)) {
+#if APR_HAS_THREADS
+        if (f->aio_req) {
+            /* the read in flight frees itself */
+            file_aio_release(f->aio_req);
+        }
+#endif
         /* no need to close the file here; it will get
          * done automatically when the pool gets cleaned up */
         apr_bucket_free(f);
@@ -41,6 +78,17 @@ static void file_bucket_destroy(void *data)
 }
 
 #if APR_HAS_MMAP
+static apr_status_t file_mmap(apr_mmap_t **mm, apr_bucket_file *a,
+                              apr_off_t fileoffset, apr_size_t len,
+                              apr_pool_t *p)
+{
+    if (a->mmap_cache) {
+        return apr_mmap_cache_get(mm, a->mmap_cache, a->fd, fileoffset, len,
+                                  APR_MMAP_READ, p);
+    }
+    return apr_mmap_create(mm, a->fd, fileoffset, len, APR_MMAP_READ, p);
+}
+
 static int file_make_mmap(apr_bucket *e, apr_size_t filelength,
                            apr_off_t fileoffset, apr_pool_t *p)
 {
@@ -51,18 +99,18 @@ static int file_make_mmap(apr_bucket *e, apr_size_t filelength,
         return 0;
     }
 
-    if (filelength > APR_MMAP_LIMIT) {
-        if (apr_mmap_create(&mm, a->fd, fileoffset, APR_MMAP_LIMIT,
-                            APR_MMAP_READ, p) != APR_SUCCESS)
+    if (filelength > a->mmap_limit) {
+        if (a->mmap_limit < a->mmap_threshold
+            || file_mmap(&mm, a, fileoffset, a->mmap_limit,
+                         p) != APR_SUCCESS)
         {
             return 0;
         }
-        apr_bucket_split(e, APR_MMAP_LIMIT);
-        filelength = APR_MMAP_LIMIT;
+        apr_bucket_split(e, a->mmap_limit);
+        filelength = a->mmap_limit;
     }
-    else if ((filelength < APR_MMAP_THRESHOLD) ||
-             (apr_mmap_create(&mm, a->fd, fileoffset, filelength,
-                              APR_MMAP_READ, p) != APR_SUCCESS))
+    else if ((filelength < a->mmap_threshold) ||
+             (file_mmap(&mm, a, fileoffset, filelength, p) != APR_SUCCESS))
     {
         return 0;
     }
@@ -72,12 +120,339 @@ static int file_make_mmap(apr_bucket *e, apr_size_t filelength,
 }
 #endif
 
+/* Ask the system to read ahead the given range of the file */
+static void file_advise(apr_file_t *f, apr_off_t offset, apr_size_t len)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+    apr_os_file_t fd;
+
+    if (apr_os_file_get(&fd, f) == APR_SUCCESS) {
+        (void)posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)f;
+    (void)offset;
+    (void)len;
+#endif
+}
+
+/* The size of the next read of the bucket */
+static apr_size_t file_read_size(apr_bucket_file *a, apr_off_t fileoffset,
+                                 apr_size_t filelength)
+{
+    apr_size_t size = a->read_size;
+
+    if (a->read_ahead) {
+        if (fileoffset != a->read_next) {
+            a->read_cur = a->read_size;
+        }
+        size = a->read_cur;
+    }
+    return (filelength > size) ? size : filelength;
+}
+
+/* Change the bucket to a heap bucket of what was read, followed by
+ * a file bucket for the rest if any.
+ */
+static void file_read_morph(apr_bucket *e, char *buf, apr_size_t len,
+                            void (*free_func)(void *data),
+                            apr_status_t rv)
+{
+    apr_bucket_file *a = e->data;
+    apr_size_t filelength = e->length - len;
+    apr_off_t fileoffset = e->start;
+    apr_bucket *b;
+
+    if (a->read_ahead) {
+        a->read_next = fileoffset + len;
+        if (a->read_cur < a->read_ahead) {
+            a->read_cur = (a->read_cur > a->read_ahead / 2)
+                          ? a->read_ahead
+                          : apr_bucket_alloc_aligned_floor(e->list,
+                                                           a->read_cur * 2);
+        }
+        if (filelength > 0 && rv != APR_EOF) {
+            file_advise(a->fd, a->read_next,
+                        (filelength > a->read_cur) ? a->read_cur
+                                                   : filelength);
+        }
+    }
+    /*
+     * Change the current bucket to refer to what we read,
+     * even if we read nothing because we hit EOF.
+     */
+    apr_bucket_heap_make(e, buf, len, free_func);
+
+    /* If we have more to read from the file, then create another bucket */
+    if (filelength > 0 && rv != APR_EOF) {
+        /* for efficiency, we can just build a new apr_bucket struct
+         * to wrap around the existing file bucket */
+        b = apr_bucket_alloc(sizeof(*b), e->list);
+        b->start  = fileoffset + len;
+        b->length = filelength;
+        b->data   = a;
+        b->type   = &apr_bucket_type_file;
+        b->free   = apr_bucket_free;
+        b->list   = e->list;
+        APR_BUCKET_INSERT_AFTER(e, b);
+    }
+    else {
+        file_bucket_destroy(a);
+    }
+}
+
+#if APR_HAS_THREADS
+struct apr_bucket_file_aio_t {
+    apr_thread_pool_t *tp;
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    void (*notify)(void *baton);
+    void *baton;
+    /* number of reads submitted and not completed (under mutex) */
+    apr_size_t pending;
+};
+
+/* A read in flight, owned by the bucket and the worker thread */
+struct file_aio_req_t {
+    apr_bucket_file_aio_t *aio;
+    apr_file_t *fd;
+#if defined(HAVE_PREAD)
+    apr_os_file_t osfd;
+#endif
+    char *buf;
+    apr_off_t offset;
+    apr_size_t len;
+    apr_status_t status;
+    volatile apr_uint32_t done;
+    volatile apr_uint32_t refs;
+};
+
+static void file_aio_release(file_aio_req_t *req)
+{
+    if (!apr_atomic_dec32(&req->refs)) {
+        free(req->buf);
+        free(req);
+    }
+}
+
+static void * APR_THREAD_FUNC file_aio_task(apr_thread_t *thd, void *data)
+{
+    file_aio_req_t *req = data;
+    apr_bucket_file_aio_t *aio = req->aio;
+    void (*notify)(void *baton) = aio->notify;
+    void *baton = aio->baton;
+    apr_status_t rv;
+
+#if defined(HAVE_PREAD)
+    if (req->osfd >= 0) {
+        apr_ssize_t n;
+
+        do {
+            n = pread(req->osfd, req->buf, req->len, req->offset);
+        } while (n == -1 && errno == EINTR);
+        if (n < 0) {
+            rv = errno;
+            req->len = 0;
+        }
+        else {
+            rv = (n == 0 && req->len) ? APR_EOF : APR_SUCCESS;
+            req->len = n;
+        }
+    }
+    else
+#endif
+    {
+        apr_off_t offset = req->offset;
+
+        rv = apr_file_seek(req->fd, APR_SET, &offset);
+        if (rv == APR_SUCCESS) {
+            rv = apr_file_read(req->fd, req->buf, &req->len);
+        }
+    }
+    req->status = rv;
+
+    apr_thread_mutex_lock(aio->mutex);
+    apr_atomic_set32(&req->done, 1);
+    aio->pending--;
+    apr_thread_cond_broadcast(aio->cond);
+    apr_thread_mutex_unlock(aio->mutex);
+
+    /* aio may be gone now */
+    file_aio_release(req);
+    if (notify) {
+        notify(baton);
+    }
+    return NULL;
+}
+
+static apr_status_t file_aio_cleanup(void *data)
+{
+    apr_bucket_file_aio_t *aio = data;
+
+    /* The requests refer to aio, wait for them */
+    apr_thread_mutex_lock(aio->mutex);
+    while (aio->pending) {
+        apr_thread_cond_wait(aio->cond, aio->mutex);
+    }
+    apr_thread_mutex_unlock(aio->mutex);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_bucket_file_aio_create(
+                                            apr_bucket_file_aio_t **aio,
+                                            apr_thread_pool_t *tp,
+                                            void (*notify)(void *baton),
+                                            void *baton,
+                                            apr_pool_t *p)
+{
+    apr_bucket_file_aio_t *new;
+    apr_status_t rv;
+
+    new = apr_pcalloc(p, sizeof(*new));
+    new->tp = tp;
+    new->notify = notify;
+    new->baton = baton;
+    rv = apr_thread_mutex_create(&new->mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_thread_cond_create(&new->cond, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_pool_cleanup_register(p, new, file_aio_cleanup,
+                              apr_pool_cleanup_null);
+
+    *aio = new;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_bucket_file_set_aio(apr_bucket *e,
+                                                  apr_bucket_file_aio_t *aio)
+{
+    apr_bucket_file *a = e->data;
+
+    a->aio = aio;
+#if APR_HAS_MMAP
+    /* page faults would block too */
+    if (aio) {
+        a->can_mmap = 0;
+    }
+#endif
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t file_aio_submit(apr_bucket *e, apr_size_t len)
+{
+    apr_bucket_file *a = e->data;
+    file_aio_req_t *req;
+    apr_status_t rv;
+
+    req = malloc(sizeof(*req));
+    if (!req) {
+        return APR_ENOMEM;
+    }
+    req->buf = malloc(len ? len : 1);
+    if (!req->buf) {
+        free(req);
+        return APR_ENOMEM;
+    }
+    req->aio = a->aio;
+    req->fd = a->fd;
+#if defined(HAVE_PREAD)
+    req->osfd = -1;
+    if (!(apr_file_flags_get(a->fd) & APR_FOPEN_BUFFERED)) {
+        apr_os_file_get(&req->osfd, a->fd);
+    }
+#endif
+    req->offset = e->start;
+    req->len = len;
+    req->status = APR_SUCCESS;
+    apr_atomic_set32(&req->done, 0);
+    apr_atomic_set32(&req->refs, 2);
+
+    apr_thread_mutex_lock(a->aio->mutex);
+    a->aio->pending++;
+    apr_thread_mutex_unlock(a->aio->mutex);
+
+    rv = apr_thread_pool_push(a->aio->tp, file_aio_task, req,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, a->aio);
+    if (rv != APR_SUCCESS) {
+        apr_thread_mutex_lock(a->aio->mutex);
+        a->aio->pending--;
+        apr_thread_mutex_unlock(a->aio->mutex);
+        free(req->buf);
+        free(req);
+        return rv;
+    }
+    a->aio_req = req;
+
+    return APR_SUCCESS;
+}
+
+/* Read the bucket from the thread pool, returns APR_ENOTIMPL for a
+ * blocking read which did not start there.
+ */
+static apr_status_t file_aio_read(apr_bucket *e, const char **str,
+                                  apr_size_t *len, apr_read_type_e block)
+{
+    apr_bucket_file *a = e->data;
+    file_aio_req_t *req = a->aio_req;
+    char *buf;
+    apr_status_t rv;
+
+    if (req && req->offset != e->start) {
+        /* Started for another bucket of this file, abandon it */
+        a->aio_req = NULL;
+        file_aio_release(req);
+        req = NULL;
+    }
+    if (!req) {
+        if (block == APR_BLOCK_READ) {
+            return APR_ENOTIMPL;
+        }
+        rv = file_aio_submit(e, file_read_size(a, e->start, e->length));
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        return APR_EAGAIN;
+    }
+
+    if (!apr_atomic_read32(&req->done)) {
+        if (block == APR_NONBLOCK_READ) {
+            return APR_EAGAIN;
+        }
+        apr_thread_mutex_lock(a->aio->mutex);
+        while (!apr_atomic_read32(&req->done)) {
+            apr_thread_cond_wait(a->aio->cond, a->aio->mutex);
+        }
+        apr_thread_mutex_unlock(a->aio->mutex);
+    }
+
+    a->aio_req = NULL;
+    rv = req->status;
+    *len = req->len;
+    buf = req->buf;
+    req->buf = NULL;
+    file_aio_release(req);
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        free(buf);
+        return rv;
+    }
+
+    file_read_morph(e, buf, *len, free, rv);
+    *str = buf;
+    return rv;
+}
+#endif /* APR_HAS_THREADS */
+
 static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
                                      apr_size_t *len, apr_read_type_e block)
 {
     apr_bucket_file *a = e->data;
     apr_file_t *f = a->fd;
-    apr_bucket *b = NULL;
     char *buf;
     apr_status_t rv;
     apr_size_t filelength = e->length;  /* bytes remaining in file past offset */
@@ -109,7 +484,17 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
 #endif
 
     *str = NULL;  /* in case we die prematurely */
-    *len = (filelength > a->read_size) ? a->read_size : filelength;
+#if APR_HAS_THREADS
+    if (a->aio) {
+        *len = 0;
+        rv = file_aio_read(e, str, len, block);
+        if (rv != APR_ENOTIMPL) {
+            return rv;
+        }
+    }
+#endif
+
+    *len = file_read_size(a, fileoffset, filelength);
     buf = apr_bucket_alloc(*len, e->list);
 
     /* Handle offset ... */
@@ -119,33 +504,13 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
         return rv;
     }
     rv = apr_file_read(f, buf, len);
+    APR_PROBE3(bucket__read, e, e->type->name, *len);
     if (rv != APR_SUCCESS && rv != APR_EOF) {
         apr_bucket_free(buf);
         return rv;
     }
-    filelength -= *len;
-    /*
-     * Change the current bucket to refer to what we read,
-     * even if we read nothing because we hit EOF.
-     */
-    apr_bucket_heap_make(e, buf, *len, apr_bucket_free);
 
-    /* If we have more to read from the file, then create another bucket */
-    if (filelength > 0 && rv != APR_EOF) {
-        /* for efficiency, we can just build a new apr_bucket struct
-         * to wrap around the existing file bucket */
-        b = apr_bucket_alloc(sizeof(*b), e->list);
-        b->start  = fileoffset + (*len);
-        b->length = filelength;
-        b->data   = a;
-        b->type   = &apr_bucket_type_file;
-        b->free   = apr_bucket_free;
-        b->list   = e->list;
-        APR_BUCKET_INSERT_AFTER(e, b);
-    }
-    else {
-        file_bucket_destroy(a);
-    }
+    file_read_morph(e, buf, *len, apr_bucket_free, rv);
 
     *str = buf;
     return rv;
@@ -162,8 +527,18 @@ APR_DECLARE(apr_bucket *) apr_bucket_file_make(apr_bucket *b, apr_file_t *fd,
     f->readpool = p;
 #if APR_HAS_MMAP
     f->can_mmap = 1;
+    f->mmap_threshold = APR_MMAP_THRESHOLD;
+    f->mmap_limit = APR_MMAP_LIMIT;
+    f->mmap_cache = NULL;
 #endif
     f->read_size = APR_BUCKET_BUFF_SIZE;
+    f->read_ahead = 0;
+    f->read_cur = f->read_size;
+    f->read_next = -1;
+#if APR_HAS_THREADS
+    f->aio = NULL;
+    f->aio_req = NULL;
+#endif
 
     b = apr_bucket_shared_make(b, f, offset, len);
     b->type = &apr_bucket_type_file;
@@ -208,6 +583,61 @@ APR_DECLARE(apr_status_t) apr_bucket_file_set_buf_size(apr_bucket *e,
         apr_size_t floor = apr_bucket_alloc_aligned_floor(e->list, size);
         a->read_size = (size < floor) ? size : floor;
     }
+    if (a->read_ahead && a->read_ahead < a->read_size) {
+        a->read_ahead = a->read_size;
+    }
+    a->read_cur = a->read_size;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_bucket_file_set_mmap_limits(apr_bucket *e,
+                                                          apr_size_t threshold,
+                                                          apr_size_t limit)
+{
+#if APR_HAS_MMAP
+    apr_bucket_file *a = e->data;
+
+    if (!limit) {
+        return APR_EINVAL;
+    }
+    a->mmap_threshold = threshold;
+    a->mmap_limit = limit;
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif /* APR_HAS_MMAP */
+}
+
+APR_DECLARE(apr_status_t) apr_bucket_file_set_mmap_cache(apr_bucket *e,
+                                                         apr_mmap_cache_t *cache)
+{
+#if APR_HAS_MMAP
+    apr_bucket_file *a = e->data;
+
+    a->mmap_cache = cache;
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif /* APR_HAS_MMAP */
+}
+
+APR_DECLARE(apr_status_t) apr_bucket_file_set_read_ahead(apr_bucket *e,
+                                                         apr_size_t max)
+{
+    apr_bucket_file *a = e->data;
+
+    if (!max) {
+        a->read_ahead = 0;
+    }
+    else if (max <= a->read_size) {
+        a->read_ahead = a->read_size;
+    }
+    else {
+        apr_size_t floor = apr_bucket_alloc_aligned_floor(e->list, max);
+        a->read_ahead = (max < floor) ? max : floor;
+    }
+    a->read_cur = a->read_size;
 
     return APR_SUCCESS;
 }
@@ -219,6 +649,8 @@ static apr_status_t file_bucket_setaside(apr_bucket *b, apr_pool_t *reqpool)
     apr_file_t *f = a->fd;
     apr_pool_t *curpool = apr_file_pool_get(f);
 
+    APR_PROBE2(bucket__setaside, b, b->type->name);
+
     if (apr_pool_is_ancestor(curpool, reqpool)) {
         return APR_SUCCESS;
     }
@@ -239,6 +671,10 @@ static apr_status_t file_bucket_setaside(apr_bucket *b, apr_pool_t *reqpool)
         new = apr_bucket_alloc(sizeof(*new), b->list);
         memcpy(new, a, sizeof(*new));
         new->refcount.refcount = 1;
+#if APR_HAS_THREADS
+        /* the read in flight stays with the other buckets */
+        new->aio_req = NULL;
+#endif
 
         a->refcount.refcount--;
         a = b->data = new;
@@ -15,6 +15,7 @@
  */
 
 #include "apr_buckets.h"
+#include "apr_probes.h"
 
 APR_DECLARE_NONSTD(apr_status_t) apr_bucket_simple_copy(apr_bucket *a,
                                                         apr_bucket **b)
@@ -78,16 +79,14 @@ APR_DECLARE(apr_bucket *) apr_bucket_immortal_create(const char *buf,
 }
 
 /*
- * XXX: This function could do with some tweaking to reduce memory
- * usage in various cases, e.g. share buffers in the heap between all
- * the buckets that are set aside, or even spool set-aside data to
- * disk if it gets too voluminous (but if it does then that's probably
- * a bug elsewhere). There should probably be a apr_brigade_setaside()
- * function that co-ordinates the action of all the bucket setaside
- * functions to improve memory efficiency.
+ * The data are copied in a HEAP bucket of their own, apr_brigade_setaside()
+ * shares one between the adjacent TRANSIENT buckets instead.
+ * XXX: set-aside data could be spooled to disk if it gets too voluminous
+ * (but if it does then that's probably a bug elsewhere).
  */
 static apr_status_t transient_bucket_setaside(apr_bucket *b, apr_pool_t *pool)
 {
+    APR_PROBE2(bucket__setaside, b, b->type->name);
     b = apr_bucket_heap_make(b, (char *)b->data + b->start, b->length, NULL);
     if (b == NULL) {
         return APR_ENOMEM;
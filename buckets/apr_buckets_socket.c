@@ -15,6 +15,46 @@
  */
 
 #include "apr_buckets.h"
+#include "apr_probes.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+/* The reads of a SOCKET bucket start at APR_BUCKET_BUFF_SIZE and double
+ * while they fill the buffer, up to a maximum, then halve back when they
+ * use a quarter of it or less.  The bucket keeps the current size and the
+ * maximum (as powers of two of APR_BUCKET_BUFF_SIZE) in its start, which
+ * is -1 for the defaults.
+ */
+#define SOCKET_READ_SHIFT_MAX 16
+
+static int socket_read_max_shift(apr_size_t max)
+{
+    int shift = 0;
+
+    while (shift < SOCKET_READ_SHIFT_MAX
+           && (apr_size_t)APR_BUCKET_BUFF_SIZE << (shift + 1) <= max) {
+        shift++;
+    }
+    return shift;
+}
+
+static void socket_read_state_get(const apr_bucket *b, int *shift,
+                                  int *max_shift)
+{
+    if (b->start < 0) {
+        *shift = 0;
+        *max_shift = socket_read_max_shift(APR_BUCKET_READ_MAX);
+    }
+    else {
+        *shift = (int)(b->start & 0xff);
+        *max_shift = (int)(b->start >> 8);
+    }
+}
+
+static void socket_read_state_set(apr_bucket *b, int shift, int max_shift)
+{
+    b->start = ((apr_off_t)max_shift << 8) | shift;
+}
 
 static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
                                        apr_size_t *len, apr_read_type_e block)
@@ -23,17 +63,23 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
     char *buf;
     apr_status_t rv;
     apr_interval_time_t timeout;
+    apr_size_t size;
+    int shift, max_shift;
 
     if (block == APR_NONBLOCK_READ) {
         apr_socket_timeout_get(p, &timeout);
         apr_socket_timeout_set(p, 0);
     }
 
+    socket_read_state_get(a, &shift, &max_shift);
+    size = (apr_size_t)APR_BUCKET_BUFF_SIZE << shift;
+
     *str = NULL;
-    *len = APR_BUCKET_BUFF_SIZE;
+    *len = size;
     buf = apr_bucket_alloc(*len, a->list); /* XXX: check for failure? */
 
     rv = apr_socket_recv(p, buf, len);
+    APR_PROBE3(bucket__read, a, a->type->name, *len);
 
     if (block == APR_NONBLOCK_READ) {
         apr_socket_timeout_set(p, timeout);
@@ -60,12 +106,36 @@ static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
      */
     if (*len > 0) {
         apr_bucket_heap *h;
+        apr_bucket *b;
+
+        /* Size the next read after this one */
+        b = apr_bucket_socket_create(p, a->list);
+        if (*len == size && shift < max_shift) {
+            socket_read_state_set(b, shift + 1, max_shift);
+        }
+        else if (*len <= size / 4 && shift > 0) {
+            socket_read_state_set(b, shift - 1, max_shift);
+        }
+        else {
+            b->start = a->start;
+        }
+
+        /* Don't hold a large buffer for a little data */
+        if (size > APR_BUCKET_BUFF_SIZE && *len <= APR_BUCKET_BUFF_SIZE) {
+            char *small = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, a->list);
+
+            memcpy(small, buf, *len);
+            apr_bucket_free(buf);
+            buf = small;
+            size = APR_BUCKET_BUFF_SIZE;
+        }
+
         /* Change the current bucket to refer to what we read */
         a = apr_bucket_heap_make(a, buf, *len, apr_bucket_free);
         h = a->data;
-        h->alloc_len = APR_BUCKET_BUFF_SIZE; /* note the real buffer size */
+        h->alloc_len = size; /* note the real buffer size */
         *str = buf;
-        APR_BUCKET_INSERT_AFTER(a, apr_bucket_socket_create(p, a->list));
+        APR_BUCKET_INSERT_AFTER(a, b);
     }
     else {
         apr_bucket_free(buf);
@@ -104,6 +174,18 @@ APR_DECLARE(apr_bucket *) apr_bucket_socket_create(apr_socket_t *p,
     return apr_bucket_socket_make(b, p);
 }
 
+APR_DECLARE(apr_status_t) apr_bucket_socket_set_read_max(apr_bucket *b,
+                                                         apr_size_t max)
+{
+    int shift, max_shift;
+
+    socket_read_state_get(b, &shift, &max_shift);
+    max_shift = socket_read_max_shift(max);
+    socket_read_state_set(b, shift < max_shift ? shift : max_shift, max_shift);
+
+    return APR_SUCCESS;
+}
+
 APR_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_socket = {
     "SOCKET", 5, APR_BUCKET_DATA,
     apr_bucket_destroy_noop,
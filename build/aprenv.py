@@ -623,6 +623,11 @@ class APREnv(Environment):
       subst['@hasprocpthreadser@'] = 1
     else:
       subst['@hasprocpthreadser@'] = 0
+
+    if conf.CheckCHeader('linux/futex.h') and conf.CheckFile('/dev/zero'):
+      subst['@hasfutexser@'] = 1
+    else:
+      subst['@hasfutexser@'] = 0
     
     
     subst['@havemmaptmp@'] = 0
@@ -681,6 +686,7 @@ class APREnv(Environment):
     subst['@apu_have_nss@'] = 0
 
     subst['@have_iconv@'] = 0
+    subst['@have_zlib@'] = 0
     
     self.SubstFile('include/apr.h', 'include/apr.h.in', SUBST_DICT = subst)
     self.SubstFile('include/apu.h', 'include/apu.h.in', SUBST_DICT = subst)
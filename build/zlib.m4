@@ -0,0 +1,57 @@
+dnl -------------------------------------------------------- -*- autoconf -*-
+dnl Licensed to the Apache Software Foundation (ASF) under one or more
+dnl contributor license agreements.  See the NOTICE file distributed with
+dnl this work for additional information regarding copyright ownership.
+dnl The ASF licenses this file to You under the Apache License, Version 2.0
+dnl (the "License"); you may not use this file except in compliance with
+dnl the License.  You may obtain a copy of the License at
+dnl
+dnl     http://www.apache.org/licenses/LICENSE-2.0
+dnl
+dnl Unless required by applicable law or agreed to in writing, software
+dnl distributed under the License is distributed on an "AS IS" BASIS,
+dnl WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+dnl See the License for the specific language governing permissions and
+dnl limitations under the License.
+
+dnl
+dnl APU_FIND_ZLIB: find the zlib library, for the brigade compressors
+dnl
+AC_DEFUN([APU_FIND_ZLIB], [
+
+apu_zlib_dir="unknown"
+want_zlib="1"
+have_zlib="0"
+AC_ARG_WITH(zlib,[  --with-zlib[=DIR]         path to zlib installation],
+  [ apu_zlib_dir="$withval"
+    if test "$apu_zlib_dir" = "no"; then
+      want_zlib="0"
+    elif test "$apu_zlib_dir" != "yes"; then
+      APR_ADDTO(CPPFLAGS,[-I$apu_zlib_dir/include])
+      APR_ADDTO(LDFLAGS,[-L$apu_zlib_dir/lib])
+    fi
+  ])
+
+if test "$want_zlib" = "1"; then
+  AC_CHECK_HEADER(zlib.h, [
+    AC_CHECK_LIB(z, deflateInit2_, [ have_zlib="1" ])
+  ])
+fi
+
+if test "$want_zlib" = "1" -a "$apu_zlib_dir" != "unknown"; then
+  if test "$have_zlib" != "1"; then
+    AC_MSG_ERROR([zlib support requested, but not found])
+  fi
+  if test "$apu_zlib_dir" != "yes"; then
+    APR_REMOVEFROM(CPPFLAGS,[-I$apu_zlib_dir/include])
+    APR_ADDTO(INCLUDES,[-I$apu_zlib_dir/include])
+  fi
+fi
+
+if test "$have_zlib" = "1"; then
+  APR_ADDTO(APRUTIL_EXPORT_LIBS,[-lz])
+  APR_ADDTO(APRUTIL_LIBS,[-lz])
+fi
+
+AC_SUBST(have_zlib)
+])dnl
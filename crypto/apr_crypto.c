@@ -34,6 +34,10 @@
 #include "apr_version.h"
 
 static apr_hash_t *drivers = NULL;
+#if APR_HAVE_MODULAR_DSO
+/* The drivers of the hash, for lookups without the dso mutex */
+static apu_dso_driver_t *volatile loaded = NULL;
+#endif
 
 #define ERROR_SIZE 1024
 
@@ -81,6 +85,9 @@ static apr_status_t apr_crypto_term(void *ptr)
 {
     /* set drivers to NULL so init can work again */
     drivers = NULL;
+#if APR_HAVE_MODULAR_DSO
+    loaded = NULL;
+#endif
 
     /* Everything else we need is handled by cleanups registered
      * when we created mutexes and loaded DSOs
@@ -197,6 +204,11 @@ APR_DECLARE(apr_status_t) apr_crypto_get_driver(
     }
 
 #if APR_HAVE_MODULAR_DSO
+    *driver = apu_dso_driver_get(&loaded, name);
+    if (*driver) {
+        return APR_SUCCESS;
+    }
+
     rv = apu_dso_mutex_lock();
     if (rv) {
         return rv;
@@ -237,6 +249,7 @@ APR_DECLARE(apr_status_t) apr_crypto_get_driver(
         }
         if (rv == APR_SUCCESS) {
             apr_hash_set(drivers, d->name, APR_HASH_KEY_STRING, d);
+            apu_dso_driver_set(&loaded, name, d, rootp);
             *driver = d;
         }
     }
@@ -793,6 +806,61 @@ APR_DECLARE(apr_status_t) apr_crypto_block_cleanup(apr_crypto_block_t *ctx)
     return ctx->provider->block_cleanup(ctx);
 }
 
+/**
+ * @brief Reset an encryption or decryption context to process a new
+ *        message with the same key and direction, but a new IV.
+ * @param ctx The block context to reset.
+ * @param iv The new initialisation vector, or NULL if the mode has none.
+ * @return APR_ENOIV if an initialisation vector is required but not specified.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_block_reset(apr_crypto_block_t *ctx,
+        const unsigned char *iv)
+{
+    return ctx->provider->block_reset(ctx, iv);
+}
+
+/**
+ * @brief Encrypt and authenticate a message in one call.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_aead_seal(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    return key->provider->aead_seal(ctx, out, outlen, in, inlen, aad, aadlen,
+            iv, key, p);
+}
+
+/**
+ * @brief Verify and decrypt a message in one call.
+ * @return APR_ENOVERIFY if the message does not authenticate.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_aead_open(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    return key->provider->aead_open(ctx, out, outlen, in, inlen, aad, aadlen,
+            iv, key, p);
+}
+
+/**
+ * @brief One shot HMAC or CMAC of a single memory buffer.
+ * @return APR_ENOSPACE if out is too small for the MAC.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_hmac(const apr_crypto_key_t *key,
+        const unsigned char *in, apr_size_t inlen,
+        unsigned char *out, apr_size_t *outlen)
+{
+    return key->provider->hmac(key, in, inlen, out, outlen);
+}
+
 /**
  * @brief Clean sign / verify context.
  * @note After cleanup, a context is free to be reused if necessary.
@@ -0,0 +1,426 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apu.h"
+#include "apr_pools.h"
+#include "apr_buckets.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if APU_HAVE_CRYPTO
+
+#include "apr_crypto.h"
+
+/* Room kept in the output buffer of the block keys for what a call may
+ * produce besides its input (a held back or padding block) */
+#define BLOCK_SLACK 32
+
+/* Bounds the chunks, and so the working buffer, of the AEAD framing */
+#define CHUNK_MAX (1U << 30)
+
+struct apr_crypto_brigade_t {
+    apr_pool_t *pool;
+    apr_bucket_alloc_t *list;
+    const apr_crypto_key_t *key;
+    apr_crypto_block_t *block;
+    apr_uint32_t flags;
+    /* The plaintext size of the AEAD chunks */
+    apr_size_t chunk;
+    /* The IV of the AEAD stream, and the index of its next chunk */
+    unsigned char iv[APR_CRYPTO_AEAD_IVSIZE];
+    apr_uint64_t seq;
+    /* The working buffer: the output being filled for the block keys,
+     * the chunk being gathered for the AEAD framing */
+    unsigned char *buf;
+    apr_size_t len;
+    /* Whether the stream ended with an EOS, until reset */
+    unsigned int ended:1;
+};
+
+#define CRYPTO_IS_DECRYPT(ctx) ((ctx)->flags & APR_CRYPTO_BRIGADE_DECRYPT)
+#define CRYPTO_IS_AEAD(ctx) ((ctx)->flags & APR_CRYPTO_BRIGADE_AEAD)
+
+/* The size of a whole chunk of the AEAD stream */
+#define CHUNK_SIZE(ctx) ((ctx)->chunk + \
+        (CRYPTO_IS_DECRYPT(ctx) ? APR_CRYPTO_AEAD_TAGSIZE : 0))
+
+static apr_status_t brigade_cleanup(void *data)
+{
+    apr_crypto_brigade_t *ctx = data;
+
+    if (ctx->buf) {
+        /* The AEAD chunks are kept, plaintext included */
+        if (CRYPTO_IS_AEAD(ctx)) {
+            apr_crypto_memzero(ctx->buf, CHUNK_SIZE(ctx));
+        }
+        apr_bucket_free(ctx->buf);
+        ctx->buf = NULL;
+    }
+    ctx->len = 0;
+
+    return APR_SUCCESS;
+}
+
+/* Pass the output of the block keys produced so far to the brigade, as a
+ * HEAP bucket owning the buffer */
+static void block_emit(apr_crypto_brigade_t *ctx, apr_bucket_brigade *out)
+{
+    if (ctx->buf) {
+        if (ctx->len) {
+            APR_BRIGADE_INSERT_TAIL(out,
+                    apr_bucket_heap_create((char *)ctx->buf, ctx->len,
+                                           apr_bucket_free, ctx->list));
+        }
+        else {
+            apr_bucket_free(ctx->buf);
+        }
+        ctx->buf = NULL;
+        ctx->len = 0;
+    }
+}
+
+static apr_status_t block_feed(apr_crypto_brigade_t *ctx,
+                               apr_bucket_brigade *out,
+                               const unsigned char *data, apr_size_t len)
+{
+    apr_status_t rv;
+
+    while (len) {
+        unsigned char *o;
+        apr_size_t n, olen;
+
+        if (!ctx->buf) {
+            ctx->buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ctx->list);
+            if (!ctx->buf) {
+                return APR_ENOMEM;
+            }
+        }
+        n = APR_BUCKET_BUFF_SIZE - ctx->len;
+        if (n < 2 * BLOCK_SLACK) {
+            block_emit(ctx, out);
+            continue;
+        }
+        n -= BLOCK_SLACK;
+        if (n > len) {
+            n = len;
+        }
+
+        o = ctx->buf + ctx->len;
+        olen = 0;
+        if (CRYPTO_IS_DECRYPT(ctx)) {
+            rv = apr_crypto_block_decrypt(&o, &olen, data, n, ctx->block);
+        }
+        else {
+            rv = apr_crypto_block_encrypt(&o, &olen, data, n, ctx->block);
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        ctx->len += olen;
+
+        data += n;
+        len -= n;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t block_finish(apr_crypto_brigade_t *ctx,
+                                 apr_bucket_brigade *out)
+{
+    apr_size_t olen = 0;
+    apr_status_t rv;
+
+    if (!ctx->buf || APR_BUCKET_BUFF_SIZE - ctx->len < BLOCK_SLACK) {
+        block_emit(ctx, out);
+        ctx->buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, ctx->list);
+        if (!ctx->buf) {
+            return APR_ENOMEM;
+        }
+    }
+
+    if (CRYPTO_IS_DECRYPT(ctx)) {
+        rv = apr_crypto_block_decrypt_finish(ctx->buf + ctx->len, &olen,
+                                             ctx->block);
+    }
+    else {
+        rv = apr_crypto_block_encrypt_finish(ctx->buf + ctx->len, &olen,
+                                             ctx->block);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    ctx->len += olen;
+    block_emit(ctx, out);
+
+    return APR_SUCCESS;
+}
+
+/* Seal (or open) a chunk of the AEAD stream to a new HEAP bucket, with the
+ * IV xor'ed with its index, and whether it's the last one as AAD */
+static apr_status_t aead_chunk(apr_crypto_brigade_t *ctx,
+                               apr_bucket_brigade *out,
+                               const unsigned char *data, apr_size_t len,
+                               int last)
+{
+    unsigned char nonce[APR_CRYPTO_AEAD_IVSIZE];
+    unsigned char aad = last ? 1 : 0;
+    unsigned char *o;
+    apr_size_t olen;
+    apr_uint64_t seq = ctx->seq;
+    apr_status_t rv;
+    int i;
+
+    memcpy(nonce, ctx->iv, sizeof(nonce));
+    for (i = sizeof(nonce) - 1; seq; --i, seq >>= 8) {
+        nonce[i] ^= (unsigned char)seq;
+    }
+
+    if (CRYPTO_IS_DECRYPT(ctx)) {
+        olen = len - APR_CRYPTO_AEAD_TAGSIZE;
+    }
+    else {
+        olen = len + APR_CRYPTO_AEAD_TAGSIZE;
+    }
+    o = apr_bucket_alloc(olen ? olen : 1, ctx->list);
+    if (!o) {
+        return APR_ENOMEM;
+    }
+
+    if (CRYPTO_IS_DECRYPT(ctx)) {
+        rv = apr_crypto_aead_open(&ctx->block, o, &olen, data, len,
+                                  &aad, 1, nonce, ctx->key, ctx->pool);
+    }
+    else {
+        rv = apr_crypto_aead_seal(&ctx->block, o, &olen, data, len,
+                                  &aad, 1, nonce, ctx->key, ctx->pool);
+    }
+    if (rv != APR_SUCCESS || !olen) {
+        apr_bucket_free(o);
+    }
+    else {
+        APR_BRIGADE_INSERT_TAIL(out,
+                apr_bucket_heap_create((char *)o, olen, apr_bucket_free,
+                                       ctx->list));
+    }
+    if (rv == APR_SUCCESS) {
+        ctx->seq++;
+    }
+
+    return rv;
+}
+
+/* Cut the data in whole chunks, the last one of the stream being shorter
+ * (possibly empty), so that a whole chunk is never the last one and can
+ * go without waiting for more */
+static apr_status_t aead_feed(apr_crypto_brigade_t *ctx,
+                              apr_bucket_brigade *out,
+                              const unsigned char *data, apr_size_t len)
+{
+    apr_size_t size = CHUNK_SIZE(ctx);
+    apr_status_t rv;
+
+    while (len) {
+        apr_size_t n;
+
+        /* Whole chunks straight from the input */
+        if (!ctx->len && len >= size) {
+            rv = aead_chunk(ctx, out, data, size, 0);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            data += size;
+            len -= size;
+            continue;
+        }
+
+        if (!ctx->buf) {
+            ctx->buf = apr_bucket_alloc(size, ctx->list);
+            if (!ctx->buf) {
+                return APR_ENOMEM;
+            }
+        }
+        n = size - ctx->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->buf + ctx->len, data, n);
+        ctx->len += n;
+        data += n;
+        len -= n;
+
+        if (ctx->len == size) {
+            ctx->len = 0;
+            rv = aead_chunk(ctx, out, ctx->buf, size, 0);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t aead_finish(apr_crypto_brigade_t *ctx,
+                                apr_bucket_brigade *out)
+{
+    apr_size_t len = ctx->len;
+
+    if (CRYPTO_IS_DECRYPT(ctx) && len < APR_CRYPTO_AEAD_TAGSIZE) {
+        /* Truncated stream, the last chunk is missing */
+        return APR_INCOMPLETE;
+    }
+
+    ctx->len = 0;
+    return aead_chunk(ctx, out, ctx->buf, len, 1);
+}
+
+APR_DECLARE(apr_status_t) apr_crypto_brigade_create(apr_crypto_brigade_t **ctx,
+        const apr_crypto_key_t *key, const unsigned char *iv,
+        apr_size_t chunk, apr_uint32_t flags, apr_bucket_alloc_t *list,
+        apr_pool_t *p)
+{
+    apr_crypto_brigade_t *c;
+    apr_status_t rv;
+
+    *ctx = NULL;
+
+    if (flags & ~(APR_CRYPTO_BRIGADE_DECRYPT | APR_CRYPTO_BRIGADE_AEAD)) {
+        return APR_EINVAL;
+    }
+
+    c = apr_pcalloc(p, sizeof(*c));
+    c->pool = p;
+    c->list = list;
+    c->key = key;
+    c->flags = flags;
+
+    if (CRYPTO_IS_AEAD(c)) {
+        if (!chunk) {
+            chunk = APR_CRYPTO_BRIGADE_CHUNK_DEFAULT;
+        }
+        else if (chunk > CHUNK_MAX) {
+            return APR_EINVAL;
+        }
+        if (!iv) {
+            return APR_ENOIV;
+        }
+        c->chunk = chunk;
+        memcpy(c->iv, iv, sizeof(c->iv));
+    }
+    else {
+        apr_size_t bsize;
+
+        if (CRYPTO_IS_DECRYPT(c)) {
+            rv = apr_crypto_block_decrypt_init(&c->block, &bsize, iv, key, p);
+        }
+        else {
+            /* no IV made up here, it would be lost */
+            rv = apr_crypto_block_encrypt_init(&c->block, iv ? &iv : NULL,
+                                               key, &bsize, p);
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    apr_pool_cleanup_register(p, c, brigade_cleanup, apr_pool_cleanup_null);
+
+    *ctx = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_crypto_brigade_reset(apr_crypto_brigade_t *ctx,
+        const unsigned char *iv)
+{
+    ctx->len = 0;
+    ctx->seq = 0;
+    ctx->ended = 0;
+
+    if (CRYPTO_IS_AEAD(ctx)) {
+        if (!iv) {
+            return APR_ENOIV;
+        }
+        memcpy(ctx->iv, iv, sizeof(ctx->iv));
+        return APR_SUCCESS;
+    }
+
+    if (ctx->buf) {
+        apr_bucket_free(ctx->buf);
+        ctx->buf = NULL;
+    }
+    return apr_crypto_block_reset(ctx->block, iv);
+}
+
+APR_DECLARE(apr_status_t) apr_crypto_brigade_process(apr_crypto_brigade_t *ctx,
+        apr_bucket_brigade *out, apr_bucket_brigade *in,
+        apr_read_type_e block)
+{
+    apr_status_t rv;
+
+    while (!APR_BRIGADE_EMPTY(in)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(in);
+        const char *data;
+        apr_size_t len;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            if (APR_BUCKET_IS_EOS(e) && !ctx->ended) {
+                if (CRYPTO_IS_AEAD(ctx)) {
+                    rv = aead_finish(ctx, out);
+                }
+                else {
+                    rv = block_finish(ctx, out);
+                }
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+                /* The IV must not be used again */
+                ctx->ended = 1;
+            }
+            else if (!CRYPTO_IS_AEAD(ctx)) {
+                /* Keep the order of what's been produced already */
+                block_emit(ctx, out);
+            }
+
+            APR_BUCKET_REMOVE(e);
+            APR_BRIGADE_INSERT_TAIL(out, e);
+            continue;
+        }
+
+        rv = apr_bucket_read(e, &data, &len, block);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (len) {
+            if (ctx->ended) {
+                return APR_EINVAL;
+            }
+            if (CRYPTO_IS_AEAD(ctx)) {
+                rv = aead_feed(ctx, out, (const unsigned char *)data, len);
+            }
+            else {
+                rv = block_feed(ctx, out, (const unsigned char *)data, len);
+            }
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        apr_bucket_delete(e);
+    }
+
+    return APR_SUCCESS;
+}
+
+#endif /* APU_HAVE_CRYPTO */
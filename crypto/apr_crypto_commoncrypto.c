@@ -62,6 +62,7 @@ struct apr_crypto_key_t
     int keyLen;
     int ivSize;
     CCHmacAlgorithm hmac;
+    CCHmacContext hmacCtx;
     apr_size_t blockSize;
     apr_size_t digestSize;
 };
@@ -333,6 +334,11 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
     /* handle padding */
     key->options = doPad ? kCCOptionPKCS7Padding : 0;
 
+    /* the authenticated modes are not supported by this driver */
+    if (APR_MODE_GCM == mode || APR_MODE_POLY1305 == mode) {
+        return APR_ENOCIPHER;
+    }
+
     /* determine the algorithm to be used */
     switch (type) {
 
@@ -595,6 +601,10 @@ static apr_status_t crypto_key(apr_crypto_key_t **k,
             return APR_ENODIGEST;
         }
 
+        /* key the HMAC once, the digests start from a copy of it */
+        CCHmacInit(&key->hmacCtx, key->hmac, rec->k.hmac.secret,
+                rec->k.hmac.secretLen);
+
         break;
     }
 
@@ -1211,13 +1221,14 @@ static apr_status_t crypto_digest_init(apr_crypto_digest_t **ctx,
     }
     case APR_CRYPTO_KTYPE_HMAC: {
 
-        digest->hmac = apr_pcalloc(p, sizeof(CCHmacContext));
         if (!digest->hmac) {
-            return APR_ENOMEM;
+            digest->hmac = apr_palloc(p, sizeof(CCHmacContext));
+            if (!digest->hmac) {
+                return APR_ENOMEM;
+            }
         }
 
-        CCHmacInit(digest->hmac, key->hmac, key->rec->k.hmac.secret,
-                key->rec->k.hmac.secretLen);
+        memcpy(digest->hmac, &key->hmacCtx, sizeof(CCHmacContext));
 
         break;
     }
@@ -1452,6 +1463,71 @@ static apr_status_t cprng_stream_ctx_bytes(cprng_stream_ctx_t **pctx,
     return APR_ENOTIMPL;
 }
 
+/**
+ * @brief Reset an encryption or decryption context with a new IV.
+ * @return APR_ENOTIMPL, not supported by this driver.
+ */
+static apr_status_t crypto_block_reset(apr_crypto_block_t *block,
+        const unsigned char *iv)
+{
+    return APR_ENOTIMPL;
+}
+
+/**
+ * @brief Encrypt and authenticate a message in one call.
+ * @return APR_ENOTIMPL, not supported by this driver.
+ */
+static apr_status_t crypto_aead_seal(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
+/**
+ * @brief Verify and decrypt a message in one call.
+ * @return APR_ENOTIMPL, not supported by this driver.
+ */
+static apr_status_t crypto_aead_open(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
+static apr_status_t crypto_hmac(const apr_crypto_key_t *key,
+        const unsigned char *in, apr_size_t inlen,
+        unsigned char *out, apr_size_t *outlen)
+{
+    CCHmacContext ctx;
+
+    switch (key->rec->ktype) {
+    case APR_CRYPTO_KTYPE_HMAC:
+        break;
+    case APR_CRYPTO_KTYPE_CMAC:
+        return APR_ENOTIMPL;
+    default:
+        return APR_EINVAL;
+    }
+
+    if (!out || *outlen < key->digestSize) {
+        *outlen = key->digestSize;
+        return out ? APR_ENOSPACE : APR_SUCCESS;
+    }
+
+    memcpy(&ctx, &key->hmacCtx, sizeof(CCHmacContext));
+    CCHmacUpdate(&ctx, in, inlen);
+    CCHmacFinal(&ctx, out);
+    apr_crypto_memzero(&ctx, sizeof(CCHmacContext));
+    *outlen = key->digestSize;
+
+    return APR_SUCCESS;
+}
+
 /**
  * OSX Common Crypto module.
  */
@@ -1466,7 +1542,9 @@ APR_MODULE_DECLARE_DATA const apr_crypto_driver_t apr_crypto_commoncrypto_driver
         crypto_digest_init, crypto_digest_update, crypto_digest_final,
         crypto_digest, crypto_block_cleanup, crypto_digest_cleanup,
         crypto_cleanup, crypto_shutdown, crypto_error, crypto_key,
-        cprng_stream_ctx_make, cprng_stream_ctx_free, cprng_stream_ctx_bytes
+        cprng_stream_ctx_make, cprng_stream_ctx_free, cprng_stream_ctx_bytes,
+        crypto_block_reset, crypto_aead_seal, crypto_aead_open,
+        crypto_hmac
 };
 
 #endif
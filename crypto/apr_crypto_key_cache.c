@@ -0,0 +1,424 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apu.h"
+#include "apr_private.h"
+#include "apr_general.h"
+#include "apr_pools.h"
+#include "apr_hash.h"
+#include "apr_ring.h"
+#include "apr_thread_mutex.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if APU_HAVE_CRYPTO
+
+#include "apr_crypto.h"
+
+#if APR_HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && (defined(MAP_ANONYMOUS) || defined(MAP_ANON))
+#define CACHE_USE_MLOCK 1
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#else
+#define CACHE_USE_MLOCK 0
+#endif
+
+/* The tags of the entries are HMAC-SHA256, keyed with a secret as long */
+#define CACHE_TAG_SIZE 32
+
+/* The largest key derived, for AES-256 and ChaCha20 */
+#define CACHE_KEY_SIZE 32
+
+/* The output of a PBKDF2 round, HMAC-SHA1 */
+#define PBKDF2_SIZE 20
+
+/* Room on the stack for the input of the tags, allocated beyond */
+#define TAG_INPUT_SIZE 256
+
+typedef struct cache_entry_t cache_entry_t;
+struct cache_entry_t {
+    APR_RING_ENTRY(cache_entry_t) link;
+    unsigned char tag[CACHE_TAG_SIZE];
+    unsigned char key[CACHE_KEY_SIZE];
+};
+
+/* What is kept in the locked memory: the secret of the tags, then the
+ * entries */
+typedef struct cache_locked_t {
+    unsigned char secret[CACHE_TAG_SIZE];
+    cache_entry_t entries[1];
+} cache_locked_t;
+
+struct apr_crypto_key_cache_t {
+    apr_pool_t *pool;
+    const apr_crypto_t *f;
+    apr_crypto_key_t *tagKey;
+    cache_locked_t *locked;
+    apr_size_t size;
+    apr_size_t max;
+    apr_size_t count;
+    /* The entries by tag, and from the most to the least recently used */
+    apr_hash_t *index;
+    APR_RING_HEAD(cache_lru_t, cache_entry_t) lru;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+};
+
+static APR_INLINE void cache_lock(apr_crypto_key_cache_t *cache)
+{
+#if APR_HAS_THREADS
+    if (cache->lock) {
+        apr_thread_mutex_lock(cache->lock);
+    }
+#endif
+}
+
+static APR_INLINE void cache_unlock(apr_crypto_key_cache_t *cache)
+{
+#if APR_HAS_THREADS
+    if (cache->lock) {
+        apr_thread_mutex_unlock(cache->lock);
+    }
+#endif
+}
+
+static apr_status_t cache_cleanup(void *data)
+{
+    apr_crypto_key_cache_t *cache = data;
+
+    if (cache->locked) {
+        apr_crypto_memzero(cache->locked, cache->size);
+#if CACHE_USE_MLOCK
+        munlock(cache->locked, cache->size);
+        munmap(cache->locked, cache->size);
+#endif
+        cache->locked = NULL;
+    }
+
+    return APR_SUCCESS;
+}
+
+/* The length of the key of a cipher, zero if unknown */
+static apr_size_t cache_key_len(apr_crypto_block_key_type_e type)
+{
+    switch (type) {
+    case APR_KEY_AES_128:
+        return 16;
+    case APR_KEY_3DES_192:
+    case APR_KEY_AES_192:
+        return 24;
+    case APR_KEY_AES_256:
+    case APR_KEY_CHACHA20:
+        return 32;
+    default:
+        return 0;
+    }
+}
+
+static unsigned char *cache_put_be(unsigned char *buf, apr_uint64_t v,
+                                   int n)
+{
+    int i;
+
+    for (i = n; i--; v >>= 8) {
+        buf[i] = (unsigned char)v;
+    }
+    return buf + n;
+}
+
+/* The tag of a passphrase record: the lengths are part of the input, so
+ * that no two records give the same one */
+static apr_status_t cache_tag(apr_crypto_key_cache_t *cache,
+        const apr_crypto_key_rec_t *rec, unsigned char *tag, apr_pool_t *p)
+{
+    unsigned char stack[TAG_INPUT_SIZE], *buf = stack, *b;
+    apr_size_t passLen = rec->k.passphrase.passLen;
+    apr_size_t saltLen = rec->k.passphrase.saltLen;
+    apr_size_t len = 4 + 4 + 8 + passLen + 8 + saltLen;
+    apr_size_t taglen = CACHE_TAG_SIZE;
+    apr_status_t rv;
+
+    if (len > sizeof(stack)) {
+        buf = apr_palloc(p, len);
+    }
+
+    b = cache_put_be(buf, rec->type, 4);
+    b = cache_put_be(b, rec->k.passphrase.iterations, 4);
+    b = cache_put_be(b, passLen, 8);
+    memcpy(b, rec->k.passphrase.pass, passLen);
+    b = cache_put_be(b + passLen, saltLen, 8);
+    memcpy(b, rec->k.passphrase.salt, saltLen);
+
+    rv = apr_crypto_hmac(cache->tagKey, buf, len, tag, &taglen);
+    apr_crypto_memzero(buf, len);
+
+    return rv;
+}
+
+/* PBKDF2 with HMAC-SHA1 (RFC 8018), as the drivers derive the keys of
+ * passphrases. The HMAC key of the passphrase is computed once, and each
+ * round is a one shot MAC from it. */
+static apr_status_t cache_pbkdf2(apr_crypto_key_cache_t *cache,
+        const apr_crypto_key_rec_t *rec, unsigned char *out,
+        apr_size_t outlen, apr_pool_t *p)
+{
+    apr_crypto_key_rec_t *hrec;
+    apr_crypto_key_t *hkey = NULL;
+    unsigned char u[PBKDF2_SIZE], t[PBKDF2_SIZE], *block;
+    apr_size_t saltLen = rec->k.passphrase.saltLen, len, n;
+    apr_uint32_t i;
+    apr_pool_t *tp;
+    apr_status_t rv;
+    int j, k;
+
+    rv = apr_pool_create(&tp, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    hrec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_HMAC, tp);
+    hrec->k.hmac.digest = APR_CRYPTO_DIGEST_SHA1;
+    hrec->k.hmac.secret = (const unsigned char *)rec->k.passphrase.pass;
+    hrec->k.hmac.secretLen = rec->k.passphrase.passLen;
+    rv = apr_crypto_key(&hkey, hrec, cache->f, tp);
+
+    block = apr_palloc(tp, saltLen + 4);
+    memcpy(block, rec->k.passphrase.salt, saltLen);
+
+    for (i = 1; rv == APR_SUCCESS && outlen; i++) {
+        cache_put_be(block + saltLen, i, 4);
+        len = sizeof(u);
+        rv = apr_crypto_hmac(hkey, block, saltLen + 4, u, &len);
+        memcpy(t, u, sizeof(t));
+        for (j = 1; rv == APR_SUCCESS && j < rec->k.passphrase.iterations;
+             j++) {
+            len = sizeof(u);
+            rv = apr_crypto_hmac(hkey, u, sizeof(u), u, &len);
+            for (k = 0; k < PBKDF2_SIZE; k++) {
+                t[k] ^= u[k];
+            }
+        }
+
+        n = outlen < sizeof(t) ? outlen : sizeof(t);
+        memcpy(out, t, n);
+        out += n;
+        outlen -= n;
+    }
+
+    apr_crypto_memzero(u, sizeof(u));
+    apr_crypto_memzero(t, sizeof(t));
+    apr_pool_destroy(tp);
+
+    return rv;
+}
+
+/* Add a key, in place of the least recently used one if the cache is
+ * full; called locked */
+static void cache_insert(apr_crypto_key_cache_t *cache,
+        const unsigned char *tag, const unsigned char *key, apr_size_t len)
+{
+    cache_entry_t *e;
+
+    if (cache->count < cache->max) {
+        e = &cache->locked->entries[cache->count++];
+    }
+    else {
+        e = APR_RING_LAST(&cache->lru);
+        APR_RING_REMOVE(e, link);
+        apr_hash_set(cache->index, e->tag, CACHE_TAG_SIZE, NULL);
+        apr_crypto_memzero(e->tag, CACHE_TAG_SIZE);
+        apr_crypto_memzero(e->key, CACHE_KEY_SIZE);
+    }
+
+    memcpy(e->tag, tag, CACHE_TAG_SIZE);
+    memcpy(e->key, key, len);
+    APR_RING_INSERT_HEAD(&cache->lru, e, cache_entry_t, link);
+    apr_hash_set(cache->index, e->tag, CACHE_TAG_SIZE, e);
+}
+
+APR_DECLARE(apr_status_t) apr_crypto_key_cache_create(
+        apr_crypto_key_cache_t **cache, apr_size_t max,
+        const apr_crypto_t *f, apr_pool_t *p)
+{
+    apr_crypto_key_cache_t *c;
+    apr_crypto_key_rec_t *rec;
+    apr_size_t len;
+    apr_status_t rv;
+
+    if (!max) {
+        return APR_EINVAL;
+    }
+
+    c = apr_pcalloc(p, sizeof(*c));
+    c->pool = p;
+    c->f = f;
+    c->max = max;
+    c->size = APR_OFFSETOF(cache_locked_t, entries)
+              + max * sizeof(cache_entry_t);
+
+#if CACHE_USE_MLOCK
+    {
+        void *mem;
+#if defined(_SC_PAGESIZE)
+        apr_size_t pagesize = (apr_size_t)sysconf(_SC_PAGESIZE);
+#else
+        apr_size_t pagesize = 4096;
+#endif
+
+        c->size = APR_ALIGN(c->size, pagesize);
+        mem = mmap(NULL, c->size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return errno;
+        }
+        if (mlock(mem, c->size) != 0) {
+            rv = errno;
+            munmap(mem, c->size);
+            return rv;
+        }
+#if defined(HAVE_MADVISE) && defined(MADV_DONTDUMP)
+        madvise(mem, c->size, MADV_DONTDUMP);
+#endif
+        c->locked = mem;
+    }
+#else
+    c->locked = apr_pcalloc(p, c->size);
+#endif
+    apr_pool_cleanup_register(p, c, cache_cleanup, apr_pool_cleanup_null);
+
+    rv = apr_generate_random_bytes(c->locked->secret, CACHE_TAG_SIZE);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_HMAC, p);
+    rec->k.hmac.digest = APR_CRYPTO_DIGEST_SHA256;
+    rec->k.hmac.secret = c->locked->secret;
+    rec->k.hmac.secretLen = CACHE_TAG_SIZE;
+    rv = apr_crypto_key(&c->tagKey, rec, f, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* the driver must have apr_crypto_hmac() */
+    rv = apr_crypto_hmac(c->tagKey, NULL, 0, NULL, &len);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    c->index = apr_hash_make(p);
+    APR_RING_INIT(&c->lru, cache_entry_t, link);
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_create(&c->lock, APR_THREAD_MUTEX_DEFAULT, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#endif
+
+    *cache = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_crypto_key_cached(apr_crypto_key_t **key,
+        const apr_crypto_key_rec_t *rec, apr_crypto_key_cache_t *cache,
+        apr_pool_t *p)
+{
+    apr_crypto_key_rec_t *srec;
+    cache_entry_t *e;
+    unsigned char tag[CACHE_TAG_SIZE], *secret;
+    apr_size_t len;
+    apr_status_t rv;
+
+    /* what the driver is left to derive, or to report */
+    len = cache_key_len(rec->type);
+    if (*key || rec->ktype != APR_CRYPTO_KTYPE_PASSPHRASE || !len
+            || !rec->k.passphrase.pass || !rec->k.passphrase.passLen
+            || rec->k.passphrase.iterations < 1) {
+        return apr_crypto_key(key, rec, cache->f, p);
+    }
+
+    rv = cache_tag(cache, rec, tag, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    secret = apr_palloc(p, len);
+    apr_crypto_clear(p, secret, len);
+
+    cache_lock(cache);
+    e = apr_hash_get(cache->index, tag, CACHE_TAG_SIZE);
+    if (e) {
+        memcpy(secret, e->key, len);
+        APR_RING_REMOVE(e, link);
+        APR_RING_INSERT_HEAD(&cache->lru, e, cache_entry_t, link);
+    }
+    cache_unlock(cache);
+
+    /* derived unlocked, another thread may have added the same key
+     * meanwhile */
+    if (!e) {
+        rv = cache_pbkdf2(cache, rec, secret, len, p);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        cache_lock(cache);
+        if (!apr_hash_get(cache->index, tag, CACHE_TAG_SIZE)) {
+            cache_insert(cache, tag, secret, len);
+        }
+        cache_unlock(cache);
+    }
+    apr_crypto_memzero(tag, sizeof(tag));
+
+    srec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_SECRET, p);
+    srec->type = rec->type;
+    srec->mode = rec->mode;
+    srec->pad = rec->pad;
+    srec->k.secret.secret = secret;
+    srec->k.secret.secretLen = len;
+
+    return apr_crypto_key(key, srec, cache->f, p);
+}
+
+APR_DECLARE(void) apr_crypto_key_cache_clear(apr_crypto_key_cache_t *cache)
+{
+    apr_size_t i;
+
+    cache_lock(cache);
+    for (i = 0; i < cache->count; i++) {
+        cache_entry_t *e = &cache->locked->entries[i];
+        apr_crypto_memzero(e->tag, CACHE_TAG_SIZE);
+        apr_crypto_memzero(e->key, CACHE_KEY_SIZE);
+    }
+    cache->count = 0;
+    apr_hash_clear(cache->index);
+    APR_RING_INIT(&cache->lru, cache_entry_t, link);
+    cache_unlock(cache);
+}
+
+#endif /* APU_HAVE_CRYPTO */
@@ -70,8 +70,11 @@ struct apr_crypto_key_t {
     SECOidTag cipherOid;
     SECOidTag hashAlg;
     PK11SymKey *symKey;
+    PK11Context *hmacCtx;
+    SECItem *hmacParam;
     int ivSize;
     int keyLength;
+    unsigned int macLength;
 };
 
 struct apr_crypto_block_t {
@@ -319,6 +322,14 @@ static apr_status_t crypto_digest_cleanup_helper(void *data)
 static apr_status_t crypto_key_cleanup(void *data)
 {
     apr_crypto_key_t *key = data;
+    if (key->hmacCtx) {
+        PK11_DestroyContext(key->hmacCtx, PR_TRUE);
+        key->hmacCtx = NULL;
+    }
+    if (key->hmacParam) {
+        SECITEM_FreeItem(key->hmacParam, PR_TRUE);
+        key->hmacParam = NULL;
+    }
     if (key->symKey) {
         PK11_FreeSymKey(key->symKey);
         key->symKey = NULL;
@@ -465,6 +476,11 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
         const apr_crypto_block_key_mode_e mode, const int doPad)
 {
 
+    /* the authenticated modes are not supported by this driver */
+    if (APR_MODE_GCM == mode || APR_MODE_POLY1305 == mode) {
+        return APR_ENOCIPHER;
+    }
+
     /* decide on what cipher mechanism we will be using */
     switch (type) {
 
@@ -758,21 +774,27 @@ static apr_status_t crypto_key(apr_crypto_key_t **k,
         switch (rec->k.hmac.digest) {
         case APR_CRYPTO_DIGEST_MD5:
             key->hashMech = CKM_MD5_HMAC;
+            key->macLength = 16;
             break;
         case APR_CRYPTO_DIGEST_SHA1:
             key->hashMech = CKM_SHA_1_HMAC;
+            key->macLength = 20;
             break;
         case APR_CRYPTO_DIGEST_SHA224:
             key->hashMech = CKM_SHA224_HMAC;
+            key->macLength = 28;
             break;
         case APR_CRYPTO_DIGEST_SHA256:
             key->hashMech = CKM_SHA256_HMAC;
+            key->macLength = 32;
             break;
         case APR_CRYPTO_DIGEST_SHA384:
             key->hashMech = CKM_SHA384_HMAC;
+            key->macLength = 48;
             break;
         case APR_CRYPTO_DIGEST_SHA512:
             key->hashMech = CKM_SHA512_HMAC;
+            key->macLength = 64;
             break;
         default:
             return APR_ENODIGEST;
@@ -799,6 +821,23 @@ static apr_status_t crypto_key(apr_crypto_key_t **k,
                 }
             }
 
+            /* key the HMAC once, the digests start from a clone of it */
+            else {
+                key->hmacParam = PK11_GenerateNewParam(key->cipherMech,
+                        key->symKey);
+                key->hmacCtx = PK11_CreateContextBySymKey(key->hashMech,
+                        CKA_SIGN, key->symKey, key->hmacParam);
+                if (!key->hmacCtx
+                        || PK11_DigestBegin(key->hmacCtx) != SECSuccess) {
+                    PRErrorCode perr = PORT_GetError();
+                    if (perr) {
+                        f->result->rc = perr;
+                        f->result->msg = PR_ErrorToName(perr);
+                    }
+                    rv = APR_ENOKEY;
+                }
+            }
+
             PK11_FreeSlot(slot);
         }
 
@@ -1386,28 +1425,19 @@ static apr_status_t crypto_digest_init(apr_crypto_digest_t **d,
     }
     case APR_CRYPTO_KTYPE_HMAC: {
 
-        digest->secParam = PK11_GenerateNewParam(key->cipherMech, key->symKey);
-        digest->ctx = PK11_CreateContextBySymKey(key->hashMech, CKA_SIGN,
-                key->symKey, digest->secParam);
+        if (digest->ctx) {
+            PK11_DestroyContext(digest->ctx, PR_TRUE);
+        }
+        digest->ctx = PK11_CloneContext(key->hmacCtx);
 
         /* did an error occur? */
-        perr = PORT_GetError();
-        if (perr || !digest->ctx) {
+        if (!digest->ctx) {
+            perr = PORT_GetError();
             key->f->result->rc = perr;
             key->f->result->msg = PR_ErrorToName(perr);
             return APR_EINIT;
         }
 
-        s = PK11_DigestBegin(digest->ctx);
-        if (s != SECSuccess) {
-            PRErrorCode perr = PORT_GetError();
-            if (perr) {
-                digest->f->result->rc = perr;
-                digest->f->result->msg = PR_ErrorToName(perr);
-            }
-            return APR_ECRYPT;
-        }
-
         return APR_SUCCESS;
 
     }
@@ -1620,6 +1650,46 @@ static apr_status_t crypto_digest(
     return status;
 }
 
+static apr_status_t crypto_hmac(const apr_crypto_key_t *key,
+        const unsigned char *in, apr_size_t inlen,
+        unsigned char *out, apr_size_t *outlen)
+{
+    PK11Context *ctx;
+    unsigned int len;
+    SECStatus s;
+
+    switch (key->rec->ktype) {
+    case APR_CRYPTO_KTYPE_HMAC:
+        break;
+    case APR_CRYPTO_KTYPE_CMAC:
+        return APR_ENOTIMPL;
+    default:
+        return APR_EINVAL;
+    }
+
+    if (!out || *outlen < key->macLength) {
+        *outlen = key->macLength;
+        return out ? APR_ENOSPACE : APR_SUCCESS;
+    }
+
+    ctx = PK11_CloneContext(key->hmacCtx);
+    if (!ctx) {
+        return APR_ECRYPT;
+    }
+
+    s = PK11_DigestOp(ctx, (unsigned char*) in, inlen);
+    if (s == SECSuccess) {
+        s = PK11_DigestFinal(ctx, out, &len, key->macLength);
+    }
+    PK11_DestroyContext(ctx, PR_TRUE);
+    if (s != SECSuccess) {
+        return APR_ECRYPT;
+    }
+    *outlen = len;
+
+    return APR_SUCCESS;
+}
+
 static apr_status_t cprng_stream_ctx_make(cprng_stream_ctx_t **psctx,
         apr_crypto_t *f, apr_crypto_cipher_e cipher, apr_pool_t *pool)
 {
@@ -1636,6 +1706,42 @@ static apr_status_t cprng_stream_ctx_bytes(cprng_stream_ctx_t **pctx,
     return APR_ENOTIMPL;
 }
 
+/**
+ * @brief Reset an encryption or decryption context with a new IV.
+ * @return APR_ENOTIMPL, not supported by this driver.
+ */
+static apr_status_t crypto_block_reset(apr_crypto_block_t *block,
+        const unsigned char *iv)
+{
+    return APR_ENOTIMPL;
+}
+
+/**
+ * @brief Encrypt and authenticate a message in one call.
+ * @return APR_ENOTIMPL, not supported by this driver.
+ */
+static apr_status_t crypto_aead_seal(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
+/**
+ * @brief Verify and decrypt a message in one call.
+ * @return APR_ENOTIMPL, not supported by this driver.
+ */
+static apr_status_t crypto_aead_open(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
 /**
  * NSS module.
  */
@@ -1647,7 +1753,8 @@ APR_MODULE_DECLARE_DATA const apr_crypto_driver_t apr_crypto_nss_driver = {
     crypto_block_decrypt, crypto_block_decrypt_finish,
     crypto_digest_init, crypto_digest_update, crypto_digest_final, crypto_digest,
     crypto_block_cleanup, crypto_digest_cleanup, crypto_cleanup, crypto_shutdown, crypto_error,
-    crypto_key, cprng_stream_ctx_make, cprng_stream_ctx_free, cprng_stream_ctx_bytes
+    crypto_key, cprng_stream_ctx_make, cprng_stream_ctx_free, cprng_stream_ctx_bytes,
+    crypto_block_reset, crypto_aead_seal, crypto_aead_open, crypto_hmac
 };
 
 #endif
@@ -22,8 +22,10 @@
 #include <ctype.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "apr_strings.h"
+#include "apr_atomic.h"
 #include "apr_time.h"
 #include "apr_buckets.h"
 #include "apr_thread_mutex.h"
@@ -59,6 +61,11 @@
 #endif /* defined(LIBRESSL_VERSION_NUMBER) */
 #endif /* ndef APR_USE_OPENSSL_PRE_1_1_API */
 
+#ifndef EVP_CTRL_AEAD_GET_TAG
+#define EVP_CTRL_AEAD_GET_TAG EVP_CTRL_GCM_GET_TAG
+#define EVP_CTRL_AEAD_SET_TAG EVP_CTRL_GCM_SET_TAG
+#endif
+
 struct apr_crypto_t {
     apr_pool_t *pool;
     const apr_crypto_driver_t *provider;
@@ -73,6 +80,9 @@ struct apr_crypto_config_t {
     ENGINE *engine;
 };
 
+/* The number of contexts a key keeps for its next one shot digests */
+#define KEY_SPARE_CTX 4
+
 struct apr_crypto_key_t {
     apr_pool_t *pool;
     const apr_crypto_driver_t *provider;
@@ -81,10 +91,14 @@ struct apr_crypto_key_t {
     const EVP_CIPHER *cipher;
     const EVP_MD *hmac;
     EVP_PKEY *pkey;
+    EVP_MD_CTX *signCtx;
+    void *volatile spareCtx[KEY_SPARE_CTX];
     unsigned char *key;
     int keyLen;
     int doPad;
     int ivSize;
+    int aead;
+    apr_uint32_t serial;
 };
 
 struct apr_crypto_block_t {
@@ -97,6 +111,8 @@ struct apr_crypto_block_t {
     int ivSize;
     int blockSize;
     int doPad;
+    int encrypt;
+    apr_uint32_t serial;
 };
 
 struct apr_crypto_digest_t {
@@ -129,12 +145,20 @@ static struct apr_crypto_block_key_type_t key_types[] =
 { APR_KEY_3DES_192, 24, 8, 8 },
 { APR_KEY_AES_128, 16, 16, 16 },
 { APR_KEY_AES_192, 24, 16, 16 },
-{ APR_KEY_AES_256, 32, 16, 16 } };
+{ APR_KEY_AES_256, 32, 16, 16 },
+{ APR_KEY_CHACHA20, 32, 1, 12 } };
 
 static struct apr_crypto_block_key_mode_t key_modes[] =
 {
 { APR_MODE_ECB },
-{ APR_MODE_CBC } };
+{ APR_MODE_CBC },
+{ APR_MODE_GCM },
+{ APR_MODE_POLY1305 } };
+
+/* Each derivation of a key gets a new serial, for the AEAD contexts to tell
+ * whether they still hold its key schedule.
+ */
+static apr_uint32_t key_serials;
 
 /* sufficient space to wrap a key */
 #define BUFFER_SIZE 128
@@ -250,13 +274,66 @@ void EVP_CIPHER_CTX_free(EVP_CIPHER_CTX *ctx)
  */
 static apr_status_t crypto_key_cleanup(apr_crypto_key_t *key)
 {
+    int i;
+
+    for (i = 0; i < KEY_SPARE_CTX; i++) {
+        if (key->spareCtx[i]) {
+            EVP_MD_CTX_free(key->spareCtx[i]);
+            key->spareCtx[i] = NULL;
+        }
+    }
+    if (key->signCtx) {
+        EVP_MD_CTX_free(key->signCtx);
+        key->signCtx = NULL;
+    }
     if (key->pkey) {
         EVP_PKEY_free(key->pkey);
+        key->pkey = NULL;
     }
 
     return APR_SUCCESS;
 }
 
+/* Take a context kept by the key, or a new one. The key is shared by the
+ * threads, so its slots are exchanged atomically.
+ */
+static EVP_MD_CTX *crypto_key_ctx_take(const apr_crypto_key_t *key)
+{
+    apr_crypto_key_t *k = (apr_crypto_key_t *) key;
+    int i;
+
+    for (i = 0; i < KEY_SPARE_CTX; i++) {
+        if (k->spareCtx[i]) {
+            EVP_MD_CTX *ctx = apr_atomic_xchgptr(&k->spareCtx[i], NULL);
+            if (ctx) {
+                return ctx;
+            }
+        }
+    }
+
+    return EVP_MD_CTX_new();
+}
+
+/* Give a context back to the key, or free it if the key has enough */
+static void crypto_key_ctx_release(const apr_crypto_key_t *key,
+        EVP_MD_CTX *ctx)
+{
+    apr_crypto_key_t *k = (apr_crypto_key_t *) key;
+    int i;
+
+    if (!ctx) {
+        return;
+    }
+    for (i = 0; i < KEY_SPARE_CTX; i++) {
+        if (!k->spareCtx[i]
+                && !apr_atomic_casptr(&k->spareCtx[i], ctx, NULL)) {
+            return;
+        }
+    }
+
+    EVP_MD_CTX_free(ctx);
+}
+
 static apr_status_t crypto_key_cleanup_helper(void *data)
 {
     apr_crypto_key_t *key = (apr_crypto_key_t *) data;
@@ -449,6 +526,9 @@ static apr_status_t crypto_make(apr_crypto_t **ff,
     apr_hash_set(f->types, "aes128", APR_HASH_KEY_STRING, &(key_types[++i]));
     apr_hash_set(f->types, "aes192", APR_HASH_KEY_STRING, &(key_types[++i]));
     apr_hash_set(f->types, "aes256", APR_HASH_KEY_STRING, &(key_types[++i]));
+#if defined(NID_chacha20_poly1305)
+    apr_hash_set(f->types, "chacha20", APR_HASH_KEY_STRING, &(key_types[++i]));
+#endif
 
     f->modes = apr_hash_make(pool);
     if (!f->modes) {
@@ -456,6 +536,10 @@ static apr_status_t crypto_make(apr_crypto_t **ff,
     }
     apr_hash_set(f->modes, "ecb", APR_HASH_KEY_STRING, &(key_modes[i = 0]));
     apr_hash_set(f->modes, "cbc", APR_HASH_KEY_STRING, &(key_modes[++i]));
+    apr_hash_set(f->modes, "gcm", APR_HASH_KEY_STRING, &(key_modes[++i]));
+#if defined(NID_chacha20_poly1305)
+    apr_hash_set(f->modes, "poly1305", APR_HASH_KEY_STRING, &(key_modes[++i]));
+#endif
 
     f->digests = apr_hash_make(pool);
     if (!f->digests) {
@@ -533,6 +617,13 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
         const apr_crypto_block_key_type_e type,
         const apr_crypto_block_key_mode_e mode, const int doPad, apr_pool_t *p)
 {
+    /* the authenticated modes go with their own ciphers only */
+    if ((mode == APR_MODE_GCM && (type == APR_KEY_3DES_192
+                                  || type == APR_KEY_CHACHA20))
+            || (mode == APR_MODE_POLY1305) != (type == APR_KEY_CHACHA20)) {
+        return APR_ENOCIPHER;
+    }
+
     /* determine the cipher to be used */
     switch (type) {
 
@@ -552,6 +643,9 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
         if (mode == APR_MODE_CBC) {
             key->cipher = EVP_aes_128_cbc();
         }
+        else if (mode == APR_MODE_GCM) {
+            key->cipher = EVP_aes_128_gcm();
+        }
         else {
             key->cipher = EVP_aes_128_ecb();
         }
@@ -562,6 +656,9 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
         if (mode == APR_MODE_CBC) {
             key->cipher = EVP_aes_192_cbc();
         }
+        else if (mode == APR_MODE_GCM) {
+            key->cipher = EVP_aes_192_gcm();
+        }
         else {
             key->cipher = EVP_aes_192_ecb();
         }
@@ -572,11 +669,23 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
         if (mode == APR_MODE_CBC) {
             key->cipher = EVP_aes_256_cbc();
         }
+        else if (mode == APR_MODE_GCM) {
+            key->cipher = EVP_aes_256_gcm();
+        }
         else {
             key->cipher = EVP_aes_256_ecb();
         }
         break;
 
+    case (APR_KEY_CHACHA20):
+
+#if defined(NID_chacha20_poly1305)
+        key->cipher = EVP_chacha20_poly1305();
+        break;
+#else
+        return APR_ENOCIPHER;
+#endif
+
     default:
 
         /* unknown key type, give up */
@@ -584,6 +693,9 @@ static apr_status_t crypto_cipher_mechanism(apr_crypto_key_t *key,
 
     }
 
+    key->aead = (mode == APR_MODE_GCM || mode == APR_MODE_POLY1305);
+    key->serial = apr_atomic_inc32(&key_serials) + 1;
+
     /* find the length of the key we need */
     key->keyLen = EVP_CIPHER_key_length(key->cipher);
 
@@ -625,6 +737,9 @@ static apr_status_t crypto_key(apr_crypto_key_t **k,
             return APR_ENOMEM;
         }
     }
+    else {
+        crypto_key_cleanup(key);
+    }
 
     apr_pool_cleanup_register(p, key, crypto_key_cleanup_helper,
             apr_pool_cleanup_null);
@@ -800,6 +915,20 @@ static apr_status_t crypto_key(apr_crypto_key_t **k,
         key->ivSize = EVP_CIPHER_iv_length(key->cipher);
     }
 
+    /* key the MAC once, the digests start from a copy of this context */
+    if (key->pkey) {
+        apr_crypto_config_t *config = f->config;
+
+        key->signCtx = EVP_MD_CTX_new();
+        if (!key->signCtx) {
+            return APR_ENOMEM;
+        }
+        if (1 != EVP_DigestSignInit(key->signCtx, NULL, key->hmac,
+                config->engine, key->pkey)) {
+            return APR_ENOKEY;
+        }
+    }
+
     return APR_SUCCESS;
 }
 
@@ -906,28 +1035,37 @@ static apr_status_t crypto_block_encrypt_init(apr_crypto_block_t **ctx,
     unsigned char *usedIv;
     apr_crypto_config_t *config = key->f->config;
     apr_crypto_block_t *block = *ctx;
-    if (!block) {
-        *ctx = block = apr_pcalloc(p, sizeof(apr_crypto_block_t));
+
+    /* the AEAD keys are for apr_crypto_aead_seal() only, for the tag */
+    if (key->aead) {
+        return APR_ENOCIPHER;
     }
+
     if (!block) {
-        return APR_ENOMEM;
+        *ctx = block = apr_pcalloc(p, sizeof(apr_crypto_block_t));
+        if (!block) {
+            return APR_ENOMEM;
+        }
+        apr_pool_cleanup_register(p, block, crypto_block_cleanup_helper,
+                apr_pool_cleanup_null);
     }
     block->f = key->f;
     block->pool = p;
     block->provider = key->provider;
     block->key = key;
-
-    apr_pool_cleanup_register(p, block, crypto_block_cleanup_helper,
-            apr_pool_cleanup_null);
+    block->encrypt = 1;
 
     switch (key->rec->ktype) {
 
     case APR_CRYPTO_KTYPE_PASSPHRASE:
     case APR_CRYPTO_KTYPE_SECRET: {
 
-        /* create a new context for encryption */
+        /* create a new context for encryption, kept until cleanup */
         if (!block->initialised) {
             block->cipherCtx = EVP_CIPHER_CTX_new();
+            if (!block->cipherCtx) {
+                return APR_ENOMEM;
+            }
             block->initialised = 1;
         }
 
@@ -1061,7 +1199,7 @@ static apr_status_t crypto_block_encrypt(unsigned char **out,
  *       same buffer used by apr_crypto_block_encrypt, offset by the
  *       number of bytes returned as actually written by the
  *       apr_crypto_block_encrypt() call. After this call, the context
- *       is cleaned and can be reused by apr_crypto_block_encrypt_init().
+ *       can be reused by apr_crypto_block_encrypt_init() or reset.
  * @param out Address of a buffer to which data will be written. This
  *            buffer must already exist, and is usually the same
  *            buffer used by apr_evp_crypt(). See note.
@@ -1083,13 +1221,13 @@ static apr_status_t crypto_block_encrypt_finish(unsigned char *out,
         apr_status_t rc = APR_SUCCESS;
         int len = *outlen;
 
+        /* the context is kept for apr_crypto_block_reset() */
         if (EVP_EncryptFinal_ex(block->cipherCtx, out, &len) == 0) {
             rc = APR_EPADDING;
         }
         else {
             *outlen = len;
         }
-        crypto_block_cleanup(block);
 
         return rc;
 
@@ -1124,28 +1262,37 @@ static apr_status_t crypto_block_decrypt_init(apr_crypto_block_t **ctx,
 {
     apr_crypto_config_t *config = key->f->config;
     apr_crypto_block_t *block = *ctx;
-    if (!block) {
-        *ctx = block = apr_pcalloc(p, sizeof(apr_crypto_block_t));
+
+    /* the AEAD keys are for apr_crypto_aead_open() only, for the tag */
+    if (key->aead) {
+        return APR_ENOCIPHER;
     }
+
     if (!block) {
-        return APR_ENOMEM;
+        *ctx = block = apr_pcalloc(p, sizeof(apr_crypto_block_t));
+        if (!block) {
+            return APR_ENOMEM;
+        }
+        apr_pool_cleanup_register(p, block, crypto_block_cleanup_helper,
+                apr_pool_cleanup_null);
     }
     block->f = key->f;
     block->pool = p;
     block->provider = key->provider;
     block->key = key;
-
-    apr_pool_cleanup_register(p, block, crypto_block_cleanup_helper,
-            apr_pool_cleanup_null);
+    block->encrypt = 0;
 
     switch (key->rec->ktype) {
 
     case APR_CRYPTO_KTYPE_PASSPHRASE:
     case APR_CRYPTO_KTYPE_SECRET: {
 
-        /* create a new context for encryption */
+        /* create a new context for encryption, kept until cleanup */
         if (!block->initialised) {
             block->cipherCtx = EVP_CIPHER_CTX_new();
+            if (!block->cipherCtx) {
+                return APR_ENOMEM;
+            }
             block->initialised = 1;
         }
 
@@ -1264,7 +1411,7 @@ static apr_status_t crypto_block_decrypt(unsigned char **out,
  *       same buffer used by apr_crypto_block_decrypt, offset by the
  *       number of bytes returned as actually written by the
  *       apr_crypto_block_decrypt() call. After this call, the context
- *       is cleaned and can be reused by apr_crypto_block_decrypt_init().
+ *       can be reused by apr_crypto_block_decrypt_init() or reset.
  * @param out Address of a buffer to which data will be written. This
  *            buffer must already exist, and is usually the same
  *            buffer used by apr_evp_crypt(). See note.
@@ -1286,13 +1433,13 @@ static apr_status_t crypto_block_decrypt_finish(unsigned char *out,
         apr_status_t rc = APR_SUCCESS;
         int len = *outlen;
 
+        /* the context is kept for apr_crypto_block_reset() */
         if (EVP_DecryptFinal_ex(block->cipherCtx, out, &len) == 0) {
             rc = APR_EPADDING;
         }
         else {
             *outlen = len;
         }
-        crypto_block_cleanup(block);
 
         return rc;
 
@@ -1306,31 +1453,253 @@ static apr_status_t crypto_block_decrypt_finish(unsigned char *out,
 
 }
 
-static apr_status_t crypto_digest_init(apr_crypto_digest_t **d,
-        const apr_crypto_key_t *key, apr_crypto_digest_rec_t *rec, apr_pool_t *p)
+/**
+ * @brief Reset an encryption or decryption context with a new IV, keeping
+ *        the cipher and the key schedule of the last init.
+ * @param block The block context to reset.
+ * @param iv The new initialisation vector, or NULL if none is needed.
+ * @return APR_ENOIV if an initialisation vector is required but not specified.
+ *         APR_EINIT if the context was never initialised, or the backend
+ *         failed to reinitialise it.
+ */
+static apr_status_t crypto_block_reset(apr_crypto_block_t *block,
+        const unsigned char *iv)
 {
-    apr_crypto_config_t *config = key->f->config;
-    apr_crypto_digest_t *digest = *d;
-    if (!digest) {
-        *d = digest = apr_pcalloc(p, sizeof(apr_crypto_digest_t));
+    const apr_crypto_key_t *key = block->key;
+
+    if (!key || key->aead) {
+        return APR_EINIT;
     }
-    if (!digest) {
-        return APR_ENOMEM;
+
+    switch (key->rec->ktype) {
+
+    case APR_CRYPTO_KTYPE_PASSPHRASE:
+    case APR_CRYPTO_KTYPE_SECRET: {
+
+        if (key->ivSize && !iv) {
+            return APR_ENOIV;
+        }
+
+        if (!block->initialised) {
+
+            /* cleaned up after an error, set it up from the key again */
+            block->cipherCtx = EVP_CIPHER_CTX_new();
+            if (!block->cipherCtx) {
+                return APR_ENOMEM;
+            }
+            block->initialised = 1;
+
+            if (!EVP_CipherInit_ex(block->cipherCtx, key->cipher,
+                    key->f->config->engine, (unsigned char *) key->key,
+                    (unsigned char *) iv, block->encrypt)) {
+                return APR_EINIT;
+            }
+        }
+        else if (!EVP_CipherInit_ex(block->cipherCtx, NULL, NULL, NULL,
+                (unsigned char *) iv, block->encrypt)) {
+            return APR_EINIT;
+        }
+
+        if (!EVP_CIPHER_CTX_set_padding(block->cipherCtx, key->doPad)) {
+            return APR_EPADDING;
+        }
+
+        return APR_SUCCESS;
+
     }
-    digest->f = key->f;
-    digest->pool = p;
-    digest->provider = key->provider;
-    digest->key = key;
-    digest->rec = rec;
+    default: {
+
+        return APR_EINVAL;
 
-    /* create a new context for digest */
-    if (!digest->initialised) {
-        digest->mdCtx = EVP_MD_CTX_new();
-        digest->initialised = 1;
+    }
     }
 
-    apr_pool_cleanup_register(p, digest, crypto_digest_cleanup_helper,
-            apr_pool_cleanup_null);
+}
+
+/*
+ * Set up a context for sealing or opening a message with an AEAD key. The
+ * key schedule is only computed when the key changed since the previous
+ * message, otherwise just the IV is set.
+ */
+static apr_status_t crypto_aead_init(apr_crypto_block_t **ctx,
+        const unsigned char *iv, const apr_crypto_key_t *key, int encrypt,
+        apr_pool_t *p)
+{
+    apr_crypto_block_t *block = *ctx;
+
+    switch (key->rec->ktype) {
+
+    case APR_CRYPTO_KTYPE_PASSPHRASE:
+    case APR_CRYPTO_KTYPE_SECRET:
+        break;
+
+    default:
+        return APR_EINVAL;
+
+    }
+
+    if (!key->aead) {
+        return APR_ENOCIPHER;
+    }
+    if (!iv) {
+        return APR_ENOIV;
+    }
+
+    if (!block) {
+        *ctx = block = apr_pcalloc(p, sizeof(apr_crypto_block_t));
+        if (!block) {
+            return APR_ENOMEM;
+        }
+        apr_pool_cleanup_register(p, block, crypto_block_cleanup_helper,
+                apr_pool_cleanup_null);
+    }
+    block->f = key->f;
+    block->pool = p;
+    block->provider = key->provider;
+    block->encrypt = encrypt;
+
+    if (!block->initialised) {
+        block->cipherCtx = EVP_CIPHER_CTX_new();
+        if (!block->cipherCtx) {
+            return APR_ENOMEM;
+        }
+        block->initialised = 1;
+        block->key = NULL;
+    }
+
+    if (block->key != key || block->serial != key->serial) {
+        block->key = NULL;
+        if (!EVP_CipherInit_ex(block->cipherCtx, key->cipher,
+                key->f->config->engine, (unsigned char *) key->key,
+                (unsigned char *) iv, encrypt)) {
+            return APR_EINIT;
+        }
+        block->key = key;
+        block->serial = key->serial;
+    }
+    else if (!EVP_CipherInit_ex(block->cipherCtx, NULL, NULL, NULL,
+            (unsigned char *) iv, encrypt)) {
+        block->key = NULL;
+        return APR_EINIT;
+    }
+
+    return APR_SUCCESS;
+}
+
+/**
+ * @brief Encrypt and authenticate a message in one call, the tag following
+ *        the ciphertext in out.
+ */
+static apr_status_t crypto_aead_seal(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    apr_crypto_block_t *block;
+    apr_status_t rv;
+    int len = 0, fin = 0, ignored;
+
+    /* are we after the size of the out buffer? */
+    if (!out) {
+        *outlen = inlen + APR_CRYPTO_AEAD_TAGSIZE;
+        return APR_SUCCESS;
+    }
+    if (inlen > INT_MAX - APR_CRYPTO_AEAD_TAGSIZE || aadlen > INT_MAX) {
+        return APR_EINVAL;
+    }
+
+    rv = crypto_aead_init(ctx, iv, key, 1, p);
+    if (APR_SUCCESS != rv) {
+        return rv;
+    }
+    block = *ctx;
+
+    /* a NULL input would finalise the message, so skip empty updates */
+    if ((aadlen && !EVP_EncryptUpdate(block->cipherCtx, NULL, &ignored,
+                (unsigned char *) aad, (int) aadlen))
+            || (inlen && !EVP_EncryptUpdate(block->cipherCtx, out, &len,
+                (unsigned char *) in, (int) inlen))
+            || !EVP_EncryptFinal_ex(block->cipherCtx, out + len, &fin)
+            || !EVP_CIPHER_CTX_ctrl(block->cipherCtx, EVP_CTRL_AEAD_GET_TAG,
+                APR_CRYPTO_AEAD_TAGSIZE, out + len + fin)) {
+        block->key = NULL;
+        return APR_ECRYPT;
+    }
+    *outlen = len + fin + APR_CRYPTO_AEAD_TAGSIZE;
+
+    return APR_SUCCESS;
+}
+
+/**
+ * @brief Verify and decrypt a message sealed by crypto_aead_seal(), the
+ *        plaintext being cleared if the tag does not match.
+ */
+static apr_status_t crypto_aead_open(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p)
+{
+    apr_crypto_block_t *block;
+    apr_size_t ctlen;
+    apr_status_t rv;
+    int len = 0, fin = 0, ignored;
+
+    if (inlen < APR_CRYPTO_AEAD_TAGSIZE) {
+        return APR_ENOVERIFY;
+    }
+    ctlen = inlen - APR_CRYPTO_AEAD_TAGSIZE;
+
+    /* are we after the size of the out buffer? */
+    if (!out) {
+        *outlen = ctlen;
+        return APR_SUCCESS;
+    }
+    if (ctlen > INT_MAX || aadlen > INT_MAX) {
+        return APR_EINVAL;
+    }
+
+    rv = crypto_aead_init(ctx, iv, key, 0, p);
+    if (APR_SUCCESS != rv) {
+        return rv;
+    }
+    block = *ctx;
+
+    if ((aadlen && !EVP_DecryptUpdate(block->cipherCtx, NULL, &ignored,
+                (unsigned char *) aad, (int) aadlen))
+            || (ctlen && !EVP_DecryptUpdate(block->cipherCtx, out, &len,
+                (unsigned char *) in, (int) ctlen))
+            || !EVP_CIPHER_CTX_ctrl(block->cipherCtx, EVP_CTRL_AEAD_SET_TAG,
+                APR_CRYPTO_AEAD_TAGSIZE, (unsigned char *) in + ctlen)) {
+        block->key = NULL;
+        apr_crypto_memzero(out, ctlen);
+        return APR_ECRYPT;
+    }
+    if (EVP_DecryptFinal_ex(block->cipherCtx, out + len, &fin) <= 0) {
+        apr_crypto_memzero(out, ctlen);
+        return APR_ENOVERIFY;
+    }
+    *outlen = len + fin;
+
+    return APR_SUCCESS;
+}
+
+/* Give the context of a finished digest back to its key */
+static void crypto_digest_release(apr_crypto_digest_t *digest)
+{
+    if (digest->initialised) {
+        crypto_key_ctx_release(digest->key, digest->mdCtx);
+        digest->mdCtx = NULL;
+        digest->initialised = 0;
+    }
+}
+
+/* Start a digest, from a copy of the keyed context for a MAC */
+static apr_status_t crypto_digest_begin(apr_crypto_digest_t *digest)
+{
+    const apr_crypto_key_t *key = digest->key;
+    apr_crypto_config_t *config = key->f->config;
 
     switch (key->rec->ktype) {
 
@@ -1346,9 +1715,7 @@ static apr_status_t crypto_digest_init(apr_crypto_digest_t **d,
     }
     case APR_CRYPTO_KTYPE_HMAC:
     case APR_CRYPTO_KTYPE_CMAC: {
-        if (1
-                != EVP_DigestSignInit(digest->mdCtx, NULL, key->hmac,
-                        config->engine, key->pkey)) {
+        if (1 != EVP_MD_CTX_copy_ex(digest->mdCtx, key->signCtx)) {
             return APR_EINIT;
         }
         break;
@@ -1362,6 +1729,40 @@ static apr_status_t crypto_digest_init(apr_crypto_digest_t **d,
 
 }
 
+static apr_status_t crypto_digest_init(apr_crypto_digest_t **d,
+        const apr_crypto_key_t *key, apr_crypto_digest_rec_t *rec, apr_pool_t *p)
+{
+    apr_crypto_digest_t *digest = *d;
+    if (!digest) {
+        *d = digest = apr_pcalloc(p, sizeof(apr_crypto_digest_t));
+        if (!digest) {
+            return APR_ENOMEM;
+        }
+        apr_pool_cleanup_register(p, digest, crypto_digest_cleanup_helper,
+                apr_pool_cleanup_null);
+    }
+    else if (digest->key != key) {
+        crypto_digest_cleanup(digest);
+    }
+    digest->f = key->f;
+    digest->pool = p;
+    digest->provider = key->provider;
+    digest->key = key;
+    digest->rec = rec;
+
+    /* reuse a context of the key, or create a new one */
+    if (!digest->initialised) {
+        digest->mdCtx = crypto_key_ctx_take(key);
+        if (!digest->mdCtx) {
+            return APR_ENOMEM;
+        }
+        digest->initialised = 1;
+    }
+
+    return crypto_digest_begin(digest);
+
+}
+
 static apr_status_t crypto_digest_update(apr_crypto_digest_t *digest,
         const unsigned char *in, apr_size_t inlen)
 {
@@ -1432,7 +1833,7 @@ static apr_status_t crypto_digest_final(apr_crypto_digest_t *digest)
             status = APR_ENODIGEST;
         }
 
-        crypto_digest_cleanup(digest);
+        crypto_digest_release(digest);
 
         return status;
 
@@ -1508,7 +1909,7 @@ static apr_status_t crypto_digest_final(apr_crypto_digest_t *digest)
 
         }
 
-        crypto_digest_cleanup(digest);
+        crypto_digest_release(digest);
 
         return status;
 
@@ -1524,16 +1925,73 @@ static apr_status_t crypto_digest(
         const apr_crypto_key_t *key, apr_crypto_digest_rec_t *rec, const unsigned char *in,
         apr_size_t inlen, apr_pool_t *p)
 {
-    apr_crypto_digest_t *digest = NULL;
+    apr_crypto_digest_t digest;
     apr_status_t status = APR_SUCCESS;
 
-    status = crypto_digest_init(&digest, key, rec, p);
+    /* no need for a digest from the pool, nor for its cleanup */
+    memset(&digest, 0, sizeof(digest));
+    digest.f = key->f;
+    digest.pool = p;
+    digest.provider = key->provider;
+    digest.key = key;
+    digest.rec = rec;
+    digest.mdCtx = crypto_key_ctx_take(key);
+    if (!digest.mdCtx) {
+        return APR_ENOMEM;
+    }
+    digest.initialised = 1;
+
+    status = crypto_digest_begin(&digest);
     if (APR_SUCCESS == status) {
-        status = crypto_digest_update(digest, in, inlen);
+        status = crypto_digest_update(&digest, in, inlen);
         if (APR_SUCCESS == status) {
-            status = crypto_digest_final(digest);
+            status = crypto_digest_final(&digest);
         }
     }
+    crypto_digest_release(&digest);
+
+    return status;
+}
+
+static apr_status_t crypto_hmac(const apr_crypto_key_t *key,
+        const unsigned char *in, apr_size_t inlen,
+        unsigned char *out, apr_size_t *outlen)
+{
+    EVP_MD_CTX *ctx;
+    apr_status_t status = APR_SUCCESS;
+    size_t len;
+
+    switch (key->rec->ktype) {
+    case APR_CRYPTO_KTYPE_HMAC:
+        len = EVP_MD_size(key->hmac);
+        break;
+    case APR_CRYPTO_KTYPE_CMAC:
+        len = EVP_CIPHER_block_size(key->cipher);
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    if (!out || *outlen < len) {
+        *outlen = len;
+        return out ? APR_ENOSPACE : APR_SUCCESS;
+    }
+
+    ctx = crypto_key_ctx_take(key);
+    if (!ctx) {
+        return APR_ENOMEM;
+    }
+
+    if (1 != EVP_MD_CTX_copy_ex(ctx, key->signCtx)
+            || 1 != EVP_DigestSignUpdate(ctx, in, inlen)
+            || 1 != EVP_DigestSignFinal(ctx, out, &len)) {
+        status = APR_ECRYPT;
+    }
+    else {
+        *outlen = len;
+    }
+
+    crypto_key_ctx_release(key, ctx);
 
     return status;
 }
@@ -1691,7 +2149,8 @@ APR_MODULE_DECLARE_DATA const apr_crypto_driver_t apr_crypto_openssl_driver = {
     crypto_block_decrypt, crypto_block_decrypt_finish,
     crypto_digest_init, crypto_digest_update, crypto_digest_final, crypto_digest,
     crypto_block_cleanup, crypto_digest_cleanup, crypto_cleanup, crypto_shutdown, crypto_error,
-    crypto_key, cprng_stream_ctx_make, cprng_stream_ctx_free, cprng_stream_ctx_bytes
+    crypto_key, cprng_stream_ctx_make, cprng_stream_ctx_free, cprng_stream_ctx_bytes,
+    crypto_block_reset, crypto_aead_seal, crypto_aead_open, crypto_hmac
 };
 
 #endif
@@ -50,6 +50,7 @@
 
 #include "apr_ring.h"
 #include "apr_pools.h"
+#include "apr_atomic.h"
 #include "apr_thread_mutex.h"
 #include "apr_thread_proc.h"
 
@@ -68,6 +69,12 @@
 #define CPRNG_BUF_SIZE_MIN (CPRNG_KEY_SIZE * (8 - 1))
 #define CPRNG_BUF_SIZE_DEF (CPRNG_KEY_SIZE * (24 - 1))
 
+/* The per-thread CPRNGs serve mostly small requests (IDs, nonces) from
+ * their buffer, so refill it by 4KB (key included): far fewer rekeys, and
+ * bulks of keystream for the widest SIMD path of the cipher.
+ */
+#define CPRNG_BUF_SIZE_THREAD (CPRNG_KEY_SIZE * (128 - 1))
+
 APR_TYPEDEF_STRUCT(apr_crypto_t,
     apr_pool_t *pool;
     apr_crypto_driver_t *provider;
@@ -85,11 +92,25 @@ struct apr_crypto_prng_t {
     apr_size_t len, pos;
     int flags;
     apr_crypto_cipher_e cipher;
+#if APR_HAS_FORK
+    apr_uint32_t forks;
+#endif
 };
 
+static apr_status_t cprng_bytes(apr_crypto_prng_t *cprng,
+                                void *buf, apr_size_t len);
+
 static apr_crypto_prng_t *cprng_global = NULL;
 static APR_RING_HEAD(apr_cprng_ring, apr_crypto_prng_t) *cprng_ring;
 
+#if APR_HAS_FORK
+/* Bumped by apr_crypto_prng_after_fork() for the global CPRNG, which can't
+ * forward to the per-thread CPRNGs (not in the ring) but tells them to
+ * reseed on their next use.
+ */
+static apr_uint32_t cprng_forks;
+#endif
+
 #if APR_HAS_THREADS
 static apr_thread_mutex_t *cprng_ring_mutex;
 
@@ -225,8 +246,8 @@ APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
 
     cprng = private;
     if (!cprng) {
-        rv = apr_crypto_prng_create(&cprng, cprng_global->crypto, cprng_global->cipher, 0,
-                APR_CRYPTO_PRNG_PER_THREAD, NULL, NULL);
+        rv = apr_crypto_prng_create(&cprng, cprng_global->crypto, cprng_global->cipher,
+                CPRNG_BUF_SIZE_THREAD, APR_CRYPTO_PRNG_PER_THREAD, NULL, NULL);
         if (rv != APR_SUCCESS) {
             return rv;
         }
@@ -237,8 +258,26 @@ APR_DECLARE(apr_status_t) apr_crypto_random_thread_bytes(void *buf,
             return rv;
         }
     }
+#if APR_HAS_FORK
+    else if (cprng->forks != apr_atomic_read32(&cprng_forks)) {
+        /* Don't share the state (nor the buffer) with the other process */
+        cprng->forks = apr_atomic_read32(&cprng_forks);
+        rv = apr_crypto_prng_reseed(cprng, NULL);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
 
-    return apr_crypto_prng_bytes(cprng, buf, len);
+    /* Fast path, no lock: served from the buffer */
+    if (len <= cprng->len - cprng->pos) {
+        memcpy(buf, cprng->buf + cprng->pos, len);
+        apr_memzero_explicit(cprng->buf + cprng->pos, len);
+        cprng->pos += len;
+        return APR_SUCCESS;
+    }
+
+    return cprng_bytes(cprng, buf, len);
 }
 #endif
 
@@ -312,6 +351,9 @@ APR_DECLARE(apr_status_t) apr_crypto_prng_create(apr_crypto_prng_t **pcprng,
     cprng->cipher = cipher;
     cprng->flags = flags;
     cprng->pool = pool;
+#if APR_HAS_FORK
+    cprng->forks = apr_atomic_read32(&cprng_forks);
+#endif
 
     if (bufsize == 0) {
         bufsize = CPRNG_BUF_SIZE_DEF;
@@ -639,6 +681,9 @@ APR_DECLARE(apr_status_t) apr_crypto_prng_after_fork(apr_crypto_prng_t *cprng,
     cprng_unlock(cprng);
 
     if (cprng == cprng_global) {
+        /* Have the per-thread CPRNGs reseed from the new global state */
+        apr_atomic_inc32(&cprng_forks);
+
         /* Forward to all maintained CPRNGs. */
         cprng_ring_lock();
         for (cprng = APR_RING_FIRST(cprng_ring);
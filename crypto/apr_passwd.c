@@ -19,6 +19,8 @@
 #include "apr_lib.h"
 #include "apr_private.h"
 #include "apr_sha1.h"
+#include "apr_siphash.h"
+#include "apr_thread_mutex.h"
 #include "crypt_blowfish.h"
 
 #if APR_HAVE_STRING_H
@@ -224,3 +226,254 @@ APR_DECLARE(apr_status_t) apr_bcrypt_encode(const char *pw,
         return APR_FROM_OS_ERROR(errno);
     return APR_SUCCESS;
 }
+
+/* The cache is set associative: a credential goes to one of the ways of
+ * the set given by its tag, replacing the least lasting one of the set.
+ */
+#define PASSWORD_CACHE_WAYS 4
+
+/* Longer credentials are always validated */
+#define PASSWORD_CACHE_MAX_CRED 1024
+
+typedef struct {
+    apr_uint64_t tag[2];
+    apr_interval_time_t expiry;     /* monotonic, zero when free */
+} password_entry_t;
+
+struct apr_password_cache_t {
+    password_entry_t *entries;
+    apr_size_t mask;                /* of the sets */
+    apr_interval_time_t ttl;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *mutex;
+#endif
+    unsigned char key[2][APR_SIPHASH_KSIZE];
+};
+
+#if APR_HAS_THREADS
+#define password_cache_lock(cache) apr_thread_mutex_lock((cache)->mutex)
+#define password_cache_unlock(cache) apr_thread_mutex_unlock((cache)->mutex)
+#else
+#define password_cache_lock(cache)
+#define password_cache_unlock(cache)
+#endif
+
+APR_DECLARE(apr_status_t) apr_password_cache_create(apr_password_cache_t **cache,
+                                                    apr_size_t size,
+                                                    apr_interval_time_t ttl,
+                                                    apr_pool_t *p)
+{
+#if APR_HAS_RANDOM
+    apr_password_cache_t *c;
+    apr_size_t sets = 1;
+    apr_status_t rv;
+
+    while (sets * PASSWORD_CACHE_WAYS < size) {
+        sets <<= 1;
+    }
+
+    c = apr_pcalloc(p, sizeof(*c));
+    rv = apr_generate_random_bytes(&c->key[0][0], sizeof(c->key));
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_create(&c->mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#endif
+    c->entries = apr_pcalloc(p, sets * PASSWORD_CACHE_WAYS
+                                * sizeof(password_entry_t));
+    c->mask = sets - 1;
+    c->ttl = ttl;
+
+    *cache = c;
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(void) apr_password_cache_clear(apr_password_cache_t *cache)
+{
+    password_cache_lock(cache);
+    memset(cache->entries, 0, (cache->mask + 1) * PASSWORD_CACHE_WAYS
+                              * sizeof(password_entry_t));
+    password_cache_unlock(cache);
+}
+
+/* The tag of the credentials, or zero if they are too long to be cached */
+static int password_cache_tag(apr_password_cache_t *cache,
+                              apr_uint64_t tag[2], const char *user,
+                              const char *passwd, const char *hash)
+{
+    char cred[PASSWORD_CACHE_MAX_CRED];
+    apr_size_t ulen = user ? strlen(user) + 1 : 0;
+    apr_size_t plen = strlen(passwd) + 1;
+    apr_size_t hlen = strlen(hash);
+
+    if (ulen + plen + hlen > sizeof(cred)) {
+        return 0;
+    }
+
+    /* NUL separated, no two credentials make the same string */
+    if (ulen) {
+        memcpy(cred, user, ulen);
+    }
+    memcpy(cred + ulen, passwd, plen);
+    memcpy(cred + ulen + plen, hash, hlen);
+    tag[0] = apr_siphash24(cred, ulen + plen + hlen, cache->key[0]);
+    tag[1] = apr_siphash24(cred, ulen + plen + hlen, cache->key[1]);
+    apr_memzero_explicit(cred, ulen + plen + hlen);
+
+    return 1;
+}
+
+static password_entry_t *password_cache_set(apr_password_cache_t *cache,
+                                            const apr_uint64_t tag[2])
+{
+    return &cache->entries[(apr_size_t)(tag[0] & cache->mask)
+                           * PASSWORD_CACHE_WAYS];
+}
+
+static int password_cache_lookup(apr_password_cache_t *cache,
+                                 const apr_uint64_t tag[2])
+{
+    password_entry_t *set = password_cache_set(cache, tag);
+    apr_interval_time_t now = apr_time_monotonic();
+    int i, found = 0;
+
+    password_cache_lock(cache);
+    for (i = 0; i < PASSWORD_CACHE_WAYS; i++) {
+        if (set[i].tag[0] == tag[0] && set[i].tag[1] == tag[1]
+                && set[i].expiry > now) {
+            found = 1;
+            break;
+        }
+    }
+    password_cache_unlock(cache);
+
+    return found;
+}
+
+static void password_cache_insert(apr_password_cache_t *cache,
+                                  const apr_uint64_t tag[2])
+{
+    password_entry_t *set = password_cache_set(cache, tag), *e = set;
+    apr_interval_time_t expiry = apr_time_monotonic() + cache->ttl;
+    int i;
+
+    password_cache_lock(cache);
+    for (i = 0; i < PASSWORD_CACHE_WAYS; i++) {
+        if (set[i].tag[0] == tag[0] && set[i].tag[1] == tag[1]) {
+            e = &set[i];
+            break;
+        }
+        if (set[i].expiry < e->expiry) {
+            e = &set[i];
+        }
+    }
+    e->tag[0] = tag[0];
+    e->tag[1] = tag[1];
+    e->expiry = expiry;
+    password_cache_unlock(cache);
+}
+
+APR_DECLARE(apr_status_t) apr_password_validate_cached(apr_password_cache_t *cache,
+                                                       const char *user,
+                                                       const char *passwd,
+                                                       const char *hash)
+{
+    apr_uint64_t tag[2];
+    apr_status_t rv;
+
+    if (!cache || !password_cache_tag(cache, tag, user, passwd, hash)) {
+        return apr_password_validate(passwd, hash);
+    }
+    if (password_cache_lookup(cache, tag)) {
+        return APR_SUCCESS;
+    }
+
+    rv = apr_password_validate(passwd, hash);
+    if (rv == APR_SUCCESS) {
+        password_cache_insert(cache, tag);
+    }
+    return rv;
+}
+
+#if APR_HAS_THREADS
+
+typedef struct {
+    apr_password_cache_t *cache;
+    apr_password_validate_fn *done;
+    void *baton;
+    const char *user;
+    const char *passwd;
+    const char *hash;
+    apr_size_t size;
+} password_task_t;
+
+static void *APR_THREAD_FUNC password_validate_task(apr_thread_t *thread,
+                                                    void *param)
+{
+    password_task_t *task = param;
+    apr_password_validate_fn *done = task->done;
+    void *baton = task->baton;
+    apr_status_t rv;
+
+    rv = apr_password_validate_cached(task->cache, task->user, task->passwd,
+                                      task->hash);
+    apr_memzero_explicit(task, task->size);
+    free(task);
+
+    done(baton, rv);
+    return NULL;
+}
+
+APR_DECLARE(apr_status_t) apr_password_validate_async(apr_thread_pool_t *tp,
+                                                      apr_password_cache_t *cache,
+                                                      const char *user,
+                                                      const char *passwd,
+                                                      const char *hash,
+                                                      apr_password_validate_fn *done,
+                                                      void *baton)
+{
+    apr_size_t ulen = user ? strlen(user) + 1 : 0;
+    apr_size_t plen = strlen(passwd) + 1;
+    apr_size_t hlen = strlen(hash) + 1;
+    password_task_t *task;
+    apr_uint64_t tag[2];
+    apr_status_t rv;
+    char *s;
+
+    if (cache && password_cache_tag(cache, tag, user, passwd, hash)
+            && password_cache_lookup(cache, tag)) {
+        done(baton, APR_SUCCESS);
+        return APR_SUCCESS;
+    }
+
+    /* Not from a pool, the task outlives the call (and its thread) */
+    task = malloc(sizeof(*task) + ulen + plen + hlen);
+    if (!task) {
+        return APR_ENOMEM;
+    }
+    task->cache = cache;
+    task->done = done;
+    task->baton = baton;
+    task->size = sizeof(*task) + ulen + plen + hlen;
+    s = (char *)(task + 1);
+    task->user = user ? memcpy(s, user, ulen) : NULL;
+    task->passwd = memcpy(s + ulen, passwd, plen);
+    task->hash = memcpy(s + ulen + plen, hash, hlen);
+
+    rv = apr_thread_pool_push(tp, password_validate_task, task,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    if (rv != APR_SUCCESS) {
+        apr_memzero_explicit(task, task->size);
+        free(task);
+    }
+    return rv;
+}
+
+#endif /* APR_HAS_THREADS */
@@ -48,6 +48,7 @@
 #include "apr_base64.h"
 #include "apr_strings.h"
 #include "apr_lib.h"
+#include "apr_sha_private.h"
 #if APR_CHARSET_EBCDIC
 #include "apr_xlate.h"
 #endif /*APR_CHARSET_EBCDIC*/
@@ -109,6 +110,10 @@ static void sha_transform(apr_sha1_ctx_t *sha_info)
     int i;
     apr_uint32_t temp, A, B, C, D, E, W[80];
 
+    if (apr__sha1_blocks(sha_info->digest, sha_info->data, 1, 1)) {
+        return;
+    }
+
     for (i = 0; i < 16; ++i) {
         W[i] = sha_info->data[i];
     }
@@ -245,6 +250,11 @@ APR_DECLARE(void) apr_sha1_update_binary(apr_sha1_ctx_t *sha_info,
             return;
         }
     }
+    /* The SHA instructions take the blocks where they are */
+    i = (unsigned int)apr__sha1_blocks(sha_info->digest, buffer,
+                                       count / SHA_BLOCKSIZE, 0);
+    buffer += i * SHA_BLOCKSIZE;
+    count -= i * SHA_BLOCKSIZE;
     while (count >= SHA_BLOCKSIZE) {
         memcpy(sha_info->data, buffer, SHA_BLOCKSIZE);
         buffer += SHA_BLOCKSIZE;
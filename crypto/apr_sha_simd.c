@@ -0,0 +1,906 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * SHA-1 and SHA-256 block functions using the instructions of the CPU:
+ * SHA-NI on x86 and the cryptographic extension on aarch64, picked at
+ * runtime, plus SHA-256 over eight independent buffers at once in the
+ * lanes of AVX2 registers.  They compute the same as the portable code of
+ * apr_sha1.c and sha2.c, which remains in use when they process nothing.
+ */
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_sha_private.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+        && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#include <cpuid.h>
+#define SHA_X86 1
+#define SHA_TARGET(t) __attribute__((target(t)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#include <immintrin.h>
+#include <intrin.h>
+#define SHA_X86 1
+#define SHA_TARGET(t)
+#elif defined(__aarch64__) && defined(__GNUC__) && !defined(__AARCH64EB__)
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)
+#define SHA_ARM 1
+#define SHA_ARM_TARGET
+#elif defined(__linux__) && defined(HAVE_SYS_AUXV_H)
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#define SHA_ARM 1
+#define SHA_ARM_DETECT 1
+#if defined(__clang__)
+#define SHA_ARM_TARGET __attribute__((target("crypto")))
+#else
+#define SHA_ARM_TARGET __attribute__((target("+crypto")))
+#endif
+#endif
+#if SHA_ARM
+#include <arm_neon.h>
+#endif
+#endif
+
+#if SHA_X86 || SHA_ARM
+
+static const apr_uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#endif
+
+#if SHA_X86
+
+#define SHA_NI   1
+#define SHA_AVX2 2
+
+/* The SHA-NI and AVX2 flags of what the CPU (and OS) supports, a benign
+ * race.  SHA-NI comes with SSE4.1 and SSSE3 on all the CPUs having it,
+ * check them anyway.
+ */
+static int sha_level(void)
+{
+    static int level = -1;
+
+    if (level < 0) {
+        int l = 0;
+#if defined(_MSC_VER)
+        int info[4];
+
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            if ((info[2] & ((1 << 9) | (1 << 19))) == ((1 << 9) | (1 << 19))) {
+                int avx = (info[2] & (3 << 27)) == (3 << 27)
+                          && (_xgetbv(0) & 6) == 6;
+
+                __cpuidex(info, 7, 0);
+                if (info[1] & (1 << 29)) {
+                    l |= SHA_NI;
+                }
+                if (avx && (info[1] & (1 << 5))) {
+                    l |= SHA_AVX2;
+                }
+            }
+        }
+#else
+        unsigned int a, b, c, d;
+
+        if (__get_cpuid_max(0, NULL) >= 7) {
+            __cpuid(1, a, b, c, d);
+            if ((c & ((1 << 9) | (1 << 19))) == ((1 << 9) | (1 << 19))) {
+                __cpuid_count(7, 0, a, b, c, d);
+                if (b & (1 << 29)) {
+                    l |= SHA_NI;
+                }
+            }
+        }
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            l |= SHA_AVX2;
+        }
+#endif
+        level = l;
+    }
+
+    return level;
+}
+
+/* The bytes of the message words in big endian, the last word first for
+ * SHA-1, or already in host order (the words of SHA-1 still reversed).
+ */
+#define SHA1_BYTES_MASK \
+    _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL)
+#define SHA1_WORDS_MASK \
+    _mm_set_epi64x(0x0302010007060504ULL, 0x0b0a09080f0e0d0cULL)
+#define SHA256_BYTES_MASK \
+    _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL)
+#define SHA256_WORDS_MASK \
+    _mm_set_epi64x(0x0f0e0d0c0b0a0908ULL, 0x0706050403020100ULL)
+
+/* Four rounds, the next E from the message words m, the message schedule
+ * for the next rounds being computed along by the callers.
+ */
+#define SHA1_NI_ROUNDS(f, e0, e1, m) do { \
+    e0 = _mm_sha1nexte_epu32(e0, m); \
+    e1 = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, f); \
+} while (0)
+
+SHA_TARGET("sha,sse4.1,ssse3")
+static void sha1_ni(apr_uint32_t state[5], const unsigned char *data,
+                    apr_size_t nblocks, int words)
+{
+    const __m128i mask = words ? SHA1_WORDS_MASK : SHA1_BYTES_MASK;
+    __m128i abcd, e0, e1, abcd_save, e0_save;
+    __m128i m0, m1, m2, m3;
+
+    abcd = _mm_loadu_si128((const __m128i *)state);
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while (nblocks--) {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), mask);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)),
+                              mask);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)),
+                              mask);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)),
+                              mask);
+
+        /* 0-3 */
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        /* 4-7 */
+        SHA1_NI_ROUNDS(0, e1, e0, m1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        /* 8-11 */
+        SHA1_NI_ROUNDS(0, e0, e1, m2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+        /* 12-15 */
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        SHA1_NI_ROUNDS(0, e1, e0, m3);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+        /* 16-19 */
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        SHA1_NI_ROUNDS(0, e0, e1, m0);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+        /* 20-23 */
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        SHA1_NI_ROUNDS(1, e1, e0, m1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+        /* 24-27 */
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        SHA1_NI_ROUNDS(1, e0, e1, m2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+        /* 28-31 */
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        SHA1_NI_ROUNDS(1, e1, e0, m3);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+        /* 32-35 */
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        SHA1_NI_ROUNDS(1, e0, e1, m0);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+        /* 36-39 */
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        SHA1_NI_ROUNDS(1, e1, e0, m1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+        /* 40-43 */
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        SHA1_NI_ROUNDS(2, e0, e1, m2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+        /* 44-47 */
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        SHA1_NI_ROUNDS(2, e1, e0, m3);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+        /* 48-51 */
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        SHA1_NI_ROUNDS(2, e0, e1, m0);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+        /* 52-55 */
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        SHA1_NI_ROUNDS(2, e1, e0, m1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+        /* 56-59 */
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        SHA1_NI_ROUNDS(2, e0, e1, m2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+        /* 60-63 */
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        SHA1_NI_ROUNDS(3, e1, e0, m3);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+        /* 64-67 */
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        SHA1_NI_ROUNDS(3, e0, e1, m0);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+        /* 68-71 */
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        SHA1_NI_ROUNDS(3, e1, e0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+        /* 72-75 */
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        SHA1_NI_ROUNDS(3, e0, e1, m2);
+        /* 76-79 */
+        SHA1_NI_ROUNDS(3, e1, e0, m3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+
+        data += 64;
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    _mm_storeu_si128((__m128i *)state, abcd);
+    state[4] = (apr_uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+/* Four rounds with the message words m (W + K), two at a time */
+#define SHA256_NI_ROUNDS(m) do { \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, m); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, \
+                                   _mm_shuffle_epi32(m, 0x0E)); \
+} while (0)
+
+/* The rounds 4i to 4i+3, from the message words mi, computing the next
+ * words of the schedule from mp (the previous ones) into mn along.
+ */
+#define SHA256_NI_SCHEDULE(i, mi, mp, mn) do { \
+    __m128i wk = _mm_add_epi32(mi, \
+                    _mm_loadu_si128((const __m128i *)&sha256_k[4 * (i)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, wk); \
+    mn = _mm_add_epi32(mn, _mm_alignr_epi8(mi, mp, 4)); \
+    mn = _mm_sha256msg2_epu32(mn, mi); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, \
+                                   _mm_shuffle_epi32(wk, 0x0E)); \
+} while (0)
+
+#define SHA256_NI_K(i, m) \
+    _mm_add_epi32(m, _mm_loadu_si128((const __m128i *)&sha256_k[4 * (i)]))
+
+SHA_TARGET("sha,sse4.1,ssse3")
+static void sha256_ni(apr_uint32_t state[8], const unsigned char *data,
+                      apr_size_t nblocks, int words)
+{
+    const __m128i mask = words ? SHA256_WORDS_MASK : SHA256_BYTES_MASK;
+    __m128i state0, state1, save0, save1, tmp;
+    __m128i m0, m1, m2, m3;
+
+    /* ABEF and CDGH, as the instructions want them */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]),
+                               0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (nblocks--) {
+        save0 = state0;
+        save1 = state1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), mask);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)),
+                              mask);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)),
+                              mask);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)),
+                              mask);
+
+        tmp = SHA256_NI_K(0, m0);
+        SHA256_NI_ROUNDS(tmp);
+        tmp = SHA256_NI_K(1, m1);
+        SHA256_NI_ROUNDS(tmp);
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+        tmp = SHA256_NI_K(2, m2);
+        SHA256_NI_ROUNDS(tmp);
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+
+        SHA256_NI_SCHEDULE(3, m3, m2, m0);
+        m2 = _mm_sha256msg1_epu32(m2, m3);
+        SHA256_NI_SCHEDULE(4, m0, m3, m1);
+        m3 = _mm_sha256msg1_epu32(m3, m0);
+        SHA256_NI_SCHEDULE(5, m1, m0, m2);
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+        SHA256_NI_SCHEDULE(6, m2, m1, m3);
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+        SHA256_NI_SCHEDULE(7, m3, m2, m0);
+        m2 = _mm_sha256msg1_epu32(m2, m3);
+        SHA256_NI_SCHEDULE(8, m0, m3, m1);
+        m3 = _mm_sha256msg1_epu32(m3, m0);
+        SHA256_NI_SCHEDULE(9, m1, m0, m2);
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+        SHA256_NI_SCHEDULE(10, m2, m1, m3);
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+        SHA256_NI_SCHEDULE(11, m3, m2, m0);
+        m2 = _mm_sha256msg1_epu32(m2, m3);
+        SHA256_NI_SCHEDULE(12, m0, m3, m1);
+        m3 = _mm_sha256msg1_epu32(m3, m0);
+        SHA256_NI_SCHEDULE(13, m1, m0, m2);
+        SHA256_NI_SCHEDULE(14, m2, m1, m3);
+        tmp = SHA256_NI_K(15, m3);
+        SHA256_NI_ROUNDS(tmp);
+
+        state0 = _mm_add_epi32(state0, save0);
+        state1 = _mm_add_epi32(state1, save1);
+
+        data += 64;
+    }
+
+    /* Back to ABCD and EFGH */
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)state, state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+#define ROTR_X8(x, n) \
+    _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+#define SHA256_X8_ROUND(a, b, c, d, e, f, g, h, j) do { \
+    __m256i t1, t2; \
+    t1 = _mm256_add_epi32(h, _mm256_xor_si256(ROTR_X8(e, 6), \
+                             _mm256_xor_si256(ROTR_X8(e, 11), ROTR_X8(e, 25)))); \
+    t1 = _mm256_add_epi32(t1, _mm256_xor_si256(_mm256_and_si256(e, f), \
+                                               _mm256_andnot_si256(e, g))); \
+    t1 = _mm256_add_epi32(t1, _mm256_add_epi32(w[(j) & 15], \
+                                   _mm256_set1_epi32((int)sha256_k[j]))); \
+    t2 = _mm256_add_epi32(_mm256_xor_si256(ROTR_X8(a, 2), \
+                          _mm256_xor_si256(ROTR_X8(a, 13), ROTR_X8(a, 22))), \
+                          _mm256_or_si256(_mm256_and_si256(a, b), \
+                              _mm256_and_si256(c, _mm256_or_si256(a, b)))); \
+    d = _mm256_add_epi32(d, t1); \
+    h = _mm256_add_epi32(t1, t2); \
+} while (0)
+
+#define SHA256_X8_SCHEDULE(j) do { \
+    __m256i s0 = w[((j) + 1) & 15], s1 = w[((j) + 14) & 15]; \
+    s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR_X8(s0, 7), ROTR_X8(s0, 18)), \
+                          _mm256_srli_epi32(s0, 3)); \
+    s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR_X8(s1, 17), ROTR_X8(s1, 19)), \
+                          _mm256_srli_epi32(s1, 10)); \
+    w[(j) & 15] = _mm256_add_epi32(_mm256_add_epi32(w[(j) & 15], s0), \
+                      _mm256_add_epi32(w[((j) + 9) & 15], s1)); \
+} while (0)
+
+/* Eight 32 bit words of eight rows to eight words of each column */
+#define TRANSPOSE8(r) do { \
+    __m256i t0, t1, t2, t3, t4, t5, t6, t7, u0, u1, u2, u3, u4, u5, u6, u7; \
+    t0 = _mm256_unpacklo_epi32(r[0], r[1]); \
+    t1 = _mm256_unpackhi_epi32(r[0], r[1]); \
+    t2 = _mm256_unpacklo_epi32(r[2], r[3]); \
+    t3 = _mm256_unpackhi_epi32(r[2], r[3]); \
+    t4 = _mm256_unpacklo_epi32(r[4], r[5]); \
+    t5 = _mm256_unpackhi_epi32(r[4], r[5]); \
+    t6 = _mm256_unpacklo_epi32(r[6], r[7]); \
+    t7 = _mm256_unpackhi_epi32(r[6], r[7]); \
+    u0 = _mm256_unpacklo_epi64(t0, t2); \
+    u1 = _mm256_unpackhi_epi64(t0, t2); \
+    u2 = _mm256_unpacklo_epi64(t1, t3); \
+    u3 = _mm256_unpackhi_epi64(t1, t3); \
+    u4 = _mm256_unpacklo_epi64(t4, t6); \
+    u5 = _mm256_unpackhi_epi64(t4, t6); \
+    u6 = _mm256_unpacklo_epi64(t5, t7); \
+    u7 = _mm256_unpackhi_epi64(t5, t7); \
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20); \
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20); \
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20); \
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20); \
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31); \
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31); \
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31); \
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31); \
+} while (0)
+
+/* One block of each of the eight lanes, state[i] holding the word i of
+ * the eight states.
+ */
+SHA_TARGET("avx2")
+static void sha256_x8(apr_uint32_t state[8][8],
+                      const unsigned char *const blocks[8])
+{
+    const __m256i mask = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                           0x0405060700010203ULL,
+                                           0x0c0d0e0f08090a0bULL,
+                                           0x0405060700010203ULL);
+    __m256i a, b, c, d, e, f, g, h, w[16];
+    int i, j;
+
+    for (i = 0; i < 8; i++) {
+        w[i] = _mm256_loadu_si256((const __m256i *)blocks[i]);
+        w[i + 8] = _mm256_loadu_si256((const __m256i *)(blocks[i] + 32));
+    }
+    TRANSPOSE8(w);
+    TRANSPOSE8((w + 8));
+    for (i = 0; i < 16; i++) {
+        w[i] = _mm256_shuffle_epi8(w[i], mask);
+    }
+
+    a = _mm256_loadu_si256((const __m256i *)state[0]);
+    b = _mm256_loadu_si256((const __m256i *)state[1]);
+    c = _mm256_loadu_si256((const __m256i *)state[2]);
+    d = _mm256_loadu_si256((const __m256i *)state[3]);
+    e = _mm256_loadu_si256((const __m256i *)state[4]);
+    f = _mm256_loadu_si256((const __m256i *)state[5]);
+    g = _mm256_loadu_si256((const __m256i *)state[6]);
+    h = _mm256_loadu_si256((const __m256i *)state[7]);
+
+    for (j = 0; j < 64; j += 8) {
+        if (j >= 16) {
+            for (i = 0; i < 8; i++) {
+                SHA256_X8_SCHEDULE(j + i);
+            }
+        }
+        SHA256_X8_ROUND(a, b, c, d, e, f, g, h, j);
+        SHA256_X8_ROUND(h, a, b, c, d, e, f, g, j + 1);
+        SHA256_X8_ROUND(g, h, a, b, c, d, e, f, j + 2);
+        SHA256_X8_ROUND(f, g, h, a, b, c, d, e, j + 3);
+        SHA256_X8_ROUND(e, f, g, h, a, b, c, d, j + 4);
+        SHA256_X8_ROUND(d, e, f, g, h, a, b, c, j + 5);
+        SHA256_X8_ROUND(c, d, e, f, g, h, a, b, j + 6);
+        SHA256_X8_ROUND(b, c, d, e, f, g, h, a, j + 7);
+    }
+
+#define SHA256_X8_ADD(i, x) \
+    _mm256_storeu_si256((__m256i *)state[i], _mm256_add_epi32(x, \
+                        _mm256_loadu_si256((const __m256i *)state[i])))
+    SHA256_X8_ADD(0, a);
+    SHA256_X8_ADD(1, b);
+    SHA256_X8_ADD(2, c);
+    SHA256_X8_ADD(3, d);
+    SHA256_X8_ADD(4, e);
+    SHA256_X8_ADD(5, f);
+    SHA256_X8_ADD(6, g);
+    SHA256_X8_ADD(7, h);
+#undef SHA256_X8_ADD
+}
+
+#endif /* SHA_X86 */
+
+#if SHA_ARM
+
+/* Four rounds of the function op, from the message words plus constant
+ * wk, e1 taking the E of the next rounds.
+ */
+#define SHA1_ARM_ROUNDS(op, e0, e1, wk) do { \
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+    abcd = op(abcd, e0, wk); \
+} while (0)
+
+SHA_ARM_TARGET
+static void sha1_arm(apr_uint32_t state[5], const unsigned char *data,
+                     apr_size_t nblocks, int words)
+{
+    const uint32x4_t k0 = vdupq_n_u32(0x5A827999);
+    const uint32x4_t k1 = vdupq_n_u32(0x6ED9EBA1);
+    const uint32x4_t k2 = vdupq_n_u32(0x8F1BBCDC);
+    const uint32x4_t k3 = vdupq_n_u32(0xCA62C1D6);
+    uint32x4_t abcd, abcd_save, m0, m1, m2, m3, wk0, wk1;
+    uint32_t e0, e1, e0_save;
+
+    abcd = vld1q_u32(state);
+    e0 = state[4];
+
+    while (nblocks--) {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        m0 = vld1q_u32((const uint32_t *)data);
+        m1 = vld1q_u32((const uint32_t *)(data + 16));
+        m2 = vld1q_u32((const uint32_t *)(data + 32));
+        m3 = vld1q_u32((const uint32_t *)(data + 48));
+        if (!words) {
+            m0 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m0)));
+            m1 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m1)));
+            m2 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m2)));
+            m3 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m3)));
+        }
+
+        wk0 = vaddq_u32(m0, k0);
+        wk1 = vaddq_u32(m1, k0);
+
+        /* 0-3 */
+        SHA1_ARM_ROUNDS(vsha1cq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m2, k0);
+        m0 = vsha1su0q_u32(m0, m1, m2);
+        /* 4-7 */
+        SHA1_ARM_ROUNDS(vsha1cq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m3, k0);
+        m0 = vsha1su1q_u32(m0, m3);
+        m1 = vsha1su0q_u32(m1, m2, m3);
+        /* 8-11 */
+        SHA1_ARM_ROUNDS(vsha1cq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m0, k0);
+        m1 = vsha1su1q_u32(m1, m0);
+        m2 = vsha1su0q_u32(m2, m3, m0);
+        /* 12-15 */
+        SHA1_ARM_ROUNDS(vsha1cq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m1, k1);
+        m2 = vsha1su1q_u32(m2, m1);
+        m3 = vsha1su0q_u32(m3, m0, m1);
+        /* 16-19 */
+        SHA1_ARM_ROUNDS(vsha1cq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m2, k1);
+        m3 = vsha1su1q_u32(m3, m2);
+        m0 = vsha1su0q_u32(m0, m1, m2);
+        /* 20-23 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m3, k1);
+        m0 = vsha1su1q_u32(m0, m3);
+        m1 = vsha1su0q_u32(m1, m2, m3);
+        /* 24-27 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m0, k1);
+        m1 = vsha1su1q_u32(m1, m0);
+        m2 = vsha1su0q_u32(m2, m3, m0);
+        /* 28-31 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m1, k1);
+        m2 = vsha1su1q_u32(m2, m1);
+        m3 = vsha1su0q_u32(m3, m0, m1);
+        /* 32-35 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m2, k2);
+        m3 = vsha1su1q_u32(m3, m2);
+        m0 = vsha1su0q_u32(m0, m1, m2);
+        /* 36-39 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m3, k2);
+        m0 = vsha1su1q_u32(m0, m3);
+        m1 = vsha1su0q_u32(m1, m2, m3);
+        /* 40-43 */
+        SHA1_ARM_ROUNDS(vsha1mq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m0, k2);
+        m1 = vsha1su1q_u32(m1, m0);
+        m2 = vsha1su0q_u32(m2, m3, m0);
+        /* 44-47 */
+        SHA1_ARM_ROUNDS(vsha1mq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m1, k2);
+        m2 = vsha1su1q_u32(m2, m1);
+        m3 = vsha1su0q_u32(m3, m0, m1);
+        /* 48-51 */
+        SHA1_ARM_ROUNDS(vsha1mq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m2, k2);
+        m3 = vsha1su1q_u32(m3, m2);
+        m0 = vsha1su0q_u32(m0, m1, m2);
+        /* 52-55 */
+        SHA1_ARM_ROUNDS(vsha1mq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m3, k3);
+        m0 = vsha1su1q_u32(m0, m3);
+        m1 = vsha1su0q_u32(m1, m2, m3);
+        /* 56-59 */
+        SHA1_ARM_ROUNDS(vsha1mq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m0, k3);
+        m1 = vsha1su1q_u32(m1, m0);
+        m2 = vsha1su0q_u32(m2, m3, m0);
+        /* 60-63 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m1, k3);
+        m2 = vsha1su1q_u32(m2, m1);
+        m3 = vsha1su0q_u32(m3, m0, m1);
+        /* 64-67 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e0, e1, wk0);
+        wk0 = vaddq_u32(m2, k3);
+        m3 = vsha1su1q_u32(m3, m2);
+        /* 68-71 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e1, e0, wk1);
+        wk1 = vaddq_u32(m3, k3);
+        /* 72-75 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e0, e1, wk0);
+        /* 76-79 */
+        SHA1_ARM_ROUNDS(vsha1pq_u32, e1, e0, wk1);
+
+        e0 += e0_save;
+        abcd = vaddq_u32(abcd, abcd_save);
+
+        data += 64;
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e0;
+}
+
+/* Four rounds from the message words plus constants wk, the words being
+ * scheduled along by the callers.
+ */
+#define SHA256_ARM_ROUNDS(wk) do { \
+    uint32x4_t s0 = state0; \
+    state0 = vsha256hq_u32(state0, state1, wk); \
+    state1 = vsha256h2q_u32(state1, s0, wk); \
+} while (0)
+
+/* The rounds 4i to 4i+3 from m0 (plus constants in wk), m0 becoming the
+ * words of the rounds 4i+16 to 4i+19 from the next ones m1, m2 and m3.
+ */
+#define SHA256_ARM_SCHEDULE(i, m0, m1, m2, m3) do { \
+    uint32x4_t wk = vaddq_u32(m0, vld1q_u32(&sha256_k[4 * (i)])); \
+    m0 = vsha256su0q_u32(m0, m1); \
+    SHA256_ARM_ROUNDS(wk); \
+    m0 = vsha256su1q_u32(m0, m2, m3); \
+} while (0)
+
+#define SHA256_ARM_LAST(i, m) \
+    SHA256_ARM_ROUNDS(vaddq_u32(m, vld1q_u32(&sha256_k[4 * (i)])))
+
+SHA_ARM_TARGET
+static void sha256_arm(apr_uint32_t state[8], const unsigned char *data,
+                       apr_size_t nblocks, int words)
+{
+    uint32x4_t state0, state1, save0, save1, m0, m1, m2, m3;
+
+    state0 = vld1q_u32(state);
+    state1 = vld1q_u32(&state[4]);
+
+    while (nblocks--) {
+        save0 = state0;
+        save1 = state1;
+
+        m0 = vld1q_u32((const uint32_t *)data);
+        m1 = vld1q_u32((const uint32_t *)(data + 16));
+        m2 = vld1q_u32((const uint32_t *)(data + 32));
+        m3 = vld1q_u32((const uint32_t *)(data + 48));
+        if (!words) {
+            m0 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m0)));
+            m1 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m1)));
+            m2 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m2)));
+            m3 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(m3)));
+        }
+
+        SHA256_ARM_SCHEDULE(0, m0, m1, m2, m3);
+        SHA256_ARM_SCHEDULE(1, m1, m2, m3, m0);
+        SHA256_ARM_SCHEDULE(2, m2, m3, m0, m1);
+        SHA256_ARM_SCHEDULE(3, m3, m0, m1, m2);
+        SHA256_ARM_SCHEDULE(4, m0, m1, m2, m3);
+        SHA256_ARM_SCHEDULE(5, m1, m2, m3, m0);
+        SHA256_ARM_SCHEDULE(6, m2, m3, m0, m1);
+        SHA256_ARM_SCHEDULE(7, m3, m0, m1, m2);
+        SHA256_ARM_SCHEDULE(8, m0, m1, m2, m3);
+        SHA256_ARM_SCHEDULE(9, m1, m2, m3, m0);
+        SHA256_ARM_SCHEDULE(10, m2, m3, m0, m1);
+        SHA256_ARM_SCHEDULE(11, m3, m0, m1, m2);
+        SHA256_ARM_LAST(12, m0);
+        SHA256_ARM_LAST(13, m1);
+        SHA256_ARM_LAST(14, m2);
+        SHA256_ARM_LAST(15, m3);
+
+        state0 = vaddq_u32(state0, save0);
+        state1 = vaddq_u32(state1, save1);
+
+        data += 64;
+    }
+
+    vst1q_u32(state, state0);
+    vst1q_u32(&state[4], state1);
+}
+
+#endif /* SHA_ARM */
+
+apr_size_t apr__sha1_blocks(apr_uint32_t state[5], const void *data,
+                            apr_size_t nblocks, int words)
+{
+#if SHA_X86
+    if (sha_level() & SHA_NI) {
+        sha1_ni(state, data, nblocks, words);
+        return nblocks;
+    }
+#elif SHA_ARM_DETECT
+    /* glibc caches the hwcaps, this is cheap */
+    if (getauxval(AT_HWCAP) & HWCAP_SHA1) {
+        sha1_arm(state, data, nblocks, words);
+        return nblocks;
+    }
+#elif SHA_ARM
+    sha1_arm(state, data, nblocks, words);
+    return nblocks;
+#endif
+    return 0;
+}
+
+apr_size_t apr__sha256_blocks(apr_uint32_t state[8], const void *data,
+                              apr_size_t nblocks, int words)
+{
+#if SHA_X86
+    if (sha_level() & SHA_NI) {
+        sha256_ni(state, data, nblocks, words);
+        return nblocks;
+    }
+#elif SHA_ARM_DETECT
+    if (getauxval(AT_HWCAP) & HWCAP_SHA2) {
+        sha256_arm(state, data, nblocks, words);
+        return nblocks;
+    }
+#elif SHA_ARM
+    sha256_arm(state, data, nblocks, words);
+    return nblocks;
+#endif
+    return 0;
+}
+
+#if SHA_X86
+
+static const apr_uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* An input being hashed in a lane: the whole blocks of its buffer, then
+ * the one or two padded blocks of its tail.
+ */
+typedef struct {
+    const unsigned char *next;
+    apr_size_t blocks;
+    int ntails;
+    int tails;
+    apr_size_t input;
+    unsigned char tail[128];
+} sha256_lane_t;
+
+static void sha256_lane_start(sha256_lane_t *lane, apr_uint32_t state[8][8],
+                              int l, const struct iovec *vec, apr_size_t i)
+{
+    const unsigned char *buf = vec[i].iov_base;
+    apr_size_t len = vec[i].iov_len, rest = len % 64;
+    apr_uint64_t bits = (apr_uint64_t)len << 3;
+    int j;
+
+    lane->input = i;
+    lane->next = buf;
+    lane->blocks = len / 64;
+    lane->ntails = lane->tails = rest < 56 ? 1 : 2;
+    if (rest) {
+        memcpy(lane->tail, buf + len - rest, rest);
+    }
+    lane->tail[rest] = 0x80;
+    memset(lane->tail + rest + 1, 0, lane->ntails * 64 - rest - 9);
+    for (j = 0; j < 8; j++) {
+        lane->tail[lane->ntails * 64 - 1 - j] = (unsigned char)(bits >> 8 * j);
+    }
+
+    for (j = 0; j < 8; j++) {
+        state[j][l] = sha256_h0[j];
+    }
+}
+
+apr_size_t apr__sha256_multi(unsigned char (*digests)[32],
+                             const struct iovec *vec, apr_size_t n)
+{
+    static const unsigned char idle[64];
+    sha256_lane_t lanes[8];
+    const unsigned char *blocks[8];
+    apr_uint32_t state[8][8];
+    apr_size_t next = 0;
+    int l, j, active = 0;
+
+    /* A single input is better hashed the usual way, and so are many
+     * with the SHA instructions which outrun the eight lanes.
+     */
+    if (n < 2 || (sha_level() & (SHA_NI | SHA_AVX2)) != SHA_AVX2) {
+        return 0;
+    }
+
+    for (l = 0; l < 8; l++) {
+        if (next < n) {
+            sha256_lane_start(&lanes[l], state, l, vec, next++);
+            active++;
+        }
+        else {
+            lanes[l].input = n;
+        }
+    }
+
+    while (active) {
+        for (l = 0; l < 8; l++) {
+            sha256_lane_t *lane = &lanes[l];
+
+            if (lane->input == n) {
+                blocks[l] = idle;
+            }
+            else if (lane->blocks) {
+                blocks[l] = lane->next;
+            }
+            else {
+                blocks[l] = lane->tail + 64 * (lane->ntails - lane->tails);
+            }
+        }
+        sha256_x8(state, blocks);
+
+        for (l = 0; l < 8; l++) {
+            sha256_lane_t *lane = &lanes[l];
+
+            if (lane->input == n) {
+                continue;
+            }
+            if (lane->blocks) {
+                lane->next += 64;
+                lane->blocks--;
+                continue;
+            }
+            if (--lane->tails) {
+                continue;
+            }
+            for (j = 0; j < 8; j++) {
+                apr_uint32_t s = state[j][l];
+
+                digests[lane->input][4 * j] = (unsigned char)(s >> 24);
+                digests[lane->input][4 * j + 1] = (unsigned char)(s >> 16);
+                digests[lane->input][4 * j + 2] = (unsigned char)(s >> 8);
+                digests[lane->input][4 * j + 3] = (unsigned char)s;
+            }
+            if (next < n) {
+                sha256_lane_start(lane, state, l, vec, next++);
+            }
+            else {
+                lane->input = n;
+                active--;
+            }
+        }
+    }
+
+    return n;
+}
+
+#else /* !SHA_X86 */
+
+apr_size_t apr__sha256_multi(unsigned char (*digests)[32],
+                             const struct iovec *vec, apr_size_t n)
+{
+    return 0;
+}
+
+#endif /* SHA_X86 */
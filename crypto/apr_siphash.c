@@ -21,6 +21,18 @@
 
 #include "apr_siphash.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+        && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define SIPHASH_X86 1
+#define SIPHASH_TARGET(t) __attribute__((target(t)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#include <immintrin.h>
+#include <intrin.h>
+#define SIPHASH_X86 1
+#define SIPHASH_TARGET(t)
+#endif
+
 #define ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
 
 #define U8TO64_LE(p) \
@@ -194,3 +206,268 @@ APR_DECLARE(void) apr_siphash48_auth(unsigned char out[APR_SIPHASH_DSIZE],
     U64TO8_LE(out, h);
 }
 
+
+APR_DECLARE(void) apr_siphash24_128(apr_uint64_t out[2],
+                                    const void *src, apr_size_t len,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    const unsigned char *ptr, *end, *s = src;
+    apr_uint64_t v0, v1, v2, v3, m;
+    apr_uint64_t k0, k1;
+    unsigned int rem;
+
+    k0 = U8TO64_LE(key + 0);
+    k1 = U8TO64_LE(key + 8);
+    v3 = k1 ^ (apr_uint64_t)0x7465646279746573ULL;
+    v2 = k0 ^ (apr_uint64_t)0x6c7967656e657261ULL;
+    v1 = k1 ^ (apr_uint64_t)0x646f72616e646f6dULL ^ 0xee;
+    v0 = k0 ^ (apr_uint64_t)0x736f6d6570736575ULL;
+
+    rem = (unsigned int)(len & 0x7);
+    for (ptr = s, end = ptr + len - rem; ptr < end; ptr += 8) {
+        m = U8TO64_LE(ptr);
+        v3 ^= m;
+        SIPROUND();
+        SIPROUND();
+        v0 ^= m;
+    }
+    m = (apr_uint64_t)(len & 0xff) << 56;
+    switch (rem) {
+        case 7: m |= (apr_uint64_t)ptr[6] << 48;
+        case 6: m |= (apr_uint64_t)ptr[5] << 40;
+        case 5: m |= (apr_uint64_t)ptr[4] << 32;
+        case 4: m |= (apr_uint64_t)ptr[3] << 24;
+        case 3: m |= (apr_uint64_t)ptr[2] << 16;
+        case 2: m |= (apr_uint64_t)ptr[1] << 8;
+        case 1: m |= (apr_uint64_t)ptr[0];
+        case 0: break;
+    }
+    v3 ^= m;
+    SIPROUND();
+    SIPROUND();
+    v0 ^= m;
+
+    v2 ^= 0xee;
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    out[0] = v0 ^ v1 ^ v2 ^ v3;
+
+    v1 ^= 0xdd;
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    out[1] = v0 ^ v1 ^ v2 ^ v3;
+}
+
+APR_DECLARE(void) apr_siphash24_128_auth(unsigned char out[APR_SIPHASH128_DSIZE],
+                                         const void *src, apr_size_t len,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    apr_uint64_t h[2];
+    apr_siphash24_128(h, src, len, key);
+    U64TO8_LE(out, h[0]);
+    U64TO8_LE(out + 8, h[1]);
+}
+
+#if SIPHASH_X86
+
+/* Whether the CPU (and OS) supports AVX2, a benign race */
+static int siphash_avx2(void)
+{
+    static int avx2 = -1;
+
+    if (avx2 < 0) {
+#if defined(_MSC_VER)
+        int info[4];
+
+        avx2 = 0;
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            if ((info[2] & (3 << 27)) == (3 << 27)
+                    && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+        }
+#else
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+
+    return avx2;
+}
+
+#define ROTL64X4(x, n) \
+    _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+#define ROTL64X4_16(x) _mm256_shuffle_epi8(x, rot16)
+#define ROTL64X4_32(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+
+#define SIPROUNDX4(v0, v1, v2, v3) \
+do { \
+    v0 = _mm256_add_epi64(v0, v1); v1 = ROTL64X4(v1, 13); \
+    v1 = _mm256_xor_si256(v1, v0); v0 = ROTL64X4_32(v0); \
+    v2 = _mm256_add_epi64(v2, v3); v3 = ROTL64X4_16(v3); \
+    v3 = _mm256_xor_si256(v3, v2); \
+    v0 = _mm256_add_epi64(v0, v3); v3 = ROTL64X4(v3, 21); \
+    v3 = _mm256_xor_si256(v3, v0); \
+    v2 = _mm256_add_epi64(v2, v1); v1 = ROTL64X4(v1, 17); \
+    v1 = _mm256_xor_si256(v1, v2); v2 = ROTL64X4_32(v2); \
+} while (0)
+
+/* The last word of a message: its tail and its length */
+static apr_uint64_t siphash_last(const unsigned char *s, apr_size_t len)
+{
+    const unsigned char *ptr = s + (len & ~(apr_size_t)7);
+    apr_uint64_t m = (apr_uint64_t)(len & 0xff) << 56;
+
+    switch (len & 0x7) {
+        case 7: m |= (apr_uint64_t)ptr[6] << 48;
+        case 6: m |= (apr_uint64_t)ptr[5] << 40;
+        case 5: m |= (apr_uint64_t)ptr[4] << 32;
+        case 4: m |= (apr_uint64_t)ptr[3] << 24;
+        case 3: m |= (apr_uint64_t)ptr[2] << 16;
+        case 2: m |= (apr_uint64_t)ptr[1] << 8;
+        case 1: m |= (apr_uint64_t)ptr[0];
+        case 0: break;
+    }
+
+    return m;
+}
+
+#define SIPHASH_LANES 8
+
+/* The word i of the message of lane l, or its last word */
+#define SIPHASH_WORD(l) U8TO64_LE(i < words[l] ? msg[l] + 8 * i \
+                                  : (const unsigned char *)&last[l])
+
+/* SipHash-2-4 of eight messages in the lanes of two sets of AVX2
+ * registers, whose rounds interleave for the latency of one to hide that
+ * of the other.  The words all the messages have are compressed first,
+ * then those of the longer ones while the lanes of the shorter ones are
+ * kept as they are.
+ */
+SIPHASH_TARGET("avx2")
+static void siphash24_x8(apr_uint64_t out[SIPHASH_LANES],
+                         const struct iovec vec[SIPHASH_LANES],
+                         const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    const __m256i rot16 = _mm256_set_epi64x(0x0d0c0b0a09080f0eULL,
+                                            0x0504030201000706ULL,
+                                            0x0d0c0b0a09080f0eULL,
+                                            0x0504030201000706ULL);
+    const unsigned char *msg[SIPHASH_LANES];
+    apr_uint64_t last[SIPHASH_LANES];
+    apr_size_t words[SIPHASH_LANES], minw = APR_SIZE_MAX, maxw = 0, i;
+    apr_uint64_t k0 = U8TO64_LE(key), k1 = U8TO64_LE(key + 8);
+    __m256i a0, a1, a2, a3, b0, b1, b2, b3, ma, mb, wa, wb;
+    int l;
+
+    for (l = 0; l < SIPHASH_LANES; l++) {
+        msg[l] = vec[l].iov_base;
+        words[l] = vec[l].iov_len / 8;
+        last[l] = siphash_last(msg[l], vec[l].iov_len);
+        if (words[l] < minw) {
+            minw = words[l];
+        }
+        if (words[l] > maxw) {
+            maxw = words[l];
+        }
+    }
+
+    a3 = b3 = _mm256_set1_epi64x(k1 ^ (apr_uint64_t)0x7465646279746573ULL);
+    a2 = b2 = _mm256_set1_epi64x(k0 ^ (apr_uint64_t)0x6c7967656e657261ULL);
+    a1 = b1 = _mm256_set1_epi64x(k1 ^ (apr_uint64_t)0x646f72616e646f6dULL);
+    a0 = b0 = _mm256_set1_epi64x(k0 ^ (apr_uint64_t)0x736f6d6570736575ULL);
+
+#define SIPCOMPRESSX8() \
+do { \
+    a3 = _mm256_xor_si256(a3, ma); \
+    b3 = _mm256_xor_si256(b3, mb); \
+    SIPROUNDX4(a0, a1, a2, a3); \
+    SIPROUNDX4(b0, b1, b2, b3); \
+    SIPROUNDX4(a0, a1, a2, a3); \
+    SIPROUNDX4(b0, b1, b2, b3); \
+    a0 = _mm256_xor_si256(a0, ma); \
+    b0 = _mm256_xor_si256(b0, mb); \
+} while (0)
+
+    for (i = 0; i < minw; i++) {
+        ma = _mm256_set_epi64x(U8TO64_LE(msg[3] + 8 * i),
+                               U8TO64_LE(msg[2] + 8 * i),
+                               U8TO64_LE(msg[1] + 8 * i),
+                               U8TO64_LE(msg[0] + 8 * i));
+        mb = _mm256_set_epi64x(U8TO64_LE(msg[7] + 8 * i),
+                               U8TO64_LE(msg[6] + 8 * i),
+                               U8TO64_LE(msg[5] + 8 * i),
+                               U8TO64_LE(msg[4] + 8 * i));
+        SIPCOMPRESSX8();
+    }
+
+    /* The lanes still compressing are those with more words than i */
+    wa = _mm256_set_epi64x(words[3] + 1, words[2] + 1,
+                           words[1] + 1, words[0] + 1);
+    wb = _mm256_set_epi64x(words[7] + 1, words[6] + 1,
+                           words[5] + 1, words[4] + 1);
+    for (; i <= maxw; i++) {
+        const __m256i s0 = a0, s1 = a1, s2 = a2, s3 = a3;
+        const __m256i t0 = b0, t1 = b1, t2 = b2, t3 = b3;
+        const __m256i iv = _mm256_set1_epi64x(i);
+        __m256i ka, kb;
+
+        ma = _mm256_set_epi64x(SIPHASH_WORD(3), SIPHASH_WORD(2),
+                               SIPHASH_WORD(1), SIPHASH_WORD(0));
+        mb = _mm256_set_epi64x(SIPHASH_WORD(7), SIPHASH_WORD(6),
+                               SIPHASH_WORD(5), SIPHASH_WORD(4));
+        ka = _mm256_cmpgt_epi64(wa, iv);
+        kb = _mm256_cmpgt_epi64(wb, iv);
+        SIPCOMPRESSX8();
+        a0 = _mm256_blendv_epi8(s0, a0, ka);
+        a1 = _mm256_blendv_epi8(s1, a1, ka);
+        a2 = _mm256_blendv_epi8(s2, a2, ka);
+        a3 = _mm256_blendv_epi8(s3, a3, ka);
+        b0 = _mm256_blendv_epi8(t0, b0, kb);
+        b1 = _mm256_blendv_epi8(t1, b1, kb);
+        b2 = _mm256_blendv_epi8(t2, b2, kb);
+        b3 = _mm256_blendv_epi8(t3, b3, kb);
+    }
+
+#undef SIPCOMPRESSX8
+
+    a2 = _mm256_xor_si256(a2, _mm256_set1_epi64x(0xff));
+    b2 = _mm256_xor_si256(b2, _mm256_set1_epi64x(0xff));
+    for (l = 0; l < 4; l++) {
+        SIPROUNDX4(a0, a1, a2, a3);
+        SIPROUNDX4(b0, b1, b2, b3);
+    }
+
+    _mm256_storeu_si256((__m256i *)out, _mm256_xor_si256(
+                        _mm256_xor_si256(a0, a1), _mm256_xor_si256(a2, a3)));
+    _mm256_storeu_si256((__m256i *)(out + 4), _mm256_xor_si256(
+                        _mm256_xor_si256(b0, b1), _mm256_xor_si256(b2, b3)));
+}
+
+#endif /* SIPHASH_X86 */
+
+APR_DECLARE(void) apr_siphash24_batch(apr_uint64_t *out,
+                                      const struct iovec *vec, apr_size_t n,
+                               const unsigned char key[APR_SIPHASH_KSIZE])
+{
+    apr_size_t i = 0;
+
+#if SIPHASH_X86
+    if (n >= SIPHASH_LANES && siphash_avx2()) {
+        for (; i + SIPHASH_LANES <= n; i += SIPHASH_LANES) {
+            siphash24_x8(out + i, vec + i, key);
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = apr_siphash24(vec[i].iov_base, vec[i].iov_len, key);
+    }
+}
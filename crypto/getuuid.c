@@ -23,6 +23,9 @@
 #include "apr_md5.h"
 #include "apr_general.h"
 #include "apr_portable.h"
+#include "apr_time.h"
+#include "apr_thread_proc.h"
+#include "apr_crypto.h"
 
 
 #if APR_HAVE_UNISTD_H
@@ -206,3 +209,82 @@ APR_DECLARE(void) apr_uuid_get(apr_uuid_t *uuid)
     /* node, byte[6] */
     memcpy(&d[10], uuid_state_node, NODE_LENGTH);
 }
+
+/* The random bits of the v4 and v7 UUIDs, from the CPRNG of the thread when
+ * apr_crypto_prng_init() allows, taking no lock nor system call.
+ */
+static apr_status_t uuid_random(unsigned char *buf, apr_size_t len)
+{
+#if APU_HAVE_CRYPTO && APU_HAVE_CRYPTO_PRNG && APR_HAS_THREADS
+    if (apr_crypto_random_thread_bytes(buf, len) == APR_SUCCESS) {
+        return APR_SUCCESS;
+    }
+#endif
+#if APR_HAS_RANDOM
+    return apr_generate_random_bytes(buf, len);
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_uuid_get_v4(apr_uuid_t *uuid)
+{
+    unsigned char *d = uuid->data;
+    apr_status_t rv;
+
+    rv = uuid_random(d, sizeof(uuid->data));
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    d[6] = (d[6] & 0x0F) | 0x40;
+    d[8] = (d[8] & 0x3F) | 0x80;
+
+    return APR_SUCCESS;
+}
+
+#if APR_HAS_THREADS && APR_HAS_THREAD_LOCAL
+/* The last timestamp of the thread, for its UUIDs to be strictly ordered */
+static APR_THREAD_LOCAL apr_uint64_t uuid_v7_last;
+#define UUID_V7_MONOTONIC 1
+#elif !APR_HAS_THREADS
+static apr_uint64_t uuid_v7_last;
+#define UUID_V7_MONOTONIC 1
+#endif
+
+APR_DECLARE(apr_status_t) apr_uuid_get_v7(apr_uuid_t *uuid)
+{
+    unsigned char *d = uuid->data;
+    apr_time_t now = apr_time_now();
+    apr_uint64_t ts;
+    apr_status_t rv;
+
+    /* The unix time in milliseconds (48 bits), then its fraction in 1/4096
+     * (12 bits, rand_a of RFC 9562's method 3).
+     */
+    ts = ((apr_uint64_t)apr_time_as_msec(now) << 12)
+         | (apr_uint64_t)((now % 1000) * 4096 / 1000);
+#ifdef UUID_V7_MONOTONIC
+    if (ts <= uuid_v7_last) {
+        ts = uuid_v7_last + 1;
+    }
+    uuid_v7_last = ts;
+#endif
+
+    rv = uuid_random(d + 8, 8);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    d[0] = (unsigned char)(ts >> 52);
+    d[1] = (unsigned char)(ts >> 44);
+    d[2] = (unsigned char)(ts >> 36);
+    d[3] = (unsigned char)(ts >> 28);
+    d[4] = (unsigned char)(ts >> 20);
+    d[5] = (unsigned char)(ts >> 12);
+    d[6] = (unsigned char)(((ts >> 8) & 0x0F) | 0x70);
+    d[7] = (unsigned char)ts;
+    d[8] = (d[8] & 0x3F) | 0x80;
+
+    return APR_SUCCESS;
+}
@@ -14,22 +14,39 @@
  * limitations under the License.
  */
 
-#include <stdio.h>      /* for sprintf */
-
 #include "apr.h"
 #include "apr_uuid.h"
 #include "apr_errno.h"
 #include "apr_lib.h"
-
+#include "apr_encode_private.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
 
 APR_DECLARE(void) apr_uuid_format(char *buffer, const apr_uuid_t *uuid)
 {
+    static const char digits[] = "0123456789abcdef";
     const unsigned char *d = uuid->data;
+    char hex[32];
+    int i;
+
+    /* The 32 digits at once if the CPU can, then the dashes in */
+    if (apr__encode_base16_blocks(hex, d, 16, 1) != 16) {
+        for (i = 0; i < 16; ++i) {
+            hex[2 * i] = digits[d[i] >> 4];
+            hex[2 * i + 1] = digits[d[i] & 0x0F];
+        }
+    }
 
-    sprintf(buffer,
-            "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
-            d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7],
-            d[8], d[9], d[10], d[11], d[12], d[13], d[14], d[15]);
+    memcpy(buffer, hex, 8);
+    buffer[8] = '-';
+    memcpy(buffer + 9, hex + 8, 4);
+    buffer[13] = '-';
+    memcpy(buffer + 14, hex + 12, 4);
+    buffer[18] = '-';
+    memcpy(buffer + 19, hex + 16, 4);
+    buffer[23] = '-';
+    memcpy(buffer + 24, hex + 20, 12);
+    buffer[36] = '\0';
 }
 
 /* convert a pair of hex digits to an integer value [0,255] */
@@ -96,6 +113,22 @@ APR_DECLARE(apr_status_t) apr_uuid_parse(apr_uuid_t *uuid,
 {
     int i;
     unsigned char *d = uuid->data;
+    unsigned char hex[32];
+
+    if (memchr(uuid_str, '\0', 37) == uuid_str + 36
+            && uuid_str[8] == '-' && uuid_str[13] == '-'
+            && uuid_str[18] == '-' && uuid_str[23] == '-') {
+        /* Validate and decode the 32 digits at once if the CPU can */
+        memcpy(hex, uuid_str, 8);
+        memcpy(hex + 8, uuid_str + 9, 4);
+        memcpy(hex + 12, uuid_str + 14, 4);
+        memcpy(hex + 16, uuid_str + 19, 4);
+        memcpy(hex + 20, uuid_str + 24, 12);
+        if (apr__decode_base16_valid(hex, 32) == 32
+                && apr__decode_base16_blocks(d, hex, 32) == 32) {
+            return APR_SUCCESS;
+        }
+    }
 
     for (i = 0; i < 36; ++i) {
         char c = uuid_str[i];
@@ -27,12 +27,17 @@
 #include "apr_lib.h"
 #include "apr_atomic.h"
 #include "apr_version.h"
+#include "apr_ring.h"
 
 #include "apu_internal.h"
 #include "apr_dbd_internal.h"
 #include "apr_dbd.h"
 
 static apr_hash_t *drivers = NULL;
+#if APR_HAVE_MODULAR_DSO
+/* The drivers of the hash, for lookups without the dso mutex */
+static apu_dso_driver_t *volatile loaded = NULL;
+#endif
 static apr_uint32_t initialised = 0, in_init = 1;
 
 #define CLEANUP_CAST (apr_status_t (*)(void*))
@@ -79,6 +84,9 @@ static apr_status_t apr_dbd_term(void *ptr)
 {
     /* set drivers to NULL so init can work again */
     drivers = NULL;
+#if APR_HAVE_MODULAR_DSO
+    loaded = NULL;
+#endif
 
     /* Everything else we need is handled by cleanups registered
      * when we created mutexes and loaded DSOs
@@ -162,6 +170,11 @@ APR_DECLARE(apr_status_t) apr_dbd_get_driver(apr_pool_t *pool, const char *name,
     apr_status_t rv;
 
 #if APR_HAVE_MODULAR_DSO
+    *driver = apu_dso_driver_get(&loaded, name);
+    if (*driver) {
+        return APR_SUCCESS;
+    }
+
     rv = apu_dso_mutex_lock();
     if (rv) {
         return rv;
@@ -199,6 +212,7 @@ APR_DECLARE(apr_status_t) apr_dbd_get_driver(apr_pool_t *pool, const char *name,
         if ((*driver)->init) {
             (*driver)->init(pool);
         }
+        apu_dso_driver_set(&loaded, name, *driver, pool);
     }
     apu_dso_mutex_unlock();
 
@@ -570,3 +584,325 @@ APR_DECLARE(apr_status_t) apr_dbd_datum_get(const apr_dbd_driver_t *driver,
 {
     return driver->datum_get(row,col,type,data);
 }
+
+APR_DECLARE(int) apr_dbd_send_query(const apr_dbd_driver_t *driver,
+                                    apr_pool_t *pool, apr_dbd_t *handle,
+                                    apr_dbd_prepared_t *statement,
+                                    const char **args)
+{
+    if (!driver->send_query) {
+        return APR_ENOTIMPL;
+    }
+    return driver->send_query(pool,handle,statement,args);
+}
+
+APR_DECLARE(int) apr_dbd_poll_result(const apr_dbd_driver_t *driver,
+                                     apr_pool_t *pool, apr_dbd_t *handle,
+                                     apr_dbd_results_t **res, int *nrows,
+                                     int block)
+{
+    apr_dbd_results_t *dummy_res = NULL;
+    int dummy_nrows;
+
+    if (!driver->poll_result) {
+        return APR_ENOTIMPL;
+    }
+    return driver->poll_result(pool,handle,res ? res : &dummy_res,
+                               nrows ? nrows : &dummy_nrows,block);
+}
+
+APR_DECLARE(apr_status_t) apr_dbd_socket_get(const apr_dbd_driver_t *driver,
+                                             apr_pool_t *pool,
+                                             apr_dbd_t *handle,
+                                             apr_socket_t **sock)
+{
+    if (!driver->socket_get) {
+        return APR_ENOTIMPL;
+    }
+    return driver->socket_get(pool,handle,sock);
+}
+
+/* the statements cached, unlabelled ones in least recently used order */
+typedef struct dbd_stmt_t dbd_stmt_t;
+struct dbd_stmt_t {
+    APR_RING_ENTRY(dbd_stmt_t) link;
+    apr_pool_t *pool;
+    apr_dbd_prepared_t *statement;
+    const char *key;
+    apr_size_t klen;
+    int labelled;
+};
+
+struct apr_dbd_stmt_cache_t {
+    apr_pool_t *pool;
+    const apr_dbd_driver_t *driver;
+    apr_dbd_t *handle;
+    apr_hash_t *stmts;
+    APR_RING_HEAD(dbd_stmt_ring_t, dbd_stmt_t) lru;
+    apr_size_t nlru;
+    apr_size_t max;
+    char *kbuf;                 /* to look the keys up */
+    apr_size_t kbufsz;
+};
+
+static void dbd_stmt_drop(apr_dbd_stmt_cache_t *cache, dbd_stmt_t *stmt)
+{
+    apr_hash_set(cache->stmts, stmt->key, stmt->klen, NULL);
+    if (!stmt->labelled) {
+        APR_RING_REMOVE(stmt, link);
+        cache->nlru--;
+    }
+    apr_pool_destroy(stmt->pool);
+}
+
+APR_DECLARE(apr_status_t) apr_dbd_stmt_cache_create(
+                                            apr_dbd_stmt_cache_t **cache,
+                                            const apr_dbd_driver_t *driver,
+                                            apr_dbd_t *handle,
+                                            apr_size_t max,
+                                            apr_pool_t *pool)
+{
+    apr_dbd_stmt_cache_t *c = apr_pcalloc(pool, sizeof(*c));
+
+    c->pool = pool;
+    c->driver = driver;
+    c->handle = handle;
+    c->stmts = apr_hash_make(pool);
+    APR_RING_INIT(&c->lru, dbd_stmt_t, link);
+    c->max = max ? max : 1;
+
+    *cache = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(int) apr_dbd_stmt_cache_prepare(apr_dbd_stmt_cache_t *cache,
+                                            const char *query,
+                                            const char *label,
+                                            apr_dbd_prepared_t **statement)
+{
+    dbd_stmt_t *stmt;
+    apr_pool_t *pool;
+    apr_size_t llen = label ? strlen(label) : 0, qlen = strlen(query);
+    char *key;
+    int ret;
+
+    /* the label (with its NUL, when there is one) then the query */
+    if (cache->kbufsz < llen + !!label + qlen) {
+        cache->kbufsz = (llen + !!label + qlen) * 2;
+        cache->kbuf = apr_palloc(cache->pool, cache->kbufsz);
+    }
+    key = cache->kbuf;
+    if (label) {
+        memcpy(key, label, llen + 1);
+    }
+    memcpy(key + llen + !!label, query, qlen);
+
+    stmt = apr_hash_get(cache->stmts, key, llen + !!label + qlen);
+    if (stmt) {
+        if (!stmt->labelled) {
+            APR_RING_REMOVE(stmt, link);
+            APR_RING_INSERT_TAIL(&cache->lru, stmt, dbd_stmt_t, link);
+        }
+        *statement = stmt->statement;
+        return 0;
+    }
+
+    if (apr_pool_create(&pool, cache->pool) != APR_SUCCESS) {
+        return APR_ENOMEM;
+    }
+    stmt = apr_pcalloc(pool, sizeof(*stmt));
+    stmt->pool = pool;
+    stmt->klen = llen + !!label + qlen;
+    stmt->key = apr_pmemdup(pool, key, stmt->klen);
+    stmt->labelled = label != NULL;
+    ret = apr_dbd_prepare(cache->driver, pool, cache->handle, query, label,
+                          &stmt->statement);
+    if (ret) {
+        apr_pool_destroy(pool);
+        return ret;
+    }
+
+    if (!stmt->labelled) {
+        if (cache->nlru == cache->max) {
+            dbd_stmt_drop(cache, APR_RING_FIRST(&cache->lru));
+        }
+        APR_RING_INSERT_TAIL(&cache->lru, stmt, dbd_stmt_t, link);
+        cache->nlru++;
+    }
+    apr_hash_set(cache->stmts, stmt->key, stmt->klen, stmt);
+
+    *statement = stmt->statement;
+    return 0;
+}
+
+APR_DECLARE_NONSTD(int) apr_dbd_stmt_cache_pvquery(
+                                            apr_dbd_stmt_cache_t *cache,
+                                            apr_pool_t *pool, int *nrows,
+                                            const char *query, ...)
+{
+    apr_dbd_prepared_t *statement;
+    int ret;
+    va_list args;
+
+    ret = apr_dbd_stmt_cache_prepare(cache, query, NULL, &statement);
+    if (ret) {
+        return ret;
+    }
+    va_start(args, query);
+    ret = cache->driver->pvquery(pool,cache->handle,nrows,statement,args);
+    va_end(args);
+    return ret;
+}
+
+APR_DECLARE_NONSTD(int) apr_dbd_stmt_cache_pvselect(
+                                            apr_dbd_stmt_cache_t *cache,
+                                            apr_pool_t *pool,
+                                            apr_dbd_results_t **res,
+                                            const char *query,
+                                            int random, ...)
+{
+    apr_dbd_prepared_t *statement;
+    int ret;
+    va_list args;
+
+    ret = apr_dbd_stmt_cache_prepare(cache, query, NULL, &statement);
+    if (ret) {
+        return ret;
+    }
+    va_start(args, random);
+    ret = cache->driver->pvselect(pool,cache->handle,res,statement,random,
+                                  args);
+    va_end(args);
+    return ret;
+}
+
+APR_DECLARE(void) apr_dbd_stmt_cache_clear(apr_dbd_stmt_cache_t *cache)
+{
+    apr_hash_index_t *hi;
+
+    for (hi = apr_hash_first(NULL, cache->stmts); hi;
+         hi = apr_hash_next(hi)) {
+        dbd_stmt_drop(cache, apr_hash_this_val(hi));
+    }
+}
+
+/* drivers without a bulk path get a prepared insert in a transaction */
+struct apr_dbd_bulk_t {
+    const apr_dbd_driver_t *driver;
+    apr_pool_t *pool;
+    apr_dbd_t *handle;
+    int ncols;
+    int nrows;
+    int errnum;
+    apr_dbd_prepared_t *statement;
+    apr_dbd_transaction_t *trans;
+};
+
+APR_DECLARE(int) apr_dbd_bulk_begin(const apr_dbd_driver_t *driver,
+                                    apr_pool_t *pool, apr_dbd_t *handle,
+                                    const char *table, const char **cols,
+                                    int ncols, apr_dbd_bulk_t **bulk)
+{
+    apr_dbd_bulk_t *b;
+    struct iovec *vec;
+    int i, n = 0, ret;
+
+    if (ncols < 1) {
+        return APR_EINVAL;
+    }
+
+    b = apr_pcalloc(pool, sizeof(*b));
+    b->driver = driver;
+    b->pool = pool;
+    b->handle = handle;
+    b->ncols = ncols;
+
+    if (driver->bulk_begin) {
+        ret = driver->bulk_begin(pool,handle,table,cols,ncols);
+        if (ret) {
+            return ret;
+        }
+        *bulk = b;
+        return 0;
+    }
+
+    /* INSERT INTO table (c, ...) VALUES (%s, ...) */
+    vec = apr_palloc(pool, sizeof(*vec) * (4 * ncols + 4));
+    vec[n].iov_base = "INSERT INTO ";
+    vec[n++].iov_len = 12;
+    vec[n].iov_base = (char *)table;
+    vec[n++].iov_len = strlen(table);
+    for (i = 0; cols && i < ncols; i++) {
+        vec[n].iov_base = i ? ", " : " (";
+        vec[n++].iov_len = 2;
+        vec[n].iov_base = (char *)cols[i];
+        vec[n++].iov_len = strlen(cols[i]);
+    }
+    vec[n].iov_base = cols ? ") VALUES (%s" : " VALUES (%s";
+    vec[n].iov_len = strlen(vec[n].iov_base);
+    n++;
+    for (i = 1; i < ncols; i++) {
+        vec[n].iov_base = ", %s";
+        vec[n++].iov_len = 4;
+    }
+    vec[n].iov_base = ")";
+    vec[n++].iov_len = 1;
+
+    ret = apr_dbd_prepare(driver, pool, handle,
+                          apr_pstrcatv(pool, vec, n, NULL), NULL,
+                          &b->statement);
+    if (ret) {
+        return ret;
+    }
+    ret = apr_dbd_transaction_start(driver, pool, handle, &b->trans);
+    if (ret) {
+        return ret;
+    }
+
+    *bulk = b;
+    return 0;
+}
+
+APR_DECLARE(int) apr_dbd_bulk_append_row(apr_dbd_bulk_t *bulk,
+                                         const char **values)
+{
+    int nrows, ret;
+
+    if (bulk->errnum) {
+        return bulk->errnum;
+    }
+
+    if (bulk->driver->bulk_append) {
+        ret = bulk->driver->bulk_append(bulk->handle,values,bulk->ncols);
+    }
+    else {
+        ret = apr_dbd_pquery(bulk->driver, bulk->pool, bulk->handle, &nrows,
+                             bulk->statement, bulk->ncols, values);
+    }
+    if (ret) {
+        bulk->errnum = ret;
+        return ret;
+    }
+    bulk->nrows++;
+    return 0;
+}
+
+APR_DECLARE(int) apr_dbd_bulk_end(apr_dbd_bulk_t *bulk, int *nrows)
+{
+    int ret;
+
+    if (bulk->driver->bulk_end) {
+        ret = bulk->driver->bulk_end(bulk->handle,nrows,bulk->errnum != 0);
+    }
+    else {
+        if (bulk->errnum) {
+            apr_dbd_transaction_mode_set(bulk->driver, bulk->trans,
+                                         APR_DBD_TRANSACTION_ROLLBACK);
+        }
+        ret = apr_dbd_transaction_end(bulk->driver, bulk->pool, bulk->trans);
+        if (nrows) {
+            *nrows = (bulk->errnum || ret) ? 0 : bulk->nrows;
+        }
+    }
+    return bulk->errnum ? bulk->errnum : ret;
+}
@@ -77,6 +77,9 @@ static void check_error(apr_dbd_t *a, const char *step, SQLRETURN rc,
 #define MAX_ERROR_STRING 1024           /* max length of message in dbc */
 #define MAX_COLUMN_NAME 256             /* longest column name recognized */
 #define DEFAULT_BUFFER_SIZE 1024        /* value for defaultBufferSize */
+#define DEFAULT_FETCH_SIZE 1            /* rows fetched at once */
+#define DEFAULT_BATCH_SIZE 100          /* rows of a bulk load sent at once */
+#define DEFAULT_BULK_WIDTH 64           /* initial width of bulk load values */
 
 #define MAX_PARAMS  20
 #define DEFAULTSEPS " \t\r\n,="
@@ -103,6 +106,18 @@ static void check_error(apr_dbd_t *a, const char *step, SQLRETURN rc,
 #define APR_FROM_SQL_RESULT(rc) \
     (SQL_SUCCEEDED(rc) ? APR_SUCCESS : APR_EGENERAL)
 
+/* a bulk load, sending batches of rows bound column-wise as arrays */
+typedef struct {
+    SQLHANDLE stmt;             /* the prepared INSERT */
+    apr_pool_t *pool;           /* pool from bulk_begin */
+    int nrows;                  /* rows of the current batch */
+    int loaded;                 /* rows sent in the previous batches */
+    SQLLEN *widths;             /* width of the values of each column */
+    char **values;              /* array of values of each column */
+    SQLLEN **lens;              /* array of value lengths of each column */
+    SQLUSMALLINT *status;       /* status of each row of a batch */
+} odbc_bulk_t;
+
 /* DBD opaque structures */
 struct apr_dbd_t
 {
@@ -118,6 +133,10 @@ struct apr_dbd_t
     apr_intptr_t dboptions;     /* driver options re SQLGetData */
     apr_intptr_t default_transaction_mode;
     int can_commit;             /* controls end_trans behavior */
+    int fetchSize;              /* rows fetched at once by sequential
+                                 * selects */
+    int batchSize;              /* rows of a bulk load sent at once */
+    odbc_bulk_t *bulk;          /* bulk load in progress */
 };
 
 struct apr_dbd_results_t
@@ -140,6 +159,12 @@ struct apr_dbd_results_t
                                  */
     int *all_data_fetched;      /* flags data as all fetched, for LOBs  */
     void *data;                 /* buffer for all data for one row */
+    SQLULEN fetchsize;          /* rows fetched at once (0 if not bound
+                                 * to arrays) */
+    SQLULEN nfetched;           /* rows of the block last fetched */
+    SQLULEN rowpos;             /* current row in that block */
+    SQLPOINTER *colarrays;      /* arrays of rows bound to the columns */
+    SQLLEN *indarrays;          /* their indicators, fetchsize per column */
 };
 
 enum                            /* results column states */
@@ -467,6 +492,69 @@ static SQLRETURN odbc_set_result_column(int icol, apr_dbd_results_t *res,
     return rc;
 }
 
+#ifndef ODBCV2
+/* bind the columns to arrays of rows, so that SQLFetch fetches a block of
+ * rows at once - when every column could be bound, else set the statement
+ * (which may be a prepared one used before) back to a row at a time
+ */
+static void odbc_bind_arrays(apr_dbd_results_t *res, SQLULEN fetchsize)
+{
+    SQLRETURN rc = SQL_SUCCESS;
+    SQLHANDLE stmt = res->stmt;
+    int i;
+
+    for (i = 0; i < res->ncols; i++) {
+        if (res->colstate[i] != COL_BOUND)
+            fetchsize = 1;
+    }
+    if (fetchsize > 1) {
+        rc = SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE,
+                            (SQLPOINTER)fetchsize, 0);
+        CHECK_ERROR(res->apr_dbd, "SQLSetStmtAttr (SQL_ATTR_ROW_ARRAY_SIZE)",
+                    rc, SQL_HANDLE_STMT, stmt);
+    }
+    if (fetchsize > 1 && SQL_SUCCEEDED(rc)) {
+        /* the driver may have lowered it */
+        rc = SQLGetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, &fetchsize, 0,
+                            NULL);
+        CHECK_ERROR(res->apr_dbd, "SQLGetStmtAttr (SQL_ATTR_ROW_ARRAY_SIZE)",
+                    rc, SQL_HANDLE_STMT, stmt);
+    }
+    if (fetchsize > 1 && SQL_SUCCEEDED(rc)) {
+        rc = SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &res->nfetched,
+                            0);
+        CHECK_ERROR(res->apr_dbd, "SQLSetStmtAttr (SQL_ATTR_ROWS_FETCHED_PTR)",
+                    rc, SQL_HANDLE_STMT, stmt);
+    }
+    if (fetchsize > 1 && SQL_SUCCEEDED(rc)) {
+        res->colarrays = apr_palloc(res->pool, res->ncols * sizeof(SQLPOINTER));
+        res->indarrays = apr_pcalloc(res->pool,
+                                     res->ncols * fetchsize * sizeof(SQLLEN));
+        for (i = 0; i < res->ncols && SQL_SUCCEEDED(rc); i++) {
+            res->colarrays[i] = apr_pcalloc(res->pool,
+                                            fetchsize * res->colsizes[i]);
+            rc = SQLBindCol(stmt, i + 1, res->coltypes[i], res->colarrays[i],
+                            res->colsizes[i], res->indarrays + i * fetchsize);
+            CHECK_ERROR(res->apr_dbd, "SQLBindCol", rc, SQL_HANDLE_STMT,
+                        stmt);
+        }
+        if (SQL_SUCCEEDED(rc)) {
+            res->fetchsize = fetchsize;
+            return;
+        }
+    }
+
+    /* back to a row at a time, in the buffers of the columns */
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+    for (i = 0; i < res->ncols; i++) {
+        if (res->colstate[i] == COL_BOUND)
+            SQLBindCol(stmt, i + 1, res->coltypes[i], res->colptrs[i],
+                       res->colsizes[i], &(res->colinds[i]));
+    }
+}
+#endif
+
 /* create and populate an apr_dbd_results_t for a select */
 static SQLRETURN odbc_create_results(apr_dbd_t *handle, SQLHANDLE hstmt,
                                      apr_pool_t *pool, const int random,
@@ -499,6 +587,12 @@ static SQLRETURN odbc_create_results(apr_dbd_t *handle, SQLHANDLE hstmt,
         for (i = 0; i < ncols; i++) {
             odbc_set_result_column(i, (*res), hstmt);
         }
+#ifndef ODBCV2
+        if (handle->fetchSize > 1) {
+            /* random access fetches the rows one by one */
+            odbc_bind_arrays(*res, random ? 1 : handle->fetchSize);
+        }
+#endif
     }
     return rc;
 }
@@ -787,6 +881,23 @@ static void *odbc_get(const apr_dbd_row_t *row, const int col,
         /* this driver won't let us re-get bound columns */
         return (void *)-1;
 
+#ifndef ODBCV2
+    if (row->res->fetchsize) {
+        /* the cursor is on a block of rows, position it on this one */
+        if (!(options & SQL_GD_BLOCK))
+            return (void *)-1;
+        rc = SQLSetPos(row->res->stmt, (SQLSETPOSIROW)row->res->rowpos + 1,
+                       SQL_POSITION, SQL_LOCK_NO_CHANGE);
+        CHECK_ERROR(row->res->apr_dbd, "SQLSetPos", rc, SQL_HANDLE_STMT,
+                    row->res->stmt);
+        if (!SQL_SUCCEEDED(rc))
+            return (void *)-1;
+        /* the data of the block stays where it is */
+        row->res->colptrs[col] = apr_pcalloc(row->pool,
+                                             row->res->colsizes[col]);
+    }
+#endif
+
     /* a LOB might not have a buffer allocated yet - so create one */
     if (!row->res->colptrs[col])
         row->res->colptrs[col] = apr_pcalloc(row->pool, row->res->colsizes[col]);
@@ -799,8 +910,11 @@ static void *odbc_get(const apr_dbd_row_t *row, const int col,
         return NULL;
 
     if (SQL_SUCCEEDED(rc)) {
-        /* whatever it was originally, it is now this sqltype */
-        row->res->coltypes[col] = sqltype;
+        /* whatever it was originally, it is now this sqltype - unless
+         * the next rows are already in the block
+         */
+        if (!row->res->fetchsize)
+            row->res->coltypes[col] = sqltype;
         /* this allows getting CLOBs in text mode by calling get_entry
          *   until it returns NULL
          */
@@ -816,7 +930,8 @@ static void *odbc_get(const apr_dbd_row_t *row, const int col,
 static apr_status_t odbc_parse_params(apr_pool_t *pool, const char *params,
                                int *connect, SQLCHAR **datasource, 
                                SQLCHAR **user, SQLCHAR **password, 
-                               int *defaultBufferSize, int *nattrs,
+                               int *defaultBufferSize, int *fetchSize,
+                               int *batchSize, int *nattrs,
                                int **attrs, apr_intptr_t **attrvals)
 {
     char *seps, *last, *next, *name[MAX_PARAMS], *val[MAX_PARAMS];
@@ -870,6 +985,14 @@ static apr_status_t odbc_parse_params(apr_pool_t *pool, const char *params,
         else if (!apr_strnatcasecmp(name[i], "BUFSIZE")) {
             *defaultBufferSize = atoi(val[i]);
         }
+        else if (!apr_strnatcasecmp(name[i], "FETCHSIZE")) {
+            if ((*fetchSize = atoi(val[i])) < 1)
+                return SQL_ERROR;
+        }
+        else if (!apr_strnatcasecmp(name[i], "BATCHSIZE")) {
+            if ((*batchSize = atoi(val[i])) < 1)
+                return SQL_ERROR;
+        }
         else if (!apr_strnatcasecmp(name[i], "ACCESS")) {
             if (!apr_strnatcasecmp(val[i], "READ_ONLY"))
                 (*attrvals)[j] = SQL_MODE_READ_ONLY;
@@ -1059,6 +1182,7 @@ static apr_dbd_t *odbc_open(apr_pool_t *pool, const char *params, const char **e
     char *err_step;
     int err_htype, i;
     int defaultBufferSize = DEFAULT_BUFFER_SIZE;
+    int fetchSize = DEFAULT_FETCH_SIZE, batchSize = DEFAULT_BATCH_SIZE;
     SQLHANDLE err_h = NULL;
     SQLCHAR  *datasource = (SQLCHAR *)"", *user = (SQLCHAR *)"",
              *password = (SQLCHAR *)"";
@@ -1074,8 +1198,8 @@ static apr_dbd_t *odbc_open(apr_pool_t *pool, const char *params, const char **e
         err_htype = SQL_HANDLE_DBC;
         err_h = hdbc;
         rc = odbc_parse_params(pool, params, &connect, &datasource, &user,
-                               &password, &defaultBufferSize, &nattrs, &attrs,
-                               &attrvals);
+                               &password, &defaultBufferSize, &fetchSize,
+                               &batchSize, &nattrs, &attrs, &attrvals);
     }
     if (SQL_SUCCEEDED(rc)) {
         for (i = 0; i < nattrs && SQL_SUCCEEDED(rc); i++) {
@@ -1113,6 +1237,8 @@ static apr_dbd_t *odbc_open(apr_pool_t *pool, const char *params, const char **e
         handle->dbc = hdbc;
         handle->pool = pool;
         handle->defaultBufferSize = defaultBufferSize;
+        handle->fetchSize = fetchSize;
+        handle->batchSize = batchSize;
         CHECK_ERROR(handle, "SQLConnect", rc, SQL_HANDLE_DBC, handle->dbc);
         handle->default_transaction_mode = 0;
         handle->can_commit = APR_DBD_TRANSACTION_IGNORE_ERRORS;
@@ -1320,6 +1446,37 @@ static int odbc_get_row(apr_pool_t *pool, apr_dbd_results_t *res,
     (*row)->res = res;
     (*row)->pool = res->pool;
 
+    if (res->fetchsize) {
+        /* the rows come from the block last fetched, until exhausted */
+        if (++res->rowpos < res->nfetched) {
+            rc = SQL_SUCCESS;
+        }
+        else {
+            res->rowpos = 0;
+            rc = SQLFetch(res->stmt);
+            CHECK_ERROR(res->apr_dbd, "SQLFetch", rc, SQL_HANDLE_STMT,
+                        res->stmt);
+            if (SQL_SUCCEEDED(rc) && !res->nfetched)
+                rc = SQL_NO_DATA;
+        }
+        if (!SQL_SUCCEEDED(rc)) {
+            odbc_close_results(res);
+            return -1;
+        }
+        for (c = 0; c < res->ncols; c++) {
+            SQLLEN ind = res->indarrays[c * res->fetchsize + res->rowpos];
+
+            res->colptrs[c] = (char *)res->colarrays[c]
+                              + res->rowpos * res->colsizes[c];
+            res->colinds[c] = ind;
+            res->colstate[c] = COL_BOUND;
+            /* some drivers do not null-term zero-len CHAR data */
+            if (ind == 0)
+                *(char *)res->colptrs[c] = 0;
+        }
+        return 0;
+    }
+
     /* mark all the columns as needing SQLGetData unless they are bound  */
     for (c = 0; c < res->ncols; c++) {
         if (res->colstate[c] != COL_BOUND) {
@@ -1697,6 +1854,199 @@ static int odbc_pvbselect(apr_pool_t *pool, apr_dbd_t *handle,
     return odbc_pbselect(pool, handle, res, statement, random, (const void **)values);
 }
 
+#ifndef ODBCV2
+/*
+ * Bulk loads are an INSERT prepared once, whose parameters are bound to
+ * arrays of batchSize rows: each batch goes to the server in one
+ * SQLExecute, the whole load in a transaction of its own.
+ */
+
+/* bind a column of a bulk load to an array of values of the given width */
+static SQLRETURN odbc_bulk_bind(apr_dbd_t *handle, odbc_bulk_t *bulk,
+                                int col, SQLLEN width)
+{
+    SQLRETURN rc;
+
+    bulk->values[col] = apr_palloc(bulk->pool, width * handle->batchSize);
+    bulk->lens[col] = apr_palloc(bulk->pool,
+                                 handle->batchSize * sizeof(SQLLEN));
+    bulk->widths[col] = width;
+    rc = SQLBindParameter(bulk->stmt, (SQLUSMALLINT)(col + 1),
+                          SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, width, 0,
+                          bulk->values[col], width, bulk->lens[col]);
+    CHECK_ERROR(handle, "SQLBindParameter", rc, SQL_HANDLE_STMT, bulk->stmt);
+    return rc;
+}
+
+/* send the rows of the current batch */
+static SQLRETURN odbc_bulk_flush(apr_dbd_t *handle, odbc_bulk_t *bulk)
+{
+    SQLRETURN rc;
+    int i;
+
+    if (!bulk->nrows)
+        return SQL_SUCCESS;
+
+    rc = SQLSetStmtAttr(bulk->stmt, SQL_ATTR_PARAMSET_SIZE,
+                        (SQLPOINTER)(SQLULEN)bulk->nrows, 0);
+    CHECK_ERROR(handle, "SQLSetStmtAttr (SQL_ATTR_PARAMSET_SIZE)", rc,
+                SQL_HANDLE_STMT, bulk->stmt);
+    if (SQL_SUCCEEDED(rc)) {
+        rc = SQLExecute(bulk->stmt);
+        CHECK_ERROR(handle, "SQLExecute", rc, SQL_HANDLE_STMT, bulk->stmt);
+    }
+    /* SQL_SUCCESS_WITH_INFO may be all that says some rows failed */
+    for (i = 0; i < bulk->nrows && SQL_SUCCEEDED(rc); i++) {
+        if (bulk->status[i] == SQL_PARAM_ERROR)
+            rc = SQL_ERROR;
+    }
+    bulk->loaded += bulk->nrows;
+    bulk->nrows = 0;
+    return rc;
+}
+
+static int odbc_bulk_begin(apr_pool_t *pool, apr_dbd_t *handle,
+                           const char *table, const char **cols, int ncols)
+{
+    SQLRETURN rc;
+    SQLUINTEGER autocommit = SQL_AUTOCOMMIT_ON;
+    odbc_bulk_t *bulk;
+    const char *query;
+    int i;
+
+    if (odbc_check_rollback(handle))
+        return APR_EGENERAL;
+
+    /* the load commits (or rolls back) on its own */
+    rc = SQLGetConnectAttr(handle->dbc, SQL_ATTR_AUTOCOMMIT, &autocommit,
+                           0, NULL);
+    CHECK_ERROR(handle, "SQLGetConnectAttr (SQL_ATTR_AUTOCOMMIT)", rc,
+                SQL_HANDLE_DBC, handle->dbc);
+    if (!SQL_SUCCEEDED(rc) || autocommit != SQL_AUTOCOMMIT_ON)
+        return APR_EGENERAL;
+
+    query = apr_pstrcat(pool, "INSERT INTO ", table, NULL);
+    for (i = 0; cols && i < ncols; i++) {
+        query = apr_pstrcat(pool, query, i ? ", " : " (", cols[i], NULL);
+    }
+    query = apr_pstrcat(pool, query, cols ? ") VALUES (" : " VALUES (",
+                        NULL);
+    for (i = 0; i < ncols; i++) {
+        query = apr_pstrcat(pool, query, i ? ", ?" : "?", NULL);
+    }
+    query = apr_pstrcat(pool, query, ")", NULL);
+
+    bulk = apr_pcalloc(pool, sizeof(odbc_bulk_t));
+    bulk->pool = pool;
+    bulk->widths = apr_pcalloc(pool, ncols * sizeof(SQLLEN));
+    bulk->values = apr_pcalloc(pool, ncols * sizeof(char *));
+    bulk->lens = apr_pcalloc(pool, ncols * sizeof(SQLLEN *));
+    bulk->status = apr_pcalloc(pool,
+                               handle->batchSize * sizeof(SQLUSMALLINT));
+
+    rc = SQLAllocHandle(SQL_HANDLE_STMT, handle->dbc, &bulk->stmt);
+    CHECK_ERROR(handle, "SQLAllocHandle (STMT)", rc, SQL_HANDLE_DBC,
+                handle->dbc);
+    if (!SQL_SUCCEEDED(rc))
+        return APR_FROM_SQL_RESULT(rc);
+
+    rc = SQLPrepare(bulk->stmt, (SQLCHAR *)query, SQL_NTS);
+    CHECK_ERROR(handle, "SQLPrepare", rc, SQL_HANDLE_STMT, bulk->stmt);
+    if (SQL_SUCCEEDED(rc)) {
+        rc = SQLSetStmtAttr(bulk->stmt, SQL_ATTR_PARAM_STATUS_PTR,
+                            bulk->status, 0);
+        CHECK_ERROR(handle, "SQLSetStmtAttr (SQL_ATTR_PARAM_STATUS_PTR)", rc,
+                    SQL_HANDLE_STMT, bulk->stmt);
+    }
+    for (i = 0; i < ncols && SQL_SUCCEEDED(rc); i++) {
+        rc = odbc_bulk_bind(handle, bulk, i, DEFAULT_BULK_WIDTH);
+    }
+    if (SQL_SUCCEEDED(rc)) {
+        rc = SQLSetConnectAttr(handle->dbc, SQL_ATTR_AUTOCOMMIT,
+                               SQL_AUTOCOMMIT_OFF, 0);
+        CHECK_ERROR(handle, "SQLSetConnectAttr (SQL_ATTR_AUTOCOMMIT)", rc,
+                    SQL_HANDLE_DBC, handle->dbc);
+    }
+    if (!SQL_SUCCEEDED(rc)) {
+        SQLFreeHandle(SQL_HANDLE_STMT, bulk->stmt);
+        return APR_FROM_SQL_RESULT(rc);
+    }
+    handle->bulk = bulk;
+    return APR_SUCCESS;
+}
+
+static int odbc_bulk_append(apr_dbd_t *handle, const char **values,
+                            int ncols)
+{
+    SQLRETURN rc = SQL_SUCCESS;
+    odbc_bulk_t *bulk = handle->bulk;
+    int i;
+
+    /* a value wider than its column sends the batch so far, for the
+     * column to be bound again to wider values
+     */
+    for (i = 0; i < ncols && SQL_SUCCEEDED(rc); i++) {
+        SQLLEN len = values[i] ? (SQLLEN)strlen(values[i]) : 0;
+
+        if (len > bulk->widths[i]) {
+            SQLLEN width = bulk->widths[i];
+
+            while (width < len)
+                width *= 2;
+            rc = odbc_bulk_flush(handle, bulk);
+            if (SQL_SUCCEEDED(rc))
+                rc = odbc_bulk_bind(handle, bulk, i, width);
+        }
+    }
+    if (!SQL_SUCCEEDED(rc))
+        return APR_FROM_SQL_RESULT(rc);
+
+    for (i = 0; i < ncols; i++) {
+        SQLLEN *len = bulk->lens[i] + bulk->nrows;
+
+        if (values[i]) {
+            *len = (SQLLEN)strlen(values[i]);
+            memcpy(bulk->values[i] + bulk->nrows * bulk->widths[i],
+                   values[i], *len);
+        }
+        else
+            *len = SQL_NULL_DATA;
+    }
+    if (++bulk->nrows == handle->batchSize)
+        rc = odbc_bulk_flush(handle, bulk);
+    return APR_FROM_SQL_RESULT(rc);
+}
+
+static int odbc_bulk_end(apr_dbd_t *handle, int *nrows, int discard)
+{
+    SQLRETURN rc = SQL_SUCCESS, rc2;
+    odbc_bulk_t *bulk = handle->bulk;
+
+    if (!discard)
+        rc = odbc_bulk_flush(handle, bulk);
+    rc2 = SQLEndTran(SQL_HANDLE_DBC, handle->dbc,
+                     (!discard && SQL_SUCCEEDED(rc)) ? SQL_COMMIT
+                                                     : SQL_ROLLBACK);
+    if (SQL_SUCCEEDED(rc)) {
+        CHECK_ERROR(handle, "SQLEndTran", rc2, SQL_HANDLE_DBC, handle->dbc);
+        rc = rc2;
+    }
+    rc2 = SQLSetConnectAttr(handle->dbc, SQL_ATTR_AUTOCOMMIT,
+                            (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+    if (SQL_SUCCEEDED(rc)) {
+        CHECK_ERROR(handle, "SQLSetConnectAttr (SQL_ATTR_AUTOCOMMIT)", rc2,
+                    SQL_HANDLE_DBC, handle->dbc);
+        rc = rc2;
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, bulk->stmt);
+    handle->bulk = NULL;
+
+    if (nrows)
+        *nrows = (discard || !SQL_SUCCEEDED(rc)) ? 0 : bulk->loaded;
+    return APR_FROM_SQL_RESULT(rc);
+}
+#endif
+
 APR_MODULE_DECLARE_DATA const apr_dbd_driver_t ODBC_DRIVER_ENTRY = {
     ODBC_DRIVER_STRING,
     odbc_init,
@@ -1728,7 +2078,15 @@ APR_MODULE_DECLARE_DATA const apr_dbd_driver_t ODBC_DRIVER_ENTRY = {
     odbc_pvbselect,
     odbc_pbquery,
     odbc_pbselect,
-    odbc_datum_get
+    odbc_datum_get,
+#ifndef ODBCV2
+    NULL,
+    NULL,
+    NULL,
+    odbc_bulk_begin,
+    odbc_bulk_append,
+    odbc_bulk_end
+#endif
 };
 
 #endif
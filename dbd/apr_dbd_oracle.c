@@ -72,6 +72,10 @@
                          * Should really make it configurable
                          */
 #define DEFAULT_LONG_SIZE 4096
+#define DEFAULT_PREFETCH_ROWS 1  /* rows OCI fetches at once for a select */
+#define DEFAULT_BATCH_SIZE 100   /* rows of a bulk load sent at once */
+#define DEFAULT_BULK_WIDTH 64    /* initial width of bulk load values */
+#define MAX_BULK_WIDTH 65535     /* values are bound with a ub2 length */
 #define DBD_ORACLE_MAX_COLUMNS 256
 #define NUMERIC_FIELD_SIZE 32
 
@@ -121,6 +125,18 @@ struct apr_dbd_results_t {
     apr_dbd_prepared_t *statement;
 };
 
+/* a bulk load, sending batches of rows bound as arrays */
+typedef struct {
+    OCIStmt *stmt;
+    apr_pool_t *pool;
+    int nrows;       /* rows of the current batch */
+    int loaded;      /* rows sent in the previous batches */
+    ub2 *widths;     /* width of the values of each column */
+    char **values;   /* array of values of each column */
+    sb2 **inds;      /* array of NULL indicators of each column */
+    ub2 **lens;      /* array of value lengths of each column */
+} bulk_load;
+
 struct apr_dbd_t {
     sword status;
     OCIError *err;
@@ -132,6 +148,9 @@ struct apr_dbd_t {
     char buf[ERR_BUF_SIZE]; /* for error messages */
     apr_size_t long_size;
     apr_dbd_prepared_t *check_conn_stmt;
+    ub4 prefetch;
+    int batch_size;
+    bulk_load *bulk;
 };
 
 struct apr_dbd_row_t {
@@ -389,6 +408,8 @@ static apr_dbd_t *dbd_oracle_open(apr_pool_t *pool, const char *params,
         {"pass", BLANK},
         {"dbname", BLANK},
         {"server", BLANK},
+        {"prefetch", BLANK},
+        {"batch", BLANK},
         {NULL, NULL}
     };
     int i;
@@ -433,6 +454,29 @@ static apr_dbd_t *dbd_oracle_open(apr_pool_t *pool, const char *params,
         ptr = value+vlen;
     }
 
+    ret->prefetch = DEFAULT_PREFETCH_ROWS;
+    if (*fields[4].value) {
+        i = atoi(fields[4].value);
+        if (i < 1) {
+            if (error) {
+                *error = "prefetch must be a positive number of rows";
+            }
+            return NULL;
+        }
+        ret->prefetch = i;
+    }
+    ret->batch_size = DEFAULT_BATCH_SIZE;
+    if (*fields[5].value) {
+        i = atoi(fields[5].value);
+        if (i < 1) {
+            if (error) {
+                *error = "batch must be a positive number of rows";
+            }
+            return NULL;
+        }
+        ret->batch_size = i;
+    }
+
     ret->status = OCIHandleAlloc(dbd_oracle_env, (dvoid**)&ret->err,
                                  OCI_HTYPE_ERROR, 0, NULL);
     switch (ret->status) {
@@ -912,6 +956,13 @@ static int dbd_oracle_prepare(apr_pool_t *pool, apr_dbd_t *sql,
 #endif
 
     if (stmt->type == OCI_STMT_SELECT) {
+        /* OCIStmtFetch2 serves the rows from a block fetched at once */
+        sql->status = OCIAttrSet(stmt->stmt, OCI_HTYPE_STMT, &sql->prefetch,
+                                 sizeof(sql->prefetch),
+                                 OCI_ATTR_PREFETCH_ROWS, sql->err);
+        if (sql->status != OCI_SUCCESS) {
+            return 1;
+        }
         ret = outputParams(sql, stmt);
     }
     return ret;
@@ -2185,6 +2236,170 @@ static int dbd_oracle_num_tuples(apr_dbd_results_t* res)
     return res->nrows;
 }
 
+/*
+ * Bulk loads are an INSERT prepared once, whose values are bound to arrays
+ * of batch_size rows: each batch goes to the server in one OCIStmtExecute,
+ * the whole load in a transaction of its own.
+ */
+
+/* bind a column of a bulk load to an array of values of the given width */
+static int dbd_oracle_bulk_bind(apr_dbd_t *sql, bulk_load *bulk, int col,
+                                ub2 width)
+{
+    OCIBind *bind = NULL;
+
+    bulk->values[col] = apr_palloc(bulk->pool,
+                                   (apr_size_t)width * sql->batch_size);
+    bulk->inds[col] = apr_palloc(bulk->pool, sql->batch_size * sizeof(sb2));
+    bulk->lens[col] = apr_palloc(bulk->pool, sql->batch_size * sizeof(ub2));
+    bulk->widths[col] = width;
+    sql->status = OCIBindByPos(bulk->stmt, &bind, sql->err, col + 1,
+                               bulk->values[col], width, SQLT_CHR,
+                               bulk->inds[col], bulk->lens[col], NULL,
+                               0, NULL, OCI_DEFAULT);
+    return sql->status != OCI_SUCCESS;
+}
+
+/* send the rows of the current batch */
+static int dbd_oracle_bulk_flush(apr_dbd_t *sql, bulk_load *bulk)
+{
+    if (!bulk->nrows) {
+        return 0;
+    }
+    sql->status = OCIStmtExecute(sql->svc, bulk->stmt, sql->err, bulk->nrows,
+                                 0, NULL, NULL, OCI_DEFAULT);
+    bulk->loaded += bulk->nrows;
+    bulk->nrows = 0;
+    return sql->status != OCI_SUCCESS;
+}
+
+static int dbd_oracle_bulk_begin(apr_pool_t *pool, apr_dbd_t *sql,
+                                 const char *table, const char **cols,
+                                 int ncols)
+{
+    bulk_load *bulk;
+    const char *query;
+    int i;
+
+    /* the load commits (or rolls back) on its own */
+    if (sql->trans) {
+        return 1;
+    }
+
+    query = apr_pstrcat(pool, "INSERT INTO ", table, NULL);
+    for (i = 0; cols && i < ncols; i++) {
+        query = apr_pstrcat(pool, query, i ? ", " : " (", cols[i], NULL);
+    }
+    query = apr_pstrcat(pool, query, cols ? ") VALUES (" : " VALUES (",
+                        NULL);
+    for (i = 0; i < ncols; i++) {
+        query = apr_psprintf(pool, i ? "%s, :apr%d" : "%s:apr%d", query,
+                             i + 1);
+    }
+    query = apr_pstrcat(pool, query, ")", NULL);
+
+    bulk = apr_pcalloc(pool, sizeof(bulk_load));
+    bulk->pool = pool;
+    bulk->widths = apr_pcalloc(pool, ncols * sizeof(ub2));
+    bulk->values = apr_pcalloc(pool, ncols * sizeof(char*));
+    bulk->inds = apr_pcalloc(pool, ncols * sizeof(sb2*));
+    bulk->lens = apr_pcalloc(pool, ncols * sizeof(ub2*));
+
+    sql->status = OCIHandleAlloc(dbd_oracle_env, (dvoid**)&bulk->stmt,
+                                 OCI_HTYPE_STMT, 0, NULL);
+    if (sql->status != OCI_SUCCESS) {
+        return 1;
+    }
+    sql->status = OCIStmtPrepare(bulk->stmt, sql->err, (text*) query,
+                                 strlen(query), OCI_NTV_SYNTAX, OCI_DEFAULT);
+    for (i = 0; i < ncols && sql->status == OCI_SUCCESS; i++) {
+        dbd_oracle_bulk_bind(sql, bulk, i, DEFAULT_BULK_WIDTH);
+    }
+    if (sql->status != OCI_SUCCESS) {
+        OCIHandleFree(bulk->stmt, OCI_HTYPE_STMT);
+        return 1;
+    }
+
+    sql->bulk = bulk;
+    return 0;
+}
+
+static int dbd_oracle_bulk_append(apr_dbd_t *sql, const char **values,
+                                  int ncols)
+{
+    bulk_load *bulk = sql->bulk;
+    apr_size_t len;
+    int i;
+
+    /* a value wider than its column sends the batch so far, for the
+     * column to be bound again to wider values
+     */
+    for (i = 0; i < ncols; i++) {
+        len = values[i] ? strlen(values[i]) : 0;
+        if (len > MAX_BULK_WIDTH) {
+            return 1;
+        }
+        if (len > bulk->widths[i]) {
+            apr_size_t width = bulk->widths[i];
+
+            while (width < len) {
+                width *= 2;
+            }
+            if (width > MAX_BULK_WIDTH) {
+                width = MAX_BULK_WIDTH;
+            }
+            if (dbd_oracle_bulk_flush(sql, bulk)
+                || dbd_oracle_bulk_bind(sql, bulk, i, (ub2)width)) {
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < ncols; i++) {
+        if (values[i]) {
+            len = strlen(values[i]);
+            memcpy(bulk->values[i] + bulk->nrows * bulk->widths[i],
+                   values[i], len);
+            bulk->lens[i][bulk->nrows] = (ub2)len;
+            bulk->inds[i][bulk->nrows] = 0;
+        }
+        else {
+            bulk->lens[i][bulk->nrows] = 0;
+            bulk->inds[i][bulk->nrows] = -1;
+        }
+    }
+    if (++bulk->nrows == sql->batch_size) {
+        return dbd_oracle_bulk_flush(sql, bulk);
+    }
+    return 0;
+}
+
+static int dbd_oracle_bulk_end(apr_dbd_t *sql, int *nrows, int discard)
+{
+    bulk_load *bulk = sql->bulk;
+    int ret = 0;
+
+    if (!discard) {
+        ret = dbd_oracle_bulk_flush(sql, bulk);
+    }
+    if (discard || ret) {
+        OCITransRollback(sql->svc, sql->err, OCI_DEFAULT);
+    }
+    else {
+        sql->status = OCITransCommit(sql->svc, sql->err, OCI_DEFAULT);
+        if (sql->status != OCI_SUCCESS) {
+            ret = 3;
+        }
+    }
+    OCIHandleFree(bulk->stmt, OCI_HTYPE_STMT);
+    sql->bulk = NULL;
+
+    if (nrows) {
+        *nrows = (discard || ret) ? 0 : bulk->loaded;
+    }
+    return ret;
+}
+
 APR_MODULE_DECLARE_DATA const apr_dbd_driver_t apr_dbd_oracle_driver = {
     "oracle",
     dbd_oracle_init,
@@ -2216,6 +2431,12 @@ APR_MODULE_DECLARE_DATA const apr_dbd_driver_t apr_dbd_oracle_driver = {
     dbd_oracle_pvbselect,
     dbd_oracle_pbquery,
     dbd_oracle_pbselect,
-    dbd_oracle_datum_get
+    dbd_oracle_datum_get,
+    NULL,
+    NULL,
+    NULL,
+    dbd_oracle_bulk_begin,
+    dbd_oracle_bulk_append,
+    dbd_oracle_bulk_end
 };
 #endif
@@ -31,6 +31,7 @@
 #include "apr_strings.h"
 #include "apr_time.h"
 #include "apr_buckets.h"
+#include "apr_portable.h"
 
 #include "apr_dbd_internal.h"
 
@@ -43,6 +44,8 @@ struct apr_dbd_transaction_t {
 struct apr_dbd_t {
     PGconn *conn;
     apr_dbd_transaction_t *trans;
+    int sent;                   /* queries in flight, in pipeline mode */
+    PGresult *head;             /* the oldest one's result, until synced */
 };
 
 struct apr_dbd_results_t {
@@ -171,7 +174,8 @@ static int dbd_pgsql_select(apr_pool_t *pool, apr_dbd_t *sql,
                 return sql->trans->errnum = PGRES_FATAL_ERROR;
             }
         }
-        if (PQsendQuery(sql->conn, query) == 0) {
+        if (PQsendQuery(sql->conn, query) == 0
+            || PQsetSingleRowMode(sql->conn) == 0) {
             if (TXN_IGNORE_ERRORS(sql->trans)) {
                 PGresult *res = PQexec(sql->conn,
                                        "ROLLBACK TO SAVEPOINT APR_DBD_TXN_SP");
@@ -280,10 +284,10 @@ static int dbd_pgsql_get_row(apr_pool_t *pool, apr_dbd_results_t *res,
             if (res->res) {
                 res->ntuples = PQntuples(res->res);
                 while (res->ntuples == 0) {
-                    /* if we got an empty result, clear it, wait a mo, try
-                     * again */
+                    /* in single row mode the rows come one per result,
+                     * the last one empty: PQgetResult() waits for the
+                     * next and returns NULL once they're all in */
                     PQclear(res->res);
-                    apr_sleep(100000);        /* 0.1 secs */
                     res->res = PQgetResult(res->handle);
                     if (res->res) {
                         res->ntuples = PQntuples(res->res);
@@ -872,7 +876,7 @@ static int dbd_pgsql_pselect_internal(apr_pool_t *pool, apr_dbd_t *sql,
             rv = PQsendQueryParams(sql->conn, statement->name,
                                    statement->nargs, 0, values, len, fmt, 0);
         }
-        if (rv == 0) {
+        if (rv == 0 || PQsetSingleRowMode(sql->conn) == 0) {
             if (TXN_IGNORE_ERRORS(sql->trans)) {
                 PGresult *res = PQexec(sql->conn,
                                        "ROLLBACK TO SAVEPOINT APR_DBD_TXN_SP");
@@ -1236,6 +1240,9 @@ static apr_dbd_t *dbd_pgsql_open(apr_pool_t *pool, const char *params,
 
 static apr_status_t dbd_pgsql_close(apr_dbd_t *handle)
 {
+    if (handle->head) {
+        PQclear(handle->head);
+    }
     PQfinish(handle->conn);
     return APR_SUCCESS;
 }
@@ -1278,6 +1285,282 @@ static int dbd_pgsql_num_tuples(apr_dbd_results_t* res)
     }
 }
 
+#ifdef LIBPQ_HAS_PIPELINING
+/*
+ * Queries in flight use the pipeline mode of libpq, entered with the first
+ * one and left once the last result is in.  Each query is followed by a
+ * sync so that an error aborts it alone, its results being complete when
+ * the sync comes back.  Only the reading is done without blocking: the
+ * connection stays blocking for PQpipelineSync() to send everything out.
+ */
+static int dbd_pgsql_send_query(apr_pool_t *pool, apr_dbd_t *sql,
+                                apr_dbd_prepared_t *statement,
+                                const char **values)
+{
+    int *len, *fmt;
+    const char **val;
+    int rv;
+
+    if (sql->trans && sql->trans->errnum) {
+        return sql->trans->errnum;
+    }
+    if (TXN_IGNORE_ERRORS(sql->trans)) {
+        /* no savepoints around queries in flight */
+        return APR_ENOTIMPL;
+    }
+
+    val = apr_palloc(pool, sizeof(*val) * statement->nargs);
+    len = apr_pcalloc(pool, sizeof(*len) * statement->nargs);
+    fmt = apr_pcalloc(pool, sizeof(*fmt) * statement->nargs);
+
+    dbd_pgsql_bind(statement, values, val, len, fmt);
+
+    if (!sql->sent && !PQenterPipelineMode(sql->conn)) {
+        return PGRES_FATAL_ERROR;
+    }
+    if (statement->prepared) {
+        rv = PQsendQueryPrepared(sql->conn, statement->name,
+                                 statement->nargs, val, len, fmt, 0);
+    }
+    else {
+        rv = PQsendQueryParams(sql->conn, statement->name,
+                               statement->nargs, 0, val, len, fmt, 0);
+    }
+    if (rv == 0 || PQpipelineSync(sql->conn) == 0) {
+        if (!sql->sent) {
+            PQexitPipelineMode(sql->conn);
+        }
+        if (TXN_NOTICE_ERRORS(sql->trans)) {
+            sql->trans->errnum = PGRES_FATAL_ERROR;
+        }
+        return PGRES_FATAL_ERROR;
+    }
+    sql->sent++;
+
+    return 0;
+}
+
+static int dbd_pgsql_poll_result(apr_pool_t *pool, apr_dbd_t *sql,
+                                 apr_dbd_results_t **results, int *nrows,
+                                 int block)
+{
+    PGresult *res;
+    int ret;
+
+    if (!sql->sent) {
+        return APR_EOF;
+    }
+
+    for (;;) {
+        if (!block) {
+            if (!PQconsumeInput(sql->conn)) {
+                return PGRES_FATAL_ERROR;
+            }
+            if (PQisBusy(sql->conn)) {
+                return APR_EAGAIN;
+            }
+        }
+        res = PQgetResult(sql->conn);
+        if (res == NULL) {
+            /* the end of a query's results, or of the connection */
+            if (PQstatus(sql->conn) != CONNECTION_OK) {
+                return PGRES_FATAL_ERROR;
+            }
+            continue;
+        }
+        if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+            PQclear(res);
+            break;
+        }
+        if (sql->head) {
+            PQclear(res);
+        }
+        else {
+            sql->head = res;
+        }
+    }
+
+    res = sql->head;
+    sql->head = NULL;
+    if (--sql->sent == 0) {
+        PQexitPipelineMode(sql->conn);
+    }
+
+    if (res == NULL) {
+        return PGRES_FATAL_ERROR;
+    }
+    ret = PQresultStatus(res);
+    if (!dbd_pgsql_is_success(ret)) {
+        PQclear(res);
+        if (ret == PGRES_PIPELINE_ABORTED) {
+            ret = PGRES_FATAL_ERROR;
+        }
+        if (TXN_NOTICE_ERRORS(sql->trans)) {
+            sql->trans->errnum = ret;
+        }
+        return ret;
+    }
+
+    *nrows = ret == PGRES_TUPLES_OK ? PQntuples(res)
+                                    : atoi(PQcmdTuples(res));
+    if (ret != PGRES_TUPLES_OK) {
+        PQclear(res);
+        return 0;
+    }
+    if (!*results) {
+        *results = apr_pcalloc(pool, sizeof(apr_dbd_results_t));
+    }
+    (*results)->res = res;
+    (*results)->ntuples = PQntuples(res);
+    (*results)->sz = PQnfields(res);
+    (*results)->random = 1;
+    (*results)->pool = pool;
+    apr_pool_cleanup_register(pool, res, clear_result,
+                              apr_pool_cleanup_null);
+
+    return 0;
+}
+
+static apr_status_t dbd_pgsql_socket_get(apr_pool_t *pool, apr_dbd_t *sql,
+                                         apr_socket_t **sock)
+{
+    apr_os_sock_t fd = PQsocket(sql->conn);
+
+    if (fd < 0) {
+        return APR_EBADF;
+    }
+    *sock = NULL;
+    return apr_os_sock_put(sock, &fd, pool);
+}
+#endif
+
+/*
+ * Bulk loads are a COPY FROM STDIN in the text format, each value put as
+ * it comes: libpq buffers the stream and sends it out as it fills up.
+ */
+static int dbd_pgsql_bulk_begin(apr_pool_t *pool, apr_dbd_t *sql,
+                                const char *table, const char **cols,
+                                int ncols)
+{
+    const char *query;
+    PGresult *res;
+    int i, ret;
+
+    if (sql->trans && sql->trans->errnum) {
+        return sql->trans->errnum;
+    }
+
+    query = apr_pstrcat(pool, "COPY ", table, NULL);
+    for (i = 0; cols && i < ncols; i++) {
+        query = apr_pstrcat(pool, query, i ? ", " : " (", cols[i], NULL);
+    }
+    query = apr_pstrcat(pool, query, cols ? ") FROM STDIN" : " FROM STDIN",
+                        NULL);
+
+    res = PQexec(sql->conn, query);
+    if (!res) {
+        ret = PGRES_FATAL_ERROR;
+    }
+    else {
+        ret = PQresultStatus(res);
+        PQclear(res);
+        if (ret == PGRES_COPY_IN) {
+            return 0;
+        }
+    }
+    if (TXN_NOTICE_ERRORS(sql->trans)) {
+        sql->trans->errnum = ret;
+    }
+    return ret;
+}
+
+static int dbd_pgsql_bulk_append(apr_dbd_t *sql, const char **values,
+                                 int ncols)
+{
+    const char *value, *run;
+    char esc[2];
+    int i;
+
+    for (i = 0; i < ncols; i++) {
+        if (i && PQputCopyData(sql->conn, "\t", 1) != 1) {
+            return PGRES_FATAL_ERROR;
+        }
+        if (!values[i]) {
+            if (PQputCopyData(sql->conn, "\\N", 2) != 1) {
+                return PGRES_FATAL_ERROR;
+            }
+            continue;
+        }
+        esc[0] = '\\';
+        for (run = value = values[i]; ; value++) {
+            switch (*value) {
+            case '\\':
+                esc[1] = '\\';
+                break;
+            case '\t':
+                esc[1] = 't';
+                break;
+            case '\n':
+                esc[1] = 'n';
+                break;
+            case '\r':
+                esc[1] = 'r';
+                break;
+            case '\0':
+                esc[1] = '\0';
+                break;
+            default:
+                continue;
+            }
+            if (value > run
+                && PQputCopyData(sql->conn, run, value - run) != 1) {
+                return PGRES_FATAL_ERROR;
+            }
+            if (!esc[1]) {
+                break;
+            }
+            if (PQputCopyData(sql->conn, esc, 2) != 1) {
+                return PGRES_FATAL_ERROR;
+            }
+            run = value + 1;
+        }
+    }
+    if (PQputCopyData(sql->conn, "\n", 1) != 1) {
+        return PGRES_FATAL_ERROR;
+    }
+
+    return 0;
+}
+
+static int dbd_pgsql_bulk_end(apr_dbd_t *sql, int *nrows, int discard)
+{
+    PGresult *res;
+    int ret = 0;
+
+    if (PQputCopyEnd(sql->conn, discard ? "bulk load discarded" : NULL) != 1) {
+        ret = PGRES_FATAL_ERROR;
+    }
+    while ((res = PQgetResult(sql->conn))) {
+        int status = PQresultStatus(res);
+
+        if (!ret && !dbd_pgsql_is_success(status)) {
+            ret = status;
+        }
+        else if (!ret && nrows) {
+            *nrows = atoi(PQcmdTuples(res));
+        }
+        PQclear(res);
+    }
+    if (ret && nrows) {
+        *nrows = 0;
+    }
+    if (ret && !discard && TXN_NOTICE_ERRORS(sql->trans)) {
+        sql->trans->errnum = ret;
+    }
+
+    return ret;
+}
+
 APR_MODULE_DECLARE_DATA const apr_dbd_driver_t apr_dbd_pgsql_driver = {
     "pgsql",
     NULL,
@@ -1309,6 +1592,18 @@ APR_MODULE_DECLARE_DATA const apr_dbd_driver_t apr_dbd_pgsql_driver = {
     dbd_pgsql_pvbselect,
     dbd_pgsql_pbquery,
     dbd_pgsql_pbselect,
-    dbd_pgsql_datum_get
+    dbd_pgsql_datum_get,
+#ifdef LIBPQ_HAS_PIPELINING
+    dbd_pgsql_send_query,
+    dbd_pgsql_poll_result,
+    dbd_pgsql_socket_get,
+#else
+    NULL,
+    NULL,
+    NULL,
+#endif
+    dbd_pgsql_bulk_begin,
+    dbd_pgsql_bulk_append,
+    dbd_pgsql_bulk_end
 };
 #endif
@@ -44,6 +44,7 @@ struct apr_dbd_t {
     apr_dbd_transaction_t *trans;
     apr_pool_t *pool;
     apr_dbd_prepared_t *prep;
+    apr_dbd_results_t *streams;
 };
 
 typedef struct {
@@ -51,6 +52,10 @@ typedef struct {
     char *value;
     int size;
     int type;
+    union {
+        apr_int64_t i;
+        double d;
+    } num;
 } apr_dbd_column_t;
 
 struct apr_dbd_row_t {
@@ -70,6 +75,10 @@ struct apr_dbd_results_t {
     int tuples;
     char **col_names;
     apr_pool_t *pool;
+    apr_pool_t *rowpool;        /* the current row, when streaming */
+    apr_dbd_t *sql;
+    apr_dbd_results_t *next_stream;
+    int finalize;               /* the statement goes with the results */
 };
 
 struct apr_dbd_prepared_t {
@@ -82,93 +91,180 @@ struct apr_dbd_prepared_t {
 
 #define dbd_sqlite3_is_success(x) (((x) == SQLITE_DONE) || ((x) == SQLITE_OK))
 
+static int dbd_sqlite3_step(sqlite3_stmt *stmt)
+{
+    int ret, retry_count = 0;
+
+    while ((ret = sqlite3_step(stmt)) == SQLITE_BUSY) {
+        if (retry_count++ > MAX_RETRY_COUNT) {
+            return SQLITE_ERROR;
+        }
+        apr_dbd_mutex_unlock();
+        apr_sleep(MAX_RETRY_SLEEP);
+        apr_dbd_mutex_lock();
+    }
+    return ret;
+}
+
+static apr_dbd_row_t *dbd_sqlite3_fetch_row(apr_pool_t *pool,
+                                            apr_dbd_results_t *res)
+{
+    sqlite3_stmt *stmt = res->stmt;
+    apr_dbd_row_t *row;
+    apr_dbd_column_t *column;
+    const char *hold;
+    size_t i;
+
+    row = apr_palloc(pool, sizeof(apr_dbd_row_t));
+    row->res = res;
+    row->columns = apr_palloc(pool, sizeof(apr_dbd_column_t *) * res->sz);
+    row->columnCount = res->sz;
+    for (i = 0; i < res->sz; i++) {
+        column = apr_palloc(pool, sizeof(apr_dbd_column_t));
+        row->columns[i] = column;
+        /* copy column name once only */
+        if (res->col_names[i] == NULL) {
+            res->col_names[i] = apr_pstrdup(res->pool,
+                                            sqlite3_column_name(stmt, i));
+        }
+        column->name = res->col_names[i];
+        column->type = sqlite3_column_type(stmt, i);
+        column->value = NULL;
+        /* keep numbers as they are, datum_get won't parse them back */
+        switch (column->type) {
+        case SQLITE_INTEGER:
+            column->num.i = sqlite3_column_int64(stmt, i);
+            break;
+        case SQLITE_FLOAT:
+            column->num.d = sqlite3_column_double(stmt, i);
+            break;
+        }
+        switch (column->type) {
+        case SQLITE_FLOAT:
+        case SQLITE_INTEGER:
+        case SQLITE_TEXT:
+            hold = (const char *) sqlite3_column_text(stmt, i);
+            column->size = sqlite3_column_bytes(stmt, i);
+            if (hold) {
+                column->value = apr_pstrmemdup(pool, hold, column->size);
+            }
+            break;
+        case SQLITE_BLOB:
+            hold = sqlite3_column_blob(stmt, i);
+            column->size = sqlite3_column_bytes(stmt, i);
+            if (hold) {
+                column->value = apr_pstrmemdup(pool, hold, column->size);
+            }
+            break;
+        case SQLITE_NULL:
+            column->size = 0;
+            break;
+        }
+    }
+    row->rownum = res->tuples++;
+    row->next_row = 0;
+
+    return row;
+}
+
+static apr_status_t dbd_sqlite3_stream_end(void *data)
+{
+    apr_dbd_results_t *res = data;
+    apr_dbd_results_t **prev;
+
+    apr_dbd_mutex_lock();
+    if (res->stmt) {
+        if (res->finalize) {
+            sqlite3_finalize(res->stmt);
+        }
+        else {
+            sqlite3_reset(res->stmt);
+        }
+        res->stmt = NULL;
+    }
+    apr_dbd_mutex_unlock();
+
+    for (prev = &res->sql->streams; *prev; prev = &(*prev)->next_stream) {
+        if (*prev == res) {
+            *prev = res->next_stream;
+            break;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+/* end the stream still running stmt, or all of them for NULL */
+static void dbd_sqlite3_streams_end(apr_dbd_t *sql, sqlite3_stmt *stmt)
+{
+    apr_dbd_results_t *res = sql->streams, *next;
+
+    while (res) {
+        next = res->next_stream;
+        if (!stmt || res->stmt == stmt) {
+            apr_pool_cleanup_run(res->pool, res, dbd_sqlite3_stream_end);
+        }
+        res = next;
+    }
+}
+
+/*
+ * A random access select steps through the statement here and copies all
+ * of the rows.  Otherwise only the first one is, to report errors, and the
+ * statement is left running for get_row to step it a row at a time into
+ * rowpool, cleared in between: the results stay in constant memory.
+ * Returns with (*results)->stmt still set in the latter case only.
+ */
 static int dbd_sqlite3_select_internal(apr_pool_t *pool,
                                        apr_dbd_t *sql,
                                        apr_dbd_results_t **results,
                                        sqlite3_stmt *stmt, int seek)
 {
-    int ret, retry_count = 0, column_count;
-    size_t i, num_tuples = 0;
-    int increment = 0;
+    apr_dbd_results_t *res;
     apr_dbd_row_t *row = NULL;
     apr_dbd_row_t *lastrow = NULL;
-    apr_dbd_column_t *column;
-    char *hold = NULL;
+    int ret;
 
-    column_count = sqlite3_column_count(stmt);
     if (!*results) {
         *results = apr_pcalloc(pool, sizeof(apr_dbd_results_t));
     }
-    (*results)->stmt = stmt;
-    (*results)->sz = column_count;
-    (*results)->random = seek;
-    (*results)->next_row = 0;
-    (*results)->tuples = 0;
-    (*results)->col_names = apr_pcalloc(pool, column_count * sizeof(char *));
-    (*results)->pool = pool;
-    do {
-        ret = sqlite3_step(stmt);
-        if (ret == SQLITE_BUSY) {
-            if (retry_count++ > MAX_RETRY_COUNT) {
-                ret = SQLITE_ERROR;
-            } else {
-                apr_dbd_mutex_unlock();
-                apr_sleep(MAX_RETRY_SLEEP);
-                apr_dbd_mutex_lock();
-            }
-        } else if (ret == SQLITE_ROW) {
-            int length;
-            row = apr_palloc(pool, sizeof(apr_dbd_row_t));
-            row->res = *results;
-            increment = sizeof(apr_dbd_column_t *);
-            length = increment * (*results)->sz;
-            row->columns = apr_palloc(pool, length);
-            row->columnCount = column_count;
-            for (i = 0; i < (*results)->sz; i++) {
-                column = apr_palloc(pool, sizeof(apr_dbd_column_t));
-                row->columns[i] = column;
-                /* copy column name once only */
-                if ((*results)->col_names[i] == NULL) {
-                    (*results)->col_names[i] =
-                        apr_pstrdup(pool, sqlite3_column_name(stmt, i));
-                }
-                column->name = (*results)->col_names[i];
-                column->size = sqlite3_column_bytes(stmt, i);
-                column->type = sqlite3_column_type(stmt, i);
-                column->value = NULL;
-                switch (column->type) {
-                case SQLITE_FLOAT:
-                case SQLITE_INTEGER:
-                case SQLITE_TEXT:
-                    hold = (char *) sqlite3_column_text(stmt, i);
-                    if (hold) {
-                        column->value = apr_pstrmemdup(pool, hold,
-                                                       column->size);
-                    }
-                    break;
-                case SQLITE_BLOB:
-                    hold = (char *) sqlite3_column_blob(stmt, i);
-                    if (hold) {
-                        column->value = apr_pstrmemdup(pool, hold,
-                                                       column->size);
-                    }
-                    break;
-                case SQLITE_NULL:
-                    break;
-                }
-            }
-            row->rownum = num_tuples++;
-            row->next_row = 0;
-            (*results)->tuples = num_tuples;
-            if ((*results)->next_row == 0) {
-                (*results)->next_row = row;
+    res = *results;
+    res->stmt = stmt;
+    res->sz = sqlite3_column_count(stmt);
+    res->random = seek;
+    res->next_row = 0;
+    res->tuples = 0;
+    res->col_names = apr_pcalloc(pool, res->sz * sizeof(char *));
+    res->pool = pool;
+    res->rowpool = NULL;
+    res->sql = sql;
+    res->finalize = 0;
+
+    if (!seek) {
+        apr_pool_create(&res->rowpool, pool);
+        ret = dbd_sqlite3_step(stmt);
+        if (ret == SQLITE_ROW) {
+            res->next_row = dbd_sqlite3_fetch_row(res->rowpool, res);
+            res->next_stream = sql->streams;
+            sql->streams = res;
+            apr_pool_cleanup_register(pool, res, dbd_sqlite3_stream_end,
+                                      apr_pool_cleanup_null);
+            return 0;
+        }
+    }
+    else {
+        while ((ret = dbd_sqlite3_step(stmt)) == SQLITE_ROW) {
+            row = dbd_sqlite3_fetch_row(pool, res);
+            if (lastrow == 0) {
+                res->next_row = row;
             }
-            if (lastrow != 0) {
+            else {
                 lastrow->next_row = row;
             }
             lastrow = row;
         }
-    } while (ret == SQLITE_ROW || ret == SQLITE_BUSY);
+    }
+    res->stmt = NULL;
 
     if (dbd_sqlite3_is_success(ret)) {
         ret = 0;
@@ -194,7 +290,12 @@ static int dbd_sqlite3_select(apr_pool_t *pool, apr_dbd_t *sql,
     if (dbd_sqlite3_is_success(ret)) {
         ret = dbd_sqlite3_select_internal(pool, sql, results, stmt, seek);
     }
-    sqlite3_finalize(stmt);
+    if (stmt && (*results)->stmt == stmt) {
+        (*results)->finalize = 1;
+    }
+    else {
+        sqlite3_finalize(stmt);
+    }
 
     apr_dbd_mutex_unlock();
 
@@ -218,6 +319,31 @@ static int dbd_sqlite3_get_row(apr_pool_t *pool, apr_dbd_results_t *res,
 {
     int i = 0;
 
+    if (!res->random) {
+        int ret;
+
+        /* the first row was stepped to by the select */
+        if (res->next_row) {
+            *rowp = res->next_row;
+            res->next_row = 0;
+            return 0;
+        }
+        if (!res->stmt) {
+            return -1;
+        }
+        apr_pool_clear(res->rowpool);
+        apr_dbd_mutex_lock();
+        ret = dbd_sqlite3_step(res->stmt);
+        if (ret == SQLITE_ROW) {
+            *rowp = dbd_sqlite3_fetch_row(res->rowpool, res);
+        }
+        apr_dbd_mutex_unlock();
+        if (ret != SQLITE_ROW) {
+            apr_pool_cleanup_run(res->pool, res, dbd_sqlite3_stream_end);
+            return -1;
+        }
+        return 0;
+    }
     if (rownum == -1) {
         *rowp = res->next_row;
         if (*rowp == 0)
@@ -252,6 +378,30 @@ static const char *dbd_sqlite3_get_entry(const apr_dbd_row_t *row, int n)
     return value;
 }
 
+static apr_int64_t dbd_sqlite3_int(const apr_dbd_column_t *column)
+{
+    switch (column->type) {
+    case SQLITE_INTEGER:
+        return column->num.i;
+    case SQLITE_FLOAT:
+        return (apr_int64_t)column->num.d;
+    default:
+        return apr_atoi64(column->value);
+    }
+}
+
+static double dbd_sqlite3_double(const apr_dbd_column_t *column)
+{
+    switch (column->type) {
+    case SQLITE_INTEGER:
+        return (double)column->num.i;
+    case SQLITE_FLOAT:
+        return column->num.d;
+    default:
+        return atof(column->value);
+    }
+}
+
 static apr_status_t dbd_sqlite3_datum_get(const apr_dbd_row_t *row, int n,
                                           apr_dbd_type_e type, void *data)
 {
@@ -265,40 +415,41 @@ static apr_status_t dbd_sqlite3_datum_get(const apr_dbd_row_t *row, int n,
 
     switch (type) {
     case APR_DBD_TYPE_TINY:
-        *(char*)data = atoi(row->columns[n]->value);
+        *(char*)data = (char)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_UTINY:
-        *(unsigned char*)data = atoi(row->columns[n]->value);
+        *(unsigned char*)data = (unsigned char)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_SHORT:
-        *(short*)data = atoi(row->columns[n]->value);
+        *(short*)data = (short)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_USHORT:
-        *(unsigned short*)data = atoi(row->columns[n]->value);
+        *(unsigned short*)data =
+            (unsigned short)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_INT:
-        *(int*)data = atoi(row->columns[n]->value);
+        *(int*)data = (int)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_UINT:
-        *(unsigned int*)data = atoi(row->columns[n]->value);
+        *(unsigned int*)data = (unsigned int)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_LONG:
-        *(long*)data = atol(row->columns[n]->value);
+        *(long*)data = (long)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_ULONG:
-        *(unsigned long*)data = atol(row->columns[n]->value);
+        *(unsigned long*)data = (unsigned long)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_LONGLONG:
-        *(apr_int64_t*)data = apr_atoi64(row->columns[n]->value);
+        *(apr_int64_t*)data = dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_ULONGLONG:
-        *(apr_uint64_t*)data = apr_atoi64(row->columns[n]->value);
+        *(apr_uint64_t*)data = (apr_uint64_t)dbd_sqlite3_int(row->columns[n]);
         break;
     case APR_DBD_TYPE_FLOAT:
-        *(float*)data = (float)atof(row->columns[n]->value);
+        *(float*)data = (float)dbd_sqlite3_double(row->columns[n]);
         break;
     case APR_DBD_TYPE_DOUBLE:
-        *(double*)data = atof(row->columns[n]->value);
+        *(double*)data = dbd_sqlite3_double(row->columns[n]);
         break;
     case APR_DBD_TYPE_STRING:
     case APR_DBD_TYPE_TEXT:
@@ -317,7 +468,9 @@ static apr_status_t dbd_sqlite3_datum_get(const apr_dbd_row_t *row, int n,
 
         e = apr_bucket_pool_create(row->columns[n]->value,
                                    row->columns[n]->size,
-                                   row->res->pool, b->bucket_alloc);
+                                   row->res->rowpool ? row->res->rowpool
+                                                     : row->res->pool,
+                                   b->bucket_alloc);
         APR_BRIGADE_INSERT_TAIL(b, e);
         }
         break;
@@ -444,7 +597,8 @@ static int dbd_sqlite3_prepare(apr_pool_t *pool, apr_dbd_t *sql,
     return ret;
 }
 
-static void dbd_sqlite3_bind(apr_dbd_prepared_t *statement, const char **values)
+static void dbd_sqlite3_bind(apr_dbd_prepared_t *statement, const char **values,
+                             sqlite3_destructor_type copy)
 {
     sqlite3_stmt *stmt = statement->stmt;
     int i, j;
@@ -464,12 +618,12 @@ static void dbd_sqlite3_bind(apr_dbd_prepared_t *statement, const char **values)
                 /* skip table and column */
                 j += 2;
 
-                sqlite3_bind_blob(stmt, i + 1, data, size, SQLITE_STATIC);
+                sqlite3_bind_blob(stmt, i + 1, data, size, copy);
                 }
                 break;
             default:
                 sqlite3_bind_text(stmt, i + 1, values[j],
-                                  strlen(values[j]), SQLITE_STATIC);
+                                  strlen(values[j]), copy);
                 break;
             }
         }
@@ -493,7 +647,7 @@ static int dbd_sqlite3_pquery(apr_pool_t *pool, apr_dbd_t *sql,
 
     ret = sqlite3_reset(stmt);
     if (ret == SQLITE_OK) {
-        dbd_sqlite3_bind(statement, values);
+        dbd_sqlite3_bind(statement, values, SQLITE_STATIC);
 
         ret = dbd_sqlite3_query_internal(sql, stmt, nrows);
 
@@ -539,15 +693,21 @@ static int dbd_sqlite3_pselect(apr_pool_t *pool, apr_dbd_t *sql,
         return sql->trans->errnum;
     }
 
+    dbd_sqlite3_streams_end(sql, stmt);
+
     apr_dbd_mutex_lock();
 
     ret = sqlite3_reset(stmt);
     if (ret == SQLITE_OK) {
-        dbd_sqlite3_bind(statement, values);
+        /* a stream outlives the caller's values */
+        dbd_sqlite3_bind(statement, values,
+                       seek ? SQLITE_STATIC : SQLITE_TRANSIENT);
 
         ret = dbd_sqlite3_select_internal(pool, sql, results, stmt, seek);
 
-        sqlite3_reset(stmt);
+        if ((*results)->stmt != stmt) {
+            sqlite3_reset(stmt);
+        }
     }
 
     apr_dbd_mutex_unlock();
@@ -580,7 +740,8 @@ static int dbd_sqlite3_pvselect(apr_pool_t *pool, apr_dbd_t *sql,
 }
 
 static void dbd_sqlite3_bbind(apr_dbd_prepared_t * statement,
-                              const void **values)
+                              const void **values,
+                              sqlite3_destructor_type copy)
 {
     sqlite3_stmt *stmt = statement->stmt;
     int i, j;
@@ -634,7 +795,7 @@ static void dbd_sqlite3_bbind(apr_dbd_prepared_t * statement,
         case APR_DBD_TYPE_TIMESTAMP:
         case APR_DBD_TYPE_ZTIMESTAMP:
             sqlite3_bind_text(stmt, i + 1, values[j], strlen(values[j]),
-                              SQLITE_STATIC);
+                              copy);
             break;
         case APR_DBD_TYPE_BLOB:
         case APR_DBD_TYPE_CLOB:
@@ -642,7 +803,7 @@ static void dbd_sqlite3_bbind(apr_dbd_prepared_t * statement,
             char *data = (char*)values[j];
             apr_size_t size = *(apr_size_t*)values[++j];
 
-            sqlite3_bind_blob(stmt, i + 1, data, size, SQLITE_STATIC);
+            sqlite3_bind_blob(stmt, i + 1, data, size, copy);
 
             /* skip table and column */
             j += 2;
@@ -673,7 +834,7 @@ static int dbd_sqlite3_pbquery(apr_pool_t * pool, apr_dbd_t * sql,
 
     ret = sqlite3_reset(stmt);
     if (ret == SQLITE_OK) {
-        dbd_sqlite3_bbind(statement, values);
+        dbd_sqlite3_bbind(statement, values, SQLITE_STATIC);
 
         ret = dbd_sqlite3_query_internal(sql, stmt, nrows);
 
@@ -720,15 +881,21 @@ static int dbd_sqlite3_pbselect(apr_pool_t * pool, apr_dbd_t * sql,
         return sql->trans->errnum;
     }
 
+    dbd_sqlite3_streams_end(sql, stmt);
+
     apr_dbd_mutex_lock();
 
     ret = sqlite3_reset(stmt);
     if (ret == SQLITE_OK) {
-        dbd_sqlite3_bbind(statement, values);
+        /* a stream outlives the caller's values */
+        dbd_sqlite3_bbind(statement, values,
+                       seek ? SQLITE_STATIC : SQLITE_TRANSIENT);
 
         ret = dbd_sqlite3_select_internal(pool, sql, results, stmt, seek);
 
-        sqlite3_reset(stmt);
+        if ((*results)->stmt != stmt) {
+            sqlite3_reset(stmt);
+        }
     }
 
     apr_dbd_mutex_unlock();
@@ -842,6 +1009,8 @@ static apr_status_t dbd_sqlite3_close(apr_dbd_t *handle)
 {
     apr_dbd_prepared_t *prep = handle->prep;
 
+    dbd_sqlite3_streams_end(handle, NULL);
+
     /* finalize all prepared statements, or we'll get SQLITE_BUSY on close */
     while (prep) {
         sqlite3_finalize(prep->stmt);
@@ -876,6 +1045,9 @@ static int dbd_sqlite3_num_cols(apr_dbd_results_t *res)
 
 static int dbd_sqlite3_num_tuples(apr_dbd_results_t *res)
 {
+    if (!res->random) {
+        return -1;
+    }
     return res->tuples;
 }
 
@@ -63,11 +63,14 @@
 
 static apr_hash_t *drivers = NULL;
 static apr_uint32_t initialised = 0, in_init = 1;
+/* The drivers of the hash, for lookups without the dso mutex */
+static apu_dso_driver_t *volatile loaded = NULL;
 
 static apr_status_t dbm_term(void *ptr)
 {
     /* set drivers to NULL so init can work again */
     drivers = NULL;
+    loaded = NULL;
 
     /* Everything else we need is handled by cleanups registered
      * when we created mutexes and loaded DSOs
@@ -92,6 +95,7 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **vtable,
 
     *vtable = NULL;
     if (!strcasecmp(type, "default"))     *vtable = &DBM_VTABLE;
+    else if (!strcasecmp(type, "cdb"))    *vtable = &apr_dbm_type_cdb;
 #if APU_HAVE_DB
     else if (!strcasecmp(type, "db"))     *vtable = &apr_dbm_type_db;
 #endif
@@ -142,6 +146,7 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **vtable,
 
     if (!strcasecmp(type, "default"))        type = DBM_NAME;
     else if (!strcasecmp(type, "db"))        type = "db";
+    else if (!strcasecmp(type, "cdb"))       type = "cdb";
     else if (*type && !strcasecmp(type + 1, "dbm")) {
         if      (*type == 'G' || *type == 'g') type = "gdbm"; 
         else if (*type == 'N' || *type == 'n') type = "ndbm"; 
@@ -169,6 +174,9 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **vtable,
 
         drivers = apr_hash_make(pool);
         apr_hash_set(drivers, "sdbm", APR_HASH_KEY_STRING, &apr_dbm_type_sdbm);
+        apr_hash_set(drivers, "cdb", APR_HASH_KEY_STRING, &apr_dbm_type_cdb);
+        apu_dso_driver_set(&loaded, "sdbm", &apr_dbm_type_sdbm, pool);
+        apu_dso_driver_set(&loaded, "cdb", &apr_dbm_type_cdb, pool);
 
         apr_pool_cleanup_register(pool, NULL, dbm_term,
                                   apr_pool_cleanup_null);
@@ -176,6 +184,11 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **vtable,
         apr_atomic_dec32(&in_init);
     }
 
+    *vtable = apu_dso_driver_get(&loaded, type);
+    if (*vtable) {
+        return APR_SUCCESS;
+    }
+
     rv = apu_dso_mutex_lock();
     if (rv) {
         *vtable = NULL;
@@ -209,6 +222,7 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **vtable,
         if (usertype)
             type = apr_pstrdup(pool, type);
         apr_hash_set(drivers, type, APR_HASH_KEY_STRING, *vtable);
+        apu_dso_driver_set(&loaded, type, *vtable, pool);
         rv = APR_SUCCESS;
     }
     else
@@ -279,6 +293,26 @@ APR_DECLARE(apr_status_t) apr_dbm_store(apr_dbm_t *dbm, apr_datum_t key,
     return (*dbm->type->store)(dbm, key, value);
 }
 
+APR_DECLARE(apr_status_t) apr_dbm_bulk_load(apr_dbm_t *dbm,
+                                            apr_dbm_bulk_next_fn_t *next,
+                                            void *baton)
+{
+    apr_datum_t key, value;
+    apr_status_t rv;
+
+    if (dbm->type->bulk_load) {
+        return (*dbm->type->bulk_load)(dbm, next, baton);
+    }
+
+    while ((rv = next(baton, &key, &value)) == APR_SUCCESS) {
+        if ((rv = (*dbm->type->store)(dbm, key, value)) != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    return rv == APR_EOF ? APR_SUCCESS : rv;
+}
+
 APR_DECLARE(apr_status_t) apr_dbm_delete(apr_dbm_t *dbm, apr_datum_t key)
 {
     return (*dbm->type->del)(dbm, key);
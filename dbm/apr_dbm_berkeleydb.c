@@ -398,7 +398,8 @@ APR_MODULE_DECLARE_DATA const apr_dbm_driver_t apr_dbm_type_db = {
     vt_db_firstkey,
     vt_db_nextkey,
     vt_db_freedatum,
-    vt_db_usednames
+    vt_db_usednames,
+    NULL
 };
 
 #endif /* APU_HAVE_DB */
@@ -0,0 +1,741 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A constant database: built once, then only read.
+ *
+ * The file is a header, the records one after the other, then the two
+ * levels of a minimal perfect hash ("hash, displace and compress"):
+ *
+ *   header   "aprcdb\0\1", count, buckets, slots, seed, tables, 0
+ *   records  klen, vlen, key, value
+ *   disp     one displacement per bucket
+ *   slots    check, offset of the record (0 when empty)
+ *
+ * all numbers being 32 bits little endian.  A key's 128 bit SipHash,
+ * keyed by the seed, gives its bucket, the two values its displacement
+ * turns into a slot, and the check telling most absent keys apart
+ * without touching the records.  Lookups thus read the displacement,
+ * the slot and, for a present key, the record, all in the mapped file,
+ * the data returned pointing right into it.
+ *
+ * Opened for writing, the records are kept in a hash table and written
+ * to a temporary file renamed over the database when it is closed (or
+ * bulk loaded), so that readers see either the old or the new one.
+ */
+
+#include "apr_strings.h"
+#include "apr_hash.h"
+#include "apr_mmap.h"
+#include "apr_siphash.h"
+#define APR_WANT_MEMFUNC
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>     /* for qsort */
+#endif
+
+#include "apu.h"
+#include "apr_private.h"
+
+#include "apr_dbm_private.h"
+
+#define CDB_MAGIC       "aprcdb\0\1"
+#define CDB_HDRSIZ      32
+#define CDB_RECHDR      8
+#define CDB_SLOTSIZ     8
+#define CDB_MAXDISP     (1 << 20)  /* displacements tried per bucket */
+#define CDB_MAXSEED     32         /* seeds tried before giving up */
+
+typedef struct {
+    apr_pool_t *pool;
+    const char *path;
+    apr_fileperms_t perm;
+    int rdonly;
+
+    /* the database file, read only */
+    apr_file_t *f;
+#if APR_HAS_MMAP
+    apr_mmap_t *mm;
+#endif
+    const unsigned char *base;
+    apr_size_t size;
+    apr_uint32_t nbuckets;
+    apr_uint32_t nslots;
+    apr_uint32_t recend;       /* end of the records, start of disp */
+    const unsigned char *disp;
+    const unsigned char *slots;
+    unsigned char key[APR_SIPHASH_KSIZE];
+    apr_uint32_t cursor;
+
+    /* the records being written */
+    apr_hash_t *recs;
+    apr_hash_index_t *hi;
+    int dirty;
+} cdb_t;
+
+static apr_uint32_t get32(const unsigned char *p)
+{
+    return (apr_uint32_t)p[0] | ((apr_uint32_t)p[1] << 8)
+           | ((apr_uint32_t)p[2] << 16) | ((apr_uint32_t)p[3] << 24);
+}
+
+static void put32(unsigned char *p, apr_uint32_t n)
+{
+    p[0] = (unsigned char)n;
+    p[1] = (unsigned char)(n >> 8);
+    p[2] = (unsigned char)(n >> 16);
+    p[3] = (unsigned char)(n >> 24);
+}
+
+static void cdb_setseed(unsigned char key[APR_SIPHASH_KSIZE],
+                        apr_uint32_t seed)
+{
+    memset(key, 0, APR_SIPHASH_KSIZE);
+    put32(key, seed);
+}
+
+/* the bucket, the two values and the check of a key */
+static void cdb_hash(const unsigned char key[APR_SIPHASH_KSIZE],
+                     const void *data, apr_size_t len, apr_uint32_t w[4])
+{
+    apr_uint64_t h[2];
+
+    apr_siphash24_128(h, data, len, key);
+    w[0] = (apr_uint32_t)h[0];
+    w[1] = (apr_uint32_t)(h[0] >> 32);
+    w[2] = (apr_uint32_t)h[1];
+    w[3] = (apr_uint32_t)(h[1] >> 32);
+}
+
+static APR_INLINE apr_uint32_t cdb_slot(const apr_uint32_t w[4],
+                                        apr_uint32_t d, apr_uint32_t m)
+{
+    apr_uint64_t f1 = w[1] % m, f2 = w[2] % m;
+
+    return (apr_uint32_t)((f1 + (d / m) * f2 + d % m) % m);
+}
+
+static apr_status_t set_error(apr_dbm_t *dbm, apr_status_t dbm_said)
+{
+    dbm->errcode = dbm_said;
+
+    if (dbm_said != APR_SUCCESS) {
+        dbm->errmsg = apr_psprintf(dbm->pool, "%pm", &dbm_said);
+    } else {
+        dbm->errmsg = NULL;
+    }
+
+    return dbm_said;
+}
+
+/* --------------------------------------------------------------------------
+**
+** READING
+*/
+
+static void cdb_unmap(cdb_t *db)
+{
+#if APR_HAS_MMAP
+    if (db->mm) {
+        apr_mmap_delete(db->mm);
+        db->mm = NULL;
+    }
+#endif
+    if (db->f) {
+        apr_file_close(db->f);
+        db->f = NULL;
+    }
+    db->base = NULL;
+}
+
+static apr_status_t cdb_map(cdb_t *db)
+{
+    apr_finfo_t finfo;
+    const unsigned char *hdr;
+    apr_uint64_t tables;
+    apr_status_t rv;
+
+    if ((rv = apr_file_open(&db->f, db->path, APR_FOPEN_READ
+                            | APR_FOPEN_BINARY, APR_FPROT_OS_DEFAULT,
+                            db->pool)) != APR_SUCCESS)
+        return rv;
+    if ((rv = apr_file_info_get(&finfo, APR_FINFO_SIZE, db->f))
+                != APR_SUCCESS)
+        goto error;
+    if (finfo.size < CDB_HDRSIZ || finfo.size > APR_UINT32_MAX) {
+        rv = APR_EGENERAL; /* ### better error? */
+        goto error;
+    }
+    db->size = (apr_size_t)finfo.size;
+
+#if APR_HAS_MMAP
+    if ((rv = apr_mmap_create(&db->mm, db->f, 0, db->size, APR_MMAP_READ,
+                              db->pool)) != APR_SUCCESS)
+        goto error;
+    db->base = db->mm->mm;
+#else
+    {
+        unsigned char *buf = apr_palloc(db->pool, db->size);
+
+        if ((rv = apr_file_read_full(db->f, buf, db->size, NULL))
+                    != APR_SUCCESS)
+            goto error;
+        db->base = buf;
+    }
+#endif
+
+    hdr = db->base;
+    db->nbuckets = get32(hdr + 12);
+    db->nslots = get32(hdr + 16);
+    db->recend = get32(hdr + 24);
+    tables = (apr_uint64_t)db->recend + 4 * (apr_uint64_t)db->nbuckets
+             + CDB_SLOTSIZ * (apr_uint64_t)db->nslots;
+    if (memcmp(hdr, CDB_MAGIC, 8) || !db->nbuckets || !db->nslots
+            || db->recend < CDB_HDRSIZ || tables != db->size) {
+        rv = APR_EGENERAL; /* ### better error? */
+        goto error;
+    }
+    cdb_setseed(db->key, get32(hdr + 20));
+    db->disp = db->base + db->recend;
+    db->slots = db->disp + 4 * (apr_size_t)db->nbuckets;
+
+    return APR_SUCCESS;
+
+error:
+    cdb_unmap(db);
+    return rv;
+}
+
+/* the record at off, if it is one */
+static int cdb_record(const cdb_t *db, apr_uint32_t off,
+                      apr_datum_t *key, apr_datum_t *val)
+{
+    apr_uint32_t klen, vlen;
+
+    if (off < CDB_HDRSIZ || off > db->recend
+            || db->recend - off < CDB_RECHDR)
+        return 0;
+    klen = get32(db->base + off);
+    vlen = get32(db->base + off + 4);
+    if ((apr_uint64_t)klen + vlen > db->recend - off - CDB_RECHDR)
+        return 0;
+
+    key->dptr = (char *)db->base + off + CDB_RECHDR;
+    key->dsize = klen;
+    val->dptr = key->dptr + klen;
+    val->dsize = vlen;
+
+    return 1;
+}
+
+static int cdb_find(const cdb_t *db, apr_datum_t key, apr_datum_t *pvalue)
+{
+    const unsigned char *slot;
+    apr_uint32_t w[4], d;
+    apr_datum_t k;
+
+    cdb_hash(db->key, key.dptr, key.dsize, w);
+    d = get32(db->disp + 4 * (apr_size_t)(w[0] % db->nbuckets));
+    slot = db->slots + CDB_SLOTSIZ * (apr_size_t)cdb_slot(w, d, db->nslots);
+
+    return get32(slot) == w[3]
+           && cdb_record(db, get32(slot + 4), &k, pvalue)
+           && k.dsize == key.dsize
+           && !memcmp(k.dptr, key.dptr, key.dsize);
+}
+
+/* --------------------------------------------------------------------------
+**
+** WRITING
+*/
+
+typedef struct {
+    const char *key;
+    apr_uint32_t klen;
+    apr_uint32_t vlen;
+    const char *val;
+    apr_uint32_t off;
+    apr_uint32_t w[4];
+} cdb_rec_t;
+
+typedef struct {
+    apr_uint32_t size;
+    apr_uint32_t id;
+} cdb_bucket_t;
+
+static int cdb_bucket_cmp(const void *a, const void *b)
+{
+    const cdb_bucket_t *x = a, *y = b;
+
+    if (x->size != y->size)
+        return x->size < y->size ? 1 : -1;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static apr_status_t cdb_put(cdb_t *db, const void *key, apr_size_t klen,
+                            const void *val, apr_size_t vlen)
+{
+    apr_datum_t *v;
+
+    if (klen > APR_UINT32_MAX - CDB_HDRSIZ - CDB_RECHDR
+            || vlen > APR_UINT32_MAX - CDB_HDRSIZ - CDB_RECHDR - klen)
+        return APR_EINVAL;
+
+    v = apr_palloc(db->pool, sizeof(*v) + klen + vlen);
+    v->dptr = (char *)(v + 1) + klen;
+    v->dsize = vlen;
+    memcpy((char *)(v + 1), key, klen);
+    memcpy(v->dptr, val, vlen);
+    apr_hash_set(db->recs, v + 1, klen, v);
+    db->dirty = 1;
+
+    return APR_SUCCESS;
+}
+
+/*
+ * place each bucket's keys, the largest buckets first, at the first
+ * displacement sending them all to free slots
+ */
+static int cdb_place(cdb_rec_t *recs, apr_uint32_t n, apr_uint32_t r,
+                     apr_uint32_t m, apr_uint32_t *order,
+                     apr_uint32_t *start, cdb_bucket_t *buckets,
+                     apr_uint32_t *disp, apr_uint32_t *slot,
+                     apr_uint32_t *tmp)
+{
+    apr_uint32_t i, j, b, d, s;
+
+    memset(start, 0, (r + 1) * sizeof(*start));
+    for (i = 0; i < n; i++)
+        start[recs[i].w[0] % r + 1]++;
+    for (b = 0; b < r; b++) {
+        buckets[b].size = start[b + 1];
+        buckets[b].id = b;
+        start[b + 1] += start[b];
+    }
+    for (i = 0; i < n; i++)
+        order[start[recs[i].w[0] % r]++] = i;
+    for (b = r; b > 0; b--)
+        start[b] = start[b - 1];
+    start[0] = 0;
+    qsort(buckets, r, sizeof(*buckets), cdb_bucket_cmp);
+
+    memset(disp, 0, r * sizeof(*disp));
+    for (s = 0; s < m; s++)
+        slot[s] = APR_UINT32_MAX;
+
+    for (b = 0; b < r && buckets[b].size; b++) {
+        apr_uint32_t id = buckets[b].id, size = buckets[b].size;
+        apr_uint32_t *keys = order + start[id];
+
+        for (d = 0; d < CDB_MAXDISP; d++) {
+            for (j = 0; j < size; j++) {
+                s = cdb_slot(recs[keys[j]].w, d, m);
+                if (slot[s] != APR_UINT32_MAX)
+                    break;
+                slot[s] = keys[j];
+                tmp[j] = s;
+            }
+            if (j == size)
+                break;
+            while (j--)
+                slot[tmp[j]] = APR_UINT32_MAX;
+        }
+        if (d == CDB_MAXDISP)
+            return 0;
+        disp[id] = d;
+    }
+
+    return 1;
+}
+
+static apr_status_t cdb_write(cdb_t *db)
+{
+    apr_pool_t *p;
+    apr_hash_index_t *hi;
+    apr_file_t *f = NULL;
+    apr_fileperms_t perm;
+    cdb_rec_t *recs;
+    unsigned char hdr[CDB_HDRSIZ], *tables;
+    apr_uint32_t *order, *start, *disp, *slot, *tmp;
+    cdb_bucket_t *buckets;
+    apr_uint32_t i, n, r, m, seed;
+    apr_uint64_t off = CDB_HDRSIZ;
+    char *tmpname = NULL, *templ;
+    apr_status_t rv;
+
+    if ((rv = apr_pool_create(&p, db->pool)) != APR_SUCCESS)
+        return rv;
+
+    n = apr_hash_count(db->recs);
+    r = n / 4 + 1;
+    m = n + n / 4 + 1;
+    recs = apr_palloc(p, n * sizeof(*recs) + 1);
+    for (i = 0, hi = apr_hash_first(p, db->recs); hi;
+         i++, hi = apr_hash_next(hi)) {
+        const void *key;
+        apr_ssize_t klen;
+        void *val;
+
+        apr_hash_this(hi, &key, &klen, &val);
+        recs[i].key = key;
+        recs[i].klen = (apr_uint32_t)klen;
+        recs[i].val = ((apr_datum_t *)val)->dptr;
+        recs[i].vlen = (apr_uint32_t)((apr_datum_t *)val)->dsize;
+        recs[i].off = (apr_uint32_t)off;
+        off += CDB_RECHDR + (apr_uint64_t)recs[i].klen + recs[i].vlen;
+        if (off > APR_UINT32_MAX) {
+            rv = APR_ENOSPC;
+            goto error;
+        }
+    }
+    if (off + 4 * (apr_uint64_t)r + CDB_SLOTSIZ * (apr_uint64_t)m
+            > APR_UINT32_MAX) {
+        rv = APR_ENOSPC;
+        goto error;
+    }
+
+    order = apr_palloc(p, n * sizeof(*order) + 1);
+    start = apr_palloc(p, (r + 1) * sizeof(*start));
+    buckets = apr_palloc(p, r * sizeof(*buckets));
+    disp = apr_palloc(p, r * sizeof(*disp));
+    slot = apr_palloc(p, m * sizeof(*slot));
+    tmp = apr_palloc(p, n * sizeof(*tmp) + 1);
+    for (seed = 0; seed < CDB_MAXSEED; seed++) {
+        unsigned char key[APR_SIPHASH_KSIZE];
+
+        cdb_setseed(key, seed);
+        for (i = 0; i < n; i++)
+            cdb_hash(key, recs[i].key, recs[i].klen, recs[i].w);
+        if (cdb_place(recs, n, r, m, order, start, buckets, disp, slot, tmp))
+            break;
+    }
+    if (seed == CDB_MAXSEED) {
+        rv = APR_EGENERAL; /* ### better error? */
+        goto error;
+    }
+
+    tables = apr_palloc(p, 4 * (apr_size_t)r + CDB_SLOTSIZ * (apr_size_t)m);
+    for (i = 0; i < r; i++)
+        put32(tables + 4 * (apr_size_t)i, disp[i]);
+    for (i = 0; i < m; i++) {
+        unsigned char *s = tables + 4 * (apr_size_t)r
+                           + CDB_SLOTSIZ * (apr_size_t)i;
+
+        put32(s, slot[i] == APR_UINT32_MAX ? 0 : recs[slot[i]].w[3]);
+        put32(s + 4, slot[i] == APR_UINT32_MAX ? 0 : recs[slot[i]].off);
+    }
+
+    memcpy(hdr, CDB_MAGIC, 8);
+    put32(hdr + 8, n);
+    put32(hdr + 12, r);
+    put32(hdr + 16, m);
+    put32(hdr + 20, seed);
+    put32(hdr + 24, (apr_uint32_t)off);
+    put32(hdr + 28, 0);
+
+    templ = apr_pstrcat(p, db->path, ".XXXXXX", NULL);
+    if ((rv = apr_file_mktemp(&f, templ, APR_FOPEN_CREATE | APR_FOPEN_READ
+                              | APR_FOPEN_WRITE | APR_FOPEN_EXCL
+                              | APR_FOPEN_BINARY | APR_FOPEN_BUFFERED, p))
+                != APR_SUCCESS) {
+        f = NULL;
+        goto error;
+    }
+    tmpname = templ;
+    if ((rv = apr_file_write_full(f, hdr, CDB_HDRSIZ, NULL)) != APR_SUCCESS)
+        goto error;
+    for (i = 0; i < n; i++) {
+        unsigned char rec[CDB_RECHDR];
+
+        put32(rec, recs[i].klen);
+        put32(rec + 4, recs[i].vlen);
+        if ((rv = apr_file_write_full(f, rec, CDB_RECHDR, NULL))
+                    != APR_SUCCESS
+                || (rv = apr_file_write_full(f, recs[i].key, recs[i].klen,
+                                             NULL)) != APR_SUCCESS
+                || (rv = apr_file_write_full(f, recs[i].val, recs[i].vlen,
+                                             NULL)) != APR_SUCCESS)
+            goto error;
+    }
+    if ((rv = apr_file_write_full(f, tables, 4 * (apr_size_t)r
+                                  + CDB_SLOTSIZ * (apr_size_t)m, NULL))
+                != APR_SUCCESS
+            || (rv = apr_file_flush(f)) != APR_SUCCESS
+            || (rv = apr_file_datasync(f)) != APR_SUCCESS)
+        goto error;
+    rv = apr_file_close(f);
+    f = NULL;
+    if (rv != APR_SUCCESS)
+        goto error;
+
+    /* mktemp creates the file private, unlike a database */
+    perm = db->perm;
+    if (perm == APR_FPROT_OS_DEFAULT)
+        perm = APR_FPROT_UREAD | APR_FPROT_UWRITE | APR_FPROT_GREAD
+               | APR_FPROT_WREAD;
+    rv = apr_file_perms_set(tmpname, perm);
+    if (rv != APR_SUCCESS && !APR_STATUS_IS_ENOTIMPL(rv))
+        goto error;
+    if ((rv = apr_file_rename(tmpname, db->path, p)) != APR_SUCCESS)
+        goto error;
+
+    db->dirty = 0;
+    apr_pool_destroy(p);
+    return APR_SUCCESS;
+
+error:
+    if (f) {
+        apr_file_close(f);
+    }
+    if (tmpname) {
+        apr_file_remove(tmpname, p);
+    }
+    apr_pool_destroy(p);
+    return rv;
+}
+
+/* --------------------------------------------------------------------------
+**
+** DEFINE THE VTABLE FUNCTIONS FOR CDB
+*/
+
+static apr_status_t vt_cdb_open(apr_dbm_t **pdb, const char *pathname,
+                                apr_int32_t mode, apr_fileperms_t perm,
+                                apr_pool_t *pool)
+{
+    cdb_t *db;
+    apr_status_t rv;
+
+    *pdb = NULL;
+
+    switch (mode) {
+    case APR_DBM_READONLY:
+    case APR_DBM_READWRITE:
+    case APR_DBM_RWCREATE:
+    case APR_DBM_RWTRUNC:
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    db = apr_pcalloc(pool, sizeof(*db));
+    db->pool = pool;
+    db->path = apr_pstrdup(pool, pathname);
+    db->perm = perm;
+    db->rdonly = mode == APR_DBM_READONLY;
+
+    if (db->rdonly) {
+        if ((rv = cdb_map(db)) != APR_SUCCESS)
+            return rv;
+    }
+    else {
+        db->recs = apr_hash_make(pool);
+        if (mode == APR_DBM_RWTRUNC) {
+            db->dirty = 1;
+        }
+        else if ((rv = cdb_map(db)) == APR_SUCCESS) {
+            /* take the records to rewrite them */
+            apr_datum_t key, val;
+            apr_uint32_t off = CDB_HDRSIZ;
+
+            while (cdb_record(db, off, &key, &val)) {
+                cdb_put(db, key.dptr, key.dsize, val.dptr, val.dsize);
+                off += CDB_RECHDR + key.dsize + val.dsize;
+            }
+            cdb_unmap(db);
+            db->dirty = 0;
+        }
+        else if (APR_STATUS_IS_ENOENT(rv) && mode == APR_DBM_RWCREATE) {
+            db->dirty = 1;
+        }
+        else {
+            return rv;
+        }
+    }
+
+    /* we have an open database... return it */
+    *pdb = apr_pcalloc(pool, sizeof(**pdb));
+    (*pdb)->pool = pool;
+    (*pdb)->type = &apr_dbm_type_cdb;
+    (*pdb)->file = db;
+
+    return APR_SUCCESS;
+}
+
+static void vt_cdb_close(apr_dbm_t *dbm)
+{
+    cdb_t *db = dbm->file;
+
+    if (db->dirty) {
+        /* ### nowhere to report a failure, bulk load to know about it */
+        (void)cdb_write(db);
+    }
+    cdb_unmap(db);
+}
+
+static apr_status_t vt_cdb_fetch(apr_dbm_t *dbm, apr_datum_t key,
+                                 apr_datum_t *pvalue)
+{
+    cdb_t *db = dbm->file;
+
+    if (db->rdonly) {
+        if (!cdb_find(db, key, pvalue)) {
+            pvalue->dptr = NULL;
+            pvalue->dsize = 0;
+        }
+    }
+    else {
+        apr_datum_t *v = apr_hash_get(db->recs, key.dptr, key.dsize);
+
+        pvalue->dptr = v ? v->dptr : NULL;
+        pvalue->dsize = v ? v->dsize : 0;
+    }
+
+    return set_error(dbm, APR_SUCCESS);
+}
+
+static apr_status_t vt_cdb_store(apr_dbm_t *dbm, apr_datum_t key,
+                                 apr_datum_t value)
+{
+    cdb_t *db = dbm->file;
+
+    if (db->rdonly || key.dptr == NULL || value.dptr == NULL)
+        return set_error(dbm, APR_EINVAL);
+
+    /* store any error info into DBM, and return a status code. */
+    return set_error(dbm, cdb_put(db, key.dptr, key.dsize, value.dptr,
+                                  value.dsize));
+}
+
+static apr_status_t vt_cdb_del(apr_dbm_t *dbm, apr_datum_t key)
+{
+    cdb_t *db = dbm->file;
+
+    if (db->rdonly || key.dptr == NULL)
+        return set_error(dbm, APR_EINVAL);
+
+    if (apr_hash_get(db->recs, key.dptr, key.dsize)) {
+        apr_hash_set(db->recs, key.dptr, key.dsize, NULL);
+        db->dirty = 1;
+    }
+
+    return set_error(dbm, APR_SUCCESS);
+}
+
+static int vt_cdb_exists(apr_dbm_t *dbm, apr_datum_t key)
+{
+    cdb_t *db = dbm->file;
+    apr_datum_t val;
+
+    if (db->rdonly)
+        return cdb_find(db, key, &val);
+    return apr_hash_get(db->recs, key.dptr, key.dsize) != NULL;
+}
+
+static apr_status_t vt_cdb_nextkey(apr_dbm_t *dbm, apr_datum_t *pkey)
+{
+    cdb_t *db = dbm->file;
+    apr_datum_t val;
+
+    pkey->dptr = NULL;
+    pkey->dsize = 0;
+
+    if (db->rdonly) {
+        if (cdb_record(db, db->cursor, pkey, &val))
+            db->cursor += CDB_RECHDR + pkey->dsize + val.dsize;
+    }
+    else if (db->hi) {
+        const void *key;
+        apr_ssize_t klen;
+
+        apr_hash_this(db->hi, &key, &klen, NULL);
+        pkey->dptr = (char *)key;
+        pkey->dsize = klen;
+        db->hi = apr_hash_next(db->hi);
+    }
+
+    return set_error(dbm, APR_SUCCESS);
+}
+
+static apr_status_t vt_cdb_firstkey(apr_dbm_t *dbm, apr_datum_t *pkey)
+{
+    cdb_t *db = dbm->file;
+
+    if (db->rdonly)
+        db->cursor = CDB_HDRSIZ;
+    else
+        db->hi = apr_hash_first(dbm->pool, db->recs);
+
+    return vt_cdb_nextkey(dbm, pkey);
+}
+
+static void vt_cdb_freedatum(apr_dbm_t *dbm, apr_datum_t data)
+{
+}
+
+static void vt_cdb_usednames(apr_pool_t *pool, const char *pathname,
+                             const char **used1, const char **used2)
+{
+    *used1 = apr_pstrdup(pool, pathname);
+    *used2 = NULL;
+}
+
+static apr_status_t vt_cdb_bulk_load(apr_dbm_t *dbm,
+                                     apr_dbm_bulk_next_fn_t *next,
+                                     void *baton)
+{
+    cdb_t *db = dbm->file;
+    apr_hash_t *recs;
+    apr_datum_t key, value;
+    apr_status_t rv;
+    int dirty = db->dirty;
+
+    if (db->rdonly)
+        return set_error(dbm, APR_EINVAL);
+
+    /* the records as they were, should the callback fail */
+    recs = apr_hash_copy(dbm->pool, db->recs);
+    while ((rv = next(baton, &key, &value)) == APR_SUCCESS) {
+        if ((rv = cdb_put(db, key.dptr, key.dsize, value.dptr,
+                          value.dsize)) != APR_SUCCESS)
+            break;
+    }
+    if (rv != APR_EOF) {
+        db->recs = recs;
+        db->dirty = dirty;
+        return set_error(dbm, rv);
+    }
+
+    /* store any error info into DBM, and return a status code. */
+    return set_error(dbm, cdb_write(db));
+}
+
+APR_MODULE_DECLARE_DATA const apr_dbm_driver_t apr_dbm_type_cdb = {
+    "cdb",
+    vt_cdb_open,
+    vt_cdb_close,
+    vt_cdb_fetch,
+    vt_cdb_store,
+    vt_cdb_del,
+    vt_cdb_exists,
+    vt_cdb_firstkey,
+    vt_cdb_nextkey,
+    vt_cdb_freedatum,
+    vt_cdb_usednames,
+    vt_cdb_bulk_load
+};
@@ -259,7 +259,8 @@ APR_MODULE_DECLARE_DATA const apr_dbm_driver_t apr_dbm_type_gdbm = {
     vt_gdbm_firstkey,
     vt_gdbm_nextkey,
     vt_gdbm_freedatum,
-    vt_gdbm_usednames
+    vt_gdbm_usednames,
+    NULL
 };
 
 #endif /* APU_HAVE_GDBM */
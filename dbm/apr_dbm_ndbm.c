@@ -232,7 +232,8 @@ APR_MODULE_DECLARE_DATA const apr_dbm_driver_t apr_dbm_type_ndbm = {
     vt_ndbm_firstkey,
     vt_ndbm_nextkey,
     vt_ndbm_freedatum,
-    vt_ndbm_usednames
+    vt_ndbm_usednames,
+    NULL
 };
 
 #endif /* APU_HAVE_NDBM  */
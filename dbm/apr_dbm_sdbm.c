@@ -209,6 +209,45 @@ static void vt_sdbm_usednames(apr_pool_t *pool, const char *pathname,
     *used2 = apr_pstrcat(pool, pathname, APR_SDBM_PAGFEXT, NULL);
 }
 
+typedef struct {
+    apr_dbm_bulk_next_fn_t *next;
+    void *baton;
+} vt_sdbm_bulk_t;
+
+static apr_status_t vt_sdbm_bulk_next(void *baton, apr_sdbm_datum_t *kd,
+                                      apr_sdbm_datum_t *vd)
+{
+    vt_sdbm_bulk_t *bulk = baton;
+    apr_datum_t key, value;
+    apr_status_t rv;
+
+    if ((rv = bulk->next(bulk->baton, &key, &value)) != APR_SUCCESS)
+        return rv;
+    if (key.dsize > APR_INT32_MAX || value.dsize > APR_INT32_MAX)
+        return APR_EINVAL;
+
+    kd->dptr = key.dptr;
+    kd->dsize = (int)key.dsize;
+    vd->dptr = value.dptr;
+    vd->dsize = (int)value.dsize;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t vt_sdbm_bulk_load(apr_dbm_t *dbm,
+                                      apr_dbm_bulk_next_fn_t *next,
+                                      void *baton)
+{
+    vt_sdbm_bulk_t bulk;
+
+    bulk.next = next;
+    bulk.baton = baton;
+
+    /* store any error info into DBM, and return a status code. */
+    return set_error(dbm, apr_sdbm_bulk_load(dbm->file, vt_sdbm_bulk_next,
+                                             &bulk));
+}
+
 APR_MODULE_DECLARE_DATA const apr_dbm_driver_t apr_dbm_type_sdbm = {
     "sdbm",
     vt_sdbm_open,
@@ -220,7 +259,8 @@ APR_MODULE_DECLARE_DATA const apr_dbm_driver_t apr_dbm_type_sdbm = {
     vt_sdbm_firstkey,
     vt_sdbm_nextkey,
     vt_sdbm_freedatum,
-    vt_sdbm_usednames
+    vt_sdbm_usednames,
+    vt_sdbm_bulk_load
 };
 
 #endif /* APU_HAVE_SDBM */
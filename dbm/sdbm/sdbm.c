@@ -25,6 +25,7 @@
 #include "apr.h"
 #include "apr_file_io.h"
 #include "apr_strings.h"
+#include "apr_tables.h"
 #include "apr_errno.h"
 #include "apr_sdbm.h"
 
@@ -33,7 +34,7 @@
 #include "sdbm_private.h"
 
 #include <string.h>     /* for memset() */
-#include <stdlib.h>     /* for malloc() and free() */
+#include <stdlib.h>     /* for malloc(), free() and qsort() */
 
 /*
  * forward
@@ -43,14 +44,21 @@ static apr_status_t setdbit(apr_sdbm_t *, long);
 static apr_status_t getpage(apr_sdbm_t *db, long, int, int);
 static apr_status_t getnext(apr_sdbm_datum_t *key, apr_sdbm_t *db);
 static apr_status_t makroom(apr_sdbm_t *, long, int);
+static int getslot(apr_sdbm_t *, sdbm_slot_t *, int, long, int *);
+static apr_status_t getvalue(apr_sdbm_t *, apr_sdbm_datum_t *);
+static apr_uint32_t getovf(apr_sdbm_t *, apr_sdbm_datum_t);
+static apr_status_t ovfwrite(apr_sdbm_t *, apr_sdbm_datum_t, apr_uint32_t *);
+static apr_status_t ovffree(apr_sdbm_t *, apr_uint32_t);
 
 /*
  * useful macros
  */
 #define bad(x)		((x).dptr == NULL || (x).dsize <= 0)
-#define exhash(item)	sdbm_hash((item).dptr, (item).dsize)
+#define exhash(db, item)	(db)->hash((item).dptr, (item).dsize)
 
-#define OFF_PAG(off)	(apr_off_t) (off) * PBLKSIZ
+#define OFF_PAG(db, off)	((db)->version == 1 ? (apr_off_t) (off) \
+				 : (apr_off_t) (off) * 2 + 1) * (db)->pagsize
+#define OFF_OVF(db, off)	((apr_off_t) (off) * 2 + 2) * (db)->pagsize
 #define OFF_DIR(off)	(apr_off_t) (off) * DBLKSIZ
 
 static const long masks[] = {
@@ -76,15 +84,131 @@ static apr_status_t database_cleanup(void *data)
      */
     if (db->flags & (SDBM_SHARED_LOCK | SDBM_EXCLUSIVE_LOCK))
         (void) apr_file_unlock(db->dirf);
+#if APR_HAS_MMAP
+    if (db->mappool)
+        apr_pool_destroy(db->mappool);
+#endif
     (void) apr_file_close(db->dirf);
     (void) apr_file_close(db->pagf);
+    free(db->pagcache);
+    free(db->twin);
+    free(db->valbuf);
     free(db);
 
     return APR_SUCCESS;
 }
 
+/*
+ * little endian fields of the version 2 header and overflow pages
+ */
+static apr_uint32_t get32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *) p;
+
+    return (apr_uint32_t)u[0] | (apr_uint32_t)u[1] << 8
+           | (apr_uint32_t)u[2] << 16 | (apr_uint32_t)u[3] << 24;
+}
+
+static void put32(char *p, apr_uint32_t v)
+{
+    p[0] = (char)(v & 0xff);
+    p[1] = (char)((v >> 8) & 0xff);
+    p[2] = (char)((v >> 16) & 0xff);
+    p[3] = (char)((v >> 24) & 0xff);
+}
+
+static apr_status_t read_from(apr_file_t *, void *, apr_off_t, apr_size_t,
+                              int);
+
+/*
+ * write the header block of a new version 2 page file
+ */
+static apr_status_t newheader(apr_sdbm_t *db)
+{
+    apr_status_t status;
+    apr_off_t off = 0;
+    char *hdr = calloc(1, db->pagsize);
+
+    if (hdr == NULL)
+        return APR_ENOMEM;
+
+    memcpy(hdr, SDBM2_MAGIC, 8);
+    put32(hdr + 8, (apr_uint32_t)db->pagsize);
+    put32(hdr + 12, SDBM2_HASH);
+
+    if ((status = apr_file_seek(db->pagf, APR_SET, &off)) == APR_SUCCESS)
+        status = apr_file_write_full(db->pagf, hdr, db->pagsize, NULL);
+    free(hdr);
+
+    return status;
+}
+
+/*
+ * find out the format of the database, or choose it if it is new
+ */
+static apr_status_t setformat(apr_sdbm_t *db, apr_size_t pagesize)
+{
+    apr_finfo_t finfo;
+    apr_status_t status;
+    char hdr[SDBM2_HDRSIZ];
+
+    db->version = 1;
+    db->pagsize = PBLKSIZ;
+    db->pairmax = PAIRMAX;
+    db->hash = sdbm_hash;
+
+    if ((status = apr_file_info_get(&finfo, APR_FINFO_SIZE, db->pagf))
+                != APR_SUCCESS)
+        return status;
+
+    if (finfo.size >= SDBM2_HDRSIZ) {
+        if ((status = read_from(db->pagf, hdr, 0, SDBM2_HDRSIZ, 0))
+                    != APR_SUCCESS)
+            return status;
+        /* the count of pairs of a version 1 page is never this large */
+        if (memcmp(hdr, SDBM2_MAGIC, 8) == 0) {
+            pagesize = get32(hdr + 8);
+            if (pagesize < SDBM2_MINPAGE || pagesize > SDBM2_MAXPAGE
+                    || (pagesize & (pagesize - 1))
+                    || get32(hdr + 12) != SDBM2_HASH)
+                return APR_EGENERAL; /* ### better error? */
+            db->version = 2;
+        }
+    }
+    else if (finfo.size == 0 && pagesize && !(db->flags & SDBM_RDONLY)) {
+        if (pagesize < SDBM2_MINPAGE || pagesize > SDBM2_MAXPAGE
+                || (pagesize & (pagesize - 1)))
+            return APR_EINVAL;
+        db->version = 2;
+    }
+
+    if (db->version == 2) {
+        db->pagsize = (int)pagesize;
+        db->pairmax = db->pagsize - 16;
+        db->inlinemax = db->pagsize / 4;
+        db->hash = sdbm_hash2;
+        if (finfo.size == 0 && (status = newheader(db)) != APR_SUCCESS)
+            return status;
+    }
+
+    db->pagcachen = PAGCACHE_BYTES / db->pagsize;
+    if (db->pagcachen > PAGCACHE)
+        db->pagcachen = PAGCACHE;
+    if (db->pagcachen < 2)
+        db->pagcachen = 2;
+
+    db->pagcache = calloc(db->pagcachen, db->pagsize);
+    db->twin = malloc(3 * (apr_size_t)db->pagsize);
+    if (db->pagcache == NULL || db->twin == NULL)
+        return APR_ENOMEM;
+    db->pagbuf = db->pagcache;
+
+    return APR_SUCCESS;
+}
+
 static apr_status_t prep(apr_sdbm_t **pdb, const char *dirname, const char *pagname,
-                         apr_int32_t flags, apr_fileperms_t perms, apr_pool_t *p)
+                         apr_int32_t flags, apr_fileperms_t perms,
+                         apr_size_t pagesize, apr_pool_t *p)
 {
     apr_sdbm_t *db;
     apr_status_t status;
@@ -94,6 +218,10 @@ static apr_status_t prep(apr_sdbm_t **pdb, const char *dirname, const char *pagn
     db = malloc(sizeof(*db));
     memset(db, 0, sizeof(*db));
     db->pagbno = -1L;
+    db->dirbno = -1L;
+    db->pagsize = PBLKSIZ;
+    db->dirbuf = db->dircache[0];
+    db->cachegen = 1;
 
     db->pool = p;
 
@@ -142,6 +270,9 @@ static apr_status_t prep(apr_sdbm_t **pdb, const char *dirname, const char *pagn
      * apr_sdbm_lock stated the dirf->size and invalidated the cache
      */
 
+    if ((status = setformat(db, pagesize)) != APR_SUCCESS)
+        goto error;
+
     /*
      * if we are opened in SHARED mode, unlock ourself 
      */
@@ -159,11 +290,17 @@ static apr_status_t prep(apr_sdbm_t **pdb, const char *dirname, const char *pagn
 error:
     if (db->dirf && db->pagf)
         (void) apr_sdbm_unlock(db);
+#if APR_HAS_MMAP
+    if (db->mappool)
+        apr_pool_destroy(db->mappool);
+#endif
     if (db->dirf != NULL)
         (void) apr_file_close(db->dirf);
     if (db->pagf != NULL) {
         (void) apr_file_close(db->pagf);
     }
+    free(db->pagcache);
+    free(db->twin);
     free(db);
     return status;
 }
@@ -175,7 +312,23 @@ APR_DECLARE(apr_status_t) apr_sdbm_open(apr_sdbm_t **db, const char *file,
     char *dirname = apr_pstrcat(p, file, APR_SDBM_DIRFEXT, NULL);
     char *pagname = apr_pstrcat(p, file, APR_SDBM_PAGFEXT, NULL);
     
-    return prep(db, dirname, pagname, flags, perms, p);
+    return prep(db, dirname, pagname, flags, perms, 0, p);
+}
+
+APR_DECLARE(apr_status_t) apr_sdbm_open_ex(apr_sdbm_t **db, const char *file,
+                                           apr_int32_t flags,
+                                           apr_fileperms_t perms,
+                                           apr_size_t pagesize, apr_pool_t *p)
+{
+    char *dirname = apr_pstrcat(p, file, APR_SDBM_DIRFEXT, NULL);
+    char *pagname = apr_pstrcat(p, file, APR_SDBM_PAGFEXT, NULL);
+    
+    return prep(db, dirname, pagname, flags, perms, pagesize, p);
+}
+
+APR_DECLARE(apr_size_t) apr_sdbm_pagesize(apr_sdbm_t *db)
+{
+    return db->version == 2 ? db->pagsize : 0;
 }
 
 APR_DECLARE(apr_status_t) apr_sdbm_close(apr_sdbm_t *db)
@@ -194,9 +347,11 @@ APR_DECLARE(apr_status_t) apr_sdbm_fetch(apr_sdbm_t *db, apr_sdbm_datum_t *val,
     if ((status = apr_sdbm_lock(db, APR_FLOCK_SHARED)) != APR_SUCCESS)
         return status;
 
-    if ((status = getpage(db, exhash(key), 0, 1)) == APR_SUCCESS) {
-        *val = getpair(db->pagbuf, key);
+    if ((status = getpage(db, exhash(db, key), 0, 1)) == APR_SUCCESS) {
+        *val = getpair(db->pagbuf, db->pagsize, key);
         /* ### do we want a not-found result? */
+        if (db->version == 2)
+            status = getvalue(db, val);
     }
 
     (void) apr_sdbm_unlock(db);
@@ -204,13 +359,40 @@ APR_DECLARE(apr_status_t) apr_sdbm_fetch(apr_sdbm_t *db, apr_sdbm_datum_t *val,
     return status;
 }
 
+/*
+ * drop the caches after a failed update, which may have left them
+ * ahead of the files
+ */
+static void dropcache(apr_sdbm_t *db)
+{
+    if (!++db->cachegen)
+        db->cachegen = 1;
+    db->pagbno = -1;
+    db->dirbno = -1;
+}
+
 static apr_status_t write_page(apr_sdbm_t *db, const char *buf, long pagno)
 {
     apr_status_t status;
-    apr_off_t off = OFF_PAG(pagno);
+    apr_off_t off = OFF_PAG(db, pagno);
+    int i;
     
     if ((status = apr_file_seek(db->pagf, APR_SET, &off)) == APR_SUCCESS)
-        status = apr_file_write_full(db->pagf, buf, PBLKSIZ, NULL);
+        status = apr_file_write_full(db->pagf, buf, db->pagsize, NULL);
+
+    /*
+     * keep a cached copy of the page, if not written from it, in sync
+     */
+    for (i = 0; i < db->pagcachen; i++) {
+        if (db->pagslot[i].gen == db->cachegen
+                && db->pagslot[i].bno == pagno) {
+            if (status != APR_SUCCESS)
+                db->pagslot[i].gen = 0;
+            else if (PAGCACHE_SLOT(db, i) != buf)
+                (void) memcpy(PAGCACHE_SLOT(db, i), buf, db->pagsize);
+            break;
+        }
+    }
 
     return status;
 }
@@ -219,6 +401,7 @@ APR_DECLARE(apr_status_t) apr_sdbm_delete(apr_sdbm_t *db,
                                           const apr_sdbm_datum_t key)
 {
     apr_status_t status;
+    apr_uint32_t ovf;
     
     if (db == NULL || bad(key))
         return APR_EINVAL;
@@ -228,12 +411,16 @@ APR_DECLARE(apr_status_t) apr_sdbm_delete(apr_sdbm_t *db,
     if ((status = apr_sdbm_lock(db, APR_FLOCK_EXCLUSIVE)) != APR_SUCCESS)
         return status;
 
-    if ((status = getpage(db, exhash(key), 0, 1)) == APR_SUCCESS) {
-        if (!delpair(db->pagbuf, key))
+    if ((status = getpage(db, exhash(db, key), 0, 1)) == APR_SUCCESS) {
+        ovf = getovf(db, key);
+        if (!delpair(db->pagbuf, db->pagsize, key))
             /* ### should we define some APRUTIL codes? */
             status = APR_EGENERAL;
-        else
-            status = write_page(db, db->pagbuf, db->pagbno);
+        else if ((status = write_page(db, db->pagbuf, db->pagbno))
+                    != APR_SUCCESS)
+            dropcache(db);
+        else if (ovf)
+            status = ovffree(db, ovf);
     }
 
     (void) apr_sdbm_unlock(db);
@@ -241,55 +428,114 @@ APR_DECLARE(apr_status_t) apr_sdbm_delete(apr_sdbm_t *db,
     return status;
 }
 
+/*
+ * the bytes a pair takes in a page, or -1 if too many: in the version 2
+ * format values are tagged, and only referenced when too large
+ */
+#define isinline(db, ksize, vsize) \
+    ((apr_int64_t) (ksize) + (vsize) + 1 <= (db)->inlinemax)
+
+static int pairsize(apr_sdbm_t *db, int ksize, int vsize)
+{
+    apr_int64_t need;
+
+    if (ksize < 0 || vsize < 0)
+        return -1;
+    need = (apr_int64_t)ksize + vsize;
+    if (db->version == 2) {
+        if (isinline(db, ksize, vsize))
+            need++;
+        else
+            need = (apr_int64_t)ksize + SDBM2_REFSIZ;
+    }
+    return need > db->pairmax ? -1 : (int)need;
+}
+
 APR_DECLARE(apr_status_t) apr_sdbm_store(apr_sdbm_t *db, apr_sdbm_datum_t key,
                                          apr_sdbm_datum_t val, int flags)
 {
     int need;
     register long hash;
     apr_status_t status;
+    apr_uint32_t ovf = 0, oldovf = 0;
     
     if (db == NULL || bad(key))
         return APR_EINVAL;
     if (apr_sdbm_rdonly(db))
         return APR_EINVAL;
-    need = key.dsize + val.dsize;
+    need = pairsize(db, key.dsize, val.dsize);
     /*
      * is the pair too big (or too small) for this database ??
      */
-    if (need < 0 || need > PAIRMAX)
+    if (need < 0)
         return APR_EINVAL;
 
     if ((status = apr_sdbm_lock(db, APR_FLOCK_EXCLUSIVE)) != APR_SUCCESS)
         return status;
 
-    if ((status = getpage(db, (hash = exhash(key)), 0, 1)) == APR_SUCCESS) {
+    if ((status = getpage(db, (hash = exhash(db, key)), 0, 1)) == APR_SUCCESS) {
 
         /*
          * if we need to replace, delete the key/data pair
          * first. If it is not there, ignore.
          */
-        if (flags == APR_SDBM_REPLACE)
-            (void) delpair(db->pagbuf, key);
-        else if (!(flags & APR_SDBM_INSERTDUP) && duppair(db->pagbuf, key)) {
+        if (flags == APR_SDBM_REPLACE) {
+            oldovf = getovf(db, key);
+            (void) delpair(db->pagbuf, db->pagsize, key);
+        }
+        else if (!(flags & APR_SDBM_INSERTDUP)
+                 && duppair(db->pagbuf, db->pagsize, key)) {
             status = APR_EEXIST;
             goto error;
         }
+        /*
+         * tag the value in the third spare page, or move it to overflow
+         * pages and reference them.
+         */
+        if (db->version == 2) {
+            char *tagged = db->twin + 2 * db->pagsize;
+
+            if (isinline(db, key.dsize, val.dsize)) {
+                tagged[0] = SDBM2_INLINE;
+                if (val.dsize)
+                    memcpy(tagged + 1, val.dptr, val.dsize);
+                val.dsize++;
+            }
+            else {
+                if ((status = ovfwrite(db, val, &ovf)) != APR_SUCCESS)
+                    goto error;
+                tagged[0] = SDBM2_OVERFLOW;
+                put32(tagged + 1, (apr_uint32_t)val.dsize);
+                put32(tagged + 5, ovf);
+                val.dsize = SDBM2_REFSIZ;
+            }
+            val.dptr = tagged;
+        }
         /*
          * if we do not have enough room, we have to split.
          */
-        if (!fitpair(db->pagbuf, need))
+        if (!fitpair(db->pagbuf, db->pagsize, need))
             if ((status = makroom(db, hash, need)) != APR_SUCCESS)
                 goto error;
         /*
          * we have enough room or split is successful. insert the key,
          * and update the page file.
          */
-        (void) putpair(db->pagbuf, key, val);
+        (void) putpair(db->pagbuf, db->pagsize, key, val);
 
-        status = write_page(db, db->pagbuf, db->pagbno);
+        if ((status = write_page(db, db->pagbuf, db->pagbno))
+                    == APR_SUCCESS) {
+            ovf = 0;
+            if (oldovf)
+                status = ovffree(db, oldovf);
+        }
     }
 
 error:
+    if (ovf)
+        (void) ovffree(db, ovf);
+    if (status != APR_SUCCESS && status != APR_EEXIST)
+        dropcache(db);
     (void) apr_sdbm_unlock(db);    
 
     return status;
@@ -303,17 +549,18 @@ error:
 static apr_status_t makroom(apr_sdbm_t *db, long hash, int need)
 {
     long newp;
-    char twin[PBLKSIZ];
     char *pag = db->pagbuf;
-    char *new = twin;
+    char *new = db->twin;
     register int smax = SPLTMAX;
     apr_status_t status;
+    int hit;
 
     do {
         /*
          * split the current page
          */
-        (void) splpage(pag, new, db->hmask + 1);
+        (void) splpage(pag, new, db->twin + db->pagsize, db->pagsize,
+                       db->hmask + 1, db->hash);
         /*
          * address of the new page
          */
@@ -326,14 +573,18 @@ static apr_status_t makroom(apr_sdbm_t *db, long hash, int need)
          * it the current page. If not, simply write the new page, and we are
          * still looking at the page of interest. current page is not updated
          * here, as sdbm_store will do so, after it inserts the incoming pair.
+         * the previous page stays cached, the new one is cached as current.
          */
         if (hash & (db->hmask + 1)) {
             if ((status = write_page(db, db->pagbuf, db->pagbno)) 
                         != APR_SUCCESS)
                 return status;
                     
+            pag = db->pagbuf = PAGCACHE_SLOT(db, getslot(db, db->pagslot,
+                                                         db->pagcachen,
+                                                         newp, &hit));
             db->pagbno = newp;
-            (void) memcpy(pag, new, PBLKSIZ);
+            (void) memcpy(pag, new, db->pagsize);
         }
         else {
             if ((status = write_page(db, new, newp)) != APR_SUCCESS)
@@ -345,7 +596,7 @@ static apr_status_t makroom(apr_sdbm_t *db, long hash, int need)
         /*
          * see if we have enough room now
          */
-        if (fitpair(pag, need))
+        if (fitpair(pag, db->pagsize, need))
             return APR_SUCCESS;
         /*
          * try again... update curbit and hmask as getpage would have
@@ -384,15 +635,22 @@ static apr_status_t read_from(apr_file_t *f, void *buf,
                               apr_off_t off, apr_size_t len,
                               int create)
 {
-    apr_status_t status;
-
-    if ((status = apr_file_seek(f, APR_SET, &off)) != APR_SUCCESS ||
-        ((status = apr_file_read_full(f, buf, len, NULL)) != APR_SUCCESS)) {
-        /* if EOF is reached, pretend we read all zero's */
-        if (status == APR_EOF && create) {
-            memset(buf, 0, len);
-            status = APR_SUCCESS;
-        }
+    apr_status_t status = APR_SUCCESS;
+    apr_size_t n;
+
+    /* positional, for readers sharing the file not to serialize on it */
+    while (len) {
+        n = len;
+        if ((status = apr_file_pread(f, buf, &n, off)) != APR_SUCCESS)
+            break;
+        buf = (char *)buf + n;
+        off += n;
+        len -= n;
+    }
+    /* if EOF is reached, pretend we read all zero's */
+    if (status == APR_EOF && create) {
+        memset(buf, 0, len);
+        status = APR_SUCCESS;
     }
 
     return status;
@@ -439,6 +697,39 @@ APR_DECLARE(apr_status_t) apr_sdbm_nextkey(apr_sdbm_t *db,
     return status;
 }
 
+/*
+ * find the block bno in a cache, else give it the least recently used
+ * slot, to be read in by the caller.
+ */
+static int getslot(apr_sdbm_t *db, sdbm_slot_t *slot, int n, long bno,
+                   int *hit)
+{
+    unsigned long used, oldest = ~0UL;
+    int i, lru = 0;
+
+    for (i = 0; i < n; i++) {
+        if (slot[i].gen != db->cachegen)
+            used = 0;
+        else if (slot[i].bno == bno) {
+            slot[i].used = ++db->cacheuse;
+            *hit = 1;
+            return i;
+        }
+        else
+            used = slot[i].used;
+        if (used < oldest) {
+            oldest = used;
+            lru = i;
+        }
+    }
+
+    slot[lru].bno = bno;
+    slot[lru].gen = db->cachegen;
+    slot[lru].used = ++db->cacheuse;
+    *hit = 0;
+    return lru;
+}
+
 /*
  * all important binary tree traversal
  */
@@ -465,27 +756,51 @@ static apr_status_t getpage(apr_sdbm_t *db, long hash, int by_num, int create)
     }
 
     /*
-     * see if the block we need is already in memory.
-     * note: this lookaside cache has about 10% hit rate.
+     * see if the block we need is already in memory: under a shared lock
+     * in the mapped pagfile, else in the page cache.
      */
     if (pagb != db->pagbno) { 
+        int i = -1, hit = 0;
+
+#if APR_HAS_MMAP
+        if (db->pagmap && (db->flags & SDBM_SHARED_LOCK)
+                && OFF_PAG(db, pagb) + db->pagsize
+                   <= (apr_off_t)db->pagmap->size) {
+            db->pagbuf = (char *)db->pagmap->mm + OFF_PAG(db, pagb);
+        }
+        else
+#endif
+        {
+            i = getslot(db, db->pagslot, db->pagcachen, pagb, &hit);
+            db->pagbuf = PAGCACHE_SLOT(db, i);
+        }
+
         /*
          * note: here, we assume a "hole" is read as 0s.
          * if not, must zero pagbuf first.
          * ### joe: this assumption was surely never correct? but
          * ### we make it so in read_from anyway.
          */
-        if ((status = read_from(db->pagf, db->pagbuf,
-                                OFF_PAG(pagb), PBLKSIZ,
-                                create)) != APR_SUCCESS)
-            return status;
+        if (!hit) {
+            if (i >= 0 && (status = read_from(db->pagf, db->pagbuf,
+                                              OFF_PAG(db, pagb), db->pagsize,
+                                              create)) != APR_SUCCESS) {
+                db->pagslot[i].gen = 0;
+                db->pagbno = -1;
+                return status;
+            }
 
-        if (!chkpage(db->pagbuf))
-            return APR_ENOSPC; /* ### better error? */
+            if (!chkpage(db->pagbuf, db->pagsize)) {
+                if (i >= 0)
+                    db->pagslot[i].gen = 0;
+                db->pagbno = -1;
+                return APR_ENOSPC; /* ### better error? */
+            }
 
-        db->pagbno = pagb;
+            debug(("pag read: %d\n", pagb));
+        }
 
-        debug(("pag read: %d\n", pagb));
+        db->pagbno = pagb;
     }
     return APR_SUCCESS;
 }
@@ -496,17 +811,32 @@ static int getdbit(apr_sdbm_t *db, long dbit)
     register long dirb;
 
     c = dbit / BYTESIZ;
+
+#if APR_HAS_MMAP
+    if (db->dirmap && (db->flags & SDBM_SHARED_LOCK)
+            && (apr_size_t)c < db->dirmap->size)
+        return ((char *)db->dirmap->mm)[c] & (1 << dbit % BYTESIZ);
+#endif
+
     dirb = c / DBLKSIZ;
 
     if (dirb != db->dirbno) {
-        if (read_from(db->dirf, db->dirbuf,
-                      OFF_DIR(dirb), DBLKSIZ,
-                      1) != APR_SUCCESS)
-            return 0;
+        int hit, i = getslot(db, db->dirslot, DIRCACHE, dirb, &hit);
+
+        db->dirbuf = db->dircache[i];
+        if (!hit) {
+            if (read_from(db->dirf, db->dirbuf,
+                          OFF_DIR(dirb), DBLKSIZ,
+                          1) != APR_SUCCESS) {
+                db->dirslot[i].gen = 0;
+                db->dirbno = -1;
+                return 0;
+            }
+
+            debug(("dir read: %d\n", dirb));
+        }
 
         db->dirbno = dirb;
-
-        debug(("dir read: %d\n", dirb));
     }
 
     return db->dirbuf[c % DBLKSIZ] & (1 << dbit % BYTESIZ);
@@ -523,14 +853,22 @@ static apr_status_t setdbit(apr_sdbm_t *db, long dbit)
     dirb = c / DBLKSIZ;
 
     if (dirb != db->dirbno) {
-        if ((status = read_from(db->dirf, db->dirbuf,
-                                OFF_DIR(dirb), DBLKSIZ,
-                                1)) != APR_SUCCESS)
-            return status;
+        int hit, i = getslot(db, db->dirslot, DIRCACHE, dirb, &hit);
+
+        db->dirbuf = db->dircache[i];
+        if (!hit) {
+            if ((status = read_from(db->dirf, db->dirbuf,
+                                    OFF_DIR(dirb), DBLKSIZ,
+                                    1)) != APR_SUCCESS) {
+                db->dirslot[i].gen = 0;
+                db->dirbno = -1;
+                return status;
+            }
+
+            debug(("dir read: %d\n", dirb));
+        }
 
         db->dirbno = dirb;
-        
-        debug(("dir read: %d\n", dirb));
     }
 
     db->dirbuf[c % DBLKSIZ] |= (1 << dbit % BYTESIZ);
@@ -554,7 +892,7 @@ static apr_status_t getnext(apr_sdbm_datum_t *key, apr_sdbm_t *db)
     apr_status_t status;
     for (;;) {
         db->keyptr++;
-        *key = getnkey(db->pagbuf, db->keyptr);
+        *key = getnkey(db->pagbuf, db->pagsize, db->keyptr);
         if (key->dptr != NULL)
             return APR_SUCCESS;
         /*
@@ -573,6 +911,562 @@ static apr_status_t getnext(apr_sdbm_datum_t *key, apr_sdbm_t *db)
     /* NOTREACHED */
 }
 
+/*
+ * bulk loading: all the pairs are held in memory, sorted by their hash
+ * with its bits reversed, so that each node of the directory tree (which
+ * branches on the low bits of the hash first) owns a run of them. A run
+ * fitting in a page becomes a page, others mark their node in the
+ * directory and split on the next bit. The pages are then written in
+ * order, runs of adjacent ones at once.
+ */
+#define BULKPAGES 64			/* pages written at once */
+
+typedef struct {
+    apr_uint32_t rhash;		       /* hash, bits reversed */
+    int ksize;
+    int vsize;
+    int need;			       /* bytes in the page */
+    apr_size_t seq;		       /* the last of equal keys wins */
+    char *dptr;			       /* key then value */
+} bulk_pair_t;
+
+typedef struct {
+    long pagb;			       /* page number */
+    apr_size_t lo;		       /* pairs in the page */
+    apr_size_t hi;
+} bulk_page_t;
+
+typedef struct {
+    apr_array_header_t *pairs;
+    apr_array_header_t *pages;
+    unsigned char *dir;		       /* directory bits */
+    long dirlen;		       /* bytes of dir */
+    long dirmax;		       /* bytes of dir in use */
+} bulk_t;
+
+static apr_uint32_t bulk_rhash(long hash)
+{
+    apr_uint32_t h = (apr_uint32_t)hash;
+
+    h = ((h >> 1) & 0x55555555) | ((h & 0x55555555) << 1);
+    h = ((h >> 2) & 0x33333333) | ((h & 0x33333333) << 2);
+    h = ((h >> 4) & 0x0f0f0f0f) | ((h & 0x0f0f0f0f) << 4);
+    h = ((h >> 8) & 0x00ff00ff) | ((h & 0x00ff00ff) << 8);
+    return (h >> 16) | (h << 16);
+}
+
+static int bulk_cmp(const void *a, const void *b)
+{
+    const bulk_pair_t *x = a, *y = b;
+    int rc;
+
+    if (x->rhash != y->rhash)
+        return x->rhash < y->rhash ? -1 : 1;
+    if (x->ksize != y->ksize)
+        return x->ksize < y->ksize ? -1 : 1;
+    if ((rc = memcmp(x->dptr, y->dptr, x->ksize)) != 0)
+        return rc;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int bulk_page_cmp(const void *a, const void *b)
+{
+    const bulk_page_t *x = a, *y = b;
+
+    return x->pagb < y->pagb ? -1 : x->pagb > y->pagb;
+}
+
+static apr_status_t bulk_add(apr_sdbm_t *db, bulk_t *bulk,
+                             apr_sdbm_datum_t key, apr_sdbm_datum_t val,
+                             apr_pool_t *p)
+{
+    bulk_pair_t *pair;
+    int need = pairsize(db, key.dsize, val.dsize);
+
+    if (bad(key) || need < 0)
+        return APR_EINVAL;
+
+    pair = apr_array_push(bulk->pairs);
+    pair->rhash = bulk_rhash(exhash(db, key));
+    pair->ksize = key.dsize;
+    pair->vsize = val.dsize;
+    pair->need = need;
+    pair->seq = bulk->pairs->nelts;
+    pair->dptr = apr_palloc(p, (apr_size_t)key.dsize + val.dsize);
+    memcpy(pair->dptr, key.dptr, key.dsize);
+    if (val.dsize)
+        memcpy(pair->dptr + key.dsize, val.dptr, val.dsize);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bulk_setdbit(bulk_t *bulk, long dbit)
+{
+    long c = dbit / BYTESIZ;
+
+    if (c >= bulk->dirlen) {
+        long len = bulk->dirlen ? bulk->dirlen : DBLKSIZ;
+        unsigned char *dir;
+
+        while (len <= c)
+            len *= 2;
+        if ((dir = realloc(bulk->dir, len)) == NULL)
+            return APR_ENOMEM;
+        memset(dir + bulk->dirlen, 0, len - bulk->dirlen);
+        bulk->dir = dir;
+        bulk->dirlen = len;
+    }
+    bulk->dir[c] |= (1 << dbit % BYTESIZ);
+    if (c >= bulk->dirmax)
+        bulk->dirmax = c + 1;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bulk_build(bulk_t *bulk, int pagsize,
+                               apr_size_t lo, apr_size_t hi,
+                               long dbit, int hbit, long pagb)
+{
+    const bulk_pair_t *pair = (const bulk_pair_t *)bulk->pairs->elts;
+    apr_size_t i, mid, size = sizeof(short);
+    apr_uint32_t bit;
+    apr_status_t status;
+
+    for (i = lo; i < hi && size <= (apr_size_t)pagsize; i++)
+        size += pair[i].need + 2 * sizeof(short);
+    if (size <= (apr_size_t)pagsize) {
+        bulk_page_t *page;
+
+        if (lo < hi) {
+            page = apr_array_push(bulk->pages);
+            page->pagb = pagb;
+            page->lo = lo;
+            page->hi = hi;
+        }
+        return APR_SUCCESS;
+    }
+
+    /*
+     * the pairs of a run share their low hbit bits of hash, the next
+     * one splits it in two
+     */
+    if (hbit >= 31)
+        return APR_ENOSPC;
+    if ((status = bulk_setdbit(bulk, dbit)) != APR_SUCCESS)
+        return status;
+
+    bit = (apr_uint32_t)0x80000000 >> hbit;
+    for (mid = lo; mid < hi && !(pair[mid].rhash & bit); mid++)
+        ;
+
+    if ((status = bulk_build(bulk, pagsize, lo, mid, 2 * dbit + 1, hbit + 1,
+                             pagb)) != APR_SUCCESS)
+        return status;
+    return bulk_build(bulk, pagsize, mid, hi, 2 * dbit + 2, hbit + 1,
+                      pagb | (1L << hbit));
+}
+
+static apr_status_t bulk_write(apr_sdbm_t *db, bulk_t *bulk)
+{
+    const bulk_pair_t *pair = (const bulk_pair_t *)bulk->pairs->elts;
+    const bulk_page_t *page = (const bulk_page_t *)bulk->pages->elts;
+    apr_size_t dirsize;
+    apr_off_t off;
+    char *buf, *pag;
+    long first = 0;
+    int i, n = 0, max;
+    apr_size_t j;
+    apr_status_t status;
+
+    if ((status = apr_file_trunc(db->pagf, 0)) != APR_SUCCESS
+            || (status = apr_file_trunc(db->dirf, 0)) != APR_SUCCESS)
+        return status;
+    if (db->version == 2 && (status = newheader(db)) != APR_SUCCESS)
+        return status;
+
+    /* the pages of the version 2 format are not adjacent in the file */
+    max = db->version == 1 ? BULKPAGES : 1;
+    if ((buf = malloc((apr_size_t)max * db->pagsize)) == NULL)
+        return APR_ENOMEM;
+
+    for (i = 0; i <= bulk->pages->nelts; i++) {
+        /* write out the pages so far at a gap, when full, or at the end */
+        if (n && (i == bulk->pages->nelts || n == max
+                  || page[i].pagb != first + n)) {
+            off = OFF_PAG(db, first);
+            if ((status = apr_file_seek(db->pagf, APR_SET, &off))
+                        != APR_SUCCESS
+                    || (status = apr_file_write_full(db->pagf, buf,
+                                                     (apr_size_t)n
+                                                     * db->pagsize, NULL))
+                        != APR_SUCCESS) {
+                free(buf);
+                return status;
+            }
+            n = 0;
+        }
+        if (i == bulk->pages->nelts)
+            break;
+
+        if (!n)
+            first = page[i].pagb;
+        pag = buf + (apr_size_t)n * db->pagsize;
+        memset(pag, 0, db->pagsize);
+        for (j = page[i].lo; j < page[i].hi; j++) {
+            apr_sdbm_datum_t key, val;
+            apr_uint32_t ovf;
+
+            key.dptr = pair[j].dptr;
+            key.dsize = pair[j].ksize;
+            val.dptr = pair[j].dptr + pair[j].ksize;
+            val.dsize = pair[j].vsize;
+            if (db->version == 2) {
+                char *tagged = db->twin + 2 * db->pagsize;
+
+                if (isinline(db, key.dsize, val.dsize)) {
+                    tagged[0] = SDBM2_INLINE;
+                    if (val.dsize)
+                        memcpy(tagged + 1, val.dptr, val.dsize);
+                    val.dsize++;
+                }
+                else {
+                    if ((status = ovfwrite(db, val, &ovf)) != APR_SUCCESS) {
+                        free(buf);
+                        return status;
+                    }
+                    tagged[0] = SDBM2_OVERFLOW;
+                    put32(tagged + 1, (apr_uint32_t)val.dsize);
+                    put32(tagged + 5, ovf);
+                    val.dsize = SDBM2_REFSIZ;
+                }
+                val.dptr = tagged;
+            }
+            putpair(pag, db->pagsize, key, val);
+        }
+        n++;
+    }
+    free(buf);
+
+    /*
+     * the directory, in whole blocks; none for a single page
+     */
+    dirsize = (bulk->dirmax + DBLKSIZ - 1) / DBLKSIZ * DBLKSIZ;
+    if (dirsize) {
+        off = 0;
+        if ((status = apr_file_seek(db->dirf, APR_SET, &off)) != APR_SUCCESS
+                || (status = apr_file_write_full(db->dirf, bulk->dir,
+                                                 dirsize, NULL))
+                    != APR_SUCCESS)
+            return status;
+    }
+
+    dropcache(db);
+    db->maxbno = (long)(dirsize * BYTESIZ);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_sdbm_bulk_load(apr_sdbm_t *db,
+                                             apr_sdbm_bulk_next_fn_t *next,
+                                             void *baton)
+{
+    apr_sdbm_datum_t key, val;
+    apr_pool_t *p;
+    bulk_t bulk;
+    bulk_pair_t *pair;
+    apr_status_t status;
+    long pagb;
+    int i, j;
+
+    if (db == NULL || next == NULL)
+        return APR_EINVAL;
+    if (apr_sdbm_rdonly(db))
+        return APR_EINVAL;
+
+    if ((status = apr_sdbm_lock(db, APR_FLOCK_EXCLUSIVE)) != APR_SUCCESS)
+        return status;
+
+    if ((status = apr_pool_create(&p, db->pool)) != APR_SUCCESS) {
+        (void) apr_sdbm_unlock(db);
+        return status;
+    }
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.pairs = apr_array_make(p, 1024, sizeof(bulk_pair_t));
+    bulk.pages = apr_array_make(p, 64, sizeof(bulk_page_t));
+
+    /*
+     * the pairs already stored, every page of the file in turn
+     */
+    for (pagb = 0; ; pagb++) {
+        if ((status = getpage(db, pagb, 1, 0)) != APR_SUCCESS)
+            break;
+        for (i = 1; (key = getnkey(db->pagbuf, db->pagsize,
+                                   i)).dptr != NULL; i++) {
+            val = getpair(db->pagbuf, db->pagsize, key);
+            if (db->version == 2
+                    && (status = getvalue(db, &val)) != APR_SUCCESS)
+                goto error;
+            if ((status = bulk_add(db, &bulk, key, val, p)) != APR_SUCCESS)
+                goto error;
+        }
+    }
+    if (status != APR_EOF)
+        goto error;
+
+    /*
+     * then the new ones, replacing them
+     */
+    while ((status = next(baton, &key, &val)) == APR_SUCCESS) {
+        if ((status = bulk_add(db, &bulk, key, val, p)) != APR_SUCCESS)
+            goto error;
+    }
+    if (status != APR_EOF)
+        goto error;
+
+    qsort(bulk.pairs->elts, bulk.pairs->nelts, sizeof(bulk_pair_t),
+          bulk_cmp);
+    pair = (bulk_pair_t *)bulk.pairs->elts;
+    for (i = 0, j = 0; i < bulk.pairs->nelts; i++) {
+        if (i + 1 < bulk.pairs->nelts
+                && pair[i].rhash == pair[i + 1].rhash
+                && pair[i].ksize == pair[i + 1].ksize
+                && !memcmp(pair[i].dptr, pair[i + 1].dptr, pair[i].ksize))
+            continue;
+        pair[j++] = pair[i];
+    }
+    bulk.pairs->nelts = j;
+
+    if ((status = bulk_build(&bulk, db->pagsize, 0, j, 0, 0, 0))
+                != APR_SUCCESS)
+        goto error;
+
+    qsort(bulk.pages->elts, bulk.pages->nelts, sizeof(bulk_page_t),
+          bulk_page_cmp);
+    if ((status = bulk_write(db, &bulk)) != APR_SUCCESS)
+        dropcache(db);
+
+error:
+    free(bulk.dir);
+    apr_pool_destroy(p);
+    (void) apr_sdbm_unlock(db);
+
+    return status;
+}
+/*
+ * overflow pages: a value too large for a page of the version 2 format
+ * is written to a chain of them, each one starting with the number of
+ * the next one plus one (0 ending the chain) and the bytes of the value
+ * it holds.  The header keeps the number of overflow pages allocated and
+ * the first one freed plus one, the freed pages being chained likewise.
+ */
+static apr_status_t ovfheader(apr_sdbm_t *db, apr_uint32_t *next,
+                              apr_uint32_t *freed)
+{
+    apr_status_t status;
+    char hdr[SDBM2_HDRSIZ];
+
+    if ((status = read_from(db->pagf, hdr, 0, SDBM2_HDRSIZ, 0))
+                != APR_SUCCESS)
+        return status;
+    *next = get32(hdr + 16);
+    *freed = get32(hdr + 20);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t ovfsetheader(apr_sdbm_t *db, apr_uint32_t next,
+                                 apr_uint32_t freed)
+{
+    apr_status_t status;
+    apr_off_t off = 16;
+    char buf[8];
+
+    put32(buf, next);
+    put32(buf + 4, freed);
+    if ((status = apr_file_seek(db->pagf, APR_SET, &off)) == APR_SUCCESS)
+        status = apr_file_write_full(db->pagf, buf, sizeof(buf), NULL);
+
+    return status;
+}
+
+static apr_status_t ovfwrite(apr_sdbm_t *db, apr_sdbm_datum_t val,
+                             apr_uint32_t *first)
+{
+    apr_status_t status;
+    apr_uint32_t next, freed, this, that;
+    apr_size_t room = db->pagsize - SDBM2_OVFHDR, done = 0, n;
+    char *buf = db->twin + 2 * db->pagsize;
+    char link[4];
+    apr_off_t off;
+
+    if ((status = ovfheader(db, &next, &freed)) != APR_SUCCESS)
+        return status;
+
+    /*
+     * take the freed pages first, then new ones; each page is written
+     * once the one after it is known
+     */
+    *first = 0;
+    this = 0;
+    while (done < (apr_size_t)val.dsize) {
+        if (freed) {
+            that = freed;
+            if ((status = read_from(db->pagf, link, OFF_OVF(db, that - 1),
+                                    sizeof(link), 0)) != APR_SUCCESS)
+                return status;
+            freed = get32(link);
+        }
+        else if ((that = ++next) == 0) {
+            return APR_ENOSPC;
+        }
+
+        if (this) {
+            put32(buf, that);
+            off = OFF_OVF(db, this - 1);
+            if ((status = apr_file_seek(db->pagf, APR_SET, &off))
+                        != APR_SUCCESS
+                    || (status = apr_file_write_full(db->pagf, buf,
+                                                     db->pagsize, NULL))
+                        != APR_SUCCESS)
+                return status;
+        }
+        else {
+            *first = that;
+        }
+        this = that;
+
+        n = val.dsize - done;
+        if (n > room)
+            n = room;
+        memset(buf, 0, db->pagsize);
+        put32(buf + 4, (apr_uint32_t)n);
+        memcpy(buf + SDBM2_OVFHDR, val.dptr + done, n);
+        done += n;
+    }
+    if (this) {
+        off = OFF_OVF(db, this - 1);
+        if ((status = apr_file_seek(db->pagf, APR_SET, &off)) != APR_SUCCESS
+                || (status = apr_file_write_full(db->pagf, buf, db->pagsize,
+                                                 NULL)) != APR_SUCCESS)
+            return status;
+    }
+
+    return ovfsetheader(db, next, freed);
+}
+
+static apr_status_t ovffree(apr_sdbm_t *db, apr_uint32_t first)
+{
+    apr_status_t status;
+    apr_uint32_t next, freed, this = first, count = 0;
+    char link[4];
+    apr_off_t off;
+
+    if ((status = ovfheader(db, &next, &freed)) != APR_SUCCESS)
+        return status;
+
+    /* find the end of the chain, and link it to the freed pages */
+    for (;;) {
+        if (this == 0 || this > next || ++count > next)
+            return APR_EGENERAL; /* ### better error? */
+        if ((status = read_from(db->pagf, link, OFF_OVF(db, this - 1),
+                                sizeof(link), 0)) != APR_SUCCESS)
+            return status;
+        if (get32(link) == 0)
+            break;
+        this = get32(link);
+    }
+
+    put32(link, freed);
+    off = OFF_OVF(db, this - 1);
+    if ((status = apr_file_seek(db->pagf, APR_SET, &off)) != APR_SUCCESS
+            || (status = apr_file_write_full(db->pagf, link, sizeof(link),
+                                             NULL)) != APR_SUCCESS)
+        return status;
+
+    return ovfsetheader(db, next, first);
+}
+
+/*
+ * the first overflow page of the value of key in the current page, if any
+ */
+static apr_uint32_t getovf(apr_sdbm_t *db, apr_sdbm_datum_t key)
+{
+    apr_sdbm_datum_t val;
+
+    if (db->version == 1)
+        return 0;
+    val = getpair(db->pagbuf, db->pagsize, key);
+    if (val.dptr == NULL || val.dsize != SDBM2_REFSIZ
+            || val.dptr[0] != SDBM2_OVERFLOW)
+        return 0;
+    return get32(val.dptr + 5);
+}
+
+/*
+ * untag a value of the version 2 format, reading it from its overflow
+ * pages into valbuf if it is there
+ */
+static apr_status_t getvalue(apr_sdbm_t *db, apr_sdbm_datum_t *val)
+{
+    apr_status_t status;
+    apr_uint32_t this, len, n;
+    apr_size_t done = 0;
+    const char *page;
+
+    if (val->dptr == NULL)
+        return APR_SUCCESS;
+    if (val->dsize >= 1 && val->dptr[0] == SDBM2_INLINE) {
+        val->dptr++;
+        val->dsize--;
+        return APR_SUCCESS;
+    }
+    if (val->dsize != SDBM2_REFSIZ || val->dptr[0] != SDBM2_OVERFLOW)
+        return APR_EGENERAL; /* ### better error? */
+
+    len = get32(val->dptr + 1);
+    this = get32(val->dptr + 5);
+    if (len > APR_INT32_MAX)
+        return APR_EGENERAL;
+    if (len > db->valsize) {
+        char *buf = realloc(db->valbuf, len);
+
+        if (buf == NULL)
+            return APR_ENOMEM;
+        db->valbuf = buf;
+        db->valsize = len;
+    }
+
+    while (done < len) {
+        if (this == 0)
+            return APR_EGENERAL;
+#if APR_HAS_MMAP
+        if (db->pagmap && (db->flags & SDBM_SHARED_LOCK)
+                && OFF_OVF(db, this - 1) + db->pagsize
+                   <= (apr_off_t)db->pagmap->size) {
+            page = (char *)db->pagmap->mm + OFF_OVF(db, this - 1);
+        }
+        else
+#endif
+        {
+            page = db->twin + 2 * db->pagsize;
+            if ((status = read_from(db->pagf, (char *)page,
+                                    OFF_OVF(db, this - 1), db->pagsize,
+                                    0)) != APR_SUCCESS)
+                return status;
+        }
+        n = get32(page + 4);
+        if (n == 0 || n > db->pagsize - SDBM2_OVFHDR || n > len - done)
+            return APR_EGENERAL;
+        memcpy(db->valbuf + done, page + SDBM2_OVFHDR, n);
+        done += n;
+        this = get32(page);
+    }
+
+    val->dptr = db->valbuf;
+    val->dsize = (int)len;
+
+    return APR_SUCCESS;
+}
 
 APR_DECLARE(int) apr_sdbm_rdonly(apr_sdbm_t *db)
 {
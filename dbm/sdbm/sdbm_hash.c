@@ -61,3 +61,49 @@ long sdbm_hash(const char *str, int len)
 #endif
 	return n;
 }
+
+/*
+ * the hash of the version 2 format: MurmurHash3 (x86, 32 bits,
+ * seed 0) by Austin Appleby, public domain, taking the bytes four at
+ * a time in little endian order whatever the machine.
+ */
+#define ROTL32(x, r)	(((x) << (r)) | ((x) >> (32 - (r))))
+
+long sdbm_hash2(const char *str, int len)
+{
+	const unsigned char *s = (const unsigned char *) str;
+	register apr_uint32_t h = 0;
+	register apr_uint32_t k;
+	int i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		k = (apr_uint32_t) s[i] | (apr_uint32_t) s[i + 1] << 8 |
+		    (apr_uint32_t) s[i + 2] << 16 | (apr_uint32_t) s[i + 3] << 24;
+		k *= 0xcc9e2d51;
+		k = ROTL32(k, 15);
+		k *= 0x1b873593;
+		h ^= k;
+		h = ROTL32(h, 13);
+		h = h * 5 + 0xe6546b64;
+	}
+
+	k = 0;
+	switch (len & 3) {
+	case 3:	k ^= (apr_uint32_t) s[i + 2] << 16;
+	case 2:	k ^= (apr_uint32_t) s[i + 1] << 8;
+	case 1:	k ^= (apr_uint32_t) s[i];
+		k *= 0xcc9e2d51;
+		k = ROTL32(k, 15);
+		k *= 0x1b873593;
+		h ^= k;
+	}
+
+	h ^= (apr_uint32_t) len;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return (long) (h & 0x7fffffff);
+}
@@ -21,6 +21,53 @@
 #include "sdbm_private.h"
 #include "sdbm_tune.h"
 
+#include <string.h>     /* for memcpy() */
+
+#if APR_HAS_MMAP
+/*
+ * map both files for the lookups under a shared lock, again whenever
+ * they changed size since; the pages are read from the files if that
+ * fails.
+ */
+static void map_files(apr_sdbm_t *db, apr_off_t dirsize)
+{
+    apr_finfo_t finfo;
+
+    if (apr_file_info_get(&finfo, APR_FINFO_SIZE, db->pagf) != APR_SUCCESS)
+        return;
+    if (db->mappool && dirsize == db->dirmapsz && finfo.size == db->pagmapsz)
+        return;
+
+    if (db->mappool) {
+        /* keep a mapped current page for apr_sdbm_nextkey */
+        if (db->pagmap && db->pagbuf >= (char *)db->pagmap->mm
+                && db->pagbuf < (char *)db->pagmap->mm + db->pagmap->size) {
+            memcpy(PAGCACHE_SLOT(db, 0), db->pagbuf, db->pagsize);
+            db->pagbuf = PAGCACHE_SLOT(db, 0);
+        }
+        apr_pool_clear(db->mappool);
+    }
+    else if (apr_pool_create_unmanaged_ex(&db->mappool, NULL,
+                                          NULL) != APR_SUCCESS) {
+        db->mappool = NULL;
+        return;
+    }
+    db->dirmap = db->pagmap = NULL;
+    db->dirmapsz = dirsize;
+    db->pagmapsz = finfo.size;
+
+    if (dirsize > 0 && dirsize == (apr_off_t)(apr_size_t)dirsize
+            && apr_mmap_create(&db->dirmap, db->dirf, 0, (apr_size_t)dirsize,
+                               APR_MMAP_READ, db->mappool) != APR_SUCCESS)
+        db->dirmap = NULL;
+    if (finfo.size > 0 && finfo.size == (apr_off_t)(apr_size_t)finfo.size
+            && apr_mmap_create(&db->pagmap, db->pagf, 0,
+                               (apr_size_t)finfo.size, APR_MMAP_READ,
+                               db->mappool) != APR_SUCCESS)
+        db->pagmap = NULL;
+}
+#endif
+
 /* NOTE: this function may block until it acquires the lock */
 APR_DECLARE(apr_status_t) apr_sdbm_lock(apr_sdbm_t *db, int type)
 {
@@ -58,6 +105,10 @@ APR_DECLARE(apr_status_t) apr_sdbm_lock(apr_sdbm_t *db, int type)
         }
 
         SDBM_INVALIDATE_CACHE(db, finfo);
+#if APR_HAS_MMAP
+        if (lock_type == APR_FLOCK_SHARED)
+            map_files(db, finfo.size);
+#endif
 
         ++db->lckcnt;
         if (type == APR_FLOCK_SHARED)
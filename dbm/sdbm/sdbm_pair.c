@@ -32,12 +32,10 @@
 #include <string.h>	/* for memset() */
 
 
-#define exhash(item)	sdbm_hash((item).dptr, (item).dsize)
-
 /* 
  * forward 
  */
-static int seepair(char *, int, char *, int);
+static int seepair(char *, int, int, char *, int);
 
 /*
  * page format:
@@ -57,19 +55,23 @@ static int seepair(char *, int, char *, int);
  * of entries (ino[0]) is zero, the offset to the END of
  * the free area is the block size. Otherwise, it is the
  * nth (ino[ino[0]]) entry's offset.
+ *
+ * the block size is given to each routine, pages of up
+ * to 64K keeping their offsets in unsigned shorts.
  */
 
 int
-fitpair(pag, need)
+fitpair(pag, size, need)
 char *pag;
+int size;
 int need;
 {
 	register int n;
 	register int off;
 	register int avail;
-	register short *ino = (short *) pag;
+	register unsigned short *ino = (unsigned short *) pag;
 
-	off = ((n = ino[0]) > 0) ? ino[n] : PBLKSIZ;
+	off = ((n = ino[0]) > 0) ? ino[n] : size;
 	avail = off - (n + 1) * sizeof(short);
 	need += 2 * sizeof(short);
 
@@ -79,16 +81,17 @@ int need;
 }
 
 void
-putpair(pag, key, val)
+putpair(pag, size, key, val)
 char *pag;
+int size;
 apr_sdbm_datum_t key;
 apr_sdbm_datum_t val;
 {
 	register int n;
 	register int off;
-	register short *ino = (short *) pag;
+	register unsigned short *ino = (unsigned short *) pag;
 
-	off = ((n = ino[0]) > 0) ? ino[n] : PBLKSIZ;
+	off = ((n = ino[0]) > 0) ? ino[n] : size;
 /*
  * enter the key first
  */
@@ -108,19 +111,20 @@ apr_sdbm_datum_t val;
 }
 
 apr_sdbm_datum_t
-getpair(pag, key)
+getpair(pag, size, key)
 char *pag;
+int size;
 apr_sdbm_datum_t key;
 {
 	register int i;
 	register int n;
 	apr_sdbm_datum_t val;
-	register short *ino = (short *) pag;
+	register unsigned short *ino = (unsigned short *) pag;
 
 	if ((n = ino[0]) == 0)
 		return sdbm_nullitem;
 
-	if ((i = seepair(pag, n, key.dptr, key.dsize)) == 0)
+	if ((i = seepair(pag, size, n, key.dptr, key.dsize)) == 0)
 		return sdbm_nullitem;
 
 	val.dptr = pag + ino[i + 1];
@@ -129,28 +133,31 @@ apr_sdbm_datum_t key;
 }
 
 int
-duppair(pag, key)
+duppair(pag, size, key)
 char *pag;
+int size;
 apr_sdbm_datum_t key;
 {
-	register short *ino = (short *) pag;
-	return ino[0] > 0 && seepair(pag, ino[0], key.dptr, key.dsize) > 0;
+	register unsigned short *ino = (unsigned short *) pag;
+	return ino[0] > 0 && seepair(pag, size, ino[0], key.dptr,
+				     key.dsize) > 0;
 }
 
 apr_sdbm_datum_t
-getnkey(pag, num)
+getnkey(pag, size, num)
 char *pag;
+int size;
 int num;
 {
 	apr_sdbm_datum_t key;
 	register int off;
-	register short *ino = (short *) pag;
+	register unsigned short *ino = (unsigned short *) pag;
 
 	num = num * 2 - 1;
 	if (ino[0] == 0 || num > ino[0])
 		return sdbm_nullitem;
 
-	off = (num > 1) ? ino[num - 1] : PBLKSIZ;
+	off = (num > 1) ? ino[num - 1] : size;
 
 	key.dptr = pag + ino[num];
 	key.dsize = off - ino[num];
@@ -159,18 +166,19 @@ int num;
 }
 
 int
-delpair(pag, key)
+delpair(pag, size, key)
 char *pag;
+int size;
 apr_sdbm_datum_t key;
 {
 	register int n;
 	register int i;
-	register short *ino = (short *) pag;
+	register unsigned short *ino = (unsigned short *) pag;
 
 	if ((n = ino[0]) == 0)
 		return 0;
 
-	if ((i = seepair(pag, n, key.dptr, key.dsize)) == 0)
+	if ((i = seepair(pag, size, n, key.dptr, key.dsize)) == 0)
 		return 0;
 /*
  * found the key. if it is the last entry
@@ -181,9 +189,9 @@ apr_sdbm_datum_t key;
  */
 	if (i < n - 1) {
 		register int m;
-		register char *dst = pag + (i == 1 ? PBLKSIZ : ino[i - 1]);
+		register char *dst = pag + (i == 1 ? size : ino[i - 1]);
 		register char *src = pag + ino[i + 1];
-		register short zoo = (short) (dst - src);
+		register int zoo = (int) (dst - src);
 
 		debug(("free-up %d ", zoo));
 /*
@@ -231,15 +239,16 @@ apr_sdbm_datum_t key;
  * return 0 if not found.
  */
 static int
-seepair(pag, n, key, siz)
+seepair(pag, size, n, key, siz)
 char *pag;
+int size;
 register int n;
 register char *key;
 register int siz;
 {
 	register int i;
-	register int off = PBLKSIZ;
-	register short *ino = (short *) pag;
+	register int off = size;
+	register unsigned short *ino = (unsigned short *) pag;
 
 	for (i = 1; i < n; i += 2) {
 		if (siz == off - ino[i] &&
@@ -251,22 +260,24 @@ register int siz;
 }
 
 void
-splpage(pag, new, sbit)
+splpage(pag, new, cur, size, sbit, hash)
 char *pag;
 char *new;
+char *cur;
+int size;
 long sbit;
+long (*hash)(const char *, int);
 {
 	apr_sdbm_datum_t key;
 	apr_sdbm_datum_t val;
 
 	register int n;
-	register int off = PBLKSIZ;
-	char cur[PBLKSIZ];
-	register short *ino = (short *) cur;
+	register int off = size;
+	register unsigned short *ino = (unsigned short *) cur;
 
-	(void) memcpy(cur, pag, PBLKSIZ);
-	(void) memset(pag, 0, PBLKSIZ);
-	(void) memset(new, 0, PBLKSIZ);
+	(void) memcpy(cur, pag, size);
+	(void) memset(pag, 0, size);
+	(void) memset(new, 0, size);
 
 	n = ino[0];
 	for (ino++; n > 0; ino += 2) {
@@ -277,15 +288,16 @@ long sbit;
 /*
  * select the page pointer (by looking at sbit) and insert
  */
-		(void) putpair((exhash(key) & sbit) ? new : pag, key, val);
+		(void) putpair((hash(key.dptr, key.dsize) & sbit) ? new : pag,
+			       size, key, val);
 
 		off = ino[1];
 		n -= 2;
 	}
 
-	debug(("%d split %d/%d\n", ((short *) cur)[0] / 2, 
-	       ((short *) new)[0] / 2,
-	       ((short *) pag)[0] / 2));
+	debug(("%d split %d/%d\n", ((unsigned short *) cur)[0] / 2, 
+	       ((unsigned short *) new)[0] / 2,
+	       ((unsigned short *) pag)[0] / 2));
 }
 
 /*
@@ -295,21 +307,21 @@ long sbit;
  * this could be made more rigorous.
  */
 int
-chkpage(pag)
+chkpage(pag, size)
 char *pag;
+int size;
 {
 	register int n;
 	register int off;
-	register short *ino = (short *) pag;
+	register unsigned short *ino = (unsigned short *) pag;
 
-	if ((n = ino[0]) < 0 || n > PBLKSIZ / sizeof(short))
+	if ((n = ino[0]) > size / (int) sizeof(short))
 		return 0;
 
 	if (n > 0) {
-		off = PBLKSIZ;
+		off = size;
 		for (ino++; n > 0; ino += 2) {
-			if (ino[0] < 0 || ino[0] > off ||
-			    ino[1] < 0 || ino[1] > off ||
+			if (ino[0] > off || ino[1] > off ||
 			    ino[1] > ino[0])
 				return 0;
 			off = ino[1];
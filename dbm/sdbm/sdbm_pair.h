@@ -27,14 +27,15 @@
 #define putpair apu__sdbm_putpair
 #define splpage apu__sdbm_splpage
 
-int fitpair(char *, int);
-void  putpair(char *, apr_sdbm_datum_t, apr_sdbm_datum_t);
-apr_sdbm_datum_t getpair(char *, apr_sdbm_datum_t);
-int  delpair(char *, apr_sdbm_datum_t);
-int  chkpage (char *);
-apr_sdbm_datum_t getnkey(char *, int);
-void splpage(char *, char *, long);
-int duppair(char *, apr_sdbm_datum_t);
+int fitpair(char *, int, int);
+void  putpair(char *, int, apr_sdbm_datum_t, apr_sdbm_datum_t);
+apr_sdbm_datum_t getpair(char *, int, apr_sdbm_datum_t);
+int  delpair(char *, int, apr_sdbm_datum_t);
+int  chkpage (char *, int);
+apr_sdbm_datum_t getnkey(char *, int, int);
+void splpage(char *, char *, char *, int, long,
+             long (*)(const char *, int));
+int duppair(char *, int, apr_sdbm_datum_t);
 
 #endif /* SDBM_PAIR_H */
 
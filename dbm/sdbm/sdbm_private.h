@@ -26,6 +26,7 @@
 #include "apr.h"
 #include "apr_pools.h"
 #include "apr_file_io.h"
+#include "apr_mmap.h"
 #include "apr_errno.h" /* for apr_status_t */
 
 #if 0
@@ -39,6 +40,25 @@
 #define PAIRMAX 1008			/* arbitrary on PBLKSIZ-N */
 #endif
 #define SPLTMAX	10			/* maximum allowed splits */
+#define PAGCACHE 16			/* pages cached when not mapped */
+#define PAGCACHE_BYTES 65536		/* fewer of them if larger */
+#define DIRCACHE 4			/* directory blocks cached likewise */
+
+/*
+ * the version 2 format: a header in the first block of the page file,
+ * the blocks after it alternating data pages and overflow pages, which
+ * chain the values too large to be kept in a page.  Its pages may be
+ * of any size from 1K to 64K and use another hash.
+ */
+#define SDBM2_MAGIC	"SDBMv2\0\0"	/* first 8 bytes of the header */
+#define SDBM2_HASH	1		/* sdbm_hash2 */
+#define SDBM2_MINPAGE	1024
+#define SDBM2_MAXPAGE	65536
+#define SDBM2_HDRSIZ	24		/* bytes of the header in use */
+#define SDBM2_OVFHDR	8		/* next and length of overflow pages */
+#define SDBM2_INLINE	0		/* value tag: the value follows */
+#define SDBM2_OVERFLOW	1		/* value tag: length and first page */
+#define SDBM2_REFSIZ	9		/* tag and the two of them */
 
 /* for apr_sdbm_t.flags */
 #define SDBM_RDONLY	        0x1    /* data base open read-only */
@@ -46,6 +66,13 @@
 #define SDBM_SHARED_LOCK	0x4    /* data base locked for shared read */
 #define SDBM_EXCLUSIVE_LOCK	0x8    /* data base locked for write */
 
+/* a block of the page or directory cache */
+typedef struct {
+    long bno;			       /* block number */
+    unsigned long gen;		       /* valid if db->cachegen */
+    unsigned long used;		       /* last use, for LRU eviction */
+} sdbm_slot_t;
+
 struct apr_sdbm_t {
     apr_pool_t *pool;
     apr_file_t *dirf;		       /* directory file descriptor */
@@ -58,26 +85,57 @@ struct apr_sdbm_t {
     int  keyptr;		       /* current key for nextkey */
     long blkno;			       /* current page to read/write */
     long pagbno;		       /* current page in pagbuf */
-    char pagbuf[PBLKSIZ];	       /* page file block buffer */
+    char *pagbuf;		       /* current page, cached or mapped */
+    int  version;		       /* 1, or 2 if with a header */
+    int  pagsize;		       /* page size */
+    int  pairmax;		       /* largest pair in a page */
+    int  inlinemax;		       /* largest pair kept inline (v2) */
+    long (*hash)(const char *, int);   /* sdbm_hash or sdbm_hash2 */
     long dirbno;		       /* current block in dirbuf */
-    char dirbuf[DBLKSIZ];	       /* directory file block buffer */
+    char *dirbuf;		       /* current directory block, cached */
     int  lckcnt;                       /* number of calls to sdbm_lock */
+    unsigned long cachegen;	       /* bumped to empty the caches */
+    unsigned long cacheuse;	       /* LRU clock of the caches */
+    int  pagcachen;		       /* number of pages in pagcache */
+    sdbm_slot_t pagslot[PAGCACHE];     /* pages in pagcache */
+    sdbm_slot_t dirslot[DIRCACHE];     /* directory blocks in dircache */
+    char *pagcache;		       /* page file block cache */
+    char *twin;			       /* three spare pages, see makroom */
+    char *valbuf;		       /* value read from overflow pages */
+    apr_size_t valsize;		       /* size of valbuf */
+    char dircache[DIRCACHE][DBLKSIZ];  /* directory file block cache */
+#if APR_HAS_MMAP
+    apr_pool_t *mappool;	       /* holds the maps below */
+    apr_mmap_t *dirmap;		       /* dirfile mapped for shared locks */
+    apr_mmap_t *pagmap;		       /* pagfile mapped likewise */
+    apr_off_t dirmapsz;		       /* size of dirfile when mapped */
+    apr_off_t pagmapsz;		       /* size of pagfile when mapped */
+#endif
 };
 
 
 #define sdbm_hash apu__sdbm_hash
+#define sdbm_hash2 apu__sdbm_hash2
 #define sdbm_nullitem apu__sdbm_nullitem
 
 extern const apr_sdbm_datum_t sdbm_nullitem;
 
 long sdbm_hash(const char *str, int len);
+long sdbm_hash2(const char *str, int len);
+
+/*
+ * the i-th page of the cache
+ */
+#define PAGCACHE_SLOT(db, i) ((db)->pagcache + (apr_size_t)(i) * (db)->pagsize)
 
 /*
  * zero the cache
  */
 #define SDBM_INVALIDATE_CACHE(db, finfo) \
-    do { db->dirbno = (!finfo.size) ? 0 : -1; \
+    do { db->dirbno = -1; \
          db->pagbno = -1; \
+         if (!++db->cachegen) \
+             db->cachegen = 1; \
          db->maxbno = (long)(finfo.size * BYTESIZ); \
     } while (0);
 
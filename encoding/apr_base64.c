@@ -24,6 +24,7 @@
 #include <assert.h>
 
 #include "apr_base64.h"
+#include "apr_encode_private.h"
 #if APR_CHARSET_EBCDIC
 #include "apr_xlate.h"
 #endif                /* APR_CHARSET_EBCDIC */
@@ -122,6 +123,7 @@ APR_DECLARE(int) apr_base64_decode_len(const char *bufcoded)
     register apr_size_t nprbytes;
 
     bufin = (const unsigned char *) bufcoded;
+    bufin += apr__decode_base64_valid(bufin, strlen(bufcoded), 1);
     while (pr2six[*(bufin++)] <= 63);
     nprbytes = (bufin - (const unsigned char *) bufcoded) - 1;
     assert(nprbytes <= APR_BASE64_DECODE_MAX);
@@ -157,8 +159,10 @@ APR_DECLARE(int) apr_base64_decode_binary(unsigned char *bufplain,
     register const unsigned char *bufin;
     register unsigned char *bufout;
     register apr_size_t nprbytes;
+    apr_size_t skip;
 
     bufin = (const unsigned char *) bufcoded;
+    bufin += apr__decode_base64_valid(bufin, strlen(bufcoded), 1);
     while (pr2six[*(bufin++)] <= 63);
     nprbytes = (bufin - (const unsigned char *) bufcoded) - 1;
     assert(nprbytes <= APR_BASE64_DECODE_MAX);
@@ -167,6 +171,11 @@ APR_DECLARE(int) apr_base64_decode_binary(unsigned char *bufplain,
     bufout = (unsigned char *) bufplain;
     bufin = (const unsigned char *) bufcoded;
 
+    skip = apr__decode_base64_blocks(bufout, bufin, nprbytes);
+    bufin += skip;
+    bufout += skip / 4 * 3;
+    nprbytes -= skip;
+
     while (nprbytes >= 4) {
         *(bufout++) =
             (unsigned char) (pr2six[*bufin] << 2 | pr2six[bufin[1]] >> 4);
@@ -261,7 +270,9 @@ APR_DECLARE(int) apr_base64_encode_binary(char *encoded,
     assert(len >= 0 && len <= APR_BASE64_ENCODE_MAX);
 
     p = encoded;
-    for (i = 0; i < len - 2; i += 3) {
+    i = (int)apr__encode_base64_blocks(p, string, len, 0);
+    p += i / 3 * 4;
+    for (; i < len - 2; i += 3) {
         *p++ = basis_64[(string[i] >> 2) & 0x3F];
         *p++ = basis_64[((string[i] & 0x3) << 4) |
             ((int) (string[i + 1] & 0xF0) >> 4)];
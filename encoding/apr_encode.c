@@ -224,7 +224,7 @@ APR_DECLARE(apr_status_t) apr_encode_base64(char *dest, const char *src,
 
     if (dest) {
         char *bufout = dest;
-        apr_size_t i = 0;
+        apr_size_t i;
 
         if (0 == ((flags & APR_ENCODE_BASE64URL))) {
             base = base64;
@@ -233,6 +233,10 @@ APR_DECLARE(apr_status_t) apr_encode_base64(char *dest, const char *src,
             base = base64url;
         }
 
+        i = apr__encode_base64_blocks(bufout, (const unsigned char *)src,
+                                      count, flags & APR_ENCODE_BASE64URL);
+        bufout += i / 3 * 4;
+
         if (count > 2) {
             for (; i < count - 2; i += 3) {
                 *bufout++ = base[(TO_ASCII(src[i]) >> 2) & 0x3F];
@@ -290,7 +294,7 @@ APR_DECLARE(apr_status_t) apr_encode_base64_binary(char *dest, const unsigned ch
 
     if (dest) {
         char *bufout = dest;
-        apr_size_t i = 0;
+        apr_size_t i;
 
         if (0 == ((flags & APR_ENCODE_BASE64URL))) {
             base = base64;
@@ -299,6 +303,10 @@ APR_DECLARE(apr_status_t) apr_encode_base64_binary(char *dest, const unsigned ch
             base = base64url;
         }
 
+        i = apr__encode_base64_blocks(bufout, (const unsigned char *)src,
+                                      count, flags & APR_ENCODE_BASE64URL);
+        bufout += i / 3 * 4;
+
         if (count > 2) {
             for (; i < count - 2; i += 3) {
                 *bufout++ = base[(src[i] >> 2) & 0x3F];
@@ -408,8 +416,12 @@ APR_DECLARE(apr_status_t) apr_decode_base64(char *dest, const char *src,
 
     if (src) {
         const unsigned char *bufin;
+        apr_size_t skip;
 
         bufin = (const unsigned char *)src;
+        skip = apr__decode_base64_valid(bufin, count, 0);
+        bufin += skip;
+        count -= skip;
         while (count) {
             if (pr2six[*bufin] >= 64) {
                 if (!(flags & APR_ENCODE_RELAXED)) {
@@ -436,6 +448,11 @@ APR_DECLARE(apr_status_t) apr_decode_base64(char *dest, const char *src,
             bufout = (unsigned char *)dest;
             bufin = (const unsigned char *)src;
 
+            skip = apr__decode_base64_blocks(bufout, bufin, count);
+            bufin += skip;
+            bufout += skip / 4 * 3;
+            count -= skip;
+
             while (count >= 4) {
                 *(bufout++) = TO_NATIVE(pr2six[bufin[0]] << 2 |
                                         pr2six[bufin[1]] >> 4);
@@ -500,8 +517,12 @@ APR_DECLARE(apr_status_t) apr_decode_base64_binary(unsigned char *dest,
 
     if (src) {
         const unsigned char *bufin;
+        apr_size_t skip;
 
         bufin = (const unsigned char *)src;
+        skip = apr__decode_base64_valid(bufin, count, 0);
+        bufin += skip;
+        count -= skip;
         while (count) {
             if (pr2six[*bufin] >= 64) {
                 if (!(flags & APR_ENCODE_RELAXED)) {
@@ -528,6 +549,11 @@ APR_DECLARE(apr_status_t) apr_decode_base64_binary(unsigned char *dest,
             bufout = (unsigned char *)dest;
             bufin = (const unsigned char *)src;
 
+            skip = apr__decode_base64_blocks(bufout, bufin, count);
+            bufin += skip;
+            bufout += skip / 4 * 3;
+            count -= skip;
+
             while (count >= 4) {
                 *(bufout++) = (pr2six[bufin[0]] << 2 |
                                pr2six[bufin[1]] >> 4);
@@ -1235,7 +1261,14 @@ APR_DECLARE(apr_status_t) apr_encode_base16(char *dest,
             base = base16;
         }
 
-        for (i = 0; i < count; i++) {
+        i = 0;
+        if (!(flags & APR_ENCODE_COLON)) {
+            i = apr__encode_base16_blocks(bufout, (const unsigned char *)src,
+                                          count, flags & APR_ENCODE_LOWER);
+            bufout += i * 2;
+        }
+
+        for (; i < count; i++) {
             if ((flags & APR_ENCODE_COLON) && i) {
                 *(bufout++) = ':';
             }
@@ -1288,7 +1321,14 @@ APR_DECLARE(apr_status_t) apr_encode_base16_binary(char *dest,
             base = base16;
         }
 
-        for (i = 0; i < count; i++) {
+        i = 0;
+        if (!(flags & APR_ENCODE_COLON)) {
+            i = apr__encode_base16_blocks(bufout, (const unsigned char *)src,
+                                          count, flags & APR_ENCODE_LOWER);
+            bufout += i * 2;
+        }
+
+        for (; i < count; i++) {
             if ((flags & APR_ENCODE_COLON) && i) {
                 *(bufout++) = ':';
             }
@@ -1385,8 +1425,12 @@ APR_DECLARE(apr_status_t) apr_decode_base16(char *dest,
 
     if (src) {
         const unsigned char *bufin;
+        apr_size_t skip;
 
         bufin = (const unsigned char *)src;
+        skip = apr__decode_base16_valid(bufin, count);
+        bufin += skip;
+        count -= skip;
         while (count) {
             if (pr2two[*bufin] >= 16
                 && (!(flags & APR_ENCODE_COLON)
@@ -1407,6 +1451,13 @@ APR_DECLARE(apr_status_t) apr_decode_base16(char *dest,
             bufout = (unsigned char *)dest;
             bufin = (const unsigned char *)src;
 
+            if (!(flags & APR_ENCODE_COLON)) {
+                skip = apr__decode_base16_blocks(bufout, bufin, count);
+                bufin += skip;
+                bufout += skip / 2;
+                count -= skip;
+            }
+
             while (count >= 2) {
                 if (pr2two[bufin[0]] == 32 /* ':' */) {
                     bufin += 1;
@@ -1463,8 +1514,12 @@ APR_DECLARE(apr_status_t) apr_decode_base16_binary(unsigned char *dest,
 
     if (src) {
         const unsigned char *bufin;
+        apr_size_t skip;
 
         bufin = (const unsigned char *)src;
+        skip = apr__decode_base16_valid(bufin, count);
+        bufin += skip;
+        count -= skip;
         while (count) {
             if (pr2two[*bufin] >= 16
                 && (!(flags & APR_ENCODE_COLON)
@@ -1485,6 +1540,13 @@ APR_DECLARE(apr_status_t) apr_decode_base16_binary(unsigned char *dest,
             bufout = (unsigned char *)dest;
             bufin = (const unsigned char *)src;
 
+            if (!(flags & APR_ENCODE_COLON)) {
+                skip = apr__decode_base16_blocks(bufout, bufin, count);
+                bufin += skip;
+                bufout += skip / 2;
+                count -= skip;
+            }
+
             while (count >= 2) {
                 if (pr2two[bufin[0]] == 32 /* ':' */) {
                     bufin += 1;
@@ -1575,3 +1637,396 @@ APR_DECLARE(const unsigned char *)apr_pdecode_base16_binary(apr_pool_t * p,
 
     return NULL;
 }
+
+/* The streaming base64 encoder and decoder */
+
+struct apr_encode_stream_t {
+    /* The bucket being filled by apr_encode_stream_process(), if any */
+    char *buf;
+    apr_size_t used;
+    /* The line length to wrap at while encoding and the current column */
+    apr_size_t wrap;
+    apr_size_t col;
+    int flags;
+    /* The incomplete quantum carried to the next chunk */
+    unsigned char carry[4];
+    unsigned int ncarry:3,
+                 decode:1,
+                 /* Whether the decoder has seen the padding, or an invalid
+                  * character when relaxed */
+                 padded:1,
+                 stopped:1;
+};
+
+#define STREAM_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' \
+                         || (c) == '\n')
+
+static apr_status_t stream_cleanup(void *data)
+{
+    apr_encode_stream_t *ctx = data;
+
+    if (ctx->buf) {
+        apr_bucket_free(ctx->buf);
+        ctx->buf = NULL;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_encode_stream_t *stream_create(int flags, apr_pool_t *p)
+{
+    apr_encode_stream_t *ctx = apr_pcalloc(p, sizeof(apr_encode_stream_t));
+
+    ctx->flags = flags;
+    apr_pool_cleanup_register(p, ctx, stream_cleanup, apr_pool_cleanup_null);
+
+    return ctx;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_base64_stream_create(
+        apr_encode_stream_t **ctx, int flags, apr_size_t wrap, apr_pool_t *p)
+{
+    if ((flags & ~APR_ENCODE_BASE64URL) || wrap % 4) {
+        return APR_EINVAL;
+    }
+
+    *ctx = stream_create(flags, p);
+    (*ctx)->wrap = wrap;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_decode_base64_stream_create(
+        apr_encode_stream_t **ctx, int flags, apr_pool_t *p)
+{
+    if (flags & ~APR_ENCODE_RELAXED) {
+        return APR_EINVAL;
+    }
+
+    *ctx = stream_create(flags, p);
+    (*ctx)->decode = 1;
+
+    return APR_SUCCESS;
+}
+
+/* Encode whole quanta, breaking the lines as they fill */
+static char *stream_encode(apr_encode_stream_t *ctx, char *bufout,
+                           const unsigned char *bufin, apr_size_t count)
+{
+    while (count) {
+        apr_size_t n = count, dlen;
+
+        if (ctx->wrap && n > (ctx->wrap - ctx->col) / 4 * 3) {
+            n = (ctx->wrap - ctx->col) / 4 * 3;
+        }
+        apr_encode_base64_binary(bufout, bufin, n, ctx->flags, &dlen);
+        bufout += dlen;
+        bufin += n;
+        count -= n;
+
+        if (ctx->wrap && (ctx->col += dlen) == ctx->wrap) {
+            *bufout++ = '\r';
+            *bufout++ = '\n';
+            ctx->col = 0;
+        }
+    }
+
+    return bufout;
+}
+
+/* Decode the complete quantum (or the padded one) of the carry */
+static unsigned char *stream_decode_carry(apr_encode_stream_t *ctx,
+                                          unsigned char *bufout)
+{
+    const unsigned char *c = ctx->carry;
+
+    if (ctx->ncarry > 1) {
+        *(bufout++) = (pr2six[c[0]] << 2 | pr2six[c[1]] >> 4);
+    }
+    if (ctx->ncarry > 2) {
+        *(bufout++) = (pr2six[c[1]] << 4 | pr2six[c[2]] >> 2);
+    }
+    if (ctx->ncarry > 3) {
+        *(bufout++) = (pr2six[c[2]] << 6 | pr2six[c[3]]);
+    }
+    ctx->ncarry = 0;
+
+    return bufout;
+}
+
+static apr_status_t stream_decode(apr_encode_stream_t *ctx,
+                                  unsigned char *dest,
+                                  const unsigned char *bufin,
+                                  apr_size_t count, apr_size_t *len)
+{
+    unsigned char *bufout = dest;
+
+    while (count && !ctx->stopped) {
+        unsigned char c = *bufin;
+
+        /* Whole quanta until the next non base64 character, at once */
+        if (!ctx->ncarry && !ctx->padded && pr2six[c] < 64) {
+            apr_size_t n, dlen;
+
+            n = apr__decode_base64_valid(bufin, count, 0);
+            while (n < count && pr2six[bufin[n]] < 64) {
+                n++;
+            }
+            n -= n % 4;
+            if (n) {
+                apr_decode_base64_binary(bufout, (const char *)bufin, n,
+                                         APR_ENCODE_NONE, &dlen);
+                bufout += dlen;
+                bufin += n;
+                count -= n;
+                continue;
+            }
+        }
+
+        bufin++;
+        count--;
+
+        if (STREAM_SPACE(c)) {
+            continue;
+        }
+        if (pr2six[c] < 64 && !ctx->padded) {
+            ctx->carry[ctx->ncarry++] = c;
+            if (ctx->ncarry == 4) {
+                bufout = stream_decode_carry(ctx, bufout);
+            }
+            continue;
+        }
+        if (c == '=' && (ctx->padded || ctx->ncarry >= 2)) {
+            bufout = stream_decode_carry(ctx, bufout);
+            ctx->padded = 1;
+            continue;
+        }
+
+        /* An invalid character, or data after the padding */
+        if (!(ctx->flags & APR_ENCODE_RELAXED)) {
+            *len = bufout - dest;
+            return APR_BADCH;
+        }
+        ctx->stopped = 1;
+    }
+
+    *len = bufout - dest;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_stream_update(apr_encode_stream_t *ctx,
+        char *dest, const char *src, apr_size_t slen, apr_size_t *len)
+{
+    const unsigned char *bufin = (const unsigned char *)src;
+    char *bufout = dest;
+    apr_size_t count = ctx->ncarry + slen;
+
+    if (count < slen) {
+        return APR_ENOSPC;
+    }
+
+    if (ctx->decode) {
+        if (!dest) {
+            *len = count / 4 * 3;
+            return APR_SUCCESS;
+        }
+        return stream_decode(ctx, (unsigned char *)dest, bufin, slen, len);
+    }
+
+    if (!dest) {
+        apr_size_t chars = count / 3 * 4;
+
+        if (count / 3 > APR_SIZE_MAX / 8) {
+            return APR_ENOSPC;
+        }
+        *len = chars;
+        if (ctx->wrap) {
+            *len += (ctx->col + chars) / ctx->wrap * 2;
+        }
+        return APR_SUCCESS;
+    }
+
+    /* Complete the carried quantum first */
+    if (ctx->ncarry) {
+        while (ctx->ncarry < 3 && slen) {
+            ctx->carry[ctx->ncarry++] = *bufin++;
+            slen--;
+        }
+        if (ctx->ncarry < 3) {
+            *len = 0;
+            return APR_SUCCESS;
+        }
+        bufout = stream_encode(ctx, bufout, ctx->carry, 3);
+        ctx->ncarry = 0;
+    }
+
+    bufout = stream_encode(ctx, bufout, bufin, slen - slen % 3);
+    bufin += slen - slen % 3;
+    while (ctx->ncarry < slen % 3) {
+        ctx->carry[ctx->ncarry++] = *bufin++;
+    }
+
+    *len = bufout - dest;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_stream_finish(apr_encode_stream_t *ctx,
+        char *dest, apr_size_t *len)
+{
+    apr_status_t status = APR_SUCCESS;
+    char *bufout = dest;
+
+    if (!dest) {
+        *len = ctx->decode ? 2 : 4 + (ctx->wrap ? 2 : 0);
+        return APR_SUCCESS;
+    }
+
+    if (ctx->decode) {
+        if (ctx->ncarry == 1) {
+            status = APR_EINCOMPLETE;
+        }
+        bufout = (char *)stream_decode_carry(ctx, (unsigned char *)bufout);
+    }
+    else {
+        if (ctx->ncarry) {
+            apr_size_t dlen;
+
+            apr_encode_base64_binary(bufout, ctx->carry, ctx->ncarry,
+                                     ctx->flags, &dlen);
+            bufout += dlen;
+            ctx->col += dlen;
+        }
+        if (ctx->wrap && ctx->col) {
+            *bufout++ = '\r';
+            *bufout++ = '\n';
+        }
+    }
+
+    ctx->ncarry = 0;
+    ctx->col = 0;
+    ctx->padded = ctx->stopped = 0;
+
+    *len = bufout - dest;
+    return status;
+}
+
+/* Pass the output produced so far to the brigade, as a HEAP bucket owning
+ * the buffer */
+static void stream_emit(apr_encode_stream_t *ctx, apr_bucket_brigade *out)
+{
+    if (ctx->buf) {
+        if (ctx->used) {
+            APR_BRIGADE_INSERT_TAIL(out,
+                    apr_bucket_heap_create(ctx->buf, ctx->used,
+                                           apr_bucket_free,
+                                           out->bucket_alloc));
+        }
+        else {
+            apr_bucket_free(ctx->buf);
+        }
+        ctx->buf = NULL;
+    }
+}
+
+/* Make room for at least need bytes in the bucket being filled */
+static apr_status_t stream_room(apr_encode_stream_t *ctx,
+                                apr_bucket_brigade *out, apr_size_t need)
+{
+    if (ctx->buf && APR_BUCKET_BUFF_SIZE - ctx->used < need) {
+        stream_emit(ctx, out);
+    }
+    if (!ctx->buf) {
+        ctx->buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, out->bucket_alloc);
+        if (!ctx->buf) {
+            return APR_ENOMEM;
+        }
+        ctx->used = 0;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t stream_feed(apr_encode_stream_t *ctx,
+                                apr_bucket_brigade *out,
+                                const char *data, apr_size_t len)
+{
+    /* Room for the output of a 6 bytes chunk at least (wrapped encoding
+     * doubles in the worst case, with the carry) */
+    const apr_size_t min = 16;
+    apr_status_t rv;
+
+    while (len) {
+        apr_size_t room, n, dlen;
+
+        rv = stream_room(ctx, out, min);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        room = APR_BUCKET_BUFF_SIZE - ctx->used;
+        n = ctx->decode ? room - 3 : room / 2 - 2;
+        if (n > len) {
+            n = len;
+        }
+
+        rv = apr_encode_stream_update(ctx, ctx->buf + ctx->used, data, n,
+                                      &dlen);
+        ctx->used += dlen;
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        data += n;
+        len -= n;
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_encode_stream_process(apr_encode_stream_t *ctx,
+        apr_bucket_brigade *out, apr_bucket_brigade *in,
+        apr_read_type_e block)
+{
+    apr_status_t rv;
+
+    while (!APR_BRIGADE_EMPTY(in)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(in);
+        const char *data;
+        apr_size_t len;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            if (APR_BUCKET_IS_EOS(e)) {
+                rv = stream_room(ctx, out, 8);
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+                rv = apr_encode_stream_finish(ctx, ctx->buf + ctx->used,
+                                              &len);
+                ctx->used += len;
+                if (rv != APR_SUCCESS) {
+                    stream_emit(ctx, out);
+                    return rv;
+                }
+            }
+            /* Keep the order of what's been produced already */
+            stream_emit(ctx, out);
+
+            APR_BUCKET_REMOVE(e);
+            APR_BRIGADE_INSERT_TAIL(out, e);
+            continue;
+        }
+
+        rv = apr_bucket_read(e, &data, &len, block);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (len) {
+            rv = stream_feed(ctx, out, data, len);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        apr_bucket_delete(e);
+    }
+
+    return APR_SUCCESS;
+}
@@ -0,0 +1,1315 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Vectorized base64 and base16 cores, shared by apr_encode and apr_base64,
+ * the scan of apr_escape for the bytes to escape, the filter of
+ * apr_strmatch for the candidate matches, and the UTF-8 validation and
+ * ASCII runs of apr_utf8.
+ *
+ * Each core processes the leading blocks of its input and returns how much
+ * it consumed, the callers finishing with their scalar loops (the tails,
+ * the padding, the separators and the errors).  The x86 cores use SSSE3 or
+ * AVX2 as the CPU has them, checked once at runtime, the ARM ones NEON.
+ */
+
+#include "apr.h"
+#include "apr_encode_private.h"
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
+#if !APR_CHARSET_EBCDIC
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+        && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define ENCODE_X86 1
+#define ENCODE_TARGET(t) __attribute__((target(t)))
+#define ENCODE_NO_ASAN __attribute__((no_sanitize_address))
+#define ENCODE_CTZ(m) __builtin_ctz(m)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#include <immintrin.h>
+#include <intrin.h>
+#define ENCODE_X86 1
+#define ENCODE_TARGET(t)
+#define ENCODE_NO_ASAN
+#define ENCODE_CTZ(m) encode_ctz(m)
+static APR_INLINE int encode_ctz(unsigned int m)
+{
+    unsigned long i;
+
+    _BitScanForward(&i, m);
+    return (int)i;
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ENCODE_NEON 1
+#define ENCODE_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+
+#if ENCODE_X86 || ENCODE_NEON
+
+/* The UTF-8 validation of Keiser and Lemire: the errors of each pair of
+ * consecutive bytes are the bits common to three lookups, by the high and
+ * low nibbles of the first byte and by the high nibble of the second one.
+ * The third and fourth bytes of the sequences are checked apart, being
+ * continuations exactly where two (or three) bytes back is a lead of a
+ * three (or four) bytes sequence, which is where TWO_CONTS must be set.
+ */
+#define UTF8_TOO_SHORT    0x01 /* lead or ASCII, then lead or ASCII */
+#define UTF8_TOO_LONG     0x02 /* ASCII, then continuation */
+#define UTF8_OVERLONG_3   0x04 /* E0, then 80..9F */
+#define UTF8_TOO_LARGE    0x08 /* F4..FF, then 90..BF */
+#define UTF8_SURROGATE    0x10 /* ED, then A0..BF */
+#define UTF8_OVERLONG_2   0x20 /* C0..C1, then continuation */
+#define UTF8_OVERLONG_4   0x40 /* F0, then 80..8F */
+#define UTF8_TOO_LARGE_80 0x40 /* F5..FF, then 80..8F */
+#define UTF8_TWO_CONTS    0x80 /* continuation, then continuation */
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+#define UTF8_LARGE (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_80)
+
+static const unsigned char utf8_tables[48] = {
+    /* the high nibble of the first byte */
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_80 | UTF8_OVERLONG_4,
+    /* the low nibble of the first byte */
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    UTF8_CARRY, UTF8_CARRY,
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+    UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+    UTF8_LARGE | UTF8_SURROGATE,
+    UTF8_LARGE, UTF8_LARGE,
+    /* the high nibble of the second byte */
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3
+        | UTF8_TOO_LARGE_80 | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3
+        | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE
+        | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE
+        | UTF8_TOO_LARGE,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+/* Where the validation of the blocks before i may stop: before the last
+ * lead byte of the three last bytes, whose continuations are unchecked.
+ */
+static apr_size_t utf8_boundary(const unsigned char *src, apr_size_t i)
+{
+    apr_size_t j;
+
+    for (j = 1; j <= 3 && j <= i; j++) {
+        if (src[i - j] >= 0xc0) {
+            return i - j;
+        }
+        if (src[i - j] < 0x80) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+#endif
+
+#if ENCODE_X86
+
+#define ENCODE_SSSE3 1
+#define ENCODE_AVX2  2
+
+/* The best of the cores the CPU (and OS) supports, a benign race */
+static int encode_level(void)
+{
+    static int level = -1;
+
+    if (level < 0) {
+#if defined(_MSC_VER)
+        int info[4];
+        int l = 0;
+
+        __cpuid(info, 1);
+        if (info[2] & (1 << 9)) {
+            l = ENCODE_SSSE3;
+            /* OSXSAVE and AVX, with the YMM state enabled */
+            if ((info[2] & (3 << 27)) == (3 << 27)
+                    && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(info, 7, 0);
+                if (info[1] & (1 << 5)) {
+                    l = ENCODE_AVX2;
+                }
+            }
+        }
+        level = l;
+#else
+        __builtin_cpu_init();
+        level = __builtin_cpu_supports("avx2") ? ENCODE_AVX2
+              : __builtin_cpu_supports("ssse3") ? ENCODE_SSSE3 : 0;
+#endif
+    }
+
+    return level;
+}
+
+/* 0xFF for the bytes of x within [lo, hi] */
+#define ENCODE_RANGE(x, lo, hi) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8((x), _mm_set1_epi8(lo)), \
+                                _mm_set1_epi8((hi) - (lo))), \
+                   _mm_sub_epi8((x), _mm_set1_epi8(lo)))
+#define ENCODE_RANGE256(x, lo, hi) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8((x), \
+                                                      _mm256_set1_epi8(lo)), \
+                                      _mm256_set1_epi8((hi) - (lo))), \
+                      _mm256_sub_epi8((x), _mm256_set1_epi8(lo)))
+
+/* The six bit values of the base64 characters of x, and whether they all
+ * are, '-' and '_' included unless strict.
+ */
+ENCODE_TARGET("ssse3")
+static APR_INLINE __m128i base64_values_ssse3(__m128i x, int strict,
+                                              int *valid)
+{
+    __m128i upper = ENCODE_RANGE(x, 'A', 'Z');
+    __m128i lower = ENCODE_RANGE(x, 'a', 'z');
+    __m128i digit = ENCODE_RANGE(x, '0', '9');
+    __m128i plus = _mm_cmpeq_epi8(x, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(x, _mm_set1_epi8('/'));
+    __m128i ok, shift;
+
+    shift = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)),
+                         _mm_and_si128(lower, _mm_set1_epi8(-71))),
+            _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(4)),
+                         _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(19)),
+                                _mm_and_si128(slash, _mm_set1_epi8(16)))));
+    ok = _mm_or_si128(_mm_or_si128(upper, lower),
+                      _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+    if (!strict) {
+        __m128i dash = _mm_cmpeq_epi8(x, _mm_set1_epi8('-'));
+        __m128i under = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+
+        shift = _mm_or_si128(shift,
+                _mm_or_si128(_mm_and_si128(dash, _mm_set1_epi8(17)),
+                             _mm_and_si128(under, _mm_set1_epi8(-32))));
+        ok = _mm_or_si128(ok, _mm_or_si128(dash, under));
+    }
+
+    *valid = (_mm_movemask_epi8(ok) == 0xFFFF);
+    return _mm_add_epi8(x, shift);
+}
+
+ENCODE_TARGET("avx2")
+static APR_INLINE __m256i base64_values_avx2(__m256i x, int strict,
+                                             int *valid)
+{
+    __m256i upper = ENCODE_RANGE256(x, 'A', 'Z');
+    __m256i lower = ENCODE_RANGE256(x, 'a', 'z');
+    __m256i digit = ENCODE_RANGE256(x, '0', '9');
+    __m256i plus = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('+'));
+    __m256i slash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('/'));
+    __m256i ok, shift;
+
+    shift = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-65)),
+                            _mm256_and_si256(lower, _mm256_set1_epi8(-71))),
+            _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(4)),
+                    _mm256_or_si256(
+                            _mm256_and_si256(plus, _mm256_set1_epi8(19)),
+                            _mm256_and_si256(slash, _mm256_set1_epi8(16)))));
+    ok = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                         _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+    if (!strict) {
+        __m256i dash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('-'));
+        __m256i under = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'));
+
+        shift = _mm256_or_si256(shift,
+                _mm256_or_si256(_mm256_and_si256(dash, _mm256_set1_epi8(17)),
+                        _mm256_and_si256(under, _mm256_set1_epi8(-32))));
+        ok = _mm256_or_si256(ok, _mm256_or_si256(dash, under));
+    }
+
+    *valid = (_mm256_movemask_epi8(ok) == -1);
+    return _mm256_add_epi8(x, shift);
+}
+
+/* Spread the 12 bytes of each lane to 16 six bit values (W. Mula) */
+#define BASE64_SPLIT(in, shuffle, and, mulhi, mullo, or, set1_32) \
+    or(mulhi(and(shuffle(in, base64_spread), set1_32(0x0fc0fc00)), \
+             set1_32(0x04000040)), \
+       mullo(and(shuffle(in, base64_spread), set1_32(0x003f03f0)), \
+             set1_32(0x01000010)))
+
+/* Then to the characters, by the offset of their range */
+ENCODE_TARGET("ssse3")
+static APR_INLINE __m128i base64_chars_ssse3(__m128i v, int url)
+{
+    __m128i lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                '0' - 52, '0' - 52, '0' - 52,
+                                url ? '-' - 62 : '+' - 62,
+                                url ? '_' - 63 : '/' - 63, 'A', 0, 0);
+    __m128i r = _mm_subs_epu8(v, _mm_set1_epi8(51));
+
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), v),
+                                      _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(lut, r), v);
+}
+
+ENCODE_TARGET("avx2")
+static APR_INLINE __m256i base64_chars_avx2(__m256i v, int url)
+{
+    __m256i lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                   '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                   '0' - 52, '0' - 52, '0' - 52,
+                                   url ? '-' - 62 : '+' - 62,
+                                   url ? '_' - 63 : '/' - 63, 'A', 0, 0,
+                                   'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                   '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                   '0' - 52, '0' - 52, '0' - 52,
+                                   url ? '-' - 62 : '+' - 62,
+                                   url ? '_' - 63 : '/' - 63, 'A', 0, 0);
+    __m256i r = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+
+    r = _mm256_or_si256(r, _mm256_and_si256(
+                _mm256_cmpgt_epi8(_mm256_set1_epi8(26), v),
+                _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lut, r), v);
+}
+
+ENCODE_TARGET("ssse3")
+static apr_size_t base64_encode_ssse3(char *dest, const unsigned char *src,
+                                      apr_size_t count, int url)
+{
+    const __m128i base64_spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                               4, 5, 3, 4, 1, 2, 0, 1);
+    apr_size_t i;
+
+    /* 12 bytes at a time, loading 16 */
+    for (i = 0; i + 16 <= count; i += 12) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i v = BASE64_SPLIT(in, _mm_shuffle_epi8, _mm_and_si128,
+                                 _mm_mulhi_epu16, _mm_mullo_epi16,
+                                 _mm_or_si128, _mm_set1_epi32);
+
+        _mm_storeu_si128((__m128i *)dest, base64_chars_ssse3(v, url));
+        dest += 16;
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("avx2")
+static apr_size_t base64_encode_avx2(char *dest, const unsigned char *src,
+                                     apr_size_t count, int url)
+{
+    const __m256i base64_spread = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                                  4, 5, 3, 4, 1, 2, 0, 1,
+                                                  10, 11, 9, 10, 7, 8, 6, 7,
+                                                  4, 5, 3, 4, 1, 2, 0, 1);
+    apr_size_t i;
+
+    /* 24 bytes at a time, loading 28 */
+    for (i = 0; i + 28 <= count; i += 24) {
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i *)(src + i))),
+                _mm_loadu_si128((const __m128i *)(src + i + 12)), 1);
+        __m256i v = BASE64_SPLIT(in, _mm256_shuffle_epi8, _mm256_and_si256,
+                                 _mm256_mulhi_epu16, _mm256_mullo_epi16,
+                                 _mm256_or_si256, _mm256_set1_epi32);
+
+        _mm256_storeu_si256((__m256i *)dest, base64_chars_avx2(v, url));
+        dest += 32;
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("ssse3")
+static apr_size_t base64_valid_ssse3(const unsigned char *src,
+                                     apr_size_t count, int strict)
+{
+    apr_size_t i;
+    int valid;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        base64_values_ssse3(_mm_loadu_si128((const __m128i *)(src + i)),
+                            strict, &valid);
+        if (!valid) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("avx2")
+static apr_size_t base64_valid_avx2(const unsigned char *src,
+                                    apr_size_t count, int strict)
+{
+    apr_size_t i;
+    int valid;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        base64_values_avx2(_mm256_loadu_si256((const __m256i *)(src + i)),
+                           strict, &valid);
+        if (!valid) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/* Pack the four six bit values of each 32 bits to three bytes, in the
+ * first 12 bytes of each lane.
+ */
+#define BASE64_PACK(v, maddubs, madd, shuffle, set1_32, compact) \
+    shuffle(madd(maddubs(v, set1_32(0x01400140)), set1_32(0x00011000)), \
+            compact)
+
+ENCODE_TARGET("ssse3")
+static apr_size_t base64_decode_ssse3(unsigned char *dest,
+                                      const unsigned char *src,
+                                      apr_size_t count)
+{
+    const __m128i compact = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                          14, 13, 12, -1, -1, -1, -1);
+    apr_size_t i;
+    int valid;
+
+    /* 16 characters at a time, storing 16 bytes for 12 so while more
+     * are to come
+     */
+    for (i = 0; i + 24 <= count; i += 16) {
+        __m128i v = base64_values_ssse3(
+                _mm_loadu_si128((const __m128i *)(src + i)), 0, &valid);
+
+        _mm_storeu_si128((__m128i *)dest,
+                         BASE64_PACK(v, _mm_maddubs_epi16, _mm_madd_epi16,
+                                     _mm_shuffle_epi8, _mm_set1_epi32,
+                                     compact));
+        dest += 12;
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("avx2")
+static apr_size_t base64_decode_avx2(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+    const __m256i compact = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                             14, 13, 12, -1, -1, -1, -1,
+                                             2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                             14, 13, 12, -1, -1, -1, -1);
+    apr_size_t i;
+    int valid;
+
+    for (i = 0; i + 40 <= count; i += 32) {
+        __m256i v = base64_values_avx2(
+                _mm256_loadu_si256((const __m256i *)(src + i)), 0, &valid);
+
+        v = BASE64_PACK(v, _mm256_maddubs_epi16, _mm256_madd_epi16,
+                        _mm256_shuffle_epi8, _mm256_set1_epi32, compact);
+        _mm_storeu_si128((__m128i *)dest, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *)(dest + 12),
+                         _mm256_extracti128_si256(v, 1));
+        dest += 24;
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("ssse3")
+static apr_size_t base16_encode_ssse3(char *dest, const unsigned char *src,
+                                      apr_size_t count, int lower)
+{
+    const __m128i lut = lower
+            ? _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                            '8', '9', 'a', 'b', 'c', 'd', 'e', 'f')
+            : _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                            '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_shuffle_epi8(lut,
+                _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, nibble));
+
+        _mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(dest + 16), _mm_unpackhi_epi8(hi, lo));
+        dest += 32;
+    }
+
+    return i;
+}
+
+/* The nibbles of the hexadecimal digits of x, and whether they all are */
+ENCODE_TARGET("ssse3")
+static APR_INLINE __m128i base16_values_ssse3(__m128i x, int *valid)
+{
+    __m128i digit = ENCODE_RANGE(x, '0', '9');
+    __m128i upper = ENCODE_RANGE(x, 'A', 'F');
+    __m128i lower = ENCODE_RANGE(x, 'a', 'f');
+    __m128i shift;
+
+    shift = _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(-48)),
+                         _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-55)),
+                                      _mm_and_si128(lower,
+                                                    _mm_set1_epi8(-87))));
+    *valid = (_mm_movemask_epi8(_mm_or_si128(digit,
+                                _mm_or_si128(upper, lower))) == 0xFFFF);
+    return _mm_add_epi8(x, shift);
+}
+
+ENCODE_TARGET("ssse3")
+static apr_size_t base16_valid_ssse3(const unsigned char *src,
+                                     apr_size_t count)
+{
+    apr_size_t i;
+    int valid;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        base16_values_ssse3(_mm_loadu_si128((const __m128i *)(src + i)),
+                            &valid);
+        if (!valid) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("ssse3")
+static apr_size_t base16_decode_ssse3(unsigned char *dest,
+                                      const unsigned char *src,
+                                      apr_size_t count)
+{
+    apr_size_t i;
+    int valid;
+
+    /* 32 digits at a time */
+    for (i = 0; i + 32 <= count; i += 32) {
+        __m128i a = base16_values_ssse3(
+                _mm_loadu_si128((const __m128i *)(src + i)), &valid);
+        __m128i b = base16_values_ssse3(
+                _mm_loadu_si128((const __m128i *)(src + i + 16)), &valid);
+
+        a = _mm_maddubs_epi16(a, _mm_set1_epi16(0x0110));
+        b = _mm_maddubs_epi16(b, _mm_set1_epi16(0x0110));
+        _mm_storeu_si128((__m128i *)dest, _mm_packus_epi16(a, b));
+        dest += 16;
+    }
+
+    return i;
+}
+
+/* The bytes of x to stop at: NUL, those of the nibbles and the non ASCII
+ * ones if high is set (all ones).
+ */
+#define ESCAPE_STOPS(x, lo_tab, hi_tab, bits, high, shuffle, and, andnot, \
+                     or, cmpeq, cmpgt, srli, set1, zero) \
+    or(or(cmpeq((x), zero), and(cmpgt(zero, (x)), (high))), \
+       andnot(cmpeq(and(or(and(cmpgt(zero, (x)), \
+                               shuffle((hi_tab), and((x), set1(0x0f)))), \
+                           andnot(cmpgt(zero, (x)), \
+                                  shuffle((lo_tab), and((x), set1(0x0f))))), \
+                        shuffle((bits), and(srli((x), 4), set1(0x0f)))), \
+                    zero), \
+              cmpeq(zero, zero)))
+
+/* Aligned loads never cross a page, so the scans can read the blocks of
+ * NUL terminated strings whole, past their ends.
+ */
+ENCODE_TARGET("ssse3") ENCODE_NO_ASAN
+static apr_size_t escape_skip_ssse3(const unsigned char *src,
+                                    apr_size_t count,
+                                    const unsigned char *nibbles, int high)
+{
+    const __m128i lo_tab = _mm_loadu_si128((const __m128i *)nibbles);
+    const __m128i hi_tab = _mm_loadu_si128((const __m128i *)(nibbles + 16));
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                       1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i highs = _mm_set1_epi8(high ? -1 : 0);
+    const __m128i *p = (const __m128i *)(src - ((apr_uintptr_t)src & 15));
+    apr_size_t skip = src - (const unsigned char *)p, i = 0;
+    unsigned int m;
+    __m128i x;
+
+#define ESCAPE_STOPS_SSSE3(x) \
+    (unsigned int)_mm_movemask_epi8(ESCAPE_STOPS(x, lo_tab, hi_tab, bits, \
+            highs, _mm_shuffle_epi8, _mm_and_si128, _mm_andnot_si128, \
+            _mm_or_si128, _mm_cmpeq_epi8, _mm_cmpgt_epi8, _mm_srli_epi16, \
+            _mm_set1_epi8, _mm_setzero_si128()))
+
+    x = _mm_load_si128(p);
+    m = ESCAPE_STOPS_SSSE3(x) >> skip;
+    while (!m) {
+        i += 16 - skip;
+        skip = 0;
+        if (i >= count) {
+            return count;
+        }
+        x = _mm_load_si128(++p);
+        m = ESCAPE_STOPS_SSSE3(x);
+    }
+    i += ENCODE_CTZ(m);
+
+#undef ESCAPE_STOPS_SSSE3
+
+    return i < count ? i : count;
+}
+
+ENCODE_TARGET("avx2") ENCODE_NO_ASAN
+static apr_size_t escape_skip_avx2(const unsigned char *src,
+                                   apr_size_t count,
+                                   const unsigned char *nibbles, int high)
+{
+    const __m256i lo_tab = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)nibbles));
+    const __m256i hi_tab = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)(nibbles + 16)));
+    const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i highs = _mm256_set1_epi8(high ? -1 : 0);
+    const __m256i *p = (const __m256i *)(src - ((apr_uintptr_t)src & 31));
+    apr_size_t skip = src - (const unsigned char *)p, i = 0;
+    unsigned int m;
+    __m256i x;
+
+#define ESCAPE_STOPS_AVX2(x) \
+    (unsigned int)_mm256_movemask_epi8(ESCAPE_STOPS(x, lo_tab, hi_tab, \
+            bits, highs, _mm256_shuffle_epi8, _mm256_and_si256, \
+            _mm256_andnot_si256, _mm256_or_si256, _mm256_cmpeq_epi8, \
+            _mm256_cmpgt_epi8, _mm256_srli_epi16, _mm256_set1_epi8, \
+            _mm256_setzero_si256()))
+
+    x = _mm256_load_si256(p);
+    m = ESCAPE_STOPS_AVX2(x) >> skip;
+    while (!m) {
+        i += 32 - skip;
+        skip = 0;
+        if (i >= count) {
+            return count;
+        }
+        x = _mm256_load_si256(++p);
+        m = ESCAPE_STOPS_AVX2(x);
+    }
+    i += ENCODE_CTZ(m);
+
+#undef ESCAPE_STOPS_AVX2
+
+    return i < count ? i : count;
+}
+
+/* The offsets whose first and last bytes (ORed with their folds) are those
+ * of the pattern, as many at once as a vector holds.
+ */
+ENCODE_TARGET("sse2")
+static apr_size_t strmatch_pair_sse2(const unsigned char *s, apr_size_t n,
+                                     apr_size_t plen, unsigned char first,
+                                     unsigned char last, unsigned char ffold,
+                                     unsigned char lfold)
+{
+    const __m128i f = _mm_set1_epi8((char)first);
+    const __m128i l = _mm_set1_epi8((char)last);
+    const __m128i ff = _mm_set1_epi8((char)ffold);
+    const __m128i lf = _mm_set1_epi8((char)lfold);
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i *)(s + i)),
+                                 ff);
+        __m128i b = _mm_or_si128(
+                _mm_loadu_si128((const __m128i *)(s + i + plen - 1)), lf);
+        unsigned int m = (unsigned int)_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, f), _mm_cmpeq_epi8(b, l)));
+
+        if (m) {
+            return i + ENCODE_CTZ(m);
+        }
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("avx2")
+static apr_size_t strmatch_pair_avx2(const unsigned char *s, apr_size_t n,
+                                     apr_size_t plen, unsigned char first,
+                                     unsigned char last, unsigned char ffold,
+                                     unsigned char lfold)
+{
+    const __m256i f = _mm256_set1_epi8((char)first);
+    const __m256i l = _mm256_set1_epi8((char)last);
+    const __m256i ff = _mm256_set1_epi8((char)ffold);
+    const __m256i lf = _mm256_set1_epi8((char)lfold);
+    apr_size_t i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_or_si256(
+                _mm256_loadu_si256((const __m256i *)(s + i)), ff);
+        __m256i b = _mm256_or_si256(
+                _mm256_loadu_si256((const __m256i *)(s + i + plen - 1)), lf);
+        unsigned int m = (unsigned int)_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, f),
+                                 _mm256_cmpeq_epi8(b, l)));
+
+        if (m) {
+            return i + ENCODE_CTZ(m);
+        }
+    }
+
+    return i;
+}
+
+/* The errors of the bytes of x, prev being the block before */
+#define UTF8_ERRORS(x, prev1, prev2, prev3, t1, t2, t3, nib, shuffle, \
+                    and, or, xor, srli, subs, set1) \
+    xor(and(or(subs((prev2), set1((char)(0xe0 - 0x80))), \
+               subs((prev3), set1((char)(0xf0 - 0x80)))), \
+            set1((char)0x80)), \
+        and(and(shuffle((t1), and(srli((prev1), 4), (nib))), \
+                shuffle((t2), and((prev1), (nib)))), \
+            shuffle((t3), and(srli((x), 4), (nib)))))
+
+ENCODE_TARGET("ssse3")
+static apr_size_t utf8_valid_ssse3(const unsigned char *src,
+                                   apr_size_t count)
+{
+    const __m128i t1 = _mm_loadu_si128((const __m128i *)utf8_tables);
+    const __m128i t2 = _mm_loadu_si128((const __m128i *)(utf8_tables + 16));
+    const __m128i t3 = _mm_loadu_si128((const __m128i *)(utf8_tables + 32));
+    const __m128i nib = _mm_set1_epi8(0x0f);
+    __m128i prev = _mm_setzero_si128();
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+        /* ASCII after complete characters needs no check */
+        if (_mm_movemask_epi8(x) | (_mm_movemask_epi8(prev) & 0xe000)) {
+            __m128i e = UTF8_ERRORS(x, _mm_alignr_epi8(x, prev, 15),
+                                    _mm_alignr_epi8(x, prev, 14),
+                                    _mm_alignr_epi8(x, prev, 13),
+                                    t1, t2, t3, nib, _mm_shuffle_epi8,
+                                    _mm_and_si128, _mm_or_si128,
+                                    _mm_xor_si128, _mm_srli_epi16,
+                                    _mm_subs_epu8, _mm_set1_epi8);
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(e, _mm_setzero_si128()))
+                    != 0xffff) {
+                break;
+            }
+        }
+        prev = x;
+    }
+
+    return utf8_boundary(src, i);
+}
+
+ENCODE_TARGET("avx2")
+static apr_size_t utf8_valid_avx2(const unsigned char *src,
+                                  apr_size_t count)
+{
+    const __m256i t1 = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)utf8_tables));
+    const __m256i t2 = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)(utf8_tables + 16)));
+    const __m256i t3 = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)(utf8_tables + 32)));
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    __m256i prev = _mm256_setzero_si256();
+    apr_size_t i;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+
+        if (_mm256_movemask_epi8(x)
+                | (_mm256_movemask_epi8(prev) & 0xe0000000)) {
+            /* The high half of prev then the low half of x, for the
+             * in lane shifts.
+             */
+            __m256i t = _mm256_permute2x128_si256(prev, x, 0x21);
+            __m256i e = UTF8_ERRORS(x, _mm256_alignr_epi8(x, t, 15),
+                                    _mm256_alignr_epi8(x, t, 14),
+                                    _mm256_alignr_epi8(x, t, 13),
+                                    t1, t2, t3, nib, _mm256_shuffle_epi8,
+                                    _mm256_and_si256, _mm256_or_si256,
+                                    _mm256_xor_si256, _mm256_srli_epi16,
+                                    _mm256_subs_epu8, _mm256_set1_epi8);
+
+            if ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(e,
+                    _mm256_setzero_si256())) != 0xffffffffU) {
+                break;
+            }
+        }
+        prev = x;
+    }
+
+    return utf8_boundary(src, i);
+}
+
+ENCODE_TARGET("sse2")
+static apr_size_t utf8_ascii_sse2(const unsigned char *src,
+                                  apr_size_t count)
+{
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        unsigned int m = (unsigned int)_mm_movemask_epi8(
+                _mm_loadu_si128((const __m128i *)(src + i)));
+
+        if (m) {
+            return i + ENCODE_CTZ(m);
+        }
+    }
+
+    return i;
+}
+
+ENCODE_TARGET("avx2")
+static apr_size_t utf8_ascii_avx2(const unsigned char *src,
+                                  apr_size_t count)
+{
+    apr_size_t i;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        unsigned int m = (unsigned int)_mm256_movemask_epi8(
+                _mm256_loadu_si256((const __m256i *)(src + i)));
+
+        if (m) {
+            return i + ENCODE_CTZ(m);
+        }
+    }
+
+    return i;
+}
+
+#elif ENCODE_NEON
+
+static const unsigned char base64_neon_std[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const unsigned char base64_neon_url[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+#define ENCODE_RANGE(x, lo, hi) \
+    vcleq_u8(vsubq_u8((x), vdupq_n_u8(lo)), vdupq_n_u8((hi) - (lo)))
+
+static APR_INLINE uint8x16_t base64_values_neon(uint8x16_t x, int strict,
+                                                uint8x16_t *ok)
+{
+    uint8x16_t upper = ENCODE_RANGE(x, 'A', 'Z');
+    uint8x16_t lower = ENCODE_RANGE(x, 'a', 'z');
+    uint8x16_t digit = ENCODE_RANGE(x, '0', '9');
+    uint8x16_t plus = vceqq_u8(x, vdupq_n_u8('+'));
+    uint8x16_t slash = vceqq_u8(x, vdupq_n_u8('/'));
+    uint8x16_t shift;
+
+    shift = vorrq_u8(vorrq_u8(vandq_u8(upper, vdupq_n_u8((apr_byte_t)-65)),
+                              vandq_u8(lower, vdupq_n_u8((apr_byte_t)-71))),
+                     vorrq_u8(vandq_u8(digit, vdupq_n_u8(4)),
+                              vorrq_u8(vandq_u8(plus, vdupq_n_u8(19)),
+                                       vandq_u8(slash, vdupq_n_u8(16)))));
+    *ok = vorrq_u8(vorrq_u8(upper, lower),
+                   vorrq_u8(digit, vorrq_u8(plus, slash)));
+    if (!strict) {
+        uint8x16_t dash = vceqq_u8(x, vdupq_n_u8('-'));
+        uint8x16_t under = vceqq_u8(x, vdupq_n_u8('_'));
+
+        shift = vorrq_u8(shift,
+                vorrq_u8(vandq_u8(dash, vdupq_n_u8(17)),
+                         vandq_u8(under, vdupq_n_u8((apr_byte_t)-32))));
+        *ok = vorrq_u8(*ok, vorrq_u8(dash, under));
+    }
+
+    return vaddq_u8(x, shift);
+}
+
+static apr_size_t base64_encode_neon(char *dest, const unsigned char *src,
+                                     apr_size_t count, int url)
+{
+    const unsigned char *t = url ? base64_neon_url : base64_neon_std;
+    uint8x16x4_t lut = { { vld1q_u8(t), vld1q_u8(t + 16),
+                           vld1q_u8(t + 32), vld1q_u8(t + 48) } };
+    apr_size_t i;
+
+    /* 48 bytes at a time, deinterleaved by three */
+    for (i = 0; i + 48 <= count; i += 48) {
+        uint8x16x3_t in = vld3q_u8(src + i);
+        uint8x16x4_t out;
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+                                       vshrq_n_u8(in.val[1], 4)),
+                              vdupq_n_u8(0x3f));
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+                                       vshrq_n_u8(in.val[2], 6)),
+                              vdupq_n_u8(0x3f));
+        out.val[3] = vandq_u8(in.val[2], vdupq_n_u8(0x3f));
+
+        out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+        out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+        out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+        out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+        vst4q_u8((unsigned char *)dest, out);
+        dest += 64;
+    }
+
+    return i;
+}
+
+static apr_size_t base64_valid_neon(const unsigned char *src,
+                                    apr_size_t count, int strict)
+{
+    apr_size_t i;
+    uint8x16_t ok;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        base64_values_neon(vld1q_u8(src + i), strict, &ok);
+        if (vminvq_u8(ok) != 0xff) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+static apr_size_t base64_decode_neon(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+    apr_size_t i;
+    uint8x16_t ok;
+
+    /* 64 characters at a time, deinterleaved by four */
+    for (i = 0; i + 64 <= count; i += 64) {
+        uint8x16x4_t in = vld4q_u8(src + i);
+        uint8x16x3_t out;
+        uint8x16_t a = base64_values_neon(in.val[0], 0, &ok);
+        uint8x16_t b = base64_values_neon(in.val[1], 0, &ok);
+        uint8x16_t c = base64_values_neon(in.val[2], 0, &ok);
+        uint8x16_t d = base64_values_neon(in.val[3], 0, &ok);
+
+        out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8(dest, out);
+        dest += 48;
+    }
+
+    return i;
+}
+
+static apr_size_t base16_encode_neon(char *dest, const unsigned char *src,
+                                     apr_size_t count, int lower)
+{
+    const uint8x16_t lut = vld1q_u8((const unsigned char *)(lower
+            ? "0123456789abcdef" : "0123456789ABCDEF"));
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint8x16_t in = vld1q_u8(src + i);
+        uint8x16x2_t out;
+
+        out.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(in, 4));
+        out.val[1] = vqtbl1q_u8(lut, vandq_u8(in, vdupq_n_u8(0x0f)));
+        vst2q_u8((unsigned char *)dest, out);
+        dest += 32;
+    }
+
+    return i;
+}
+
+static APR_INLINE uint8x16_t base16_values_neon(uint8x16_t x, uint8x16_t *ok)
+{
+    uint8x16_t digit = ENCODE_RANGE(x, '0', '9');
+    uint8x16_t upper = ENCODE_RANGE(x, 'A', 'F');
+    uint8x16_t lower = ENCODE_RANGE(x, 'a', 'f');
+    uint8x16_t shift;
+
+    shift = vorrq_u8(vandq_u8(digit, vdupq_n_u8((apr_byte_t)-48)),
+                     vorrq_u8(vandq_u8(upper, vdupq_n_u8((apr_byte_t)-55)),
+                              vandq_u8(lower, vdupq_n_u8((apr_byte_t)-87))));
+    *ok = vorrq_u8(digit, vorrq_u8(upper, lower));
+
+    return vaddq_u8(x, shift);
+}
+
+static apr_size_t base16_valid_neon(const unsigned char *src,
+                                    apr_size_t count)
+{
+    apr_size_t i;
+    uint8x16_t ok;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        base16_values_neon(vld1q_u8(src + i), &ok);
+        if (vminvq_u8(ok) != 0xff) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+static apr_size_t base16_decode_neon(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+    apr_size_t i;
+    uint8x16_t ok;
+
+    /* 32 digits at a time, deinterleaved by two */
+    for (i = 0; i + 32 <= count; i += 32) {
+        uint8x16x2_t in = vld2q_u8(src + i);
+        uint8x16_t hi = base16_values_neon(in.val[0], &ok);
+        uint8x16_t lo = base16_values_neon(in.val[1], &ok);
+
+        vst1q_u8(dest, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+        dest += 16;
+    }
+
+    return i;
+}
+
+/* Aligned loads never cross a page, so the scan can read the blocks of
+ * NUL terminated strings whole, past their ends.
+ */
+ENCODE_NO_ASAN
+static apr_size_t escape_skip_neon(const unsigned char *src,
+                                   apr_size_t count,
+                                   const unsigned char *nibbles, int high)
+{
+    static const unsigned char bit[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    const uint8x16_t lo_tab = vld1q_u8(nibbles);
+    const uint8x16_t hi_tab = vld1q_u8(nibbles + 16);
+    const uint8x16_t bits = vld1q_u8(bit);
+    const uint8x16_t highs = vdupq_n_u8(high ? 0xFF : 0);
+    const unsigned char *p = src - ((apr_uintptr_t)src & 15);
+    apr_size_t skip = src - p, i = 0;
+    uint8x16_t x;
+    uint64_t m;
+
+#define ESCAPE_STOPS_NEON(x) \
+    vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8( \
+        vorrq_u8(vorrq_u8(vceqzq_u8(x), \
+                          vandq_u8(vcltzq_s8(vreinterpretq_s8_u8(x)), \
+                                   highs)), \
+                 vtstq_u8(vbslq_u8(vcltzq_s8(vreinterpretq_s8_u8(x)), \
+                                   vqtbl1q_u8(hi_tab, \
+                                              vandq_u8(x, vdupq_n_u8(15))), \
+                                   vqtbl1q_u8(lo_tab, \
+                                              vandq_u8(x, vdupq_n_u8(15)))), \
+                          vqtbl1q_u8(bits, vshrq_n_u8(x, 4))))), 4)), 0)
+
+    x = vld1q_u8(p);
+    m = ESCAPE_STOPS_NEON(x) >> (skip * 4);
+    while (!m) {
+        i += 16 - skip;
+        skip = 0;
+        if (i >= count) {
+            return count;
+        }
+        p += 16;
+        x = vld1q_u8(p);
+        m = ESCAPE_STOPS_NEON(x);
+    }
+    i += __builtin_ctzll(m) / 4;
+
+#undef ESCAPE_STOPS_NEON
+
+    return i < count ? i : count;
+}
+
+static apr_size_t strmatch_pair_neon(const unsigned char *s, apr_size_t n,
+                                     apr_size_t plen, unsigned char first,
+                                     unsigned char last, unsigned char ffold,
+                                     unsigned char lfold)
+{
+    const uint8x16_t f = vdupq_n_u8(first);
+    const uint8x16_t l = vdupq_n_u8(last);
+    const uint8x16_t ff = vdupq_n_u8(ffold);
+    const uint8x16_t lf = vdupq_n_u8(lfold);
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        uint8x16_t a = vorrq_u8(vld1q_u8(s + i), ff);
+        uint8x16_t b = vorrq_u8(vld1q_u8(s + i + plen - 1), lf);
+        uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+                vreinterpretq_u16_u8(vandq_u8(vceqq_u8(a, f),
+                                              vceqq_u8(b, l))), 4)), 0);
+
+        if (m) {
+            return i + __builtin_ctzll(m) / 4;
+        }
+    }
+
+    return i;
+}
+
+static apr_size_t utf8_valid_neon(const unsigned char *src,
+                                  apr_size_t count)
+{
+    const uint8x16_t t1 = vld1q_u8(utf8_tables);
+    const uint8x16_t t2 = vld1q_u8(utf8_tables + 16);
+    const uint8x16_t t3 = vld1q_u8(utf8_tables + 32);
+    const uint8x16_t nib = vdupq_n_u8(0x0f);
+    uint8x16_t prev = vdupq_n_u8(0);
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint8x16_t x = vld1q_u8(src + i);
+
+        if (vmaxvq_u8(vorrq_u8(x, prev)) >= 0x80) {
+            uint8x16_t prev1 = vextq_u8(prev, x, 15);
+            uint8x16_t prev2 = vextq_u8(prev, x, 14);
+            uint8x16_t prev3 = vextq_u8(prev, x, 13);
+            uint8x16_t e = veorq_u8(
+                    vandq_u8(vorrq_u8(vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80)),
+                                      vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80))),
+                             vdupq_n_u8(0x80)),
+                    vandq_u8(vandq_u8(vqtbl1q_u8(t1, vshrq_n_u8(prev1, 4)),
+                                      vqtbl1q_u8(t2, vandq_u8(prev1, nib))),
+                             vqtbl1q_u8(t3, vshrq_n_u8(x, 4))));
+
+            if (vmaxvq_u8(e)) {
+                break;
+            }
+        }
+        prev = x;
+    }
+
+    return utf8_boundary(src, i);
+}
+
+static apr_size_t utf8_ascii_neon(const unsigned char *src,
+                                  apr_size_t count)
+{
+    apr_size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(src + i)) >= 0x80) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+#endif /* ENCODE_NEON */
+
+apr_size_t apr__encode_base64_blocks(char *dest, const unsigned char *src,
+                                     apr_size_t count, int url)
+{
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        return base64_encode_avx2(dest, src, count, url);
+    case ENCODE_SSSE3:
+        return base64_encode_ssse3(dest, src, count, url);
+    }
+#elif ENCODE_NEON
+    return base64_encode_neon(dest, src, count, url);
+#endif
+    return 0;
+}
+
+apr_size_t apr__decode_base64_valid(const unsigned char *src,
+                                    apr_size_t count, int strict)
+{
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        return base64_valid_avx2(src, count, strict);
+    case ENCODE_SSSE3:
+        return base64_valid_ssse3(src, count, strict);
+    }
+#elif ENCODE_NEON
+    return base64_valid_neon(src, count, strict);
+#endif
+    return 0;
+}
+
+apr_size_t apr__decode_base64_blocks(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        return base64_decode_avx2(dest, src, count);
+    case ENCODE_SSSE3:
+        return base64_decode_ssse3(dest, src, count);
+    }
+#elif ENCODE_NEON
+    return base64_decode_neon(dest, src, count);
+#endif
+    return 0;
+}
+
+apr_size_t apr__encode_base16_blocks(char *dest, const unsigned char *src,
+                                     apr_size_t count, int lower)
+{
+#if ENCODE_X86
+    if (encode_level()) {
+        return base16_encode_ssse3(dest, src, count, lower);
+    }
+#elif ENCODE_NEON
+    return base16_encode_neon(dest, src, count, lower);
+#endif
+    return 0;
+}
+
+apr_size_t apr__decode_base16_valid(const unsigned char *src,
+                                    apr_size_t count)
+{
+#if ENCODE_X86
+    if (encode_level()) {
+        return base16_valid_ssse3(src, count);
+    }
+#elif ENCODE_NEON
+    return base16_valid_neon(src, count);
+#endif
+    return 0;
+}
+
+apr_size_t apr__decode_base16_blocks(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count)
+{
+#if ENCODE_X86
+    if (encode_level()) {
+        return base16_decode_ssse3(dest, src, count);
+    }
+#elif ENCODE_NEON
+    return base16_decode_neon(dest, src, count);
+#endif
+    return 0;
+}
+
+apr_size_t apr__escape_skip(const unsigned char *src, apr_size_t count,
+                            const unsigned char *nibbles, int high)
+{
+    if (!count) {
+        return 0;
+    }
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        return escape_skip_avx2(src, count, nibbles, high);
+    case ENCODE_SSSE3:
+        return escape_skip_ssse3(src, count, nibbles, high);
+    }
+#elif ENCODE_NEON
+    return escape_skip_neon(src, count, nibbles, high);
+#endif
+    {
+        apr_size_t i;
+
+        for (i = 0; i < count; i++) {
+            unsigned int c = src[i];
+
+            if (!c || (high && c >= 0x80)
+                    || nibbles[(c & 15) | (c & 0x80 ? 16 : 0)]
+                       & (1 << ((c >> 4) & 7))) {
+                break;
+            }
+        }
+
+        return i;
+    }
+}
+
+apr_size_t apr__strmatch_pair(const unsigned char *s, apr_size_t n,
+                              apr_size_t plen, unsigned char first,
+                              unsigned char last, unsigned char ffold,
+                              unsigned char lfold)
+{
+    apr_size_t i = 0;
+
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        i = strmatch_pair_avx2(s, n, plen, first, last, ffold, lfold);
+        break;
+    case ENCODE_SSSE3:
+        i = strmatch_pair_sse2(s, n, plen, first, last, ffold, lfold);
+        break;
+    }
+#elif ENCODE_NEON
+    i = strmatch_pair_neon(s, n, plen, first, last, ffold, lfold);
+#endif
+
+    while (i < n) {
+        if (!ffold) {
+            const unsigned char *c = memchr(s + i, first, n - i);
+
+            if (!c) {
+                break;
+            }
+            i = c - s;
+        }
+        if ((s[i] | ffold) == first && (s[i + plen - 1] | lfold) == last) {
+            return i;
+        }
+        i++;
+    }
+
+    return n;
+}
+
+apr_size_t apr__utf8_valid(const unsigned char *src, apr_size_t count)
+{
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        return utf8_valid_avx2(src, count);
+    case ENCODE_SSSE3:
+        return utf8_valid_ssse3(src, count);
+    }
+#elif ENCODE_NEON
+    return utf8_valid_neon(src, count);
+#endif
+    return 0;
+}
+
+apr_size_t apr__utf8_ascii(const unsigned char *src, apr_size_t count)
+{
+#if ENCODE_X86
+    switch (encode_level()) {
+    case ENCODE_AVX2:
+        return utf8_ascii_avx2(src, count);
+    case ENCODE_SSSE3:
+        return utf8_ascii_sse2(src, count);
+    }
+#elif ENCODE_NEON
+    return utf8_ascii_neon(src, count);
+#endif
+    return 0;
+}
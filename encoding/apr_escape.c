@@ -38,12 +38,43 @@
  */
 #define TEST_CHAR(c, f)        (test_char_table[(unsigned)(c)] & (f))
 
+/* The test_char_nibbles of a flag */
+#define TEST_NIBBLES(f)        (test_char_nibbles[((f) & 0xF0 ? 4 : 0) \
+                                                  | ((f) & 0xCC ? 2 : 0) \
+                                                  | ((f) & 0xAA ? 1 : 0)])
+
+/* Copy (or only skip if *d is NULL) the bytes of *s up to the next one to
+ * escape or NUL, at once, and return how many.
+ */
+static APR_INLINE apr_size_t escape_clean(unsigned char **d,
+                                          const unsigned char **s,
+                                          apr_ssize_t *slen,
+                                          const unsigned char *nibbles,
+                                          int high)
+{
+    apr_size_t n;
+
+    n = apr__escape_skip(*s, *slen < 0 ? APR_SIZE_MAX : (apr_size_t)*slen,
+                         nibbles, high);
+    if (n) {
+        if (*d) {
+            memcpy(*d, *s, n);
+            *d += n;
+        }
+        *s += n;
+        *slen -= n;
+    }
+
+    return n;
+}
+
 APR_DECLARE(apr_status_t) apr_escape_shell(char *escaped, const char *str,
         apr_ssize_t slen, apr_size_t *len)
 {
     unsigned char *d;
     const unsigned char *s;
     apr_size_t size = 1;
+    apr_size_t n;
     int found = 0;
 
     d = (unsigned char *) escaped;
@@ -52,6 +83,14 @@ APR_DECLARE(apr_status_t) apr_escape_shell(char *escaped, const char *str,
     if (s) {
         if (d) {
             for (; *s && slen; ++s, slen--) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_SHELL_CMD), 0);
+                if (n) {
+                    size += n;
+                    if (!*s || !slen) {
+                        break;
+                    }
+                }
 #if defined(OS2) || defined(WIN32)
                 /*
                  * Newlines to Win32/OS2 CreateProcess() are ill advised.
@@ -78,6 +117,14 @@ APR_DECLARE(apr_status_t) apr_escape_shell(char *escaped, const char *str,
         }
         else {
             for (; *s && slen; ++s, slen--) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_SHELL_CMD), 0);
+                if (n) {
+                    size += n;
+                    if (!*s || !slen) {
+                        break;
+                    }
+                }
                 if (TEST_CHAR(*s, T_ESCAPE_SHELL_CMD)) {
                     size++;
                     found = 1;
@@ -302,6 +349,7 @@ APR_DECLARE(apr_status_t) apr_escape_path_segment(char *escaped,
         const char *str, apr_ssize_t slen, apr_size_t *len)
 {
     apr_size_t size = 1;
+    apr_size_t n;
     int found = 0;
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
@@ -310,6 +358,12 @@ APR_DECLARE(apr_status_t) apr_escape_path_segment(char *escaped,
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_PATH_SEGMENT), 0);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_PATH_SEGMENT)) {
                     d = c2x(c, '%', d);
                     size += 2;
@@ -326,6 +380,12 @@ APR_DECLARE(apr_status_t) apr_escape_path_segment(char *escaped,
         }
         else {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_PATH_SEGMENT), 0);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_PATH_SEGMENT)) {
                     size += 2;
                     found = 1;
@@ -370,6 +430,7 @@ APR_DECLARE(apr_status_t) apr_escape_path(char *escaped, const char *path,
         apr_ssize_t slen, int partial, apr_size_t *len)
 {
     apr_size_t size = 1;
+    apr_size_t n;
     int found = 0;
     const unsigned char *s = (const unsigned char *) path;
     unsigned char *d = (unsigned char *) escaped;
@@ -394,6 +455,12 @@ APR_DECLARE(apr_status_t) apr_escape_path(char *escaped, const char *path,
     }
     if (d) {
         while ((c = *s) && slen) {
+            n = escape_clean(&d, &s, &slen,
+                             TEST_NIBBLES(T_OS_ESCAPE_PATH), 0);
+            if (n) {
+                size += n;
+                continue;
+            }
             if (TEST_CHAR(c, T_OS_ESCAPE_PATH)) {
                 d = c2x(c, '%', d);
                 size += 2;
@@ -410,6 +477,12 @@ APR_DECLARE(apr_status_t) apr_escape_path(char *escaped, const char *path,
     }
     else {
         while ((c = *s) && slen) {
+            n = escape_clean(&d, &s, &slen,
+                             TEST_NIBBLES(T_OS_ESCAPE_PATH), 0);
+            if (n) {
+                size += n;
+                continue;
+            }
             if (TEST_CHAR(c, T_OS_ESCAPE_PATH)) {
                 size += 2;
                 found = 1;
@@ -453,6 +526,7 @@ APR_DECLARE(apr_status_t) apr_escape_urlencoded(char *escaped, const char *str,
         apr_ssize_t slen, apr_size_t *len)
 {
     apr_size_t size = 1;
+    apr_size_t n;
     int found = 0;
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
@@ -461,6 +535,12 @@ APR_DECLARE(apr_status_t) apr_escape_urlencoded(char *escaped, const char *str,
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_URLENCODED), 0);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_URLENCODED)) {
                     d = c2x(c, '%', d);
                     size += 2;
@@ -481,6 +561,12 @@ APR_DECLARE(apr_status_t) apr_escape_urlencoded(char *escaped, const char *str,
         }
         else {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_URLENCODED), 0);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_URLENCODED)) {
                     size += 2;
                     found = 1;
@@ -527,6 +613,7 @@ APR_DECLARE(apr_status_t) apr_escape_entity(char *escaped, const char *str,
         apr_ssize_t slen, int toasc, apr_size_t *len)
 {
     apr_size_t size = 1;
+    apr_size_t n;
     int found = 0;
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
@@ -535,6 +622,12 @@ APR_DECLARE(apr_status_t) apr_escape_entity(char *escaped, const char *str,
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_XML), toasc);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_XML)) {
                     switch (c) {
                     case '>': {
@@ -587,6 +680,12 @@ APR_DECLARE(apr_status_t) apr_escape_entity(char *escaped, const char *str,
         }
         else {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_XML), toasc);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_XML)) {
                     switch (c) {
                     case '>': {
@@ -833,6 +932,7 @@ APR_DECLARE(apr_status_t) apr_escape_echo(char *escaped, const char *str,
         apr_ssize_t slen, int quote, apr_size_t *len)
 {
     apr_size_t size = 1;
+    apr_size_t n;
     int found = 0;
     const unsigned char *s = (const unsigned char *) str;
     unsigned char *d = (unsigned char *) escaped;
@@ -841,6 +941,12 @@ APR_DECLARE(apr_status_t) apr_escape_echo(char *escaped, const char *str,
     if (s) {
         if (d) {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_ECHO), 0);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_ECHO)) {
                     *d++ = '\\';
                     size++;
@@ -914,6 +1020,12 @@ APR_DECLARE(apr_status_t) apr_escape_echo(char *escaped, const char *str,
         }
         else {
             while ((c = *s) && slen) {
+                n = escape_clean(&d, &s, &slen,
+                                 TEST_NIBBLES(T_ESCAPE_ECHO), 0);
+                if (n) {
+                    size += n;
+                    continue;
+                }
                 if (TEST_CHAR(c, T_ESCAPE_ECHO)) {
                     size++;
                     switch (c) {
@@ -0,0 +1,272 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* UTF-8 validation and UTF-16 transcoding.
+ *
+ * The vectorized cores of apr_encode_simd.c validate the whole blocks of
+ * UTF-8 and skip the ASCII runs; the scalar code below does the rest, and
+ * all of it without them.
+ */
+
+#include "apr_utf8.h"
+#include "apr_encode_private.h"
+#include "apr_lib.h"
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
+/* Decode the UTF-8 character at s, returning its length, or 0 with
+ * *status set to APR_INCOMPLETE if it is truncated, APR_EINVAL if it is
+ * invalid.
+ */
+static apr_size_t utf8_decode(const unsigned char *s, apr_size_t len,
+                              apr_uint32_t *c, apr_status_t *status)
+{
+    apr_size_t n, i;
+    apr_uint32_t low;
+
+    if (s[0] < 0x80) {
+        *c = s[0];
+        return 1;
+    }
+    if (s[0] < 0xc2 || s[0] > 0xf4) {
+        *status = APR_EINVAL; /* continuation, overlong or too large */
+        return 0;
+    }
+    if (s[0] < 0xe0) {
+        n = 2;
+        *c = s[0] & 0x1f;
+        low = 0x80;
+    }
+    else if (s[0] < 0xf0) {
+        n = 3;
+        *c = s[0] & 0x0f;
+        low = 0x800;
+    }
+    else {
+        n = 4;
+        *c = s[0] & 0x07;
+        low = 0x10000;
+    }
+    for (i = 1; i < n; i++) {
+        if (i == len) {
+            *status = APR_INCOMPLETE;
+            return 0;
+        }
+        if ((s[i] & 0xc0) != 0x80) {
+            *status = APR_EINVAL;
+            return 0;
+        }
+        *c = (*c << 6) | (s[i] & 0x3f);
+        /* Overlongs, surrogates and beyond U+10FFFF show from the second
+         * byte on.
+         */
+        if (i == 1) {
+            apr_uint32_t shift = 6 * (n - 2);
+
+            if (*c < (low >> shift)
+                    || (n == 3 && *c >= (0xd800 >> shift)
+                               && *c <= (0xdfff >> shift))
+                    || (n == 4 && *c > (0x10ffff >> shift))) {
+                *status = APR_EINVAL;
+                return 0;
+            }
+        }
+    }
+
+    return n;
+}
+
+APR_DECLARE(apr_status_t) apr_utf8_validate(const char *src,
+                                            apr_ssize_t slen,
+                                            apr_size_t *len)
+{
+    const unsigned char *s = (const unsigned char *)src;
+    apr_status_t status = APR_SUCCESS;
+    apr_size_t count, i;
+
+    if (slen == APR_UTF8_STRING) {
+        count = strlen(src);
+    }
+    else if (slen < 0) {
+        if (len) {
+            *len = 0;
+        }
+        return APR_EINVAL;
+    }
+    else {
+        count = slen;
+    }
+
+    i = apr__utf8_valid(s, count);
+    while (i < count) {
+        apr_uint32_t c;
+        apr_size_t n;
+
+        if (s[i] < 0x80) {
+            i++;
+            continue;
+        }
+        n = utf8_decode(s + i, count - i, &c, &status);
+        if (!n) {
+            break;
+        }
+        i += n;
+    }
+
+    if (len) {
+        *len = i;
+    }
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_utf8_to_utf16(const char *in,
+                                            apr_size_t *inbytes,
+                                            apr_uint16_t *out,
+                                            apr_size_t *outwords)
+{
+    const unsigned char *s = (const unsigned char *)in;
+    apr_size_t inlen = *inbytes, outlen = *outwords;
+    apr_status_t status = APR_SUCCESS;
+
+    while (inlen && outlen) {
+        apr_size_t n = inlen < outlen ? inlen : outlen, i;
+        apr_uint32_t c;
+
+        /* widen the ASCII run */
+        i = apr__utf8_ascii(s, n);
+        while (i < n && s[i] < 0x80) {
+            i++;
+        }
+        for (n = 0; n < i; n++) {
+            out[n] = s[n];
+        }
+        s += i;
+        inlen -= i;
+        out += i;
+        outlen -= i;
+        if (!inlen || !outlen) {
+            break;
+        }
+
+        n = utf8_decode(s, inlen, &c, &status);
+        if (!n) {
+            break;
+        }
+        if (c < 0x10000) {
+            *out++ = (apr_uint16_t)c;
+            outlen--;
+        }
+        else if (outlen < 2) {
+            break;
+        }
+        else {
+            c -= 0x10000;
+            *out++ = (apr_uint16_t)(0xd800 | (c >> 10));
+            *out++ = (apr_uint16_t)(0xdc00 | (c & 0x3ff));
+            outlen -= 2;
+        }
+        s += n;
+        inlen -= n;
+    }
+
+    *inbytes = inlen;
+    *outwords = outlen;
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_utf16_to_utf8(const apr_uint16_t *in,
+                                            apr_size_t *inwords,
+                                            char *out,
+                                            apr_size_t *outbytes)
+{
+    unsigned char *d = (unsigned char *)out;
+    apr_size_t inlen = *inwords, outlen = *outbytes;
+    apr_status_t status = APR_SUCCESS;
+
+    while (inlen && outlen) {
+        apr_uint32_t c = in[0];
+        apr_size_t n = 1;
+
+        if (c < 0x80) {
+            /* narrow the ASCII run */
+            apr_size_t m = inlen < outlen ? inlen : outlen, i;
+
+            for (i = 1; i < m && in[i] < 0x80; i++)
+                ;
+            for (m = 0; m < i; m++) {
+                d[m] = (unsigned char)in[m];
+            }
+            in += i;
+            inlen -= i;
+            d += i;
+            outlen -= i;
+            continue;
+        }
+        if (c >= 0xd800 && c <= 0xdfff) {
+            if (c >= 0xdc00) {
+                status = APR_EINVAL;
+                break;
+            }
+            if (inlen < 2) {
+                status = APR_INCOMPLETE;
+                break;
+            }
+            if (in[1] < 0xdc00 || in[1] > 0xdfff) {
+                status = APR_EINVAL;
+                break;
+            }
+            c = 0x10000 + ((c - 0xd800) << 10) + (in[1] - 0xdc00);
+            n = 2;
+        }
+
+        if (c < 0x800) {
+            if (outlen < 2) {
+                break;
+            }
+            d[0] = (unsigned char)(0xc0 | (c >> 6));
+            d[1] = (unsigned char)(0x80 | (c & 0x3f));
+            d += 2;
+            outlen -= 2;
+        }
+        else if (c < 0x10000) {
+            if (outlen < 3) {
+                break;
+            }
+            d[0] = (unsigned char)(0xe0 | (c >> 12));
+            d[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3f));
+            d[2] = (unsigned char)(0x80 | (c & 0x3f));
+            d += 3;
+            outlen -= 3;
+        }
+        else {
+            if (outlen < 4) {
+                break;
+            }
+            d[0] = (unsigned char)(0xf0 | (c >> 18));
+            d[1] = (unsigned char)(0x80 | ((c >> 12) & 0x3f));
+            d[2] = (unsigned char)(0x80 | ((c >> 6) & 0x3f));
+            d[3] = (unsigned char)(0x80 | (c & 0x3f));
+            d += 4;
+            outlen -= 4;
+        }
+        in += n;
+        inlen -= n;
+    }
+
+    *inwords = inlen;
+    *outbytes = outlen;
+    return status;
+}
@@ -96,6 +96,25 @@ APR_DECLARE(apr_status_t) apr_file_pipe_timeout_get(apr_file_t *thepipe, apr_int
     return APR_EINVAL;
 }
 
+APR_DECLARE(apr_status_t) apr_file_pipe_size_set(apr_file_t *thepipe,
+                                                 apr_size_t size)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pipe_size_get(apr_file_t *thepipe,
+                                                 apr_size_t *size)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pipe_write_gift(apr_file_t *thepipe,
+                                                   const void *buf,
+                                                   apr_size_t *nbytes)
+{
+    return apr_file_write(thepipe, buf, nbytes);
+}
+
 APR_DECLARE(apr_status_t) apr_os_pipe_put_ex(apr_file_t **file,
                                              apr_os_file_t *thefile,
                                              int register_cleanup,
@@ -136,6 +136,32 @@ APR_DECLARE(apr_status_t) apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
 
 
 
+APR_DECLARE(apr_status_t) apr_dir_read_batch(apr_finfo_t *finfos,
+                                             apr_size_t nelts,
+                                             apr_size_t *nread,
+                                             apr_int32_t wanted,
+                                             apr_dir_t *thedir)
+{
+    apr_status_t rv, ret = APR_SUCCESS;
+    apr_size_t n;
+
+    for (n = 0; n < nelts; n++) {
+        rv = apr_dir_read(&finfos[n], wanted, thedir);
+        if (rv == APR_INCOMPLETE) {
+            ret = rv;
+        }
+        else if (rv != APR_SUCCESS) {
+            if (!n) {
+                ret = rv;
+            }
+            break;
+        }
+    }
+
+    *nread = n;
+    return ret;
+}
+
 APR_DECLARE(apr_status_t) apr_dir_rewind(apr_dir_t *thedir)
 {
     return apr_dir_close(thedir);
@@ -38,7 +38,7 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new, const char *fname, apr
     ULONG action;
     apr_file_t *dafile = (apr_file_t *)apr_pcalloc(pool, sizeof(apr_file_t));
 
-    if (flag & APR_FOPEN_NONBLOCK) {
+    if (flag & (APR_FOPEN_NONBLOCK | APR_FOPEN_DIRECT)) {
         return APR_ENOTIMPL;
     }
 
@@ -258,6 +258,99 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
 
 
 
+APR_DECLARE(apr_status_t) apr_file_readv(apr_file_t *thefile,
+                                         const struct iovec *vec,
+                                         apr_size_t nvec, apr_size_t *nbytes)
+{
+    apr_size_t i;
+
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        *nbytes = 0;
+        return APR_EINVAL;
+    }
+    /* As apr_file_writev(), only the first buffer to fill is read into. */
+    for (i = 0; i < nvec; i++) {
+        if (vec[i].iov_len) {
+            *nbytes = vec[i].iov_len;
+            return apr_file_read(thefile, vec[i].iov_base, nbytes);
+        }
+    }
+    *nbytes = 0;
+    return APR_SUCCESS;
+}
+
+/* No positional I/O here: seek to the offset and back again, the file
+ * pointer moving meanwhile.
+ */
+static apr_status_t file_pio(apr_file_t *thefile, const struct iovec *vec,
+                             apr_size_t nvec, apr_size_t *nbytes,
+                             apr_off_t offset, int writing)
+{
+    apr_off_t cur = 0;
+    apr_size_t i, len;
+    apr_status_t rv, rv2;
+
+    *nbytes = 0;
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        return APR_EINVAL;
+    }
+    if ((rv = apr_file_seek(thefile, APR_CUR, &cur)) != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_file_seek(thefile, APR_SET, &offset);
+    for (i = 0; rv == APR_SUCCESS && i < nvec; i++) {
+        len = 0;
+        rv = writing ? apr_file_write_full(thefile, vec[i].iov_base,
+                                           vec[i].iov_len, &len)
+                     : apr_file_read_full(thefile, vec[i].iov_base,
+                                          vec[i].iov_len, &len);
+        *nbytes += len;
+    }
+    rv2 = apr_file_seek(thefile, APR_SET, &cur);
+    if (rv == APR_EOF && *nbytes) {
+        rv = APR_SUCCESS;
+    }
+    return rv != APR_SUCCESS ? rv : rv2;
+}
+
+APR_DECLARE(apr_status_t) apr_file_preadv(apr_file_t *thefile,
+                                          const struct iovec *vec,
+                                          apr_size_t nvec, apr_size_t *nbytes,
+                                          apr_off_t offset)
+{
+    return file_pio(thefile, vec, nvec, nbytes, offset, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwritev(apr_file_t *thefile,
+                                           const struct iovec *vec,
+                                           apr_size_t nvec, apr_size_t *nbytes,
+                                           apr_off_t offset)
+{
+    return file_pio(thefile, vec, nvec, nbytes, offset, 1);
+}
+
+APR_DECLARE(apr_status_t) apr_file_pread(apr_file_t *thefile, void *buf,
+                                         apr_size_t *nbytes, apr_off_t offset)
+{
+    struct iovec vec;
+
+    vec.iov_base = buf;
+    vec.iov_len = *nbytes;
+    return file_pio(thefile, &vec, 1, nbytes, offset, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwrite(apr_file_t *thefile,
+                                          const void *buf,
+                                          apr_size_t *nbytes,
+                                          apr_off_t offset)
+{
+    struct iovec vec;
+
+    vec.iov_base = (void *)buf;
+    vec.iov_len = *nbytes;
+    return file_pio(thefile, &vec, 1, nbytes, offset, 1);
+}
+
 APR_DECLARE(apr_status_t) apr_file_putc(char ch, apr_file_t *thefile)
 {
     apr_size_t nbytes = 1;
@@ -409,6 +502,15 @@ apr_status_t apr_file_check_read(apr_file_t *fd)
 
 
 
+APR_DECLARE(apr_status_t) apr_file_getline(apr_file_t *thefile,
+                                           const char **line,
+                                           apr_size_t *len)
+{
+    *line = NULL;
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_file_pipe_wait(apr_file_t *pipe, apr_wait_type_t direction)
 {
     int rc;
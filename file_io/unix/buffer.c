@@ -17,6 +17,91 @@
 #include "apr_arch_file_io.h"
 #include "apr_pools.h"
 #include "apr_thread_mutex.h"
+#include "apr_allocator.h"
+#include "apr_general.h"
+
+#if defined(HAVE_STATX) && defined(STATX_DIOALIGN)
+#define USE_STATX_DIOALIGN
+#endif
+
+typedef struct direct_buffer_t {
+    apr_allocator_t *allocator;
+    apr_memnode_t *node;
+} direct_buffer_t;
+
+static apr_status_t direct_buffer_cleanup(void *data)
+{
+    direct_buffer_t *b = data;
+
+    apr_allocator_free(b->allocator, b->node);
+    return APR_SUCCESS;
+}
+
+char *apr_unix_direct_buffer_alloc(apr_pool_t *pool, apr_size_t size,
+                                   apr_size_t align)
+{
+    apr_allocator_t *allocator = apr_pool_allocator_get(pool);
+    char *mem;
+
+    if (allocator) {
+        direct_buffer_t *b = apr_palloc(pool, sizeof(*b));
+
+        b->allocator = allocator;
+        b->node = apr_allocator_alloc(allocator, size + align);
+        if (!b->node) {
+            return NULL;
+        }
+        apr_pool_cleanup_register(pool, b, direct_buffer_cleanup,
+                                  apr_pool_cleanup_null);
+        mem = b->node->first_avail;
+    }
+    else {
+        mem = apr_palloc(pool, size + align);
+    }
+    return (char *)APR_ALIGN((apr_uintptr_t)mem, align);
+}
+
+apr_status_t apr_unix_file_direct_init(apr_file_t *thefile, int on)
+{
+    apr_size_t align = APR_FILE_DIRECT_ALIGN;
+#ifdef USE_STATX_DIOALIGN
+    struct statx stx;
+
+    if (statx(thefile->filedes, "", AT_EMPTY_PATH, STATX_DIOALIGN,
+              &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN)) {
+        if (!stx.stx_dio_offset_align) {
+            /* no direct I/O on this file */
+            return APR_ENOTIMPL;
+        }
+        align = stx.stx_dio_offset_align;
+        if (align < stx.stx_dio_mem_align) {
+            align = stx.stx_dio_mem_align;
+        }
+    }
+#endif
+#if defined(F_NOCACHE)
+    if (!on) {
+        if (fcntl(thefile->filedes, F_NOCACHE, 1) == -1) {
+            return errno;
+        }
+        on = 1;
+    }
+#endif
+    if (!on) {
+        return APR_ENOTIMPL;
+    }
+
+    thefile->buffer = apr_unix_direct_buffer_alloc(thefile->pool,
+                                                   APR_FILE_DIRECT_BUFSIZE,
+                                                   align);
+    if (!thefile->buffer) {
+        return APR_ENOMEM;
+    }
+    thefile->bufsize = APR_FILE_DIRECT_BUFSIZE;
+    thefile->direct_align = align;
+    thefile->direct_on = 1;
+    return APR_SUCCESS;
+}
 
 APR_DECLARE(apr_status_t) apr_file_buffer_set(apr_file_t *file, 
                                               char * buffer,
@@ -34,7 +119,25 @@ APR_DECLARE(apr_status_t) apr_file_buffer_set(apr_file_t *file,
             return rv;
         }
     }
-        
+
+    if (file->direct_align && bufsize) {
+        /* use the aligned part of the buffer */
+        char *aligned = (char *)APR_ALIGN((apr_uintptr_t)buffer,
+                                          file->direct_align);
+
+        if ((apr_size_t)(aligned - buffer) >= bufsize) {
+            file_unlock(file);
+            return APR_EINVAL;
+        }
+        bufsize -= aligned - buffer;
+        bufsize &= ~(file->direct_align - 1);
+        if (!bufsize) {
+            file_unlock(file);
+            return APR_EINVAL;
+        }
+        buffer = aligned;
+    }
+
     file->buffer = buffer;
     file->bufsize = bufsize;
     file->buffered = 1;
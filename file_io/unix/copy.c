@@ -16,17 +16,130 @@
 
 #include "apr_arch_file_io.h"
 #include "apr_file_io.h"
+#include "apr_portable.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if defined(HAVE_LINUX_FS_H) && APR_HAVE_SYS_IOCTL_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>           /* for FICLONE */
+#endif
+#if defined(__linux__) && APR_HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#define COPY_SENDFILE
+#endif
+#if defined(HAVE_FCOPYFILE) && defined(HAVE_COPYFILE_H)
+#include <copyfile.h>
+#endif
+
+/* the most the kernel is asked to move at a time */
+#define COPY_CHUNK (1 << 30)
+
+/* the buffer of copies through user space */
+#define COPY_BUFSIZ (256 * 1024)
+
+/*
+ * Have the kernel copy the data where it can, sharing the blocks of the
+ * source (reflink) if the file system allows, or moving them without a
+ * trip through user space.  Returns APR_ENOTIMPL when it can't, before
+ * anything was written, for the caller to copy them itself.
+ */
+static apr_status_t copy_in_kernel(apr_file_t *s, apr_file_t *d,
+                                   apr_int32_t flags, int clone)
+{
+#if defined(FICLONE) || defined(HAVE_COPY_FILE_RANGE) \
+    || defined(COPY_SENDFILE) || defined(HAVE_FCOPYFILE)
+    apr_os_file_t sfd, dfd;
+
+    apr_os_file_get(&sfd, s);
+    apr_os_file_get(&dfd, d);
+#endif
+
+#ifdef FICLONE
+    /* the whole file at once, only into an empty one then */
+    if (!(flags & APR_FOPEN_APPEND) && ioctl(dfd, FICLONE, sfd) == 0) {
+        return APR_SUCCESS;
+    }
+#endif
+    if (clone) {
+        return APR_ENOTIMPL;
+    }
+
+#ifdef HAVE_COPY_FILE_RANGE
+    {
+        /* may still share the blocks, or copy them on a remote server */
+        apr_ssize_t n;
+        int copied = 0;
+
+        for (;;) {
+            n = copy_file_range(sfd, NULL, dfd, NULL, COPY_CHUNK, 0);
+            if (n > 0) {
+                copied = 1;
+            }
+            else if (n == 0) {
+                if (copied) {
+                    return APR_SUCCESS;
+                }
+                /* or a file whose size is not known (procfs) */
+                break;
+            }
+            else if (errno != EINTR) {
+                if (copied) {
+                    return errno;
+                }
+                /* across file systems on older kernels, O_APPEND, ... */
+                break;
+            }
+        }
+    }
+#endif
+#ifdef COPY_SENDFILE
+    {
+        apr_ssize_t n;
+        int copied = 0;
+
+        for (;;) {
+            n = sendfile(dfd, sfd, NULL, COPY_CHUNK);
+            if (n > 0) {
+                copied = 1;
+            }
+            else if (n == 0) {
+                return APR_SUCCESS;
+            }
+            else if (errno != EINTR) {
+                if (copied) {
+                    return errno;
+                }
+                break;
+            }
+        }
+    }
+#endif
+#if defined(HAVE_FCOPYFILE) && defined(HAVE_COPYFILE_H)
+    if (!(flags & APR_FOPEN_APPEND)) {
+        if (fcopyfile(sfd, dfd, NULL, COPYFILE_DATA) == 0) {
+            return APR_SUCCESS;
+        }
+        return errno;
+    }
+#endif
+
+    return APR_ENOTIMPL;
+}
 
 static apr_status_t apr_file_transfer_contents(const char *from_path,
                                                const char *to_path,
                                                apr_int32_t flags,
                                                apr_fileperms_t to_perms,
+                                               int clone,
                                                apr_pool_t *pool)
 {
     apr_file_t *s, *d;
     apr_status_t status;
     apr_finfo_t finfo;
     apr_fileperms_t perms;
+    char *buf;
 
     /* Open source file. */
     status = apr_file_open(&s, from_path, APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, pool);
@@ -53,47 +166,55 @@ static apr_status_t apr_file_transfer_contents(const char *from_path,
         return status;
     }
 
-#if BUFSIZ > APR_FILE_DEFAULT_BUFSIZE
-#define COPY_BUFSIZ BUFSIZ
-#else
-#define COPY_BUFSIZ APR_FILE_DEFAULT_BUFSIZE
-#endif
+    status = copy_in_kernel(s, d, flags, clone);
+    if (status == APR_ENOTIMPL && !clone) {
+        buf = malloc(COPY_BUFSIZ);
+        status = buf ? APR_SUCCESS : APR_ENOMEM;
+    }
+    else {
+        buf = NULL;
+    }
 
     /* Copy bytes till the cows come home. */
-    while (1) {
-        char buf[COPY_BUFSIZ];
-        apr_size_t bytes_this_time = sizeof(buf);
+    while (buf) {
+        apr_size_t bytes_this_time = COPY_BUFSIZ;
         apr_status_t read_err;
         apr_status_t write_err;
 
         /* Read 'em. */
         read_err = apr_file_read(s, buf, &bytes_this_time);
         if (read_err && !APR_STATUS_IS_EOF(read_err)) {
-            apr_file_close(s);  /* toss any error */
-            apr_file_close(d);  /* toss any error */
-            return read_err;
+            status = read_err;
+            break;
         }
 
         /* Write 'em. */
         write_err = apr_file_write_full(d, buf, bytes_this_time, NULL);
         if (write_err) {
-            apr_file_close(s);  /* toss any error */
-            apr_file_close(d);  /* toss any error */
-            return write_err;
+            status = write_err;
+            break;
         }
 
         if (read_err && APR_STATUS_IS_EOF(read_err)) {
-            status = apr_file_close(s);
-            if (status) {
-                apr_file_close(d);  /* toss any error */
-                return status;
-            }
-
-            /* return the results of this close: an error, or success */
-            return apr_file_close(d);
+            break;
         }
     }
-    /* NOTREACHED */
+    free(buf);
+
+    if (status) {
+        apr_file_close(s);  /* toss any error */
+        apr_file_close(d);  /* toss any error */
+        return status;
+    }
+
+    status = apr_file_close(s);
+    if (status) {
+        apr_file_close(d);  /* toss any error */
+        return status;
+    }
+
+    /* return the results of this close: an error, or success */
+    return apr_file_close(d);
 }
 
 APR_DECLARE(apr_status_t) apr_file_copy(const char *from_path,
@@ -103,7 +224,7 @@ APR_DECLARE(apr_status_t) apr_file_copy(const char *from_path,
 {
     return apr_file_transfer_contents(from_path, to_path,
                                       (APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE),
-                                      perms,
+                                      perms, 0,
                                       pool);
 }
 
@@ -114,6 +235,21 @@ APR_DECLARE(apr_status_t) apr_file_append(const char *from_path,
 {
     return apr_file_transfer_contents(from_path, to_path,
                                       (APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_APPEND),
-                                      perms,
+                                      perms, 0,
+                                      pool);
+}
+
+APR_DECLARE(apr_status_t) apr_file_copy_ex(const char *from_path,
+                                           const char *to_path,
+                                           apr_fileperms_t perms,
+                                           apr_int32_t flags,
+                                           apr_pool_t *pool)
+{
+    return apr_file_transfer_contents(from_path, to_path,
+                                      APR_FOPEN_WRITE | APR_FOPEN_CREATE |
+                                      ((flags & APR_FILE_COPY_APPEND)
+                                       ? APR_FOPEN_APPEND
+                                       : APR_FOPEN_TRUNCATE),
+                                      perms, (flags & APR_FILE_COPY_CLONE),
                                       pool);
 }
@@ -23,11 +23,30 @@
 #if APR_HAVE_LIMITS_H
 #include <limits.h>
 #endif
+#if defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
+#include <sys/syscall.h>
+#endif
+#if defined(HAVE_STATX) && defined(HAVE_SYS_SYSMACROS_H)
+#include <sys/sysmacros.h>      /* for makedev() */
+#endif
 
 #ifndef NAME_MAX
 #define NAME_MAX 255
 #endif
 
+#if defined(__linux__) && defined(SYS_getdents64) && defined(DIRENT_TYPE)
+#define DIR_GETDENTS
+/* The kernel's record, which older libcs don't declare */
+struct dir_dirent64 {
+    apr_uint64_t d_ino;
+    apr_int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#define DIR_DENTS_SIZE (64 * 1024)
+#endif
+
 static apr_status_t dir_cleanup(void *thedir)
 {
     apr_dir_t *dir = thedir;
@@ -72,20 +91,16 @@ static char *path_remove_last_component (const char *path, apr_pool_t *pool)
     return apr_pstrndup (pool, path, (i < 0) ? 0 : i);
 }
 
-apr_status_t apr_dir_open(apr_dir_t **new, const char *dirname, 
-                          apr_pool_t *pool)
+static void dir_init(apr_dir_t **new, DIR *dir, const char *dirname,
+                     apr_pool_t *pool)
 {
-    DIR *dir = opendir(dirname);
-
-    if (!dir) {
-        return errno;
-    }
-
     (*new) = (apr_dir_t *)apr_palloc(pool, sizeof(apr_dir_t));
 
     (*new)->pool = pool;
     (*new)->dirname = apr_pstrdup(pool, dirname);
     (*new)->dirstruct = dir;
+    (*new)->dents = NULL;
+    (*new)->dents_pos = (*new)->dents_len = 0;
 
 #if APR_HAS_THREADS && defined(_POSIX_THREAD_SAFE_FUNCTIONS) \
                     && !defined(READDIR_IS_THREAD_SAFE)
@@ -103,8 +118,54 @@ apr_status_t apr_dir_open(apr_dir_t **new, const char *dirname,
 
     apr_pool_cleanup_register((*new)->pool, *new, dir_cleanup,
                               apr_pool_cleanup_null);
+}
+
+apr_status_t apr_dir_open(apr_dir_t **new, const char *dirname, 
+                          apr_pool_t *pool)
+{
+    DIR *dir = opendir(dirname);
+
+    if (!dir) {
+        return errno;
+    }
+
+    dir_init(new, dir, dirname, pool);
+    return APR_SUCCESS;
+}
+
+#ifdef DIR_OPENAT
+apr_status_t apr_unix_dir_openat(apr_dir_t **new, apr_dir_t *parent,
+                                 const char *name, const char *dirname,
+                                 apr_pool_t *pool)
+{
+    int oflags = O_RDONLY;
+    int fd;
+    DIR *dir;
+
+#ifdef O_DIRECTORY
+    oflags |= O_DIRECTORY;
+#endif
+#ifdef O_NOFOLLOW
+    oflags |= O_NOFOLLOW;
+#endif
+#ifdef O_CLOEXEC
+    oflags |= O_CLOEXEC;
+#endif
+    fd = openat(dirfd(parent->dirstruct), name, oflags);
+    if (fd < 0) {
+        return errno;
+    }
+    dir = fdopendir(fd);
+    if (!dir) {
+        apr_status_t rv = errno;
+        close(fd);
+        return rv;
+    }
+
+    dir_init(new, dir, dirname, pool);
     return APR_SUCCESS;
 }
+#endif
 
 apr_status_t apr_dir_close(apr_dir_t *thedir)
 {
@@ -288,9 +349,252 @@ apr_status_t apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
     return APR_SUCCESS;
 }
 
+#ifdef DIR_GETDENTS
+#ifdef HAVE_STATX
+static unsigned int statx_mask(apr_int32_t wanted)
+{
+    unsigned int mask = 0;
+
+    if (wanted & APR_FINFO_TYPE)
+        mask |= STATX_TYPE;
+    if (wanted & APR_FINFO_PROT)
+        mask |= STATX_MODE;
+    if (wanted & APR_FINFO_USER)
+        mask |= STATX_UID;
+    if (wanted & APR_FINFO_GROUP)
+        mask |= STATX_GID;
+    if (wanted & APR_FINFO_NLINK)
+        mask |= STATX_NLINK;
+    if (wanted & APR_FINFO_INODE)
+        mask |= STATX_INO;
+    if (wanted & APR_FINFO_SIZE)
+        mask |= STATX_SIZE;
+    if (wanted & APR_FINFO_CSIZE)
+        mask |= STATX_BLOCKS;
+    if (wanted & APR_FINFO_ATIME)
+        mask |= STATX_ATIME;
+    if (wanted & APR_FINFO_MTIME)
+        mask |= STATX_MTIME;
+    if (wanted & APR_FINFO_CTIME)
+        mask |= STATX_CTIME;
+    return mask;
+}
+
+static apr_time_t statx_time(const struct statx_timestamp *ts)
+{
+    apr_time_t t;
+
+    apr_time_ansi_put(&t, ts->tv_sec);
+    return t + ts->tv_nsec / APR_TIME_C(1000);
+}
+
+/* Only what the file system returned is valid */
+static void statx_to_finfo(apr_finfo_t *finfo, const struct statx *stx)
+{
+    unsigned int mask = stx->stx_mask;
+
+    finfo->valid = APR_FINFO_DEV;
+    finfo->device = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    if (mask & STATX_TYPE) {
+        finfo->filetype = filetype_from_dirent_type(IFTODT(stx->stx_mode));
+        finfo->valid |= APR_FINFO_TYPE;
+    }
+    if (mask & STATX_MODE) {
+        finfo->protection = apr_unix_mode2perms(stx->stx_mode);
+        finfo->valid |= APR_FINFO_PROT;
+    }
+    if (mask & STATX_UID) {
+        finfo->user = stx->stx_uid;
+        finfo->valid |= APR_FINFO_USER;
+    }
+    if (mask & STATX_GID) {
+        finfo->group = stx->stx_gid;
+        finfo->valid |= APR_FINFO_GROUP;
+    }
+    if (mask & STATX_NLINK) {
+        finfo->nlink = stx->stx_nlink;
+        finfo->valid |= APR_FINFO_NLINK;
+    }
+    if ((mask & STATX_INO)
+        && (sizeof(apr_ino_t) >= sizeof(stx->stx_ino)
+            || (apr_ino_t)stx->stx_ino == stx->stx_ino)) {
+        finfo->inode = stx->stx_ino;
+        finfo->valid |= APR_FINFO_INODE;
+    }
+    if (mask & STATX_SIZE) {
+        finfo->size = stx->stx_size;
+        finfo->valid |= APR_FINFO_SIZE;
+    }
+    if (mask & STATX_BLOCKS) {
+        /* always in 512 byte units here */
+        finfo->csize = (apr_off_t)stx->stx_blocks * 512;
+        finfo->valid |= APR_FINFO_CSIZE;
+    }
+    if (mask & STATX_ATIME) {
+        finfo->atime = statx_time(&stx->stx_atime);
+        finfo->valid |= APR_FINFO_ATIME;
+    }
+    if (mask & STATX_MTIME) {
+        finfo->mtime = statx_time(&stx->stx_mtime);
+        finfo->valid |= APR_FINFO_MTIME;
+    }
+    if (mask & STATX_CTIME) {
+        finfo->ctime = statx_time(&stx->stx_ctime);
+        finfo->valid |= APR_FINFO_CTIME;
+    }
+}
+#endif /* HAVE_STATX */
+
+/* Stat an entry as apr_stat(APR_FINFO_LINK) does, but relative to the
+ * directory's descriptor rather than by its rebuilt path.
+ */
+static apr_status_t dir_stat_entry(apr_finfo_t *finfo, apr_dir_t *thedir,
+                                   const char *name, apr_int32_t wanted)
+{
+#ifdef HAVE_STATX
+    struct statx stx;
+#endif
+#ifdef HAVE_FSTATAT
+    struct_stat info;
+#else
+    char fspec[APR_PATH_MAX];
+    char *end;
+    apr_status_t rv;
+#endif
+
+#ifdef HAVE_STATX
+    /* Asks the file system for the wanted fields only */
+    if (statx(dirfd(thedir->dirstruct), name,
+              AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+              statx_mask(wanted), &stx) == 0) {
+        statx_to_finfo(finfo, &stx);
+        return APR_SUCCESS;
+    }
+    if (errno != ENOSYS && errno != EPERM) {
+        return errno;
+    }
+#endif
+#ifdef HAVE_FSTATAT
+    if (fstatat(dirfd(thedir->dirstruct), name, &info,
+                AT_SYMLINK_NOFOLLOW) == 0) {
+        apr_unix_stat2finfo(finfo, &info, wanted);
+        return APR_SUCCESS;
+    }
+    return errno;
+#else
+    end = apr_cpystrn(fspec, thedir->dirname, sizeof fspec);
+    if (end > fspec && end[-1] != '/' && (end < fspec + APR_PATH_MAX))
+        *end++ = '/';
+    apr_cpystrn(end, name, sizeof fspec - (end - fspec));
+
+    rv = apr_stat(finfo, fspec, APR_FINFO_LINK | wanted, thedir->pool);
+    finfo->fname = NULL;
+    return (rv == APR_INCOMPLETE) ? APR_SUCCESS : rv;
+#endif
+}
+#endif /* DIR_GETDENTS */
+
+apr_status_t apr_dir_read_batch(apr_finfo_t *finfos, apr_size_t nelts,
+                                apr_size_t *nread, apr_int32_t wanted,
+                                apr_dir_t *thedir)
+{
+#ifdef DIR_GETDENTS
+    apr_status_t ret = APR_SUCCESS;
+    apr_size_t n = 0;
+
+    wanted &= ~APR_FINFO_NAME;
+
+    if (!thedir->dents) {
+        thedir->dents = apr_palloc(thedir->pool, DIR_DENTS_SIZE);
+    }
+
+    while (n < nelts) {
+        struct dir_dirent64 *ent;
+        apr_finfo_t *finfo;
+        apr_filetype_e type;
+        apr_int32_t need = wanted;
+
+        if (thedir->dents_pos >= thedir->dents_len) {
+            long len = syscall(SYS_getdents64, dirfd(thedir->dirstruct),
+                               thedir->dents, DIR_DENTS_SIZE);
+            if (len <= 0) {
+                /* An error after some entries shows on the next call */
+                if (!n) {
+                    ret = len ? errno : APR_ENOENT;
+                }
+                break;
+            }
+            thedir->dents_len = len;
+            thedir->dents_pos = 0;
+        }
+        ent = (struct dir_dirent64 *)(thedir->dents + thedir->dents_pos);
+        thedir->dents_pos += ent->d_reclen;
+
+        finfo = &finfos[n++];
+        finfo->pool = thedir->pool;
+        finfo->fname = NULL;
+        finfo->valid = 0;
+
+        type = filetype_from_dirent_type(ent->d_type);
+        if (type != APR_UNKFILE) {
+            need &= ~APR_FINFO_TYPE;
+        }
+        if (ent->d_ino && (apr_ino_t)ent->d_ino == ent->d_ino) {
+            need &= ~APR_FINFO_INODE;
+        }
+        if (need && dir_stat_entry(finfo, thedir, ent->d_name,
+                                   need) != APR_SUCCESS) {
+            /* as apr_dir_read(), only incomplete */
+            finfo->valid = 0;
+        }
+        if (type != APR_UNKFILE && !(finfo->valid & APR_FINFO_TYPE)) {
+            finfo->filetype = type;
+            finfo->valid |= APR_FINFO_TYPE;
+        }
+        if (ent->d_ino && (apr_ino_t)ent->d_ino == ent->d_ino
+            && !(finfo->valid & APR_FINFO_INODE)) {
+            finfo->inode = (apr_ino_t)ent->d_ino;
+            finfo->valid |= APR_FINFO_INODE;
+        }
+
+        finfo->name = apr_pstrdup(thedir->pool, ent->d_name);
+        finfo->valid |= APR_FINFO_NAME;
+
+        if (wanted & ~finfo->valid) {
+            ret = APR_INCOMPLETE;
+        }
+    }
+
+    *nread = n;
+    return ret;
+#else
+    apr_status_t rv, ret = APR_SUCCESS;
+    apr_size_t n;
+
+    for (n = 0; n < nelts; n++) {
+        rv = apr_dir_read(&finfos[n], wanted, thedir);
+        if (rv == APR_INCOMPLETE) {
+            ret = rv;
+        }
+        else if (rv != APR_SUCCESS) {
+            if (!n) {
+                ret = rv;
+            }
+            break;
+        }
+    }
+
+    *nread = n;
+    return ret;
+#endif
+}
+
 apr_status_t apr_dir_rewind(apr_dir_t *thedir)
 {
     rewinddir(thedir->dirstruct);
+#ifdef DIR_GETDENTS
+    thedir->dents_pos = thedir->dents_len = 0;
+#endif
     return APR_SUCCESS;
 }
 
@@ -0,0 +1,304 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_arch_file_io.h"
+#include "apr_file_io.h"
+#include "apr_strings.h"
+#include "apr_atomic.h"
+#include "apr_thread_pool.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+
+/* the entries read from a directory at a time */
+#define WALK_BATCH 64
+
+typedef struct walk_t {
+    apr_int32_t wanted;
+    int max_depth;
+    apr_int32_t flags;
+    apr_dir_walk_fn_t *fn;
+    void *baton;
+    /* the first error, which stops the walk */
+    volatile apr_uint32_t status;
+#if APR_HAS_THREADS
+    apr_thread_pool_t *tp;
+    apr_size_t nworkers;
+    /* the tasks' pools are made of this one, its allocator being locked */
+    apr_pool_t *pool;
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    apr_size_t pending;
+#endif
+} walk_t;
+
+#if APR_HAS_THREADS
+typedef struct walk_task_t {
+    walk_t *walk;
+    const char *path;
+    int depth;
+    apr_pool_t *pool;
+} walk_task_t;
+#endif
+
+static apr_status_t walk_subdir(walk_t *walk, apr_dir_t *parent,
+                                const char *name, const char *path,
+                                int depth, apr_pool_t *pool);
+
+static APR_INLINE int walk_stopped(walk_t *walk)
+{
+    return apr_atomic_read32(&walk->status) != 0;
+}
+
+static APR_INLINE void walk_fail(walk_t *walk, apr_status_t rv)
+{
+    apr_atomic_cas32(&walk->status, (apr_uint32_t)rv, 0);
+}
+
+#if APR_HAS_THREADS
+static void * APR_THREAD_FUNC walk_task(apr_thread_t *thd, void *data)
+{
+    walk_task_t *task = data;
+    walk_t *walk = task->walk;
+    apr_status_t rv;
+
+    if (!walk_stopped(walk)) {
+        rv = walk_subdir(walk, NULL, NULL, task->path, task->depth,
+                         task->pool);
+        if (rv != APR_SUCCESS) {
+            walk_fail(walk, rv);
+        }
+    }
+    apr_pool_destroy(task->pool);
+
+    apr_thread_mutex_lock(walk->mutex);
+    if (--walk->pending == 0) {
+        apr_thread_cond_broadcast(walk->cond);
+    }
+    apr_thread_mutex_unlock(walk->mutex);
+
+    return NULL;
+}
+
+/* Hand the directory to a worker if one is free, or return APR_EAGAIN */
+static apr_status_t walk_push(walk_t *walk, const char *path, int depth)
+{
+    walk_task_t *task;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(walk->mutex);
+    if (walk->pending >= walk->nworkers) {
+        apr_thread_mutex_unlock(walk->mutex);
+        return APR_EAGAIN;
+    }
+    walk->pending++;
+    apr_thread_mutex_unlock(walk->mutex);
+
+    rv = apr_pool_create(&pool, walk->pool);
+    if (rv == APR_SUCCESS) {
+        task = apr_palloc(pool, sizeof(*task));
+        task->walk = walk;
+        task->path = apr_pstrdup(pool, path);
+        task->depth = depth;
+        task->pool = pool;
+        rv = apr_thread_pool_push(walk->tp, walk_task, task,
+                                  APR_THREAD_TASK_PRIORITY_NORMAL, walk);
+        if (rv != APR_SUCCESS) {
+            apr_pool_destroy(pool);
+        }
+    }
+    if (rv != APR_SUCCESS) {
+        apr_thread_mutex_lock(walk->mutex);
+        walk->pending--;
+        apr_thread_mutex_unlock(walk->mutex);
+        return APR_EAGAIN;
+    }
+    return APR_SUCCESS;
+}
+#endif
+
+static apr_status_t walk_entry(walk_t *walk, apr_dir_t *dir,
+                               const char *path, apr_finfo_t *finfo,
+                               int depth, apr_pool_t *pool)
+{
+    const char *name = finfo->name;
+    const char *child;
+    apr_pool_t *subpool;
+    apr_status_t rv;
+    int prune = 0;
+
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) {
+        return APR_SUCCESS;
+    }
+
+    /* only the root may be "/" */
+    child = apr_pstrcat(pool, (path[0] == '/' && !path[1]) ? "" : path,
+                        "/", name, NULL);
+    rv = walk->fn(walk->baton, child, finfo, depth, &prune, pool);
+    if (rv != APR_SUCCESS) {
+        walk_fail(walk, rv);
+        return rv;
+    }
+    if (prune || !(finfo->valid & APR_FINFO_TYPE)
+        || finfo->filetype != APR_DIR
+        || (walk->max_depth >= 0 && depth >= walk->max_depth)) {
+        return APR_SUCCESS;
+    }
+
+#if APR_HAS_THREADS
+    if (walk->tp && walk_push(walk, child, depth + 1) == APR_SUCCESS) {
+        return APR_SUCCESS;
+    }
+#endif
+
+    rv = apr_pool_create(&subpool, pool);
+    if (rv == APR_SUCCESS) {
+        rv = walk_subdir(walk, dir, name, child, depth + 1, subpool);
+        apr_pool_destroy(subpool);
+    }
+    return rv;
+}
+
+/* Report the entries of a directory, and descend into its subdirectories
+ * inline or through the workers.  A directory which can't be read only
+ * fails the walk without APR_DIR_WALK_SKIP_ERRORS, unless it's the root.
+ */
+static apr_status_t walk_subdir(walk_t *walk, apr_dir_t *parent,
+                                const char *name, const char *path,
+                                int depth, apr_pool_t *pool)
+{
+    apr_finfo_t finfos[WALK_BATCH];
+    apr_dir_t *dir;
+    apr_pool_t *iterpool;
+    apr_size_t i, n;
+    apr_status_t rv;
+
+#ifdef DIR_OPENAT
+    if (parent) {
+        rv = apr_unix_dir_openat(&dir, parent, name, path, pool);
+    }
+    else
+#endif
+    rv = apr_dir_open(&dir, path, pool);
+    if (rv != APR_SUCCESS) {
+        return (depth && (walk->flags & APR_DIR_WALK_SKIP_ERRORS))
+               ? APR_SUCCESS : rv;
+    }
+
+    apr_pool_create(&iterpool, pool);
+    do {
+        rv = apr_dir_read_batch(finfos, WALK_BATCH, &n, walk->wanted, dir);
+        if (rv != APR_SUCCESS && rv != APR_INCOMPLETE) {
+            if (APR_STATUS_IS_ENOENT(rv)
+                || (depth && (walk->flags & APR_DIR_WALK_SKIP_ERRORS))) {
+                rv = APR_SUCCESS;
+            }
+            break;
+        }
+        rv = APR_SUCCESS;
+
+        apr_pool_clear(iterpool);
+        for (i = 0; i < n && rv == APR_SUCCESS; i++) {
+            rv = walk_entry(walk, dir, path, &finfos[i], depth, iterpool);
+        }
+    } while (rv == APR_SUCCESS && !walk_stopped(walk));
+    apr_pool_destroy(iterpool);
+
+    apr_dir_close(dir);
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_dir_walk(const char *root, apr_int32_t wanted,
+                                       int max_depth, apr_int32_t flags,
+                                       int nthreads, apr_dir_walk_fn_t *fn,
+                                       void *baton, apr_pool_t *pool)
+{
+    walk_t walk;
+    apr_size_t len;
+    apr_status_t rv;
+
+    memset(&walk, 0, sizeof(walk));
+    walk.wanted = wanted | APR_FINFO_TYPE;
+    walk.max_depth = max_depth;
+    walk.flags = flags;
+    walk.fn = fn;
+    walk.baton = baton;
+
+    /* "root/" would give "root//name" */
+    len = strlen(root);
+    while (len > 1 && root[len - 1] == '/') {
+        len--;
+    }
+    root = apr_pstrmemdup(pool, root, len);
+
+#if APR_HAS_THREADS
+    if (nthreads > 1) {
+        apr_allocator_t *allocator;
+        apr_thread_mutex_t *mutex;
+
+        rv = apr_allocator_create(&allocator);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        rv = apr_pool_create_ex(&walk.pool, pool, NULL, allocator);
+        if (rv != APR_SUCCESS) {
+            apr_allocator_destroy(allocator);
+            return rv;
+        }
+        apr_allocator_owner_set(allocator, walk.pool);
+        rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT,
+                                     walk.pool);
+        if (rv != APR_SUCCESS) {
+            apr_pool_destroy(walk.pool);
+            return rv;
+        }
+        apr_allocator_mutex_set(allocator, mutex);
+
+        if ((rv = apr_thread_mutex_create(&walk.mutex,
+                                          APR_THREAD_MUTEX_DEFAULT,
+                                          walk.pool)) != APR_SUCCESS
+            || (rv = apr_thread_cond_create(&walk.cond,
+                                            walk.pool)) != APR_SUCCESS
+            || (rv = apr_thread_pool_create(&walk.tp, nthreads - 1,
+                                            nthreads - 1,
+                                            walk.pool)) != APR_SUCCESS) {
+            apr_pool_destroy(walk.pool);
+            return rv;
+        }
+        walk.nworkers = nthreads - 1;
+    }
+#endif
+
+    /* The calling thread is a worker too */
+    rv = walk_subdir(&walk, NULL, NULL, root, 0, pool);
+    if (rv != APR_SUCCESS) {
+        walk_fail(&walk, rv);
+    }
+
+#if APR_HAS_THREADS
+    if (walk.tp) {
+        apr_thread_mutex_lock(walk.mutex);
+        while (walk.pending) {
+            apr_thread_cond_wait(walk.cond, walk.mutex);
+        }
+        apr_thread_mutex_unlock(walk.mutex);
+        apr_thread_pool_destroy(walk.tp);
+        apr_pool_destroy(walk.pool);
+    }
+#endif
+
+    return (apr_status_t)apr_atomic_read32(&walk.status);
+}
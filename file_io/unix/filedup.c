@@ -89,10 +89,21 @@ static apr_status_t file_dup(apr_file_t **new_file,
      * got one.
      */
     if ((*new_file)->buffered && !(*new_file)->buffer) {
-        (*new_file)->buffer = apr_palloc(p, old_file->bufsize);
+        if (old_file->direct_align) {
+            (*new_file)->buffer =
+                apr_unix_direct_buffer_alloc(p, old_file->bufsize,
+                                             old_file->direct_align);
+        }
+        else {
+            (*new_file)->buffer = apr_palloc(p, old_file->bufsize);
+        }
         (*new_file)->bufsize = old_file->bufsize;
     }
 
+    /* the descriptors share O_DIRECT */
+    (*new_file)->direct_align = old_file->direct_align;
+    (*new_file)->direct_on = old_file->direct_on;
+
     /* this is the way dup() works */
     (*new_file)->blocking = old_file->blocking; 
 
@@ -128,9 +139,10 @@ static apr_status_t file_dup(apr_file_t **new_file,
     (*new_file)->flags = old_file->flags
                        & ~(APR_INHERIT | APR_FOPEN_NOCLEANUP);
 
-    apr_pool_cleanup_register((*new_file)->pool, (void *)(*new_file),
-                              apr_unix_file_cleanup, 
-                              apr_unix_child_file_cleanup);
+    (*new_file)->cleanup =
+        apr_pool_cleanup_register_ex((*new_file)->pool, (void *)(*new_file),
+                                     apr_unix_file_cleanup,
+                                     apr_unix_child_file_cleanup);
 #ifndef WAITIO_USES_POLL
     /* Start out with no pollset.  apr_wait_for_io_or_timeout() will
      * initialize the pollset if needed.
@@ -159,7 +171,14 @@ APR_DECLARE(apr_status_t) apr_file_setaside(apr_file_t **new_file,
     *new_file = (apr_file_t *)apr_pmemdup(p, old_file, sizeof(apr_file_t));
     (*new_file)->pool = p;
     if (old_file->buffered) {
-        (*new_file)->buffer = apr_palloc(p, old_file->bufsize);
+        if (old_file->direct_align) {
+            (*new_file)->buffer =
+                apr_unix_direct_buffer_alloc(p, old_file->bufsize,
+                                             old_file->direct_align);
+        }
+        else {
+            (*new_file)->buffer = apr_palloc(p, old_file->bufsize);
+        }
         (*new_file)->bufsize = old_file->bufsize;
         if (old_file->direction == 1) {
             memcpy((*new_file)->buffer, old_file->buffer, old_file->bufpos);
@@ -179,13 +198,23 @@ APR_DECLARE(apr_status_t) apr_file_setaside(apr_file_t **new_file,
         (*new_file)->fname = apr_pstrdup(p, old_file->fname);
     }
     if (!(old_file->flags & APR_FOPEN_NOCLEANUP)) {
-        apr_pool_cleanup_kill(old_file->pool, (void *)old_file,
-                              apr_unix_file_cleanup);
-        apr_pool_cleanup_register(p, (void *)(*new_file), 
-                                  apr_unix_file_cleanup,
-                                  ((*new_file)->flags & APR_INHERIT)
-                                     ? apr_pool_cleanup_null
-                                     : apr_unix_child_file_cleanup);
+        if (old_file->cleanup) {
+            apr_pool_cleanup_kill_handle(old_file->pool, old_file->cleanup);
+            old_file->cleanup = NULL;
+        }
+        else {
+            apr_pool_cleanup_kill(old_file->pool, (void *)old_file,
+                                  apr_unix_file_cleanup);
+        }
+        (*new_file)->cleanup =
+            apr_pool_cleanup_register_ex(p, (void *)(*new_file),
+                                         apr_unix_file_cleanup,
+                                         ((*new_file)->flags & APR_INHERIT)
+                                            ? apr_pool_cleanup_null
+                                            : apr_unix_child_file_cleanup);
+    }
+    else {
+        (*new_file)->cleanup = NULL;
     }
 
     old_file->filedes = -1;
@@ -67,8 +67,8 @@ static apr_filetype_e filetype_from_mode(mode_t mode)
     return type;
 }
 
-static void fill_out_finfo(apr_finfo_t *finfo, struct_stat *info,
-                           apr_int32_t wanted)
+void apr_unix_stat2finfo(apr_finfo_t *finfo, struct_stat *info,
+                         apr_int32_t wanted)
 { 
     finfo->valid = APR_FINFO_MIN | APR_FINFO_IDENT | APR_FINFO_NLINK
                  | APR_FINFO_OWNER | APR_FINFO_PROT;
@@ -140,7 +140,7 @@ apr_status_t apr_file_info_get_locked(apr_finfo_t *finfo, apr_int32_t wanted,
     if (fstat(thefile->filedes, &info) == 0) {
         finfo->pool = thefile->pool;
         finfo->fname = thefile->fname;
-        fill_out_finfo(finfo, &info, wanted);
+        apr_unix_stat2finfo(finfo, &info, wanted);
         return (wanted & ~finfo->valid) ? APR_INCOMPLETE : APR_SUCCESS;
     }
     else {
@@ -163,7 +163,7 @@ APR_DECLARE(apr_status_t) apr_file_info_get(apr_finfo_t *finfo,
     if (fstat(thefile->filedes, &info) == 0) {
         finfo->pool = thefile->pool;
         finfo->fname = thefile->fname;
-        fill_out_finfo(finfo, &info, wanted);
+        apr_unix_stat2finfo(finfo, &info, wanted);
         return (wanted & ~finfo->valid) ? APR_INCOMPLETE : APR_SUCCESS;
     }
     else {
@@ -296,7 +296,7 @@ APR_DECLARE(apr_status_t) apr_stat(apr_finfo_t *finfo,
     if (srv == 0) {
         finfo->pool = pool;
         finfo->fname = fname;
-        fill_out_finfo(finfo, &info, wanted);
+        apr_unix_stat2finfo(finfo, &info, wanted);
         if (wanted & APR_FINFO_LINK)
             wanted &= ~APR_FINFO_LINK;
         return (wanted & ~finfo->valid) ? APR_INCOMPLETE : APR_SUCCESS;
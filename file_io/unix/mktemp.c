@@ -221,9 +221,10 @@ APR_DECLARE(apr_status_t) apr_file_mktemp(apr_file_t **fp, char *template, apr_i
             return errno;
 #endif
 
-        apr_pool_cleanup_register((*fp)->pool, (void *)(*fp),
-                                  apr_unix_file_cleanup,
-                                  apr_unix_child_file_cleanup);
+        (*fp)->cleanup =
+            apr_pool_cleanup_register_ex((*fp)->pool, (void *)(*fp),
+                                         apr_unix_file_cleanup,
+                                         apr_unix_child_file_cleanup);
 
         /* Clear APR_FOPEN_NOCLEANUP set by apr_os_file_put() */
         (*fp)->flags &= ~APR_FOPEN_NOCLEANUP;
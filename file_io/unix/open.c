@@ -144,6 +144,15 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
 #endif
     }
 
+    if (flag & APR_FOPEN_DIRECT) {
+#if defined(O_DIRECT)
+        oflags |= O_DIRECT;
+#elif !defined(F_NOCACHE)
+        return APR_ENOTIMPL;
+#endif
+        flag |= APR_FOPEN_BUFFERED;
+    }
+
 #ifdef O_CLOEXEC
     /* Introduced in Linux 2.6.23. Silently ignored on earlier Linux kernels.
      */
@@ -176,6 +185,19 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
     else {
         fd = open(fname, oflags, apr_unix_perms2mode(perm));
     } 
+#ifdef O_DIRECT
+    if (fd < 0 && errno == EINVAL && (oflags & O_DIRECT)) {
+        /* the file system can't do direct I/O; the file may have been
+         * created already, by us since O_EXCL did not fail */
+        oflags &= ~(O_DIRECT | O_EXCL);
+        if (perm == APR_FPROT_OS_DEFAULT) {
+            fd = open(fname, oflags, 0666);
+        }
+        else {
+            fd = open(fname, oflags, apr_unix_perms2mode(perm));
+        }
+    }
+#endif
     if (fd < 0) {
        return errno;
     }
@@ -216,13 +238,35 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
     (*new)->blocking = BLK_ON;
     (*new)->buffered = (flag & APR_FOPEN_BUFFERED) > 0;
 
-    if ((*new)->buffered) {
-        (*new)->buffer = apr_palloc(pool, APR_FILE_DEFAULT_BUFSIZE);
-        (*new)->bufsize = APR_FILE_DEFAULT_BUFSIZE;
+    if (flag & APR_FOPEN_DIRECT) {
+#ifdef O_DIRECT
+        rv = apr_unix_file_direct_init(*new, (oflags & O_DIRECT) != 0);
+#else
+        rv = apr_unix_file_direct_init(*new, 0);
+#endif
+        if (rv == APR_ENOTIMPL) {
+            /* not on this file system, go through the cache */
+#ifdef O_DIRECT
+            if ((oflags & O_DIRECT)
+                && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT) == -1) {
+                rv = errno;
+                close(fd);
+                return rv;
+            }
+#endif
+        }
+        else if (rv != APR_SUCCESS) {
+            close(fd);
+            return rv;
+        }
     }
-    else {
+    if (!(*new)->buffered) {
         (*new)->buffer = NULL;
     }
+    else if (!(*new)->direct_align) {
+        (*new)->buffer = apr_palloc(pool, APR_FILE_DEFAULT_BUFSIZE);
+        (*new)->bufsize = APR_FILE_DEFAULT_BUFSIZE;
+    }
 
 #if APR_HAS_THREADS
     (*new)->thlock = thlock;
@@ -243,9 +287,10 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
     (*new)->pollset = NULL;
 #endif
     if (!(flag & APR_FOPEN_NOCLEANUP)) {
-        apr_pool_cleanup_register((*new)->pool, (void *)(*new), 
-                                  apr_unix_file_cleanup, 
-                                  apr_unix_child_file_cleanup);
+        (*new)->cleanup =
+            apr_pool_cleanup_register_ex((*new)->pool, (void *)(*new),
+                                         apr_unix_file_cleanup,
+                                         apr_unix_child_file_cleanup);
     }
 
     if ((flag & APR_FOPEN_ROTATING) || (flag & APR_FOPEN_MANUAL_ROTATE)) {
@@ -278,6 +323,12 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new,
 
 APR_DECLARE(apr_status_t) apr_file_close(apr_file_t *file)
 {
+    apr_pool_cleanup_t *cleanup = file->cleanup;
+
+    if (cleanup) {
+        file->cleanup = NULL;
+        return apr_pool_cleanup_run_handle(file->pool, cleanup);
+    }
     return apr_pool_cleanup_run(file->pool, file, apr_unix_file_cleanup);
 }
 
@@ -19,6 +19,7 @@
 #include "apr_portable.h"
 
 #include "apr_arch_inherit.h"
+#include "apr_support.h"
 
 /* Figure out how to get pipe block/nonblock on BeOS...
  * Basically, BONE7 changed things again so that ioctl didn't work,
@@ -133,6 +134,95 @@ APR_DECLARE(apr_status_t) apr_file_pipe_timeout_get(apr_file_t *thepipe, apr_int
     return APR_EINVAL;
 }
 
+APR_DECLARE(apr_status_t) apr_file_pipe_size_set(apr_file_t *thepipe,
+                                                 apr_size_t size)
+{
+    if (thepipe->is_pipe != 1) {
+        return APR_EINVAL;
+    }
+#ifdef F_SETPIPE_SZ
+    if (size > INT_MAX) {
+        return APR_EINVAL;
+    }
+    if (fcntl(thepipe->filedes, F_SETPIPE_SZ, (int)size) == -1) {
+        return errno;
+    }
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_file_pipe_size_get(apr_file_t *thepipe,
+                                                 apr_size_t *size)
+{
+#ifdef F_GETPIPE_SZ
+    int rv;
+#endif
+
+    if (thepipe->is_pipe != 1) {
+        return APR_EINVAL;
+    }
+#ifdef F_GETPIPE_SZ
+    rv = fcntl(thepipe->filedes, F_GETPIPE_SZ);
+    if (rv == -1) {
+        return errno;
+    }
+    *size = rv;
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_file_pipe_write_gift(apr_file_t *thepipe,
+                                                   const void *buf,
+                                                   apr_size_t *nbytes)
+{
+#ifdef HAVE_VMSPLICE
+    struct iovec iov;
+    unsigned int flags = 0;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    apr_ssize_t rv;
+
+    /* what is buffered must go first */
+    if (thepipe->is_pipe != 1 || thepipe->buffered) {
+        return apr_file_write(thepipe, buf, nbytes);
+    }
+
+    /* only whole pages can be gifted, the others are just mapped */
+    if (pagesize > 0 && ((apr_uintptr_t)buf % pagesize) == 0
+            && (*nbytes % pagesize) == 0) {
+        flags = SPLICE_F_GIFT;
+    }
+    iov.iov_base = (void *)buf;
+    iov.iov_len = *nbytes;
+
+    do {
+        rv = vmsplice(thepipe->filedes, &iov, 1, flags);
+    } while (rv == -1 && errno == EINTR);
+    if (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)
+            && thepipe->timeout != 0) {
+        apr_status_t arv = apr_wait_for_io_or_timeout(thepipe, NULL, 0);
+        if (arv != APR_SUCCESS) {
+            *nbytes = 0;
+            return arv;
+        }
+        do {
+            rv = vmsplice(thepipe->filedes, &iov, 1, flags);
+        } while (rv == -1 && errno == EINTR);
+    }
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    return APR_SUCCESS;
+#else
+    return apr_file_write(thepipe, buf, nbytes);
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_os_pipe_put_ex(apr_file_t **file,
                                              apr_os_file_t *thefile,
                                              int register_cleanup,
@@ -156,9 +246,10 @@ APR_DECLARE(apr_status_t) apr_os_pipe_put_ex(apr_file_t **file,
     (*file)->thlock = NULL;
 #endif
     if (register_cleanup) {
-        apr_pool_cleanup_register((*file)->pool, (void *)(*file),
-                                  apr_unix_file_cleanup,
-                                  apr_pool_cleanup_null);
+        (*file)->cleanup =
+            apr_pool_cleanup_register_ex((*file)->pool, (void *)(*file),
+                                         apr_unix_file_cleanup,
+                                         apr_pool_cleanup_null);
     }
 #ifndef WAITIO_USES_POLL
     /* Start out with no pollset.  apr_wait_for_io_or_timeout() will
@@ -219,10 +310,13 @@ static apr_status_t file_pipe_create(apr_file_t **in,
 #ifndef WAITIO_USES_POLL
     (*out)->pollset = NULL;
 #endif
-    apr_pool_cleanup_register((*in)->pool, (void *)(*in), apr_unix_file_cleanup,
-                         apr_pool_cleanup_null);
-    apr_pool_cleanup_register((*out)->pool, (void *)(*out), apr_unix_file_cleanup,
-                         apr_pool_cleanup_null);
+    (*in)->cleanup = apr_pool_cleanup_register_ex((*in)->pool, (void *)(*in),
+                                                  apr_unix_file_cleanup,
+                                                  apr_pool_cleanup_null);
+    (*out)->cleanup = apr_pool_cleanup_register_ex((*out)->pool,
+                                                   (void *)(*out),
+                                                   apr_unix_file_cleanup,
+                                                   apr_pool_cleanup_null);
 
     switch (blocking) {
     case APR_FULL_BLOCK:
@@ -27,6 +27,106 @@
 #define USE_WAIT_FOR_IO
 #endif
 
+/* Set or clear O_DIRECT (F_NOCACHE) on an APR_FOPEN_DIRECT file */
+static void file_direct_set(apr_file_t *thefile, int on)
+{
+#if defined(O_DIRECT)
+    int flags = fcntl(thefile->filedes, F_GETFL);
+
+    if (flags == -1 || fcntl(thefile->filedes, F_SETFL,
+                             on ? flags | O_DIRECT
+                                : flags & ~O_DIRECT) == -1) {
+        return;
+    }
+#elif defined(F_NOCACHE)
+    if (fcntl(thefile->filedes, F_NOCACHE, on) == -1) {
+        return;
+    }
+#endif
+    thefile->direct_on = on;
+}
+
+/* Whether an I/O at the buffer, size and file offset (-1 if unknown) of
+ * an APR_FOPEN_DIRECT file can be direct, and set the file for it */
+static int file_direct_prepare(apr_file_t *thefile, const void *buf,
+                               apr_size_t len, apr_off_t offset)
+{
+    apr_uint64_t mask = thefile->direct_align - 1;
+    int aligned = !(((apr_uintptr_t)buf | (apr_uint64_t)len
+                     | (apr_uint64_t)(offset > 0 ? offset : 0)) & mask);
+
+    if (aligned != thefile->direct_on) {
+        file_direct_set(thefile, aligned);
+    }
+    return aligned;
+}
+
+/* Read or write an APR_FOPEN_DIRECT file, around the system's cache when
+ * aligned, through it otherwise (the tail of the file notably) */
+static apr_ssize_t file_direct_io(apr_file_t *thefile, void *buf,
+                                  apr_size_t len, apr_off_t offset,
+                                  int writing)
+{
+    int aligned = file_direct_prepare(thefile, buf, len, offset);
+    apr_ssize_t n;
+
+    for (;;) {
+        do {
+            n = writing ? write(thefile->filedes, buf, len)
+                        : read(thefile->filedes, buf, len);
+        } while (n == -1 && errno == EINTR);
+        if (n == -1 && errno == EINVAL && aligned) {
+            /* at an unaligned file offset */
+            file_direct_set(thefile, 0);
+            aligned = 0;
+            continue;
+        }
+        return n;
+    }
+}
+
+/* Drop the data of an APR_FOPEN_NOREUSE file from the system's cache by
+ * windows, len bytes having been read or written up to the file offset
+ * end (-1 if unknown) */
+static void file_noreuse(apr_file_t *thefile, apr_size_t len, apr_off_t end)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+    apr_off_t start;
+
+    thefile->noreuse_len += len;
+    if (thefile->noreuse_len < APR_FILE_NOREUSE_WINDOW) {
+        return;
+    }
+    if (end < 0 && (end = lseek(thefile->filedes, 0, SEEK_CUR)) == -1) {
+        thefile->noreuse_len = 0;
+        return;
+    }
+    start = end - (apr_off_t)thefile->noreuse_len;
+    if (start < 0) {
+        start = 0;
+    }
+
+    /* The clean pages of the window go now, the dirty ones are written
+     * back to go with the next window */
+    (void)posix_fadvise(thefile->filedes, start, end - start,
+                        POSIX_FADV_DONTNEED);
+    if (thefile->noreuse_prevlen) {
+        (void)posix_fadvise(thefile->filedes, thefile->noreuse_prev,
+                            thefile->noreuse_prevlen, POSIX_FADV_DONTNEED);
+    }
+    thefile->noreuse_prev = start;
+    thefile->noreuse_prevlen = (apr_size_t)(end - start);
+    thefile->noreuse_len = 0;
+#else
+    (void)thefile;
+    (void)len;
+    (void)end;
+#endif
+}
+
+/* The offset of a buffered file, unless writes go to its end */
+#define FILE_PTR(f) (((f)->flags & APR_FOPEN_APPEND) ? -1 : (f)->filePtr)
+
 static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
                                        apr_size_t *nbytes)
 {
@@ -54,8 +154,12 @@ static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
     }
     while (rv == 0 && size > 0) {
         if (thefile->bufpos >= thefile->dataRead) {
-            int bytesread = read(thefile->filedes, thefile->buffer, 
-                                 thefile->bufsize);
+            int bytesread = thefile->direct_align
+                            ? file_direct_io(thefile, thefile->buffer,
+                                             thefile->bufsize,
+                                             FILE_PTR(thefile), 0)
+                            : read(thefile->filedes, thefile->buffer,
+                                   thefile->bufsize);
             if (bytesread == 0) {
                 thefile->eof_hit = TRUE;
                 rv = APR_EOF;
@@ -68,6 +172,9 @@ static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
             thefile->dataRead = bytesread;
             thefile->filePtr += thefile->dataRead;
             thefile->bufpos = 0;
+            if (thefile->flags & APR_FOPEN_NOREUSE) {
+                file_noreuse(thefile, bytesread, FILE_PTR(thefile));
+            }
         }
 
         blocksize = size > thefile->dataRead - thefile->bufpos ? thefile->dataRead - thefile->bufpos : size;
@@ -115,7 +222,9 @@ APR_DECLARE(apr_status_t) apr_file_read(apr_file_t *thefile, void *buf, apr_size
         }
 
         do {
-            rv = read(thefile->filedes, buf, *nbytes);
+            rv = thefile->direct_align
+                 ? file_direct_io(thefile, buf, *nbytes, -1, 0)
+                 : read(thefile->filedes, buf, *nbytes);
         } while (rv == -1 && errno == EINTR);
 #ifdef USE_WAIT_FOR_IO
         if (rv == -1 && 
@@ -140,6 +249,9 @@ APR_DECLARE(apr_status_t) apr_file_read(apr_file_t *thefile, void *buf, apr_size
         }
         if (rv > 0) {
             *nbytes += rv;
+            if (thefile->flags & APR_FOPEN_NOREUSE) {
+                file_noreuse(thefile, rv, -1);
+            }
             return APR_SUCCESS;
         }
         return errno;
@@ -270,7 +382,9 @@ APR_DECLARE(apr_status_t) apr_file_write(apr_file_t *thefile, const void *buf, a
     }
     else {
         do {
-            rv = write(thefile->filedes, buf, *nbytes);
+            rv = thefile->direct_align
+                 ? file_direct_io(thefile, (void *)buf, *nbytes, -1, 1)
+                 : write(thefile->filedes, buf, *nbytes);
         } while (rv == (apr_size_t)-1 && errno == EINTR);
 #ifdef USE_WAIT_FOR_IO
         if (rv == (apr_size_t)-1 &&
@@ -304,6 +418,9 @@ APR_DECLARE(apr_status_t) apr_file_write(apr_file_t *thefile, const void *buf, a
             return errno;
         }
         *nbytes = rv;
+        if (thefile->flags & APR_FOPEN_NOREUSE) {
+            file_noreuse(thefile, rv, -1);
+        }
         return APR_SUCCESS;
     }
 }
@@ -312,9 +429,25 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
                                           apr_size_t nvec, apr_size_t *nbytes)
 {
 #ifdef HAVE_WRITEV
-    apr_status_t rv;
+    apr_status_t rv = APR_SUCCESS;
     apr_ssize_t bytes;
 
+    if (thefile->direct_align) {
+        /* through the aligned buffer, the vectors may not be */
+        apr_size_t i, len;
+
+        *nbytes = 0;
+        for (i = 0; i < nvec; i++) {
+            len = vec[i].iov_len;
+            rv = apr_file_write(thefile, vec[i].iov_base, &len);
+            *nbytes += len;
+            if (rv != APR_SUCCESS || !thefile->buffered) {
+                break;
+            }
+        }
+        return *nbytes ? APR_SUCCESS : rv;
+    }
+
     if (thefile->buffered) {
         file_lock(thefile);
 
@@ -374,6 +507,293 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
 #endif
 }
 
+APR_DECLARE(apr_status_t) apr_file_readv(apr_file_t *thefile,
+                                         const struct iovec *vec,
+                                         apr_size_t nvec, apr_size_t *nbytes)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t i, len;
+
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        *nbytes = 0;
+        return APR_EINVAL;
+    }
+
+    if (thefile->buffered) {
+        /* all from the buffer, in one go as far as other threads go */
+        *nbytes = 0;
+        file_lock(thefile);
+        for (i = 0; i < nvec; i++) {
+            len = vec[i].iov_len;
+            if (len == 0) {
+                continue;
+            }
+            rv = file_read_buffered(thefile, vec[i].iov_base, &len);
+            *nbytes += len;
+            if (rv != APR_SUCCESS || len < vec[i].iov_len) {
+                break;
+            }
+        }
+        file_unlock(thefile);
+        return *nbytes ? APR_SUCCESS : rv;
+    }
+
+#ifdef HAVE_READV
+    if (thefile->ungetchar == -1 && !thefile->direct_align) {
+        apr_ssize_t bytes;
+
+        for (len = 0, i = 0; i < nvec; i++) {
+            len += vec[i].iov_len;
+        }
+        do {
+            bytes = readv(thefile->filedes, vec, nvec);
+        } while (bytes == -1 && errno == EINTR);
+#ifdef USE_WAIT_FOR_IO
+        if (bytes == -1 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK) &&
+            thefile->timeout != 0) {
+            rv = apr_wait_for_io_or_timeout(thefile, NULL, 1);
+            if (rv != APR_SUCCESS) {
+                *nbytes = 0;
+                return rv;
+            }
+            do {
+                bytes = readv(thefile->filedes, vec, nvec);
+            } while (bytes == -1 && errno == EINTR);
+        }
+#endif
+        if (bytes < 0) {
+            *nbytes = 0;
+            return errno;
+        }
+        *nbytes = bytes;
+        if (bytes == 0 && len) {
+            thefile->eof_hit = TRUE;
+            return APR_EOF;
+        }
+        return APR_SUCCESS;
+    }
+#endif
+
+    /* As apr_file_writev() without writev(), only one read is done:
+     * that of the first buffer to fill.
+     */
+    for (i = 0; i < nvec; i++) {
+        if (vec[i].iov_len) {
+            *nbytes = vec[i].iov_len;
+            return apr_file_read(thefile, vec[i].iov_base, nbytes);
+        }
+    }
+    *nbytes = 0;
+    return APR_SUCCESS;
+}
+
+/*
+ * Positional reads and writes leave the file pointer alone, so on an
+ * unbuffered file they take no lock: threads sharing it each go their own
+ * offsets.  A buffered file has its pending writes flushed first, and its
+ * read buffer dropped before a write, for both views of it to agree.
+ */
+static apr_status_t file_buffer_settle(apr_file_t *thefile, int writing)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    file_lock(thefile);
+    if (thefile->direction == 1) {
+        rv = apr_file_flush_locked(thefile);
+    }
+    else if (writing && thefile->dataRead) {
+        apr_off_t offset = thefile->filePtr - thefile->dataRead +
+                           thefile->bufpos;
+
+        if (lseek(thefile->filedes, offset, SEEK_SET) == -1) {
+            rv = errno;
+        }
+        else {
+            thefile->filePtr = offset;
+            thefile->bufpos = thefile->dataRead = 0;
+        }
+    }
+    file_unlock(thefile);
+
+    return rv;
+}
+
+static apr_ssize_t file_pio(int fd, const struct iovec *vec, apr_size_t nvec,
+                            apr_off_t offset, int writing)
+{
+    apr_ssize_t n = 0;
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+    do {
+        n = writing ? pwritev(fd, vec, nvec, offset)
+                    : preadv(fd, vec, nvec, offset);
+    } while (n == -1 && errno == EINTR);
+    return n;
+#elif defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+    apr_ssize_t total = 0;
+    apr_size_t i;
+
+    for (i = 0; i < nvec; i++) {
+        do {
+            n = writing ? pwrite(fd, vec[i].iov_base, vec[i].iov_len,
+                                 offset + total)
+                        : pread(fd, vec[i].iov_base, vec[i].iov_len,
+                                offset + total);
+        } while (n == -1 && errno == EINTR);
+        if (n < 0) {
+            return total ? total : -1;
+        }
+        total += n;
+        if ((apr_size_t)n < vec[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+#else
+    /* no lock-free way to it: seek there and back */
+    apr_off_t cur = lseek(fd, 0, SEEK_CUR);
+    apr_ssize_t total = 0;
+    apr_size_t i;
+    int err;
+
+    if (cur == -1 || lseek(fd, offset, SEEK_SET) == -1) {
+        return -1;
+    }
+    for (i = 0; i < nvec; i++) {
+        do {
+            n = writing ? write(fd, vec[i].iov_base, vec[i].iov_len)
+                        : read(fd, vec[i].iov_base, vec[i].iov_len);
+        } while (n == -1 && errno == EINTR);
+        if (n < 0 || (total += n, (apr_size_t)n < vec[i].iov_len)) {
+            break;
+        }
+    }
+    err = errno;
+    lseek(fd, cur, SEEK_SET);
+    errno = err;
+    return (n < 0 && !total) ? -1 : total;
+#endif
+}
+
+/* Positional I/O of an APR_FOPEN_DIRECT file, under the file's lock since
+ * it changes the descriptor */
+static apr_ssize_t file_direct_pio(apr_file_t *thefile,
+                                   const struct iovec *vec, apr_size_t nvec,
+                                   apr_off_t offset, int writing)
+{
+    apr_uint64_t mask = thefile->direct_align - 1, bits;
+    apr_ssize_t n;
+    apr_size_t i;
+    int aligned;
+
+    bits = (apr_uint64_t)offset;
+    for (i = 0; i < nvec; i++) {
+        bits |= (apr_uintptr_t)vec[i].iov_base | (apr_uint64_t)vec[i].iov_len;
+    }
+    aligned = !(bits & mask);
+
+    file_lock(thefile);
+    if (aligned != thefile->direct_on) {
+        file_direct_set(thefile, aligned);
+    }
+    n = file_pio(thefile->filedes, vec, nvec, offset, writing);
+    if (n == -1 && errno == EINVAL && aligned) {
+        file_direct_set(thefile, 0);
+        n = file_pio(thefile->filedes, vec, nvec, offset, writing);
+    }
+    file_unlock(thefile);
+    return n;
+}
+
+APR_DECLARE(apr_status_t) apr_file_preadv(apr_file_t *thefile,
+                                          const struct iovec *vec,
+                                          apr_size_t nvec, apr_size_t *nbytes,
+                                          apr_off_t offset)
+{
+    apr_status_t rv;
+    apr_ssize_t bytes;
+    apr_size_t i, len;
+
+    *nbytes = 0;
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        return APR_EINVAL;
+    }
+    if (thefile->buffered && (rv = file_buffer_settle(thefile, 0))) {
+        return rv;
+    }
+
+    if (thefile->direct_align) {
+        bytes = file_direct_pio(thefile, vec, nvec, offset, 0);
+    }
+    else {
+        bytes = file_pio(thefile->filedes, vec, nvec, offset, 0);
+    }
+    if (bytes < 0) {
+        return errno;
+    }
+    *nbytes = bytes;
+    if (bytes == 0) {
+        for (len = 0, i = 0; i < nvec; i++) {
+            len += vec[i].iov_len;
+        }
+        if (len) {
+            return APR_EOF;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwritev(apr_file_t *thefile,
+                                           const struct iovec *vec,
+                                           apr_size_t nvec, apr_size_t *nbytes,
+                                           apr_off_t offset)
+{
+    apr_status_t rv;
+    apr_ssize_t bytes;
+
+    *nbytes = 0;
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        return APR_EINVAL;
+    }
+    if (thefile->buffered && (rv = file_buffer_settle(thefile, 1))) {
+        return rv;
+    }
+
+    if (thefile->direct_align) {
+        bytes = file_direct_pio(thefile, vec, nvec, offset, 1);
+    }
+    else {
+        bytes = file_pio(thefile->filedes, vec, nvec, offset, 1);
+    }
+    if (bytes < 0) {
+        return errno;
+    }
+    *nbytes = bytes;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pread(apr_file_t *thefile, void *buf,
+                                         apr_size_t *nbytes, apr_off_t offset)
+{
+    struct iovec vec;
+
+    vec.iov_base = buf;
+    vec.iov_len = *nbytes;
+    return apr_file_preadv(thefile, &vec, 1, nbytes, offset);
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwrite(apr_file_t *thefile,
+                                          const void *buf,
+                                          apr_size_t *nbytes,
+                                          apr_off_t offset)
+{
+    struct iovec vec;
+
+    vec.iov_base = (void *)buf;
+    vec.iov_len = *nbytes;
+    return apr_file_pwritev(thefile, &vec, 1, nbytes, offset);
+}
+
 APR_DECLARE(apr_status_t) apr_file_putc(char ch, apr_file_t *thefile)
 {
     apr_size_t nbytes = 1;
@@ -407,8 +827,17 @@ apr_status_t apr_file_flush_locked(apr_file_t *thefile)
         apr_ssize_t written = 0, ret;
 
         do {
-            ret = write(thefile->filedes, thefile->buffer + written,
-                        thefile->bufpos - written);
+            if (thefile->direct_align) {
+                apr_off_t offset = FILE_PTR(thefile);
+
+                ret = file_direct_io(thefile, thefile->buffer + written,
+                                     thefile->bufpos - written,
+                                     offset < 0 ? -1 : offset + written, 1);
+            }
+            else {
+                ret = write(thefile->filedes, thefile->buffer + written,
+                            thefile->bufpos - written);
+            }
             if (ret > 0)
                 written += ret;
         } while (written < thefile->bufpos &&
@@ -418,6 +847,9 @@ apr_status_t apr_file_flush_locked(apr_file_t *thefile)
         } else {
             thefile->filePtr += written;
             thefile->bufpos = 0;
+            if (thefile->flags & APR_FOPEN_NOREUSE) {
+                file_noreuse(thefile, written, FILE_PTR(thefile));
+            }
         }
     }
 
@@ -499,6 +931,51 @@ APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile)
     return rv;
 }
 
+/* Read a line from an unbuffered file, in chunks if it is seekable (and
+ * not shared between threads) then seeking back to the end of the line,
+ * else byte by byte so as not to read past it.
+ */
+static apr_status_t file_gets_unbuffered(apr_file_t *thefile, char **pstr,
+                                         char *final)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t nbytes, chunk = 1;
+    char *str = *pstr, *nl;
+
+    if (!thefile->is_pipe && !thefile->direct_align
+        && !(thefile->flags & APR_FOPEN_XTHREAD)
+        && lseek(thefile->filedes, 0, SEEK_CUR) != -1) {
+        chunk = APR_FILE_DEFAULT_BUFSIZE;
+    }
+
+    while (str < final) { /* leave room for trailing '\0' */
+        nbytes = final - str;
+        if (nbytes > chunk) {
+            nbytes = chunk;
+        }
+        /* An ungetc leftover may be read along with an error */
+        rv = apr_file_read(thefile, str, &nbytes);
+        nl = memchr(str, '\n', nbytes);
+        if (nl) {
+            apr_off_t excess = (str + nbytes) - (nl + 1);
+
+            if (excess && lseek(thefile->filedes, -excess, SEEK_CUR) == -1) {
+                /* the line is lost, report it as not read */
+                return errno;
+            }
+            str = nl + 1;
+            break;
+        }
+        str += nbytes;
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    *pstr = str;
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
 {
     apr_status_t rv = APR_SUCCESS; /* get rid of gcc warning */
@@ -534,36 +1011,39 @@ APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
             /* Force ungetc leftover to call apr_file_read. */
             if (thefile->bufpos < thefile->dataRead &&
                 thefile->ungetchar == -1) {
-                *str = thefile->buffer[thefile->bufpos++];
-            }
-            else {
-                nbytes = 1;
-                rv = file_read_buffered(thefile, str, &nbytes);
-                if (rv != APR_SUCCESS) {
+                const char *pos = thefile->buffer + thefile->bufpos;
+                const char *nl;
+
+                nbytes = thefile->dataRead - thefile->bufpos;
+                if (nbytes > (apr_size_t)(final - str)) {
+                    nbytes = final - str;
+                }
+                nl = memchr(pos, '\n', nbytes);
+                if (nl) {
+                    nbytes = nl + 1 - pos;
+                }
+                memcpy(str, pos, nbytes);
+                thefile->bufpos += nbytes;
+                str += nbytes;
+                if (nl) {
                     break;
                 }
+                continue;
             }
-            if (*str == '\n') {
-                ++str;
-                break;
-            }
-            ++str;
-        }
-        file_unlock(thefile);
-    }
-    else {
-        while (str < final) { /* leave room for trailing '\0' */
+
             nbytes = 1;
-            rv = apr_file_read(thefile, str, &nbytes);
+            rv = file_read_buffered(thefile, str, &nbytes);
             if (rv != APR_SUCCESS) {
                 break;
             }
-            if (*str == '\n') {
-                ++str;
+            if (*str++ == '\n') {
                 break;
             }
-            ++str;
         }
+        file_unlock(thefile);
+    }
+    else {
+        rv = file_gets_unbuffered(thefile, &str, final);
     }
 
     /* We must store a terminating '\0' if we've stored any chars. We can
@@ -579,6 +1059,115 @@ APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
     return rv;
 }
 
+/* Double the size of the buffer of a file, keeping the data read */
+static void file_buffer_grow(apr_file_t *thefile)
+{
+    apr_size_t size = thefile->bufsize * 2;
+    char *buffer = apr_palloc(thefile->pool, size);
+
+    memcpy(buffer, thefile->buffer, thefile->dataRead);
+    thefile->buffer = buffer;
+    thefile->bufsize = size;
+}
+
+APR_DECLARE(apr_status_t) apr_file_getline(apr_file_t *thefile,
+                                           const char **line,
+                                           apr_size_t *len)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t scanned = 0;
+
+    *line = NULL;
+    *len = 0;
+    if (!thefile->buffered || thefile->direct_align) {
+        return APR_EINVAL;
+    }
+
+    file_lock(thefile);
+
+    if (thefile->direction == 1) {
+        rv = apr_file_flush_locked(thefile);
+        if (rv) {
+            file_unlock(thefile);
+            return rv;
+        }
+        thefile->direction = 0;
+        thefile->bufpos = 0;
+        thefile->dataRead = 0;
+    }
+
+    /* Put an ungetc leftover back in the buffer, before the data */
+    if (thefile->ungetchar != -1) {
+        if (!thefile->bufpos) {
+            if (thefile->dataRead == thefile->bufsize) {
+                file_buffer_grow(thefile);
+            }
+            memmove(thefile->buffer + 1, thefile->buffer, thefile->dataRead);
+            thefile->dataRead++;
+            thefile->bufpos++;
+        }
+        thefile->buffer[--thefile->bufpos] = (char)thefile->ungetchar;
+        thefile->ungetchar = -1;
+    }
+
+    for (;;) {
+        char *start = thefile->buffer + thefile->bufpos;
+        apr_size_t avail = thefile->dataRead - thefile->bufpos;
+        const char *nl = memchr(start + scanned, '\n', avail - scanned);
+        int bytesread;
+
+        if (nl) {
+            *line = start;
+            *len = nl + 1 - start;
+            thefile->bufpos += *len;
+            break;
+        }
+        scanned = avail;
+
+        /* Make room for more of the line, at the start of the buffer
+         * or by growing it.
+         */
+        if (thefile->dataRead == thefile->bufsize) {
+            if (thefile->bufpos) {
+                memmove(thefile->buffer, start, avail);
+                thefile->bufpos = 0;
+                thefile->dataRead = avail;
+            }
+            else {
+                file_buffer_grow(thefile);
+            }
+        }
+
+        bytesread = read(thefile->filedes,
+                         thefile->buffer + thefile->dataRead,
+                         thefile->bufsize - thefile->dataRead);
+        if (bytesread == 0) {
+            thefile->eof_hit = TRUE;
+            if (!avail) {
+                rv = APR_EOF;
+                break;
+            }
+            /* the last line, with no newline */
+            *line = thefile->buffer + thefile->bufpos;
+            *len = avail;
+            thefile->bufpos = thefile->dataRead;
+            break;
+        }
+        else if (bytesread == -1) {
+            rv = errno;
+            break;
+        }
+        thefile->dataRead += bytesread;
+        thefile->filePtr += bytesread;
+        if (thefile->flags & APR_FOPEN_NOREUSE) {
+            file_noreuse(thefile, bytesread, FILE_PTR(thefile));
+        }
+    }
+
+    file_unlock(thefile);
+    return rv;
+}
+
 
 
 APR_DECLARE(apr_status_t) apr_file_pipe_wait(apr_file_t *thepipe, apr_wait_type_t direction)
@@ -273,7 +273,7 @@ APR_DECLARE(apr_status_t) apr_file_open(apr_file_t **new, const char *fname,
     apr_wchar_t wfname[APR_PATH_MAX];
 
 
-    if (flag & APR_FOPEN_NONBLOCK) {
+    if (flag & (APR_FOPEN_NONBLOCK | APR_FOPEN_DIRECT)) {
         return APR_ENOTIMPL;
     }
     if (flag & APR_FOPEN_READ) {
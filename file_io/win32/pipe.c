@@ -239,6 +239,25 @@ APR_DECLARE(apr_status_t) apr_file_namedpipe_create(const char *filename,
 }
 
 
+APR_DECLARE(apr_status_t) apr_file_pipe_size_set(apr_file_t *thepipe,
+                                                 apr_size_t size)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pipe_size_get(apr_file_t *thepipe,
+                                                 apr_size_t *size)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pipe_write_gift(apr_file_t *thepipe,
+                                                   const void *buf,
+                                                   apr_size_t *nbytes)
+{
+    return apr_file_write(thepipe, buf, nbytes);
+}
+
 /* XXX: Problem; we need to choose between blocking and nonblocking based
  * on how *thefile was opened, and we don't have that information :-/
  * Hack; assume a blocking socket, since the most common use for the fn
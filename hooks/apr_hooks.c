@@ -14,7 +14,6 @@
  * limitations under the License.
  */
 
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -23,6 +22,7 @@
 #include "apr.h"
 #include "apr_hooks.h"
 #include "apr_hash.h"
+#include "apr_strings.h"
 #include "apr_optional_hooks.h"
 #include "apr_optional.h"
 #define APR_WANT_MEMFUNC
@@ -36,6 +36,7 @@
 APR_DECLARE_DATA apr_pool_t *apr_hook_global_pool = NULL;
 APR_DECLARE_DATA int apr_hook_debug_enabled = 0;
 APR_DECLARE_DATA const char *apr_hook_debug_current = NULL;
+APR_DECLARE_DATA apr_uint32_t apr_optional_hook_generation = 1;
 
 /** @deprecated @see apr_hook_global_pool */
 APR_DECLARE_DATA apr_pool_t *apr_global_hook_pool = NULL;
@@ -56,14 +57,28 @@ typedef struct
     int nOrder;
 } TSortData;
 
-typedef struct tsort_
+/* A hook being sorted, its predecessors (those it names and those which
+ * name it as successor) in a list of edges, in the order they are found.
+ */
+typedef struct
 {
-    void *pData;
-    int nPredecessors;
-    struct tsort_ **ppPredecessors;
-    struct tsort_ *pNext;
+    TSortData *pData;
+    int nIndex;                 /* of registration */
+    int nFirstEdge;
+    int nLastEdge;
+    int nState;                 /* TSORT_* */
 } TSort;
 
+typedef struct
+{
+    int nPredecessor;
+    int nNext;
+} TSortEdge;
+
+#define TSORT_NEW     0
+#define TSORT_VISITED 1
+#define TSORT_PLACED  2
+
 #ifdef NETWARE
 #include "apr_private.h"
 #define get_apd                 APP_DATA* apd = (APP_DATA*)get_app_data(gLibId);
@@ -74,146 +89,159 @@ typedef struct tsort_
 
 static int crude_order(const void *a_,const void *b_)
 {
-    const TSortData *a=a_;
-    const TSortData *b=b_;
+    const TSort *a=a_;
+    const TSort *b=b_;
 
-    return a->nOrder-b->nOrder;
+    if(a->pData->nOrder != b->pData->nOrder)
+        return a->pData->nOrder < b->pData->nOrder ? -1 : 1;
+    /* keep the registration order, qsort() is not stable */
+    return a->nIndex-b->nIndex;
 }
 
-static TSort *prepare(apr_pool_t *p,TSortData *pItems,int nItems)
+static void add_edge(TSort *pData,TSortEdge *pEdges,int *pnEdges,
+                     int nItem,int nPredecessor)
+{
+    TSortEdge *pEdge=&pEdges[*pnEdges];
+
+    if(nItem == nPredecessor)
+        return;
+    pEdge->nPredecessor=nPredecessor;
+    pEdge->nNext=-1;
+    if(pData[nItem].nLastEdge < 0)
+        pData[nItem].nFirstEdge=*pnEdges;
+    else
+        pEdges[pData[nItem].nLastEdge].nNext=*pnEdges;
+    pData[nItem].nLastEdge=*pnEdges;
+    ++*pnEdges;
+}
+
+/* Order the items by nOrder, then link each to its predecessors, the
+ * names being interned into the items' indexes with a hash so that this
+ * is linear in the number of items and names.
+ */
+static TSort *prepare(apr_pool_t *p,TSortData *pItems,int nItems,
+                      TSortEdge **ppEdges)
 {
     TSort *pData=apr_palloc(p,nItems*sizeof *pData);
-    int n;
+    apr_hash_t *pNames=apr_hash_make(p);
+    TSortEdge *pEdges;
+    int *pnIndexes=apr_palloc(p,nItems*sizeof *pnIndexes);
+    int n,nEdges=0;
 
-    qsort(pItems,nItems,sizeof *pItems,crude_order);
     for(n=0 ; n < nItems ; ++n) {
-        pData[n].nPredecessors=0;
-        pData[n].ppPredecessors=apr_pcalloc(p,nItems*sizeof *pData[n].ppPredecessors);
-        pData[n].pNext=NULL;
+        int i;
+
         pData[n].pData=&pItems[n];
+        pData[n].nIndex=n;
+        pData[n].nFirstEdge=pData[n].nLastEdge=-1;
+        pData[n].nState=TSORT_NEW;
+        for(i=0 ; pItems[n].aszPredecessors && pItems[n].aszPredecessors[i] ; ++i)
+            ++nEdges;
+        for(i=0 ; pItems[n].aszSuccessors && pItems[n].aszSuccessors[i] ; ++i)
+            ++nEdges;
+    }
+    qsort(pData,nItems,sizeof *pData,crude_order);
+
+    /* a name stands for its first item */
+    for(n=nItems-1 ; n >= 0 ; --n) {
+        if(pData[n].pData->szName) {
+            pnIndexes[n]=n;
+            apr_hash_set(pNames,pData[n].pData->szName,APR_HASH_KEY_STRING,
+                         &pnIndexes[n]);
+        }
     }
 
+    pEdges=apr_palloc(p,(nEdges+1)*sizeof *pEdges);
+    nEdges=0;
     for(n=0 ; n < nItems ; ++n) {
-        int i,k;
-
-        for(i=0 ; pItems[n].aszPredecessors && pItems[n].aszPredecessors[i] ; ++i)
-            for(k=0 ; k < nItems ; ++k)
-                if(!strcmp(pItems[k].szName,pItems[n].aszPredecessors[i])) {
-                    int l;
-
-                    for(l=0 ; l < pData[n].nPredecessors ; ++l)
-                        if(pData[n].ppPredecessors[l] == &pData[k])
-                            goto got_it;
-                    pData[n].ppPredecessors[pData[n].nPredecessors]=&pData[k];
-                    ++pData[n].nPredecessors;
-                got_it:
-                    break;
-                }
-        for(i=0 ; pItems[n].aszSuccessors && pItems[n].aszSuccessors[i] ; ++i)
-            for(k=0 ; k < nItems ; ++k)
-                if(!strcmp(pItems[k].szName,pItems[n].aszSuccessors[i])) {
-                    int l;
-
-                    for(l=0 ; l < pData[k].nPredecessors ; ++l)
-                        if(pData[k].ppPredecessors[l] == &pData[n])
-                            goto got_it2;
-                    pData[k].ppPredecessors[pData[k].nPredecessors]=&pData[n];
-                    ++pData[k].nPredecessors;
-                got_it2:
-                    break;
-                }
+        const TSortData *pItem=pData[n].pData;
+        int i,*pk;
+
+        for(i=0 ; pItem->aszPredecessors && pItem->aszPredecessors[i] ; ++i)
+            if((pk=apr_hash_get(pNames,pItem->aszPredecessors[i],
+                                APR_HASH_KEY_STRING)))
+                add_edge(pData,pEdges,&nEdges,n,*pk);
+        for(i=0 ; pItem->aszSuccessors && pItem->aszSuccessors[i] ; ++i)
+            if((pk=apr_hash_get(pNames,pItem->aszSuccessors[i],
+                                APR_HASH_KEY_STRING)))
+                add_edge(pData,pEdges,&nEdges,*pk,n);
     }
 
+    *ppEdges=pEdges;
     return pData;
 }
 
-/* Topologically sort, dragging out-of-order items to the front. Note that
-   this tends to preserve things that want to be near the front better, and
-   changing that behaviour might compromise some of Apache's behaviour (in
-   particular, mod_log_forensic might otherwise get pushed to the end, and
-   core.c's log open function used to end up at the end when pushing items
-   to the back was the methedology). Also note that the algorithm could
-   go back to its original simplicity by sorting from the back instead of
-   the front.
+/* Topologically sort, dragging out-of-order items to the front: each item
+   in turn (by nOrder) is placed after its predecessors, recursively, the
+   first named first. Note that this tends to preserve things that want to
+   be near the front better, and changing that behaviour might compromise
+   some of Apache's behaviour (in particular, mod_log_forensic might
+   otherwise get pushed to the end, and core.c's log open function used to
+   end up at the end when pushing items to the back was the methedology).
+   This is a depth-first search, linear in the items and their links; a
+   loop is broken where it closes.
 */
-static TSort *tsort(TSort *pData,int nItems)
+static void tsort(apr_pool_t *p,TSort *pData,const TSortEdge *pEdges,
+                  int nItems,TSortData *pResult)
 {
-    int nTotal;
-    TSort *pHead=NULL;
-    TSort *pTail=NULL;
-
-    for(nTotal=0 ; nTotal < nItems ; ++nTotal) {
-        int n,i,k;
-
-        for(n=0 ; ; ++n) {
-            if(n == nItems)
-                assert(0);      /* we have a loop... */
-            if(!pData[n].pNext) {
-                if(pData[n].nPredecessors) {
-                    for(k=0 ; ; ++k) {
-                        assert(k < nItems);
-                        if(pData[n].ppPredecessors[k])
-                            break;
-                    }
-                    for(i=0 ; ; ++i) {
-                        assert(i < nItems);
-                        if(&pData[i] == pData[n].ppPredecessors[k]) {
-                            n=i-1;
-                            break;
-                        }
-                    }
-                } else
-                    break;
+    int *pnStack=apr_palloc(p,nItems*sizeof *pnStack);
+    int *pnCursor=apr_palloc(p,nItems*sizeof *pnCursor);
+    int n,nDepth,nPlaced=0;
+
+    for(n=0 ; n < nItems ; ++n) {
+        if(pData[n].nState != TSORT_NEW)
+            continue;
+        pData[n].nState=TSORT_VISITED;
+        pnStack[0]=n;
+        pnCursor[0]=pData[n].nFirstEdge;
+        nDepth=1;
+        while(nDepth) {
+            int nTop=pnStack[nDepth-1];
+            int e=pnCursor[nDepth-1];
+
+            while(e >= 0
+                  && pData[pEdges[e].nPredecessor].nState != TSORT_NEW)
+                e=pEdges[e].nNext;
+            if(e >= 0) {
+                int k=pEdges[e].nPredecessor;
+
+                pnCursor[nDepth-1]=pEdges[e].nNext;
+                pData[k].nState=TSORT_VISITED;
+                pnStack[nDepth]=k;
+                pnCursor[nDepth]=pData[k].nFirstEdge;
+                ++nDepth;
+            }
+            else {
+                pData[nTop].nState=TSORT_PLACED;
+                memcpy(&pResult[nPlaced++],pData[nTop].pData,sizeof *pResult);
+                --nDepth;
             }
         }
-        if(pTail)
-            pTail->pNext=&pData[n];
-        else
-            pHead=&pData[n];
-        pTail=&pData[n];
-        pTail->pNext=pTail;     /* fudge it so it looks linked */
-        for(i=0 ; i < nItems ; ++i)
-            for(k=0 ; k < nItems ; ++k)
-                if(pData[i].ppPredecessors[k] == &pData[n]) {
-                    --pData[i].nPredecessors;
-                    pData[i].ppPredecessors[k]=NULL;
-                    break;
-                }
     }
-    if(pTail)
-        pTail->pNext=NULL;  /* unfudge the tail */
-    return pHead;
 }
 
-static apr_array_header_t *sort_hook(apr_array_header_t *pHooks,
-                                     const char *szName)
+/* Sort the hooks in place */
+static void sort_hook(apr_array_header_t *pHooks,const char *szName)
 {
     apr_pool_t *p;
     TSort *pSort;
-    apr_array_header_t *pNew;
+    TSortEdge *pEdges;
+    TSortData *pItems;
     int n;
 
     apr_pool_create(&p, apr_hook_global_pool);
-    pSort=prepare(p,(TSortData *)pHooks->elts,pHooks->nelts);
-    pSort=tsort(pSort,pHooks->nelts);
-    pNew=apr_array_make(apr_hook_global_pool,pHooks->nelts,sizeof(TSortData));
-    if(apr_hook_debug_enabled)
+    pItems=apr_pmemdup(p,pHooks->elts,pHooks->nelts*sizeof *pItems);
+    pSort=prepare(p,pItems,pHooks->nelts,&pEdges);
+    tsort(p,pSort,pEdges,pHooks->nelts,(TSortData *)pHooks->elts);
+    if(apr_hook_debug_enabled) {
         printf("Sorting %s:",szName);
-    for(n=0 ; pSort ; pSort=pSort->pNext,++n) {
-        TSortData *pHook;
-        assert(n < pHooks->nelts);
-        pHook=apr_array_push(pNew);
-        memcpy(pHook,pSort->pData,sizeof *pHook);
-        if(apr_hook_debug_enabled)
-            printf(" %s",pHook->szName);
-    }
-    if(apr_hook_debug_enabled)
+        for(n=0 ; n < pHooks->nelts ; ++n)
+            printf(" %s",((TSortData *)pHooks->elts)[n].szName);
         fputc('\n',stdout);
+    }
 
     /* destroy the pool - the sorted hooks were already copied */
     apr_pool_destroy(p);
-
-    return pNew;
 }
 
 #ifndef NETWARE
@@ -224,10 +252,13 @@ typedef struct
 {
     const char *szHookName;
     apr_array_header_t **paHooks;
+    apr_hook_fn_t * const **paTable;
+    int nSorted;                /* number of hooks at the last sort */
 } HookSortEntry;
 
-APR_DECLARE(void) apr_hook_sort_register(const char *szHookName,
-                                        apr_array_header_t **paHooks)
+APR_DECLARE(void) apr_hook_sort_register_ex(const char *szHookName,
+                                            apr_array_header_t **paHooks,
+                                            apr_hook_fn_t * const **paTable)
 {
 #ifdef NETWARE
     get_apd
@@ -239,6 +270,31 @@ APR_DECLARE(void) apr_hook_sort_register(const char *szHookName,
     pEntry=apr_array_push(s_aHooksToSort);
     pEntry->szHookName=szHookName;
     pEntry->paHooks=paHooks;
+    pEntry->paTable=paTable;
+    pEntry->nSorted=-1;
+}
+
+APR_DECLARE(void) apr_hook_sort_register(const char *szHookName,
+                                        apr_array_header_t **paHooks)
+{
+    apr_hook_sort_register_ex(szHookName,paHooks,NULL);
+}
+
+/* Compile the sorted functions of a hook into its dispatch table, which
+ * the run functions walk instead of the (five times larger) links.
+ */
+static apr_hook_fn_t * const *build_table(apr_array_header_t *pHooks)
+{
+    apr_hook_fn_t **pTable;
+    int n;
+
+    pTable=apr_palloc(apr_hook_global_pool,
+                      (pHooks->nelts+1)*sizeof *pTable);
+    for(n=0 ; n < pHooks->nelts ; ++n)
+        pTable[n]=(apr_hook_fn_t *)((TSortData *)pHooks->elts)[n].dummy;
+    pTable[n]=NULL;
+
+    return pTable;
 }
 
 APR_DECLARE(void) apr_hook_sort_all(void)
@@ -254,8 +310,23 @@ APR_DECLARE(void) apr_hook_sort_all(void)
 
     for(n=0 ; n < s_aHooksToSort->nelts ; ++n) {
         HookSortEntry *pEntry=&((HookSortEntry *)s_aHooksToSort->elts)[n];
-        *pEntry->paHooks=sort_hook(*pEntry->paHooks,pEntry->szHookName);
+        apr_array_header_t *pHooks=*pEntry->paHooks;
+
+        /* Hooks only ever get appended, so only the hooks which got some
+         * since their last sort (a late module) need to be sorted again.
+         */
+        if(!pHooks)
+            continue;
+        if(pHooks->nelts != pEntry->nSorted) {
+            sort_hook(pHooks,pEntry->szHookName);
+            pEntry->nSorted=pHooks->nelts;
+            if(pEntry->paTable)
+                *pEntry->paTable=NULL;
+        }
+        if(pEntry->paTable && !*pEntry->paTable)
+            *pEntry->paTable=build_table(pHooks);
     }
+    ++apr_optional_hook_generation;
 }
 
 #ifndef NETWARE
@@ -277,7 +348,10 @@ APR_DECLARE(void) apr_hook_deregister_all(void)
     for(n=0 ; n < s_aHooksToSort->nelts ; ++n) {
         HookSortEntry *pEntry=&((HookSortEntry *)s_aHooksToSort->elts)[n];
         *pEntry->paHooks=NULL;
+        if(pEntry->paTable)
+            *pEntry->paTable=NULL;
     }
+    ++apr_optional_hook_generation;
     s_aHooksToSort=NULL;
     s_phOptionalHooks=NULL;
     s_phOptionalFunctions=NULL;
@@ -321,19 +395,39 @@ APR_DECLARE(void) apr_hook_debug_show(const char *szName,
 
 APR_DECLARE_EXTERNAL_HOOK(apr,APR,void,_optional,(void))
 
-APR_DECLARE(apr_array_header_t *) apr_optional_hook_get(const char *szName)
+typedef struct
+{
+    apr_array_header_t *pArray;
+    apr_hook_fn_t * const *pTable;
+} OptionalHook;
+
+static OptionalHook *optional_hook_get(const char *szName)
 {
 #ifdef NETWARE
     get_apd
 #endif
-    apr_array_header_t **ppArray;
 
     if(!s_phOptionalHooks)
         return NULL;
-    ppArray=apr_hash_get(s_phOptionalHooks,szName,strlen(szName));
-    if(!ppArray)
+    return apr_hash_get(s_phOptionalHooks,szName,strlen(szName));
+}
+
+APR_DECLARE(apr_array_header_t *) apr_optional_hook_get(const char *szName)
+{
+    OptionalHook *pOptional=optional_hook_get(szName);
+
+    if(!pOptional)
+        return NULL;
+    return pOptional->pArray;
+}
+
+APR_DECLARE(apr_hook_fn_t * const *) apr_optional_hook_table_get(const char *szName)
+{
+    OptionalHook *pOptional=optional_hook_get(szName);
+
+    if(!pOptional)
         return NULL;
-    return *ppArray;
+    return pOptional->pTable;
 }
 
 APR_DECLARE(void) apr_optional_hook_add(const char *szName,void (*pfn)(void),
@@ -343,22 +437,23 @@ APR_DECLARE(void) apr_optional_hook_add(const char *szName,void (*pfn)(void),
 #ifdef NETWARE
     get_apd
 #endif
-    apr_array_header_t *pArray=apr_optional_hook_get(szName);
+    OptionalHook *pOptional=optional_hook_get(szName);
     apr_LINK__optional_t *pHook;
 
-    if(!pArray) {
-        apr_array_header_t **ppArray;
-
-        pArray=apr_array_make(apr_hook_global_pool,1,
-                              sizeof(apr_LINK__optional_t));
+    if(!pOptional) {
+        pOptional=apr_palloc(apr_hook_global_pool,sizeof *pOptional);
+        pOptional->pArray=apr_array_make(apr_hook_global_pool,1,
+                                         sizeof(apr_LINK__optional_t));
         if(!s_phOptionalHooks)
             s_phOptionalHooks=apr_hash_make(apr_hook_global_pool);
-        ppArray=apr_palloc(apr_hook_global_pool,sizeof *ppArray);
-        *ppArray=pArray;
-        apr_hash_set(s_phOptionalHooks,szName,strlen(szName),ppArray);
-        apr_hook_sort_register(szName,ppArray);
+        apr_hash_set(s_phOptionalHooks,szName,strlen(szName),pOptional);
+        apr_hook_sort_register_ex(szName,&pOptional->pArray,
+                                  &pOptional->pTable);
     }
-    pHook=apr_array_push(pArray);
+    /* Run unsorted from the array until the next sort */
+    pOptional->pTable=NULL;
+    ++apr_optional_hook_generation;
+    pHook=apr_array_push(pOptional->pArray);
     pHook->pFunc=pfn;
     pHook->aszPredecessors=aszPre;
     pHook->aszSuccessors=aszSucc;
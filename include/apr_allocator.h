@@ -66,6 +66,17 @@ struct apr_memnode_t {
 /** Symbolic constants */
 #define APR_ALLOCATOR_MAX_FREE_UNLIMITED 0
 
+/**
+ * @defgroup apr_allocator_flags Allocator creation flags
+ * @{
+ */
+/** Keep per-thread caches of free memnodes in front of the allocator's
+ * (mutex protected) free lists.
+ * @see apr_allocator_create_ex()
+ */
+#define APR_ALLOCATOR_THREAD_CACHE 0x01
+/** @} */
+
 /**
  * Create a new allocator
  * @param allocator The allocator we have just created.
@@ -74,6 +85,25 @@ struct apr_memnode_t {
 APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
                           __attribute__((nonnull(1)));
 
+/**
+ * Create a new allocator with the given flags
+ * @param allocator The allocator we have just created.
+ * @param flags A bitmask of APR_ALLOCATOR_* flags, or zero.
+ * @return APR_SUCCESS, APR_ENOMEM, or APR_ENOTIMPL if one of the
+ *         @a flags is not supported on this platform.
+ * @remark With APR_ALLOCATOR_THREAD_CACHE, each thread allocating from or
+ *         freeing to the allocator keeps a small cache of the smallest
+ *         free memnodes which it takes and returns without locking. The
+ *         allocator's free lists (and mutex) are only used to refill or
+ *         drain these caches in batches. Memnodes held by the thread
+ *         caches are not accounted in apr_allocator_max_free_set(), and
+ *         are given back only when the allocator is destroyed, so this is
+ *         meant for allocators shared by long-lived threads.
+ */
+APR_DECLARE(apr_status_t) apr_allocator_create_ex(apr_allocator_t **allocator,
+                                                  apr_uint32_t flags)
+                          __attribute__((nonnull(1)));
+
 /**
  * Destroy an allocator
  * @param allocator The allocator to be destroyed
@@ -163,6 +193,103 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
                                              apr_size_t size)
                   __attribute__((nonnull(1)));
 
+/** Allocator statistics, see apr_allocator_stats_get() */
+typedef struct apr_allocator_stats_t {
+    /** Number of memnodes obtained from the system */
+    apr_uint64_t nodes_alloc;
+    /** Number of memnodes given back to the system */
+    apr_uint64_t nodes_released;
+    /** Number of allocations served with a recycled (free) memnode */
+    apr_uint64_t nodes_recycled;
+    /** Size of the memnodes currently obtained from the system */
+    apr_size_t   bytes_footprint;
+    /** Highest bytes_footprint so far */
+    apr_size_t   bytes_peak;
+    /** Size of the free memnodes currently held by the allocator */
+    apr_size_t   bytes_free;
+} apr_allocator_stats_t;
+
+/**
+ * Get the statistics of the allocator
+ * @param allocator The allocator
+ * @param stats The statistics to fill in
+ * @remark This helps sizing apr_allocator_max_free_set() since
+ *         bytes_free is the memory that could be given back.
+ * @remark With APR_ALLOCATOR_THREAD_CACHE, the memnodes held by the
+ *         thread caches are read without synchronization and thus
+ *         nodes_recycled and bytes_free may be slightly off.
+ */
+APR_DECLARE(void) apr_allocator_stats_get(apr_allocator_t *allocator,
+                                          apr_allocator_stats_t *stats)
+                  __attribute__((nonnull(1,2)));
+
+/** Make apr_allocator_trim() give back all the free memnodes */
+#define APR_ALLOCATOR_TRIM_ALL 0x01
+
+/**
+ * Give back to the system the free memnodes of the allocator which have
+ * not been used since the previous call
+ * @param allocator The allocator
+ * @param flags Zero or APR_ALLOCATOR_TRIM_ALL
+ * @return The size of the memory given back
+ * @remark Meant to be called periodically (e.g. every few seconds by a
+ *         maintenance thread), it releases half of the memnodes of each
+ *         size which stayed free since the previous call, so that the
+ *         memory kept after a peak decays over a few calls while the
+ *         sizes in use keep theirs.  This is a cheaper alternative to
+ *         apr_allocator_max_free_set(), which releases the memnodes
+ *         exceeding its threshold synchronously when they are freed.
+ * @remark The memnodes carved from a region stay in the allocator, only
+ *         their memory (but the first page) is given back with
+ *         madvise(), unless the region uses huge pages.  The memnodes
+ *         held by the thread caches or for recycled subpools are kept.
+ */
+APR_DECLARE(apr_size_t) apr_allocator_trim(apr_allocator_t *allocator,
+                                           apr_uint32_t flags)
+                        __attribute__((nonnull(1)));
+
+/**
+ * @defgroup apr_allocator_region_flags Allocator region flags
+ * @{
+ */
+/** Back the regions with (default sized) huge pages, or ask for
+ * transparent huge pages if none are available */
+#define APR_ALLOCATOR_REGION_HUGEPAGES    0x01
+/** Back the regions with 1 GiB huge pages */
+#define APR_ALLOCATOR_REGION_HUGEPAGES_1G 0x02
+/** @} */
+
+/** No NUMA binding for apr_allocator_region_set() */
+#define APR_ALLOCATOR_NUMA_NODE_ANY (-1)
+
+/**
+ * Make the allocator carve its new memnodes from large regions of
+ * memory rather than allocating them one at a time from the system.
+ * @param allocator The allocator
+ * @param size The size of each region, rounded up to the (huge) page
+ *        size, or zero to stop using regions for the next allocations.
+ * @param flags A bitmask of APR_ALLOCATOR_REGION_* flags, or zero
+ * @param numa_node The NUMA node to bind the regions memory to, or
+ *        APR_ALLOCATOR_NUMA_NODE_ANY.
+ * @return APR_SUCCESS, APR_ENOTIMPL if regions (or NUMA binding) are not
+ *         supported on this platform, or the error encountered while
+ *         mapping or binding the first region.
+ * @remark The first region is mapped by this call, the next ones when the
+ *         current region is exhausted.  Memnodes larger than the region
+ *         size are still allocated individually.
+ * @remark Memnodes carved from a region are never given back to the
+ *         system before the allocator is destroyed, regardless of
+ *         apr_allocator_max_free_set(); apr_allocator_trim() only gives
+ *         back their memory.
+ * @remark Should be done at initialization time, before the allocator
+ *         is used concurrently.
+ */
+APR_DECLARE(apr_status_t) apr_allocator_region_set(apr_allocator_t *allocator,
+                                                   apr_size_t size,
+                                                   apr_uint32_t flags,
+                                                   int numa_node)
+                          __attribute__((nonnull(1)));
+
 #include "apr_thread_mutex.h"
 
 #if APR_HAS_THREADS
@@ -46,6 +46,20 @@ extern "C" {
  */
 APR_DECLARE(apr_status_t) apr_atomic_init(apr_pool_t *p);
 
+/**
+ * The memory orders of the *_explicit() operations, as defined by C11.
+ * @remark An order which does not apply to an operation (e.g. releasing
+ *         a load) is strengthened to APR_ATOMIC_SEQ_CST, and platforms
+ *         lacking the weaker orders implement them as APR_ATOMIC_SEQ_CST.
+ */
+typedef enum {
+    APR_ATOMIC_RELAXED, /**< atomicity only, no ordering */
+    APR_ATOMIC_ACQUIRE, /**< later accesses are not reordered before a load */
+    APR_ATOMIC_RELEASE, /**< prior accesses are not reordered after a store */
+    APR_ATOMIC_ACQ_REL, /**< both, for read-modify-write operations */
+    APR_ATOMIC_SEQ_CST  /**< a single total order, as the other functions */
+} apr_atomic_order_e;
+
 /*
  * Atomic operations on 32-bit values
  * Note: Each of these functions internally implements a memory barrier
@@ -113,6 +127,49 @@ APR_DECLARE(apr_uint32_t) apr_atomic_cas32(volatile apr_uint32_t *mem, apr_uint3
  */
 APR_DECLARE(apr_uint32_t) apr_atomic_xchg32(volatile apr_uint32_t *mem, apr_uint32_t val);
 
+/**
+ * atomically OR 'val' into an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val bits to set
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_or32(volatile apr_uint32_t *mem, apr_uint32_t val);
+
+/**
+ * atomically AND 'val' into an apr_uint32_t
+ * @param mem pointer to the object
+ * @param val bits to keep
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_and32(volatile apr_uint32_t *mem, apr_uint32_t val);
+
+/**
+ * atomically read an apr_uint32_t from memory, with the given memory order
+ * @param mem the pointer
+ * @param order APR_ATOMIC_RELAXED, APR_ATOMIC_ACQUIRE or APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_read32_explicit(volatile apr_uint32_t *mem,
+                                                     apr_atomic_order_e order);
+
+/**
+ * atomically set an apr_uint32_t in memory, with the given memory order
+ * @param mem pointer to the object
+ * @param val value that the object will assume
+ * @param order APR_ATOMIC_RELAXED, APR_ATOMIC_RELEASE or APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(void) apr_atomic_set32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                             apr_atomic_order_e order);
+
+/**
+ * atomically add 'val' to an apr_uint32_t, with the given memory order
+ * @param mem pointer to the object
+ * @param val amount to add
+ * @param order the memory order, APR_ATOMIC_RELAXED for statistics counters
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint32_t) apr_atomic_add32_explicit(volatile apr_uint32_t *mem, apr_uint32_t val,
+                                                    apr_atomic_order_e order);
+
 /*
  * Atomic operations on 64-bit values
  * Note: Each of these functions internally implements a memory barrier
@@ -180,6 +237,49 @@ APR_DECLARE(apr_uint64_t) apr_atomic_cas64(volatile apr_uint64_t *mem, apr_uint6
  */
 APR_DECLARE(apr_uint64_t) apr_atomic_xchg64(volatile apr_uint64_t *mem, apr_uint64_t val);
 
+/**
+ * atomically OR 'val' into an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val bits to set
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_or64(volatile apr_uint64_t *mem, apr_uint64_t val);
+
+/**
+ * atomically AND 'val' into an apr_uint64_t
+ * @param mem pointer to the object
+ * @param val bits to keep
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_and64(volatile apr_uint64_t *mem, apr_uint64_t val);
+
+/**
+ * atomically read an apr_uint64_t from memory, with the given memory order
+ * @param mem the pointer
+ * @param order APR_ATOMIC_RELAXED, APR_ATOMIC_ACQUIRE or APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_read64_explicit(volatile apr_uint64_t *mem,
+                                                     apr_atomic_order_e order);
+
+/**
+ * atomically set an apr_uint64_t in memory, with the given memory order
+ * @param mem pointer to the object
+ * @param val value that the object will assume
+ * @param order APR_ATOMIC_RELAXED, APR_ATOMIC_RELEASE or APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(void) apr_atomic_set64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                             apr_atomic_order_e order);
+
+/**
+ * atomically add 'val' to an apr_uint64_t, with the given memory order
+ * @param mem pointer to the object
+ * @param val amount to add
+ * @param order the memory order, APR_ATOMIC_RELAXED for statistics counters
+ * @return old value pointed to by mem
+ */
+APR_DECLARE(apr_uint64_t) apr_atomic_add64_explicit(volatile apr_uint64_t *mem, apr_uint64_t val,
+                                                    apr_atomic_order_e order);
+
 /**
  * compare the pointer's value with cmp.
  * If they are the same swap the value with 'with'
@@ -198,6 +298,57 @@ APR_DECLARE(void*) apr_atomic_casptr(void *volatile *mem, void *with, const void
  */
 APR_DECLARE(void*) apr_atomic_xchgptr(void *volatile *mem, void *with);
 
+/**
+ * atomically read a pointer from memory, with the given memory order
+ * @param mem pointer to the pointer
+ * @param order APR_ATOMIC_RELAXED, APR_ATOMIC_ACQUIRE or APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(void*) apr_atomic_readptr_explicit(void *volatile *mem,
+                                               apr_atomic_order_e order);
+
+/**
+ * atomically set a pointer in memory, with the given memory order
+ * @param mem pointer to the pointer
+ * @param with value that the pointer will assume
+ * @param order APR_ATOMIC_RELAXED, APR_ATOMIC_RELEASE or APR_ATOMIC_SEQ_CST
+ */
+APR_DECLARE(void) apr_atomic_setptr_explicit(void *volatile *mem, void *with,
+                                             apr_atomic_order_e order);
+
+/**
+ * A pointer and its tag, swapped together by apr_atomic_cas_tagptr() such
+ * that changing the tag in every swap protects from the ABA problem.
+ */
+typedef struct apr_atomic_tagptr_t {
+    void *ptr;          /**< the pointer */
+    apr_uintptr_t tag;  /**< the tag, usually a modification count */
+} apr_atomic_tagptr_t;
+
+/**
+ * compare a tagged pointer's value with 'cmp'.
+ * If both the pointer and the tag are the same swap the value with 'with'
+ * @param mem pointer to the tagged pointer
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @return the old value of *mem
+ * @remark The operation is lock-free where the platform has a double-width
+ *         compare and swap, provided that the object is aligned on its size
+ *         (e.g. with APR_ALIGN()), and implemented with a lock otherwise.
+ */
+APR_DECLARE(apr_atomic_tagptr_t) apr_atomic_cas_tagptr(
+                                        volatile apr_atomic_tagptr_t *mem,
+                                        apr_atomic_tagptr_t with,
+                                        apr_atomic_tagptr_t cmp);
+
+/**
+ * atomically read a tagged pointer from memory
+ * @param mem pointer to the tagged pointer
+ * @remark The object must be writable, the read being a compare and swap
+ *         on some platforms.
+ */
+APR_DECLARE(apr_atomic_tagptr_t) apr_atomic_read_tagptr(
+                                        volatile apr_atomic_tagptr_t *mem);
+
 /** @} */
 
 #ifdef __cplusplus
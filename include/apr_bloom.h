@@ -0,0 +1,185 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_BLOOM_H
+#define APR_BLOOM_H
+
+/**
+ * @file apr_bloom.h
+ * @brief APR Bloom filter
+ *
+ * @remark A Bloom filter tells whether a key was possibly added to it, or
+ * certainly not, in a fixed size that does not depend on the size of the
+ * keys.  It can thus front lookups which are expensive when they miss,
+ * only the keys possibly there being looked up.
+ *
+ * The filter is blocked: all the bits of a key are in the same block of
+ * a cache line (64 bytes), so adding or testing a key touches a single
+ * cache line.  The keys are hashed with SipHash-2-4 (apr_siphash24())
+ * keyed by a random seed of the filter, or the callers may bring their
+ * own 64bit hash (apr_bloom_add_hash()).
+ *
+ * The filter is a single contiguous image, made of a header and the
+ * blocks, with no pointers.  It can thus be created in memory shared by
+ * processes (apr_shm) and attached to by the others, or written to a file
+ * and attached to once read back, on hosts of the same byte order.
+ *
+ * Keys can be added and tested concurrently by threads or processes, the
+ * bits being set atomically.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_bloom Bloom filter
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the Bloom filter API */
+typedef struct apr_bloom_t apr_bloom_t;
+
+/**
+ * Get the size of the image of a filter
+ * @param n The number of keys expected
+ * @param fpp The false positive probability wanted with @a n keys,
+ *            between 0 and 1 (excluded)
+ * @return The size in bytes, or zero if @a fpp is out of range
+ * @remark The false positive probability of a blocked filter is slightly
+ *         above the one of a classic filter of the same size, which is
+ *         accounted for here.
+ */
+APR_DECLARE(apr_size_t) apr_bloom_size(apr_uint64_t n, double fpp);
+
+/**
+ * Create a filter
+ * @param bloom The pointer in which to return the newly created object
+ * @param n The number of keys expected
+ * @param fpp The false positive probability wanted with @a n keys
+ * @param p The pool from which to allocate the filter
+ * @return APR_EINVAL if @a fpp is out of range
+ */
+APR_DECLARE(apr_status_t) apr_bloom_create(apr_bloom_t **bloom,
+                                           apr_uint64_t n, double fpp,
+                                           apr_pool_t *p);
+
+/**
+ * Create a filter in the given memory, shared memory for instance
+ * @param bloom The pointer in which to return the newly created object
+ * @param mem The memory, aligned on 8 bytes at least (64 is better)
+ * @param size The size of @a mem, at least apr_bloom_size(@a n, @a fpp)
+ * @param n The number of keys expected
+ * @param fpp The false positive probability wanted with @a n keys
+ * @param p The pool from which to allocate the object
+ * @return APR_EINVAL if @a fpp is out of range, or @a mem is misaligned
+ *         or too small
+ * @remark The image in @a mem is initialized with no key, the other users
+ *         of @a mem may then attach to it with apr_bloom_attach().
+ */
+APR_DECLARE(apr_status_t) apr_bloom_create_in(apr_bloom_t **bloom,
+                                              void *mem, apr_size_t size,
+                                              apr_uint64_t n, double fpp,
+                                              apr_pool_t *p);
+
+/**
+ * Attach to the image of a filter, created elsewhere or read from a file
+ * @param bloom The pointer in which to return the newly created object
+ * @param mem The image, aligned on 8 bytes at least
+ * @param size The size of @a mem
+ * @param p The pool from which to allocate the object
+ * @return APR_EINVAL if @a mem is misaligned, or is not the image of a
+ *         filter of (at most) @a size bytes
+ * @remark The keys added through either object are seen by the other.
+ */
+APR_DECLARE(apr_status_t) apr_bloom_attach(apr_bloom_t **bloom,
+                                           void *mem, apr_size_t size,
+                                           apr_pool_t *p);
+
+/**
+ * Get the image of a filter, to write it to a file for instance
+ * @param bloom The filter
+ * @param mem Location of the image
+ * @param size Location of the size of the image
+ */
+APR_DECLARE(void) apr_bloom_image_get(const apr_bloom_t *bloom,
+                                      void **mem, apr_size_t *size);
+
+/**
+ * Hash a key the way a filter does
+ * @param bloom The filter
+ * @param key The key
+ * @param klen The length of the key
+ * @return The hash of the key for apr_bloom_add_hash() and
+ *         apr_bloom_test_hash()
+ */
+APR_DECLARE(apr_uint64_t) apr_bloom_hash(const apr_bloom_t *bloom,
+                                         const void *key, apr_size_t klen);
+
+/**
+ * Add a key to a filter
+ * @param bloom The filter
+ * @param key The key
+ * @param klen The length of the key
+ */
+APR_DECLARE(void) apr_bloom_add(apr_bloom_t *bloom,
+                                const void *key, apr_size_t klen);
+
+/**
+ * Test whether a key was possibly added to a filter
+ * @param bloom The filter
+ * @param key The key
+ * @param klen The length of the key
+ * @return Non-zero if the key was possibly added, zero if it was not
+ */
+APR_DECLARE(int) apr_bloom_test(const apr_bloom_t *bloom,
+                                const void *key, apr_size_t klen);
+
+/**
+ * Add the hash of a key to a filter
+ * @param bloom The filter
+ * @param hash The hash of the key, all its 64 bits being mixed
+ */
+APR_DECLARE(void) apr_bloom_add_hash(apr_bloom_t *bloom, apr_uint64_t hash);
+
+/**
+ * Test whether the hash of a key was possibly added to a filter
+ * @param bloom The filter
+ * @param hash The hash of the key
+ * @return Non-zero if the hash was possibly added, zero if it was not
+ */
+APR_DECLARE(int) apr_bloom_test_hash(const apr_bloom_t *bloom,
+                                     apr_uint64_t hash);
+
+/**
+ * Remove all the keys of a filter
+ * @param bloom The filter
+ * @remark This must not race with additions to the filter.
+ */
+APR_DECLARE(void) apr_bloom_clear(apr_bloom_t *bloom);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_BLOOM_H */
@@ -32,7 +32,11 @@
 #include "apr_mmap.h"
 #include "apr_errno.h"
 #include "apr_ring.h"
+#include "apr_lib.h"
 #include "apr.h"
+#if APR_HAS_THREADS
+#include "apr_thread_pool.h"
+#endif
 #if APR_HAVE_SYS_UIO_H
 #include <sys/uio.h>	/* for struct iovec */
 #endif
@@ -53,6 +57,11 @@ extern "C" {
 /** default bucket buffer size - 8KB minus room for memory allocator headers */
 #define APR_BUCKET_BUFF_SIZE 8000
 
+/** default maximum size of the reads of SOCKET and PIPE buckets, see
+ * apr_bucket_socket_set_read_max()
+ */
+#define APR_BUCKET_READ_MAX (APR_BUCKET_BUFF_SIZE * 8)
+
 /** if passed to apr_brigade_split_boundary(), the string length will
  * be calculated
  */
@@ -242,7 +251,9 @@ struct apr_bucket {
      *  data to be referenced by multiple buckets, each bucket pointing to
      *  a different segment of the data.  That segment starts at base+start
      *  and ends at base+start+length.  
-     *  If the length == (apr_size_t)(-1), then start == -1.
+     *  If the length == (apr_size_t)(-1), then start == -1, except for
+     *  SOCKET and PIPE buckets which keep the size of their next read
+     *  there.
      */
     apr_off_t start;
     /** type-dependent data hangs off this pointer */
@@ -278,6 +289,9 @@ struct apr_bucket_brigade {
     APR_RING_HEAD(apr_bucket_list, apr_bucket) list;
     /** The freelist from which this bucket was allocated */
     apr_bucket_alloc_t *bucket_alloc;
+    /** The cleanup registered with the pool, killed directly when the
+     *  brigade is destroyed */
+    apr_pool_cleanup_t *cleanup;
 };
 
 
@@ -517,6 +531,12 @@ typedef apr_status_t (*apr_brigade_flush)(apr_bucket_brigade *bb, void *ctx);
  * @return true or false
  */
 #define APR_BUCKET_IS_POOL(e)        ((e)->type == &apr_bucket_type_pool)
+/**
+ * Determine if a bucket is a BUFFER bucket
+ * @param e The bucket to inspect
+ * @return true or false
+ */
+#define APR_BUCKET_IS_BUFFER(e)      ((e)->type == &apr_bucket_type_buffer)
 
 /*
  * General-purpose reference counting for the various bucket types.
@@ -612,6 +632,30 @@ struct apr_bucket_mmap {
 };
 #endif
 
+/** @see apr_bucket_buffer */
+typedef struct apr_bucket_buffer apr_bucket_buffer;
+/**
+ * A buffer shared by BUFFER buckets, possibly of different bucket
+ * allocators and threads
+ */
+struct apr_bucket_buffer {
+    /** Number of buckets (and owners) using this buffer, updated
+     * atomically */
+    volatile apr_uint32_t refcount;
+    /** The data of the buffer, never modified */
+    const char *base;
+    /** The size of the data */
+    apr_size_t length;
+    /** Function to use to free the data, or NULL if the data were
+     * copied with the buffer */
+    void (*free_func)(void *data);
+};
+
+#if APR_HAS_THREADS
+/** @see apr_bucket_file_aio_create() */
+typedef struct apr_bucket_file_aio_t apr_bucket_file_aio_t;
+#endif
+
 /** @see apr_bucket_file */
 typedef struct apr_bucket_file apr_bucket_file;
 /**
@@ -629,9 +673,27 @@ struct apr_bucket_file {
     /** Whether this bucket should be memory-mapped if
      *  a caller tries to read from it */
     int can_mmap;
+    /** The minimum length to memory-map */
+    apr_size_t mmap_threshold;
+    /** The maximum length memory-mapped at once */
+    apr_size_t mmap_limit;
+    /** The cache sharing the mappings, or NULL */
+    apr_mmap_cache_t *mmap_cache;
 #endif /* APR_HAS_MMAP */
     /** File read block size */
     apr_size_t read_size;
+    /** Maximum read block size for sequential reads, or zero */
+    apr_size_t read_ahead;
+    /** Current read block size for sequential reads */
+    apr_size_t read_cur;
+    /** The offset where the next sequential read starts */
+    apr_off_t read_next;
+#if APR_HAS_THREADS
+    /** The asynchronous reader, or NULL */
+    apr_bucket_file_aio_t *aio;
+    /** The asynchronous read in flight, or NULL */
+    void *aio_req;
+#endif
 };
 
 /** @see apr_bucket_structs */
@@ -827,6 +889,76 @@ APR_DECLARE(apr_status_t) apr_brigade_split_boundary(apr_bucket_brigade *bbOut,
                                                      apr_off_t maxbytes)
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Split a brigade based on the provided boundary, or metadata buckets,
+ * whichever are encountered first, and tell how many bytes were passed.
+ *
+ * This is apr_brigade_split_boundary() which sets @a scanned to the number
+ * of bytes passed into bbOut (the boundary excluded), such that a caller
+ * resuming after APR_INCOMPLETE needs not compute the length of bbOut.
+ *
+ * @param bbOut The bucket brigade that will have the LF line appended to.
+ * @param bbIn The input bucket brigade to search for a LF-line.
+ * @param block The blocking mode to be used to split the line.
+ * @param boundary The boundary string.
+ * @param boundary_len The length of the boundary string. If set to
+ *        APR_BUCKETS_STRING, the length will be calculated.
+ * @param maxbytes The maximum bytes to read.
+ * @param scanned If not NULL, set to the number of bytes passed into bbOut.
+ * @remark The boundary is searched with memmem() in the buckets, and the
+ *         candidates for a match straddling buckets with memchr() of its
+ *         first byte, without flattening.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_split_boundary_ex(
+                                                 apr_bucket_brigade *bbOut,
+                                                 apr_bucket_brigade *bbIn,
+                                                 apr_read_type_e block,
+                                                 const char *boundary,
+                                                 apr_size_t boundary_len,
+                                                 apr_off_t maxbytes,
+                                                 apr_off_t *scanned)
+                          __attribute__((nonnull(1,2)));
+
+/**
+ * Merge the adjacent small in-memory buckets of a brigade into heap
+ * buckets, so that later reads and writes have fewer buckets to handle.
+ * @param bb The bucket brigade to coalesce
+ * @param size The maximum size of the merged buckets, or zero for
+ *             APR_BUCKET_BUFF_SIZE
+ * @return APR_SUCCESS, or APR_ENOMEM if allocation failed (the brigade is
+ *         consistent still)
+ * @remark The HEAP, TRANSIENT, POOL and IMMORTAL buckets smaller than
+ *         @a size are copied together in new HEAP buckets of up to @a size
+ *         bytes, the empty ones are removed, and the remaining TRANSIENT
+ *         buckets are set aside (made HEAP) in place. The other buckets,
+ *         including the metadata ones, are left in place, so the runs of
+ *         data between them are merged separately.
+ * @remark After this, there are at most two in-memory buckets per @a size
+ *         bytes of data between each pair of other buckets.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_coalesce(apr_bucket_brigade *bb,
+                                               apr_size_t size)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Set aside all the buckets of a brigade, so that their data survive
+ * until @a pool is cleared or destroyed.
+ * @param bb The bucket brigade to set aside
+ * @param pool The pool the data must live as long as
+ * @return APR_SUCCESS, or the first error of a bucket setaside function
+ *         except APR_ENOTIMPL (the buckets which can not be set aside,
+ *         as SOCKET and PIPE, are left alone)
+ * @remark The adjacent TRANSIENT buckets are copied together in one
+ *         allocator owned buffer of up to APR_BUCKET_BUFF_SIZE bytes,
+ *         and become HEAP buckets sharing it by reference count, rather
+ *         than allocating one buffer each. Since setting aside HEAP
+ *         buckets is free, the data are copied once however many times
+ *         the brigade is set aside afterwards.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_setaside(apr_bucket_brigade *bb,
+                                               apr_pool_t *pool)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * Create an iovec of the elements in a bucket_brigade... return number 
  * of elements used.  This is useful for writing to a file or to the
@@ -974,6 +1106,39 @@ APR_DECLARE(apr_status_t) apr_brigade_vprintf(apr_bucket_brigade *b,
                                               const char *fmt, va_list va)
                           __attribute__((nonnull(1,4)));
 
+/**
+ * apr_brigade_printf() with a format compiled by apr_format_compile(),
+ * so that it is not parsed again.
+ * @param b The brigade to write to
+ * @param flush The flush function to use if the brigade is full
+ * @param ctx The structure to pass to the flush function
+ * @param format The compiled format of the string to write
+ * @param ... The arguments to fill out the format
+ * @return APR_SUCCESS or error code
+ */
+APR_DECLARE_NONSTD(apr_status_t) apr_brigade_format(apr_bucket_brigade *b,
+                                                    apr_brigade_flush flush,
+                                                    void *ctx,
+                                                    const apr_format_t *format,
+                                                    ...)
+                                 __attribute__((nonnull(1,4)));
+
+/**
+ * apr_brigade_vprintf() with a format compiled by apr_format_compile().
+ * @param b The brigade to write to
+ * @param flush The flush function to use if the brigade is full
+ * @param ctx The structure to pass to the flush function
+ * @param format The compiled format of the string to write
+ * @param va The arguments to fill out the format
+ * @return APR_SUCCESS or error code
+ */
+APR_DECLARE(apr_status_t) apr_brigade_vformat(apr_bucket_brigade *b,
+                                              apr_brigade_flush flush,
+                                              void *ctx,
+                                              const apr_format_t *format,
+                                              va_list va)
+                          __attribute__((nonnull(1,4)));
+
 /**
  * Utility function to insert a file (or a segment of a file) onto the
  * end of the brigade.  The file is split into multiple buckets if it
@@ -993,6 +1158,30 @@ APR_DECLARE(apr_bucket *) apr_brigade_insert_file(apr_bucket_brigade *bb,
                                                   apr_pool_t *p)
                           __attribute__((nonnull(1,2,5)));
 
+/**
+ * Write the buckets of a brigade to a socket, up to the first metadata
+ * bucket, deleting the buckets which are entirely written.
+ * @param bb The brigade to write
+ * @param sock The socket to write to
+ * @param len Set to the number of bytes written
+ * @remark The data buckets are written in batches with apr_socket_sendv(),
+ *         the small ones being copied together first. When APR_HAS_SENDFILE,
+ *         the file buckets opened with APR_FOPEN_SENDFILE_ENABLED are sent
+ *         with apr_socket_sendfile() (the batch before as headers), and
+ *         when APR_HAS_SPLICE the socket and pipe buckets are moved with
+ *         apr_socket_splice() or apr_socket_splice_file(), so their data
+ *         are never copied to userspace.
+ * @remark After a partial write the first bucket is split, so calling
+ *         this again resumes where it stopped.  When this returns with a
+ *         socket or pipe bucket first, some of its data may still be
+ *         pending for @a sock, so the next write to @a sock must be
+ *         through this function too.
+ * It is possible for both bytes to be written and an error to be returned.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_write_socket(apr_bucket_brigade *bb,
+                                                   apr_socket_t *sock,
+                                                   apr_size_t *len)
+                          __attribute__((nonnull(1,2,3)));
 
 
 /*  *****  Bucket freelist functions *****  */
@@ -1030,6 +1219,22 @@ APR_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(
 APR_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
                          __attribute__((nonnull(1)));
 
+/**
+ * Set the maximum amount of memory a bucket allocator keeps on its free
+ * lists of large blocks, releasing what exceeds it now.
+ * @param list The bucket allocator
+ * @param size The maximum number of bytes, zero to not keep any (128K
+ *             by default)
+ * @remark The blocks larger than APR_BUCKET_ALLOC_SIZE are kept by size
+ *         (in pages, up to 128K) when freed, and reused by the next
+ *         apr_bucket_alloc() of the same size, without going through
+ *         the apr_allocator_t.  Asking for the sizes returned by
+ *         apr_bucket_alloc_aligned_floor() makes these reuses exact.
+ */
+APR_DECLARE_NONSTD(void) apr_bucket_alloc_max_free_set(apr_bucket_alloc_t *list,
+                                                       apr_size_t size)
+                         __attribute__((nonnull(1)));
+
 /**
  * Get the aligned size corresponding to the requested size, but minus the
  * allocator(s) overhead such that the allocation would remain in the
@@ -1271,6 +1476,11 @@ APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_file;
  * heap.
  */
 APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_heap;
+/**
+ * The BUFFER bucket type.  This bucket represents a slice of a buffer
+ * shared across bucket allocators and threads.
+ */
+APR_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_buffer;
 #if APR_HAS_MMAP
 /**
  * The MMAP bucket type.  This bucket represents an MMAP'ed file
@@ -1523,6 +1733,64 @@ APR_DECLARE(apr_bucket *) apr_bucket_heap_make(apr_bucket *b, const char *buf,
                                                void (*free_func)(void *data))
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Create a buffer to be shared by BUFFER buckets.
+ * @param buf The data of the buffer
+ * @param length The size of the data
+ * @param free_func Function to use to free the data when the buffer is
+ *                  no longer used; NULL indicates that the data should be
+ *                  copied with the buffer
+ * @return The new buffer, with one reference owned by the caller, or NULL
+ *         if allocation failed
+ * @remark The buffer is not allocated from a pool or bucket allocator but
+ *         with malloc(), and its reference count is updated atomically, so
+ *         that its buckets can be used from different bucket allocators and
+ *         threads.  @a free_func is called by whichever thread releases
+ *         the last reference.
+ */
+APR_DECLARE(apr_bucket_buffer *) apr_bucket_buffer_alloc(const char *buf,
+                                                         apr_size_t length,
+                                                 void (*free_func)(void *data));
+
+/**
+ * Release the reference to a shared buffer owned by the caller, the buffer
+ * is freed when its last bucket is destroyed.
+ * @param buffer The buffer
+ */
+APR_DECLARE(void) apr_bucket_buffer_release(apr_bucket_buffer *buffer)
+                  __attribute__((nonnull(1)));
+
+/**
+ * Create a bucket referring to a slice of a shared buffer.
+ * @param buffer The buffer
+ * @param start The offset of the slice in the buffer
+ * @param length The size of the slice
+ * @param list The freelist from which this bucket should be allocated
+ * @return The new bucket
+ * @remark The bucket holds a reference to @a buffer, the caller must
+ *         still release its own.  The data are never copied, by this
+ *         bucket or the ones split or copied from it.
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_buffer_create(apr_bucket_buffer *buffer,
+                                                   apr_off_t start,
+                                                   apr_size_t length,
+                                                   apr_bucket_alloc_t *list)
+                          __attribute__((nonnull(1,4)));
+
+/**
+ * Make the bucket passed in a bucket refer to a slice of a shared buffer
+ * @param b The bucket to make into a BUFFER bucket
+ * @param buffer The buffer
+ * @param start The offset of the slice in the buffer
+ * @param length The size of the slice
+ * @return The new bucket
+ */
+APR_DECLARE(apr_bucket *) apr_bucket_buffer_make(apr_bucket *b,
+                                                 apr_bucket_buffer *buffer,
+                                                 apr_off_t start,
+                                                 apr_size_t length)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * Create a bucket referring to memory allocated from a pool.
  *
@@ -1601,6 +1869,25 @@ APR_DECLARE(apr_bucket *) apr_bucket_socket_make(apr_bucket *b,
                                                  apr_socket_t *thissock)
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Set the maximum size of the read buffers of a SOCKET bucket
+ * @param b The bucket
+ * @param max The maximum size, APR_BUCKET_BUFF_SIZE or less to always
+ *            read APR_BUCKET_BUFF_SIZE (default is APR_BUCKET_READ_MAX)
+ * @return APR_SUCCESS
+ * @remark The reads start at APR_BUCKET_BUFF_SIZE and double while they
+ *         fill the buffer, up to @a max (floored to APR_BUCKET_BUFF_SIZE
+ *         times a power of two), and halve back when they use a quarter
+ *         of it or less.  A read of APR_BUCKET_BUFF_SIZE or less is kept
+ *         in a buffer of APR_BUCKET_BUFF_SIZE, so idle connections don't
+ *         hold large buffers.
+ * @remark The setting passes on to the bucket holding the rest of the
+ *         socket after a read.
+ */
+APR_DECLARE(apr_status_t) apr_bucket_socket_set_read_max(apr_bucket *b,
+                                                         apr_size_t max)
+                          __attribute__((nonnull(1)));
+
 /**
  * Create a bucket referring to a pipe.
  * @param thispipe The pipe to put in the bucket
@@ -1621,6 +1908,19 @@ APR_DECLARE(apr_bucket *) apr_bucket_pipe_make(apr_bucket *b,
                                                apr_file_t *thispipe)
                           __attribute__((nonnull(1,2)));
 
+/**
+ * Set the maximum size of the read buffers of a PIPE bucket
+ * @param b The bucket
+ * @param max The maximum size, APR_BUCKET_BUFF_SIZE or less to always
+ *            read APR_BUCKET_BUFF_SIZE (default is APR_BUCKET_READ_MAX)
+ * @return APR_SUCCESS
+ * @remark The reads are sized like the ones of a SOCKET bucket, @see
+ *         apr_bucket_socket_set_read_max()
+ */
+APR_DECLARE(apr_status_t) apr_bucket_pipe_set_read_max(apr_bucket *b,
+                                                       apr_size_t max)
+                          __attribute__((nonnull(1)));
+
 /**
  * Create a bucket referring to a file.
  * @param fd The file to put in the bucket
@@ -1682,6 +1982,201 @@ APR_DECLARE(apr_status_t) apr_bucket_file_enable_mmap(apr_bucket *b,
 APR_DECLARE(apr_status_t) apr_bucket_file_set_buf_size(apr_bucket *b,
                                                        apr_size_t size);
 
+/**
+ * Set the lengths of a FILE bucket for which memory-mapping is used
+ * (default are @a APR_MMAP_THRESHOLD and @a APR_MMAP_LIMIT)
+ * @param b The bucket
+ * @param threshold The minimum length of the bucket to memory-map it
+ * @param limit The maximum length memory-mapped at once, the rest of the
+ *              bucket being split
+ * @return APR_SUCCESS normally, APR_EINVAL if @a limit is zero, or
+ *         APR_ENOTIMPL if memory-mapping is not supported
+ * @remark Relevant/used only when memory-mapping is enabled (@see
+ * apr_bucket_file_enable_mmap)
+ */
+APR_DECLARE(apr_status_t) apr_bucket_file_set_mmap_limits(apr_bucket *b,
+                                                          apr_size_t threshold,
+                                                          apr_size_t limit)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Share the memory-mappings of a FILE bucket with the other buckets of the
+ * same file region, through a mapping cache
+ * @param b The bucket
+ * @param cache The mapping cache, or NULL to map privately (the default)
+ * @return APR_SUCCESS normally, or APR_ENOTIMPL if memory-mapping is not
+ *         supported
+ * @remark The cache must outlive the pool the bucket reads into.
+ * @remark Relevant/used only when memory-mapping is enabled (@see
+ * apr_bucket_file_enable_mmap)
+ */
+APR_DECLARE(apr_status_t) apr_bucket_file_set_mmap_cache(apr_bucket *b,
+                                                         apr_mmap_cache_t *cache)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Let a FILE bucket grow its read buffer for sequential reads, and ask
+ * the system to read ahead of them
+ * @param b The bucket
+ * @param max The maximum size of the read buffers, or zero to always
+ *            allocate the size set by apr_bucket_file_set_buf_size()
+ * @return APR_SUCCESS normally, or an error code if the operation fails
+ * @remark Each read following the previous one in the file doubles the
+ *         size of the next read, up to @a max (floored to the bucket
+ *         allocator's alignment, @see apr_bucket_alloc_aligned_floor),
+ *         and where available posix_fadvise(POSIX_FADV_WILLNEED) is
+ *         issued for the next read.  Any other read restarts from the
+ *         size set by apr_bucket_file_set_buf_size().
+ * @remark Relevant/used only when memory-mapping is disabled or not
+ *         applicable (@see apr_bucket_file_set_mmap_limits)
+ */
+APR_DECLARE(apr_status_t) apr_bucket_file_set_read_ahead(apr_bucket *b,
+                                                         apr_size_t max)
+                          __attribute__((nonnull(1)));
+
+#if APR_HAS_THREADS
+/**
+ * Create an asynchronous reader for FILE buckets, reading from the
+ * threads of a thread pool
+ * @param aio The new reader
+ * @param tp The thread pool to run the reads
+ * @param notify If not NULL, the function called by the thread pool when
+ *               a read completes, typically to wake up the pollset (or
+ *               pollcb) of the reading thread with apr_pollset_wakeup()
+ * @param baton The argument passed to @a notify
+ * @param p The pool to allocate the reader from
+ * @return APR_SUCCESS normally, or an error code if the operation fails
+ * @remark The cleanup of @a p waits for the reads in flight, so @a tp must
+ *         still run them then.
+ */
+APR_DECLARE(apr_status_t) apr_bucket_file_aio_create(
+                                            apr_bucket_file_aio_t **aio,
+                                            apr_thread_pool_t *tp,
+                                            void (*notify)(void *baton),
+                                            void *baton,
+                                            apr_pool_t *p)
+                          __attribute__((nonnull(1,2,5)));
+
+/**
+ * Make the APR_NONBLOCK_READ reads of a FILE bucket asynchronous
+ * @param b The bucket
+ * @param aio The asynchronous reader, or NULL to read synchronously
+ * @return APR_SUCCESS normally, or an error code if the operation fails
+ * @remark A nonblocking read submits the read of the next block to the
+ *         thread pool of @a aio and returns APR_EAGAIN, as do the next
+ *         ones until the data are read, then the bucket becomes a HEAP
+ *         bucket as with a blocking read.  A blocking read waits for the
+ *         read in flight if any, or reads synchronously.
+ * @remark Memory-mapping is disabled for the bucket, since page faults
+ *         would block the reading thread too.
+ * @remark The file is read with pread() where available and unbuffered,
+ *         otherwise the file must not be used by other threads while a
+ *         read is in flight.
+ */
+APR_DECLARE(apr_status_t) apr_bucket_file_set_aio(apr_bucket *b,
+                                                  apr_bucket_file_aio_t *aio)
+                          __attribute__((nonnull(1)));
+#endif /* APR_HAS_THREADS */
+
+/*  *****  Brigade compression  *****  */
+
+/**
+ * The formats of the brigade compressors
+ */
+typedef enum {
+    APR_BRIGADE_CODEC_DEFLATE,  /**< Raw deflate (RFC 1951) */
+    APR_BRIGADE_CODEC_ZLIB,     /**< zlib (RFC 1950) */
+    APR_BRIGADE_CODEC_GZIP,     /**< gzip (RFC 1952) */
+    APR_BRIGADE_CODEC_ZSTD,     /**< Zstandard (RFC 8878) */
+    APR_BRIGADE_CODEC_BROTLI    /**< Brotli (RFC 7932) */
+} apr_brigade_codec_type_e;
+
+/**
+ * Decompress rather than compress, see apr_brigade_codec_create()
+ */
+#define APR_BRIGADE_CODEC_DECODE 0x01
+
+/**
+ * The default compression level of the format
+ */
+#define APR_BRIGADE_CODEC_LEVEL_DEFAULT (-1)
+
+/**
+ * Opaque streaming compressor (or decompressor) of brigades
+ */
+typedef struct apr_brigade_codec_t apr_brigade_codec_t;
+
+/**
+ * Whether a compression format is available in this build
+ * @param type The format
+ * @return Non-zero if apr_brigade_codec_create() supports @a type
+ * @remark The deflate, zlib and gzip formats are available when APR is
+ *         built with zlib (APU_HAVE_ZLIB).
+ */
+APR_DECLARE(int) apr_brigade_codec_supported(apr_brigade_codec_type_e type);
+
+/**
+ * Create a streaming compressor (or decompressor) of brigades
+ * @param ctx The new compressor
+ * @param type The compression format
+ * @param flags APR_BRIGADE_CODEC_DECODE to decompress, or zero
+ * @param level The compression level (0 to 9 for zlib formats), or
+ *              APR_BRIGADE_CODEC_LEVEL_DEFAULT; unused to decompress
+ * @param window The base-two logarithm of the window size (9 to 15 for
+ *               zlib formats), or zero for the format's maximum
+ * @param list The bucket allocator of the output buckets
+ * @param p The pool to allocate the compressor from, which releases the
+ *          compression state when cleared
+ * @return APR_ENOTIMPL if @a type is not available, APR_EINVAL if a
+ *         parameter is out of range, APR_SUCCESS otherwise
+ * @remark @a list must remain valid until @a p is cleared.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_codec_create(apr_brigade_codec_t **ctx,
+                                                   apr_brigade_codec_type_e type,
+                                                   apr_uint32_t flags,
+                                                   int level, int window,
+                                                   apr_bucket_alloc_t *list,
+                                                   apr_pool_t *p)
+                          __attribute__((nonnull(1,6,7)));
+
+/**
+ * Compress (or decompress) the buckets of a brigade into another
+ * @param ctx The compressor
+ * @param out The brigade to append the output buckets to
+ * @param in The brigade to consume
+ * @param block Whether the reads of @a in should block
+ * @return APR_SUCCESS once @a in is empty, APR_EAGAIN if a nonblocking
+ *         read would block (the remaining buckets are left in @a in),
+ *         APR_INCOMPLETE if an EOS bucket ends a truncated compressed
+ *         stream, or another error code if a read or the (de)compression
+ *         fails.
+ * @remark The output is produced in HEAP buckets of APR_BUCKET_BUFF_SIZE
+ *         bytes, and the last ones of a stream are kept by @a ctx until
+ *         more input fills them or a metadata bucket is found.
+ * @remark Metadata buckets are moved to @a out after the output they
+ *         follow.  A FLUSH bucket first flushes the compressor so that
+ *         everything before it can be decompressed, and an EOS bucket
+ *         ends the compressed stream and resets @a ctx for the next one.
+ * @remark Successive streams (like gzip members) are decompressed until
+ *         the end of the input.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_codec_process(apr_brigade_codec_t *ctx,
+                                                    apr_bucket_brigade *out,
+                                                    apr_bucket_brigade *in,
+                                                    apr_read_type_e block)
+                          __attribute__((nonnull(1,2,3)));
+
+/**
+ * Reset a compressor to (de)compress a new stream, discarding the current
+ * one
+ * @param ctx The compressor
+ * @return APR_SUCCESS normally, or an error code if the operation fails
+ * @remark This allows to reuse the compression state of @a ctx (and its
+ *         memory) across streams.
+ */
+APR_DECLARE(apr_status_t) apr_brigade_codec_reset(apr_brigade_codec_t *ctx)
+                          __attribute__((nonnull(1)));
+
 /** @} */
 #ifdef __cplusplus
 }
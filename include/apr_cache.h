@@ -0,0 +1,227 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_CACHE_H
+#define APR_CACHE_H
+
+/**
+ * @file apr_cache.h
+ * @brief APR bounded in-memory cache
+ *
+ * @remark A cache maps keys to values of the caller, up to a budget of
+ * cost (usually bytes) after which the values least likely to be used
+ * again are evicted.  Eviction follows S3-FIFO: new values enter a small
+ * FIFO queue from which those not used again are evicted quickly, the
+ * ones used again moving to a main queue where each use buys another
+ * round, and the keys recently evicted from the small queue go straight
+ * to the main one when they come back.  A hit only bumps a counter of
+ * the value, the queues are not reordered.
+ *
+ * The entries are split in shards by the hash of their keys, each with
+ * its own lock, such that the threads using the cache seldom contend.
+ * apr_cache_get_or_compute() computes a missing value once, the other
+ * threads asking for it meanwhile waiting for that value.
+ *
+ * The values got from the cache are referenced until released, such that
+ * they are freed (see apr_cache_free_t) only once they are both out of
+ * the cache and no longer used.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_cache Bounded in-memory cache
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the cache API */
+typedef struct apr_cache_t apr_cache_t;
+
+/** A value got from a cache, until released */
+typedef struct apr_cache_entry_t apr_cache_entry_t;
+
+/** The default number of shards of a cache */
+#define APR_CACHE_SHARDS 16
+
+/**
+ * Free a value which is neither cached nor used anymore
+ * @param value The value
+ * @param baton The baton given to apr_cache_create()
+ */
+typedef void (apr_cache_free_t)(void *value, void *baton);
+
+/**
+ * Compute a value missing from a cache
+ * @param value Location of the value
+ * @param cost Location of the cost of the value, zero on input
+ * @param ttl Location of the time to live of the value, zero (the
+ *            default of the cache) on input
+ * @param key The key
+ * @param klen The length of the key
+ * @param baton The baton given to apr_cache_get_or_compute()
+ * @return APR_SUCCESS, or an error returned to all the callers waiting
+ *         for this value
+ */
+typedef apr_status_t (apr_cache_compute_t)(void **value, apr_size_t *cost,
+                                           apr_interval_time_t *ttl,
+                                           const void *key, apr_size_t klen,
+                                           void *baton);
+
+/** Statistics of a cache */
+typedef struct apr_cache_stats_t {
+    apr_uint64_t hits;      /**< Values found */
+    apr_uint64_t misses;    /**< Values not found, or expired */
+    apr_uint64_t computes;  /**< Values computed */
+    apr_uint64_t evictions; /**< Values evicted for room */
+    apr_size_t entries;     /**< Values cached */
+    apr_size_t cost;        /**< Cost of the values cached */
+} apr_cache_stats_t;
+
+/**
+ * Create a cache
+ * @param cache The pointer in which to return the newly created object
+ * @param max_cost The maximum cost of the values cached
+ * @param ttl The default time in microseconds during which a value is
+ *            served, or zero for no expiry
+ * @param shards The number of shards, rounded up to a power of two, or
+ *               zero for APR_CACHE_SHARDS
+ * @param free_fn The function freeing the values, or NULL
+ * @param baton The baton given to @a free_fn
+ * @param p The pool from which to allocate the cache, and whose cleanup
+ *          frees the values cached
+ * @return APR_EINVAL if @a ttl is negative
+ * @remark The cost of an entry is the one given for its value plus the
+ *         size of its key and of the bookkeeping, such that with the
+ *         sizes of the values for their cost @a max_cost bounds the
+ *         memory used.  Each shard gets an equal part of @a max_cost.
+ * @remark All the entries got from the cache must be released before
+ *         @a p is cleared or destroyed.
+ */
+APR_DECLARE(apr_status_t) apr_cache_create(apr_cache_t **cache,
+                                           apr_size_t max_cost,
+                                           apr_interval_time_t ttl,
+                                           apr_uint32_t shards,
+                                           apr_cache_free_t *free_fn,
+                                           void *baton,
+                                           apr_pool_t *p);
+
+/**
+ * Get a value from a cache
+ * @param cache The cache
+ * @param key The key
+ * @param klen The length of the key
+ * @param entry Location of the entry of the value, to be released with
+ *              apr_cache_release()
+ * @return APR_SUCCESS, or APR_NOTFOUND if the value is not cached, is
+ *         expired or is still being computed
+ */
+APR_DECLARE(apr_status_t) apr_cache_get(apr_cache_t *cache,
+                                        const void *key, apr_size_t klen,
+                                        apr_cache_entry_t **entry);
+
+/**
+ * Get a value from a cache, or compute and cache it if missing
+ * @param cache The cache
+ * @param key The key
+ * @param klen The length of the key
+ * @param compute The function computing the value
+ * @param baton The baton given to @a compute
+ * @param entry Location of the entry of the value, to be released with
+ *              apr_cache_release()
+ * @return APR_SUCCESS, or the error returned by @a compute
+ * @remark Only one caller computes a missing value, with no lock held,
+ *         the others asking for the same key meanwhile waiting for it.
+ *         @a compute must thus not ask for its own key.
+ * @remark The value computed is returned even if it does not fit the
+ *         cache, then freed once released.
+ */
+APR_DECLARE(apr_status_t) apr_cache_get_or_compute(apr_cache_t *cache,
+                                                   const void *key,
+                                                   apr_size_t klen,
+                                                   apr_cache_compute_t *compute,
+                                                   void *baton,
+                                                   apr_cache_entry_t **entry);
+
+/**
+ * Get the value of an entry got from a cache
+ * @param entry The entry
+ * @return The value
+ */
+APR_DECLARE(void *) apr_cache_entry_value(const apr_cache_entry_t *entry);
+
+/**
+ * Release an entry got from a cache
+ * @param entry The entry
+ * @remark The value is freed if it was evicted or replaced meanwhile and
+ *         this was its last user.
+ */
+APR_DECLARE(void) apr_cache_release(apr_cache_entry_t *entry);
+
+/**
+ * Cache a value, replacing any previous one
+ * @param cache The cache
+ * @param key The key
+ * @param klen The length of the key
+ * @param value The value, freed by the cache from now on
+ * @param cost The cost of the value
+ * @param ttl The time in microseconds during which the value is served,
+ *            or zero for the default of the cache
+ * @return APR_SUCCESS, or APR_ENOSPC if the value does not fit a shard
+ *         (the value is then freed already)
+ */
+APR_DECLARE(apr_status_t) apr_cache_set(apr_cache_t *cache,
+                                        const void *key, apr_size_t klen,
+                                        void *value, apr_size_t cost,
+                                        apr_interval_time_t ttl);
+
+/**
+ * Remove a value from a cache
+ * @param cache The cache
+ * @param key The key
+ * @param klen The length of the key
+ */
+APR_DECLARE(void) apr_cache_delete(apr_cache_t *cache,
+                                   const void *key, apr_size_t klen);
+
+/**
+ * Remove all the values of a cache
+ * @param cache The cache
+ */
+APR_DECLARE(void) apr_cache_clear(apr_cache_t *cache);
+
+/**
+ * Get the statistics of a cache
+ * @param cache The cache
+ * @param stats The statistics, summed over the shards
+ */
+APR_DECLARE(void) apr_cache_stats_get(apr_cache_t *cache,
+                                      apr_cache_stats_t *stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_CACHE_H */
@@ -0,0 +1,134 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_COUNTER_H
+#define APR_COUNTER_H
+
+/**
+ * @file apr_counter.h
+ * @brief APR Sharded statistics counters
+ *
+ * @remark A counter is split in slots of their own cache line, each
+ * updated by the threads running on a given CPU (or, where the CPU is not
+ * known, by a given set of threads), such that frequent updates from many
+ * threads do not contend.  Reading the counter sums the slots, with no
+ * snapshot guarantee while updates happen.
+ *
+ * A counter lives either in the memory of a process, or in a shared memory
+ * segment (see apr_shm.h) initialized by one process and attached to by
+ * the others, which then count together.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_counter Sharded statistics counters
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the counter API */
+typedef struct apr_counter_t apr_counter_t;
+
+/**
+ * Get the size of the memory needed by a counter.
+ * @param nslots The number of slots, or zero for the default of 64, which
+ *        should be around the number of CPUs of the system.
+ * @return The size to give to apr_counter_init().
+ */
+APR_DECLARE(apr_size_t) apr_counter_size(unsigned int nslots);
+
+/**
+ * Create a counter, starting at zero, in the memory of the process.
+ * @param counter The newly created counter.
+ * @param nslots The number of slots, or zero for the default.
+ * @param p The pool to allocate the counter from.
+ */
+APR_DECLARE(apr_status_t) apr_counter_create(apr_counter_t **counter,
+                                             unsigned int nslots,
+                                             apr_pool_t *p);
+
+/**
+ * Initialize a counter, starting at zero, in the given memory.
+ * @param counter The newly initialized counter.
+ * @param nslots The number of slots, or zero for the default.
+ * @param membuf The memory of the counter, usually from apr_shm_baseaddr_get().
+ * @param memsize The size of membuf, at least apr_counter_size(nslots).
+ * @param p The pool to allocate the counter's handle from.
+ * @return APR_ENOSPC if memsize is too small.
+ * @remark The memory should be aligned on a cache line for the slots not
+ *         to share them, which shared memory segments are.
+ * @remark Cross-process counters need lock-free 64-bit atomics, which all
+ *         the 64-bit and most 32-bit platforms have.
+ */
+APR_DECLARE(apr_status_t) apr_counter_init(apr_counter_t **counter,
+                                           unsigned int nslots,
+                                           void *membuf, apr_size_t memsize,
+                                           apr_pool_t *p);
+
+/**
+ * Attach to a counter initialized by apr_counter_init(), possibly in another
+ * process.
+ * @param counter The attached counter.
+ * @param membuf The memory of the counter.
+ * @param memsize The size of membuf.
+ * @param p The pool to allocate the counter's handle from.
+ * @return APR_EINVAL if membuf does not hold an initialized counter.
+ */
+APR_DECLARE(apr_status_t) apr_counter_attach(apr_counter_t **counter,
+                                             void *membuf, apr_size_t memsize,
+                                             apr_pool_t *p);
+
+/**
+ * Add to a counter.
+ * @param counter The counter.
+ * @param val The amount to add.
+ */
+APR_DECLARE(void) apr_counter_add(apr_counter_t *counter, apr_uint64_t val);
+
+/**
+ * Increment a counter by one.
+ * @param counter The counter.
+ */
+APR_DECLARE(void) apr_counter_inc(apr_counter_t *counter);
+
+/**
+ * Read the value of a counter, summing its slots.
+ * @param counter The counter.
+ * @remark The additions done concurrently may or may not be accounted for.
+ */
+APR_DECLARE(apr_uint64_t) apr_counter_read(apr_counter_t *counter);
+
+/**
+ * Reset a counter to zero.
+ * @param counter The counter.
+ * @remark The additions done concurrently may or may not be reset.
+ */
+APR_DECLARE(void) apr_counter_reset(apr_counter_t *counter);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_COUNTER_H */
@@ -0,0 +1,59 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_CRC32_H
+#define APR_CRC32_H
+
+#include "apr.h"
+
+/**
+ * @file apr_crc32.h
+ * @brief APR CRC-32 Library
+ *        The CRC-32 of ISO 3309, ITU-T V.42, gzip, zlib and png (reflected
+ *        polynomial 0xEDB88320), as used by apr_memcache and apr_redis to
+ *        split the keys between servers.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup APR_CRC32 CRC-32 Library
+ * @ingroup APR
+ * @{
+ */
+
+/**
+ * Update a running CRC-32 with some data
+ * @param crc The CRC-32 of the previous data, or zero to start
+ * @param data The data
+ * @param len The length of the data
+ * @return The CRC-32 of the previous data followed by @a data
+ * @remark The computation uses the CRC instructions of the CPU when they
+ *         are available (ARMv8), and slicing by 8 otherwise, the result
+ *         being the same (e.g. 0xCBF43926 for "123456789").
+ */
+APR_DECLARE(apr_uint32_t) apr_crc32(apr_uint32_t crc, const void *data,
+                                    apr_size_t len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_CRC32_H */
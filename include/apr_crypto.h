@@ -23,6 +23,7 @@
 #include "apr_hash.h"
 #include "apu_errno.h"
 #include "apr_thread_proc.h"
+#include "apr_buckets.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -117,8 +118,9 @@ typedef enum
     APR_KEY_NONE, APR_KEY_3DES_192, /** 192 bit (3-Key) 3DES */
     APR_KEY_AES_128, /** 128 bit AES */
     APR_KEY_AES_192, /** 192 bit AES */
-    APR_KEY_AES_256
-/** 256 bit AES */
+    APR_KEY_AES_256, /** 256 bit AES */
+    APR_KEY_CHACHA20
+/** 256 bit ChaCha20 */
 } apr_crypto_block_key_type_e;
 
 /**
@@ -128,10 +130,22 @@ typedef enum
 {
     APR_MODE_NONE, /** An error condition */
     APR_MODE_ECB, /** Electronic Code Book */
-    APR_MODE_CBC
-/** Cipher Block Chaining */
+    APR_MODE_CBC, /** Cipher Block Chaining */
+    APR_MODE_GCM, /** Galois/Counter Mode (AEAD, AES only) */
+    APR_MODE_POLY1305
+/** Poly1305 authenticator (AEAD, ChaCha20 only) */
 } apr_crypto_block_key_mode_e;
 
+/**
+ * Size of the authentication tag appended by apr_crypto_aead_seal().
+ */
+#define APR_CRYPTO_AEAD_TAGSIZE 16
+
+/**
+ * Size of the initialisation vector of the AEAD keys.
+ */
+#define APR_CRYPTO_AEAD_IVSIZE 12
+
 /**
  * Types of digests supported by the apr_crypto_key() function.
  */
@@ -731,6 +745,63 @@ APR_DECLARE(apr_status_t) apr_crypto_passphrase(apr_crypto_key_t **key,
         const apr_crypto_block_key_mode_e mode, const int doPad,
         const int iterations, const apr_crypto_t *f, apr_pool_t *p);
 
+/**
+ * Structure caching the keys derived from passphrases.
+ *
+ * This structure is created using the apr_crypto_key_cache_create()
+ * function.
+ */
+typedef struct apr_crypto_key_cache_t apr_crypto_key_cache_t;
+
+/**
+ * @brief Create a cache of the keys derived from passphrases, so that
+ *        apr_crypto_key_cached() runs PBKDF2 once per passphrase, salt,
+ *        iteration count and cipher rather than once per key.
+ * @note The derived keys are kept in memory locked from being swapped out,
+ *       where the platform supports it. They are found by an HMAC-SHA256,
+ *       keyed with a random secret of the cache, of the passphrase, salt,
+ *       iteration count and cipher, which the cache does not keep. A key
+ *       is cleared when evicted, the least recently used first, and all
+ *       of them when the pool is cleaned up. The memory locks are not
+ *       inherited by the processes forked.
+ * @param cache The cache returned.
+ * @param max The maximum number of keys kept.
+ * @param f The context whose driver derives the keys and computes the
+ *        HMACs, see apr_crypto_hmac().
+ * @param p The pool to use.
+ * @return APR_EINVAL if max is zero.
+ * @return APR_ENOTIMPL if the driver does not support apr_crypto_hmac().
+ * @return The error of locking the memory, if it cannot be locked, in
+ *         particular beyond the limit of the locked memory of the process.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_key_cache_create(
+        apr_crypto_key_cache_t **cache, apr_size_t max,
+        const apr_crypto_t *f, apr_pool_t *p);
+
+/**
+ * @brief Create a key like apr_crypto_key(), the key of a record of type
+ *        APR_CRYPTO_KTYPE_PASSPHRASE being derived once and then taken
+ *        from the cache.
+ * @note The key is the one apr_crypto_key() would create with the same
+ *       record, PBKDF2 with HMAC-SHA1, and can be used in the same way.
+ *       The other records are given to apr_crypto_key(), as the records
+ *       of a passphrase when *key is not NULL.
+ * @param key The key returned, see apr_crypto_key().
+ * @param rec The key record, from which the key will be derived.
+ * @param cache The cache to use.
+ * @param p The pool to use.
+ * @return The errors of apr_crypto_key().
+ */
+APR_DECLARE(apr_status_t) apr_crypto_key_cached(apr_crypto_key_t **key,
+        const apr_crypto_key_rec_t *rec, apr_crypto_key_cache_t *cache,
+        apr_pool_t *p);
+
+/**
+ * @brief Clear and evict all the keys of a cache.
+ * @param cache The cache to clear.
+ */
+APR_DECLARE(void) apr_crypto_key_cache_clear(apr_crypto_key_cache_t *cache);
+
 /**
  * @brief Initialise a context for encrypting arbitrary data using the given key.
  * @note If *ctx is NULL, a apr_crypto_block_t will be created from a pool. If
@@ -782,7 +853,8 @@ APR_DECLARE(apr_status_t) apr_crypto_block_encrypt(unsigned char **out,
  *       same buffer used by apr_crypto_block_encrypt, offset by the
  *       number of bytes returned as actually written by the
  *       apr_crypto_block_encrypt() call. After this call, the context
- *       is cleaned and can be reused by apr_crypto_block_encrypt_init().
+ *       can be reused by apr_crypto_block_encrypt_init() or
+ *       apr_crypto_block_reset().
  * @param out Address of a buffer to which data will be written. This
  *            buffer must already exist, and is usually the same
  *            buffer used by apr_crypto_block_encrypt(). See note.
@@ -845,7 +917,8 @@ APR_DECLARE(apr_status_t) apr_crypto_block_decrypt(unsigned char **out,
  *       same buffer used by apr_crypto_block_decrypt, offset by the
  *       number of bytes returned as actually written by the
  *       apr_crypto_block_decrypt() call. After this call, the context
- *       is cleaned and can be reused by apr_crypto_block_decrypt_init().
+ *       can be reused by apr_crypto_block_decrypt_init() or
+ *       apr_crypto_block_reset().
  * @param out Address of a buffer to which data will be written. This
  *            buffer must already exist, and is usually the same
  *            buffer used by apr_crypto_block_decrypt(). See note.
@@ -868,6 +941,180 @@ APR_DECLARE(apr_status_t) apr_crypto_block_decrypt_finish(unsigned char *out,
  */
 APR_DECLARE(apr_status_t) apr_crypto_block_cleanup(apr_crypto_block_t *ctx);
 
+/**
+ * @brief Reset an encryption or decryption context to process a new
+ *        message with the same key and direction, but a new IV.
+ * @note This avoids the allocation of a context and the key schedule of
+ *       apr_crypto_block_encrypt_init() or apr_crypto_block_decrypt_init()
+ *       for each message, and may be called at any time after them,
+ *       including after the context was finished.
+ * @param ctx The block context to reset.
+ * @param iv The new initialisation vector, of the size given by the key,
+ *           or NULL if the mode has none.
+ * @return APR_ENOIV if an initialisation vector is required but not specified.
+ * @return APR_EINIT if the context was never initialised, or the backend
+ *         failed to reinitialise it.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_block_reset(apr_crypto_block_t *ctx,
+        const unsigned char *iv);
+
+/**
+ * @brief Encrypt and authenticate a message in one call, with a key of
+ *        mode APR_MODE_GCM or APR_MODE_POLY1305.
+ * @note The ciphertext is written to out followed by the authentication
+ *       tag of APR_CRYPTO_AEAD_TAGSIZE bytes, so out must have room for
+ *       inlen + APR_CRYPTO_AEAD_TAGSIZE bytes. If out is NULL, outlen
+ *       will contain that size. If *ctx is NULL, a apr_crypto_block_t
+ *       will be created from the pool, otherwise it is reused, keeping
+ *       the key schedule across the calls made with the same key.
+ * @param ctx The block context to use, see note.
+ * @param out The buffer to which the sealed message will be written.
+ * @param outlen Length of the output will be written here.
+ * @param in Address of the message to seal.
+ * @param inlen Length of the message.
+ * @param aad Additional data to authenticate but not encrypt, or NULL.
+ * @param aadlen Length of the additional data.
+ * @param iv The initialisation vector (nonce) of the size given by the
+ *           key. It must never be used twice with the same key.
+ * @param key The key structure to use.
+ * @param p The pool to use.
+ * @return APR_ENOIV if the initialisation vector is not specified.
+ * @return APR_ENOCIPHER if the key is not an AEAD key.
+ * @return APR_EINIT if the backend failed to initialise the context.
+ * @return APR_ECRYPT if an error occurred.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_aead_seal(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p);
+
+/**
+ * @brief Verify and decrypt a message sealed by apr_crypto_aead_seal().
+ * @note The plaintext, of inlen - APR_CRYPTO_AEAD_TAGSIZE bytes, is
+ *       written to out. If out is NULL, outlen will contain that size.
+ *       When the message does not authenticate, out is cleared.
+ * @param ctx The block context to use, see apr_crypto_aead_seal().
+ * @param out The buffer to which the plaintext will be written.
+ * @param outlen Length of the output will be written here.
+ * @param in Address of the sealed message, ciphertext and tag.
+ * @param inlen Length of the sealed message.
+ * @param aad The additional data given when sealing, or NULL.
+ * @param aadlen Length of the additional data.
+ * @param iv The initialisation vector given when sealing.
+ * @param key The key structure to use.
+ * @param p The pool to use.
+ * @return APR_ENOVERIFY if the message or the additional data was
+ *         tampered with, or is too short to hold a tag.
+ * @return APR_ENOIV if the initialisation vector is not specified.
+ * @return APR_ENOCIPHER if the key is not an AEAD key.
+ * @return APR_EINIT if the backend failed to initialise the context.
+ * @return APR_ECRYPT if an error occurred.
+ * @return APR_ENOTIMPL if not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_aead_open(apr_crypto_block_t **ctx,
+        unsigned char *out, apr_size_t *outlen,
+        const unsigned char *in, apr_size_t inlen,
+        const unsigned char *aad, apr_size_t aadlen,
+        const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p);
+
+/**
+ * Structure representing a streaming encryption or decryption of brigades.
+ *
+ * This structure is created using the apr_crypto_brigade_create() function.
+ */
+typedef struct apr_crypto_brigade_t apr_crypto_brigade_t;
+
+/**
+ * Decrypt rather than encrypt, see apr_crypto_brigade_create().
+ */
+#define APR_CRYPTO_BRIGADE_DECRYPT 0x01
+
+/**
+ * Frame the stream in chunks sealed by apr_crypto_aead_seal(), see
+ * apr_crypto_brigade_create().
+ */
+#define APR_CRYPTO_BRIGADE_AEAD    0x02
+
+/**
+ * The default size of the chunks of the AEAD framing.
+ */
+#define APR_CRYPTO_BRIGADE_CHUNK_DEFAULT (16 * 1024)
+
+/**
+ * @brief Create a streaming encryption (or decryption) of brigades.
+ * @note Without APR_CRYPTO_BRIGADE_AEAD, the stream is processed with the
+ *       block functions, a key of mode ECB or CBC and its padding.
+ * @note With APR_CRYPTO_BRIGADE_AEAD, the stream is cut in chunks of
+ *       @a chunk bytes sealed one after the other with an AEAD key, the
+ *       last one being shorter, possibly empty. Each chunk is
+ *       followed by its tag, and is sealed with the IV xor'ed with its
+ *       index (big-endian in the last eight bytes) and a byte of
+ *       additional data set when it is the last chunk, so that any
+ *       change, truncation or reordering of the stream is detected.
+ * @param ctx The new streaming context.
+ * @param key The key structure to use.
+ * @param iv The initialisation vector of the stream, of the size given by
+ *           the key, or APR_CRYPTO_AEAD_IVSIZE bytes for the AEAD framing.
+ *           It must never be used twice with the same key.
+ * @param chunk The size of the chunks of the AEAD framing, zero for
+ *              APR_CRYPTO_BRIGADE_CHUNK_DEFAULT. Unused otherwise.
+ * @param flags APR_CRYPTO_BRIGADE_DECRYPT and/or APR_CRYPTO_BRIGADE_AEAD.
+ * @param list The bucket allocator of the output buckets.
+ * @param p The pool to allocate the context from.
+ * @return APR_EINVAL if a parameter is out of range, or the errors of
+ *         the apr_crypto_block_*_init() functions.
+ * @remark @a list must remain valid until @a p is cleared.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_brigade_create(apr_crypto_brigade_t **ctx,
+        const apr_crypto_key_t *key, const unsigned char *iv,
+        apr_size_t chunk, apr_uint32_t flags, apr_bucket_alloc_t *list,
+        apr_pool_t *p);
+
+/**
+ * @brief Encrypt (or decrypt) the buckets of a brigade into another.
+ * @param ctx The streaming context.
+ * @param out The brigade to append the output buckets to.
+ * @param in The brigade to consume.
+ * @param block Whether the reads of @a in should block.
+ * @return APR_SUCCESS once @a in is empty, APR_EAGAIN if a nonblocking
+ *         read would block (the remaining buckets are left in @a in),
+ *         APR_INCOMPLETE if an EOS bucket ends a truncated stream,
+ *         APR_ENOVERIFY if a chunk does not authenticate, APR_EPADDING
+ *         if the padding is wrong, or another error code if a read or the
+ *         encryption fails.
+ * @remark Whatever the size of the stream, the memory used is that of a
+ *         working buffer of APR_BUCKET_BUFF_SIZE bytes, or of a chunk of
+ *         the AEAD framing, the output being passed on in HEAP buckets
+ *         as soon as they are full.
+ * @remark Metadata buckets are moved to @a out after the output they
+ *         follow. An EOS bucket ends the stream, after which
+ *         apr_crypto_brigade_reset() must be called before the next one.
+ *         A FLUSH bucket passes on what's complete, but not the partial
+ *         blocks or chunks that more input may follow.
+ * @remark When decrypting with the AEAD framing, no plaintext is passed
+ *         on before its chunk authenticates, yet only the EOS bucket
+ *         tells that the stream is complete: the consumer must not act
+ *         on the plaintext of a stream that fails.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_brigade_process(apr_crypto_brigade_t *ctx,
+        apr_bucket_brigade *out, apr_bucket_brigade *in,
+        apr_read_type_e block);
+
+/**
+ * @brief Reset a streaming context to encrypt (or decrypt) a new stream
+ *        with a new IV, discarding the current one.
+ * @param ctx The streaming context.
+ * @param iv The initialisation vector of the new stream.
+ * @return APR_SUCCESS, or the errors of apr_crypto_block_reset().
+ * @remark This allows to reuse the context (and its key schedule) across
+ *         streams.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_brigade_reset(apr_crypto_brigade_t *ctx,
+        const unsigned char *iv);
+
 /**
  * @brief Initialise a context for hashing, signing or verifying arbitrary
  *        data.
@@ -888,7 +1135,9 @@ APR_DECLARE(apr_status_t) apr_crypto_block_cleanup(apr_crypto_block_t *ctx);
  *        structure will be modified by each digest operation, and cannot be
  *        shared.
  * @note If *d is NULL, a apr_crypto_digest_t will be created from a pool. If
- *       *d is not NULL, *d must point at a previously created structure.
+ *       *d is not NULL, *d must point at a previously created structure,
+ *       whose backend context is then reset and reused. The keyed state of
+ *       HMAC and CMAC keys is computed once by the key, and copied here.
  * @param d The digest context returned, see note.
  * @param key The key structure to use.
  * @param rec The digest record indicating whether we want to sign or verify.
@@ -957,6 +1206,29 @@ APR_DECLARE(apr_status_t) apr_crypto_digest(const apr_crypto_key_t *key,
         apr_crypto_digest_rec_t *rec, const unsigned char *in, apr_size_t inlen,
         apr_pool_t *p);
 
+/**
+ * @brief One shot HMAC or CMAC of a single memory buffer, written to a
+ *        buffer of the caller.
+ * @note The key keeps the keyed state of the MAC computed once, and the
+ *       contexts used by previous calls, so this call does not allocate
+ *       from a pool and is safe to use from several threads with the same
+ *       key. If out is NULL, outlen will contain the size of the MAC.
+ * @param key The key structure to use, of type APR_CRYPTO_KTYPE_HMAC or
+ *        APR_CRYPTO_KTYPE_CMAC.
+ * @param in Address of the buffer to authenticate.
+ * @param inlen Length of the buffer to authenticate.
+ * @param out The buffer to which the MAC will be written.
+ * @param outlen On entry the size of out, on return the length of the MAC.
+ * @return APR_ENOSPACE if out is too small for the MAC, whose length is
+ *         returned in outlen.
+ * @return APR_ECRYPT if an error occurred.
+ * @return APR_ENOTIMPL if not implemented.
+ * @return APR_EINVAL if the key type does not support the given operation.
+ */
+APR_DECLARE(apr_status_t) apr_crypto_hmac(const apr_crypto_key_t *key,
+        const unsigned char *in, apr_size_t inlen,
+        unsigned char *out, apr_size_t *outlen);
+
 /**
  * @brief Clean digest context.
  * @note After cleanup, a digest context is free to be reused if necessary.
@@ -1053,6 +1325,11 @@ APR_DECLARE(apr_status_t) apr_crypto_random_bytes(void *buf, apr_size_t len);
  * @brief Generate cryptographically secure random bytes from the CPRNG of
  *        the current thread.
  *
+ * @remark The keystream is pre-generated in a per-thread buffer of 4KB,
+ *         so small requests take no lock and amount to a copy. After
+ *         \ref apr_crypto_prng_after_fork() for the global CPRNG, each
+ *         per-thread CPRNG is reseeded on its next use.
+ *
  * @param buf The destination buffer
  * @param len The destination length
  * @return APR_EINIT if \ref apr_crypto_prng_init() was not called or
@@ -1124,7 +1401,8 @@ APR_DECLARE(apr_status_t) apr_crypto_prng_reseed(apr_crypto_prng_t *cprng,
  * @brief Rekey a CPRNG in the parent and/or child process after a fork(),
  *        so that they don't share the same state.
  *
- * @param cprng The CPRNG, or NULL for all the created CPRNGs (but per-thread).
+ * @param cprng The CPRNG, or NULL for all the created CPRNGs (the per-thread
+ *              ones reseed on their next use).
  * @param in_child Whether in the child process (non zero), or in the parent
  *                 process otherwise (zero).
  *
@@ -99,6 +99,9 @@ APR_DECLARE(void) apr_cstr_split_append(apr_array_header_t *array,
 /** Return @c TRUE iff @a str matches any of the elements of @a list, a list
  * of zero or more glob patterns.
  *
+ * @remark The patterns are interpreted anew for each call, see
+ * apr_fnmatch_list_compile() to match many strings against the same list.
+ *
  * @since New in 1.6
  */
 APR_DECLARE(int) apr_cstr_match_glob_list(const char *str,
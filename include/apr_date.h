@@ -98,6 +98,18 @@ APR_DECLARE(apr_time_t) apr_date_parse_http(const char *date);
  */
 APR_DECLARE(apr_time_t) apr_date_parse_rfc(const char *date);
 
+/**
+ * Format a time as an RFC 822 date like apr_rfc822_date(), reusing the
+ * date of the same second when it was formatted recently.
+ * @param date_str String to write to, at least APR_RFC822_DATE_LEN bytes
+ * @param t The time to format
+ * @remark The recent dates are cached for the whole process, without
+ *         locks, which suits the Date headers and the like of a server
+ *         where most threads format the current second.
+ */
+APR_DECLARE(apr_status_t) apr_date_rfc822_recent(char *date_str,
+                                                 apr_time_t t);
+
 /** @} */
 #ifdef __cplusplus
 }
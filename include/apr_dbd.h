@@ -23,6 +23,7 @@
 
 #include "apu.h"
 #include "apr_pools.h"
+#include "apr_network_io.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -85,6 +86,8 @@ typedef struct apr_dbd_transaction_t apr_dbd_transaction_t;
 typedef struct apr_dbd_results_t apr_dbd_results_t;
 typedef struct apr_dbd_row_t apr_dbd_row_t;
 typedef struct apr_dbd_prepared_t apr_dbd_prepared_t;
+typedef struct apr_dbd_stmt_cache_t apr_dbd_stmt_cache_t;
+typedef struct apr_dbd_bulk_t apr_dbd_bulk_t;
 
 /** apr_dbd_init: perform once-only initialisation.  Call once only.
  *
@@ -122,9 +125,12 @@ APR_DECLARE(apr_status_t) apr_dbd_get_driver(apr_pool_t *pool, const char *name,
  *  @remarks SQLite3: the params is passed directly to the sqlite3_open()
  *  function as a filename to be opened (check SQLite3 documentation for more
  *  details).
- *  @remarks Oracle: the params can have "user", "pass", "dbname" and "server"
- *  keys, each followed by an equal sign and a value. Such key/value pairs can
- *  be delimited by space, CR, LF, tab, semicolon, vertical bar or comma.
+ *  @remarks Oracle: the params can have "user", "pass", "dbname", "server",
+ *  "prefetch" and "batch" keys, each followed by an equal sign and a value.
+ *  Such key/value pairs can be delimited by space, CR, LF, tab, semicolon,
+ *  vertical bar or comma. "prefetch" is the number of rows a select fetches
+ *  from the server at once (1 by default), and "batch" the number of rows a
+ *  bulk load sends at once (100 by default).
  *  @remarks MySQL: the params can have "host", "port", "user", "pass",
  *  "dbname", "sock", "flags" "fldsz", "group" and "reconnect" keys, each
  *  followed by an equal sign and a value. Such key/value pairs can be
@@ -136,6 +142,13 @@ APR_DECLARE(apr_status_t) apr_dbd_get_driver(apr_pool_t *pool, const char *name,
  *  "group" determines which group from configuration file to use (see
  *  MYSQL_READ_DEFAULT_GROUP option of mysql_options() in MySQL manual).
  *  Reconnect is set to 1 by default (i.e. true).
+ *  @remarks ODBC: the params can have "CONNECT" (a connection string) or
+ *  "DATASOURCE", "USER", "PASSWORD", "BUFSIZE", "ACCESS", "CTIMEOUT",
+ *  "STIMEOUT", "TXMODE", "FETCHSIZE" and "BATCHSIZE" keys, each followed by
+ *  an equal sign and a value. "FETCHSIZE" is the number of rows a select
+ *  without random access fetches at once, when all its columns can be bound
+ *  (1 by default), and "BATCHSIZE" the number of rows a bulk load sends at
+ *  once (100 by default).
  *  @remarks FreeTDS: the params can have "username", "password", "appname",
  *  "dbname", "host", "charset", "lang" and "server" keys, each followed by an
  *  equal sign and a value.
@@ -285,6 +298,10 @@ APR_DECLARE(int) apr_dbd_query(const apr_dbd_driver_t *driver, apr_dbd_t *handle
  *                  0 to support only looping through results in order
  *                    (async access - faster)
  *  @return 0 for success or error code
+ *  @remark Without random access the rows are streamed from the server
+ *  (mysql, pgsql and sqlite3), in constant memory: a row stays valid until
+ *  the next one is fetched, and the results must be read to the end or
+ *  their pool cleared before the connection runs another query.
  */
 APR_DECLARE(int) apr_dbd_select(const apr_dbd_driver_t *driver, apr_pool_t *pool,
                                 apr_dbd_t *handle, apr_dbd_results_t **res,
@@ -538,11 +555,188 @@ APR_DECLARE_NONSTD(int) apr_dbd_pvbselect(const apr_dbd_driver_t *driver,
  *  @param type - type of data to get
  *  @param data - pointer to data, allocated by the caller
  *  @return APR_SUCCESS on success, APR_ENOENT if data is NULL or APR_EGENERAL
+ *  @remark Numeric types are converted from the column's native value where
+ *  the driver keeps one (sqlite3), rather than parsed back from its text.
  */
 APR_DECLARE(apr_status_t) apr_dbd_datum_get(const apr_dbd_driver_t *driver,
                                             apr_dbd_row_t *row, int col,
                                             apr_dbd_type_e type, void *data);
 
+/** apr_dbd_send_query: send a prepared statement + args to be executed,
+ *  without waiting for its result
+ *
+ *  @param driver - the driver
+ *  @param pool - working pool
+ *  @param handle - the connection
+ *  @param statement - the prepared statement to execute
+ *  @param args - args to prepared statement
+ *  @return 0 for success, APR_ENOTIMPL if the driver can not have queries
+ *  in flight, or error code
+ *  @remark Several queries may be sent before their results are collected
+ *  in the same order with apr_dbd_poll_result(), the other query functions
+ *  not being usable on the connection until then.  Sending may still block
+ *  while the connection can not take any more.
+ *  @remark Not supported inside a transaction ignoring errors.
+ */
+APR_DECLARE(int) apr_dbd_send_query(const apr_dbd_driver_t *driver,
+                                    apr_pool_t *pool, apr_dbd_t *handle,
+                                    apr_dbd_prepared_t *statement,
+                                    const char **args);
+
+/** apr_dbd_poll_result: get the result of the oldest query sent with
+ *  apr_dbd_send_query()
+ *
+ *  @param driver - the driver
+ *  @param pool - working pool, for the results
+ *  @param handle - the connection
+ *  @param res - pointer to query results, set if the query returned a
+ *  result set and random-access.  May be NULL, or point to NULL on entry
+ *  @param nrows - number of rows affected or returned.  May be NULL
+ *  @param block - whether to wait for the result if it is not there yet
+ *  @return 0 for success, APR_EAGAIN if not blocking and the result is not
+ *  there yet, APR_EOF if no query is in flight, APR_ENOTIMPL if the driver
+ *  can not have queries in flight, or the error code of the query
+ */
+APR_DECLARE(int) apr_dbd_poll_result(const apr_dbd_driver_t *driver,
+                                     apr_pool_t *pool, apr_dbd_t *handle,
+                                     apr_dbd_results_t **res, int *nrows,
+                                     int block);
+
+/** apr_dbd_socket_get: get the socket of a connection, readable when
+ *  apr_dbd_poll_result() has something to read, to add to an apr_pollset
+ *
+ *  @param driver - the driver
+ *  @param pool - the pool to allocate the socket from
+ *  @param handle - the connection
+ *  @param sock - the socket, still owned by the connection
+ *  @return APR_SUCCESS, or APR_ENOTIMPL if the driver can not have queries
+ *  in flight
+ */
+APR_DECLARE(apr_status_t) apr_dbd_socket_get(const apr_dbd_driver_t *driver,
+                                             apr_pool_t *pool,
+                                             apr_dbd_t *handle,
+                                             apr_socket_t **sock);
+
+/** apr_dbd_stmt_cache_create: create a cache of the statements prepared
+ *  on a connection, keyed by their SQL and label
+ *
+ *  @param cache - the new cache
+ *  @param driver - the driver
+ *  @param handle - the connection
+ *  @param max - the number of unlabelled statements to keep (at least
+ *  one), the least recently used ones being dropped beyond that
+ *  @param pool - the pool the statements are prepared from, which must not
+ *  outlive the connection
+ *  @return APR_SUCCESS or error code
+ *  @remark Statements prepared with a label are kept until the cache is
+ *  cleared, for their labels name them on the server for some drivers.
+ *  @remark Like the connection, the cache is not to be used by several
+ *  threads at once.
+ */
+APR_DECLARE(apr_status_t) apr_dbd_stmt_cache_create(
+                                            apr_dbd_stmt_cache_t **cache,
+                                            const apr_dbd_driver_t *driver,
+                                            apr_dbd_t *handle,
+                                            apr_size_t max,
+                                            apr_pool_t *pool);
+
+/** apr_dbd_stmt_cache_prepare: get a statement from the cache, preparing
+ *  it the first time as apr_dbd_prepare() would
+ *
+ *  @param cache - the cache
+ *  @param query - the SQL query
+ *  @param label - A label for the prepared statement, or NULL
+ *  @param statement - the prepared statement
+ *  @return 0 for success or error code
+ *  @remark The statement remains valid until it is dropped from the
+ *  cache, so until the next call for an unlabelled one.
+ */
+APR_DECLARE(int) apr_dbd_stmt_cache_prepare(apr_dbd_stmt_cache_t *cache,
+                                            const char *query,
+                                            const char *label,
+                                            apr_dbd_prepared_t **statement);
+
+/** apr_dbd_stmt_cache_pvquery: query by SQL with a cached prepared
+ *  statement + args, as apr_dbd_pvquery() would
+ *
+ *  @param cache - the cache
+ *  @param pool - working pool
+ *  @param nrows - number of rows affected.
+ *  @param query - the SQL query, as for apr_dbd_prepare()
+ *  @param ... - varargs list
+ *  @return 0 for success or error code
+ */
+APR_DECLARE_NONSTD(int) apr_dbd_stmt_cache_pvquery(
+                                            apr_dbd_stmt_cache_t *cache,
+                                            apr_pool_t *pool, int *nrows,
+                                            const char *query, ...);
+
+/** apr_dbd_stmt_cache_pvselect: select by SQL with a cached prepared
+ *  statement + args, as apr_dbd_pvselect() would
+ *
+ *  @param cache - the cache
+ *  @param pool - working pool
+ *  @param res - pointer to query results.  May point to NULL on entry
+ *  @param query - the SQL query, as for apr_dbd_prepare()
+ *  @param random - Whether to support random-access to results
+ *  @param ... - varargs list
+ *  @return 0 for success or error code
+ */
+APR_DECLARE_NONSTD(int) apr_dbd_stmt_cache_pvselect(
+                                            apr_dbd_stmt_cache_t *cache,
+                                            apr_pool_t *pool,
+                                            apr_dbd_results_t **res,
+                                            const char *query,
+                                            int random, ...);
+
+/** apr_dbd_stmt_cache_clear: drop all the statements of a cache, when
+ *  the connection was reset or its statements deallocated
+ *
+ *  @param cache - the cache
+ */
+APR_DECLARE(void) apr_dbd_stmt_cache_clear(apr_dbd_stmt_cache_t *cache);
+
+/** apr_dbd_bulk_begin: start loading rows into a table in bulk
+ *
+ *  @param driver - the driver
+ *  @param pool - pool for the load, until apr_dbd_bulk_end()
+ *  @param handle - the connection
+ *  @param table - the table, as it is to appear in SQL (not escaped)
+ *  @param cols - the columns to give values for, as they are to appear in
+ *                SQL, or NULL for all of them in the table's order
+ *  @param ncols - the number of columns
+ *  @param bulk - the load
+ *  @return 0 for success or error code
+ *  @remark The pgsql driver streams the rows with COPY FROM STDIN.  The
+ *  others insert them with a statement prepared once, all in a transaction
+ *  of their own: the connection must not have one open.  The odbc and
+ *  oracle drivers send the rows by batches bound as arrays, see the
+ *  "BATCHSIZE" and "batch" parameters of apr_dbd_open_ex().  Either way the
+ *  connection is not to be used for anything else until the load ends.
+ */
+APR_DECLARE(int) apr_dbd_bulk_begin(const apr_dbd_driver_t *driver,
+                                    apr_pool_t *pool, apr_dbd_t *handle,
+                                    const char *table, const char **cols,
+                                    int ncols, apr_dbd_bulk_t **bulk);
+
+/** apr_dbd_bulk_append_row: add a row to a bulk load
+ *
+ *  @param bulk - the load
+ *  @param values - the ncols values of the row, as text, NULL for SQL NULL
+ *  @return 0 for success or error code, the load then failing as a whole
+ */
+APR_DECLARE(int) apr_dbd_bulk_append_row(apr_dbd_bulk_t *bulk,
+                                         const char **values);
+
+/** apr_dbd_bulk_end: end a bulk load, committing its rows unless one of
+ *  them failed
+ *
+ *  @param bulk - the load
+ *  @param nrows - number of rows loaded
+ *  @return 0 for success or error code, no row being loaded then
+ */
+APR_DECLARE(int) apr_dbd_bulk_end(apr_dbd_bulk_t *bulk, int *nrows);
+
 /** @} */
 
 #ifdef __cplusplus
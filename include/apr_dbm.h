@@ -92,6 +92,7 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **driver,
  *  gdbm for GDBM files
  *  ndbm for NDBM files
  *  sdbm for SDBM files (always available)
+ *  cdb  for constant databases (always available)
  *  default for the default DBM type
  *  </pre>
  * @param name The dbm file name to open
@@ -106,6 +107,12 @@ APR_DECLARE(apr_status_t) apr_dbm_get_driver(const apr_dbm_driver_t **driver,
  * @param cntxt The pool to use when creating the dbm
  * @remark The dbm name may not be a true file name, as many dbm packages
  * append suffixes for seperate data and index files.
+ * @remark A cdb database is mapped into memory when opened read-only, and
+ * looked up through a perfect hash, the data fetched pointing into the
+ * mapping until the database is closed.  Opened for writing, its records
+ * are held in memory and the whole file written anew when it is closed,
+ * to a temporary file then renamed over it, so that readers opening it
+ * meanwhile see either the previous or the new one, never a mix.
  * @bug In apr-util 0.9 and 1.x, the type arg was case insensitive.  This
  * was highly inefficient, and as of 2.x the dbm name must be provided in
  * the correct case (lower case for all bundled providers)
@@ -181,6 +188,34 @@ APR_DECLARE(apr_status_t) apr_dbm_fetch(apr_dbm_t *dbm, apr_datum_t key,
 APR_DECLARE(apr_status_t) apr_dbm_store(apr_dbm_t *dbm, apr_datum_t key, 
                                         apr_datum_t value);
 
+/**
+ * Callback supplying the records to apr_dbm_bulk_load, one per call
+ * @param baton The baton given to apr_dbm_bulk_load
+ * @param key The key datum of the next record
+ * @param value The value datum of the next record
+ * @return APR_SUCCESS with the next record, APR_EOF after the last one,
+ * or an error aborting the load
+ * @remark The data need only stay valid until the next call.
+ */
+typedef apr_status_t (apr_dbm_bulk_next_fn_t)(void *baton, apr_datum_t *key,
+                                              apr_datum_t *value);
+
+/**
+ * Store many records at once, as apr_dbm_store would each of them
+ * @param dbm The database 
+ * @param next The callback supplying the records, in any order
+ * @param baton The baton passed to the callback
+ * @remark The sdbm driver rebuilds its files from all the records in
+ * memory, in large sequential writes under a single lock, leaving the
+ * database untouched should a record be invalid or the callback fail.
+ * The cdb driver adds the records to those held in memory and writes the
+ * file at once, returning any error in doing so, which apr_dbm_close
+ * can not.  The other drivers store the records one by one as they come.
+ */
+APR_DECLARE(apr_status_t) apr_dbm_bulk_load(apr_dbm_t *dbm,
+                                            apr_dbm_bulk_next_fn_t *next,
+                                            void *baton);
+
 /**
  * Delete a dbm record value by key
  * @param dbm The database 
@@ -23,6 +23,7 @@
 
 #include "apr.h"
 #include "apr_general.h"
+#include "apr_buckets.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -642,6 +643,105 @@ APR_DECLARE(const unsigned char *)apr_pdecode_base16_binary(apr_pool_t * p,
         const char *src, apr_ssize_t slen, int flags, apr_size_t * len)
         __attribute__((nonnull(1)));
 
+/**
+ * Opaque streaming base64 encoder or decoder, converting its input chunk
+ * by chunk
+ */
+typedef struct apr_encode_stream_t apr_encode_stream_t;
+
+/**
+ * Create a streaming base64 encoder.
+ * @param ctx The new encoder.
+ * @param flags If APR_ENCODE_NONE, emit RFC4648 Base 64 Encoding. If
+ *  APR_ENCODE_NOPADDING, omit the = padding character. If APR_ENCODE_URL,
+ *  use RFC4648 Base 64 Encoding with URL and Filename Safe Alphabet.
+ *  If APR_ENCODE_BASE64URL, use RFC7515 base64url Encoding.
+ * @param wrap The length of the lines to break the encoding into with
+ *  CRLFs, like 76 for MIME (RFC2045) or 64 for PEM (RFC7468), or zero
+ *  for a single line.
+ * @param p The pool to allocate the encoder from.
+ * @return APR_SUCCESS, or APR_EINVAL if \c flags has other flags or
+ *  \c wrap is not a multiple of 4.
+ */
+APR_DECLARE(apr_status_t) apr_encode_base64_stream_create(
+        apr_encode_stream_t **ctx, int flags, apr_size_t wrap, apr_pool_t *p)
+        __attribute__((nonnull(1,4)));
+
+/**
+ * Create a streaming base64 decoder.
+ * @param ctx The new decoder.
+ * @param flags If APR_ENCODE_NONE, parse RFC4648 Base 64 Encoding (with
+ *  either alphabet), failing on the first invalid character. If
+ *  APR_ENCODE_RELAXED, stop decoding at the first invalid character and
+ *  ignore the rest of the stream.
+ * @param p The pool to allocate the decoder from.
+ * @return APR_SUCCESS, or APR_EINVAL if \c flags has other flags.
+ * @remark Whitespace (spaces, tabs, CRs and LFs) is skipped, so that the
+ *  wrapped lines of MIME or PEM can be decoded, and the padding is
+ *  optional.
+ */
+APR_DECLARE(apr_status_t) apr_decode_base64_stream_create(
+        apr_encode_stream_t **ctx, int flags, apr_pool_t *p)
+        __attribute__((nonnull(1,3)));
+
+/**
+ * Convert the next chunk of a stream.
+ * @param ctx The encoder or decoder.
+ * @param dest The destination buffer, or NULL to compute the maximum
+ *  length of the output for \c slen bytes of input.
+ * @param src The chunk, can be NULL if \c dest is NULL.
+ * @param slen The length of the chunk.
+ * @param len Outputs the maximum length of the output if \c dest is NULL,
+ *  or the actual length of the output otherwise (no NUL is written).
+ * @return APR_SUCCESS, or APR_BADCH if the decoder finds an invalid
+ *  character, \c len being what was decoded before it.
+ * @remark The incomplete base64 quantum that ends the chunk, if any, is
+ *  kept by \c ctx to complete with the next chunk or
+ *  apr_encode_stream_finish().
+ */
+APR_DECLARE(apr_status_t) apr_encode_stream_update(apr_encode_stream_t *ctx,
+        char *dest, const char *src, apr_size_t slen, apr_size_t *len)
+        __attribute__((nonnull(1,5)));
+
+/**
+ * Finish a stream, converting the last quantum kept by the encoder or
+ * decoder, and reset it for the next stream.
+ * @param ctx The encoder or decoder.
+ * @param dest The destination buffer, or NULL to compute the maximum
+ *  length of the output.
+ * @param len Outputs the maximum length of the output if \c dest is NULL,
+ *  or the actual length of the output otherwise (no NUL is written).
+ * @return APR_SUCCESS, or APR_EINCOMPLETE if the decoder is left with a
+ *  single character.
+ * @remark When wrapping, the encoder ends the last line with a CRLF.
+ */
+APR_DECLARE(apr_status_t) apr_encode_stream_finish(apr_encode_stream_t *ctx,
+        char *dest, apr_size_t *len)
+        __attribute__((nonnull(1,3)));
+
+/**
+ * Encode (or decode) the buckets of a brigade into another, with bounded
+ * memory.
+ * @param ctx The encoder or decoder.
+ * @param out The brigade to append the output buckets to.
+ * @param in The brigade to consume.
+ * @param block Whether the reads of \c in should block.
+ * @return APR_SUCCESS once \c in is empty, APR_EAGAIN if a nonblocking
+ *  read would block (the remaining buckets are left in \c in), or an
+ *  error code of a read, apr_encode_stream_update() or
+ *  apr_encode_stream_finish().
+ * @remark The output is produced in HEAP buckets of APR_BUCKET_BUFF_SIZE
+ *  bytes, and the last one of a stream is kept by \c ctx until more
+ *  input fills it or a metadata bucket is found.
+ * @remark Metadata buckets are moved to \c out after the output they
+ *  follow, and an EOS bucket first finishes the stream with
+ *  apr_encode_stream_finish().
+ */
+APR_DECLARE(apr_status_t) apr_encode_stream_process(apr_encode_stream_t *ctx,
+        apr_bucket_brigade *out, apr_bucket_brigade *in,
+        apr_read_type_e block)
+        __attribute__((nonnull(1,2,3)));
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -0,0 +1,124 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_EPOCH_H
+#define APR_EPOCH_H
+
+/**
+ * @file apr_epoch.h
+ * @brief APR Epoch based memory reclamation
+ *
+ * @remark An epoch domain tells when the memory unlinked from a shared
+ * structure can be reclaimed, that is once no reader can still be using
+ * it.  The readers access the structure between apr_epoch_enter() and
+ * apr_epoch_exit(), without any lock, and the writers atomically unlink
+ * the memory before handing it to apr_epoch_retire().  It is reclaimed
+ * by apr_epoch_synchronize(), once all the readers entered until then
+ * have exited.
+ *
+ * A typical use is a read-mostly configuration snapshot: the readers load
+ * its pointer with apr_atomic_casptr(&ptr, NULL, NULL) inside an epoch,
+ * and a writer swaps in a new snapshot with apr_atomic_xchgptr(), then
+ * retires the pool of the old one with apr_epoch_retire_pool().
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_epoch Epoch based memory reclamation
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the epoch API */
+typedef struct apr_epoch_t apr_epoch_t;
+
+/** The token of a reader, from apr_epoch_enter() for apr_epoch_exit() */
+typedef apr_uint32_t apr_epoch_token_t;
+
+/** The function reclaiming retired memory */
+typedef apr_status_t (*apr_epoch_reclaim_fn_t)(void *data);
+
+/**
+ * Create an epoch domain
+ * @param epoch The pointer in which to return the newly created object
+ * @param p The pool from which to allocate the domain, whose cleanup
+ *          reclaims what is still retired (no reader must be left then)
+ */
+APR_DECLARE(apr_status_t) apr_epoch_create(apr_epoch_t **epoch,
+                                           apr_pool_t *p);
+
+/**
+ * Enter an epoch as a reader
+ * @param epoch The epoch domain
+ * @return The token to pass to apr_epoch_exit()
+ * @remark This never blocks, and may be nested.
+ */
+APR_DECLARE(apr_epoch_token_t) apr_epoch_enter(apr_epoch_t *epoch);
+
+/**
+ * Exit an epoch as a reader
+ * @param epoch The epoch domain
+ * @param token The token returned by the matching apr_epoch_enter()
+ * @remark The memory read since apr_epoch_enter() must not be used after
+ *         this.
+ */
+APR_DECLARE(void) apr_epoch_exit(apr_epoch_t *epoch,
+                                 apr_epoch_token_t token);
+
+/**
+ * Retire memory unlinked from a shared structure, for reclamation when no
+ * reader can use it anymore
+ * @param epoch The epoch domain
+ * @param data The memory
+ * @param reclaim The function called on @a data to reclaim it
+ * @remark The memory must not be reachable by new readers already.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_retire(apr_epoch_t *epoch, void *data,
+                                           apr_epoch_reclaim_fn_t reclaim);
+
+/**
+ * Retire a pool, for destruction when no reader can use its memory anymore
+ * @param epoch The epoch domain
+ * @param pool The pool
+ * @remark The pool and its memory must not be reachable by new readers
+ *         already.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_retire_pool(apr_epoch_t *epoch,
+                                                apr_pool_t *pool);
+
+/**
+ * Wait until the readers entered before this call have exited, then
+ * reclaim the memory retired before it
+ * @param epoch The epoch domain
+ * @remark This must not be called by a reader of the same domain, which
+ *         would wait for itself.
+ */
+APR_DECLARE(apr_status_t) apr_epoch_synchronize(apr_epoch_t *epoch);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_EPOCH_H */
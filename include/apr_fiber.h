@@ -0,0 +1,173 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_FIBER_H
+#define APR_FIBER_H
+
+/**
+ * @file apr_fiber.h
+ * @brief APR Fibers (stackful coroutines) on top of apr_pollcb_t
+ *
+ * @remark A fiber scheduler runs many fibers on the thread calling
+ * apr_fiber_sched_run(), switching between them only when a fiber waits:
+ * in apr_fiber_yield(), apr_fiber_sleep(), apr_fiber_socket_wait() and
+ * the socket functions below, which park the fiber on the scheduler's
+ * pollcb or timers instead of blocking the thread.  Code written with
+ * blocking calls thus serves many connections concurrently, e.g. the
+ * clients of backends, with no state machine.
+ *
+ * The stacks of the fibers are allocated once and reused, with a guard
+ * page where the system allows, so they must be sized for the deepest
+ * call of the fibers.
+ *
+ * Outside of a fiber, the functions behave as their blocking counterpart.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_network_io.h"
+#include "apr_poll.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_fiber Fibers
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure of a fiber scheduler */
+typedef struct apr_fiber_sched_t apr_fiber_sched_t;
+
+/** Opaque structure of a fiber */
+typedef struct apr_fiber_t apr_fiber_t;
+
+/**
+ * Function prototype of the fibers
+ * @param fiber The fiber
+ * @param baton The opaque baton given to apr_fiber_create()
+ */
+typedef void (apr_fiber_fn_t)(apr_fiber_t *fiber, void *baton);
+
+/** The default size of the fibers' stacks */
+#define APR_FIBER_STACK_SIZE (64 * 1024)
+
+/**
+ * Create a fiber scheduler
+ * @param sched The pointer in which to return the newly created object
+ * @param size The maximum number of fibers waiting for a socket at once
+ * @param stack_size The size of the fibers' stacks, or zero for
+ *                   APR_FIBER_STACK_SIZE
+ * @param p The pool from which to allocate the scheduler and the stacks
+ * @return APR_ENOTIMPL if the system can't switch contexts
+ */
+APR_DECLARE(apr_status_t) apr_fiber_sched_create(apr_fiber_sched_t **sched,
+                                                 apr_uint32_t size,
+                                                 apr_size_t stack_size,
+                                                 apr_pool_t *p);
+
+/**
+ * Create a fiber, run by the scheduler from the next switch
+ * @param fiber The pointer in which to return the fiber (may be NULL)
+ * @param sched The scheduler
+ * @param func The function run by the fiber, which ends when it returns
+ * @param baton The opaque baton passed to @a func
+ * @remark This can be called from the fibers of the scheduler, or from
+ *         its thread otherwise.  The fiber and its stack are reused once
+ *         it has ended.
+ */
+APR_DECLARE(apr_status_t) apr_fiber_create(apr_fiber_t **fiber,
+                                           apr_fiber_sched_t *sched,
+                                           apr_fiber_fn_t *func,
+                                           void *baton);
+
+/**
+ * Run the fibers of a scheduler until they have all ended
+ * @param sched The scheduler
+ * @return APR_SUCCESS, APR_EINVAL if called from a fiber, or the error
+ *         of apr_pollcb_poll()
+ */
+APR_DECLARE(apr_status_t) apr_fiber_sched_run(apr_fiber_sched_t *sched);
+
+/**
+ * Get the fiber running on the calling thread
+ * @return The fiber, or NULL if not called from a fiber
+ */
+APR_DECLARE(apr_fiber_t *) apr_fiber_current(void);
+
+/**
+ * Let the other ready fibers run before the calling one continues
+ */
+APR_DECLARE(void) apr_fiber_yield(void);
+
+/**
+ * Sleep for the given time, letting the other fibers run meanwhile
+ * @param t The time in microseconds
+ * @remark Outside of a fiber, this is apr_sleep().
+ */
+APR_DECLARE(void) apr_fiber_sleep(apr_interval_time_t t);
+
+/**
+ * Wait for a socket to be readable or writable, letting the other fibers
+ * run meanwhile
+ * @param sock The socket
+ * @param reqevents APR_POLLIN and/or APR_POLLOUT
+ * @param timeout The maximum time in microseconds to wait, or negative to
+ *                wait forever
+ * @return APR_SUCCESS, APR_TIMEUP, or the error of apr_pollcb_add()
+ */
+APR_DECLARE(apr_status_t) apr_fiber_socket_wait(apr_socket_t *sock,
+                                                apr_int16_t reqevents,
+                                                apr_interval_time_t timeout);
+
+/**
+ * Read data from a socket as apr_socket_recv(), letting the other fibers
+ * run while no data is available, up to the socket's timeout
+ * @param sock The socket
+ * @param buf The buffer to read into
+ * @param len On entry, the size of the buffer; on exit, the number of
+ *            bytes read
+ * @remark The socket is made non-blocking for the call, which is cheaper
+ *         when its timeout is not negative.
+ */
+APR_DECLARE(apr_status_t) apr_fiber_socket_recv(apr_socket_t *sock,
+                                                char *buf, apr_size_t *len);
+
+/**
+ * Send data over a socket as apr_socket_send(), letting the other fibers
+ * run while the socket is not writable, up to the socket's timeout
+ * @param sock The socket
+ * @param buf The data to send
+ * @param len On entry, the number of bytes to send; on exit, the number
+ *            of bytes sent
+ * @remark The socket is made non-blocking for the call, which is cheaper
+ *         when its timeout is not negative.
+ */
+APR_DECLARE(apr_status_t) apr_fiber_socket_send(apr_socket_t *sock,
+                                                const char *buf,
+                                                apr_size_t *len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_FIBER_H */
@@ -0,0 +1,161 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_FILE_APPENDER_H
+#define APR_FILE_APPENDER_H
+
+/**
+ * @file apr_file_appender.h
+ * @brief APR group-commit appender to a file
+ *
+ * @remark An appender lets many threads append records to a file (a log
+ * typically) without serializing on the file's lock: each record is
+ * copied into a buffer whose space is reserved with an atomic operation,
+ * the buffers being spread over the threads.  The buffers are written to
+ * the file together with a single writev(), a group commit, by a
+ * background thread or by the writer that finds its buffer full or the
+ * commit interval elapsed.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_file_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_file_appender Group-commit file appender
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the appender API */
+typedef struct apr_file_appender_t apr_file_appender_t;
+
+/** Commit from a background thread, every interval */
+#define APR_FILE_APPENDER_THREAD 0x01
+
+/**
+ * The function called after each group commit
+ * @param baton The baton given to apr_file_appender_hook_set()
+ * @param file The file appended to
+ * @param len The amount of data written by the commit
+ * @return APR_SUCCESS, or an error code returned by the next writes
+ * @remark Called with commits excluded, the function may rotate the file
+ *         (@see apr_file_rotating_manual_check), whereas a file opened
+ *         with #APR_FOPEN_ROTATING is checked for rotation by the
+ *         commits themselves.  It must not append to the appender.
+ */
+typedef apr_status_t (apr_file_appender_hook_fn_t)(void *baton,
+                                                   apr_file_t *file,
+                                                   apr_size_t len);
+
+/**
+ * Create an appender to a file
+ * @param appender The pointer in which to return the newly created object
+ * @param file The file to append to, typically opened unbuffered with
+ *             #APR_FOPEN_APPEND
+ * @param bufsize The size of each of the buffers of the appender, of
+ *                which there are 16; a larger record is written directly
+ * @param interval The longest time a record waits for its commit, or zero
+ *                 for commits only when a buffer is full or on
+ *                 apr_file_appender_flush()
+ * @param flags #APR_FILE_APPENDER_THREAD or 0
+ * @param p The pool from which to allocate the appender, and whose
+ *          cleanup commits the pending records (and stops the thread)
+ * @return APR_SUCCESS, APR_EINVAL if @a bufsize is zero or over 2GB, or if
+ *         #APR_FILE_APPENDER_THREAD is given with no @a interval, or
+ *         APR_ENOTIMPL if it is given without threads.
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_create(
+                                            apr_file_appender_t **appender,
+                                            apr_file_t *file,
+                                            apr_size_t bufsize,
+                                            apr_interval_time_t interval,
+                                            apr_int32_t flags,
+                                            apr_pool_t *p);
+
+/**
+ * Append a record
+ * @param appender The appender
+ * @param buf The record
+ * @param len The length of the record
+ * @return APR_SUCCESS, or the error of a previous commit
+ * @remark The records of a thread are written in order, and each record
+ *         in one piece.
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_write(
+                                            apr_file_appender_t *appender,
+                                            const void *buf,
+                                            apr_size_t len);
+
+/**
+ * Append a record made of several pieces
+ * @param appender The appender
+ * @param vec The pieces of the record
+ * @param nvec The number of pieces
+ * @return As apr_file_appender_write()
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_writev(
+                                            apr_file_appender_t *appender,
+                                            const struct iovec *vec,
+                                            apr_size_t nvec);
+
+/**
+ * Commit the records appended so far
+ * @param appender The appender
+ * @return APR_SUCCESS, or the error of this or a previous commit
+ */
+APR_DECLARE(apr_status_t) apr_file_appender_flush(
+                                            apr_file_appender_t *appender);
+
+/**
+ * Set the cadence at which the commits are made durable
+ * @param appender The appender
+ * @param bytes Sync the file after this amount of data is committed, or
+ *              zero
+ * @param interval Sync the file after this time elapsed since the previous
+ *                 sync, or zero
+ * @remark The file is synced with apr_file_datasync() after a commit
+ *         when either condition holds, never if both are zero (the
+ *         default).  Call apr_file_appender_flush() then
+ *         apr_file_datasync() to sync at a given point.
+ */
+APR_DECLARE(void) apr_file_appender_sync_set(apr_file_appender_t *appender,
+                                             apr_size_t bytes,
+                                             apr_interval_time_t interval);
+
+/**
+ * Set the function called after each group commit
+ * @param appender The appender
+ * @param fn The function, or NULL
+ * @param baton The argument passed to @a fn
+ */
+APR_DECLARE(void) apr_file_appender_hook_set(apr_file_appender_t *appender,
+                                           apr_file_appender_hook_fn_t *fn,
+                                           void *baton);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_FILE_APPENDER_H */
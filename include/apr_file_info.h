@@ -267,11 +267,86 @@ APR_DECLARE(apr_status_t) apr_dir_close(apr_dir_t *thedir);
 APR_DECLARE(apr_status_t) apr_dir_read(apr_finfo_t *finfo, apr_int32_t wanted,
                                        apr_dir_t *thedir);
 
+/**
+ * Read up to @a nelts next entries from the specified directory at once.
+ * @param finfos the array of file info structures filled in, as by
+ *        apr_dir_read()
+ * @param nelts the number of elements of @a finfos
+ * @param nread the number of entries read
+ * @param wanted The desired apr_finfo_t fields, as a bit flag of APR_FINFO_
+ *        values
+ * @param thedir the directory descriptor returned from apr_dir_open
+ * @remark On Linux the entries are read many at a time with getdents64(),
+ *         and those needing more than their name, type and inode are
+ *         stat'ed relative to the directory, with statx() asking for the
+ *         @a wanted fields only, instead of by their full path. Elsewhere
+ *         this loops on apr_dir_read().
+ * @remark Calls to apr_dir_read() and apr_dir_read_batch() shouldn't be
+ *         mixed on the same directory, unless apr_dir_rewind() is called
+ *         in between.
+ * @note If @c APR_INCOMPLETE is returned some entries lack some of the
+ *       @a wanted fields, and you need to check each @c finfo->valid
+ *       bitmask. When no more entries are available, APR_ENOENT is
+ *       returned and @a nread is 0; an error following some entries is
+ *       only returned by the next call.
+ */
+APR_DECLARE(apr_status_t) apr_dir_read_batch(apr_finfo_t *finfos,
+                                             apr_size_t nelts,
+                                             apr_size_t *nread,
+                                             apr_int32_t wanted,
+                                             apr_dir_t *thedir);
+
 /**
  * Rewind the directory to the first entry.
  * @param thedir the directory descriptor to rewind.
  */                        
 APR_DECLARE(apr_status_t) apr_dir_rewind(apr_dir_t *thedir);
+
+/**
+ * The function called by apr_dir_walk() for each entry.
+ * @param baton the baton given to apr_dir_walk()
+ * @param path the path of the entry, the root joined with its relative path
+ * @param finfo the entry's information, as by apr_dir_read()
+ * @param depth the depth of the entry, 0 in the root
+ * @param prune set it to non-zero not to descend into this directory
+ * @param pool a pool cleared after some entries
+ * @return APR_SUCCESS to carry on, anything else stops the walk and is
+ *         returned by apr_dir_walk()
+ */
+typedef apr_status_t (apr_dir_walk_fn_t)(void *baton, const char *path,
+                                         const apr_finfo_t *finfo,
+                                         int depth, int *prune,
+                                         apr_pool_t *pool);
+
+/** Skip the subdirectories which can't be opened or read, rather than
+ * failing the walk */
+#define APR_DIR_WALK_SKIP_ERRORS 0x01
+
+/**
+ * Walk a directory tree, calling @a fn for each entry but "." and "..",
+ * before descending into the subdirectories (not following the links).
+ * @param root the directory to walk (use / on all systems)
+ * @param wanted The desired apr_finfo_t fields, as a bit flag of APR_FINFO_
+ *        values, APR_FINFO_TYPE being always asked
+ * @param max_depth the depth of the deepest entries reported, or -1 for the
+ *        whole tree
+ * @param flags APR_DIR_WALK_SKIP_ERRORS or 0
+ * @param nthreads the number of threads walking, the caller included; the
+ *        subdirectories are handed to the others when they are idle
+ * @param fn the function called for each entry
+ * @param baton the baton given to @a fn
+ * @param pool The pool to use.
+ * @remark With more than one thread @a fn is called concurrently, and
+ *         the entries of a directory may be reported after the ones of
+ *         other directories.
+ * @remark The entries are read with apr_dir_read_batch(), and where the
+ *         system allows the subdirectories are opened relative to their
+ *         parent (openat) when walked by the same thread.
+ */
+APR_DECLARE(apr_status_t) apr_dir_walk(const char *root, apr_int32_t wanted,
+                                       int max_depth, apr_int32_t flags,
+                                       int nthreads, apr_dir_walk_fn_t *fn,
+                                       void *baton, apr_pool_t *pool);
 /** @} */
 
 /**
@@ -79,6 +79,9 @@ extern "C" {
 #define APR_FOPEN_SENDFILE_ENABLED 0x01000 /**< Advisory flag that this
                                              file should support
                                              apr_socket_sendfile operation */
+#define APR_FOPEN_NOREUSE     0x02000 /**< The data is read or written
+                                       * once, drop it from the system's
+                                       * cache behind the stream */
 #define APR_FOPEN_LARGEFILE   0x04000 /**< Platform dependent flag to enable
                                        * large file support, see WARNING below 
                                        */
@@ -94,6 +97,10 @@ extern "C" {
 #define APR_FOPEN_NONBLOCK    0x40000 /**< Platform dependent flag to enable
                                        * non blocking file io */
 
+#define APR_FOPEN_DIRECT      0x80000 /**< Platform dependent flag to
+                                       * bypass the system's cache (direct
+                                       * I/O), see WARNING below */
+
  
 
 /* backcompat */
@@ -138,8 +145,30 @@ extern "C" {
  * @def APR_FOPEN_NONBLOCK
  * @warning APR_FOPEN_NONBLOCK is not implemented on all platforms.
  * Callers should be prepared for it to fail with #APR_ENOTIMPL.
+ *
+ * @def APR_FOPEN_DIRECT
+ * @warning APR_FOPEN_DIRECT implies #APR_FOPEN_BUFFERED, with a buffer
+ * aligned as direct I/O requires (O_DIRECT), and the file's I/O goes
+ * around the system's cache only as long as it is aligned: the tail
+ * of a file, or any read or write at an unaligned offset, buffer or
+ * size, is done through the cache.  A direct I/O file should be used by
+ * one thread at a time, unless opened with #APR_FOPEN_XTHREAD.  On file
+ * systems which cannot do direct I/O, the flag is ignored by
+ * apr_file_open().  Callers should be prepared for it to fail with
+ * #APR_ENOTIMPL on platforms without direct I/O.
+ *
+ * @def APR_FOPEN_NOREUSE
+ * @warning APR_FOPEN_NOREUSE is advisory, the data read or written
+ * sequentially being dropped from the system's cache by windows of
+ * #APR_FILE_NOREUSE_WINDOW bytes with posix_fadvise(POSIX_FADV_DONTNEED)
+ * where available.  The data written is dropped once written back, the
+ * window before the current one.
  */
 
+/** The amount of data read or written between two drops of
+ * #APR_FOPEN_NOREUSE files from the system's cache */
+#define APR_FILE_NOREUSE_WINDOW (1024 * 1024)
+
 /** @} */
 
 /**
@@ -248,6 +277,10 @@ typedef struct apr_file_t         apr_file_t;
  * @li #APR_FOPEN_MANUAL_ROTATE  Enable Manual rotation
  * @li #APR_FOPEN_NONBLOCK       Platform dependent flag to enable
  *                               non blocking file io
+ * @li #APR_FOPEN_DIRECT         Platform dependent flag to bypass the
+ *                               system's cache, see WARNING below
+ * @li #APR_FOPEN_NOREUSE        Drop the data from the system's cache
+ *                               behind the stream, see WARNING below
  * @param perm Access permissions for file.
  * @param pool The pool to use.
  * @remark If perm is #APR_FPROT_OS_DEFAULT and the file is being created,
@@ -334,6 +367,45 @@ APR_DECLARE(apr_status_t) apr_file_append(const char *from_path,
                                           apr_fileperms_t perms,
                                           apr_pool_t *pool);
 
+/**
+ * @defgroup apr_file_copy_flags File copy flags
+ * @{
+ */
+#define APR_FILE_COPY_APPEND 0x01 /**< Append to the destination, as
+                                       apr_file_append() does */
+#define APR_FILE_COPY_CLONE  0x02 /**< Share the blocks of the source,
+                                       copied on write, or fail */
+/** @} */
+
+/**
+ * Copy the specified file to another file, as apr_file_copy() or
+ * apr_file_append() do.
+ * @param from_path The full path to the original file (using / on all systems)
+ * @param to_path The full path to the new file (using / on all systems)
+ * @param perms Access permissions for the new file if it is created.
+ *     In place of the usual or'd combination of file permissions, the
+ *     value #APR_FPROT_FILE_SOURCE_PERMS may be given, in which case the source
+ *     file's permissions are copied.
+ * @param flags Or'ed value of:
+ * <PRE>
+ *         #APR_FILE_COPY_APPEND  append rather than replace the destination
+ *         #APR_FILE_COPY_CLONE   clone the source (reflink), or fail with
+ *                                #APR_ENOTIMPL where the file systems can't,
+ *                                the destination being created or truncated
+ *                                all the same
+ * </PRE>
+ * @param pool The pool to use.
+ * @remark Where the system has it, the kernel does the copy: a clone,
+ * copy_file_range(), sendfile() or fcopyfile(), the data going through a
+ * buffer in user space otherwise.  The same goes for apr_file_copy() and
+ * apr_file_append().
+ */
+APR_DECLARE(apr_status_t) apr_file_copy_ex(const char *from_path,
+                                           const char *to_path,
+                                           apr_fileperms_t perms,
+                                           apr_int32_t flags,
+                                           apr_pool_t *pool);
+
 /**
  * Are we at the end of the file
  * @param fptr The apr file we are testing.
@@ -499,6 +571,97 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile,
                                           const struct iovec *vec,
                                           apr_size_t nvec, apr_size_t *nbytes);
 
+/**
+ * Read data from the specified file into an iovec array.
+ * @param thefile The file descriptor to read from.
+ * @param vec The array of buffers to fill, in order.
+ * @param nvec The number of elements in the struct iovec array. This must
+ *             be smaller than #APR_MAX_IOVEC_SIZE.  If it isn't, the function
+ *             will fail with #APR_EINVAL.
+ * @param nbytes The number of bytes read.
+ *
+ * @remark As with apr_file_read(), it is not possible for both bytes to be
+ * read and an #APR_EOF or other error to be returned.  #APR_EINTR is never
+ * returned.
+ *
+ * @remark apr_file_readv() is available even if the underlying
+ * operating system doesn't provide readv(), only the first buffer
+ * being read into then.
+ */
+APR_DECLARE(apr_status_t) apr_file_readv(apr_file_t *thefile,
+                                         const struct iovec *vec,
+                                         apr_size_t nvec, apr_size_t *nbytes);
+
+/**
+ * Read data from the specified file at an offset, without moving the file
+ * pointer.
+ * @param thefile The file descriptor to read from.
+ * @param buf The buffer to store the data to.
+ * @param nbytes On entry, the number of bytes to read; on exit, the number
+ * of bytes read.
+ * @param offset The offset in the file to read from.
+ *
+ * @remark Positional I/O takes no lock on an unbuffered file, so threads
+ * sharing one can read (and write) at their own offsets concurrently.  A
+ * buffered file has pending writes flushed first.
+ *
+ * @remark It is not possible for both bytes to be read and an #APR_EOF
+ * or other error to be returned.  #APR_EINTR is never returned.
+ */
+APR_DECLARE(apr_status_t) apr_file_pread(apr_file_t *thefile, void *buf,
+                                         apr_size_t *nbytes, apr_off_t offset);
+
+/**
+ * Write data to the specified file at an offset, without moving the file
+ * pointer.
+ * @param thefile The file descriptor to write to.
+ * @param buf The buffer which contains the data.
+ * @param nbytes On entry, the number of bytes to write; on exit, the number
+ *               of bytes written.
+ * @param offset The offset in the file to write at.
+ *
+ * @remark See apr_file_pread() for concurrency.  Where the data of a file
+ * opened with #APR_FOPEN_APPEND is written is system dependent.
+ */
+APR_DECLARE(apr_status_t) apr_file_pwrite(apr_file_t *thefile,
+                                          const void *buf,
+                                          apr_size_t *nbytes,
+                                          apr_off_t offset);
+
+/**
+ * Read data from the specified file at an offset into an iovec array,
+ * without moving the file pointer.
+ * @param thefile The file descriptor to read from.
+ * @param vec The array of buffers to fill, in order.
+ * @param nvec The number of elements in the struct iovec array. This must
+ *             be smaller than #APR_MAX_IOVEC_SIZE.  If it isn't, the function
+ *             will fail with #APR_EINVAL.
+ * @param nbytes The number of bytes read.
+ * @param offset The offset in the file to read from.
+ * @remark See apr_file_pread().
+ */
+APR_DECLARE(apr_status_t) apr_file_preadv(apr_file_t *thefile,
+                                          const struct iovec *vec,
+                                          apr_size_t nvec, apr_size_t *nbytes,
+                                          apr_off_t offset);
+
+/**
+ * Write data from an iovec array to the specified file at an offset,
+ * without moving the file pointer.
+ * @param thefile The file descriptor to write to.
+ * @param vec The array from which to get the data to write to the file.
+ * @param nvec The number of elements in the struct iovec array. This must
+ *             be smaller than #APR_MAX_IOVEC_SIZE.  If it isn't, the function
+ *             will fail with #APR_EINVAL.
+ * @param nbytes The number of bytes written.
+ * @param offset The offset in the file to write at.
+ * @remark See apr_file_pwrite().
+ */
+APR_DECLARE(apr_status_t) apr_file_pwritev(apr_file_t *thefile,
+                                           const struct iovec *vec,
+                                           apr_size_t nvec, apr_size_t *nbytes,
+                                           apr_off_t offset);
+
 /**
  * Read data from the specified file, ensuring that the buffer is filled
  * before returning.
@@ -598,6 +761,24 @@ APR_DECLARE(apr_status_t) apr_file_ungetc(char ch, apr_file_t *thefile);
 APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, 
                                         apr_file_t *thefile);
 
+/**
+ * Read a line from the specified file, without copying it
+ * @param thefile The file descriptor to read from, opened with
+ *                APR_FOPEN_BUFFERED
+ * @param line The location to store the start of the line
+ * @param len The location to store the length of the line
+ * @return APR_EOF at the end of the file, APR_EINVAL if the file is not
+ *         buffered or opened with APR_FOPEN_DIRECT
+ * @remark The line points into the buffer of the file and is valid until
+ *         the next operation on the file.  It includes the newline, except
+ *         for a last line not terminated, and is not NUL-terminated.
+ * @remark The buffer grows to hold lines longer than it, which replaces a
+ *         buffer given to apr_file_buffer_set().
+ */
+APR_DECLARE(apr_status_t) apr_file_getline(apr_file_t *thefile,
+                                           const char **line,
+                                           apr_size_t *len);
+
 /**
  * Write the string into the specified file.
  * @param str The string to write. 
@@ -681,6 +862,9 @@ APR_DECLARE(apr_status_t) apr_file_setaside(apr_file_t **new_file,
  *         the file handle's flags. Likewise, with buffer=NULL and
  *         bufsize=0 arguments it is possible to make a previously
  *         buffered file handle unbuffered.
+ * @remark For a file opened with #APR_FOPEN_DIRECT, the buffer used is
+ *         the largest part of the given one aligned as direct I/O
+ *         requires, or #APR_EINVAL is returned if there is none.
  */
 APR_DECLARE(apr_status_t) apr_file_buffer_set(apr_file_t *thefile,
                                               char * buffer,
@@ -803,6 +987,52 @@ APR_DECLARE(apr_status_t) apr_file_pipe_timeout_get(apr_file_t *thepipe,
 APR_DECLARE(apr_status_t) apr_file_pipe_timeout_set(apr_file_t *thepipe, 
                                                   apr_interval_time_t timeout);
 
+/**
+ * Set the capacity of a pipe, the data it can hold before writes block.
+ * @param thepipe Either end of the pipe.
+ * @param size The capacity in bytes, which the system may round up
+ *        (to a power of two number of pages on Linux).
+ * @return APR_ENOTIMPL where the capacity of a pipe is fixed; the
+ *         system's error when it can not be set, e.g. EPERM past the
+ *         limit of unprivileged processes, or EBUSY below the data the
+ *         pipe already holds.
+ * @remark Called right after creating the pipe, a larger capacity lets
+ *         the writer get further ahead of the reader (as a piped logger)
+ *         with fewer context switches.
+ */
+APR_DECLARE(apr_status_t) apr_file_pipe_size_set(apr_file_t *thepipe,
+                                                 apr_size_t size);
+
+/**
+ * Get the capacity of a pipe.
+ * @param thepipe Either end of the pipe.
+ * @param size The capacity in bytes.
+ * @return APR_ENOTIMPL where the capacity of a pipe can not be queried.
+ */
+APR_DECLARE(apr_status_t) apr_file_pipe_size_get(apr_file_t *thepipe,
+                                                 apr_size_t *size);
+
+/**
+ * Write data to a pipe by handing its memory over, without copying it
+ * where the system allows it (vmsplice() on Linux).
+ * @param thepipe The writing end of the pipe.
+ * @param buf The data to write, ideally page aligned and a multiple of
+ *        the page size, for whole pages to be given to the pipe.
+ * @param nbytes On entry, the number of bytes to write; on exit, the
+ *        number of bytes written, which may be less as with
+ *        apr_file_write().
+ * @remark The pipe refers to the memory until the data is read from the
+ *         other end, so the memory must not be modified nor reused once
+ *         written this way: only memory which is discarded afterwards
+ *         (typically unmapped, e.g. an apr_mmap_t of a log batch) may be
+ *         given to the pipe.
+ * @remark Where the system can not do it, or when @a thepipe is buffered,
+ *         the data is copied with apr_file_write().
+ */
+APR_DECLARE(apr_status_t) apr_file_pipe_write_gift(apr_file_t *thepipe,
+                                                   const void *buf,
+                                                   apr_size_t *nbytes);
+
 /** file (un)locking functions. */
 
 /**
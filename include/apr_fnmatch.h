@@ -127,6 +127,58 @@ APR_DECLARE(apr_status_t) apr_fnmatch(const char *pattern,
  */
 APR_DECLARE(int) apr_fnmatch_test(const char *pattern);
 
+/**
+ * A compiled pattern, see apr_fnmatch_compile().
+ */
+typedef struct apr_fnmatch_t apr_fnmatch_t;
+
+/**
+ * A compiled list of patterns, see apr_fnmatch_list_compile().
+ */
+typedef struct apr_fnmatch_list_t apr_fnmatch_list_t;
+
+/**
+ * Compile a pattern once, to match it against many strings with
+ * apr_fnmatch_exec(), as apr_fnmatch() would with the same flags.
+ * @param pattern The pattern to match to
+ * @param flags The flags of apr_fnmatch()
+ * @param p The pool to allocate from
+ * @return The compiled pattern (a copy of pattern is made)
+ */
+APR_DECLARE(apr_fnmatch_t *) apr_fnmatch_compile(const char *pattern,
+                                                 int flags, apr_pool_t *p);
+
+/**
+ * Try to match the string to a compiled pattern.
+ * @param fnm The compiled pattern
+ * @param string The string we are trying to match
+ * @return APR_SUCCESS if the string matches, else APR_FNM_NOMATCH
+ */
+APR_DECLARE(int) apr_fnmatch_exec(const apr_fnmatch_t *fnm,
+                                  const char *string);
+
+/**
+ * Compile a list of patterns, to match strings against all of them at
+ * once with apr_fnmatch_list_exec().  The patterns sharing their leading
+ * literal characters are gathered in a trie, which a string walks along
+ * once, so the patterns whose literal prefixes do not match cost nothing.
+ * @param patterns The array of the (const char *) patterns
+ * @param flags The flags of apr_fnmatch(), for all the patterns
+ * @param p The pool to allocate from
+ * @return The compiled list
+ */
+APR_DECLARE(apr_fnmatch_list_t *) apr_fnmatch_list_compile(
+        const apr_array_header_t *patterns, int flags, apr_pool_t *p);
+
+/**
+ * Find the first pattern of a compiled list which matches the string.
+ * @param list The compiled list
+ * @param string The string we are trying to match
+ * @return The index of the first matching pattern, or -1 if none matches
+ */
+APR_DECLARE(int) apr_fnmatch_list_exec(const apr_fnmatch_list_t *list,
+                                       const char *string);
+
 /**
  * Find all files that match a specified pattern in a directory.
  * @param dir_pattern The pattern to use for finding files, appended
@@ -41,6 +41,10 @@ extern "C" {
  * @{
  */
 
+/** The mutex is only used by one thread of each process, so no thread
+ *  mutex is needed, see apr_global_mutex_create_ex() */
+#define APR_GLOBAL_MUTEX_UNTHREADED 0x1
+
 #if !APR_PROC_MUTEX_IS_GLOBAL || defined(DOXYGEN)
 
 /** Opaque global mutex structure. */
@@ -66,6 +70,7 @@ typedef struct apr_global_mutex_t apr_global_mutex_t;
  *            APR_LOCK_SYSVSEM
  *            APR_LOCK_POSIXSEM
  *            APR_LOCK_PROC_PTHREAD
+ *            APR_LOCK_FUTEX
  *            APR_LOCK_DEFAULT     pick the default mechanism for the platform
  *            APR_LOCK_DEFAULT_TIMED pick the default timed mechanism
  * </PRE>
@@ -78,6 +83,29 @@ APR_DECLARE(apr_status_t) apr_global_mutex_create(apr_global_mutex_t **mutex,
                                                   apr_lockmech_e mech,
                                                   apr_pool_t *pool);
 
+/**
+ * Create and initialize a mutex that can be used to synchronize both
+ * processes and threads, see apr_global_mutex_create().
+ * @param mutex the memory address where the newly created mutex will be
+ *        stored.
+ * @param fname A file name to use if the lock mechanism requires one.
+ * @param mech The mechanism to use for the interprocess lock, if any.
+ * @param flags Zero or APR_GLOBAL_MUTEX_UNTHREADED.
+ * @param pool the pool from which to allocate the mutex.
+ * @remark The mechanisms whose locks are held by a thread rather than by
+ *         the process (e.g. APR_LOCK_PROC_PTHREAD or APR_LOCK_FUTEX) lock
+ *         a single mutex.  The others lock a thread mutex first, to
+ *         exclude the threads of the process between them, unless
+ *         APR_GLOBAL_MUTEX_UNTHREADED is given: only one thread of each
+ *         process may then use the mutex, as in prefork servers, which
+ *         halves the cost of locking it.
+ */
+APR_DECLARE(apr_status_t) apr_global_mutex_create_ex(apr_global_mutex_t **mutex,
+                                                     const char *fname,
+                                                     apr_lockmech_e mech,
+                                                     int flags,
+                                                     apr_pool_t *pool);
+
 /**
  * Re-open a mutex in a child process.
  * @param mutex The newly re-opened mutex structure.
@@ -154,6 +182,16 @@ APR_DECLARE(apr_lockmech_e) apr_global_mutex_mech(apr_global_mutex_t *mutex);
  */
 APR_DECLARE(const char *) apr_global_mutex_name(apr_global_mutex_t *mutex);
 
+/**
+ * Name a mutex, enabling the contention statistics of its underlying
+ * proc and thread mutexes in this process.
+ * @param mutex the mutex to name.
+ * @param name the name, which must live as long as the mutex's pool.
+ * @see apr_proc_mutex_name_set(), apr_thread_mutex_name_set()
+ */
+APR_DECLARE(apr_status_t) apr_global_mutex_name_set(apr_global_mutex_t *mutex,
+                                                    const char *name);
+
 /**
  * Set mutex permissions.
  */
@@ -174,6 +212,8 @@ APR_POOL_DECLARE_ACCESSOR(global_mutex);
 
 #define apr_global_mutex_t          apr_proc_mutex_t
 #define apr_global_mutex_create     apr_proc_mutex_create
+#define apr_global_mutex_create_ex(mutex, fname, mech, flags, pool) \
+    apr_proc_mutex_create(mutex, fname, mech, pool)
 #define apr_global_mutex_child_init apr_proc_mutex_child_init
 #define apr_global_mutex_lock       apr_proc_mutex_lock
 #define apr_global_mutex_trylock    apr_proc_mutex_trylock
@@ -182,6 +222,7 @@ APR_POOL_DECLARE_ACCESSOR(global_mutex);
 #define apr_global_mutex_lockfile   apr_proc_mutex_lockfile
 #define apr_global_mutex_mech       apr_proc_mutex_mech
 #define apr_global_mutex_name       apr_proc_mutex_name
+#define apr_global_mutex_name_set   apr_proc_mutex_name_set
 #define apr_global_mutex_perms_set  apr_proc_mutex_perms_set
 #define apr_global_mutex_pool_get   apr_proc_mutex_pool_get
 
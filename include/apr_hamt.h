@@ -0,0 +1,145 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_HAMT_H
+#define APR_HAMT_H
+
+/**
+ * @file apr_hamt.h
+ * @brief APR Persistent Hash Maps
+ *
+ * @remark A persistent hash map is a hash array mapped trie (HAMT), whose
+ * copies share all their nodes: copying a map is O(1), and modifying a
+ * copy only copies the nodes on the path to the key modified (a few,
+ * since each node has up to 32 children).  This suits the maps built
+ * once then copied and modified a little many times, like configurations
+ * merged per request.
+ *
+ * The nodes created by a map since it was last copied are modified in
+ * place, so building a map does not leave a copy of each path behind.
+ *
+ * Like apr_hash_t, the keys and values are not copied, and a map is not
+ * thread-safe, except that concurrent threads may copy (and read) a map
+ * which is not modified meanwhile.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_hamt Persistent Hash Maps
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the persistent hash map API */
+typedef struct apr_hamt_t apr_hamt_t;
+
+/**
+ * Create an empty map
+ * @param p The pool from which to allocate the map and its nodes
+ * @return The map
+ */
+APR_DECLARE(apr_hamt_t *) apr_hamt_make(apr_pool_t *p);
+
+/**
+ * Create an empty map with a custom hash function
+ * @param p The pool from which to allocate the map and its nodes
+ * @param hash_func A custom hash function, see apr_hash_make_custom()
+ * @return The map
+ */
+APR_DECLARE(apr_hamt_t *) apr_hamt_make_custom(apr_pool_t *p,
+                                               apr_hashfunc_t hash_func);
+
+/**
+ * Copy a map, in O(1)
+ * @param p The pool from which to allocate the copy and the nodes it
+ *          modifies
+ * @param h The map to copy
+ * @return The copy
+ * @remark The nodes of @a h are shared, so its pool must live at least
+ *         as long as @a p.
+ * @remark Several threads may copy @a h at the same time, provided it
+ *         is not modified meanwhile.
+ */
+APR_DECLARE(apr_hamt_t *) apr_hamt_copy(apr_pool_t *p, apr_hamt_t *h);
+
+/**
+ * Associate a value with a key in a map, or remove it
+ * @param h The map
+ * @param key Pointer to the key
+ * @param klen Length of the key, or APR_HASH_KEY_STRING
+ * @param val The value, or NULL to remove the key
+ * @remark The copies of the map are not affected.
+ */
+APR_DECLARE(void) apr_hamt_set(apr_hamt_t *h, const void *key,
+                               apr_ssize_t klen, const void *val);
+
+/**
+ * Look up the value associated with a key in a map
+ * @param h The map
+ * @param key Pointer to the key
+ * @param klen Length of the key, or APR_HASH_KEY_STRING
+ * @return The value, or NULL if the key is not present
+ */
+APR_DECLARE(void *) apr_hamt_get(const apr_hamt_t *h, const void *key,
+                                 apr_ssize_t klen);
+
+/**
+ * Get the number of keys in a map
+ * @param h The map
+ * @return The number of keys
+ */
+APR_DECLARE(unsigned int) apr_hamt_count(const apr_hamt_t *h);
+
+/**
+ * Iterate over a map, see apr_hash_do()
+ * @param comp The function to run for each key
+ * @param rec The data to pass as the first argument to the function
+ * @param h The map
+ * @return FALSE if one of the comp() iterations returned zero; TRUE if all
+ *         iterations returned non-zero
+ */
+APR_DECLARE(int) apr_hamt_do(apr_hash_do_callback_fn_t *comp, void *rec,
+                             const apr_hamt_t *h);
+
+/**
+ * Merge two maps into a new one, the values of the overlay overriding
+ * the ones of the base
+ * @param p The pool to use for the new map
+ * @param overlay The map whose values take precedence
+ * @param base The map to start from
+ * @return The new map
+ * @remark The new map is a copy of @a base with the keys of @a overlay
+ *         set, so this is proportional to the size of @a overlay only.
+ *         Both maps must use the same hash function.
+ */
+APR_DECLARE(apr_hamt_t *) apr_hamt_overlay(apr_pool_t *p,
+                                           const apr_hamt_t *overlay,
+                                           apr_hamt_t *base);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_HAMT_H */
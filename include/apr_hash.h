@@ -86,6 +86,72 @@ APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool);
 APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool, 
                                                apr_hashfunc_t hash_func);
 
+/**
+ * Create a flat hash table, using open addressing with the entries stored
+ * inline rather than chained, to reduce the cache misses on lookups.
+ * @param pool The pool to allocate the hash table out of
+ * @return The hash table just created
+ * @remark The table is used with the same functions as the ones created
+ *         by apr_hash_make(), and apr_hash_copy() or apr_hash_merge() of
+ *         a flat table (as base) create a flat table too.
+ */
+APR_DECLARE(apr_hash_t *) apr_hash_make_flat(apr_pool_t *pool);
+
+/**
+ * Create a flat hash table with a custom hash function
+ * @param pool The pool to allocate the hash table out of
+ * @param hash_func A custom hash function.
+ * @return The hash table just created
+ * @see apr_hash_make_flat()
+ */
+APR_DECLARE(apr_hash_t *) apr_hash_make_flat_custom(apr_pool_t *pool,
+                                                    apr_hashfunc_t hash_func);
+
+/**
+ * Create a flat hash table, see apr_hash_make_ex()
+ */
+#define APR_HASH_FLAT           0x01
+
+/**
+ * Grow the (non flat) hash table incrementally, see apr_hash_make_ex()
+ */
+#define APR_HASH_INCREMENTAL    0x02
+
+/**
+ * Hash the keys with SipHash-1-3 keyed per table, see apr_hash_make_ex()
+ */
+#define APR_HASH_SIPHASH        0x04
+
+/**
+ * Hash the keys with a fast keyed hash, see apr_hash_make_ex()
+ */
+#define APR_HASH_FASTHASH       0x08
+
+/**
+ * Create a hash table with the given flags
+ * @param pool The pool to allocate the hash table out of
+ * @param hash_func A custom hash function, or NULL for the default one
+ * @param flags A bitmask of APR_HASH_* flags, or zero
+ * @return The hash table just created
+ * @remark With APR_HASH_INCREMENTAL, when the table grows its entries are
+ *         not rehashed at once but a few buckets at a time by the next
+ *         insertions, which bounds the latency of each operation. The
+ *         lookups and the functions walking the table (apr_hash_first(),
+ *         apr_hash_do(), apr_hash_copy(), ...) do not move the entries,
+ *         so a table not modified can still be read by concurrent
+ *         threads. This flag has no effect on flat tables.
+ * @remark APR_HASH_SIPHASH and APR_HASH_FASTHASH replace the default
+ *         hash function (when @a hash_func is NULL) by one processing the
+ *         keys a word at a time and keyed with a random secret, making
+ *         the collisions hard to predict for keys coming from untrusted
+ *         sources (e.g. request headers). SipHash is a cryptographic PRF
+ *         hence the safest, the fast hash is quicker but not proven
+ *         resistant to an attacker observing the table's behaviour.
+ */
+APR_DECLARE(apr_hash_t *) apr_hash_make_ex(apr_pool_t *pool,
+                                           apr_hashfunc_t hash_func,
+                                           apr_uint32_t flags);
+
 /**
  * Make a copy of a hash table
  * @param pool The pool from which to allocate the new hash table
@@ -161,6 +227,38 @@ APR_DECLARE(void *) apr_hash_get_or_set(apr_hash_t *ht, const void *key,
  */
 APR_DECLARE(apr_hash_index_t *) apr_hash_first(apr_pool_t *p, apr_hash_t *ht);
 
+/**
+ * Storage for the state of an iteration, see apr_hash_iter_init()
+ */
+typedef struct apr_hash_iter_t {
+    /** Private, the iteration state */
+    void *state[6];
+} apr_hash_iter_t;
+
+/**
+ * Start iterating over the entries in a hash table, with the iteration
+ * state in the given storage (usually on the stack).
+ * @param it The storage of the iteration state
+ * @param ht The hash table
+ * @return The iteration state, for apr_hash_next() and apr_hash_this(),
+ *         or NULL if the table is empty
+ * @remark This is apr_hash_first() without allocating from a pool nor
+ *         sharing the iterator of the table, for the iterations run in
+ *         loops or by concurrent readers of the table.
+ *
+ * @par Example:
+ *
+ * @code
+ * apr_hash_iter_t it;
+ * apr_hash_index_t *hi;
+ * for (hi = apr_hash_iter_init(&it, ht); hi; hi = apr_hash_next(hi)) {
+ *     ...
+ * }
+ * @endcode
+ */
+APR_DECLARE(apr_hash_index_t *) apr_hash_iter_init(apr_hash_iter_t *it,
+                                                   apr_hash_t *ht);
+
 /**
  * Continue iterating over the entries in a hash table.
  * @param hi The iteration state
@@ -283,6 +381,169 @@ typedef int (apr_hash_do_callback_fn_t)(void *rec, const void *key,
 APR_DECLARE(int) apr_hash_do(apr_hash_do_callback_fn_t *comp,
                              void *rec, const apr_hash_t *ht);
 
+#if APR_HAS_THREADS
+/** The thread pool, see apr_thread_pool.h */
+struct apr_thread_pool;
+
+/**
+ * Iterate over a hash table like apr_hash_do(), splitting the table in
+ * parts scanned concurrently by the caller and the threads of a pool.
+ *
+ * @param comp The function to run, concurrently
+ * @param rec The data to pass as the first argument to the function
+ * @param ht The hash table to iterate over
+ * @param tp The thread pool, or NULL to run apr_hash_do()
+ * @param nparts The number of parts, or zero for four per thread of
+ *               @a tp at most
+ * @return FALSE if one of the comp() iterations returned zero; TRUE if all
+ *            iterations returned non-zero
+ * @remark The table must not be modified during the iteration.  Once an
+ *         iteration returned zero the others stop soon, those running
+ *         finishing their call first.
+ * @remark The parts not taken by the threads of @a tp are scanned by the
+ *         caller, which can thus be one of them.
+ */
+APR_DECLARE(int) apr_hash_do_parallel(apr_hash_do_callback_fn_t *comp,
+                                      void *rec, const apr_hash_t *ht,
+                                      struct apr_thread_pool *tp,
+                                      unsigned int nparts);
+#endif
+
+/**
+ * Abstract type for hash tables keyed by 64-bit integers.
+ */
+typedef struct apr_hash_u64_t apr_hash_u64_t;
+
+/**
+ * Abstract type for hash tables keyed by pointers.
+ */
+typedef struct apr_hash_ptr_t apr_hash_ptr_t;
+
+/**
+ * Callback functions for apr_hash_u64_do()
+ * @see apr_hash_do_callback_fn_t
+ */
+typedef int (apr_hash_u64_do_callback_fn_t)(void *rec, apr_uint64_t key,
+                                            const void *value);
+
+/**
+ * Callback functions for apr_hash_ptr_do()
+ * @see apr_hash_do_callback_fn_t
+ */
+typedef int (apr_hash_ptr_do_callback_fn_t)(void *rec, const void *key,
+                                            const void *value);
+
+/**
+ * Create a hash table keyed by 64-bit integers.
+ * @param pool The pool to allocate the hash table out of
+ * @return The hash table just created
+ * @remark The keys are stored inline (by value) in the table, which uses
+ *         open addressing and compares the keys directly, so it is
+ *         faster than an apr_hash_t whose keys are integers of
+ *         sizeof(key) bytes.  Like apr_hash_t, a NULL value removes the key
+ *         and the table is not thread-safe.
+ */
+APR_DECLARE(apr_hash_u64_t *) apr_hash_make_u64(apr_pool_t *pool);
+
+/**
+ * Make a copy of a hash table keyed by 64-bit integers.
+ * @param pool The pool from which to allocate the new hash table
+ * @param ht The hash table to clone
+ * @return The hash table just created
+ */
+APR_DECLARE(apr_hash_u64_t *) apr_hash_u64_copy(apr_pool_t *pool,
+                                                const apr_hash_u64_t *ht);
+
+/**
+ * Associate a value with a key in a hash table keyed by 64-bit integers.
+ * @param ht The hash table
+ * @param key The key
+ * @param val Value to associate with the key
+ * @remark If the value is NULL the hash entry is deleted.
+ */
+APR_DECLARE(void) apr_hash_u64_set(apr_hash_u64_t *ht, apr_uint64_t key,
+                                   const void *val);
+
+/**
+ * Look up the value associated with a key in a hash table keyed by 64-bit
+ * integers.
+ * @param ht The hash table
+ * @param key The key
+ * @return Returns NULL if the key is not present.
+ */
+APR_DECLARE(void *) apr_hash_u64_get(const apr_hash_u64_t *ht,
+                                     apr_uint64_t key);
+
+/**
+ * Get the number of key/value pairs in a hash table keyed by 64-bit
+ * integers.
+ * @param ht The hash table
+ * @return The number of key/value pairs in the hash table.
+ */
+APR_DECLARE(unsigned int) apr_hash_u64_count(const apr_hash_u64_t *ht);
+
+/**
+ * Clear any key/value pairs in a hash table keyed by 64-bit integers.
+ * @param ht The hash table
+ */
+APR_DECLARE(void) apr_hash_u64_clear(apr_hash_u64_t *ht);
+
+/**
+ * Iterate over a hash table keyed by 64-bit integers, see apr_hash_do().
+ * @param comp The function to run
+ * @param rec The data to pass as the first argument to the function
+ * @param ht The hash table to iterate over
+ * @return FALSE if one of the comp() iterations returned zero; TRUE if all
+ *            iterations returned non-zero
+ * @remark The table must not be modified during the iteration.
+ */
+APR_DECLARE(int) apr_hash_u64_do(apr_hash_u64_do_callback_fn_t *comp,
+                                 void *rec, const apr_hash_u64_t *ht);
+
+/**
+ * Create a hash table keyed by pointers, compared by address.
+ * @param pool The pool to allocate the hash table out of
+ * @return The hash table just created
+ * @see apr_hash_make_u64()
+ */
+APR_DECLARE(apr_hash_ptr_t *) apr_hash_make_ptr(apr_pool_t *pool);
+
+/**
+ * Make a copy of a hash table keyed by pointers, see apr_hash_u64_copy().
+ */
+APR_DECLARE(apr_hash_ptr_t *) apr_hash_ptr_copy(apr_pool_t *pool,
+                                                const apr_hash_ptr_t *ht);
+
+/**
+ * Associate a value with a key in a hash table keyed by pointers, see
+ * apr_hash_u64_set().
+ */
+APR_DECLARE(void) apr_hash_ptr_set(apr_hash_ptr_t *ht, const void *key,
+                                   const void *val);
+
+/**
+ * Look up the value associated with a key in a hash table keyed by
+ * pointers, see apr_hash_u64_get().
+ */
+APR_DECLARE(void *) apr_hash_ptr_get(const apr_hash_ptr_t *ht,
+                                     const void *key);
+
+/**
+ * Get the number of key/value pairs in a hash table keyed by pointers.
+ */
+APR_DECLARE(unsigned int) apr_hash_ptr_count(const apr_hash_ptr_t *ht);
+
+/**
+ * Clear any key/value pairs in a hash table keyed by pointers.
+ */
+APR_DECLARE(void) apr_hash_ptr_clear(apr_hash_ptr_t *ht);
+
+/**
+ * Iterate over a hash table keyed by pointers, see apr_hash_u64_do().
+ */
+APR_DECLARE(int) apr_hash_ptr_do(apr_hash_ptr_do_callback_fn_t *comp,
+                                 void *rec, const apr_hash_ptr_t *ht);
+
 /**
  * Get a pointer to the pool which the hash table was created in
  */
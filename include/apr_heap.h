@@ -0,0 +1,166 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_HEAP_H
+#define APR_HEAP_H
+
+/**
+ * @file apr_heap.h
+ * @brief APR Heap (priority queue)
+ *
+ * @remark A heap keeps the first of its elements, per a comparison
+ * function, at hand: pushing or popping an element is O(log n), peeking
+ * the first one O(1).  The elements are pointers kept in a single array
+ * of a d-ary heap (4 children a node by default), with no allocation per
+ * element, which makes it lighter than an apr_skiplist used as priority
+ * queue for timers or schedulers.
+ *
+ * An element pushed with a handle can be removed, or moved after its key
+ * changed, in O(log n) too.
+ *
+ * A heap is not thread-safe, nor are the elements comparing equal popped
+ * in any particular order.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_heap Heap (priority queue)
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the heap API */
+typedef struct apr_heap_t apr_heap_t;
+
+/** The position of an element in a heap, see apr_heap_push() */
+typedef struct apr_heap_handle_t apr_heap_handle_t;
+
+/**
+ * Compare two elements of a heap
+ * @param a The first element
+ * @param b The second element
+ * @return Negative if @a a comes before @a b, positive if after, zero
+ *         if either can come first
+ */
+typedef int (apr_heap_compare_fn)(const void *a, const void *b);
+
+/** The default number of children of a node */
+#define APR_HEAP_ARITY 4
+
+/**
+ * Allocate the array of the heap from the pool's allocator, see
+ * apr_array_make_ex()
+ */
+#define APR_HEAP_ALLOCATOR 0x01
+
+/**
+ * Create a heap
+ * @param heap The pointer in which to return the newly created object
+ * @param arity The number of children of a node, from 2 to 16, or zero
+ *              for APR_HEAP_ARITY
+ * @param nelts The number of elements the heap can hold before growing
+ * @param compare The function comparing the elements
+ * @param flags Zero or APR_HEAP_ALLOCATOR
+ * @param p The pool from which to allocate the heap
+ * @return APR_EINVAL if @a arity is out of range
+ * @remark With APR_HEAP_ALLOCATOR the array holding the elements is given
+ *         back whenever it grows, which suits the long-lived heaps.
+ */
+APR_DECLARE(apr_status_t) apr_heap_create(apr_heap_t **heap,
+                                          unsigned int arity, int nelts,
+                                          apr_heap_compare_fn *compare,
+                                          apr_uint32_t flags,
+                                          apr_pool_t *p);
+
+/**
+ * Push an element to a heap
+ * @param heap The heap
+ * @param data The element
+ * @param handle Location of the handle of the element, or NULL if the
+ *               element will only be popped
+ * @remark The handle is valid until the element leaves the heap, popped,
+ *         removed or cleared.
+ */
+APR_DECLARE(void) apr_heap_push(apr_heap_t *heap, void *data,
+                                apr_heap_handle_t **handle);
+
+/**
+ * Get the first element of a heap, leaving it in the heap
+ * @param heap The heap
+ * @return The element, or NULL if the heap is empty
+ */
+APR_DECLARE(void *) apr_heap_peek(const apr_heap_t *heap);
+
+/**
+ * Get the first element of a heap, removing it from the heap
+ * @param heap The heap
+ * @return The element, or NULL if the heap is empty
+ */
+APR_DECLARE(void *) apr_heap_pop(apr_heap_t *heap);
+
+/**
+ * Remove an element from a heap
+ * @param heap The heap
+ * @param handle The handle of the element
+ * @return The element
+ */
+APR_DECLARE(void *) apr_heap_remove(apr_heap_t *heap,
+                                    apr_heap_handle_t *handle);
+
+/**
+ * Move an element in a heap after its key changed
+ * @param heap The heap
+ * @param handle The handle of the element
+ */
+APR_DECLARE(void) apr_heap_update(apr_heap_t *heap,
+                                  apr_heap_handle_t *handle);
+
+/**
+ * Get the element of a handle
+ * @param heap The heap
+ * @param handle The handle
+ * @return The element
+ */
+APR_DECLARE(void *) apr_heap_handle_data(const apr_heap_t *heap,
+                                         const apr_heap_handle_t *handle);
+
+/**
+ * Get the number of elements in a heap
+ * @param heap The heap
+ * @return The number of elements
+ */
+APR_DECLARE(apr_size_t) apr_heap_size(const apr_heap_t *heap);
+
+/**
+ * Remove all the elements of a heap
+ * @param heap The heap
+ */
+APR_DECLARE(void) apr_heap_clear(apr_heap_t *heap);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_HEAP_H */
@@ -51,7 +51,15 @@ extern "C" {
 
 #ifdef APR_HOOK_PROBES_ENABLED
 #define APR_HOOK_INT_DCL_UD void *ud = NULL
+/** The probes want the name of each function, so the hooks are run from
+ * their arrays rather than from their dispatch tables
+ */
+#define APR_HOOK_INT_TABLE(name) NULL
 #else
+/** internal implementation detail to run the hooks from their dispatch
+ * tables when hook probes are not used
+ */
+#define APR_HOOK_INT_TABLE(name) _hooks.run_##name
 /** internal implementation detail to avoid the ud declaration when
  * hook probes are not used
  */
@@ -110,6 +118,12 @@ extern "C" {
 
 /** @} */
 
+/**
+ * The generic type of the functions in a hook dispatch table, which are
+ * cast back to the type of their hook before being called.
+ */
+typedef void (apr_hook_fn_t)(void);
+
 /** macro to return the prototype of the hook function */    
 #define APR_IMPLEMENT_HOOK_GET_PROTO(ns,link,name) \
 link##_DECLARE(apr_array_header_t *) ns##_hook_get_##name(void)
@@ -135,9 +149,16 @@ typedef struct ns##_LINK_##name##_t \
 #define APR_HOOK_STRUCT(members) \
 static struct { members } _hooks;
 
-/** macro to link the hook structure */
+/**
+ * macro to link the hook structure
+ * @remark Besides the array of the registered functions, a hook has a
+ * dispatch table: the NULL terminated array of its functions built by
+ * apr_hook_sort_all(), and reset to NULL by the registration of a function
+ * until the next sort (the hook then runs from the array, unsorted).
+ */
 #define APR_HOOK_LINK(name) \
-    apr_array_header_t *link_##name;
+    apr_array_header_t *link_##name; \
+    apr_hook_fn_t * const *run_##name;
 
 /** macro to implement the hook */
 #define APR_IMPLEMENT_EXTERNAL_HOOK_BASE(ns,link,name) \
@@ -148,8 +169,9 @@ link##_DECLARE(void) ns##_hook_##name(ns##_HOOK_##name##_t *pf,const char * cons
     if(!_hooks.link_##name) \
     { \
         _hooks.link_##name=apr_array_make(apr_hook_global_pool,1,sizeof(ns##_LINK_##name##_t)); \
-        apr_hook_sort_register(#name,&_hooks.link_##name); \
+        apr_hook_sort_register_ex(#name,&_hooks.link_##name,&_hooks.run_##name); \
     } \
+    _hooks.run_##name=NULL; \
     pHook=apr_array_push(_hooks.link_##name); \
     pHook->pFunc=pf; \
     pHook->aszPredecessors=aszPre; \
@@ -181,12 +203,18 @@ APR_IMPLEMENT_EXTERNAL_HOOK_BASE(ns,link,name) \
 link##_DECLARE(void) ns##_run_##name args_decl \
     { \
     ns##_LINK_##name##_t *pHook; \
+    apr_hook_fn_t * const *pTable=APR_HOOK_INT_TABLE(name); \
     int n; \
     APR_HOOK_INT_DCL_UD; \
 \
     APR_HOOK_PROBE_ENTRY(ud, ns, name, args_use); \
 \
-    if(_hooks.link_##name) \
+    if(pTable) \
+        { \
+        for(n=0 ; pTable[n] ; ++n) \
+            ((ns##_HOOK_##name##_t *)pTable[n]) args_use; \
+        } \
+    else if(_hooks.link_##name) \
         { \
         pHook=(ns##_LINK_##name##_t *)_hooks.link_##name->elts; \
         for(n=0 ; n < _hooks.link_##name->nelts ; ++n) \
@@ -224,13 +252,24 @@ APR_IMPLEMENT_EXTERNAL_HOOK_BASE(ns,link,name) \
 link##_DECLARE(ret) ns##_run_##name args_decl \
     { \
     ns##_LINK_##name##_t *pHook; \
+    apr_hook_fn_t * const *pTable=APR_HOOK_INT_TABLE(name); \
     int n; \
     ret rv = ok; \
     APR_HOOK_INT_DCL_UD; \
 \
     APR_HOOK_PROBE_ENTRY(ud, ns, name, args_use); \
 \
-    if(_hooks.link_##name) \
+    if(pTable) \
+        { \
+        for(n=0 ; pTable[n] ; ++n) \
+            { \
+            rv=((ns##_HOOK_##name##_t *)pTable[n]) args_use; \
+            if(rv != ok && rv != decline) \
+                break; \
+            rv = ok; \
+            } \
+        } \
+    else if(_hooks.link_##name) \
         { \
         pHook=(ns##_LINK_##name##_t *)_hooks.link_##name->elts; \
         for(n=0 ; n < _hooks.link_##name->nelts ; ++n) \
@@ -269,13 +308,23 @@ APR_IMPLEMENT_EXTERNAL_HOOK_BASE(ns,link,name) \
 link##_DECLARE(ret) ns##_run_##name args_decl \
     { \
     ns##_LINK_##name##_t *pHook; \
+    apr_hook_fn_t * const *pTable=APR_HOOK_INT_TABLE(name); \
     int n; \
     ret rv = decline; \
     APR_HOOK_INT_DCL_UD; \
 \
     APR_HOOK_PROBE_ENTRY(ud, ns, name, args_use); \
 \
-    if(_hooks.link_##name) \
+    if(pTable) \
+        { \
+        for(n=0 ; pTable[n] ; ++n) \
+            { \
+            rv=((ns##_HOOK_##name##_t *)pTable[n]) args_use; \
+            if(rv != decline) \
+                break; \
+            } \
+        } \
+    else if(_hooks.link_##name) \
         { \
         pHook=(ns##_LINK_##name##_t *)_hooks.link_##name->elts; \
         for(n=0 ; n < _hooks.link_##name->nelts ; ++n) \
@@ -329,8 +378,21 @@ APR_DECLARE_DATA extern const char *apr_hook_debug_current;
  */
 APR_DECLARE(void) apr_hook_sort_register(const char *szHookName, 
                                         apr_array_header_t **aHooks);
+
+/**
+ * Register a hook function to be sorted, and its dispatch table to be
+ * built by the sort.
+ * @param szHookName The name of the Hook the function is registered for
+ * @param aHooks The array which stores all of the functions for this hook
+ * @param aTable The dispatch table of the hook
+ */
+APR_DECLARE(void) apr_hook_sort_register_ex(const char *szHookName,
+                                            apr_array_header_t **aHooks,
+                                            apr_hook_fn_t * const **aTable);
+
 /**
- * Sort all of the registered functions for a given hook.
+ * Sort all of the registered functions for a given hook, and build the
+ * dispatch tables of the hooks.
  */
 APR_DECLARE(void) apr_hook_sort_all(void);
 
@@ -53,7 +53,9 @@
 #include "apu_errno.h"
 #include "apr_strings.h"
 #include "apr_buckets.h"
+#include "apr_hash.h"
 #include "apr_json.h"
+#include "apr_time.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -525,6 +527,8 @@ typedef struct apr_jose_jwk_t {
 typedef struct apr_jose_jwks_t {
     /** Parsed JWK set JSON structure containing a JSON array */
     apr_json_value_t *keys;
+    /** Keys of the set by their 'kid', see apr_jose_jwks_get() */
+    apr_hash_t *kids;
 } apr_jose_jwks_t;
 
 /**
@@ -956,6 +960,24 @@ APR_DECLARE(apr_jose_t *) apr_jose_jwks_make(apr_jose_t *jose,
         apr_json_value_t *keys, apr_pool_t *pool)
         __attribute__((nonnull(3)));
 
+/**
+ * Get the key of a JSON Web Key Set with the given key ID.
+ *
+ * The keys are indexed by their 'kid' once by apr_jose_jwks_make(), so
+ * that a verify or decrypt callback finds the key named by the 'kid'
+ * header parameter without walking the set.
+ * @param jwks the JWKS made by apr_jose_jwks_make() or apr_jose_decode().
+ * @param kid the key ID.
+ * @param klen the length of the key ID, or APR_HASH_KEY_STRING.
+ * @return The JWK as JSON, or NULL if no key has this ID. If several keys
+ *   have the same ID, the first one of the set is returned.
+ * @remark The index is not updated when the keys array is changed after
+ *   apr_jose_jwks_make(), which must then be called again.
+ */
+APR_DECLARE(apr_json_value_t *) apr_jose_jwks_get(apr_jose_t *jwks,
+        const char *kid, apr_ssize_t klen)
+        __attribute__((nonnull(1, 2)));
+
 /**
  * Make a signature structure for JWS.
  *
@@ -1162,6 +1184,66 @@ APR_DECLARE(apr_status_t) apr_jose_decode(apr_jose_t **jose, const char *typ,
         apr_pool_t *pool)
         __attribute__((nonnull(1, 3, 7)));
 
+/**
+ * Opaque cache of decoded and verified JWTs.
+ */
+typedef struct apr_jose_cache_t apr_jose_cache_t;
+
+/**
+ * Create a cache of the JWTs decoded by apr_jose_decode_cached(), such
+ * that decoding the same token again is a lookup rather than a
+ * verification or decryption.
+ * @param cache the new cache.
+ * @param size the maximum number of tokens to remember, rounded up to a
+ *   power of two; the least lasting ones are replaced when full.
+ * @param ttl how long a token is remembered at most.
+ * @param pool pool used to allocate the cache from.
+ * @return APR_ENOTIMPL if the platform has no source of random bytes for
+ *   the secret key of the cache.
+ * @remark A token is remembered until its 'exp' claim or for the ttl,
+ *   whichever comes first. The cache is thread safe.
+ */
+APR_DECLARE(apr_status_t) apr_jose_cache_create(apr_jose_cache_t **cache,
+        apr_size_t size, apr_interval_time_t ttl, apr_pool_t *pool)
+        __attribute__((nonnull(1, 4)));
+
+/**
+ * Forget all the tokens of a cache, for instance after a key of the
+ * verify callback was revoked.
+ * @param cache the cache.
+ */
+APR_DECLARE(void) apr_jose_cache_clear(apr_jose_cache_t *cache)
+        __attribute__((nonnull(1)));
+
+/**
+ * Decode, decrypt and verify the utf8-encoded JOSE string into apr_jose_t
+ * as apr_jose_decode() does, unless the same compact JWT was decoded
+ * successfully less than the cache lifetime of the token ago.
+ *
+ * Only the compact tokens whose payload is a JWT, decoded with
+ * APR_JOSE_FLAG_NONE, are remembered. Everything else is always decoded
+ * by apr_jose_decode().
+ * @param jose If jose points at NULL, a JOSE structure will be
+ *   created. If the jose pointer is not NULL, the structure will
+ *   be reused.
+ * @param typ content type of this object.
+ * @param brigade the JOSE structure to decode.
+ * @param cb callbacks for verify and decrypt.
+ * @param cache the cache, or NULL to always decode.
+ * @param level depth limit of JOSE and JSON nesting.
+ * @param flags APR_JOSE_FLAG_NONE to return payload only. APR_JOSE_FLAG_DECODE_ALL
+ *   to return the full JWS/JWE structure.
+ * @param pool pool used to allocate the result from.
+ * @remark The callbacks are not called on a cache hit, the token is known
+ *   to have passed them. The claims are returned as they were, the caller
+ *   still validates 'exp', 'nbf', 'aud' and the like against the current
+ *   time and request.
+ */
+APR_DECLARE(apr_status_t) apr_jose_decode_cached(apr_jose_t **jose,
+        const char *typ, apr_bucket_brigade *brigade, apr_jose_cb_t *cb,
+        apr_jose_cache_t *cache, int level, int flags, apr_pool_t *pool)
+        __attribute__((nonnull(1, 3, 8)));
+
 
 #ifdef __cplusplus
 }
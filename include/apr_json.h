@@ -82,6 +82,17 @@ extern "C" {
  */
 #define APR_JSON_FLAGS_STRICT 2
 
+/**
+ * Flag indicating lazy decoding: the strings needing no unescaping nor
+ * UTF-8 validation point into the decoded text, which must outlive them,
+ * and are not NUL terminated, and the hash of the objects is built on
+ * the first lookup by key or walk (apr_json_object_first(), encoding).
+ * Until then the list of an object walked directly still holds the
+ * duplicate keys, which are merged as when decoding eagerly: the value
+ * of the last one replaces the value of the first one.
+ */
+#define APR_JSON_FLAGS_LAZY 4
+
 /**
  * A structure to hold a JSON object.
  */
@@ -168,8 +179,11 @@ typedef struct apr_json_kv_t {
 struct apr_json_object_t {
     /** The key value pairs in the object are in this list */
     APR_RING_HEAD(apr_json_object_list_t, apr_json_kv_t) list;
-    /** JSON object */
+    /** JSON object, or NULL until first looked up by key when decoded
+     * with APR_JSON_FLAGS_LAZY */
     apr_hash_t *hash;
+    /** The pool to build the hash from, when NULL */
+    apr_pool_t *pool;
 };
 
 /**
@@ -390,7 +404,8 @@ APR_DECLARE(apr_json_value_t *) apr_json_array_next(const apr_json_value_t *arr,
  * @param size length of the input string.
  * @param offset number of characters processed.
  * @param flags set to APR_JSON_FLAGS_WHITESPACE to preserve whitespace,
- *   or APR_JSON_FLAGS_NONE to filter whitespace.
+ *   or APR_JSON_FLAGS_NONE to filter whitespace, possibly combined with
+ *   APR_JSON_FLAGS_LAZY.
  * @param level maximum nesting level we are prepared to decode.
  * @param pool pool used to allocate the result from.
  * @return APR_SUCCESS on success, APR_EOF if the JSON text is truncated.
@@ -403,6 +418,359 @@ APR_DECLARE(apr_status_t) apr_json_decode(apr_json_value_t ** retval,
         int flags, int level, apr_pool_t * pool)
         __attribute__((nonnull(1, 2, 7)));
 
+/**
+ * A JSON document decoded into a tape, the nodes of its values laid out
+ * contiguously in document order.
+ */
+typedef struct apr_json_tape_t apr_json_tape_t;
+
+/**
+ * A value within a tape, valid as long as the tape.
+ */
+typedef struct apr_json_node_t apr_json_node_t;
+
+/**
+ * Decode utf8-encoded JSON string into a tape.
+ *
+ * The tape is a compact alternative to the apr_json_value_t tree, built
+ * from a single growing allocation with no hash nor ring: the scalars
+ * take one node of 16 bytes and the arrays and objects one node followed
+ * by their contents, the keys of the objects being looked up linearly.
+ * It is read only, and does not keep the whitespace.
+ * @param tape the result
+ * @param injson utf8-encoded JSON string.
+ * @param size length of the input string, or APR_JSON_VALUE_STRING.
+ * @param offset number of characters processed.
+ * @param flags APR_JSON_FLAGS_NONE, or APR_JSON_FLAGS_LAZY for the plain
+ *   strings to point into the decoded text.
+ * @param level maximum nesting level we are prepared to decode.
+ * @param pool pool used to allocate the result from.
+ * @return APR_SUCCESS on success, APR_EOF if the JSON text is truncated.
+ *   APR_BADCH when a decoding error has occurred (the location of the error
+ *   is at offset), APR_EINVAL if the level has been exceeded, APR_ENOSPC
+ *   if a string or container is longer than 4G, or APR_ENOTIMPL on
+ *   platforms where not implemented.
+ */
+APR_DECLARE(apr_status_t) apr_json_decode_tape(apr_json_tape_t **tape,
+        const char *injson, apr_ssize_t size, apr_off_t *offset,
+        int flags, int level, apr_pool_t *pool)
+        __attribute__((nonnull(1, 2, 7)));
+
+/**
+ * Get the root value of a tape.
+ * @param tape The tape.
+ * @return The root node.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_tape_root(
+        const apr_json_tape_t *tape)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the type of a node.
+ * @param node The node.
+ * @return The type of the value.
+ */
+APR_DECLARE(apr_json_type_e) apr_json_node_type(const apr_json_node_t *node)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the string of a node.
+ * @param node The node.
+ * @param len The length of the string, if not NULL.
+ * @return The string, NUL terminated unless pointing into the text with
+ *   APR_JSON_FLAGS_LAZY, or NULL if the node is not a string.
+ */
+APR_DECLARE(const char *) apr_json_node_string(const apr_json_node_t *node,
+        apr_size_t *len)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the integer of a node.
+ * @param node The node.
+ * @return The long integer, truncated from a double, or zero if the node
+ *   is not a number.
+ */
+APR_DECLARE(apr_int64_t) apr_json_node_long(const apr_json_node_t *node)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the floating point number of a node.
+ * @param node The node.
+ * @return The double, converted from a long integer, or zero if the node
+ *   is not a number.
+ */
+APR_DECLARE(double) apr_json_node_double(const apr_json_node_t *node)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the boolean of a node.
+ * @param node The node.
+ * @return The boolean, or zero if the node is not a boolean.
+ */
+APR_DECLARE(int) apr_json_node_boolean(const apr_json_node_t *node)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the number of elements of an array, or of members of an object.
+ * @param node The node.
+ * @return The count, or zero if the node is neither an array nor an
+ *   object.
+ */
+APR_DECLARE(apr_size_t) apr_json_node_count(const apr_json_node_t *node)
+        __attribute__((nonnull(1)));
+
+/**
+ * Look up the value associated with a key in an object node.
+ * @param obj The object node.
+ * @param key Pointer to the key.
+ * @param klen Length of the key, or APR_JSON_VALUE_STRING if NUL
+ *   terminated.
+ * @return The value of the first member with that key, or NULL if the
+ *   key is not present or the node is not an object.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_get(
+        const apr_json_node_t *obj, const char *key, apr_ssize_t klen)
+        __attribute__((nonnull(1, 2)));
+
+/**
+ * Get the key of the first member of an object node.
+ * @param obj The object node.
+ * @return The key, a string node, or NULL if the node is not an object
+ *   or the object is empty.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_first(
+        const apr_json_node_t *obj)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the key of the next member of an object node.
+ * @param obj The object node.
+ * @param key The key of the previous member.
+ * @return The key, or NULL if no more members are present.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_next(
+        const apr_json_node_t *obj, const apr_json_node_t *key)
+        __attribute__((nonnull(1, 2)));
+
+/**
+ * Get the value of the member of an object node with the given key.
+ * @param key The key returned by apr_json_node_object_first() or
+ *   apr_json_node_object_next().
+ * @return The value.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_value(
+        const apr_json_node_t *key)
+        __attribute__((nonnull(1)));
+
+/**
+ * Look up an element of an array node by its index.
+ * @param arr The array node.
+ * @param index The index of the element in the array.
+ * @return The element, or NULL if out of bounds or the node is not an
+ *   array.
+ * @remark The elements before the index are skipped over, each in
+ *   constant time whether a scalar or a nested array or object.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_array_get(
+        const apr_json_node_t *arr, apr_size_t index)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the first element of an array node.
+ * @param arr The array node.
+ * @return The element, or NULL if the node is not an array or the array
+ *   is empty.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_array_first(
+        const apr_json_node_t *arr)
+        __attribute__((nonnull(1)));
+
+/**
+ * Get the next element of an array node.
+ * @param arr The array node.
+ * @param val The previous element.
+ * @return The element, or NULL if no more elements are present.
+ */
+APR_DECLARE(const apr_json_node_t *) apr_json_node_array_next(
+        const apr_json_node_t *arr, const apr_json_node_t *val)
+        __attribute__((nonnull(1, 2)));
+
+/**
+ * Depth given to apr_json_decoder_create() for the decoder to never build
+ * the values of arrays and objects, only calling the callbacks.
+ */
+#define APR_JSON_DECODER_NODOM (-1)
+
+/**
+ * A structure to hold an incremental JSON decoder.
+ */
+typedef struct apr_json_decoder_t apr_json_decoder_t;
+
+/**
+ * The callbacks of an incremental JSON decoder, any of which may be NULL.
+ *
+ * The key given to the callbacks is the key of the value in its object,
+ * or NULL in an array or at the top level.  The keys and values are valid
+ * until the callback returns, after which they are freed.
+ */
+typedef struct apr_json_decoder_cb_t {
+    /** Called at the start of an array or an object not being built */
+    apr_status_t (*start)(void *ctx, const apr_json_string_t *key,
+                          apr_json_type_e type);
+    /** Called at the end of an array or an object not being built */
+    apr_status_t (*end)(void *ctx, apr_json_type_e type);
+    /** Called with the values of the other types, and with the arrays and
+     * objects once built */
+    apr_status_t (*value)(void *ctx, const apr_json_string_t *key,
+                          apr_json_value_t *val);
+} apr_json_decoder_cb_t;
+
+/**
+ * Create an incremental decoder, to decode a JSON text fed in chunks.
+ * @param dec the new decoder
+ * @param cb the callbacks, or NULL.
+ * @param ctx the context passed to the callbacks.
+ * @param depth the nesting depth from which the arrays and objects are
+ *   built and passed whole to the value callback, such that with 1 the
+ *   elements of a top level array are passed one by one. With 0 the whole
+ *   text is built and returned by apr_json_decoder_finish(), and with
+ *   APR_JSON_DECODER_NODOM nothing is built.
+ * @param level maximum nesting level we are prepared to decode.
+ * @param pool pool used to allocate the decoder, and the text built with
+ *   a depth of 0.
+ * @return APR_SUCCESS on success, or APR_ENOTIMPL on platforms where not
+ *   implemented.
+ * @remark Whitespace is not preserved. The values passed to the callbacks
+ *   are allocated from a subpool cleared after each call, so that a large
+ *   text is decoded in memory bounded by its largest value built.
+ */
+APR_DECLARE(apr_status_t) apr_json_decoder_create(apr_json_decoder_t **dec,
+        const apr_json_decoder_cb_t *cb, void *ctx, int depth, int level,
+        apr_pool_t *pool) __attribute__((nonnull(1, 6)));
+
+/**
+ * Feed the next chunk of a JSON text to an incremental decoder, calling
+ * the callbacks for the values it completes.
+ * @param dec the decoder
+ * @param buf the chunk
+ * @param len the length of the chunk
+ * @return APR_SUCCESS on success, APR_BADCH when a decoding error has
+ *   occurred (the location of the error is given by
+ *   apr_json_decoder_offset()), APR_EINVAL if the level has been exceeded,
+ *   or the error returned by a callback. Errors are final.
+ */
+APR_DECLARE(apr_status_t) apr_json_decoder_feed(apr_json_decoder_t *dec,
+        const char *buf, apr_size_t len) __attribute__((nonnull(1)));
+
+/**
+ * Feed the data buckets of a brigade to an incremental decoder, deleting
+ * them, up to an EOS bucket where apr_json_decoder_finish() is called.
+ * @param dec the decoder
+ * @param bb the brigade
+ * @return as apr_json_decoder_feed() and apr_json_decoder_finish(), or
+ *   the error of a bucket read.
+ * @remark The EOS bucket is left in the brigade.
+ */
+APR_DECLARE(apr_status_t) apr_json_decoder_feed_brigade(
+        apr_json_decoder_t *dec, apr_bucket_brigade *bb)
+        __attribute__((nonnull(1, 2)));
+
+/**
+ * Signal the end of the JSON text to an incremental decoder.
+ * @param dec the decoder
+ * @param result the text built with a depth of 0, if not NULL.
+ * @return APR_SUCCESS on success, APR_EOF if the JSON text is truncated,
+ *   or as apr_json_decoder_feed() for a number or literal ending the text.
+ */
+APR_DECLARE(apr_status_t) apr_json_decoder_finish(apr_json_decoder_t *dec,
+        apr_json_value_t **result) __attribute__((nonnull(1)));
+
+/**
+ * Get the number of characters processed by an incremental decoder, the
+ * location of the error if any.
+ * @param dec the decoder
+ */
+APR_DECLARE(apr_off_t) apr_json_decoder_offset(apr_json_decoder_t *dec)
+        __attribute__((nonnull(1)));
+
+/**
+ * A structure to hold a compiled JSON path.
+ */
+typedef struct apr_json_path_t apr_json_path_t;
+
+/**
+ * Callback called by a path decoder with the values matching its paths.
+ * @param ctx the context given to apr_json_path_decoder_create().
+ * @param index the index of the matching path in the paths given to
+ *   apr_json_path_decoder_create().
+ * @param val the matching value, valid until the callback returns.
+ */
+typedef apr_status_t (*apr_json_path_cb)(void *ctx, int index,
+                                         apr_json_value_t *val);
+
+/**
+ * Compile a JSON path, to be evaluated any number of times.
+ *
+ * The path is a JSON Pointer (RFC 6901), like "/user/id" or "/items/0",
+ * where "~1" stands for '/' and "~0" for '~' in the keys.  A segment of
+ * a single '*' matches any element of an array or member of an object,
+ * to get the price of all the items for instance.  The empty path
+ * matches the whole value.
+ * @param path the compiled path
+ * @param expr the path
+ * @param pool pool used to allocate the compiled path.
+ * @return APR_SUCCESS on success, APR_EINVAL if the path does not start
+ *   with a '/' nor is empty, APR_BADCH on an invalid escape.
+ */
+APR_DECLARE(apr_status_t) apr_json_path_compile(apr_json_path_t **path,
+        const char *expr, apr_pool_t *pool) __attribute__((nonnull(1, 2, 3)));
+
+/**
+ * Get the first value matching a compiled JSON path.
+ * @param path the compiled path
+ * @param json the JSON value to search.
+ * @return the first matching value, in document order, or NULL.
+ */
+APR_DECLARE(apr_json_value_t *) apr_json_path_get(
+        const apr_json_path_t *path, apr_json_value_t *json)
+        __attribute__((nonnull(1, 2)));
+
+/**
+ * Get all the values matching a compiled JSON path.
+ * @param path the compiled path
+ * @param json the JSON value to search.
+ * @param matches an array of apr_json_value_t pointers the matching values
+ *   are pushed to, in document order.
+ * @return the number of matching values.
+ */
+APR_DECLARE(int) apr_json_path_eval(const apr_json_path_t *path,
+        apr_json_value_t *json, apr_array_header_t *matches)
+        __attribute__((nonnull(1, 2, 3)));
+
+/**
+ * Create an incremental decoder passing the values matching some compiled
+ * JSON paths to a callback, and skipping the rest of the text without
+ * building it.  The decoder is then used as one created by
+ * apr_json_decoder_create(), and apr_json_decoder_finish() returns no
+ * result.
+ * @param dec the new decoder
+ * @param paths the compiled paths, at most 64.
+ * @param npaths the number of paths.
+ * @param cb the callback called for each value matching a path.
+ * @param ctx the context passed to the callback.
+ * @param level maximum nesting level we are prepared to decode.
+ * @param pool pool used to allocate the decoder.
+ * @return APR_SUCCESS on success, APR_EINVAL if there are more than 64
+ *   paths, or APR_ENOTIMPL on platforms where not implemented.
+ * @remark The strings, numbers and literals of the skipped parts are only
+ *   checked to be well formed, not decoded, and the matching values are
+ *   allocated from a subpool cleared after each call to the callback.
+ */
+APR_DECLARE(apr_status_t) apr_json_path_decoder_create(
+        apr_json_decoder_t **dec, apr_json_path_t *const *paths,
+        int npaths, apr_json_path_cb cb, void *ctx, int level,
+        apr_pool_t *pool) __attribute__((nonnull(1, 2, 4, 7)));
+
 /**
  * Encode data represented as apr_json_value_t to utf8-encoded JSON string
  * and append it to the specified brigade.
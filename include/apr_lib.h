@@ -124,10 +124,13 @@ APR_DECLARE(const char *) apr_filepath_name_get(const char *pathname);
  * - %%pB takes a apr_uint32_t * as bytes and outputs it's apr_strfsize
  * - %%pF same as above, but takes a apr_off_t *
  * - %%pS same as above, but takes a apr_size_t *
+ * - %%pd takes a double * and outputs the shortest string reading back
+ * as the same double (see apr_dtoa)
  *
  * %%pA, %%pI, %%pT, %%pp are available from APR 1.0.0 onwards (and in 0.9.x).
  * %%pt is only available from APR 1.2.0 onwards.
  * %%pm, %%pB, %%pF and %%pS are only available from APR 1.3.0 onwards.
+ * %%pd is only available from APR 2.0.0 onwards.
  *
  * The %%p hacks are to force gcc's printf warning code to skip
  * over a pointer argument without complaining.  This does
@@ -175,6 +178,22 @@ APR_DECLARE(int) apr_vformatter(int (*flush_func)(apr_vformatter_buff_t *b),
 			        apr_vformatter_buff_t *c, const char *fmt,
 			        va_list ap);
 
+/** @see apr_format_compile */
+typedef struct apr_format_t apr_format_t;
+
+/**
+ * apr_vformatter() with a format compiled by apr_format_compile(), so
+ * that it is not parsed again.
+ * @param flush_func The function to call when the buffer is full
+ * @param c The buffer to write to
+ * @param format The compiled format
+ * @param ap The arguments to use to fill out the format
+ * @return The number of bytes written, or -1 if flush_func failed
+ */
+APR_DECLARE(int) apr_format_vformatter(
+        int (*flush_func)(apr_vformatter_buff_t *b),
+        apr_vformatter_buff_t *c, const apr_format_t *format, va_list ap);
+
 /**
  * Display a prompt and read in the password from stdin.
  * @param prompt The prompt to display
@@ -49,6 +49,9 @@
 
 #include "apu.h"
 #include "apr_xlate.h"
+#include "apr_pools.h"
+#include "apr_time.h"
+#include "apr_thread_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -167,6 +170,89 @@ APR_DECLARE(apr_status_t) apr_bcrypt_encode(const char *pw,
 APR_DECLARE(apr_status_t) apr_password_validate(const char *passwd, 
                                                 const char *hash);
 
+/** Opaque cache of verified credentials */
+typedef struct apr_password_cache_t apr_password_cache_t;
+
+/**
+ * Create a cache of the credentials verified by
+ * apr_password_validate_cached(), such that validating them again is a
+ * lookup rather than a full crypt.
+ * @param cache The new cache.
+ * @param size The maximum number of credentials to remember, rounded up
+ *        to a power of two; the least lasting ones are replaced when full.
+ * @param ttl How long a verified credential is remembered.
+ * @param p The pool to allocate the cache from.
+ * @return APR_ENOTIMPL if the platform has no source of random bytes for
+ *         the secret key of the cache.
+ * @remark The credentials are remembered as a keyed hash (SipHash-2-4 with
+ *         a random key, 128 bits) of the user, the password and the hash,
+ *         never in the clear, and only those that validated.  A changed
+ *         password hash thus no longer matches what was remembered.  The
+ *         cache is thread safe.
+ */
+APR_DECLARE(apr_status_t) apr_password_cache_create(apr_password_cache_t **cache,
+                                                    apr_size_t size,
+                                                    apr_interval_time_t ttl,
+                                                    apr_pool_t *p);
+
+/**
+ * Forget all the credentials of a cache, for instance after revoking some.
+ * @param cache The cache.
+ */
+APR_DECLARE(void) apr_password_cache_clear(apr_password_cache_t *cache);
+
+/**
+ * Validate a password against a hash as apr_password_validate() does,
+ * unless the same user, password and hash were verified less than the ttl
+ * of the cache ago.
+ * @param cache The cache, or NULL to always validate.
+ * @param user The user the password is for, or NULL.
+ * @param passwd The password to validate.
+ * @param hash The password hash to validate against.
+ * @return APR_SUCCESS if the password matches, APR_EMISMATCH if it does
+ *         not, or another error from apr_password_validate().
+ */
+APR_DECLARE(apr_status_t) apr_password_validate_cached(apr_password_cache_t *cache,
+                                                       const char *user,
+                                                       const char *passwd,
+                                                       const char *hash);
+
+#if APR_HAS_THREADS || defined(DOXYGEN)
+
+/**
+ * The function called with the result of apr_password_validate_async().
+ * @param baton The baton given to apr_password_validate_async().
+ * @param status The result, as returned by apr_password_validate_cached().
+ */
+typedef void (apr_password_validate_fn)(void *baton, apr_status_t status);
+
+/**
+ * Validate a password in a thread of a pool, for the calling thread not to
+ * be blocked by the crypt (bcrypt notably).
+ * @param tp The thread pool to validate the password in.
+ * @param cache The cache of verified credentials, or NULL.
+ * @param user The user the password is for, or NULL.
+ * @param passwd The password to validate.
+ * @param hash The password hash to validate against.
+ * @param done The function to call with the result.
+ * @param baton The baton to give to done.
+ * @return APR_SUCCESS if done was or will be called, or the error of
+ *         apr_thread_pool_push() in which case it won't.
+ * @remark The strings are copied, they need not outlive the call.  When
+ *         the credentials are found in the cache, done is called right
+ *         away by the calling thread, otherwise by a thread of tp which
+ *         must then hand the result over to where it is expected.
+ */
+APR_DECLARE(apr_status_t) apr_password_validate_async(apr_thread_pool_t *tp,
+                                                      apr_password_cache_t *cache,
+                                                      const char *user,
+                                                      const char *passwd,
+                                                      const char *hash,
+                                                      apr_password_validate_fn *done,
+                                                      void *baton);
+
+#endif /* APR_HAS_THREADS */
+
 
 /** @} */
 #ifdef __cplusplus
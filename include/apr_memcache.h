@@ -30,10 +30,12 @@
 #include "apr_time.h"
 #include "apr_strings.h"
 #include "apr_network_io.h"
+#include "apr_poll.h"
 #include "apr_buckets.h"
 #include "apr_ring.h"
 #include "apr_reslist.h"
 #include "apr_hash.h"
+#include "apr_nearcache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -94,10 +96,14 @@ typedef apr_memcache_server_t* (*apr_memcache_server_func)(void *baton,
                                                  apr_memcache_t *mc,
                                                  const apr_uint32_t hash);
 
+/** The servers speak the meta protocol (memcached 1.6 and later), which
+ * the multiple gets then use */
+#define APR_MEMCACHE_META 0x01
+
 /** Container for a set of memcached servers */
 struct apr_memcache_t
 {
-    apr_uint32_t flags; /**< Flags, Not currently used */
+    apr_uint32_t flags; /**< Flags, APR_MEMCACHE_META or zero */
     apr_uint16_t nalloc; /**< Number of Servers Allocated */
     apr_uint16_t ntotal; /**< Number of Servers Added */
     apr_memcache_server_t **live_servers; /**< Array of Servers */
@@ -106,6 +112,9 @@ struct apr_memcache_t
     apr_memcache_hash_func hash_func;
     void *server_baton;
     apr_memcache_server_func server_func;
+    /** In-process cache of the values got, which the writes through this
+     * client invalidate, or NULL */
+    apr_nearcache_t *nearcache;
 };
 
 /** Returned Data from a multiple get */
@@ -144,6 +153,14 @@ APR_DECLARE(apr_uint32_t) apr_memcache_hash_default(void *baton,
                                                     const char *data,
                                                     const apr_size_t data_len);
 
+/**
+ * MD5 based hash compatible with libketama, to be used as the hash_func
+ * of apr_memcache_find_server_hash_ketama().
+ */
+APR_DECLARE(apr_uint32_t) apr_memcache_hash_ketama(void *baton,
+                                                   const char *data,
+                                                   const apr_size_t data_len);
+
 /**
  * Picks a server based on a hash
  * @param mc The memcache client object to use
@@ -162,6 +179,52 @@ apr_memcache_find_server_hash_default(void *baton,
                                       apr_memcache_t *mc, 
                                       const apr_uint32_t hash);
 
+/**
+ * Server selection with the jump consistent hash, to be used as the
+ * server_func (with no baton) such that adding a server at the end of
+ * live_servers only moves 1/ntotal of the keys.
+ * @remark The keys of a dead server move to the live ones, the others'
+ *         staying in place.
+ */
+APR_DECLARE(apr_memcache_server_t *)
+apr_memcache_find_server_hash_jump(void *baton,
+                                   apr_memcache_t *mc,
+                                   const apr_uint32_t hash);
+
+/** Opaque continuum of points used by apr_memcache_find_server_hash_ketama() */
+typedef struct apr_memcache_continuum_t apr_memcache_continuum_t;
+
+/** Default number of points per server in the continuum */
+#define APR_MEMCACHE_CONTINUUM_POINTS 160
+
+/**
+ * Create the ketama continuum of the servers of a client object
+ * @param continuum The pointer in which to return the continuum
+ * @param mc The client object, whose servers must have been added
+ * @param points The number of points per server, rounded up to a multiple
+ *               of four, or zero for APR_MEMCACHE_CONTINUUM_POINTS
+ * @param p The pool from which to allocate the continuum
+ * @remark The continuum must be created again when servers are added.
+ */
+APR_DECLARE(apr_status_t)
+apr_memcache_continuum_create(apr_memcache_continuum_t **continuum,
+                              apr_memcache_t *mc, apr_uint32_t points,
+                              apr_pool_t *p);
+
+/**
+ * Server selection with a ketama continuum, to be used as the server_func
+ * with the continuum as server_baton, such that adding or removing a
+ * server only moves the keys of its points (1/ntotal on average).
+ * @remark The lookup costs O(log(points * ntotal)), and the keys of a dead
+ *         server move to the servers of the next points.
+ * @remark The continuum covers hash values on 32 bits, so the hash_func
+ *         should be apr_memcache_hash_ketama() or apr_memcache_hash_crc32().
+ */
+APR_DECLARE(apr_memcache_server_t *)
+apr_memcache_find_server_hash_ketama(void *baton,
+                                     apr_memcache_t *mc,
+                                     const apr_uint32_t hash);
+
 /**
  * Adds a server to a client object
  * @param mc The memcache client object to use
@@ -227,7 +290,7 @@ APR_DECLARE(apr_status_t) apr_memcache_server_create(apr_pool_t *p,
  * Creates a new memcached client object
  * @param p Pool to use
  * @param max_servers maximum number of servers
- * @param flags Not currently used
+ * @param flags APR_MEMCACHE_META to use the meta protocol, or zero
  * @param mc   location of the new memcache client object
  */
 APR_DECLARE(apr_status_t) apr_memcache_create(apr_pool_t *p,
@@ -244,6 +307,8 @@ APR_DECLARE(apr_status_t) apr_memcache_create(apr_pool_t *p,
  * @param len   length of data at baton
  * @param flags any flags set by the client for this key
  * @return 
+ * @remark With mc->nearcache set, the value is got from there if cached,
+ *         and cached there otherwise.
  */
 APR_DECLARE(apr_status_t) apr_memcache_getp(apr_memcache_t *mc, 
                                             apr_pool_t *p,
@@ -280,6 +345,174 @@ APR_DECLARE(apr_status_t) apr_memcache_multgetp(apr_memcache_t *mc,
                                                 apr_pool_t *data_pool,
                                                 apr_hash_t *values);
 
+/** Opaque multiget context, reusable for successive multigets */
+typedef struct apr_memcache_multget_t apr_memcache_multget_t;
+
+/** The default maximum number of keys in a single get command */
+#define APR_MEMCACHE_MULTGET_KEYS 100
+
+/**
+ * Create a context for multiple gets
+ * @param multget location of the new context
+ * @param mc client to use
+ * @param max_keys the maximum number of keys sent in a single get command,
+ *        more keys being split in several commands sent back to back, or
+ *        zero for APR_MEMCACHE_MULTGET_KEYS
+ * @param timeout how long to wait for the replies of the servers, or zero
+ *        for the default
+ * @param p pool from where the context, and the queries it builds, are
+ *        allocated
+ * @remark The context is not thread safe, each thread needs its own.
+ */
+APR_DECLARE(apr_status_t) apr_memcache_multget_create(
+                                            apr_memcache_multget_t **multget,
+                                            apr_memcache_t *mc,
+                                            apr_uint32_t max_keys,
+                                            apr_interval_time_t timeout,
+                                            apr_pool_t *p);
+
+/**
+ * Gets multiple values from the servers, using a multiget context
+ * @param multget context to use
+ * @param data_pool Pool used to allocate data for the returned values.
+ * @param values hash of apr_memcache_value_t keyed by strings, contains the
+ *        result of the multiget call.
+ * @return APR_SUCCESS, the status of each value telling whether it was found
+ * @remark The queries are written to all the servers concerned at once,
+ *         and their replies read as they come, without blocking on any
+ *         single server.
+ * @remark With APR_MEMCACHE_META, each key is a quiet mg command, the
+ *         misses not being answered, and the replies of a server end
+ *         with that of an mn command.
+ * @remark With mc->nearcache set, the values cached there are not queried,
+ *         and those found on the servers are cached there.
+ */
+APR_DECLARE(apr_status_t) apr_memcache_multget_exec(
+                                            apr_memcache_multget_t *multget,
+                                            apr_pool_t *data_pool,
+                                            apr_hash_t *values);
+
+/** Opaque asynchronous connection to a memcached server */
+typedef struct apr_memcache_async_t apr_memcache_async_t;
+
+/**
+ * Function prototype of the callbacks of the asynchronous commands
+ * @param ac the connection
+ * @param status the outcome of the command, or the error of the connection
+ * @param baton the opaque baton given with the command
+ */
+typedef void (apr_memcache_async_cb_t)(apr_memcache_async_t *ac,
+                                       apr_status_t status,
+                                       void *baton);
+
+/**
+ * Create an asynchronous connection to a server, whose commands are sent
+ * without waiting for the replies of the previous ones (pipelined), the
+ * replies calling back the commands in order as they are read
+ * @param ac location of the new connection
+ * @param ms server to connect to
+ * @param pollcb pollcb to which the connection's socket is added, e.g. the
+ *        one of an apr_reactor_t
+ * @param client_data client_data of the socket's descriptor in @a pollcb,
+ *        or NULL for @a ac
+ * @param p pool from which the connection is allocated, whose cleanup
+ *        removes the socket from @a pollcb and closes it
+ * @return APR_SUCCESS, or the error of the connection or of the pollcb
+ * @remark The connection is established before this returns, the socket
+ *         is non-blocking thereafter.
+ * @remark The pollcb's callback calls apr_memcache_async_process() for the
+ *         descriptor of @a client_data.  A connection is used from the
+ *         thread polling @a pollcb only.
+ */
+APR_DECLARE(apr_status_t)
+apr_memcache_async_create(apr_memcache_async_t **ac,
+                          apr_memcache_server_t *ms,
+                          apr_pollcb_t *pollcb,
+                          void *client_data,
+                          apr_pool_t *p);
+
+/**
+ * Get a value asynchronously
+ * @param ac connection to use
+ * @param data_pool pool from which the value's data is allocated
+ * @param value the value to get, whose key is set, filled before @a func
+ *        is called
+ * @param func function called with APR_SUCCESS, APR_NOTFOUND, or an error
+ * @param baton the opaque baton passed to @a func
+ * @return APR_SUCCESS if @a func will be called, from
+ *         apr_memcache_async_process(), or the error of the connection
+ * @remark The command is written right away if the socket is writable,
+ *         otherwise once apr_memcache_async_process() is told it is.
+ */
+APR_DECLARE(apr_status_t)
+apr_memcache_async_getp(apr_memcache_async_t *ac,
+                        apr_pool_t *data_pool,
+                        apr_memcache_value_t *value,
+                        apr_memcache_async_cb_t *func,
+                        void *baton);
+
+/**
+ * Get multiple values asynchronously, with a single command
+ * @param ac connection to use
+ * @param data_pool pool from which the values' data is allocated
+ * @param values hash of apr_memcache_value_t keyed by strings, see
+ *        apr_memcache_add_multget_key(), all stored on the server of @a ac
+ * @param func function called with APR_SUCCESS once the values are
+ *        filled, their status telling whether they were found, or an error
+ * @param baton the opaque baton passed to @a func
+ */
+APR_DECLARE(apr_status_t)
+apr_memcache_async_multgetp(apr_memcache_async_t *ac,
+                            apr_pool_t *data_pool,
+                            apr_hash_t *values,
+                            apr_memcache_async_cb_t *func,
+                            void *baton);
+
+/**
+ * Set a value asynchronously
+ * @param ac connection to use
+ * @param key null terminated string containing the key
+ * @param data data to store on the server, copied
+ * @param data_size length of data
+ * @param timeout time in seconds for the data to live on the server
+ * @param flags any flags set by the client for this key
+ * @param func function called with APR_SUCCESS, APR_EEXIST if not stored,
+ *        or an error
+ * @param baton the opaque baton passed to @a func
+ * @remark The value is not invalidated in mc->nearcache.
+ */
+APR_DECLARE(apr_status_t)
+apr_memcache_async_set(apr_memcache_async_t *ac,
+                       const char *key,
+                       const char *data,
+                       apr_size_t data_size,
+                       apr_uint32_t timeout,
+                       apr_uint16_t flags,
+                       apr_memcache_async_cb_t *func,
+                       void *baton);
+
+/**
+ * Process the events of an asynchronous connection's socket: write the
+ * commands pending and read the replies available, calling back their
+ * commands
+ * @param ac connection to use
+ * @param rtnevents the events signalled by the pollcb
+ * @return APR_SUCCESS, or the error which failed the connection, with which
+ *         the pending commands are then called back
+ * @remark Once failed, a connection refuses new commands, and should be
+ *         cleaned up and created again.
+ */
+APR_DECLARE(apr_status_t)
+apr_memcache_async_process(apr_memcache_async_t *ac, apr_int16_t rtnevents);
+
+/**
+ * Get the number of commands of an asynchronous connection awaiting
+ * their reply
+ * @param ac connection to use
+ */
+APR_DECLARE(apr_size_t)
+apr_memcache_async_pending(apr_memcache_async_t *ac);
+
 /**
  * Sets a value by key on the server
  * @param mc client to use
@@ -341,6 +574,69 @@ APR_DECLARE(apr_status_t) apr_memcache_delete(apr_memcache_t *mc,
                                               const char *key,
                                               apr_uint32_t timeout);
 
+/**
+ * Gets a value and its CAS from the server with the meta protocol,
+ * refreshing its time to live in the same round trip
+ * @param mc client to use
+ * @param p Pool to use
+ * @param key null terminated string containing the key
+ * @param timeout new time in seconds for the data to live on the server,
+ *        or a negative value to leave it
+ * @param baton location of the allocated value
+ * @param len   length of data at baton
+ * @param flags any flags set by the client for this key, or NULL
+ * @param cas location of the CAS of the value, or NULL
+ * @return APR_SUCCESS, or APR_NOTFOUND if the key is not on the server
+ * @remark The value is always got from the server, for its CAS to be
+ *         current, mc->nearcache being left alone.
+ */
+APR_DECLARE(apr_status_t) apr_memcache_meta_getp(apr_memcache_t *mc,
+                                                 apr_pool_t *p,
+                                                 const char *key,
+                                                 apr_int32_t timeout,
+                                                 char **baton,
+                                                 apr_size_t *len,
+                                                 apr_uint16_t *flags,
+                                                 apr_uint64_t *cas);
+
+/**
+ * Sets a value by key on the server with the meta protocol, if its CAS
+ * did not change
+ * @param mc client to use
+ * @param key   null terminated string containing the key
+ * @param baton data to store on the server
+ * @param data_size   length of data at baton
+ * @param timeout time in seconds for the data to live on the server
+ * @param flags any flags set by the client for this key
+ * @param cas the CAS the value must still have, as returned by
+ *        apr_memcache_meta_getp(), or zero to set it regardless
+ * @param new_cas location of the CAS of the stored value, or NULL
+ * @return APR_SUCCESS if the value was stored, APR_EEXIST if its CAS
+ *         changed, APR_NOTFOUND if a CAS was given and the key is gone.
+ */
+APR_DECLARE(apr_status_t) apr_memcache_meta_set(apr_memcache_t *mc,
+                                                const char *key,
+                                                char *baton,
+                                                const apr_size_t data_size,
+                                                apr_uint32_t timeout,
+                                                apr_uint16_t flags,
+                                                apr_uint64_t cas,
+                                                apr_uint64_t *new_cas);
+
+/**
+ * Deletes a key from a server with the meta protocol, if its CAS did not
+ * change
+ * @param mc client to use
+ * @param key   null terminated string containing the key
+ * @param cas the CAS the value must still have, or zero to delete it
+ *        regardless
+ * @return APR_SUCCESS if the key was deleted, APR_NOTFOUND if it is not
+ *         on the server, APR_EEXIST if its CAS changed.
+ */
+APR_DECLARE(apr_status_t) apr_memcache_meta_delete(apr_memcache_t *mc,
+                                                   const char *key,
+                                                   apr_uint64_t cas);
+
 /**
  * Increments a value
  * @param mc client to use
@@ -46,6 +46,17 @@ extern "C" {
 #define APR_MMAP_READ    1
 /** MMap opened for writing */
 #define APR_MMAP_WRITE   2
+/** The mapping will be read sequentially (hint) */
+#define APR_MMAP_SEQUENTIAL 4
+/** The mapping will be read in random order (hint) */
+#define APR_MMAP_RANDOM     8
+/** The mapping will be read soon, start reading it in (hint) */
+#define APR_MMAP_WILLNEED   16
+/** Back the mapping with huge pages where possible (hint) */
+#define APR_MMAP_HUGEPAGE   32
+
+/** @see apr_mmap_cache_t */
+typedef struct apr_mmap_cache_t      apr_mmap_cache_t;
 
 /** @see apr_mmap_t */
 typedef struct apr_mmap_t            apr_mmap_t;
@@ -80,6 +91,9 @@ struct apr_mmap_t {
     /** ring of apr_mmap_t's that reference the same
      * mmap'ed region; acts in place of a reference count */
     APR_RING_ENTRY(apr_mmap_t) link;
+    /** The mapping cache entry this mmap'ed region belongs to, or NULL
+     *  if the region is private to the ring */
+    struct apr_mmap_shared_t *shared;
 };
 
 #if APR_HAS_MMAP || defined(DOXYGEN)
@@ -124,8 +138,14 @@ struct apr_mmap_t {
  * <PRE>
  *          APR_MMAP_READ       MMap opened for reading
  *          APR_MMAP_WRITE      MMap opened for writing
+ *          APR_MMAP_SEQUENTIAL The mapping will be read sequentially
+ *          APR_MMAP_RANDOM     The mapping will be read in random order
+ *          APR_MMAP_WILLNEED   Start reading the mapping in
+ *          APR_MMAP_HUGEPAGE   Back the mapping with huge pages
  * </PRE>
  * @param cntxt The pool to use when creating the mmap.
+ * @remark The hints are given to the system with madvise() where
+ *         available, and ignored otherwise.
  */
 APR_DECLARE(apr_status_t) apr_mmap_create(apr_mmap_t **newmmap, 
                                           apr_file_t *file, apr_off_t offset,
@@ -157,6 +177,48 @@ APR_DECLARE(apr_status_t) apr_mmap_delete(apr_mmap_t *mm);
 APR_DECLARE(apr_status_t) apr_mmap_offset(void **addr, apr_mmap_t *mm, 
                                           apr_off_t offset);
 
+/**
+ * Create a cache of mmap'ed regions, shared by the files mapped again
+ * and again.
+ * @param cache The newly created cache.
+ * @param max_bytes The size of the regions kept mapped once no mmap
+ *                  refers to them anymore; the least recently used ones
+ *                  are unmapped beyond.
+ * @param p The pool from which to allocate the cache, and whose cleanup
+ *          unmaps the regions.
+ * @return APR_SUCCESS, or APR_ENOTIMPL if not supported by the platform.
+ * @remark The cache can be used by multiple threads, and must outlive the
+ *         pools of the mmaps it returns.
+ */
+APR_DECLARE(apr_status_t) apr_mmap_cache_create(apr_mmap_cache_t **cache,
+                                                apr_size_t max_bytes,
+                                                apr_pool_t *p);
+
+/**
+ * Get an mmap of the given region of a file, sharing the mapping with
+ * the other mmaps of the same region (file device, inode and modification
+ * time, offset, size and access) taken from the cache.
+ * @param newmmap The mmap of the region.
+ * @param cache The mapping cache.
+ * @param file The file to map.
+ * @param offset The offset into the file to start the data pointer at.
+ * @param size The size of the region.
+ * @param flag As apr_mmap_create(), the hints applying only when the
+ *             region is mapped.
+ * @param cntxt The pool to use for the mmap, whose cleanup (or
+ *              apr_mmap_delete()) releases the region.
+ * @remark The mmap is as one created by apr_mmap_create(), and can be
+ *         duplicated with apr_mmap_dup(); the region is given back to the
+ *         cache when the last of them is deleted.
+ */
+APR_DECLARE(apr_status_t) apr_mmap_cache_get(apr_mmap_t **newmmap,
+                                             apr_mmap_cache_t *cache,
+                                             apr_file_t *file,
+                                             apr_off_t offset,
+                                             apr_size_t size,
+                                             apr_int32_t flag,
+                                             apr_pool_t *cntxt);
+
 #endif /* APR_HAS_MMAP */
 
 /** @} */
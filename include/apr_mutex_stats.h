@@ -0,0 +1,109 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_MUTEX_STATS_H
+#define APR_MUTEX_STATS_H
+
+/**
+ * @file apr_mutex_stats.h
+ * @brief APR Mutex Contention Statistics
+ *
+ * @remark The mutexes named with apr_thread_mutex_name_set(),
+ * apr_proc_mutex_name_set() or apr_global_mutex_name_set() account for
+ * their locks, and for the time spent waiting when they were contended
+ * along with where the lock was called and held.  The other mutexes cost
+ * a single test more per lock.
+ */
+
+#include "apr.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_file_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_mutex_stats Mutex Contention Statistics
+ * @ingroup APR
+ * @{
+ */
+
+/** The contention statistics of a named mutex */
+typedef struct apr_mutex_stats_t {
+    /** The name of the mutex */
+    const char *name;
+    /** The kind of mutex: "thread" or "proc" (the parts of a global mutex
+     * are accounted for separately) */
+    const char *kind;
+    /** Number of times the mutex was locked */
+    apr_uint64_t locks;
+    /** Number of those which had to wait for another holder */
+    apr_uint64_t contended;
+    /** Total time waited */
+    apr_interval_time_t wait_time;
+    /** Longest wait */
+    apr_interval_time_t wait_max;
+    /** Code address of the lock call which waited the longest, or NULL if
+     * the compiler does not tell */
+    const void *wait_max_site;
+    /** Code address of the lock call holding the mutex meanwhile, or NULL
+     * if unknown (e.g. held by another process) */
+    const void *wait_max_holder;
+} apr_mutex_stats_t;
+
+/**
+ * Callback for apr_mutex_stats_do()
+ * @param baton The baton passed to apr_mutex_stats_do()
+ * @param stats The statistics of a mutex
+ * @return Non-zero to continue, zero to stop the iteration
+ */
+typedef int (apr_mutex_stats_do_fn_t)(void *baton,
+                                      const apr_mutex_stats_t *stats);
+
+/**
+ * Iterate over the statistics of all the named mutexes of the process
+ * @param fn The function to call for each mutex
+ * @param baton The baton to pass to @a fn
+ * @remark The statistics are updated without synchronization with this
+ *         call, so they may be slightly off.  @a fn must not create,
+ *         name or destroy a named mutex.
+ */
+APR_DECLARE(void) apr_mutex_stats_do(apr_mutex_stats_do_fn_t *fn,
+                                     void *baton);
+
+/**
+ * Write the statistics of all the named mutexes of the process, one line
+ * per mutex, the most contended first
+ * @param file The file to write to
+ * @param p The pool for temporary allocations
+ */
+APR_DECLARE(apr_status_t) apr_mutex_stats_dump(apr_file_t *file,
+                                               apr_pool_t *p);
+
+/**
+ * Reset the statistics of all the named mutexes of the process
+ */
+APR_DECLARE(void) apr_mutex_stats_reset(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_MUTEX_STATS_H */
@@ -0,0 +1,153 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_NEARCACHE_H
+#define APR_NEARCACHE_H
+
+/**
+ * @file apr_nearcache.h
+ * @brief APR in-process cache of remote values
+ *
+ * @remark A near cache keeps the values most recently got from a remote
+ * cache (apr_memcache, apr_redis) in the memory of the process, for a
+ * time to live bounding how stale they can get, such that the hot keys
+ * do not cost a round trip each.  Its size is bounded in bytes, the least
+ * recently used values being evicted first, and its entries are split in
+ * shards by the hash of their keys, each with its own lock, such that the
+ * threads using it seldom contend.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_nearcache In-process cache of remote values
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the near cache API */
+typedef struct apr_nearcache_t apr_nearcache_t;
+
+/** The default number of shards of a near cache */
+#define APR_NEARCACHE_SHARDS 16
+
+/** Statistics of a near cache */
+typedef struct apr_nearcache_stats_t {
+    apr_uint64_t hits;      /**< Values found */
+    apr_uint64_t misses;    /**< Values not found, or expired */
+    apr_uint64_t evictions; /**< Values evicted for room */
+    apr_size_t entries;     /**< Values cached */
+    apr_size_t bytes;       /**< Bytes used by the values and their keys */
+} apr_nearcache_stats_t;
+
+/**
+ * Create a near cache
+ * @param nc The pointer in which to return the newly created object
+ * @param max_bytes The maximum size of the cache, its keys and values
+ *                  included
+ * @param ttl The default time in microseconds during which a value is
+ *            served, or zero for no expiry
+ * @param shards The number of shards, rounded up to a power of two, or
+ *               zero for APR_NEARCACHE_SHARDS
+ * @param p The pool from which to allocate the cache, and whose cleanup
+ *          frees its values
+ * @return APR_EINVAL if @a ttl is negative
+ * @remark Each shard gets an equal part of @a max_bytes.
+ */
+APR_DECLARE(apr_status_t) apr_nearcache_create(apr_nearcache_t **nc,
+                                               apr_size_t max_bytes,
+                                               apr_interval_time_t ttl,
+                                               apr_uint32_t shards,
+                                               apr_pool_t *p);
+
+/**
+ * Get a value from a near cache
+ * @param nc The near cache
+ * @param key The key
+ * @param klen The length of the key
+ * @param p The pool from which to copy the value
+ * @param data Location of the value, nul terminated
+ * @param len Location of the length of the value
+ * @param flags Location of the flags of the value, or NULL
+ * @return APR_SUCCESS, or APR_NOTFOUND if the value is not cached or
+ *         expired
+ */
+APR_DECLARE(apr_status_t) apr_nearcache_get(apr_nearcache_t *nc,
+                                            const char *key,
+                                            apr_size_t klen,
+                                            apr_pool_t *p,
+                                            char **data,
+                                            apr_size_t *len,
+                                            apr_uint16_t *flags);
+
+/**
+ * Cache a value in a near cache, replacing any previous one
+ * @param nc The near cache
+ * @param key The key
+ * @param klen The length of the key
+ * @param data The value, copied
+ * @param len The length of the value
+ * @param flags The flags of the value
+ * @param ttl The time in microseconds during which the value is served,
+ *            or zero for the default of the cache
+ * @return APR_SUCCESS, or APR_ENOSPC if the value does not fit a shard
+ */
+APR_DECLARE(apr_status_t) apr_nearcache_set(apr_nearcache_t *nc,
+                                            const char *key,
+                                            apr_size_t klen,
+                                            const char *data,
+                                            apr_size_t len,
+                                            apr_uint16_t flags,
+                                            apr_interval_time_t ttl);
+
+/**
+ * Remove a value from a near cache
+ * @param nc The near cache
+ * @param key The key
+ * @param klen The length of the key
+ */
+APR_DECLARE(void) apr_nearcache_delete(apr_nearcache_t *nc,
+                                       const char *key,
+                                       apr_size_t klen);
+
+/**
+ * Remove all the values of a near cache
+ * @param nc The near cache
+ */
+APR_DECLARE(void) apr_nearcache_clear(apr_nearcache_t *nc);
+
+/**
+ * Get the statistics of a near cache
+ * @param nc The near cache
+ * @param stats The statistics, summed over the shards
+ */
+APR_DECLARE(void) apr_nearcache_stats_get(apr_nearcache_t *nc,
+                                          apr_nearcache_stats_t *stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_NEARCACHE_H */
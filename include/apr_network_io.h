@@ -108,6 +108,24 @@ extern "C" {
 #define APR_SO_FREEBIND     131072 /**< Allow binding to addresses not owned
                                     * by any interface
                                     */
+#define APR_SO_REUSEPORT    262144 /**< Allow multiple sockets to bind to the
+                                    * same address, balancing the incoming
+                                    * connections or datagrams among them
+                                    * @see apr_socket_listen_group_create
+                                    */
+#define APR_SO_UDP_GRO     524288 /**< Let the kernel coalesce the
+                                    * datagrams received from one peer
+                                    * @see apr_socket_recvmmsg
+                                    */
+#define APR_SO_ZEROCOPY   1048576 /**< Allow sending from the caller's
+                                   * pages without copying them
+                                   * @see apr_socket_sendv_zerocopy
+                                   */
+#define APR_SO_SYSTIMEOUT 2097152 /**< Have the system time out the
+                                   * I/O on a blocking socket rather than
+                                   * polling it for the socket timeout
+                                   * @see apr_socket_timeout_set
+                                   */
 
 /** @} */
 
@@ -225,6 +243,8 @@ typedef struct apr_hdtr_t       apr_hdtr_t;
 typedef struct in_addr          apr_in_addr_t;
 /** A structure to represent an IP subnet */
 typedef struct apr_ipsubnet_t apr_ipsubnet_t;
+/** A structure to represent a set of IP subnets */
+typedef struct apr_ipset_t apr_ipset_t;
 
 /** @remark use apr_uint16_t just in case some system has a short that isn't 16 bits... */
 typedef apr_uint16_t            apr_port_t;
@@ -356,6 +376,64 @@ APR_DECLARE(apr_status_t) apr_socket_bind(apr_socket_t *sock,
 APR_DECLARE(apr_status_t) apr_socket_listen(apr_socket_t *sock, 
                                             apr_int32_t backlog);
 
+/** Opaque structure of a group of sockets bound to the same address */
+typedef struct apr_socket_listen_group_t apr_socket_listen_group_t;
+
+/**
+ * Steer the connections (or datagrams) of a listen group to the socket
+ * with the index of the CPU handling them (modulo the group's size)
+ * @see apr_socket_listen_group_create
+ */
+#define APR_LISTEN_GROUP_STEER_CPU 0x01
+
+/**
+ * Create a group of sockets bound to the same address with APR_SO_REUSEPORT,
+ * and listening to it for the stream sockets, typically one per worker
+ * thread so that each accepts from its own listen queue
+ * @param group The new group
+ * @param sa The socket address to bind to, if its port is zero the first
+ *           socket picks one for the others
+ * @param type The type of the sockets (e.g., SOCK_STREAM)
+ * @param protocol The protocol of the sockets (e.g., APR_PROTO_TCP)
+ * @param nsockets The number of sockets in the group
+ * @param backlog The listen queue size of each socket, as for
+ *                apr_socket_listen()
+ * @param flags Zero or APR_LISTEN_GROUP_STEER_CPU
+ * @param p The pool for the group and its sockets
+ * @returns APR_ENOTIMPL if APR_SO_REUSEPORT, or the steering policy, is not
+ *          supported on this platform, APR_EINVAL if @a nsockets is not
+ *          positive
+ * @remark With APR_LISTEN_GROUP_STEER_CPU (Linux only), the socket at index
+ *         N of the group gets what is received by the CPU N (modulo
+ *         @a nsockets), which is best served by a thread bound to that CPU.
+ *         Otherwise the kernel balances by hashing the peers' addresses.
+ */
+APR_DECLARE(apr_status_t) apr_socket_listen_group_create(
+                                          apr_socket_listen_group_t **group,
+                                          apr_sockaddr_t *sa,
+                                          int type, int protocol,
+                                          int nsockets,
+                                          apr_int32_t backlog,
+                                          apr_uint32_t flags,
+                                          apr_pool_t *p);
+
+/**
+ * Get the number of sockets in a listen group
+ * @param group The group
+ */
+APR_DECLARE(int) apr_socket_listen_group_size(
+                                    const apr_socket_listen_group_t *group);
+
+/**
+ * Get a socket of a listen group
+ * @param group The group
+ * @param index The index of the socket, from zero to the group's size - 1
+ * @return The socket, or NULL if @a index is out of range
+ */
+APR_DECLARE(apr_socket_t *) apr_socket_listen_group_get(
+                                    const apr_socket_listen_group_t *group,
+                                    int index);
+
 /**
  * Accept a new connection request
  * @param new_sock A copy of the socket that is connected to the socket that
@@ -380,6 +458,51 @@ APR_DECLARE(apr_status_t) apr_socket_accept(apr_socket_t **new_sock,
 APR_DECLARE(apr_status_t) apr_socket_connect(apr_socket_t *sock,
                                              apr_sockaddr_t *sa);
 
+/**
+ * Use TCP Fast Open for the connections of apr_socket_connect_any(), so
+ * that a destination connected to before is connected to at once
+ * @see apr_socket_connect_any
+ */
+#define APR_CONNECT_FASTOPEN 0x01
+
+/** The default connection attempt delay of apr_socket_connect_any() */
+#define APR_CONNECT_ANY_DELAY apr_time_from_msec(250)
+
+/**
+ * Connect to any of a list of addresses, such as returned by
+ * apr_sockaddr_info_get(), racing the address families ("Happy Eyeballs",
+ * RFC 8305) so that an unreachable one does not delay the connection
+ * @param sock The new connected socket
+ * @param sa The first address of the list
+ * @param type The type of the socket (e.g., SOCK_STREAM)
+ * @param protocol The protocol of the socket (e.g., APR_PROTO_TCP)
+ * @param delay The time given to each connection attempt before the next
+ *              one starts alongside, or a negative value for
+ *              APR_CONNECT_ANY_DELAY (at least 10 milliseconds)
+ * @param timeout The time to connect in, or a negative value to wait
+ *                until each attempt succeeds or fails
+ * @param flags Zero or APR_CONNECT_FASTOPEN
+ * @param p The pool for the new socket
+ * @return APR_TIMEUP if @a timeout expired, APR_ENOTIMPL if
+ *         APR_CONNECT_FASTOPEN is not supported on this platform, or the
+ *         error of the last attempt to fail if none succeeded
+ * @remark The addresses are tried in their order, alternating the address
+ *         families from the first one's, the next attempt starting when
+ *         the previous ones failed or after @a delay.  The first connected
+ *         socket is returned in blocking mode, the others are closed.
+ * @remark With APR_CONNECT_FASTOPEN (Linux only), a destination having
+ *         given a Fast Open cookie before connects at once, the handshake
+ *         completing with the first data written to the socket; otherwise
+ *         the flag is ignored by the system.
+ */
+APR_DECLARE(apr_status_t) apr_socket_connect_any(apr_socket_t **sock,
+                                                 apr_sockaddr_t *sa,
+                                                 int type, int protocol,
+                                                 apr_interval_time_t delay,
+                                                 apr_interval_time_t timeout,
+                                                 apr_uint32_t flags,
+                                                 apr_pool_t *p);
+
 /**
  * Determine whether the receive part of the socket has been closed by
  * the peer (such that a subsequent call to apr_socket_read would
@@ -583,6 +706,45 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
                                            const struct iovec *vec,
                                            apr_int32_t nvec, apr_size_t *len);
 
+/**
+ * Send multiple buffers over a network without copying them, the kernel
+ * referencing the caller's pages until it notifies their release.
+ * @param sock The socket to send the data over, with APR_SO_ZEROCOPY set
+ * @param vec The array of iovec structs containing the data to send
+ * @param nvec The number of iovec structs in the array
+ * @param len Receives the number of bytes actually written
+ * @param id Receives the identifier of this send, to match the ranges
+ *           returned by apr_socket_zerocopy_reap(), if @a len is not zero
+ * @remark This acts like apr_socket_sendv(), but the buffers must not be
+ *         modified nor freed until the completion of @a id is reaped.
+ *         The identifiers are consecutive per socket, starting from zero.
+ *         Since pinning the pages has a cost, this is only worthwhile
+ *         for large buffers (tens of kilobytes).
+ * @return APR_EINVAL if APR_SO_ZEROCOPY is not set on @a sock, ENOBUFS if
+ *         too many completions are pending, APR_ENOTIMPL if not supported
+ */
+APR_DECLARE(apr_status_t) apr_socket_sendv_zerocopy(apr_socket_t *sock,
+                                                    const struct iovec *vec,
+                                                    apr_int32_t nvec,
+                                                    apr_size_t *len,
+                                                    apr_uint32_t *id);
+
+/**
+ * Reap a completion of the sends made with apr_socket_sendv_zerocopy()
+ * @param sock The socket the data were sent over
+ * @param lo Receives the first identifier of the completed range
+ * @param hi Receives the last identifier of the completed range
+ * @param copied Receives non-zero if the kernel copied the data anyway, in
+ *               which case zero copy does not pay off on this socket
+ * @remark The pending completions make @a sock signal APR_POLLERR to
+ *         apr_poll() and pollsets, and this function never blocks.
+ * @return APR_EAGAIN if there is no completion to reap
+ */
+APR_DECLARE(apr_status_t) apr_socket_zerocopy_reap(apr_socket_t *sock,
+                                                   apr_uint32_t *lo,
+                                                   apr_uint32_t *hi,
+                                                   int *copied);
+
 /**
  * @param sock The socket to send from
  * @param where The apr_sockaddr_t describing where to send the data
@@ -612,6 +774,69 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
                                               apr_socket_t *sock,
                                               apr_int32_t flags, char *buf, 
                                               apr_size_t *len);
+
+/** A datagram sent by apr_socket_sendmmsg() or received by
+ *  apr_socket_recvmmsg() */
+typedef struct apr_socket_msg_t {
+    /** The data to send, or the buffer in which to receive */
+    char *buf;
+    /** On entry, the length of the data to send or the size of @a buf to
+     *  receive in; on exit, the number of bytes sent or received */
+    apr_size_t len;
+    /** On send, the destination (NULL for a connected socket); on receive,
+     *  updated with the source if not NULL */
+    apr_sockaddr_t *addr;
+    /** On send, the size of the datagrams to cut @a buf into, or zero to
+     *  send one datagram; on receive, the size of the datagrams coalesced
+     *  in @a buf with APR_SO_UDP_GRO, or zero for a single datagram */
+    apr_size_t segment;
+} apr_socket_msg_t;
+
+/**
+ * Send multiple datagrams from a socket, with as few system calls as
+ * possible.
+ * @param sock The socket to send from
+ * @param msgs The datagrams to send
+ * @param nmsgs The number of elements in @a msgs
+ * @param flags The flags to use, as for apr_socket_sendto()
+ * @param nsent The number of elements of @a msgs which were sent
+ * @remark A message with a non-zero @c segment is sent as consecutive
+ *         datagrams of @c segment bytes (the last one possibly shorter),
+ *         using the generic segmentation offload (UDP_SEGMENT) where
+ *         available, or one datagram at a time otherwise.
+ * @remark Fewer than @a nmsgs messages may be sent on a non-blocking socket
+ *         or when an error occurs after the first message, in which case
+ *         APR_SUCCESS is returned and the error is returned by the next
+ *         call.
+ * @return APR_EINVAL if @a nmsgs is negative, or if a @c segment is larger
+ *         than 65535 bytes
+ */
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_int32_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_int32_t *nsent);
+
+/**
+ * Receive multiple datagrams from a socket, with as few system calls as
+ * possible.
+ * @param sock The socket to receive from
+ * @param msgs The buffers in which to receive the datagrams
+ * @param nmsgs The number of elements in @a msgs
+ * @param flags The flags to use, as for apr_socket_recvfrom()
+ * @param nrecv The number of elements of @a msgs which were filled in
+ * @remark This waits for the first datagram according to the timeout of
+ *         @a sock, then receives those already queued without waiting.
+ * @remark With APR_SO_UDP_GRO set on @a sock, a message may hold several
+ *         datagrams of @c segment bytes (the last one possibly shorter)
+ *         from the same source.
+ * @return APR_EINVAL if @a nmsgs is negative
+ */
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_int32_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_int32_t *nrecv);
  
 #if APR_HAS_SENDFILE || defined(DOXYGEN)
 
@@ -633,6 +858,11 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
  * The offset parameter is passed by reference for no reason; its
  * value will never be modified by the apr_socket_sendfile() function.
  * It is possible for both bytes to be sent and an error to be returned.
+ * @remark On Linux, the headers are sent with MSG_MORE so that they share
+ *         the first segments with the file, TCP_CORK being only set when
+ *         there are trailers.  A socket whose TLS records are offloaded to
+ *         the kernel (kTLS) can be given as is, the file being encrypted
+ *         without being copied to userspace.
  */
 APR_DECLARE(apr_status_t) apr_socket_sendfile(apr_socket_t *sock, 
                                               apr_file_t *file,
@@ -643,6 +873,47 @@ APR_DECLARE(apr_status_t) apr_socket_sendfile(apr_socket_t *sock,
 
 #endif /* APR_HAS_SENDFILE */
 
+#if APR_HAS_SPLICE || defined(DOXYGEN)
+
+/**
+ * Move data read from a socket to another socket, without copying it
+ * to userspace
+ * @param to The socket to which we're writing
+ * @param from The socket from which to read
+ * @param len (input)  - Maximum number of bytes to move
+ *            (output) - Number of bytes actually written to @a to
+ * @return APR_EOF if @a from reached EOF with nothing pending for @a to
+ * @remark The data go through a kernel pipe owned by @a to, and at most
+ *         a pipe's capacity (64K) is moved per call. If writing to @a to
+ *         would block (per its timeout), the bytes read from @a from are
+ *         kept in the pipe and written first on the next call with the
+ *         same @a to, which must not be written to otherwise meanwhile.
+ * @remark This acts like a blocking read and write by default, see
+ *         apr_socket_timeout_set() for the sockets.
+ * It is possible for both bytes to be written and an error to be returned.
+ */
+APR_DECLARE(apr_status_t) apr_socket_splice(apr_socket_t *to,
+                                            apr_socket_t *from,
+                                            apr_size_t *len);
+
+/**
+ * Move data read from a file (typically a pipe) to a socket, without
+ * copying it to userspace
+ * @param to The socket to which we're writing
+ * @param from The file from which to read, at its current offset
+ * @param len (input)  - Maximum number of bytes to move
+ *            (output) - Number of bytes actually written to @a to
+ * @return APR_EOF if @a from reached EOF with nothing pending for @a to
+ * @return APR_ENOTIMPL if @a from is buffered
+ * @remark See apr_socket_splice(); the timeout of @a from is the one set
+ *         by apr_file_pipe_timeout_set().
+ */
+APR_DECLARE(apr_status_t) apr_socket_splice_file(apr_socket_t *to,
+                                                 apr_file_t *from,
+                                                 apr_size_t *len);
+
+#endif /* APR_HAS_SPLICE */
+
 /**
  * Read data from a network.
  * @param sock The socket to read the data from.
@@ -695,6 +966,8 @@ APR_DECLARE(apr_status_t) apr_socket_wait(apr_socket_t *sock,
  *            APR_SO_SNDBUF     --  Set the SendBufferSize
  *            APR_SO_RCVBUF     --  Set the ReceiveBufferSize
  *            APR_SO_FREEBIND   --  Allow binding to non-local IP address.
+ *            APR_SO_SYSTIMEOUT --  Have the system time out the I/O,
+ *                                  see apr_socket_timeout_set().
  * </PRE>
  * @param on Value for the option.
  */
@@ -711,6 +984,14 @@ APR_DECLARE(apr_status_t) apr_socket_opt_set(apr_socket_t *sock,
  *   t == 0 -- read and write calls never block
  *   t < 0  -- read and write calls block
  * </PRE>
+ * @remark A positive timeout usually makes the socket non-blocking, and
+ * the calls which would block poll() it until it's ready or the timeout
+ * expires, that's one more system call per wait.  With the APR_SO_SYSTIMEOUT
+ * option (where SO_RCVTIMEO and SO_SNDTIMEO are supported, APR_ENOTIMPL
+ * otherwise) the socket is left blocking and the system fails the calls
+ * with APR_TIMEUP itself.  apr_socket_wait() still polls.  Some systems
+ * (like Linux) give the accepted sockets the system timeouts of the
+ * listening one, so this option is meant for connected sockets.
  */
 APR_DECLARE(apr_status_t) apr_socket_timeout_set(apr_socket_t *sock,
                                                  apr_interval_time_t t);
@@ -844,6 +1125,54 @@ APR_DECLARE(apr_status_t) apr_ipsubnet_create(apr_ipsubnet_t **ipsub,
  */
 APR_DECLARE(int) apr_ipsubnet_test(apr_ipsubnet_t *ipsub, apr_sockaddr_t *sa);
 
+/**
+ * Create an empty ip-set, a set of ip-subnets with optional values that
+ * is tested in O(prefix length) time whatever its size.
+ * @param ipset The new ip-set
+ * @param p The pool to allocate from
+ * @remark The ip-set is a path-compressed radix trie per address family,
+ * an IPv4-mapped IPv6 address being looked up as the IPv4 address like
+ * with apr_ipsubnet_test().
+ * @remark Testing an ip-set is read-only and thus safe from multiple
+ * threads, but not concurrently with apr_ipset_add().  To update a set
+ * in use, build a new one (in its own pool) and publish it atomically,
+ * e.g. with apr_atomic_xchgptr(), then destroy the pool of the previous
+ * one once no thread can be testing it anymore.
+ */
+APR_DECLARE(apr_status_t) apr_ipset_create(apr_ipset_t **ipset,
+                                           apr_pool_t *p);
+
+/**
+ * Add an ip-subnet to an ip-set.
+ * @param ipset The ip-set
+ * @param ipsub The ip-subnet, as built by apr_ipsubnet_create()
+ * @param value The value to associate with the ip-subnet (may be NULL),
+ *              replacing any value of the same ip-subnet added before
+ * @return APR_EBADMASK if the netmask of the ip-subnet is not contiguous
+ *         (e.g. "255.0.255.0"), which a trie can't represent
+ */
+APR_DECLARE(apr_status_t) apr_ipset_add(apr_ipset_t *ipset,
+                                        const apr_ipsubnet_t *ipsub,
+                                        void *value);
+
+/**
+ * Test the IP address in an apr_sockaddr_t against an ip-set.
+ * @param ipset The ip-set
+ * @param sa The socket address to test
+ * @param value If not NULL, set to the value of the longest (most specific)
+ *              ip-subnet of the set matching the address
+ * @return non-zero if the socket address is within an ip-subnet of the
+ *         set, 0 otherwise
+ */
+APR_DECLARE(int) apr_ipset_test(const apr_ipset_t *ipset,
+                                const apr_sockaddr_t *sa, void **value);
+
+/**
+ * Return the number of distinct ip-subnets in an ip-set.
+ * @param ipset The ip-set
+ */
+APR_DECLARE(apr_size_t) apr_ipset_count(const apr_ipset_t *ipset);
+
 #if APR_HAS_SO_ACCEPTFILTER || defined(DOXYGEN)
 /**
  * Set an OS level accept filter.
@@ -23,6 +23,7 @@
 #define APR_OPTIONAL_HOOK_H
 
 #include "apr_tables.h"
+#include "apr_hooks.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -73,6 +74,21 @@ APR_DECLARE(void) apr_optional_hook_add(const char *szName,void (*pfn)(void),
  */
 APR_DECLARE(apr_array_header_t *) apr_optional_hook_get(const char *szName);
 
+/**
+ * @internal
+ * @param szName - the name of the function
+ * @return the dispatch table of a given hook, NULL if not sorted since
+ *         the last registration
+ */
+APR_DECLARE(apr_hook_fn_t * const *) apr_optional_hook_table_get(const char *szName);
+
+/**
+ * @internal
+ * Changed whenever the dispatch tables of the optional hooks may have
+ * changed, so that their run functions need not look them up each time.
+ */
+APR_DECLARE_DATA extern apr_uint32_t apr_optional_hook_generation;
+
 /**
  * Implement an optional hook that runs until one of the functions
  * returns something other than OK or DECLINE.
@@ -90,11 +106,31 @@ APR_DECLARE(apr_array_header_t *) apr_optional_hook_get(const char *szName);
 #define APR_IMPLEMENT_OPTIONAL_HOOK_RUN_ALL(ns,link,ret,name,args_decl,args_use,ok,decline) \
 link##_DECLARE(ret) ns##_run_##name args_decl \
     { \
+    static apr_hook_fn_t * const *pTable; \
+    static apr_uint32_t nGeneration; \
     ns##_LINK_##name##_t *pHook; \
     int n; \
     ret rv; \
-    apr_array_header_t *pHookArray=apr_optional_hook_get(#name); \
+    apr_array_header_t *pHookArray; \
+\
+    if(nGeneration != apr_optional_hook_generation) \
+	{ \
+	pTable=apr_optional_hook_table_get(#name); \
+	nGeneration=apr_optional_hook_generation; \
+	} \
+    if(pTable) \
+	{ \
+	for(n=0 ; pTable[n] ; ++n) \
+	    { \
+	    rv=((ns##_HOOK_##name##_t *)pTable[n]) args_use; \
+\
+	    if(rv != ok && rv != decline) \
+		return rv; \
+	    } \
+	return ok; \
+	} \
 \
+    pHookArray=apr_optional_hook_get(#name); \
     if(!pHookArray) \
 	return ok; \
 \
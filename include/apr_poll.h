@@ -53,6 +53,10 @@ extern "C" {
 #define APR_POLLHUP   0x020     /**< Hangup occurred */
 #define APR_POLLNVAL  0x040     /**< Descriptor invalid */
 #define APR_POLLEXCL  0x080     /**< Exclusive wake up */
+#define APR_POLLET    0x100     /**< Edge-triggered events, if supported */
+#define APR_POLLONESHOT 0x200   /**< Disarm after an event, until
+                                 *   apr_pollset_rearm() or apr_pollcb_rearm()
+                                 */
 /** @} */
 
 /**
@@ -85,7 +89,8 @@ typedef enum {
     APR_POLLSET_PORT,           /**< Poll uses Solaris event port method */
     APR_POLLSET_EPOLL,          /**< Poll uses epoll method */
     APR_POLLSET_POLL,           /**< Poll uses poll method */
-    APR_POLLSET_AIO_MSGQ        /**< Poll uses z/OS asio method */
+    APR_POLLSET_AIO_MSGQ,       /**< Poll uses z/OS asio method */
+    APR_POLLSET_IOURING         /**< Poll uses Linux io_uring method */
 } apr_pollset_method_e;
 
 /** Used in apr_pollfd_t to determine what the apr_descriptor is */
@@ -145,11 +150,12 @@ typedef struct apr_pollset_t apr_pollset_t;
  * @remark If flags contains APR_POLLSET_NOCOPY, then the apr_pollfd_t
  *         structures passed to apr_pollset_add() are not copied and
  *         must have a lifetime at least as long as the pollset.
+ *         APR_POLLSET_IOURING does not support APR_POLLSET_NOCOPY.
  * @remark Some poll methods (including APR_POLLSET_KQUEUE,
- *         APR_POLLSET_PORT, and APR_POLLSET_EPOLL) do not have a
- *         fixed limit on the size of the pollset. For these methods,
- *         the size parameter controls the maximum number of
- *         descriptors that will be returned by a single call to
+ *         APR_POLLSET_PORT, APR_POLLSET_EPOLL and APR_POLLSET_IOURING)
+ *         do not have a fixed limit on the size of the pollset. For
+ *         these methods, the size parameter controls the maximum number
+ *         of descriptors that will be returned by a single call to
  *         apr_pollset_poll().
  */
 APR_DECLARE(apr_status_t) apr_pollset_create(apr_pollset_t **pollset,
@@ -182,12 +188,17 @@ APR_DECLARE(apr_status_t) apr_pollset_create(apr_pollset_t **pollset,
  * @remark If flags contains APR_POLLSET_NOCOPY, then the apr_pollfd_t
  *         structures passed to apr_pollset_add() are not copied and
  *         must have a lifetime at least as long as the pollset.
+ *         APR_POLLSET_IOURING does not support APR_POLLSET_NOCOPY.
  * @remark Some poll methods (including APR_POLLSET_KQUEUE,
- *         APR_POLLSET_PORT, and APR_POLLSET_EPOLL) do not have a
- *         fixed limit on the size of the pollset. For these methods,
- *         the size parameter controls the maximum number of
- *         descriptors that will be returned by a single call to
+ *         APR_POLLSET_PORT, APR_POLLSET_EPOLL and APR_POLLSET_IOURING)
+ *         do not have a fixed limit on the size of the pollset. For
+ *         these methods, the size parameter controls the maximum number
+ *         of descriptors that will be returned by a single call to
  *         apr_pollset_poll().
+ * @remark With APR_POLLSET_IOURING the kernel holds a reference on the
+ *         descriptors while they are in the pollset, so they must be
+ *         removed before being closed.  Destroying such a pollset may
+ *         also interrupt (EINTR) a blocking system call of the thread.
  */
 APR_DECLARE(apr_status_t) apr_pollset_create_ex(apr_pollset_t **pollset,
                                                 apr_uint32_t size,
@@ -251,6 +262,29 @@ APR_DECLARE(apr_status_t) apr_pollset_add(apr_pollset_t *pollset,
 APR_DECLARE(apr_status_t) apr_pollset_remove(apr_pollset_t *pollset,
                                              const apr_pollfd_t *descriptor);
 
+/**
+ * Re-enable a descriptor of a pollset, possibly for other events
+ * @param pollset The pollset of the descriptor
+ * @param descriptor The descriptor, with the requested events
+ * @remark This is typically used to arm again an APR_POLLONESHOT descriptor
+ *         after it has been signalled, or to change the events requested
+ *         for a descriptor, in a single system call where the poll method
+ *         allows it (APR_POLLSET_EPOLL, APR_POLLSET_KQUEUE, APR_POLLSET_POLL
+ *         and APR_POLLSET_IOURING) rather than with apr_pollset_remove()
+ *         and apr_pollset_add().  The other methods do just that.
+ * @remark APR_POLLET is only honored by the APR_POLLSET_EPOLL,
+ *         APR_POLLSET_KQUEUE and APR_POLLSET_IOURING methods (the latter
+ *         using a multishot poll request), the others signal the descriptors
+ *         as long as they are ready (level-triggered), which the users of
+ *         edge-triggered descriptors should handle anyway.  APR_POLLONESHOT
+ *         is emulated by removing the signalled descriptors from the
+ *         pollset where it is not supported.
+ * @remark Depending on the poll method, a descriptor which is not in the
+ *         pollset is either added or APR_NOTFOUND is returned.
+ */
+APR_DECLARE(apr_status_t) apr_pollset_rearm(apr_pollset_t *pollset,
+                                            const apr_pollfd_t *descriptor);
+
 /**
  * Block for activity on the descriptor(s) in a pollset
  * @param pollset The pollset to use
@@ -274,6 +308,35 @@ APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
                                            apr_int32_t *num,
                                            const apr_pollfd_t **descriptors);
 
+/**
+ * Block for activity on the descriptor(s) in a pollset, returning at most
+ * a given number of signalled descriptors in an array provided by the caller
+ * @param pollset The pollset to use
+ * @param timeout The amount of time in microseconds to wait, as for
+ *                apr_pollset_poll()
+ * @param descriptors Array of at least @a max elements in which the
+ *                    signalled descriptors are returned (output parameter)
+ * @param max The maximum number of descriptors to return
+ * @param num Number of signalled descriptors (output parameter)
+ * @returns APR_EINVAL if @a max is not positive, otherwise as for
+ *          apr_pollset_poll()
+ * @remark The timeout is not rounded up to milliseconds by the poll methods
+ *         which allow it (APR_POLLSET_KQUEUE, APR_POLLSET_IOURING, and
+ *         APR_POLLSET_EPOLL where epoll_pwait2() is available).
+ * @remark The returned descriptors are copies which remain valid until the
+ *         caller reuses the array, so multiple batches can be harvested
+ *         without the result of the previous call being overwritten.
+ * @remark The descriptors signalled beyond @a max are not lost, they are
+ *         left pending (in the kernel for the native methods) and returned
+ *         by the next call, APR_POLLONESHOT ones being removed or disarmed
+ *         only once returned.
+ */
+APR_DECLARE(apr_status_t) apr_pollset_poll_ex(apr_pollset_t *pollset,
+                                              apr_interval_time_t timeout,
+                                              apr_pollfd_t *descriptors,
+                                              apr_int32_t max,
+                                              apr_int32_t *num);
+
 /**
  * Interrupt the blocked apr_pollset_poll() call.
  * @param pollset The pollset to use
@@ -352,6 +415,8 @@ APR_DECLARE(apr_status_t) apr_pollcb_create(apr_pollcb_t **pollcb,
  *         in that case @a size + 1.
  * @remark Pollcb is only supported on some platforms; the apr_pollcb_create_ex()
  *         call will fail with APR_ENOTIMPL on platforms where it is not supported.
+ * @remark The remarks of apr_pollset_create_ex() about APR_POLLSET_IOURING
+ *         apply to pollcb too.
  */
 APR_DECLARE(apr_status_t) apr_pollcb_create_ex(apr_pollcb_t **pollcb,
                                                apr_uint32_t size,
@@ -390,6 +455,18 @@ APR_DECLARE(apr_status_t) apr_pollcb_add(apr_pollcb_t *pollcb,
 APR_DECLARE(apr_status_t) apr_pollcb_remove(apr_pollcb_t *pollcb,
                                             apr_pollfd_t *descriptor);
 
+/**
+ * Re-enable a descriptor of a pollcb, possibly for other events
+ * @param pollcb The pollcb of the descriptor
+ * @param descriptor The descriptor, with the requested events
+ * @remark This is typically used to arm again an APR_POLLONESHOT descriptor
+ *         after it has been signalled, or to change the events requested
+ *         for a descriptor, see apr_pollset_rearm().
+ * @remark This can be called from the pollcb handler of the descriptor.
+ */
+APR_DECLARE(apr_status_t) apr_pollcb_rearm(apr_pollcb_t *pollcb,
+                                           apr_pollfd_t *descriptor);
+
 /**
  * Function prototype for pollcb handlers 
  * @param baton Opaque baton passed into apr_pollcb_poll()
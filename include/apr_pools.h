@@ -59,6 +59,9 @@ extern "C" {
 /** The fundamental pool type */
 typedef struct apr_pool_t apr_pool_t;
 
+/** A registered cleanup, see apr_pool_cleanup_register_ex() */
+typedef struct apr_pool_cleanup_t apr_pool_cleanup_t;
+
 
 /**
  * Declaration helper macro to construct apr_foo_pool_get()s.
@@ -326,6 +329,37 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged(apr_pool_t **newpool);
 APR_DECLARE(apr_allocator_t *) apr_pool_allocator_get(apr_pool_t *pool)
                                __attribute__((nonnull(1)));
 
+/** Pool statistics, see apr_pool_stats_get() */
+typedef struct apr_pool_stats_t {
+    /** Bytes allocated from the pool since its creation (aligned) */
+    apr_size_t bytes_alloc;
+    /** Number of memnodes fetched from the allocator */
+    apr_size_t nodes_fetched;
+    /** Number of times a memnode of the pool was reused for an
+     * allocation that did not fit in the active one */
+    apr_size_t nodes_reused;
+    /** Size of the memnodes currently held by the pool */
+    apr_size_t footprint;
+    /** Highest footprint so far */
+    apr_size_t peak_footprint;
+    /** Number of times the pool was cleared */
+    apr_size_t clears;
+} apr_pool_stats_t;
+
+/**
+ * Get the statistics of the pool (excluding its subpools)
+ * @param pool The pool
+ * @param stats The statistics to fill in
+ * @return APR_SUCCESS, or APR_ENOTIMPL with APR_POOL_DEBUG
+ *         (see apr_pool_num_bytes() instead)
+ * @remark The counters are maintained in all (non debug) builds, they
+ *         are not synchronized so the pool should not be in use by
+ *         another thread at the same time.
+ */
+APR_DECLARE(apr_status_t) apr_pool_stats_get(apr_pool_t *pool,
+                                             apr_pool_stats_t *stats)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * Clear all memory in the pool and run all the cleanups. This also destroys all
  * subpools.
@@ -425,6 +459,75 @@ APR_DECLARE(void *) apr_palloc_debug(apr_pool_t *p, apr_size_t size,
     apr_palloc_debug(p, size, APR_POOL__FILE_LINE__)
 #endif
 
+/**
+ * The head of a (non debug) pool, from which the inline apr_palloc() of
+ * APR_POOL_INLINE allocates; it is private to APR otherwise.
+ */
+typedef struct apr_pool_inline_t {
+    apr_memnode_t *active;      /**< The node allocated from */
+    apr_size_t     bytes_alloc; /**< @see apr_pool_stats_t */
+} apr_pool_inline_t;
+
+/**
+ * Nonzero when the allocations must go through the function apr_palloc()
+ * rather than the inline one, e.g. while the pools are profiled
+ */
+APR_DECLARE_DATA extern volatile int apr_pool_inline_off;
+
+#if defined(APR_POOL_INLINE) && !APR_POOL_DEBUG && !defined(DOXYGEN)
+/*
+ * With APR_POOL_INLINE defined before including apr_pools.h, apr_palloc()
+ * (and apr_pcalloc()) bump the pointer of the pool's active node inline,
+ * calling the function when it has no room left.  Constant sizes are
+ * aligned at compile time.
+ */
+
+/** The largest constant size aligned at compile time */
+#define APR_POOL_INLINE_MAX 4096
+
+/** APR_ALIGN_DEFAULT(), which apr_general.h may not have defined yet */
+#define APR_POOL_INLINE_ALIGN(size) \
+    (((apr_size_t)(size) + 7) & ~(apr_size_t)7)
+
+static APR_INLINE void *apr_palloc_inline_aligned(apr_pool_t *p,
+                                                  apr_size_t size,
+                                                  apr_size_t in_size)
+{
+    apr_pool_inline_t *head = (apr_pool_inline_t *)p;
+    apr_memnode_t *active = head->active;
+
+    if (size <= (apr_size_t)(active->endp - active->first_avail)
+            && !apr_pool_inline_off) {
+        void *mem = active->first_avail;
+
+        active->first_avail += size;
+        head->bytes_alloc += size;
+        return mem;
+    }
+    return (apr_palloc)(p, in_size);
+}
+
+static APR_INLINE void *apr_palloc_inline(apr_pool_t *p, apr_size_t size)
+{
+    apr_size_t aligned = APR_POOL_INLINE_ALIGN(size);
+
+    if (aligned < size) {
+        /* overflow, failed by the function */
+        return (apr_palloc)(p, size);
+    }
+    return apr_palloc_inline_aligned(p, aligned, size);
+}
+
+#if defined(__GNUC__)
+#define apr_palloc(p, size) \
+    ((__builtin_constant_p(size) && (size) <= APR_POOL_INLINE_MAX) \
+     ? apr_palloc_inline_aligned(p, APR_POOL_INLINE_ALIGN(size), size) \
+     : apr_palloc_inline(p, size))
+#else
+#define apr_palloc(p, size) apr_palloc_inline(p, size)
+#endif
+#endif /* APR_POOL_INLINE */
+
 /**
  * Allocate a block of memory from a pool and set all of the memory to 0
  * @param p The pool to allocate from
@@ -454,6 +557,42 @@ APR_DECLARE(void *) apr_pcalloc_debug(apr_pool_t *p, apr_size_t size,
     apr_pcalloc_debug(p, size, APR_POOL__FILE_LINE__)
 #endif
 
+/**
+ * Allocate a block of memory from a pool, reusing a block of the same
+ * size class previously given back with apr_pool_free_sized() if any.
+ * @param p The pool to allocate from
+ * @param size The amount of memory to allocate
+ * @return The allocated memory
+ * @remark This allows long-lived pools which keep allocating and
+ *         releasing objects to stay bounded in memory, without
+ *         clearing the pool.  Sizes are rounded up to their size class
+ *         (multiples of 8 bytes up to 256 bytes, then powers of two up
+ *         to APR_POOL_SIZED_MAX), larger blocks are never recycled.
+ */
+APR_DECLARE(void *) apr_pool_alloc_sized(apr_pool_t *p, apr_size_t size)
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 4))
+                    __attribute__((alloc_size(2)))
+#endif
+                    __attribute__((nonnull(1)));
+
+/**
+ * Give a block of memory back to the pool for reuse by
+ * apr_pool_alloc_sized().
+ * @param p The pool the memory was allocated from
+ * @param mem The memory to release
+ * @param size The size given to apr_pool_alloc_sized() for @a mem
+ * @remark The memory must have been allocated by apr_pool_alloc_sized()
+ *         from the same pool, and must not be used anymore.  It is
+ *         never given back to the pool's allocator before the pool is
+ *         cleared or destroyed.
+ */
+APR_DECLARE(void) apr_pool_free_sized(apr_pool_t *p, void *mem,
+                                      apr_size_t size)
+                  __attribute__((nonnull(1)));
+
+/** The largest size recycled by apr_pool_free_sized() */
+#define APR_POOL_SIZED_MAX (16 * 1024)
+
 
 /*
  * Pool Properties
@@ -516,6 +655,43 @@ APR_DECLARE(void) apr_pool_tag(apr_pool_t *pool, const char *tag)
 APR_DECLARE(const char *) apr_pool_get_tag(apr_pool_t *pool)
                   __attribute__((nonnull(1)));
 
+/**
+ * Start or stop sampling the allocations from the pools, for
+ * apr_pool_profile_get()
+ * @param period The number of bytes allocated by a thread between two
+ *               samples, or zero to stop sampling
+ * @return APR_SUCCESS, or APR_ENOTIMPL if the stacks of the allocations
+ *         cannot be recorded on this platform
+ * @remark Each time a thread has allocated @a period more bytes from the
+ *         pools, the stack of the allocation is recorded along with the
+ *         tag of its pool (see apr_pool_tag()), accounting for the bytes
+ *         of the periods it spans.  The other allocations only count
+ *         their size, so this is meant for production use.
+ */
+APR_DECLARE(apr_status_t) apr_pool_profile_set(apr_size_t period);
+
+/**
+ * Get the allocations sampled so far in the pprof format
+ * @param profile The profile, allocated from @a p
+ * @param len The length of the profile
+ * @param p The pool to allocate the profile from
+ * @return APR_SUCCESS, or APR_ENOTIMPL if the stacks of the allocations
+ *         cannot be recorded on this platform
+ * @remark The profile is an uncompressed profile.proto (as read by
+ *         "pprof"), with the number of samples ("alloc_objects") and the
+ *         bytes they account for ("alloc_space") by stack, labeled by
+ *         "pool_tag".  The functions are named where dladdr() can.
+ */
+APR_DECLARE(apr_status_t) apr_pool_profile_get(void **profile,
+                                               apr_size_t *len,
+                                               apr_pool_t *p)
+                          __attribute__((nonnull(1,2,3)));
+
+/**
+ * Forget the allocations sampled so far
+ */
+APR_DECLARE(void) apr_pool_profile_clear(void);
+
 /*
  * User data management
  */
@@ -676,6 +852,56 @@ APR_DECLARE(apr_status_t) apr_pool_cleanup_run(apr_pool_t *p, void *data,
                                                apr_status_t (*cleanup)(void *))
                           __attribute__((nonnull(3)));
 
+/**
+ * Register a function to be called when a pool is cleared or destroyed,
+ * returning a handle to unregister it in constant time.
+ *
+ * Unlike apr_pool_cleanup_kill() and apr_pool_cleanup_run() which search
+ * the cleanups of the pool, the handle variants unlink the cleanup
+ * directly, which matters for pools living long and registering/killing
+ * many cleanups (e.g. one per request of a connection).
+ *
+ * @param p The pool to register the cleanup with
+ * @param data The data to pass to the cleanup function.
+ * @param plain_cleanup The function to call when the pool is cleared
+ *                      or destroyed
+ * @param child_cleanup The function to call when a child process is about
+ *                      to exec - this function is called in the child, obviously!
+ * @return The handle of the cleanup
+ * @remark The handle can be passed to apr_pool_cleanup_kill_handle() or
+ *         apr_pool_cleanup_run_handle() until the cleanup is killed, by
+ *         either of them or apr_pool_cleanup_kill(), or @a p is cleared
+ *         or destroyed.  It is also still valid during the cleanups of
+ *         @a p, killing a cleanup that already ran being a noop then.
+ */
+APR_DECLARE(apr_pool_cleanup_t *) apr_pool_cleanup_register_ex(
+                            apr_pool_t *p, const void *data,
+                            apr_status_t (*plain_cleanup)(void *),
+                            apr_status_t (*child_cleanup)(void *))
+                  __attribute__((nonnull(1,3,4)));
+
+/**
+ * Remove a cleanup registered with apr_pool_cleanup_register_ex().
+ *
+ * @param p The pool of the registered cleanup
+ * @param cleanup The handle of the registered cleanup
+ */
+APR_DECLARE(void) apr_pool_cleanup_kill_handle(apr_pool_t *p,
+                                               apr_pool_cleanup_t *cleanup)
+                  __attribute__((nonnull(1,2)));
+
+/**
+ * Run a cleanup registered with apr_pool_cleanup_register_ex() immediately
+ * and unregister it.
+ *
+ * @param p The pool of the registered cleanup
+ * @param cleanup The handle of the registered cleanup
+ * @return The value returned by the cleanup function
+ */
+APR_DECLARE(apr_status_t) apr_pool_cleanup_run_handle(apr_pool_t *p,
+                                                apr_pool_cleanup_t *cleanup)
+                          __attribute__((nonnull(1,2)));
+
 /**
  * An empty cleanup function.
  * 
@@ -140,6 +140,11 @@ struct apr_os_proc_mutex_t {
     /** Value used for POSIX semaphores serialization */
     sem_t *psem_interproc;
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    /** Value used for FUTEX serialization, a zeroed and 32-bit aligned
+     *  word which apr_os_proc_mutex_put_ex() may place in an apr_shm */
+    apr_uint32_t *futex_interproc;
+#endif
 };
 
 typedef int                   apr_os_file_t;        /**< native file */
@@ -302,6 +307,9 @@ APR_DECLARE(apr_status_t) apr_os_thread_get(apr_os_thread_t **thethd,
  * convert the thread private memory key to os specific type from an apr type.
  * @param thekey The apr handle we are converting from.
  * @param key The os specific handle we are converting to.
+ * @remark The values are cached per thread by apr_threadkey_private_get(),
+ * so a value set with the os API after the thread got or set one with
+ * APR may not be seen by APR.
  */
 APR_DECLARE(apr_status_t) apr_os_threadkey_get(apr_os_threadkey_t *thekey,
                                                apr_threadkey_t *key);
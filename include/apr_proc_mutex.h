@@ -50,7 +50,9 @@ typedef enum {
     APR_LOCK_PROC_PTHREAD,  /**< POSIX pthread process-based locking */
     APR_LOCK_POSIXSEM,      /**< POSIX semaphore process-based locking */
     APR_LOCK_DEFAULT,       /**< Use the default process lock */
-    APR_LOCK_DEFAULT_TIMED  /**< Use the default process timed lock */
+    APR_LOCK_DEFAULT_TIMED, /**< Use the default process timed lock */
+    APR_LOCK_FUTEX          /**< Linux futex word in shared memory, whose
+                             *   waiters take over from a dead owner */
 } apr_lockmech_e;
 
 /** Opaque structure representing a process mutex. */
@@ -72,6 +74,7 @@ typedef struct apr_proc_mutex_t apr_proc_mutex_t;
  *            APR_LOCK_SYSVSEM
  *            APR_LOCK_POSIXSEM
  *            APR_LOCK_PROC_PTHREAD
+ *            APR_LOCK_FUTEX
  *            APR_LOCK_DEFAULT     pick the default mechanism for the platform
  * </PRE>
  * @param pool the pool from which to allocate the mutex.
@@ -146,6 +149,19 @@ APR_DECLARE(apr_status_t) apr_proc_mutex_destroy(apr_proc_mutex_t *mutex);
  */
 APR_DECLARE(apr_status_t) apr_proc_mutex_cleanup(void *mutex);
 
+/**
+ * Name a mutex, enabling its contention statistics in this process.
+ * @param mutex the mutex to name.
+ * @param name the name, which must live as long as the mutex's pool.
+ * @remark The statistics are kept until the mutex's pool is cleared, see
+ *         apr_mutex_stats_dump().  They are not shared between processes,
+ *         each accounting for its own locks.
+ * @remark This is not to be confused with apr_proc_mutex_name(), which
+ *         returns the name of the mechanism.
+ */
+APR_DECLARE(apr_status_t) apr_proc_mutex_name_set(apr_proc_mutex_t *mutex,
+                                                  const char *name);
+
 /**
  * Return the name of the lockfile for the mutex, or NULL
  * if the mutex doesn't use a lock file
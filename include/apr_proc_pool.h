@@ -0,0 +1,120 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_PROC_POOL_H
+#define APR_PROC_POOL_H
+
+/**
+ * @file apr_proc_pool.h
+ * @brief APR Process Spawner
+ *
+ * @remark A process pool is a small "spawner" process forked early, while
+ * the application is still small and single threaded, which creates the
+ * child processes on behalf of the application afterwards: the application
+ * sends it the program, arguments and procattr over a Unix socket, along
+ * with the descriptors of the child's stdio, so that a large or heavily
+ * threaded process never forks itself.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_thread_proc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_proc_pool Process Spawner
+ * @ingroup apr_thread_proc
+ * @{
+ */
+
+#if APR_HAS_FORK || defined(DOXYGEN)
+
+/** Opaque structure used for the process pool API */
+typedef struct apr_proc_pool_t apr_proc_pool_t;
+
+/**
+ * Fork the spawner of a process pool
+ * @param proc_pool The pointer in which to return the newly created object
+ * @param p The pool from which to allocate the process pool, and whose
+ *          cleanup terminates the spawner
+ * @remark Call this at startup, before any thread is created: the spawner
+ *         is a fork() of the calling process which runs the child cleanups
+ *         of the pools and then only serves spawn requests.  It keeps the
+ *         credentials, umask, resource limits and signal dispositions the
+ *         process had at this time for the children it spawns.
+ */
+APR_DECLARE(apr_status_t) apr_proc_pool_create(apr_proc_pool_t **proc_pool,
+                                               apr_pool_t *p);
+
+/**
+ * Create a new process and execute a new program within that process,
+ * from the spawner of a process pool.
+ * @param proc_pool The process pool
+ * @param new_proc The resulting process handle
+ * @param progname The program to run
+ * @param args The arguments to pass to the new program
+ * @param env The new environment table for the new process
+ * @param attr The procattr we should use to determine how to create the
+ *             new process
+ * @param p The pool to use
+ * @return As apr_proc_create(), APR_ENOTIMPL if permission set functions
+ *         are registered on @a attr, or APR_EOF if the spawner is gone.
+ * @remark The arguments are as for apr_proc_create(), the current
+ *         directory and (for the command types which replicate it) the
+ *         environment being those of the caller.  The child error
+ *         function of @a attr, if any, is called in the child.
+ * @remark The child is not a child of the calling process, so it must be
+ *         waited for with apr_proc_pool_wait() rather than apr_proc_wait();
+ *         apr_proc_kill() works as usual.
+ */
+APR_DECLARE(apr_status_t) apr_proc_pool_spawn(apr_proc_pool_t *proc_pool,
+                                              apr_proc_t *new_proc,
+                                              const char *progname,
+                                              const char * const *args,
+                                              const char * const *env,
+                                              apr_procattr_t *attr,
+                                              apr_pool_t *p);
+
+/**
+ * Wait for a child process of a process pool to die
+ * @param proc_pool The process pool
+ * @param proc The process handle returned by apr_proc_pool_spawn()
+ * @param exitcode The returned exit status of the child, or the signal
+ *                 that caused it to die
+ * @param exitwhy Why the child died
+ * @param waithow How should we wait, as for apr_proc_wait()
+ * @return As apr_proc_wait(), or APR_EOF if the spawner is gone.
+ * @remark Only one caller may wait for a given child at a time.
+ */
+APR_DECLARE(apr_status_t) apr_proc_pool_wait(apr_proc_pool_t *proc_pool,
+                                             apr_proc_t *proc,
+                                             int *exitcode,
+                                             apr_exit_why_e *exitwhy,
+                                             apr_wait_how_e waithow);
+
+#endif /* APR_HAS_FORK */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_PROC_POOL_H */
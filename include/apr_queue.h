@@ -57,6 +57,29 @@ APR_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **queue,
                                            unsigned int queue_capacity, 
                                            apr_pool_t *a);
 
+/**
+ * Use a lock-free ring for the queue, see apr_queue_create_ex()
+ */
+#define APR_QUEUE_LOCKFREE 0x01
+
+/**
+ * create a FIFO queue with the given flags
+ * @param queue The new queue
+ * @param queue_capacity maximum size of the queue
+ * @param flags A bitmask of APR_QUEUE_* flags, or zero
+ * @param a pool to allocate queue from
+ * @returns APR_EINVAL if @a flags is not supported
+ * @remark With APR_QUEUE_LOCKFREE the elements are pushed and popped with
+ *         atomic operations on a bounded ring, the queue's mutex and
+ *         condition variables are only used to block when the queue is
+ *         full (for pushing) or empty (for popping), and to wake up the
+ *         threads blocked this way.
+ */
+APR_DECLARE(apr_status_t) apr_queue_create_ex(apr_queue_t **queue,
+                                              unsigned int queue_capacity,
+                                              apr_uint32_t flags,
+                                              apr_pool_t *a);
+
 /**
  * push/add an object to the queue, blocking if the queue is already full
  *
@@ -135,6 +158,59 @@ APR_DECLARE(apr_status_t) apr_queue_timedpush(apr_queue_t *queue, void *data,
 APR_DECLARE(apr_status_t) apr_queue_timedpop(apr_queue_t *queue, void **data,
                                              apr_interval_time_t timeout);
 
+/**
+ * push/add up to nelts objects to the queue at once, waiting a maximum of
+ * timeout microseconds before returning if the queue is full
+ *
+ * @param queue the queue
+ * @param data the array of data to push, in order
+ * @param nelts the number of elements in data
+ * @param pushed the number of elements pushed
+ * @param timeout the timeout, zero to not block or negative to block
+ *        indefinitely
+ * @returns APR_EINTR the blocking operation was interrupted (try again)
+ * @returns APR_EAGAIN the queue is full and timeout is 0
+ * @returns APR_TIMEUP the queue is full and the timeout expired
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS when at least one element was pushed
+ * @remark This blocks only until there is room for the first element,
+ *         then pushes as many elements as fit with a single lock
+ *         acquisition (or none with APR_QUEUE_LOCKFREE) and wakes up
+ *         the waiting consumers once. The caller should push the
+ *         remaining elements (from data + *pushed) if any.
+ */
+APR_DECLARE(apr_status_t) apr_queue_push_batch(apr_queue_t *queue,
+                                               void **data,
+                                               unsigned int nelts,
+                                               unsigned int *pushed,
+                                               apr_interval_time_t timeout);
+
+/**
+ * pop/get up to nelts objects from the queue at once, waiting a maximum
+ * of timeout microseconds before returning if the queue is empty
+ *
+ * @param queue the queue
+ * @param data the array to fill in with the popped data, in order
+ * @param nelts the number of elements available in data
+ * @param popped the number of elements popped
+ * @param timeout the timeout, zero to not block or negative to block
+ *        indefinitely
+ * @returns APR_EINTR the blocking operation was interrupted (try again)
+ * @returns APR_EAGAIN the queue is empty and timeout is 0
+ * @returns APR_TIMEUP the queue is empty and the timeout expired
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS when at least one element was popped
+ * @remark This blocks only until the first element is available, then
+ *         pops as many elements as available with a single lock
+ *         acquisition (or none with APR_QUEUE_LOCKFREE) and wakes up
+ *         the waiting producers once.
+ */
+APR_DECLARE(apr_status_t) apr_queue_pop_batch(apr_queue_t *queue,
+                                              void **data,
+                                              unsigned int nelts,
+                                              unsigned int *popped,
+                                              apr_interval_time_t timeout);
+
 /**
  * returns the size of the queue.
  *
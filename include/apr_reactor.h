@@ -0,0 +1,194 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_REACTOR_H
+#define APR_REACTOR_H
+
+/**
+ * @file apr_reactor.h
+ * @brief APR event loop with timers, on top of apr_pollcb_t
+ *
+ * @remark A reactor runs the callbacks of the signalled descriptors of a
+ * pollcb, the one-shot or periodic timers which expired and the tasks
+ * pushed by other threads, from a single thread calling apr_reactor_run()
+ * or apr_reactor_run_once().  The poll timeout is derived from the next
+ * timer to expire, the timers being stored in a hierarchical timing wheel
+ * with a resolution of one millisecond, such that adding, cancelling or
+ * firing a timer costs O(1) whatever the number of timers.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_poll.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_reactor Event loop routines
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the reactor API */
+typedef struct apr_reactor_t apr_reactor_t;
+
+/** Opaque structure of a reactor's timer */
+typedef struct apr_reactor_timer_t apr_reactor_timer_t;
+
+/**
+ * Function prototype of the timer callbacks
+ * @param reactor The reactor running the timer
+ * @param timer The expired timer
+ * @param baton The opaque baton given to apr_reactor_timer_add()
+ */
+typedef void (apr_reactor_timer_cb_t)(apr_reactor_t *reactor,
+                                      apr_reactor_timer_t *timer,
+                                      void *baton);
+
+/**
+ * Function prototype of the task callbacks
+ * @param reactor The reactor running the task
+ * @param baton The opaque baton given to apr_reactor_task_push()
+ */
+typedef void (apr_reactor_task_cb_t)(apr_reactor_t *reactor, void *baton);
+
+/**
+ * Create a reactor and its pollcb
+ * @param reactor The pointer in which to return the newly created object
+ * @param size The maximum number of descriptors that the pollcb can hold
+ * @param p The pool from which to allocate the reactor
+ * @param flags Optional flags to modify the operation of the pollcb,
+ *              as for apr_pollcb_create_ex()
+ * @param method Poll method to use, as for apr_pollcb_create_ex()
+ * @remark The pollcb is always created with APR_POLLSET_WAKEABLE, which
+ *         is used by apr_reactor_task_push() and apr_reactor_stop().
+ */
+APR_DECLARE(apr_status_t) apr_reactor_create(apr_reactor_t **reactor,
+                                             apr_uint32_t size,
+                                             apr_pool_t *p,
+                                             apr_uint32_t flags,
+                                             apr_pollset_method_e method);
+
+/**
+ * Get the pollcb of a reactor, for the descriptors to be added, removed
+ * or re-armed with the apr_pollcb API from the reactor's thread
+ * @param reactor The reactor
+ */
+APR_DECLARE(apr_pollcb_t *) apr_reactor_pollcb_get(apr_reactor_t *reactor);
+
+/**
+ * Get the time cached by a reactor when it last returned from polling
+ * @param reactor The reactor
+ * @remark This is cheaper than apr_time_now() for the callbacks which
+ *         need the current time, but can be late by the time spent in
+ *         the callbacks run since the poll returned.
+ */
+APR_DECLARE(apr_time_t) apr_reactor_now(apr_reactor_t *reactor);
+
+/**
+ * Add a timer to a reactor
+ * @param reactor The reactor
+ * @param delay The time in microseconds until the timer expires, relative
+ *              to apr_reactor_now()
+ * @param period The time in microseconds between the next expirations of
+ *               a periodic timer, or zero for a one-shot timer
+ * @param func The function to call when the timer expires
+ * @param baton The opaque baton passed to @a func
+ * @param timer The pointer in which to return the timer (may be NULL)
+ * @returns APR_EINVAL if @a delay or @a period is negative
+ * @remark This must be called from the reactor's thread (including from
+ *         the callbacks), use apr_reactor_task_push() otherwise.
+ * @remark A one-shot timer is recycled once it has expired (after its
+ *         callback returned), so it must not be cancelled thereafter.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_timer_add(apr_reactor_t *reactor,
+                                                apr_interval_time_t delay,
+                                                apr_interval_time_t period,
+                                                apr_reactor_timer_cb_t *func,
+                                                void *baton,
+                                                apr_reactor_timer_t **timer);
+
+/**
+ * Cancel a timer of a reactor
+ * @param reactor The reactor
+ * @param timer The timer to cancel, which is recycled
+ * @remark This must be called from the reactor's thread, possibly from
+ *         the timer's own callback to stop a periodic timer.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_timer_cancel(apr_reactor_t *reactor,
+                                                   apr_reactor_timer_t *timer);
+
+/**
+ * Push a task to be run by a reactor's thread
+ * @param reactor The reactor
+ * @param func The function to call
+ * @param baton The opaque baton passed to @a func
+ * @remark This can be called from any thread, the reactor is woken up if
+ *         it is polling.  The tasks are run in the order they were pushed.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_task_push(apr_reactor_t *reactor,
+                                                apr_reactor_task_cb_t *func,
+                                                void *baton);
+
+/**
+ * Run one iteration of a reactor: poll the descriptors until one is
+ * signalled, a timer expires, a task is pushed or the given timeout
+ * expires, then run the callbacks of what happened
+ * @param reactor The reactor
+ * @param timeout The maximum time in microseconds to wait, or negative
+ *                to wait until something happens
+ * @param func The callback of the signalled descriptors, as for
+ *             apr_pollcb_poll()
+ * @param baton The opaque baton passed to @a func
+ * @returns APR_SUCCESS, including when nothing happened before the
+ *          timeout, or the error returned by apr_pollcb_poll()
+ */
+APR_DECLARE(apr_status_t) apr_reactor_run_once(apr_reactor_t *reactor,
+                                               apr_interval_time_t timeout,
+                                               apr_pollcb_cb_t func,
+                                               void *baton);
+
+/**
+ * Run a reactor until apr_reactor_stop() is called or an error occurs
+ * @param reactor The reactor
+ * @param func The callback of the signalled descriptors, as for
+ *             apr_pollcb_poll()
+ * @param baton The opaque baton passed to @a func
+ * @returns APR_SUCCESS when stopped, or the error returned by
+ *          apr_reactor_run_once()
+ */
+APR_DECLARE(apr_status_t) apr_reactor_run(apr_reactor_t *reactor,
+                                          apr_pollcb_cb_t func,
+                                          void *baton);
+
+/**
+ * Stop a reactor, apr_reactor_run() returns after the current iteration
+ * @param reactor The reactor
+ * @remark This can be called from any thread.
+ */
+APR_DECLARE(apr_status_t) apr_reactor_stop(apr_reactor_t *reactor);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_REACTOR_H */
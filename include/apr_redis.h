@@ -29,10 +29,13 @@
 #include "apr_time.h"
 #include "apr_strings.h"
 #include "apr_network_io.h"
+#include "apr_poll.h"
 #include "apr_ring.h"
 #include "apr_buckets.h"
 #include "apr_reslist.h"
 #include "apr_hash.h"
+#include "apr_tables.h"
+#include "apr_nearcache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -95,6 +98,9 @@ struct apr_redis_server_t
         int patch;
         char *number;
     } version;
+    /** Client ID receiving the invalidations of the keys read, or zero,
+     * @see apr_redis_tracking_create() */
+    apr_int64_t tracking_id;
 };
 
 typedef struct apr_redis_t apr_redis_t;
@@ -128,6 +134,9 @@ struct apr_redis_t
     apr_redis_hash_func hash_func;
     void *server_baton;
     apr_redis_server_func server_func;
+    /** In-process cache of the values got, which the writes through this
+     * client invalidate, or NULL */
+    apr_nearcache_t *nearcache;
 };
 
 /**
@@ -156,6 +165,14 @@ APR_DECLARE(apr_uint32_t) apr_redis_hash_default(void *baton,
                                                  const char *data,
                                                  const apr_size_t data_len);
 
+/**
+ * MD5 based hash compatible with libketama, to be used as the hash_func
+ * of apr_redis_find_server_hash_ketama().
+ */
+APR_DECLARE(apr_uint32_t) apr_redis_hash_ketama(void *baton,
+                                                const char *data,
+                                                const apr_size_t data_len);
+
 /**
  * Picks a server based on a hash
  * @param rc The redis client object to use
@@ -173,6 +190,52 @@ APR_DECLARE(apr_redis_server_t *) apr_redis_find_server_hash_default(void *baton
                                                                       apr_redis_t *rc,
                                                                       const apr_uint32_t hash);
 
+/**
+ * Server selection with the jump consistent hash, to be used as the
+ * server_func (with no baton) such that adding a server at the end of
+ * live_servers only moves 1/ntotal of the keys.
+ * @remark The keys of a dead server move to the live ones, the others'
+ *         staying in place.
+ */
+APR_DECLARE(apr_redis_server_t *)
+apr_redis_find_server_hash_jump(void *baton,
+                                apr_redis_t *rc,
+                                const apr_uint32_t hash);
+
+/** Opaque continuum of points used by apr_redis_find_server_hash_ketama() */
+typedef struct apr_redis_continuum_t apr_redis_continuum_t;
+
+/** Default number of points per server in the continuum */
+#define APR_REDIS_CONTINUUM_POINTS 160
+
+/**
+ * Create the ketama continuum of the servers of a client object
+ * @param continuum The pointer in which to return the continuum
+ * @param rc The client object, whose servers must have been added
+ * @param points The number of points per server, rounded up to a multiple
+ *               of four, or zero for APR_REDIS_CONTINUUM_POINTS
+ * @param p The pool from which to allocate the continuum
+ * @remark The continuum must be created again when servers are added.
+ */
+APR_DECLARE(apr_status_t)
+apr_redis_continuum_create(apr_redis_continuum_t **continuum,
+                           apr_redis_t *rc, apr_uint32_t points,
+                           apr_pool_t *p);
+
+/**
+ * Server selection with a ketama continuum, to be used as the server_func
+ * with the continuum as server_baton, such that adding or removing a
+ * server only moves the keys of its points (1/ntotal on average).
+ * @remark The lookup costs O(log(points * ntotal)), and the keys of a dead
+ *         server move to the servers of the next points.
+ * @remark The continuum covers hash values on 32 bits, so the hash_func
+ *         should be apr_redis_hash_ketama() or apr_redis_hash_crc32().
+ */
+APR_DECLARE(apr_redis_server_t *)
+apr_redis_find_server_hash_ketama(void *baton,
+                                  apr_redis_t *rc,
+                                  const apr_uint32_t hash);
+
 /**
  * Adds a server to a client object
  * @param rc The redis client object to use
@@ -257,6 +320,8 @@ APR_DECLARE(apr_status_t) apr_redis_create(apr_pool_t *p,
  * @param len   length of data at baton
  * @param flags any flags set by the client for this key
  * @return 
+ * @remark With rc->nearcache set, the value is got from there if cached,
+ *         and cached there otherwise.
  */
 APR_DECLARE(apr_status_t) apr_redis_getp(apr_redis_t *rc,
                                          apr_pool_t *p,
@@ -355,6 +420,26 @@ APR_DECLARE(apr_status_t) apr_redis_decr(apr_redis_t *rc,
  */
 APR_DECLARE(apr_status_t) apr_redis_ping(apr_redis_server_t *rs);
 
+/** Returned Data from a multiple get, or data for a multiple set */
+typedef struct
+{
+    apr_status_t status;
+    const char* key;
+    apr_size_t len;
+    char *data;
+} apr_redis_value_t;
+
+/**
+ * Add a key to a value hash for a multiple get query
+ * @param data_pool pool from which the hash and its values are allocated
+ * @param key null terminated string containing the key
+ * @param values the hash of apr_redis_value_t keyed by strings, created
+ *        if NULL
+ */
+APR_DECLARE(void) apr_redis_add_multget_key(apr_pool_t *data_pool,
+                                            const char* key,
+                                            apr_hash_t **values);
+
 /**
  * Gets multiple values from the server, allocating the values out of p
  * @param rc client to use
@@ -363,13 +448,328 @@ APR_DECLARE(apr_status_t) apr_redis_ping(apr_redis_server_t *rs);
  * @param data_pool Pool used to allocate data for the returned values.
  * @param values hash of apr_redis_value_t keyed by strings, contains the
  *        result of the multiget call.
- * @return
+ * @return APR_SUCCESS, or the first error that prevented some servers from
+ *         answering, the status of each value telling its outcome
+ * @remark The keys are sent with one MGET command per server, all the
+ *         servers being queried before any reply is read.
+ * @remark With rc->nearcache set, the values cached there are not queried,
+ *         and those found on the servers are cached there.
  */
 APR_DECLARE(apr_status_t) apr_redis_multgetp(apr_redis_t *rc,
                                              apr_pool_t *temp_pool,
                                              apr_pool_t *data_pool,
                                              apr_hash_t *values);
 
+/**
+ * Sets multiple values on the servers
+ * @param rc client to use
+ * @param temp_pool Pool used for temporary allocations
+ * @param values hash of apr_redis_value_t keyed by strings, whose data and
+ *        len are stored, the status of each value being set to the outcome
+ * @return APR_SUCCESS, or the first error that prevented some servers from
+ *         answering
+ * @remark The values are sent with one MSET command per server.
+ */
+APR_DECLARE(apr_status_t) apr_redis_multset(apr_redis_t *rc,
+                                            apr_pool_t *temp_pool,
+                                            apr_hash_t *values);
+
+/**
+ * Deletes multiple keys from the servers
+ * @param rc client to use
+ * @param temp_pool Pool used for temporary allocations
+ * @param keys array of null terminated strings containing the keys
+ * @param deleted location of the number of keys actually deleted, or NULL
+ * @return APR_SUCCESS, or the first error that prevented some servers from
+ *         answering
+ * @remark The keys are sent with one DEL command per server.
+ */
+APR_DECLARE(apr_status_t) apr_redis_multdelete(apr_redis_t *rc,
+                                               apr_pool_t *temp_pool,
+                                               const apr_array_header_t *keys,
+                                               apr_uint32_t *deleted);
+
+/** Opaque pipeline of redis commands */
+typedef struct apr_redis_pipeline_t apr_redis_pipeline_t;
+
+/** Type of a RESP reply */
+typedef enum
+{
+    APR_RR_NONE,    /**< No reply was read */
+    APR_RR_STATUS,  /**< Simple string, e.g. OK */
+    APR_RR_ERROR,   /**< Error string */
+    APR_RR_INTEGER, /**< Integer */
+    APR_RR_STRING,  /**< Bulk string */
+    APR_RR_NIL,     /**< Null bulk string or array */
+    APR_RR_ARRAY,   /**< Array of replies */
+    APR_RR_DOUBLE,  /**< Double (RESP3) */
+    APR_RR_BOOLEAN, /**< Boolean (RESP3), in integer */
+    APR_RR_BIGNUM,  /**< Big number (RESP3), in str */
+    APR_RR_MAP,     /**< Map (RESP3), its keys and values alternating */
+    APR_RR_SET,     /**< Set of replies (RESP3) */
+    APR_RR_PUSH     /**< Out of band data pushed (RESP3) */
+} apr_redis_reply_type_t;
+
+/** Reply to a pipelined command */
+typedef struct apr_redis_reply_t apr_redis_reply_t;
+struct apr_redis_reply_t
+{
+    /** APR_SUCCESS, APR_NOTFOUND for a nil reply, APR_EGENERAL for an
+     *  error reply, or the error which prevented reading the reply */
+    apr_status_t status;
+    apr_redis_reply_type_t type; /**< @see apr_redis_reply_type_t */
+    char *str;            /**< Null terminated status, error, string,
+                           *   double or big number */
+    apr_size_t len;       /**< Length of str */
+    apr_int64_t integer;  /**< Value of an integer or boolean reply */
+    apr_size_t nelts;     /**< Number of elements of an aggregate reply */
+    apr_redis_reply_t **elts; /**< Elements of an aggregate reply */
+    double number;        /**< Value of a double reply */
+};
+
+/**
+ * Create a pipeline, in which commands are queued per server and then
+ * sent together, saving a round trip per command.
+ * @param pl location of the new pipeline
+ * @param rc client to use
+ * @param p pool from which the pipeline, its commands and their replies
+ *        are allocated
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_create(apr_redis_pipeline_t **pl,
+                                                    apr_redis_t *rc,
+                                                    apr_pool_t *p);
+
+/**
+ * Queue a command in a pipeline
+ * @param pl pipeline to use
+ * @param key null terminated string containing the key which selects the
+ *        server
+ * @param argc number of arguments of the command, its name included
+ * @param argv the arguments, e.g. "SET", key and data
+ * @param argvlen the lengths of the arguments, or NULL if they are all null
+ *        terminated strings
+ * @param reply location of the reply, filled by apr_redis_pipeline_exec()
+ * @return APR_NOTFOUND if there is no live server for @a key
+ * @remark The arguments are not copied, they must remain valid until
+ *         apr_redis_pipeline_exec() returns.
+ * @remark The values which the command writes are not invalidated in
+ *         rc->nearcache, unlike with the helpers below.
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_add(apr_redis_pipeline_t *pl,
+                                                 const char *key,
+                                                 apr_size_t argc,
+                                                 const char * const *argv,
+                                                 const apr_size_t *argvlen,
+                                                 apr_redis_reply_t **reply);
+
+/**
+ * Queue a SET command in a pipeline
+ * @param pl pipeline to use
+ * @param key null terminated string containing the key
+ * @param data data to store on the server, not copied
+ * @param data_size length of data
+ * @param reply location of the reply, filled by apr_redis_pipeline_exec()
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_set(apr_redis_pipeline_t *pl,
+                                                 const char *key,
+                                                 const char *data,
+                                                 apr_size_t data_size,
+                                                 apr_redis_reply_t **reply);
+
+/**
+ * Queue a SETEX command in a pipeline
+ * @param pl pipeline to use
+ * @param key null terminated string containing the key
+ * @param data data to store on the server, not copied
+ * @param data_size length of data
+ * @param timeout time in seconds for the data to live on the server
+ * @param reply location of the reply, filled by apr_redis_pipeline_exec()
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_setex(apr_redis_pipeline_t *pl,
+                                                   const char *key,
+                                                   const char *data,
+                                                   apr_size_t data_size,
+                                                   apr_uint32_t timeout,
+                                                   apr_redis_reply_t **reply);
+
+/**
+ * Queue a GET command in a pipeline
+ * @param pl pipeline to use
+ * @param key null terminated string containing the key
+ * @param reply location of the reply, filled by apr_redis_pipeline_exec()
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_get(apr_redis_pipeline_t *pl,
+                                                 const char *key,
+                                                 apr_redis_reply_t **reply);
+
+/**
+ * Queue a DEL command in a pipeline
+ * @param pl pipeline to use
+ * @param key null terminated string containing the key
+ * @param reply location of the reply, filled by apr_redis_pipeline_exec()
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_delete(apr_redis_pipeline_t *pl,
+                                                    const char *key,
+                                                    apr_redis_reply_t **reply);
+
+/**
+ * Queue an INCRBY command in a pipeline
+ * @param pl pipeline to use
+ * @param key null terminated string containing the key
+ * @param inc number to increment by, negative to decrement
+ * @param reply location of the reply, filled by apr_redis_pipeline_exec()
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_incr(apr_redis_pipeline_t *pl,
+                                                  const char *key,
+                                                  apr_int64_t inc,
+                                                  apr_redis_reply_t **reply);
+
+/**
+ * Send the commands queued in a pipeline and read their replies
+ * @param pl pipeline to use
+ * @return APR_SUCCESS, or the first error that prevented some servers from
+ *         answering, the status of each reply telling its outcome
+ * @remark The commands of each server are written in one go, to all the
+ *         servers before any reply is read, and the replies are read in
+ *         order.  The pipeline is then empty, and can be used again.
+ */
+APR_DECLARE(apr_status_t) apr_redis_pipeline_exec(apr_redis_pipeline_t *pl);
+
+/** Opaque asynchronous connection to a redis server */
+typedef struct apr_redis_async_t apr_redis_async_t;
+
+/**
+ * Function prototype of the callbacks of the asynchronous commands
+ * @param ac the connection
+ * @param reply the reply, allocated from the pool given with the command,
+ *        whose status tells the outcome (or the error of the connection)
+ * @param baton the opaque baton given with the command
+ */
+typedef void (apr_redis_async_cb_t)(apr_redis_async_t *ac,
+                                    apr_redis_reply_t *reply,
+                                    void *baton);
+
+/**
+ * Create an asynchronous connection to a server, whose commands are sent
+ * without waiting for the replies of the previous ones (pipelined), the
+ * replies calling back the commands in order as they are read
+ * @param ac location of the new connection
+ * @param rs server to connect to
+ * @param pollcb pollcb to which the connection's socket is added, e.g. the
+ *        one of an apr_reactor_t
+ * @param client_data client_data of the socket's descriptor in @a pollcb,
+ *        or NULL for @a ac
+ * @param p pool from which the connection is allocated, whose cleanup
+ *        removes the socket from @a pollcb and closes it
+ * @return APR_SUCCESS, or the error of the connection or of the pollcb
+ * @remark The connection is established before this returns, the socket
+ *         is non-blocking thereafter.
+ * @remark The pollcb's callback calls apr_redis_async_process() for the
+ *         descriptor of @a client_data.  A connection is used from the
+ *         thread polling @a pollcb only.
+ */
+APR_DECLARE(apr_status_t) apr_redis_async_create(apr_redis_async_t **ac,
+                                                 apr_redis_server_t *rs,
+                                                 apr_pollcb_t *pollcb,
+                                                 void *client_data,
+                                                 apr_pool_t *p);
+
+/**
+ * Send a command on an asynchronous connection
+ * @param ac connection to use
+ * @param p pool from which the reply is allocated
+ * @param argc number of arguments of the command, its name included
+ * @param argv the arguments, copied if not written right away
+ * @param argvlen the lengths of the arguments, or NULL if they are all null
+ *        terminated strings
+ * @param func function called with the reply
+ * @param baton the opaque baton passed to @a func
+ * @return APR_SUCCESS if @a func will be called, from
+ *         apr_redis_async_process(), or the error of the connection
+ * @remark The command is written right away if the socket is writable,
+ *         otherwise once apr_redis_async_process() is told it is.
+ * @remark The values which the command writes are not invalidated in
+ *         rc->nearcache.
+ */
+APR_DECLARE(apr_status_t) apr_redis_async_command(apr_redis_async_t *ac,
+                                                  apr_pool_t *p,
+                                                  apr_size_t argc,
+                                                  const char * const *argv,
+                                                  const apr_size_t *argvlen,
+                                                  apr_redis_async_cb_t *func,
+                                                  void *baton);
+
+/**
+ * Send a GET command on an asynchronous connection
+ * @param ac connection to use
+ * @param p pool from which the reply is allocated
+ * @param key null terminated string containing the key
+ * @param func function called with the reply, a string or APR_NOTFOUND
+ * @param baton the opaque baton passed to @a func
+ */
+APR_DECLARE(apr_status_t) apr_redis_async_get(apr_redis_async_t *ac,
+                                              apr_pool_t *p,
+                                              const char *key,
+                                              apr_redis_async_cb_t *func,
+                                              void *baton);
+
+/**
+ * Send a SET command on an asynchronous connection
+ * @param ac connection to use
+ * @param p pool from which the reply is allocated
+ * @param key null terminated string containing the key
+ * @param data data to store on the server
+ * @param data_size length of data
+ * @param func function called with the reply
+ * @param baton the opaque baton passed to @a func
+ */
+APR_DECLARE(apr_status_t) apr_redis_async_set(apr_redis_async_t *ac,
+                                              apr_pool_t *p,
+                                              const char *key,
+                                              const char *data,
+                                              apr_size_t data_size,
+                                              apr_redis_async_cb_t *func,
+                                              void *baton);
+
+/**
+ * Send an MGET command on an asynchronous connection
+ * @param ac connection to use
+ * @param p pool from which the reply is allocated
+ * @param nkeys number of keys
+ * @param keys null terminated strings containing the keys, all stored on
+ *        the server of @a ac
+ * @param func function called with the reply, an array of the values in
+ *        the order of @a keys, the missing ones being APR_NOTFOUND
+ * @param baton the opaque baton passed to @a func
+ */
+APR_DECLARE(apr_status_t) apr_redis_async_mget(apr_redis_async_t *ac,
+                                               apr_pool_t *p,
+                                               apr_size_t nkeys,
+                                               const char * const *keys,
+                                               apr_redis_async_cb_t *func,
+                                               void *baton);
+
+/**
+ * Process the events of an asynchronous connection's socket: write the
+ * commands pending and read the replies available, calling back their
+ * commands
+ * @param ac connection to use
+ * @param rtnevents the events signalled by the pollcb
+ * @return APR_SUCCESS, or the error which failed the connection, with which
+ *         the pending commands are then called back
+ * @remark Once failed, a connection refuses new commands, and should be
+ *         cleaned up and created again.
+ */
+APR_DECLARE(apr_status_t) apr_redis_async_process(apr_redis_async_t *ac,
+                                                  apr_int16_t rtnevents);
+
+/**
+ * Get the number of commands of an asynchronous connection awaiting
+ * their reply
+ * @param ac connection to use
+ */
+APR_DECLARE(apr_size_t) apr_redis_async_pending(apr_redis_async_t *ac);
+
 typedef enum
 {
     APR_RS_SERVER_MASTER, /**< Server is a master */
@@ -440,6 +840,43 @@ typedef struct
     apr_uint32_t cluster_enabled;
 } apr_redis_stats_t;
 
+/** Opaque subscription to the invalidations of a server */
+typedef struct apr_redis_tracking_t apr_redis_tracking_t;
+
+/**
+ * Subscribe to the invalidations of the keys read from a server, for them
+ * to be removed from rc->nearcache (Redis 6 client side caching)
+ * @param tr location of the new subscription
+ * @param rc client whose near cache to invalidate
+ * @param rs server to subscribe to
+ * @param p pool from which the subscription and its connection are
+ *        allocated
+ * @return APR_SUCCESS, or the error of the connection or of the commands
+ * @remark A connection of its own gets the client ID of the subscription
+ *         then subscribes to the __redis__:invalidate channel, and each
+ *         connection of @a rs enables the tracking of its reads
+ *         (CLIENT TRACKING on REDIRECT <id>) the next time it is used.
+ * @remark Create the subscription before the values are got from @a rs,
+ *         and again once apr_redis_tracking_process() fails, which clears
+ *         rc->nearcache since invalidations may have been missed.
+ */
+APR_DECLARE(apr_status_t) apr_redis_tracking_create(apr_redis_tracking_t **tr,
+                                                    apr_redis_t *rc,
+                                                    apr_redis_server_t *rs,
+                                                    apr_pool_t *p);
+
+/**
+ * Remove from the near cache the keys which the server invalidated
+ * @param tr subscription to use
+ * @param timeout how long to wait for a first invalidation
+ * @return APR_SUCCESS once the invalidations received are processed,
+ *         APR_TIMEUP if none came in time, or the error of the connection
+ * @remark Call it from a single thread, often enough for the cached values
+ *         to be fresh, e.g. in a loop of its own.
+ */
+APR_DECLARE(apr_status_t) apr_redis_tracking_process(apr_redis_tracking_t *tr,
+                                            apr_interval_time_t timeout);
+
 /**
  * Query a server for statistics
  * @param rs    server to query
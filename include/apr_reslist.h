@@ -59,6 +59,16 @@ typedef apr_status_t (*apr_reslist_constructor)(void **resource, void *params,
 typedef apr_status_t (*apr_reslist_destructor)(void *resource, void *params,
                                                apr_pool_t *pool);
 
+/* Generic validator called by the resource list maintainer to check that
+ * an available resource is still usable, e.g. by pinging a connection.
+ * A resource is destroyed if this does not return APR_SUCCESS.
+ * @param resource opaque resource
+ * @param params flags
+ * @param pool  Pool
+ */
+typedef apr_status_t (*apr_reslist_validator)(void *resource, void *params,
+                                              apr_pool_t *pool);
+
 /* Cleanup order modes */
 #define APR_RESLIST_CLEANUP_DEFAULT  0       /**< default pool cleanup */
 #define APR_RESLIST_CLEANUP_FIRST    1       /**< use pool pre cleanup */
@@ -176,6 +186,61 @@ APR_DECLARE(apr_status_t) apr_reslist_invalidate(apr_reslist_t *reslist,
  */
 APR_DECLARE(apr_status_t) apr_reslist_maintain(apr_reslist_t *reslist);
 
+/**
+ * Split the available resources of the list in shards, each with its own
+ * lock, such that the threads acquire and release them without contending
+ * on the lock of the list.
+ * @param reslist The resource list.
+ * @param shards The number of shards, zero or one for none.
+ * @return APR_EINVAL if @a shards is negative or the list is already
+ *         sharded, APR_ENOTIMPL if APR has been compiled without thread
+ *         support.
+ * @remark Each thread releases the resources to its own shard and acquires
+ *         them from there first, then from the list or the other shards,
+ *         creating or waiting for one as usual only if none is available.
+ *         The resources are moved back from the shards to the list by the
+ *         maintenance, which the releases run at most once per ttl (or per
+ *         second without ttl) if the list is not locked already; the min,
+ *         smax and ttl settings hold only as of the maintenance.
+ * @remark This must be called before the list is used by multiple threads.
+ */
+APR_DECLARE(apr_status_t) apr_reslist_shards_set(apr_reslist_t *reslist,
+                                                 int shards);
+
+/**
+ * Start a thread maintaining the resource list in the background, such
+ * that the acquirers never create or destroy a resource themselves.
+ * @param reslist The resource list.
+ * @param interval The time in microseconds between maintenances, and
+ *                 between validations of the available resources.
+ * @param validator If not NULL, called every @a interval on each available
+ *                  resource, which is destroyed if it fails.
+ * @return APR_EINVAL if @a interval is not positive, APR_EBUSY if the
+ *         maintainer is already started, APR_ENOTIMPL if APR has been
+ *         compiled without thread support.
+ * @remark The maintainer keeps min resources available ahead of demand,
+ *         creates those the acquirers wait for (up to hmax), and destroys
+ *         the expired (when the ttl is reached) and invalidated ones, all
+ *         of this without holding the lock of the list while calling the
+ *         constructor, destructor or validator. An acquirer thus waits for
+ *         an available resource only, or fails with the error of the
+ *         constructor if the maintainer could not create one.
+ * @remark The constructor, destructor and validator are serialized, and
+ *         apr_reslist_invalidate() returns before the resource is destroyed.
+ * @remark The maintainer is stopped when the list is destroyed.
+ */
+APR_DECLARE(apr_status_t) apr_reslist_maintainer_start(apr_reslist_t *reslist,
+                                                       apr_interval_time_t interval,
+                                                       apr_reslist_validator validator);
+
+/**
+ * Stop the background maintainer of the resource list, if started.
+ * @param reslist The resource list.
+ * @remark The acquirers create the resources themselves again once this
+ *         returns.
+ */
+APR_DECLARE(apr_status_t) apr_reslist_maintainer_stop(apr_reslist_t *reslist);
+
 /**
  * Set reslist cleanup order.
  * @param reslist The resource list.
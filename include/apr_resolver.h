@@ -0,0 +1,161 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_RESOLVER_H
+#define APR_RESOLVER_H
+
+/**
+ * @file apr_resolver.h
+ * @brief APR caching and asynchronous host name resolver
+ *
+ * @remark A resolver caches the results of apr_sockaddr_info_get(), the
+ * addresses for a given time to live and the failures for a (usually
+ * shorter) negative time to live, since the system resolver does not tell
+ * the TTLs of the DNS records.  With a thread pool, the lookups which miss
+ * the cache can be resolved asynchronously, and the expired addresses can
+ * still be served for a while (stale-while-revalidate) while they are
+ * resolved again in the background, so that the callers never wait for the
+ * names they already resolved once.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_network_io.h"
+#if APR_HAS_THREADS
+#include "apr_thread_pool.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_resolver Host name resolver cache
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the resolver API */
+typedef struct apr_resolver_t apr_resolver_t;
+
+/**
+ * Function prototype of the apr_resolver_lookup_async() callbacks
+ * @param sa The resolved addresses, allocated from the pool given to
+ *           apr_resolver_lookup_async(), or NULL on failure
+ * @param status The result of the resolution, as for apr_sockaddr_info_get()
+ * @param baton The opaque baton given to apr_resolver_lookup_async()
+ */
+typedef void (apr_resolver_cb_t)(apr_sockaddr_t *sa, apr_status_t status,
+                                 void *baton);
+
+/**
+ * Create a resolver
+ * @param resolver The pointer in which to return the newly created object
+ * @param ttl The time in microseconds during which resolved addresses are
+ *            served from the cache
+ * @param negative_ttl The time in microseconds during which failures are
+ *                     served from the cache
+ * @param stale_ttl The time in microseconds after @a ttl during which
+ *                  the expired addresses are still served while they are
+ *                  resolved again, if a thread pool is set
+ * @param p The pool from which to allocate the resolver, and whose cleanup
+ *          destroys the cache
+ * @return APR_EINVAL if any of the times is negative
+ */
+APR_DECLARE(apr_status_t) apr_resolver_create(apr_resolver_t **resolver,
+                                              apr_interval_time_t ttl,
+                                              apr_interval_time_t negative_ttl,
+                                              apr_interval_time_t stale_ttl,
+                                              apr_pool_t *p);
+
+#if APR_HAS_THREADS || defined(DOXYGEN)
+/**
+ * Set the thread pool of a resolver, in which the asynchronous lookups and
+ * the revalidations of the stale addresses are run
+ * @param resolver The resolver
+ * @param tpool The thread pool, or NULL to resolve synchronously only
+ * @remark The thread pool must be destroyed before the resolver, such that
+ *         no resolution is still running.
+ */
+APR_DECLARE(apr_status_t) apr_resolver_thread_pool_set(apr_resolver_t *resolver,
+                                                       apr_thread_pool_t *tpool);
+#endif
+
+/**
+ * Look up the addresses of a host name from the cache of a resolver, or
+ * resolve them and cache them
+ * @param sa The new apr_sockaddr_t, allocated from @a p
+ * @param resolver The resolver
+ * @param hostname The hostname or numeric address string to resolve/parse,
+ *                 as for apr_sockaddr_info_get()
+ * @param family The address family to use, as for apr_sockaddr_info_get()
+ * @param port The port number
+ * @param flags Special processing flags, as for apr_sockaddr_info_get()
+ * @param p The pool for the apr_sockaddr_t and associated storage
+ * @remark This can be called from any thread.  It blocks only when the
+ *         name is not cached, or when it expired beyond the stale time.
+ */
+APR_DECLARE(apr_status_t) apr_resolver_lookup(apr_sockaddr_t **sa,
+                                              apr_resolver_t *resolver,
+                                              const char *hostname,
+                                              apr_int32_t family,
+                                              apr_port_t port,
+                                              apr_int32_t flags,
+                                              apr_pool_t *p);
+
+/**
+ * Look up the addresses of a host name from the cache of a resolver, or
+ * resolve them in the thread pool of the resolver
+ * @param resolver The resolver
+ * @param hostname The hostname or numeric address string to resolve/parse
+ * @param family The address family to use
+ * @param port The port number
+ * @param flags Special processing flags
+ * @param func The function called with the result
+ * @param baton The opaque baton passed to @a func
+ * @param p The pool for the apr_sockaddr_t and associated storage, which
+ *          must not be used by another thread until @a func is called
+ * @remark If the name is cached (or no thread pool is set), @a func is
+ *         called before this function returns.  Otherwise it is called
+ *         from a thread of the pool once the name is resolved, the
+ *         concurrent lookups of the same name sharing the resolution; a
+ *         reactor's thread can get the result with apr_reactor_task_push().
+ * @return APR_SUCCESS if @a func was or will be called
+ */
+APR_DECLARE(apr_status_t) apr_resolver_lookup_async(apr_resolver_t *resolver,
+                                                    const char *hostname,
+                                                    apr_int32_t family,
+                                                    apr_port_t port,
+                                                    apr_int32_t flags,
+                                                    apr_resolver_cb_t *func,
+                                                    void *baton,
+                                                    apr_pool_t *p);
+
+/**
+ * Forget the results cached by a resolver, the next lookups resolve again
+ * @param resolver The resolver
+ */
+APR_DECLARE(apr_status_t) apr_resolver_clear(apr_resolver_t *resolver);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_RESOLVER_H */
@@ -57,6 +57,35 @@ APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock,
                                        void *membuf, apr_size_t memsize, 
                                        apr_pool_t *cont);
 
+/**
+ * Serve the small allocations from lock-free per size class free lists
+ * (see apr_rmm_init_ex()).
+ */
+#define APR_RMM_SLAB 0x1
+
+/**
+ * Initialize a relocatable memory block to be managed by the apr_rmm API,
+ * with options.
+ * @param rmm The relocatable memory block
+ * @param lock An apr_anylock_t of the appropriate type of lock, or NULL
+ *             if no locking is required.
+ * @param membuf The block of relocatable memory to be managed
+ * @param memsize The size of relocatable memory block to be managed
+ * @param flags APR_RMM_SLAB, or zero to behave as apr_rmm_init()
+ * @param cont The pool to use for local storage and management
+ * @remark With APR_RMM_SLAB, the allocations of up to 32KB are rounded up
+ * to a power of two size class and taken from and freed to its lock-free
+ * list in constant time.  Those lists are refilled with slabs carved out
+ * of the memory block under the lock, which are never given back for the
+ * other classes or the bigger allocations.  The cross-process use of this
+ * mode needs lock-free 64-bit atomics, and a memory block of up to 32GB.
+ * @return APR_EINVAL if memsize is too big for APR_RMM_SLAB.
+ */
+APR_DECLARE(apr_status_t) apr_rmm_init_ex(apr_rmm_t **rmm, apr_anylock_t *lock,
+                                          void *membuf, apr_size_t memsize,
+                                          apr_uint32_t flags,
+                                          apr_pool_t *cont);
+
 /**
  * Destroy a managed memory block.
  * @param rmm The relocatable memory block to destroy
@@ -123,6 +152,37 @@ APR_DECLARE(void *) apr_rmm_addr_get(apr_rmm_t *rmm, apr_rmm_off_t entity);
  */
 APR_DECLARE(apr_rmm_off_t) apr_rmm_offset_get(apr_rmm_t *rmm, void *entity);
 
+/** Usage and fragmentation statistics of a relocatable memory block */
+typedef struct apr_rmm_stats_t {
+    /** The size of the memory block */
+    apr_size_t size;
+    /** The bytes of the free blocks, their headers included */
+    apr_size_t free;
+    /** The number of free blocks */
+    apr_size_t free_blocks;
+    /** The bytes of the largest free block, the other free bytes being
+     *  unusable for bigger allocations */
+    apr_size_t largest_free;
+    /** The bytes carved into slab objects with APR_RMM_SLAB, their headers
+     *  included, whether allocated or free */
+    apr_size_t slab_carved;
+    /** The bytes of the size classes of the slab objects allocated */
+    apr_size_t slab_inuse;
+    /** The bytes requested for them, the difference being lost to the
+     *  rounding up to the size classes */
+    apr_size_t slab_requested;
+} apr_rmm_stats_t;
+
+/**
+ * Get the usage and fragmentation statistics of a relocatable memory block.
+ * @param rmm The relocatable memory block
+ * @param stats The statistics to fill in
+ * @remark The free blocks are walked under the lock, while the slab figures
+ *         are a snapshot of counters updated concurrently.
+ */
+APR_DECLARE(apr_status_t) apr_rmm_stats_get(apr_rmm_t *rmm,
+                                            apr_rmm_stats_t *stats);
+
 /**
  * Compute the required overallocation of memory needed to fit n allocs
  * @param n The number of alloc/calloc regions desired
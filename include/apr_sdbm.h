@@ -83,11 +83,37 @@ typedef struct {
  * @param p The pool to use when creating the sdbm
  * @remark The sdbm name is not a true file name, as sdbm appends suffixes 
  * for seperate data and index files.
+ * @remark Where mmap is available, lookups under a shared lock (always for
+ * a database opened read-only) read the files mapped into memory, mapped
+ * again whenever they grew since the previous lock.  Otherwise the most
+ * recently used pages are kept in a small cache, emptied at each lock.
  */
 APR_DECLARE(apr_status_t) apr_sdbm_open(apr_sdbm_t **db, const char *name, 
                                         apr_int32_t mode, 
                                         apr_fileperms_t perms, apr_pool_t *p);
 
+/**
+ * Open an sdbm database by file name, choosing the format of a new one
+ * @param db The newly opened database
+ * @param name The sdbm file to open
+ * @param mode The flag values, as for apr_sdbm_open()
+ * @param perms Permissions to apply to if created
+ * @param pagesize The page size of a new database, a power of 2 from
+ * 1024 to 65536, or 0 for the original format of 1024 byte pages
+ * @param p The pool to use when creating the sdbm
+ * @remark A database created with a nonzero page size uses the version 2
+ * format: a header, pages of that size, a better distributing hash, and
+ * values of any size, those too large to share a page being kept in a
+ * chain of overflow pages.  It can not be read by older versions of APR.
+ * @remark An existing database is opened in the format it was created
+ * with, whatever the page size given; apr_sdbm_open() does the same.
+ */
+APR_DECLARE(apr_status_t) apr_sdbm_open_ex(apr_sdbm_t **db, const char *name,
+                                           apr_int32_t mode,
+                                           apr_fileperms_t perms,
+                                           apr_size_t pagesize,
+                                           apr_pool_t *p);
+
 /**
  * Close an sdbm file previously opened by apr_sdbm_open
  * @param db The database to close
@@ -122,6 +148,8 @@ APR_DECLARE(apr_status_t) apr_sdbm_unlock(apr_sdbm_t *db);
  * @param db The database 
  * @param value The value datum retrieved for this record
  * @param key The key datum to find this record
+ * @remark The value points into the database's page and stays valid until
+ * the next call on the database.
  */
 APR_DECLARE(apr_status_t) apr_sdbm_fetch(apr_sdbm_t *db, 
                                          apr_sdbm_datum_t *value, 
@@ -150,6 +178,34 @@ APR_DECLARE(apr_status_t) apr_sdbm_store(apr_sdbm_t *db, apr_sdbm_datum_t key,
 APR_DECLARE(apr_status_t) apr_sdbm_delete(apr_sdbm_t *db, 
                                           const apr_sdbm_datum_t key);
 
+/**
+ * Callback supplying the records to apr_sdbm_bulk_load, one per call
+ * @param baton The baton given to apr_sdbm_bulk_load
+ * @param key The key datum of the next record
+ * @param value The value datum of the next record
+ * @return APR_SUCCESS with the next record, APR_EOF after the last one,
+ * or an error aborting the load
+ * @remark The data need only stay valid until the next call.
+ */
+typedef apr_status_t (apr_sdbm_bulk_next_fn_t)(void *baton,
+                                               apr_sdbm_datum_t *key,
+                                               apr_sdbm_datum_t *value);
+
+/**
+ * Store many records at once, as apr_sdbm_store with APR_SDBM_REPLACE
+ * would but rebuilding the database in one go
+ * @param db The database
+ * @param next The callback supplying the records, in any order
+ * @param baton The baton passed to the callback
+ * @remark The records, those of the database with the new ones, are all
+ * held in memory, and the files rewritten from them in large sequential
+ * writes under a single exclusive lock.  Should a record be invalid or
+ * the callback fail, the database is left untouched.
+ */
+APR_DECLARE(apr_status_t) apr_sdbm_bulk_load(apr_sdbm_t *db,
+                                             apr_sdbm_bulk_next_fn_t *next,
+                                             void *baton);
+
 /**
  * Retrieve the first record key from a dbm
  * @param db The database 
@@ -173,5 +229,12 @@ APR_DECLARE(apr_status_t) apr_sdbm_nextkey(apr_sdbm_t *db, apr_sdbm_datum_t *key
  * @param db The database to test
  */
 APR_DECLARE(int) apr_sdbm_rdonly(apr_sdbm_t *db);
+
+/**
+ * Returns the page size of an sdbm database of the version 2 format
+ * @param db The database to query
+ * @return The page size, or 0 for a database of the original format
+ */
+APR_DECLARE(apr_size_t) apr_sdbm_pagesize(apr_sdbm_t *db);
 /** @} */
 #endif /* APR_SDBM_H */
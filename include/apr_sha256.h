@@ -0,0 +1,72 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_SHA256_H
+#define APR_SHA256_H
+
+/**
+ * @file apr_sha256.h
+ * @brief APR SHA-256 digests
+ *
+ * @remark The digests are computed with the SHA instructions of the CPU
+ * when it has them (SHA-NI on x86, the cryptographic extension on
+ * aarch64).  For a streaming digest, see apr_crypto_sha256_new().
+ */
+
+#include "apr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup apr_sha256 SHA-256 digests
+ * @ingroup APR
+ * @{
+ */
+
+/** size of the SHA-256 digest */
+#define APR_SHA256_DIGESTSIZE 32
+
+/**
+ * Compute the SHA-256 digest of a buffer.
+ * @param digest The output buffer in which to store the digest.
+ * @param data The buffer to digest.
+ * @param len The length of the buffer.
+ */
+APR_DECLARE(void) apr_sha256(unsigned char digest[APR_SHA256_DIGESTSIZE],
+                             const void *data, apr_size_t len);
+
+/**
+ * Compute the SHA-256 digests of many independent buffers.
+ * @param digests The n output buffers in which to store the digests, the
+ *        digest of vec[i] going to digests[i].
+ * @param vec The buffers to digest.
+ * @param n The number of buffers.
+ * @remark Where the CPU has AVX2 but not the SHA instructions, the
+ *         buffers are hashed eight at a time in the lanes of the vector
+ *         registers, four to five times faster than one after the other.
+ */
+APR_DECLARE(void) apr_sha256_multi(unsigned char (*digests)[APR_SHA256_DIGESTSIZE],
+                                   const struct iovec *vec, apr_size_t n);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_SHA256_H */
@@ -86,6 +86,23 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
                                * segment in the "Global" namespace on
                                * Windows.  (Ignored on other platforms.)
                                */
+#define APR_SHM_HUGEPAGES   4 /* Back the segment with huge pages, reserved
+                               * ones (hugetlbfs) for anonymous and SysV
+                               * segments when available, transparent
+                               * ones otherwise.  (Linux only, ignored
+                               * where neither is available.)
+                               */
+#define APR_SHM_PREFAULT    8 /* Fault all the pages of the segment in at
+                               * creation rather than on first touch.
+                               */
+#define APR_SHM_MLOCK      16 /* Lock the pages of the segment in memory
+                               * (subject to RLIMIT_MEMLOCK) in the mapping
+                               * of the creating process.
+                               */
+#define APR_SHM_NUMA_INTERLEAVE 32 /* Interleave the pages of the segment
+                               * over the allowed NUMA nodes.  (Linux only,
+                               * ignored where NUMA is not supported.)
+                               */
 
 /**
  * Create and make accessible a shared memory segment with platform-
@@ -110,7 +127,12 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
  *         implementation to request a slightly greater segment length
  *         from the subsystem. In all cases, the apr_shm_baseaddr_get()
  *         function will return the first usable byte of memory.
- * 
+ * @remark The flags applying to the pages (APR_SHM_HUGEPAGES,
+ *         APR_SHM_PREFAULT, APR_SHM_MLOCK and APR_SHM_NUMA_INTERLEAVE) are
+ *         applied once at creation, through the mapping of the creating
+ *         process; the pages faulted in then are shared as such with the
+ *         attaching processes.
+ *
  */
 APR_DECLARE(apr_status_t) apr_shm_create_ex(apr_shm_t **m,
                                             apr_size_t reqsize,
@@ -0,0 +1,194 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_SHM_HASH_H
+#define APR_SHM_HASH_H
+
+/**
+ * @file apr_shm_hash.h
+ * @brief APR Shared memory hash tables
+ *
+ * @remark A shared memory hash table lives in an apr_shm segment, where
+ * the entries are allocated by an apr_rmm and addressed by their offsets,
+ * such that forked children and unrelated processes attaching to the
+ * segment by its name all see the same table.  Keys and values are copied
+ * in and out of the table.
+ *
+ * The buckets are protected by a number of locks (the stripes), on which
+ * the operations on different keys seldom contend.  The locks are futexes
+ * where available, which a process dying while holding them does not
+ * leave locked, or spinlocks otherwise.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_shm_hash Shared memory hash tables
+ * @ingroup APR
+ * @{
+ */
+
+/** Evict the least recently used entries when the table is full */
+#define APR_SHM_HASH_LRU        0x1
+/** Use spinlocks even where futexes are available */
+#define APR_SHM_HASH_SPINLOCK   0x2
+
+/** Opaque structure used for the shared memory hash table API */
+typedef struct apr_shm_hash_t apr_shm_hash_t;
+
+/**
+ * Callback functions for calling apr_shm_hash_do() on each entry.
+ * @param rec The data passed as the first argument to apr_shm_hash_do()
+ * @param key The key of the entry
+ * @param klen The length of the key
+ * @param val The value of the entry
+ * @param vlen The length of the value
+ * @return zero to stop iterating, non-zero to continue
+ */
+typedef int (apr_shm_hash_do_callback_fn_t)(void *rec, const void *key,
+                                            apr_size_t klen,
+                                            const void *val,
+                                            apr_size_t vlen);
+
+/**
+ * Create a shared memory hash table.
+ * @param ht The newly created table.
+ * @param size The size of the shared memory segment, which bounds the
+ *        size of the entries.
+ * @param filename The file name of the segment for other processes to
+ *        attach to it, or NULL for an anonymous segment shared with the
+ *        forked children only (see apr_shm_create()).
+ * @param nbuckets The number of buckets, or zero for one per 512 bytes.
+ * @param nstripes The number of locks, or zero for the default of 16.
+ * @param flags APR_SHM_HASH_LRU and/or APR_SHM_HASH_SPINLOCK, or zero.
+ * @param pool The pool to allocate the table and segment handles from.
+ * @return APR_EINVAL if size is too small for the buckets and locks.
+ * @remark Without APR_SHM_HASH_LRU, apr_shm_hash_set() fails when the
+ *         table is full.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_create(apr_shm_hash_t **ht,
+                                              apr_size_t size,
+                                              const char *filename,
+                                              unsigned int nbuckets,
+                                              unsigned int nstripes,
+                                              apr_uint32_t flags,
+                                              apr_pool_t *pool);
+
+/**
+ * Attach to a shared memory hash table created by another process.
+ * @param ht The attached table.
+ * @param filename The file name given to apr_shm_hash_create().
+ * @param pool The pool to allocate the table and segment handles from.
+ * @return APR_EINVAL if the segment does not hold a table.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_attach(apr_shm_hash_t **ht,
+                                              const char *filename,
+                                              apr_pool_t *pool);
+
+/**
+ * Detach from a shared memory hash table, which remains for the others.
+ * @param ht The table.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_detach(apr_shm_hash_t *ht);
+
+/**
+ * Destroy a shared memory hash table and its segment.
+ * @param ht The table.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_destroy(apr_shm_hash_t *ht);
+
+/**
+ * Set the value of a key, replacing its previous value if any.
+ * @param ht The table.
+ * @param key The key.
+ * @param klen The length of the key, or APR_HASH_KEY_STRING to use the
+ *        string length.
+ * @param val The value.
+ * @param vlen The length of the value.
+ * @param ttl The time after which the entry expires, or zero to never
+ *        expire.
+ * @return APR_ENOMEM if the table is full and nothing can be evicted.
+ * @remark With APR_SHM_HASH_LRU, room is made by evicting the least
+ *         recently used entries of the same stripe.  Expired entries are
+ *         released first in any case.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_set(apr_shm_hash_t *ht,
+                                           const void *key, apr_ssize_t klen,
+                                           const void *val, apr_size_t vlen,
+                                           apr_interval_time_t ttl);
+
+/**
+ * Get the value of a key.
+ * @param ht The table.
+ * @param key The key.
+ * @param klen The length of the key, or APR_HASH_KEY_STRING.
+ * @param val A copy of the value, allocated from pool and NUL terminated.
+ * @param vlen The length of the value, if not NULL.
+ * @param pool The pool to allocate the copy from.
+ * @return APR_NOTFOUND if the key is not in the table, or expired.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_get(apr_shm_hash_t *ht,
+                                           const void *key, apr_ssize_t klen,
+                                           void **val, apr_size_t *vlen,
+                                           apr_pool_t *pool);
+
+/**
+ * Delete a key.
+ * @param ht The table.
+ * @param key The key.
+ * @param klen The length of the key, or APR_HASH_KEY_STRING.
+ * @return APR_NOTFOUND if the key is not in the table, or expired.
+ */
+APR_DECLARE(apr_status_t) apr_shm_hash_delete(apr_shm_hash_t *ht,
+                                              const void *key,
+                                              apr_ssize_t klen);
+
+/**
+ * Iterate over the entries of a table, calling comp for each one until
+ * it returns zero.
+ * @param comp The function to run.
+ * @param rec The data to pass as the first argument to comp.
+ * @param ht The table.
+ * @return zero if a call of comp returned zero, non-zero otherwise.
+ * @remark comp is called with the lock of the entry's stripe held and must
+ *         not use the table.  The entries set or deleted concurrently may
+ *         or may not be iterated.
+ */
+APR_DECLARE(int) apr_shm_hash_do(apr_shm_hash_do_callback_fn_t *comp,
+                                 void *rec, apr_shm_hash_t *ht);
+
+/**
+ * Get the number of entries in a table, including the expired ones not
+ * released yet.
+ * @param ht The table.
+ */
+APR_DECLARE(unsigned int) apr_shm_hash_count(apr_shm_hash_t *ht);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_SHM_HASH_H */
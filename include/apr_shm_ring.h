@@ -0,0 +1,167 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_SHM_RING_H
+#define APR_SHM_RING_H
+
+/**
+ * @file apr_shm_ring.h
+ * @brief APR Shared memory ring buffers
+ *
+ * @remark A shared memory ring buffer passes variable length records from
+ * one producer (or many with APR_SHM_RING_MPSC) to a single consumer, the
+ * processes being forked children of the creator or attaching to the
+ * segment by its name.  The records are written and read in place: the
+ * producer reserves room in the ring, fills it and commits it, and the
+ * consumer peeks at the oldest committed record and releases it.
+ *
+ * Neither side takes a lock nor makes a system call in the common case.
+ * The consumer may wait for records, it then sleeps on a futex where
+ * available (and polls otherwise), and the producers wake it up only
+ * when it does.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_shm_ring Shared memory ring buffers
+ * @ingroup APR
+ * @{
+ */
+
+/** Allow multiple concurrent producers */
+#define APR_SHM_RING_MPSC       0x1
+
+/** Opaque structure used for the shared memory ring buffer API */
+typedef struct apr_shm_ring_t apr_shm_ring_t;
+
+/**
+ * Create a shared memory ring buffer.
+ * @param ring The newly created ring.
+ * @param size The capacity of the ring in bytes, rounded up to a power
+ *        of two.  Each record takes eight more bytes, rounded up to a
+ *        multiple of eight.
+ * @param filename The file name of the segment for other processes to
+ *        attach to it, or NULL for an anonymous segment shared with the
+ *        forked children only (see apr_shm_create()).
+ * @param flags APR_SHM_RING_MPSC, or zero for a single producer.
+ * @param pool The pool to allocate the ring and segment handles from.
+ * @return APR_EINVAL if size is zero or above 1GB.
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_create(apr_shm_ring_t **ring,
+                                              apr_size_t size,
+                                              const char *filename,
+                                              apr_uint32_t flags,
+                                              apr_pool_t *pool);
+
+/**
+ * Attach to a shared memory ring buffer created by another process.
+ * @param ring The attached ring.
+ * @param filename The file name given to apr_shm_ring_create().
+ * @param pool The pool to allocate the ring and segment handles from.
+ * @return APR_EINVAL if the segment does not hold a ring.
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_attach(apr_shm_ring_t **ring,
+                                              const char *filename,
+                                              apr_pool_t *pool);
+
+/**
+ * Detach from a shared memory ring buffer, which remains for the others.
+ * @param ring The ring.
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_detach(apr_shm_ring_t *ring);
+
+/**
+ * Destroy a shared memory ring buffer and its segment.
+ * @param ring The ring.
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_destroy(apr_shm_ring_t *ring);
+
+/**
+ * Reserve room for a record in the ring.
+ * @param ring The ring.
+ * @param len The length of the record, at most half of the capacity
+ *        minus eight bytes.
+ * @param buf The room to write the record to, aligned on eight bytes.
+ * @return APR_EAGAIN if the ring is full, APR_EINVAL if len is too long.
+ * @remark The record is passed to the consumer by apr_shm_ring_commit(),
+ *         and holds up the records reserved after it until then.
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_reserve(apr_shm_ring_t *ring,
+                                               apr_size_t len, void **buf);
+
+/**
+ * Commit a record reserved by apr_shm_ring_reserve(), waking up the
+ * consumer if it waits.
+ * @param ring The ring.
+ * @param buf The room returned by apr_shm_ring_reserve().
+ */
+APR_DECLARE(void) apr_shm_ring_commit(apr_shm_ring_t *ring, void *buf);
+
+/**
+ * Copy a record into the ring.
+ * @param ring The ring.
+ * @param data The record.
+ * @param len The length of the record.
+ * @return APR_EAGAIN if the ring is full, APR_EINVAL if len is too long.
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_write(apr_shm_ring_t *ring,
+                                             const void *data,
+                                             apr_size_t len);
+
+/**
+ * Get the oldest record of the ring, in place, waiting for one if needed.
+ * @param ring The ring.
+ * @param buf The record.
+ * @param len The length of the record.
+ * @param timeout The time to wait for a record, zero to not wait, or a
+ *        negative value to wait forever.
+ * @return APR_EAGAIN if timeout is zero and the ring is empty, APR_TIMEUP
+ *         if no record was committed in time.
+ * @remark The record remains valid, and is returned again by the next
+ *         calls, until released by apr_shm_ring_release().
+ */
+APR_DECLARE(apr_status_t) apr_shm_ring_peek(apr_shm_ring_t *ring,
+                                            void **buf, apr_size_t *len,
+                                            apr_interval_time_t timeout);
+
+/**
+ * Release the record returned by apr_shm_ring_peek(), making its room
+ * available to the producers.
+ * @param ring The ring.
+ */
+APR_DECLARE(void) apr_shm_ring_release(apr_shm_ring_t *ring);
+
+/**
+ * Get the capacity of a ring in bytes.
+ * @param ring The ring.
+ */
+APR_DECLARE(apr_size_t) apr_shm_ring_capacity(apr_shm_ring_t *ring);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_SHM_RING_H */
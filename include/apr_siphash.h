@@ -55,6 +55,9 @@ extern "C" {
 /** size of the siphash key */
 #define APR_SIPHASH_KSIZE 16
 
+/** size of the 128bit siphash digest */
+#define APR_SIPHASH128_DSIZE 16
+
 
 /**
  * @brief Computes SipHash-c-d, producing a 64bit (APR_SIPHASH_DSIZE) hash
@@ -140,6 +143,51 @@ APR_DECLARE(void) apr_siphash48_auth(unsigned char out[APR_SIPHASH_DSIZE],
                                      const void *src, apr_size_t len,
                                const unsigned char key[APR_SIPHASH_KSIZE]);
 
+/**
+ * @brief Computes SipHash-2-4-128, the variant of SipHash-2-4 producing a
+ * 128bit (APR_SIPHASH128_DSIZE) hash from a message and a 128bit
+ * (APR_SIPHASH_KSIZE) secret key, for the cost of four more rounds.
+ * @param out The hash value as two 64bit unsigned integers
+ * @param src The message to hash
+ * @param len The length of the message
+ * @param key The secret key
+ * @remark The two halves are independent hash functions of the message,
+ *         as double hashing (e.g. a Bloom filter) needs.
+ */
+APR_DECLARE(void) apr_siphash24_128(apr_uint64_t out[2],
+                                    const void *src, apr_size_t len,
+                               const unsigned char key[APR_SIPHASH_KSIZE]);
+
+/**
+ * @brief Computes SipHash-2-4-128, producing a 128bit (APR_SIPHASH128_DSIZE)
+ * hash from a message and a 128bit (APR_SIPHASH_KSIZE) secret key, into a
+ * possibly unaligned buffer (using the little endian representation as
+ * defined by the authors for interoperabilty) usable as a MAC.
+ * @param out The output buffer (or MAC)
+ * @param src The message
+ * @param len The length of the message
+ * @param key The secret key
+ */
+APR_DECLARE(void) apr_siphash24_128_auth(unsigned char out[APR_SIPHASH128_DSIZE],
+                                         const void *src, apr_size_t len,
+                               const unsigned char key[APR_SIPHASH_KSIZE]);
+
+/**
+ * @brief Computes SipHash-2-4 of many independent messages with the same
+ * 128bit (APR_SIPHASH_KSIZE) secret key.
+ * @param out The n hash values, that of vec[i] going to out[i]
+ * @param vec The messages to hash
+ * @param n The number of messages
+ * @param key The secret key
+ * @remark Where the CPU has AVX2, the messages are hashed eight at a time
+ *         in the lanes of the vector registers, up to twice as fast as one
+ *         after the other. A group of eight costs as much as its longest
+ *         message, so keys of similar lengths gain the most.
+ */
+APR_DECLARE(void) apr_siphash24_batch(apr_uint64_t *out,
+                                      const struct iovec *vec, apr_size_t n,
+                               const unsigned char key[APR_SIPHASH_KSIZE]);
+
 #ifdef __cplusplus
 }
 #endif
@@ -84,6 +84,7 @@ APR_DECLARE(void *) apr_skiplist_alloc(apr_skiplist *sl, size_t size);
  * to operations on the skip list or to other calls to apr_skiplist_alloc().
  * Otherwise, memory will be freed using the  C standard library heap
  * functions.
+ * @remark The memory must have been allocated with apr_skiplist_alloc().
  */
 APR_DECLARE(void) apr_skiplist_free(apr_skiplist *sl, void *mem);
 
@@ -96,6 +97,46 @@ APR_DECLARE(void) apr_skiplist_free(apr_skiplist *sl, void *mem);
  */
 APR_DECLARE(apr_status_t) apr_skiplist_init(apr_skiplist **sl, apr_pool_t *p);
 
+/**
+ * Make the skip list safe for concurrent use, see apr_skiplist_init_ex()
+ */
+#define APR_SKIPLIST_CONCURRENT 0x01
+
+/**
+ * Allocate a new skip list with the given flags
+ * @param sl The pointer in which to return the newly created skip list
+ * @param p The pool from which to allocate the skip list (optional).
+ * @param flags Zero or APR_SKIPLIST_CONCURRENT
+ * @return APR_EINVAL if @a flags is not supported
+ * @remark With APR_SKIPLIST_CONCURRENT, apr_skiplist_insert(),
+ * apr_skiplist_add(), apr_skiplist_replace() (and their _compare()
+ * variants), apr_skiplist_find(), apr_skiplist_last(),
+ * apr_skiplist_remove(), apr_skiplist_remove_node(), apr_skiplist_pop(),
+ * apr_skiplist_peek() and apr_skiplist_size() can be called concurrently
+ * by multiple threads without locking: the elements are linked and
+ * unlinked with atomic operations, and the removed nodes are reclaimed
+ * once no concurrent operation can access them anymore. The comparison
+ * functions and the preheight must be set before the skip list is
+ * shared, and apr_skiplist_remove_all(), apr_skiplist_destroy() and
+ * apr_skiplist_merge() must not run concurrently with other operations.
+ * @remark The nodes of a concurrent skip list are always allocated with
+ * the C standard library heap functions since pools are not thread-safe
+ * (nor is apr_skiplist_alloc()), the pool (if any) is used for the skip
+ * list itself and to free everything when it's cleared or destroyed.
+ * @remark A removed element may still be compared by concurrent operations
+ * until its node is reclaimed, so the freefunc given to the removing
+ * functions is called at that time, and the elements removed without a
+ * freefunc should be freed only when no operation can be running on them.
+ * @remark There are no indexes (see apr_skiplist_add_index()) nor iterations
+ * (see apr_skiplist_getlist()) for concurrent skip lists, the nodes returned
+ * by the insertions and searches are only usable with apr_skiplist_element()
+ * and apr_skiplist_remove_node(), and only by the thread that removes them
+ * (or while it's known they are not being removed).
+ */
+APR_DECLARE(apr_status_t) apr_skiplist_init_ex(apr_skiplist **sl,
+                                               apr_pool_t *p,
+                                               apr_uint32_t flags);
+
 /**
  * Set the comparison functions to be used for searching the skip list.
  * @param sl The skip list
@@ -176,6 +217,37 @@ APR_DECLARE(void *) apr_skiplist_last_compare(apr_skiplist *sl, void *data,
 APR_DECLARE(void *) apr_skiplist_last(apr_skiplist *sl, void *data,
                                       apr_skiplistnode **iter);
 
+/**
+ * Return the first element of the skip list in the range [lo, hi).
+ * @param sl The skip list
+ * @param lo The lower bound (included), or NULL to start from the first
+ * element
+ * @param hi The upper bound (excluded), or NULL for no upper bound
+ * @param iter A pointer to the returned skip list node representing the
+ * element found, to be passed to apr_skiplist_range_next()
+ * @return The element, or NULL if the range is empty
+ * @remark The bounds are compared to the elements with the existing key
+ * comparison function (the second one given to apr_skiplist_set_compare()).
+ * @remark To remove the elements while iterating (e.g. expiry sweeps), get
+ * the next element before removing the current one with
+ * apr_skiplist_remove_node().
+ * @remark Not available for APR_SKIPLIST_CONCURRENT skip lists (returns NULL).
+ */
+APR_DECLARE(void *) apr_skiplist_range_first(apr_skiplist *sl, void *lo,
+                                             void *hi,
+                                             apr_skiplistnode **iter);
+
+/**
+ * Return the next element of the skip list in the range [lo, hi).
+ * @param sl The skip list
+ * @param hi The upper bound (excluded), or NULL for no upper bound
+ * @param iter A pointer to the skip list node of the current element,
+ * updated to the returned one
+ * @return The element, or NULL (and iter NULL) at the end of the range
+ */
+APR_DECLARE(void *) apr_skiplist_range_next(apr_skiplist *sl, void *hi,
+                                            apr_skiplistnode **iter);
+
 /**
  * Return the next element in the skip list.
  * @param sl The skip list
@@ -240,6 +312,22 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_add_compare(apr_skiplist *sl,
  */
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_add(apr_skiplist* sl, void *data);
 
+/**
+ * Add sorted elements into the skip list at once.
+ * @param sl The skip list
+ * @param elts The elements to add, sorted with the existing comparison
+ * function (duplicates are kept in order)
+ * @param nelts The number of elements
+ * @return APR_EINVAL if the elements are not sorted or if no comparison
+ * function has been set, in which case none is added.
+ * @remark If the skip list is empty (and has no index), it is built in
+ * linear time with deterministic heights (the perfect skip list),
+ * otherwise the elements are added one by one like apr_skiplist_add().
+ */
+APR_DECLARE(apr_status_t) apr_skiplist_bulk_load_sorted(apr_skiplist *sl,
+                                                        void **elts,
+                                                        size_t nelts);
+
 /**
  * Add an element into the skip list using the specified comparison function
  * removing the existing duplicates.
@@ -365,6 +453,26 @@ APR_DECLARE(int) apr_skiplist_preheight(const apr_skiplist *sl);
  */
 APR_DECLARE(void) apr_skiplist_set_preheight(apr_skiplist *sl, int to);
 
+/**
+ * Set the maximum number of nodes kept for reuse by the skip list.
+ * @param sl The skip list
+ * @param max The maximum number of nodes, or zero for no limit (default).
+ * @remark The nodes of the removed elements are recycled (by tower height,
+ * i.e. all the nodes of an element at once) for the next insertions. Beyond
+ * this limit they are freed, for skip lists using the C standard library
+ * heap functions, or left to the pool otherwise.
+ */
+APR_DECLARE(void) apr_skiplist_set_cache_max(apr_skiplist *sl, size_t max);
+
+/**
+ * Return the memory used by the skip list.
+ * @param sl The skip list
+ * @return The number of bytes allocated for the skip list, its nodes
+ * (including the ones kept for reuse), its indexes and, for skip lists
+ * using a pool, the memory allocated with apr_skiplist_alloc().
+ */
+APR_DECLARE(apr_size_t) apr_skiplist_memory_usage(const apr_skiplist *sl);
+
 /**
  * Merge two skip lists.  XXX SEMANTICS
  * @param sl1 One of two skip lists to be merged
@@ -0,0 +1,119 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_STAT_CACHE_H
+#define APR_STAT_CACHE_H
+
+/**
+ * @file apr_stat_cache.h
+ * @brief APR cache of file information
+ *
+ * @remark A stat cache keeps the results of apr_stat() for the paths asked
+ * again and again, such that they cost a lookup in a sharded table rather
+ * than a system call.  The results are served for a time to live, and/or
+ * until the file system notifies a change to the file, its directory
+ * being watched (inotify on Linux).  Nonexistent paths are cached too.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+#include "apr_file_info.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_stat_cache Cache of file information
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the stat cache API */
+typedef struct apr_stat_cache_t apr_stat_cache_t;
+
+/** Drop the cached information of the files when the file system says
+ * they change */
+#define APR_STAT_CACHE_NOTIFY 0x01
+
+/**
+ * Create a stat cache
+ * @param sc The pointer in which to return the newly created object
+ * @param max_bytes The maximum size of the cache, as apr_nearcache_create()
+ * @param ttl The time in microseconds during which a result is served, or
+ *            zero for no expiry, which needs #APR_STAT_CACHE_NOTIFY
+ * @param flags #APR_STAT_CACHE_NOTIFY or 0
+ * @param p The pool from which to allocate the cache, and whose cleanup
+ *          releases it
+ * @return APR_ENOTIMPL if #APR_STAT_CACHE_NOTIFY is not supported by the
+ *         system, APR_EINVAL if @a ttl is negative, or zero without
+ *         notifications
+ * @remark With #APR_STAT_CACHE_NOTIFY, a change made to a file is seen
+ *         after the file system event is processed, by a thread of the
+ *         cache (without threads, on the next lookup).  Renaming a parent
+ *         of the file's directory is not noticed, the ttl bounds then how
+ *         long a result can be stale.
+ */
+APR_DECLARE(apr_status_t) apr_stat_cache_create(apr_stat_cache_t **sc,
+                                                apr_size_t max_bytes,
+                                                apr_interval_time_t ttl,
+                                                apr_int32_t flags,
+                                                apr_pool_t *p);
+
+/**
+ * Get the specified file's stats, from the cache or apr_stat()
+ * @param sc The stat cache
+ * @param finfo Where to store the information about the file, which is
+ *              never touched if the call fails.
+ * @param fname The name of the file to stat.
+ * @param wanted The desired apr_finfo_t fields, as a bit flag of APR_FINFO_
+ *               values
+ * @param pool The pool to use.
+ * @return As apr_stat()
+ * @remark The files are stat'ed for APR_FINFO_NORM (and APR_FINFO_LINK if
+ *         @a wanted asks) whatever @a wanted, such that a result serves
+ *         any later lookup.  A relative @a fname is cached as such, so
+ *         changing the working directory calls for apr_stat_cache_clear().
+ */
+APR_DECLARE(apr_status_t) apr_stat_cache_stat(apr_stat_cache_t *sc,
+                                              apr_finfo_t *finfo,
+                                              const char *fname,
+                                              apr_int32_t wanted,
+                                              apr_pool_t *pool);
+
+/**
+ * Drop the cached information of a file
+ * @param sc The stat cache
+ * @param fname The name of the file
+ */
+APR_DECLARE(void) apr_stat_cache_invalidate(apr_stat_cache_t *sc,
+                                            const char *fname);
+
+/**
+ * Drop all the cached information
+ * @param sc The stat cache
+ */
+APR_DECLARE(void) apr_stat_cache_clear(apr_stat_cache_t *sc);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_STAT_CACHE_H */
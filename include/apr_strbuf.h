@@ -0,0 +1,218 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_STRBUF_H
+#define APR_STRBUF_H
+
+/**
+ * @file apr_strbuf.h
+ * @brief APR String buffers
+ *
+ * @remark A string buffer builds a string piece by piece in chunks of
+ * doubling sizes, such that appending never copies what was already
+ * appended, unlike repeated calls of apr_pstrcat() or apr_psprintf() on
+ * the growing string.  The pieces can be written out as they lie in the
+ * chunks (apr_strbuf_to_iovec() and apr_strbuf_to_brigade()), or joined
+ * once into a pool string (apr_strbuf_pflatten()).
+ *
+ * The chunks come either from a pool, where they stay until the pool is
+ * cleared, or from an allocator, to which apr_strbuf_destroy() gives them
+ * back, for buffers built and dropped often in a long lived pool.
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_allocator.h"
+#include "apr_errno.h"
+#include "apr_buckets.h"
+
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @defgroup apr_strbuf String buffers
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure used for the string buffer API */
+typedef struct apr_strbuf_t apr_strbuf_t;
+
+/**
+ * Create a string buffer whose chunks are allocated from a pool.
+ * @param p The pool to allocate the buffer and its chunks from.
+ * @param size The size of the first chunk, or zero for the default;
+ *        each next chunk is twice as large as the previous one.
+ * @return The new buffer.
+ */
+APR_DECLARE(apr_strbuf_t *) apr_strbuf_make(apr_pool_t *p, apr_size_t size)
+                            __attribute__((nonnull(1)));
+
+/**
+ * Create a string buffer whose chunks are allocated from an allocator.
+ * @param allocator The allocator to allocate the buffer and its chunks
+ *        from.
+ * @param size The size of the first chunk, or zero for the default.
+ * @return The new buffer, or NULL if the allocation failed.
+ * @remark The buffer must be given back with apr_strbuf_destroy().  Like
+ *         the allocator, it is not thread safe.
+ */
+APR_DECLARE(apr_strbuf_t *) apr_strbuf_create(apr_allocator_t *allocator,
+                                              apr_size_t size)
+                            __attribute__((nonnull(1)));
+
+/**
+ * Destroy a string buffer, giving its chunks back to the allocator it
+ * was created from with apr_strbuf_create().  Nothing is done for buffers
+ * made with apr_strbuf_make(), their memory lasting as long as the pool.
+ * @param sb The buffer to destroy.
+ */
+APR_DECLARE(void) apr_strbuf_destroy(apr_strbuf_t *sb)
+                  __attribute__((nonnull(1)));
+
+/**
+ * Empty a string buffer, keeping its chunks to be filled again.
+ * @param sb The buffer to empty.
+ */
+APR_DECLARE(void) apr_strbuf_clear(apr_strbuf_t *sb)
+                  __attribute__((nonnull(1)));
+
+/**
+ * Get the length of the string in a buffer.
+ * @param sb The buffer.
+ * @return The number of bytes appended since the buffer was created or
+ *         last cleared.
+ */
+APR_DECLARE(apr_size_t) apr_strbuf_length(const apr_strbuf_t *sb)
+                        __attribute__((nonnull(1)));
+
+/**
+ * Append bytes to a string buffer.
+ * @param sb The buffer.
+ * @param str The bytes to append, which may contain NULs.
+ * @param len The number of bytes.
+ * @return APR_ENOMEM if a chunk could not be allocated from the allocator,
+ *         in which case the bytes that fitted were appended.
+ */
+APR_DECLARE(apr_status_t) apr_strbuf_write(apr_strbuf_t *sb,
+                                           const char *str, apr_size_t len)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Append a string to a string buffer.
+ * @param sb The buffer.
+ * @param str The NUL terminated string to append.
+ * @return APR_ENOMEM if a chunk could not be allocated from the allocator.
+ */
+APR_DECLARE(apr_status_t) apr_strbuf_puts(apr_strbuf_t *sb, const char *str)
+                          __attribute__((nonnull(1,2)));
+
+/**
+ * Append a character to a string buffer.
+ * @param sb The buffer.
+ * @param c The character to append.
+ * @return APR_ENOMEM if a chunk could not be allocated from the allocator.
+ */
+APR_DECLARE(apr_status_t) apr_strbuf_putc(apr_strbuf_t *sb, const char c)
+                          __attribute__((nonnull(1)));
+
+/**
+ * Append strings to a string buffer.
+ * @param sb The buffer.
+ * @param ... The strings to append, followed by a NULL.
+ * @return APR_ENOMEM if a chunk could not be allocated from the allocator.
+ */
+APR_DECLARE_NONSTD(apr_status_t) apr_strbuf_putstrs(apr_strbuf_t *sb, ...)
+#if defined(__GNUC__) && __GNUC__ >= 4
+    __attribute__((sentinel))
+#endif
+    __attribute__((nonnull(1)))
+    ;
+
+/**
+ * Append a formatted string to a string buffer, as formatted by
+ * apr_vformatter() straight into the chunks.
+ * @param sb The buffer.
+ * @param fmt The format of the string.
+ * @param ... The arguments to use to fill out the format.
+ * @return APR_ENOMEM if a chunk could not be allocated from the allocator.
+ */
+APR_DECLARE_NONSTD(apr_status_t) apr_strbuf_printf(apr_strbuf_t *sb,
+                                                   const char *fmt, ...)
+    __attribute__((format(printf,2,3)))
+    __attribute__((nonnull(1,2)));
+
+/**
+ * Append a formatted string to a string buffer.
+ * @param sb The buffer.
+ * @param fmt The format of the string.
+ * @param va The arguments to use to fill out the format.
+ * @return APR_ENOMEM if a chunk could not be allocated from the allocator.
+ */
+APR_DECLARE(apr_status_t) apr_strbuf_vprintf(apr_strbuf_t *sb,
+                                             const char *fmt, va_list va)
+                          __attribute__((nonnull(1,2)));
+
+/**
+ * Describe the string in a buffer with an iovec of its chunks, without
+ * copying it.
+ * @param sb The buffer.
+ * @param vec The iovec to fill out.
+ * @param nvec The number of elements in the iovec. On return, it is the
+ *             number of iovec elements actually filled out.
+ * @return APR_INCOMPLETE if the string needs more iovec elements than
+ *         given, APR_SUCCESS otherwise.
+ * @remark The iovec is valid until the buffer is next appended to,
+ *         cleared or destroyed.
+ */
+APR_DECLARE(apr_status_t) apr_strbuf_to_iovec(const apr_strbuf_t *sb,
+                                              struct iovec *vec, int *nvec)
+                          __attribute__((nonnull(1,2,3)));
+
+/**
+ * Append the string in a buffer to a brigade, as a transient bucket for
+ * each chunk, without copying it.
+ * @param sb The buffer.
+ * @param bb The brigade to append to.
+ * @remark The buckets are valid until the buffer is next cleared or
+ *         destroyed; they must be set aside (see apr_bucket_setaside())
+ *         to outlive it.
+ */
+APR_DECLARE(void) apr_strbuf_to_brigade(const apr_strbuf_t *sb,
+                                        apr_bucket_brigade *bb)
+                  __attribute__((nonnull(1,2)));
+
+/**
+ * Copy the string in a buffer into a pool, in a single copy.
+ * @param sb The buffer.
+ * @param len If not NULL, set to the length of the string.
+ * @param p The pool to allocate the string from.
+ * @return The NUL terminated string.
+ */
+APR_DECLARE(char *) apr_strbuf_pflatten(const apr_strbuf_t *sb,
+                                        apr_size_t *len, apr_pool_t *p)
+                    __attribute__((nonnull(1,3)));
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_STRBUF_H */
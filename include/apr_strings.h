@@ -48,6 +48,7 @@
 #include "apr.h"
 #include "apr_errno.h"
 #include "apr_pools.h"
+#include "apr_lib.h"
 #define APR_WANT_IOVEC
 #include "apr_want.h"
 
@@ -300,6 +301,37 @@ APR_DECLARE_NONSTD(int) apr_snprintf(char *buf, apr_size_t len,
  */
 APR_DECLARE(int) apr_vsnprintf(char *buf, apr_size_t len, const char *format,
                                va_list ap);
+
+/**
+ * Compile a format of apr_vformatter() once, for apr_format_exec(),
+ * apr_format_vformatter() or apr_brigade_format() not to parse it again
+ * on each call.
+ * @param fmt The format string
+ * @param p The pool to allocate from
+ * @return The compiled format (a copy of fmt is made)
+ */
+APR_DECLARE(apr_format_t *) apr_format_compile(const char *fmt,
+                                               apr_pool_t *p);
+
+/**
+ * apr_snprintf() with a compiled format.
+ * @param buf The buffer to write to
+ * @param len The size of the buffer
+ * @param format The compiled format
+ * @param ... The arguments to use to fill out the format
+ */
+APR_DECLARE_NONSTD(int) apr_format_exec(char *buf, apr_size_t len,
+                                        const apr_format_t *format, ...);
+
+/**
+ * apr_vsnprintf() with a compiled format.
+ * @param buf The buffer to write to
+ * @param len The size of the buffer
+ * @param format The compiled format
+ * @param ap The arguments to use to fill out the format
+ */
+APR_DECLARE(int) apr_format_vexec(char *buf, apr_size_t len,
+                                  const apr_format_t *format, va_list ap);
 /** @} */
 
 /**
@@ -371,6 +403,38 @@ APR_DECLARE(apr_int64_t) apr_strtoi64(const char *buf, char **end, int base);
  */
 APR_DECLARE(apr_int64_t) apr_atoi64(const char *buf);
 
+/** The size of a buffer large enough for any apr_dtoa() result */
+#define APR_DTOA_SIZE 32
+
+/**
+ * Format a double as the shortest string that reads back as the same
+ * double, like "0.1", "800", "1.5e-7" or "1e21".
+ * @param buf The text buffer, of APR_DTOA_SIZE bytes at least
+ * @param num The number to format
+ * @return The length of the string, without the trailing null
+ * @remark The exponent form is used from 1e21 and below 1e-6, as in
+ * ECMAScript.  Infinities and NaNs are formatted as "inf", "-inf" and
+ * "nan".  The digits are the shortest ones but for rare cases, where
+ * one more digit is given.
+ */
+APR_DECLARE(apr_size_t) apr_dtoa(char *buf, double num);
+
+/**
+ * Parse a numeric string into a double, rounded correctly, as strtod()
+ * does in the "C" locale.
+ * @param buf The string to parse. It may contain optional whitespace,
+ *   followed by an optional '+' or '-' character, followed by decimal
+ *   digits with an optional fraction and exponent.
+ * @param end A pointer to the end of the valid character in buf. If
+ *   not NULL, it is set to the first invalid character in buf.
+ * @return The numeric value of the string.  On overflow, or underflow
+ * to zero, errno is set to ERANGE.  On success, errno is set to 0.
+ * @remark The hexadecimal, infinity and NaN forms, and the rare numbers
+ * whose rounding depends on more than nineteen significant digits, are
+ * passed to strtod().
+ */
+APR_DECLARE(double) apr_strtod_fast(const char *buf, char **end);
+
 /**
  * Format a binary size (magnitiudes are 2^10 rather than 10^3) from an apr_off_t,
  * as bytes, K, M, T, etc, to a four character compacted human readable string.
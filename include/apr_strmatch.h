@@ -73,6 +73,71 @@ APR_DECLARE(const char *) apr_strmatch(const apr_strmatch_pattern *pattern,
  */
 APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(apr_pool_t *p, const char *s, int case_sensitive);
 
+/**
+ * Precompiled set of search patterns
+ */
+typedef struct apr_strmatch_multi_t apr_strmatch_multi_t;
+
+/**
+ * Declaration prototype for the callback function of
+ * apr_strmatch_multi_scan()
+ * @param baton The data passed to apr_strmatch_multi_scan()
+ * @param index The index of the pattern found, in the array given to
+ *        apr_strmatch_multi_precompile()
+ * @param match The start of the pattern found within the string
+ * @remark The scan continues while this callback function returns non-zero.
+ */
+typedef int (apr_strmatch_multi_fn_t)(void *baton, int index,
+                                      const char *match);
+
+/**
+ * Precompile a set of patterns into an Aho-Corasick automaton, to search
+ * for all of them at once
+ * @param p The pool from which to allocate the automaton
+ * @param patterns The pattern strings
+ * @param npatterns The number of patterns
+ * @param case_sensitive Whether the matching should be case-sensitive
+ * @return a pointer to the compiled patterns, or NULL if a pattern is empty
+ *         or the automaton would be too big
+ * @remark The strings are searched at a constant cost per byte, whatever
+ *         the number of patterns.  Identical patterns are found under the
+ *         index of the first one.
+ */
+APR_DECLARE(const apr_strmatch_multi_t *) apr_strmatch_multi_precompile(
+        apr_pool_t *p, const char *const *patterns, int npatterns,
+        int case_sensitive);
+
+/**
+ * Search for the first instance of any of the precompiled patterns within
+ * a string
+ * @param multi The patterns
+ * @param s The string in which to search for the patterns
+ * @param slen The length of s (excluding null terminator)
+ * @param index If not NULL, set to the index of the pattern found
+ * @return A pointer to the instance of the pattern in s which ends first
+ *         (the longest pattern of those ending there), or NULL if none is
+ *         found
+ */
+APR_DECLARE(const char *) apr_strmatch_multi(
+        const apr_strmatch_multi_t *multi, const char *s, apr_size_t slen,
+        int *index);
+
+/**
+ * Search for all the instances of the precompiled patterns within a
+ * string, overlapping ones included
+ * @param multi The patterns
+ * @param s The string in which to search for the patterns
+ * @param slen The length of s (excluding null terminator)
+ * @param fn The function called for each instance, in the order of their
+ *        ends (the longest pattern first for those ending at the same place)
+ * @param baton The data to pass as the first argument to the function
+ * @return FALSE if one of the fn() calls returned zero; TRUE otherwise
+ */
+APR_DECLARE(int) apr_strmatch_multi_scan(const apr_strmatch_multi_t *multi,
+                                         const char *s, apr_size_t slen,
+                                         apr_strmatch_multi_fn_t *fn,
+                                         void *baton);
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -70,6 +70,9 @@ struct apr_array_header_t {
     int nalloc;
     /** The elements in the array */
     char *elts;
+    /** The allocator's node holding the elements of the arrays created
+     * with APR_ARRAY_ALLOCATOR, NULL otherwise */
+    struct apr_memnode_t *node;
 };
 
 /**
@@ -121,6 +124,52 @@ APR_DECLARE(int) apr_is_empty_array(const apr_array_header_t *a);
 APR_DECLARE(apr_array_header_t *) apr_array_make(apr_pool_t *p,
                                                  int nelts, int elt_size);
 
+/**
+ * Allocate the elements of the array from the pool's allocator, see
+ * apr_array_make_ex()
+ */
+#define APR_ARRAY_ALLOCATOR 0x01
+
+/**
+ * Create an array with the given flags.
+ * @param p The pool to allocate the memory out of
+ * @param nelts the number of elements in the initial array
+ * @param elt_size The size of each element in the array.
+ * @param flags Zero or APR_ARRAY_ALLOCATOR
+ * @return The new array
+ * @remark With APR_ARRAY_ALLOCATOR, the elements are allocated from the
+ *         allocator of the pool rather than the pool itself, so that the
+ *         previous storage is given back whenever the array grows (or on
+ *         apr_array_shrink_to_fit()), and the last one when the pool is
+ *         cleared or destroyed. This suits the arrays built incrementally
+ *         in long-lived pools, where the storage orphaned by the growth
+ *         would otherwise stay allocated.
+ * @remark Since the elements are moved on growth, apr_array_copy_hdr()
+ *         (hence apr_array_append()) of such an array copies the elements.
+ * @remark Pools without an allocator, as with APR_POOL_DEBUG, ignore the
+ *         flag.
+ */
+APR_DECLARE(apr_array_header_t *) apr_array_make_ex(apr_pool_t *p,
+                                                    int nelts, int elt_size,
+                                                    apr_uint32_t flags);
+
+/**
+ * Make sure an array can hold a number of elements without growing.
+ * @param arr The array
+ * @param nelts The number of elements the array should be able to hold
+ * @remark The new space is cleared, like when apr_array_push() grows the
+ *         array.
+ */
+APR_DECLARE(void) apr_array_reserve(apr_array_header_t *arr, int nelts);
+
+/**
+ * Reduce the storage of an array to the number of elements it holds.
+ * @param arr The array
+ * @remark Only the arrays created with APR_ARRAY_ALLOCATOR give memory
+ *         back, for other arrays (allocated from a pool) this is a noop.
+ */
+APR_DECLARE(void) apr_array_shrink_to_fit(apr_array_header_t *arr);
+
 /**
  * Add a new element to an array (as a first-in, last-out stack).
  * @param arr The array to add an element to.
@@ -130,6 +179,16 @@ APR_DECLARE(apr_array_header_t *) apr_array_make(apr_pool_t *p,
  */
 APR_DECLARE(void *) apr_array_push(apr_array_header_t *arr);
 
+/**
+ * Add a number of new elements to an array at once.
+ * @param arr The array to add the elements to.
+ * @param nelts The number of elements to add.
+ * @return Location for the first new element in the array.
+ * @remark If there are not enough free spots in the array, then this
+ *         function will allocate new space for all the new elements.
+ */
+APR_DECLARE(void *) apr_array_push_n(apr_array_header_t *arr, int nelts);
+
 /** A helper macro for accessing a member of an APR array.
  *
  * @param ary the array
@@ -222,6 +281,106 @@ APR_DECLARE(char *) apr_array_pstrcat(apr_pool_t *p,
 				      const apr_array_header_t *arr,
 				      const char sep);
 
+/**
+ * The comparison function of the array sorts and searches, like qsort()'s
+ * @param a The first element (the key for apr_array_bsearch())
+ * @param b The second element
+ * @return Negative, zero or positive if @a a sorts before, the same as or
+ *         after @a b
+ */
+typedef int (apr_array_compare_fn)(const void *a, const void *b);
+
+/**
+ * Sort the elements with a stable sort, see apr_array_sort()
+ */
+#define APR_ARRAY_SORT_STABLE 0x01
+
+/**
+ * Sort the elements of an array in place
+ * @param arr The array to sort
+ * @param compare The comparison function
+ * @param flags APR_ARRAY_SORT_STABLE, or zero
+ * @return APR_SUCCESS, or APR_ENOMEM if the buffer of the stable sort
+ *         could not be allocated
+ * @remark The sort is an introsort (a quicksort falling back to heapsort
+ *         when it goes quadratic), or with APR_ARRAY_SORT_STABLE a
+ *         mergesort whose buffer of the size of the array is allocated
+ *         temporarily with malloc().
+ */
+APR_DECLARE(apr_status_t) apr_array_sort(apr_array_header_t *arr,
+                                         apr_array_compare_fn *compare,
+                                         int flags);
+
+/**
+ * Search a sorted array for an element
+ * @param arr The array, sorted by @a compare
+ * @param key The key, passed as the first argument of @a compare
+ * @param compare The comparison function of the sort
+ * @param index If not NULL, receives the index of the first element not
+ *        before @a key, where it would be inserted if not found
+ * @return The first element equal to @a key, or NULL
+ */
+APR_DECLARE(void *) apr_array_bsearch(const apr_array_header_t *arr,
+                                      const void *key,
+                                      apr_array_compare_fn *compare,
+                                      int *index);
+
+/**
+ * Sort the elements of an array by a 64-bit unsigned integer key with a
+ * radix sort, in linear time
+ * @param arr The array to sort
+ * @param key_offset The offset of the (apr_uint64_t) key in the elements,
+ *        zero for an array of keys
+ * @return APR_SUCCESS, APR_EINVAL if the key is not within the elements,
+ *         or APR_ENOMEM if the buffer of the sort could not be allocated
+ * @remark The sort is stable.  It uses a buffer of the size of the array,
+ *         allocated temporarily with malloc(), and skips the bytes of the
+ *         keys which are the same in all of them (e.g. the upper ones of
+ *         small integers).
+ */
+APR_DECLARE(apr_status_t) apr_array_sort_u64(apr_array_header_t *arr,
+                                             apr_size_t key_offset);
+
+/**
+ * Sort the elements of an array by a string key with a radix sort (a
+ * multikey quicksort), in strcmp() order
+ * @param arr The array to sort
+ * @param key_offset The offset of the (const char *) key in the elements,
+ *        zero for an array of strings
+ * @return APR_SUCCESS, or APR_EINVAL if the key is not within the elements
+ * @remark The sort is not stable, but compares each character of the keys
+ *         about once rather than once per comparison, which is faster than
+ *         apr_array_sort() with strcmp() for keys sharing prefixes.
+ */
+APR_DECLARE(apr_status_t) apr_array_sort_str(apr_array_header_t *arr,
+                                             apr_size_t key_offset);
+
+#if APR_HAS_THREADS
+/** The thread pool, see apr_thread_pool.h */
+struct apr_thread_pool;
+
+/**
+ * Sort the elements of an array in place like apr_array_sort(), on the
+ * threads of a pool
+ * @param arr The array to sort
+ * @param compare The comparison function, called concurrently
+ * @param flags APR_ARRAY_SORT_STABLE, or zero
+ * @param tp The thread pool, or NULL to call apr_array_sort()
+ * @param p The pool for temporary allocations
+ * @return APR_SUCCESS, or APR_ENOMEM if the buffer of the sort could not
+ *         be allocated
+ * @remark The array is split in parts sorted concurrently, then merged in
+ *         pairs concurrently, with a buffer of the size of the array
+ *         allocated temporarily with malloc().  Small arrays are sorted by
+ *         the caller alone.
+ */
+APR_DECLARE(apr_status_t) apr_array_sort_parallel(apr_array_header_t *arr,
+                                                  apr_array_compare_fn *compare,
+                                                  int flags,
+                                                  struct apr_thread_pool *tp,
+                                                  apr_pool_t *p);
+#endif
+
 /**
  * Make a new table.
  * @param p The pool to allocate the pool out of
@@ -241,6 +400,22 @@ APR_DECLARE(apr_table_t *) apr_table_make(apr_pool_t *p, int nelts);
 APR_DECLARE(apr_table_t *) apr_table_copy(apr_pool_t *p,
                                           const apr_table_t *t);
 
+/**
+ * Create a copy of a table in O(1), sharing its entries until either
+ * table is modified.
+ * @param p The pool to allocate the new table out of
+ * @param t The table to copy
+ * @return A copy of the table passed in
+ * @remark The first modification of either table copies the entries,
+ *         like apr_table_copy() would have; the ones never modified,
+ *         like a configuration merged per request and only read, cost
+ *         nothing.
+ * @warning The table keys and respective values are not copied, and the
+ *          pool of @a t must live at least as long as @a p.
+ */
+APR_DECLARE(apr_table_t *) apr_table_snapshot(apr_pool_t *p,
+                                              const apr_table_t *t);
+
 /**
  * Create a new table whose contents are deep copied from the given
  * table. A deep copy operation copies all fields, and makes copies
@@ -360,6 +535,40 @@ APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
 APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
                                  const char *val);
 
+/** A key/value pair for apr_table_addn_bulk() */
+typedef struct apr_table_pair_t {
+    /** The key */
+    const char *key;
+    /** The value */
+    const char *val;
+} apr_table_pair_t;
+
+/**
+ * Defer the indexing of the added entries to the next use of the table,
+ * see apr_table_addn_bulk()
+ */
+#define APR_TABLE_BULK_LAZY 0x01
+
+/**
+ * Add many key/value pairs to a table at once, regardless of whether there
+ * are other elements with the same keys.
+ * @param t The table to add to
+ * @param pairs The pairs to add, in order
+ * @param npairs The number of pairs
+ * @param flags Zero or APR_TABLE_BULK_LAZY
+ * @remark Like apr_table_addn(), this function does not make a copy of the
+ *         keys or the values.
+ * @remark The table's storage is grown once for all the pairs and the
+ *         index is updated in a single pass, or with APR_TABLE_BULK_LAZY
+ *         by the first function using the table afterward (including the
+ *         read only ones like apr_table_get()). A lazily indexed table
+ *         thus must not be used concurrently by multiple threads before
+ *         then.
+ */
+APR_DECLARE(void) apr_table_addn_bulk(apr_table_t *t,
+                                      const apr_table_pair_t *pairs,
+                                      int npairs, unsigned int flags);
+
 /**
  * Merge two tables into one new table.
  * @param p The pool to use for the new table
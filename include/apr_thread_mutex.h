@@ -44,6 +44,7 @@ typedef struct apr_thread_mutex_t apr_thread_mutex_t;
 #define APR_THREAD_MUTEX_NESTED   0x1   /**< enable nested (recursive) locks */
 #define APR_THREAD_MUTEX_UNNESTED 0x2   /**< disable nested locks */
 #define APR_THREAD_MUTEX_TIMED    0x4   /**< enable timed locks */
+#define APR_THREAD_MUTEX_ADAPTIVE 0x8   /**< spin a while before sleeping */
 
 /* Delayed the include to avoid a circular reference */
 #include "apr_pools.h"
@@ -58,8 +59,15 @@ typedef struct apr_thread_mutex_t apr_thread_mutex_t;
  *           APR_THREAD_MUTEX_DEFAULT   platform-optimal lock behavior.
  *           APR_THREAD_MUTEX_NESTED    enable nested (recursive) locks.
  *           APR_THREAD_MUTEX_UNNESTED  disable nested locks (non-recursive).
+ *           APR_THREAD_MUTEX_TIMED     enable timed locks.
+ *           APR_THREAD_MUTEX_ADAPTIVE  spin a while before sleeping, for
+ *                                      short critical sections.
  * </PRE>
  * @param pool the pool from which to allocate the mutex.
+ * @remark With APR_THREAD_MUTEX_ADAPTIVE, a contended lock is retried for a
+ * number of spins adapted to how long the mutex was held lately before
+ * the thread is put to sleep, saving the system calls when the critical
+ * sections are short.  It is only a hint, ignored where not supported.
  * @warning Be cautious in using APR_THREAD_MUTEX_DEFAULT.  While this is the
  * most optimal mutex based on a given platform's performance characteristics,
  * it will behave as either a nested or an unnested lock.
@@ -106,6 +114,17 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_unlock(apr_thread_mutex_t *mutex);
  */
 APR_DECLARE(apr_status_t) apr_thread_mutex_destroy(apr_thread_mutex_t *mutex);
 
+/**
+ * Name a mutex, enabling its contention statistics.
+ * @param mutex the mutex to name.
+ * @param name the name, which must live as long as the mutex's pool.
+ * @remark The statistics are kept until the mutex's pool is cleared, see
+ *         apr_mutex_stats_dump().  Naming the mutex again only renames it.
+ * @remark This must not be called while another thread uses the mutex.
+ */
+APR_DECLARE(apr_status_t) apr_thread_mutex_name_set(apr_thread_mutex_t *mutex,
+                                                    const char *name);
+
 /**
  * Get the pool used by this thread_mutex.
  * @return apr_pool_t the pool
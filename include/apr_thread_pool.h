@@ -79,6 +79,146 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t **me,
                                                  apr_size_t max_threads,
                                                  apr_pool_t *pool);
 
+/** Opaque Thread Pool attributes structure. */
+typedef struct apr_thread_pool_attr_t apr_thread_pool_attr_t;
+
+/**
+ * The function called by each worker thread when it starts, before running
+ * any task.
+ * @param thd The worker thread
+ * @param index The creation index of the worker (0, 1, 2...)
+ * @param data The data given to apr_thread_pool_attr_worker_init_set()
+ */
+typedef void (*apr_thread_pool_worker_init_t)(apr_thread_t *thd,
+                                              apr_size_t index, void *data);
+
+/**
+ * @defgroup apr_thread_pool_flags Thread pool creation flags
+ * @{
+ */
+/** Give each worker thread its own queue of tasks, and let idle workers
+ * steal tasks from the busy ones.
+ * @see apr_thread_pool_create_ex()
+ */
+#define APR_THREAD_POOL_WORK_STEALING 0x01
+/** Record the histograms of apr_thread_pool_stats_get()
+ * @see apr_thread_pool_create_ex()
+ */
+#define APR_THREAD_POOL_STATS 0x02
+/** @} */
+
+/**
+ * @defgroup apr_thread_pool_affinity Thread pool affinity policies
+ * @{
+ */
+/** Workers can run on any CPU */
+#define APR_THREAD_POOL_AFFINITY_NONE     0
+/** Worker N is pinned to the (N modulo ncpus)th CPU, packing consecutive
+ * workers on neighbouring CPUs */
+#define APR_THREAD_POOL_AFFINITY_COMPACT  1
+/** Workers are pinned to CPUs spread evenly over the CPU set, according
+ * to the maximum number of threads */
+#define APR_THREAD_POOL_AFFINITY_SCATTER  2
+/** Every worker can run on any CPU of the set */
+#define APR_THREAD_POOL_AFFINITY_EXPLICIT 3
+/** @} */
+
+/**
+ * Create the attributes of a thread pool, see apr_thread_pool_create_ex()
+ * @param attr The newly created attributes
+ * @param pool The pool to allocate from
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_create(
+                                            apr_thread_pool_attr_t **attr,
+                                            apr_pool_t *pool);
+
+/**
+ * Set the creation flags of the thread pool
+ * @param attr The thread pool attributes
+ * @param flags A bitmask of APR_THREAD_POOL_* flags, or zero
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_flags_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            apr_uint32_t flags);
+
+/**
+ * Set the attributes the worker threads are created with (e.g. their
+ * stack size)
+ * @param attr The thread pool attributes
+ * @param thdattr The thread attributes, which must live as long as the
+ *        thread pool, or NULL for the defaults
+ * @remark With an affinity policy, @a thdattr is modified accordingly
+ *         before each worker is created.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_threadattr_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            apr_threadattr_t *thdattr);
+
+/**
+ * Set the function called by each worker thread when it starts
+ * @param attr The thread pool attributes
+ * @param func The function, or NULL for none
+ * @param data The data passed to @a func
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_worker_init_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            apr_thread_pool_worker_init_t func,
+                                            void *data);
+
+/**
+ * Name the worker threads "<name>-<index>", if supported by the system
+ * @param attr The thread pool attributes
+ * @param name The name prefix, or NULL to not name the threads
+ * @see apr_thread_name_set()
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_name_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            const char *name);
+
+/**
+ * Set the CPU affinity policy of the worker threads
+ * @param attr The thread pool attributes
+ * @param policy One of the APR_THREAD_POOL_AFFINITY_* policies
+ * @param cpus The CPU numbers to use, or NULL for the CPUs 0 to ncpus - 1
+ *        (not with APR_THREAD_POOL_AFFINITY_EXPLICIT)
+ * @param ncpus The number of CPUs to use
+ * @return APR_SUCCESS, or APR_EINVAL if the arguments don't fit the policy
+ * @remark apr_thread_pool_create_ex() fails with APR_ENOTIMPL if thread
+ *         affinity is not supported on this platform.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_affinity_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            int policy,
+                                            const int *cpus, int ncpus);
+
+/**
+ * Create a thread pool with the given attributes
+ * @param me The pointer in which to return the newly created apr_thread_pool
+ * object, or NULL if thread pool creation fails.
+ * @param init_threads The number of threads to be created initially, this number
+ * will also be used as the initial value for the maximum number of idle threads.
+ * @param max_threads The maximum number of threads that can be created
+ * @param attr The attributes created by apr_thread_pool_attr_create(), or
+ * NULL for the defaults
+ * @param pool The pool to use
+ * @return APR_SUCCESS if the thread pool was created successfully, APR_ENOTIMPL
+ * if one of the attributes is not supported on this platform. Otherwise, the
+ * error code.
+ * @remark With APR_THREAD_POOL_WORK_STEALING, the tasks pushed by a task
+ * (i.e. from one of the pool's threads) go to that thread's own queue, which
+ * it serves first without taking the pool's lock. The tasks pushed from other
+ * threads and the scheduled tasks still go to the pool's queue, which the
+ * threads look at when their own queue is empty (and regularly otherwise),
+ * before stealing from the queue of a random busy thread. Priorities are
+ * preserved within each queue but not across queues, while
+ * apr_thread_pool_tasks_cancel() works for all the queues.
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_create_ex(apr_thread_pool_t **me,
+                                                    apr_size_t init_threads,
+                                                    apr_size_t max_threads,
+                                             const apr_thread_pool_attr_t *attr,
+                                                    apr_pool_t *pool);
+
 /**
  * Destroy the thread pool and stop all the threads
  * @return APR_SUCCESS if all threads are stopped.
@@ -218,6 +358,89 @@ APR_DECLARE(apr_size_t)
 APR_DECLARE(apr_size_t)
     apr_thread_pool_threads_idle_timeout_count(apr_thread_pool_t * me);
 
+/** Number of buckets of an apr_thread_pool_histogram_t */
+#define APR_THREAD_POOL_HISTOGRAM_BUCKETS 128
+
+/**
+ * Log-linear histogram of values (microseconds or number of tasks): the
+ * values 0 to 3 have their own bucket, then each power of two range is
+ * split in 4 buckets, so the bucket of a value is known within 25%.
+ * Values above 2^33 are accounted in the last bucket.
+ */
+typedef struct apr_thread_pool_histogram_t {
+    /** Number of values recorded */
+    apr_uint64_t count;
+    /** Sum of the values recorded */
+    apr_uint64_t sum;
+    /** Highest value recorded */
+    apr_uint64_t max;
+    /** Number of values recorded per bucket */
+    apr_uint64_t buckets[APR_THREAD_POOL_HISTOGRAM_BUCKETS];
+} apr_thread_pool_histogram_t;
+
+/** Number of priority bands of apr_thread_pool_stats_t, a task of priority
+ * P being accounted in the band P / 64 */
+#define APR_THREAD_POOL_PRIORITY_BANDS 4
+
+/** Thread pool statistics, see apr_thread_pool_stats_get() */
+typedef struct apr_thread_pool_stats_t {
+    /** Number of tasks waiting to run */
+    apr_size_t tasks;
+    /** Number of scheduled tasks waiting for their time */
+    apr_size_t scheduled_tasks;
+    /** Number of threads */
+    apr_size_t threads;
+    /** Number of busy threads */
+    apr_size_t busy;
+    /** Number of idle threads */
+    apr_size_t idle;
+    /** Number of tasks that have run */
+    apr_size_t tasks_run;
+    /** High water mark of tasks */
+    apr_size_t tasks_high;
+    /** High water mark of threads */
+    apr_size_t threads_high;
+    /** Number of idle threads that timed out */
+    apr_size_t idle_timeouts;
+    /** Time from push to start of the tasks, per priority band
+     * (with APR_THREAD_POOL_STATS only) */
+    apr_thread_pool_histogram_t wait[APR_THREAD_POOL_PRIORITY_BANDS];
+    /** Run time of the tasks, per priority band
+     * (with APR_THREAD_POOL_STATS only) */
+    apr_thread_pool_histogram_t run[APR_THREAD_POOL_PRIORITY_BANDS];
+    /** Time from due time to start of the scheduled tasks
+     * (with APR_THREAD_POOL_STATS only) */
+    apr_thread_pool_histogram_t scheduled_wait;
+    /** Run time of the scheduled tasks
+     * (with APR_THREAD_POOL_STATS only) */
+    apr_thread_pool_histogram_t scheduled_run;
+    /** Number of tasks already queued when a task is pushed, in the pool's
+     * queue or the worker's own queue (with APR_THREAD_POOL_STATS only) */
+    apr_thread_pool_histogram_t queue_depth;
+} apr_thread_pool_stats_t;
+
+/**
+ * Get the statistics of the thread pool
+ * @param me The thread pool
+ * @param stats The statistics to fill in
+ * @remark The histograms are recorded with atomic operations and read
+ *         while tasks run, so they may be slightly inconsistent with each
+ *         other (e.g. count vs buckets).
+ */
+APR_DECLARE(apr_status_t) apr_thread_pool_stats_get(apr_thread_pool_t *me,
+                                            apr_thread_pool_stats_t *stats);
+
+/**
+ * Get the value at the given percentile of a histogram
+ * @param hist The histogram
+ * @param percentile The percentile, from 0.0 to 100.0
+ * @return The highest value of the bucket holding the percentile (bounded
+ *         by the max value), or zero if the histogram is empty
+ */
+APR_DECLARE(apr_uint64_t) apr_thread_pool_histogram_value_at(
+                                    const apr_thread_pool_histogram_t *hist,
+                                    double percentile);
+
 /**
  * Access function for the maximum number of idle threads
  * @param me The thread pool
@@ -289,6 +512,100 @@ APR_DECLARE(apr_size_t) apr_thread_pool_threshold_get(apr_thread_pool_t * me);
 APR_DECLARE(apr_status_t) apr_thread_pool_task_owner_get(apr_thread_t *thd,
                                                          void **owner);
 
+/**
+ * @defgroup APR_Util_TP_Group Task groups and parallel loops
+ * @{
+ */
+
+/** Opaque task group structure. */
+typedef struct apr_task_group_t apr_task_group_t;
+
+/**
+ * The function of a task of a group
+ * @param baton The baton given to apr_task_group_spawn()
+ * @return APR_SUCCESS, or an error which apr_task_group_wait() returns
+ */
+typedef apr_status_t (apr_task_group_fn_t)(void *baton);
+
+/**
+ * The function running a range of an apr_parallel_for() loop
+ * @param begin The first index of the range
+ * @param end The index past the last one of the range
+ * @param baton The baton given to apr_parallel_for()
+ * @return APR_SUCCESS, or an error which stops the loop
+ */
+typedef apr_status_t (apr_parallel_for_fn_t)(apr_size_t begin,
+                                             apr_size_t end, void *baton);
+
+/**
+ * Create a group of tasks, run by a thread pool and waited for together
+ * @param group The newly created group
+ * @param tp The thread pool running the tasks
+ * @param p The pool to allocate the group from
+ * @remark The group is the owner of its tasks in the thread pool, which
+ *         must not be cancelled with apr_thread_pool_tasks_cancel().
+ */
+APR_DECLARE(apr_status_t) apr_task_group_create(apr_task_group_t **group,
+                                                apr_thread_pool_t *tp,
+                                                apr_pool_t *p);
+
+/**
+ * Run a task in the group
+ * @param group The group
+ * @param func The task function
+ * @param baton The parameter for the task function
+ * @return APR_SUCCESS, APR_INCOMPLETE if the group is cancelled, or the
+ *         error of apr_thread_pool_push()
+ * @remark The tasks of the group may spawn more tasks in it; otherwise
+ *         only the thread calling apr_task_group_wait() should.
+ */
+APR_DECLARE(apr_status_t) apr_task_group_spawn(apr_task_group_t *group,
+                                               apr_task_group_fn_t *func,
+                                               void *baton);
+
+/**
+ * Wait for all the tasks of the group, running the queued ones meanwhile
+ * in the calling thread
+ * @param group The group
+ * @return The first error of a task, else APR_INCOMPLETE if the group was
+ *         cancelled, else APR_SUCCESS
+ * @remark Since the waiting thread runs the tasks which no worker has
+ *         started, a task may wait for a group of its own without starving
+ *         the thread pool.  The group can be reused afterwards.
+ */
+APR_DECLARE(apr_status_t) apr_task_group_wait(apr_task_group_t *group);
+
+/**
+ * Cancel the group: its tasks not started yet will not run, nor will the
+ * ones spawned from now on until apr_task_group_wait() returns
+ * @param group The group
+ */
+APR_DECLARE(apr_status_t) apr_task_group_cancel(apr_task_group_t *group);
+
+/**
+ * Run a loop in parallel, splitting the range of indexes in halves for
+ * the workers of a thread pool and the calling thread, down to a grain
+ * @param tp The thread pool
+ * @param begin The first index
+ * @param end The index past the last one
+ * @param grain The size of the ranges not split anymore, or zero for
+ *        about eight ranges per thread of the pool
+ * @param func The function running a range
+ * @param baton The parameter for the function
+ * @param p The pool for temporary allocations
+ * @return The first error of @a func, which stops the ranges not started,
+ *         or APR_SUCCESS
+ * @remark The ranges split by a worker are pushed to its own queue with
+ *         APR_THREAD_POOL_WORK_STEALING, the idle workers stealing them.
+ */
+APR_DECLARE(apr_status_t) apr_parallel_for(apr_thread_pool_t *tp,
+                                           apr_size_t begin, apr_size_t end,
+                                           apr_size_t grain,
+                                           apr_parallel_for_fn_t *func,
+                                           void *baton, apr_pool_t *p);
+
+/** @} */
+
 /** @} */
 
 #ifdef __cplusplus
@@ -286,6 +286,52 @@ APR_DECLARE(apr_status_t) apr_threadattr_guardsize_set(apr_threadattr_t *attr,
 APR_DECLARE(apr_status_t) apr_threadattr_max_free_set(apr_threadattr_t *attr, 
                                                       apr_size_t size);
 
+/**
+ * Keep the pools of the threads created with this threadattr for reuse
+ * once they exit, so that new threads do not have to create a pool and
+ * allocator (and allocate its first memory blocks) from scratch.
+ * @param attr The threadattr to affect
+ * @param max The maximum number of pools kept (for exited threads not
+ *        yet replaced), or zero to stop caching
+ * @return APR_SUCCESS, or APR_ENOTIMPL if not supported on this platform.
+ * @remark The pool of a thread is cleared before reuse, thus its cleanups
+ *         and subpools go as usual, but the memory kept by its allocator
+ *         (see apr_threadattr_max_free_set()) is not given back to the
+ *         system until the threadattr's pool is cleared or destroyed.
+ * @remark The threads' stacks are not managed by APR and usually cached
+ *         by the system's thread library already (e.g. glibc reuses the
+ *         stacks of exited threads of the same stack size).
+ */
+APR_DECLARE(apr_status_t) apr_threadattr_cache_set(apr_threadattr_t *attr,
+                                                   apr_size_t max);
+
+/**
+ * Set the CPUs newly created threads are allowed to run on.
+ * @param attr The threadattr to affect
+ * @param cpus The array of CPU numbers
+ * @param ncpus The number of elements in @a cpus, or zero to allow all
+ *        the CPUs again
+ * @return APR_SUCCESS, APR_EINVAL if one of the @a cpus is out of range,
+ *         or APR_ENOTIMPL if thread affinity is not supported on this
+ *         platform.
+ */
+APR_DECLARE(apr_status_t) apr_threadattr_affinity_set(apr_threadattr_t *attr,
+                                                      const int *cpus,
+                                                      int ncpus);
+
+/**
+ * Set the name of a thread, as shown by debuggers and system tools.
+ * @param name The name, possibly truncated to the length supported by the
+ *        system (15 characters on Linux) keeping its end
+ * @param thread The thread, or NULL for the current thread
+ * @param pool The pool to use for temporary allocations, if needed
+ * @return APR_SUCCESS, or APR_ENOTIMPL if naming threads is not supported
+ *         on this platform.
+ */
+APR_DECLARE(apr_status_t) apr_thread_name_set(const char *name,
+                                              apr_thread_t *thread,
+                                              apr_pool_t *pool);
+
 /**
  * Create a new thread of execution
  * @param new_thread The newly created thread handle.
@@ -405,6 +451,8 @@ APR_DECLARE(apr_status_t) apr_threadkey_private_create(apr_threadkey_t **key,
  * Get a pointer to the thread private memory
  * @param new_mem The data stored in private memory 
  * @param key The handle for the desired thread private memory 
+ * @remark With compiler thread local storage, this is a plain load from a
+ * per thread cache for the first 32 keys created (and not deleted).
  */
 APR_DECLARE(apr_status_t) apr_threadkey_private_get(void **new_mem, 
                                                  apr_threadkey_t *key);
@@ -607,6 +655,27 @@ APR_DECLARE(apr_status_t) apr_procattr_child_errfn_set(apr_procattr_t *attr,
 APR_DECLARE(apr_status_t) apr_procattr_error_check_set(apr_procattr_t *attr,
                                                        apr_int32_t chk);
 
+/**
+ * Determine whether apr_proc_create() may start the child with posix_spawn()
+ * rather than fork() and exec().
+ * @param attr The procattr describing the child process to be created.
+ * @param spawn Non-zero to let posix_spawn() be used where the procattr
+ *              allows it (the default), zero to always fork().
+ * @remark Spawning spares a large parent the copy of its page tables made
+ *         by fork().  It is only used when the child needs no resource
+ *         limits, no detaching and (when running as root) no change of
+ *         user, group or permissions, nor a change of directory without
+ *         posix_spawn_file_actions_addchdir().  A spawned child does not
+ *         run the child cleanups of the pools: descriptors opened by APR
+ *         are closed on exec anyway, but an application relying on child
+ *         cleanups of its own must disable spawning.  Spawn failures,
+ *         including exec() failures with most C libraries, are returned
+ *         by apr_proc_create() and the child error function is not called.
+ *         This flag only affects platforms where fork() is used.
+ */
+APR_DECLARE(apr_status_t) apr_procattr_spawn_set(apr_procattr_t *attr,
+                                                 apr_int32_t spawn);
+
 /**
  * Determine if the child should start in its own address space or using the 
  * current one from its parent
@@ -715,6 +784,23 @@ APR_DECLARE(apr_status_t) apr_proc_wait(apr_proc_t *proc,
                                         int *exitcode, apr_exit_why_e *exitwhy,
                                         apr_wait_how_e waithow);
 
+/**
+ * Get a file which polls readable once a child process has terminated.
+ * @param file The resulting file, to be added to an apr_pollset_t or
+ *             apr_pollcb_t as an #APR_POLL_FILE for #APR_POLLIN
+ * @param proc The child process, which must not have been waited for yet
+ * @param pool The pool to allocate the file from, whose cleanup closes it
+ * @return APR_SUCCESS, or APR_ENOTIMPL where the platform has neither
+ *         pidfd_open() nor kqueue's EVFILT_PROC.
+ * @remark The file only signals the termination: the child must still be
+ *         reaped with apr_proc_wait() (or apr_proc_other_child_refresh_proc()
+ *         for an other child), which then returns immediately.  Nothing
+ *         should be read from the file.
+ */
+APR_DECLARE(apr_status_t) apr_proc_exit_file_get(apr_file_t **file,
+                                                 apr_proc_t *proc,
+                                                 apr_pool_t *pool);
+
 /**
  * Wait for any current child process to die and return information 
  * about that child.
@@ -830,6 +916,20 @@ APR_DECLARE(void) apr_proc_other_child_refresh(apr_other_child_rec_t *ocr,
  */
 APR_DECLARE(void) apr_proc_other_child_refresh_all(int reason);
 
+/**
+ * Test the registered other child process of a process handle, as
+ * apr_proc_other_child_refresh() does.
+ * @param proc The process to check, typically one whose file returned by
+ *             apr_proc_exit_file_get() has polled readable
+ * @param reason The reason code (e.g. APR_OC_REASON_RESTART) if still running
+ * @return APR_SUCCESS, or APR_EPROC_UNKNOWN if @a proc is not a registered
+ *         other child
+ * @remark Watching the exit files of the other children saves the periodic
+ *         scans of apr_proc_other_child_refresh_all().
+ */
+APR_DECLARE(apr_status_t) apr_proc_other_child_refresh_proc(apr_proc_t *proc,
+                                                            int reason);
+
 /** 
  * Terminate a process.
  * @param proc The process to terminate.
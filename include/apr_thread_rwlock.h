@@ -41,6 +41,9 @@ extern "C" {
 /** Opaque read-write thread-safe lock. */
 typedef struct apr_thread_rwlock_t apr_thread_rwlock_t;
 
+#define APR_THREAD_RWLOCK_DEFAULT  0x0  /**< platform-optimal lock behavior */
+#define APR_THREAD_RWLOCK_SCALABLE 0x1  /**< readers do not share a counter */
+
 /**
  * Note: The following operations have undefined results: unlocking a
  * read-write lock which is not locked in the calling thread; write
@@ -59,6 +62,32 @@ typedef struct apr_thread_rwlock_t apr_thread_rwlock_t;
  */
 APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
                                                    apr_pool_t *pool);
+
+/**
+ * Create and initialize a read-write lock that can be used to synchronize
+ * threads, with flags.
+ * @param rwlock the memory address where the newly created readwrite lock
+ *        will be stored.
+ * @param flags Or'ed value of:
+ * <PRE>
+ *           APR_THREAD_RWLOCK_DEFAULT   platform-optimal lock behavior.
+ *           APR_THREAD_RWLOCK_SCALABLE  for read-mostly data, see below.
+ * </PRE>
+ * @param pool the pool from which to allocate the mutex.
+ * @remark With APR_THREAD_RWLOCK_SCALABLE, the readers are counted in
+ * slots spread over cache lines, the threads using different slots, such
+ * that concurrent readers do not contend on the cache line of a shared
+ * counter. The writers are serialized, and wait for all the slots to
+ * drain (readers arriving meanwhile wait for them), so writing is more
+ * expensive than with the default lock and can starve the readers.  It
+ * is only a hint, ignored where not supported (or without thread local
+ * storage). A thread may take a read lock again while holding it, as
+ * with the default lock, provided it holds no more than 8 such locks at
+ * once (the others would deadlock if a writer was waiting).
+ */
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool);
 /**
  * Acquire a shared-read lock on the given read-write lock. This will allow
  * multiple threads to enter the same critical section while they have acquired
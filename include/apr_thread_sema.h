@@ -0,0 +1,118 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APR_THREAD_SEMA_H
+#define APR_THREAD_SEMA_H
+
+/**
+ * @file apr_thread_sema.h
+ * @brief APR Thread Semaphore Routines
+ */
+
+#include "apr.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#if APR_HAS_THREADS || defined(DOXYGEN)
+
+/**
+ * @defgroup apr_thread_sema Thread Semaphore Routines
+ * @ingroup APR
+ * @{
+ */
+
+/** Opaque structure for thread semaphores */
+typedef struct apr_thread_sema_t apr_thread_sema_t;
+
+/**
+ * Note: destroying a semaphore (or likewise, destroying or clearing the
+ * pool from which a semaphore was allocated) if any threads are blocked
+ * waiting on it gives undefined results.
+ */
+
+/**
+ * Create and initialize a counting semaphore that can be used to hand off
+ * work to waiting threads in a single process, with no mutex associated.
+ * @param sema the memory address where the newly created semaphore will be
+ *        stored.
+ * @param value the initial count of the semaphore.
+ * @param pool the pool from which to allocate the semaphore.
+ * @remark Posting costs a single atomic operation when no thread waits,
+ *         and waiting spins a while before sleeping.
+ */
+APR_DECLARE(apr_status_t) apr_thread_sema_create(apr_thread_sema_t **sema,
+                                                 apr_uint32_t value,
+                                                 apr_pool_t *pool);
+
+/**
+ * Decrement the count of the semaphore, putting the active calling thread
+ * to sleep until it is positive.
+ * @param sema the semaphore on which to block.
+ */
+APR_DECLARE(apr_status_t) apr_thread_sema_wait(apr_thread_sema_t *sema);
+
+/**
+ * Decrement the count of the semaphore, if positive.
+ * @param sema the semaphore.
+ * @return APR_EBUSY if the count is zero.
+ */
+APR_DECLARE(apr_status_t) apr_thread_sema_trywait(apr_thread_sema_t *sema);
+
+/**
+ * Decrement the count of the semaphore, putting the active calling thread
+ * to sleep until it is positive or the timeout is reached.
+ * @param sema the semaphore on which to block.
+ * @param timeout The amount of time in microseconds to wait. This is
+ *        a maximum, not a minimum. If the semaphore is posted, we
+ *        will wake up before this time, otherwise the error APR_TIMEUP
+ *        is returned.
+ */
+APR_DECLARE(apr_status_t) apr_thread_sema_timedwait(apr_thread_sema_t *sema,
+                                                    apr_interval_time_t timeout);
+
+/**
+ * Increment the count of the semaphore, waking up a single thread if one
+ * is blocking on it.
+ * @param sema the semaphore to post.
+ */
+APR_DECLARE(apr_status_t) apr_thread_sema_post(apr_thread_sema_t *sema);
+
+/**
+ * Destroy the semaphore and free the associated memory.
+ * @param sema the semaphore to destroy.
+ */
+APR_DECLARE(apr_status_t) apr_thread_sema_destroy(apr_thread_sema_t *sema);
+
+/**
+ * Get the pool used by this thread_sema.
+ * @return apr_pool_t the pool
+ */
+APR_POOL_DECLARE_ACCESSOR(thread_sema);
+
+/** @} */
+
+#endif /* APR_HAS_THREADS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ! APR_THREAD_SEMA_H */
@@ -86,6 +86,39 @@ typedef apr_int32_t apr_short_interval_time_t;
  */
 APR_DECLARE(apr_time_t) apr_time_now(void);
 
+/**
+ * @return the current time, as apr_time_now() but at the resolution of
+ *         the system clock's tick (a few milliseconds) where this is
+ *         cheaper to read, as CLOCK_REALTIME_COARSE on Linux
+ */
+APR_DECLARE(apr_time_t) apr_time_now_coarse(void);
+
+/**
+ * @return the time elapsed since an arbitrary point in the past, which
+ *         unlike apr_time_now() neither goes back nor jumps when the
+ *         system time is changed, for measuring intervals and timeouts
+ * @remark Platforms without a monotonic clock fall back to apr_time_now().
+ */
+APR_DECLARE(apr_interval_time_t) apr_time_monotonic(void);
+
+/**
+ * Read the cycle counter of the processor (the TSC on x86, the virtual
+ * counter on AArch64, the performance counter on Windows), or else a
+ * monotonic clock in nanoseconds, for profiling.
+ * @return the number of cycles since an arbitrary point in the past
+ * @remark The counters of the CPUs of older systems may be neither
+ *         synchronized nor ticking at a constant rate, timeouts should
+ *         use apr_time_monotonic().
+ */
+APR_DECLARE(apr_uint64_t) apr_time_cycles(void);
+
+/**
+ * @return the rate of apr_time_cycles() per second, calibrated against
+ *         apr_time_monotonic() on the first call (sleeping 10ms) where the
+ *         processor does not tell it
+ */
+APR_DECLARE(apr_uint64_t) apr_time_cycles_per_sec(void);
+
 /** @see apr_time_exp_t */
 typedef struct apr_time_exp_t apr_time_exp_t;
 
@@ -157,6 +190,30 @@ APR_DECLARE(apr_status_t) apr_time_exp_gmt(apr_time_exp_t *result,
 APR_DECLARE(apr_status_t) apr_time_exp_lt(apr_time_exp_t *result, 
                                           apr_time_t input);
 
+/**
+ * Convert times to their human readable components in the local timezone,
+ * as apr_time_exp_lt() does for each of them.
+ * @param results the exploded times
+ * @param inputs the times to explode
+ * @param n the number of times
+ * @remark The timezone is looked up once for all the times in the same
+ *         span between daylight saving changes, so sorted times (as read
+ *         from logs) are exploded the fastest.
+ */
+APR_DECLARE(apr_status_t) apr_time_exp_lt_n(apr_time_exp_t *results,
+                                            const apr_time_t *inputs,
+                                            apr_size_t n);
+
+/**
+ * Forget the local timezone known by apr_time_exp_lt(), for it to be
+ * read again from the system, after the TZ environment variable or the
+ * system timezone changed.
+ * @remark The span between daylight saving changes of the last exploded
+ *         time is cached, so that apr_time_exp_lt() mostly runs without
+ *         asking the system.
+ */
+APR_DECLARE(void) apr_time_zone_refresh(void);
+
 /**
  * Convert time value from human readable format to a numeric apr_time_t
  * (elapsed microseconds since the epoch).
@@ -0,0 +1,106 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * @file apr_utf8.h
+ * @brief APR-UTIL UTF-8 validation and UTF-16 transcoding
+ */
+#ifndef APR_UTF8_H
+#define APR_UTF8_H
+#include "apu.h"
+#include "apr_general.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup APR_Util_UTF8 UTF-8 functions
+ * @ingroup APR
+ * @{
+ */
+
+/*
+ * UTF-8 is as per RFC 3629: the shortest form only, no surrogates, and
+ * nothing beyond U+10FFFF.  UTF-16 is in words of the native byte order,
+ * without a byte order mark.
+ *
+ * The whole blocks of the input are validated, and the ASCII runs copied,
+ * with SSSE3 or AVX2 on x86 as the CPU has them, and NEON on ARM.
+ */
+
+/**
+ * When passing a string to apr_utf8_validate(), this value can be passed
+ * to indicate a NUL terminated string, and have the length computed
+ * automatically.
+ */
+#define APR_UTF8_STRING      (-1)
+
+/**
+ * Validate UTF-8 text.
+ * @param src The text
+ * @param slen The length of the text, or APR_UTF8_STRING if NUL terminated
+ * @param len If not NULL, the length of the well formed text leading
+ *  @a src, that is where the invalid or incomplete character starts
+ * @return APR_SUCCESS if the text is well formed, APR_INCOMPLETE if it
+ *  ends in the middle of a character, APR_EINVAL if it holds an invalid
+ *  sequence or if @a slen is negative and not APR_UTF8_STRING.
+ */
+APR_DECLARE(apr_status_t) apr_utf8_validate(const char *src,
+                                            apr_ssize_t slen,
+                                            apr_size_t *len);
+
+/**
+ * Convert UTF-8 text to UTF-16.
+ * @param in The text to convert
+ * @param inbytes Input: the length of @a in;
+ *  output: the length of @a in not converted
+ * @param out The buffer to convert to
+ * @param outwords Input: the number of words available in @a out;
+ *  output: the number of words of @a out not used
+ * @return APR_SUCCESS when all of @a in is converted or @a out is full,
+ *  APR_INCOMPLETE if @a in ends in the middle of a character, or
+ *  APR_EINVAL if it holds an invalid sequence, where the conversion
+ *  stopped.
+ * @remark At most one word is needed per byte of @a in.
+ */
+APR_DECLARE(apr_status_t) apr_utf8_to_utf16(const char *in,
+                                            apr_size_t *inbytes,
+                                            apr_uint16_t *out,
+                                            apr_size_t *outwords);
+
+/**
+ * Convert UTF-16 text to UTF-8.
+ * @param in The text to convert
+ * @param inwords Input: the number of words of @a in;
+ *  output: the number of words of @a in not converted
+ * @param out The buffer to convert to
+ * @param outbytes Input: the size of @a out;
+ *  output: the size of @a out not used
+ * @return APR_SUCCESS when all of @a in is converted or @a out is full,
+ *  APR_INCOMPLETE if @a in ends with a high surrogate, or APR_EINVAL
+ *  if it holds an unpaired surrogate, where the conversion stopped.
+ * @remark At most three bytes are needed per word of @a in.
+ */
+APR_DECLARE(apr_status_t) apr_utf16_to_utf8(const apr_uint16_t *in,
+                                            apr_size_t *inwords,
+                                            char *out,
+                                            apr_size_t *outbytes);
+
+/** @} */
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_UTF8_H */
@@ -52,6 +52,27 @@ typedef struct {
  */ 
 APR_DECLARE(void) apr_uuid_get(apr_uuid_t *uuid);
 
+/**
+ * Generate a random (version 4) UUID
+ * @param uuid The resulting UUID
+ * @return APR_SUCCESS, or APR_ENOTIMPL if no random source is available
+ * @remark The random bits come from the CPRNG of the calling thread when
+ *         apr_crypto_prng_init() was called with APR_CRYPTO_PRNG_PER_THREAD,
+ *         with no lock nor system call, or from the system otherwise.
+ */
+APR_DECLARE(apr_status_t) apr_uuid_get_v4(apr_uuid_t *uuid);
+
+/**
+ * Generate a time-ordered (version 7) UUID, as of RFC 9562
+ * @param uuid The resulting UUID
+ * @return APR_SUCCESS, or APR_ENOTIMPL if no random source is available
+ * @remark The UUID starts with the unix time in milliseconds, then a 1/4096
+ *         fraction of it, so that the UUIDs sort in their order of creation
+ *         (which makes friendlier database keys), strictly within a thread,
+ *         followed by 62 random bits taken as by apr_uuid_get_v4().
+ */
+APR_DECLARE(apr_status_t) apr_uuid_get_v7(apr_uuid_t *uuid);
+
 /**
  * Format a UUID into a string, following the standard format
  * @param buffer The buffer to place the formatted UUID string into. It must
@@ -59,6 +59,11 @@ typedef struct apr_xlate_t            apr_xlate_t;
  *  names to indicate the charset of the current locale.
  *
  * @remark
+ *  Conversions between UTF-8, ISO-8859-1 (Latin-1), UTF-16LE and
+ *  UTF-16BE are made by APR itself rather than by iconv, as are the
+ *  single-byte conversions once their table is known.
+ *
+ * @remark
  *  Return APR_EINVAL if unable to procure a convset, or APR_ENOTIMPL
  *  if charset transcoding is not available in this instance of
  *  apr-util at all (i.e., APR_HAS_XLATE is undefined).
@@ -28,6 +28,7 @@
 #include "apr_pools.h"
 #include "apr_tables.h"
 #include "apr_file_io.h"
+#include "apr_buckets.h"
 
 #include "apu.h"
 #if APR_CHARSET_EBCDIC
@@ -214,6 +215,68 @@ typedef struct apr_xml_parser apr_xml_parser;
  */
 APR_DECLARE(apr_xml_parser *) apr_xml_parser_create(apr_pool_t *pool);
 
+/**
+ * Callback for the start of an element, in a streaming parse.
+ * @param baton The baton given to apr_xml_parser_create_stream()
+ * @param elem The element, with its namespace resolved, its xml:lang and
+ *             its attributes, and the elements it lies in as parents, but
+ *             no children nor cdata
+ * @return APR_SUCCESS to go on parsing, or an error to stop it, which
+ *         apr_xml_parser_feed() then returns
+ */
+typedef apr_status_t (apr_xml_start_fn)(void *baton, const apr_xml_elem *elem);
+
+/**
+ * Callback for character data, in a streaming parse.
+ * @param baton The baton given to apr_xml_parser_create_stream()
+ * @param elem The element the data lies in
+ * @param data The data, not NUL terminated, valid during the call only
+ * @param len The length of the data
+ * @return APR_SUCCESS to go on parsing, or an error to stop it
+ * @remark The data of an element may come in several calls.
+ */
+typedef apr_status_t (apr_xml_cdata_fn)(void *baton, const apr_xml_elem *elem,
+                                        const char *data, apr_size_t len);
+
+/**
+ * Callback for the end of an element, in a streaming parse.
+ * @param baton The baton given to apr_xml_parser_create_stream()
+ * @param elem The element, as given to the start callback, which is not
+ *             valid past this call
+ * @return APR_SUCCESS to go on parsing, or an error to stop it
+ */
+typedef apr_status_t (apr_xml_end_fn)(void *baton, const apr_xml_elem *elem);
+
+/**
+ * Create an XML parser giving the elements and character data to callbacks
+ * as they are parsed, rather than building a document.
+ * @param pool The pool for allocating the parser.
+ * @param start_fn The callback for the start of elements, or NULL.
+ * @param cdata_fn The callback for character data, or NULL.
+ * @param end_fn The callback for the end of elements, or NULL.
+ * @param baton The baton to pass to the callbacks.
+ * @return The new parser.
+ * @remark Each element lives in a subpool which is cleared at its end,
+ *         so the memory used depends on the depth of the document rather
+ *         than its size.  Namespaces are resolved as apr_xml_parser_create()
+ *         does, their URIs being in apr_xml_parser_namespaces().  The
+ *         document given by apr_xml_parser_done() has no root.
+ */
+APR_DECLARE(apr_xml_parser *) apr_xml_parser_create_stream(apr_pool_t *pool,
+                                                   apr_xml_start_fn *start_fn,
+                                                   apr_xml_cdata_fn *cdata_fn,
+                                                   apr_xml_end_fn *end_fn,
+                                                   void *baton);
+
+/**
+ * Get the namespace URIs found so far by a parser, as indexed by the ns
+ * field of elements and attributes.
+ * @param parser The XML parser.
+ * @return The array of namespace URIs, see APR_XML_GET_URI_ITEM().
+ */
+APR_DECLARE(apr_array_header_t *) apr_xml_parser_namespaces(
+                                                   apr_xml_parser *parser);
+
 /**
  * Parse a File, producing a xml_doc
  * @param p      The pool for allocating the parse results.
@@ -288,6 +351,31 @@ APR_DECLARE(void) apr_xml_to_text(apr_pool_t *p, const apr_xml_elem *elem,
                                   int *ns_map, const char **pbuf,
                                   apr_size_t *psize);
 
+/**
+ * Write an XML element tree into a brigade, as apr_xml_to_text() would
+ * give it, without building the text first.
+ * @param bb The brigade to write to
+ * @param flush The function to call when the brigade is full, as for
+ *        apr_brigade_write(), or NULL
+ * @param ctx The context to pass to the flush function
+ * @param elem The XML element to convert
+ * @param style How to covert the XML, as for apr_xml_to_text()
+ * @param namespaces The namespace of the current XML element
+ * @param ns_map Namespace mapping
+ * @param quote If true, quote the cdata and attribute values on the way,
+ *        as apr_xml_quote_elem() would have done beforehand
+ * @return APR_SUCCESS, or the error of a write or flush
+ * @remark With the LANG_INNER style, the xml:lang value and its NUL
+ *         terminator come first, as with apr_xml_to_text().
+ */
+APR_DECLARE(apr_status_t) apr_xml_to_brigade(apr_bucket_brigade *bb,
+                                             apr_brigade_flush flush,
+                                             void *ctx,
+                                             const apr_xml_elem *elem,
+                                             int style,
+                                             apr_array_header_t *namespaces,
+                                             int *ns_map, int quote);
+
 /* style argument values: */
 #define APR_XML_X2T_FULL         0	/**< start tag, contents, end tag */
 #define APR_XML_X2T_INNER        1	/**< contents only */
@@ -130,6 +130,7 @@ struct apr_file_t {
     struct apr_thread_mutex_t *thlock;
 #endif
     apr_rotating_info_t *rotating;
+    apr_pool_cleanup_t *cleanup; /* NULL if none or closed */
 };
 
 struct apr_dir_t {
@@ -57,4 +57,30 @@
 apr_status_t apr__atomic_generic64_init(apr_pool_t *p);
 #endif
 
+#if HAVE__ATOMIC_BUILTINS
+/* The builtins need the memory order at compile time, the orders not
+ * applying to an operation being strengthened to sequential consistency.
+ */
+#define ATOMIC_LOAD_EXPLICIT(mem, order) \
+    ((order) == APR_ATOMIC_RELAXED ? __atomic_load_n(mem, __ATOMIC_RELAXED) \
+     : (order) == APR_ATOMIC_ACQUIRE ? __atomic_load_n(mem, __ATOMIC_ACQUIRE) \
+     : __atomic_load_n(mem, __ATOMIC_SEQ_CST))
+#define ATOMIC_STORE_EXPLICIT(mem, val, order) \
+    ((order) == APR_ATOMIC_RELAXED \
+         ? __atomic_store_n(mem, val, __ATOMIC_RELAXED) \
+     : (order) == APR_ATOMIC_RELEASE \
+         ? __atomic_store_n(mem, val, __ATOMIC_RELEASE) \
+     : __atomic_store_n(mem, val, __ATOMIC_SEQ_CST))
+#define ATOMIC_FETCH_ADD_EXPLICIT(mem, val, order) \
+    ((order) == APR_ATOMIC_RELAXED \
+         ? __atomic_fetch_add(mem, val, __ATOMIC_RELAXED) \
+     : (order) == APR_ATOMIC_ACQUIRE \
+         ? __atomic_fetch_add(mem, val, __ATOMIC_ACQUIRE) \
+     : (order) == APR_ATOMIC_RELEASE \
+         ? __atomic_fetch_add(mem, val, __ATOMIC_RELEASE) \
+     : (order) == APR_ATOMIC_ACQ_REL \
+         ? __atomic_fetch_add(mem, val, __ATOMIC_ACQ_REL) \
+     : __atomic_fetch_add(mem, val, __ATOMIC_SEQ_CST))
+#endif
+
 #endif /* ATOMIC_H */
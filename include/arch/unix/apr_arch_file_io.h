@@ -92,6 +92,11 @@
 /* For backwards-compat */
 #define APR_FILE_BUFSIZE  APR_FILE_DEFAULT_BUFSIZE
 
+/* The buffer size of APR_FOPEN_DIRECT files, and their alignment where
+ * the system does not tell */
+#define APR_FILE_DIRECT_BUFSIZE (256 * 1024)
+#define APR_FILE_DIRECT_ALIGN   4096
+
 typedef struct apr_rotating_info_t {
     apr_finfo_t finfo;
     apr_interval_time_t timeout;
@@ -127,6 +132,13 @@ struct apr_file_t {
     struct apr_thread_mutex_t *thlock;
 #endif
     apr_rotating_info_t *rotating;
+    apr_pool_cleanup_t *cleanup; /* NULL if none or closed */
+    /* Stuff for APR_FOPEN_DIRECT and APR_FOPEN_NOREUSE */
+    apr_size_t direct_align;  /* alignment of direct I/O, 0 if not direct */
+    int direct_on;            /* whether the descriptor is direct now */
+    apr_size_t noreuse_len;   /* amount of data not dropped from the cache */
+    apr_off_t noreuse_prev;   /* the previous window, being written back */
+    apr_size_t noreuse_prevlen;
 };
 
 #if APR_HAS_THREADS
@@ -147,6 +159,7 @@ struct apr_file_t {
 #define stat(f,b) stat64(f,b)
 #define lstat(f,b) lstat64(f,b)
 #define fstat(f,b) fstat64(f,b)
+#define fstatat(d,f,b,l) fstatat64(d,f,b,l)
 #define lseek(f,o,w) lseek64(f,o,w)
 #define ftruncate(f,l) ftruncate64(f,l)
 typedef struct stat64 struct_stat;
@@ -169,6 +182,10 @@ struct apr_dir_t {
 #else
     struct dirent *entry;
 #endif
+    /* apr_dir_read_batch()'s getdents64 buffer */
+    char *dents;
+    apr_size_t dents_pos;
+    apr_size_t dents_len;
 };
 
 apr_status_t apr_unix_file_cleanup(void *);
@@ -176,6 +193,22 @@ apr_status_t apr_unix_child_file_cleanup(void *);
 
 mode_t apr_unix_perms2mode(apr_fileperms_t perms);
 apr_fileperms_t apr_unix_mode2perms(mode_t mode);
+void apr_unix_stat2finfo(apr_finfo_t *finfo, struct_stat *info,
+                         apr_int32_t wanted);
+
+#if defined(HAVE_OPENAT) && defined(HAVE_FDOPENDIR)
+#define DIR_OPENAT
+/* Open the directory @a name of @a parent, known as @a dirname */
+apr_status_t apr_unix_dir_openat(apr_dir_t **new, apr_dir_t *parent,
+                                 const char *name, const char *dirname,
+                                 apr_pool_t *pool);
+#endif
+
+/* Set up direct I/O for a file opened with APR_FOPEN_DIRECT */
+apr_status_t apr_unix_file_direct_init(apr_file_t *thefile, int on);
+/* Allocate an aligned buffer of direct I/O from the allocator of a pool */
+char *apr_unix_direct_buffer_alloc(apr_pool_t *pool, apr_size_t size,
+                                   apr_size_t align);
 
 apr_status_t apr_file_flush_locked(apr_file_t *thefile);
 apr_status_t apr_file_info_get_locked(apr_finfo_t *finfo, apr_int32_t wanted,
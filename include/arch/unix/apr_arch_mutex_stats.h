@@ -0,0 +1,57 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MUTEX_STATS_H
+#define MUTEX_STATS_H
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_pools.h"
+#include "apr_mutex_stats.h"
+
+/* The statistics of a named mutex, registered process wide until the
+ * pool of the mutex is cleared.  They are updated with the mutex held.
+ */
+typedef struct apr_mutex_profile_t apr_mutex_profile_t;
+struct apr_mutex_profile_t {
+    apr_mutex_stats_t stats;
+    const void *volatile holder;    /* lock call site of the holder */
+    apr_mutex_profile_t *next;
+};
+
+/* The caller of the function using it, as the site of a lock call */
+#if defined(__GNUC__)
+#define APR_MUTEX_CALL_SITE() __builtin_return_address(0)
+#else
+#define APR_MUTEX_CALL_SITE() NULL
+#endif
+
+/* Name a mutex, registering its statistics on the first call */
+apr_status_t apr_mutex_profile_name(apr_mutex_profile_t **profile,
+                                    const char *name, const char *kind,
+                                    apr_pool_t *pool);
+
+/* Account for a lock taken at site, which waited since start for the
+ * holder if start is not 0; called with the mutex held.
+ */
+void apr_mutex_profile_locked(apr_mutex_profile_t *profile,
+                              apr_time_t start, const void *site,
+                              const void *holder);
+
+#define apr_mutex_profile_unlocked(profile) ((profile)->holder = NULL)
+
+#endif  /* MUTEX_STATS_H */
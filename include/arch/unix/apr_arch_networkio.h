@@ -52,6 +52,9 @@
 #if APR_HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
 #endif
+#ifdef HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
 #if APR_HAVE_NETINET_SCTP_UIO_H
 #include <netinet/sctp_uio.h>
 #endif
@@ -82,6 +85,11 @@
 #if APR_HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) \
+    && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define HAVE_SOCKET_ZEROCOPY 1
+#endif
 /* End System Headers */
 
 #ifndef HAVE_POLLIN
@@ -124,6 +132,16 @@ struct apr_socket_t {
     /* if there is a timeout set, then this pollset is used */
     apr_pollset_t *pollset;
 #endif
+#if APR_HAS_SPLICE
+    /* the pipe used by apr_socket_splice() to write to this socket */
+    int splice_pipe[2];
+    /* the number of bytes still in splice_pipe, to be written first */
+    apr_size_t splice_pending;
+#endif
+#ifdef HAVE_SOCKET_ZEROCOPY
+    /* the identifier of the next MSG_ZEROCOPY send */
+    apr_uint32_t zerocopy_id;
+#endif
 };
 
 const char *apr_inet_ntop(int af, const void *src, char *dst, apr_size_t size);
@@ -141,5 +159,18 @@ void apr_sockaddr_vars_set(apr_sockaddr_t *, int, apr_port_t);
             (skt)->options &= ~(option);        \
     } while (0)
 
+/* Whether the timeout of the socket is waited for by polling it, rather
+ * than by the blocking socket calls themselves (APR_SO_SYSTIMEOUT).
+ */
+#define apr_socket_timeout_polled(skt) \
+    ((skt)->timeout > 0 && !apr_is_option_set(skt, APR_SO_SYSTIMEOUT))
+
+/* Wait for the socket after a call failed with EAGAIN, which with the
+ * system timeout means that it expired already.
+ */
+#define apr_socket_wait_io(skt, for_read) \
+    (apr_is_option_set(skt, APR_SO_SYSTIMEOUT) ? APR_TIMEUP \
+        : apr_wait_for_io_or_timeout(NULL, skt, for_read))
+
 #endif  /* ! NETWORK_IO_H */
 
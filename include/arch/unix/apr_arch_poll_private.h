@@ -38,6 +38,10 @@
 #include <sys/epoll.h>
 #endif
 
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
 #ifdef NETWARE
 #define HAS_SOCKETS(dt) (dt == APR_POLL_SOCKET) ? 1 : 0
 #define HAS_PIPES(dt) (dt == APR_POLL_FILE) ? 1 : 0
@@ -87,7 +91,7 @@
 #define WAKEUP_USES_PIPE 1
 #endif
 
-#if defined(POLLSET_USES_KQUEUE) || defined(POLLSET_USES_EPOLL) || defined(POLLSET_USES_PORT) || defined(POLLSET_USES_AIO_MSGQ)
+#if defined(POLLSET_USES_KQUEUE) || defined(POLLSET_USES_EPOLL) || defined(POLLSET_USES_PORT) || defined(POLLSET_USES_AIO_MSGQ) || defined(HAVE_IO_URING)
 
 #include "apr_ring.h"
 
@@ -109,11 +113,33 @@ typedef struct pfd_elem_t pfd_elem_t;
 struct pfd_elem_t {
     APR_RING_ENTRY(pfd_elem_t) link;
     apr_pollfd_t pfd;
+    /* The native descriptor this element is mapped with, or -1 */
+    int map_fd;
 #ifdef HAVE_PORT_CREATE
    int on_query_ring;
 #endif
+#ifdef HAVE_IO_URING
+    /* The pollcb's descriptor */
+    apr_pollfd_t *descriptor;
+    /* The state of the io_uring poll request */
+    int iouring_state;
+#endif
 };
 
+/* A table of the pfd_elem_t on the query ring, indexed by their native
+ * descriptor, so that they can be found without walking the ring.
+ */
+typedef struct pfd_elem_map_t {
+    pfd_elem_t **elems;
+    apr_uint32_t nalloc;
+} pfd_elem_map_t;
+
+void apr_pollset_elem_map_set(pfd_elem_map_t *map, int fd,
+                              pfd_elem_t *elem, apr_pool_t *p);
+pfd_elem_t *apr_pollset_elem_map_get(const pfd_elem_map_t *map, int fd,
+                                     const apr_pollfd_t *descriptor);
+void apr_pollset_elem_map_unset(pfd_elem_map_t *map, pfd_elem_t *elem);
+
 #endif
 
 typedef struct apr_pollset_private_t apr_pollset_private_t;
@@ -150,6 +176,9 @@ typedef union {
 #endif
 #if defined(HAVE_POLL)
     struct pollfd *ps;
+#endif
+#if defined(HAVE_IO_URING)
+    struct apr_iouring_t *iouring;
 #endif
     void *undef;
 } apr_pollcb_pset;
@@ -177,7 +206,9 @@ struct apr_pollset_provider_t {
     apr_status_t (*create)(apr_pollset_t *, apr_uint32_t, apr_pool_t *, apr_uint32_t);
     apr_status_t (*add)(apr_pollset_t *, const apr_pollfd_t *);
     apr_status_t (*remove)(apr_pollset_t *, const apr_pollfd_t *);
+    apr_status_t (*rearm)(apr_pollset_t *, const apr_pollfd_t *);
     apr_status_t (*poll)(apr_pollset_t *, apr_interval_time_t, apr_int32_t *, const apr_pollfd_t **);
+    apr_status_t (*poll_ex)(apr_pollset_t *, apr_interval_time_t, apr_pollfd_t *, apr_int32_t, apr_int32_t *);
     apr_status_t (*cleanup)(apr_pollset_t *);
     const char *name;
 };
@@ -186,6 +217,7 @@ struct apr_pollcb_provider_t {
     apr_status_t (*create)(apr_pollcb_t *, apr_uint32_t, apr_pool_t *, apr_uint32_t);
     apr_status_t (*add)(apr_pollcb_t *, apr_pollfd_t *);
     apr_status_t (*remove)(apr_pollcb_t *, apr_pollfd_t *);
+    apr_status_t (*rearm)(apr_pollcb_t *, apr_pollfd_t *);
     apr_status_t (*poll)(apr_pollcb_t *, apr_interval_time_t, apr_pollcb_cb_t, void *);
     apr_status_t (*cleanup)(apr_pollcb_t *);
     const char *name;
@@ -199,6 +231,7 @@ struct apr_pollcb_provider_t {
 apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
                                          apr_file_t **wakeup_pipe);
 apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe);
+apr_status_t apr_poll_send_wakeup_pipe(apr_file_t **wakeup_pipe);
 void apr_poll_drain_wakeup_pipe(volatile apr_uint32_t *wakeup_set, apr_file_t **wakeup_pipe);
 #else
 apr_status_t apr_poll_create_wakeup_socket(apr_pool_t *pool, apr_pollfd_t *pfd,
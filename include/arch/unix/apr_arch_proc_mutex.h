@@ -27,6 +27,7 @@
 #include "apr_file_io.h"
 #include "apr_arch_file_io.h"
 #include "apr_time.h"
+#include "apr_arch_mutex_stats.h"
 
 /* System headers required by Locks library */
 #if APR_HAVE_SYS_TYPES_H
@@ -60,6 +61,11 @@
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#endif
 #if APR_HAVE_PTHREAD_H
 #include <pthread.h>
 #endif
@@ -98,6 +104,7 @@ struct apr_proc_mutex_t {
     char *fname;
 
     apr_os_proc_mutex_t os;     /* Native mutex holder. */
+    apr_mutex_profile_t *profile;   /* If named. */
 
 #if APR_HAS_FCNTL_SERIALIZE || APR_HAS_FLOCK_SERIALIZE
     apr_file_t *interproc;      /* For apr_file_ calls on native fd. */
@@ -113,6 +120,11 @@ struct apr_proc_mutex_t {
                                  * refcounting impossible/undesirable.
                                  */
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    int futex_mapped;           /* Whether the futex word is mapped by us or
+                                 * apr_os_proc_mutex_put()ed.
+                                 */
+#endif
 };
 
 void apr_proc_mutex_unix_setup_lock(void);
@@ -24,6 +24,7 @@
 #include "apr_thread_cond.h"
 #include "apr_portable.h"
 #include "apr_atomic.h"
+#include "apr_arch_mutex_stats.h"
 
 #if APR_HAVE_PTHREAD_H
 #include <pthread.h>
@@ -33,6 +34,9 @@
 struct apr_thread_mutex_t {
     apr_pool_t *pool;
     pthread_mutex_t mutex;
+    int adaptive;       /* spins by APR, not the pthread library */
+    apr_uint32_t spins; /* estimated spins needed, if adaptive */
+    apr_mutex_profile_t *profile;   /* if named */
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     apr_thread_cond_t *cond;
     int locked, num_waiters;
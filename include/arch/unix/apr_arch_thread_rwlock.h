@@ -22,6 +22,9 @@
 #include "apr_general.h"
 #include "apr_thread_rwlock.h"
 #include "apr_pools.h"
+#include "apr_portable.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
 
 #if APR_HAVE_PTHREAD_H
 /* this gives us pthread_rwlock_t */
@@ -31,9 +34,24 @@
 #if APR_HAS_THREADS
 #ifdef HAVE_PTHREAD_RWLOCKS
 
+/* A reader counter of APR_THREAD_RWLOCK_SCALABLE, alone in its cache line */
+#define THREAD_RWLOCK_SLOTS 64
+#define THREAD_RWLOCK_SLOT_SIZE 64
+typedef struct thread_rwlock_slot_t {
+    apr_uint32_t readers;
+    char pad[THREAD_RWLOCK_SLOT_SIZE - sizeof(apr_uint32_t)];
+} thread_rwlock_slot_t;
+
 struct apr_thread_rwlock_t {
     apr_pool_t *pool;
     pthread_rwlock_t rwlock;
+    /* APR_THREAD_RWLOCK_SCALABLE, slots is NULL otherwise */
+    thread_rwlock_slot_t *slots;
+    apr_uint32_t writing;       /* a writer holds or waits for the lock */
+    apr_os_thread_t writer;     /* that writer, if writing */
+    apr_thread_mutex_t *wlock;  /* serializes the writers */
+    apr_thread_mutex_t *dlock;  /* for the drained readers */
+    apr_thread_cond_t *drained;
 };
 
 #else
@@ -43,6 +43,9 @@
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#ifdef HAVE_SPAWN_H
+#include <spawn.h>
+#endif
 /* End System Headers */
 
 
@@ -51,6 +54,10 @@
 
 #define SHELL_PATH "/bin/sh"
 
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWN)
+#define APR_PROC_SPAWN 1
+#endif
+
 #if APR_HAS_THREADS
 
 struct apr_thread_t {
@@ -60,17 +67,22 @@ struct apr_thread_t {
     apr_thread_start_t func;
     apr_status_t exitval;
     int detached;
+    struct apr_thread_cache_t *cache;
+    apr_thread_t *next; /* in the cache */
 };
 
 struct apr_threadattr_t {
     apr_pool_t *pool;
     pthread_attr_t attr;
     apr_size_t max_free;
+    struct apr_thread_cache_t *cache;
 };
 
 struct apr_threadkey_t {
     apr_pool_t *pool;
     pthread_key_t key;
+    int slot;           /* of the thread local cache, or -1 */
+    apr_uint32_t gen;   /* of the slot, for its cells to be valid */
 };
 
 struct apr_thread_once_t {
@@ -115,6 +127,7 @@ struct apr_procattr_t {
     apr_uid_t   uid;
     apr_gid_t   gid;
     apr_procattr_pscb_t *perms_set_callbacks;
+    apr_int32_t spawn;
 };
 
 #endif  /* ! THREAD_PROC_H */
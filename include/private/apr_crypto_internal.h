@@ -400,6 +400,71 @@ struct apr_crypto_driver_t {
     apr_status_t (*cprng_stream_ctx_bytes)(cprng_stream_ctx_t **pctx, unsigned char *key,
             unsigned char *to, apr_size_t n, const unsigned char *z);
 
+    /**
+     * @brief Reset an encryption or decryption context with a new IV.
+     * @param ctx The block context to reset.
+     * @param iv The new initialisation vector, or NULL if none is needed.
+     * @return APR_ENOIV if an initialisation vector is required but not
+     *         specified. APR_ENOTIMPL if not implemented.
+     */
+    apr_status_t (*block_reset)(apr_crypto_block_t *ctx,
+            const unsigned char *iv);
+
+    /**
+     * @brief Encrypt and authenticate a message in one call.
+     * @param ctx The block context, created from p if *ctx is NULL.
+     * @param out The ciphertext followed by the tag is written here.
+     * @param outlen Length of the output will be written here.
+     * @param in The message.
+     * @param inlen Length of the message.
+     * @param aad Additional authenticated data, or NULL.
+     * @param aadlen Length of the additional data.
+     * @param iv The initialisation vector.
+     * @param key The key structure.
+     * @param p The pool to use.
+     * @return APR_ENOTIMPL if not implemented.
+     */
+    apr_status_t (*aead_seal)(apr_crypto_block_t **ctx,
+            unsigned char *out, apr_size_t *outlen,
+            const unsigned char *in, apr_size_t inlen,
+            const unsigned char *aad, apr_size_t aadlen,
+            const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p);
+
+    /**
+     * @brief Verify and decrypt a message in one call.
+     * @param ctx The block context, created from p if *ctx is NULL.
+     * @param out The plaintext is written here.
+     * @param outlen Length of the output will be written here.
+     * @param in The ciphertext followed by the tag.
+     * @param inlen Length of the ciphertext and tag.
+     * @param aad Additional authenticated data, or NULL.
+     * @param aadlen Length of the additional data.
+     * @param iv The initialisation vector.
+     * @param key The key structure.
+     * @param p The pool to use.
+     * @return APR_ENOVERIFY if the message does not authenticate.
+     *         APR_ENOTIMPL if not implemented.
+     */
+    apr_status_t (*aead_open)(apr_crypto_block_t **ctx,
+            unsigned char *out, apr_size_t *outlen,
+            const unsigned char *in, apr_size_t inlen,
+            const unsigned char *aad, apr_size_t aadlen,
+            const unsigned char *iv, const apr_crypto_key_t *key, apr_pool_t *p);
+
+    /**
+     * @brief One shot HMAC or CMAC of a single memory buffer.
+     * @param key The key structure.
+     * @param in The message.
+     * @param inlen Length of the message.
+     * @param out The MAC is written here, or its size only if NULL.
+     * @param outlen On entry the size of out, on return the length of the MAC.
+     * @return APR_ENOSPACE if out is too small. APR_ENOTIMPL if not
+     *         implemented.
+     */
+    apr_status_t (*hmac)(const apr_crypto_key_t *key,
+            const unsigned char *in, apr_size_t inlen,
+            unsigned char *out, apr_size_t *outlen);
+
 };
 
 #endif
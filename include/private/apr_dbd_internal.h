@@ -349,6 +349,71 @@ struct apr_dbd_driver_t {
      */
     apr_status_t (*datum_get)(const apr_dbd_row_t *row, int col,
                               apr_dbd_type_e type, void *data);
+
+    /** send_query: send a prepared statement + args, not waiting for it
+     *  (NULL if the driver can not have queries in flight)
+     *
+     *  @param pool - working pool
+     *  @param handle - the connection
+     *  @param statement - the prepared statement to execute
+     *  @param args - args to prepared statement
+     *  @return 0 for success or error code
+     */
+    int (*send_query)(apr_pool_t *pool, apr_dbd_t *handle,
+                      apr_dbd_prepared_t *statement, const char **args);
+
+    /** poll_result: get the result of the oldest query sent
+     *
+     *  @param pool - working pool
+     *  @param handle - the connection
+     *  @param res - pointer to query results.  May point to NULL on entry
+     *  @param nrows - number of rows affected or returned
+     *  @param block - whether to wait for the result
+     *  @return 0 for success, APR_EAGAIN, APR_EOF or error code
+     */
+    int (*poll_result)(apr_pool_t *pool, apr_dbd_t *handle,
+                       apr_dbd_results_t **res, int *nrows, int block);
+
+    /** socket_get: get the socket of a connection
+     *
+     *  @param pool - the pool to allocate the socket from
+     *  @param handle - the connection
+     *  @param sock - the socket
+     *  @return APR_SUCCESS or error code
+     */
+    apr_status_t (*socket_get)(apr_pool_t *pool, apr_dbd_t *handle,
+                               apr_socket_t **sock);
+
+    /** bulk_begin: start a bulk load the driver's own way
+     *  (NULL to insert the rows with a prepared statement instead)
+     *
+     *  @param pool - pool for the load
+     *  @param handle - the connection
+     *  @param table - the table
+     *  @param cols - the columns, or NULL for all of them
+     *  @param ncols - the number of columns
+     *  @return 0 for success or error code
+     */
+    int (*bulk_begin)(apr_pool_t *pool, apr_dbd_t *handle,
+                      const char *table, const char **cols, int ncols);
+
+    /** bulk_append: add a row to the bulk load
+     *
+     *  @param handle - the connection
+     *  @param values - the values of the row
+     *  @param ncols - the number of columns
+     *  @return 0 for success or error code
+     */
+    int (*bulk_append)(apr_dbd_t *handle, const char **values, int ncols);
+
+    /** bulk_end: end the bulk load
+     *
+     *  @param handle - the connection
+     *  @param nrows - number of rows loaded
+     *  @param discard - whether to discard the rows, one having failed
+     *  @return 0 for success or error code
+     */
+    int (*bulk_end)(apr_dbd_t *handle, int *nrows, int discard);
 };
 
 /* Export mutex lock/unlock for drivers that need it 
@@ -84,6 +84,10 @@ struct apr_dbm_driver_t {
                          const char **used1,
                          const char **used2);
 
+    /** Store many records at once, NULL to store them one by one */
+    apr_status_t (*bulk_load)(apr_dbm_t *dbm, apr_dbm_bulk_next_fn_t *next,
+                              void *baton);
+
 };
 
 
@@ -113,6 +117,7 @@ APR_MODULE_DECLARE_DATA extern const apr_dbm_driver_t apr_dbm_type_sdbm;
 APR_MODULE_DECLARE_DATA extern const apr_dbm_driver_t apr_dbm_type_gdbm;
 APR_MODULE_DECLARE_DATA extern const apr_dbm_driver_t apr_dbm_type_ndbm;
 APR_MODULE_DECLARE_DATA extern const apr_dbm_driver_t apr_dbm_type_db;
+APR_MODULE_DECLARE_DATA extern const apr_dbm_driver_t apr_dbm_type_cdb;
 
 #ifdef __cplusplus
 }
@@ -81,6 +81,76 @@ static unsigned char convert_e2a[256] = {
 
 #endif /* !APR_CHARSET_EBCDIC */
 
+/*
+ * The vectorized cores of apr_encode, apr_base64, apr_escape, apr_strmatch
+ * and apr_utf8, which process the leading blocks of their input when the
+ * CPU allows, and return the number of input bytes consumed (possibly zero)
+ * for the scalar code to go on.
+ */
+
+/* Encode whole groups of three bytes to dest, with the base64url alphabet
+ * if url is set.
+ */
+apr_size_t apr__encode_base64_blocks(char *dest, const unsigned char *src,
+                                     apr_size_t count, int url);
+
+/* Skip the base64 characters of src by blocks, '-' and '_' included unless
+ * strict, stopping at the block holding the first other character.
+ */
+apr_size_t apr__decode_base64_valid(const unsigned char *src,
+                                    apr_size_t count, int strict);
+
+/* Decode whole groups of four characters, all valid, to dest, stopping
+ * early enough for the scalar code to write the last three bytes at
+ * least.
+ */
+apr_size_t apr__decode_base64_blocks(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count);
+
+/* Encode bytes to dest in hexadecimal, with lower case digits if lower is
+ * set.
+ */
+apr_size_t apr__encode_base16_blocks(char *dest, const unsigned char *src,
+                                     apr_size_t count, int lower);
+
+/* Skip the hexadecimal digits of src by blocks */
+apr_size_t apr__decode_base16_valid(const unsigned char *src,
+                                    apr_size_t count);
+
+/* Decode pairs of hexadecimal digits, all valid, to dest */
+apr_size_t apr__decode_base16_blocks(unsigned char *dest,
+                                     const unsigned char *src,
+                                     apr_size_t count);
+
+/* Skip the bytes of src to copy as they are, stopping at the first NUL,
+ * the first byte of the nibbles of apr_escape_test_char.h, or the first
+ * non ASCII byte if high is set.  count may exceed a NUL terminated src.
+ * Unlike the other cores, this one has a scalar fallback and skips the
+ * whole run.
+ */
+apr_size_t apr__escape_skip(const unsigned char *src, apr_size_t count,
+                            const unsigned char *nibbles, int high);
+
+/* Find the first of the n offsets of s where a pattern of plen bytes may
+ * start, its first and last bytes ORed with ffold and lfold (the case bit
+ * of a caseless letter, else zero) being first and last, or return n.
+ * s holds n + plen - 1 bytes.  This one also has a scalar fallback, with
+ * memchr() when ffold is zero.
+ */
+apr_size_t apr__strmatch_pair(const unsigned char *s, apr_size_t n,
+                              apr_size_t plen, unsigned char first,
+                              unsigned char last, unsigned char ffold,
+                              unsigned char lfold);
+
+/* Skip the well formed UTF-8 of src by blocks, stopping before the last
+ * character starting in the blocks before the first one holding an error.
+ */
+apr_size_t apr__utf8_valid(const unsigned char *src, apr_size_t count);
+
+/* Skip the ASCII bytes of src by blocks */
+apr_size_t apr__utf8_ascii(const unsigned char *src, apr_size_t count);
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -0,0 +1,153 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file apr_json_private.h
+ * @brief APR-UTIL JSON Private
+ */
+#ifndef APR_JSON_PRIVATE_H
+#define APR_JSON_PRIVATE_H
+
+#include "apr.h"
+#include "apr_json.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define JSON_SCAN_NEON 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup APR_Util_JSON_Private
+ * @ingroup APR_Util
+ * @{
+ */
+
+#define JSON_ONES  APR_UINT64_C(0x0101010101010101)
+#define JSON_HIGHS APR_UINT64_C(0x8080808080808080)
+/* Whether any byte of x is zero, or equal to c, or below c (when none
+ * of the bytes of x has its high bit set) */
+#define JSON_HASZERO(x) (((x) - JSON_ONES) & ~(x) & JSON_HIGHS)
+#define JSON_HASBYTE(x, c) JSON_HASZERO((x) ^ (JSON_ONES * (c)))
+#define JSON_HASLESS(x, c) (((x) - JSON_ONES * (c)) & ~(x) & JSON_HIGHS)
+
+#if JSON_SCAN_SSE2 || JSON_SCAN_NEON
+static APR_INLINE unsigned int json_ctz(apr_uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, mask);
+    return (unsigned int)i;
+#else
+    return (unsigned int)__builtin_ctzll(mask);
+#endif
+}
+#endif
+
+#if JSON_SCAN_NEON
+/* One nibble per byte of a comparison result, for json_ctz() / 4 */
+static APR_INLINE apr_uint64_t json_neon_mask(uint8x16_t m)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(
+                vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+#endif
+
+/* A segment of a compiled path, with its key unescaped */
+typedef struct json_path_seg_t {
+    const char *key;
+    apr_size_t klen;
+    /* the array index, or -1 if the key is not one */
+    apr_ssize_t index;
+    int wildcard;
+} json_path_seg_t;
+
+struct apr_json_path_t {
+    const char *expr;
+    json_path_seg_t *segs;
+    int nsegs;
+};
+
+/* The hash of an object, built on first use when decoded with
+ * APR_JSON_FLAGS_LAZY, which also drops the duplicate keys of its list.
+ */
+apr_hash_t *apr__json_object_hash(apr_json_object_t *object);
+
+/* Whether a segment matches the member of an object with the given key,
+ * or the element of an array at the given index when key is NULL.
+ */
+static APR_INLINE int json_path_seg_match(const json_path_seg_t *seg,
+                                          const char *key, apr_size_t klen,
+                                          apr_size_t index)
+{
+    if (seg->wildcard) {
+        return 1;
+    }
+    if (key) {
+        return seg->klen == klen && !memcmp(seg->key, key, klen);
+    }
+    return seg->index >= 0 && (apr_size_t)seg->index == index;
+}
+
+/* A node of a tape, the scalars taking one node and the arrays and
+ * objects one followed by the nodes of their elements, or of the keys
+ * and values of their members.
+ */
+struct apr_json_node_t {
+    /* the apr_json_type_e */
+    apr_uint32_t type;
+    /* the length of a string, the number of elements or members */
+    apr_uint32_t len;
+    union {
+        const char *p;
+        apr_int64_t lnumber;
+        double dnumber;
+        int boolean;
+        /* the nodes of an array or object, itself included */
+        apr_size_t skip;
+    } u;
+};
+
+struct apr_json_tape_t {
+    apr_json_node_t *nodes;
+};
+
+/* The node following a node and its elements or members, if any */
+static APR_INLINE const apr_json_node_t *json_node_skip(
+        const apr_json_node_t *node)
+{
+    return node + ((node->type == APR_JSON_ARRAY
+                    || node->type == APR_JSON_OBJECT) ? node->u.skip : 1);
+}
+
+/** @} */
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !APR_JSON_PRIVATE_H */
@@ -0,0 +1,75 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file apr_probes.h
+ * @brief APR Private Static Tracing Probes
+ *
+ * @remark Built with --enable-sdt, APR defines USDT (DTrace/SystemTap)
+ * probes with the provider "apr", which tools like bpftrace, perf or
+ * SystemTap can attach to in a running process, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/lib/libapr-2.so:apr:pool__clear { @[ustack] =
+ *   count(); }'
+ *
+ * A probe not attached to is a single nop instruction, its arguments
+ * being left wherever they are.  Without --enable-sdt the probes compile
+ * to nothing.
+ *
+ * The probes and their arguments:
+ *
+ *   pool__create(pool, parent), pool__clear(pool), pool__destroy(pool)
+ *   allocator__alloc(allocator, node, size), allocator__free(allocator,
+ *       node): the nodes taken from and given back to an allocator
+ *   mutex__contended(mutex), mutex__acquired(mutex): around the wait
+ *       for a thread mutex, only when it was locked
+ *   thread_pool__push(pool, func, param), thread_pool__start(pool,
+ *       func, param), thread_pool__end(pool, func, param)
+ *   queue__push__block(queue), queue__pop__block(queue): a queue push
+ *       (pop) waiting for room (data)
+ *   poll__enter(pollset, timeout), poll__leave(pollset, status, num):
+ *       around an apr_pollset_poll() or apr_pollcb_poll() (where num is
+ *       0) wait
+ *   bucket__read(bucket, type, len), bucket__setaside(bucket, type):
+ *       the reads of the file, pipe and socket buckets, and the setasides
+ *       of the transient and file buckets, with the bucket type's name
+ */
+#ifndef APR_PROBES_H
+#define APR_PROBES_H
+
+#include "apr.h"
+#include "apr_private.h"
+
+#if APR_HAVE_SDT
+
+#include <sys/sdt.h>
+
+#define APR_PROBE1(name, a) \
+    DTRACE_PROBE1(apr, name, a)
+#define APR_PROBE2(name, a, b) \
+    DTRACE_PROBE2(apr, name, a, b)
+#define APR_PROBE3(name, a, b, c) \
+    DTRACE_PROBE3(apr, name, a, b, c)
+
+#else /* APR_HAVE_SDT */
+
+#define APR_PROBE1(name, a)
+#define APR_PROBE2(name, a, b)
+#define APR_PROBE3(name, a, b, c)
+
+#endif /* APR_HAVE_SDT */
+
+#endif /* APR_PROBES_H */
@@ -0,0 +1,66 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file apr_sha_private.h
+ * @brief Hardware accelerated SHA-1 and SHA-256 block functions
+ */
+#ifndef APR_SHA_PRIVATE_H
+#define APR_SHA_PRIVATE_H
+
+#include "apr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup APR_Util_SHA_Private SHA private routines
+ * @ingroup APR
+ * @{
+ */
+
+/*
+ * The block functions below return the number of blocks they processed,
+ * all of them when the CPU has the SHA instructions (SHA-NI on x86,
+ * the ARMv8 cryptographic extension on aarch64), or none for the caller
+ * to fall back to its portable code.
+ */
+
+/* Process nblocks blocks of 64 bytes into the SHA-1 state, data being
+ * the message bytes, or the 16 words of a single block in host byte order
+ * if words is non-zero.
+ */
+apr_size_t apr__sha1_blocks(apr_uint32_t state[5], const void *data,
+                            apr_size_t nblocks, int words);
+
+/* Process nblocks blocks of 64 bytes into the SHA-256 state, as above */
+apr_size_t apr__sha256_blocks(apr_uint32_t state[8], const void *data,
+                              apr_size_t nblocks, int words);
+
+/* Compute the SHA-256 digests of the n buffers of vec at once, eight at
+ * a time in the lanes of the AVX2 registers, returning n, or zero when
+ * the CPU can't or has the SHA instructions which are faster.
+ */
+apr_size_t apr__sha256_multi(unsigned char (*digests)[32],
+                             const struct iovec *vec, apr_size_t n);
+
+/** @} */
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* !APR_SHA_PRIVATE_H */
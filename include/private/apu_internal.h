@@ -37,10 +37,27 @@ apr_status_t apu_dso_init(apr_pool_t *pool);
 apr_status_t apu_dso_mutex_lock(void);
 apr_status_t apu_dso_mutex_unlock(void);
 
+/* A module is searched and loaded once for the process, the symbols
+ * resolved from it being cached too: apu_dso_load returns APR_EINIT
+ * with the cached handle and symbol if this symbol of this module was
+ * already loaded, and APR_SUCCESS the first time.
+ */
 apr_status_t apu_dso_load(apr_dso_handle_t **dso, apr_dso_handle_sym_t *dsoptr,
                           const char *module, const char *modsym,
                           apr_pool_t *pool);
 
+/* The drivers loaded, to be found without locking: a list of them is
+ * only prepended to, with apu_dso_driver_set (under the interlock
+ * above), and apu_dso_driver_get walks it from any thread.  The list
+ * is allocated from pool, which must outlive it.
+ */
+typedef struct apu_dso_driver_t apu_dso_driver_t;
+
+const void *apu_dso_driver_get(apu_dso_driver_t *volatile *list,
+                               const char *name);
+void apu_dso_driver_set(apu_dso_driver_t *volatile *list, const char *name,
+                        const void *driver, apr_pool_t *pool);
+
 #ifdef __cplusplus
 }
 #endif
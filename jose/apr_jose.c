@@ -222,10 +222,46 @@ APR_DECLARE(apr_jose_t *) apr_jose_jwks_make(apr_jose_t *jose,
     }
 
     jwks->keys = keys;
+    jwks->kids = apr_hash_make(pool);
+    if (!jwks->kids) {
+        return NULL;
+    }
+
+    if (keys && keys->type == APR_JSON_ARRAY) {
+        apr_json_value_t *key;
+
+        for (key = apr_json_array_first(keys); key;
+                key = apr_json_array_next(keys, key)) {
+            apr_json_kv_t *kv;
+
+            if (key->type != APR_JSON_OBJECT) {
+                continue;
+            }
+
+            kv = apr_json_object_get(key, APR_JOSE_JWKSE_KEYID,
+                    APR_JSON_VALUE_STRING);
+            if (kv && kv->v->type == APR_JSON_STRING
+                    && !apr_hash_get(jwks->kids, kv->v->value.string.p,
+                            kv->v->value.string.len)) {
+                apr_hash_set(jwks->kids, kv->v->value.string.p,
+                        kv->v->value.string.len, key);
+            }
+        }
+    }
 
     return jose;
 }
 
+APR_DECLARE(apr_json_value_t *) apr_jose_jwks_get(apr_jose_t *jwks,
+        const char *kid, apr_ssize_t klen)
+{
+    if (jwks->type != APR_JOSE_TYPE_JWKS || !jwks->jose.jwks->kids) {
+        return NULL;
+    }
+
+    return apr_hash_get(jwks->jose.jwks->kids, kid, klen);
+}
+
 APR_DECLARE(apr_jose_t *) apr_jose_jws_make(apr_jose_t *jose,
         apr_jose_signature_t *signature, apr_array_header_t *signatures,
         apr_jose_t *payload, apr_pool_t *pool)
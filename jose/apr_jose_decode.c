@@ -14,9 +14,14 @@
  * levelations under the License.
  */
 
+#include <stdlib.h>
+
 #include "apr_jose.h"
 #include "apr_lib.h"
 #include "apr_encode.h"
+#include "apr_general.h"
+#include "apr_siphash.h"
+#include "apr_thread_mutex.h"
 
 static
 apr_status_t apr_jose_flatten(apr_bucket_brigade *bb, apr_jose_text_t *in,
@@ -1744,3 +1749,266 @@ APR_DECLARE(apr_status_t) apr_jose_decode(apr_jose_t **jose, const char *typ,
 
     return apr_jose_decode_data(jose, typ, brigade, cb, level, flags, pool);
 }
+
+/* The cache is set associative: a token goes to one of the ways of the
+ * set given by its tag, replacing the least lasting one of the set.
+ */
+#define JOSE_CACHE_WAYS 4
+
+typedef struct {
+    apr_uint64_t tag[2];
+    apr_interval_time_t expiry;     /* monotonic, zero when free */
+    char *claims;                   /* malloc()ed JSON text */
+    apr_size_t len;
+} jose_cache_entry_t;
+
+struct apr_jose_cache_t {
+    jose_cache_entry_t *entries;
+    apr_size_t mask;                /* of the sets */
+    apr_interval_time_t ttl;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *mutex;
+#endif
+    unsigned char key[2][APR_SIPHASH_KSIZE];
+};
+
+#if APR_HAS_THREADS
+#define jose_cache_lock(cache) apr_thread_mutex_lock((cache)->mutex)
+#define jose_cache_unlock(cache) apr_thread_mutex_unlock((cache)->mutex)
+#else
+#define jose_cache_lock(cache)
+#define jose_cache_unlock(cache)
+#endif
+
+static void jose_cache_free(apr_jose_cache_t *cache)
+{
+    apr_size_t i, n = (cache->mask + 1) * JOSE_CACHE_WAYS;
+
+    for (i = 0; i < n; i++) {
+        free(cache->entries[i].claims);
+    }
+    memset(cache->entries, 0, n * sizeof(jose_cache_entry_t));
+}
+
+static apr_status_t jose_cache_cleanup(void *data)
+{
+    jose_cache_free(data);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_jose_cache_create(apr_jose_cache_t **cache,
+        apr_size_t size, apr_interval_time_t ttl, apr_pool_t *pool)
+{
+#if APR_HAS_RANDOM
+    apr_jose_cache_t *c;
+    apr_size_t sets = 1;
+    apr_status_t status;
+
+    while (sets * JOSE_CACHE_WAYS < size) {
+        sets <<= 1;
+    }
+
+    c = apr_pcalloc(pool, sizeof(*c));
+    status = apr_generate_random_bytes(&c->key[0][0], sizeof(c->key));
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+#if APR_HAS_THREADS
+    status = apr_thread_mutex_create(&c->mutex, APR_THREAD_MUTEX_DEFAULT,
+            pool);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+#endif
+    c->entries = apr_pcalloc(pool, sets * JOSE_CACHE_WAYS
+            * sizeof(jose_cache_entry_t));
+    c->mask = sets - 1;
+    c->ttl = ttl;
+
+    apr_pool_cleanup_register(pool, c, jose_cache_cleanup,
+            apr_pool_cleanup_null);
+
+    *cache = c;
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(void) apr_jose_cache_clear(apr_jose_cache_t *cache)
+{
+    jose_cache_lock(cache);
+    jose_cache_free(cache);
+    jose_cache_unlock(cache);
+}
+
+static jose_cache_entry_t *jose_cache_set(apr_jose_cache_t *cache,
+        const apr_uint64_t tag[2])
+{
+    return &cache->entries[(apr_size_t)(tag[0] & cache->mask)
+            * JOSE_CACHE_WAYS];
+}
+
+/* The claims of a remembered token, copied to the pool */
+static int jose_cache_lookup(apr_jose_cache_t *cache,
+        const apr_uint64_t tag[2], apr_jose_text_t *claims, apr_pool_t *pool)
+{
+    jose_cache_entry_t *set = jose_cache_set(cache, tag);
+    apr_interval_time_t now = apr_time_monotonic();
+    int i, found = 0;
+
+    jose_cache_lock(cache);
+    for (i = 0; i < JOSE_CACHE_WAYS; i++) {
+        if (set[i].tag[0] == tag[0] && set[i].tag[1] == tag[1]
+                && set[i].expiry > now) {
+            claims->text = apr_pstrmemdup(pool, set[i].claims, set[i].len);
+            claims->len = set[i].len;
+            found = 1;
+            break;
+        }
+    }
+    jose_cache_unlock(cache);
+
+    return found;
+}
+
+static void jose_cache_insert(apr_jose_cache_t *cache,
+        const apr_uint64_t tag[2], apr_interval_time_t lifetime,
+        const char *claims, apr_size_t len)
+{
+    jose_cache_entry_t *set = jose_cache_set(cache, tag), *e = set;
+    apr_interval_time_t expiry = apr_time_monotonic() + lifetime;
+    char *copy;
+    int i;
+
+    copy = malloc(len ? len : 1);
+    if (!copy) {
+        return;
+    }
+    memcpy(copy, claims, len);
+
+    jose_cache_lock(cache);
+    for (i = 0; i < JOSE_CACHE_WAYS; i++) {
+        if (set[i].tag[0] == tag[0] && set[i].tag[1] == tag[1]) {
+            e = &set[i];
+            break;
+        }
+        if (set[i].expiry < e->expiry) {
+            e = &set[i];
+        }
+    }
+    free(e->claims);
+    e->tag[0] = tag[0];
+    e->tag[1] = tag[1];
+    e->expiry = expiry;
+    e->claims = copy;
+    e->len = len;
+    jose_cache_unlock(cache);
+}
+
+/* How long the claims may be remembered, zero if not at all */
+static apr_interval_time_t jose_cache_lifetime(apr_jose_cache_t *cache,
+        apr_json_value_t *claims)
+{
+    apr_interval_time_t lifetime = cache->ttl;
+    apr_json_kv_t *kv;
+
+    kv = apr_json_object_get(claims, APR_JOSE_JWT_EXPIRATION_TIME,
+            APR_JSON_VALUE_STRING);
+    if (kv) {
+        double exp;
+
+        if (kv->v->type == APR_JSON_LONG) {
+            exp = (double)kv->v->value.lnumber;
+        }
+        else if (kv->v->type == APR_JSON_DOUBLE) {
+            exp = kv->v->value.dnumber;
+        }
+        else {
+            return 0;
+        }
+
+        /* in seconds, a far away expiry must not overflow */
+        exp -= (double)apr_time_now() / APR_USEC_PER_SEC;
+        if (exp * APR_USEC_PER_SEC < (double)lifetime) {
+            lifetime = (apr_interval_time_t)(exp * APR_USEC_PER_SEC);
+        }
+    }
+
+    return lifetime > 0 ? lifetime : 0;
+}
+
+APR_DECLARE(apr_status_t) apr_jose_decode_cached(apr_jose_t **jose,
+        const char *typ, apr_bucket_brigade *brigade, apr_jose_cb_t *cb,
+        apr_jose_cache_t *cache, int level, int flags, apr_pool_t *pool)
+{
+    apr_bucket_brigade *bb;
+    apr_json_value_t *claims;
+    apr_jose_text_t in;
+    apr_jose_text_t text;
+    apr_interval_time_t lifetime;
+    apr_uint64_t tag[2];
+    apr_off_t offset;
+    apr_status_t status;
+
+    if (!cache || (flags & APR_JOSE_FLAG_DECODE_ALL)) {
+        return apr_jose_decode(jose, typ, brigade, cb, level, flags, pool);
+    }
+
+    status = apr_jose_flatten(brigade, &in, pool);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+
+    /* the JSON serialization has no single canonical form, don't bother */
+    if (!in.len || in.text[0] == '{') {
+        return apr_jose_decode(jose, typ, brigade, cb, level, flags, pool);
+    }
+
+    tag[0] = apr_siphash24(in.text, in.len, cache->key[0]);
+    tag[1] = apr_siphash24(in.text, in.len, cache->key[1]);
+
+    if (jose_cache_lookup(cache, tag, &text, pool)) {
+
+        status = apr_json_decode(&claims, text.text, text.len, &offset,
+                APR_JSON_FLAGS_WHITESPACE, level, pool);
+        if (APR_SUCCESS == status) {
+            *jose = apr_jose_jwt_make(NULL, claims, pool);
+            if (!*jose) {
+                return APR_ENOMEM;
+            }
+            return APR_SUCCESS;
+        }
+
+    }
+
+    status = apr_jose_decode(jose, typ, brigade, cb, level, flags, pool);
+    if (APR_SUCCESS != status || (*jose)->type != APR_JOSE_TYPE_JWT
+            || !(*jose)->jose.jwt->claims
+            || (*jose)->jose.jwt->claims->type != APR_JSON_OBJECT) {
+        return status;
+    }
+
+    claims = (*jose)->jose.jwt->claims;
+
+    lifetime = jose_cache_lifetime(cache, claims);
+    if (!lifetime) {
+        return status;
+    }
+
+    bb = apr_brigade_create(pool, brigade->bucket_alloc);
+    if (!bb) {
+        return status;
+    }
+
+    if (APR_SUCCESS == apr_json_encode(bb, NULL, NULL, claims,
+            APR_JSON_FLAGS_WHITESPACE, pool)
+            && APR_SUCCESS == apr_brigade_pflatten(bb, (char **)&text.text,
+                    &text.len, pool)) {
+        jose_cache_insert(cache, tag, lifetime, text.text, text.len);
+    }
+
+    apr_brigade_destroy(bb);
+
+    return status;
+}
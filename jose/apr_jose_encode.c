@@ -17,6 +17,138 @@
 #include "apr_jose.h"
 #include "apr_encode.h"
 
+/*
+ * The compact serializations are written straight to the output brigade:
+ * the JSON and payload brigades are base64url encoded bucket by bucket
+ * into one heap bucket sized for the whole token, which is the signing
+ * input handed to the sign callback, and which the signature is appended
+ * to in place.
+ */
+
+/* Room left after the signing input for '.' || BASE64URL(JWS Signature),
+ * enough for RSA-4096 signatures */
+#define JOSE_SIGNATURE_ROOM 1024
+
+/* Length of the base64url encoding of len bytes, without padding */
+static apr_size_t apr_jose_base64_len(apr_size_t len)
+{
+    return len / 3 * 4 + (len % 3 ? len % 3 + 1 : 0);
+}
+
+/*
+ * Reserve len bytes at the end of the brigade, in its last heap bucket if
+ * unshared and with room for len bytes and a NUL, otherwise in a new heap
+ * bucket of size bytes.
+ */
+static char *apr_jose_brigade_reserve(apr_bucket_brigade *bb,
+        apr_size_t len, apr_size_t size)
+{
+    apr_bucket *e = APR_BRIGADE_LAST(bb);
+    char *buf;
+
+    if (!APR_BRIGADE_EMPTY(bb) && APR_BUCKET_IS_HEAP(e)
+            && ((apr_bucket_heap *)(e->data))->refcount.refcount == 1) {
+        apr_bucket_heap *h = e->data;
+
+        /* HEAP bucket start offsets are always in-memory, safe to cast */
+        if (h->alloc_len - (e->length + (apr_size_t)e->start) > len) {
+            buf = h->base + e->start + e->length;
+            e->length += len;
+            return buf;
+        }
+    }
+
+    if (size <= len) {
+        size = len + 1;
+    }
+
+    buf = apr_bucket_alloc(size, bb->bucket_alloc);
+    if (!buf) {
+        return NULL;
+    }
+    e = apr_bucket_heap_create(buf, size, apr_bucket_free, bb->bucket_alloc);
+    e->length = len;
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+
+    return buf;
+}
+
+/* Base64url encode the buckets of the brigade to buf, returning the length */
+static apr_status_t apr_jose_encode_base64_brigade(apr_encode_stream_t *enc,
+        char *buf, apr_bucket_brigade *bb, apr_size_t *len)
+{
+    apr_bucket *e;
+    apr_size_t off = 0, dlen;
+    apr_status_t status;
+
+    for (e = APR_BRIGADE_FIRST(bb); e != APR_BRIGADE_SENTINEL(bb);
+            e = APR_BUCKET_NEXT(e)) {
+        const char *data;
+        apr_size_t n;
+
+        if (APR_BUCKET_IS_METADATA(e)) {
+            continue;
+        }
+
+        status = apr_bucket_read(e, &data, &n, APR_BLOCK_READ);
+        if (APR_SUCCESS != status) {
+            return status;
+        }
+
+        status = apr_encode_stream_update(enc, buf + off, data, n, &dlen);
+        if (APR_SUCCESS != status) {
+            return status;
+        }
+        off += dlen;
+    }
+
+    status = apr_encode_stream_finish(enc, buf + off, &dlen);
+    *len = off + dlen;
+
+    return status;
+}
+
+/* Encode the JSON to the brigade, returning its length */
+static apr_status_t apr_jose_encode_json_brigade(apr_bucket_brigade *bb,
+        apr_json_value_t *json, apr_size_t *len, apr_pool_t *pool)
+{
+    apr_off_t length = 0;
+    apr_status_t status = APR_SUCCESS;
+
+    if (json) {
+        status = apr_json_encode(bb, NULL, NULL, json,
+                APR_JSON_FLAGS_WHITESPACE, pool);
+        if (APR_SUCCESS == status) {
+            status = apr_brigade_length(bb, 1, &length);
+        }
+    }
+
+    *len = (apr_size_t)length;
+
+    return status;
+}
+
+/* Append '.' || BASE64URL(data) to the brigade */
+static apr_status_t apr_jose_write_base64(apr_bucket_brigade *bb,
+        const unsigned char *data, apr_size_t len, apr_size_t size)
+{
+    apr_size_t len64 = data ? apr_jose_base64_len(len) : 0;
+    char *buf;
+
+    buf = apr_jose_brigade_reserve(bb, 1 + len64, size);
+    if (!buf) {
+        return APR_ENOMEM;
+    }
+
+    *buf++ = '.';
+    if (len64) {
+        return apr_encode_base64_binary(buf, data, len, APR_ENCODE_BASE64URL,
+                NULL);
+    }
+
+    return APR_SUCCESS;
+}
+
 static apr_status_t apr_jose_encode_base64_json(apr_bucket_brigade *brigade,
         apr_brigade_flush flush, void *ctx, apr_json_value_t *json,
         apr_pool_t *pool)
@@ -26,25 +158,31 @@ static apr_status_t apr_jose_encode_base64_json(apr_bucket_brigade *brigade,
     if (json) {
 
         apr_bucket_brigade *bb;
+        apr_encode_stream_t *enc;
+        apr_size_t len;
+        char *buf;
 
         bb = apr_brigade_create(pool, brigade->bucket_alloc);
 
-        status = apr_json_encode(bb, flush, ctx, json,
-                APR_JSON_FLAGS_WHITESPACE, pool);
+        status = apr_jose_encode_json_brigade(bb, json, &len, pool);
+        if (APR_SUCCESS == status) {
+            status = apr_encode_base64_stream_create(&enc,
+                    APR_ENCODE_BASE64URL, 0, pool);
+        }
         if (APR_SUCCESS == status) {
 
-            char *buf;
-            apr_size_t buflen;
-            const char *buf64;
-            apr_size_t buf64len;
+            buf = apr_jose_brigade_reserve(brigade, apr_jose_base64_len(len),
+                    APR_BUCKET_BUFF_SIZE);
+            if (!buf) {
+                return APR_ENOMEM;
+            }
 
-            apr_brigade_pflatten(bb, &buf, &buflen, pool);
-            buf64 = apr_pencode_base64(pool, buf, buflen, APR_ENCODE_BASE64URL,
-                    &buf64len);
-            status = apr_brigade_write(brigade, flush, ctx, buf64, buf64len);
+            status = apr_jose_encode_base64_brigade(enc, buf, bb, &len);
 
         }
 
+        apr_brigade_cleanup(bb);
+
     }
 
     return status;
@@ -56,11 +194,21 @@ static apr_status_t apr_jose_encode_compact_jwe(apr_bucket_brigade *brigade,
 {
     apr_bucket_brigade *bb = apr_brigade_create(p,
             brigade->bucket_alloc);
+    apr_bucket_brigade *hb = apr_brigade_create(p,
+            brigade->bucket_alloc);
+    apr_encode_stream_t *enc;
+    apr_size_t hlen, len, size;
+    char *buf;
 
     apr_jose_jwe_t *jwe = jose->jose.jwe;
 
     apr_status_t status = APR_SUCCESS;
 
+    status = apr_encode_base64_stream_create(&enc, APR_ENCODE_BASE64URL, 0, p);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+
     /*
      * 7.1.  JWE Compact Serialization
      *
@@ -70,19 +218,14 @@ static apr_status_t apr_jose_encode_compact_jwe(apr_bucket_brigade *brigade,
      *      BASE64URL(UTF8(JWE Protected Header)) || '.' ||
      */
 
-    status = apr_jose_encode_base64_json(brigade, flush, ctx,
-            jwe->encryption->protected, p);
-    if (APR_SUCCESS != status) {
-        return status;
-    }
-
-    status = apr_brigade_write(brigade, flush, ctx, ".", 1);
+    status = apr_jose_encode_json_brigade(hb, jwe->encryption->protected,
+            &hlen, p);
     if (APR_SUCCESS != status) {
         return status;
     }
 
     if (cb && cb->encrypt) {
-        status = apr_jose_encode(bb, flush, ctx, jwe->payload, cb, p);
+        status = apr_jose_encode(bb, NULL, NULL, jwe->payload, cb, p);
         if (APR_SUCCESS != status) {
             jose->result = jwe->payload->result;
             return status;
@@ -94,105 +237,117 @@ static apr_status_t apr_jose_encode_compact_jwe(apr_bucket_brigade *brigade,
         }
     }
 
-    if (APR_SUCCESS == status) {
+    /*
+     *    7.   Compute the encoded key value BASE64URL(JWE Encrypted Key).
+     *
+     *    10.  Compute the encoded Initialization Vector value BASE64URL(JWE
+     *         Initialization Vector).
+     *
+     *    16.  Compute the encoded ciphertext value BASE64URL(JWE Ciphertext).
+     *
+     *    17.  Compute the encoded Authentication Tag value BASE64URL(JWE
+     *         Authentication Tag).
+     *
+     *    18.  If a JWE AAD value is present, compute the encoded AAD value
+     *         BASE64URL(JWE AAD).
+     *
+     *    19.  Create the desired serialized output.  The Compact Serialization
+     *         of this result is the string BASE64URL(UTF8(JWE Protected
+     *         Header)) || '.' || BASE64URL(JWE Encrypted Key) || '.' ||
+     *         BASE64URL(JWE Initialization Vector) || '.' || BASE64URL(JWE
+     *         Ciphertext) || '.' || BASE64URL(JWE Authentication Tag).  The
+     *         JWE JSON Serialization is described in Section 7.2.
+     */
 
-        struct iovec vec[7];
-
-        /*
-         *    7.   Compute the encoded key value BASE64URL(JWE Encrypted Key).
-         *
-         *    10.  Compute the encoded Initialization Vector value BASE64URL(JWE
-         *         Initialization Vector).
-         *
-         *    16.  Compute the encoded ciphertext value BASE64URL(JWE Ciphertext).
-         *
-         *    17.  Compute the encoded Authentication Tag value BASE64URL(JWE
-          *         Authentication Tag).
-          *
-          *    18.  If a JWE AAD value is present, compute the encoded AAD value
-          *         BASE64URL(JWE AAD).
-          *
-         *    19.  Create the desired serialized output.  The Compact Serialization
-         *         of this result is the string BASE64URL(UTF8(JWE Protected
-         *         Header)) || '.' || BASE64URL(JWE Encrypted Key) || '.' ||
-         *         BASE64URL(JWE Initialization Vector) || '.' || BASE64URL(JWE
-         *         Ciphertext) || '.' || BASE64URL(JWE Authentication Tag).  The
-         *         JWE JSON Serialization is described in Section 7.2.
-         */
-
-        /*
-         *      BASE64URL(JWE Encrypted Key) || '.' ||
-         */
-
-        vec[0].iov_base = (void *) apr_pencode_base64_binary(p,
-                jwe->recipient->ekey.data, jwe->recipient->ekey.len,
-                APR_ENCODE_BASE64URL, &vec[0].iov_len);
-        vec[1].iov_base = ".";
-        vec[1].iov_len = 1;
-
-        /*
-         *      BASE64URL(JWE Initialization Vector) || '.' ||
-         */
-
-        vec[2].iov_base = (void *) apr_pencode_base64_binary(p,
-                jwe->encryption->iv.data, jwe->encryption->iv.len,
-                APR_ENCODE_BASE64URL, &vec[2].iov_len);
-        vec[3].iov_base = ".";
-        vec[3].iov_len = 1;
-
-        /*
-         *      BASE64URL(JWE Ciphertext) || '.' ||
-         */
-
-        vec[4].iov_base = (void *) apr_pencode_base64_binary(p,
-                jwe->encryption->cipher.data, jwe->encryption->cipher.len,
-                APR_ENCODE_BASE64URL, &vec[4].iov_len);
-        vec[5].iov_base = ".";
-        vec[5].iov_len = 1;
-
-        /*
-         *      BASE64URL(JWE Authentication Tag)
-         */
-
-        vec[6].iov_base = (void *)apr_pencode_base64_binary(p, jwe->encryption->tag.data, jwe->encryption->tag.len,
-                APR_ENCODE_BASE64URL, &vec[6].iov_len);
-
-        status = apr_brigade_writev(brigade, flush, ctx, vec, 7);
+    size = apr_jose_base64_len(hlen)
+            + 1 + apr_jose_base64_len(jwe->recipient->ekey.len)
+            + 1 + apr_jose_base64_len(jwe->encryption->iv.len)
+            + 1 + apr_jose_base64_len(jwe->encryption->cipher.len)
+            + 1 + apr_jose_base64_len(jwe->encryption->tag.len) + 1;
 
+    apr_brigade_cleanup(bb);
+
+    buf = apr_jose_brigade_reserve(bb, apr_jose_base64_len(hlen), size);
+    if (!buf) {
+        return APR_ENOMEM;
     }
 
-    return status;
+    status = apr_jose_encode_base64_brigade(enc, buf, hb, &len);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+
+    /*
+     *      BASE64URL(JWE Encrypted Key) || '.' ||
+     *      BASE64URL(JWE Initialization Vector) || '.' ||
+     *      BASE64URL(JWE Ciphertext) || '.' ||
+     *      BASE64URL(JWE Authentication Tag)
+     */
+
+    status = apr_jose_write_base64(bb, jwe->recipient->ekey.data,
+            jwe->recipient->ekey.len, 0);
+    if (APR_SUCCESS == status) {
+        status = apr_jose_write_base64(bb, jwe->encryption->iv.data,
+                jwe->encryption->iv.len, 0);
+    }
+    if (APR_SUCCESS == status) {
+        status = apr_jose_write_base64(bb, jwe->encryption->cipher.data,
+                jwe->encryption->cipher.len, 0);
+    }
+    if (APR_SUCCESS == status) {
+        status = apr_jose_write_base64(bb, jwe->encryption->tag.data,
+                jwe->encryption->tag.len, 0);
+    }
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+
+    APR_BRIGADE_CONCAT(brigade, bb);
+
+    return APR_SUCCESS;
 }
 
 static apr_status_t apr_jose_encode_compact_jws(apr_bucket_brigade *brigade,
         apr_brigade_flush flush, void *ctx, apr_jose_t *jose, apr_jose_cb_t *cb,
         apr_pool_t *p)
 {
-    apr_bucket *e;
     apr_bucket_brigade *bb = apr_brigade_create(p,
             brigade->bucket_alloc);
-    apr_jose_text_t payload;
-    apr_jose_text_t payload64;
+    apr_bucket_brigade *hb = apr_brigade_create(p,
+            brigade->bucket_alloc);
+    apr_bucket_brigade *pb = apr_brigade_create(p,
+            brigade->bucket_alloc);
+    apr_encode_stream_t *enc;
+    apr_off_t plen;
+    apr_size_t hlen, len, len64;
+    char *buf;
 
     apr_jose_jws_t *jws = jose->jose.jws;
 
     apr_status_t status;
 
-    status = apr_jose_encode(bb, flush, ctx, jws->payload, cb, p);
+    status = apr_encode_base64_stream_create(&enc, APR_ENCODE_BASE64URL, 0, p);
     if (APR_SUCCESS != status) {
-        jose->result = jws->payload->result;
         return status;
     }
 
-    status = apr_brigade_pflatten(bb, (char **)&payload.text, &payload.len, p);
+    status = apr_jose_encode(pb, NULL, NULL, jws->payload, cb, p);
     if (APR_SUCCESS != status) {
+        jose->result = jws->payload->result;
         return status;
     }
 
-    payload64.text = apr_pencode_base64(p, payload.text, payload.len,
-            APR_ENCODE_BASE64URL, &payload64.len);
+    status = apr_brigade_length(pb, 1, &plen);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
 
-    apr_brigade_cleanup(bb);
+    status = apr_jose_encode_json_brigade(hb,
+            jws->signature ? jws->signature->protected_header : NULL,
+            &hlen, p);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
 
     /*
      * 7.1.  JWS Compact Serialization
@@ -201,31 +356,36 @@ static apr_status_t apr_jose_encode_compact_jws(apr_bucket_brigade *brigade,
      *    content as a compact, URL-safe string.  This string is:
      *
      *    BASE64URL(UTF8(JWS Protected Header)) || '.' ||
+     *    BASE64URL(JWS Payload) ||
      */
 
-    if (jws->signature) {
-        status = apr_jose_encode_base64_json(bb, flush, ctx,
-                jws->signature->protected_header, p);
-        if (APR_SUCCESS != status) {
-            return status;
-        }
+    len64 = apr_jose_base64_len(hlen) + 1 + apr_jose_base64_len(plen);
+
+    buf = apr_jose_brigade_reserve(bb, len64, len64 + JOSE_SIGNATURE_ROOM);
+    if (!buf) {
+        return APR_ENOMEM;
     }
 
-    status = apr_brigade_write(bb, flush, ctx, ".", 1);
+    status = apr_jose_encode_base64_brigade(enc, buf, hb, &len);
     if (APR_SUCCESS != status) {
         return status;
     }
+    buf += len;
 
-    /*
-     *   BASE64URL(JWS Payload) ||
-     */
+    *buf++ = '.';
 
-    e = apr_bucket_pool_create(payload64.text, payload64.len, p,
-            bb->bucket_alloc);
-    APR_BRIGADE_INSERT_TAIL(bb, e);
+    status = apr_jose_encode_base64_brigade(enc, buf, pb, &len);
+    if (APR_SUCCESS != status) {
+        return status;
+    }
+
+    apr_brigade_cleanup(hb);
+    apr_brigade_cleanup(pb);
 
     /*
      *    '.' || BASE64URL(JWS Signature)
+     *
+     * The signing input is the one bucket written so far.
      */
 
     if (cb && cb->sign && jws->signature) {
@@ -237,22 +397,12 @@ static apr_status_t apr_jose_encode_compact_jws(apr_bucket_brigade *brigade,
 
     APR_BRIGADE_CONCAT(brigade, bb);
 
-    status = apr_brigade_write(brigade, flush, ctx, ".", 1);
-    if (APR_SUCCESS != status) {
-        return status;
+    if (jws->signature && jws->signature->sig.data) {
+        status = apr_jose_write_base64(brigade, jws->signature->sig.data,
+                jws->signature->sig.len, 0);
     }
-
-    if (jws->signature && jws->signature->sig.data && APR_SUCCESS == status) {
-
-        const char *buf64;
-        apr_size_t buf64len;
-
-        buf64 = apr_pencode_base64_binary(p, jws->signature->sig.data,
-                jws->signature->sig.len,
-                APR_ENCODE_BASE64URL, &buf64len);
-        status = apr_brigade_write(brigade, flush, ctx, buf64,
-                buf64len);
-
+    else {
+        status = apr_jose_write_base64(brigade, NULL, 0, 0);
     }
 
     return status;
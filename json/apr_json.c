@@ -18,6 +18,7 @@
 #include <stdlib.h>
 
 #include "apr_json.h"
+#include "apr_json_private.h"
 
 #define APR_JSON_OBJECT_INSERT_TAIL(o, e) do {                              \
         apr_json_kv_t *ap__b = (e);                                        \
@@ -36,6 +37,36 @@ APR_DECLARE(apr_json_value_t *) apr_json_value_create(apr_pool_t *pool)
     return apr_pcalloc(pool, sizeof(apr_json_value_t));
 }
 
+/* The hash of the objects decoded with APR_JSON_FLAGS_LAZY is built on
+ * first use, by lookup or walk. As when decoding eagerly, a duplicate key
+ * replaces the value of the first one, in place, and is dropped.
+ */
+apr_hash_t *apr__json_object_hash(apr_json_object_t *object)
+{
+    if (!object->hash) {
+        apr_json_kv_t *kv, *next, *prev;
+
+        object->hash = apr_hash_make(object->pool);
+        for (kv = APR_RING_FIRST(&object->list);
+             kv != APR_RING_SENTINEL(&object->list, apr_json_kv_t, link);
+             kv = next) {
+            next = APR_RING_NEXT(kv, link);
+            prev = apr_hash_get(object->hash, kv->k->value.string.p,
+                                kv->k->value.string.len);
+            if (prev) {
+                prev->k = kv->k;
+                prev->v = kv->v;
+                APR_RING_REMOVE(kv, link);
+            }
+            else {
+                apr_hash_set(object->hash, kv->k->value.string.p,
+                             kv->k->value.string.len, kv);
+            }
+        }
+    }
+    return object->hash;
+}
+
 APR_DECLARE(apr_json_value_t *) apr_json_object_create(apr_pool_t *pool)
 {
     apr_json_object_t *object;
@@ -46,6 +77,7 @@ APR_DECLARE(apr_json_value_t *) apr_json_object_create(apr_pool_t *pool)
     json->value.object = object = apr_pcalloc(pool, sizeof(apr_json_object_t));
     APR_RING_INIT(&object->list, apr_json_kv_t, link);
     object->hash = apr_hash_make(pool);
+    object->pool = pool;
 
     return json;
 }
@@ -146,7 +178,7 @@ APR_DECLARE(apr_status_t) apr_json_object_set(apr_json_value_t *object,
         klen = strlen(key);
     }
 
-    hash = object->value.object->hash;
+    hash = apr__json_object_hash(object->value.object);
 
     kv = apr_hash_get(hash, key, klen);
 
@@ -185,7 +217,7 @@ APR_DECLARE(apr_status_t) apr_json_object_set_ex(apr_json_value_t *object,
         return APR_EINVAL;
     }
 
-    hash = object->value.object->hash;
+    hash = apr__json_object_hash(object->value.object);
 
     kv = apr_hash_get(hash, key->value.string.p, key->value.string.len);
 
@@ -220,7 +252,7 @@ APR_DECLARE(apr_json_kv_t *) apr_json_object_get(apr_json_value_t *object,
         return NULL;
     }
 
-    return apr_hash_get(object->value.object->hash, key, klen);
+    return apr_hash_get(apr__json_object_hash(object->value.object), key, klen);
 }
 
 APR_DECLARE(apr_json_kv_t *) apr_json_object_first(apr_json_value_t *obj)
@@ -231,6 +263,7 @@ APR_DECLARE(apr_json_kv_t *) apr_json_object_first(apr_json_value_t *obj)
         return NULL;
     }
 
+    apr__json_object_hash(obj->value.object);
     kv = APR_RING_FIRST(&(obj->value.object)->list);
 
     if (kv != APR_RING_SENTINEL(&(obj->value.object)->list, apr_json_kv_t, link)) {
@@ -348,11 +381,11 @@ APR_DECLARE(apr_json_value_t *) apr_json_overlay(apr_pool_t *p,
         return overlay;
     }
 
-    oc = apr_hash_count(overlay->value.object->hash);
+    oc = apr_hash_count(apr__json_object_hash(overlay->value.object));
     if (!oc) {
         return base;
     }
-    bc = apr_hash_count(base->value.object->hash);
+    bc = apr_hash_count(apr__json_object_hash(base->value.object));
     if (!bc) {
         return overlay;
     }
@@ -363,7 +396,8 @@ APR_DECLARE(apr_json_value_t *) apr_json_overlay(apr_pool_t *p,
          kv != APR_RING_SENTINEL(&(base->value.object)->list, apr_json_kv_t, link);
          kv = APR_RING_NEXT((kv), link)) {
 
-        if (!apr_hash_get(overlay->value.object->hash, kv->k->value.string.p,
+        if (!apr_hash_get(apr__json_object_hash(overlay->value.object),
+                kv->k->value.string.p,
                 kv->k->value.string.len)) {
 
             apr_json_object_set_ex(res, kv->k, kv->v, p);
@@ -385,3 +419,140 @@ APR_DECLARE(apr_json_value_t *) apr_json_overlay(apr_pool_t *p,
 
     return res;
 }
+
+APR_DECLARE(const apr_json_node_t *) apr_json_tape_root(
+        const apr_json_tape_t *tape)
+{
+    return tape->nodes;
+}
+
+APR_DECLARE(apr_json_type_e) apr_json_node_type(const apr_json_node_t *node)
+{
+    return (apr_json_type_e)node->type;
+}
+
+APR_DECLARE(const char *) apr_json_node_string(const apr_json_node_t *node,
+                                               apr_size_t *len)
+{
+    if (node->type != APR_JSON_STRING) {
+        return NULL;
+    }
+
+    if (len) {
+        *len = node->len;
+    }
+    return node->u.p;
+}
+
+APR_DECLARE(apr_int64_t) apr_json_node_long(const apr_json_node_t *node)
+{
+    switch (node->type) {
+    case APR_JSON_LONG:
+        return node->u.lnumber;
+    case APR_JSON_DOUBLE:
+        return (apr_int64_t)node->u.dnumber;
+    default:
+        return 0;
+    }
+}
+
+APR_DECLARE(double) apr_json_node_double(const apr_json_node_t *node)
+{
+    switch (node->type) {
+    case APR_JSON_LONG:
+        return (double)node->u.lnumber;
+    case APR_JSON_DOUBLE:
+        return node->u.dnumber;
+    default:
+        return 0;
+    }
+}
+
+APR_DECLARE(int) apr_json_node_boolean(const apr_json_node_t *node)
+{
+    return node->type == APR_JSON_BOOLEAN ? node->u.boolean : 0;
+}
+
+APR_DECLARE(apr_size_t) apr_json_node_count(const apr_json_node_t *node)
+{
+    if (node->type != APR_JSON_ARRAY && node->type != APR_JSON_OBJECT) {
+        return 0;
+    }
+
+    return node->len;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_get(
+        const apr_json_node_t *obj, const char *key, apr_ssize_t klen)
+{
+    const apr_json_node_t *k;
+
+    if (klen == APR_JSON_VALUE_STRING) {
+        klen = strlen(key);
+    }
+
+    for (k = apr_json_node_object_first(obj); k;
+         k = apr_json_node_object_next(obj, k)) {
+        if (k->len == (apr_size_t)klen && !memcmp(k->u.p, key, klen)) {
+            return k + 1;
+        }
+    }
+
+    return NULL;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_first(
+        const apr_json_node_t *obj)
+{
+    if (obj->type != APR_JSON_OBJECT || !obj->len) {
+        return NULL;
+    }
+
+    return obj + 1;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_next(
+        const apr_json_node_t *obj, const apr_json_node_t *key)
+{
+    const apr_json_node_t *next = json_node_skip(key + 1);
+
+    return next < obj + obj->u.skip ? next : NULL;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_object_value(
+        const apr_json_node_t *key)
+{
+    return key + 1;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_array_get(
+        const apr_json_node_t *arr, apr_size_t index)
+{
+    const apr_json_node_t *val;
+
+    if (arr->type != APR_JSON_ARRAY || index >= arr->len) {
+        return NULL;
+    }
+
+    for (val = arr + 1; index--; val = json_node_skip(val));
+
+    return val;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_array_first(
+        const apr_json_node_t *arr)
+{
+    if (arr->type != APR_JSON_ARRAY || !arr->len) {
+        return NULL;
+    }
+
+    return arr + 1;
+}
+
+APR_DECLARE(const apr_json_node_t *) apr_json_node_array_next(
+        const apr_json_node_t *arr, const apr_json_node_t *val)
+{
+    const apr_json_node_t *next = json_node_skip(val);
+
+    return next < arr + arr->u.skip ? next : NULL;
+}
@@ -18,6 +18,11 @@
 #include <stdlib.h>
 
 #include "apr_json.h"
+#include "apr_json_private.h"
+#include "apr_utf8.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
 
 #if !APR_CHARSET_EBCDIC
 
@@ -52,6 +57,138 @@ static int hex_to_int(int c)
     return -1;
 }
 
+/* The scanners below skip runs of bytes needing no attention, sixteen at
+ * a time with SSE2 or NEON, eight at a time otherwise, and one at a time
+ * for the tail.  A plain string byte is anything but '"', '\\' and the
+ * non-ASCII bytes, which are validated as UTF-8; the whitespaces are those
+ * of isspace() in the "C" locale.
+ */
+#define JSON_PLAIN(c) ((c) != '"' && (c) != '\\' && (c) < 0x80)
+#define JSON_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define JSON_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+static const char *json_scan_plain(const char *p, const char *e)
+{
+#if JSON_SCAN_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+
+    while (e - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        /* The sign bit of v itself flags the non-ASCII bytes */
+        int mask = _mm_movemask_epi8(_mm_or_si128(v,
+                       _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                    _mm_cmpeq_epi8(v, bslash))));
+        if (mask) {
+            return p + json_ctz((apr_uint64_t)mask);
+        }
+        p += 16;
+    }
+#elif JSON_SCAN_NEON
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t bslash = vdupq_n_u8('\\');
+    const uint8x16_t high = vdupq_n_u8(0x80);
+
+    while (e - p >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        apr_uint64_t mask = json_neon_mask(vorrq_u8(vcgeq_u8(v, high),
+                                vorrq_u8(vceqq_u8(v, quote),
+                                         vceqq_u8(v, bslash))));
+        if (mask) {
+            return p + json_ctz(mask) / 4;
+        }
+        p += 16;
+    }
+#endif
+    while (e - p >= 8) {
+        apr_uint64_t x;
+
+        memcpy(&x, p, 8);
+        if ((x & JSON_HIGHS) || JSON_HASBYTE(x, '"')
+                || JSON_HASBYTE(x, '\\')) {
+            break;
+        }
+        p += 8;
+    }
+    while (p < e && JSON_PLAIN(*(const unsigned char *)p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char *json_scan_space(const char *p, const char *e)
+{
+    /* Mostly single separators, the vectors only pay for indentation */
+    if (e - p < 2 || !JSON_SPACE(((const unsigned char *)p)[1])) {
+        return (p < e && JSON_SPACE(*(const unsigned char *)p)) ? p + 1 : p;
+    }
+#if JSON_SCAN_SSE2
+    {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i four = _mm_set1_epi8(4);
+
+        while (e - p >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+            __m128i c = _mm_sub_epi8(v, tab);
+            /* '\t' to '\r' are the bytes of v - '\t' not above 4 */
+            int mask = ~_mm_movemask_epi8(_mm_or_si128(
+                           _mm_cmpeq_epi8(v, space),
+                           _mm_cmpeq_epi8(_mm_min_epu8(c, four), c)))
+                       & 0xffff;
+            if (mask) {
+                return p + json_ctz((apr_uint64_t)mask);
+            }
+            p += 16;
+        }
+    }
+#elif JSON_SCAN_NEON
+    {
+        const uint8x16_t space = vdupq_n_u8(' ');
+        const uint8x16_t tab = vdupq_n_u8('\t');
+        const uint8x16_t four = vdupq_n_u8(4);
+
+        while (e - p >= 16) {
+            uint8x16_t v = vld1q_u8((const uint8_t *)p);
+            apr_uint64_t mask = ~json_neon_mask(vorrq_u8(
+                                    vceqq_u8(v, space),
+                                    vcleq_u8(vsubq_u8(v, tab), four)));
+            if (mask) {
+                return p + json_ctz(mask) / 4;
+            }
+            p += 16;
+        }
+    }
+#endif
+    while (p < e && JSON_SPACE(*(const unsigned char *)p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char *json_scan_digits(const char *p, const char *e)
+{
+    while (e - p >= 8) {
+        apr_uint64_t x;
+
+        memcpy(&x, p, 8);
+        /* Digits are 0x30 to 0x39: the high nibble is 3, and adding 6 to
+         * the low one does not carry into it (nor into the next byte once
+         * all the high nibbles are 3).
+         */
+        if (((x & (JSON_ONES * 0xf0)) ^ (JSON_ONES * 0x30))
+                | (((x + JSON_ONES * 0x06) & (JSON_ONES * 0xf0))
+                   ^ (JSON_ONES * 0x30))) {
+            break;
+        }
+        p += 8;
+    }
+    while (p < e && JSON_DIGIT(*(const unsigned char *)p)) {
+        p++;
+    }
+    return p;
+}
+
 static apr_ssize_t ucs4_to_utf8(char *out, int code)
 {
     if (code < 0x00000080) {
@@ -84,9 +221,10 @@ static apr_status_t apr_json_decode_string(apr_json_scanner_t * self, apr_json_s
     apr_status_t status = APR_SUCCESS;
     apr_json_string_t string;
     const char *p = self->p;
-    const char *e;
+    const char *e, *bs = NULL;
     char *q;
     apr_ssize_t len;
+    int plain = 1;
 
     if (self->p >= self->e) {
         status = APR_EOF;
@@ -98,9 +236,16 @@ static apr_status_t apr_json_decode_string(apr_json_scanner_t * self, apr_json_s
     /* advance past the \ " */
     len = 0;
     for (p = self->p, e = self->e; p < e;) {
+        const char *run = json_scan_plain(p, e);
+
+        len += run - p;
+        p = run;
+        if (p >= e)
+            break;
         if (*p == '"')
             break;
-        else if (*p == '\\') {
+        plain = 0;
+        if (*p == '\\') {
             p++;
             if (p >= e) {
                 status = APR_EOF;
@@ -125,6 +270,20 @@ static apr_status_t apr_json_decode_string(apr_json_scanner_t * self, apr_json_s
         }
     }
 
+    if (p >= e) {
+        status = APR_EOF;
+        goto out;
+    }
+
+    if (plain && (self->flags & APR_JSON_FLAGS_LAZY)) {
+        /* nothing to unescape nor validate, point into the text */
+        string.p = self->p;
+        string.len = p - self->p;
+        *retval = string;
+        p++; /* eat the trailing '"' */
+        goto out;
+    }
+
     string.p = q = apr_pcalloc(self->pool, len + 1);
     e = p;
 
@@ -135,6 +294,36 @@ static apr_status_t apr_json_decode_string(apr_json_scanner_t * self, apr_json_s
     }
 
     for (p = self->p; p < e;) {
+        const char *run = json_scan_plain(p, e);
+
+        if (run != p) {
+            memcpy(q, p, run - p);
+            q += run - p;
+            p = run;
+            continue;
+        }
+
+        if (*(unsigned char *)p >= 0x80) {
+            apr_size_t n;
+
+            /* Copy the well formed UTF-8 up to the next escape at once,
+             * the switch below handling what the validation stops at.
+             */
+            if (!bs || bs < p) {
+                bs = memchr(p, '\\', e - p);
+                if (!bs) {
+                    bs = e;
+                }
+            }
+            apr_utf8_validate(p, bs - p, &n);
+            if (n) {
+                memcpy(q, p, n);
+                q += n;
+                p += n;
+                continue;
+            }
+        }
+
         switch (*(unsigned char *)p) {
         case '\\':
             p++;
@@ -436,7 +625,10 @@ static apr_status_t apr_json_decode_object(apr_json_scanner_t * self,
     apr_json_object_t *object = apr_pcalloc(self->pool,
             sizeof(apr_json_object_t));
     APR_RING_INIT(&object->list, apr_json_kv_t, link);
-    object->hash = apr_hash_make(self->pool);
+    object->pool = self->pool;
+    if (!(self->flags & APR_JSON_FLAGS_LAZY)) {
+        object->hash = apr_hash_make(self->pool);
+    }
 
     *retval = object;
 
@@ -504,7 +696,18 @@ static apr_status_t apr_json_decode_object(apr_json_scanner_t * self,
         if ((status = apr_json_decode_value(self, &value)))
             goto out;
 
-        apr_json_object_set_ex(json, key, value, self->pool);
+        if (object->hash) {
+            apr_json_object_set_ex(json, key, value, self->pool);
+        }
+        else {
+            /* the hash comes later, if ever */
+            apr_json_kv_t *kv = apr_palloc(self->pool, sizeof(apr_json_kv_t));
+
+            APR_RING_ELEM_INIT(kv, link);
+            kv->k = key;
+            kv->v = value;
+            APR_RING_INSERT_TAIL(&object->list, kv, apr_json_kv_t, link);
+        }
 
         if (self->p == self->e) {
             status = APR_EOF;
@@ -547,7 +750,7 @@ static apr_status_t apr_json_decode_boolean(apr_json_scanner_t * self, int *retv
 static apr_status_t apr_json_decode_number(apr_json_scanner_t * self, apr_json_value_t * retval)
 {
     apr_status_t status = APR_SUCCESS;
-    int treat_as_float = 0, exp_occurred = 0;
+    int treat_as_float = 0;
     const char *p = self->p, *e = self->e;
 
     if (p >= e)
@@ -568,106 +771,52 @@ static apr_status_t apr_json_decode_number(apr_json_scanner_t * self, apr_json_v
         p++;
     }
 
-    if (!treat_as_float) {
-        while (p < e) {
-            unsigned char c = *(unsigned char *)p;
-            if (c == 'e' || c == 'E') {
-                p++;
-                if (p >= e)
-                    return APR_EOF;
-                c = *(unsigned char *)p;
-                if (c == '-') {
-                    p++;
-                    if (p >= e)
-                        return APR_EOF;
-                    c = *(unsigned char *)p;
-                }
-                if (!isdigit(c)) {
-                    status = APR_BADCH;
-                    goto out;
-                }
-                treat_as_float = 1;
-                exp_occurred = 1;
-                break;
-            }
-            else if (c == '.') {
-                p++;
-                treat_as_float = 1;
-                break;
-            }
-            else if (!isdigit(c))
-                break;
-            p++;
-        }
-    }
-    else {
-        while (p < e) {
-            unsigned char c = *(unsigned char *)p;
-            if (c == 'e' || c == 'E') {
-                p++;
-                if (p >= e)
-                    return APR_EOF;
-                c = *(unsigned char *)p;
-                if (c == '-') {
-                    p++;
-                    if (p >= e)
-                        return APR_EOF;
-                    c = *(unsigned char *)p;
-                }
-                if (!isdigit(c)) {
-                    status = APR_BADCH;
-                    goto out;
-                }
-                exp_occurred = 1;
-                break;
-            }
-            else if (!isdigit(c))
-                break;
-            p++;
-        }
+    p = json_scan_digits(p, e);
+
+    if (p < e && *p == '.') {
+        p = json_scan_digits(p + 1, e);
+        treat_as_float = 1;
     }
 
-    if (treat_as_float) {
-        if (!exp_occurred) {
-            while (p < e) {
-                unsigned char c = *(unsigned char *)p;
-                if (c == 'e' || c == 'E') {
-                    p++;
-                    if (p >= e)
-                        return APR_EOF;
-                    c = *(unsigned char *)p;
-                    if (c == '-') {
-                        p++;
-                        if (p >= e)
-                            return APR_EOF;
-                        c = *(unsigned char *)p;
-                    }
-                    if (!isdigit(c)) {
-                        status = APR_BADCH;
-                        goto out;
-                    }
-                    exp_occurred = 1;
-                    break;
-                }
-                else if (!isdigit(c))
-                    break;
-                p++;
-            }
-        }
-        if (exp_occurred) {
-            if (p >= e || !isdigit(*(unsigned char *)p))
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        unsigned char c;
+
+        p++;
+        if (p >= e)
+            return APR_EOF;
+        c = *(unsigned char *)p;
+        if (c == '-') {
+            p++;
+            if (p >= e)
                 return APR_EOF;
-            while (++p < e && isdigit(*(unsigned char *)p));
+            c = *(unsigned char *)p;
         }
+        if (!isdigit(c)) {
+            status = APR_BADCH;
+            goto out;
+        }
+        p = json_scan_digits(p + 1, e);
+        treat_as_float = 1;
     }
 
     if (treat_as_float) {
         retval->type = APR_JSON_DOUBLE;
-        retval->value.dnumber = strtod(self->p, NULL);
+        retval->value.dnumber = apr_strtod_fast(self->p, NULL);
+    }
+    else if (p - self->p <= 18) {
+        /* no overflow possible */
+        const char *d = self->p + (*self->p == '-');
+        apr_int64_t n = 0;
+
+        for (; d < p; d++) {
+            n = n * 10 + (*d - '0');
+        }
+        retval->type = APR_JSON_LONG;
+        retval->value.lnumber = (*self->p == '-') ? -n : n;
     }
     else {
         retval->type = APR_JSON_LONG;
-        retval->value.lnumber = strtol(self->p, NULL, 10);
+        retval->value.lnumber = apr_strtoi64(self->p, NULL, 10);
     }
 
 out:
@@ -689,7 +838,7 @@ static apr_status_t apr_json_decode_space(apr_json_scanner_t * self,
 {
     const char *p = self->p;
     char *s;
-    int len = 0;
+    apr_size_t len;
 
     *space = NULL;
 
@@ -697,24 +846,15 @@ static apr_status_t apr_json_decode_space(apr_json_scanner_t * self,
         return APR_SUCCESS;
     }
 
-    while (p < self->e && isspace(*(unsigned char *)p)) {
-        p++;
-        len++;
-    }
+    p = json_scan_space(p, self->e);
+    len = p - self->p;
 
-    if (self->flags & APR_JSON_FLAGS_WHITESPACE) {
-        if (len) {
-            *space = s = apr_palloc(self->pool, len + 1);
-
-            while (self->p < self->e && isspace(*(unsigned char *) self->p)) {
-                *s++ = *self->p++;
-            }
-            *s = 0;
-
-        }
-    } else {
-        self->p = p;
+    if ((self->flags & APR_JSON_FLAGS_WHITESPACE) && len) {
+        *space = s = apr_palloc(self->pool, len + 1);
+        memcpy(s, self->p, len);
+        s[len] = 0;
     }
+    self->p = p;
 
     return APR_SUCCESS;
 }
@@ -809,6 +949,865 @@ APR_DECLARE(apr_status_t) apr_json_decode(apr_json_value_t ** retval,
     return status;
 }
 
+/* The tape is decoded with the scanner, the nodes being pushed in document
+ * order and the arrays and objects given their length and extent once
+ * closed.
+ */
+static apr_status_t json_tape_string(apr_json_scanner_t *self,
+                                     apr_json_node_t *node)
+{
+    apr_json_string_t string;
+    apr_status_t status;
+
+    if ((status = apr_json_decode_string(self, &string))) {
+        return status;
+    }
+    if ((apr_uint64_t)string.len > APR_UINT32_MAX) {
+        return APR_ENOSPC;
+    }
+
+    node->type = APR_JSON_STRING;
+    node->len = (apr_uint32_t)string.len;
+    node->u.p = string.p;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t json_tape_value(apr_json_scanner_t *self,
+                                    apr_array_header_t *nodes)
+{
+    apr_json_node_t *node;
+    apr_status_t status = APR_SUCCESS;
+
+    self->p = json_scan_space(self->p, self->e);
+    if (self->p >= self->e) {
+        return APR_EOF;
+    }
+
+    node = apr_array_push(nodes);
+
+    switch (*(unsigned char *) self->p) {
+    case '"':
+        status = json_tape_string(self, node);
+        break;
+    case '[':
+    case '{': {
+        int i = nodes->nelts - 1;
+        char end = (*self->p == '[') ? ']' : '}';
+        apr_uint64_t count = 0;
+
+        if (self->level <= 0) {
+            return APR_EINVAL;
+        }
+        self->level--;
+
+        node->type = (end == ']') ? APR_JSON_ARRAY : APR_JSON_OBJECT;
+        self->p = json_scan_space(self->p + 1, self->e);
+
+        if (self->p < self->e && *self->p == end) {
+            self->p++;
+        }
+        else {
+            for (;;) {
+                if (end == '}') {
+                    self->p = json_scan_space(self->p, self->e);
+                    if (self->p >= self->e) {
+                        return APR_EOF;
+                    }
+                    if (*self->p != '"') {
+                        return APR_BADCH;
+                    }
+                    status = json_tape_string(self, apr_array_push(nodes));
+                    if (status) {
+                        return status;
+                    }
+                    self->p = json_scan_space(self->p, self->e);
+                    if (self->p >= self->e) {
+                        return APR_EOF;
+                    }
+                    if (*self->p != ':') {
+                        return APR_BADCH;
+                    }
+                    self->p++;
+                }
+
+                if ((status = json_tape_value(self, nodes))) {
+                    return status;
+                }
+                if (++count > APR_UINT32_MAX) {
+                    return APR_ENOSPC;
+                }
+
+                if (self->p >= self->e) {
+                    return APR_EOF;
+                }
+                if (*self->p == end) {
+                    self->p++;
+                    break;
+                }
+                if (*self->p != ',') {
+                    return APR_BADCH;
+                }
+                self->p++;
+
+                /* right before the end, as apr_json_decode() */
+                if (self->p < self->e && *self->p == end) {
+                    self->p++;
+                    break;
+                }
+            }
+        }
+
+        /* the nodes may have moved */
+        node = &APR_ARRAY_IDX(nodes, i, apr_json_node_t);
+        node->len = (apr_uint32_t)count;
+        node->u.skip = nodes->nelts - i;
+
+        self->level++;
+        break;
+    }
+    case 'n':
+        node->type = APR_JSON_NULL;
+        status = apr_json_decode_null(self);
+        break;
+    case 't':
+    case 'f':
+        node->type = APR_JSON_BOOLEAN;
+        status = apr_json_decode_boolean(self, &node->u.boolean);
+        break;
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9': {
+        apr_json_value_t value;
+
+        if ((status = apr_json_decode_number(self, &value))) {
+            break;
+        }
+        node->type = value.type;
+        if (value.type == APR_JSON_LONG) {
+            node->u.lnumber = value.value.lnumber;
+        }
+        else {
+            node->u.dnumber = value.value.dnumber;
+        }
+        break;
+    }
+    default:
+        status = APR_BADCH;
+    }
+
+    if (status == APR_SUCCESS) {
+        self->p = json_scan_space(self->p, self->e);
+    }
+
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decode_tape(apr_json_tape_t **tape,
+                                               const char *injson,
+                                               apr_ssize_t injson_size,
+                                               apr_off_t *offset, int flags,
+                                               int level, apr_pool_t *pool)
+{
+    apr_status_t status;
+    apr_json_scanner_t scanner;
+    apr_array_header_t *nodes;
+
+    if (injson_size == APR_JSON_VALUE_STRING) {
+        injson_size = strlen(injson);
+    }
+
+    scanner.p = injson;
+    scanner.e = injson + injson_size;
+    scanner.pool = pool;
+    scanner.flags = flags & APR_JSON_FLAGS_LAZY;
+    scanner.level = level;
+
+    /* about a node per eight characters in the usual documents */
+    nodes = apr_array_make(pool, injson_size / 8 + 1, sizeof(apr_json_node_t));
+
+    if (APR_SUCCESS == (status = json_tape_value(&scanner, nodes))) {
+        if (scanner.p != scanner.e) {
+            /* trailing craft */
+            status = APR_BADCH;
+        }
+        else {
+            *tape = apr_palloc(pool, sizeof(apr_json_tape_t));
+            (*tape)->nodes = (apr_json_node_t *)nodes->elts;
+        }
+    }
+
+    if (offset) {
+        *offset = scanner.p - injson;
+    }
+
+    return status;
+}
+
+
+/* The incremental decoder reads the text character by character, except
+ * for the strings, numbers and literals (the tokens) decoded as above once
+ * complete, and kept in a buffer while they span chunks.
+ */
+typedef enum {
+    JSON_DECODER_VALUE,         /* a value */
+    JSON_DECODER_VALUE_OR_END,  /* a value or ']' */
+    JSON_DECODER_KEY,           /* a key */
+    JSON_DECODER_KEY_OR_END,    /* a key or '}' */
+    JSON_DECODER_COLON,         /* ':' */
+    JSON_DECODER_NEXT,          /* ',' or the end of the array or object */
+    JSON_DECODER_DONE           /* whitespace only */
+} json_decoder_state_e;
+
+typedef enum {
+    JSON_TOKEN_NONE,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_LITERAL
+} json_token_e;
+
+typedef struct json_frame_t {
+    apr_json_type_e type;
+    /* the array or object being built, if any */
+    apr_json_value_t *value;
+    /* the key of the value being decoded in an object */
+    apr_json_value_t *key;
+    /* the index of the value being decoded in an array */
+    apr_size_t index;
+    /* the paths matching so far, and still going on below */
+    apr_uint64_t alive;
+    /* whether the array or object matches no path */
+    int skip;
+} json_frame_t;
+
+struct apr_json_decoder_t {
+    apr_pool_t *pool;
+    apr_pool_t *scratch;
+    const apr_json_decoder_cb_t *cb;
+    void *ctx;
+    apr_json_value_t *result;
+    apr_array_header_t *frames;
+    char *tok;
+    apr_size_t toklen;
+    apr_size_t toksize;
+    apr_off_t offset;
+    apr_status_t status;
+    int depth;
+    int level;
+    json_decoder_state_e state;
+    json_token_e toktype;
+    int escaped;
+    /* a ',' was just read, the end may follow as with apr_json_decode() */
+    int comma;
+    apr_json_path_t *const *paths;
+    int npaths;
+    apr_json_path_cb path_cb;
+    void *path_ctx;
+};
+
+#define JSON_DECODER_POOL(dec) ((dec)->depth ? (dec)->scratch : (dec)->pool)
+#define JSON_DECODER_TOP(dec) ((dec)->frames->nelts \
+        ? &APR_ARRAY_IDX((dec)->frames, (dec)->frames->nelts - 1, json_frame_t) \
+        : NULL)
+#define JSON_DECODER_KEY(frame) \
+        ((frame) && (frame)->key ? &(frame)->key->value.string : NULL)
+
+#define JSON_NUMBER_CHAR(c) (JSON_DIGIT(c) || (c) == '-' || (c) == '+' \
+                             || (c) == '.' || (c) == 'e' || (c) == 'E')
+#define JSON_LITERAL_CHAR(c) ((c) >= 'a' && (c) <= 'z')
+
+/* Find the end of a token from p, past its closing quote for a string, or
+ * NULL if it goes on in the next chunk.
+ */
+static const char *json_token_end(json_token_e type, const char *p,
+                                  const char *e, int *escaped)
+{
+    switch (type) {
+    case JSON_TOKEN_STRING:
+        if (*escaped && p < e) {
+            *escaped = 0;
+            p++;
+        }
+        while ((p = json_scan_plain(p, e)) < e) {
+            if (*p == '"') {
+                return p + 1;
+            }
+            if (*p == '\\' && ++p == e) {
+                *escaped = 1;
+                break;
+            }
+            p++;
+        }
+        return NULL;
+    case JSON_TOKEN_NUMBER:
+        while (p < e && JSON_NUMBER_CHAR(*p)) {
+            p++;
+        }
+        break;
+    default:
+        while (p < e && JSON_LITERAL_CHAR(*p)) {
+            p++;
+        }
+        break;
+    }
+    return p < e ? p : NULL;
+}
+
+static void json_decoder_append(apr_json_decoder_t *dec, const char *p,
+                                apr_size_t len)
+{
+    if (dec->toklen + len >= dec->toksize) {
+        char *tok;
+
+        while (dec->toklen + len >= dec->toksize) {
+            dec->toksize *= 2;
+        }
+        tok = apr_palloc(dec->pool, dec->toksize);
+        memcpy(tok, dec->tok, dec->toklen);
+        dec->tok = tok;
+    }
+    memcpy(dec->tok + dec->toklen, p, len);
+    dec->toklen += len;
+    dec->tok[dec->toklen] = '\0';
+}
+
+static void json_decoder_clear(apr_json_decoder_t *dec)
+{
+    if (dec->depth) {
+        apr_pool_clear(dec->scratch);
+    }
+}
+
+static void json_decoder_next(apr_json_decoder_t *dec)
+{
+    json_frame_t *top = JSON_DECODER_TOP(dec);
+
+    if (top && top->type == APR_JSON_ARRAY) {
+        top->index++;
+    }
+    dec->state = top ? JSON_DECODER_NEXT : JSON_DECODER_DONE;
+}
+
+/* Match the value being decoded against the paths still alive in its
+ * parent, returning those ending with it, and setting those going on.
+ */
+static apr_uint64_t json_decoder_match(apr_json_decoder_t *dec,
+                                       json_frame_t *parent,
+                                       apr_uint64_t *alive)
+{
+    int depth = dec->frames->nelts, i;
+    apr_uint64_t mask, full = 0;
+    const char *key = NULL;
+    apr_size_t klen = 0;
+
+    if (parent) {
+        mask = parent->alive;
+        if (parent->type == APR_JSON_OBJECT) {
+            key = parent->key->value.string.p;
+            klen = parent->key->value.string.len;
+        }
+    }
+    else {
+        mask = (dec->npaths < 64) ? (APR_UINT64_C(1) << dec->npaths) - 1
+                                  : ~APR_UINT64_C(0);
+    }
+
+    *alive = 0;
+    for (i = 0; mask; i++, mask >>= 1) {
+        const apr_json_path_t *path = dec->paths[i];
+
+        if (!(mask & 1) || (parent
+                && !json_path_seg_match(&path->segs[depth - 1], key, klen,
+                                        parent->index))) {
+            continue;
+        }
+        if (path->nsegs == depth) {
+            full |= APR_UINT64_C(1) << i;
+        }
+        else {
+            *alive |= APR_UINT64_C(1) << i;
+        }
+    }
+
+    return full;
+}
+
+/* Add a complete value to the array or object being built, or pass it to
+ * the callback.
+ */
+static apr_status_t json_decoder_emit(apr_json_decoder_t *dec,
+                                      apr_json_value_t *val)
+{
+    json_frame_t *parent = JSON_DECODER_TOP(dec);
+    apr_status_t status = APR_SUCCESS;
+
+    if (parent && parent->value) {
+        if (parent->type == APR_JSON_ARRAY) {
+            return apr_json_array_add(parent->value, val);
+        }
+        status = apr_json_object_set_ex(parent->value, parent->key, val,
+                                        JSON_DECODER_POOL(dec));
+        parent->key = NULL;
+        return status;
+    }
+
+    if (dec->paths) {
+        apr_uint64_t alive, full = json_decoder_match(dec, parent, &alive);
+        int i;
+
+        for (i = 0; full && status == APR_SUCCESS; i++, full >>= 1) {
+            if (full & 1) {
+                status = dec->path_cb(dec->path_ctx, i, val);
+            }
+        }
+        if (parent) {
+            parent->key = NULL;
+        }
+        json_decoder_clear(dec);
+
+        return status;
+    }
+
+    if (!parent && !dec->depth) {
+        dec->result = val;
+    }
+    if (dec->cb && dec->cb->value) {
+        status = dec->cb->value(dec->ctx, JSON_DECODER_KEY(parent), val);
+    }
+    if (parent) {
+        parent->key = NULL;
+    }
+    json_decoder_clear(dec);
+
+    return status;
+}
+
+static apr_status_t json_decoder_open(apr_json_decoder_t *dec,
+                                      apr_json_type_e type)
+{
+    json_frame_t *parent = JSON_DECODER_TOP(dec), *frame;
+    apr_json_value_t *value = NULL;
+    apr_status_t status = APR_SUCCESS;
+    apr_uint64_t alive = 0;
+    int skip = 0;
+
+    if (dec->frames->nelts >= dec->level) {
+        return APR_EINVAL;
+    }
+
+    if (parent && parent->skip) {
+        skip = 1;
+    }
+    else if (dec->paths && !(parent && parent->value)) {
+        if (json_decoder_match(dec, parent, &alive)) {
+            /* matched, the key of the parent is needed once built */
+            value = (type == APR_JSON_OBJECT)
+                    ? apr_json_object_create(JSON_DECODER_POOL(dec))
+                    : apr_json_array_create(JSON_DECODER_POOL(dec), 0);
+            alive = 0;
+        }
+        else {
+            skip = !alive;
+            if (parent) {
+                parent->key = NULL;
+            }
+            json_decoder_clear(dec);
+        }
+    }
+    else if ((parent && parent->value)
+            || (dec->depth >= 0 && dec->frames->nelts >= dec->depth)) {
+        /* the key of the parent is needed once built */
+        value = (type == APR_JSON_OBJECT)
+                ? apr_json_object_create(JSON_DECODER_POOL(dec))
+                : apr_json_array_create(JSON_DECODER_POOL(dec), 0);
+    }
+    else {
+        if (dec->cb && dec->cb->start) {
+            status = dec->cb->start(dec->ctx, JSON_DECODER_KEY(parent), type);
+        }
+        if (parent) {
+            parent->key = NULL;
+        }
+        json_decoder_clear(dec);
+        if (status != APR_SUCCESS) {
+            return status;
+        }
+    }
+
+    frame = apr_array_push(dec->frames);
+    frame->type = type;
+    frame->value = value;
+    frame->key = NULL;
+    frame->index = 0;
+    frame->alive = alive;
+    frame->skip = skip;
+    dec->state = (type == APR_JSON_OBJECT) ? JSON_DECODER_KEY_OR_END
+                                           : JSON_DECODER_VALUE_OR_END;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t json_decoder_close(apr_json_decoder_t *dec,
+                                       apr_json_type_e type)
+{
+    json_frame_t *frame = JSON_DECODER_TOP(dec);
+    apr_json_value_t *value = frame->value;
+    apr_status_t status = APR_SUCCESS;
+
+    dec->frames->nelts--;
+    if (value) {
+        status = json_decoder_emit(dec, value);
+    }
+    else if (dec->cb && dec->cb->end) {
+        status = dec->cb->end(dec->ctx, type);
+        json_decoder_clear(dec);
+    }
+    json_decoder_next(dec);
+
+    return status;
+}
+
+static apr_status_t json_decoder_token(apr_json_decoder_t *dec,
+                                       const char *p, const char *e)
+{
+    json_frame_t *top = JSON_DECODER_TOP(dec);
+    apr_json_scanner_t scanner;
+    apr_json_value_t *val, skipped;
+    apr_status_t status;
+    int skip = top && top->skip;
+
+    scanner.pool = JSON_DECODER_POOL(dec);
+    scanner.p = p;
+    scanner.e = e;
+    scanner.flags = APR_JSON_FLAGS_NONE;
+    scanner.level = 0;
+
+    /* the skipped values are checked, but neither kept nor unescaped */
+    val = skip ? &skipped : apr_json_value_create(scanner.pool);
+
+    switch (dec->state) {
+    case JSON_DECODER_KEY:
+    case JSON_DECODER_KEY_OR_END:
+        if (*p != '"') {
+            return APR_BADCH;
+        }
+        if (skip) {
+            dec->state = JSON_DECODER_COLON;
+            return APR_SUCCESS;
+        }
+        val->type = APR_JSON_STRING;
+        status = apr_json_decode_string(&scanner, &val->value.string);
+        if (status == APR_SUCCESS && scanner.p != e) {
+            status = APR_BADCH;
+        }
+        if (status == APR_SUCCESS) {
+            JSON_DECODER_TOP(dec)->key = val;
+            dec->state = JSON_DECODER_COLON;
+        }
+        return status;
+    case JSON_DECODER_VALUE:
+    case JSON_DECODER_VALUE_OR_END:
+        break;
+    default:
+        return APR_BADCH;
+    }
+
+    switch (*p) {
+    case '"':
+        val->type = APR_JSON_STRING;
+        if (skip) {
+            scanner.p = e;
+            status = APR_SUCCESS;
+            break;
+        }
+        status = apr_json_decode_string(&scanner, &val->value.string);
+        break;
+    case 't':
+    case 'f':
+        val->type = APR_JSON_BOOLEAN;
+        status = apr_json_decode_boolean(&scanner, &val->value.boolean);
+        break;
+    case 'n':
+        val->type = APR_JSON_NULL;
+        status = apr_json_decode_null(&scanner);
+        break;
+    default:
+        status = apr_json_decode_number(&scanner, val);
+        break;
+    }
+    if (status == APR_SUCCESS && scanner.p != e) {
+        status = APR_BADCH;
+    }
+    if (status != APR_SUCCESS) {
+        return status;
+    }
+
+    status = skip ? APR_SUCCESS : json_decoder_emit(dec, val);
+    json_decoder_next(dec);
+
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_create(apr_json_decoder_t **dec,
+        const apr_json_decoder_cb_t *cb, void *ctx, int depth, int level,
+        apr_pool_t *pool)
+{
+    apr_json_decoder_t *d = apr_pcalloc(pool, sizeof(apr_json_decoder_t));
+    apr_status_t status;
+
+    status = apr_pool_create(&d->scratch, pool);
+    if (status != APR_SUCCESS) {
+        return status;
+    }
+    d->pool = pool;
+    d->cb = cb;
+    d->ctx = ctx;
+    d->depth = depth;
+    d->level = level;
+    d->frames = apr_array_make(pool, level < 16 ? level + 1 : 16,
+                               sizeof(json_frame_t));
+    d->toksize = 256;
+    d->tok = apr_palloc(pool, d->toksize);
+    d->state = JSON_DECODER_VALUE;
+
+    *dec = d;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_json_path_decoder_create(
+        apr_json_decoder_t **dec, apr_json_path_t *const *paths,
+        int npaths, apr_json_path_cb cb, void *ctx, int level,
+        apr_pool_t *pool)
+{
+    apr_status_t status;
+
+    if (npaths > 64) {
+        return APR_EINVAL;
+    }
+
+    status = apr_json_decoder_create(dec, NULL, NULL, APR_JSON_DECODER_NODOM,
+                                     level, pool);
+    if (status == APR_SUCCESS) {
+        (*dec)->paths = paths;
+        (*dec)->npaths = npaths;
+        (*dec)->path_cb = cb;
+        (*dec)->path_ctx = ctx;
+    }
+
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_feed(apr_json_decoder_t *dec,
+        const char *buf, apr_size_t len)
+{
+    const char *p = buf, *e = buf + len, *end;
+    apr_status_t status = APR_SUCCESS;
+    json_frame_t *top;
+    json_token_e type;
+
+    if (dec->status != APR_SUCCESS) {
+        return dec->status;
+    }
+
+    while (p < e && status == APR_SUCCESS) {
+        int comma = dec->comma;
+
+        if (dec->toktype != JSON_TOKEN_NONE) {
+            end = json_token_end(dec->toktype, p, e, &dec->escaped);
+            json_decoder_append(dec, p, (end ? end : e) - p);
+            if (!end) {
+                break;
+            }
+            p = end;
+            dec->toktype = JSON_TOKEN_NONE;
+            status = json_decoder_token(dec, dec->tok, dec->tok + dec->toklen);
+            if (status == APR_SUCCESS) {
+                dec->offset += dec->toklen;
+            }
+            dec->toklen = 0;
+            continue;
+        }
+
+        top = JSON_DECODER_TOP(dec);
+        dec->comma = 0;
+
+        switch (*(unsigned char *)p) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case '\v':
+        case '\f':
+            if (comma) {
+                /* the end may only follow the ',' immediately */
+                dec->state = (top->type == APR_JSON_OBJECT)
+                             ? JSON_DECODER_KEY : JSON_DECODER_VALUE;
+            }
+            end = json_scan_space(p, e);
+            dec->offset += end - p;
+            p = end;
+            continue;
+        case '{':
+        case '[':
+            if (dec->state != JSON_DECODER_VALUE
+                    && dec->state != JSON_DECODER_VALUE_OR_END) {
+                status = APR_BADCH;
+                break;
+            }
+            status = json_decoder_open(dec, *p == '{' ? APR_JSON_OBJECT
+                                                      : APR_JSON_ARRAY);
+            break;
+        case '}':
+            if (dec->state != JSON_DECODER_KEY_OR_END
+                    && (dec->state != JSON_DECODER_NEXT
+                        || top->type != APR_JSON_OBJECT)) {
+                status = APR_BADCH;
+                break;
+            }
+            status = json_decoder_close(dec, APR_JSON_OBJECT);
+            break;
+        case ']':
+            if (dec->state != JSON_DECODER_VALUE_OR_END
+                    && (dec->state != JSON_DECODER_NEXT
+                        || top->type != APR_JSON_ARRAY)) {
+                status = APR_BADCH;
+                break;
+            }
+            status = json_decoder_close(dec, APR_JSON_ARRAY);
+            break;
+        case ',':
+            if (dec->state != JSON_DECODER_NEXT) {
+                status = APR_BADCH;
+                break;
+            }
+            dec->state = (top->type == APR_JSON_OBJECT)
+                         ? JSON_DECODER_KEY_OR_END : JSON_DECODER_VALUE_OR_END;
+            dec->comma = 1;
+            break;
+        case ':':
+            if (dec->state != JSON_DECODER_COLON) {
+                status = APR_BADCH;
+                break;
+            }
+            dec->state = JSON_DECODER_VALUE;
+            break;
+        default:
+            if (*p == '"') {
+                type = JSON_TOKEN_STRING;
+                end = json_token_end(type, p + 1, e, &dec->escaped);
+            }
+            else if (*p == '-' || JSON_DIGIT(*p)) {
+                type = JSON_TOKEN_NUMBER;
+                end = json_token_end(type, p, e, &dec->escaped);
+            }
+            else if (JSON_LITERAL_CHAR(*p)) {
+                type = JSON_TOKEN_LITERAL;
+                end = json_token_end(type, p, e, &dec->escaped);
+            }
+            else {
+                status = APR_BADCH;
+                break;
+            }
+            if (!end) {
+                /* to be continued */
+                dec->toktype = type;
+                json_decoder_append(dec, p, e - p);
+                p = e;
+                continue;
+            }
+            status = json_decoder_token(dec, p, end);
+            if (status == APR_SUCCESS) {
+                dec->offset += end - p;
+            }
+            p = end;
+            continue;
+        }
+
+        if (status == APR_SUCCESS) {
+            dec->offset++;
+            p++;
+        }
+    }
+
+    if (status == APR_EOF) {
+        /* a complete token */
+        status = APR_BADCH;
+    }
+    dec->status = status;
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_feed_brigade(
+        apr_json_decoder_t *dec, apr_bucket_brigade *bb)
+{
+    apr_status_t status = APR_SUCCESS;
+
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        apr_bucket *b = APR_BRIGADE_FIRST(bb);
+        const char *data;
+        apr_size_t len;
+
+        if (APR_BUCKET_IS_EOS(b)) {
+            return apr_json_decoder_finish(dec, NULL);
+        }
+        if (!APR_BUCKET_IS_METADATA(b)) {
+            status = apr_bucket_read(b, &data, &len, APR_BLOCK_READ);
+            if (status == APR_SUCCESS) {
+                status = apr_json_decoder_feed(dec, data, len);
+            }
+            if (status != APR_SUCCESS) {
+                return status;
+            }
+        }
+        apr_bucket_delete(b);
+    }
+
+    return status;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_finish(apr_json_decoder_t *dec,
+        apr_json_value_t **result)
+{
+    apr_status_t status = dec->status;
+
+    if (status == APR_SUCCESS && dec->toktype != JSON_TOKEN_NONE) {
+        if (dec->toktype == JSON_TOKEN_STRING) {
+            status = APR_EOF;
+        }
+        else {
+            status = json_decoder_token(dec, dec->tok,
+                                        dec->tok + dec->toklen);
+            if (status == APR_SUCCESS) {
+                dec->offset += dec->toklen;
+            }
+            dec->toktype = JSON_TOKEN_NONE;
+            dec->toklen = 0;
+        }
+    }
+    if (status == APR_SUCCESS && dec->state != JSON_DECODER_DONE) {
+        status = APR_EOF;
+    }
+    dec->status = status;
+
+    if (result) {
+        *result = (status == APR_SUCCESS) ? dec->result : NULL;
+    }
+    return status;
+}
+
+APR_DECLARE(apr_off_t) apr_json_decoder_offset(apr_json_decoder_t *dec)
+{
+    return dec->offset;
+}
+
 #else
 /* we do not yet support JSON on EBCDIC platforms, but will do in future */
 apr_status_t apr_json_decode(apr_json_value_t ** retval, const char *injson,
@@ -816,4 +1815,48 @@ apr_status_t apr_json_decode(apr_json_value_t ** retval, const char *injson,
 {
     return APR_ENOTIMPL;
 }
+APR_DECLARE(apr_status_t) apr_json_decode_tape(apr_json_tape_t **tape,
+        const char *injson, apr_ssize_t injson_size, apr_off_t *offset,
+        int flags, int level, apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_create(apr_json_decoder_t **dec,
+        const apr_json_decoder_cb_t *cb, void *ctx, int depth, int level,
+        apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_json_path_decoder_create(
+        apr_json_decoder_t **dec, apr_json_path_t *const *paths,
+        int npaths, apr_json_path_cb cb, void *ctx, int level,
+        apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_feed(apr_json_decoder_t *dec,
+        const char *buf, apr_size_t len)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_feed_brigade(
+        apr_json_decoder_t *dec, apr_bucket_brigade *bb)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_json_decoder_finish(apr_json_decoder_t *dec,
+        apr_json_value_t **result)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_off_t) apr_json_decoder_offset(apr_json_decoder_t *dec)
+{
+    return 0;
+}
 #endif
@@ -15,137 +15,280 @@
  */
 
 #include "apr_json.h"
+#include "apr_json_private.h"
+#include "apr_strings.h"
+
+#define APR_WANT_MEMFUNC
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
 
 #if !APR_CHARSET_EBCDIC
 
+/* The serializer writes straight into the spare room of the heap bucket
+ * at the end of the brigade, as apr_brigade_write() would, and settles
+ * the bucket's length when it is full or the encoding is done, calling
+ * the flush function in between.
+ */
 typedef struct apr_json_serializer_t {
     apr_pool_t *pool;
     apr_bucket_brigade *brigade;
     apr_brigade_flush flush;
     void *ctx;
     int flags;
+    apr_bucket *e;
+    char *base;
+    char *p;
+    char *end;
 } apr_json_serializer_t;
 
+/* Below this the spare room of a heap bucket is not worth reusing */
+#define JSON_ROOM_MIN 64
+
 static apr_status_t apr_json_encode_value(apr_json_serializer_t * self,
                                             const apr_json_value_t * value);
 
-static apr_status_t apr_json_brigade_write(apr_json_serializer_t * self,
-               const char *chunk, apr_size_t chunk_len, const char *escaped)
+static void json_buffer_settle(apr_json_serializer_t * self)
 {
-    apr_status_t status;
+    if (self->e) {
+        self->e->length = self->p - self->base;
+        self->e = NULL;
+        self->base = self->p = self->end = NULL;
+    }
+}
 
-    status = apr_brigade_write(self->brigade, self->flush, self->ctx, chunk, chunk_len);
-    if (APR_SUCCESS == status) {
-        status = apr_brigade_puts(self->brigade, self->flush, self->ctx, escaped);
+static apr_status_t json_buffer_next(apr_json_serializer_t * self)
+{
+    apr_bucket_brigade *bb = self->brigade;
+    apr_bucket_heap *h;
+    apr_bucket *e;
+
+    if (self->e) {
+        json_buffer_settle(self);
+        if (self->flush) {
+            apr_status_t status = self->flush(bb, self->ctx);
+            if (APR_SUCCESS != status) {
+                return status;
+            }
+        }
     }
 
-    return status;
+    e = APR_BRIGADE_LAST(bb);
+    if (APR_BRIGADE_EMPTY(bb) || !APR_BUCKET_IS_HEAP(e)
+            || ((apr_bucket_heap *)(e->data))->refcount.refcount != 1
+            || ((apr_bucket_heap *)(e->data))->alloc_len
+                    - (e->length + (apr_size_t)e->start) < JSON_ROOM_MIN) {
+        char *buf = apr_bucket_alloc(APR_BUCKET_BUFF_SIZE, bb->bucket_alloc);
+
+        e = apr_bucket_heap_create(buf, APR_BUCKET_BUFF_SIZE,
+                                   apr_bucket_free, bb->bucket_alloc);
+        e->length = 0;
+        APR_BRIGADE_INSERT_TAIL(bb, e);
+    }
+
+    h = e->data;
+    self->e = e;
+    self->base = h->base + e->start;
+    self->p = self->base + e->length;
+    self->end = h->base + h->alloc_len;
+
+    return APR_SUCCESS;
 }
 
-static apr_status_t apr_json_brigade_printf(apr_json_serializer_t * self,
-               const char *chunk, apr_size_t chunk_len, const char *fmt, ...)
+static apr_status_t json_write(apr_json_serializer_t * self,
+                               const char *chunk, apr_size_t chunk_len)
 {
-    va_list ap;
-    apr_status_t status;
+    while (chunk_len > (apr_size_t)(self->end - self->p)) {
+        apr_size_t room = self->end - self->p;
+        apr_status_t status;
+
+        if (room) {
+            memcpy(self->p, chunk, room);
+            self->p += room;
+            chunk += room;
+            chunk_len -= room;
+        }
+        status = json_buffer_next(self);
+        if (APR_SUCCESS != status) {
+            return status;
+        }
+    }
+    memcpy(self->p, chunk, chunk_len);
+    self->p += chunk_len;
 
-    status = apr_brigade_write(self->brigade, self->flush, self->ctx, chunk,
-            chunk_len);
-    if (APR_SUCCESS == status) {
-        va_start(ap, fmt);
-        status = apr_brigade_vprintf(self->brigade, self->flush, self->ctx, fmt,
-                ap);
-        va_end(ap);
+    return APR_SUCCESS;
+}
+
+static APR_INLINE apr_status_t json_putc(apr_json_serializer_t * self,
+                                         char c)
+{
+    if (self->p == self->end) {
+        apr_status_t status = json_buffer_next(self);
+        if (APR_SUCCESS != status) {
+            return status;
+        }
     }
+    *self->p++ = c;
 
-    return status;
+    return APR_SUCCESS;
+}
+
+static APR_INLINE apr_status_t json_puts(apr_json_serializer_t * self,
+                                         const char *str)
+{
+    return json_write(self, str, strlen(str));
+}
+
+/* Skip the string bytes needing no escape nor UTF-8 validation, that is
+ * anything but '"', '\\', the control characters and the non-ASCII bytes.
+ */
+#define JSON_UNESCAPED(c) ((c) >= 0x20 && (c) < 0x80 && (c) != '"' \
+                           && (c) != '\\')
+
+static const char *json_scan_unescaped(const char *p, const char *e)
+{
+#if JSON_SCAN_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(0x20);
+
+    while (e - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        /* A signed comparison flags both control and non-ASCII bytes */
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(v, space),
+                       _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                    _mm_cmpeq_epi8(v, bslash))));
+        if (mask) {
+            return p + json_ctz((apr_uint64_t)mask);
+        }
+        p += 16;
+    }
+#elif JSON_SCAN_NEON
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t bslash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    const uint8x16_t high = vdupq_n_u8(0x80);
+
+    while (e - p >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        apr_uint64_t mask = json_neon_mask(vorrq_u8(
+                vorrq_u8(vcltq_u8(v, space), vcgeq_u8(v, high)),
+                vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, bslash))));
+        if (mask) {
+            return p + json_ctz(mask) / 4;
+        }
+        p += 16;
+    }
+#endif
+    while (e - p >= 8) {
+        apr_uint64_t x;
+
+        memcpy(&x, p, 8);
+        if ((x & JSON_HIGHS) || JSON_HASLESS(x, 0x20)
+                || JSON_HASBYTE(x, '"') || JSON_HASBYTE(x, '\\')) {
+            break;
+        }
+        p += 8;
+    }
+    while (p < e && JSON_UNESCAPED(*(const unsigned char *)p)) {
+        p++;
+    }
+    return p;
+}
+
+/* The short escapes of the control characters, zero for \u00XX */
+static const char json_ctrl_escapes[0x20] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 'b', 't', 'n', 0, 'f', 'r', 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const char json_hex[] = "0123456789abcdef";
+
+/* The length of the well formed UTF-8 sequence at p, or zero */
+static apr_size_t json_utf8_len(const unsigned char *p,
+                                const unsigned char *e)
+{
+    apr_size_t n, i;
+
+    if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+        n = 2;
+    }
+    else if (p[0] >= 0xe0 && p[0] <= 0xef) {
+        n = 3;
+    }
+    else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+        n = 4;
+    }
+    else {
+        return 0;
+    }
+    if ((apr_size_t)(e - p) < n) {
+        return 0;
+    }
+    for (i = 1; i < n; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+
+    return n;
 }
 
 static apr_status_t apr_json_encode_string(apr_json_serializer_t * self,
         const apr_json_string_t * string)
 {
     apr_status_t status;
-    const char *p, *e, *chunk;
-    const char invalid[4] = { 0xEF, 0xBF, 0xBD, 0x00 };
+    const char *p, *e, *run;
+    const char invalid[3] = { 0xEF, 0xBF, 0xBD };
+    char esc[6] = { '\\', 'u', '0', '0' };
     unsigned char c;
+    apr_size_t n;
 
-    status = apr_brigade_putc(self->brigade, self->flush, self->ctx, '\"');
+    status = json_putc(self, '\"');
     if (APR_SUCCESS != status) {
         return status;
     }
 
-    for (p = chunk = string->p, e = string->p
-            + (APR_JSON_VALUE_STRING == string->len ?
-                    strlen(string->p) : string->len); p < e; p++) {
-        switch (*p) {
-        case '\n':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\n");
-            chunk = p + 1;
-            break;
-        case '\r':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\r");
-            chunk = p + 1;
-            break;
-        case '\t':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\t");
-            chunk = p + 1;
-            break;
-        case '\b':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\b");
-            chunk = p + 1;
-            break;
-        case '\f':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\f");
-            chunk = p + 1;
-            break;
-        case '\\':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\\\");
-            chunk = p + 1;
-            break;
-        case '"':
-            status = apr_json_brigade_write(self, chunk, p - chunk, "\\\"");
-            chunk = p + 1;
+    p = string->p;
+    e = p + (APR_JSON_VALUE_STRING == string->len ?
+            strlen(string->p) : string->len);
+    for (;;) {
+        run = json_scan_unescaped(p, e);
+        status = json_write(self, p, run - p);
+        if (APR_SUCCESS != status) {
+            return status;
+        }
+        p = run;
+        if (p >= e) {
             break;
-        default:
-            c = (unsigned char)(*p);
-            apr_size_t left = e - p;
-            if (c < 0x20) {
-                status = apr_json_brigade_printf(self, chunk, p - chunk,
-                        "\\u%04x", c);
-                chunk = p + 1;
-            }
-            else if (((c >> 7) == 0x00)) {
-                /* 1 byte */
-            }
-            else if (left > 1 && ((c >> 5) == 0x06) && p[1]) {
-                /* 2 bytes */
-                if (left < 2 || (p[1] >> 6) != 0x02) {
-                    status = apr_json_brigade_write(self, chunk, p - chunk,
-                            invalid);
-                    chunk = p + 1;
-                }
-            }
-            else if (((c >> 4) == 0x0E)) {
-                /* 3 bytes */
-                if (left < 3 || (p[1] >> 6) != 0x02 || (p[2] >> 6) != 0x02) {
-                    status = apr_json_brigade_write(self, chunk, p - chunk,
-                            invalid);
-                    chunk = p + 1;
-                }
-            }
-            else if ((c >> 3) == 0x1E) {
-                /* 4 bytes */
-                if (left < 4 || (p[1] >> 6) != 0x02 || (p[2] >> 6) != 0x02 || (p[3] >> 6) != 0x02) {
-                    status = apr_json_brigade_write(self, chunk, p - chunk,
-                            invalid);
-                    chunk = p + 1;
-                }
+        }
+
+        c = (unsigned char)(*p);
+        if (c == '"' || c == '\\') {
+            esc[1] = c;
+            status = json_write(self, esc, 2);
+            p++;
+        }
+        else if (c < 0x20) {
+            if (json_ctrl_escapes[c]) {
+                esc[1] = json_ctrl_escapes[c];
+                status = json_write(self, esc, 2);
             }
             else {
-                status = apr_json_brigade_write(self, chunk, p - chunk,
-                        invalid);
-                chunk = p + 1;
+                esc[1] = 'u';
+                esc[4] = json_hex[c >> 4];
+                esc[5] = json_hex[c & 0xf];
+                status = json_write(self, esc, 6);
             }
-            break;
+            p++;
+        }
+        else if ((n = json_utf8_len((const unsigned char *)p,
+                                    (const unsigned char *)e))) {
+            status = json_write(self, p, n);
+            p += n;
+        }
+        else {
+            status = json_write(self, invalid, sizeof(invalid));
+            p++;
         }
 
         if (APR_SUCCESS != status) {
@@ -153,14 +296,69 @@ static apr_status_t apr_json_encode_string(apr_json_serializer_t * self,
         }
     }
 
-    if (chunk < p) {
-        status = apr_brigade_write(self->brigade, self->flush, self->ctx, chunk, p - chunk);
-        if (APR_SUCCESS != status) {
-            return status;
-        }
+    return json_putc(self, '\"');
+}
+
+static const char json_digits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Format n backwards from the end of a 20 bytes buffer at least */
+static char *json_format_digits(char *end, apr_uint64_t n)
+{
+    char *p = end;
+
+    while (n >= 100) {
+        const char *d = json_digits + (n % 100) * 2;
+        n /= 100;
+        *--p = d[1];
+        *--p = d[0];
+    }
+    if (n >= 10) {
+        *--p = json_digits[n * 2 + 1];
+        *--p = json_digits[n * 2];
+    }
+    else {
+        *--p = (char)('0' + n);
     }
 
-    return apr_brigade_putc(self->brigade, self->flush, self->ctx, '\"');
+    return p;
+}
+
+static apr_status_t apr_json_encode_long(apr_json_serializer_t * self,
+                                         apr_int64_t lnumber)
+{
+    char buf[24], *end = buf + sizeof(buf), *p;
+
+    if (lnumber < 0) {
+        p = json_format_digits(end, 0 - (apr_uint64_t)lnumber);
+        *--p = '-';
+    }
+    else {
+        p = json_format_digits(end, (apr_uint64_t)lnumber);
+    }
+
+    return json_write(self, p, end - p);
+}
+
+static apr_status_t apr_json_encode_double(apr_json_serializer_t * self,
+                                           double dnumber)
+{
+    char buf[APR_DTOA_SIZE + 2];
+    apr_size_t len = apr_dtoa(buf, dnumber);
+
+    if (buf[len - 1] == 'f' || buf[len - 1] == 'n') {
+        /* JSON knows no infinities nor NaNs */
+        return json_write(self, "null", 4);
+    }
+    if (!strpbrk(buf, ".e")) {
+        /* for the value to decode as a double again */
+        memcpy(buf + len, ".0", 2);
+        len += 2;
+    }
+
+    return json_write(self, buf, len);
 }
 
 
@@ -171,7 +369,7 @@ static apr_status_t apr_json_encode_array(apr_json_serializer_t * self,
     apr_json_value_t *val;
     apr_size_t count = 0;
 
-    status = apr_brigade_putc(self->brigade, self->flush, self->ctx, '[');
+    status = json_putc(self, '[');
     if (APR_SUCCESS != status) {
         return status;
     }
@@ -180,7 +378,7 @@ static apr_status_t apr_json_encode_array(apr_json_serializer_t * self,
     while (val) {
 
         if (count > 0) {
-            status = apr_brigade_putc(self->brigade, self->flush, self->ctx, ',');
+            status = json_putc(self, ',');
             if (APR_SUCCESS != status) {
                 return status;
             }
@@ -195,7 +393,7 @@ static apr_status_t apr_json_encode_array(apr_json_serializer_t * self,
         count++;
     }
 
-    return apr_brigade_putc(self->brigade, self->flush, self->ctx, ']');
+    return json_putc(self, ']');
 }
 
 static apr_status_t apr_json_encode_object(apr_json_serializer_t * self, apr_json_object_t * object)
@@ -203,17 +401,20 @@ static apr_status_t apr_json_encode_object(apr_json_serializer_t * self, apr_jso
     apr_status_t status;
     apr_json_kv_t *kv;
     int first = 1;
-    status = apr_brigade_putc(self->brigade, self->flush, self->ctx, '{');
+    status = json_putc(self, '{');
     if (APR_SUCCESS != status) {
         return status;
     }
 
+    /* no duplicate key from a lazy decoding */
+    apr__json_object_hash(object);
+
     for (kv = APR_RING_FIRST(&(object)->list);
          kv != APR_RING_SENTINEL(&(object)->list, apr_json_kv_t, link);
          kv = APR_RING_NEXT((kv), link)) {
 
         if (!first) {
-            status = apr_brigade_putc(self->brigade, self->flush, self->ctx, ',');
+            status = json_putc(self, ',');
             if (APR_SUCCESS != status) {
                 return status;
             }
@@ -225,7 +426,7 @@ static apr_status_t apr_json_encode_object(apr_json_serializer_t * self, apr_jso
                 return status;
             }
 
-            status = apr_brigade_putc(self->brigade, self->flush, self->ctx, ':');
+            status = json_putc(self, ':');
             if (APR_SUCCESS != status) {
                 return status;
             }
@@ -237,7 +438,7 @@ static apr_status_t apr_json_encode_object(apr_json_serializer_t * self, apr_jso
         }
         first = 0;
     }
-    return apr_brigade_putc(self->brigade, self->flush, self->ctx, '}');
+    return json_putc(self, '}');
 }
 
 static apr_status_t apr_json_encode_value(apr_json_serializer_t * self, const apr_json_value_t * value)
@@ -245,8 +446,7 @@ static apr_status_t apr_json_encode_value(apr_json_serializer_t * self, const ap
     apr_status_t status = APR_SUCCESS;
 
     if (value->pre && (self->flags & APR_JSON_FLAGS_WHITESPACE)) {
-        status = apr_brigade_puts(self->brigade, self->flush, self->ctx,
-                value->pre);
+        status = json_puts(self, value->pre);
     }
 
     if (APR_SUCCESS == status) {
@@ -255,20 +455,17 @@ static apr_status_t apr_json_encode_value(apr_json_serializer_t * self, const ap
             status = apr_json_encode_string(self, &value->value.string);
             break;
         case APR_JSON_LONG:
-            status = apr_brigade_printf(self->brigade, self->flush, self->ctx,
-                    "%" APR_INT64_T_FMT, value->value.lnumber);
+            status = apr_json_encode_long(self, value->value.lnumber);
             break;
         case APR_JSON_DOUBLE:
-            status = apr_brigade_printf(self->brigade, self->flush, self->ctx,
-                    "%lf", value->value.dnumber);
+            status = apr_json_encode_double(self, value->value.dnumber);
             break;
         case APR_JSON_BOOLEAN:
-            status = apr_brigade_puts(self->brigade, self->flush, self->ctx,
-                    value->value.boolean ? "true" : "false");
+            status = value->value.boolean ? json_write(self, "true", 4)
+                                          : json_write(self, "false", 5);
             break;
         case APR_JSON_NULL:
-            status = apr_brigade_puts(self->brigade, self->flush, self->ctx,
-                    "null");
+            status = json_write(self, "null", 4);
             break;
         case APR_JSON_OBJECT:
             status = apr_json_encode_object(self, value->value.object);
@@ -283,8 +480,7 @@ static apr_status_t apr_json_encode_value(apr_json_serializer_t * self, const ap
 
     if (APR_SUCCESS == status && value->post
             && (self->flags & APR_JSON_FLAGS_WHITESPACE)) {
-        status = apr_brigade_puts(self->brigade, self->flush, self->ctx,
-                value->post);
+        status = json_puts(self, value->post);
     }
 
     return status;
@@ -296,7 +492,12 @@ APR_DECLARE(apr_status_t) apr_json_encode(apr_bucket_brigade * brigade,
                                           int flags, apr_pool_t * pool)
 {
     apr_json_serializer_t serializer = {pool, brigade, flush, ctx, flags};
-    return apr_json_encode_value(&serializer, json);
+    apr_status_t status;
+
+    status = apr_json_encode_value(&serializer, json);
+    json_buffer_settle(&serializer);
+
+    return status;
 }
 
 #else
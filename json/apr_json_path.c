@@ -0,0 +1,181 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_json.h"
+#include "apr_json_private.h"
+
+/* The longest array index we parse, below APR_SSIZE_MAX on 32 bits too */
+#define JSON_PATH_INDEX_DIGITS 9
+
+APR_DECLARE(apr_status_t) apr_json_path_compile(apr_json_path_t **path,
+        const char *expr, apr_pool_t *pool)
+{
+    apr_json_path_t *jp;
+    const char *s, *e;
+    int n = 0;
+
+    if (*expr && *expr != '/') {
+        return APR_EINVAL;
+    }
+
+    for (s = expr; *s; s++) {
+        if (*s == '/') {
+            n++;
+        }
+    }
+
+    jp = apr_pcalloc(pool, sizeof(apr_json_path_t));
+    jp->expr = apr_pstrdup(pool, expr);
+    jp->segs = apr_pcalloc(pool, (n ? n : 1) * sizeof(json_path_seg_t));
+
+    for (s = expr; *s; s = e) {
+        json_path_seg_t *seg = &jp->segs[jp->nsegs++];
+        char *key, *k;
+
+        s++; /* the '/' */
+        e = strchr(s, '/');
+        if (!e) {
+            e = s + strlen(s);
+        }
+
+        k = key = apr_palloc(pool, e - s + 1);
+        for (; s < e; s++) {
+            if (*s != '~') {
+                *k++ = *s;
+            }
+            else if (s[1] == '0' || s[1] == '1') {
+                *k++ = (*++s == '0') ? '~' : '/';
+            }
+            else {
+                return APR_BADCH;
+            }
+        }
+        *k = '\0';
+
+        seg->key = key;
+        seg->klen = k - key;
+        seg->wildcard = (seg->klen == 1 && key[0] == '*');
+        seg->index = -1;
+
+        /* a number without leading zeros may also be an array index */
+        if (seg->klen && seg->klen <= JSON_PATH_INDEX_DIGITS
+                && (key[0] != '0' || seg->klen == 1)) {
+            apr_ssize_t index = 0;
+
+            for (k = key; *k >= '0' && *k <= '9'; k++) {
+                index = index * 10 + (*k - '0');
+            }
+            if (!*k) {
+                seg->index = index;
+            }
+        }
+    }
+
+    *path = jp;
+    return APR_SUCCESS;
+}
+
+static apr_json_value_t *json_path_array_get(apr_json_value_t *arr,
+                                             apr_ssize_t index)
+{
+    apr_array_header_t *array = arr->value.array->array;
+    apr_json_value_t *val;
+
+    if (array) {
+        return index < array->nelts
+                ? APR_ARRAY_IDX(array, index, apr_json_value_t *) : NULL;
+    }
+
+    for (val = apr_json_array_first(arr); val && index--;
+         val = apr_json_array_next(arr, val));
+
+    return val;
+}
+
+/* Walk down the path from its segment i, pushing the matches if any, or
+ * returning the first one otherwise.
+ */
+static apr_json_value_t *json_path_walk(const apr_json_path_t *path, int i,
+                                        apr_json_value_t *json,
+                                        apr_array_header_t *matches)
+{
+    const json_path_seg_t *seg;
+    apr_json_value_t *found;
+
+    if (i == path->nsegs) {
+        if (matches) {
+            APR_ARRAY_PUSH(matches, apr_json_value_t *) = json;
+        }
+        return json;
+    }
+
+    seg = &path->segs[i];
+    switch (json->type) {
+    case APR_JSON_OBJECT: {
+        apr_json_kv_t *kv;
+
+        if (!seg->wildcard) {
+            kv = apr_json_object_get(json, seg->key, seg->klen);
+            return kv ? json_path_walk(path, i + 1, kv->v, matches) : NULL;
+        }
+        for (kv = apr_json_object_first(json); kv;
+             kv = apr_json_object_next(json, kv)) {
+            found = json_path_walk(path, i + 1, kv->v, matches);
+            if (found && !matches) {
+                return found;
+            }
+        }
+        break;
+    }
+    case APR_JSON_ARRAY: {
+        apr_json_value_t *val;
+
+        if (!seg->wildcard) {
+            val = seg->index >= 0 ? json_path_array_get(json, seg->index)
+                                  : NULL;
+            return val ? json_path_walk(path, i + 1, val, matches) : NULL;
+        }
+        for (val = apr_json_array_first(json); val;
+             val = apr_json_array_next(json, val)) {
+            found = json_path_walk(path, i + 1, val, matches);
+            if (found && !matches) {
+                return found;
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+APR_DECLARE(apr_json_value_t *) apr_json_path_get(
+        const apr_json_path_t *path, apr_json_value_t *json)
+{
+    return json_path_walk(path, 0, json, NULL);
+}
+
+APR_DECLARE(int) apr_json_path_eval(const apr_json_path_t *path,
+        apr_json_value_t *json, apr_array_header_t *matches)
+{
+    int nelts = matches->nelts;
+
+    json_path_walk(path, 0, json, matches);
+
+    return matches->nelts - nelts;
+}
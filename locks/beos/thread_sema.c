@@ -0,0 +1 @@
+#include "../unix/thread_sema.c"
@@ -177,5 +177,11 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_destroy(apr_thread_mutex_t *mutex)
     return stat;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_mutex_name_set(apr_thread_mutex_t *mutex,
+                                                    const char *name)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_POOL_IMPLEMENT_ACCESSOR(thread_mutex)
 
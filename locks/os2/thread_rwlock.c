@@ -61,6 +61,13 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
 
 
 
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
+{
+    return apr_thread_rwlock_create(rwlock, pool);
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_rdlock(apr_thread_rwlock_t *rwlock)
 {
     ULONG rc, posts;
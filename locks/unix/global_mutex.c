@@ -47,6 +47,15 @@ APR_DECLARE(apr_status_t) apr_global_mutex_create(apr_global_mutex_t **mutex,
                                                   const char *fname,
                                                   apr_lockmech_e mech,
                                                   apr_pool_t *pool)
+{
+    return apr_global_mutex_create_ex(mutex, fname, mech, 0, pool);
+}
+
+APR_DECLARE(apr_status_t) apr_global_mutex_create_ex(apr_global_mutex_t **mutex,
+                                                     const char *fname,
+                                                     apr_lockmech_e mech,
+                                                     int flags,
+                                                     apr_pool_t *pool)
 {
     apr_status_t rv;
     apr_global_mutex_t *m;
@@ -60,7 +69,8 @@ APR_DECLARE(apr_status_t) apr_global_mutex_create(apr_global_mutex_t **mutex,
     }
 
 #if APR_HAS_THREADS
-    if (m->proc_mutex->meth->flags & APR_PROCESS_LOCK_MECH_IS_GLOBAL) {
+    if ((m->proc_mutex->meth->flags & APR_PROCESS_LOCK_MECH_IS_GLOBAL)
+            || (flags & APR_GLOBAL_MUTEX_UNTHREADED)) {
         m->thread_mutex = NULL; /* We don't need a thread lock. */
     }
     else {
@@ -228,6 +238,20 @@ APR_DECLARE(const char *) apr_global_mutex_name(apr_global_mutex_t *mutex)
     return apr_proc_mutex_name(mutex->proc_mutex);
 }
 
+APR_DECLARE(apr_status_t) apr_global_mutex_name_set(apr_global_mutex_t *mutex,
+                                                    const char *name)
+{
+    apr_status_t rv;
+
+    rv = apr_proc_mutex_name_set(mutex->proc_mutex, name);
+#if APR_HAS_THREADS
+    if (rv == APR_SUCCESS && mutex->thread_mutex) {
+        rv = apr_thread_mutex_name_set(mutex->thread_mutex, name);
+    }
+#endif
+    return rv;
+}
+
 APR_PERMS_SET_IMPLEMENT(global_mutex)
 {
     apr_status_t rv;
@@ -0,0 +1,206 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "apr_arch_mutex_stats.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>             /* for qsort */
+#endif
+
+/* The named mutexes of the process, the list being locked by a spinlock
+ * since the mutexes themselves may be named.
+ */
+static apr_mutex_profile_t *profiles;
+static volatile apr_uint32_t profiles_lock;
+
+static void profiles_acquire(void)
+{
+    while (apr_atomic_cas32(&profiles_lock, 1, 0)) {
+#if APR_HAS_THREADS
+        apr_thread_yield();
+#endif
+    }
+}
+
+static void profiles_release(void)
+{
+    apr_atomic_set32(&profiles_lock, 0);
+}
+
+static apr_status_t profile_cleanup(void *data)
+{
+    apr_mutex_profile_t *profile = data, **ref;
+
+    profiles_acquire();
+    for (ref = &profiles; *ref; ref = &(*ref)->next) {
+        if (*ref == profile) {
+            *ref = profile->next;
+            break;
+        }
+    }
+    profiles_release();
+    return APR_SUCCESS;
+}
+
+apr_status_t apr_mutex_profile_name(apr_mutex_profile_t **profile,
+                                    const char *name, const char *kind,
+                                    apr_pool_t *pool)
+{
+    apr_mutex_profile_t *new_profile = *profile;
+
+    if (!name) {
+        return APR_EINVAL;
+    }
+    if (new_profile) {
+        new_profile->stats.name = name;
+        return APR_SUCCESS;
+    }
+
+    new_profile = apr_pcalloc(pool, sizeof(*new_profile));
+    new_profile->stats.name = name;
+    new_profile->stats.kind = kind;
+    apr_pool_cleanup_register(pool, new_profile, profile_cleanup,
+                              apr_pool_cleanup_null);
+
+    profiles_acquire();
+    new_profile->next = profiles;
+    profiles = new_profile;
+    profiles_release();
+
+    /* Enabled once registered */
+    *profile = new_profile;
+    return APR_SUCCESS;
+}
+
+void apr_mutex_profile_locked(apr_mutex_profile_t *profile,
+                              apr_time_t start, const void *site,
+                              const void *holder)
+{
+    apr_mutex_stats_t *stats = &profile->stats;
+
+    stats->locks++;
+    if (start) {
+        apr_interval_time_t wait = apr_time_now() - start;
+
+        stats->contended++;
+        stats->wait_time += wait;
+        if (wait >= stats->wait_max) {
+            stats->wait_max = wait;
+            stats->wait_max_site = site;
+            stats->wait_max_holder = holder;
+        }
+    }
+    profile->holder = site;
+}
+
+APR_DECLARE(void) apr_mutex_stats_do(apr_mutex_stats_do_fn_t *fn,
+                                     void *baton)
+{
+    apr_mutex_profile_t *profile;
+
+    profiles_acquire();
+    for (profile = profiles; profile; profile = profile->next) {
+        apr_mutex_stats_t stats = profile->stats;
+
+        if (!fn(baton, &stats)) {
+            break;
+        }
+    }
+    profiles_release();
+}
+
+static int stats_count(void *baton, const apr_mutex_stats_t *stats)
+{
+    (*(int *)baton)++;
+    return 1;
+}
+
+typedef struct stats_copy_t {
+    apr_mutex_stats_t *stats;
+    int nelts, nalloc;
+} stats_copy_t;
+
+static int stats_copy(void *baton, const apr_mutex_stats_t *stats)
+{
+    stats_copy_t *copy = baton;
+
+    if (copy->nelts == copy->nalloc) {
+        return 0;
+    }
+    copy->stats[copy->nelts++] = *stats;
+    return 1;
+}
+
+static int stats_compare(const void *a, const void *b)
+{
+    const apr_mutex_stats_t *sa = a, *sb = b;
+
+    if (sa->wait_time != sb->wait_time) {
+        return (sa->wait_time < sb->wait_time) ? 1 : -1;
+    }
+    if (sa->contended != sb->contended) {
+        return (sa->contended < sb->contended) ? 1 : -1;
+    }
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_mutex_stats_dump(apr_file_t *file,
+                                               apr_pool_t *p)
+{
+    stats_copy_t copy;
+    int i;
+
+    /* Not allocating under the spinlock, the pool may use a named mutex */
+    copy.nelts = copy.nalloc = 0;
+    apr_mutex_stats_do(stats_count, &copy.nalloc);
+    copy.stats = apr_palloc(p, (copy.nalloc + 1) * sizeof(apr_mutex_stats_t));
+    apr_mutex_stats_do(stats_copy, &copy);
+
+    qsort(copy.stats, copy.nelts, sizeof(apr_mutex_stats_t), stats_compare);
+
+    for (i = 0; i < copy.nelts; i++) {
+        const apr_mutex_stats_t *stats = &copy.stats[i];
+
+        if (apr_file_printf(file, "%s %s locks=%" APR_UINT64_T_FMT
+                            " contended=%" APR_UINT64_T_FMT
+                            " wait=%" APR_TIME_T_FMT
+                            "us max=%" APR_TIME_T_FMT
+                            "us site=%pp holder=%pp\n",
+                            stats->kind, stats->name, stats->locks,
+                            stats->contended, stats->wait_time,
+                            stats->wait_max, stats->wait_max_site,
+                            stats->wait_max_holder) < 0) {
+            return APR_EGENERAL;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_mutex_stats_reset(void)
+{
+    apr_mutex_profile_t *profile;
+
+    profiles_acquire();
+    for (profile = profiles; profile; profile = profile->next) {
+        profile->stats.locks = profile->stats.contended = 0;
+        profile->stats.wait_time = profile->stats.wait_max = 0;
+        profile->stats.wait_max_site = profile->stats.wait_max_holder = NULL;
+    }
+    profiles_release();
+}
@@ -40,7 +40,8 @@ static apr_status_t proc_mutex_no_child_init(apr_proc_mutex_t **mutex,
 }
 #endif    
 
-#if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_PROC_PTHREAD_SERIALIZE
+#if APR_HAS_POSIXSEM_SERIALIZE || APR_HAS_PROC_PTHREAD_SERIALIZE \
+    || APR_HAS_FUTEX_SERIALIZE
 static apr_status_t proc_mutex_no_perms_set(apr_proc_mutex_t *mutex,
                                             apr_fileperms_t perms,
                                             apr_uid_t uid,
@@ -988,6 +989,235 @@ static const apr_proc_mutex_unix_lock_methods_t mutex_proc_pthread_cond_methods
 
 #endif
 
+#if APR_HAS_FUTEX_SERIALIZE
+
+/* The futex word is zero when unlocked, otherwise the ID of the owning
+ * thread, with FUTEX_WAITERS set once others may sleep on it.  Owned by
+ * threads, the mutex is global.
+ */
+
+/* How often the sleepers check whether the owner is still alive */
+#define FUTEX_OWNER_CHECK apr_time_from_msec(100)
+
+#if APR_HAS_THREAD_LOCAL
+/* The ID of the current thread, zero until assigned, and reset in a forked
+ * child whose only thread inherits the value of its parent's.
+ */
+static APR_THREAD_LOCAL apr_uint32_t futex_tid;
+
+static void futex_atfork_child(void)
+{
+    futex_tid = 0;
+}
+#endif
+
+static APR_INLINE apr_uint32_t proc_mutex_futex_tid(void)
+{
+#if APR_HAS_THREAD_LOCAL
+    if (!futex_tid) {
+        futex_tid = (apr_uint32_t)syscall(SYS_gettid);
+    }
+    return futex_tid;
+#else
+    return (apr_uint32_t)syscall(SYS_gettid);
+#endif
+}
+
+static APR_INLINE long proc_mutex_futex(volatile apr_uint32_t *word, int op,
+                                        apr_uint32_t val,
+                                        const struct timespec *timeout)
+{
+    /* Not FUTEX_PRIVATE_FLAG, the word is shared by processes */
+    return syscall(SYS_futex, word, op, val, timeout, NULL, 0);
+}
+
+/* Like robust mutexes, which glibc keeps for its own, a dead owner is
+ * replaced by the first waiter noticing it.
+ */
+static int proc_mutex_futex_owner_dead(apr_uint32_t val)
+{
+    pid_t tid = (pid_t)(val & FUTEX_TID_MASK);
+
+    return kill(tid, 0) < 0 && errno == ESRCH;
+}
+
+static apr_status_t proc_mutex_futex_cleanup(void *mutex_)
+{
+    apr_proc_mutex_t *mutex = mutex_;
+
+    if (mutex->curr_locked == 1) {
+        apr_proc_mutex_unlock(mutex);
+    }
+    if (mutex->futex_mapped) {
+        if (munmap(mutex->os.futex_interproc, sizeof(apr_uint32_t))) {
+            return errno;
+        }
+        mutex->futex_mapped = 0;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_create(apr_proc_mutex_t *new_mutex,
+                                            const char *fname)
+{
+    apr_status_t rv;
+    void *word;
+    int fd;
+
+    fd = open("/dev/zero", O_RDWR);
+    if (fd < 0) {
+        return errno;
+    }
+
+    word = mmap(NULL, sizeof(apr_uint32_t), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    if (word == MAP_FAILED) {
+        rv = errno;
+        close(fd);
+        return rv;
+    }
+    close(fd);
+
+    new_mutex->os.futex_interproc = word;
+    new_mutex->futex_mapped = 1;
+    new_mutex->curr_locked = 0;
+    apr_pool_cleanup_register(new_mutex->pool,
+                              (void *)new_mutex,
+                              apr_proc_mutex_cleanup,
+                              apr_pool_cleanup_null);
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_child_init(apr_proc_mutex_t **mutex,
+                                                apr_pool_t *pool,
+                                                const char *fname)
+{
+    (*mutex)->curr_locked = 0;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_tryacquire(apr_proc_mutex_t *mutex)
+{
+    if (apr_atomic_cas32(mutex->os.futex_interproc,
+                         proc_mutex_futex_tid(), 0)) {
+        return APR_EBUSY;
+    }
+    mutex->curr_locked = 1;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_timedacquire(apr_proc_mutex_t *mutex,
+                                                  apr_interval_time_t timeout)
+{
+    volatile apr_uint32_t *word = mutex->os.futex_interproc;
+    apr_uint32_t tid = proc_mutex_futex_tid(), val;
+    apr_time_t deadline = 0;
+    int expired = 0;
+
+    val = apr_atomic_cas32(word, tid, 0);
+    if (!val) {
+        mutex->curr_locked = 1;
+        return APR_SUCCESS;
+    }
+    if (!timeout) {
+        return APR_TIMEUP;
+    }
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    for (;;) {
+        apr_interval_time_t wait = FUTEX_OWNER_CHECK;
+        struct timespec ts;
+        apr_uint32_t prev;
+
+        if (!val) {
+            /* Not knowing whether others sleep, keep them woken up */
+            val = apr_atomic_cas32(word, tid | FUTEX_WAITERS, 0);
+            if (!val) {
+                break;
+            }
+            continue;
+        }
+        if (expired && proc_mutex_futex_owner_dead(val)) {
+            prev = apr_atomic_cas32(word, tid | FUTEX_WAITERS, val);
+            if (prev == val) {
+                break;
+            }
+            val = prev;
+            continue;
+        }
+        if (deadline) {
+            apr_interval_time_t left = deadline - apr_time_now();
+            if (left <= 0) {
+                return APR_TIMEUP;
+            }
+            if (wait > left) {
+                wait = left;
+            }
+        }
+        if (!(val & FUTEX_WAITERS)) {
+            prev = apr_atomic_cas32(word, val | FUTEX_WAITERS, val);
+            if (prev != val) {
+                val = prev;
+                continue;
+            }
+            val |= FUTEX_WAITERS;
+        }
+
+        ts.tv_sec = apr_time_sec(wait);
+        ts.tv_nsec = apr_time_usec(wait) * 1000; /* nanoseconds */
+        expired = 0;
+        if (proc_mutex_futex(word, FUTEX_WAIT, val, &ts) < 0) {
+            if (errno == ETIMEDOUT) {
+                expired = 1;
+            }
+            else if (errno != EAGAIN && errno != EINTR) {
+                return errno;
+            }
+        }
+        val = apr_atomic_read32(word);
+    }
+
+    mutex->curr_locked = 1;
+    return APR_SUCCESS;
+}
+
+static apr_status_t proc_mutex_futex_acquire(apr_proc_mutex_t *mutex)
+{
+    return proc_mutex_futex_timedacquire(mutex, -1);
+}
+
+static apr_status_t proc_mutex_futex_release(apr_proc_mutex_t *mutex)
+{
+    volatile apr_uint32_t *word = mutex->os.futex_interproc;
+
+    mutex->curr_locked = 0;
+    if (apr_atomic_xchg32(word, 0) & FUTEX_WAITERS) {
+        if (proc_mutex_futex(word, FUTEX_WAKE, 1, NULL) < 0) {
+            return errno;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static const apr_proc_mutex_unix_lock_methods_t mutex_futex_methods =
+{
+    APR_PROCESS_LOCK_MECH_IS_GLOBAL,
+    proc_mutex_futex_create,
+    proc_mutex_futex_acquire,
+    proc_mutex_futex_tryacquire,
+    proc_mutex_futex_timedacquire,
+    proc_mutex_futex_release,
+    proc_mutex_futex_cleanup,
+    proc_mutex_futex_child_init,
+    proc_mutex_no_perms_set,
+    APR_LOCK_FUTEX,
+    "futex"
+};
+
+#endif /* futex implementation */
+
 #if APR_HAS_FCNTL_SERIALIZE
 
 static struct flock proc_mutex_lock_it;
@@ -1335,6 +1565,9 @@ void apr_proc_mutex_unix_setup_lock(void)
 #if APR_HAS_FCNTL_SERIALIZE
     proc_mutex_fcntl_setup();
 #endif
+#if APR_HAS_FUTEX_SERIALIZE && APR_HAS_THREAD_LOCAL
+    pthread_atfork(NULL, NULL, futex_atfork_child);
+#endif
 }
 
 static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex,
@@ -1347,6 +1580,9 @@ static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex,
 #if APR_HAS_POSIXSEM_SERIALIZE
     new_mutex->os.psem_interproc = NULL;
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    new_mutex->os.futex_interproc = NULL;
+#endif
 #if APR_HAS_SYSVSEM_SERIALIZE || APR_HAS_FCNTL_SERIALIZE || APR_HAS_FLOCK_SERIALIZE
     new_mutex->os.crossproc = -1;
 
@@ -1420,6 +1656,21 @@ static apr_status_t proc_mutex_choose_method(apr_proc_mutex_t *new_mutex,
         }
 #else
         return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_LOCK_FUTEX:
+#if APR_HAS_FUTEX_SERIALIZE
+        new_mutex->meth = &mutex_futex_methods;
+        if (ospmutex) {
+            if (ospmutex->futex_interproc == NULL
+                || ((apr_uintptr_t)ospmutex->futex_interproc
+                    & (sizeof(apr_uint32_t) - 1))) {
+                return APR_EINVAL;
+            }
+            new_mutex->os.futex_interproc = ospmutex->futex_interproc;
+        }
+#else
+        return APR_ENOTIMPL;
 #endif
         break;
     case APR_LOCK_DEFAULT_TIMED:
@@ -1563,27 +1814,89 @@ APR_DECLARE(apr_status_t) apr_proc_mutex_child_init(apr_proc_mutex_t **mutex,
     return (*mutex)->meth->child_init(mutex, pool, fname);
 }
 
+/* The lock of a named mutex tries first, to know whether it waited; the
+ * holder is only known when it is a thread of this process.
+ */
+static apr_status_t proc_mutex_lock_profiled(apr_proc_mutex_t *mutex,
+                                             apr_interval_time_t timeout,
+                                             const void *site)
+{
+    apr_mutex_profile_t *profile = mutex->profile;
+    const void *holder = NULL;
+    apr_time_t start = 0;
+    apr_status_t rv;
+
+    rv = mutex->meth->tryacquire(mutex);
+    if (rv == APR_EBUSY) {
+        holder = profile->holder;
+        start = apr_time_now();
+    }
+    if (rv != APR_SUCCESS) {
+        if (timeout < 0) {
+            rv = mutex->meth->acquire(mutex);
+        }
+        else {
+            rv = mutex->meth->timedacquire(mutex, timeout);
+        }
+    }
+    if (rv == APR_SUCCESS) {
+        apr_mutex_profile_locked(profile, start, site, holder);
+    }
+    return rv;
+}
+
 APR_DECLARE(apr_status_t) apr_proc_mutex_lock(apr_proc_mutex_t *mutex)
 {
+    if (mutex->profile) {
+        return proc_mutex_lock_profiled(mutex, -1, APR_MUTEX_CALL_SITE());
+    }
     return mutex->meth->acquire(mutex);
 }
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_trylock(apr_proc_mutex_t *mutex)
 {
-    return mutex->meth->tryacquire(mutex);
+    apr_status_t rv = mutex->meth->tryacquire(mutex);
+
+    if (rv == APR_SUCCESS && mutex->profile) {
+        apr_mutex_profile_locked(mutex->profile, 0, APR_MUTEX_CALL_SITE(),
+                                 NULL);
+    }
+    return rv;
 }
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_timedlock(apr_proc_mutex_t *mutex,
                                                apr_interval_time_t timeout)
 {
-    return mutex->meth->timedacquire(mutex, timeout);
+    if (mutex->profile && timeout > 0) {
+        return proc_mutex_lock_profiled(mutex, timeout,
+                                        APR_MUTEX_CALL_SITE());
+    }
+    else {
+        apr_status_t rv = mutex->meth->timedacquire(mutex, timeout);
+
+        if (rv == APR_SUCCESS && mutex->profile) {
+            apr_mutex_profile_locked(mutex->profile, 0,
+                                     APR_MUTEX_CALL_SITE(), NULL);
+        }
+        return rv;
+    }
 }
 
 APR_DECLARE(apr_status_t) apr_proc_mutex_unlock(apr_proc_mutex_t *mutex)
 {
+    if (mutex->profile) {
+        apr_mutex_profile_unlocked(mutex->profile);
+    }
     return mutex->meth->release(mutex);
 }
 
+APR_DECLARE(apr_status_t) apr_proc_mutex_name_set(apr_proc_mutex_t *mutex,
+                                                  const char *name)
+{
+    return apr_mutex_profile_name(&mutex->profile, name, "proc",
+                                  mutex->pool);
+}
+
 APR_DECLARE(apr_status_t) apr_proc_mutex_cleanup(void *mutex)
 {
     return ((apr_proc_mutex_t *)mutex)->meth->cleanup(mutex);
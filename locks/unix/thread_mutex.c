@@ -15,11 +15,23 @@
  */
 
 #include "apr_arch_thread_mutex.h"
+#include "apr_probes.h"
 #define APR_WANT_MEMFUNC
 #include "apr_want.h"
 
 #if APR_HAS_THREADS
 
+/* The most spins of an adaptive mutex before sleeping */
+#define MUTEX_SPINS_MAX 100
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define mutex_cpu_relax() __asm__ __volatile__("pause" ::: "memory")
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define mutex_cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define mutex_cpu_relax()
+#endif
+
 static apr_status_t thread_mutex_cleanup(void *data)
 {
     apr_thread_mutex_t *mutex = data;
@@ -85,9 +97,32 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
 
         pthread_mutexattr_destroy(&mattr);
 #else
+#ifdef HAVE_PTHREAD_MUTEX_ADAPTIVE_NP
+        if (flags & APR_THREAD_MUTEX_ADAPTIVE) {
+            pthread_mutexattr_t mattr;
+
+            rv = pthread_mutexattr_init(&mattr);
+            if (rv) return rv;
+
+            rv = pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_ADAPTIVE_NP);
+            if (rv) {
+                pthread_mutexattr_destroy(&mattr);
+                return rv;
+            }
+
+            rv = pthread_mutex_init(&new_mutex->mutex, &mattr);
+
+            pthread_mutexattr_destroy(&mattr);
+
+            /* The library spins already */
+            flags &= ~APR_THREAD_MUTEX_ADAPTIVE;
+        }
+        else
+#endif
         rv = pthread_mutex_init(&new_mutex->mutex, NULL);
 #endif
     }
+    new_mutex->adaptive = (flags & APR_THREAD_MUTEX_ADAPTIVE) != 0;
 
     if (rv) {
 #ifdef HAVE_ZOS_PTHREADS
@@ -117,7 +152,51 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
     return APR_SUCCESS;
 }
 
-APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
+/* Retry a contended lock for up to about twice the spins it took lately,
+ * averaged, before sleeping in pthread_mutex_lock().
+ */
+static apr_status_t thread_mutex_spinlock(apr_thread_mutex_t *mutex)
+{
+    apr_uint32_t estimate = apr_atomic_read32(&mutex->spins);
+    apr_uint32_t max = estimate * 2 + 10, n = 0;
+    apr_status_t rv;
+
+    if (max > MUTEX_SPINS_MAX) {
+        max = MUTEX_SPINS_MAX;
+    }
+    for (;;) {
+        rv = pthread_mutex_trylock(&mutex->mutex);
+#ifdef HAVE_ZOS_PTHREADS
+        if (rv) {
+            rv = errno;
+        }
+#endif
+        if (rv != EBUSY) {
+            break;
+        }
+        if (++n >= max) {
+            APR_PROBE1(mutex__contended, mutex);
+            rv = pthread_mutex_lock(&mutex->mutex);
+#ifdef HAVE_ZOS_PTHREADS
+            if (rv) {
+                rv = errno;
+            }
+#endif
+            APR_PROBE1(mutex__acquired, mutex);
+            break;
+        }
+        mutex_cpu_relax();
+    }
+
+    if (n) {
+        /* Racy, but that's only an estimate */
+        apr_atomic_set32(&mutex->spins,
+                         estimate + ((apr_int32_t)(n - estimate)) / 8);
+    }
+    return rv;
+}
+
+static apr_status_t thread_mutex_lock(apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
 
@@ -155,17 +234,36 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
     }
 #endif
 
+    if (mutex->adaptive) {
+        return thread_mutex_spinlock(mutex);
+    }
+
+#if APR_HAVE_SDT
+    /* Only a locked mutex fires the (contention) probes */
+    rv = pthread_mutex_trylock(&mutex->mutex);
+#ifdef HAVE_ZOS_PTHREADS
+    if (rv) {
+        rv = errno;
+    }
+#endif
+    if (rv != EBUSY) {
+        return rv;
+    }
+    APR_PROBE1(mutex__contended, mutex);
+#endif
+
     rv = pthread_mutex_lock(&mutex->mutex);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
         rv = errno;
     }
 #endif
+    APR_PROBE1(mutex__acquired, mutex);
 
     return rv;
 }
 
-APR_DECLARE(apr_status_t) apr_thread_mutex_trylock(apr_thread_mutex_t *mutex)
+static apr_status_t thread_mutex_trylock(apr_thread_mutex_t *mutex)
 {
     apr_status_t rv;
 
@@ -212,8 +310,8 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_trylock(apr_thread_mutex_t *mutex)
     return APR_SUCCESS;
 }
 
-APR_DECLARE(apr_status_t) apr_thread_mutex_timedlock(apr_thread_mutex_t *mutex,
-                                                 apr_interval_time_t timeout)
+static apr_status_t thread_mutex_timedlock(apr_thread_mutex_t *mutex,
+                                           apr_interval_time_t timeout)
 {
     apr_status_t rv = APR_ENOTIMPL;
 
@@ -298,10 +396,83 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_timedlock(apr_thread_mutex_t *mutex,
     return rv;
 }
 
+/* The lock of a named mutex tries first, to know whether it waited */
+static apr_status_t thread_mutex_lock_profiled(apr_thread_mutex_t *mutex,
+                                               apr_interval_time_t timeout,
+                                               const void *site)
+{
+    apr_mutex_profile_t *profile = mutex->profile;
+    const void *holder = NULL;
+    apr_time_t start = 0;
+    apr_status_t rv;
+
+    rv = thread_mutex_trylock(mutex);
+    if (rv == APR_EBUSY) {
+        holder = profile->holder;
+        start = apr_time_now();
+        if (timeout < 0) {
+            rv = thread_mutex_lock(mutex);
+        }
+        else {
+            rv = thread_mutex_timedlock(mutex, timeout);
+        }
+    }
+    if (rv == APR_SUCCESS) {
+        apr_mutex_profile_locked(profile, start, site, holder);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_mutex_lock(apr_thread_mutex_t *mutex)
+{
+    if (mutex->profile) {
+        return thread_mutex_lock_profiled(mutex, -1, APR_MUTEX_CALL_SITE());
+    }
+    return thread_mutex_lock(mutex);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_mutex_trylock(apr_thread_mutex_t *mutex)
+{
+    apr_status_t rv = thread_mutex_trylock(mutex);
+
+    if (rv == APR_SUCCESS && mutex->profile) {
+        apr_mutex_profile_locked(mutex->profile, 0, APR_MUTEX_CALL_SITE(),
+                                 NULL);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_mutex_timedlock(apr_thread_mutex_t *mutex,
+                                                 apr_interval_time_t timeout)
+{
+#ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
+    if (!mutex->cond) {
+        return APR_ENOTIMPL;
+    }
+#endif
+    if (mutex->profile && timeout > 0) {
+        return thread_mutex_lock_profiled(mutex, timeout,
+                                          APR_MUTEX_CALL_SITE());
+    }
+    else {
+        apr_status_t rv = thread_mutex_timedlock(mutex, timeout);
+
+        if (rv == APR_SUCCESS && mutex->profile) {
+            apr_mutex_profile_locked(mutex->profile, 0,
+                                     APR_MUTEX_CALL_SITE(), NULL);
+        }
+        return rv;
+    }
+}
+
 APR_DECLARE(apr_status_t) apr_thread_mutex_unlock(apr_thread_mutex_t *mutex)
 {
     apr_status_t status;
 
+    if (mutex->profile) {
+        apr_mutex_profile_unlocked(mutex->profile);
+    }
+
 #ifndef HAVE_PTHREAD_MUTEX_TIMEDLOCK
     if (mutex->cond) {
         status = pthread_mutex_lock(&mutex->mutex);
@@ -355,6 +526,13 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_destroy(apr_thread_mutex_t *mutex)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_mutex_name_set(apr_thread_mutex_t *mutex,
+                                                    const char *name)
+{
+    return apr_mutex_profile_name(&mutex->profile, name, "thread",
+                                  mutex->pool);
+}
+
 APR_POOL_IMPLEMENT_ACCESSOR(thread_mutex)
 
 #endif /* APR_HAS_THREADS */
@@ -16,11 +16,179 @@
 
 #include "apr_arch_thread_rwlock.h"
 #include "apr_private.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
 
 #if APR_HAS_THREADS
 
 #ifdef HAVE_PTHREAD_RWLOCKS
 
+#if APR_HAS_THREAD_LOCAL
+/* The reader slot of the current thread, plus one (zero until assigned) */
+static APR_THREAD_LOCAL apr_uint32_t rwlock_slot_hint;
+static apr_uint32_t rwlock_slot_next;
+
+/* The scalable rwlocks read locked by the current thread, so that it can
+ * lock them again while a writer waits: the writer can't get the lock
+ * before the thread releases its first read lock, so backing off would
+ * deadlock.  Past RWLOCK_HELD_MAX locks held at once, the others are not
+ * tracked (nor can be locked recursively while a writer waits).
+ */
+#define RWLOCK_HELD_MAX 8
+
+static APR_THREAD_LOCAL struct {
+    apr_thread_rwlock_t *rwlock;
+    apr_uint32_t count;
+} rwlock_held[RWLOCK_HELD_MAX];
+
+static int rwlock_held_find(apr_thread_rwlock_t *rwlock)
+{
+    int i, free = -1;
+
+    for (i = 0; i < RWLOCK_HELD_MAX; i++) {
+        if (!rwlock_held[i].count) {
+            if (free < 0) {
+                free = i;
+            }
+        }
+        else if (rwlock_held[i].rwlock == rwlock) {
+            return i;
+        }
+    }
+    return free;
+}
+
+/* A thread must use the same slot to lock and unlock, or a writer summing
+ * the slots could miss a reader's increment but not its decrement.
+ */
+static APR_INLINE volatile apr_uint32_t *rwlock_slot(apr_thread_rwlock_t *rwlock)
+{
+    if (!rwlock_slot_hint) {
+        rwlock_slot_hint = apr_atomic_inc32(&rwlock_slot_next) + 1;
+    }
+    return &rwlock->slots[(rwlock_slot_hint - 1)
+                          % THREAD_RWLOCK_SLOTS].readers;
+}
+
+static apr_uint32_t rwlock_readers(apr_thread_rwlock_t *rwlock)
+{
+    apr_uint32_t n = 0;
+    int i;
+
+    for (i = 0; i < THREAD_RWLOCK_SLOTS; i++) {
+        n += apr_atomic_read32(&rwlock->slots[i].readers);
+    }
+    return n;
+}
+
+static void rwlock_reader_leave(apr_thread_rwlock_t *rwlock,
+                                volatile apr_uint32_t *slot)
+{
+    apr_atomic_dec32(slot);
+    if (apr_atomic_read32(&rwlock->writing)) {
+        /* The writer sleeps until the readers are gone */
+        apr_thread_mutex_lock(rwlock->dlock);
+        apr_thread_cond_signal(rwlock->drained);
+        apr_thread_mutex_unlock(rwlock->dlock);
+    }
+}
+
+static apr_status_t rwlock_scalable_rdlock(apr_thread_rwlock_t *rwlock,
+                                           int try)
+{
+    volatile apr_uint32_t *slot = rwlock_slot(rwlock);
+    int held = rwlock_held_find(rwlock);
+
+    if (held >= 0 && rwlock_held[held].count) {
+        /* Already read locked by this thread, no writer can get in */
+        apr_atomic_inc32(slot);
+        rwlock_held[held].count++;
+        return APR_SUCCESS;
+    }
+
+    for (;;) {
+        apr_status_t rv;
+
+        apr_atomic_inc32(slot);
+        if (!apr_atomic_read32(&rwlock->writing)) {
+            if (held >= 0) {
+                rwlock_held[held].rwlock = rwlock;
+                rwlock_held[held].count = 1;
+            }
+            return APR_SUCCESS;
+        }
+        rwlock_reader_leave(rwlock, slot);
+        if (try) {
+            return APR_EBUSY;
+        }
+
+        /* Wait for the writer to be done */
+        rv = apr_thread_mutex_lock(rwlock->wlock);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        apr_thread_mutex_unlock(rwlock->wlock);
+    }
+}
+
+static apr_status_t rwlock_scalable_wrlock(apr_thread_rwlock_t *rwlock,
+                                           int try)
+{
+    apr_status_t rv;
+
+    if (try) {
+        rv = apr_thread_mutex_trylock(rwlock->wlock);
+    }
+    else {
+        rv = apr_thread_mutex_lock(rwlock->wlock);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* No new reader from now, then wait for the current ones */
+    rwlock->writer = apr_os_thread_current();
+    apr_atomic_xchg32(&rwlock->writing, 1);
+    apr_thread_mutex_lock(rwlock->dlock);
+    while (rwlock_readers(rwlock)) {
+        if (try) {
+            apr_thread_mutex_unlock(rwlock->dlock);
+            apr_atomic_set32(&rwlock->writing, 0);
+            apr_thread_mutex_unlock(rwlock->wlock);
+            return APR_EBUSY;
+        }
+        apr_thread_cond_wait(rwlock->drained, rwlock->dlock);
+    }
+    apr_thread_mutex_unlock(rwlock->dlock);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t rwlock_scalable_unlock(apr_thread_rwlock_t *rwlock)
+{
+    int held;
+
+    /* Readers may still be leaving while a writer waits */
+    if (apr_atomic_read32(&rwlock->writing)
+        && apr_os_thread_equal(rwlock->writer, apr_os_thread_current())) {
+        apr_atomic_set32(&rwlock->writing, 0);
+        return apr_thread_mutex_unlock(rwlock->wlock);
+    }
+
+    held = rwlock_held_find(rwlock);
+    if (held >= 0 && rwlock_held[held].count) {
+        rwlock_held[held].count--;
+    }
+    rwlock_reader_leave(rwlock, rwlock_slot(rwlock));
+    return APR_SUCCESS;
+}
+#else
+/* APR_THREAD_RWLOCK_SCALABLE is ignored, rwlock->slots is always NULL */
+#define rwlock_scalable_rdlock(rwlock, try) APR_ENOTIMPL
+#define rwlock_scalable_wrlock(rwlock, try) APR_ENOTIMPL
+#define rwlock_scalable_unlock(rwlock)      APR_ENOTIMPL
+#endif /* APR_HAS_THREAD_LOCAL */
+
 /* The rwlock must be initialized but not locked by any thread when
  * cleanup is called. */
 static apr_status_t thread_rwlock_cleanup(void *data)
@@ -39,13 +207,38 @@ static apr_status_t thread_rwlock_cleanup(void *data)
 
 APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
                                                    apr_pool_t *pool)
+{
+    return apr_thread_rwlock_create_ex(rwlock, APR_THREAD_RWLOCK_DEFAULT,
+                                       pool);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
 {
     apr_thread_rwlock_t *new_rwlock;
     apr_status_t stat;
 
-    new_rwlock = apr_palloc(pool, sizeof(apr_thread_rwlock_t));
+    new_rwlock = apr_pcalloc(pool, sizeof(apr_thread_rwlock_t));
     new_rwlock->pool = pool;
 
+#if APR_HAS_THREAD_LOCAL
+    if (flags & APR_THREAD_RWLOCK_SCALABLE) {
+        char *mem = apr_pcalloc(pool, (THREAD_RWLOCK_SLOTS + 1)
+                                      * THREAD_RWLOCK_SLOT_SIZE);
+
+        new_rwlock->slots = (thread_rwlock_slot_t *)
+            APR_ALIGN((apr_uintptr_t)mem, THREAD_RWLOCK_SLOT_SIZE);
+        if ((stat = apr_thread_mutex_create(&new_rwlock->wlock,
+                                            APR_THREAD_MUTEX_DEFAULT, pool))
+            || (stat = apr_thread_mutex_create(&new_rwlock->dlock,
+                                               APR_THREAD_MUTEX_DEFAULT, pool))
+            || (stat = apr_thread_cond_create(&new_rwlock->drained, pool))) {
+            return stat;
+        }
+    }
+#endif
+
     if ((stat = pthread_rwlock_init(&new_rwlock->rwlock, NULL))) {
 #ifdef HAVE_ZOS_PTHREADS
         stat = errno;
@@ -65,6 +258,10 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_rdlock(apr_thread_rwlock_t *rwlock)
 {
     apr_status_t stat;
 
+    if (rwlock->slots) {
+        return rwlock_scalable_rdlock(rwlock, 0);
+    }
+
     stat = pthread_rwlock_rdlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
@@ -78,6 +275,10 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_tryrdlock(apr_thread_rwlock_t *rwloc
 {
     apr_status_t stat;
 
+    if (rwlock->slots) {
+        return rwlock_scalable_rdlock(rwlock, 1);
+    }
+
     stat = pthread_rwlock_tryrdlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
@@ -94,6 +295,10 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_wrlock(apr_thread_rwlock_t *rwlock)
 {
     apr_status_t stat;
 
+    if (rwlock->slots) {
+        return rwlock_scalable_wrlock(rwlock, 0);
+    }
+
     stat = pthread_rwlock_wrlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
@@ -107,6 +312,10 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_trywrlock(apr_thread_rwlock_t *rwloc
 {
     apr_status_t stat;
 
+    if (rwlock->slots) {
+        return rwlock_scalable_wrlock(rwlock, 1);
+    }
+
     stat = pthread_rwlock_trywrlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
@@ -123,6 +332,10 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_unlock(apr_thread_rwlock_t *rwlock)
 {
     apr_status_t stat;
 
+    if (rwlock->slots) {
+        return rwlock_scalable_unlock(rwlock);
+    }
+
     stat = pthread_rwlock_unlock(&rwlock->rwlock);
 #ifdef HAVE_ZOS_PTHREADS
     if (stat) {
@@ -145,6 +358,13 @@ APR_DECLARE(apr_status_t) apr_thread_rwlock_create(apr_thread_rwlock_t **rwlock,
     return APR_ENOTIMPL;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_rwlock_create_ex(apr_thread_rwlock_t **rwlock,
+                                                      unsigned int flags,
+                                                      apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_thread_rwlock_rdlock(apr_thread_rwlock_t *rwlock)
 {
     return APR_ENOTIMPL;
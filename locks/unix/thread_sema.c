@@ -0,0 +1,255 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_atomic.h"
+#include "apr_thread_sema.h"
+
+#if APR_HAS_THREADS
+
+/* Without futexes the sleepers use a condition variable, which this file
+ * builds upon portably for the platforms including it.
+ */
+#ifdef HAVE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+#endif
+
+/* How many times a waiter checks the count before sleeping */
+#define SEMA_SPINS 100
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define sema_cpu_relax() __asm__ __volatile__("pause" ::: "memory")
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define sema_cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define sema_cpu_relax()
+#endif
+
+/* The count is taken and given back atomically, the sleepers being woken
+ * up only if the poster sees some, after it incremented the count which
+ * they check once accounted for.
+ */
+struct apr_thread_sema_t {
+    apr_pool_t *pool;
+    apr_uint32_t value;
+    apr_uint32_t sleepers;
+#ifndef HAVE_FUTEX
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *cond;
+#endif
+};
+
+static APR_INLINE int sema_take(apr_thread_sema_t *sema)
+{
+    apr_uint32_t val = apr_atomic_read32(&sema->value);
+
+    while (val) {
+        apr_uint32_t prev = apr_atomic_cas32(&sema->value, val - 1, val);
+        if (prev == val) {
+            return 1;
+        }
+        val = prev;
+    }
+    return 0;
+}
+
+#ifdef HAVE_FUTEX
+
+static apr_status_t sema_sleep(apr_thread_sema_t *sema,
+                               apr_interval_time_t timeout)
+{
+    struct timespec ts, *tsp = NULL;
+
+    if (timeout >= 0) {
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000; /* nanoseconds */
+        tsp = &ts;
+    }
+
+    apr_atomic_inc32(&sema->sleepers);
+    if (syscall(SYS_futex, &sema->value, FUTEX_WAIT_PRIVATE, 0, tsp,
+                NULL, 0) < 0
+            && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+        apr_status_t rv = errno;
+        apr_atomic_dec32(&sema->sleepers);
+        return rv;
+    }
+    apr_atomic_dec32(&sema->sleepers);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t sema_wake(apr_thread_sema_t *sema)
+{
+    if (syscall(SYS_futex, &sema->value, FUTEX_WAKE_PRIVATE, 1,
+                NULL, NULL, 0) < 0) {
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+
+#else /* !HAVE_FUTEX */
+
+static apr_status_t sema_sleep(apr_thread_sema_t *sema,
+                               apr_interval_time_t timeout)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    apr_thread_mutex_lock(sema->lock);
+    apr_atomic_inc32(&sema->sleepers);
+    if (!apr_atomic_read32(&sema->value)) {
+        if (timeout >= 0) {
+            rv = apr_thread_cond_timedwait(sema->cond, sema->lock, timeout);
+            if (rv == APR_TIMEUP) {
+                rv = APR_SUCCESS;
+            }
+        }
+        else {
+            rv = apr_thread_cond_wait(sema->cond, sema->lock);
+        }
+    }
+    apr_atomic_dec32(&sema->sleepers);
+    apr_thread_mutex_unlock(sema->lock);
+
+    return rv;
+}
+
+static apr_status_t sema_wake(apr_thread_sema_t *sema)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(sema->lock);
+    rv = apr_thread_cond_signal(sema->cond);
+    apr_thread_mutex_unlock(sema->lock);
+
+    return rv;
+}
+
+#endif /* !HAVE_FUTEX */
+
+static apr_status_t thread_sema_cleanup(void *data)
+{
+#ifndef HAVE_FUTEX
+    apr_thread_sema_t *sema = data;
+    apr_status_t rv;
+
+    rv = apr_thread_cond_destroy(sema->cond);
+    if (rv == APR_SUCCESS) {
+        rv = apr_thread_mutex_destroy(sema->lock);
+    }
+    return rv;
+#else
+    return APR_SUCCESS;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_create(apr_thread_sema_t **sema,
+                                                 apr_uint32_t value,
+                                                 apr_pool_t *pool)
+{
+    apr_thread_sema_t *new_sema;
+
+    new_sema = apr_pcalloc(pool, sizeof(apr_thread_sema_t));
+    new_sema->pool = pool;
+    new_sema->value = value;
+
+#ifndef HAVE_FUTEX
+    {
+        apr_status_t rv;
+
+        if ((rv = apr_thread_mutex_create(&new_sema->lock,
+                                          APR_THREAD_MUTEX_DEFAULT, pool))
+            || (rv = apr_thread_cond_create(&new_sema->cond, pool))) {
+            return rv;
+        }
+    }
+#endif
+
+    apr_pool_cleanup_register(new_sema->pool, new_sema, thread_sema_cleanup,
+                              apr_pool_cleanup_null);
+
+    *sema = new_sema;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_trywait(apr_thread_sema_t *sema)
+{
+    return sema_take(sema) ? APR_SUCCESS : APR_EBUSY;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_timedwait(apr_thread_sema_t *sema,
+                                                    apr_interval_time_t timeout)
+{
+    apr_time_t deadline = 0;
+    apr_status_t rv;
+    int spins;
+
+    for (spins = 0; timeout && spins < SEMA_SPINS; spins++) {
+        if (sema_take(sema)) {
+            return APR_SUCCESS;
+        }
+        sema_cpu_relax();
+    }
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+    while (!sema_take(sema)) {
+        if (timeout >= 0) {
+            if (timeout > 0) {
+                timeout = deadline - apr_time_now();
+            }
+            if (timeout <= 0) {
+                return APR_TIMEUP;
+            }
+        }
+        if ((rv = sema_sleep(sema, timeout))) {
+            return rv;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_wait(apr_thread_sema_t *sema)
+{
+    return apr_thread_sema_timedwait(sema, -1);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_post(apr_thread_sema_t *sema)
+{
+    apr_atomic_inc32(&sema->value);
+    if (apr_atomic_read32(&sema->sleepers)) {
+        return sema_wake(sema);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_destroy(apr_thread_sema_t *sema)
+{
+    return apr_pool_cleanup_run(sema->pool, sema, thread_sema_cleanup);
+}
+
+APR_POOL_IMPLEMENT_ACCESSOR(thread_sema)
+
+#endif /* APR_HAS_THREADS */
@@ -191,6 +191,12 @@ APR_DECLARE(const char *) apr_proc_mutex_defname(void)
     return "win32mutex";
 }
 
+APR_DECLARE(apr_status_t) apr_proc_mutex_name_set(apr_proc_mutex_t *mutex,
+                                                  const char *name)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_PERMS_SET_ENOTIMPL(proc_mutex)
 
 APR_POOL_IMPLEMENT_ACCESSOR(proc_mutex)
@@ -60,7 +60,12 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_create(apr_thread_mutex_t **mutex,
     else {
         /* Critical Sections are terrific, performance-wise, on NT.
          */
-        InitializeCriticalSection(&(*mutex)->section);
+        if (flags & APR_THREAD_MUTEX_ADAPTIVE) {
+            InitializeCriticalSectionAndSpinCount(&(*mutex)->section, 4000);
+        }
+        else {
+            InitializeCriticalSection(&(*mutex)->section);
+        }
         (*mutex)->type = thread_mutex_critical_section;
         (*mutex)->handle = NULL;
     }
@@ -157,5 +162,11 @@ APR_DECLARE(apr_status_t) apr_thread_mutex_destroy(apr_thread_mutex_t *mutex)
     return apr_pool_cleanup_run(mutex->pool, mutex, thread_mutex_cleanup);
 }
 
+APR_DECLARE(apr_status_t) apr_thread_mutex_name_set(apr_thread_mutex_t *mutex,
+                                                    const char *name)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_POOL_IMPLEMENT_ACCESSOR(thread_mutex)
 
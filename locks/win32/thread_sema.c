@@ -0,0 +1,152 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_private.h"
+#include "apr_general.h"
+#include "apr_thread_sema.h"
+#include "apr_arch_misc.h"
+
+#include <limits.h>
+
+/* How many times a waiter checks the count before sleeping */
+#define SEMA_SPINS 100
+
+/* The count goes negative by the number of sleepers, which only then
+ * cost the kernel semaphore a wait and its posters a release.
+ */
+struct apr_thread_sema_t {
+    apr_pool_t *pool;
+    volatile LONG count;
+    HANDLE semaphore;
+};
+
+static apr_status_t thread_sema_cleanup(void *data)
+{
+    apr_thread_sema_t *sema = data;
+
+    if (sema->semaphore) {
+        if (!CloseHandle(sema->semaphore)) {
+            return apr_get_os_error();
+        }
+        sema->semaphore = NULL;
+    }
+    return APR_SUCCESS;
+}
+
+static APR_INLINE int sema_take(apr_thread_sema_t *sema)
+{
+    LONG val = sema->count;
+
+    while (val > 0) {
+        LONG prev = InterlockedCompareExchange(&sema->count, val - 1, val);
+        if (prev == val) {
+            return 1;
+        }
+        val = prev;
+    }
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_create(apr_thread_sema_t **sema,
+                                                 apr_uint32_t value,
+                                                 apr_pool_t *pool)
+{
+    apr_thread_sema_t *new_sema;
+
+    new_sema = apr_pcalloc(pool, sizeof(apr_thread_sema_t));
+    new_sema->pool = pool;
+    new_sema->count = (LONG)value;
+    new_sema->semaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+    if (!new_sema->semaphore) {
+        return apr_get_os_error();
+    }
+
+    apr_pool_cleanup_register(new_sema->pool, new_sema, thread_sema_cleanup,
+                              apr_pool_cleanup_null);
+
+    *sema = new_sema;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_trywait(apr_thread_sema_t *sema)
+{
+    return sema_take(sema) ? APR_SUCCESS : APR_EBUSY;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_timedwait(apr_thread_sema_t *sema,
+                                                    apr_interval_time_t timeout)
+{
+    DWORD res;
+    int spins;
+
+    for (spins = 0; spins < SEMA_SPINS; spins++) {
+        if (sema_take(sema)) {
+            return APR_SUCCESS;
+        }
+        if (!timeout) {
+            return APR_TIMEUP;
+        }
+        YieldProcessor();
+    }
+
+    if (InterlockedDecrement(&sema->count) >= 0) {
+        return APR_SUCCESS;
+    }
+
+    res = apr_wait_for_single_object(sema->semaphore, timeout);
+    if (res == WAIT_TIMEOUT) {
+        /* Give our place back, unless a poster already released the
+         * semaphore for us.
+         */
+        LONG val = sema->count;
+
+        while (val < 0) {
+            LONG prev = InterlockedCompareExchange(&sema->count, val + 1, val);
+            if (prev == val) {
+                return APR_TIMEUP;
+            }
+            val = prev;
+        }
+        res = apr_wait_for_single_object(sema->semaphore, -1);
+    }
+    if (res != WAIT_OBJECT_0) {
+        return apr_get_os_error();
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_wait(apr_thread_sema_t *sema)
+{
+    return apr_thread_sema_timedwait(sema, -1);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_post(apr_thread_sema_t *sema)
+{
+    if (InterlockedIncrement(&sema->count) <= 0) {
+        if (!ReleaseSemaphore(sema->semaphore, 1, NULL)) {
+            return apr_get_os_error();
+        }
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_sema_destroy(apr_thread_sema_t *sema)
+{
+    return apr_pool_cleanup_run(sema->pool, sema, thread_sema_cleanup);
+}
+
+APR_POOL_IMPLEMENT_ACCESSOR(thread_sema)
@@ -17,6 +17,9 @@
 #include "apr_memcache.h"
 #include "apr_poll.h"
 #include "apr_version.h"
+#include "apr_crc32.h"
+#include "apr_md5.h"
+#include "apr_strings.h"
 #include <stdlib.h>
 
 #define BUFFER_SIZE 512
@@ -24,9 +27,10 @@ struct apr_memcache_conn_t
 {
     char *buffer;
     apr_size_t blen;
+    int partial;                /* buffer holds the start of a line */
     apr_pool_t *p;
-    apr_pool_t *tp;
     apr_socket_t *sock;
+    apr_bucket_alloc_t *ba;     /* bb and tb live as long as the socket */
     apr_bucket_brigade *bb;
     apr_bucket_brigade *tb;
     apr_memcache_server_t *ms;
@@ -70,6 +74,23 @@ struct apr_memcache_conn_t
 #define MC_QUIT "quit"
 #define MC_QUIT_LEN (sizeof(MC_QUIT)-1)
 
+#define MC_META_GET "mg "
+#define MC_META_GET_LEN (sizeof(MC_META_GET)-1)
+
+#define MC_META_SET "ms "
+#define MC_META_SET_LEN (sizeof(MC_META_SET)-1)
+
+#define MC_META_DELETE "md "
+#define MC_META_DELETE_LEN (sizeof(MC_META_DELETE)-1)
+
+#define MC_META_NOOP "mn"
+#define MC_META_NOOP_LEN (sizeof(MC_META_NOOP)-1)
+
+/* the flags of an mg in a multiple get: quiet, and an opaque token which
+ * is the index of the value, of a fixed width filled in when sent */
+#define MC_META_MGET_FLAGS " v f q O%08x" MC_EOL
+#define MC_META_MGET_FLAGS_LEN (sizeof(" v f q O00000000" MC_EOL)-1)
+
 /* Strings for Server Replies */
 
 #define MS_STORED "STORED"
@@ -99,12 +120,45 @@ struct apr_memcache_conn_t
 #define MS_END "END"
 #define MS_END_LEN (sizeof(MS_END)-1)
 
+#define MS_META_VALUE "VA "
+#define MS_META_VALUE_LEN (sizeof(MS_META_VALUE)-1)
+
+#define MS_META_HIT "HD"
+#define MS_META_HIT_LEN (sizeof(MS_META_HIT)-1)
+
+#define MS_META_MISS "EN"
+#define MS_META_MISS_LEN (sizeof(MS_META_MISS)-1)
+
+#define MS_META_NOT_STORED "NS"
+#define MS_META_NOT_STORED_LEN (sizeof(MS_META_NOT_STORED)-1)
+
+#define MS_META_EXISTS "EX"
+#define MS_META_EXISTS_LEN (sizeof(MS_META_EXISTS)-1)
+
+#define MS_META_NOT_FOUND "NF"
+#define MS_META_NOT_FOUND_LEN (sizeof(MS_META_NOT_FOUND)-1)
+
+#define MS_META_NOOP "MN"
+#define MS_META_NOOP_LEN (sizeof(MS_META_NOOP)-1)
+
 /** Server and Query Structure for a multiple get */
 struct cache_server_query_t {
     apr_memcache_server_t* ms;
-    apr_memcache_conn_t* conn;
+    apr_memcache_conn_t* conn; /* NULL unless queried */
     struct iovec* query_vec;
     apr_int32_t query_vec_count;
+    apr_int32_t query_vec_alloc;
+    apr_int32_t query_vec_sent; /* the vectors already written */
+    apr_uint32_t batch_keys;    /* the keys of the last get line */
+    apr_uint32_t ends;          /* the END replies still awaited */
+    apr_array_header_t *values; /* the values asked */
+    apr_memcache_value_t *value; /* whose data is being read, if any */
+    apr_size_t value_len;
+    apr_uint16_t value_flags;
+    char *tokens;               /* the mg flags of the values (meta) */
+    apr_size_t tokens_alloc;
+    apr_interval_time_t timeout; /* of conn->sock, restored when done */
+    apr_pollfd_t pfd;
 };
 
 #define MULT_GET_TIMEOUT 50000
@@ -156,55 +210,192 @@ apr_memcache_find_server_hash(apr_memcache_t *mc, const apr_uint32_t hash)
     }
 }   
 
-APR_DECLARE(apr_memcache_server_t *) 
+/* Whether a server can be used, trying a dead one every 5 seconds */
+static int server_usable(apr_memcache_t *mc, apr_memcache_server_t *ms,
+                         apr_time_t *curtime)
+{
+    int usable = 0;
+
+    if (ms->status == APR_MC_SERVER_LIVE) {
+        return 1;
+    }
+
+    if (*curtime == 0) {
+        *curtime = apr_time_now();
+    }
+#if APR_HAS_THREADS
+    apr_thread_mutex_lock(ms->lock);
+#endif
+    if (*curtime - ms->btime > apr_time_from_sec(5)) {
+        ms->btime = *curtime;
+        if (mc_version_ping(ms) == APR_SUCCESS) {
+            make_server_live(mc, ms);
+            usable = 1;
+        }
+    }
+#if APR_HAS_THREADS
+    apr_thread_mutex_unlock(ms->lock);
+#endif
+
+    return usable;
+}
+
+APR_DECLARE(apr_memcache_server_t *)
 apr_memcache_find_server_hash_default(void *baton, apr_memcache_t *mc,
                                       const apr_uint32_t hash)
 {
-    apr_memcache_server_t *ms = NULL;
+    apr_memcache_server_t *ms;
     apr_uint32_t h = hash ? hash : 1;
-    apr_uint32_t i = 0;
+    apr_uint32_t i;
+    apr_time_t curtime = 0;
+
+    for (i = 0; i < mc->ntotal; i++, h++) {
+        ms = mc->live_servers[h % mc->ntotal];
+        if (server_usable(mc, ms, &curtime)) {
+            return ms;
+        }
+    }
+
+    return NULL;
+}
+
+/* Jump consistent hash (Lamping and Veach): the bucket in [0, n) of key,
+ * which changes for 1/n of the keys only when growing to n buckets.
+ */
+static apr_int32_t jump_hash(apr_uint64_t key, apr_int32_t n)
+{
+    apr_int64_t b = -1, j = 0;
+
+    while (j < n) {
+        b = j;
+        key = key * APR_UINT64_C(2862933555777941757) + 1;
+        j = (apr_int64_t)((b + 1) * ((double)(APR_INT64_C(1) << 31)
+                                     / (double)((key >> 33) + 1)));
+    }
+
+    return (apr_int32_t)b;
+}
+
+APR_DECLARE(apr_memcache_server_t *)
+apr_memcache_find_server_hash_jump(void *baton, apr_memcache_t *mc,
+                                   const apr_uint32_t hash)
+{
+    apr_memcache_server_t *ms;
+    apr_uint64_t key = hash;
+    apr_uint32_t i;
+    apr_time_t curtime = 0;
+
+    for (i = 0; i < mc->ntotal; i++) {
+        ms = mc->live_servers[jump_hash(key, mc->ntotal)];
+        if (server_usable(mc, ms, &curtime)) {
+            return ms;
+        }
+        /* Dead, so rehash: the keys of the live servers don't move */
+        key += APR_UINT64_C(0x9E3779B97F4A7C15);
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    apr_uint32_t point;
+    apr_memcache_server_t *server;
+} continuum_point_t;
+
+struct apr_memcache_continuum_t {
+    apr_uint32_t npoints;
+    continuum_point_t *points;
+};
+
+static int continuum_point_cmp(const void *a, const void *b)
+{
+    apr_uint32_t pa = ((const continuum_point_t *)a)->point;
+    apr_uint32_t pb = ((const continuum_point_t *)b)->point;
+
+    return pa < pb ? -1 : pa > pb;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_continuum_create(apr_memcache_continuum_t **continuum,
+                              apr_memcache_t *mc, apr_uint32_t points,
+                              apr_pool_t *p)
+{
+    apr_memcache_continuum_t *c;
+    apr_uint32_t i, k, n = 0;
+
+    if (points == 0) {
+        points = APR_MEMCACHE_CONTINUUM_POINTS;
+    }
+    /* Four points per MD5 digest */
+    points = (points + 3) & ~3;
+
+    c = apr_palloc(p, sizeof(*c));
+    c->points = apr_palloc(p, sizeof(*c->points) * points * mc->ntotal);
+    for (i = 0; i < mc->ntotal; i++) {
+        apr_memcache_server_t *ms = mc->live_servers[i];
+
+        for (k = 0; k < points / 4; k++) {
+            unsigned char digest[APR_MD5_DIGESTSIZE];
+            apr_md5_ctx_t md5;
+            char suffix[32];
+            int h;
+
+            /* MD5 of "host:port-k", as libketama */
+            apr_snprintf(suffix, sizeof(suffix), ":%d-%u", (int)ms->port, k);
+            apr_md5_init(&md5);
+            apr_md5_update(&md5, ms->host, strlen(ms->host));
+            apr_md5_update(&md5, suffix, strlen(suffix));
+            apr_md5_final(digest, &md5);
+            for (h = 0; h < 4; h++) {
+                c->points[n].point = ((apr_uint32_t)digest[3 + h * 4] << 24)
+                                   | ((apr_uint32_t)digest[2 + h * 4] << 16)
+                                   | ((apr_uint32_t)digest[1 + h * 4] << 8)
+                                   | digest[h * 4];
+                c->points[n].server = ms;
+                n++;
+            }
+        }
+    }
+    c->npoints = n;
+    qsort(c->points, n, sizeof(*c->points), continuum_point_cmp);
+
+    *continuum = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_memcache_server_t *)
+apr_memcache_find_server_hash_ketama(void *baton, apr_memcache_t *mc,
+                                     const apr_uint32_t hash)
+{
+    apr_memcache_continuum_t *c = baton;
+    apr_uint32_t lo = 0, hi, i;
     apr_time_t curtime = 0;
-   
-    if(mc->ntotal == 0) {
+
+    if (!c || c->npoints == 0) {
         return NULL;
     }
 
-    do {
-        ms = mc->live_servers[h % mc->ntotal];
-        if(ms->status == APR_MC_SERVER_LIVE) {
-            break;
+    /* The first point at or after the hash, wrapping around */
+    hi = c->npoints;
+    while (lo < hi) {
+        apr_uint32_t mid = lo + (hi - lo) / 2;
+        if (c->points[mid].point < hash) {
+            lo = mid + 1;
         }
         else {
-            if (curtime == 0) {
-                curtime = apr_time_now();
-            }
-#if APR_HAS_THREADS
-            apr_thread_mutex_lock(ms->lock);
-#endif
-            /* Try the dead server, every 5 seconds */
-            if (curtime - ms->btime >  apr_time_from_sec(5)) {
-                ms->btime = curtime;
-                if (mc_version_ping(ms) == APR_SUCCESS) {
-                    make_server_live(mc, ms);
-#if APR_HAS_THREADS
-                    apr_thread_mutex_unlock(ms->lock);
-#endif
-                    break;
-                }
-            }
-#if APR_HAS_THREADS
-            apr_thread_mutex_unlock(ms->lock);
-#endif
+            hi = mid;
         }
-        h++;
-        i++;
-    } while(i < mc->ntotal);
+    }
 
-    if (i == mc->ntotal) {
-        ms = NULL;
+    /* Dead servers pass their keys to the next points */
+    for (i = 0; i < c->npoints; i++) {
+        apr_memcache_server_t *ms = c->points[(lo + i) % c->npoints].server;
+        if (server_usable(mc, ms, &curtime)) {
+            return ms;
+        }
     }
 
-    return ms;
+    return NULL;
 }
 
 APR_DECLARE(apr_memcache_server_t *) apr_memcache_find_server(apr_memcache_t *mc, const char *host, apr_port_t port)
@@ -225,8 +416,6 @@ APR_DECLARE(apr_memcache_server_t *) apr_memcache_find_server(apr_memcache_t *mc
 static apr_status_t ms_find_conn(apr_memcache_server_t *ms, apr_memcache_conn_t **conn) 
 {
     apr_status_t rv;
-    apr_bucket_alloc_t *balloc;
-    apr_bucket *e;
 
 #if APR_HAS_THREADS
     rv = apr_reslist_acquire(ms->conns, (void **)conn);
@@ -239,18 +428,22 @@ static apr_status_t ms_find_conn(apr_memcache_server_t *ms, apr_memcache_conn_t
         return rv;
     }
 
-    balloc = apr_bucket_alloc_create((*conn)->tp);
-    (*conn)->bb = apr_brigade_create((*conn)->tp, balloc);
-    (*conn)->tb = apr_brigade_create((*conn)->tp, balloc);
-
-    e = apr_bucket_socket_create((*conn)->sock, balloc);
-    APR_BRIGADE_INSERT_TAIL((*conn)->bb, e);
+    /* the brigades are kept from one use to the next, the socket bucket
+     * only being gone once it has read the end of the connection */
+    if (APR_BRIGADE_EMPTY((*conn)->bb)) {
+        apr_bucket *e = apr_bucket_socket_create((*conn)->sock, (*conn)->ba);
+        APR_BRIGADE_INSERT_TAIL((*conn)->bb, e);
+    }
 
     return rv;
 }
 
 static apr_status_t ms_bad_conn(apr_memcache_server_t *ms, apr_memcache_conn_t *conn) 
 {
+    /* whatever was read is out of sync */
+    apr_brigade_cleanup(conn->bb);
+    apr_brigade_cleanup(conn->tb);
+    conn->partial = 0;
 #if APR_HAS_THREADS
     return apr_reslist_invalidate(ms->conns, conn);
 #else
@@ -260,7 +453,7 @@ static apr_status_t ms_bad_conn(apr_memcache_server_t *ms, apr_memcache_conn_t *
 
 static apr_status_t ms_release_conn(apr_memcache_server_t *ms, apr_memcache_conn_t *conn) 
 {
-    apr_pool_clear(conn->tp);
+    apr_brigade_cleanup(conn->tb);
 #if APR_HAS_THREADS
     return apr_reslist_release(ms->conns, conn);
 #else
@@ -325,7 +518,6 @@ mc_conn_construct(void **conn_, void *params, apr_pool_t *pool)
     apr_status_t rv = APR_SUCCESS;
     apr_memcache_conn_t *conn;
     apr_pool_t *np;
-    apr_pool_t *tp;
     apr_memcache_server_t *ms = params;
 #if APR_HAVE_SOCKADDR_UN
     apr_int32_t family = ms->host[0] != '/' ? APR_INET : APR_UNIX;
@@ -338,16 +530,9 @@ mc_conn_construct(void **conn_, void *params, apr_pool_t *pool)
         return rv;
     }
 
-    rv = apr_pool_create(&tp, np);
-    if (rv != APR_SUCCESS) {
-        apr_pool_destroy(np);
-        return rv;
-    }
-
     conn = apr_palloc(np, sizeof( apr_memcache_conn_t ));
 
     conn->p = np;
-    conn->tp = tp;
 
     rv = apr_socket_create(&conn->sock, family, SOCK_STREAM, 0, np);
 
@@ -358,8 +543,13 @@ mc_conn_construct(void **conn_, void *params, apr_pool_t *pool)
 
     conn->buffer = apr_palloc(conn->p, BUFFER_SIZE + 1);
     conn->blen = 0;
+    conn->partial = 0;
     conn->ms = ms;
 
+    conn->ba = apr_bucket_alloc_create(np);
+    conn->bb = apr_brigade_create(np, conn->ba);
+    conn->tb = apr_brigade_create(np, conn->ba);
+
     rv = conn_connect(conn);
     if (rv != APR_SUCCESS) {
         apr_pool_destroy(np);
@@ -457,6 +647,7 @@ APR_DECLARE(apr_status_t) apr_memcache_create(apr_pool_t *p,
     
     mc = apr_palloc(p, sizeof(apr_memcache_t));
     mc->p = p;
+    mc->flags = flags;
     mc->nalloc = max_servers;
     mc->ntotal = 0;
     mc->live_servers = apr_palloc(p, mc->nalloc * sizeof(struct apr_memcache_server_t *));
@@ -464,96 +655,17 @@ APR_DECLARE(apr_status_t) apr_memcache_create(apr_pool_t *p,
     mc->hash_baton = NULL;
     mc->server_func = NULL;
     mc->server_baton = NULL;
+    mc->nearcache = NULL;
     *memcache = mc;
     return rv;
 }
 
 
-/* The crc32 functions and data was originally written by Spencer
- * Garrett <srg@quick.com> and was gleaned from the PostgreSQL source
- * tree via the files contrib/ltree/crc32.[ch] and from FreeBSD at
- * src/usr.bin/cksum/crc32.c.
- */ 
-
-static const apr_uint32_t crc32tab[256] = {
-  0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
-  0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
-  0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-  0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
-  0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de,
-  0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-  0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,
-  0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
-  0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-  0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
-  0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
-  0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-  0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116,
-  0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
-  0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-  0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
-  0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a,
-  0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-  0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818,
-  0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
-  0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-  0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
-  0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c,
-  0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-  0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2,
-  0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
-  0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-  0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
-  0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086,
-  0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-  0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4,
-  0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
-  0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-  0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
-  0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8,
-  0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-  0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe,
-  0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
-  0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-  0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
-  0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252,
-  0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-  0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60,
-  0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
-  0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-  0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
-  0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04,
-  0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-  0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a,
-  0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
-  0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-  0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
-  0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e,
-  0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-  0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
-  0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
-  0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-  0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
-  0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0,
-  0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-  0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6,
-  0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
-  0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-  0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
-};
-
 APR_DECLARE(apr_uint32_t) apr_memcache_hash_crc32(void *baton, 
                                                   const char *data,
                                                   const apr_size_t data_len)
 {
-    apr_uint32_t i;
-    apr_uint32_t crc;
-    crc = ~0;
-    
-    for (i = 0; i < data_len; i++)
-        crc = (crc >> 8) ^ crc32tab[(crc ^ (data[i])) & 0xff];
-    
-    return ~crc;
+    return apr_crc32(0, data, data_len);
 }
 
 APR_DECLARE(apr_uint32_t) apr_memcache_hash_default(void *baton, 
@@ -566,6 +678,17 @@ APR_DECLARE(apr_uint32_t) apr_memcache_hash_default(void *baton,
     return ((apr_memcache_hash_crc32(baton, data, data_len) >> 16) & 0x7fff);
 }
 
+APR_DECLARE(apr_uint32_t) apr_memcache_hash_ketama(void *baton,
+                                                   const char *data,
+                                                   const apr_size_t data_len)
+{
+    unsigned char digest[APR_MD5_DIGESTSIZE];
+
+    apr_md5(digest, data, data_len);
+    return ((apr_uint32_t)digest[3] << 24) | ((apr_uint32_t)digest[2] << 16)
+           | ((apr_uint32_t)digest[1] << 8) | digest[0];
+}
+
 APR_DECLARE(apr_uint32_t) apr_memcache_hash(apr_memcache_t *mc,
                                             const char *data,
                                             const apr_size_t data_len)
@@ -578,27 +701,72 @@ APR_DECLARE(apr_uint32_t) apr_memcache_hash(apr_memcache_t *mc,
     }
 }
 
-static apr_status_t get_server_line(apr_memcache_conn_t *conn)
+/* Copies the next line (BUFFER_SIZE bytes at most) from the buckets of
+ * conn->bb to conn->buffer, consuming them, where the start of a line not
+ * read completely without blocking stays until the next call.
+ */
+static apr_status_t read_server_line(apr_memcache_conn_t *conn,
+                                     apr_read_type_e block)
 {
-    apr_size_t bsize = BUFFER_SIZE;
-    apr_status_t rv = APR_SUCCESS;
+    if (!conn->partial) {
+        conn->blen = 0;
+    }
+    conn->partial = 0;
 
-    rv = apr_brigade_split_line(conn->tb, conn->bb, APR_BLOCK_READ, BUFFER_SIZE);
+    while (conn->blen < BUFFER_SIZE) {
+        apr_bucket *e = APR_BRIGADE_FIRST(conn->bb);
+        const char *str;
+        const char *pos;
+        apr_size_t len;
+        apr_status_t rv;
 
-    if (rv != APR_SUCCESS) {
-        return rv;
-    }
+        if (e == APR_BRIGADE_SENTINEL(conn->bb)) {
+            break;
+        }
+
+        rv = apr_bucket_read(e, &str, &len, block);
+        if (rv != APR_SUCCESS) {
+            conn->partial = APR_STATUS_IS_EAGAIN(rv);
+            return rv;
+        }
+
+        pos = memchr(str, APR_ASCII_LF, len);
+        if (pos) {
+            len = pos - str + 1;
+        }
+        if (len > BUFFER_SIZE - conn->blen) {
+            len = BUFFER_SIZE - conn->blen;
+        }
+        memcpy(conn->buffer + conn->blen, str, len);
+        conn->blen += len;
 
-    rv = apr_brigade_flatten(conn->tb, conn->buffer, &bsize);
+        if (len < e->length) {
+            apr_bucket_split(e, len);
+        }
+        apr_bucket_delete(e);
 
-    if (rv != APR_SUCCESS) {
-        return rv;
+        if (conn->blen && conn->buffer[conn->blen - 1] == APR_ASCII_LF) {
+            break;
+        }
     }
 
-    conn->blen = bsize;
-    conn->buffer[bsize] = '\0';
+    conn->buffer[conn->blen] = '\0';
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t get_server_line(apr_memcache_conn_t *conn)
+{
+    return read_server_line(conn, APR_BLOCK_READ);
+}
 
-    return apr_brigade_cleanup(conn->tb);
+/* The value cached in the process is stale once written */
+static void nearcache_delete(apr_memcache_t *mc, const char *key,
+                             apr_size_t klen)
+{
+    if (mc->nearcache) {
+        apr_nearcache_delete(mc->nearcache, key, klen);
+    }
 }
 
 static apr_status_t storage_cmd_write(apr_memcache_t *mc,
@@ -620,6 +788,8 @@ static apr_status_t storage_cmd_write(apr_memcache_t *mc,
 
     apr_size_t key_size = strlen(key);
 
+    nearcache_delete(mc, key, key_size);
+
     hash = apr_memcache_hash(mc, key, key_size);
 
     ms = apr_memcache_find_server_hash(mc, hash);
@@ -751,6 +921,42 @@ static int parse_size(const char *size_str, apr_size_t *size)
     return 1;
 }
 
+/* Reads the len bytes of a value and their trailing \r\n */
+static apr_status_t get_server_data(apr_memcache_conn_t *conn,
+                                    apr_size_t len,
+                                    apr_pool_t *p,
+                                    char **baton,
+                                    apr_size_t *new_length)
+{
+    apr_bucket_brigade *bbb;
+    apr_bucket *e;
+    apr_status_t rv;
+
+    /* eat the trailing \r\n */
+    rv = apr_brigade_partition(conn->bb, len+2, &e);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* the rest goes to tb, which becomes bb */
+    apr_brigade_split_ex(conn->bb, e, conn->tb);
+
+    rv = apr_brigade_pflatten(conn->bb, baton, &len, p);
+    apr_brigade_cleanup(conn->bb);
+
+    bbb = conn->bb;
+    conn->bb = conn->tb;
+    conn->tb = bbb;
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    *new_length = len - 2;
+    (*baton)[*new_length] = '\0';
+
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t)
 apr_memcache_getp(apr_memcache_t *mc,
                   apr_pool_t *p,
@@ -765,8 +971,15 @@ apr_memcache_getp(apr_memcache_t *mc,
     apr_uint32_t hash;
     apr_size_t written;
     apr_size_t klen = strlen(key);
+    apr_uint16_t vflags = 0;
     struct iovec vec[3];
 
+    if (mc->nearcache
+            && apr_nearcache_get(mc->nearcache, key, klen, p, baton,
+                                 new_length, flags_) == APR_SUCCESS) {
+        return APR_SUCCESS;
+    }
+
     hash = apr_memcache_hash(mc, key, klen);
     ms = apr_memcache_find_server_hash(mc, hash);
     if (ms == NULL)
@@ -814,8 +1027,11 @@ apr_memcache_getp(apr_memcache_t *mc,
         apr_strtok(NULL, " ", &last);
         flags = apr_strtok(NULL, " ", &last);
 
+        if (flags) {
+            vflags = atoi(flags);
+        }
         if (flags_) {
-            *flags_ = atoi(flags);
+            *flags_ = vflags;
         }
 
         length = apr_strtok(NULL, " ", &last);
@@ -825,35 +1041,12 @@ apr_memcache_getp(apr_memcache_t *mc,
             return APR_EGENERAL;
         }
         else {
-            apr_bucket_brigade *bbb;
-            apr_bucket *e;
-
-            /* eat the trailing \r\n */
-            rv = apr_brigade_partition(conn->bb, len+2, &e);
+            rv = get_server_data(conn, len, p, baton, new_length);
             if (rv != APR_SUCCESS) {
                 ms_bad_conn(ms, conn);
                 apr_memcache_disable_server(mc, ms);
                 return rv;
             }
-            
-            bbb = apr_brigade_split(conn->bb, e);
-
-            rv = apr_brigade_pflatten(conn->bb, baton, &len, p);
-            if (rv != APR_SUCCESS) {
-                ms_bad_conn(ms, conn);
-                return rv;
-            }
-
-            rv = apr_brigade_destroy(conn->bb);
-            if (rv != APR_SUCCESS) {
-                ms_bad_conn(ms, conn);
-                return rv;
-            }
-
-            conn->bb = bbb;
-
-            *new_length = len - 2;
-            (*baton)[*new_length] = '\0';
         }
         
         rv = get_server_line(conn);
@@ -868,6 +1061,11 @@ apr_memcache_getp(apr_memcache_t *mc,
             apr_memcache_disable_server(mc, ms);
             return APR_EGENERAL;
         }
+
+        if (mc->nearcache) {
+            apr_nearcache_set(mc->nearcache, key, klen, *baton, *new_length,
+                              vflags, 0);
+        }
     }
     else if (strncmp(MS_END, conn->buffer, MS_END_LEN) == 0) {
         rv = APR_NOTFOUND;
@@ -896,6 +1094,8 @@ apr_memcache_delete(apr_memcache_t *mc,
     struct iovec vec[3];
     apr_size_t klen = strlen(key);
 
+    nearcache_delete(mc, key, klen);
+
     hash = apr_memcache_hash(mc, key, klen);
     ms = apr_memcache_find_server_hash(mc, hash);
     if (ms == NULL)
@@ -950,26 +1150,67 @@ apr_memcache_delete(apr_memcache_t *mc,
     return rv;
 }
 
-static apr_status_t num_cmd_write(apr_memcache_t *mc,
-                                      char *cmd,
-                                      const apr_uint32_t cmd_size,
-                                      const char *key,
-                                      const apr_int32_t inc,
-                                      apr_uint32_t *new_value)
+/* The flags of a meta reply */
+typedef struct {
+    apr_uint16_t flags;
+    apr_uint64_t cas;
+    apr_uint32_t opaque;
+} meta_reply_t;
+
+/* Parses the flags of a meta reply line, from its first token after the
+ * code (and size) of the reply. */
+static void meta_parse_flags(char *line, meta_reply_t *reply)
+{
+    char *token;
+    char *last;
+
+    reply->flags = 0;
+    reply->cas = 0;
+    reply->opaque = APR_UINT32_MAX;
+
+    if (!line) {
+        return;
+    }
+    for (token = apr_strtok(line, " \r\n", &last); token;
+         token = apr_strtok(NULL, " \r\n", &last)) {
+        switch (token[0]) {
+        case 'f':
+            reply->flags = (apr_uint16_t)strtoul(token + 1, NULL, 10);
+            break;
+        case 'c':
+            reply->cas = (apr_uint64_t)apr_strtoi64(token + 1, NULL, 10);
+            break;
+        case 'O':
+            reply->opaque = (apr_uint32_t)strtoul(token + 1, NULL, 16);
+            break;
+        }
+    }
+}
+
+/* Sends a meta command and reads the first line of its reply */
+static apr_status_t meta_cmd(apr_memcache_t *mc,
+                             const char *cmd, apr_size_t cmd_size,
+                             const char *key,
+                             char *data, apr_size_t data_size,
+                             apr_memcache_server_t **ms_,
+                             apr_memcache_conn_t **conn_,
+                             const char *fmt, ...)
 {
     apr_status_t rv;
     apr_memcache_server_t *ms;
     apr_memcache_conn_t *conn;
     apr_uint32_t hash;
     apr_size_t written;
-    struct iovec vec[3];
     apr_size_t klen = strlen(key);
+    struct iovec vec[5];
+    int nvec = 3;
+    va_list ap;
 
     hash = apr_memcache_hash(mc, key, klen);
     ms = apr_memcache_find_server_hash(mc, hash);
     if (ms == NULL)
         return APR_NOTFOUND;
-    
+
     rv = ms_find_conn(ms, &conn);
 
     if (rv != APR_SUCCESS) {
@@ -977,19 +1218,31 @@ static apr_status_t num_cmd_write(apr_memcache_t *mc,
         return rv;
     }
 
-    /* <cmd> <key> <value>\r\n */
-    vec[0].iov_base = cmd;
+    /* <command name> <key>[ <flag>[...]]\r\n[<data>\r\n] */
+    vec[0].iov_base = (void*)cmd;
     vec[0].iov_len  = cmd_size;
 
     vec[1].iov_base = (void*)key;
     vec[1].iov_len  = klen;
 
-    klen = apr_snprintf(conn->buffer, BUFFER_SIZE, " %u" MC_EOL, inc);
+    va_start(ap, fmt);
+    klen = apr_vsnprintf(conn->buffer, BUFFER_SIZE, fmt, ap);
+    va_end(ap);
 
     vec[2].iov_base = conn->buffer;
     vec[2].iov_len  = klen;
 
-    rv = apr_socket_sendv(conn->sock, vec, 3, &written);
+    if (data) {
+        vec[3].iov_base = data;
+        vec[3].iov_len  = data_size;
+
+        vec[4].iov_base = MC_EOL;
+        vec[4].iov_len  = MC_EOL_LEN;
+
+        nvec = 5;
+    }
+
+    rv = apr_socket_sendv(conn->sock, vec, nvec, &written);
 
     if (rv != APR_SUCCESS) {
         ms_bad_conn(ms, conn);
@@ -1004,17 +1257,69 @@ static apr_status_t num_cmd_write(apr_memcache_t *mc,
         return rv;
     }
 
-    if (strncmp(MS_ERROR, conn->buffer, MS_ERROR_LEN) == 0) {
-        rv = APR_EGENERAL;
+    *ms_ = ms;
+    *conn_ = conn;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_meta_getp(apr_memcache_t *mc,
+                       apr_pool_t *p,
+                       const char *key,
+                       apr_int32_t timeout,
+                       char **baton,
+                       apr_size_t *new_length,
+                       apr_uint16_t *flags,
+                       apr_uint64_t *cas)
+{
+    apr_status_t rv;
+    apr_memcache_server_t *ms;
+    apr_memcache_conn_t *conn;
+    char ttl[32] = "";
+
+    /* mg <key> v f c[ T<timeout>]\r\n */
+    if (timeout >= 0) {
+        apr_snprintf(ttl, sizeof(ttl), " T%d", timeout);
     }
-    else if (strncmp(MS_NOT_FOUND, conn->buffer, MS_NOT_FOUND_LEN) == 0) {
+    rv = meta_cmd(mc, MC_META_GET, MC_META_GET_LEN, key, NULL, 0, &ms, &conn,
+                  " v f c%s" MC_EOL, ttl);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    if (strncmp(MS_META_VALUE, conn->buffer, MS_META_VALUE_LEN) == 0) {
+        meta_reply_t reply;
+        apr_size_t len = 0;
+
+        if (!parse_size(conn->buffer + MS_META_VALUE_LEN, &len)) {
+            ms_bad_conn(ms, conn);
+            apr_memcache_disable_server(mc, ms);
+            return APR_EGENERAL;
+        }
+        meta_parse_flags(strchr(conn->buffer + MS_META_VALUE_LEN, ' '),
+                         &reply);
+
+        rv = get_server_data(conn, len, p, baton, new_length);
+        if (rv != APR_SUCCESS) {
+            ms_bad_conn(ms, conn);
+            apr_memcache_disable_server(mc, ms);
+            return rv;
+        }
+
+        if (flags) {
+            *flags = reply.flags;
+        }
+        if (cas) {
+            *cas = reply.cas;
+        }
+    }
+    else if (strncmp(MS_META_MISS, conn->buffer, MS_META_MISS_LEN) == 0) {
         rv = APR_NOTFOUND;
     }
     else {
-        if (new_value) {
-            *new_value = atoi(conn->buffer);
-        }
-        rv = APR_SUCCESS;
+        ms_bad_conn(ms, conn);
+        apr_memcache_disable_server(mc, ms);
+        return APR_EGENERAL;
     }
 
     ms_release_conn(ms, conn);
@@ -1022,7 +1327,168 @@ static apr_status_t num_cmd_write(apr_memcache_t *mc,
     return rv;
 }
 
-APR_DECLARE(apr_status_t)
+/* The status of a meta set or delete reply */
+static apr_status_t meta_status(const char *line)
+{
+    if (strncmp(MS_META_HIT, line, MS_META_HIT_LEN) == 0) {
+        return APR_SUCCESS;
+    }
+    else if (strncmp(MS_META_NOT_STORED, line, MS_META_NOT_STORED_LEN) == 0
+             || strncmp(MS_META_EXISTS, line, MS_META_EXISTS_LEN) == 0) {
+        return APR_EEXIST;
+    }
+    else if (strncmp(MS_META_NOT_FOUND, line, MS_META_NOT_FOUND_LEN) == 0) {
+        return APR_NOTFOUND;
+    }
+    return APR_EGENERAL;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_meta_set(apr_memcache_t *mc,
+                      const char *key,
+                      char *data,
+                      const apr_size_t data_size,
+                      apr_uint32_t timeout,
+                      apr_uint16_t flags,
+                      apr_uint64_t cas,
+                      apr_uint64_t *new_cas)
+{
+    apr_status_t rv;
+    apr_memcache_server_t *ms;
+    apr_memcache_conn_t *conn;
+    char compare[32] = "";
+
+    nearcache_delete(mc, key, strlen(key));
+
+    /* ms <key> <bytes> T<timeout> F<flags>[ C<cas>] c\r\n<data>\r\n */
+    if (cas) {
+        apr_snprintf(compare, sizeof(compare), " C%" APR_UINT64_T_FMT, cas);
+    }
+    rv = meta_cmd(mc, MC_META_SET, MC_META_SET_LEN, key, data, data_size,
+                  &ms, &conn,
+                  " %" APR_SIZE_T_FMT " T%u F%u%s c" MC_EOL,
+                  data_size, timeout, flags, compare);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rv = meta_status(conn->buffer);
+    if (rv == APR_SUCCESS && new_cas) {
+        meta_reply_t reply;
+
+        meta_parse_flags(strchr(conn->buffer, ' '), &reply);
+        *new_cas = reply.cas;
+    }
+
+    ms_release_conn(ms, conn);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_meta_delete(apr_memcache_t *mc,
+                         const char *key,
+                         apr_uint64_t cas)
+{
+    apr_status_t rv;
+    apr_memcache_server_t *ms;
+    apr_memcache_conn_t *conn;
+    char compare[32] = "";
+
+    nearcache_delete(mc, key, strlen(key));
+
+    /* md <key>[ C<cas>]\r\n */
+    if (cas) {
+        apr_snprintf(compare, sizeof(compare), " C%" APR_UINT64_T_FMT, cas);
+    }
+    rv = meta_cmd(mc, MC_META_DELETE, MC_META_DELETE_LEN, key, NULL, 0,
+                  &ms, &conn, "%s" MC_EOL, compare);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rv = meta_status(conn->buffer);
+
+    ms_release_conn(ms, conn);
+
+    return rv;
+}
+
+static apr_status_t num_cmd_write(apr_memcache_t *mc,
+                                      char *cmd,
+                                      const apr_uint32_t cmd_size,
+                                      const char *key,
+                                      const apr_int32_t inc,
+                                      apr_uint32_t *new_value)
+{
+    apr_status_t rv;
+    apr_memcache_server_t *ms;
+    apr_memcache_conn_t *conn;
+    apr_uint32_t hash;
+    apr_size_t written;
+    struct iovec vec[3];
+    apr_size_t klen = strlen(key);
+
+    nearcache_delete(mc, key, klen);
+
+    hash = apr_memcache_hash(mc, key, klen);
+    ms = apr_memcache_find_server_hash(mc, hash);
+    if (ms == NULL)
+        return APR_NOTFOUND;
+    
+    rv = ms_find_conn(ms, &conn);
+
+    if (rv != APR_SUCCESS) {
+        apr_memcache_disable_server(mc, ms);
+        return rv;
+    }
+
+    /* <cmd> <key> <value>\r\n */
+    vec[0].iov_base = cmd;
+    vec[0].iov_len  = cmd_size;
+
+    vec[1].iov_base = (void*)key;
+    vec[1].iov_len  = klen;
+
+    klen = apr_snprintf(conn->buffer, BUFFER_SIZE, " %u" MC_EOL, inc);
+
+    vec[2].iov_base = conn->buffer;
+    vec[2].iov_len  = klen;
+
+    rv = apr_socket_sendv(conn->sock, vec, 3, &written);
+
+    if (rv != APR_SUCCESS) {
+        ms_bad_conn(ms, conn);
+        apr_memcache_disable_server(mc, ms);
+        return rv;
+    }
+
+    rv = get_server_line(conn);
+    if (rv != APR_SUCCESS) {
+        ms_bad_conn(ms, conn);
+        apr_memcache_disable_server(mc, ms);
+        return rv;
+    }
+
+    if (strncmp(MS_ERROR, conn->buffer, MS_ERROR_LEN) == 0) {
+        rv = APR_EGENERAL;
+    }
+    else if (strncmp(MS_NOT_FOUND, conn->buffer, MS_NOT_FOUND_LEN) == 0) {
+        rv = APR_NOTFOUND;
+    }
+    else {
+        if (new_value) {
+            *new_value = atoi(conn->buffer);
+        }
+        rv = APR_SUCCESS;
+    }
+
+    ms_release_conn(ms, conn);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t)
 apr_memcache_incr(apr_memcache_t *mc,
                     const char *key,
                     apr_int32_t inc,
@@ -1158,330 +1624,1073 @@ apr_memcache_add_multget_key(apr_pool_t *data_pool,
     apr_hash_set(*values, value->key, klen, value);
 }
 
-static void mget_conn_result(int serverup,
-                             int connup,
-                             apr_status_t rv,
-                             apr_memcache_t *mc,
-                             apr_memcache_server_t *ms,
-                             apr_memcache_conn_t *conn,
-                             struct cache_server_query_t *server_query,
-                             apr_hash_t *values,
-                             apr_hash_t *server_queries)
+struct apr_memcache_multget_t {
+    apr_memcache_t *mc;
+    apr_pool_t *p;
+    apr_uint32_t max_keys;
+    apr_interval_time_t timeout;
+    apr_pollset_t *pollset;
+    /* one per server slot, reused by each call */
+    struct cache_server_query_t *queries;
+};
+
+APR_DECLARE(apr_status_t)
+apr_memcache_multget_create(apr_memcache_multget_t **multget,
+                            apr_memcache_t *mc,
+                            apr_uint32_t max_keys,
+                            apr_interval_time_t timeout,
+                            apr_pool_t *p)
 {
-    apr_int32_t j;
-    apr_memcache_value_t* value;
-    
-    apr_hash_set(server_queries, &ms, sizeof(ms), NULL);
+    apr_memcache_multget_t *ctx;
+    apr_status_t rv;
+    apr_uint16_t i;
 
-    if (connup) {
-        ms_release_conn(ms, conn);
-    } else {
-        ms_bad_conn(ms, conn);
+    ctx = apr_pcalloc(p, sizeof(apr_memcache_multget_t));
+    ctx->mc = mc;
+    ctx->p = p;
+    ctx->max_keys = max_keys ? max_keys : APR_MEMCACHE_MULTGET_KEYS;
+    ctx->timeout = timeout ? timeout : MULT_GET_TIMEOUT;
 
-        if (!serverup) {
-            apr_memcache_disable_server(mc, ms);
-        }
+    rv = apr_pollset_create(&ctx->pollset, mc->nalloc ? mc->nalloc : 1, p,
+                            APR_POLLSET_NOCOPY);
+    if (rv != APR_SUCCESS) {
+        return rv;
     }
-    
-    for (j = 1; j < server_query->query_vec_count ; j+=2) {
-        if (server_query->query_vec[j].iov_base) {
-            value = apr_hash_get(values, server_query->query_vec[j].iov_base,
-                                 strlen(server_query->query_vec[j].iov_base));
-            
-            if (value->status == APR_NOTFOUND) {
-                value->status = rv;
-            }
-        }
+
+    ctx->queries = apr_pcalloc(p, mc->nalloc
+                                  * sizeof(struct cache_server_query_t));
+    for (i = 0; i < mc->nalloc; i++) {
+        ctx->queries[i].values = apr_array_make(p, 16,
+                                                sizeof(apr_memcache_value_t *));
     }
+
+    *multget = ctx;
+    return APR_SUCCESS;
 }
 
-APR_DECLARE(apr_status_t)
-apr_memcache_multgetp(apr_memcache_t *mc,
-                      apr_pool_t *temp_pool,
-                      apr_pool_t *data_pool,
-                      apr_hash_t *values)
+static struct cache_server_query_t *mget_query(apr_memcache_multget_t *ctx,
+                                               apr_memcache_server_t *ms)
 {
-    apr_status_t rv;
-    apr_memcache_server_t* ms;
-    apr_memcache_conn_t* conn;
-    apr_uint32_t hash;
-    apr_size_t written;
-    apr_size_t klen;
-
-    apr_memcache_value_t* value;
-    apr_hash_index_t* value_hash_index;
-
-    /* this is a little over aggresive, but beats multiple loops
-     * to figure out how long each vector needs to be per-server.
-     */
-    apr_int32_t veclen = 2 + 2 * apr_hash_count(values) - 1; /* get <key>[<space><key>...]\r\n */
-    apr_int32_t i, j;
-    apr_int32_t queries_sent;
-    apr_int32_t queries_recvd;
-
-    apr_hash_t * server_queries = apr_hash_make(temp_pool);
-    struct cache_server_query_t* server_query;
-    apr_hash_index_t * query_hash_index;
+    apr_uint16_t i;
 
-    apr_pollset_t* pollset;
-    const apr_pollfd_t* activefds;
-    apr_pollfd_t* pollfds;
+    for (i = 0; i < ctx->mc->ntotal; i++) {
+        if (ctx->mc->live_servers[i] == ms) {
+            return &ctx->queries[i];
+        }
+    }
+    return NULL;
+}
 
+static void mget_query_vec(apr_memcache_multget_t *ctx,
+                           struct cache_server_query_t *server_query,
+                           void *base, apr_size_t len)
+{
+    struct iovec *vec;
 
-    /* build all the queries */
-    value_hash_index = apr_hash_first(temp_pool, values);
-    while (value_hash_index) {
-        void *v;
-        apr_hash_this(value_hash_index, NULL, NULL, &v);
-        value = v;
-        value_hash_index = apr_hash_next(value_hash_index);
-        klen = strlen(value->key);
+    if (server_query->query_vec_count == server_query->query_vec_alloc) {
+        apr_int32_t alloc = server_query->query_vec_alloc * 2;
 
-        hash = apr_memcache_hash(mc, value->key, klen);
-        ms = apr_memcache_find_server_hash(mc, hash);
-        if (ms == NULL) {
-            continue;
+        if (alloc < 64) {
+            alloc = 64;
         }
+        vec = apr_palloc(ctx->p, alloc * sizeof(struct iovec));
+        if (server_query->query_vec_count) {
+            memcpy(vec, server_query->query_vec,
+                   server_query->query_vec_count * sizeof(struct iovec));
+        }
+        server_query->query_vec = vec;
+        server_query->query_vec_alloc = alloc;
+    }
 
-        server_query = apr_hash_get(server_queries, &ms, sizeof(ms));
+    vec = &server_query->query_vec[server_query->query_vec_count++];
+    vec->iov_base = base;
+    vec->iov_len = len;
+}
 
-        if (!server_query) {
-            rv = ms_find_conn(ms, &conn);
+/* get <key>[<space><key>...]\r\n, in lines of max_keys keys at most */
+static void mget_query_key(apr_memcache_multget_t *ctx,
+                           struct cache_server_query_t *server_query,
+                           apr_memcache_value_t *value)
+{
+    if (ctx->mc->flags & APR_MEMCACHE_META) {
+        /* mg <key> v f q O<index>\r\n, the flags being filled in by
+         * mget_query_end() */
+        mget_query_vec(ctx, server_query, MC_META_GET, MC_META_GET_LEN);
+        mget_query_vec(ctx, server_query, (void *)value->key,
+                       strlen(value->key));
+        mget_query_vec(ctx, server_query, NULL, MC_META_MGET_FLAGS_LEN);
+        APR_ARRAY_PUSH(server_query->values, apr_memcache_value_t *) = value;
+        return;
+    }
 
-            if (rv != APR_SUCCESS) {
-                apr_memcache_disable_server(mc, ms);
-                value->status = rv;
-                continue;
-            }
+    if (server_query->batch_keys == 0) {
+        mget_query_vec(ctx, server_query, MC_GET, MC_GET_LEN);
+    }
+    else {
+        mget_query_vec(ctx, server_query, MC_WS, MC_WS_LEN);
+    }
+    mget_query_vec(ctx, server_query, (void *)value->key, strlen(value->key));
+    APR_ARRAY_PUSH(server_query->values, apr_memcache_value_t *) = value;
 
-            server_query = apr_pcalloc(temp_pool,sizeof(struct cache_server_query_t));
+    if (++server_query->batch_keys == ctx->max_keys) {
+        mget_query_vec(ctx, server_query, MC_EOL, MC_EOL_LEN);
+        server_query->batch_keys = 0;
+        server_query->ends++;
+    }
+}
 
-            apr_hash_set(server_queries, &ms, sizeof(ms), server_query);
+/* Terminates the query, before it is sent */
+static void mget_query_end(apr_memcache_multget_t *ctx,
+                           struct cache_server_query_t *server_query)
+{
+    if (ctx->mc->flags & APR_MEMCACHE_META) {
+        apr_size_t size = server_query->values->nelts
+                          * MC_META_MGET_FLAGS_LEN + 1;
+        apr_int32_t i, n = 0;
+
+        if (server_query->tokens_alloc < size) {
+            server_query->tokens_alloc = size * 2;
+            server_query->tokens = apr_palloc(ctx->p,
+                                              server_query->tokens_alloc);
+        }
+        for (i = 0; i < server_query->query_vec_count; i++) {
+            struct iovec *vec = &server_query->query_vec[i];
+
+            if (!vec->iov_base) {
+                vec->iov_base = server_query->tokens
+                                + n * MC_META_MGET_FLAGS_LEN;
+                apr_snprintf(vec->iov_base, MC_META_MGET_FLAGS_LEN + 1,
+                             MC_META_MGET_FLAGS, n);
+                n++;
+            }
+        }
 
-            server_query->ms = ms;
-            server_query->conn = conn;
-            server_query->query_vec = apr_pcalloc(temp_pool, sizeof(struct iovec)*veclen);
+        /* the misses are not answered, mn tells the end */
+        mget_query_vec(ctx, server_query, MC_META_NOOP, MC_META_NOOP_LEN);
+        mget_query_vec(ctx, server_query, MC_EOL, MC_EOL_LEN);
+        server_query->ends = 1;
+    }
+    else if (server_query->batch_keys) {
+        mget_query_vec(ctx, server_query, MC_EOL, MC_EOL_LEN);
+        server_query->batch_keys = 0;
+        server_query->ends++;
+    }
+}
 
-            /* set up the first key */
-            server_query->query_vec[0].iov_base = MC_GET;
-            server_query->query_vec[0].iov_len  = MC_GET_LEN;
+/* Writes what the socket takes of the query without blocking */
+static apr_status_t mget_send(struct cache_server_query_t *server_query)
+{
+    apr_status_t rv = APR_SUCCESS;
 
-            server_query->query_vec[1].iov_base = (void*)(value->key);
-            server_query->query_vec[1].iov_len  = klen;
+    while (server_query->query_vec_sent < server_query->query_vec_count) {
+        struct iovec *vec;
+        apr_int32_t n;
+        apr_size_t written = 0;
 
-            server_query->query_vec[2].iov_base = MC_EOL;
-            server_query->query_vec[2].iov_len  = MC_EOL_LEN;
+        vec = &server_query->query_vec[server_query->query_vec_sent];
+        n = server_query->query_vec_count - server_query->query_vec_sent;
+        if (n > APR_MAX_IOVEC_SIZE) {
+            n = APR_MAX_IOVEC_SIZE;
+        }
+        rv = apr_socket_sendv(server_query->conn->sock, vec, n, &written);
+
+        /* skip what was written, resuming within a vector if need be */
+        while (server_query->query_vec_sent < server_query->query_vec_count
+               && vec->iov_len <= written) {
+            written -= vec->iov_len;
+            server_query->query_vec_sent++;
+            vec++;
+        }
+        if (written) {
+            vec->iov_base = (char *)vec->iov_base + written;
+            vec->iov_len -= written;
+        }
 
-            server_query->query_vec_count = 3;
+        if (rv != APR_SUCCESS) {
+            break;
         }
-        else {
-            j = server_query->query_vec_count - 1;
+    }
 
-            server_query->query_vec[j].iov_base = MC_WS;
-            server_query->query_vec[j].iov_len  = MC_WS_LEN;
-            j++;
+    return rv;
+}
 
-            server_query->query_vec[j].iov_base = (void*)(value->key);
-            server_query->query_vec[j].iov_len  = klen;
-            j++;
+/* Whether need bytes can be read from bb without blocking */
+static apr_status_t mget_avail(apr_bucket_brigade *bb, apr_size_t need)
+{
+    apr_size_t have = 0;
+    apr_bucket *e;
 
-            server_query->query_vec[j].iov_base = MC_EOL;
-            server_query->query_vec[j].iov_len  = MC_EOL_LEN;
-            j++;
+    for (e = APR_BRIGADE_FIRST(bb); have < need; e = APR_BUCKET_NEXT(e)) {
+        const char *str;
+        apr_size_t len;
+        apr_status_t rv;
 
-           server_query->query_vec_count = j;
+        if (e == APR_BRIGADE_SENTINEL(bb)) {
+            return APR_EOF;
+        }
+        rv = apr_bucket_read(e, &str, &len, APR_NONBLOCK_READ);
+        if (rv != APR_SUCCESS) {
+            return rv;
         }
+        have += len;
     }
 
-    /* create polling structures */
-    pollfds = apr_pcalloc(temp_pool, apr_hash_count(server_queries) * sizeof(apr_pollfd_t));
-    
-    rv = apr_pollset_create(&pollset, apr_hash_count(server_queries), temp_pool,
-                            APR_POLLSET_NOCOPY);
+    return APR_SUCCESS;
+}
 
+/* get_server_line() without blocking, a partial line staying in
+ * conn->buffer until the next call */
+static apr_status_t mget_server_line(apr_memcache_conn_t *conn)
+{
+    apr_status_t rv;
+
+    rv = read_server_line(conn, APR_NONBLOCK_READ);
     if (rv != APR_SUCCESS) {
-        query_hash_index = apr_hash_first(temp_pool, server_queries);
+        return rv;
+    }
 
-        while (query_hash_index) {
-            void *v;
-            apr_hash_this(query_hash_index, NULL, NULL, &v);
-            server_query = v;
-            query_hash_index = apr_hash_next(query_hash_index);
+    if (conn->blen == 0) {
+        return APR_EOF;
+    }
+    if (conn->buffer[conn->blen - 1] != APR_ASCII_LF) {
+        /* too long, or truncated by the end of the connection */
+        return APR_EGENERAL;
+    }
 
-            mget_conn_result(TRUE, TRUE, rv, mc, server_query->ms, server_query->conn,
-                             server_query, values, server_queries);
-        }
+    return APR_SUCCESS;
+}
 
-        return rv;
-    }
+/* Reads the replies available, until the last END */
+static apr_status_t mget_recv(struct cache_server_query_t *server_query,
+                              apr_pool_t *data_pool,
+                              apr_hash_t *values,
+                              apr_memcache_t *mc)
+{
+    int meta = mc->flags & APR_MEMCACHE_META;
+    apr_memcache_conn_t *conn = server_query->conn;
+    apr_status_t rv;
 
-    /* send all the queries */
-    queries_sent = 0;
-    query_hash_index = apr_hash_first(temp_pool, server_queries);
+    while (server_query->ends) {
+        if (server_query->value) {
+            apr_memcache_value_t *value = server_query->value;
+            apr_bucket_brigade *bb;
+            apr_bucket *e;
+            apr_size_t len;
+            char *data;
 
-    while (query_hash_index) {
-        void *v;
-        apr_hash_this(query_hash_index, NULL, NULL, &v);
-        server_query = v;
-        query_hash_index = apr_hash_next(query_hash_index);
+            /* the data and its trailing \r\n */
+            rv = mget_avail(conn->bb, server_query->value_len + 2);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            rv = apr_brigade_partition(conn->bb, server_query->value_len + 2,
+                                       &e);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            apr_brigade_split_ex(conn->bb, e, conn->tb);
 
-        conn = server_query->conn;
-        ms = server_query->ms;
+            rv = apr_brigade_pflatten(conn->bb, &data, &len, data_pool);
+            apr_brigade_cleanup(conn->bb);
+            bb = conn->bb;
+            conn->bb = conn->tb;
+            conn->tb = bb;
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
 
-        for (i = 0, rv = APR_SUCCESS; i < veclen && rv == APR_SUCCESS; i += APR_MAX_IOVEC_SIZE) {
-            rv = apr_socket_sendv(conn->sock, &(server_query->query_vec[i]),
-                                  veclen-i>APR_MAX_IOVEC_SIZE ? APR_MAX_IOVEC_SIZE : veclen-i , &written);
+            value->len = len - 2;
+            data[value->len] = '\0';
+            value->data = data;
+            value->status = APR_SUCCESS;
+            value->flags = server_query->value_flags;
+            server_query->value = NULL;
+            if (mc->nearcache) {
+                apr_nearcache_set(mc->nearcache, value->key,
+                                  strlen(value->key), value->data,
+                                  value->len, value->flags, 0);
+            }
+            continue;
         }
 
+        rv = mget_server_line(conn);
         if (rv != APR_SUCCESS) {
-            mget_conn_result(FALSE, FALSE, rv, mc, ms, conn,
-                             server_query, values, server_queries);
-            continue;
+            return rv;
         }
 
-        pollfds[queries_sent].desc_type = APR_POLL_SOCKET;
-        pollfds[queries_sent].reqevents = APR_POLLIN;
-        pollfds[queries_sent].p = temp_pool;
-        pollfds[queries_sent].desc.s = conn->sock;
-        pollfds[queries_sent].client_data = (void *)server_query;
-        apr_pollset_add (pollset, &pollfds[queries_sent]);
+        if (meta) {
+            if (strncmp(MS_META_VALUE, conn->buffer, MS_META_VALUE_LEN) == 0) {
+                meta_reply_t reply;
 
-        queries_sent++;
+                if (!parse_size(conn->buffer + MS_META_VALUE_LEN,
+                                &server_query->value_len)) {
+                    return APR_EGENERAL;
+                }
+                meta_parse_flags(strchr(conn->buffer + MS_META_VALUE_LEN, ' '),
+                                 &reply);
+
+                /* the opaque token is the index of the value */
+                if (reply.opaque >= (apr_uint32_t)server_query->values->nelts) {
+                    return APR_EGENERAL;
+                }
+                server_query->value = APR_ARRAY_IDX(server_query->values,
+                                                    reply.opaque,
+                                                    apr_memcache_value_t *);
+                server_query->value_flags = reply.flags;
+            }
+            else if (strncmp(MS_META_NOOP, conn->buffer,
+                             MS_META_NOOP_LEN) == 0) {
+                server_query->ends--;
+            }
+            else if (strncmp(MS_META_MISS, conn->buffer,
+                             MS_META_MISS_LEN) != 0) {
+                /* unknown reply? */
+                return APR_EGENERAL;
+            }
+            continue;
+        }
+
+        if (strncmp(MS_VALUE, conn->buffer, MS_VALUE_LEN) == 0) {
+            char *key;
+            char *flags;
+            char *length;
+            char *last;
+
+            apr_strtok(conn->buffer, " ", &last); /* just the VALUE, ignore */
+            key = apr_strtok(NULL, " ", &last);
+            flags = apr_strtok(NULL, " ", &last);
+            length = apr_strtok(NULL, " ", &last);
+
+            if (!length || !parse_size(length, &server_query->value_len)) {
+                return APR_EGENERAL;
+            }
+            server_query->value = apr_hash_get(values, key, strlen(key));
+            if (!server_query->value) {
+                /* Server Sent back a key I didn't ask for or my
+                 * hash is corrupt */
+                return APR_EGENERAL;
+            }
+            server_query->value_flags = atoi(flags);
+        }
+        else if (strncmp(MS_END, conn->buffer, MS_END_LEN) == 0) {
+            server_query->ends--;
+        }
+        else {
+            /* unknown reply? */
+            return APR_EGENERAL;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+static void mget_conn_result(int serverup,
+                             int connup,
+                             apr_status_t rv,
+                             apr_memcache_multget_t *ctx,
+                             struct cache_server_query_t *server_query)
+{
+    apr_memcache_server_t *ms = server_query->ms;
+    apr_memcache_conn_t *conn = server_query->conn;
+    apr_int32_t j;
+
+    apr_socket_timeout_set(conn->sock, server_query->timeout);
+    server_query->conn = NULL;
+
+    if (connup) {
+        ms_release_conn(ms, conn);
+    } else {
+        ms_bad_conn(ms, conn);
+
+        if (!serverup) {
+            apr_memcache_disable_server(ctx->mc, ms);
+        }
+    }
+
+    for (j = 0; rv != APR_SUCCESS && j < server_query->values->nelts; j++) {
+        apr_memcache_value_t *value;
+
+        value = APR_ARRAY_IDX(server_query->values, j, apr_memcache_value_t *);
+        if (value->status == APR_NOTFOUND) {
+            value->status = rv;
+        }
+    }
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_multget_exec(apr_memcache_multget_t *ctx,
+                          apr_pool_t *data_pool,
+                          apr_hash_t *values)
+{
+    apr_status_t rv;
+    apr_memcache_server_t* ms;
+    apr_memcache_conn_t* conn;
+    apr_uint32_t hash;
+    apr_size_t klen;
+
+    apr_memcache_value_t* value;
+    apr_hash_index_t* value_hash_index;
+
+    apr_int32_t i;
+    apr_int32_t queries_sent;
+    apr_int32_t queries_recvd;
+
+    struct cache_server_query_t* server_query;
+    const apr_pollfd_t* activefds;
+
+    /* build all the queries */
+    for (value_hash_index = apr_hash_first(NULL, values); value_hash_index;
+         value_hash_index = apr_hash_next(value_hash_index)) {
+        value = apr_hash_this_val(value_hash_index);
+        klen = strlen(value->key);
+
+        if (ctx->mc->nearcache
+                && apr_nearcache_get(ctx->mc->nearcache, value->key, klen,
+                                     data_pool, &value->data, &value->len,
+                                     &value->flags) == APR_SUCCESS) {
+            value->status = APR_SUCCESS;
+            continue;
+        }
+
+        hash = apr_memcache_hash(ctx->mc, value->key, klen);
+        ms = apr_memcache_find_server_hash(ctx->mc, hash);
+        if (ms == NULL) {
+            continue;
+        }
+
+        server_query = mget_query(ctx, ms);
+        if (!server_query) {
+            continue;
+        }
+
+        if (!server_query->conn) {
+            rv = ms_find_conn(ms, &conn);
+
+            if (rv != APR_SUCCESS) {
+                apr_memcache_disable_server(ctx->mc, ms);
+                value->status = rv;
+                continue;
+            }
+
+            server_query->ms = ms;
+            server_query->conn = conn;
+            server_query->query_vec_count = 0;
+            server_query->query_vec_sent = 0;
+            server_query->batch_keys = 0;
+            server_query->ends = 0;
+            server_query->value = NULL;
+            apr_array_clear(server_query->values);
+        }
+
+        mget_query_key(ctx, server_query, value);
     }
 
+    /* send all the queries, as much as the sockets take without blocking,
+     * the rest being written as the replies are read */
+    queries_sent = 0;
+    for (i = 0; i < ctx->mc->nalloc; i++) {
+        server_query = &ctx->queries[i];
+        if (!server_query->conn) {
+            continue;
+        }
+        conn = server_query->conn;
+
+        mget_query_end(ctx, server_query);
+
+        apr_socket_timeout_get(conn->sock, &server_query->timeout);
+        apr_socket_timeout_set(conn->sock, 0);
+
+        rv = mget_send(server_query);
+        if (rv != APR_SUCCESS && !APR_STATUS_IS_EAGAIN(rv)) {
+            mget_conn_result(FALSE, FALSE, rv, ctx, server_query);
+            continue;
+        }
+
+        server_query->pfd.desc_type = APR_POLL_SOCKET;
+        server_query->pfd.reqevents = APR_POLLIN;
+        if (server_query->query_vec_sent < server_query->query_vec_count) {
+            server_query->pfd.reqevents |= APR_POLLOUT;
+        }
+        server_query->pfd.p = ctx->p;
+        server_query->pfd.desc.s = conn->sock;
+        server_query->pfd.client_data = server_query;
+        rv = apr_pollset_add(ctx->pollset, &server_query->pfd);
+        if (rv != APR_SUCCESS) {
+            mget_conn_result(TRUE, FALSE, rv, ctx, server_query);
+            continue;
+        }
+
+        queries_sent++;
+    }
+
+    rv = APR_SUCCESS;
     while (queries_sent) {
-        rv = apr_pollset_poll(pollset, MULT_GET_TIMEOUT, &queries_recvd, &activefds);
+        rv = apr_pollset_poll(ctx->pollset, ctx->timeout, &queries_recvd,
+                              &activefds);
 
         if (rv != APR_SUCCESS) {
+            if (APR_STATUS_IS_EINTR(rv)) {
+                continue;
+            }
             /* timeout */
-            queries_sent = 0;
-            continue;
+            break;
         }
         for (i = 0; i < queries_recvd; i++) {
             server_query = activefds[i].client_data;
-            conn = server_query->conn;
-            ms = server_query->ms;
-
-           rv = get_server_line(conn);
-
-           if (rv != APR_SUCCESS) {
-               apr_pollset_remove (pollset, &activefds[i]);
-               mget_conn_result(FALSE, FALSE, rv, mc, ms, conn,
-                                server_query, values, server_queries);
-               queries_sent--;
-               continue;
-           }
-
-           if (strncmp(MS_VALUE, conn->buffer, MS_VALUE_LEN) == 0) {
-               char *key;
-               char *flags;
-               char *length;
-               char *last;
-               char *data;
-               apr_size_t len = 0;
-               apr_bucket *e = NULL;
-
-               apr_strtok(conn->buffer, " ", &last); /* just the VALUE, ignore */
-               key = apr_strtok(NULL, " ", &last);
-               flags = apr_strtok(NULL, " ", &last);
-               length = apr_strtok(NULL, " ", &last);
-
-               if (!length || !parse_size(length, &len)) {
-                   rv = APR_EGENERAL;
-               }
-               else {
-                   /* eat the trailing \r\n */
-                   rv = apr_brigade_partition(conn->bb, len+2, &e);
-               }
-               if (rv != APR_SUCCESS) {
-                   apr_pollset_remove (pollset, &activefds[i]);
-                   mget_conn_result(TRUE, FALSE, rv, mc, ms, conn,
-                                    server_query, values, server_queries);
-                   queries_sent--;
-                   continue;
-               }
-
-               value = apr_hash_get(values, key, strlen(key));
-               if (value) {
-                   apr_bucket_brigade *bbb;
-
-                   bbb = apr_brigade_split(conn->bb, e);
-
-                   rv = apr_brigade_pflatten(conn->bb, &data, &len, data_pool);
-                   if (rv != APR_SUCCESS) {
-                       apr_pollset_remove (pollset, &activefds[i]);
-                       mget_conn_result(TRUE, FALSE, rv, mc, ms, conn,
-                                        server_query, values, server_queries);
-                       queries_sent--;
-                       continue;
-                   }
-
-                   rv = apr_brigade_destroy(conn->bb);
-                   if (rv != APR_SUCCESS) {
-                       apr_pollset_remove (pollset, &activefds[i]);
-                       mget_conn_result(TRUE, FALSE, rv, mc, ms, conn,
-                                        server_query, values, server_queries);
-                       queries_sent--;
-                       continue;
-                   }
-
-                   conn->bb = bbb;
-
-                   value->len = len - 2;
-                   data[value->len] = '\0';
-                   value->data = data;
-
-                   value->status = rv;
-                   value->flags = atoi(flags);
-
-                   /* stay on the server */
-                   i--;
-               }
-               else {
-                   /* Server Sent back a key I didn't ask for or my
-                    * hash is corrupt */
-                   rv = APR_EGENERAL;
-               }
-           }
-           else if (strncmp(MS_END, conn->buffer, MS_END_LEN) == 0) {
-               /* this connection is done */
-               apr_pollset_remove (pollset, &activefds[i]);
-               ms_release_conn(ms, conn);
-               apr_hash_set(server_queries, &ms, sizeof(ms), NULL);
-               queries_sent--;
-           }
-           else {
-               /* unknown reply? */
-               rv = APR_EGENERAL;
-           }
-           if (rv != APR_SUCCESS) {
-               apr_pollset_remove (pollset, &activefds[i]);
-               mget_conn_result(TRUE, FALSE, rv, mc, ms, conn,
-                                server_query, values, server_queries);
-               queries_sent--;
-           }
+
+            if (!server_query->conn) {
+                continue;
+            }
+
+            if (server_query->query_vec_sent < server_query->query_vec_count) {
+                rv = mget_send(server_query);
+                if (rv != APR_SUCCESS && !APR_STATUS_IS_EAGAIN(rv)) {
+                    apr_pollset_remove(ctx->pollset, &server_query->pfd);
+                    mget_conn_result(FALSE, FALSE, rv, ctx, server_query);
+                    queries_sent--;
+                    continue;
+                }
+                if (server_query->query_vec_sent
+                        == server_query->query_vec_count) {
+                    apr_pollset_remove(ctx->pollset, &server_query->pfd);
+                    server_query->pfd.reqevents = APR_POLLIN;
+                    apr_pollset_add(ctx->pollset, &server_query->pfd);
+                }
+            }
+
+            if (!(activefds[i].rtnevents & (APR_POLLIN | APR_POLLHUP
+                                            | APR_POLLERR))) {
+                continue;
+            }
+
+            rv = mget_recv(server_query, data_pool, values, ctx->mc);
+            if (APR_STATUS_IS_EAGAIN(rv)) {
+                continue;
+            }
+
+            /* this connection is done */
+            apr_pollset_remove(ctx->pollset, &server_query->pfd);
+            if (rv == APR_SUCCESS) {
+                mget_conn_result(TRUE, TRUE, rv, ctx, server_query);
+            }
+            else {
+                mget_conn_result(rv == APR_EGENERAL, FALSE, rv, ctx,
+                                 server_query);
+            }
+            queries_sent--;
         } /* /for */
     } /* /while */
-    
-    query_hash_index = apr_hash_first(temp_pool, server_queries);
-    while (query_hash_index) {
-        void *v;
-        apr_hash_this(query_hash_index, NULL, NULL, &v);
-        server_query = v;
-        query_hash_index = apr_hash_next(query_hash_index);
-        
-        conn = server_query->conn;
-        ms = server_query->ms;
-        
-        mget_conn_result(TRUE, (rv == APR_SUCCESS), rv, mc, ms, conn,
-                         server_query, values, server_queries);
-        continue;
+
+    /* the servers which did not answer in time */
+    for (i = 0; i < ctx->mc->nalloc; i++) {
+        server_query = &ctx->queries[i];
+        if (!server_query->conn) {
+            continue;
+        }
+        apr_pollset_remove(ctx->pollset, &server_query->pfd);
+        mget_conn_result(TRUE, FALSE, rv, ctx, server_query);
     }
-    
-    apr_pollset_destroy(pollset);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_multgetp(apr_memcache_t *mc,
+                      apr_pool_t *temp_pool,
+                      apr_pool_t *data_pool,
+                      apr_hash_t *values)
+{
+    apr_memcache_multget_t *ctx;
+    apr_status_t rv;
+
+    rv = apr_memcache_multget_create(&ctx, mc, 0, 0, temp_pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rv = apr_memcache_multget_exec(ctx, data_pool, values);
     apr_pool_clear(temp_pool);
+    return rv;
+}
+
+/* A command sent on an asynchronous connection, awaiting its reply */
+typedef enum {
+    ASYNC_STORE,                /* a single line */
+    ASYNC_RETRIEVE              /* values up to END */
+} async_kind_e;
+
+typedef struct async_request_t async_request_t;
+struct async_request_t
+{
+    async_request_t *next;
+    async_kind_e kind;
+    apr_memcache_async_cb_t *func;
+    void *baton;
+    apr_pool_t *p;              /* for the values' data */
+    apr_memcache_value_t *value;
+    apr_hash_t *values;
+};
+
+struct apr_memcache_async_t
+{
+    apr_memcache_conn_t *conn;
+    apr_pollcb_t *pollcb;
+    apr_pollfd_t pfd;
+    int polled;                 /* pfd is in the pollcb */
+    apr_bucket_brigade *out;    /* the commands not written yet */
+    char *in;                   /* the replies read, not parsed yet */
+    apr_size_t in_size, in_len, in_pos;
+    async_request_t *head, *tail, *free;
+    apr_size_t pending;
+    apr_status_t status;
+};
+
+#define ASYNC_BUFFER_SIZE 4096
+
+/* Read the reply of a command from buf, only checking that it is complete
+ * if req is NULL (nothing filled), the scan being repeated until it is.
+ */
+static apr_status_t async_parse(const char *buf, apr_size_t len,
+                                apr_size_t *pos, async_kind_e kind,
+                                async_request_t *req, apr_status_t *status)
+{
+    apr_size_t next = *pos;
+
+    for (;;) {
+        const char *line = buf + next, *eol, *key, *end;
+        apr_size_t llen, klen;
+        apr_int64_t flags, size;
+
+        eol = memchr(line, APR_ASCII_LF, len - next);
+        if (!eol) {
+            return APR_INCOMPLETE;
+        }
+        if (eol == line || eol[-1] != APR_ASCII_CR) {
+            return APR_EGENERAL;
+        }
+        llen = eol - 1 - line;
+        next = eol + 1 - buf;
+
+        if (kind == ASYNC_STORE) {
+            if (llen == MS_STORED_LEN && !memcmp(line, MS_STORED, llen)) {
+                *status = APR_SUCCESS;
+            }
+            else if (llen == MS_NOT_STORED_LEN
+                     && !memcmp(line, MS_NOT_STORED, llen)) {
+                *status = APR_EEXIST;
+            }
+            else {
+                *status = APR_EGENERAL;
+            }
+            break;
+        }
+
+        if (llen == MS_END_LEN && !memcmp(line, MS_END, llen)) {
+            *status = APR_SUCCESS;
+            break;
+        }
+        if (llen <= MS_VALUE_LEN + 1
+                || memcmp(line, MS_VALUE " ", MS_VALUE_LEN + 1)) {
+            /* ERROR, CLIENT_ERROR or SERVER_ERROR */
+            *status = APR_EGENERAL;
+            break;
+        }
+
+        /* VALUE <key> <flags> <bytes> [<cas unique>]\r\n<data>\r\n */
+        key = line + MS_VALUE_LEN + 1;
+        end = memchr(key, ' ', eol - key);
+        if (!end) {
+            return APR_EGENERAL;
+        }
+        klen = end - key;
+        flags = apr_strtoi64(end + 1, (char **)&end, 10);
+        if (*end != ' ') {
+            return APR_EGENERAL;
+        }
+        size = apr_strtoi64(end + 1, (char **)&end, 10);
+        if (size < 0 || (*end != ' ' && *end != APR_ASCII_CR)) {
+            return APR_EGENERAL;
+        }
+        if ((apr_uint64_t)size > len - next
+                || len - next - (apr_size_t)size < MC_EOL_LEN) {
+            return APR_INCOMPLETE;
+        }
+        if (memcmp(buf + next + size, MC_EOL, MC_EOL_LEN)) {
+            return APR_EGENERAL;
+        }
+
+        if (req) {
+            apr_memcache_value_t *value = req->value;
+
+            if (req->values) {
+                value = apr_hash_get(req->values, key, klen);
+            }
+            else if (strlen(value->key) != klen
+                     || memcmp(value->key, key, klen)) {
+                value = NULL;
+            }
+            if (value) {
+                value->data = apr_pstrmemdup(req->p, buf + next,
+                                             (apr_size_t)size);
+                value->len = (apr_size_t)size;
+                value->flags = (apr_uint16_t)flags;
+                value->status = APR_SUCCESS;
+            }
+        }
+        next += (apr_size_t)size + MC_EOL_LEN;
+    }
+
+    *pos = next;
     return APR_SUCCESS;
-    
+}
+
+static apr_status_t async_cleanup(void *data)
+{
+    apr_memcache_async_t *ac = data;
+
+    if (ac->polled) {
+        apr_pollcb_remove(ac->pollcb, &ac->pfd);
+        ac->polled = 0;
+    }
+    return APR_SUCCESS;
+}
+
+/* Poll for writability too while some commands could not be written */
+static apr_status_t async_poll(apr_memcache_async_t *ac,
+                               apr_int16_t reqevents)
+{
+    apr_status_t rv;
+
+    if (ac->pfd.reqevents == reqevents) {
+        return APR_SUCCESS;
+    }
+    /* the pollcb API has no portable modification of the events */
+    rv = apr_pollcb_remove(ac->pollcb, &ac->pfd);
+    if (rv == APR_SUCCESS) {
+        ac->pfd.reqevents = reqevents;
+        rv = apr_pollcb_add(ac->pollcb, &ac->pfd);
+    }
+    if (rv != APR_SUCCESS) {
+        ac->polled = 0;
+    }
+    return rv;
+}
+
+static apr_status_t async_write(apr_memcache_async_t *ac)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t written;
+
+    while (!APR_BRIGADE_EMPTY(ac->out)) {
+        rv = apr_brigade_write_socket(ac->out, ac->conn->sock, &written);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    if (rv != APR_SUCCESS && !APR_STATUS_IS_EAGAIN(rv)) {
+        return rv;
+    }
+
+    return async_poll(ac, APR_BRIGADE_EMPTY(ac->out)
+                          ? APR_POLLIN : APR_POLLIN | APR_POLLOUT);
+}
+
+/* Call back the commands whose reply is complete, in order */
+static apr_status_t async_replies(apr_memcache_async_t *ac)
+{
+    while (ac->in_pos < ac->in_len) {
+        async_request_t *req = ac->head;
+        apr_size_t pos = ac->in_pos;
+        apr_status_t rv, status;
+
+        if (!req) {
+            /* nothing was asked */
+            return APR_EGENERAL;
+        }
+        rv = async_parse(ac->in, ac->in_len, &pos, req->kind, NULL, &status);
+        if (rv == APR_INCOMPLETE) {
+            break;
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        pos = ac->in_pos;
+        async_parse(ac->in, ac->in_len, &pos, req->kind, req, &status);
+        ac->in_pos = pos;
+
+        /* a single get tells whether the value was found */
+        if (status == APR_SUCCESS && req->value) {
+            status = req->value->status;
+        }
+
+        ac->head = req->next;
+        if (!ac->head) {
+            ac->tail = NULL;
+        }
+        ac->pending--;
+        req->func(ac, status, req->baton);
+
+        req->next = ac->free;
+        ac->free = req;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t async_read(apr_memcache_async_t *ac)
+{
+    apr_status_t rv;
+
+    for (;;) {
+        apr_size_t len;
+
+        if (ac->in_pos == ac->in_len) {
+            ac->in_pos = ac->in_len = 0;
+        }
+        if (ac->in_len == ac->in_size) {
+            if (ac->in_pos) {
+                memmove(ac->in, ac->in + ac->in_pos, ac->in_len - ac->in_pos);
+                ac->in_len -= ac->in_pos;
+                ac->in_pos = 0;
+            }
+            else {
+                /* a reply larger than the buffer */
+                char *in = apr_palloc(ac->conn->p, ac->in_size * 2);
+
+                memcpy(in, ac->in, ac->in_len);
+                ac->in = in;
+                ac->in_size *= 2;
+            }
+        }
+
+        len = ac->in_size - ac->in_len;
+        rv = apr_socket_recv(ac->conn->sock, ac->in + ac->in_len, &len);
+        if (len) {
+            apr_status_t arv;
+
+            ac->in_len += len;
+            arv = async_replies(ac);
+            if (arv != APR_SUCCESS) {
+                return arv;
+            }
+        }
+        if (rv != APR_SUCCESS) {
+            return APR_STATUS_IS_EAGAIN(rv) ? APR_SUCCESS : rv;
+        }
+    }
+}
+
+/* Call back the pending commands with the error of the connection */
+static void async_fail(apr_memcache_async_t *ac)
+{
+    async_cleanup(ac);
+
+    while (ac->head) {
+        async_request_t *req = ac->head;
+
+        ac->head = req->next;
+        ac->pending--;
+        req->func(ac, ac->status, req->baton);
+    }
+    ac->tail = NULL;
+}
+
+static apr_status_t async_queue(apr_memcache_async_t *ac,
+                                async_kind_e kind,
+                                apr_pool_t *p,
+                                apr_memcache_value_t *value,
+                                apr_hash_t *values,
+                                apr_memcache_async_cb_t *func,
+                                void *baton)
+{
+    async_request_t *req = ac->free;
+
+    if (req) {
+        ac->free = req->next;
+    }
+    else {
+        req = apr_palloc(ac->conn->p, sizeof(*req));
+    }
+    req->next = NULL;
+    req->kind = kind;
+    req->func = func;
+    req->baton = baton;
+    req->p = p;
+    req->value = value;
+    req->values = values;
+    if (ac->tail) {
+        ac->tail->next = req;
+    }
+    else {
+        ac->head = req;
+    }
+    ac->tail = req;
+    ac->pending++;
+
+    /* written right away unless the previous commands wait for the socket
+     * to be writable, a write error failing the commands from
+     * apr_memcache_async_process() once the socket is signalled */
+    APR_BRIGADE_CONCAT(ac->out, ac->conn->tb);
+    if (ac->pfd.reqevents == APR_POLLIN) {
+        ac->status = async_write(ac);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_async_create(apr_memcache_async_t **ac,
+                          apr_memcache_server_t *ms,
+                          apr_pollcb_t *pollcb,
+                          void *client_data,
+                          apr_pool_t *p)
+{
+    apr_memcache_async_t *nac;
+    apr_status_t rv;
+    void *conn;
+
+    /* a connection of its own, closed with its pool (a subpool of p) */
+    rv = mc_conn_construct(&conn, ms, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    nac = apr_pcalloc(p, sizeof(*nac));
+    nac->conn = conn;
+    nac->pollcb = pollcb;
+    nac->out = apr_brigade_create(nac->conn->p, nac->conn->ba);
+    nac->in_size = ASYNC_BUFFER_SIZE;
+    nac->in = apr_palloc(nac->conn->p, nac->in_size);
+
+    rv = apr_socket_timeout_set(nac->conn->sock, 0);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(nac->conn->p);
+        return rv;
+    }
+
+    nac->pfd.p = nac->conn->p;
+    nac->pfd.desc_type = APR_POLL_SOCKET;
+    nac->pfd.reqevents = APR_POLLIN;
+    nac->pfd.desc.s = nac->conn->sock;
+    nac->pfd.client_data = client_data ? client_data : nac;
+    rv = apr_pollcb_add(pollcb, &nac->pfd);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(nac->conn->p);
+        return rv;
+    }
+    nac->polled = 1;
+
+    /* out of the pollcb before the socket is closed */
+    apr_pool_pre_cleanup_register(p, nac, async_cleanup);
+
+    *ac = nac;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_async_getp(apr_memcache_async_t *ac,
+                        apr_pool_t *data_pool,
+                        apr_memcache_value_t *value,
+                        apr_memcache_async_cb_t *func,
+                        void *baton)
+{
+    apr_bucket_brigade *bb = ac->conn->tb;
+
+    if (ac->status != APR_SUCCESS) {
+        return ac->status;
+    }
+
+    value->status = APR_NOTFOUND;
+    value->data = NULL;
+    value->len = 0;
+    value->flags = 0;
+
+    /* get <key>\r\n */
+    apr_brigade_write(bb, NULL, NULL, MC_GET, MC_GET_LEN);
+    apr_brigade_puts(bb, NULL, NULL, value->key);
+    apr_brigade_write(bb, NULL, NULL, MC_EOL, MC_EOL_LEN);
+
+    return async_queue(ac, ASYNC_RETRIEVE, data_pool, value, NULL,
+                       func, baton);
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_async_multgetp(apr_memcache_async_t *ac,
+                            apr_pool_t *data_pool,
+                            apr_hash_t *values,
+                            apr_memcache_async_cb_t *func,
+                            void *baton)
+{
+    apr_bucket_brigade *bb = ac->conn->tb;
+    apr_hash_index_t *hi;
+
+    if (ac->status != APR_SUCCESS) {
+        return ac->status;
+    }
+    if (!apr_hash_count(values)) {
+        return APR_EINVAL;
+    }
+
+    /* get <key>*\r\n */
+    apr_brigade_write(bb, NULL, NULL, MC_GET, MC_GET_LEN - 1);
+    for (hi = apr_hash_first(NULL, values); hi; hi = apr_hash_next(hi)) {
+        apr_memcache_value_t *value = apr_hash_this_val(hi);
+
+        apr_brigade_write(bb, NULL, NULL, MC_WS, MC_WS_LEN);
+        apr_brigade_puts(bb, NULL, NULL, value->key);
+    }
+    apr_brigade_write(bb, NULL, NULL, MC_EOL, MC_EOL_LEN);
+
+    return async_queue(ac, ASYNC_RETRIEVE, data_pool, NULL, values,
+                       func, baton);
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_async_set(apr_memcache_async_t *ac,
+                       const char *key,
+                       const char *data,
+                       apr_size_t data_size,
+                       apr_uint32_t timeout,
+                       apr_uint16_t flags,
+                       apr_memcache_async_cb_t *func,
+                       void *baton)
+{
+    apr_bucket_brigade *bb = ac->conn->tb;
+
+    if (ac->status != APR_SUCCESS) {
+        return ac->status;
+    }
+
+    /* set <key> <flags> <exptime> <bytes>\r\n<data>\r\n, the data copied */
+    apr_brigade_write(bb, NULL, NULL, MC_SET, MC_SET_LEN);
+    apr_brigade_printf(bb, NULL, NULL, "%s %u %u %" APR_SIZE_T_FMT MC_EOL,
+                       key, flags, timeout, data_size);
+    apr_brigade_write(bb, NULL, NULL, data, data_size);
+    apr_brigade_write(bb, NULL, NULL, MC_EOL, MC_EOL_LEN);
+
+    return async_queue(ac, ASYNC_STORE, NULL, NULL, NULL, func, baton);
+}
+
+APR_DECLARE(apr_status_t)
+apr_memcache_async_process(apr_memcache_async_t *ac, apr_int16_t rtnevents)
+{
+    if (ac->status == APR_SUCCESS && !APR_BRIGADE_EMPTY(ac->out)
+            && (rtnevents & (APR_POLLOUT | APR_POLLERR | APR_POLLHUP))) {
+        ac->status = async_write(ac);
+    }
+    if (ac->status == APR_SUCCESS
+            && (rtnevents & (APR_POLLIN | APR_POLLERR | APR_POLLHUP))) {
+        ac->status = async_read(ac);
+    }
+    if (ac->status != APR_SUCCESS) {
+        async_fail(ac);
+    }
+    return ac->status;
+}
+
+APR_DECLARE(apr_size_t)
+apr_memcache_async_pending(apr_memcache_async_t *ac)
+{
+    return ac->pending;
 }
 
 
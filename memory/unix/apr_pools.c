@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+/* The functions the inline fast path calls are defined here */
+#undef APR_POOL_INLINE
+
 #include "apr.h"
 #include "apr_private.h"
 
@@ -25,9 +28,11 @@
 #include "apr_allocator.h"
 #include "apr_lib.h"
 #include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
 #include "apr_hash.h"
 #include "apr_time.h"
 #include "apr_support.h"
+#include "apr_probes.h"
 #define APR_WANT_MEMFUNC
 #include "apr_want.h"
 #include "apr_env.h"
@@ -48,6 +53,34 @@
 #include <sys/mman.h>
 #endif
 
+/*
+ * Regions (apr_allocator_region_set) need anonymous mmap(), and can't
+ * be used with guard pages around each node.
+ */
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) \
+    && !APR_ALLOCATOR_GUARD_PAGES
+#define APR_ALLOCATOR_HAS_REGIONS 1
+#include <sys/mman.h>
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_SHIFT 26
+#endif
+#if defined(HAVE_SYS_SYSCALL_H)
+#include <sys/syscall.h>
+#endif
+#if defined(SYS_mbind)
+#define APR_ALLOCATOR_HAS_MBIND 1
+#define APR_ALLOCATOR_NUMA_MASK_LONGS 16
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#endif
+#else
+#define APR_ALLOCATOR_HAS_REGIONS 0
+#endif
+
 #if HAVE_VALGRIND
 #define REDZONE APR_ALIGN_DEFAULT(8)
 int apr_running_on_valgrind = 0;
@@ -57,6 +90,9 @@ int apr_running_on_valgrind = 0;
 #error pool-concurrency-check does not make sense without threads
 #endif
 
+/* Set by pool_inline_update() */
+APR_DECLARE_DATA volatile int apr_pool_inline_off = 0;
+
 
 /*
  * Magic numbers
@@ -95,6 +131,40 @@ static unsigned int boundary_size;
 #define GUARDPAGE_SIZE 0
 #endif /* APR_ALLOCATOR_GUARD_PAGES */
 
+/*
+ * Per-thread caches of free nodes (APR_ALLOCATOR_THREAD_CACHE).
+ *
+ * Only the nodes of the smallest sizes (index below TCACHE_INDEX) are
+ * cached, up to TCACHE_MAX per index, and they are moved from/to the
+ * allocator's free lists TCACHE_BATCH at a time.  Each thread can hold
+ * caches for up to TCACHE_SLOTS allocators at once, the cache of an
+ * evicted slot is left to the next thread needing one for its allocator.
+ */
+#if APR_HAS_THREADS && APR_HAS_THREAD_LOCAL
+#define APR_ALLOCATOR_HAS_TCACHE 1
+#define TCACHE_INDEX    8
+#define TCACHE_MAX      16
+#define TCACHE_BATCH    8
+#define TCACHE_SLOTS    4
+#else
+#define APR_ALLOCATOR_HAS_TCACHE 0
+#endif
+
+/*
+ * Recycled subpools, up to POOL_CACHE_MAX per allocator.
+ *
+ * The node holding the struct of a destroyed subpool is kept by its
+ * allocator for the next subpool, the cache being accessed under the
+ * allocator lock which is taken anyway to (un)link the subpool from
+ * its parent.  Disabled with the guard pages which should catch any
+ * use after destroy.
+ */
+#if APR_ALLOCATOR_GUARD_PAGES
+#define POOL_CACHE_MAX  0
+#else
+#define POOL_CACHE_MAX  16
+#endif
+
 /* 
  * Timing constants for killing subprocesses
  * There is a total 3-second delay between sending a SIGINT 
@@ -112,6 +182,26 @@ static unsigned int boundary_size;
  * indices, but quantities of BOUNDARY_SIZE big memory blocks.
  */
 
+#if APR_ALLOCATOR_HAS_TCACHE
+typedef struct allocator_tcache_t allocator_tcache_t;
+#endif
+
+#if APR_ALLOCATOR_HAS_REGIONS
+typedef struct allocator_region_t allocator_region_t;
+
+/** A region of memory (see apr_allocator_region_set()) */
+struct allocator_region_t {
+    /** previously mapped region */
+    allocator_region_t *next;
+    /** start of the mapping */
+    char               *base;
+    /** end of the mapping */
+    char               *endp;
+    /** first byte not carved yet */
+    char               *first_avail;
+};
+#endif /* APR_ALLOCATOR_HAS_REGIONS */
+
 struct apr_allocator_t {
     /** largest used index into free[], always < MAX_INDEX */
     apr_size_t        max_index;
@@ -142,10 +232,91 @@ struct apr_allocator_t {
      * slot 20: nodes larger than 81920
      */
     apr_memnode_t      *free[MAX_INDEX + 1];
+    /** Nodes of destroyed subpools, see POOL_CACHE_MAX */
+    apr_memnode_t      *pool_cache;
+    apr_size_t          pool_cache_count;
+    /** Number of nodes in each free[] list */
+    apr_uint32_t        free_count[MAX_INDEX + 1];
+    /** Lowest free_count[] since the last apr_allocator_trim(), the
+     * nodes below which have not been used meanwhile */
+    apr_uint32_t        free_low[MAX_INDEX + 1];
+#if APR_ALLOCATOR_HAS_TCACHE
+    /** Non-zero identifier if APR_ALLOCATOR_THREAD_CACHE */
+    apr_uint32_t        tcache_id;
+    /** All the thread caches created for this allocator */
+    allocator_tcache_t *tcaches;
+#endif /* APR_ALLOCATOR_HAS_TCACHE */
+    /** Statistics, see apr_allocator_stats_get() */
+    apr_uint64_t        stat_nodes_alloc;
+    apr_uint64_t        stat_nodes_released;
+    apr_uint64_t        stat_nodes_recycled;
+    apr_size_t          stat_footprint;
+    apr_size_t          stat_peak;
+#if APR_ALLOCATOR_HAS_REGIONS
+    /** Size of the regions to map, zero if not using regions */
+    apr_size_t          region_size;
+    /** APR_ALLOCATOR_REGION_* flags */
+    apr_uint32_t        region_flags;
+    /** NUMA node to bind the regions to */
+    int                 region_node;
+    /** Mapped regions, current one first */
+    allocator_region_t *regions;
+#endif /* APR_ALLOCATOR_HAS_REGIONS */
 };
 
 #define SIZEOF_ALLOCATOR_T  APR_ALIGN_DEFAULT(sizeof(apr_allocator_t))
 
+#if APR_ALLOCATOR_HAS_TCACHE
+struct allocator_tcache_t {
+    /** next cache of the same allocator (or spare cache) */
+    allocator_tcache_t *next;
+    /** tcache_id of the allocator, or zero once spare */
+    apr_uint32_t        id;
+    /** whether no thread's slot holds the cache anymore */
+    int                 evicted;
+    /** number of nodes in free[] lists */
+    apr_uint32_t        count[TCACHE_INDEX];
+    /** free nodes of sizes (i+1) * BOUNDARY_SIZE */
+    apr_memnode_t      *free[TCACHE_INDEX];
+    /** number of allocations served by this cache */
+    apr_uint64_t        recycled;
+};
+
+/* The caches of the current thread, most recently used first. An
+ * allocator is identified by its (unique) tcache_id rather than its
+ * address, so that a slot left behind by a destroyed allocator never
+ * matches a new one.  The caches are never freed but kept spare for
+ * reuse, so the cache of an evicted slot can be marked evicted whether or
+ * not its allocator is still alive: it is if the ids still match, under
+ * tcache_lock (which apr_allocator_destroy() takes too).
+ */
+static APR_THREAD_LOCAL struct {
+    apr_uint32_t        id;
+    allocator_tcache_t *tcache;
+} tcache_slots[TCACHE_SLOTS];
+
+/* Last apr_allocator_t::tcache_id handed out */
+static apr_uint32_t tcache_last_id = 0;
+
+/* Spinlock for the eviction and the adoption of the caches, and the
+ * spare caches of the destroyed allocators.
+ */
+static apr_uint32_t tcache_lock_word = 0;
+static allocator_tcache_t *tcache_spares = NULL;
+
+static void tcache_lock(void)
+{
+    while (apr_atomic_cas32(&tcache_lock_word, 1, 0) != 0) {
+        apr_thread_yield();
+    }
+}
+
+static void tcache_unlock(void)
+{
+    apr_atomic_set32(&tcache_lock_word, 0);
+}
+#endif /* APR_ALLOCATOR_HAS_TCACHE */
+
 
 /*
  * Allocator
@@ -169,18 +340,260 @@ void allocator_unlock(apr_allocator_t *allocator)
 #endif /* APR_HAS_THREADS */
 }
 
+/* Account for a node of the given size obtained from the system, must be
+ * called with the allocator locked.
+ */
+static APR_INLINE
+void allocator_stats_alloc(apr_allocator_t *allocator, apr_size_t size)
+{
+    allocator->stat_nodes_alloc++;
+    allocator->stat_footprint += size;
+    if (allocator->stat_peak < allocator->stat_footprint)
+        allocator->stat_peak = allocator->stat_footprint;
+}
+
+/* Undo allocator_stats_alloc() for a node the system finally did not
+ * give, must be called with the allocator locked.  The peak is kept.
+ */
+static APR_INLINE
+void allocator_stats_undo(apr_allocator_t *allocator, apr_size_t size)
+{
+    allocator->stat_nodes_alloc--;
+    allocator->stat_footprint -= size;
+}
+
+/* Account for n nodes taken from the free list of the given index, must
+ * be called with the allocator locked.
+ */
+static APR_INLINE
+void allocator_free_take(apr_allocator_t *allocator, apr_size_t index,
+                         apr_uint32_t n)
+{
+    allocator->free_count[index] -= n;
+    if (allocator->free_low[index] > allocator->free_count[index])
+        allocator->free_low[index] = allocator->free_count[index];
+}
+
+/* Give a node back to the system */
+static APR_INLINE
+void allocator_node_release(apr_memnode_t *node)
+{
+#if APR_ALLOCATOR_USES_MMAP
+    munmap((char *)node - GUARDPAGE_SIZE,
+           2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
+#else
+    free(node);
+#endif
+}
+
+#if APR_ALLOCATOR_HAS_REGIONS
+/* Whether the given node was carved from one of the allocator's regions */
+static APR_INLINE
+int allocator_region_owns(apr_allocator_t *allocator, apr_memnode_t *node)
+{
+    allocator_region_t *region;
+
+    for (region = allocator->regions; region; region = region->next) {
+        if ((char *)node >= region->base && (char *)node < region->endp)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Give what is left of the current region to the free lists, so that
+ * it is not wasted when a new region gets mapped.
+ */
+static void allocator_region_recycle(apr_allocator_t *allocator)
+{
+    allocator_region_t *region = allocator->regions;
+    apr_memnode_t *node;
+    apr_size_t index, left;
+
+    if (!region || (left = region->endp - region->first_avail) < MIN_ALLOC)
+        return;
+
+    node = (apr_memnode_t *)region->first_avail;
+    node->index = (apr_uint32_t)((left >> BOUNDARY_INDEX) - 1);
+    node->endp = region->endp;
+    region->first_avail = region->endp;
+    allocator_stats_alloc(allocator, left);
+
+    index = node->index;
+    if (index < MAX_INDEX) {
+        if (index > allocator->max_index)
+            allocator->max_index = index;
+    }
+    else {
+        index = MAX_INDEX;
+    }
+    node->next = allocator->free[index];
+    allocator->free[index] = node;
+    allocator->free_count[index]++;
+}
+
+/* Give the pages of a free node carved from a region back to the system,
+ * but the first one holding the node itself which stays in its free list.
+ * Returns the size given back.
+ */
+static apr_size_t allocator_region_advise(apr_allocator_t *allocator,
+                                          apr_memnode_t *node)
+{
+    apr_size_t size = (apr_size_t)node->index << BOUNDARY_INDEX;
+
+    /* Don't split the huge pages */
+    if (!size || (allocator->region_flags
+                  & (APR_ALLOCATOR_REGION_HUGEPAGES
+                     | APR_ALLOCATOR_REGION_HUGEPAGES_1G))) {
+        return 0;
+    }
+#if defined(MADV_FREE)
+    if (madvise((char *)node + BOUNDARY_SIZE, size, MADV_FREE) == 0)
+        return size;
+#endif
+#if defined(MADV_DONTNEED)
+    if (madvise((char *)node + BOUNDARY_SIZE, size, MADV_DONTNEED) == 0)
+        return size;
+#endif
+    return 0;
+}
+
+/* Map a new region and make it the current one.  Must be called with
+ * the allocator locked (or not shared yet).
+ */
+static apr_status_t allocator_region_map(apr_allocator_t *allocator)
+{
+    allocator_region_t *region;
+    apr_size_t size = allocator->region_size;
+    void *base = MAP_FAILED;
+    apr_status_t rv;
+
+    if ((region = malloc(sizeof(*region))) == NULL) {
+        return APR_ENOMEM;
+    }
+
+#if defined(MAP_HUGETLB)
+    if (allocator->region_flags & (APR_ALLOCATOR_REGION_HUGEPAGES |
+                                   APR_ALLOCATOR_REGION_HUGEPAGES_1G)) {
+        int huge = MAP_HUGETLB;
+
+        if (allocator->region_flags & APR_ALLOCATOR_REGION_HUGEPAGES_1G) {
+            huge |= 30 << MAP_HUGE_SHIFT;
+        }
+        base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANON|huge, -1, 0);
+    }
+#endif
+    if (base == MAP_FAILED) {
+        base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANON, -1, 0);
+        if (base == MAP_FAILED) {
+            rv = errno;
+            free(region);
+            return rv;
+        }
+#if defined(MADV_HUGEPAGE)
+        /* No (reserved) huge pages, fall back to transparent ones */
+        if (allocator->region_flags & (APR_ALLOCATOR_REGION_HUGEPAGES |
+                                       APR_ALLOCATOR_REGION_HUGEPAGES_1G)) {
+            (void)madvise(base, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+#if APR_ALLOCATOR_HAS_MBIND
+    if (allocator->region_node != APR_ALLOCATOR_NUMA_NODE_ANY) {
+        unsigned long mask[APR_ALLOCATOR_NUMA_MASK_LONGS];
+        const int bits = sizeof(unsigned long) * 8;
+
+        memset(mask, 0, sizeof(mask));
+        mask[allocator->region_node / bits] |=
+            1UL << (allocator->region_node % bits);
+        if (syscall(SYS_mbind, base, size, MPOL_BIND, mask,
+                    (unsigned long)sizeof(mask) * 8 + 1, 0) != 0) {
+            rv = errno;
+            munmap(base, size);
+            free(region);
+            return rv;
+        }
+    }
+#endif
+
+    allocator_region_recycle(allocator);
+
+    region->base = region->first_avail = base;
+    region->endp = (char *)base + size;
+    region->next = allocator->regions;
+    allocator->regions = region;
+
+    return APR_SUCCESS;
+}
+
+/* Carve a node of the given (aligned) size from the current region,
+ * mapping a new region if the current one is exhausted.  Must be called
+ * with the allocator locked.
+ */
+static apr_memnode_t *allocator_region_alloc(apr_allocator_t *allocator,
+                                             apr_size_t size)
+{
+    allocator_region_t *region;
+    apr_memnode_t *node = NULL;
+
+    if (size <= allocator->region_size) {
+        region = allocator->regions;
+        if (region && size <= (apr_size_t)(region->endp
+                                           - region->first_avail)) {
+            node = (apr_memnode_t *)region->first_avail;
+        }
+        else if (allocator_region_map(allocator) == APR_SUCCESS) {
+            region = allocator->regions;
+            node = (apr_memnode_t *)region->first_avail;
+        }
+        if (node) {
+            region->first_avail += size;
+            allocator_stats_alloc(allocator, size);
+        }
+    }
+
+    return node;
+}
+#else
+#define allocator_region_owns(allocator, node) 0
+#define allocator_region_advise(allocator, node) 0
+#endif /* APR_ALLOCATOR_HAS_REGIONS */
+
 APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
+{
+    return apr_allocator_create_ex(allocator, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_allocator_create_ex(apr_allocator_t **allocator,
+                                                  apr_uint32_t flags)
 {
     apr_allocator_t *new_allocator;
 
     *allocator = NULL;
 
+#if !APR_ALLOCATOR_HAS_TCACHE
+    if (flags & APR_ALLOCATOR_THREAD_CACHE)
+        return APR_ENOTIMPL;
+#endif
+
     if ((new_allocator = malloc(SIZEOF_ALLOCATOR_T)) == NULL)
         return APR_ENOMEM;
 
     memset(new_allocator, 0, SIZEOF_ALLOCATOR_T);
     new_allocator->max_free_index = APR_ALLOCATOR_MAX_FREE_UNLIMITED;
 
+#if APR_ALLOCATOR_HAS_TCACHE
+    if (flags & APR_ALLOCATOR_THREAD_CACHE) {
+        /* Zero is "no cache", skip it on wrap around */
+        do {
+            new_allocator->tcache_id = apr_atomic_inc32(&tcache_last_id) + 1;
+        } while (!new_allocator->tcache_id);
+    }
+#endif
+
     *allocator = new_allocator;
 
     return APR_SUCCESS;
@@ -191,19 +604,59 @@ APR_DECLARE(void) apr_allocator_destroy(apr_allocator_t *allocator)
     apr_size_t index;
     apr_memnode_t *node, **ref;
 
+#if APR_ALLOCATOR_HAS_TCACHE
+    /* Give the nodes of all the thread caches back to the free lists
+     * so that they are released below, and the caches to the spares
+     * (the slots of the threads may still point to them).
+     */
+    tcache_lock();
+    while (allocator->tcaches) {
+        allocator_tcache_t *tcache = allocator->tcaches;
+
+        allocator->tcaches = tcache->next;
+        for (index = 0; index < TCACHE_INDEX; index++) {
+            while ((node = tcache->free[index]) != NULL) {
+                tcache->free[index] = node->next;
+                node->next = allocator->free[index];
+                allocator->free[index] = node;
+            }
+        }
+        memset(tcache, 0, sizeof(*tcache));
+        tcache->next = tcache_spares;
+        tcache_spares = tcache;
+    }
+    tcache_unlock();
+#endif
+
+    /* Likewise for the recycled subpools */
+    while ((node = allocator->pool_cache) != NULL) {
+        allocator->pool_cache = node->next;
+        index = node->index < MAX_INDEX ? node->index : MAX_INDEX;
+        node->next = allocator->free[index];
+        allocator->free[index] = node;
+    }
+
     for (index = 0; index <= MAX_INDEX; index++) {
         ref = &allocator->free[index];
         while ((node = *ref) != NULL) {
             *ref = node->next;
-#if APR_ALLOCATOR_USES_MMAP
-            munmap((char *)node - GUARDPAGE_SIZE,
-                   2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
-#else
-            free(node);
-#endif
+            if (allocator_region_owns(allocator, node)) {
+                continue;
+            }
+            allocator_node_release(node);
         }
     }
 
+#if APR_ALLOCATOR_HAS_REGIONS
+    while (allocator->regions) {
+        allocator_region_t *region = allocator->regions;
+
+        allocator->regions = region->next;
+        munmap(region->base, region->endp - region->base);
+        free(region);
+    }
+#endif
+
     free(allocator);
 }
 
@@ -250,6 +703,61 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
     allocator_unlock(allocator);
 }
 
+APR_DECLARE(apr_status_t) apr_allocator_region_set(apr_allocator_t *allocator,
+                                                   apr_size_t in_size,
+                                                   apr_uint32_t flags,
+                                                   int numa_node)
+{
+#if APR_ALLOCATOR_HAS_REGIONS
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t size, align = BOUNDARY_SIZE;
+
+    if (numa_node != APR_ALLOCATOR_NUMA_NODE_ANY) {
+#if APR_ALLOCATOR_HAS_MBIND
+        if (numa_node < 0 || numa_node >= APR_ALLOCATOR_NUMA_MASK_LONGS
+                                          * (int)sizeof(unsigned long) * 8) {
+            return APR_EINVAL;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+    }
+
+    if (flags & APR_ALLOCATOR_REGION_HUGEPAGES_1G) {
+        align = (apr_size_t)1 << 30;
+    }
+    else if (flags & APR_ALLOCATOR_REGION_HUGEPAGES) {
+        align = (apr_size_t)1 << 21;
+    }
+    size = APR_ALIGN(in_size, align);
+    if (size < in_size) {
+        return APR_EINVAL;
+    }
+
+    allocator_lock(allocator);
+
+    allocator->region_size = size;
+    allocator->region_flags = flags;
+    allocator->region_node = numa_node;
+    if (size) {
+        rv = allocator_region_map(allocator);
+        if (rv != APR_SUCCESS) {
+            allocator->region_size = 0;
+        }
+    }
+
+    allocator_unlock(allocator);
+
+    return rv;
+#else
+    (void)allocator;
+    (void)in_size;
+    (void)flags;
+    (void)numa_node;
+    return APR_ENOTIMPL;
+#endif
+}
+
 static APR_INLINE
 apr_size_t allocator_align(apr_size_t in_size)
 {
@@ -276,6 +784,168 @@ APR_DECLARE(apr_size_t) apr_allocator_align(apr_allocator_t *allocator,
     return allocator_align(size);
 }
 
+#if APR_ALLOCATOR_HAS_TCACHE
+/* Get the cache of the current thread for the given allocator,
+ * creating it if needed.
+ */
+static allocator_tcache_t *allocator_tcache_get(apr_allocator_t *allocator)
+{
+    apr_uint32_t id = allocator->tcache_id;
+    allocator_tcache_t *tcache;
+    int i;
+
+    if (tcache_slots[0].id == id) {
+        return tcache_slots[0].tcache;
+    }
+    for (i = 1; i < TCACHE_SLOTS; i++) {
+        if (tcache_slots[i].id == id) {
+            tcache = tcache_slots[i].tcache;
+            goto have_tcache;
+        }
+    }
+
+    /* Evict the least recently used slot, and adopt an evicted cache of
+     * the allocator (with its nodes) if any, so that an allocator has no
+     * more caches than threads using it at once.
+     */
+    i = TCACHE_SLOTS - 1;
+    tcache_lock();
+    if (tcache_slots[i].id
+            && tcache_slots[i].tcache->id == tcache_slots[i].id) {
+        tcache_slots[i].tcache->evicted = 1;
+    }
+    tcache_slots[i].id = 0;
+
+    allocator_lock(allocator);
+    for (tcache = allocator->tcaches; tcache; tcache = tcache->next) {
+        if (tcache->evicted) {
+            tcache->evicted = 0;
+            break;
+        }
+    }
+    if (!tcache) {
+        if ((tcache = tcache_spares) != NULL) {
+            tcache_spares = tcache->next;
+        }
+        else if ((tcache = calloc(1, sizeof(*tcache))) == NULL) {
+            allocator_unlock(allocator);
+            tcache_unlock();
+            return NULL;
+        }
+        tcache->id = id;
+        tcache->next = allocator->tcaches;
+        allocator->tcaches = tcache;
+    }
+    allocator_unlock(allocator);
+    tcache_unlock();
+
+have_tcache:
+    memmove(&tcache_slots[1], &tcache_slots[0], i * sizeof(tcache_slots[0]));
+    tcache_slots[0].id = id;
+    tcache_slots[0].tcache = tcache;
+
+    return tcache;
+}
+
+/* Take a node of the given index from the thread cache, refilling the
+ * cache from the allocator's free list (by batch) if it is empty.
+ */
+static APR_INLINE
+apr_memnode_t *tcache_alloc(apr_allocator_t *allocator,
+                            allocator_tcache_t *tcache, apr_size_t index)
+{
+    apr_memnode_t *node, **ref;
+    apr_size_t max_index;
+    apr_uint32_t count;
+
+    if ((node = tcache->free[index]) == NULL
+            && index <= allocator->max_index) {
+        allocator_lock(allocator);
+
+        ref = &allocator->free[index];
+        for (count = 0; count < TCACHE_BATCH && (node = *ref); count++) {
+            *ref = node->next;
+            node->next = tcache->free[index];
+            tcache->free[index] = node;
+
+            allocator->current_free_index += index + 1;
+        }
+        if (allocator->current_free_index > allocator->max_free_index)
+            allocator->current_free_index = allocator->max_free_index;
+        allocator_free_take(allocator, index, count);
+
+        /* Find the new highest available index if we emptied it */
+        max_index = allocator->max_index;
+        if (*ref == NULL && index == max_index) {
+            while (max_index && allocator->free[max_index] == NULL)
+                max_index--;
+            allocator->max_index = max_index;
+        }
+
+        allocator_unlock(allocator);
+
+        tcache->count[index] = count;
+        node = tcache->free[index];
+    }
+
+    if (node) {
+        tcache->free[index] = node->next;
+        tcache->count[index]--;
+        tcache->recycled++;
+    }
+
+    return node;
+}
+
+/* Put the cacheable nodes of the given list in the thread cache, and
+ * return the list of the others (including the ones overflowing the
+ * cache) to be given back to the allocator.
+ */
+static APR_INLINE
+apr_memnode_t *tcache_free(allocator_tcache_t *tcache, apr_memnode_t *node)
+{
+    apr_memnode_t *next, *last, *tail, *freelist = NULL;
+    apr_size_t index;
+    apr_uint32_t count;
+
+    do {
+        next = node->next;
+        index = node->index;
+
+        if (index >= TCACHE_INDEX) {
+            node->next = freelist;
+            freelist = node;
+            continue;
+        }
+
+        APR_VALGRIND_NOACCESS((char *)node + APR_MEMNODE_T_SIZE,
+                              (node->index+1) << BOUNDARY_INDEX);
+
+        if (tcache->count[index] >= TCACHE_MAX) {
+            /* Full, release the least recently cached nodes */
+            last = tcache->free[index];
+            for (count = 1; count < TCACHE_MAX - TCACHE_BATCH; count++)
+                last = last->next;
+            tcache->count[index] = count;
+
+            tail = last->next;
+            last->next = NULL;
+            last = tail;
+            while (last->next)
+                last = last->next;
+            last->next = freelist;
+            freelist = tail;
+        }
+
+        node->next = tcache->free[index];
+        tcache->free[index] = node;
+        tcache->count[index]++;
+    } while ((node = next) != NULL);
+
+    return freelist;
+}
+#endif /* APR_ALLOCATOR_HAS_TCACHE */
+
 static APR_INLINE
 apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
 {
@@ -300,6 +970,16 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
         return NULL;
     }
 
+#if APR_ALLOCATOR_HAS_TCACHE
+    if (allocator->tcache_id && index < TCACHE_INDEX) {
+        allocator_tcache_t *tcache = allocator_tcache_get(allocator);
+
+        if (tcache && (node = tcache_alloc(allocator, tcache, index))) {
+            goto have_node;
+        }
+    }
+#endif
+
     /* First see if there are any nodes in the area we know
      * our node will fit into.
      */
@@ -345,23 +1025,24 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
 
                 allocator->max_index = max_index;
             }
+            allocator_free_take(allocator, i, 1);
 
             allocator->current_free_index += node->index + 1;
             if (allocator->current_free_index > allocator->max_free_index)
                 allocator->current_free_index = allocator->max_free_index;
 
+            allocator->stat_nodes_recycled++;
+
             allocator_unlock(allocator);
 
             goto have_node;
         }
-
-        allocator_unlock(allocator);
     }
 
-    /* If we found nothing, seek the sink (at index MAX_INDEX), if
-     * it is not empty.
+    /* If we found nothing, seek the sink (at index MAX_INDEX).  The
+     * allocator is locked even if it is empty, to account for a new node.
      */
-    else if (allocator->free[MAX_INDEX]) {
+    else {
         allocator_lock(allocator);
 
         /* Walk the free list to see if there are
@@ -373,22 +1054,35 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
 
         if (node) {
             *ref = node->next;
+            allocator_free_take(allocator, MAX_INDEX, 1);
 
             allocator->current_free_index += node->index + 1;
             if (allocator->current_free_index > allocator->max_free_index)
                 allocator->current_free_index = allocator->max_free_index;
 
+            allocator->stat_nodes_recycled++;
+
             allocator_unlock(allocator);
 
             goto have_node;
         }
+    }
 
+    /* If we haven't got a suitable node, carve it from the current
+     * region if any, otherwise malloc a new one, and initialize it.
+     * The allocator is still locked here, so account for the new node
+     * now rather than locking it again once it is obtained.
+     */
+#if APR_ALLOCATOR_HAS_REGIONS
+    if (allocator->region_size
+            && (node = allocator_region_alloc(allocator, size)) != NULL) {
         allocator_unlock(allocator);
+        goto have_new_node;
     }
+#endif
+    allocator_stats_alloc(allocator, size);
+    allocator_unlock(allocator);
 
-    /* If we haven't got a suitable node, malloc a new one
-     * and initialize it.
-     */
 #if APR_ALLOCATOR_GUARD_PAGES
     if ((node = mmap(NULL, size + 2 * GUARDPAGE_SIZE, PROT_NONE,
                      MAP_PRIVATE|MAP_ANON, -1, 0)) == MAP_FAILED)
@@ -398,14 +1092,18 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
 #else
     if ((node = malloc(size)) == NULL)
 #endif
-        return NULL;
+        goto have_no_node;
 
 #if APR_ALLOCATOR_GUARD_PAGES
     node = (apr_memnode_t *)((char *)node + GUARDPAGE_SIZE);
     if (mprotect(node, size, PROT_READ|PROT_WRITE) != 0) {
         munmap((char *)node - GUARDPAGE_SIZE, size + 2 * GUARDPAGE_SIZE);
-        return NULL;
+        goto have_no_node;
     }
+#endif
+
+#if APR_ALLOCATOR_HAS_REGIONS
+have_new_node:
 #endif
     node->index = (apr_uint32_t)index;
     node->endp = (char *)node + size;
@@ -416,7 +1114,16 @@ have_node:
 
     APR_VALGRIND_UNDEFINED(node->first_avail, size - APR_MEMNODE_T_SIZE);
 
+    APR_PROBE3(allocator__alloc, allocator, node, size);
+
     return node;
+
+have_no_node:
+    allocator_lock(allocator);
+    allocator_stats_undo(allocator, size);
+    allocator_unlock(allocator);
+
+    return NULL;
 }
 
 static APR_INLINE
@@ -426,6 +1133,18 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
     apr_size_t index, max_index;
     apr_size_t max_free_index, current_free_index;
 
+    APR_PROBE2(allocator__free, allocator, node);
+
+#if APR_ALLOCATOR_HAS_TCACHE
+    if (allocator->tcache_id) {
+        allocator_tcache_t *tcache = allocator_tcache_get(allocator);
+
+        if (tcache && (node = tcache_free(tcache, node)) == NULL) {
+            return;
+        }
+    }
+#endif
+
     allocator_lock(allocator);
 
     max_index = allocator->max_index;
@@ -443,9 +1162,12 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
                               (node->index+1) << BOUNDARY_INDEX);
 
         if (max_free_index != APR_ALLOCATOR_MAX_FREE_UNLIMITED
-            && index + 1 > current_free_index) {
+            && index + 1 > current_free_index
+            && !allocator_region_owns(allocator, node)) {
             node->next = freelist;
             freelist = node;
+            allocator->stat_nodes_released++;
+            allocator->stat_footprint -= (index + 1) << BOUNDARY_INDEX;
         }
         else if (index < MAX_INDEX) {
             /* Add the node to the appropriate 'size' bucket.  Adjust
@@ -456,6 +1178,7 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
                 max_index = index;
             }
             allocator->free[index] = node;
+            allocator->free_count[index]++;
             if (current_free_index >= index + 1)
                 current_free_index -= index + 1;
             else
@@ -467,6 +1190,7 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
              */
             node->next = allocator->free[MAX_INDEX];
             allocator->free[MAX_INDEX] = node;
+            allocator->free_count[MAX_INDEX]++;
             if (current_free_index >= index + 1)
                 current_free_index -= index + 1;
             else
@@ -482,12 +1206,7 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
     while (freelist != NULL) {
         node = freelist;
         freelist = node->next;
-#if APR_ALLOCATOR_USES_MMAP
-        munmap((char *)node - GUARDPAGE_SIZE,
-               2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
-#else
-        free(node);
-#endif
+        allocator_node_release(node);
     }
 }
 
@@ -503,6 +1222,104 @@ APR_DECLARE(void) apr_allocator_free(apr_allocator_t *allocator,
     allocator_free(allocator, node);
 }
 
+APR_DECLARE(void) apr_allocator_stats_get(apr_allocator_t *allocator,
+                                          apr_allocator_stats_t *stats)
+{
+    apr_memnode_t *node;
+    apr_size_t index;
+
+    allocator_lock(allocator);
+
+    stats->nodes_alloc = allocator->stat_nodes_alloc;
+    stats->nodes_released = allocator->stat_nodes_released;
+    stats->nodes_recycled = allocator->stat_nodes_recycled;
+    stats->bytes_footprint = allocator->stat_footprint;
+    stats->bytes_peak = allocator->stat_peak;
+    stats->bytes_free = 0;
+    for (index = 0; index <= MAX_INDEX; index++) {
+        for (node = allocator->free[index]; node; node = node->next) {
+            stats->bytes_free += (node->index + 1) << BOUNDARY_INDEX;
+        }
+    }
+#if APR_ALLOCATOR_HAS_TCACHE
+    {
+        allocator_tcache_t *tcache;
+
+        for (tcache = allocator->tcaches; tcache; tcache = tcache->next) {
+            stats->nodes_recycled += tcache->recycled;
+            for (index = 0; index < TCACHE_INDEX; index++) {
+                stats->bytes_free += (apr_size_t)tcache->count[index]
+                                     * ((index + 1) << BOUNDARY_INDEX);
+            }
+        }
+    }
+#endif
+
+    allocator_unlock(allocator);
+}
+
+APR_DECLARE(apr_size_t) apr_allocator_trim(apr_allocator_t *allocator,
+                                           apr_uint32_t flags)
+{
+    apr_memnode_t *node, **ref, *freelist = NULL;
+    apr_size_t index, max_index = 0, released = 0;
+    apr_uint32_t keep;
+
+    allocator_lock(allocator);
+
+    for (index = 0; index <= MAX_INDEX; index++) {
+        /* The nodes below the low mark have not been used since the last
+         * call, and they are the last ones of the list where the nodes
+         * are put back first.  Half of them are released, so that a size
+         * still used now and then keeps some, and an unused size none
+         * after a few calls.
+         */
+        keep = allocator->free_count[index];
+        if (flags & APR_ALLOCATOR_TRIM_ALL)
+            keep = 0;
+        else
+            keep -= (allocator->free_low[index] + 1) / 2;
+
+        for (ref = &allocator->free[index]; keep && *ref; keep--)
+            ref = &(*ref)->next;
+
+        while ((node = *ref) != NULL) {
+            if (allocator_region_owns(allocator, node)) {
+                released += allocator_region_advise(allocator, node);
+                ref = &node->next;
+                continue;
+            }
+            *ref = node->next;
+            node->next = freelist;
+            freelist = node;
+
+            allocator->free_count[index]--;
+            allocator->current_free_index += node->index + 1;
+            allocator->stat_nodes_released++;
+            allocator->stat_footprint -= (node->index + 1) << BOUNDARY_INDEX;
+            released += (node->index + 1) << BOUNDARY_INDEX;
+        }
+        allocator->free_low[index] = allocator->free_count[index];
+
+        if (index < MAX_INDEX && allocator->free[index])
+            max_index = index;
+    }
+
+    allocator->max_index = max_index;
+    if (allocator->current_free_index > allocator->max_free_index)
+        allocator->current_free_index = allocator->max_free_index;
+
+    allocator_unlock(allocator);
+
+    while (freelist != NULL) {
+        node = freelist;
+        freelist = node->next;
+        allocator_node_release(node);
+    }
+
+    return released;
+}
+
 APR_DECLARE(apr_size_t) apr_allocator_page_size(void)
 {
     return boundary_size;
@@ -536,7 +1353,7 @@ APR_DECLARE(apr_status_t) apr_allocator_min_order_set(unsigned int order)
  * Structures
  */
 
-typedef struct cleanup_t cleanup_t;
+typedef struct apr_pool_cleanup_t cleanup_t;
 
 /** A list of processes */
 struct process_chain {
@@ -570,6 +1387,9 @@ struct debug_node_t {
  * to see how it is used.
  */
 struct apr_pool_t {
+#if !APR_POOL_DEBUG
+    apr_pool_inline_t     head; /* first, see apr_palloc_inline() */
+#endif
     apr_pool_t           *parent;
     apr_pool_t           *child;
     apr_pool_t           *sibling;
@@ -581,74 +1401,590 @@ struct apr_pool_t {
     apr_abortfunc_t       abort_fn;
     apr_hash_t           *user_data;
     const char           *tag;
+    void                **sized_free; /* apr_pool_free_sized() lists */
+
+#if !APR_POOL_DEBUG
+    apr_memnode_t        *self; /* The node containing the pool itself */
+    char                 *self_first_avail;
+    apr_pool_stats_t      stats;
+
+#else /* APR_POOL_DEBUG */
+    apr_pool_t           *joined; /* the caller has guaranteed that this pool
+                                   * will survive as long as ->joined */
+    debug_node_t         *nodes;
+    const char           *file_line;
+    apr_uint32_t          creation_flags;
+    unsigned int          stat_alloc;
+    unsigned int          stat_total_alloc;
+    unsigned int          stat_clear;
+#if APR_HAS_THREADS
+    apr_os_thread_t       owner;
+    apr_thread_mutex_t   *mutex;
+#endif /* APR_HAS_THREADS */
+#endif /* APR_POOL_DEBUG */
+#ifdef NETWARE
+    apr_os_proc_t         owner_proc;
+#endif /* defined(NETWARE) */
+    cleanup_t            *pre_cleanups;
+#if APR_POOL_CONCURRENCY_CHECK
+
+#define                   IDLE        0
+#define                   IN_USE      1
+#define                   DESTROYED   2
+    volatile apr_uint32_t in_use;
+    apr_os_thread_t       in_use_by;
+#endif /* APR_POOL_CONCURRENCY_CHECK */
+};
+
+#define SIZEOF_POOL_T       APR_ALIGN_DEFAULT(sizeof(apr_pool_t))
+
+
+/*
+ * Variables
+ */
+
+static apr_byte_t   apr_pools_initialized = 0;
+static apr_pool_t  *global_pool = NULL;
+
+#if !APR_POOL_DEBUG
+static apr_allocator_t *global_allocator = NULL;
+#endif /* !APR_POOL_DEBUG */
+
+#if (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE_ALL)
+static apr_file_t *file_stderr = NULL;
+static apr_status_t apr_pool_cleanup_file_stderr(void *data)
+{
+    file_stderr = NULL;
+    return APR_SUCCESS;
+}
+
+#endif /* (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE_ALL) */
+
+/*
+ * Local functions
+ */
+
+static void run_cleanups(cleanup_t **c);
+static void free_proc_chain(struct process_chain *procs);
+
+#if APR_POOL_DEBUG
+static void pool_destroy_debug(apr_pool_t *pool, const char *file_line);
+#endif
+
+/*
+ * Sampling allocation profiler (apr_pool_profile_set)
+ *
+ * Each thread counts down the bytes it allocates from the pools, and
+ * records the stack of the allocation reaching zero, weighted by the
+ * number of periods it spans.  The records are aggregated by stack and
+ * pool tag in a hash table which is malloc()ed, not to recurse into the
+ * pools, and locked by a spinlock since sampling is rare.
+ */
+#if defined(HAVE_EXECINFO_H) && defined(HAVE_BACKTRACE) \
+    && (APR_HAS_THREAD_LOCAL || !APR_HAS_THREADS)
+#define APR_POOL_HAS_PROFILE 1
+#include <execinfo.h>
+#if defined(HAVE_DLFCN_H) && defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#define APR_POOL_PROFILE_DLADDR 1
+#endif
+#if APR_HAS_THREADS
+#define PROFILE_THREAD_LOCAL APR_THREAD_LOCAL
+#else
+#define PROFILE_THREAD_LOCAL
+#endif
+#else
+#define APR_POOL_HAS_PROFILE 0
+#endif
+
+#if APR_POOL_HAS_PROFILE
+#define PROFILE_DEPTH   32
+#define PROFILE_BUCKETS 1024
+
+typedef struct profile_sample_t profile_sample_t;
+
+struct profile_sample_t {
+    profile_sample_t *next;
+    apr_uint32_t      hash;
+    int               depth;
+    /** Copy of the pool tag, or NULL */
+    char             *tag;
+    /** Number of samples */
+    apr_uint64_t      count;
+    /** Bytes accounted for by the samples */
+    apr_uint64_t      bytes;
+    void             *stack[PROFILE_DEPTH];
+};
+
+/* Zero when not sampling, read without locking by the allocations */
+static apr_size_t profile_period = 0;
+static PROFILE_THREAD_LOCAL apr_ssize_t profile_countdown;
+
+static apr_uint32_t profile_lock = 0;
+static profile_sample_t **profile_table = NULL;
+static apr_size_t profile_nsamples = 0;
+
+static void profile_acquire(void)
+{
+    while (apr_atomic_cas32(&profile_lock, 1, 0) != 0) {
+#if APR_HAS_THREADS
+        apr_thread_yield();
+#endif
+    }
+}
+
+static void profile_release(void)
+{
+    apr_atomic_set32(&profile_lock, 0);
+}
+
+static APR_INLINE apr_uint32_t profile_hash(const void *data, apr_size_t len,
+                                            apr_uint32_t hash)
+{
+    const unsigned char *p = data;
+
+    /* FNV-1a */
+    while (len--) {
+        hash = (hash ^ *p++) * 16777619;
+    }
+    return hash;
+}
+
+static void profile_record(apr_pool_t *pool, apr_size_t period)
+{
+    profile_sample_t *sample, **ref;
+    void *stack[PROFILE_DEPTH + 1];
+    const char *tag = pool->tag;
+    apr_size_t n, taglen = tag ? strlen(tag) + 1 : 0;
+    apr_uint32_t hash;
+    int depth;
+
+    n = 1 + (apr_size_t)-profile_countdown / period;
+    profile_countdown += n * period;
+
+    /* Skip our own frame */
+    depth = backtrace(stack, PROFILE_DEPTH + 1) - 1;
+    if (depth <= 0) {
+        return;
+    }
+    hash = profile_hash(stack + 1, depth * sizeof(void *), 2166136261U);
+    hash = profile_hash(tag, taglen, hash);
+
+    profile_acquire();
+
+    if (!profile_table) {
+        profile_release();
+        return;
+    }
+    ref = &profile_table[hash % PROFILE_BUCKETS];
+    for (sample = *ref; sample; sample = sample->next) {
+        if (sample->hash == hash && sample->depth == depth
+            && !memcmp(sample->stack, stack + 1, depth * sizeof(void *))
+            && (tag ? sample->tag && !strcmp(sample->tag, tag)
+                    : !sample->tag)) {
+            break;
+        }
+    }
+    if (!sample && (sample = malloc(sizeof(*sample) + taglen)) != NULL) {
+        sample->hash = hash;
+        sample->depth = depth;
+        memcpy(sample->stack, stack + 1, depth * sizeof(void *));
+        sample->tag = NULL;
+        if (tag) {
+            sample->tag = memcpy(sample + 1, tag, taglen);
+        }
+        sample->count = sample->bytes = 0;
+        sample->next = *ref;
+        *ref = sample;
+        profile_nsamples++;
+    }
+    if (sample) {
+        sample->count++;
+        sample->bytes += n * period;
+    }
+
+    profile_release();
+}
+
+static APR_INLINE void profile_account(apr_pool_t *pool, apr_size_t size)
+{
+    apr_size_t period = profile_period;
+
+    if (period) {
+        profile_countdown -= (apr_ssize_t)size;
+        if (profile_countdown <= 0) {
+            profile_record(pool, period);
+        }
+    }
+}
+
+/* Protocol buffers encoding of the profile */
+typedef struct profile_buf_t {
+    apr_pool_t *pool;
+    char       *data;
+    apr_size_t  len;
+    apr_size_t  size;
+} profile_buf_t;
+
+static void pb_put(profile_buf_t *b, const void *data, apr_size_t len)
+{
+    if (b->len + len > b->size) {
+        apr_size_t size = b->size ? b->size * 2 : 256;
+        char *newdata;
+
+        while (size < b->len + len) {
+            size *= 2;
+        }
+        newdata = apr_palloc(b->pool, size);
+        if (b->len) {
+            memcpy(newdata, b->data, b->len);
+        }
+        b->data = newdata;
+        b->size = size;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void pb_varint(profile_buf_t *b, apr_uint64_t v)
+{
+    unsigned char buf[10];
+    apr_size_t n = 0;
+
+    do {
+        buf[n++] = (unsigned char)((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+        v >>= 7;
+    } while (v);
+    pb_put(b, buf, n);
+}
+
+static void pb_uint(profile_buf_t *b, int field, apr_uint64_t v)
+{
+    pb_varint(b, (apr_uint64_t)field << 3);
+    pb_varint(b, v);
+}
+
+static void pb_bytes(profile_buf_t *b, int field, const void *data,
+                     apr_size_t len)
+{
+    pb_varint(b, ((apr_uint64_t)field << 3) | 2);
+    pb_varint(b, len);
+    pb_put(b, data, len);
+}
+
+/* Put the message being built in msg as the given field of b */
+static void pb_message(profile_buf_t *b, int field, profile_buf_t *msg)
+{
+    pb_bytes(b, field, msg->data, msg->len);
+    msg->len = 0;
+}
+
+typedef struct profile_strings_t {
+    apr_hash_t *index;
+    apr_array_header_t *strings;
+} profile_strings_t;
+
+static apr_uint64_t profile_string(profile_strings_t *strs, const char *s)
+{
+    apr_uint64_t *i = apr_hash_get(strs->index, s, APR_HASH_KEY_STRING);
+
+    if (!i) {
+        i = apr_palloc(strs->strings->pool, sizeof(*i));
+        *i = strs->strings->nelts;
+        APR_ARRAY_PUSH(strs->strings, const char *) = s;
+        apr_hash_set(strs->index, s, APR_HASH_KEY_STRING, i);
+    }
+    return *i;
+}
+
+typedef struct profile_location_t {
+    apr_uint64_t id;
+    apr_uint64_t mapping_id;
+    apr_uint64_t function_id;
+} profile_location_t;
+
+typedef struct profile_mapping_t {
+    apr_uint64_t id;
+    apr_uintptr_t start;
+    apr_uintptr_t limit;
+    const char *filename;
+} profile_mapping_t;
+
+static void profile_value_type(profile_buf_t *b, int field,
+                               profile_strings_t *strs,
+                               const char *type, const char *unit,
+                               profile_buf_t *msg)
+{
+    pb_uint(msg, 1, profile_string(strs, type));
+    pb_uint(msg, 2, profile_string(strs, unit));
+    pb_message(b, field, msg);
+}
+
+static void profile_encode(profile_buf_t *b, profile_sample_t *samples,
+                           apr_size_t nsamples, apr_size_t period)
+{
+    apr_pool_t *p = b->pool;
+    profile_buf_t msg = { 0 }, sub = { 0 }, ids = { 0 };
+    profile_strings_t strs;
+    apr_hash_t *locations = apr_hash_make(p);
+    apr_hash_t *mappings = apr_hash_make(p);
+    apr_hash_t *functions = apr_hash_make(p);
+    apr_hash_index_t *hi;
+    apr_uint64_t tag_key, nlocations = 0, nfunctions = 0, nmappings = 0;
+    apr_size_t i;
+    int j;
+
+    msg.pool = sub.pool = ids.pool = p;
+    strs.index = apr_hash_make(p);
+    strs.strings = apr_array_make(p, 64, sizeof(const char *));
+    profile_string(&strs, "");
+    tag_key = profile_string(&strs, "pool_tag");
+
+    profile_value_type(b, 1, &strs, "alloc_objects", "count", &msg);
+    profile_value_type(b, 1, &strs, "alloc_space", "bytes", &msg);
+
+    for (i = 0; i < nsamples; i++) {
+        profile_sample_t *sample = &samples[i];
+
+        for (j = 0; j < sample->depth; j++) {
+            /* The return addresses, back into the calls */
+            apr_uintptr_t addr = (apr_uintptr_t)sample->stack[j] - 1;
+            profile_location_t *loc;
+
+            loc = apr_hash_get(locations, &sample->stack[j], sizeof(void *));
+            if (!loc) {
+                loc = apr_pcalloc(p, sizeof(*loc));
+                loc->id = ++nlocations;
+                apr_hash_set(locations, &sample->stack[j], sizeof(void *),
+                             loc);
+#if APR_POOL_PROFILE_DLADDR
+                {
+                    Dl_info info;
+
+                    if (dladdr((void *)addr, &info) && info.dli_fbase) {
+                        profile_mapping_t *map;
+                        apr_uint64_t *fid;
+
+                        map = apr_hash_get(mappings, &info.dli_fbase,
+                                           sizeof(void *));
+                        if (!map) {
+                            map = apr_pcalloc(p, sizeof(*map));
+                            map->id = ++nmappings;
+                            map->start = (apr_uintptr_t)info.dli_fbase;
+                            map->filename = apr_pstrdup(p, info.dli_fname
+                                                           ? info.dli_fname
+                                                           : "");
+                            apr_hash_set(mappings, &map->start,
+                                         sizeof(void *), map);
+                        }
+                        if (map->limit <= addr) {
+                            map->limit = addr + 1;
+                        }
+                        loc->mapping_id = map->id;
+
+                        if (info.dli_sname) {
+                            fid = apr_hash_get(functions, info.dli_sname,
+                                               APR_HASH_KEY_STRING);
+                            if (!fid) {
+                                const char *name;
+
+                                name = apr_pstrdup(p, info.dli_sname);
+                                fid = apr_palloc(p, sizeof(*fid));
+                                *fid = ++nfunctions;
+                                apr_hash_set(functions, name,
+                                             APR_HASH_KEY_STRING, fid);
+
+                                pb_uint(&msg, 1, *fid);
+                                pb_uint(&msg, 2, profile_string(&strs, name));
+                                pb_uint(&msg, 3, profile_string(&strs, name));
+                                pb_message(b, 5, &msg);
+                            }
+                            loc->function_id = *fid;
+                        }
+                    }
+                }
+#endif
+                pb_uint(&msg, 1, loc->id);
+                if (loc->mapping_id) {
+                    pb_uint(&msg, 2, loc->mapping_id);
+                }
+                pb_uint(&msg, 3, addr);
+                if (loc->function_id) {
+                    pb_uint(&sub, 1, loc->function_id);
+                    pb_message(&msg, 4, &sub);
+                }
+                pb_message(b, 4, &msg);
+            }
+            pb_varint(&ids, loc->id);
+        }
+        pb_message(&msg, 1, &ids);
 
-#if !APR_POOL_DEBUG
-    apr_memnode_t        *active;
-    apr_memnode_t        *self; /* The node containing the pool itself */
-    char                 *self_first_avail;
+        pb_varint(&sub, sample->count);
+        pb_varint(&sub, sample->bytes);
+        pb_message(&msg, 2, &sub);
 
-#else /* APR_POOL_DEBUG */
-    apr_pool_t           *joined; /* the caller has guaranteed that this pool
-                                   * will survive as long as ->joined */
-    debug_node_t         *nodes;
-    const char           *file_line;
-    apr_uint32_t          creation_flags;
-    unsigned int          stat_alloc;
-    unsigned int          stat_total_alloc;
-    unsigned int          stat_clear;
-#if APR_HAS_THREADS
-    apr_os_thread_t       owner;
-    apr_thread_mutex_t   *mutex;
-#endif /* APR_HAS_THREADS */
-#endif /* APR_POOL_DEBUG */
-#ifdef NETWARE
-    apr_os_proc_t         owner_proc;
-#endif /* defined(NETWARE) */
-    cleanup_t            *pre_cleanups;
-#if APR_POOL_CONCURRENCY_CHECK
+        if (sample->tag) {
+            pb_uint(&sub, 1, tag_key);
+            pb_uint(&sub, 2, profile_string(&strs, sample->tag));
+            pb_message(&msg, 3, &sub);
+        }
+        pb_message(b, 2, &msg);
+    }
 
-#define                   IDLE        0
-#define                   IN_USE      1
-#define                   DESTROYED   2
-    volatile apr_uint32_t in_use;
-    apr_os_thread_t       in_use_by;
-#endif /* APR_POOL_CONCURRENCY_CHECK */
-};
+    for (hi = apr_hash_first(p, mappings); hi; hi = apr_hash_next(hi)) {
+        profile_mapping_t *map = apr_hash_this_val(hi);
 
-#define SIZEOF_POOL_T       APR_ALIGN_DEFAULT(sizeof(apr_pool_t))
+        pb_uint(&msg, 1, map->id);
+        pb_uint(&msg, 2, map->start);
+        pb_uint(&msg, 3, map->limit);
+        pb_uint(&msg, 5, profile_string(&strs, map->filename));
+        pb_uint(&msg, 7, 1);
+        pb_message(b, 3, &msg);
+    }
 
+    pb_uint(b, 9, (apr_uint64_t)apr_time_now() * 1000);
+    profile_value_type(b, 11, &strs, "space", "bytes", &msg);
+    pb_uint(b, 12, period);
 
-/*
- * Variables
- */
+    for (j = 0; j < strs.strings->nelts; j++) {
+        const char *s = APR_ARRAY_IDX(strs.strings, j, const char *);
 
-static apr_byte_t   apr_pools_initialized = 0;
-static apr_pool_t  *global_pool = NULL;
+        pb_bytes(b, 6, s, strlen(s));
+    }
+}
+#else
+#define profile_account(pool, size)
+#endif /* APR_POOL_HAS_PROFILE */
 
-#if !APR_POOL_DEBUG
-static apr_allocator_t *global_allocator = NULL;
-#endif /* !APR_POOL_DEBUG */
+/* The inline apr_palloc() of APR_POOL_INLINE bumps the active node only,
+ * so it is turned off while the allocations need more (accounting).
+ */
+static void pool_inline_update(void)
+{
+    int off = 0;
 
-#if (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE_ALL)
-static apr_file_t *file_stderr = NULL;
-static apr_status_t apr_pool_cleanup_file_stderr(void *data)
+#if APR_POOL_HAS_PROFILE
+    off |= (profile_period != 0);
+#endif
+#if HAVE_VALGRIND
+    off |= apr_running_on_valgrind;
+#endif
+#if APR_POOL_CONCURRENCY_CHECK
+    off = 1;
+#endif
+    apr_pool_inline_off = off;
+}
+
+APR_DECLARE(apr_status_t) apr_pool_profile_set(apr_size_t period)
 {
-    file_stderr = NULL;
+#if APR_POOL_HAS_PROFILE
+    if (period) {
+        profile_acquire();
+        if (!profile_table) {
+            profile_table = calloc(PROFILE_BUCKETS, sizeof(*profile_table));
+        }
+        profile_release();
+        if (!profile_table) {
+            return APR_ENOMEM;
+        }
+    }
+    profile_period = period;
+    pool_inline_update();
     return APR_SUCCESS;
+#else
+    (void)period;
+    return APR_ENOTIMPL;
+#endif
 }
 
-#endif /* (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE_ALL) */
+APR_DECLARE(apr_status_t) apr_pool_profile_get(void **profile,
+                                               apr_size_t *len,
+                                               apr_pool_t *p)
+{
+#if APR_POOL_HAS_PROFILE
+    profile_sample_t *samples = NULL, *sample;
+    apr_size_t nsamples = 0, alloced = 0, size, i;
+    profile_buf_t b = { 0 };
+    char *tags;
+
+    /* Copy the samples (in malloc()ed memory, the allocations from the
+     * pools could sample while locked) to encode them unlocked.
+     */
+    for (;;) {
+        profile_acquire();
+        size = profile_nsamples * sizeof(*sample);
+        if (profile_table) {
+            for (i = 0; i < PROFILE_BUCKETS; i++) {
+                for (sample = profile_table[i]; sample;
+                     sample = sample->next) {
+                    if (sample->tag) {
+                        size += strlen(sample->tag) + 1;
+                    }
+                }
+            }
+        }
+        if (size <= alloced) {
+            break;
+        }
+        profile_release();
+        free(samples);
+        if ((samples = malloc(size)) == NULL) {
+            return APR_ENOMEM;
+        }
+        alloced = size;
+    }
+    if (size) {
+        tags = (char *)(samples + profile_nsamples);
+        for (i = 0; i < PROFILE_BUCKETS; i++) {
+            for (sample = profile_table[i]; sample; sample = sample->next) {
+                samples[nsamples] = *sample;
+                if (sample->tag) {
+                    apr_size_t taglen = strlen(sample->tag) + 1;
+
+                    samples[nsamples].tag = memcpy(tags, sample->tag, taglen);
+                    tags += taglen;
+                }
+                nsamples++;
+            }
+        }
+    }
+    profile_release();
 
-/*
- * Local functions
- */
+    b.pool = p;
+    profile_encode(&b, samples, nsamples, profile_period);
+    free(samples);
 
-static void run_cleanups(cleanup_t **c);
-static void free_proc_chain(struct process_chain *procs);
+    *profile = b.data;
+    *len = b.len;
+    return APR_SUCCESS;
+#else
+    (void)p;
+    *profile = NULL;
+    *len = 0;
+    return APR_ENOTIMPL;
+#endif
+}
 
-#if APR_POOL_DEBUG
-static void pool_destroy_debug(apr_pool_t *pool, const char *file_line);
+APR_DECLARE(void) apr_pool_profile_clear(void)
+{
+#if APR_POOL_HAS_PROFILE
+    apr_size_t i;
+
+    profile_acquire();
+    if (profile_table) {
+        for (i = 0; i < PROFILE_BUCKETS; i++) {
+            while (profile_table[i]) {
+                profile_sample_t *sample = profile_table[i];
+
+                profile_table[i] = sample->next;
+                free(sample);
+            }
+        }
+        profile_nsamples = 0;
+    }
+    profile_release();
 #endif
+}
 
 #if !APR_POOL_DEBUG
 /*
@@ -665,6 +2001,7 @@ APR_DECLARE(apr_status_t) apr_pool_initialize(void)
 #if HAVE_VALGRIND
     apr_running_on_valgrind = RUNNING_ON_VALGRIND;
 #endif
+    pool_inline_update();
 
 #if defined(_SC_PAGESIZE)
     boundary_size = sysconf(_SC_PAGESIZE);
@@ -757,6 +2094,22 @@ APR_DECLARE(void) apr_pool_terminate(void)
 /* Returns the amount of free space in the given node. */
 #define node_free_space(node_) ((apr_size_t)(node_->endp - node_->first_avail))
 
+/* Returns the total size of the given node. */
+#define node_size(node_) ((apr_size_t)(node_->endp - (char *)node_))
+
+/* Pool statistics helpers, for a node fetched from or given back to
+ * the allocator.
+ */
+#define pool_stats_fetched(pool_, node_) do {                         \
+    (pool_)->stats.nodes_fetched++;                                   \
+    (pool_)->stats.footprint += node_size(node_);                     \
+    if ((pool_)->stats.peak_footprint < (pool_)->stats.footprint)     \
+        (pool_)->stats.peak_footprint = (pool_)->stats.footprint;     \
+} while (0)
+
+#define pool_stats_released(pool_, node_) \
+    ((pool_)->stats.footprint -= node_size(node_))
+
 /*
  * Helpers to mark pool as in-use/free. Used for finding thread-unsafe
  * concurrent accesses from different threads.
@@ -842,7 +2195,9 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 
         return NULL;
     }
-    active = pool->active;
+    active = pool->head.active;
+    pool->head.bytes_alloc += size;
+    profile_account(pool, size);
 
     /* If the active node has enough bytes left, use it. */
     if (size <= node_free_space(active)) {
@@ -854,6 +2209,7 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
     node = active->next;
     if (size <= node_free_space(node)) {
         list_remove(node);
+        pool->stats.nodes_reused++;
     }
     else {
         if ((node = allocator_alloc(pool->allocator, size)) == NULL) {
@@ -863,6 +2219,7 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 
             return NULL;
         }
+        pool_stats_fetched(pool, node);
     }
 
     node->free_index = 0;
@@ -872,7 +2229,7 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 
     list_insert(node, active);
 
-    pool->active = node;
+    pool->head.active = node;
 
     free_index = (APR_ALIGN(active->endp - active->first_avail + 1,
                             BOUNDARY_SIZE) - BOUNDARY_SIZE) >> BOUNDARY_INDEX;
@@ -937,6 +2294,8 @@ APR_DECLARE(void) apr_pool_clear(apr_pool_t *pool)
 {
     apr_memnode_t *active;
 
+    APR_PROBE1(pool__clear, pool);
+
     /* Run pre destroy cleanups */
     run_cleanups(&pool->pre_cleanups);
 
@@ -963,13 +2322,17 @@ APR_DECLARE(void) apr_pool_clear(apr_pool_t *pool)
 
     /* Clear the user data. */
     pool->user_data = NULL;
+    pool->sized_free = NULL;
 
     /* Find the node attached to the pool structure, reset it, make
      * it the active node and free the rest of the nodes.
      */
-    active = pool->active = pool->self;
+    active = pool->head.active = pool->self;
     active->first_avail = pool->self_first_avail;
 
+    pool->stats.clears++;
+    pool->stats.footprint = node_size(active);
+
     APR_IF_VALGRIND(VALGRIND_MEMPOOL_TRIM(pool, pool, 1));
 
     if (active->next == active) {
@@ -985,11 +2348,52 @@ APR_DECLARE(void) apr_pool_clear(apr_pool_t *pool)
     pool_concurrency_set_idle(pool);
 }
 
+/* Whether the node of a pool can be recycled in the cache of the allocator
+ * (which must be locked), and if so put it there.
+ */
+static APR_INLINE int pool_cache_put(apr_allocator_t *allocator,
+                                     apr_memnode_t *node)
+{
+#if POOL_CACHE_MAX
+    if (allocator->pool_cache_count < POOL_CACHE_MAX
+            && (apr_size_t)(node->endp - (char *)node) == MIN_ALLOC
+#if HAVE_VALGRIND
+            && !apr_running_on_valgrind
+#endif
+            ) {
+        node->next = allocator->pool_cache;
+        allocator->pool_cache = node;
+        allocator->pool_cache_count++;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+/* Take a recycled pool node from the cache of the allocator (which must be
+ * locked), if any.
+ */
+static APR_INLINE apr_memnode_t *pool_cache_get(apr_allocator_t *allocator)
+{
+    apr_memnode_t *node = NULL;
+
+#if POOL_CACHE_MAX
+    if ((node = allocator->pool_cache) != NULL) {
+        allocator->pool_cache = node->next;
+        allocator->pool_cache_count--;
+        allocator->stat_nodes_recycled++;
+    }
+#endif
+    return node;
+}
+
 APR_DECLARE(void) apr_pool_destroy(apr_pool_t *pool)
 {
     apr_memnode_t *active;
     apr_allocator_t *allocator;
 
+    APR_PROBE1(pool__destroy, pool);
+
     /* Run pre destroy cleanups */
     run_cleanups(&pool->pre_cleanups);
 
@@ -1010,22 +2414,35 @@ APR_DECLARE(void) apr_pool_destroy(apr_pool_t *pool)
     /* Free subprocesses */
     free_proc_chain(pool->subprocesses);
 
+    /* Find the block attached to the pool structure.  Save a copy of the
+     * allocator pointer, because the pool struct soon will be no more.
+     */
+    allocator = pool->allocator;
+    active = pool->self;
+    *active->ref = NULL;
+
     /* Remove the pool from the parents child list */
     if (pool->parent) {
-        allocator_lock(pool->parent->allocator);
+        apr_allocator_t *parent_allocator = pool->parent->allocator;
+
+        allocator_lock(parent_allocator);
 
         if ((*pool->ref = pool->sibling) != NULL)
             pool->sibling->ref = pool->ref;
 
-        allocator_unlock(pool->parent->allocator);
-    }
+        /* Recycle the pool struct's node if possible, the pool (or
+         * its struct) must not be used from now on.
+         */
+        if (parent_allocator == allocator && allocator->owner != pool) {
+            apr_memnode_t *next = active->next;
 
-    /* Find the block attached to the pool structure.  Save a copy of the
-     * allocator pointer, because the pool struct soon will be no more.
-     */
-    allocator = pool->allocator;
-    active = pool->self;
-    *active->ref = NULL;
+            if (pool_cache_put(allocator, active)) {
+                active = next;
+            }
+        }
+
+        allocator_unlock(parent_allocator);
+    }
 
 #if APR_HAS_THREADS
     if (apr_allocator_owner_get(allocator) == pool) {
@@ -1037,9 +2454,11 @@ APR_DECLARE(void) apr_pool_destroy(apr_pool_t *pool)
 #endif /* APR_HAS_THREADS */
 
     /* Free all the nodes in the pool (including the node holding the
-     * pool struct), by giving them back to the allocator.
+     * pool struct unless recycled), by giving them back to the allocator.
      */
-    allocator_free(allocator, active);
+    if (active) {
+        allocator_free(allocator, active);
+    }
 
     /* If this pool happens to be the owner of the allocator, free
      * everything in the allocator (that includes the pool struct
@@ -1059,6 +2478,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
 {
     apr_pool_t *pool;
     apr_memnode_t *node;
+    int recycled = 0;
 
     *newpool = NULL;
 
@@ -1075,12 +2495,28 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     if (allocator == NULL)
         allocator = parent->allocator;
 
-    if ((node = allocator_alloc(allocator,
-                                MIN_ALLOC - APR_MEMNODE_T_SIZE)) == NULL) {
-        if (abort_fn)
-            abort_fn(APR_ENOMEM);
+    /* Try to recycle a pool, keeping the allocator locked until the new
+     * pool is linked to its parent below.
+     */
+    node = NULL;
+    if (parent && parent->allocator == allocator) {
+        allocator_lock(allocator);
+        if ((node = pool_cache_get(allocator)) != NULL) {
+            node->first_avail = (char *)node + APR_MEMNODE_T_SIZE;
+            recycled = 1;
+        }
+        else {
+            allocator_unlock(allocator);
+        }
+    }
+    if (!node) {
+        node = allocator_alloc(allocator, MIN_ALLOC - APR_MEMNODE_T_SIZE);
+        if (node == NULL) {
+            if (abort_fn)
+                abort_fn(APR_ENOMEM);
 
-        return APR_ENOMEM;
+            return APR_ENOMEM;
+        }
     }
 
     node->next = node;
@@ -1105,7 +2541,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     node->first_avail = pool->self_first_avail;
 
     pool->allocator = allocator;
-    pool->active = pool->self = node;
+    pool->head.active = pool->self = node;
     pool->abort_fn = abort_fn;
     pool->child = NULL;
     pool->cleanups = NULL;
@@ -1113,14 +2549,20 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     pool->pre_cleanups = NULL;
     pool->subprocesses = NULL;
     pool->user_data = NULL;
+    pool->sized_free = NULL;
     pool->tag = NULL;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pool->head.bytes_alloc = 0;
+    pool_stats_fetched(pool, node);
 
 #ifdef NETWARE
     pool->owner_proc = (apr_os_proc_t)getnlmhandle();
 #endif /* defined(NETWARE) */
 
     if ((pool->parent = parent) != NULL) {
-        allocator_lock(parent->allocator);
+        if (!recycled) {
+            allocator_lock(parent->allocator);
+        }
 
         if ((pool->sibling = parent->child) != NULL)
             pool->sibling->ref = &pool->sibling;
@@ -1136,6 +2578,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     }
 
     pool_concurrency_init(pool);
+    APR_PROBE2(pool__create, pool, parent);
 
     *newpool = pool;
 
@@ -1186,7 +2629,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex(apr_pool_t **newpool,
     node->first_avail = pool->self_first_avail = (char *)pool + SIZEOF_POOL_T;
 
     pool->allocator = pool_allocator;
-    pool->active = pool->self = node;
+    pool->head.active = pool->self = node;
     pool->abort_fn = abort_fn;
     pool->child = NULL;
     pool->cleanups = NULL;
@@ -1194,10 +2637,14 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex(apr_pool_t **newpool,
     pool->pre_cleanups = NULL;
     pool->subprocesses = NULL;
     pool->user_data = NULL;
+    pool->sized_free = NULL;
     pool->tag = NULL;
     pool->parent = NULL;
     pool->sibling = NULL;
     pool->ref = NULL;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pool->head.bytes_alloc = 0;
+    pool_stats_fetched(pool, node);
 
 #ifdef NETWARE
     pool->owner_proc = (apr_os_proc_t)getnlmhandle();
@@ -1206,6 +2653,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex(apr_pool_t **newpool,
         pool_allocator->owner = pool;
 
     pool_concurrency_init(pool);
+    APR_PROBE2(pool__create, pool, pool->parent);
     *newpool = pool;
 
     return APR_SUCCESS;
@@ -1270,7 +2718,8 @@ static int psprintf_flush(apr_vformatter_buff_t *vbuff)
 
         node->free_index = 0;
 
-        pool->active = node;
+        pool->head.active = node;
+        pool->stats.nodes_reused++;
 
         free_index = (APR_ALIGN(active->endp - active->first_avail + 1,
                                 BOUNDARY_SIZE) - BOUNDARY_SIZE) >> BOUNDARY_INDEX;
@@ -1287,11 +2736,12 @@ static int psprintf_flush(apr_vformatter_buff_t *vbuff)
             list_insert(active, node);
         }
 
-        node = pool->active;
+        node = pool->head.active;
     }
     else {
         if ((node = allocator_alloc(pool->allocator, size)) == NULL)
             return -1;
+        pool_stats_fetched(pool, node);
 
         if (ps->got_a_new_node) {
             active->next = ps->free;
@@ -1352,7 +2802,7 @@ APR_DECLARE(char *) apr_pvsprintf(apr_pool_t *pool, const char *fmt, va_list ap)
     apr_size_t free_index;
 
     pool_concurrency_set_used(pool);
-    ps.node = pool->active;
+    ps.node = pool->head.active;
     ps.pool = pool;
     ps.vbuff.curpos  = ps.node->first_avail;
 
@@ -1407,9 +2857,13 @@ APR_DECLARE(char *) apr_pvsprintf(apr_pool_t *pool, const char *fmt, va_list ap)
     size = ps.vbuff.curpos - ps.node->first_avail;
     size = APR_ALIGN_DEFAULT(size);
     ps.node->first_avail += size;
+    pool->head.bytes_alloc += size;
 
-    if (ps.free)
+    if (ps.free) {
+        for (node = ps.free; node; node = node->next)
+            pool_stats_released(pool, node);
         allocator_free(pool->allocator, ps.free);
+    }
 
     /*
      * Link the node in if it's a new one
@@ -1419,14 +2873,14 @@ APR_DECLARE(char *) apr_pvsprintf(apr_pool_t *pool, const char *fmt, va_list ap)
         return strp;
     }
 
-    active = pool->active;
+    active = pool->head.active;
     node = ps.node;
 
     node->free_index = 0;
 
     list_insert(node, active);
 
-    pool->active = node;
+    pool->head.active = node;
 
     free_index = (APR_ALIGN(active->endp - active->first_avail + 1,
                             BOUNDARY_SIZE) - BOUNDARY_SIZE) >> BOUNDARY_INDEX;
@@ -1456,14 +2910,26 @@ error:
         pool->abort_fn(APR_ENOMEM);
     if (ps.got_a_new_node) {
         ps.node->next = ps.free;
+        for (node = ps.node; node; node = node->next)
+            pool_stats_released(pool, node);
         allocator_free(pool->allocator, ps.node);
     }
-    APR_VALGRIND_NOACCESS(pool->active->first_avail,
-                          pool->active->endp - pool->active->first_avail);
+    APR_VALGRIND_NOACCESS(pool->head.active->first_avail,
+                          pool->head.active->endp - pool->head.active->first_avail);
     return NULL;
 }
 
 
+APR_DECLARE(apr_status_t) apr_pool_stats_get(apr_pool_t *pool,
+                                             apr_pool_stats_t *stats)
+{
+    *stats = pool->stats;
+    stats->bytes_alloc = pool->head.bytes_alloc;
+
+    return APR_SUCCESS;
+}
+
+
 #else /* APR_POOL_DEBUG */
 /*
  * Debug helper functions
@@ -1784,6 +3250,8 @@ static void *pool_alloc(apr_pool_t *pool, apr_size_t size)
     debug_node_t *node;
     void *mem;
 
+    profile_account(pool, size);
+
     if ((mem = malloc(size)) == NULL) {
         if (pool->abort_fn)
             pool->abort_fn(APR_ENOMEM);
@@ -1894,6 +3362,7 @@ static void pool_clear_debug(apr_pool_t *pool, const char *file_line)
 
     /* Clear the user data. */
     pool->user_data = NULL;
+    pool->sized_free = NULL;
 
     /* Free the blocks, scribbling over them first to help highlight
      * use-after-free issues. */
@@ -1926,6 +3395,7 @@ APR_DECLARE(void) apr_pool_clear_debug(apr_pool_t *pool,
 #endif
 
     apr_pool_check_lifetime(pool);
+    APR_PROBE1(pool__clear, pool);
 
 #if APR_HAS_THREADS
     /* Lock the parent mutex before clearing so that if we have our
@@ -1988,6 +3458,7 @@ APR_DECLARE(void) apr_pool_destroy_debug(apr_pool_t *pool,
 #endif
 
     apr_pool_check_lifetime(pool);
+    APR_PROBE1(pool__destroy, pool);
 
     if (pool->joined) {
         /* Joined pools must not be explicitly destroyed; the caller
@@ -2106,6 +3577,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex_debug(apr_pool_t **newpool,
     apr_pool_log_event(pool, "CREATE", file_line, 1);
 #endif /* (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE) */
 
+    APR_PROBE2(pool__create, pool, parent);
     *newpool = pool;
 
     return APR_SUCCESS;
@@ -2176,6 +3648,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex_debug(apr_pool_t **newpoo
     apr_pool_log_event(pool, "CREATEU", file_line, 1);
 #endif /* (APR_POOL_DEBUG & APR_POOL_DEBUG_VERBOSE) */
 
+    APR_PROBE2(pool__create, pool, pool->parent);
     *newpool = pool;
 
     return APR_SUCCESS;
@@ -2337,6 +3810,12 @@ APR_DECLARE(apr_size_t) apr_pool_num_bytes(apr_pool_t *pool, int recurse)
     return size;
 }
 
+APR_DECLARE(apr_status_t) apr_pool_stats_get(apr_pool_t *pool,
+                                             apr_pool_stats_t *stats)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(void) apr_pool_lock(apr_pool_t *pool, int flag)
 {
 }
@@ -2436,6 +3915,74 @@ APR_DECLARE(int) apr_pool_is_ancestor(apr_pool_t *a, apr_pool_t *b)
     return 0;
 }
 
+/*
+ * Size classes for apr_pool_alloc_sized(): SIZED_SMALL_CLASSES classes
+ * of multiples of APR_ALIGN_DEFAULT(1) up to SIZED_SMALL_MAX, then
+ * powers of two up to APR_POOL_SIZED_MAX.
+ */
+#define SIZED_SMALL_MAX     256
+#define SIZED_SMALL_CLASSES (SIZED_SMALL_MAX / APR_ALIGN_DEFAULT(1))
+#define SIZED_CLASSES       (SIZED_SMALL_CLASSES + 6)
+
+/* Returns the class of the given (aligned) size and rounds it up to the
+ * class size, or returns -1 if the size is not recycled.
+ */
+static APR_INLINE int pool_sized_class(apr_size_t *size)
+{
+    apr_size_t class_size = SIZED_SMALL_MAX << 1;
+    int i = SIZED_SMALL_CLASSES;
+
+    if (*size <= SIZED_SMALL_MAX) {
+        return (int)(*size / APR_ALIGN_DEFAULT(1)) - 1;
+    }
+    if (*size > APR_POOL_SIZED_MAX) {
+        return -1;
+    }
+    while (class_size < *size) {
+        class_size <<= 1;
+        i++;
+    }
+    *size = class_size;
+
+    return i;
+}
+
+APR_DECLARE(void *) apr_pool_alloc_sized(apr_pool_t *pool, apr_size_t in_size)
+{
+    apr_size_t size = APR_ALIGN_DEFAULT(in_size);
+    void *mem;
+    int i;
+
+    if (size < in_size || (i = pool_sized_class(&size)) < 0) {
+        return apr_palloc(pool, in_size);
+    }
+    if (pool->sized_free && (mem = pool->sized_free[i]) != NULL) {
+        pool->sized_free[i] = *(void **)mem;
+        return mem;
+    }
+
+    return apr_palloc(pool, size);
+}
+
+APR_DECLARE(void) apr_pool_free_sized(apr_pool_t *pool, void *mem,
+                                      apr_size_t in_size)
+{
+    apr_size_t size = APR_ALIGN_DEFAULT(in_size);
+    int i;
+
+    if (!mem || size < in_size || (i = pool_sized_class(&size)) < 0) {
+        return;
+    }
+    if (!pool->sized_free) {
+        pool->sized_free = apr_pcalloc(pool, SIZED_CLASSES * sizeof(void *));
+        if (!pool->sized_free) {
+            return;
+        }
+    }
+    *(void **)mem = pool->sized_free[i];
+    pool->sized_free[i] = mem;
+}
+
 APR_DECLARE(void) apr_pool_tag(apr_pool_t *pool, const char *tag)
 {
     pool->tag = tag;
@@ -2517,43 +4064,99 @@ APR_DECLARE(apr_status_t) apr_pool_userdata_get(void **data, const char *key,
  * Cleanup
  */
 
-struct cleanup_t {
-    struct cleanup_t *next;
+/* The cleanups lists are singly linked from the head, and each cleanup
+ * points back to the pointer referencing it (NULL once unlinked) so that
+ * a handle can be killed without searching.
+ */
+struct apr_pool_cleanup_t {
+    struct apr_pool_cleanup_t *next;
+    struct apr_pool_cleanup_t **ref;
     const void *data;
     apr_status_t (*plain_cleanup_fn)(void *data);
     apr_status_t (*child_cleanup_fn)(void *data);
 };
 
-APR_DECLARE(void) apr_pool_cleanup_register(apr_pool_t *p, const void *data,
+static APR_INLINE void cleanup_link(cleanup_t **head, cleanup_t *c)
+{
+    c->next = *head;
+    if (c->next) {
+        c->next->ref = &c->next;
+    }
+    c->ref = head;
+    *head = c;
+}
+
+static APR_INLINE void cleanup_unlink(cleanup_t *c)
+{
+    *c->ref = c->next;
+    if (c->next) {
+        c->next->ref = c->ref;
+    }
+    c->ref = NULL;
+}
+
+static APR_INLINE cleanup_t *cleanup_alloc(apr_pool_t *p)
+{
+    cleanup_t *c;
+
+    if (p->free_cleanups) {
+        /* reuse a cleanup structure */
+        c = p->free_cleanups;
+        p->free_cleanups = c->next;
+    } else {
+        c = apr_palloc(p, sizeof(cleanup_t));
+    }
+    return c;
+}
+
+static APR_INLINE void cleanup_free(apr_pool_t *p, cleanup_t *c)
+{
+    cleanup_unlink(c);
+    /* move to freelist */
+    c->next = p->free_cleanups;
+    p->free_cleanups = c;
+}
+
+APR_DECLARE(apr_pool_cleanup_t *) apr_pool_cleanup_register_ex(
+                      apr_pool_t *p, const void *data,
                       apr_status_t (*plain_cleanup_fn)(void *data),
                       apr_status_t (*child_cleanup_fn)(void *data))
 {
-    cleanup_t *c = NULL;
+    cleanup_t *c;
 
 #if APR_POOL_DEBUG
     apr_pool_check_integrity(p);
 #endif /* APR_POOL_DEBUG */
 
-    if (p != NULL) {
-        if (p->free_cleanups) {
-            /* reuse a cleanup structure */
-            c = p->free_cleanups;
-            p->free_cleanups = c->next;
-        } else {
-            c = apr_palloc(p, sizeof(cleanup_t));
-        }
-        c->data = data;
-        c->plain_cleanup_fn = plain_cleanup_fn;
-        c->child_cleanup_fn = child_cleanup_fn;
-        c->next = p->cleanups;
-        p->cleanups = c;
+    c = cleanup_alloc(p);
+    c->data = data;
+    c->plain_cleanup_fn = plain_cleanup_fn;
+    c->child_cleanup_fn = child_cleanup_fn;
+    cleanup_link(&p->cleanups, c);
+
+#if APR_POOL_DEBUG
+    if (!c->plain_cleanup_fn || !c->child_cleanup_fn) {
+        abort();
     }
+#endif /* APR_POOL_DEBUG */
 
+    return c;
+}
+
+APR_DECLARE(void) apr_pool_cleanup_register(apr_pool_t *p, const void *data,
+                      apr_status_t (*plain_cleanup_fn)(void *data),
+                      apr_status_t (*child_cleanup_fn)(void *data))
+{
 #if APR_POOL_DEBUG
-    if (!c || !c->plain_cleanup_fn || !c->child_cleanup_fn) {
+    if (p == NULL) {
         abort();
     }
 #endif /* APR_POOL_DEBUG */
+
+    if (p != NULL) {
+        apr_pool_cleanup_register_ex(p, data, plain_cleanup_fn,
+                                     child_cleanup_fn);
+    }
 }
 
 APR_DECLARE(void) apr_pool_pre_cleanup_register(apr_pool_t *p, const void *data,
@@ -2566,17 +4169,10 @@ APR_DECLARE(void) apr_pool_pre_cleanup_register(apr_pool_t *p, const void *data,
 #endif /* APR_POOL_DEBUG */
 
     if (p != NULL) {
-        if (p->free_cleanups) {
-            /* reuse a cleanup structure */
-            c = p->free_cleanups;
-            p->free_cleanups = c->next;
-        } else {
-            c = apr_palloc(p, sizeof(cleanup_t));
-        }
+        c = cleanup_alloc(p);
         c->data = data;
         c->plain_cleanup_fn = plain_cleanup_fn;
-        c->next = p->pre_cleanups;
-        p->pre_cleanups = c;
+        cleanup_link(&p->pre_cleanups, c);
     }
 
 #if APR_POOL_DEBUG
@@ -2589,7 +4185,7 @@ APR_DECLARE(void) apr_pool_pre_cleanup_register(apr_pool_t *p, const void *data,
 APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
                       apr_status_t (*cleanup_fn)(void *))
 {
-    cleanup_t *c, **lastp;
+    cleanup_t *c;
 
 #if APR_POOL_DEBUG
     apr_pool_check_integrity(p);
@@ -2599,7 +4195,6 @@ APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
         return;
 
     c = p->cleanups;
-    lastp = &p->cleanups;
     while (c) {
 #if APR_POOL_DEBUG
         /* Some cheap loop detection to catch a corrupt list: */
@@ -2611,20 +4206,15 @@ APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
 #endif
 
         if (c->data == data && c->plain_cleanup_fn == cleanup_fn) {
-            *lastp = c->next;
-            /* move to freelist */
-            c->next = p->free_cleanups;
-            p->free_cleanups = c;
+            cleanup_free(p, c);
             break;
         }
 
-        lastp = &c->next;
         c = c->next;
     }
 
     /* Remove any pre-cleanup as well */
     c = p->pre_cleanups;
-    lastp = &p->pre_cleanups;
     while (c) {
 #if APR_POOL_DEBUG
         /* Some cheap loop detection to catch a corrupt list: */
@@ -2636,19 +4226,28 @@ APR_DECLARE(void) apr_pool_cleanup_kill(apr_pool_t *p, const void *data,
 #endif
 
         if (c->data == data && c->plain_cleanup_fn == cleanup_fn) {
-            *lastp = c->next;
-            /* move to freelist */
-            c->next = p->free_cleanups;
-            p->free_cleanups = c;
+            cleanup_free(p, c);
             break;
         }
 
-        lastp = &c->next;
         c = c->next;
     }
 
 }
 
+APR_DECLARE(void) apr_pool_cleanup_kill_handle(apr_pool_t *p,
+                                               apr_pool_cleanup_t *c)
+{
+#if APR_POOL_DEBUG
+    apr_pool_check_integrity(p);
+#endif /* APR_POOL_DEBUG */
+
+    /* Noop if the cleanup already ran in the current clear/destroy */
+    if (c->ref) {
+        cleanup_free(p, c);
+    }
+}
+
 APR_DECLARE(void) apr_pool_child_cleanup_set(apr_pool_t *p, const void *data,
                       apr_status_t (*plain_cleanup_fn)(void *),
                       apr_status_t (*child_cleanup_fn)(void *))
@@ -2680,12 +4279,22 @@ APR_DECLARE(apr_status_t) apr_pool_cleanup_run(apr_pool_t *p, void *data,
     return (*cleanup_fn)(data);
 }
 
+APR_DECLARE(apr_status_t) apr_pool_cleanup_run_handle(apr_pool_t *p,
+                                                apr_pool_cleanup_t *c)
+{
+    apr_status_t (*cleanup_fn)(void *data) = c->plain_cleanup_fn;
+    void *data = (void *)c->data;
+
+    apr_pool_cleanup_kill_handle(p, c);
+    return (*cleanup_fn)(data);
+}
+
 static void run_cleanups(cleanup_t **cref)
 {
     cleanup_t *c = *cref;
 
     while (c) {
-        *cref = c->next;
+        cleanup_unlink(c);
         (*c->plain_cleanup_fn)((void *)c->data);
         c = *cref;
     }
@@ -2698,7 +4307,7 @@ static void run_child_cleanups(cleanup_t **cref)
     cleanup_t *c = *cref;
 
     while (c) {
-        *cref = c->next;
+        cleanup_unlink(c);
         (*c->child_cleanup_fn)((void *)c->data);
         c = *cref;
     }
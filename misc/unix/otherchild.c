@@ -190,6 +190,20 @@ APR_DECLARE(void) apr_proc_other_child_refresh(apr_other_child_rec_t *ocr,
 #endif
 }
 
+APR_DECLARE(apr_status_t) apr_proc_other_child_refresh_proc(apr_proc_t *proc,
+                                                            int reason)
+{
+    apr_other_child_rec_t *ocr;
+
+    for (ocr = other_children; ocr; ocr = ocr->next) {
+        if (ocr->proc && ocr->proc->pid == proc->pid) {
+            apr_proc_other_child_refresh(ocr, reason);
+            return APR_SUCCESS;
+        }
+    }
+    return APR_EPROC_UNKNOWN;
+}
+
 APR_DECLARE(void) apr_proc_other_child_refresh_all(int reason)
 {
     apr_other_child_rec_t *ocr, *next_ocr;
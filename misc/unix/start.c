@@ -49,7 +49,6 @@ APR_DECLARE(apr_status_t) apr_initialize(void)
 
 #if !defined(BEOS) && !defined(OS2)
     apr_proc_mutex_unix_setup_lock();
-    apr_unix_setup_time();
 #endif
 
     if ((status = apr_pool_initialize()) != APR_SUCCESS)
@@ -68,6 +67,10 @@ APR_DECLARE(apr_status_t) apr_initialize(void)
      * apr_atomic_init() at the correct time.
      */
 
+    /* The time zone offset (where struct tm has none) and the signal
+     * descriptions are set up on first use, so that starting a program
+     * costs no more than its pools.
+     */
     apr_signal_init(pool);
 
     return APR_SUCCESS;
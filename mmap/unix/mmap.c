@@ -24,6 +24,9 @@
 #include "apr_errno.h"
 #include "apr_arch_file_io.h"
 #include "apr_portable.h"
+#include "apr_hash.h"
+#include "apr_thread_mutex.h"
+#include "apr_atomic.h"
 
 /* System headers required for the mmap library */
 #ifdef BEOS
@@ -32,6 +35,9 @@
 #if APR_HAVE_STRING_H
 #include <string.h>
 #endif
+#if APR_HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
 #if APR_HAVE_STDIO_H
 #include <stdio.h>
 #endif
@@ -47,6 +53,94 @@
 
 #if APR_HAS_MMAP || defined(BEOS)
 
+#ifndef BEOS
+typedef struct mmap_key_t {
+    apr_dev_t device;
+    apr_ino_t inode;
+    apr_time_t mtime;
+    apr_off_t offset;
+    apr_size_t size;
+    apr_int32_t prot;
+} mmap_key_t;
+
+/* A region mapped by the cache */
+struct apr_mmap_shared_t {
+    mmap_key_t key;
+    /* The cache, or NULL once it is destroyed */
+    apr_mmap_cache_t *cache;
+    void *mm;
+    apr_off_t poffset;
+    /* The number of rings using the region, under the cache's lock */
+    apr_uint32_t refs;
+    /* The link in the cache's idle list, when refs is zero */
+    APR_RING_ENTRY(apr_mmap_shared_t) link;
+};
+
+struct apr_mmap_cache_t {
+    apr_pool_t *pool;
+    /* The regions by key */
+    apr_hash_t *regions;
+    /* The unused regions, the most recently used first */
+    APR_RING_HEAD(mmap_idle_ring, apr_mmap_shared_t) idle;
+    apr_size_t idle_bytes;
+    apr_size_t max_bytes;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+};
+
+#if APR_HAS_THREADS
+#define CACHE_LOCK(c)   apr_thread_mutex_lock((c)->lock)
+#define CACHE_UNLOCK(c) apr_thread_mutex_unlock((c)->lock)
+#else
+#define CACHE_LOCK(c)
+#define CACHE_UNLOCK(c)
+#endif
+
+#define REGION_LEN(e) ((e)->key.size + (e)->poffset)
+
+static void mmap_shared_unmap(struct apr_mmap_shared_t *e)
+{
+    munmap((char *)e->mm - e->poffset, REGION_LEN(e));
+    free(e);
+}
+
+/* Unmap the least recently used idle regions beyond the cache's budget,
+ * with the lock held */
+static void mmap_cache_trim(apr_mmap_cache_t *cache)
+{
+    while (cache->idle_bytes > cache->max_bytes) {
+        struct apr_mmap_shared_t *e = APR_RING_LAST(&cache->idle);
+
+        APR_RING_REMOVE(e, link);
+        cache->idle_bytes -= REGION_LEN(e);
+        apr_hash_set(cache->regions, &e->key, sizeof(e->key), NULL);
+        mmap_shared_unmap(e);
+    }
+}
+
+static void mmap_shared_release(struct apr_mmap_shared_t *e)
+{
+    apr_mmap_cache_t *cache = e->cache;
+
+    if (!cache) {
+        /* detached by the cache's cleanup */
+        if (apr_atomic_dec32(&e->refs) == 0) {
+            mmap_shared_unmap(e);
+        }
+        return;
+    }
+
+    CACHE_LOCK(cache);
+    if (--e->refs == 0) {
+        APR_RING_INSERT_HEAD(&cache->idle, e, apr_mmap_shared_t, link);
+        cache->idle_bytes += REGION_LEN(e);
+        mmap_cache_trim(cache);
+    }
+    CACHE_UNLOCK(cache);
+}
+#endif /* !BEOS */
+
 static apr_status_t mmap_cleanup(void *themmap)
 {
     apr_mmap_t *mm = themmap;
@@ -63,6 +157,15 @@ static apr_status_t mmap_cleanup(void *themmap)
         return APR_SUCCESS;
     }
 
+#ifndef BEOS
+    if (mm->shared) {
+        /* the region is the cache's */
+        mmap_shared_release(mm->shared);
+        mm->mm = (void *)-1;
+        return APR_SUCCESS;
+    }
+#endif
+
 #ifdef BEOS
     rv = delete_area(mm->area);
 #else
@@ -76,20 +179,47 @@ static apr_status_t mmap_cleanup(void *themmap)
     return errno;
 }
 
-APR_DECLARE(apr_status_t) apr_mmap_create(apr_mmap_t **new, 
-                                          apr_file_t *file, apr_off_t offset, 
-                                          apr_size_t size, apr_int32_t flag, 
-                                          apr_pool_t *cont)
+#ifndef BEOS
+/* Give the access hints of flag to the system */
+static void mmap_advise(void *addr, apr_size_t len, apr_int32_t flag)
 {
-    void *mm;
-#ifdef BEOS
-    area_id aid = -1;
-    uint32 pages = 0;
+#ifdef HAVE_MADVISE
+#ifdef MADV_SEQUENTIAL
+    if (flag & APR_MMAP_SEQUENTIAL) {
+        (void)madvise(addr, len, MADV_SEQUENTIAL);
+    }
+#endif
+#ifdef MADV_RANDOM
+    if (flag & APR_MMAP_RANDOM) {
+        (void)madvise(addr, len, MADV_RANDOM);
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (flag & APR_MMAP_HUGEPAGE) {
+        (void)madvise(addr, len, MADV_HUGEPAGE);
+    }
+#endif
+#ifdef MADV_WILLNEED
+    if (flag & APR_MMAP_WILLNEED) {
+        (void)madvise(addr, len, MADV_WILLNEED);
+    }
+#endif
 #else
+    (void)addr;
+    (void)len;
+    (void)flag;
+#endif
+}
+
+/* Map the region of the file, returning the start of the data and its
+ * distance from the start of the page */
+static apr_status_t mmap_region(void **mm, apr_off_t *poffset,
+                                apr_file_t *file, apr_off_t offset,
+                                apr_size_t size, apr_int32_t flag)
+{
     static long psize;
-    apr_off_t poffset = 0;
     apr_int32_t native_flags = 0;
-#endif
+    void *addr;
 
 #if APR_HAS_LARGE_FILES && defined(HAVE_MMAP64)
 #define mmap mmap64
@@ -99,6 +229,53 @@ APR_DECLARE(apr_status_t) apr_mmap_create(apr_mmap_t **new,
         return APR_EINVAL;
 #endif
 
+    if (flag & APR_MMAP_WRITE) {
+        native_flags |= PROT_WRITE;
+    }
+    if (flag & APR_MMAP_READ) {
+        native_flags |= PROT_READ;
+    }
+
+    *poffset = 0;
+#if defined(_SC_PAGESIZE)
+    if (psize == 0) {
+        psize = sysconf(_SC_PAGESIZE);
+        /* the page size should be a power of two */
+        assert(psize > 0 && (psize & (psize - 1)) == 0);
+    }
+    *poffset = offset & (apr_off_t)(psize - 1);
+#endif
+
+    addr = mmap(NULL, size + *poffset,
+                native_flags, MAP_SHARED,
+                file->filedes, offset - *poffset);
+
+    if (addr == (void *)-1) {
+        /* we failed to get an mmap'd file... */
+        return errno;
+    }
+
+    mmap_advise(addr, size + *poffset, flag);
+
+    *mm = (char *)addr + *poffset;
+    return APR_SUCCESS;
+}
+#endif /* !BEOS */
+
+APR_DECLARE(apr_status_t) apr_mmap_create(apr_mmap_t **new, 
+                                          apr_file_t *file, apr_off_t offset, 
+                                          apr_size_t size, apr_int32_t flag, 
+                                          apr_pool_t *cont)
+{
+    void *mm;
+#ifdef BEOS
+    area_id aid = -1;
+    uint32 pages = 0;
+#else
+    apr_off_t poffset;
+    apr_status_t rv;
+#endif
+
     if (size == 0)
         return APR_EINVAL;
     
@@ -130,34 +307,12 @@ APR_DECLARE(apr_status_t) apr_mmap_create(apr_mmap_t **new,
     (*new)->area = aid;
 #else
 
-    if (flag & APR_MMAP_WRITE) {
-        native_flags |= PROT_WRITE;
-    }
-    if (flag & APR_MMAP_READ) {
-        native_flags |= PROT_READ;
-    }
-
-#if defined(_SC_PAGESIZE)
-    if (psize == 0) {
-        psize = sysconf(_SC_PAGESIZE);
-        /* the page size should be a power of two */
-        assert(psize > 0 && (psize & (psize - 1)) == 0);
-    }
-    poffset = offset & (apr_off_t)(psize - 1);
-    (*new)->poffset = poffset;
-#endif
-
-    mm = mmap(NULL, size + poffset,
-              native_flags, MAP_SHARED,
-              file->filedes, offset - poffset);
-
-    if (mm == (void *)-1) {
-        /* we failed to get an mmap'd file... */
+    rv = mmap_region(&mm, &poffset, file, offset, size, flag);
+    if (rv != APR_SUCCESS) {
         *new = NULL;
-        return errno;
+        return rv;
     }
-
-    mm = (char *)mm + poffset;
+    (*new)->poffset = poffset;
 #endif
 
     (*new)->mm = mm;
@@ -190,4 +345,167 @@ APR_DECLARE(apr_status_t) apr_mmap_delete(apr_mmap_t *mm)
     return apr_pool_cleanup_run(mm->cntxt, mm, mmap_cleanup);
 }
 
+#ifndef BEOS
+static apr_status_t mmap_cache_cleanup(void *data)
+{
+    apr_mmap_cache_t *cache = data;
+    apr_hash_index_t *hi;
+
+    /* The regions still in use are unmapped by their last release */
+    CACHE_LOCK(cache);
+    for (hi = apr_hash_first(NULL, cache->regions); hi;
+         hi = apr_hash_next(hi)) {
+        struct apr_mmap_shared_t *e = apr_hash_this_val(hi);
+
+        if (e->refs == 0) {
+            mmap_shared_unmap(e);
+        }
+        else {
+            e->cache = NULL;
+        }
+    }
+    CACHE_UNLOCK(cache);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_mmap_cache_create(apr_mmap_cache_t **cache,
+                                                apr_size_t max_bytes,
+                                                apr_pool_t *p)
+{
+    apr_mmap_cache_t *c = apr_pcalloc(p, sizeof(*c));
+
+    c->pool = p;
+    c->regions = apr_hash_make(p);
+    APR_RING_INIT(&c->idle, apr_mmap_shared_t, link);
+    c->max_bytes = max_bytes;
+#if APR_HAS_THREADS
+    {
+        apr_status_t rv = apr_thread_mutex_create(&c->lock,
+                                                  APR_THREAD_MUTEX_DEFAULT,
+                                                  p);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+    apr_pool_cleanup_register(p, c, mmap_cache_cleanup,
+                              apr_pool_cleanup_null);
+    *cache = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_mmap_cache_get(apr_mmap_t **new,
+                                             apr_mmap_cache_t *cache,
+                                             apr_file_t *file,
+                                             apr_off_t offset,
+                                             apr_size_t size,
+                                             apr_int32_t flag,
+                                             apr_pool_t *cont)
+{
+    struct apr_mmap_shared_t *e, *found;
+    apr_finfo_t finfo;
+    mmap_key_t key;
+    apr_status_t rv;
+
+    if (size == 0)
+        return APR_EINVAL;
+
+    if (file == NULL || file->filedes == -1 || file->buffered)
+        return APR_EBADF;
+
+    rv = apr_file_info_get(&finfo, APR_FINFO_IDENT | APR_FINFO_MTIME, file);
+    if ((rv != APR_SUCCESS && rv != APR_INCOMPLETE)
+        || (finfo.valid & (APR_FINFO_IDENT | APR_FINFO_MTIME))
+               != (APR_FINFO_IDENT | APR_FINFO_MTIME)) {
+        /* can't tell the file apart, so don't share it */
+        return apr_mmap_create(new, file, offset, size, flag, cont);
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.device = finfo.device;
+    key.inode = finfo.inode;
+    key.mtime = finfo.mtime;
+    key.offset = offset;
+    key.size = size;
+    key.prot = flag & (APR_MMAP_READ | APR_MMAP_WRITE);
+
+    CACHE_LOCK(cache);
+    e = apr_hash_get(cache->regions, &key, sizeof(key));
+    if (e && e->refs++ == 0) {
+        APR_RING_REMOVE(e, link);
+        cache->idle_bytes -= REGION_LEN(e);
+    }
+    CACHE_UNLOCK(cache);
+
+    if (!e) {
+        e = malloc(sizeof(*e));
+        if (!e) {
+            return APR_ENOMEM;
+        }
+        rv = mmap_region(&e->mm, &e->poffset, file, offset, size, flag);
+        if (rv != APR_SUCCESS) {
+            free(e);
+            *new = NULL;
+            return rv;
+        }
+        e->key = key;
+        e->cache = cache;
+        e->refs = 1;
+        APR_RING_ELEM_INIT(e, link);
+
+        CACHE_LOCK(cache);
+        found = apr_hash_get(cache->regions, &key, sizeof(key));
+        if (found) {
+            /* mapped by another thread meanwhile, use theirs */
+            if (found->refs++ == 0) {
+                APR_RING_REMOVE(found, link);
+                cache->idle_bytes -= REGION_LEN(found);
+            }
+        }
+        else {
+            apr_hash_set(cache->regions, &e->key, sizeof(e->key), e);
+        }
+        CACHE_UNLOCK(cache);
+
+        if (found) {
+            mmap_shared_unmap(e);
+            e = found;
+        }
+    }
+
+    (*new) = (apr_mmap_t *)apr_pcalloc(cont, sizeof(apr_mmap_t));
+    (*new)->poffset = e->poffset;
+    (*new)->mm = e->mm;
+    (*new)->size = size;
+    (*new)->cntxt = cont;
+    (*new)->shared = e;
+    APR_RING_ELEM_INIT(*new, link);
+
+    apr_pool_cleanup_register((*new)->cntxt, (void*)(*new), mmap_cleanup,
+             apr_pool_cleanup_null);
+    return APR_SUCCESS;
+}
+
+#else /* BEOS */
+
+APR_DECLARE(apr_status_t) apr_mmap_cache_create(apr_mmap_cache_t **cache,
+                                                apr_size_t max_bytes,
+                                                apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_mmap_cache_get(apr_mmap_t **new,
+                                             apr_mmap_cache_t *cache,
+                                             apr_file_t *file,
+                                             apr_off_t offset,
+                                             apr_size_t size,
+                                             apr_int32_t flag,
+                                             apr_pool_t *cont)
+{
+    return APR_ENOTIMPL;
+}
+
+#endif /* BEOS */
+
 #endif
@@ -161,4 +161,22 @@ APR_DECLARE(apr_status_t) apr_mmap_delete(apr_mmap_t *mm)
     return apr_pool_cleanup_run(mm->cntxt, mm, mmap_cleanup);
 }
 
+APR_DECLARE(apr_status_t) apr_mmap_cache_create(apr_mmap_cache_t **cache,
+                                                apr_size_t max_bytes,
+                                                apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_mmap_cache_get(apr_mmap_t **new,
+                                             apr_mmap_cache_t *cache,
+                                             apr_file_t *file,
+                                             apr_off_t offset,
+                                             apr_size_t size,
+                                             apr_int32_t flag,
+                                             apr_pool_t *cont)
+{
+    return APR_ENOTIMPL;
+}
+
 #endif
@@ -155,6 +155,26 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_sendv_zerocopy(apr_socket_t *sock,
+                                                    const struct iovec *vec,
+                                                    apr_int32_t nvec,
+                                                    apr_size_t *len,
+                                                    apr_uint32_t *id)
+{
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_zerocopy_reap(apr_socket_t *sock,
+                                                   apr_uint32_t *lo,
+                                                   apr_uint32_t *hi,
+                                                   int *copied)
+{
+    return APR_ENOTIMPL;
+}
+
+
 
 APR_DECLARE(apr_status_t) apr_socket_wait(apr_socket_t *sock, apr_wait_type_t direction)
 {
@@ -114,3 +114,80 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
         }
     } while (1);
 }
+
+
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_int32_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_int32_t *nsent)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_int32_t i;
+
+    *nsent = 0;
+    if (nmsgs < 0) {
+        return APR_EINVAL;
+    }
+    for (i = 0; i < nmsgs; i++) {
+        if (msgs[i].segment > 65535) {
+            return APR_EINVAL;
+        }
+    }
+
+    /* No batching nor segmentation offload, one datagram at a time */
+    for (i = 0; i < nmsgs; i++) {
+        apr_socket_msg_t *msg = &msgs[i];
+        apr_size_t off = 0, len;
+
+        do {
+            len = msg->len - off;
+            if (msg->segment && len > msg->segment) {
+                len = msg->segment;
+            }
+            if (msg->addr) {
+                rv = apr_socket_sendto(sock, msg->addr, flags,
+                                       msg->buf + off, &len);
+            }
+            else {
+                rv = apr_socket_send(sock, msg->buf + off, &len);
+            }
+            off += len;
+        } while (rv == APR_SUCCESS && off < msg->len);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        msg->len = off;
+    }
+
+    *nsent = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_int32_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_int32_t *nrecv)
+{
+    apr_sockaddr_t sa;
+    apr_status_t rv;
+
+    *nrecv = 0;
+    if (nmsgs < 0) {
+        return APR_EINVAL;
+    }
+    if (nmsgs == 0) {
+        return APR_SUCCESS;
+    }
+
+    /* No batching, one datagram at a time */
+    msgs[0].segment = 0;
+    rv = apr_socket_recvfrom(msgs[0].addr ? msgs[0].addr : &sa, sock, flags,
+                             msgs[0].buf, &msgs[0].len);
+    if (rv == APR_SUCCESS) {
+        *nrecv = 1;
+    }
+    return rv;
+}
@@ -17,10 +17,10 @@
 #include "apr_arch_networkio.h"
 #include "apr_support.h"
 
-#if APR_HAS_SENDFILE
+#if APR_HAS_SENDFILE || APR_HAS_SPLICE
 /* This file is needed to allow us access to the apr_file_t internals. */
 #include "apr_arch_file_io.h"
-#endif /* APR_HAS_SENDFILE */
+#endif /* APR_HAS_SENDFILE || APR_HAS_SPLICE */
 
 /* osreldate.h is only needed on FreeBSD for sendfile detection */
 #if defined(__FreeBSD__)
@@ -45,7 +45,7 @@ apr_status_t apr_socket_send(apr_socket_t *sock, const char *buf,
                     && (sock->timeout > 0)) {
         apr_status_t arv;
 do_select:
-        arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        arv = apr_socket_wait_io(sock, 0);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -60,7 +60,7 @@ do_select:
         *len = 0;
         return errno;
     }
-    if ((sock->timeout > 0) && (rv < *len)) {
+    if (apr_socket_timeout_polled(sock) && (rv < *len)) {
         sock->options |= APR_INCOMPLETE_WRITE;
     }
     (*len) = rv;
@@ -84,7 +84,7 @@ apr_status_t apr_socket_recv(apr_socket_t *sock, char *buf, apr_size_t *len)
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
                       && (sock->timeout > 0)) {
 do_select:
-        arv = apr_wait_for_io_or_timeout(NULL, sock, 1);
+        arv = apr_socket_wait_io(sock, 1);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -99,7 +99,7 @@ do_select:
         (*len) = 0;
         return errno;
     }
-    if ((sock->timeout > 0) && (rv < *len)) {
+    if (apr_socket_timeout_polled(sock) && (rv < *len)) {
         sock->options |= APR_INCOMPLETE_READ;
     }
     (*len) = rv;
@@ -123,7 +123,7 @@ apr_status_t apr_socket_sendto(apr_socket_t *sock, apr_sockaddr_t *where,
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
                       && (sock->timeout > 0)) {
-        apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        apr_status_t arv = apr_socket_wait_io(sock, 0);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -158,7 +158,7 @@ apr_status_t apr_socket_recvfrom(apr_sockaddr_t *from, apr_socket_t *sock,
 
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
                       && (sock->timeout > 0)) {
-        apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 1);
+        apr_status_t arv = apr_socket_wait_io(sock, 1);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -191,6 +191,357 @@ apr_status_t apr_socket_recvfrom(apr_sockaddr_t *from, apr_socket_t *sock,
     return APR_SUCCESS;
 }
 
+/* The messages given to sendmmsg()/recvmmsg() at once, on the stack */
+#define MMSG_ON_STACK 64
+
+static apr_status_t sendmmsg_loop(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                  apr_int32_t nmsgs, apr_int32_t flags,
+                                  apr_int32_t *nsent)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_int32_t i;
+
+    for (i = 0; i < nmsgs; i++) {
+        apr_socket_msg_t *msg = &msgs[i];
+        apr_size_t off = 0, len;
+
+        /* Cut the segments ourselves, at least one (possibly empty) */
+        do {
+            len = msg->len - off;
+            if (msg->segment && len > msg->segment) {
+                len = msg->segment;
+            }
+            if (msg->addr) {
+                rv = apr_socket_sendto(sock, msg->addr, flags,
+                                       msg->buf + off, &len);
+            }
+            else {
+                rv = apr_socket_send(sock, msg->buf + off, &len);
+            }
+            off += len;
+        } while (rv == APR_SUCCESS && off < msg->len);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        msg->len = off;
+    }
+
+    *nsent = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+static apr_status_t recvmmsg_loop(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                  apr_int32_t nmsgs, apr_int32_t flags,
+                                  apr_int32_t *nrecv)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_int32_t i;
+
+    for (i = 0; i < nmsgs; i++) {
+        apr_socket_msg_t *msg = &msgs[i];
+        apr_sockaddr_t sa, *from = msg->addr ? msg->addr : &sa;
+
+        msg->segment = 0;
+        if (i == 0) {
+            rv = apr_socket_recvfrom(from, sock, flags, msg->buf, &msg->len);
+        }
+        else {
+#ifdef MSG_DONTWAIT
+            /* Only pick up the datagrams already there */
+            apr_ssize_t n;
+
+            from->salen = sizeof(from->sa);
+            do {
+                n = recvfrom(sock->socketdes, msg->buf, msg->len,
+                             flags | MSG_DONTWAIT,
+                             (struct sockaddr *)&from->sa, &from->salen);
+            } while (n == -1 && errno == EINTR);
+            if (n == -1) {
+                rv = errno;
+                break;
+            }
+            if (from->salen > APR_OFFSETOF(struct sockaddr_in, sin_port)) {
+                apr_sockaddr_vars_set(from, from->sa.sin.sin_family,
+                                      ntohs(from->sa.sin.sin_port));
+            }
+            msg->len = n;
+#else
+            break;
+#endif
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    *nrecv = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+#if defined(HAVE_SENDMMSG) || defined(HAVE_RECVMMSG)
+
+/* Room for the UDP_SEGMENT (uint16_t) or UDP_GRO (int) control message */
+typedef union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+} mmsg_control_t;
+
+#endif
+
+#ifdef HAVE_SENDMMSG
+
+static apr_status_t sendmmsg_chunk(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                   int nmsgs, int flags, int *nsent)
+{
+    struct mmsghdr hdrs[MMSG_ON_STACK];
+    struct iovec iovs[MMSG_ON_STACK];
+#ifdef UDP_SEGMENT
+    mmsg_control_t controls[MMSG_ON_STACK];
+#endif
+    int i, rv;
+
+    memset(hdrs, 0, nmsgs * sizeof(hdrs[0]));
+    for (i = 0; i < nmsgs; i++) {
+        struct msghdr *mh = &hdrs[i].msg_hdr;
+
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = msgs[i].len;
+        mh->msg_iov = &iovs[i];
+        mh->msg_iovlen = 1;
+        if (msgs[i].addr) {
+            mh->msg_name = &msgs[i].addr->sa;
+            mh->msg_namelen = msgs[i].addr->salen;
+        }
+#ifdef UDP_SEGMENT
+        if (msgs[i].segment && msgs[i].len > msgs[i].segment) {
+            struct cmsghdr *cm;
+
+            mh->msg_control = controls[i].buf;
+            mh->msg_controllen = CMSG_SPACE(sizeof(apr_uint16_t));
+            cm = CMSG_FIRSTHDR(mh);
+            cm->cmsg_level = IPPROTO_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(apr_uint16_t));
+            *(apr_uint16_t *)CMSG_DATA(cm) = (apr_uint16_t)msgs[i].segment;
+        }
+#endif
+    }
+
+    do {
+        rv = sendmmsg(sock->socketdes, hdrs, nmsgs, flags);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0)) {
+        apr_status_t arv = apr_socket_wait_io(sock, 0);
+        if (arv != APR_SUCCESS) {
+            *nsent = 0;
+            return arv;
+        }
+        do {
+            rv = sendmmsg(sock->socketdes, hdrs, nmsgs, flags);
+        } while (rv == -1 && errno == EINTR);
+    }
+    if (rv == -1) {
+        *nsent = 0;
+        return errno;
+    }
+
+    for (i = 0; i < rv; i++) {
+        msgs[i].len = hdrs[i].msg_len;
+    }
+    *nsent = rv;
+    return APR_SUCCESS;
+}
+
+#endif /* HAVE_SENDMMSG */
+
+apr_status_t apr_socket_sendmmsg(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                 apr_int32_t nmsgs, apr_int32_t flags,
+                                 apr_int32_t *nsent)
+{
+    apr_int32_t i;
+
+    *nsent = 0;
+    if (nmsgs < 0) {
+        return APR_EINVAL;
+    }
+    for (i = 0; i < nmsgs; i++) {
+        if (msgs[i].segment > 65535) {
+            return APR_EINVAL;
+        }
+#ifndef UDP_SEGMENT
+        if (msgs[i].segment && msgs[i].len > msgs[i].segment) {
+            /* No offload, cut the segments in sendmmsg_loop() */
+            return sendmmsg_loop(sock, msgs, nmsgs, flags, nsent);
+        }
+#endif
+    }
+
+#ifdef HAVE_SENDMMSG
+    while (*nsent < nmsgs) {
+        int n = nmsgs - *nsent, sent;
+        apr_status_t rv;
+
+        if (n > MMSG_ON_STACK) {
+            n = MMSG_ON_STACK;
+        }
+        rv = sendmmsg_chunk(sock, msgs + *nsent, n, flags, &sent);
+        if (rv != APR_SUCCESS) {
+#ifdef ENOSYS
+            if (rv == ENOSYS && *nsent == 0) {
+                /* Not there at runtime */
+                break;
+            }
+#endif
+            return *nsent ? APR_SUCCESS : rv;
+        }
+        *nsent += sent;
+        if (sent < n) {
+            return APR_SUCCESS;
+        }
+    }
+    if (*nsent == nmsgs) {
+        return APR_SUCCESS;
+    }
+#endif
+
+    return sendmmsg_loop(sock, msgs, nmsgs, flags, nsent);
+}
+
+#ifdef HAVE_RECVMMSG
+
+static apr_status_t recvmmsg_chunk(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                   int nmsgs, int flags, int wait, int *nrecv)
+{
+    struct mmsghdr hdrs[MMSG_ON_STACK];
+    struct iovec iovs[MMSG_ON_STACK];
+#ifdef UDP_GRO
+    mmsg_control_t controls[MMSG_ON_STACK];
+    int gro = apr_is_option_set(sock, APR_SO_UDP_GRO);
+#endif
+    int i, rv;
+
+    memset(hdrs, 0, nmsgs * sizeof(hdrs[0]));
+    for (i = 0; i < nmsgs; i++) {
+        struct msghdr *mh = &hdrs[i].msg_hdr;
+
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = msgs[i].len;
+        mh->msg_iov = &iovs[i];
+        mh->msg_iovlen = 1;
+        if (msgs[i].addr) {
+            mh->msg_name = &msgs[i].addr->sa;
+            mh->msg_namelen = sizeof(msgs[i].addr->sa);
+        }
+#ifdef UDP_GRO
+        if (gro) {
+            mh->msg_control = controls[i].buf;
+            mh->msg_controllen = sizeof(controls[i].buf);
+        }
+#endif
+    }
+
+#ifdef MSG_WAITFORONE
+    /* Don't block for more than the first datagram */
+    flags |= MSG_WAITFORONE;
+#endif
+    if (!wait) {
+        flags |= MSG_DONTWAIT;
+    }
+
+    do {
+        rv = recvmmsg(sock->socketdes, hdrs, nmsgs, flags, NULL);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0) && wait) {
+        apr_status_t arv = apr_socket_wait_io(sock, 1);
+        if (arv != APR_SUCCESS) {
+            *nrecv = 0;
+            return arv;
+        }
+        do {
+            rv = recvmmsg(sock->socketdes, hdrs, nmsgs, flags, NULL);
+        } while (rv == -1 && errno == EINTR);
+    }
+    if (rv == -1) {
+        *nrecv = 0;
+        return errno;
+    }
+
+    for (i = 0; i < rv; i++) {
+        struct msghdr *mh = &hdrs[i].msg_hdr;
+        apr_sockaddr_t *from = msgs[i].addr;
+
+        msgs[i].len = hdrs[i].msg_len;
+        msgs[i].segment = 0;
+        if (from && mh->msg_namelen > APR_OFFSETOF(struct sockaddr_in,
+                                                   sin_port)) {
+            from->salen = mh->msg_namelen;
+            apr_sockaddr_vars_set(from, from->sa.sin.sin_family,
+                                  ntohs(from->sa.sin.sin_port));
+        }
+#ifdef UDP_GRO
+        if (gro) {
+            struct cmsghdr *cm;
+
+            for (cm = CMSG_FIRSTHDR(mh); cm; cm = CMSG_NXTHDR(mh, cm)) {
+                if (cm->cmsg_level == IPPROTO_UDP
+                        && cm->cmsg_type == UDP_GRO) {
+                    msgs[i].segment = *(int *)CMSG_DATA(cm);
+                }
+            }
+        }
+#endif
+    }
+    *nrecv = rv;
+    return APR_SUCCESS;
+}
+
+#endif /* HAVE_RECVMMSG */
+
+apr_status_t apr_socket_recvmmsg(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                 apr_int32_t nmsgs, apr_int32_t flags,
+                                 apr_int32_t *nrecv)
+{
+    *nrecv = 0;
+    if (nmsgs < 0) {
+        return APR_EINVAL;
+    }
+
+#ifdef HAVE_RECVMMSG
+    while (*nrecv < nmsgs) {
+        int n = nmsgs - *nrecv, received;
+        apr_status_t rv;
+
+        if (n > MMSG_ON_STACK) {
+            n = MMSG_ON_STACK;
+        }
+        rv = recvmmsg_chunk(sock, msgs + *nrecv, n, flags, *nrecv == 0,
+                            &received);
+        if (rv != APR_SUCCESS) {
+#ifdef ENOSYS
+            if (rv == ENOSYS && *nrecv == 0) {
+                /* Not there at runtime */
+                break;
+            }
+#endif
+            return *nrecv ? APR_SUCCESS : rv;
+        }
+        *nrecv += received;
+        if (received < n) {
+            return APR_SUCCESS;
+        }
+    }
+    if (*nrecv == nmsgs) {
+        return APR_SUCCESS;
+    }
+#endif
+
+    return recvmmsg_loop(sock, msgs, nmsgs, flags, nrecv);
+}
+
 apr_status_t apr_socket_sendv(apr_socket_t * sock, const struct iovec *vec,
                               apr_int32_t nvec, apr_size_t *len)
 {
@@ -211,7 +562,7 @@ apr_status_t apr_socket_sendv(apr_socket_t * sock, const struct iovec *vec,
                       && (sock->timeout > 0)) {
         apr_status_t arv;
 do_select:
-        arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        arv = apr_socket_wait_io(sock, 0);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -226,7 +577,7 @@ do_select:
         *len = 0;
         return errno;
     }
-    if (sock->timeout > 0) {
+    if (apr_socket_timeout_polled(sock)) {
         apr_size_t rv_len = rv;
         for (i = 0; i < nvec; ++i) {
             apr_size_t iov_len = vec[i].iov_len;
@@ -245,6 +596,142 @@ do_select:
 #endif
 }
 
+#if defined(HAVE_SOCKET_ZEROCOPY) \
+    || (APR_HAS_SENDFILE && (defined(__linux__) || defined(__GNU__)) \
+        && defined(HAVE_WRITEV) && defined(MSG_MORE))
+/* apr_socket_sendv() with sendmsg() flags */
+static apr_status_t sendv_flags(apr_socket_t *sock, const struct iovec *vec,
+                                apr_int32_t nvec, int flags, apr_size_t *len)
+{
+    struct msghdr msg;
+    apr_ssize_t rv;
+    apr_int32_t i;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)vec;
+    msg.msg_iovlen = nvec;
+
+    if (sock->options & APR_INCOMPLETE_WRITE) {
+        sock->options &= ~APR_INCOMPLETE_WRITE;
+        goto do_select;
+    }
+
+    do {
+        rv = sendmsg(sock->socketdes, &msg, flags);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0)) {
+        apr_status_t arv;
+do_select:
+        arv = apr_socket_wait_io(sock, 0);
+        if (arv != APR_SUCCESS) {
+            *len = 0;
+            return arv;
+        }
+        else {
+            do {
+                rv = sendmsg(sock->socketdes, &msg, flags);
+            } while (rv == -1 && errno == EINTR);
+        }
+    }
+    if (rv == -1) {
+        *len = 0;
+        return errno;
+    }
+    if (apr_socket_timeout_polled(sock)) {
+        apr_size_t rv_len = rv;
+        for (i = 0; i < nvec; ++i) {
+            apr_size_t iov_len = vec[i].iov_len;
+            if (rv_len < iov_len) {
+                sock->options |= APR_INCOMPLETE_WRITE;
+                break;
+            }
+            rv_len -= iov_len;
+        }
+    }
+    (*len) = rv;
+    return APR_SUCCESS;
+}
+#endif
+
+apr_status_t apr_socket_sendv_zerocopy(apr_socket_t *sock,
+                                       const struct iovec *vec,
+                                       apr_int32_t nvec, apr_size_t *len,
+                                       apr_uint32_t *id)
+{
+#ifdef HAVE_SOCKET_ZEROCOPY
+    apr_status_t rv;
+
+    if (!apr_is_option_set(sock, APR_SO_ZEROCOPY)) {
+        *len = 0;
+        return APR_EINVAL;
+    }
+
+    rv = sendv_flags(sock, vec, nvec, MSG_ZEROCOPY, len);
+    if (*len) {
+        /* The kernel numbers the sends which queued some data */
+        *id = sock->zerocopy_id++;
+    }
+    return rv;
+#else
+    *len = 0;
+    return APR_ENOTIMPL;
+#endif
+}
+
+apr_status_t apr_socket_zerocopy_reap(apr_socket_t *sock, apr_uint32_t *lo,
+                                      apr_uint32_t *hi, int *copied)
+{
+#ifdef HAVE_SOCKET_ZEROCOPY
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err)
+                            + sizeof(struct sockaddr_storage))];
+    } control;
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    apr_ssize_t rv;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        do {
+            rv = recvmsg(sock->socketdes, &msg, MSG_ERRQUEUE);
+        } while (rv == -1 && errno == EINTR);
+        if (rv == -1) {
+            return errno;
+        }
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *serr;
+
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+#if APR_HAVE_IPV6
+                  || (cm->cmsg_level == SOL_IPV6
+                      && cm->cmsg_type == IPV6_RECVERR)
+#endif
+                 )) {
+                continue;
+            }
+            serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            *lo = serr->ee_info;
+            *hi = serr->ee_data;
+            *copied = (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            return APR_SUCCESS;
+        }
+        /* Not a zero copy notification (e.g. a timestamp), next */
+    }
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
 apr_status_t apr_socket_wait(apr_socket_t *sock, apr_wait_type_t direction)
 {
     return apr_wait_for_io_or_timeout(NULL, sock, direction == APR_WAIT_READ);
@@ -266,7 +753,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
                                  apr_hdtr_t *hdtr, apr_off_t *offset,
                                  apr_size_t *len, apr_int32_t flags)
 {
-    int nopush_set = 0, rv, i;
+    int nopush_set = 0, more = 0, rv, i;
     apr_size_t bytes_to_send = *len;
     apr_status_t arv;
     apr_size_t n;
@@ -305,8 +792,16 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
     if (!hdtr) {
         hdtr = &no_hdtr;
     }
-    else if ((hdtr->numheaders > 0 || hdtr->numtrailers > 0)
-             && !apr_is_option_set(sock, APR_TCP_NOPUSH)) {
+#ifdef MSG_MORE
+    else if (hdtr->numtrailers == 0) {
+        /* Without trailers, MSG_MORE holds the headers back until the
+         * file follows, saving the TCP_CORK system calls.  If sending the
+         * file fails, the headers go with the next write (or the close). */
+        more = (hdtr->numheaders > 0 && bytes_to_send > 0);
+    }
+#endif
+    if (!more && (hdtr->numheaders > 0 || hdtr->numtrailers > 0)
+        && !apr_is_option_set(sock, APR_TCP_NOPUSH)) {
         /* cork before writing headers */
         rv = apr_socket_opt_set(sock, APR_TCP_NOPUSH, 1);
         if (rv != APR_SUCCESS) {
@@ -319,6 +814,13 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
         apr_size_t total_hdrbytes;
 
         /* Now write the headers */
+#ifdef MSG_MORE
+        if (more) {
+            arv = sendv_flags(sock, hdtr->headers, hdtr->numheaders,
+                              MSG_MORE, &n);
+        }
+        else
+#endif
         arv = apr_socket_sendv(sock, hdtr->headers, hdtr->numheaders, &n);
         *len += n;
         if (arv != APR_SUCCESS) {
@@ -356,7 +858,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK) 
                       && (sock->timeout > 0)) {
 do_select:
-        arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        arv = apr_socket_wait_io(sock, 0);
         if (arv != APR_SUCCESS) {
             return arv;
         }
@@ -393,7 +895,7 @@ do_select:
              * partial byte count;  this is a non-blocking socket.
              */
 
-            if (sock->timeout > 0) {
+            if (apr_socket_timeout_polled(sock)) {
                 sock->options |= APR_INCOMPLETE_WRITE;
             }
             return arv;
@@ -477,7 +979,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
         if (sock->options & APR_INCOMPLETE_WRITE) {
             apr_status_t arv;
             sock->options &= ~APR_INCOMPLETE_WRITE;
-            arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+            arv = apr_socket_wait_io(sock, 0);
             if (arv != APR_SUCCESS) {
                 return arv;
             }
@@ -493,7 +995,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
 
         if (rv == -1) {
             if (errno == EAGAIN) {
-                if (sock->timeout > 0) {
+                if (apr_socket_timeout_polled(sock)) {
                     sock->options |= APR_INCOMPLETE_WRITE;
                 }
                 /* BSD's sendfile can return -1/EAGAIN even if it
@@ -589,7 +1091,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t * sock, apr_file_t * file,
     do {
         if (sock->options & APR_INCOMPLETE_WRITE) {
             sock->options &= ~APR_INCOMPLETE_WRITE;
-            arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+            arv = apr_socket_wait_io(sock, 0);
             if (arv != APR_SUCCESS) {
                 return arv;
             }
@@ -609,7 +1111,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t * sock, apr_file_t * file,
 
             if (rv == -1) {
                 if (errno == EAGAIN) {
-                    if (sock->timeout > 0) {
+                    if (apr_socket_timeout_polled(sock)) {
                         sock->options |= APR_INCOMPLETE_WRITE;
                     }
                     /* FreeBSD's sendfile can return -1/EAGAIN even if it
@@ -647,7 +1149,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t * sock, apr_file_t * file,
                 *len += rv;
             }
             else if (rv == -1 && errno == EAGAIN) {
-                if (sock->timeout > 0) {
+                if (apr_socket_timeout_polled(sock)) {
                     sock->options |= APR_INCOMPLETE_WRITE;
                 }
                 else {
@@ -783,7 +1285,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
 
     while ((rc == -1) && (errno == EAGAIN || errno == EWOULDBLOCK) 
                       && (sock->timeout > 0)) {
-        apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        apr_status_t arv = apr_socket_wait_io(sock, 0);
 
         if (arv != APR_SUCCESS) {
             *len = 0;
@@ -931,7 +1433,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t * sock, apr_file_t * file,
     while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK) 
                       && (sock->timeout > 0)) {
 do_select:
-        arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        arv = apr_socket_wait_io(sock, 0);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -957,7 +1459,7 @@ do_select:
         return errno;
     }
 
-    if ((sock->timeout > 0)
+    if (apr_socket_timeout_polled(sock)
           && (parms.bytes_sent 
                 < (parms.file_bytes + parms.header_length + parms.trailer_length))) {
         sock->options |= APR_INCOMPLETE_WRITE;
@@ -1051,7 +1553,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
      */
     if (sock->options & APR_INCOMPLETE_WRITE) {
         sock->options &= ~APR_INCOMPLETE_WRITE;
-        arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        arv = apr_socket_wait_io(sock, 0);
         if (arv != APR_SUCCESS) {
             *len = 0;
             return arv;
@@ -1081,7 +1583,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
                 rv = 0;
             }
             else if (!arv && (sock->timeout > 0)) {
-                apr_status_t t = apr_wait_for_io_or_timeout(NULL, sock, 0);
+                apr_status_t t = apr_socket_wait_io(sock, 0);
 
                 if (t != APR_SUCCESS) {
                     *len = 0;
@@ -1109,7 +1611,7 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
         return APR_EOF;
     }
 
-    if ((sock->timeout > 0) && (*len < requested_len)) {
+    if (apr_socket_timeout_polled(sock) && (*len < requested_len)) {
         sock->options |= APR_INCOMPLETE_WRITE;
     }
     return APR_SUCCESS;
@@ -1122,3 +1624,166 @@ apr_status_t apr_socket_sendfile(apr_socket_t *sock, apr_file_t *file,
       Tru64/OSF1 */
 
 #endif /* APR_HAS_SENDFILE */
+
+#if APR_HAS_SPLICE
+
+/* The most we move through the pipe at once, the default pipe capacity */
+#define SPLICE_CHUNK (64 * 1024)
+
+static apr_status_t splice_pipe_cleanup(void *data)
+{
+    apr_socket_t *sock = data;
+
+    close(sock->splice_pipe[0]);
+    close(sock->splice_pipe[1]);
+    sock->splice_pipe[0] = sock->splice_pipe[1] = -1;
+    sock->splice_pending = 0;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t splice_pipe_create(apr_socket_t *sock)
+{
+    int fds[2], i;
+
+    if (pipe(fds) == -1) {
+        return errno;
+    }
+    for (i = 0; i < 2; i++) {
+        int flags = fcntl(fds[i], F_GETFL);
+
+        if (flags == -1
+            || fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) == -1
+            || fcntl(fds[i], F_SETFD, FD_CLOEXEC) == -1) {
+            apr_status_t rv = errno;
+            close(fds[0]);
+            close(fds[1]);
+            return rv;
+        }
+    }
+    sock->splice_pipe[0] = fds[0];
+    sock->splice_pipe[1] = fds[1];
+    apr_pool_cleanup_register(sock->pool, sock, splice_pipe_cleanup,
+                              apr_pool_cleanup_null);
+
+    return APR_SUCCESS;
+}
+
+/* Move what is pending in the pipe to the socket */
+static apr_status_t splice_flush(apr_socket_t *sock, apr_size_t *len)
+{
+    *len = 0;
+    while (sock->splice_pending) {
+        apr_ssize_t rv;
+
+        do {
+            rv = splice(sock->splice_pipe[0], NULL, sock->socketdes, NULL,
+                        sock->splice_pending,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } while (rv == -1 && errno == EINTR);
+
+        if (rv == -1) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK)
+                && sock->timeout > 0) {
+                apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+                if (arv != APR_SUCCESS) {
+                    return arv;
+                }
+                continue;
+            }
+            return errno;
+        }
+        sock->splice_pending -= rv;
+        *len += rv;
+    }
+
+    return APR_SUCCESS;
+}
+
+/* Move up to len bytes from the descriptor (of file or sock) to the pipe */
+static apr_status_t splice_fill(apr_socket_t *to, int fd, apr_file_t *file,
+                                apr_socket_t *sock, apr_size_t len)
+{
+    for (;;) {
+        apr_ssize_t rv;
+
+        do {
+            rv = splice(fd, NULL, to->splice_pipe[1], NULL, len,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } while (rv == -1 && errno == EINTR);
+
+        if (rv > 0) {
+            to->splice_pending += rv;
+            return APR_SUCCESS;
+        }
+        if (rv == 0) {
+            return APR_EOF;
+        }
+        /* SPLICE_F_NONBLOCK also applies to a pipe source, so wait for
+         * blocking pipes too; the (empty) pipe can't be the one blocking.
+         */
+        if ((errno == EAGAIN || errno == EWOULDBLOCK)
+            && (file ? file->timeout : sock->timeout) != 0) {
+            apr_status_t arv = apr_wait_for_io_or_timeout(file, sock, 1);
+            if (arv != APR_SUCCESS) {
+                return arv;
+            }
+            continue;
+        }
+        return errno;
+    }
+}
+
+static apr_status_t socket_splice(apr_socket_t *to, int fd, apr_file_t *file,
+                                  apr_socket_t *sock, apr_size_t *len)
+{
+    apr_size_t want = *len, n;
+    apr_status_t rv;
+
+    *len = 0;
+    if (to->splice_pipe[1] < 0) {
+        rv = splice_pipe_create(to);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    /* What is left from the previous call goes first */
+    if (to->splice_pending) {
+        rv = splice_flush(to, len);
+        if (rv != APR_SUCCESS || *len >= want) {
+            return rv;
+        }
+        want -= *len;
+    }
+
+    if (want > SPLICE_CHUNK) {
+        want = SPLICE_CHUNK;
+    }
+    rv = splice_fill(to, fd, file, sock, want);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = splice_flush(to, &n);
+    *len += n;
+    return rv;
+}
+
+apr_status_t apr_socket_splice(apr_socket_t *to, apr_socket_t *from,
+                               apr_size_t *len)
+{
+    return socket_splice(to, from->socketdes, NULL, from, len);
+}
+
+apr_status_t apr_socket_splice_file(apr_socket_t *to, apr_file_t *from,
+                                    apr_size_t *len)
+{
+    /* Bytes buffered by APR would be skipped */
+    if (from->buffered || from->ungetchar != -1) {
+        *len = 0;
+        return APR_ENOTIMPL;
+    }
+    return socket_splice(to, from->filedes, from, NULL, len);
+}
+
+#endif /* APR_HAS_SPLICE */
@@ -1220,6 +1220,225 @@ APR_DECLARE(int) apr_ipsubnet_test(apr_ipsubnet_t *ipsub, apr_sockaddr_t *sa)
     return 0; /* no match */
 }
 
+/*
+ * The ip-set is a binary radix trie per address family, path-compressed so
+ * that each node either is an added prefix or has two children (glue).
+ * The keys are the prefixes' 32-bit words in host order, left aligned.
+ */
+typedef struct ipset_node_t ipset_node_t;
+struct ipset_node_t {
+    ipset_node_t *child[2];
+    apr_uint32_t key[4];
+    unsigned int bits;
+    int added;
+    void *value;
+};
+
+struct apr_ipset_t {
+    apr_pool_t *pool;
+    ipset_node_t *root4;
+#if APR_HAVE_IPV6
+    ipset_node_t *root6;
+#endif
+    apr_size_t count;
+};
+
+#define IPSET_BIT(key, i) (((key)[(i) >> 5] >> (31 - ((i) & 31))) & 1)
+
+/* Number of leading bits (up to max) common to both keys */
+static unsigned int ipset_common_bits(const apr_uint32_t *a,
+                                      const apr_uint32_t *b,
+                                      unsigned int max)
+{
+    unsigned int n = 0;
+    apr_uint32_t x;
+
+    while (n < max) {
+        x = a[n >> 5] ^ b[n >> 5];
+        if (x) {
+            while (!(x & 0x80000000)) {
+                x <<= 1;
+                n++;
+            }
+            break;
+        }
+        n += 32;
+    }
+    return n < max ? n : max;
+}
+
+/* Whether the first bits of the key match the (masked) prefix */
+static APR_INLINE int ipset_match(const apr_uint32_t *prefix,
+                                  const apr_uint32_t *key, unsigned int bits)
+{
+    unsigned int i;
+
+    for (i = 0; bits >= 32; i++, bits -= 32) {
+        if (key[i] != prefix[i]) {
+            return 0;
+        }
+    }
+    return !bits || !((key[i] ^ prefix[i]) & (0xFFFFFFFFUL << (32 - bits)));
+}
+
+static ipset_node_t *ipset_node_make(apr_ipset_t *ipset,
+                                     const apr_uint32_t *key,
+                                     unsigned int bits)
+{
+    ipset_node_t *node = apr_pcalloc(ipset->pool, sizeof(*node));
+    unsigned int i;
+
+    /* Keep only the prefix bits (glue nodes are made from longer keys) */
+    for (i = 0; i < 4 && bits > i * 32; i++) {
+        node->key[i] = key[i];
+        if (bits < (i + 1) * 32) {
+            node->key[i] &= 0xFFFFFFFFUL << ((i + 1) * 32 - bits);
+        }
+    }
+    node->bits = bits;
+    return node;
+}
+
+APR_DECLARE(apr_status_t) apr_ipset_create(apr_ipset_t **ipset,
+                                           apr_pool_t *p)
+{
+    *ipset = apr_pcalloc(p, sizeof(apr_ipset_t));
+    (*ipset)->pool = p;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_ipset_add(apr_ipset_t *ipset,
+                                        const apr_ipsubnet_t *ipsub,
+                                        void *value)
+{
+    ipset_node_t **ref, *node, *leaf, *glue;
+    apr_uint32_t key[4] = {0, 0, 0, 0}, mask;
+    unsigned int i, words = 1, bits = 0, common;
+
+#if APR_HAVE_IPV6
+    if (ipsub->family == AF_INET6) {
+        words = 4;
+        ref = &ipset->root6;
+    }
+    else
+#endif
+    ref = &ipset->root4;
+
+    /* The prefix length of the (contiguous) mask */
+    for (i = 0; i < words; i++) {
+        key[i] = ntohl(ipsub->sub[i]);
+        mask = ntohl(ipsub->mask[i]);
+        if (bits == i * 32) {
+            while (mask & 0x80000000) {
+                mask <<= 1;
+                bits++;
+            }
+        }
+        if (mask) {
+            return APR_EBADMASK;
+        }
+    }
+
+    for (;;) {
+        node = *ref;
+        if (!node) {
+            *ref = ipset_node_make(ipset, key, bits);
+            node = *ref;
+            break;
+        }
+        common = ipset_common_bits(node->key, key,
+                                   node->bits < bits ? node->bits : bits);
+        if (common < node->bits) {
+            if (common == bits) {
+                /* The new prefix is above the node */
+                leaf = ipset_node_make(ipset, key, bits);
+                leaf->child[IPSET_BIT(node->key, bits)] = node;
+                *ref = node = leaf;
+            }
+            else {
+                /* The new prefix forks from the node */
+                leaf = ipset_node_make(ipset, key, bits);
+                glue = ipset_node_make(ipset, key, common);
+                glue->child[IPSET_BIT(key, common)] = leaf;
+                glue->child[IPSET_BIT(node->key, common)] = node;
+                *ref = glue;
+                node = leaf;
+            }
+            break;
+        }
+        if (node->bits == bits) {
+            break;
+        }
+        ref = &node->child[IPSET_BIT(key, node->bits)];
+    }
+
+    if (!node->added) {
+        node->added = 1;
+        ipset->count++;
+    }
+    node->value = value;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(int) apr_ipset_test(const apr_ipset_t *ipset,
+                                const apr_sockaddr_t *sa, void **value)
+{
+    const ipset_node_t *node, *found = NULL;
+    apr_uint32_t key[4];
+    unsigned int maxbits = 32;
+
+#if APR_HAVE_IPV6
+    if (sa->family == AF_INET) {
+        key[0] = ntohl(sa->sa.sin.sin_addr.s_addr);
+        node = ipset->root4;
+    }
+    else if (IN6_IS_ADDR_V4MAPPED((struct in6_addr *)sa->ipaddr_ptr)) {
+        key[0] = ntohl(((apr_uint32_t *)sa->ipaddr_ptr)[3]);
+        node = ipset->root4;
+    }
+    else if (sa->family == AF_INET6) {
+        const apr_uint32_t *addr = (const apr_uint32_t *)sa->ipaddr_ptr;
+
+        key[0] = ntohl(addr[0]);
+        key[1] = ntohl(addr[1]);
+        key[2] = ntohl(addr[2]);
+        key[3] = ntohl(addr[3]);
+        node = ipset->root6;
+        maxbits = 128;
+    }
+    else {
+        node = NULL;
+    }
+#else
+    key[0] = ntohl(sa->sa.sin.sin_addr.s_addr);
+    node = ipset->root4;
+#endif /* APR_HAVE_IPV6 */
+
+    /* Longest prefix match */
+    while (node && ipset_match(node->key, key, node->bits)) {
+        if (node->added) {
+            found = node;
+        }
+        if (node->bits == maxbits) {
+            break;
+        }
+        node = node->child[IPSET_BIT(key, node->bits)];
+    }
+
+    if (!found) {
+        return 0; /* no match */
+    }
+    if (value) {
+        *value = found->value;
+    }
+    return 1;
+}
+
+APR_DECLARE(apr_size_t) apr_ipset_count(const apr_ipset_t *ipset)
+{
+    return ipset->count;
+}
+
 APR_DECLARE(apr_status_t) apr_sockaddr_zone_set(apr_sockaddr_t *sa,
                                                 const char *zone_id)
 {
@@ -16,6 +16,19 @@
 
 #include "apr_network_io.h"
 #include "apr_poll.h"
+#include "apr_portable.h"
+#include "apr_time.h"
+
+#if APR_HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+#include <linux/filter.h>
+#define APR_HAS_REUSEPORT_CBPF 1
+#else
+#define APR_HAS_REUSEPORT_CBPF 0
+#endif
 
 APR_DECLARE(apr_status_t) apr_socket_atreadeof(apr_socket_t *sock, int *atreadeof)
 {
@@ -73,3 +86,396 @@ APR_DECLARE(apr_status_t) apr_socket_atreadeof(apr_socket_t *sock, int *atreadeo
     return APR_EGENERAL;
 }
 
+
+struct apr_socket_listen_group_t {
+    apr_pool_t *pool;
+    int nsockets;
+    apr_socket_t **socks;
+};
+
+#if APR_HAS_REUSEPORT_CBPF
+/* Select the socket of the group by CPU, modulo the number of sockets
+ * (the kernel falls back to hashing if the index is out of range anyway).
+ */
+static apr_status_t listen_group_steer_cpu(apr_socket_listen_group_t *group)
+{
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (apr_uint32_t)group->nsockets },
+        { BPF_RET | BPF_A, 0, 0, 0 }
+    };
+    struct sock_fprog prog;
+    apr_os_sock_t fd;
+    apr_status_t rv;
+
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    /* Attached to the group through any of its sockets */
+    rv = apr_os_sock_get(&fd, group->socks[0]);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                   &prog, sizeof(prog)) == -1) {
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_socket_listen_group_create(
+                                          apr_socket_listen_group_t **group,
+                                          apr_sockaddr_t *sa,
+                                          int type, int protocol,
+                                          int nsockets,
+                                          apr_int32_t backlog,
+                                          apr_uint32_t flags,
+                                          apr_pool_t *p)
+{
+    apr_socket_listen_group_t *g;
+    apr_sockaddr_t *bind_sa = sa;
+    apr_status_t rv = APR_SUCCESS;
+    int i;
+
+    *group = NULL;
+
+    if (nsockets <= 0 || (flags & ~APR_LISTEN_GROUP_STEER_CPU)) {
+        return APR_EINVAL;
+    }
+#if !APR_HAS_REUSEPORT_CBPF
+    if (flags & APR_LISTEN_GROUP_STEER_CPU) {
+        return APR_ENOTIMPL;
+    }
+#endif
+
+    g = apr_pcalloc(p, sizeof(*g));
+    g->pool = p;
+    g->socks = apr_pcalloc(p, nsockets * sizeof(apr_socket_t *));
+
+    /* The sockets join the kernel's group in this order, which gives
+     * their index for the steering policy.
+     */
+    for (i = 0; i < nsockets; i++) {
+        apr_socket_t *s;
+
+        rv = apr_socket_create(&s, sa->family, type, protocol, p);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        g->socks[g->nsockets++] = s;
+
+        rv = apr_socket_opt_set(s, APR_SO_REUSEADDR, 1);
+        if (rv == APR_SUCCESS) {
+            rv = apr_socket_opt_set(s, APR_SO_REUSEPORT, 1);
+        }
+        if (rv == APR_SUCCESS) {
+            rv = apr_socket_bind(s, bind_sa);
+        }
+        if (rv == APR_SUCCESS && i == 0 && sa->port == 0) {
+            /* The others bind to the port picked for the first one */
+            rv = apr_socket_addr_get(&bind_sa, APR_LOCAL, s);
+        }
+        if (rv == APR_SUCCESS && type == SOCK_STREAM) {
+            rv = apr_socket_listen(s, backlog);
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+#if APR_HAS_REUSEPORT_CBPF
+    if (rv == APR_SUCCESS && (flags & APR_LISTEN_GROUP_STEER_CPU)) {
+        rv = listen_group_steer_cpu(g);
+    }
+#endif
+
+    if (rv != APR_SUCCESS) {
+        for (i = 0; i < g->nsockets; i++) {
+            apr_socket_close(g->socks[i]);
+        }
+        return rv;
+    }
+
+    *group = g;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(int) apr_socket_listen_group_size(
+                                    const apr_socket_listen_group_t *group)
+{
+    return group->nsockets;
+}
+
+APR_DECLARE(apr_socket_t *) apr_socket_listen_group_get(
+                                    const apr_socket_listen_group_t *group,
+                                    int index)
+{
+    if (index < 0 || index >= group->nsockets) {
+        return NULL;
+    }
+    return group->socks[index];
+}
+
+typedef struct connect_attempt_t {
+    apr_socket_t *sock;
+    apr_sockaddr_t *sa;
+} connect_attempt_t;
+
+/* Order the addresses as RFC 8305 (section 4) recommends, alternating
+ * the address families from the first one of the list (the resolver's
+ * preferred), each family keeping its own order.
+ */
+static apr_sockaddr_t **connect_any_order(apr_sockaddr_t *sa, int *naddrs,
+                                          apr_pool_t *p)
+{
+    apr_sockaddr_t **order, **others, *cur;
+    int n = 0, nfirst = 0, nothers = 0, i;
+
+    for (cur = sa; cur; cur = cur->next) {
+        n++;
+    }
+    order = apr_palloc(p, n * sizeof(apr_sockaddr_t *));
+    others = apr_palloc(p, n * sizeof(apr_sockaddr_t *));
+
+    for (cur = sa; cur; cur = cur->next) {
+        if (cur->family == sa->family) {
+            order[nfirst++] = cur;
+        }
+        else {
+            others[nothers++] = cur;
+        }
+    }
+    /* Interleave them in place, from the end where the excess of the
+     * longer family goes.
+     */
+    for (i = n; i > 0; ) {
+        if (nothers > nfirst) {
+            order[--i] = others[--nothers];
+        }
+        else if (nfirst > nothers) {
+            order[--i] = order[--nfirst];
+        }
+        else {
+            order[--i] = others[--nothers];
+            order[--i] = order[--nfirst];
+        }
+    }
+
+    *naddrs = n;
+    return order;
+}
+
+static apr_status_t connect_any_start(connect_attempt_t *a, int type,
+                                      int protocol, apr_uint32_t flags,
+                                      apr_pool_t *p)
+{
+    apr_status_t rv;
+
+    rv = apr_socket_create(&a->sock, a->sa->family, type, protocol, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+#ifdef TCP_FASTOPEN_CONNECT
+    if (flags & APR_CONNECT_FASTOPEN) {
+        apr_os_sock_t fd;
+        int on = 1;
+
+        /* With a cookie from a previous connection to this destination,
+         * the connection completes right away, the SYN leaving with the
+         * first data written.  Best effort, the system may not know it.
+         */
+        if (apr_os_sock_get(&fd, a->sock) == APR_SUCCESS) {
+            setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+                       (void *)&on, sizeof(on));
+        }
+    }
+#endif
+    rv = apr_socket_timeout_set(a->sock, 0);
+    if (rv == APR_SUCCESS) {
+        rv = apr_socket_connect(a->sock, a->sa);
+    }
+    if (rv != APR_SUCCESS && !APR_STATUS_IS_EINPROGRESS(rv)) {
+        apr_socket_close(a->sock);
+        a->sock = NULL;
+    }
+    return rv;
+}
+
+/* Whether the connection of a socket reported writable succeeded */
+static apr_status_t connect_any_result(connect_attempt_t *a)
+{
+#ifdef SO_ERROR
+    apr_os_sock_t fd;
+    apr_socklen_t len = sizeof(int);
+    int error = 0;
+    apr_status_t rv;
+
+    rv = apr_os_sock_get(&fd, a->sock);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (char *)&error, &len) < 0) {
+        return apr_get_netos_error();
+    }
+    if (error) {
+        return APR_FROM_OS_ERROR(error);
+    }
+#endif
+    /* Connecting again fills in the socket's addresses; the system
+     * answers that it is connected, or the error otherwise.
+     */
+    apr_socket_connect(a->sock, a->sa);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_connect_any(apr_socket_t **sock,
+                                                 apr_sockaddr_t *sa,
+                                                 int type, int protocol,
+                                                 apr_interval_time_t delay,
+                                                 apr_interval_time_t timeout,
+                                                 apr_uint32_t flags,
+                                                 apr_pool_t *p)
+{
+    apr_pool_t *tmp;
+    apr_pollset_t *pollset;
+    apr_sockaddr_t **order;
+    connect_attempt_t *attempts, *winner = NULL;
+    apr_time_t now, next_start, deadline = 0;
+    apr_status_t rv, last_rv = APR_EGENERAL;
+    int naddrs, next = 0, pending = 0, i;
+
+    *sock = NULL;
+
+    if (flags & ~APR_CONNECT_FASTOPEN) {
+        return APR_EINVAL;
+    }
+#ifndef TCP_FASTOPEN_CONNECT
+    if (flags & APR_CONNECT_FASTOPEN) {
+        return APR_ENOTIMPL;
+    }
+#endif
+    if (delay < 0) {
+        delay = APR_CONNECT_ANY_DELAY;
+    }
+    else if (delay < apr_time_from_msec(10)) {
+        /* The minimum of RFC 8305, not to flood the network */
+        delay = apr_time_from_msec(10);
+    }
+
+    rv = apr_pool_create(&tmp, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    order = connect_any_order(sa, &naddrs, tmp);
+    attempts = apr_pcalloc(tmp, naddrs * sizeof(connect_attempt_t));
+    rv = apr_pollset_create(&pollset, naddrs, tmp, 0);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(tmp);
+        return rv;
+    }
+
+    now = next_start = apr_time_now();
+    if (timeout >= 0) {
+        deadline = now + timeout;
+    }
+
+    while (!winner) {
+        apr_interval_time_t wait = -1;
+        const apr_pollfd_t *descs;
+        apr_int32_t num;
+
+        if (timeout >= 0 && now >= deadline) {
+            rv = APR_TIMEUP;
+            break;
+        }
+
+        /* Start the next attempt when the previous ones have failed or
+         * had the connection attempt delay to succeed.
+         */
+        if (next < naddrs && (!pending || now >= next_start)) {
+            connect_attempt_t *a = &attempts[next];
+
+            a->sa = order[next++];
+            rv = connect_any_start(a, type, protocol, flags, p);
+            if (rv == APR_SUCCESS) {
+                winner = a;
+                break;
+            }
+            if (!APR_STATUS_IS_EINPROGRESS(rv)) {
+                last_rv = rv;
+                next_start = now;
+                continue;
+            }
+            else {
+                apr_pollfd_t pfd;
+
+                pfd.p = tmp;
+                pfd.desc_type = APR_POLL_SOCKET;
+                pfd.reqevents = APR_POLLOUT;
+                pfd.desc.s = a->sock;
+                pfd.client_data = a;
+                rv = apr_pollset_add(pollset, &pfd);
+                if (rv != APR_SUCCESS) {
+                    last_rv = rv;
+                    apr_socket_close(a->sock);
+                    a->sock = NULL;
+                    next_start = now;
+                    continue;
+                }
+                pending++;
+                next_start = now + delay;
+            }
+        }
+        if (!pending) {
+            rv = last_rv;
+            break;
+        }
+
+        if (next < naddrs) {
+            wait = next_start - now;
+        }
+        if (timeout >= 0 && (wait < 0 || wait > deadline - now)) {
+            wait = deadline - now;
+        }
+
+        rv = apr_pollset_poll(pollset, wait, &num, &descs);
+        now = apr_time_now();
+        if (rv != APR_SUCCESS) {
+            if (APR_STATUS_IS_EINTR(rv) || APR_STATUS_IS_TIMEUP(rv)) {
+                continue;
+            }
+            break;
+        }
+        for (i = 0; i < num; i++) {
+            connect_attempt_t *a = descs[i].client_data;
+
+            rv = connect_any_result(a);
+            if (rv == APR_SUCCESS) {
+                winner = a;
+                break;
+            }
+            last_rv = rv;
+            apr_pollset_remove(pollset, &descs[i]);
+            apr_socket_close(a->sock);
+            a->sock = NULL;
+            pending--;
+
+            /* A failure lets the next attempt start right away */
+            next_start = now;
+        }
+    }
+
+    for (i = 0; i < next; i++) {
+        if (attempts[i].sock && &attempts[i] != winner) {
+            apr_socket_close(attempts[i].sock);
+        }
+    }
+    if (winner) {
+        apr_socket_timeout_set(winner->sock, -1);
+        *sock = winner->sock;
+        rv = APR_SUCCESS;
+    }
+    apr_pool_destroy(tmp);
+    return rv;
+}
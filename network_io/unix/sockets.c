@@ -100,6 +100,9 @@ static void alloc_socket(apr_socket_t **new, apr_pool_t *p)
                                                         sizeof(apr_sockaddr_t));
     (*new)->remote_addr->pool = p;
     (*new)->remote_addr_unknown = 1;
+#if APR_HAS_SPLICE
+    (*new)->splice_pipe[0] = (*new)->splice_pipe[1] = -1;
+#endif
 #ifndef WAITIO_USES_POLL
     /* Create a pollset with room for one descriptor. */
     /* ### check return codes */
@@ -400,7 +403,7 @@ apr_status_t apr_socket_connect(apr_socket_t *sock, apr_sockaddr_t *sa)
      */
     if ((rc == -1) && (errno == EINPROGRESS || errno == EALREADY)
                    && (sock->timeout > 0)) {
-        rc = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        rc = apr_socket_wait_io(sock, 0);
         if (rc != APR_SUCCESS) {
             return rc;
         }
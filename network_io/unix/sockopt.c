@@ -72,10 +72,64 @@ static apr_status_t sononblock(int sd)
 }
 
 
+static apr_status_t nonblock_set(apr_socket_t *sock, int on)
+{
+    apr_status_t stat;
+
+    if (on != apr_is_option_set(sock, APR_SO_NONBLOCK)) {
+        stat = on ? sononblock(sock->socketdes) : soblock(sock->socketdes);
+        if (stat != APR_SUCCESS) {
+            return stat;
+        }
+        apr_set_option(sock, APR_SO_NONBLOCK, on);
+    }
+    return APR_SUCCESS;
+}
+
+#if defined(SO_RCVTIMEO) && defined(SO_SNDTIMEO)
+#define HAVE_SYSTIMEOUT 1
+
+/* Let the system time out the blocking socket calls (zero for never) */
+static apr_status_t sotimeout(int sd, apr_interval_time_t t)
+{
+    struct timeval tv;
+
+    tv.tv_sec = apr_time_sec(t);
+    tv.tv_usec = apr_time_usec(t);
+    if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, (void *)&tv,
+                   sizeof(tv)) == -1
+        || setsockopt(sd, SOL_SOCKET, SO_SNDTIMEO, (void *)&tv,
+                      sizeof(tv)) == -1) {
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+#endif
+
 apr_status_t apr_socket_timeout_set(apr_socket_t *sock, apr_interval_time_t t)
 {
     apr_status_t stat;
 
+#ifdef HAVE_SYSTIMEOUT
+    /* With APR_SO_SYSTIMEOUT the socket is blocking, unless the timeout
+     * is zero, and the system fails the calls once the timeout expired.
+     */
+    if (apr_is_option_set(sock, APR_SO_SYSTIMEOUT)) {
+        if (t > 0 || sock->timeout > 0) {
+            stat = sotimeout(sock->socketdes, t > 0 ? t : 0);
+            if (stat != APR_SUCCESS) {
+                return stat;
+            }
+        }
+        stat = nonblock_set(sock, t == 0);
+        if (stat != APR_SUCCESS) {
+            return stat;
+        }
+        sock->timeout = t;
+        return APR_SUCCESS;
+    }
+#endif
+
     /* If our new timeout is non-negative and our old timeout was
      * negative, then we need to ensure that we are non-blocking.
      * Conversely, if our new timeout is negative and we had
@@ -342,6 +396,67 @@ apr_status_t apr_socket_opt_set(apr_socket_t *sock,
          * options, IP_BINDANY vs IPV6_BINDANY */
 #else
         return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_REUSEPORT:
+#ifdef SO_REUSEPORT
+        if (on != apr_is_option_set(sock, APR_SO_REUSEPORT)) {
+            if (setsockopt(sock->socketdes, SOL_SOCKET, SO_REUSEPORT, (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_REUSEPORT, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_ZEROCOPY:
+#ifdef HAVE_SOCKET_ZEROCOPY
+        if (on != apr_is_option_set(sock, APR_SO_ZEROCOPY)) {
+            if (setsockopt(sock->socketdes, SOL_SOCKET, SO_ZEROCOPY,
+                           (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_ZEROCOPY, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_SYSTIMEOUT:
+#ifdef HAVE_SYSTIMEOUT
+        if (on != apr_is_option_set(sock, APR_SO_SYSTIMEOUT)) {
+            apr_interval_time_t t = sock->timeout;
+
+            /* Switch the current timeout to the other mode */
+            if (t > 0) {
+                rv = sotimeout(sock->socketdes, on ? t : 0);
+                if (rv != APR_SUCCESS) {
+                    return rv;
+                }
+            }
+            rv = nonblock_set(sock, on ? t == 0 : t >= 0);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            sock->options &= ~(APR_INCOMPLETE_READ | APR_INCOMPLETE_WRITE);
+            apr_set_option(sock, APR_SO_SYSTIMEOUT, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_UDP_GRO:
+#ifdef UDP_GRO
+        if (on != apr_is_option_set(sock, APR_SO_UDP_GRO)) {
+            if (setsockopt(sock->socketdes, IPPROTO_UDP, UDP_GRO,
+                           (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_UDP_GRO, on);
+        }
+#else
+        return APR_ENOTIMPL;
 #endif
         break;
     default:
@@ -127,6 +127,26 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_sendv_zerocopy(apr_socket_t *sock,
+                                                    const struct iovec *vec,
+                                                    apr_int32_t nvec,
+                                                    apr_size_t *len,
+                                                    apr_uint32_t *id)
+{
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_zerocopy_reap(apr_socket_t *sock,
+                                                   apr_uint32_t *lo,
+                                                   apr_uint32_t *hi,
+                                                   int *copied)
+{
+    return APR_ENOTIMPL;
+}
+
+
 APR_DECLARE(apr_status_t) apr_socket_sendto(apr_socket_t *sock,
                                             apr_sockaddr_t *where,
                                             apr_int32_t flags, const char *buf, 
@@ -174,6 +194,94 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
 }
 
 
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_int32_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_int32_t *nsent)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_int32_t i;
+
+    *nsent = 0;
+    if (nmsgs < 0) {
+        return APR_EINVAL;
+    }
+    for (i = 0; i < nmsgs; i++) {
+        if (msgs[i].segment > 65535) {
+            return APR_EINVAL;
+        }
+    }
+
+    /* No batching nor segmentation offload, one datagram at a time */
+    for (i = 0; i < nmsgs; i++) {
+        apr_socket_msg_t *msg = &msgs[i];
+        apr_size_t off = 0, len;
+
+        do {
+            len = msg->len - off;
+            if (msg->segment && len > msg->segment) {
+                len = msg->segment;
+            }
+            if (msg->addr) {
+                rv = apr_socket_sendto(sock, msg->addr, flags,
+                                       msg->buf + off, &len);
+            }
+            else {
+                rv = apr_socket_send(sock, msg->buf + off, &len);
+            }
+            off += len;
+        } while (rv == APR_SUCCESS && off < msg->len);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        msg->len = off;
+    }
+
+    *nsent = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_int32_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_int32_t *nrecv)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_int32_t i;
+
+    *nrecv = 0;
+    if (nmsgs < 0) {
+        return APR_EINVAL;
+    }
+
+    for (i = 0; i < nmsgs; i++) {
+        apr_socket_msg_t *msg = &msgs[i];
+        apr_sockaddr_t sa, *from = msg->addr ? msg->addr : &sa;
+
+        if (i > 0) {
+            /* Only pick up the datagrams already there */
+            u_long avail = 0;
+
+            if (ioctlsocket(sock->socketdes, FIONREAD, &avail) == SOCKET_ERROR
+                    || !avail) {
+                break;
+            }
+        }
+        msg->segment = 0;
+        rv = apr_socket_recvfrom(from, sock, flags, msg->buf, &msg->len);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    *nrecv = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+
 #if APR_HAS_SENDFILE
 static apr_status_t collapse_iovec(char **off, apr_size_t *len, 
                                    struct iovec *iovec, int numvec, 
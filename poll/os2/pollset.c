@@ -168,6 +168,24 @@ APR_DECLARE(apr_status_t) apr_pollset_remove(apr_pollset_t *pollset,
 
 
 
+APR_DECLARE(apr_status_t) apr_pollset_rearm(apr_pollset_t *pollset,
+                                            const apr_pollfd_t *descriptor)
+{
+    apr_uint32_t i;
+
+    for (i = 0; i < pollset->nelts; i++) {
+        if (descriptor->desc.s == pollset->query_set[i].desc.s) {
+            pollset->query_set[i] = *descriptor;
+            pollset->num_read = -1;
+            return APR_SUCCESS;
+        }
+    }
+
+    return APR_NOTFOUND;
+}
+
+
+
 static void make_pollset(apr_pollset_t *pollset)
 {
     int i;
@@ -293,6 +311,36 @@ APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
 
 
 
+APR_DECLARE(apr_status_t) apr_pollset_poll_ex(apr_pollset_t *pollset,
+                                              apr_interval_time_t timeout,
+                                              apr_pollfd_t *descriptors,
+                                              apr_int32_t max,
+                                              apr_int32_t *num)
+{
+    const apr_pollfd_t *result;
+    apr_status_t rc;
+    apr_int32_t i;
+
+    *num = 0;
+    if (max <= 0) {
+        return APR_EINVAL;
+    }
+
+    rc = apr_pollset_poll(pollset, timeout, num, &result);
+
+    /* Level triggered, the ones not returned will be signalled again */
+    if (*num > max) {
+        *num = max;
+    }
+    for (i = 0; i < *num; i++) {
+        descriptors[i] = result[i];
+    }
+
+    return rc;
+}
+
+
+
 APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset)
 {
     if (!pollset->wake_sender)
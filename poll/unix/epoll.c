@@ -39,6 +39,10 @@ static unsigned get_epoll_event(apr_int16_t event)
     if (event & APR_POLLEXCL)
         rv |= EPOLLEXCLUSIVE;
 #endif
+    if (event & APR_POLLET)
+        rv |= EPOLLET;
+    if (event & APR_POLLONESHOT)
+        rv |= EPOLLONESHOT;
     /* APR_POLLNVAL is not handled by epoll.  EPOLLERR and EPOLLHUP are return-only */
 
     return rv;
@@ -63,6 +67,35 @@ static apr_int16_t get_epoll_revent(unsigned event)
     return rv;
 }
 
+/* Waits with a microsecond resolution timeout if possible */
+static int epoll_wait_us(int fd, struct epoll_event *events, int maxevents,
+                         apr_interval_time_t timeout)
+{
+#ifdef HAVE_EPOLL_PWAIT2
+    static int pwait2_enosys = 0;
+
+    if (timeout > 0 && !pwait2_enosys) {
+        struct timespec ts;
+        int ret;
+
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000;
+        ret = epoll_pwait2(fd, events, maxevents, &ts, NULL);
+        if (ret >= 0 || errno != ENOSYS) {
+            return ret;
+        }
+        /* Not supported by this kernel (before Linux 5.11) */
+        pwait2_enosys = 1;
+    }
+#endif
+
+    if (timeout > 0) {
+        timeout = (timeout + 999) / 1000;
+    }
+
+    return epoll_wait(fd, events, maxevents, timeout);
+}
+
 struct apr_pollset_private_t
 {
     int epoll_fd;
@@ -79,8 +112,33 @@ struct apr_pollset_private_t
     /* A ring of pollfd_t where rings that have been _remove()`ed but
         might still be inside a _poll() */
     APR_RING_HEAD(pfd_dead_ring_t, pfd_elem_t) dead_ring;
+    /* The pfd_elem_t of the query ring by native descriptor */
+    pfd_elem_map_t elem_map;
 };
 
+/* Must be called with the rings locked */
+static pfd_elem_t *find_elem(apr_pollset_t *pollset, int fd,
+                             const apr_pollfd_t *descriptor)
+{
+    pfd_elem_t *ep;
+
+    ep = apr_pollset_elem_map_get(&pollset->p->elem_map, fd, descriptor);
+    if (ep || fd >= 0) {
+        return ep;
+    }
+
+    /* A descriptor closed while in the pollset can't be mapped anymore */
+    for (ep = APR_RING_FIRST(&(pollset->p->query_ring));
+         ep != APR_RING_SENTINEL(&(pollset->p->query_ring),
+                                 pfd_elem_t, link);
+         ep = APR_RING_NEXT(ep, link)) {
+        if (descriptor->desc.s == ep->pfd.desc.s) {
+            return ep;
+        }
+    }
+    return NULL;
+}
+
 static apr_status_t impl_pollset_cleanup(apr_pollset_t *pollset)
 {
     close(pollset->p->epoll_fd);
@@ -161,10 +219,17 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
                                      const apr_pollfd_t *descriptor)
 {
     struct epoll_event ev = {0};
-    int ret;
+    int fd, ret;
     pfd_elem_t *elem = NULL;
     apr_status_t rv = APR_SUCCESS;
 
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        fd = descriptor->desc.s->socketdes;
+    }
+    else {
+        fd = descriptor->desc.f->filedes;
+    }
+
     ev.events = get_epoll_event(descriptor->reqevents);
 
     if (pollset->flags & APR_POLLSET_NOCOPY) {
@@ -184,15 +249,8 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
         elem->pfd = *descriptor;
         ev.data.ptr = elem;
     }
-    if (descriptor->desc_type == APR_POLL_SOCKET) {
-        ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_ADD,
-                        descriptor->desc.s->socketdes, &ev);
-    }
-    else {
-        ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_ADD,
-                        descriptor->desc.f->filedes, &ev);
-    }
 
+    ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
     if (0 != ret) {
         rv = apr_get_netos_error();
     }
@@ -203,6 +261,8 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
         }
         else {
             APR_RING_INSERT_TAIL(&(pollset->p->query_ring), elem, pfd_elem_t, link);
+            apr_pollset_elem_map_set(&pollset->p->elem_map, fd, elem,
+                                     pollset->pool);
         }
         pollset_unlock_rings();
     }
@@ -218,16 +278,16 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
     struct epoll_event ev = {0}; /* ignored, but must be passed with
                                   * kernel < 2.6.9
                                   */
-    int ret;
+    int fd, ret;
 
     if (descriptor->desc_type == APR_POLL_SOCKET) {
-        ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_DEL,
-                        descriptor->desc.s->socketdes, &ev);
+        fd = descriptor->desc.s->socketdes;
     }
     else {
-        ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_DEL,
-                        descriptor->desc.f->filedes, &ev);
+        fd = descriptor->desc.f->filedes;
     }
+
+    ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_DEL, fd, &ev);
     if (ret < 0) {
         rv = APR_NOTFOUND;
     }
@@ -235,17 +295,12 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
     if (!(pollset->flags & APR_POLLSET_NOCOPY)) {
         pollset_lock_rings();
 
-        for (ep = APR_RING_FIRST(&(pollset->p->query_ring));
-             ep != APR_RING_SENTINEL(&(pollset->p->query_ring),
-                                     pfd_elem_t, link);
-             ep = APR_RING_NEXT(ep, link)) {
-                
-            if (descriptor->desc.s == ep->pfd.desc.s) {
-                APR_RING_REMOVE(ep, link);
-                APR_RING_INSERT_TAIL(&(pollset->p->dead_ring),
-                                     ep, pfd_elem_t, link);
-                break;
-            }
+        ep = find_elem(pollset, fd, descriptor);
+        if (ep) {
+            apr_pollset_elem_map_unset(&pollset->p->elem_map, ep);
+            APR_RING_REMOVE(ep, link);
+            APR_RING_INSERT_TAIL(&(pollset->p->dead_ring),
+                                 ep, pfd_elem_t, link);
         }
 
         pollset_unlock_rings();
@@ -254,22 +309,70 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
     return rv;
 }
 
-static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
-                                           apr_interval_time_t timeout,
-                                           apr_int32_t *num,
-                                           const apr_pollfd_t **descriptors)
+static apr_status_t impl_pollset_rearm(apr_pollset_t *pollset,
+                                       const apr_pollfd_t *descriptor)
+{
+    struct epoll_event ev = {0};
+    pfd_elem_t *ep = NULL;
+    apr_status_t rv = APR_SUCCESS;
+    int fd, ret;
+
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        fd = descriptor->desc.s->socketdes;
+    }
+    else {
+        fd = descriptor->desc.f->filedes;
+    }
+
+    /* EPOLLEXCLUSIVE can't be used with EPOLL_CTL_MOD */
+    ev.events = get_epoll_event(descriptor->reqevents & ~APR_POLLEXCL);
+
+    if (pollset->flags & APR_POLLSET_NOCOPY) {
+        ev.data.ptr = (void *)descriptor;
+    }
+    else {
+        pollset_lock_rings();
+
+        ep = find_elem(pollset, fd, descriptor);
+        if (!ep) {
+            pollset_unlock_rings();
+            return APR_NOTFOUND;
+        }
+        ev.data.ptr = ep;
+    }
+
+    ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    if (ret < 0) {
+        rv = (errno == ENOENT) ? APR_NOTFOUND : apr_get_netos_error();
+    }
+
+    if (!(pollset->flags & APR_POLLSET_NOCOPY)) {
+        if (rv == APR_SUCCESS) {
+            ep->pfd = *descriptor;
+        }
+        pollset_unlock_rings();
+    }
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_poll_ex(apr_pollset_t *pollset,
+                                         apr_interval_time_t timeout,
+                                         apr_pollfd_t *descriptors,
+                                         apr_int32_t max,
+                                         apr_int32_t *num)
 {
     int ret;
     apr_status_t rv = APR_SUCCESS;
 
     *num = 0;
 
-    if (timeout > 0) {
-        timeout = (timeout + 999) / 1000;
+    if (max > (apr_int32_t)pollset->nalloc) {
+        max = pollset->nalloc;
     }
 
-    ret = epoll_wait(pollset->p->epoll_fd, pollset->p->pollset, pollset->nalloc,
-                     timeout);
+    ret = epoll_wait_us(pollset->p->epoll_fd, pollset->p->pollset, max,
+                        timeout);
     if (ret < 0) {
         rv = apr_get_netos_error();
     }
@@ -297,18 +400,14 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
                 rv = APR_EINTR;
             }
             else {
-                pollset->p->result_set[j] = *fdptr;
-                pollset->p->result_set[j].rtnevents =
+                descriptors[j] = *fdptr;
+                descriptors[j].rtnevents =
                     get_epoll_revent(pollset->p->pollset[i].events);
                 j++;
             }
         }
         if (((*num) = j)) { /* any event besides wakeup pipe? */
             rv = APR_SUCCESS;
-
-            if (descriptors) {
-                *descriptors = pollset->p->result_set;
-            }
         }
     }
 
@@ -324,11 +423,29 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
     return rv;
 }
 
+static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
+                                      apr_interval_time_t timeout,
+                                      apr_int32_t *num,
+                                      const apr_pollfd_t **descriptors)
+{
+    apr_status_t rv;
+
+    rv = impl_pollset_poll_ex(pollset, timeout, pollset->p->result_set,
+                              pollset->nalloc, num);
+    if (*num && descriptors) {
+        *descriptors = pollset->p->result_set;
+    }
+
+    return rv;
+}
+
 static const apr_pollset_provider_t impl = {
     impl_pollset_create,
     impl_pollset_add,
     impl_pollset_remove,
+    impl_pollset_rearm,
     impl_pollset_poll,
+    impl_pollset_poll_ex,
     impl_pollset_cleanup,
     "epoll"
 };
@@ -437,6 +554,32 @@ static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
 }
 
 
+static apr_status_t impl_pollcb_rearm(apr_pollcb_t *pollcb,
+                                      apr_pollfd_t *descriptor)
+{
+    struct epoll_event ev = { 0 };
+    int ret;
+
+    /* EPOLLEXCLUSIVE can't be used with EPOLL_CTL_MOD */
+    ev.events = get_epoll_event(descriptor->reqevents & ~APR_POLLEXCL);
+    ev.data.ptr = (void *) descriptor;
+
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        ret = epoll_ctl(pollcb->fd, EPOLL_CTL_MOD,
+                        descriptor->desc.s->socketdes, &ev);
+    }
+    else {
+        ret = epoll_ctl(pollcb->fd, EPOLL_CTL_MOD,
+                        descriptor->desc.f->filedes, &ev);
+    }
+
+    if (ret == -1) {
+        return (errno == ENOENT) ? APR_NOTFOUND : apr_get_netos_error();
+    }
+
+    return APR_SUCCESS;
+}
+
 static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
                                      apr_interval_time_t timeout,
                                      apr_pollcb_cb_t func,
@@ -445,12 +588,8 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
     int ret, i;
     apr_status_t rv = APR_SUCCESS;
     
-    if (timeout > 0) {
-        timeout = (timeout + 999) / 1000;
-    }
-    
-    ret = epoll_wait(pollcb->fd, pollcb->pollset.epoll, pollcb->nalloc,
-                     timeout);
+    ret = epoll_wait_us(pollcb->fd, pollcb->pollset.epoll, pollcb->nalloc,
+                        timeout);
     if (ret < 0) {
         rv = apr_get_netos_error();
     }
@@ -484,6 +623,7 @@ static const apr_pollcb_provider_t impl_cb = {
     impl_pollcb_create,
     impl_pollcb_add,
     impl_pollcb_remove,
+    impl_pollcb_rearm,
     impl_pollcb_poll,
     impl_pollcb_cleanup,
     "epoll"
@@ -0,0 +1,922 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_poll.h"
+#include "apr_time.h"
+#include "apr_portable.h"
+#include "apr_arch_file_io.h"
+#include "apr_arch_networkio.h"
+#include "apr_arch_poll_private.h"
+#include "apr_arch_inherit.h"
+
+#if defined(HAVE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Each descriptor has at most one poll request in the kernel, single-shot
+ * for level-triggered (re-armed once signalled) and APR_POLLONESHOT
+ * descriptors, or multishot for APR_POLLET ones.  Adding, removing or
+ * re-arming descriptors only queues requests in the submission ring, they
+ * are submitted along with the wait for completions by the next poll (or
+ * immediately for a APR_POLLSET_THREADSAFE pollset).
+ */
+
+/* The poll request of the element is in the kernel (or queued) */
+#define IOURING_INFLIGHT 0x1
+/* The element has been removed, but its poll request is still in flight */
+#define IOURING_REMOVED  0x2
+
+/* Multishot poll requests come with IORING_FEAT_RSRC_TAGS (Linux 5.13) */
+#define IOURING_FEATURES (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | \
+                          IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS)
+
+#define ring_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ring_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+struct apr_iouring_t
+{
+    int fd;
+    apr_uint32_t flags;
+    /* The submission and completion rings, mapped once */
+    void *ring_ptr;
+    size_t ring_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    /* The number of requests queued but not submitted yet */
+    unsigned to_submit;
+    /* The number of removed elements with a poll request in flight */
+    unsigned zombies;
+#if APR_HAS_THREADS
+    /* A thread mutex to protect operations on the rings */
+    apr_thread_mutex_t *ring_lock;
+#endif
+    /* A ring containing all of the pfd_elem_t that are active */
+    APR_RING_HEAD(pfd_query_ring_t, pfd_elem_t) query_ring;
+    /* A ring of pfd_elem_t that have been used, and then _remove()'d */
+    APR_RING_HEAD(pfd_free_ring_t, pfd_elem_t) free_ring;
+    /* A ring of pfd_elem_t that have been _remove()'d but might still
+     * be inside a _poll()
+     */
+    APR_RING_HEAD(pfd_dead_ring_t, pfd_elem_t) dead_ring;
+    /* The pfd_elem_t of the query ring by native descriptor */
+    pfd_elem_map_t elem_map;
+};
+
+typedef struct apr_iouring_t apr_iouring_t;
+
+#if APR_HAS_THREADS
+#define iouring_lock(ring) \
+    if ((ring)->ring_lock) \
+        apr_thread_mutex_lock((ring)->ring_lock);
+#define iouring_unlock(ring) \
+    if ((ring)->ring_lock) \
+        apr_thread_mutex_unlock((ring)->ring_lock);
+#else
+#define iouring_lock(ring)
+#define iouring_unlock(ring)
+#endif
+
+static apr_uint32_t get_iouring_event(apr_int16_t event)
+{
+    apr_uint32_t rv = 0;
+
+    if (event & APR_POLLIN)
+        rv |= POLLIN;
+    if (event & APR_POLLPRI)
+        rv |= POLLPRI;
+    if (event & APR_POLLOUT)
+        rv |= POLLOUT;
+    /* POLLERR, POLLHUP, and POLLNVAL aren't valid as requested events */
+
+#if APR_IS_BIGENDIAN
+    /* The kernel expects the 32 bits events to be word-reversed */
+    rv = (rv << 16) | (rv >> 16);
+#endif
+    return rv;
+}
+
+static apr_int16_t get_iouring_revent(apr_uint32_t event)
+{
+    apr_int16_t rv = 0;
+
+    if (event & POLLIN)
+        rv |= APR_POLLIN;
+    if (event & POLLPRI)
+        rv |= APR_POLLPRI;
+    if (event & POLLOUT)
+        rv |= APR_POLLOUT;
+    if (event & POLLERR)
+        rv |= APR_POLLERR;
+    if (event & POLLHUP)
+        rv |= APR_POLLHUP;
+    if (event & POLLNVAL)
+        rv |= APR_POLLNVAL;
+
+    return rv;
+}
+
+static int get_iouring_fd(const apr_pollfd_t *descriptor)
+{
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        return descriptor->desc.s->socketdes;
+    }
+    return descriptor->desc.f->filedes;
+}
+
+static apr_status_t iouring_enter(apr_iouring_t *ring, unsigned to_submit,
+                                  unsigned min_complete,
+                                  apr_interval_time_t timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    void *argp = NULL;
+    size_t argsz = 0;
+    int ret;
+
+    if (min_complete) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout > 0) {
+            memset(&arg, 0, sizeof(arg));
+            ts.tv_sec = apr_time_sec(timeout);
+            ts.tv_nsec = apr_time_usec(timeout) * 1000;
+            arg.ts = (apr_uint64_t)(apr_uintptr_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+
+    ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+                  flags, argp, argsz);
+    if (ret < 0) {
+        if (errno == ETIME) {
+            return APR_TIMEUP;
+        }
+        return apr_get_netos_error();
+    }
+    if (to_submit) {
+        ring->to_submit -= ret;
+    }
+
+    return APR_SUCCESS;
+}
+
+/* Must be called with the rings locked */
+static apr_status_t iouring_get_sqe(apr_iouring_t *ring,
+                                    struct io_uring_sqe **sqe)
+{
+    unsigned tail = *ring->sq_tail;
+
+    if (tail - ring_load_acquire(ring->sq_head) >= ring->sq_entries) {
+        /* Full, submit what's queued so far */
+        apr_status_t rv = iouring_enter(ring, ring->to_submit, 0, 0);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (tail - ring_load_acquire(ring->sq_head) >= ring->sq_entries) {
+            return APR_EAGAIN;
+        }
+    }
+
+    *sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(*sqe, 0, sizeof(**sqe));
+    return APR_SUCCESS;
+}
+
+static void iouring_commit_sqe(apr_iouring_t *ring)
+{
+    ring_store_release(ring->sq_tail, *ring->sq_tail + 1);
+    ring->to_submit++;
+}
+
+/* Must be called with the rings locked */
+static apr_status_t iouring_poll_add(apr_iouring_t *ring, pfd_elem_t *elem)
+{
+    struct io_uring_sqe *sqe;
+    apr_status_t rv;
+
+    rv = iouring_get_sqe(ring, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = elem->map_fd;
+    sqe->poll32_events = get_iouring_event(elem->pfd.reqevents);
+    if ((elem->pfd.reqevents & APR_POLLET)
+            && !(elem->pfd.reqevents & APR_POLLONESHOT)) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = (apr_uint64_t)(apr_uintptr_t)elem;
+    iouring_commit_sqe(ring);
+
+    elem->iouring_state |= IOURING_INFLIGHT;
+    return APR_SUCCESS;
+}
+
+/* Must be called with the rings locked */
+static apr_status_t iouring_poll_remove(apr_iouring_t *ring, pfd_elem_t *elem)
+{
+    struct io_uring_sqe *sqe;
+    apr_status_t rv;
+
+    rv = iouring_get_sqe(ring, &sqe);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* The completion of the removal itself is ignored (no user_data),
+     * the element will be freed on the completion of its poll request.
+     */
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (apr_uint64_t)(apr_uintptr_t)elem;
+    iouring_commit_sqe(ring);
+
+    return APR_SUCCESS;
+}
+
+/* Must be called with the rings locked */
+static pfd_elem_t *iouring_find(apr_iouring_t *ring, int fd,
+                                const apr_pollfd_t *descriptor)
+{
+    pfd_elem_t *ep;
+
+    ep = apr_pollset_elem_map_get(&ring->elem_map, fd, descriptor);
+    if (ep || fd >= 0) {
+        return ep;
+    }
+
+    /* A descriptor closed while in the pollset can't be mapped anymore */
+    for (ep = APR_RING_FIRST(&(ring->query_ring));
+         ep != APR_RING_SENTINEL(&(ring->query_ring), pfd_elem_t, link);
+         ep = APR_RING_NEXT(ep, link)) {
+        if (descriptor->desc.s == ep->pfd.desc.s) {
+            return ep;
+        }
+    }
+    return NULL;
+}
+
+/* Must be called with the rings locked */
+static apr_status_t iouring_add_elem(apr_iouring_t *ring, int fd,
+                                     const apr_pollfd_t *descriptor,
+                                     apr_pollfd_t *cb_descriptor,
+                                     apr_pool_t *p)
+{
+    pfd_elem_t *elem;
+    apr_status_t rv;
+
+    if (!APR_RING_EMPTY(&(ring->free_ring), pfd_elem_t, link)) {
+        elem = APR_RING_FIRST(&(ring->free_ring));
+        APR_RING_REMOVE(elem, link);
+    }
+    else {
+        elem = (pfd_elem_t *) apr_palloc(p, sizeof(pfd_elem_t));
+        APR_RING_ELEM_INIT(elem, link);
+    }
+    elem->pfd = *descriptor;
+    elem->descriptor = cb_descriptor;
+    elem->map_fd = fd;
+    elem->iouring_state = 0;
+
+    rv = iouring_poll_add(ring, elem);
+    if (rv != APR_SUCCESS) {
+        APR_RING_INSERT_TAIL(&(ring->free_ring), elem, pfd_elem_t, link);
+        return rv;
+    }
+
+    APR_RING_INSERT_TAIL(&(ring->query_ring), elem, pfd_elem_t, link);
+    apr_pollset_elem_map_set(&ring->elem_map, fd, elem, p);
+
+    return APR_SUCCESS;
+}
+
+/* Must be called with the rings locked */
+static apr_status_t iouring_remove_elem(apr_iouring_t *ring, pfd_elem_t *ep)
+{
+    apr_pollset_elem_map_unset(&ring->elem_map, ep);
+    APR_RING_REMOVE(ep, link);
+    ep->iouring_state |= IOURING_REMOVED;
+
+    if (ep->iouring_state & IOURING_INFLIGHT) {
+        /* Not on any ring until the kernel is done with it */
+        APR_RING_ELEM_INIT(ep, link);
+        ring->zombies++;
+        return iouring_poll_remove(ring, ep);
+    }
+
+    APR_RING_INSERT_TAIL(&(ring->dead_ring), ep, pfd_elem_t, link);
+    return APR_SUCCESS;
+}
+
+static apr_status_t iouring_add(apr_iouring_t *ring,
+                                const apr_pollfd_t *descriptor,
+                                apr_pollfd_t *cb_descriptor,
+                                apr_pool_t *p)
+{
+    int fd = get_iouring_fd(descriptor);
+    apr_status_t rv;
+
+    if (fd < 0) {
+        return APR_EBADF;
+    }
+
+    iouring_lock(ring);
+
+    if (iouring_find(ring, fd, descriptor)) {
+        rv = APR_EEXIST;
+    }
+    else {
+        rv = iouring_add_elem(ring, fd, descriptor, cb_descriptor, p);
+        if (rv == APR_SUCCESS && (ring->flags & APR_POLLSET_THREADSAFE)) {
+            rv = iouring_enter(ring, ring->to_submit, 0, 0);
+        }
+    }
+
+    iouring_unlock(ring);
+
+    return rv;
+}
+
+static apr_status_t iouring_remove(apr_iouring_t *ring,
+                                   const apr_pollfd_t *descriptor)
+{
+    pfd_elem_t *ep;
+    apr_status_t rv;
+
+    iouring_lock(ring);
+
+    ep = iouring_find(ring, get_iouring_fd(descriptor), descriptor);
+    if (!ep) {
+        rv = APR_NOTFOUND;
+    }
+    else {
+        rv = iouring_remove_elem(ring, ep);
+        if (rv == APR_SUCCESS && ring->to_submit
+                && (ring->flags & APR_POLLSET_THREADSAFE)) {
+            rv = iouring_enter(ring, ring->to_submit, 0, 0);
+        }
+    }
+
+    iouring_unlock(ring);
+
+    return rv;
+}
+
+static apr_status_t iouring_rearm(apr_iouring_t *ring,
+                                  const apr_pollfd_t *descriptor,
+                                  apr_pollfd_t *cb_descriptor,
+                                  apr_pool_t *p)
+{
+    int fd = get_iouring_fd(descriptor);
+    pfd_elem_t *ep;
+    apr_status_t rv;
+
+    iouring_lock(ring);
+
+    ep = iouring_find(ring, fd, descriptor);
+    if (!ep) {
+        rv = APR_NOTFOUND;
+    }
+    else if (ep->iouring_state & IOURING_INFLIGHT) {
+        /* Replace the pending poll request */
+        rv = iouring_remove_elem(ring, ep);
+        if (rv == APR_SUCCESS) {
+            rv = iouring_add_elem(ring, fd, descriptor, cb_descriptor, p);
+        }
+    }
+    else {
+        ep->pfd = *descriptor;
+        ep->descriptor = cb_descriptor;
+        rv = iouring_poll_add(ring, ep);
+    }
+    if (rv == APR_SUCCESS && (ring->flags & APR_POLLSET_THREADSAFE)) {
+        rv = iouring_enter(ring, ring->to_submit, 0, 0);
+    }
+
+    iouring_unlock(ring);
+
+    return rv;
+}
+
+/* Submits the queued requests and waits for completions, with the rings
+ * locked on entry and on return.
+ */
+static apr_status_t iouring_wait(apr_iouring_t *ring,
+                                 apr_interval_time_t timeout)
+{
+    unsigned min_complete = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (timeout != 0 &&
+            *ring->cq_head == ring_load_acquire(ring->cq_tail)) {
+        min_complete = 1;
+    }
+
+    if (!(ring->flags & APR_POLLSET_THREADSAFE)) {
+        return iouring_enter(ring, ring->to_submit, min_complete, timeout);
+    }
+
+    /* Don't block the other threads while waiting */
+    if (ring->to_submit) {
+        rv = iouring_enter(ring, ring->to_submit, 0, 0);
+    }
+    if (rv == APR_SUCCESS && min_complete) {
+        iouring_unlock(ring);
+        rv = iouring_enter(ring, 0, min_complete, timeout);
+        iouring_lock(ring);
+    }
+
+    return rv;
+}
+
+/* Handles the completion of an element's poll request, with the rings
+ * locked.  Returns the signalled element, or NULL if there is nothing
+ * to report.
+ */
+static pfd_elem_t *iouring_complete(apr_iouring_t *ring,
+                                    const struct io_uring_cqe *cqe)
+{
+    pfd_elem_t *ep = (pfd_elem_t *)(apr_uintptr_t)cqe->user_data;
+
+    if (!ep) {
+        /* The completion of a removal */
+        return NULL;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        ep->iouring_state &= ~IOURING_INFLIGHT;
+    }
+
+    if (ep->iouring_state & IOURING_REMOVED) {
+        if (!(ep->iouring_state & IOURING_INFLIGHT)) {
+            APR_RING_INSERT_TAIL(&(ring->dead_ring), ep, pfd_elem_t, link);
+            ring->zombies--;
+        }
+        return NULL;
+    }
+
+    if (cqe->res == -ECANCELED) {
+        ep->pfd.rtnevents = 0;
+    }
+    else if (cqe->res < 0) {
+        ep->pfd.rtnevents = (cqe->res == -EBADF) ? APR_POLLNVAL : APR_POLLERR;
+    }
+    else {
+        ep->pfd.rtnevents = get_iouring_revent(cqe->res);
+    }
+
+    return ep;
+}
+
+/* Re-arms a level-triggered (or terminated multishot) element once
+ * signalled, with the rings locked.
+ */
+static void iouring_rearm_signalled(apr_iouring_t *ring, pfd_elem_t *ep)
+{
+    if (!(ep->iouring_state & (IOURING_INFLIGHT | IOURING_REMOVED))
+            && !(ep->pfd.reqevents & APR_POLLONESHOT)) {
+        iouring_poll_add(ring, ep);
+    }
+}
+
+static apr_status_t iouring_cleanup(apr_iouring_t *ring)
+{
+    if (ring->sqes && ring->ring_ptr) {
+        pfd_elem_t *ep;
+
+        /* Cancel the pending poll requests now, rather than letting the
+         * kernel do it asynchronously (and interrupt the thread) on close.
+         */
+        iouring_lock(ring);
+        while (!APR_RING_EMPTY(&(ring->query_ring), pfd_elem_t, link)) {
+            ep = APR_RING_FIRST(&(ring->query_ring));
+            if (iouring_remove_elem(ring, ep) != APR_SUCCESS) {
+                break;
+            }
+        }
+        if (ring->to_submit) {
+            iouring_enter(ring, ring->to_submit, 0, 0);
+        }
+
+        /* Reap the cancellations too, the kernel's teardown of the ring
+         * would otherwise have to wait for them (by periods of 50ms).
+         */
+        while (ring->zombies) {
+            unsigned head = *ring->cq_head;
+            unsigned tail = ring_load_acquire(ring->cq_tail);
+
+            if (head == tail) {
+                if (iouring_enter(ring, 0, 1, apr_time_from_msec(100))
+                        != APR_SUCCESS) {
+                    break;
+                }
+                continue;
+            }
+            for (; head != tail; head++) {
+                iouring_complete(ring, &ring->cqes[head & ring->cq_mask]);
+            }
+            ring_store_release(ring->cq_head, head);
+        }
+        iouring_unlock(ring);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->ring_ptr) {
+        munmap(ring->ring_ptr, ring->ring_len);
+    }
+    close(ring->fd);
+    return APR_SUCCESS;
+}
+
+static apr_status_t iouring_create(apr_iouring_t *ring, apr_uint32_t size,
+                                   apr_pool_t *p, apr_uint32_t flags)
+{
+    struct io_uring_params params;
+    unsigned *sq_array;
+    unsigned char *ptr;
+    size_t sq_len, cq_len;
+    apr_status_t rv;
+    unsigned i;
+
+#if APR_HAS_THREADS
+    if ((flags & APR_POLLSET_THREADSAFE) &&
+        ((rv = apr_thread_mutex_create(&ring->ring_lock,
+                                       APR_THREAD_MUTEX_DEFAULT,
+                                       p)) != APR_SUCCESS)) {
+        return rv;
+    }
+#else
+    if (flags & APR_POLLSET_THREADSAFE) {
+        return APR_ENOTIMPL;
+    }
+#endif
+
+    /* Room for adding and re-arming all the descriptors in a batch, the
+     * ring is submitted early should it be full anyway.
+     */
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+#ifdef IORING_SETUP_COOP_TASKRUN
+    /* Don't interrupt the other system calls of the thread (Linux 5.19) */
+    params.flags |= IORING_SETUP_COOP_TASKRUN;
+#endif
+    ring->fd = syscall(__NR_io_uring_setup, size < 8 ? 8 : size, &params);
+#ifdef IORING_SETUP_COOP_TASKRUN
+    if (ring->fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CLAMP;
+        ring->fd = syscall(__NR_io_uring_setup, size < 8 ? 8 : size, &params);
+    }
+#endif
+    if (ring->fd < 0) {
+        rv = apr_get_netos_error();
+        if (errno == ENOSYS || errno == EPERM) {
+            /* Not available from this kernel, or disabled */
+            rv = APR_ENOTIMPL;
+        }
+        return rv;
+    }
+
+    if ((params.features & IOURING_FEATURES) != IOURING_FEATURES) {
+        close(ring->fd);
+        return APR_ENOTIMPL;
+    }
+
+    sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_len = params.cq_off.cqes
+             + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_len = (sq_len > cq_len) ? sq_len : cq_len;
+    ring->ring_ptr = mmap(NULL, ring->ring_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd,
+                          IORING_OFF_SQ_RING);
+    if (ring->ring_ptr == MAP_FAILED) {
+        rv = apr_get_netos_error();
+        ring->ring_ptr = NULL;
+        iouring_cleanup(ring);
+        return rv;
+    }
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        rv = apr_get_netos_error();
+        ring->sqes = NULL;
+        iouring_cleanup(ring);
+        return rv;
+    }
+
+    ptr = ring->ring_ptr;
+    ring->sq_head = (unsigned *)(ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(ptr + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(ptr + params.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned *)(ptr + params.sq_off.ring_entries);
+    ring->cq_head = (unsigned *)(ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(ptr + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(ptr + params.cq_off.cqes);
+
+    /* The submission entries are always used in order */
+    sq_array = (unsigned *)(ptr + params.sq_off.array);
+    for (i = 0; i < ring->sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    ring->flags = flags;
+    APR_RING_INIT(&ring->query_ring, pfd_elem_t, link);
+    APR_RING_INIT(&ring->free_ring, pfd_elem_t, link);
+    APR_RING_INIT(&ring->dead_ring, pfd_elem_t, link);
+
+    return APR_SUCCESS;
+}
+
+struct apr_pollset_private_t
+{
+    apr_iouring_t ring;
+    apr_pollfd_t *result_set;
+};
+
+static apr_status_t impl_pollset_cleanup(apr_pollset_t *pollset)
+{
+    return iouring_cleanup(&pollset->p->ring);
+}
+
+static apr_status_t impl_pollset_create(apr_pollset_t *pollset,
+                                        apr_uint32_t size,
+                                        apr_pool_t *p,
+                                        apr_uint32_t flags)
+{
+    apr_status_t rv;
+
+    if (flags & APR_POLLSET_NOCOPY) {
+        pollset->p = NULL;
+        return APR_ENOTIMPL;
+    }
+
+    pollset->p = apr_pcalloc(p, sizeof(apr_pollset_private_t));
+    rv = iouring_create(&pollset->p->ring, size, p, flags);
+    if (rv != APR_SUCCESS) {
+        pollset->p = NULL;
+        return rv;
+    }
+    pollset->p->result_set = apr_palloc(p, size * sizeof(apr_pollfd_t));
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
+                                     const apr_pollfd_t *descriptor)
+{
+    return iouring_add(&pollset->p->ring, descriptor, NULL, pollset->pool);
+}
+
+static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
+                                        const apr_pollfd_t *descriptor)
+{
+    return iouring_remove(&pollset->p->ring, descriptor);
+}
+
+static apr_status_t impl_pollset_rearm(apr_pollset_t *pollset,
+                                       const apr_pollfd_t *descriptor)
+{
+    return iouring_rearm(&pollset->p->ring, descriptor, NULL, pollset->pool);
+}
+
+static apr_status_t impl_pollset_poll_ex(apr_pollset_t *pollset,
+                                         apr_interval_time_t timeout,
+                                         apr_pollfd_t *descriptors,
+                                         apr_int32_t max,
+                                         apr_int32_t *num)
+{
+    apr_iouring_t *ring = &pollset->p->ring;
+    unsigned head, tail;
+    apr_int32_t j = 0;
+    apr_status_t rv;
+
+    *num = 0;
+
+    iouring_lock(ring);
+
+    rv = iouring_wait(ring, timeout);
+    if (rv != APR_SUCCESS && rv != APR_TIMEUP && !APR_STATUS_IS_EINTR(rv)) {
+        iouring_unlock(ring);
+        return rv;
+    }
+
+    head = *ring->cq_head;
+    tail = ring_load_acquire(ring->cq_tail);
+    /* The completions past max are left for the next poll */
+    while (head != tail && j < max) {
+        pfd_elem_t *ep = iouring_complete(ring,
+                                          &ring->cqes[head++ & ring->cq_mask]);
+        if (!ep) {
+            continue;
+        }
+
+        /* Check if the polled descriptor is our
+         * wakeup pipe. In that case do not put it result set.
+         */
+        if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
+            ep->pfd.desc_type == APR_POLL_FILE &&
+            ep->pfd.desc.f == pollset->wakeup_pipe[0]) {
+            apr_poll_drain_wakeup_pipe(&pollset->wakeup_set,
+                                       pollset->wakeup_pipe);
+            rv = APR_EINTR;
+        }
+        else if (ep->pfd.rtnevents) {
+            descriptors[j++] = ep->pfd;
+        }
+        iouring_rearm_signalled(ring, ep);
+    }
+    ring_store_release(ring->cq_head, head);
+
+    /* Shift all PFDs in the Dead Ring to the Free Ring */
+    APR_RING_CONCAT(&(ring->free_ring), &(ring->dead_ring), pfd_elem_t, link);
+
+    iouring_unlock(ring);
+
+    if (((*num) = j)) { /* any event besides wakeup pipe? */
+        rv = APR_SUCCESS;
+    }
+    else if (rv == APR_SUCCESS) {
+        rv = APR_TIMEUP;
+    }
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
+                                      apr_interval_time_t timeout,
+                                      apr_int32_t *num,
+                                      const apr_pollfd_t **descriptors)
+{
+    apr_status_t rv;
+
+    rv = impl_pollset_poll_ex(pollset, timeout, pollset->p->result_set,
+                              pollset->nalloc, num);
+    if (*num && descriptors) {
+        *descriptors = pollset->p->result_set;
+    }
+
+    return rv;
+}
+
+static const apr_pollset_provider_t impl = {
+    impl_pollset_create,
+    impl_pollset_add,
+    impl_pollset_remove,
+    impl_pollset_rearm,
+    impl_pollset_poll,
+    impl_pollset_poll_ex,
+    impl_pollset_cleanup,
+    "io_uring"
+};
+
+const apr_pollset_provider_t *const apr_pollset_provider_iouring = &impl;
+
+static apr_status_t impl_pollcb_cleanup(apr_pollcb_t *pollcb)
+{
+    return iouring_cleanup(pollcb->pollset.iouring);
+}
+
+static apr_status_t impl_pollcb_create(apr_pollcb_t *pollcb,
+                                       apr_uint32_t size,
+                                       apr_pool_t *p,
+                                       apr_uint32_t flags)
+{
+    apr_iouring_t *ring = apr_pcalloc(p, sizeof(apr_iouring_t));
+    apr_status_t rv;
+
+    rv = iouring_create(ring, size, p, flags);
+    if (rv != APR_SUCCESS) {
+        pollcb->fd = -1;
+        return rv;
+    }
+
+    pollcb->fd = ring->fd;
+    pollcb->pollset.iouring = ring;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
+                                    apr_pollfd_t *descriptor)
+{
+    return iouring_add(pollcb->pollset.iouring, descriptor, descriptor,
+                       pollcb->pool);
+}
+
+static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
+                                       apr_pollfd_t *descriptor)
+{
+    return iouring_remove(pollcb->pollset.iouring, descriptor);
+}
+
+static apr_status_t impl_pollcb_rearm(apr_pollcb_t *pollcb,
+                                      apr_pollfd_t *descriptor)
+{
+    return iouring_rearm(pollcb->pollset.iouring, descriptor, descriptor,
+                         pollcb->pool);
+}
+
+static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
+                                     apr_interval_time_t timeout,
+                                     apr_pollcb_cb_t func,
+                                     void *baton)
+{
+    apr_iouring_t *ring = pollcb->pollset.iouring;
+    unsigned head, tail;
+    int signalled = 0;
+    apr_status_t rv = APR_SUCCESS, wait_rv;
+
+    wait_rv = iouring_wait(ring, timeout);
+    if (wait_rv != APR_SUCCESS && wait_rv != APR_TIMEUP
+            && !APR_STATUS_IS_EINTR(wait_rv)) {
+        return wait_rv;
+    }
+
+    head = *ring->cq_head;
+    tail = ring_load_acquire(ring->cq_tail);
+    while (head != tail) {
+        pfd_elem_t *ep = iouring_complete(ring,
+                                          &ring->cqes[head++ & ring->cq_mask]);
+        apr_pollfd_t *pollfd;
+
+        if (!ep) {
+            continue;
+        }
+        pollfd = ep->descriptor;
+
+        if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
+            pollfd->desc_type == APR_POLL_FILE &&
+            pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+            apr_poll_drain_wakeup_pipe(&pollcb->wakeup_set, pollcb->wakeup_pipe);
+            iouring_rearm_signalled(ring, ep);
+            rv = APR_EINTR;
+            break;
+        }
+
+        if (ep->pfd.rtnevents) {
+            signalled = 1;
+            pollfd->rtnevents = ep->pfd.rtnevents;
+
+            /* The callback may remove or re-arm the descriptor, the rest
+             * of the completions are left for the next poll if it fails.
+             */
+            rv = func(baton, pollfd);
+            if (rv) {
+                iouring_rearm_signalled(ring, ep);
+                break;
+            }
+        }
+        iouring_rearm_signalled(ring, ep);
+    }
+    ring_store_release(ring->cq_head, head);
+
+    APR_RING_CONCAT(&(ring->free_ring), &(ring->dead_ring), pfd_elem_t, link);
+
+    if (rv != APR_SUCCESS || signalled) {
+        return rv;
+    }
+    return (wait_rv == APR_SUCCESS) ? APR_TIMEUP : wait_rv;
+}
+
+static const apr_pollcb_provider_t impl_cb = {
+    impl_pollcb_create,
+    impl_pollcb_add,
+    impl_pollcb_remove,
+    impl_pollcb_rearm,
+    impl_pollcb_poll,
+    impl_pollcb_cleanup,
+    "io_uring"
+};
+
+const apr_pollcb_provider_t *const apr_pollcb_provider_iouring = &impl_cb;
+
+#endif /* HAVE_IO_URING */
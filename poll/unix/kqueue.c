@@ -43,6 +43,56 @@ static apr_int16_t get_kqueue_revent(apr_int16_t event, apr_int16_t flags)
     return rv;
 }
 
+static unsigned short get_kqueue_flags(apr_int16_t event)
+{
+    unsigned short rv = 0;
+
+    if (event & APR_POLLET)
+        rv |= EV_CLEAR;
+#ifdef EV_DISPATCH
+    if (event & APR_POLLONESHOT)
+        rv |= EV_DISPATCH;
+#else
+    if (event & APR_POLLONESHOT)
+        rv |= EV_ONESHOT;
+#endif
+    return rv;
+}
+
+/* (Re-)add the filters of the requested events, with EV_ENABLE should they
+ * be disabled by EV_DISPATCH, and delete the others.
+ */
+static apr_status_t kqueue_rearm(int kqueue_fd, apr_os_sock_t fd,
+                                 apr_int16_t reqevents, void *udata)
+{
+    unsigned short flags = EV_ADD | EV_ENABLE | get_kqueue_flags(reqevents);
+    struct kevent ev;
+
+    if (reqevents & APR_POLLIN) {
+        EV_SET(&ev, fd, EVFILT_READ, flags, 0, 0, udata);
+    }
+    else {
+        EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    }
+    if (kevent(kqueue_fd, &ev, 1, NULL, 0, NULL) == -1
+            && (reqevents & APR_POLLIN)) {
+        return apr_get_netos_error();
+    }
+
+    if (reqevents & APR_POLLOUT) {
+        EV_SET(&ev, fd, EVFILT_WRITE, flags, 0, 0, udata);
+    }
+    else {
+        EV_SET(&ev, fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+    }
+    if (kevent(kqueue_fd, &ev, 1, NULL, 0, NULL) == -1
+            && (reqevents & APR_POLLOUT)) {
+        return apr_get_netos_error();
+    }
+
+    return APR_SUCCESS;
+}
+
 struct apr_pollset_private_t
 {
     int kqueue_fd;
@@ -61,8 +111,33 @@ struct apr_pollset_private_t
     /* A ring of pollfd_t where rings that have been _remove'd but
        might still be inside a _poll */
     APR_RING_HEAD(pfd_dead_ring_t, pfd_elem_t) dead_ring;
+    /* The pfd_elem_t of the query ring by native descriptor */
+    pfd_elem_map_t elem_map;
 };
 
+/* Must be called with the rings locked */
+static pfd_elem_t *find_elem(apr_pollset_t *pollset, apr_os_sock_t fd,
+                             const apr_pollfd_t *descriptor)
+{
+    pfd_elem_t *ep;
+
+    ep = apr_pollset_elem_map_get(&pollset->p->elem_map, fd, descriptor);
+    if (ep || fd >= 0) {
+        return ep;
+    }
+
+    /* A descriptor closed while in the pollset can't be mapped anymore */
+    for (ep = APR_RING_FIRST(&(pollset->p->query_ring));
+         ep != APR_RING_SENTINEL(&(pollset->p->query_ring),
+                                 pfd_elem_t, link);
+         ep = APR_RING_NEXT(ep, link)) {
+        if (descriptor->desc.s == ep->pfd.desc.s) {
+            return ep;
+        }
+    }
+    return NULL;
+}
+
 static apr_status_t impl_pollset_cleanup(apr_pollset_t *pollset)
 {
     close(pollset->p->kqueue_fd);
@@ -170,11 +245,13 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
 
     if (descriptor->reqevents & APR_POLLIN) {
         if (pollset->flags & APR_POLLSET_NOCOPY) {
-            EV_SET(&pollset->p->kevent, fd, EVFILT_READ, EV_ADD, 0, 0,
+            EV_SET(&pollset->p->kevent, fd, EVFILT_READ,
+                   EV_ADD | get_kqueue_flags(descriptor->reqevents), 0, 0,
                    (void *)descriptor);
         }
         else {
-            EV_SET(&pollset->p->kevent, fd, EVFILT_READ, EV_ADD, 0, 0,
+            EV_SET(&pollset->p->kevent, fd, EVFILT_READ,
+                   EV_ADD | get_kqueue_flags(descriptor->reqevents), 0, 0,
                    elem);
         }
 
@@ -186,11 +263,13 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
 
     if (descriptor->reqevents & APR_POLLOUT && rv == APR_SUCCESS) {
         if (pollset->flags & APR_POLLSET_NOCOPY) {
-            EV_SET(&pollset->p->kevent, fd, EVFILT_WRITE, EV_ADD, 0, 0,
+            EV_SET(&pollset->p->kevent, fd, EVFILT_WRITE,
+                   EV_ADD | get_kqueue_flags(descriptor->reqevents), 0, 0,
                    (void *)descriptor);
         }
         else {
-            EV_SET(&pollset->p->kevent, fd, EVFILT_WRITE, EV_ADD, 0, 0,
+            EV_SET(&pollset->p->kevent, fd, EVFILT_WRITE,
+                   EV_ADD | get_kqueue_flags(descriptor->reqevents), 0, 0,
                    elem);
         }
 
@@ -203,6 +282,8 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
     if (!(pollset->flags & APR_POLLSET_NOCOPY)) {
         if (rv == APR_SUCCESS) {
             APR_RING_INSERT_TAIL(&(pollset->p->query_ring), elem, pfd_elem_t, link);
+            apr_pollset_elem_map_set(&pollset->p->elem_map, fd, elem,
+                                     pollset->pool);
         }
         else {
             APR_RING_INSERT_TAIL(&(pollset->p->free_ring), elem, pfd_elem_t, link);
@@ -251,17 +332,12 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
 
         pollset_lock_rings();
 
-        for (ep = APR_RING_FIRST(&(pollset->p->query_ring));
-             ep != APR_RING_SENTINEL(&(pollset->p->query_ring),
-                                     pfd_elem_t, link);
-             ep = APR_RING_NEXT(ep, link)) {
-
-            if (descriptor->desc.s == ep->pfd.desc.s) {
-                APR_RING_REMOVE(ep, link);
-                APR_RING_INSERT_TAIL(&(pollset->p->dead_ring),
-                                     ep, pfd_elem_t, link);
-                break;
-            }
+        ep = find_elem(pollset, fd, descriptor);
+        if (ep) {
+            apr_pollset_elem_map_unset(&pollset->p->elem_map, ep);
+            APR_RING_REMOVE(ep, link);
+            APR_RING_INSERT_TAIL(&(pollset->p->dead_ring),
+                                 ep, pfd_elem_t, link);
         }
 
         pollset_unlock_rings();
@@ -270,10 +346,49 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
     return rv;
 }
 
-static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
-                                      apr_interval_time_t timeout,
-                                      apr_int32_t *num,
-                                      const apr_pollfd_t **descriptors)
+static apr_status_t impl_pollset_rearm(apr_pollset_t *pollset,
+                                       const apr_pollfd_t *descriptor)
+{
+    apr_os_sock_t fd;
+    pfd_elem_t *ep;
+    apr_status_t rv;
+
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        fd = descriptor->desc.s->socketdes;
+    }
+    else {
+        fd = descriptor->desc.f->filedes;
+    }
+
+    if (pollset->flags & APR_POLLSET_NOCOPY) {
+        return kqueue_rearm(pollset->p->kqueue_fd, fd, descriptor->reqevents,
+                            (void *)descriptor);
+    }
+
+    pollset_lock_rings();
+
+    ep = find_elem(pollset, fd, descriptor);
+    if (!ep) {
+        rv = APR_NOTFOUND;
+    }
+    else {
+        rv = kqueue_rearm(pollset->p->kqueue_fd, fd, descriptor->reqevents,
+                          ep);
+        if (rv == APR_SUCCESS) {
+            ep->pfd = *descriptor;
+        }
+    }
+
+    pollset_unlock_rings();
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_poll_ex(apr_pollset_t *pollset,
+                                         apr_interval_time_t timeout,
+                                         apr_pollfd_t *descriptors,
+                                         apr_int32_t max,
+                                         apr_int32_t *num)
 {
     int ret;
     struct timespec tv, *tvptr;
@@ -281,6 +396,10 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
 
     *num = 0;
 
+    if (max > (apr_int32_t)pollset->p->setsize) {
+        max = pollset->p->setsize;
+    }
+
     if (timeout < 0) {
         tvptr = NULL;
     }
@@ -291,7 +410,7 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
     }
 
     ret = kevent(pollset->p->kqueue_fd, NULL, 0, pollset->p->ke_set,
-                 pollset->p->setsize, tvptr);
+                 max, tvptr);
     if (ret < 0) {
         rv = apr_get_netos_error();
     }
@@ -317,8 +436,8 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
                 rv = APR_EINTR;
             }
             else {
-                pollset->p->result_set[j] = *fd;
-                pollset->p->result_set[j].rtnevents =
+                descriptors[j] = *fd;
+                descriptors[j].rtnevents =
                         get_kqueue_revent(pollset->p->ke_set[i].filter,
                                           pollset->p->ke_set[i].flags);
                 j++;
@@ -326,9 +445,6 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
         }
         if ((*num = j)) { /* any event besides wakeup pipe? */
             rv = APR_SUCCESS;
-            if (descriptors) {
-                *descriptors = pollset->p->result_set;
-            }
         }
     }
 
@@ -345,11 +461,29 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
     return rv;
 }
 
+static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
+                                      apr_interval_time_t timeout,
+                                      apr_int32_t *num,
+                                      const apr_pollfd_t **descriptors)
+{
+    apr_status_t rv;
+
+    rv = impl_pollset_poll_ex(pollset, timeout, pollset->p->result_set,
+                              pollset->p->setsize, num);
+    if (*num && descriptors) {
+        *descriptors = pollset->p->result_set;
+    }
+
+    return rv;
+}
+
 static const apr_pollset_provider_t impl = {
     impl_pollset_create,
     impl_pollset_add,
     impl_pollset_remove,
+    impl_pollset_rearm,
     impl_pollset_poll,
+    impl_pollset_poll_ex,
     impl_pollset_cleanup,
     "kqueue"
 };
@@ -415,7 +549,9 @@ static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
     }
     
     if (descriptor->reqevents & APR_POLLIN) {
-        EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, descriptor);
+        EV_SET(&ev, fd, EVFILT_READ,
+               EV_ADD | get_kqueue_flags(descriptor->reqevents), 0, 0,
+               descriptor);
         
         if (kevent(pollcb->fd, &ev, 1, NULL, 0, NULL) == -1) {
             rv = apr_get_netos_error();
@@ -423,7 +559,9 @@ static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
     }
     
     if (descriptor->reqevents & APR_POLLOUT && rv == APR_SUCCESS) {
-        EV_SET(&ev, fd, EVFILT_WRITE, EV_ADD, 0, 0, descriptor);
+        EV_SET(&ev, fd, EVFILT_WRITE,
+               EV_ADD | get_kqueue_flags(descriptor->reqevents), 0, 0,
+               descriptor);
         
         if (kevent(pollcb->fd, &ev, 1, NULL, 0, NULL) == -1) {
             rv = apr_get_netos_error();
@@ -467,6 +605,20 @@ static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
     return rv;
 }
 
+static apr_status_t impl_pollcb_rearm(apr_pollcb_t *pollcb,
+                                      apr_pollfd_t *descriptor)
+{
+    apr_os_sock_t fd;
+
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        fd = descriptor->desc.s->socketdes;
+    }
+    else {
+        fd = descriptor->desc.f->filedes;
+    }
+
+    return kqueue_rearm(pollcb->fd, fd, descriptor->reqevents, descriptor);
+}
 
 static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
                                      apr_interval_time_t timeout,
@@ -524,6 +676,7 @@ static const apr_pollcb_provider_t impl_cb = {
     impl_pollcb_create,
     impl_pollcb_add,
     impl_pollcb_remove,
+    impl_pollcb_rearm,
     impl_pollcb_poll,
     impl_pollcb_cleanup,
     "kqueue"
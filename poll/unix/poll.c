@@ -226,10 +226,38 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
     return APR_NOTFOUND;
 }
 
-static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
-                                      apr_interval_time_t timeout,
-                                      apr_int32_t *num,
-                                      const apr_pollfd_t **descriptors)
+static apr_status_t impl_pollset_rearm(apr_pollset_t *pollset,
+                                       const apr_pollfd_t *descriptor)
+{
+    apr_uint32_t i;
+
+    for (i = 0; i < pollset->nelts; i++) {
+        if (descriptor->desc.s == pollset->p->query_set[i].desc.s) {
+            /* Enable it again (if disabled for APR_POLLONESHOT) */
+            if (descriptor->desc_type == APR_POLL_SOCKET) {
+                pollset->p->pollset[i].fd = descriptor->desc.s->socketdes;
+            }
+            else {
+#if APR_FILES_AS_SOCKETS
+                pollset->p->pollset[i].fd = descriptor->desc.f->filedes;
+#else
+                return APR_EBADF;
+#endif
+            }
+            pollset->p->pollset[i].events = get_event(descriptor->reqevents);
+            pollset->p->query_set[i] = *descriptor;
+            return APR_SUCCESS;
+        }
+    }
+
+    return APR_NOTFOUND;
+}
+
+static apr_status_t impl_pollset_poll_ex(apr_pollset_t *pollset,
+                                         apr_interval_time_t timeout,
+                                         apr_pollfd_t *descriptors,
+                                         apr_int32_t max,
+                                         apr_int32_t *num)
 {
     int ret;
     apr_status_t rv = APR_SUCCESS;
@@ -265,7 +293,8 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
     else {
         apr_uint32_t i, j;
 
-        for (i = 0, j = 0; i < pollset->nelts; i++) {
+        /* The descriptors signalled past max are left for the next poll */
+        for (i = 0, j = 0; i < pollset->nelts && j < (apr_uint32_t)max; i++) {
             if (pollset->p->pollset[i].revents != 0) {
                 /* Check if the polled descriptor is our
                  * wakeup pipe. In that case do not put it result set.
@@ -286,10 +315,14 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
                 }
 #endif
                 else {
-                    pollset->p->result_set[j] = pollset->p->query_set[i];
-                    pollset->p->result_set[j].rtnevents =
+                    descriptors[j] = pollset->p->query_set[i];
+                    descriptors[j].rtnevents =
                         get_revent(pollset->p->pollset[i].revents);
                     j++;
+                    /* Negative fds are ignored by poll() */
+                    if (pollset->p->query_set[i].reqevents & APR_POLLONESHOT) {
+                        pollset->p->pollset[i].fd = -1;
+                    }
                 }
             }
         }
@@ -297,6 +330,18 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
             rv = APR_SUCCESS;
         }
     }
+    return rv;
+}
+
+static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
+                                      apr_interval_time_t timeout,
+                                      apr_int32_t *num,
+                                      const apr_pollfd_t **descriptors)
+{
+    apr_status_t rv;
+
+    rv = impl_pollset_poll_ex(pollset, timeout, pollset->p->result_set,
+                              pollset->nalloc, num);
     if (descriptors && (*num))
         *descriptors = pollset->p->result_set;
     return rv;
@@ -306,7 +351,9 @@ static const apr_pollset_provider_t impl = {
     impl_pollset_create,
     impl_pollset_add,
     impl_pollset_remove,
+    impl_pollset_rearm,
     impl_pollset_poll,
+    impl_pollset_poll_ex,
     NULL,
     "poll"
 };
@@ -387,6 +434,33 @@ static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
     return APR_NOTFOUND;
 }
 
+static apr_status_t impl_pollcb_rearm(apr_pollcb_t *pollcb,
+                                      apr_pollfd_t *descriptor)
+{
+    apr_uint32_t i;
+
+    for (i = 0; i < pollcb->nelts; i++) {
+        if (descriptor->desc.s == pollcb->copyset[i]->desc.s) {
+            /* Enable it again (if disabled for APR_POLLONESHOT) */
+            if (descriptor->desc_type == APR_POLL_SOCKET) {
+                pollcb->pollset.ps[i].fd = descriptor->desc.s->socketdes;
+            }
+            else {
+#if APR_FILES_AS_SOCKETS
+                pollcb->pollset.ps[i].fd = descriptor->desc.f->filedes;
+#else
+                return APR_EBADF;
+#endif
+            }
+            pollcb->pollset.ps[i].events = get_event(descriptor->reqevents);
+            pollcb->copyset[i] = descriptor;
+            return APR_SUCCESS;
+        }
+    }
+
+    return APR_NOTFOUND;
+}
+
 static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
                                      apr_interval_time_t timeout,
                                      apr_pollcb_cb_t func,
@@ -442,7 +516,11 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
                     return APR_EINTR;
                 }
 #endif
-                pollfd->rtnevents = get_revent(pollcb->pollset.ps[i].revents);                    
+                pollfd->rtnevents = get_revent(pollcb->pollset.ps[i].revents);
+                /* Negative fds are ignored by poll() */
+                if (pollfd->reqevents & APR_POLLONESHOT) {
+                    pollcb->pollset.ps[i].fd = -1;
+                }
                 rv = func(baton, pollfd);
                 if (rv) {
                     return rv;
@@ -457,6 +535,7 @@ static const apr_pollcb_provider_t impl_cb = {
     impl_pollcb_create,
     impl_pollcb_add,
     impl_pollcb_remove,
+    impl_pollcb_rearm,
     impl_pollcb_poll,
     NULL,
     "poll"
@@ -27,6 +27,7 @@
 #include "apr_arch_file_io.h"
 #include "apr_arch_networkio.h"
 #include "apr_arch_poll_private.h"
+#include "apr_probes.h"
 
 static apr_pollset_method_e pollset_default_method = POLLSET_DEFAULT_METHOD;
 #if defined(HAVE_KQUEUE)
@@ -41,6 +42,9 @@ extern const apr_pollcb_provider_t *apr_pollcb_provider_epoll;
 #if defined(HAVE_POLL)
 extern const apr_pollcb_provider_t *apr_pollcb_provider_poll;
 #endif
+#if defined(HAVE_IO_URING)
+extern const apr_pollcb_provider_t *apr_pollcb_provider_iouring;
+#endif
 
 static const apr_pollcb_provider_t *pollcb_provider(apr_pollset_method_e method)
 {
@@ -64,6 +68,11 @@ static const apr_pollcb_provider_t *pollcb_provider(apr_pollset_method_e method)
         case APR_POLLSET_POLL:
 #if defined(HAVE_POLL)
             provider = apr_pollcb_provider_poll;
+#endif
+        break;
+        case APR_POLLSET_IOURING:
+#if defined(HAVE_IO_URING)
+            provider = apr_pollcb_provider_iouring;
 #endif
         break;
         case APR_POLLSET_SELECT:
@@ -217,12 +226,24 @@ APR_DECLARE(apr_status_t) apr_pollcb_remove(apr_pollcb_t *pollcb,
 }
 
 
+APR_DECLARE(apr_status_t) apr_pollcb_rearm(apr_pollcb_t *pollcb,
+                                           apr_pollfd_t *descriptor)
+{
+    return (*pollcb->provider->rearm)(pollcb, descriptor);
+}
+
 APR_DECLARE(apr_status_t) apr_pollcb_poll(apr_pollcb_t *pollcb,
                                           apr_interval_time_t timeout,
                                           apr_pollcb_cb_t func,
                                           void *baton)
 {
-    return (*pollcb->provider->poll)(pollcb, timeout, func, baton);
+    apr_status_t rv;
+
+    APR_PROBE2(poll__enter, pollcb, timeout);
+    rv = (*pollcb->provider->poll)(pollcb, timeout, func, baton);
+    APR_PROBE3(poll__leave, pollcb, rv, 0);
+
+    return rv;
 }
 
 APR_DECLARE(apr_status_t) apr_pollcb_wakeup(apr_pollcb_t *pollcb)
@@ -232,7 +253,7 @@ APR_DECLARE(apr_status_t) apr_pollcb_wakeup(apr_pollcb_t *pollcb)
 
     if (apr_atomic_cas32(&pollcb->wakeup_set, 1, 0) == 0) {
 #if WAKEUP_USES_PIPE
-        return apr_file_putc(1, pollcb->wakeup_pipe[1]);
+        return apr_poll_send_wakeup_pipe(pollcb->wakeup_pipe);
 #else
         apr_size_t len = 1;
         return apr_socket_send(pollcb->wakeup_socket[1], "\1", &len);
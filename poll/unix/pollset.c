@@ -28,6 +28,7 @@
 #include "apr_arch_networkio.h"
 #include "apr_arch_poll_private.h"
 #include "apr_arch_inherit.h"
+#include "apr_probes.h"
 
 static apr_pollset_method_e pollset_default_method = POLLSET_DEFAULT_METHOD;
 
@@ -63,6 +64,9 @@ extern const apr_pollset_provider_t *apr_pollset_provider_aio_msgq;
 #if defined(HAVE_POLL)
 extern const apr_pollset_provider_t *apr_pollset_provider_poll;
 #endif
+#if defined(HAVE_IO_URING)
+extern const apr_pollset_provider_t *apr_pollset_provider_iouring;
+#endif
 extern const apr_pollset_provider_t *apr_pollset_provider_select;
 
 static const apr_pollset_provider_t *pollset_provider(apr_pollset_method_e method)
@@ -92,6 +96,11 @@ static const apr_pollset_provider_t *pollset_provider(apr_pollset_method_e metho
         case APR_POLLSET_POLL:
 #if defined(HAVE_POLL)
             provider = apr_pollset_provider_poll;
+#endif
+        break;
+        case APR_POLLSET_IOURING:
+#if defined(HAVE_IO_URING)
+            provider = apr_pollset_provider_iouring;
 #endif
         break;
         case APR_POLLSET_SELECT:
@@ -235,7 +244,7 @@ APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset)
 
     if (apr_atomic_cas32(&pollset->wakeup_set, 1, 0) == 0) {
 #if WAKEUP_USES_PIPE
-        return apr_file_putc(1, pollset->wakeup_pipe[1]);
+        return apr_poll_send_wakeup_pipe(pollset->wakeup_pipe);
 #else
         apr_size_t len = 1;
         return apr_socket_send(pollset->wakeup_socket[1], "\1", &len);
@@ -257,10 +266,160 @@ APR_DECLARE(apr_status_t) apr_pollset_remove(apr_pollset_t *pollset,
     return (*pollset->provider->remove)(pollset, descriptor);
 }
 
+APR_DECLARE(apr_status_t) apr_pollset_rearm(apr_pollset_t *pollset,
+                                            const apr_pollfd_t *descriptor)
+{
+    apr_status_t rv;
+
+    if (pollset->provider->rearm) {
+        return (*pollset->provider->rearm)(pollset, descriptor);
+    }
+
+    /* Emulated, the descriptor may have been removed by apr_pollset_poll()
+     * already for APR_POLLONESHOT.
+     */
+    rv = (*pollset->provider->remove)(pollset, descriptor);
+    if (rv != APR_SUCCESS && rv != APR_NOTFOUND) {
+        return rv;
+    }
+    return (*pollset->provider->add)(pollset, descriptor);
+}
+
 APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
                                            apr_interval_time_t timeout,
                                            apr_int32_t *num,
                                            const apr_pollfd_t **descriptors)
 {
-    return (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+    apr_status_t rv;
+
+    APR_PROBE2(poll__enter, pollset, timeout);
+    rv = (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+    APR_PROBE3(poll__leave, pollset, rv, *num);
+
+    /* Emulate APR_POLLONESHOT by removing the signalled descriptors, the
+     * returned ones are copies so they remain valid.
+     */
+    if (rv == APR_SUCCESS && !pollset->provider->rearm && descriptors) {
+        apr_int32_t i;
+
+        for (i = 0; i < *num; i++) {
+            if ((*descriptors)[i].reqevents & APR_POLLONESHOT) {
+                (*pollset->provider->remove)(pollset, &(*descriptors)[i]);
+            }
+        }
+    }
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_pollset_poll_ex(apr_pollset_t *pollset,
+                                              apr_interval_time_t timeout,
+                                              apr_pollfd_t *descriptors,
+                                              apr_int32_t max,
+                                              apr_int32_t *num)
+{
+    const apr_pollfd_t *result;
+    apr_status_t rv;
+    apr_int32_t i, n;
+
+    *num = 0;
+    if (max <= 0) {
+        return APR_EINVAL;
+    }
+
+    APR_PROBE2(poll__enter, pollset, timeout);
+    if (pollset->provider->poll_ex) {
+        rv = (*pollset->provider->poll_ex)(pollset, timeout, descriptors,
+                                           max, num);
+        APR_PROBE3(poll__leave, pollset, rv, *num);
+        return rv;
+    }
+
+    /* No native batching, copy up to max from the internal result set */
+    rv = (*pollset->provider->poll)(pollset, timeout, &n, &result);
+    APR_PROBE3(poll__leave, pollset, rv, n);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (i < max) {
+            descriptors[i] = result[i];
+
+            /* Emulate APR_POLLONESHOT like apr_pollset_poll() */
+            if ((result[i].reqevents & APR_POLLONESHOT)
+                    && !pollset->provider->rearm) {
+                (*pollset->provider->remove)(pollset, &descriptors[i]);
+            }
+        }
+        else if ((result[i].reqevents & APR_POLLONESHOT)
+                 && pollset->provider->rearm) {
+            /* Not returned, so re-arm natively disarmed descriptors for
+             * them to be signalled again by the next poll.
+             */
+            (*pollset->provider->rearm)(pollset, &result[i]);
+        }
+    }
+    *num = (n < max) ? n : max;
+
+    return rv;
+}
+
+#if defined(POLLSET_USES_KQUEUE) || defined(POLLSET_USES_EPOLL) || defined(POLLSET_USES_PORT) || defined(POLLSET_USES_AIO_MSGQ) || defined(HAVE_IO_URING)
+
+void apr_pollset_elem_map_set(pfd_elem_map_t *map, int fd,
+                              pfd_elem_t *elem, apr_pool_t *p)
+{
+    if (fd < 0) {
+        elem->map_fd = -1;
+        return;
+    }
+
+    if ((apr_uint32_t)fd >= map->nalloc) {
+        apr_uint32_t nalloc = map->nalloc ? map->nalloc : 64;
+        pfd_elem_t **elems;
+
+        while ((apr_uint32_t)fd >= nalloc) {
+            nalloc *= 2;
+        }
+        elems = apr_pcalloc(p, nalloc * sizeof(pfd_elem_t *));
+        if (map->nalloc) {
+            memcpy(elems, map->elems, map->nalloc * sizeof(pfd_elem_t *));
+        }
+        map->elems = elems;
+        map->nalloc = nalloc;
+    }
+
+    map->elems[fd] = elem;
+    elem->map_fd = fd;
 }
+
+pfd_elem_t *apr_pollset_elem_map_get(const pfd_elem_map_t *map, int fd,
+                                     const apr_pollfd_t *descriptor)
+{
+    pfd_elem_t *elem;
+
+    if (fd < 0 || (apr_uint32_t)fd >= map->nalloc) {
+        return NULL;
+    }
+
+    /* The descriptor is only found if it is the one mapped with this
+     * fd, not some previous (closed) one.
+     */
+    elem = map->elems[fd];
+    if (elem && elem->map_fd == fd && elem->pfd.desc.s == descriptor->desc.s) {
+        return elem;
+    }
+    return NULL;
+}
+
+void apr_pollset_elem_map_unset(pfd_elem_map_t *map, pfd_elem_t *elem)
+{
+    if (elem->map_fd >= 0 && (apr_uint32_t)elem->map_fd < map->nalloc
+            && map->elems[elem->map_fd] == elem) {
+        map->elems[elem->map_fd] = NULL;
+    }
+    elem->map_fd = -1;
+}
+
+#endif
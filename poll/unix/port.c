@@ -451,7 +451,9 @@ static const apr_pollset_provider_t impl = {
     impl_pollset_create,
     impl_pollset_add,
     impl_pollset_remove,
+    NULL,
     impl_pollset_poll,
+    NULL,
     impl_pollset_cleanup,
     "port"
 };
@@ -573,7 +575,12 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
             if (rv) {
                 return rv;
             }
-            rv = apr_pollcb_add(pollcb, pollfd);
+            /* Event ports dissociate the signalled descriptors, this is
+             * APR_POLLONESHOT already.
+             */
+            if (!(pollfd->reqevents & APR_POLLONESHOT)) {
+                rv = apr_pollcb_add(pollcb, pollfd);
+            }
         }
     }
 
@@ -584,6 +591,7 @@ static const apr_pollcb_provider_t impl_cb = {
     impl_pollcb_create,
     impl_pollcb_add,
     impl_pollcb_remove,
+    impl_pollcb_add,
     impl_pollcb_poll,
     impl_pollcb_cleanup,
     "port"
@@ -448,8 +448,10 @@ static const apr_pollset_provider_t impl = {
     impl_pollset_create,
     impl_pollset_add,
     impl_pollset_remove,
+    NULL,
     impl_pollset_poll,
     NULL,
+    NULL,
     "select"
 };
 
@@ -24,6 +24,10 @@
 #include "apr_arch_poll_private.h"
 #include "apr_arch_inherit.h"
 
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
 #if !APR_FILES_AS_SOCKETS
 
 #ifdef WIN32
@@ -72,6 +76,11 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
     return APR_ENOTIMPL;
 }
 
+apr_status_t apr_poll_send_wakeup_pipe(apr_file_t **wakeup_pipe)
+{
+    return APR_ENOTIMPL;
+}
+
 #endif /* !WIN32 */
 
 #else  /* APR_FILES_AS_SOCKETS */
@@ -81,6 +90,30 @@ apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
 {
     apr_status_t rv;
 
+#ifdef HAVE_EVENTFD
+    /* A single eventfd is both ends of the "pipe", so wakeup_pipe[1] is
+     * left NULL for apr_poll_send_wakeup_pipe() and the drain to know.
+     * Fall back to a pipe if the kernel does not support it.
+     */
+    {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (fd >= 0) {
+            if ((rv = apr_os_pipe_put_ex(&wakeup_pipe[0], &fd, 1, pool))) {
+                close(fd);
+                return rv;
+            }
+            wakeup_pipe[1] = NULL;
+
+            pfd->p = pool;
+            pfd->reqevents = APR_POLLIN;
+            pfd->desc_type = APR_POLL_FILE;
+            pfd->desc.f = wakeup_pipe[0];
+            return APR_SUCCESS;
+        }
+    }
+#endif
+
     /* Read end of the pipe is non-blocking */
     if ((rv = apr_file_pipe_create_ex(&wakeup_pipe[0], &wakeup_pipe[1],
                                       APR_WRITE_BLOCK, pool)))
@@ -132,6 +165,29 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
     return rv0 ? rv0 : rv1;
 }
 
+apr_status_t apr_poll_send_wakeup_pipe(apr_file_t **wakeup_pipe)
+{
+#ifdef HAVE_EVENTFD
+    if (!wakeup_pipe[1]) {
+        apr_uint64_t one = 1;
+
+        for (;;) {
+            if (write(wakeup_pipe[0]->filedes, &one, sizeof one) >= 0) {
+                return APR_SUCCESS;
+            }
+            if (errno == EAGAIN) {
+                /* Counter saturated, the poller will wake up anyway */
+                return APR_SUCCESS;
+            }
+            if (errno != EINTR) {
+                return errno;
+            }
+        }
+    }
+#endif
+    return apr_file_putc(1, wakeup_pipe[1]);
+}
+
 #endif /* APR_FILES_AS_SOCKETS */
 
 #if WAKEUP_USES_PIPE
@@ -139,9 +195,20 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
  */
 void apr_poll_drain_wakeup_pipe(volatile apr_uint32_t *wakeup_set, apr_file_t **wakeup_pipe)
 {
-    char ch;
+#ifdef HAVE_EVENTFD
+    if (!wakeup_pipe[1]) {
+        apr_uint64_t count;
 
-    (void)apr_file_getc(&ch, wakeup_pipe[0]);
+        /* Resets the eventfd counter, however many wakeups were sent */
+        (void)read(wakeup_pipe[0]->filedes, &count, sizeof count);
+    }
+    else
+#endif
+    {
+        char ch;
+
+        (void)apr_file_getc(&ch, wakeup_pipe[0]);
+    }
     apr_atomic_set32(wakeup_set, 0);
 }
 #else
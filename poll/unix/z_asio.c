@@ -773,7 +773,9 @@ static const apr_pollset_provider_t impl = {
     asio_pollset_create,
     asio_pollset_add,
     asio_pollset_remove,
+    NULL,
     asio_pollset_poll,
+    NULL,
     asio_pollset_cleanup,
     "asio"
 };
@@ -23,6 +23,7 @@
 #include <string.h>     /* memcpy()/memset() or bcopy()/bzero() */
 #include <assert.h>     /* assert() */
 #include "sha2.h"
+#include "apr_sha_private.h"
 
 /*
  * ASSERT NOTE:
@@ -243,6 +244,10 @@ void apr__SHA256_Transform(SHA256_CTX* context, const sha2_word32* data) {
         sha2_word32     T1, *W256;
         int             j;
 
+        if (apr__sha256_blocks(context->state, data, 1, 0)) {
+                return;
+        }
+
         W256 = (sha2_word32*)context->buffer;
 
         /* Initialize registers with the prev. intermediate value */
@@ -301,6 +306,10 @@ void apr__SHA256_Transform(SHA256_CTX* context, const sha2_word32* data) {
         sha2_word32     T1, T2, *W256;
         int             j;
 
+        if (apr__sha256_blocks(context->state, data, 1, 0)) {
+                return;
+        }
+
         W256 = (sha2_word32*)context->buffer;
 
         /* Initialize registers with the prev. intermediate value */
@@ -378,6 +387,7 @@ void apr__SHA256_Transform(SHA256_CTX* context, const sha2_word32* data) {
 
 void apr__SHA256_Update(SHA256_CTX* context, const sha2_byte *data, size_t len) {
         unsigned int    freespace, usedspace;
+        size_t          blocks;
 
         if (len == 0) {
                 /* Calling with no data is valid - we do nothing */
@@ -409,6 +419,12 @@ void apr__SHA256_Update(SHA256_CTX* context, const sha2_byte *data, size_t len)
                         return;
                 }
         }
+        /* The SHA instructions take the blocks where they are */
+        blocks = apr__sha256_blocks(context->state, data,
+                                    len / SHA256_BLOCK_LENGTH, 0);
+        context->bitcount += (sha2_word64)blocks * SHA256_BLOCK_LENGTH << 3;
+        len -= blocks * SHA256_BLOCK_LENGTH;
+        data += blocks * SHA256_BLOCK_LENGTH;
         while (len >= SHA256_BLOCK_LENGTH) {
                 /* Process as many complete blocks as we can */
                 apr__SHA256_Transform(context, (sha2_word32*)data);
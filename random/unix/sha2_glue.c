@@ -17,7 +17,9 @@
 #include <apr.h>
 #include <apr_random.h>
 #include <apr_pools.h>
+#include <apr_sha256.h>
 #include "sha2.h"
+#include "apr_sha_private.h"
 
 static void sha256_init(apr_crypto_hash_t *h)
 {
@@ -47,3 +49,26 @@ APR_DECLARE(apr_crypto_hash_t *) apr_crypto_sha256_new(apr_pool_t *p)
 
     return h;
 }
+
+APR_DECLARE(void) apr_sha256(unsigned char digest[APR_SHA256_DIGESTSIZE],
+                             const void *data, apr_size_t len)
+{
+    SHA256_CTX ctx;
+
+    apr__SHA256_Init(&ctx);
+    apr__SHA256_Update(&ctx, data, len);
+    apr__SHA256_Final(digest, &ctx);
+}
+
+APR_DECLARE(void) apr_sha256_multi(unsigned char (*digests)[APR_SHA256_DIGESTSIZE],
+                                   const struct iovec *vec, apr_size_t n)
+{
+    apr_size_t i;
+
+    if (apr__sha256_multi(digests, vec, n)) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        apr_sha256(digests[i], vec[i].iov_base, vec[i].iov_len);
+    }
+}
@@ -17,6 +17,9 @@
 #include "apr_redis.h"
 #include "apr_poll.h"
 #include "apr_version.h"
+#include "apr_crc32.h"
+#include "apr_md5.h"
+#include "apr_strings.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -27,11 +30,12 @@ struct apr_redis_conn_t
     char *buffer;
     apr_size_t blen;
     apr_pool_t *p;
-    apr_pool_t *tp;
     apr_socket_t *sock;
+    apr_bucket_alloc_t *ba;     /* bb and tb live as long as the socket */
     apr_bucket_brigade *bb;
     apr_bucket_brigade *tb;
     apr_redis_server_t *rs;
+    apr_int64_t tracking_id;    /* redirecting its invalidations, or zero */
 };
 
 /* Strings for Client Commands */
@@ -165,55 +169,192 @@ apr_redis_find_server_hash(apr_redis_t *rc, const apr_uint32_t hash)
     }
 }
 
+/* Whether a server can be used, trying a dead one every 5 seconds */
+static int server_usable(apr_redis_t *rc, apr_redis_server_t *rs,
+                         apr_time_t *curtime)
+{
+    int usable = 0;
+
+    if (rs->status == APR_RC_SERVER_LIVE) {
+        return 1;
+    }
+
+    if (*curtime == 0) {
+        *curtime = apr_time_now();
+    }
+#if APR_HAS_THREADS
+    apr_thread_mutex_lock(rs->lock);
+#endif
+    if (*curtime - rs->btime > apr_time_from_sec(5)) {
+        rs->btime = *curtime;
+        if (apr_redis_ping(rs) == APR_SUCCESS) {
+            make_server_live(rc, rs);
+            usable = 1;
+        }
+    }
+#if APR_HAS_THREADS
+    apr_thread_mutex_unlock(rs->lock);
+#endif
+
+    return usable;
+}
+
 APR_DECLARE(apr_redis_server_t *)
 apr_redis_find_server_hash_default(void *baton, apr_redis_t *rc,
                                    const apr_uint32_t hash)
 {
-    apr_redis_server_t *rs = NULL;
+    apr_redis_server_t *rs;
     apr_uint32_t h = hash ? hash : 1;
-    apr_uint32_t i = 0;
+    apr_uint32_t i;
+    apr_time_t curtime = 0;
+
+    for (i = 0; i < rc->ntotal; i++, h++) {
+        rs = rc->live_servers[h % rc->ntotal];
+        if (server_usable(rc, rs, &curtime)) {
+            return rs;
+        }
+    }
+
+    return NULL;
+}
+
+/* Jump consistent hash (Lamping and Veach): the bucket in [0, n) of key,
+ * which changes for 1/n of the keys only when growing to n buckets.
+ */
+static apr_int32_t jump_hash(apr_uint64_t key, apr_int32_t n)
+{
+    apr_int64_t b = -1, j = 0;
+
+    while (j < n) {
+        b = j;
+        key = key * APR_UINT64_C(2862933555777941757) + 1;
+        j = (apr_int64_t)((b + 1) * ((double)(APR_INT64_C(1) << 31)
+                                     / (double)((key >> 33) + 1)));
+    }
+
+    return (apr_int32_t)b;
+}
+
+APR_DECLARE(apr_redis_server_t *)
+apr_redis_find_server_hash_jump(void *baton, apr_redis_t *rc,
+                                const apr_uint32_t hash)
+{
+    apr_redis_server_t *rs;
+    apr_uint64_t key = hash;
+    apr_uint32_t i;
+    apr_time_t curtime = 0;
+
+    for (i = 0; i < rc->ntotal; i++) {
+        rs = rc->live_servers[jump_hash(key, rc->ntotal)];
+        if (server_usable(rc, rs, &curtime)) {
+            return rs;
+        }
+        /* Dead, so rehash: the keys of the live servers don't move */
+        key += APR_UINT64_C(0x9E3779B97F4A7C15);
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    apr_uint32_t point;
+    apr_redis_server_t *server;
+} continuum_point_t;
+
+struct apr_redis_continuum_t {
+    apr_uint32_t npoints;
+    continuum_point_t *points;
+};
+
+static int continuum_point_cmp(const void *a, const void *b)
+{
+    apr_uint32_t pa = ((const continuum_point_t *)a)->point;
+    apr_uint32_t pb = ((const continuum_point_t *)b)->point;
+
+    return pa < pb ? -1 : pa > pb;
+}
+
+APR_DECLARE(apr_status_t)
+apr_redis_continuum_create(apr_redis_continuum_t **continuum,
+                           apr_redis_t *rc, apr_uint32_t points,
+                           apr_pool_t *p)
+{
+    apr_redis_continuum_t *c;
+    apr_uint32_t i, k, n = 0;
+
+    if (points == 0) {
+        points = APR_REDIS_CONTINUUM_POINTS;
+    }
+    /* Four points per MD5 digest */
+    points = (points + 3) & ~3;
+
+    c = apr_palloc(p, sizeof(*c));
+    c->points = apr_palloc(p, sizeof(*c->points) * points * rc->ntotal);
+    for (i = 0; i < rc->ntotal; i++) {
+        apr_redis_server_t *rs = rc->live_servers[i];
+
+        for (k = 0; k < points / 4; k++) {
+            unsigned char digest[APR_MD5_DIGESTSIZE];
+            apr_md5_ctx_t md5;
+            char suffix[32];
+            int h;
+
+            /* MD5 of "host:port-k", as libketama */
+            apr_snprintf(suffix, sizeof(suffix), ":%d-%u", (int)rs->port, k);
+            apr_md5_init(&md5);
+            apr_md5_update(&md5, rs->host, strlen(rs->host));
+            apr_md5_update(&md5, suffix, strlen(suffix));
+            apr_md5_final(digest, &md5);
+            for (h = 0; h < 4; h++) {
+                c->points[n].point = ((apr_uint32_t)digest[3 + h * 4] << 24)
+                                   | ((apr_uint32_t)digest[2 + h * 4] << 16)
+                                   | ((apr_uint32_t)digest[1 + h * 4] << 8)
+                                   | digest[h * 4];
+                c->points[n].server = rs;
+                n++;
+            }
+        }
+    }
+    c->npoints = n;
+    qsort(c->points, n, sizeof(*c->points), continuum_point_cmp);
+
+    *continuum = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_redis_server_t *)
+apr_redis_find_server_hash_ketama(void *baton, apr_redis_t *rc,
+                                  const apr_uint32_t hash)
+{
+    apr_redis_continuum_t *c = baton;
+    apr_uint32_t lo = 0, hi, i;
     apr_time_t curtime = 0;
 
-    if (rc->ntotal == 0) {
+    if (!c || c->npoints == 0) {
         return NULL;
     }
 
-    do {
-        rs = rc->live_servers[h % rc->ntotal];
-        if (rs->status == APR_RC_SERVER_LIVE) {
-            break;
+    /* The first point at or after the hash, wrapping around */
+    hi = c->npoints;
+    while (lo < hi) {
+        apr_uint32_t mid = lo + (hi - lo) / 2;
+        if (c->points[mid].point < hash) {
+            lo = mid + 1;
         }
         else {
-            if (curtime == 0) {
-                curtime = apr_time_now();
-            }
-#if APR_HAS_THREADS
-            apr_thread_mutex_lock(rs->lock);
-#endif
-            /* Try the dead server, every 5 seconds */
-            if (curtime - rs->btime > apr_time_from_sec(5)) {
-                rs->btime = curtime;
-                if (apr_redis_ping(rs) == APR_SUCCESS) {
-                    make_server_live(rc, rs);
-#if APR_HAS_THREADS
-                    apr_thread_mutex_unlock(rs->lock);
-#endif
-                    break;
-                }
-            }
-#if APR_HAS_THREADS
-            apr_thread_mutex_unlock(rs->lock);
-#endif
+            hi = mid;
         }
-        h++;
-        i++;
-    } while (i < rc->ntotal);
+    }
 
-    if (i == rc->ntotal) {
-        rs = NULL;
+    /* Dead servers pass their keys to the next points */
+    for (i = 0; i < c->npoints; i++) {
+        apr_redis_server_t *rs = c->points[(lo + i) % c->npoints].server;
+        if (server_usable(rc, rs, &curtime)) {
+            return rs;
+        }
     }
 
-    return rs;
+    return NULL;
 }
 
 APR_DECLARE(apr_redis_server_t *) apr_redis_find_server(apr_redis_t *rc,
@@ -233,12 +374,14 @@ APR_DECLARE(apr_redis_server_t *) apr_redis_find_server(apr_redis_t *rc,
     return NULL;
 }
 
+static apr_status_t rs_bad_conn(apr_redis_server_t *rs,
+                                apr_redis_conn_t *conn);
+static apr_status_t conn_track(apr_redis_conn_t *conn);
+
 static apr_status_t rs_find_conn(apr_redis_server_t *rs,
                                  apr_redis_conn_t ** conn)
 {
     apr_status_t rv;
-    apr_bucket_alloc_t *balloc;
-    apr_bucket *e;
 
 #if APR_HAS_THREADS
     rv = apr_reslist_acquire(rs->conns, (void **) conn);
@@ -251,12 +394,20 @@ static apr_status_t rs_find_conn(apr_redis_server_t *rs,
         return rv;
     }
 
-    balloc = apr_bucket_alloc_create((*conn)->tp);
-    (*conn)->bb = apr_brigade_create((*conn)->tp, balloc);
-    (*conn)->tb = apr_brigade_create((*conn)->tp, balloc);
+    /* the brigades are kept from one use to the next, the socket bucket
+     * only being gone once it has read the end of the connection */
+    if (APR_BRIGADE_EMPTY((*conn)->bb)) {
+        apr_bucket *e = apr_bucket_socket_create((*conn)->sock, (*conn)->ba);
+        APR_BRIGADE_INSERT_TAIL((*conn)->bb, e);
+    }
 
-    e = apr_bucket_socket_create((*conn)->sock, balloc);
-    APR_BRIGADE_INSERT_TAIL((*conn)->bb, e);
+    /* the reads are tracked once subscribed to the invalidations */
+    if ((*conn)->tracking_id != rs->tracking_id) {
+        rv = conn_track(*conn);
+        if (rv != APR_SUCCESS) {
+            rs_bad_conn(rs, *conn);
+        }
+    }
 
     return rv;
 }
@@ -264,6 +415,9 @@ static apr_status_t rs_find_conn(apr_redis_server_t *rs,
 static apr_status_t rs_bad_conn(apr_redis_server_t *rs,
                                 apr_redis_conn_t *conn)
 {
+    /* whatever was read is out of sync */
+    apr_brigade_cleanup(conn->bb);
+    apr_brigade_cleanup(conn->tb);
 #if APR_HAS_THREADS
     return apr_reslist_invalidate(rs->conns, conn);
 #else
@@ -274,7 +428,7 @@ static apr_status_t rs_bad_conn(apr_redis_server_t *rs,
 static apr_status_t rs_release_conn(apr_redis_server_t *rs,
                                     apr_redis_conn_t *conn)
 {
-    apr_pool_clear(conn->tp);
+    apr_brigade_cleanup(conn->tb);
 #if APR_HAS_THREADS
     return apr_reslist_release(rs->conns, conn);
 #else
@@ -341,7 +495,6 @@ rc_conn_construct(void **conn_, void *params, apr_pool_t *pool)
     apr_status_t rv = APR_SUCCESS;
     apr_redis_conn_t *conn;
     apr_pool_t *np;
-    apr_pool_t *tp;
     apr_redis_server_t *rs = params;
 #if APR_HAVE_SOCKADDR_UN
     apr_int32_t family = rs->host[0] != '/' ? APR_INET : APR_UNIX;
@@ -354,16 +507,9 @@ rc_conn_construct(void **conn_, void *params, apr_pool_t *pool)
         return rv;
     }
 
-    rv = apr_pool_create(&tp, np);
-    if (rv != APR_SUCCESS) {
-        apr_pool_destroy(np);
-        return rv;
-    }
-
     conn = apr_palloc(np, sizeof(apr_redis_conn_t));
 
     conn->p = np;
-    conn->tp = tp;
 
     rv = apr_socket_create(&conn->sock, family, SOCK_STREAM, 0, np);
 
@@ -375,6 +521,11 @@ rc_conn_construct(void **conn_, void *params, apr_pool_t *pool)
     conn->buffer = apr_palloc(conn->p, BUFFER_SIZE + 1);
     conn->blen = 0;
     conn->rs = rs;
+    conn->tracking_id = 0;
+
+    conn->ba = apr_bucket_alloc_create(np);
+    conn->bb = apr_brigade_create(np, conn->ba);
+    conn->tb = apr_brigade_create(np, conn->ba);
 
     rv = conn_connect(conn);
     if (rv != APR_SUCCESS) {
@@ -448,6 +599,7 @@ APR_DECLARE(apr_status_t) apr_redis_server_create(apr_pool_t *p,
     server->version.major = 0;
     server->version.minor = 0;
     server->version.patch = 0;
+    server->tracking_id = 0;
 
 #if APR_HAS_THREADS
     rv = apr_thread_mutex_create(&server->lock, APR_THREAD_MUTEX_DEFAULT, np);
@@ -498,96 +650,17 @@ APR_DECLARE(apr_status_t) apr_redis_create(apr_pool_t *p,
     rc->hash_baton = NULL;
     rc->server_func = NULL;
     rc->server_baton = NULL;
+    rc->nearcache = NULL;
     *redis = rc;
     return rv;
 }
 
 
-/* The crc32 functions and data was originally written by Spencer
- * Garrett <srg@quick.com> and was gleaned from the PostgreSQL source
- * tree via the files contrib/ltree/crc32.[ch] and from FreeBSD at
- * src/usr.bin/cksum/crc32.c.
- */
-
-static const apr_uint32_t crc32tab[256] = {
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
-    0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
-    0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
-    0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de,
-    0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,
-    0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
-    0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
-    0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
-    0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116,
-    0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
-    0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
-    0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a,
-    0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818,
-    0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
-    0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
-    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c,
-    0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2,
-    0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
-    0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
-    0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086,
-    0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4,
-    0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
-    0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
-    0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8,
-    0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe,
-    0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
-    0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
-    0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252,
-    0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60,
-    0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
-    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
-    0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04,
-    0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a,
-    0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
-    0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
-    0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e,
-    0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
-    0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
-    0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
-    0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0,
-    0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6,
-    0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
-    0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
-};
-
 APR_DECLARE(apr_uint32_t) apr_redis_hash_crc32(void *baton,
                                                const char *data,
                                                const apr_size_t data_len)
 {
-    apr_uint32_t i;
-    apr_uint32_t crc;
-    crc = ~0;
-
-    for (i = 0; i < data_len; i++)
-        crc = (crc >> 8) ^ crc32tab[(crc ^ (data[i])) & 0xff];
-
-    return ~crc;
+    return apr_crc32(0, data, data_len);
 }
 
 APR_DECLARE(apr_uint32_t) apr_redis_hash_default(void *baton,
@@ -600,6 +673,17 @@ APR_DECLARE(apr_uint32_t) apr_redis_hash_default(void *baton,
     return ((apr_redis_hash_crc32(baton, data, data_len) >> 16) & 0x7fff);
 }
 
+APR_DECLARE(apr_uint32_t) apr_redis_hash_ketama(void *baton,
+                                                const char *data,
+                                                const apr_size_t data_len)
+{
+    unsigned char digest[APR_MD5_DIGESTSIZE];
+
+    apr_md5(digest, data, data_len);
+    return ((apr_uint32_t)digest[3] << 24) | ((apr_uint32_t)digest[2] << 16)
+           | ((apr_uint32_t)digest[1] << 8) | digest[0];
+}
+
 APR_DECLARE(apr_uint32_t) apr_redis_hash(apr_redis_t *rc,
                                          const char *data,
                                          const apr_size_t data_len)
@@ -612,28 +696,61 @@ APR_DECLARE(apr_uint32_t) apr_redis_hash(apr_redis_t *rc,
     }
 }
 
+/* Copies the next line (BUFFER_SIZE bytes at most) from the buckets of
+ * conn->bb to conn->buffer, consuming them.
+ */
 static apr_status_t get_server_line(apr_redis_conn_t *conn)
 {
-    apr_size_t bsize = BUFFER_SIZE;
-    apr_status_t rv = APR_SUCCESS;
+    conn->blen = 0;
 
-    rv = apr_brigade_split_line(conn->tb, conn->bb, APR_BLOCK_READ,
-            BUFFER_SIZE);
+    while (conn->blen < BUFFER_SIZE) {
+        apr_bucket *e = APR_BRIGADE_FIRST(conn->bb);
+        const char *str;
+        const char *pos;
+        apr_size_t len;
+        apr_status_t rv;
 
-    if (rv != APR_SUCCESS) {
-        return rv;
-    }
+        if (e == APR_BRIGADE_SENTINEL(conn->bb)) {
+            break;
+        }
 
-    rv = apr_brigade_flatten(conn->tb, conn->buffer, &bsize);
+        rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
 
-    if (rv != APR_SUCCESS) {
-        return rv;
+        pos = memchr(str, APR_ASCII_LF, len);
+        if (pos) {
+            len = pos - str + 1;
+        }
+        if (len > BUFFER_SIZE - conn->blen) {
+            len = BUFFER_SIZE - conn->blen;
+        }
+        memcpy(conn->buffer + conn->blen, str, len);
+        conn->blen += len;
+
+        if (len < e->length) {
+            apr_bucket_split(e, len);
+        }
+        apr_bucket_delete(e);
+
+        if (conn->blen && conn->buffer[conn->blen - 1] == APR_ASCII_LF) {
+            break;
+        }
     }
 
-    conn->blen = bsize;
-    conn->buffer[bsize] = '\0';
+    conn->buffer[conn->blen] = '\0';
+
+    return APR_SUCCESS;
+}
 
-    return apr_brigade_cleanup(conn->tb);
+/* The value cached in the process is stale once written */
+static void nearcache_delete(apr_redis_t *rc, const char *key,
+                             apr_size_t klen)
+{
+    if (rc->nearcache) {
+        apr_nearcache_delete(rc->nearcache, key, klen);
+    }
 }
 
 APR_DECLARE(apr_status_t) apr_redis_set(apr_redis_t *rc,
@@ -653,6 +770,7 @@ APR_DECLARE(apr_status_t) apr_redis_set(apr_redis_t *rc,
     apr_size_t len, klen;
 
     klen = strlen(key);
+    nearcache_delete(rc, key, klen);
     hash = apr_redis_hash(rc, key, klen);
 
     rs = apr_redis_find_server_hash(rc, hash);
@@ -758,6 +876,7 @@ APR_DECLARE(apr_status_t) apr_redis_setex(apr_redis_t *rc,
 
 
     klen = strlen(key);
+    nearcache_delete(rc, key, klen);
     hash = apr_redis_hash(rc, key, klen);
 
     rs = apr_redis_find_server_hash(rc, hash);
@@ -886,18 +1005,16 @@ static apr_status_t grab_bulk_resp(apr_redis_server_t *rs, apr_redis_t *rc,
             return rv;
         }
 
-        bbb = apr_brigade_split(conn->bb, e);
+        /* the rest goes to tb, which becomes bb */
+        apr_brigade_split_ex(conn->bb, e, conn->tb);
 
         rv = apr_brigade_pflatten(conn->bb, baton, &len, p);
+        apr_brigade_cleanup(conn->bb);
 
-        if (rv != APR_SUCCESS) {
-            rs_bad_conn(rs, conn);
-            if (rc)
-                apr_redis_disable_server(rc, rs);
-            return rv;
-        }
+        bbb = conn->bb;
+        conn->bb = conn->tb;
+        conn->tb = bbb;
 
-        rv = apr_brigade_destroy(conn->bb);
         if (rv != APR_SUCCESS) {
             rs_bad_conn(rs, conn);
             if (rc)
@@ -905,8 +1022,6 @@ static apr_status_t grab_bulk_resp(apr_redis_server_t *rs, apr_redis_t *rc,
             return rv;
         }
 
-        conn->bb = bbb;
-
         *new_length = len - 2;
         (*baton)[*new_length] = '\0';
     }
@@ -931,6 +1046,13 @@ APR_DECLARE(apr_status_t) apr_redis_getp(apr_redis_t *rc,
     char keysize_str[LILBUFF_SIZE];
 
     klen = strlen(key);
+
+    if (rc->nearcache
+            && apr_nearcache_get(rc->nearcache, key, klen, p, baton,
+                                 new_length, flags) == APR_SUCCESS) {
+        return APR_SUCCESS;
+    }
+
     hash = apr_redis_hash(rc, key, klen);
     rs = apr_redis_find_server_hash(rc, hash);
 
@@ -992,6 +1114,10 @@ APR_DECLARE(apr_status_t) apr_redis_getp(apr_redis_t *rc,
     }
     else if (strncmp(RS_TYPE_STRING, conn->buffer, RS_TYPE_STRING_LEN) == 0) {
         rv = grab_bulk_resp(rs, rc, conn, p, baton, new_length);
+        if (rv == APR_SUCCESS && rc->nearcache && *baton) {
+            apr_nearcache_set(rc->nearcache, key, klen, *baton, *new_length,
+                              0, 0);
+        }
     }
     else {
         rv = APR_EGENERAL;
@@ -1014,6 +1140,7 @@ APR_DECLARE(apr_status_t)
     char keysize_str[LILBUFF_SIZE];
 
     klen = strlen(key);
+    nearcache_delete(rc, key, klen);
     hash = apr_redis_hash(rc, key, klen);
     rs = apr_redis_find_server_hash(rc, hash);
     if (rs == NULL)
@@ -1249,6 +1376,7 @@ static apr_status_t plus_minus(apr_redis_t *rc,
     int i = 0;
 
     klen = strlen(key);
+    nearcache_delete(rc, key, klen);
     hash = apr_redis_hash(rc, key, klen);
     rs = apr_redis_find_server_hash(rc, hash);
     if (rs == NULL)
@@ -1373,13 +1501,1460 @@ apr_redis_decr(apr_redis_t *rc, const char *key, apr_int32_t inc, apr_uint32_t *
     return plus_minus(rc, 0, key, inc, new_value);
 }
 
-APR_DECLARE(apr_status_t)
-apr_redis_multgetp(apr_redis_t *rc,
-                   apr_pool_t *temp_pool,
-                   apr_pool_t *data_pool,
-                   apr_hash_t *values)
+APR_DECLARE(void)
+apr_redis_add_multget_key(apr_pool_t *data_pool,
+                          const char* key,
+                          apr_hash_t **values)
+{
+    apr_redis_value_t* value;
+    apr_size_t klen = strlen(key);
+
+    /* create the value hash if need be */
+    if (!*values) {
+        *values = apr_hash_make(data_pool);
+    }
+
+    /* init key and add it to the value hash */
+    value = apr_pcalloc(data_pool, sizeof(apr_redis_value_t));
+
+    value->status = APR_NOTFOUND;
+    value->key = apr_pstrdup(data_pool, key);
+
+    apr_hash_set(*values, value->key, klen, value);
+}
+
+/* The commands queued for one server */
+typedef struct
+{
+    apr_redis_server_t *rs;
+    apr_redis_conn_t *conn;
+    apr_bucket_brigade *bb;
+    apr_array_header_t *replies;
+} pipeline_server_t;
+
+struct apr_redis_pipeline_t
+{
+    apr_redis_t *rc;
+    apr_pool_t *p;
+    apr_pool_t *rpool;      /* for the replies' data */
+    apr_bucket_alloc_t *balloc;
+    apr_hash_t *servers;
+};
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_create(apr_redis_pipeline_t **pl,
+                                                    apr_redis_t *rc,
+                                                    apr_pool_t *p)
+{
+    apr_redis_pipeline_t *np = apr_palloc(p, sizeof(*np));
+
+    np->rc = rc;
+    np->p = p;
+    np->rpool = p;
+    np->balloc = apr_bucket_alloc_create(p);
+    np->servers = apr_hash_make(p);
+
+    *pl = np;
+    return APR_SUCCESS;
+}
+
+static apr_redis_reply_t *reply_make(apr_pool_t *p, apr_status_t status)
+{
+    apr_redis_reply_t *reply = apr_pcalloc(p, sizeof(*reply));
+
+    reply->status = status;
+    reply->type = APR_RR_NONE;
+    return reply;
+}
+
+/* Write a command to a brigade */
+static void resp_command(apr_bucket_brigade *bb,
+                         apr_size_t argc,
+                         const char * const *argv,
+                         const apr_size_t *argvlen)
+{
+    apr_size_t i;
+
+    /*
+     * RESP Command:
+     *   *<argc>
+     *   $<arglen>
+     *   arg
+     *   ...
+     */
+    apr_brigade_printf(bb, NULL, NULL, "*%" APR_SIZE_T_FMT RC_EOL, argc);
+    for (i = 0; i < argc; i++) {
+        apr_size_t len = argvlen ? argvlen[i] : strlen(argv[i]);
+
+        apr_brigade_printf(bb, NULL, NULL, "$%" APR_SIZE_T_FMT RC_EOL, len);
+        /* only the large arguments are not copied, the small ones being
+         * packed together with the lengths into the heap buckets */
+        if (len >= APR_BUCKET_BUFF_SIZE) {
+            apr_bucket *e = apr_bucket_transient_create(argv[i], len,
+                                                        bb->bucket_alloc);
+            APR_BRIGADE_INSERT_TAIL(bb, e);
+        }
+        else {
+            apr_brigade_write(bb, NULL, NULL, argv[i], len);
+        }
+        apr_brigade_write(bb, NULL, NULL, RC_EOL, RC_EOL_LEN);
+    }
+}
+
+static void pipeline_add_server(apr_redis_pipeline_t *pl,
+                                apr_redis_server_t *rs,
+                                apr_size_t argc,
+                                const char * const *argv,
+                                const apr_size_t *argvlen,
+                                apr_redis_reply_t **reply)
+{
+    pipeline_server_t *ps;
+
+    ps = apr_hash_get(pl->servers, &rs, sizeof(rs));
+    if (!ps) {
+        ps = apr_pcalloc(pl->p, sizeof(*ps));
+        ps->rs = rs;
+        ps->bb = apr_brigade_create(pl->p, pl->balloc);
+        ps->replies = apr_array_make(pl->p, 8, sizeof(apr_redis_reply_t *));
+        apr_hash_set(pl->servers, &ps->rs, sizeof(rs), ps);
+    }
+
+    resp_command(ps->bb, argc, argv, argvlen);
+
+    *reply = reply_make(pl->rpool, APR_INCOMPLETE);
+    APR_ARRAY_PUSH(ps->replies, apr_redis_reply_t *) = *reply;
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_add(apr_redis_pipeline_t *pl,
+                                                 const char *key,
+                                                 apr_size_t argc,
+                                                 const char * const *argv,
+                                                 const apr_size_t *argvlen,
+                                                 apr_redis_reply_t **reply)
+{
+    apr_redis_server_t *rs;
+    apr_uint32_t hash;
+
+    if (argc == 0) {
+        return APR_EINVAL;
+    }
+
+    hash = apr_redis_hash(pl->rc, key, strlen(key));
+    rs = apr_redis_find_server_hash(pl->rc, hash);
+    if (rs == NULL) {
+        *reply = reply_make(pl->rpool, APR_NOTFOUND);
+        return APR_NOTFOUND;
+    }
+
+    pipeline_add_server(pl, rs, argc, argv, argvlen, reply);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_set(apr_redis_pipeline_t *pl,
+                                                 const char *key,
+                                                 const char *data,
+                                                 apr_size_t data_size,
+                                                 apr_redis_reply_t **reply)
+{
+    const char *argv[3];
+    apr_size_t argvlen[3];
+
+    argv[0] = "SET";
+    argvlen[0] = 3;
+    argv[1] = key;
+    argvlen[1] = strlen(key);
+    argv[2] = data;
+    argvlen[2] = data_size;
+
+    nearcache_delete(pl->rc, key, argvlen[1]);
+    return apr_redis_pipeline_add(pl, key, 3, argv, argvlen, reply);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_setex(apr_redis_pipeline_t *pl,
+                                                   const char *key,
+                                                   const char *data,
+                                                   apr_size_t data_size,
+                                                   apr_uint32_t timeout,
+                                                   apr_redis_reply_t **reply)
+{
+    const char *argv[4];
+    apr_size_t argvlen[4];
+
+    argv[0] = "SETEX";
+    argvlen[0] = 5;
+    argv[1] = key;
+    argvlen[1] = strlen(key);
+    argv[2] = apr_psprintf(pl->p, "%u", timeout);
+    argvlen[2] = strlen(argv[2]);
+    argv[3] = data;
+    argvlen[3] = data_size;
+
+    nearcache_delete(pl->rc, key, argvlen[1]);
+    return apr_redis_pipeline_add(pl, key, 4, argv, argvlen, reply);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_get(apr_redis_pipeline_t *pl,
+                                                 const char *key,
+                                                 apr_redis_reply_t **reply)
+{
+    const char *argv[2];
+
+    argv[0] = "GET";
+    argv[1] = key;
+
+    return apr_redis_pipeline_add(pl, key, 2, argv, NULL, reply);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_delete(apr_redis_pipeline_t *pl,
+                                                    const char *key,
+                                                    apr_redis_reply_t **reply)
+{
+    const char *argv[2];
+
+    argv[0] = "DEL";
+    argv[1] = key;
+
+    nearcache_delete(pl->rc, key, strlen(key));
+    return apr_redis_pipeline_add(pl, key, 2, argv, NULL, reply);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_incr(apr_redis_pipeline_t *pl,
+                                                  const char *key,
+                                                  apr_int64_t inc,
+                                                  apr_redis_reply_t **reply)
+{
+    const char *argv[3];
+
+    argv[0] = "INCRBY";
+    argv[1] = key;
+    argv[2] = apr_psprintf(pl->p, "%" APR_INT64_T_FMT, inc);
+
+    nearcache_delete(pl->rc, key, strlen(key));
+    return apr_redis_pipeline_add(pl, key, 3, argv, NULL, reply);
+}
+
+/* Scan the RESP data in buf from *pos, as long as *pending (the replies
+ * left to complete, one to start with) is not zero.  The scan stops after
+ * the last complete element on APR_INCOMPLETE, to be resumed once buf
+ * holds at least *need bytes, so that nothing is scanned twice.
+ */
+static apr_status_t resp_scan(const char *buf, apr_size_t len,
+                              apr_size_t *pos, apr_size_t *pending,
+                              apr_size_t *need)
+{
+    while (*pending) {
+        const char *line = buf + *pos, *eol;
+        apr_size_t next;
+        apr_int64_t n;
+
+        eol = memchr(line, APR_ASCII_LF, len - *pos);
+        if (!eol) {
+            *need = len + 1;
+            return APR_INCOMPLETE;
+        }
+        if (eol - line < 2 || eol[-1] != APR_ASCII_CR) {
+            return APR_EGENERAL;
+        }
+        next = eol + 1 - buf;
+
+        switch (line[0]) {
+        case '+':
+        case '-':
+        case ':':
+        case '_':
+        case '#':
+        case ',':
+        case '(':
+            (*pending)--;
+            break;
+
+        case '$':
+        case '=':
+        case '!':
+            n = apr_strtoi64(line + 1, NULL, 10);
+            if (n >= 0) {
+                if ((apr_uint64_t)n > APR_SIZE_MAX - RC_EOL_LEN - next) {
+                    return APR_EGENERAL;
+                }
+                if ((apr_size_t)n + RC_EOL_LEN > len - next) {
+                    *need = next + (apr_size_t)n + RC_EOL_LEN;
+                    return APR_INCOMPLETE;
+                }
+                if (memcmp(buf + next + n, RC_EOL, RC_EOL_LEN)) {
+                    return APR_EGENERAL;
+                }
+                next += (apr_size_t)n + RC_EOL_LEN;
+            }
+            (*pending)--;
+            break;
+
+        case '*':
+        case '~':
+        case '>':
+        case '%':
+        case '|':
+            n = apr_strtoi64(line + 1, NULL, 10);
+            if (n > 0 && (apr_uint64_t)n > (APR_SIZE_MAX - *pending) / 2) {
+                return APR_EGENERAL;
+            }
+            if (n > 0) {
+                /* the elements, allocated only once they are all there */
+                *pending += (line[0] == '%' || line[0] == '|') ? 2 * n : n;
+            }
+            if (line[0] != '|') {
+                /* the attributes precede the reply they are about */
+                (*pending)--;
+            }
+            break;
+
+        default:
+            return APR_EGENERAL;
+        }
+
+        *pos = next;
+    }
+
+    return APR_SUCCESS;
+}
+
+/* A string of the data read, terminated in place (on the \r of its \r\n)
+ * unless copied to p */
+static char *resp_str(char *str, apr_size_t len, apr_pool_t *p, int copy)
+{
+    if (copy) {
+        return apr_pstrmemdup(p, str, len);
+    }
+    str[len] = '\0';
+    return str;
+}
+
+/* Parse the RESP reply at *pos of buf, which resp_scan() found complete,
+ * its strings pointing in buf unless copied to p.
+ */
+static void resp_parse(char *buf, apr_size_t len, apr_size_t *pos,
+                       apr_redis_reply_t *reply, apr_pool_t *p, int copy)
+{
+    char *line, *eol, *str;
+    apr_size_t llen, i;
+    apr_int64_t n;
+
+    for (;;) {
+        line = buf + *pos;
+        eol = memchr(line, APR_ASCII_LF, len - *pos);
+        llen = eol - 1 - line;
+        *pos = eol + 1 - buf;
+        if (line[0] != '|') {
+            break;
+        }
+
+        /* the attributes are of no use here */
+        n = apr_strtoi64(line + 1, NULL, 10);
+        for (i = 0; n > 0 && i < 2 * (apr_size_t)n; i++) {
+            apr_redis_reply_t attr;
+
+            resp_parse(buf, len, pos, &attr, p, copy);
+        }
+    }
+
+    reply->status = APR_SUCCESS;
+    switch (line[0]) {
+    case '+':
+    case '-':
+        reply->type = line[0] == '+' ? APR_RR_STATUS : APR_RR_ERROR;
+        reply->str = resp_str(line + 1, llen - 1, p, copy);
+        reply->len = llen - 1;
+        if (line[0] == '-') {
+            reply->status = APR_EGENERAL;
+        }
+        break;
+
+    case ':':
+        reply->type = APR_RR_INTEGER;
+        reply->integer = apr_strtoi64(line + 1, NULL, 10);
+        break;
+
+    case '#':
+        reply->type = APR_RR_BOOLEAN;
+        reply->integer = line[1] == 't';
+        break;
+
+    case ',':
+    case '(':
+        reply->type = line[0] == ',' ? APR_RR_DOUBLE : APR_RR_BIGNUM;
+        reply->str = resp_str(line + 1, llen - 1, p, copy);
+        reply->len = llen - 1;
+        if (line[0] == ',') {
+            reply->number = strtod(reply->str, NULL);
+        }
+        break;
+
+    case '$':
+    case '=':
+    case '!':
+        n = apr_strtoi64(line + 1, NULL, 10);
+        if (n < 0) {
+            reply->type = APR_RR_NIL;
+            reply->status = APR_NOTFOUND;
+            break;
+        }
+        str = buf + *pos;
+        *pos += (apr_size_t)n + RC_EOL_LEN;
+        if (line[0] == '=' && n >= 4 && str[3] == ':') {
+            /* the format of a verbatim string, e.g. txt: */
+            str += 4;
+            n -= 4;
+        }
+        reply->type = line[0] == '!' ? APR_RR_ERROR : APR_RR_STRING;
+        reply->str = resp_str(str, (apr_size_t)n, p, copy);
+        reply->len = (apr_size_t)n;
+        if (line[0] == '!') {
+            reply->status = APR_EGENERAL;
+        }
+        break;
+
+    case '*':
+    case '~':
+    case '>':
+    case '%':
+        n = apr_strtoi64(line + 1, NULL, 10);
+        if (n < 0) {
+            reply->type = APR_RR_NIL;
+            reply->status = APR_NOTFOUND;
+            break;
+        }
+        reply->type = line[0] == '*' ? APR_RR_ARRAY
+                    : line[0] == '~' ? APR_RR_SET
+                    : line[0] == '>' ? APR_RR_PUSH : APR_RR_MAP;
+        reply->nelts = line[0] == '%' ? 2 * (apr_size_t)n : (apr_size_t)n;
+        reply->elts = apr_palloc(p, reply->nelts * sizeof(*reply->elts));
+        for (i = 0; i < reply->nelts; i++) {
+            reply->elts[i] = reply_make(p, APR_INCOMPLETE);
+            resp_parse(buf, len, pos, reply->elts[i], p, copy);
+        }
+        break;
+
+    default: /* '_' */
+        reply->type = APR_RR_NIL;
+        reply->status = APR_NOTFOUND;
+        break;
+    }
+}
+
+#define REPLY_BUFFER_SIZE 4096
+
+/* Read the next nreplies RESP replies of a connection, returning an error
+ * only when the connection is unusable (the error replies are not), with
+ * *nread the replies read before it.
+ *
+ * The data is received in a buffer allocated from p, where the replies
+ * are parsed in place: their strings point in it rather than being copied
+ * again, and the elements of the arrays are found in one scan.  Only what
+ * the line reads of the other commands left in conn->bb is copied to it,
+ * and what is read past the replies is put back there.
+ */
+static apr_status_t read_replies(apr_redis_conn_t *conn,
+                                 apr_redis_reply_t **replies, int nreplies,
+                                 int *nread, apr_pool_t *p)
+{
+    apr_size_t size = REPLY_BUFFER_SIZE, len = 0, pos = 0, scan = 0;
+    apr_size_t pending = 1, need = 0;
+    char *buf = apr_palloc(p, size);
+    apr_status_t rv = APR_SUCCESS;
+
+    *nread = 0;
+
+    while (!APR_BRIGADE_EMPTY(conn->bb)) {
+        apr_bucket *e = APR_BRIGADE_FIRST(conn->bb);
+        const char *str;
+        apr_size_t n;
+
+        if (APR_BUCKET_IS_SOCKET(e)) {
+            break;
+        }
+        rv = apr_bucket_read(e, &str, &n, APR_BLOCK_READ);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (n > size - len) {
+            char *nbuf;
+
+            size = len + n;
+            nbuf = apr_palloc(p, size);
+            memcpy(nbuf, buf, len);
+            buf = nbuf;
+        }
+        memcpy(buf + len, str, n);
+        len += n;
+        apr_bucket_delete(e);
+    }
+
+    for (;;) {
+        apr_size_t n;
+
+        while (*nread < nreplies) {
+            rv = resp_scan(buf, len, &scan, &pending, &need);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            resp_parse(buf, len, &pos, replies[(*nread)++], p, 0);
+            pending = 1;
+        }
+        if (rv != APR_INCOMPLETE) {
+            break;
+        }
+
+        if (need > size || len == size) {
+            /* the replies parsed keep pointing in the previous buffer,
+             * only the incomplete one is moved */
+            apr_size_t keep = len - pos, nsize = keep * 2;
+            char *nbuf;
+
+            if (nsize < REPLY_BUFFER_SIZE) {
+                nsize = REPLY_BUFFER_SIZE;
+            }
+            if (nsize < need - pos) {
+                nsize = need - pos;
+            }
+            nbuf = apr_palloc(p, nsize);
+            memcpy(nbuf, buf + pos, keep);
+            buf = nbuf;
+            size = nsize;
+            len = keep;
+            scan -= pos;
+            pos = 0;
+        }
+
+        if (APR_BRIGADE_EMPTY(conn->bb)) {
+            /* the end of the connection was read */
+            rv = APR_EOF;
+            break;
+        }
+        n = size - len;
+        rv = apr_socket_recv(conn->sock, buf + len, &n);
+        len += n;
+        if (rv != APR_SUCCESS && !n) {
+            if (APR_STATUS_IS_EOF(rv)) {
+                apr_bucket_delete(APR_BRIGADE_FIRST(conn->bb));
+            }
+            break;
+        }
+    }
+
+    if (pos < len) {
+        apr_bucket *e = apr_bucket_heap_create(buf + pos, len - pos, NULL,
+                                               conn->ba);
+        APR_BRIGADE_INSERT_HEAD(conn->bb, e);
+    }
+
+    return rv;
+}
+
+/* Read the next RESP reply of a connection, see read_replies() */
+static apr_status_t read_reply(apr_redis_conn_t *conn,
+                               apr_redis_reply_t *reply,
+                               apr_pool_t *p)
+{
+    int nread;
+
+    return read_replies(conn, &reply, 1, &nread, p);
+}
+
+/* Send a command on a connection and read its reply */
+static apr_status_t conn_command(apr_redis_conn_t *conn,
+                                 apr_size_t argc,
+                                 const char * const *argv,
+                                 apr_redis_reply_t *reply,
+                                 apr_pool_t *p)
+{
+    apr_bucket_brigade *bb = apr_brigade_create(p, conn->ba);
+    apr_size_t written;
+    apr_status_t rv = APR_SUCCESS;
+
+    resp_command(bb, argc, argv, NULL);
+    while (!APR_BRIGADE_EMPTY(bb) && rv == APR_SUCCESS) {
+        rv = apr_brigade_write_socket(bb, conn->sock, &written);
+    }
+    apr_brigade_destroy(bb);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    memset(reply, 0, sizeof(*reply));
+    return read_reply(conn, reply, p);
+}
+
+/* Redirect the invalidations of the keys read by a connection to the
+ * subscription of its server */
+static apr_status_t conn_track(apr_redis_conn_t *conn)
+{
+    apr_redis_reply_t reply;
+    const char *argv[5];
+    apr_status_t rv;
+
+    argv[0] = "CLIENT";
+    argv[1] = "TRACKING";
+    argv[2] = "on";
+    argv[3] = "REDIRECT";
+    argv[4] = apr_psprintf(conn->p, "%" APR_INT64_T_FMT,
+                           conn->rs->tracking_id);
+
+    rv = conn_command(conn, 5, argv, &reply, conn->p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (reply.type != APR_RR_STATUS) {
+        return APR_EGENERAL;
+    }
+
+    conn->tracking_id = conn->rs->tracking_id;
+    return APR_SUCCESS;
+}
+
+static void pipeline_fail(pipeline_server_t *ps, int from, apr_status_t rv)
+{
+    int i;
+
+    for (i = from; i < ps->replies->nelts; i++) {
+        APR_ARRAY_IDX(ps->replies, i, apr_redis_reply_t *)->status = rv;
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_redis_pipeline_exec(apr_redis_pipeline_t *pl)
+{
+    apr_status_t rv, status = APR_SUCCESS;
+    apr_hash_index_t *hi;
+
+    /* send everything first, so that all the servers work concurrently */
+    for (hi = apr_hash_first(NULL, pl->servers); hi; hi = apr_hash_next(hi)) {
+        pipeline_server_t *ps = apr_hash_this_val(hi);
+        apr_size_t written;
+
+        if (ps->replies->nelts == 0) {
+            continue;
+        }
+
+        rv = rs_find_conn(ps->rs, &ps->conn);
+        if (rv != APR_SUCCESS) {
+            apr_redis_disable_server(pl->rc, ps->rs);
+            ps->conn = NULL;
+        }
+        else {
+            while (!APR_BRIGADE_EMPTY(ps->bb)) {
+                rv = apr_brigade_write_socket(ps->bb, ps->conn->sock,
+                                              &written);
+                if (rv != APR_SUCCESS) {
+                    rs_bad_conn(ps->rs, ps->conn);
+                    apr_redis_disable_server(pl->rc, ps->rs);
+                    ps->conn = NULL;
+                    break;
+                }
+            }
+        }
+        if (rv != APR_SUCCESS) {
+            pipeline_fail(ps, 0, rv);
+            if (status == APR_SUCCESS) {
+                status = rv;
+            }
+        }
+    }
+
+    /* then read the replies, in order for each server */
+    for (hi = apr_hash_first(NULL, pl->servers); hi; hi = apr_hash_next(hi)) {
+        pipeline_server_t *ps = apr_hash_this_val(hi);
+        int i;
+
+        if (ps->conn) {
+            rv = read_replies(ps->conn,
+                              (apr_redis_reply_t **)ps->replies->elts,
+                              ps->replies->nelts, &i, pl->rpool);
+            if (rv != APR_SUCCESS) {
+                rs_bad_conn(ps->rs, ps->conn);
+                apr_redis_disable_server(pl->rc, ps->rs);
+                pipeline_fail(ps, i, rv);
+                if (status == APR_SUCCESS) {
+                    status = rv;
+                }
+            }
+            else {
+                rs_release_conn(ps->rs, ps->conn);
+            }
+            ps->conn = NULL;
+        }
+
+        /* ready for the next commands */
+        apr_brigade_cleanup(ps->bb);
+        apr_array_clear(ps->replies);
+    }
+
+    return status;
+}
+
+/* The keys of a multiple command sent to one server */
+typedef struct
+{
+    apr_redis_server_t *rs;
+    apr_array_header_t *argv;
+    apr_array_header_t *argvlen;
+    apr_array_header_t *values;
+    apr_redis_reply_t *reply;
+} multi_group_t;
+
+static multi_group_t *multi_group(apr_redis_t *rc, apr_hash_t *groups,
+                                  const char *cmd, const char *key,
+                                  apr_pool_t *p)
+{
+    apr_redis_server_t *rs;
+    multi_group_t *g;
+    apr_uint32_t hash;
+    apr_size_t klen = strlen(key);
+
+    hash = apr_redis_hash(rc, key, klen);
+    rs = apr_redis_find_server_hash(rc, hash);
+    if (rs == NULL) {
+        return NULL;
+    }
+
+    g = apr_hash_get(groups, &rs, sizeof(rs));
+    if (!g) {
+        g = apr_pcalloc(p, sizeof(*g));
+        g->rs = rs;
+        g->argv = apr_array_make(p, 16, sizeof(const char *));
+        g->argvlen = apr_array_make(p, 16, sizeof(apr_size_t));
+        g->values = apr_array_make(p, 16, sizeof(apr_redis_value_t *));
+        APR_ARRAY_PUSH(g->argv, const char *) = cmd;
+        APR_ARRAY_PUSH(g->argvlen, apr_size_t) = strlen(cmd);
+        apr_hash_set(groups, &g->rs, sizeof(rs), g);
+    }
+
+    APR_ARRAY_PUSH(g->argv, const char *) = key;
+    APR_ARRAY_PUSH(g->argvlen, apr_size_t) = klen;
+    return g;
+}
+
+static apr_status_t multi_exec(apr_redis_pipeline_t *pl, apr_hash_t *groups)
+{
+    apr_hash_index_t *hi;
+
+    for (hi = apr_hash_first(NULL, groups); hi; hi = apr_hash_next(hi)) {
+        multi_group_t *g = apr_hash_this_val(hi);
+
+        pipeline_add_server(pl, g->rs, g->argv->nelts,
+                            (const char * const *)g->argv->elts,
+                            (const apr_size_t *)g->argvlen->elts, &g->reply);
+    }
+
+    return apr_redis_pipeline_exec(pl);
+}
+
+APR_DECLARE(apr_status_t)
+apr_redis_multgetp(apr_redis_t *rc,
+                   apr_pool_t *temp_pool,
+                   apr_pool_t *data_pool,
+                   apr_hash_t *values)
+{
+    apr_redis_pipeline_t *pl;
+    apr_hash_t *groups = apr_hash_make(temp_pool);
+    apr_hash_index_t *hi;
+    apr_status_t rv;
+    int i;
+
+    /*
+     * RESP Command, per server:
+     *   *<1 + nkeys>
+     *   $4
+     *   MGET
+     *   $<keylen>
+     *   key
+     *   ...
+     */
+    for (hi = apr_hash_first(temp_pool, values); hi; hi = apr_hash_next(hi)) {
+        apr_redis_value_t *value = apr_hash_this_val(hi);
+        multi_group_t *g;
+
+        if (rc->nearcache
+                && apr_nearcache_get(rc->nearcache, value->key,
+                                     strlen(value->key), data_pool,
+                                     &value->data, &value->len,
+                                     NULL) == APR_SUCCESS) {
+            value->status = APR_SUCCESS;
+            continue;
+        }
+
+        g = multi_group(rc, groups, "MGET", value->key, temp_pool);
+        if (!g) {
+            value->status = APR_NOTFOUND;
+            continue;
+        }
+        APR_ARRAY_PUSH(g->values, apr_redis_value_t *) = value;
+    }
+
+    apr_redis_pipeline_create(&pl, rc, temp_pool);
+    pl->rpool = data_pool;
+    rv = multi_exec(pl, groups);
+
+    for (hi = apr_hash_first(temp_pool, groups); hi; hi = apr_hash_next(hi)) {
+        multi_group_t *g = apr_hash_this_val(hi);
+        apr_redis_reply_t *reply = g->reply;
+        int ok = (reply->type == APR_RR_ARRAY
+                  && reply->nelts == (apr_size_t)g->values->nelts);
+
+        for (i = 0; i < g->values->nelts; i++) {
+            apr_redis_value_t *value = APR_ARRAY_IDX(g->values, i,
+                                                     apr_redis_value_t *);
+            if (ok) {
+                apr_redis_reply_t *elt = reply->elts[i];
+
+                value->status = elt->status;
+                value->data = elt->str;
+                value->len = elt->len;
+                if (rc->nearcache && elt->type == APR_RR_STRING) {
+                    apr_nearcache_set(rc->nearcache, value->key,
+                                      strlen(value->key), value->data,
+                                      value->len, 0, 0);
+                }
+            }
+            else {
+                value->status = reply->status != APR_SUCCESS ? reply->status
+                                                             : APR_EGENERAL;
+            }
+        }
+    }
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t)
+apr_redis_multset(apr_redis_t *rc,
+                  apr_pool_t *temp_pool,
+                  apr_hash_t *values)
+{
+    apr_redis_pipeline_t *pl;
+    apr_hash_t *groups = apr_hash_make(temp_pool);
+    apr_hash_index_t *hi;
+    apr_status_t rv;
+    int i;
+
+    /*
+     * RESP Command, per server:
+     *   *<1 + 2 * nkeys>
+     *   $4
+     *   MSET
+     *   $<keylen>
+     *   key
+     *   $<datalen>
+     *   data
+     *   ...
+     */
+    for (hi = apr_hash_first(temp_pool, values); hi; hi = apr_hash_next(hi)) {
+        apr_redis_value_t *value = apr_hash_this_val(hi);
+        multi_group_t *g;
+
+        nearcache_delete(rc, value->key, strlen(value->key));
+        g = multi_group(rc, groups, "MSET", value->key, temp_pool);
+
+        if (!g) {
+            value->status = APR_NOTFOUND;
+            continue;
+        }
+        APR_ARRAY_PUSH(g->argv, const char *) = value->data;
+        APR_ARRAY_PUSH(g->argvlen, apr_size_t) = value->len;
+        APR_ARRAY_PUSH(g->values, apr_redis_value_t *) = value;
+    }
+
+    apr_redis_pipeline_create(&pl, rc, temp_pool);
+    rv = multi_exec(pl, groups);
+
+    for (hi = apr_hash_first(temp_pool, groups); hi; hi = apr_hash_next(hi)) {
+        multi_group_t *g = apr_hash_this_val(hi);
+
+        for (i = 0; i < g->values->nelts; i++) {
+            APR_ARRAY_IDX(g->values, i, apr_redis_value_t *)->status =
+                g->reply->status;
+        }
+    }
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t)
+apr_redis_multdelete(apr_redis_t *rc,
+                     apr_pool_t *temp_pool,
+                     const apr_array_header_t *keys,
+                     apr_uint32_t *deleted)
+{
+    apr_redis_pipeline_t *pl;
+    apr_hash_t *groups = apr_hash_make(temp_pool);
+    apr_hash_index_t *hi;
+    apr_status_t rv;
+    int i;
+
+    if (deleted) {
+        *deleted = 0;
+    }
+
+    /*
+     * RESP Command, per server:
+     *   *<1 + nkeys>
+     *   $3
+     *   DEL
+     *   $<keylen>
+     *   key
+     *   ...
+     */
+    for (i = 0; i < keys->nelts; i++) {
+        const char *key = APR_ARRAY_IDX(keys, i, const char *);
+
+        nearcache_delete(rc, key, strlen(key));
+        multi_group(rc, groups, "DEL", key, temp_pool);
+    }
+
+    apr_redis_pipeline_create(&pl, rc, temp_pool);
+    rv = multi_exec(pl, groups);
+
+    for (hi = apr_hash_first(temp_pool, groups); hi; hi = apr_hash_next(hi)) {
+        multi_group_t *g = apr_hash_this_val(hi);
+
+        if (g->reply->type == APR_RR_INTEGER) {
+            if (deleted) {
+                *deleted += (apr_uint32_t)g->reply->integer;
+            }
+        }
+        else if (rv == APR_SUCCESS) {
+            rv = g->reply->status != APR_SUCCESS ? g->reply->status
+                                                 : APR_EGENERAL;
+        }
+    }
+
+    return rv;
+}
+
+struct apr_redis_tracking_t
+{
+    apr_redis_t *rc;
+    apr_redis_conn_t *conn;
+    apr_pool_t *mpool;      /* for a message, cleared after each */
+    apr_status_t status;
+};
+
+APR_DECLARE(apr_status_t) apr_redis_tracking_create(apr_redis_tracking_t **tr,
+                                                    apr_redis_t *rc,
+                                                    apr_redis_server_t *rs,
+                                                    apr_pool_t *p)
+{
+    apr_redis_tracking_t *t;
+    apr_redis_reply_t reply;
+    const char *argv[2];
+    apr_status_t rv;
+    void *conn;
+
+    t = apr_pcalloc(p, sizeof(*t));
+    t->rc = rc;
+
+    rv = apr_pool_create(&t->mpool, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* a connection of its own, closed with its pool (a subpool of p) */
+    rv = rc_conn_construct(&conn, rs, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    t->conn = conn;
+    APR_BRIGADE_INSERT_TAIL(t->conn->bb,
+                            apr_bucket_socket_create(t->conn->sock,
+                                                     t->conn->ba));
+
+    argv[0] = "CLIENT";
+    argv[1] = "ID";
+    rv = conn_command(t->conn, 2, argv, &reply, t->mpool);
+    if (rv == APR_SUCCESS && reply.type != APR_RR_INTEGER) {
+        rv = APR_EGENERAL;
+    }
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(t->conn->p);
+        return rv;
+    }
+
+    /*
+     * RESP Reply:
+     *   *3
+     *   $9
+     *   subscribe
+     *   $20
+     *   __redis__:invalidate
+     *   :1
+     */
+    argv[0] = "SUBSCRIBE";
+    argv[1] = "__redis__:invalidate";
+    rs->tracking_id = reply.integer;
+    rv = conn_command(t->conn, 2, argv, &reply, t->mpool);
+    if (rv == APR_SUCCESS && reply.type != APR_RR_ARRAY) {
+        rv = APR_EGENERAL;
+    }
+    apr_pool_clear(t->mpool);
+    if (rv != APR_SUCCESS) {
+        rs->tracking_id = 0;
+        apr_pool_destroy(t->conn->p);
+        return rv;
+    }
+
+    *tr = t;
+    return APR_SUCCESS;
+}
+
+/* Whether a reply is buffered already, or the socket readable in time */
+static apr_status_t tracking_wait(apr_redis_tracking_t *tr,
+                                  apr_interval_time_t timeout)
+{
+    apr_bucket_brigade *bb = tr->conn->bb;
+    apr_bucket *e;
+    apr_pollfd_t pfd;
+    apr_int32_t nsds;
+    apr_status_t rv;
+
+    for (e = APR_BRIGADE_FIRST(bb); e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e)) {
+        if (APR_BUCKET_IS_SOCKET(e)) {
+            break;
+        }
+        if (e->length) {
+            return APR_SUCCESS;
+        }
+    }
+    if (e == APR_BRIGADE_SENTINEL(bb)) {
+        /* the end of the connection was read */
+        return APR_EOF;
+    }
+
+    pfd.p = tr->mpool;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = tr->conn->sock;
+    pfd.client_data = NULL;
+    do {
+        rv = apr_poll(&pfd, 1, &nsds, timeout);
+    } while (APR_STATUS_IS_EINTR(rv));
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_redis_tracking_process(apr_redis_tracking_t *tr,
+                                            apr_interval_time_t timeout)
+{
+    apr_nearcache_t *nc = tr->rc->nearcache;
+    apr_redis_reply_t reply;
+    apr_status_t rv;
+    int processed = 0;
+
+    if (tr->status != APR_SUCCESS) {
+        return tr->status;
+    }
+
+    /*
+     * RESP Message:
+     *   *3
+     *   $7
+     *   message
+     *   $20
+     *   __redis__:invalidate
+     *   *<nkeys>, or *-1 when the server's keys are all flushed
+     *   $<keylen>
+     *   key
+     *   ...
+     */
+    while ((rv = tracking_wait(tr, processed ? 0 : timeout)) == APR_SUCCESS) {
+        memset(&reply, 0, sizeof(reply));
+        rv = read_reply(tr->conn, &reply, tr->mpool);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        processed++;
+
+        if (nc && reply.type == APR_RR_ARRAY && reply.nelts == 3
+                && reply.elts[0]->type == APR_RR_STRING
+                && strcmp(reply.elts[0]->str, "message") == 0) {
+            apr_redis_reply_t *keys = reply.elts[2];
+
+            if (keys->type == APR_RR_ARRAY) {
+                apr_size_t i;
+
+                for (i = 0; i < keys->nelts; i++) {
+                    if (keys->elts[i]->type == APR_RR_STRING) {
+                        apr_nearcache_delete(nc, keys->elts[i]->str,
+                                             keys->elts[i]->len);
+                    }
+                }
+            }
+            else {
+                apr_nearcache_clear(nc);
+            }
+        }
+        apr_pool_clear(tr->mpool);
+    }
+    apr_pool_clear(tr->mpool);
+
+    if (APR_STATUS_IS_TIMEUP(rv)) {
+        return processed ? APR_SUCCESS : APR_TIMEUP;
+    }
+
+    /* invalidations may have been missed */
+    if (nc) {
+        apr_nearcache_clear(nc);
+    }
+    tr->status = rv;
+    return rv;
+}
+
+/* A command sent on an asynchronous connection, awaiting its reply */
+typedef struct async_request_t async_request_t;
+struct async_request_t
+{
+    async_request_t *next;
+    apr_redis_async_cb_t *func;
+    void *baton;
+    apr_pool_t *p;
+};
+
+struct apr_redis_async_t
+{
+    apr_redis_conn_t *conn;
+    apr_pollcb_t *pollcb;
+    apr_pollfd_t pfd;
+    int polled;                 /* pfd is in the pollcb */
+    apr_bucket_brigade *out;    /* the commands not written yet */
+    char *in;                   /* the replies read, not parsed yet */
+    apr_size_t in_size, in_len, in_pos;
+    async_request_t *head, *tail, *free;
+    apr_size_t pending;
+    apr_status_t status;
+};
+
+#define ASYNC_BUFFER_SIZE 4096
+
+static apr_status_t async_cleanup(void *data)
+{
+    apr_redis_async_t *ac = data;
+
+    if (ac->polled) {
+        apr_pollcb_remove(ac->pollcb, &ac->pfd);
+        ac->polled = 0;
+    }
+    return APR_SUCCESS;
+}
+
+/* Poll for writability too while some commands could not be written */
+static apr_status_t async_poll(apr_redis_async_t *ac, apr_int16_t reqevents)
+{
+    apr_status_t rv;
+
+    if (ac->pfd.reqevents == reqevents) {
+        return APR_SUCCESS;
+    }
+    /* the pollcb API has no portable modification of the events */
+    rv = apr_pollcb_remove(ac->pollcb, &ac->pfd);
+    if (rv == APR_SUCCESS) {
+        ac->pfd.reqevents = reqevents;
+        rv = apr_pollcb_add(ac->pollcb, &ac->pfd);
+    }
+    if (rv != APR_SUCCESS) {
+        ac->polled = 0;
+    }
+    return rv;
+}
+
+static apr_status_t async_write(apr_redis_async_t *ac)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t written;
+
+    while (!APR_BRIGADE_EMPTY(ac->out)) {
+        rv = apr_brigade_write_socket(ac->out, ac->conn->sock, &written);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    if (rv != APR_SUCCESS && !APR_STATUS_IS_EAGAIN(rv)) {
+        return rv;
+    }
+
+    return async_poll(ac, APR_BRIGADE_EMPTY(ac->out)
+                          ? APR_POLLIN : APR_POLLIN | APR_POLLOUT);
+}
+
+/* Call back the commands whose reply is complete, in order */
+static apr_status_t async_replies(apr_redis_async_t *ac)
+{
+    while (ac->in_pos < ac->in_len) {
+        async_request_t *req = ac->head;
+        apr_redis_reply_t *reply;
+        apr_size_t pos = ac->in_pos, pending = 1, need;
+        apr_status_t rv;
+
+        if (!req) {
+            /* nothing was asked */
+            return APR_EGENERAL;
+        }
+        rv = resp_scan(ac->in, ac->in_len, &pos, &pending, &need);
+        if (rv == APR_INCOMPLETE) {
+            break;
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        reply = reply_make(req->p, APR_INCOMPLETE);
+        pos = ac->in_pos;
+        resp_parse(ac->in, ac->in_len, &pos, reply, req->p, 1);
+        ac->in_pos = pos;
+
+        ac->head = req->next;
+        if (!ac->head) {
+            ac->tail = NULL;
+        }
+        ac->pending--;
+        req->func(ac, reply, req->baton);
+
+        req->next = ac->free;
+        ac->free = req;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t async_read(apr_redis_async_t *ac)
+{
+    apr_status_t rv;
+
+    for (;;) {
+        apr_size_t len;
+
+        if (ac->in_pos == ac->in_len) {
+            ac->in_pos = ac->in_len = 0;
+        }
+        if (ac->in_len == ac->in_size) {
+            if (ac->in_pos) {
+                memmove(ac->in, ac->in + ac->in_pos, ac->in_len - ac->in_pos);
+                ac->in_len -= ac->in_pos;
+                ac->in_pos = 0;
+            }
+            else {
+                /* a reply larger than the buffer */
+                char *in = apr_palloc(ac->conn->p, ac->in_size * 2);
+
+                memcpy(in, ac->in, ac->in_len);
+                ac->in = in;
+                ac->in_size *= 2;
+            }
+        }
+
+        len = ac->in_size - ac->in_len;
+        rv = apr_socket_recv(ac->conn->sock, ac->in + ac->in_len, &len);
+        if (len) {
+            apr_status_t arv;
+
+            ac->in_len += len;
+            arv = async_replies(ac);
+            if (arv != APR_SUCCESS) {
+                return arv;
+            }
+        }
+        if (rv != APR_SUCCESS) {
+            return APR_STATUS_IS_EAGAIN(rv) ? APR_SUCCESS : rv;
+        }
+    }
+}
+
+/* Call back the pending commands with the error of the connection */
+static void async_fail(apr_redis_async_t *ac)
+{
+    async_cleanup(ac);
+
+    while (ac->head) {
+        async_request_t *req = ac->head;
+
+        ac->head = req->next;
+        ac->pending--;
+        req->func(ac, reply_make(req->p, ac->status), req->baton);
+    }
+    ac->tail = NULL;
+}
+
+APR_DECLARE(apr_status_t) apr_redis_async_create(apr_redis_async_t **ac,
+                                                 apr_redis_server_t *rs,
+                                                 apr_pollcb_t *pollcb,
+                                                 void *client_data,
+                                                 apr_pool_t *p)
+{
+    apr_redis_async_t *nac;
+    apr_status_t rv;
+    void *conn;
+
+    /* a connection of its own, closed with its pool (a subpool of p) */
+    rv = rc_conn_construct(&conn, rs, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    nac = apr_pcalloc(p, sizeof(*nac));
+    nac->conn = conn;
+    nac->pollcb = pollcb;
+    nac->out = apr_brigade_create(nac->conn->p, nac->conn->ba);
+    nac->in_size = ASYNC_BUFFER_SIZE;
+    nac->in = apr_palloc(nac->conn->p, nac->in_size);
+
+    rv = apr_socket_timeout_set(nac->conn->sock, 0);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(nac->conn->p);
+        return rv;
+    }
+
+    nac->pfd.p = nac->conn->p;
+    nac->pfd.desc_type = APR_POLL_SOCKET;
+    nac->pfd.reqevents = APR_POLLIN;
+    nac->pfd.desc.s = nac->conn->sock;
+    nac->pfd.client_data = client_data ? client_data : nac;
+    rv = apr_pollcb_add(pollcb, &nac->pfd);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(nac->conn->p);
+        return rv;
+    }
+    nac->polled = 1;
+
+    /* out of the pollcb before the socket is closed */
+    apr_pool_pre_cleanup_register(p, nac, async_cleanup);
+
+    *ac = nac;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_redis_async_command(apr_redis_async_t *ac,
+                                                  apr_pool_t *p,
+                                                  apr_size_t argc,
+                                                  const char * const *argv,
+                                                  const apr_size_t *argvlen,
+                                                  apr_redis_async_cb_t *func,
+                                                  void *baton)
+{
+    apr_bucket_brigade *bb;
+    async_request_t *req;
+    apr_bucket *e;
+
+    if (ac->status != APR_SUCCESS) {
+        return ac->status;
+    }
+    if (argc == 0) {
+        return APR_EINVAL;
+    }
+
+    req = ac->free;
+    if (req) {
+        ac->free = req->next;
+    }
+    else {
+        req = apr_palloc(ac->conn->p, sizeof(*req));
+    }
+    req->next = NULL;
+    req->func = func;
+    req->baton = baton;
+    req->p = p;
+    if (ac->tail) {
+        ac->tail->next = req;
+    }
+    else {
+        ac->head = req;
+    }
+    ac->tail = req;
+    ac->pending++;
+
+    /* the large arguments are not copied by resp_command(), but may not
+     * be written before this returns */
+    bb = ac->conn->tb;
+    resp_command(bb, argc, argv, argvlen);
+    for (e = APR_BRIGADE_FIRST(bb); e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e)) {
+        apr_bucket_setaside(e, ac->conn->p);
+    }
+    APR_BRIGADE_CONCAT(ac->out, bb);
+
+    /* written right away unless the previous commands wait for the socket
+     * to be writable, a write error failing the commands from
+     * apr_redis_async_process() once the socket is signalled */
+    if (ac->pfd.reqevents == APR_POLLIN) {
+        ac->status = async_write(ac);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_redis_async_get(apr_redis_async_t *ac,
+                                              apr_pool_t *p,
+                                              const char *key,
+                                              apr_redis_async_cb_t *func,
+                                              void *baton)
+{
+    const char *argv[2];
+
+    argv[0] = "GET";
+    argv[1] = key;
+    return apr_redis_async_command(ac, p, 2, argv, NULL, func, baton);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_async_set(apr_redis_async_t *ac,
+                                              apr_pool_t *p,
+                                              const char *key,
+                                              const char *data,
+                                              apr_size_t data_size,
+                                              apr_redis_async_cb_t *func,
+                                              void *baton)
+{
+    const char *argv[3];
+    apr_size_t argvlen[3];
+
+    argv[0] = "SET";
+    argvlen[0] = 3;
+    argv[1] = key;
+    argvlen[1] = strlen(key);
+    argv[2] = data;
+    argvlen[2] = data_size;
+    return apr_redis_async_command(ac, p, 3, argv, argvlen, func, baton);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_async_mget(apr_redis_async_t *ac,
+                                               apr_pool_t *p,
+                                               apr_size_t nkeys,
+                                               const char * const *keys,
+                                               apr_redis_async_cb_t *func,
+                                               void *baton)
+{
+    const char **argv;
+
+    if (nkeys == 0) {
+        return APR_EINVAL;
+    }
+    argv = apr_palloc(p, (nkeys + 1) * sizeof(*argv));
+    argv[0] = "MGET";
+    memcpy(argv + 1, keys, nkeys * sizeof(*argv));
+    return apr_redis_async_command(ac, p, nkeys + 1, argv, NULL, func, baton);
+}
+
+APR_DECLARE(apr_status_t) apr_redis_async_process(apr_redis_async_t *ac,
+                                                  apr_int16_t rtnevents)
+{
+    if (ac->status == APR_SUCCESS && !APR_BRIGADE_EMPTY(ac->out)
+            && (rtnevents & (APR_POLLOUT | APR_POLLERR | APR_POLLHUP))) {
+        ac->status = async_write(ac);
+    }
+    if (ac->status == APR_SUCCESS
+            && (rtnevents & (APR_POLLIN | APR_POLLERR | APR_POLLHUP))) {
+        ac->status = async_read(ac);
+    }
+    if (ac->status != APR_SUCCESS) {
+        async_fail(ac);
+    }
+    return ac->status;
+}
+
+APR_DECLARE(apr_size_t) apr_redis_async_pending(apr_redis_async_t *ac)
 {
-    return APR_ENOTIMPL;
+    return ac->pending;
 }
 
 /**
@@ -23,6 +23,25 @@
 #include "apr_strings.h"
 #include "apr_hash.h"
 
+#if defined(HAVE_SYS_SYSCALL_H)
+#include <sys/syscall.h>
+#endif
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+#define SHM_HAS_MBIND 1
+#define SHM_NUMA_MASK_LONGS 16
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+#ifndef MPOL_F_MEMS_ALLOWED
+#define MPOL_F_MEMS_ALLOWED (1 << 2)
+#endif
+#endif
+
+/* The (default) size of the reserved huge pages, which the hugetlb
+ * segments are rounded up to.
+ */
+#define SHM_HUGEPAGE_SIZE ((apr_size_t)1 << 21)
+
 #if APR_USE_SHMEM_MMAP_SHM
 /* 
  *   For portable use, a shared memory object should be identified by a name of
@@ -78,6 +97,117 @@ static key_t our_ftok(const char *filename)
 }
 #endif
 
+#if APR_USE_SHMEM_SHMGET || APR_USE_SHMEM_SHMGET_ANON
+static int shm_get(key_t key, apr_size_t *size, int shmflg, apr_int32_t flags)
+{
+#if defined(SHM_HUGETLB)
+    if (flags & APR_SHM_HUGEPAGES) {
+        apr_size_t hugesize = APR_ALIGN(*size, SHM_HUGEPAGE_SIZE);
+        int shmid = shmget(key, hugesize, shmflg | SHM_HUGETLB);
+
+        if (shmid >= 0) {
+            *size = hugesize;
+            return shmid;
+        }
+    }
+#endif
+    return shmget(key, *size, shmflg);
+}
+#endif
+
+#if APR_USE_SHMEM_MMAP_ANON
+static void *shm_map_anon(apr_size_t *size, apr_int32_t flags)
+{
+    void *base = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+    if (flags & APR_SHM_HUGEPAGES) {
+        apr_size_t hugesize = APR_ALIGN(*size, SHM_HUGEPAGE_SIZE);
+
+        base = mmap(NULL, hugesize, PROT_READ|PROT_WRITE,
+                    MAP_ANON|MAP_SHARED|MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            *size = hugesize;
+            return base;
+        }
+    }
+#endif
+    return mmap(NULL, *size, PROT_READ|PROT_WRITE,
+                MAP_ANON|MAP_SHARED, -1, 0);
+}
+#endif
+
+#if SHM_HAS_MBIND
+static apr_status_t shm_interleave(void *base, apr_size_t size)
+{
+    unsigned long mask[SHM_NUMA_MASK_LONGS];
+    int mode;
+
+    memset(mask, 0, sizeof(mask));
+    if (syscall(SYS_get_mempolicy, &mode, mask,
+                (unsigned long)sizeof(mask) * 8, NULL,
+                MPOL_F_MEMS_ALLOWED) != 0
+        || syscall(SYS_mbind, base, size, MPOL_INTERLEAVE, mask,
+                   (unsigned long)sizeof(mask) * 8 + 1, 0) != 0) {
+        /* Not a NUMA kernel, or not allowed here */
+        if (errno == ENOSYS || errno == EPERM) {
+            return APR_SUCCESS;
+        }
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+#endif
+
+/* Apply the flags to a newly created segment.  The placement of the
+ * pages goes first since prefaulting and locking them allocate them.
+ */
+static apr_status_t shm_apply_flags(apr_shm_t *m, apr_int32_t flags)
+{
+#if defined(MADV_HUGEPAGE)
+    if (flags & APR_SHM_HUGEPAGES) {
+        /* Fails for hugetlb segments already, or without THP */
+        (void)madvise(m->base, m->realsize, MADV_HUGEPAGE);
+    }
+#endif
+#if SHM_HAS_MBIND
+    if (flags & APR_SHM_NUMA_INTERLEAVE) {
+        apr_status_t rv = shm_interleave(m->base, m->realsize);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+    if (flags & APR_SHM_PREFAULT) {
+#if defined(MADV_POPULATE_WRITE)
+        if (madvise(m->base, m->realsize, MADV_POPULATE_WRITE) != 0)
+#endif
+        {
+            volatile char *p = m->base;
+            apr_size_t pagesize, off;
+
+#if defined(_SC_PAGESIZE)
+            pagesize = (apr_size_t)sysconf(_SC_PAGESIZE);
+#else
+            pagesize = 4096;
+#endif
+            for (off = 0; off < m->realsize; off += pagesize) {
+                p[off] = p[off];
+            }
+        }
+    }
+    if (flags & APR_SHM_MLOCK) {
+#if defined(HAVE_SYS_MMAN_H)
+        if (mlock(m->base, m->realsize) != 0) {
+            return errno;
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+    }
+    return APR_SUCCESS;
+}
+
 static apr_status_t shm_cleanup_owner(void *m_)
 {
     apr_shm_t *m = (apr_shm_t *)m_;
@@ -141,10 +271,11 @@ static apr_status_t shm_cleanup_owner(void *m_)
     }
 }
 
-APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
-                                         apr_size_t reqsize, 
-                                         const char *filename,
-                                         apr_pool_t *pool)
+APR_DECLARE(apr_status_t) apr_shm_create_ex(apr_shm_t **m,
+                                            apr_size_t reqsize,
+                                            const char *filename,
+                                            apr_pool_t *pool,
+                                            apr_int32_t flags)
 {
     apr_shm_t *new_m;
     apr_status_t status;
@@ -197,6 +328,12 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
             return status;
         }
 
+        status = shm_apply_flags(new_m, flags);
+        if (status != APR_SUCCESS) {
+            shm_cleanup_owner(new_m);
+            return status;
+        }
+
         /* store the real size in the metadata */
         *(apr_size_t*)(new_m->base) = new_m->realsize;
         /* metadata isn't usable */
@@ -208,12 +345,17 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
         return APR_SUCCESS;
 
 #elif APR_USE_SHMEM_MMAP_ANON
-        new_m->base = mmap(NULL, new_m->realsize, PROT_READ|PROT_WRITE,
-                           MAP_ANON|MAP_SHARED, -1, 0);
+        new_m->base = shm_map_anon(&new_m->realsize, flags);
         if (new_m->base == (void *)MAP_FAILED) {
             return errno;
         }
 
+        status = shm_apply_flags(new_m, flags);
+        if (status != APR_SUCCESS) {
+            shm_cleanup_owner(new_m);
+            return status;
+        }
+
         /* store the real size in the metadata */
         *(apr_size_t*)(new_m->base) = new_m->realsize;
         /* metadata isn't usable */
@@ -232,8 +374,8 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
         new_m->realsize = reqsize;
         new_m->filename = NULL;
         new_m->shmkey = IPC_PRIVATE;
-        if ((new_m->shmid = shmget(new_m->shmkey, new_m->realsize,
-                                   SHM_R | SHM_W | IPC_CREAT)) < 0) {
+        if ((new_m->shmid = shm_get(new_m->shmkey, &new_m->realsize,
+                                    SHM_R | SHM_W | IPC_CREAT, flags)) < 0) {
             return errno;
         }
 
@@ -260,6 +402,12 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
             return errno;
         }
 
+        status = shm_apply_flags(new_m, flags);
+        if (status != APR_SUCCESS) {
+            shm_cleanup_owner(new_m);
+            return status;
+        }
+
         apr_pool_cleanup_register(new_m->pool, new_m, shm_cleanup_owner,
                                   apr_pool_cleanup_null);
         *m = new_m;
@@ -348,6 +496,12 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
         }
 #endif /* APR_USE_SHMEM_MMAP_SHM */
 
+        status = shm_apply_flags(new_m, flags);
+        if (status != APR_SUCCESS) {
+            shm_cleanup_owner(new_m);
+            return status;
+        }
+
         /* store the real size in the metadata */
         *(apr_size_t*)(new_m->base) = new_m->realsize;
         /* metadata isn't usable */
@@ -377,8 +531,9 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
             return errno;
         }
 
-        if ((new_m->shmid = shmget(new_m->shmkey, new_m->realsize,
-                                   SHM_R | SHM_W | IPC_CREAT | IPC_EXCL)) < 0) {
+        if ((new_m->shmid = shm_get(new_m->shmkey, &new_m->realsize,
+                                    SHM_R | SHM_W | IPC_CREAT | IPC_EXCL,
+                                    flags)) < 0) {
             apr_file_close(file);
             return errno;
         }
@@ -401,6 +556,13 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
             return errno;
         }
 
+        status = shm_apply_flags(new_m, flags);
+        if (status != APR_SUCCESS) {
+            apr_file_close(file);
+            shm_cleanup_owner(new_m);
+            return status;
+        }
+
         nbytes = sizeof(reqsize);
         status = apr_file_write(file, (const void *)&reqsize,
                                 &nbytes);
@@ -424,13 +586,12 @@ APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
     }
 }
 
-APR_DECLARE(apr_status_t) apr_shm_create_ex(apr_shm_t **m, 
-                                            apr_size_t reqsize, 
-                                            const char *filename, 
-                                            apr_pool_t *p,
-                                            apr_int32_t flags)
+APR_DECLARE(apr_status_t) apr_shm_create(apr_shm_t **m,
+                                         apr_size_t reqsize,
+                                         const char *filename,
+                                         apr_pool_t *pool)
 {
-    return apr_shm_create(m, reqsize, filename, p);
+    return apr_shm_create_ex(m, reqsize, filename, pool, 0);
 }
 
 APR_DECLARE(apr_status_t) apr_shm_remove(const char *filename,
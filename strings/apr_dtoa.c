@@ -0,0 +1,1320 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Shortest round-trip formatting of doubles, after the Grisu2 algorithm
+ * of Florian Loitsch ("Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers", PLDI 2010), and correctly rounded parsing,
+ * after the Clinger fast path and the Eisel-Lemire algorithm (Daniel
+ * Lemire, "Number Parsing at a Gigabyte per Second", 2021).
+ */
+
+#include "apr.h"
+#include "apr_strings.h"
+#include "apr_private.h"
+#include "apr_lib.h"
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#include <errno.h>
+#include <float.h>
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h> /* strtod */
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#pragma intrinsic(_umul128)
+#pragma intrinsic(_BitScanReverse64)
+#endif
+
+#define DTOA_HIDDEN_BIT     APR_UINT64_C(0x0010000000000000)
+#define DTOA_SIGNIFICAND    APR_UINT64_C(0x000FFFFFFFFFFFFF)
+#define DTOA_EXPONENT       APR_UINT64_C(0x7FF0000000000000)
+#define DTOA_SIGN           APR_UINT64_C(0x8000000000000000)
+
+/* The high 64 bits of the product of a and b, the low ones in lo */
+static APR_INLINE apr_uint64_t dtoa_mul128(apr_uint64_t a, apr_uint64_t b,
+                                           apr_uint64_t *lo)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    *lo = (apr_uint64_t)r;
+    return (apr_uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    apr_uint64_t hi;
+    *lo = _umul128(a, b, &hi);
+    return hi;
+#else
+    apr_uint64_t a0 = a & 0xFFFFFFFF, a1 = a >> 32;
+    apr_uint64_t b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+    apr_uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    apr_uint64_t mid = (p00 >> 32) + (p10 & 0xFFFFFFFF) + (p01 & 0xFFFFFFFF);
+
+    *lo = (mid << 32) | (p00 & 0xFFFFFFFF);
+    return p11 + (p10 >> 32) + (p01 >> 32) + (mid >> 32);
+#endif
+}
+
+/* The number of leading zero bits of a non zero x */
+static APR_INLINE int dtoa_clz64(apr_uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return 63 - (int)i;
+#else
+    int n = 0;
+
+    while (!(x & DTOA_SIGN)) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/*
+ * Formatting
+ */
+
+/* A floating point number f * 2^e, with a 64 bits significand */
+typedef struct dtoa_fp_t {
+    apr_uint64_t f;
+    int e;
+} dtoa_fp_t;
+
+/* The normalized 10^k, for k from -348 to 340 by steps of 8, rounded */
+static const struct {
+    apr_uint64_t f;
+    int e;
+} dtoa_cached_powers[] = {
+    { APR_UINT64_C(0xfa8fd5a0081c0288), -1220 },
+    { APR_UINT64_C(0xbaaee17fa23ebf76), -1193 },
+    { APR_UINT64_C(0x8b16fb203055ac76), -1166 },
+    { APR_UINT64_C(0xcf42894a5dce35ea), -1140 },
+    { APR_UINT64_C(0x9a6bb0aa55653b2d), -1113 },
+    { APR_UINT64_C(0xe61acf033d1a45df), -1087 },
+    { APR_UINT64_C(0xab70fe17c79ac6ca), -1060 },
+    { APR_UINT64_C(0xff77b1fcbebcdc4f), -1034 },
+    { APR_UINT64_C(0xbe5691ef416bd60c), -1007 },
+    { APR_UINT64_C(0x8dd01fad907ffc3c), -980 },
+    { APR_UINT64_C(0xd3515c2831559a83), -954 },
+    { APR_UINT64_C(0x9d71ac8fada6c9b5), -927 },
+    { APR_UINT64_C(0xea9c227723ee8bcb), -901 },
+    { APR_UINT64_C(0xaecc49914078536d), -874 },
+    { APR_UINT64_C(0x823c12795db6ce57), -847 },
+    { APR_UINT64_C(0xc21094364dfb5637), -821 },
+    { APR_UINT64_C(0x9096ea6f3848984f), -794 },
+    { APR_UINT64_C(0xd77485cb25823ac7), -768 },
+    { APR_UINT64_C(0xa086cfcd97bf97f4), -741 },
+    { APR_UINT64_C(0xef340a98172aace5), -715 },
+    { APR_UINT64_C(0xb23867fb2a35b28e), -688 },
+    { APR_UINT64_C(0x84c8d4dfd2c63f3b), -661 },
+    { APR_UINT64_C(0xc5dd44271ad3cdba), -635 },
+    { APR_UINT64_C(0x936b9fcebb25c996), -608 },
+    { APR_UINT64_C(0xdbac6c247d62a584), -582 },
+    { APR_UINT64_C(0xa3ab66580d5fdaf6), -555 },
+    { APR_UINT64_C(0xf3e2f893dec3f126), -529 },
+    { APR_UINT64_C(0xb5b5ada8aaff80b8), -502 },
+    { APR_UINT64_C(0x87625f056c7c4a8b), -475 },
+    { APR_UINT64_C(0xc9bcff6034c13053), -449 },
+    { APR_UINT64_C(0x964e858c91ba2655), -422 },
+    { APR_UINT64_C(0xdff9772470297ebd), -396 },
+    { APR_UINT64_C(0xa6dfbd9fb8e5b88f), -369 },
+    { APR_UINT64_C(0xf8a95fcf88747d94), -343 },
+    { APR_UINT64_C(0xb94470938fa89bcf), -316 },
+    { APR_UINT64_C(0x8a08f0f8bf0f156b), -289 },
+    { APR_UINT64_C(0xcdb02555653131b6), -263 },
+    { APR_UINT64_C(0x993fe2c6d07b7fac), -236 },
+    { APR_UINT64_C(0xe45c10c42a2b3b06), -210 },
+    { APR_UINT64_C(0xaa242499697392d3), -183 },
+    { APR_UINT64_C(0xfd87b5f28300ca0e), -157 },
+    { APR_UINT64_C(0xbce5086492111aeb), -130 },
+    { APR_UINT64_C(0x8cbccc096f5088cc), -103 },
+    { APR_UINT64_C(0xd1b71758e219652c), -77 },
+    { APR_UINT64_C(0x9c40000000000000), -50 },
+    { APR_UINT64_C(0xe8d4a51000000000), -24 },
+    { APR_UINT64_C(0xad78ebc5ac620000), 3 },
+    { APR_UINT64_C(0x813f3978f8940984), 30 },
+    { APR_UINT64_C(0xc097ce7bc90715b3), 56 },
+    { APR_UINT64_C(0x8f7e32ce7bea5c70), 83 },
+    { APR_UINT64_C(0xd5d238a4abe98068), 109 },
+    { APR_UINT64_C(0x9f4f2726179a2245), 136 },
+    { APR_UINT64_C(0xed63a231d4c4fb27), 162 },
+    { APR_UINT64_C(0xb0de65388cc8ada8), 189 },
+    { APR_UINT64_C(0x83c7088e1aab65db), 216 },
+    { APR_UINT64_C(0xc45d1df942711d9a), 242 },
+    { APR_UINT64_C(0x924d692ca61be758), 269 },
+    { APR_UINT64_C(0xda01ee641a708dea), 295 },
+    { APR_UINT64_C(0xa26da3999aef774a), 322 },
+    { APR_UINT64_C(0xf209787bb47d6b85), 348 },
+    { APR_UINT64_C(0xb454e4a179dd1877), 375 },
+    { APR_UINT64_C(0x865b86925b9bc5c2), 402 },
+    { APR_UINT64_C(0xc83553c5c8965d3d), 428 },
+    { APR_UINT64_C(0x952ab45cfa97a0b3), 455 },
+    { APR_UINT64_C(0xde469fbd99a05fe3), 481 },
+    { APR_UINT64_C(0xa59bc234db398c25), 508 },
+    { APR_UINT64_C(0xf6c69a72a3989f5c), 534 },
+    { APR_UINT64_C(0xb7dcbf5354e9bece), 561 },
+    { APR_UINT64_C(0x88fcf317f22241e2), 588 },
+    { APR_UINT64_C(0xcc20ce9bd35c78a5), 614 },
+    { APR_UINT64_C(0x98165af37b2153df), 641 },
+    { APR_UINT64_C(0xe2a0b5dc971f303a), 667 },
+    { APR_UINT64_C(0xa8d9d1535ce3b396), 694 },
+    { APR_UINT64_C(0xfb9b7cd9a4a7443c), 720 },
+    { APR_UINT64_C(0xbb764c4ca7a44410), 747 },
+    { APR_UINT64_C(0x8bab8eefb6409c1a), 774 },
+    { APR_UINT64_C(0xd01fef10a657842c), 800 },
+    { APR_UINT64_C(0x9b10a4e5e9913129), 827 },
+    { APR_UINT64_C(0xe7109bfba19c0c9d), 853 },
+    { APR_UINT64_C(0xac2820d9623bf429), 880 },
+    { APR_UINT64_C(0x80444b5e7aa7cf85), 907 },
+    { APR_UINT64_C(0xbf21e44003acdd2d), 933 },
+    { APR_UINT64_C(0x8e679c2f5e44ff8f), 960 },
+    { APR_UINT64_C(0xd433179d9c8cb841), 986 },
+    { APR_UINT64_C(0x9e19db92b4e31ba9), 1013 },
+    { APR_UINT64_C(0xeb96bf6ebadf77d9), 1039 },
+    { APR_UINT64_C(0xaf87023b9bf0ee6b), 1066 },};
+
+static APR_INLINE dtoa_fp_t dtoa_fp_mul(dtoa_fp_t x, dtoa_fp_t y)
+{
+    dtoa_fp_t r;
+    apr_uint64_t lo;
+
+    r.f = dtoa_mul128(x.f, y.f, &lo);
+    r.f += lo >> 63; /* rounded */
+    r.e = x.e + y.e + 64;
+
+    return r;
+}
+
+static APR_INLINE dtoa_fp_t dtoa_fp_normalize(dtoa_fp_t x)
+{
+    int s = dtoa_clz64(x.f);
+
+    x.f <<= s;
+    x.e -= s;
+
+    return x;
+}
+
+/* Get the cached power c = 10^-k such that e + c.e + 64 is in [-60, -32],
+ * for the product of an fp of exponent e by c to have its integral part
+ * in 32 bits.
+ */
+static dtoa_fp_t dtoa_cached_power(int e, int *k)
+{
+    dtoa_fp_t c;
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int i = (int)dk;
+
+    if (dk - i > 0.0) {
+        i++;
+    }
+    i = (i >> 3) + 1;
+    *k = -(-348 + i * 8);
+
+    c.f = dtoa_cached_powers[i].f;
+    c.e = dtoa_cached_powers[i].e;
+    return c;
+}
+
+static const apr_uint64_t dtoa_pow10[] = {
+    APR_UINT64_C(1), APR_UINT64_C(10), APR_UINT64_C(100),
+    APR_UINT64_C(1000), APR_UINT64_C(10000), APR_UINT64_C(100000),
+    APR_UINT64_C(1000000), APR_UINT64_C(10000000),
+    APR_UINT64_C(100000000), APR_UINT64_C(1000000000),
+    APR_UINT64_C(10000000000), APR_UINT64_C(100000000000),
+    APR_UINT64_C(1000000000000), APR_UINT64_C(10000000000000),
+    APR_UINT64_C(100000000000000), APR_UINT64_C(1000000000000000),
+    APR_UINT64_C(10000000000000000), APR_UINT64_C(100000000000000000),
+    APR_UINT64_C(1000000000000000000), APR_UINT64_C(10000000000000000000)
+};
+
+/* Move the last digit down, towards w, while it stays in the interval */
+static void dtoa_round(char *buf, int len, apr_uint64_t delta,
+                       apr_uint64_t rest, apr_uint64_t ten_kappa,
+                       apr_uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa
+           && (rest + ten_kappa < wp_w
+               || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+/* Generate the shortest digits of w within the interval of width delta
+ * below mp, adding their decimal exponent to k.
+ */
+static int dtoa_digits(dtoa_fp_t w, dtoa_fp_t mp, apr_uint64_t delta,
+                       char *buf, int *k)
+{
+    const int shift = -mp.e;
+    const apr_uint64_t one = APR_UINT64_C(1) << shift;
+    const apr_uint64_t wp_w = mp.f - w.f;
+    apr_uint32_t p1 = (apr_uint32_t)(mp.f >> shift);
+    apr_uint64_t p2 = mp.f & (one - 1);
+    int kappa = 1, len = 0;
+
+    while (kappa < 10 && p1 >= dtoa_pow10[kappa]) {
+        kappa++;
+    }
+
+    while (kappa > 0) {
+        apr_uint32_t d = p1 / (apr_uint32_t)dtoa_pow10[kappa - 1];
+        apr_uint64_t rest;
+
+        p1 %= (apr_uint32_t)dtoa_pow10[kappa - 1];
+        if (d || len) {
+            buf[len++] = (char)('0' + d);
+        }
+        kappa--;
+        rest = ((apr_uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            dtoa_round(buf, len, delta, rest, dtoa_pow10[kappa] << shift,
+                       wp_w);
+            return len;
+        }
+    }
+
+    for (;;) {
+        char d;
+
+        p2 *= 10;
+        delta *= 10;
+        d = (char)(p2 >> shift);
+        if (d || len) {
+            buf[len++] = (char)('0' + d);
+        }
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            dtoa_round(buf, len, delta, p2, one,
+                       -kappa < 20 ? wp_w * dtoa_pow10[-kappa] : 0);
+            return len;
+        }
+    }
+}
+
+/* The digits of a positive finite non zero double, and their decimal
+ * exponent.
+ */
+static int dtoa_grisu2(apr_uint64_t bits, char *buf, int *k)
+{
+    dtoa_fp_t v, w, mp, mm, c;
+    int biased = (int)((bits & DTOA_EXPONENT) >> 52);
+
+    v.f = bits & DTOA_SIGNIFICAND;
+    if (biased) {
+        v.f += DTOA_HIDDEN_BIT;
+        v.e = biased - 1075;
+    }
+    else {
+        v.e = -1074;
+    }
+
+    /* the boundaries m+ and m-, normalized alike */
+    mp.f = (v.f << 1) + 1;
+    mp.e = v.e - 1;
+    mp = dtoa_fp_normalize(mp);
+    if (v.f == DTOA_HIDDEN_BIT && biased > 1) {
+        mm.f = (v.f << 2) - 1;
+        mm.e = v.e - 2;
+    }
+    else {
+        mm.f = (v.f << 1) - 1;
+        mm.e = v.e - 1;
+    }
+    mm.f <<= mm.e - mp.e;
+    mm.e = mp.e;
+
+    c = dtoa_cached_power(mp.e, k);
+    w = dtoa_fp_mul(dtoa_fp_normalize(v), c);
+    mp = dtoa_fp_mul(mp, c);
+    mm = dtoa_fp_mul(mm, c);
+    mm.f++;
+    mp.f--;
+
+    return dtoa_digits(w, mp, mp.f - mm.f, buf, k);
+}
+
+APR_DECLARE(apr_size_t) apr_dtoa(char *buf, double num)
+{
+    char digits[24], *p = buf;
+    apr_uint64_t bits;
+    int len, k, n, i;
+
+    memcpy(&bits, &num, sizeof(bits));
+
+    if ((bits & DTOA_EXPONENT) == DTOA_EXPONENT) {
+        if (bits & DTOA_SIGNIFICAND) {
+            memcpy(buf, "nan", 4);
+            return 3;
+        }
+        if (bits & DTOA_SIGN) {
+            *p++ = '-';
+        }
+        memcpy(p, "inf", 4);
+        return p + 3 - buf;
+    }
+
+    if (bits & DTOA_SIGN) {
+        *p++ = '-';
+        bits &= ~DTOA_SIGN;
+    }
+    if (!bits) {
+        *p++ = '0';
+        *p = '\0';
+        return p - buf;
+    }
+
+    k = 0;
+    len = dtoa_grisu2(bits, digits, &k);
+
+    /* the decimal point is after the n-th digit, which like ECMAScript
+     * we write out from 1e-6 and below 1e21, with an exponent otherwise
+     */
+    n = len + k;
+    if (k >= 0 && n <= 21) {
+        memcpy(p, digits, len);
+        p += len;
+        for (i = 0; i < k; i++) {
+            *p++ = '0';
+        }
+    }
+    else if (n > 0 && n <= 21) {
+        memcpy(p, digits, n);
+        p += n;
+        *p++ = '.';
+        memcpy(p, digits + n, len - n);
+        p += len - n;
+    }
+    else if (n > -6 && n <= 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = n; i < 0; i++) {
+            *p++ = '0';
+        }
+        memcpy(p, digits, len);
+        p += len;
+    }
+    else {
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        n--;
+        if (n < 0) {
+            *p++ = '-';
+            n = -n;
+        }
+        if (n >= 100) {
+            *p++ = (char)('0' + n / 100);
+            n %= 100;
+            *p++ = (char)('0' + n / 10);
+        }
+        else if (n >= 10) {
+            *p++ = (char)('0' + n / 10);
+        }
+        *p++ = (char)('0' + n % 10);
+    }
+    *p = '\0';
+
+    return p - buf;
+}
+
+/*
+ * Parsing
+ */
+
+/* The 128 bits approximations of 5^q, for q from -342 to 308 */
+static const apr_uint64_t dtoa_pow5_128[] = {
+    APR_UINT64_C(0xeef453d6923bd65a), APR_UINT64_C(0x113faa2906a13b3f),
+    APR_UINT64_C(0x9558b4661b6565f8), APR_UINT64_C(0x4ac7ca59a424c507),
+    APR_UINT64_C(0xbaaee17fa23ebf76), APR_UINT64_C(0x5d79bcf00d2df649),
+    APR_UINT64_C(0xe95a99df8ace6f53), APR_UINT64_C(0xf4d82c2c107973dc),
+    APR_UINT64_C(0x91d8a02bb6c10594), APR_UINT64_C(0x79071b9b8a4be869),
+    APR_UINT64_C(0xb64ec836a47146f9), APR_UINT64_C(0x9748e2826cdee284),
+    APR_UINT64_C(0xe3e27a444d8d98b7), APR_UINT64_C(0xfd1b1b2308169b25),
+    APR_UINT64_C(0x8e6d8c6ab0787f72), APR_UINT64_C(0xfe30f0f5e50e20f7),
+    APR_UINT64_C(0xb208ef855c969f4f), APR_UINT64_C(0xbdbd2d335e51a935),
+    APR_UINT64_C(0xde8b2b66b3bc4723), APR_UINT64_C(0xad2c788035e61382),
+    APR_UINT64_C(0x8b16fb203055ac76), APR_UINT64_C(0x4c3bcb5021afcc31),
+    APR_UINT64_C(0xaddcb9e83c6b1793), APR_UINT64_C(0xdf4abe242a1bbf3d),
+    APR_UINT64_C(0xd953e8624b85dd78), APR_UINT64_C(0xd71d6dad34a2af0d),
+    APR_UINT64_C(0x87d4713d6f33aa6b), APR_UINT64_C(0x8672648c40e5ad68),
+    APR_UINT64_C(0xa9c98d8ccb009506), APR_UINT64_C(0x680efdaf511f18c2),
+    APR_UINT64_C(0xd43bf0effdc0ba48), APR_UINT64_C(0x0212bd1b2566def2),
+    APR_UINT64_C(0x84a57695fe98746d), APR_UINT64_C(0x014bb630f7604b57),
+    APR_UINT64_C(0xa5ced43b7e3e9188), APR_UINT64_C(0x419ea3bd35385e2d),
+    APR_UINT64_C(0xcf42894a5dce35ea), APR_UINT64_C(0x52064cac828675b9),
+    APR_UINT64_C(0x818995ce7aa0e1b2), APR_UINT64_C(0x7343efebd1940993),
+    APR_UINT64_C(0xa1ebfb4219491a1f), APR_UINT64_C(0x1014ebe6c5f90bf8),
+    APR_UINT64_C(0xca66fa129f9b60a6), APR_UINT64_C(0xd41a26e077774ef6),
+    APR_UINT64_C(0xfd00b897478238d0), APR_UINT64_C(0x8920b098955522b4),
+    APR_UINT64_C(0x9e20735e8cb16382), APR_UINT64_C(0x55b46e5f5d5535b0),
+    APR_UINT64_C(0xc5a890362fddbc62), APR_UINT64_C(0xeb2189f734aa831d),
+    APR_UINT64_C(0xf712b443bbd52b7b), APR_UINT64_C(0xa5e9ec7501d523e4),
+    APR_UINT64_C(0x9a6bb0aa55653b2d), APR_UINT64_C(0x47b233c92125366e),
+    APR_UINT64_C(0xc1069cd4eabe89f8), APR_UINT64_C(0x999ec0bb696e840a),
+    APR_UINT64_C(0xf148440a256e2c76), APR_UINT64_C(0xc00670ea43ca250d),
+    APR_UINT64_C(0x96cd2a865764dbca), APR_UINT64_C(0x380406926a5e5728),
+    APR_UINT64_C(0xbc807527ed3e12bc), APR_UINT64_C(0xc605083704f5ecf2),
+    APR_UINT64_C(0xeba09271e88d976b), APR_UINT64_C(0xf7864a44c633682e),
+    APR_UINT64_C(0x93445b8731587ea3), APR_UINT64_C(0x7ab3ee6afbe0211d),
+    APR_UINT64_C(0xb8157268fdae9e4c), APR_UINT64_C(0x5960ea05bad82964),
+    APR_UINT64_C(0xe61acf033d1a45df), APR_UINT64_C(0x6fb92487298e33bd),
+    APR_UINT64_C(0x8fd0c16206306bab), APR_UINT64_C(0xa5d3b6d479f8e056),
+    APR_UINT64_C(0xb3c4f1ba87bc8696), APR_UINT64_C(0x8f48a4899877186c),
+    APR_UINT64_C(0xe0b62e2929aba83c), APR_UINT64_C(0x331acdabfe94de87),
+    APR_UINT64_C(0x8c71dcd9ba0b4925), APR_UINT64_C(0x9ff0c08b7f1d0b14),
+    APR_UINT64_C(0xaf8e5410288e1b6f), APR_UINT64_C(0x07ecf0ae5ee44dd9),
+    APR_UINT64_C(0xdb71e91432b1a24a), APR_UINT64_C(0xc9e82cd9f69d6150),
+    APR_UINT64_C(0x892731ac9faf056e), APR_UINT64_C(0xbe311c083a225cd2),
+    APR_UINT64_C(0xab70fe17c79ac6ca), APR_UINT64_C(0x6dbd630a48aaf406),
+    APR_UINT64_C(0xd64d3d9db981787d), APR_UINT64_C(0x092cbbccdad5b108),
+    APR_UINT64_C(0x85f0468293f0eb4e), APR_UINT64_C(0x25bbf56008c58ea5),
+    APR_UINT64_C(0xa76c582338ed2621), APR_UINT64_C(0xaf2af2b80af6f24e),
+    APR_UINT64_C(0xd1476e2c07286faa), APR_UINT64_C(0x1af5af660db4aee1),
+    APR_UINT64_C(0x82cca4db847945ca), APR_UINT64_C(0x50d98d9fc890ed4d),
+    APR_UINT64_C(0xa37fce126597973c), APR_UINT64_C(0xe50ff107bab528a0),
+    APR_UINT64_C(0xcc5fc196fefd7d0c), APR_UINT64_C(0x1e53ed49a96272c8),
+    APR_UINT64_C(0xff77b1fcbebcdc4f), APR_UINT64_C(0x25e8e89c13bb0f7a),
+    APR_UINT64_C(0x9faacf3df73609b1), APR_UINT64_C(0x77b191618c54e9ac),
+    APR_UINT64_C(0xc795830d75038c1d), APR_UINT64_C(0xd59df5b9ef6a2417),
+    APR_UINT64_C(0xf97ae3d0d2446f25), APR_UINT64_C(0x4b0573286b44ad1d),
+    APR_UINT64_C(0x9becce62836ac577), APR_UINT64_C(0x4ee367f9430aec32),
+    APR_UINT64_C(0xc2e801fb244576d5), APR_UINT64_C(0x229c41f793cda73f),
+    APR_UINT64_C(0xf3a20279ed56d48a), APR_UINT64_C(0x6b43527578c1110f),
+    APR_UINT64_C(0x9845418c345644d6), APR_UINT64_C(0x830a13896b78aaa9),
+    APR_UINT64_C(0xbe5691ef416bd60c), APR_UINT64_C(0x23cc986bc656d553),
+    APR_UINT64_C(0xedec366b11c6cb8f), APR_UINT64_C(0x2cbfbe86b7ec8aa8),
+    APR_UINT64_C(0x94b3a202eb1c3f39), APR_UINT64_C(0x7bf7d71432f3d6a9),
+    APR_UINT64_C(0xb9e08a83a5e34f07), APR_UINT64_C(0xdaf5ccd93fb0cc53),
+    APR_UINT64_C(0xe858ad248f5c22c9), APR_UINT64_C(0xd1b3400f8f9cff68),
+    APR_UINT64_C(0x91376c36d99995be), APR_UINT64_C(0x23100809b9c21fa1),
+    APR_UINT64_C(0xb58547448ffffb2d), APR_UINT64_C(0xabd40a0c2832a78a),
+    APR_UINT64_C(0xe2e69915b3fff9f9), APR_UINT64_C(0x16c90c8f323f516c),
+    APR_UINT64_C(0x8dd01fad907ffc3b), APR_UINT64_C(0xae3da7d97f6792e3),
+    APR_UINT64_C(0xb1442798f49ffb4a), APR_UINT64_C(0x99cd11cfdf41779c),
+    APR_UINT64_C(0xdd95317f31c7fa1d), APR_UINT64_C(0x40405643d711d583),
+    APR_UINT64_C(0x8a7d3eef7f1cfc52), APR_UINT64_C(0x482835ea666b2572),
+    APR_UINT64_C(0xad1c8eab5ee43b66), APR_UINT64_C(0xda3243650005eecf),
+    APR_UINT64_C(0xd863b256369d4a40), APR_UINT64_C(0x90bed43e40076a82),
+    APR_UINT64_C(0x873e4f75e2224e68), APR_UINT64_C(0x5a7744a6e804a291),
+    APR_UINT64_C(0xa90de3535aaae202), APR_UINT64_C(0x711515d0a205cb36),
+    APR_UINT64_C(0xd3515c2831559a83), APR_UINT64_C(0x0d5a5b44ca873e03),
+    APR_UINT64_C(0x8412d9991ed58091), APR_UINT64_C(0xe858790afe9486c2),
+    APR_UINT64_C(0xa5178fff668ae0b6), APR_UINT64_C(0x626e974dbe39a872),
+    APR_UINT64_C(0xce5d73ff402d98e3), APR_UINT64_C(0xfb0a3d212dc8128f),
+    APR_UINT64_C(0x80fa687f881c7f8e), APR_UINT64_C(0x7ce66634bc9d0b99),
+    APR_UINT64_C(0xa139029f6a239f72), APR_UINT64_C(0x1c1fffc1ebc44e80),
+    APR_UINT64_C(0xc987434744ac874e), APR_UINT64_C(0xa327ffb266b56220),
+    APR_UINT64_C(0xfbe9141915d7a922), APR_UINT64_C(0x4bf1ff9f0062baa8),
+    APR_UINT64_C(0x9d71ac8fada6c9b5), APR_UINT64_C(0x6f773fc3603db4a9),
+    APR_UINT64_C(0xc4ce17b399107c22), APR_UINT64_C(0xcb550fb4384d21d3),
+    APR_UINT64_C(0xf6019da07f549b2b), APR_UINT64_C(0x7e2a53a146606a48),
+    APR_UINT64_C(0x99c102844f94e0fb), APR_UINT64_C(0x2eda7444cbfc426d),
+    APR_UINT64_C(0xc0314325637a1939), APR_UINT64_C(0xfa911155fefb5308),
+    APR_UINT64_C(0xf03d93eebc589f88), APR_UINT64_C(0x793555ab7eba27ca),
+    APR_UINT64_C(0x96267c7535b763b5), APR_UINT64_C(0x4bc1558b2f3458de),
+    APR_UINT64_C(0xbbb01b9283253ca2), APR_UINT64_C(0x9eb1aaedfb016f16),
+    APR_UINT64_C(0xea9c227723ee8bcb), APR_UINT64_C(0x465e15a979c1cadc),
+    APR_UINT64_C(0x92a1958a7675175f), APR_UINT64_C(0x0bfacd89ec191ec9),
+    APR_UINT64_C(0xb749faed14125d36), APR_UINT64_C(0xcef980ec671f667b),
+    APR_UINT64_C(0xe51c79a85916f484), APR_UINT64_C(0x82b7e12780e7401a),
+    APR_UINT64_C(0x8f31cc0937ae58d2), APR_UINT64_C(0xd1b2ecb8b0908810),
+    APR_UINT64_C(0xb2fe3f0b8599ef07), APR_UINT64_C(0x861fa7e6dcb4aa15),
+    APR_UINT64_C(0xdfbdcece67006ac9), APR_UINT64_C(0x67a791e093e1d49a),
+    APR_UINT64_C(0x8bd6a141006042bd), APR_UINT64_C(0xe0c8bb2c5c6d24e0),
+    APR_UINT64_C(0xaecc49914078536d), APR_UINT64_C(0x58fae9f773886e18),
+    APR_UINT64_C(0xda7f5bf590966848), APR_UINT64_C(0xaf39a475506a899e),
+    APR_UINT64_C(0x888f99797a5e012d), APR_UINT64_C(0x6d8406c952429603),
+    APR_UINT64_C(0xaab37fd7d8f58178), APR_UINT64_C(0xc8e5087ba6d33b83),
+    APR_UINT64_C(0xd5605fcdcf32e1d6), APR_UINT64_C(0xfb1e4a9a90880a64),
+    APR_UINT64_C(0x855c3be0a17fcd26), APR_UINT64_C(0x5cf2eea09a55067f),
+    APR_UINT64_C(0xa6b34ad8c9dfc06f), APR_UINT64_C(0xf42faa48c0ea481e),
+    APR_UINT64_C(0xd0601d8efc57b08b), APR_UINT64_C(0xf13b94daf124da26),
+    APR_UINT64_C(0x823c12795db6ce57), APR_UINT64_C(0x76c53d08d6b70858),
+    APR_UINT64_C(0xa2cb1717b52481ed), APR_UINT64_C(0x54768c4b0c64ca6e),
+    APR_UINT64_C(0xcb7ddcdda26da268), APR_UINT64_C(0xa9942f5dcf7dfd09),
+    APR_UINT64_C(0xfe5d54150b090b02), APR_UINT64_C(0xd3f93b35435d7c4c),
+    APR_UINT64_C(0x9efa548d26e5a6e1), APR_UINT64_C(0xc47bc5014a1a6daf),
+    APR_UINT64_C(0xc6b8e9b0709f109a), APR_UINT64_C(0x359ab6419ca1091b),
+    APR_UINT64_C(0xf867241c8cc6d4c0), APR_UINT64_C(0xc30163d203c94b62),
+    APR_UINT64_C(0x9b407691d7fc44f8), APR_UINT64_C(0x79e0de63425dcf1d),
+    APR_UINT64_C(0xc21094364dfb5636), APR_UINT64_C(0x985915fc12f542e4),
+    APR_UINT64_C(0xf294b943e17a2bc4), APR_UINT64_C(0x3e6f5b7b17b2939d),
+    APR_UINT64_C(0x979cf3ca6cec5b5a), APR_UINT64_C(0xa705992ceecf9c42),
+    APR_UINT64_C(0xbd8430bd08277231), APR_UINT64_C(0x50c6ff782a838353),
+    APR_UINT64_C(0xece53cec4a314ebd), APR_UINT64_C(0xa4f8bf5635246428),
+    APR_UINT64_C(0x940f4613ae5ed136), APR_UINT64_C(0x871b7795e136be99),
+    APR_UINT64_C(0xb913179899f68584), APR_UINT64_C(0x28e2557b59846e3f),
+    APR_UINT64_C(0xe757dd7ec07426e5), APR_UINT64_C(0x331aeada2fe589cf),
+    APR_UINT64_C(0x9096ea6f3848984f), APR_UINT64_C(0x3ff0d2c85def7621),
+    APR_UINT64_C(0xb4bca50b065abe63), APR_UINT64_C(0x0fed077a756b53a9),
+    APR_UINT64_C(0xe1ebce4dc7f16dfb), APR_UINT64_C(0xd3e8495912c62894),
+    APR_UINT64_C(0x8d3360f09cf6e4bd), APR_UINT64_C(0x64712dd7abbbd95c),
+    APR_UINT64_C(0xb080392cc4349dec), APR_UINT64_C(0xbd8d794d96aacfb3),
+    APR_UINT64_C(0xdca04777f541c567), APR_UINT64_C(0xecf0d7a0fc5583a0),
+    APR_UINT64_C(0x89e42caaf9491b60), APR_UINT64_C(0xf41686c49db57244),
+    APR_UINT64_C(0xac5d37d5b79b6239), APR_UINT64_C(0x311c2875c522ced5),
+    APR_UINT64_C(0xd77485cb25823ac7), APR_UINT64_C(0x7d633293366b828b),
+    APR_UINT64_C(0x86a8d39ef77164bc), APR_UINT64_C(0xae5dff9c02033197),
+    APR_UINT64_C(0xa8530886b54dbdeb), APR_UINT64_C(0xd9f57f830283fdfc),
+    APR_UINT64_C(0xd267caa862a12d66), APR_UINT64_C(0xd072df63c324fd7b),
+    APR_UINT64_C(0x8380dea93da4bc60), APR_UINT64_C(0x4247cb9e59f71e6d),
+    APR_UINT64_C(0xa46116538d0deb78), APR_UINT64_C(0x52d9be85f074e608),
+    APR_UINT64_C(0xcd795be870516656), APR_UINT64_C(0x67902e276c921f8b),
+    APR_UINT64_C(0x806bd9714632dff6), APR_UINT64_C(0x00ba1cd8a3db53b6),
+    APR_UINT64_C(0xa086cfcd97bf97f3), APR_UINT64_C(0x80e8a40eccd228a4),
+    APR_UINT64_C(0xc8a883c0fdaf7df0), APR_UINT64_C(0x6122cd128006b2cd),
+    APR_UINT64_C(0xfad2a4b13d1b5d6c), APR_UINT64_C(0x796b805720085f81),
+    APR_UINT64_C(0x9cc3a6eec6311a63), APR_UINT64_C(0xcbe3303674053bb0),
+    APR_UINT64_C(0xc3f490aa77bd60fc), APR_UINT64_C(0xbedbfc4411068a9c),
+    APR_UINT64_C(0xf4f1b4d515acb93b), APR_UINT64_C(0xee92fb5515482d44),
+    APR_UINT64_C(0x991711052d8bf3c5), APR_UINT64_C(0x751bdd152d4d1c4a),
+    APR_UINT64_C(0xbf5cd54678eef0b6), APR_UINT64_C(0xd262d45a78a0635d),
+    APR_UINT64_C(0xef340a98172aace4), APR_UINT64_C(0x86fb897116c87c34),
+    APR_UINT64_C(0x9580869f0e7aac0e), APR_UINT64_C(0xd45d35e6ae3d4da0),
+    APR_UINT64_C(0xbae0a846d2195712), APR_UINT64_C(0x8974836059cca109),
+    APR_UINT64_C(0xe998d258869facd7), APR_UINT64_C(0x2bd1a438703fc94b),
+    APR_UINT64_C(0x91ff83775423cc06), APR_UINT64_C(0x7b6306a34627ddcf),
+    APR_UINT64_C(0xb67f6455292cbf08), APR_UINT64_C(0x1a3bc84c17b1d542),
+    APR_UINT64_C(0xe41f3d6a7377eeca), APR_UINT64_C(0x20caba5f1d9e4a93),
+    APR_UINT64_C(0x8e938662882af53e), APR_UINT64_C(0x547eb47b7282ee9c),
+    APR_UINT64_C(0xb23867fb2a35b28d), APR_UINT64_C(0xe99e619a4f23aa43),
+    APR_UINT64_C(0xdec681f9f4c31f31), APR_UINT64_C(0x6405fa00e2ec94d4),
+    APR_UINT64_C(0x8b3c113c38f9f37e), APR_UINT64_C(0xde83bc408dd3dd04),
+    APR_UINT64_C(0xae0b158b4738705e), APR_UINT64_C(0x9624ab50b148d445),
+    APR_UINT64_C(0xd98ddaee19068c76), APR_UINT64_C(0x3badd624dd9b0957),
+    APR_UINT64_C(0x87f8a8d4cfa417c9), APR_UINT64_C(0xe54ca5d70a80e5d6),
+    APR_UINT64_C(0xa9f6d30a038d1dbc), APR_UINT64_C(0x5e9fcf4ccd211f4c),
+    APR_UINT64_C(0xd47487cc8470652b), APR_UINT64_C(0x7647c3200069671f),
+    APR_UINT64_C(0x84c8d4dfd2c63f3b), APR_UINT64_C(0x29ecd9f40041e073),
+    APR_UINT64_C(0xa5fb0a17c777cf09), APR_UINT64_C(0xf468107100525890),
+    APR_UINT64_C(0xcf79cc9db955c2cc), APR_UINT64_C(0x7182148d4066eeb4),
+    APR_UINT64_C(0x81ac1fe293d599bf), APR_UINT64_C(0xc6f14cd848405530),
+    APR_UINT64_C(0xa21727db38cb002f), APR_UINT64_C(0xb8ada00e5a506a7c),
+    APR_UINT64_C(0xca9cf1d206fdc03b), APR_UINT64_C(0xa6d90811f0e4851c),
+    APR_UINT64_C(0xfd442e4688bd304a), APR_UINT64_C(0x908f4a166d1da663),
+    APR_UINT64_C(0x9e4a9cec15763e2e), APR_UINT64_C(0x9a598e4e043287fe),
+    APR_UINT64_C(0xc5dd44271ad3cdba), APR_UINT64_C(0x40eff1e1853f29fd),
+    APR_UINT64_C(0xf7549530e188c128), APR_UINT64_C(0xd12bee59e68ef47c),
+    APR_UINT64_C(0x9a94dd3e8cf578b9), APR_UINT64_C(0x82bb74f8301958ce),
+    APR_UINT64_C(0xc13a148e3032d6e7), APR_UINT64_C(0xe36a52363c1faf01),
+    APR_UINT64_C(0xf18899b1bc3f8ca1), APR_UINT64_C(0xdc44e6c3cb279ac1),
+    APR_UINT64_C(0x96f5600f15a7b7e5), APR_UINT64_C(0x29ab103a5ef8c0b9),
+    APR_UINT64_C(0xbcb2b812db11a5de), APR_UINT64_C(0x7415d448f6b6f0e7),
+    APR_UINT64_C(0xebdf661791d60f56), APR_UINT64_C(0x111b495b3464ad21),
+    APR_UINT64_C(0x936b9fcebb25c995), APR_UINT64_C(0xcab10dd900beec34),
+    APR_UINT64_C(0xb84687c269ef3bfb), APR_UINT64_C(0x3d5d514f40eea742),
+    APR_UINT64_C(0xe65829b3046b0afa), APR_UINT64_C(0x0cb4a5a3112a5112),
+    APR_UINT64_C(0x8ff71a0fe2c2e6dc), APR_UINT64_C(0x47f0e785eaba72ab),
+    APR_UINT64_C(0xb3f4e093db73a093), APR_UINT64_C(0x59ed216765690f56),
+    APR_UINT64_C(0xe0f218b8d25088b8), APR_UINT64_C(0x306869c13ec3532c),
+    APR_UINT64_C(0x8c974f7383725573), APR_UINT64_C(0x1e414218c73a13fb),
+    APR_UINT64_C(0xafbd2350644eeacf), APR_UINT64_C(0xe5d1929ef90898fa),
+    APR_UINT64_C(0xdbac6c247d62a583), APR_UINT64_C(0xdf45f746b74abf39),
+    APR_UINT64_C(0x894bc396ce5da772), APR_UINT64_C(0x6b8bba8c328eb783),
+    APR_UINT64_C(0xab9eb47c81f5114f), APR_UINT64_C(0x066ea92f3f326564),
+    APR_UINT64_C(0xd686619ba27255a2), APR_UINT64_C(0xc80a537b0efefebd),
+    APR_UINT64_C(0x8613fd0145877585), APR_UINT64_C(0xbd06742ce95f5f36),
+    APR_UINT64_C(0xa798fc4196e952e7), APR_UINT64_C(0x2c48113823b73704),
+    APR_UINT64_C(0xd17f3b51fca3a7a0), APR_UINT64_C(0xf75a15862ca504c5),
+    APR_UINT64_C(0x82ef85133de648c4), APR_UINT64_C(0x9a984d73dbe722fb),
+    APR_UINT64_C(0xa3ab66580d5fdaf5), APR_UINT64_C(0xc13e60d0d2e0ebba),
+    APR_UINT64_C(0xcc963fee10b7d1b3), APR_UINT64_C(0x318df905079926a8),
+    APR_UINT64_C(0xffbbcfe994e5c61f), APR_UINT64_C(0xfdf17746497f7052),
+    APR_UINT64_C(0x9fd561f1fd0f9bd3), APR_UINT64_C(0xfeb6ea8bedefa633),
+    APR_UINT64_C(0xc7caba6e7c5382c8), APR_UINT64_C(0xfe64a52ee96b8fc0),
+    APR_UINT64_C(0xf9bd690a1b68637b), APR_UINT64_C(0x3dfdce7aa3c673b0),
+    APR_UINT64_C(0x9c1661a651213e2d), APR_UINT64_C(0x06bea10ca65c084e),
+    APR_UINT64_C(0xc31bfa0fe5698db8), APR_UINT64_C(0x486e494fcff30a62),
+    APR_UINT64_C(0xf3e2f893dec3f126), APR_UINT64_C(0x5a89dba3c3efccfa),
+    APR_UINT64_C(0x986ddb5c6b3a76b7), APR_UINT64_C(0xf89629465a75e01c),
+    APR_UINT64_C(0xbe89523386091465), APR_UINT64_C(0xf6bbb397f1135823),
+    APR_UINT64_C(0xee2ba6c0678b597f), APR_UINT64_C(0x746aa07ded582e2c),
+    APR_UINT64_C(0x94db483840b717ef), APR_UINT64_C(0xa8c2a44eb4571cdc),
+    APR_UINT64_C(0xba121a4650e4ddeb), APR_UINT64_C(0x92f34d62616ce413),
+    APR_UINT64_C(0xe896a0d7e51e1566), APR_UINT64_C(0x77b020baf9c81d17),
+    APR_UINT64_C(0x915e2486ef32cd60), APR_UINT64_C(0x0ace1474dc1d122e),
+    APR_UINT64_C(0xb5b5ada8aaff80b8), APR_UINT64_C(0x0d819992132456ba),
+    APR_UINT64_C(0xe3231912d5bf60e6), APR_UINT64_C(0x10e1fff697ed6c69),
+    APR_UINT64_C(0x8df5efabc5979c8f), APR_UINT64_C(0xca8d3ffa1ef463c1),
+    APR_UINT64_C(0xb1736b96b6fd83b3), APR_UINT64_C(0xbd308ff8a6b17cb2),
+    APR_UINT64_C(0xddd0467c64bce4a0), APR_UINT64_C(0xac7cb3f6d05ddbde),
+    APR_UINT64_C(0x8aa22c0dbef60ee4), APR_UINT64_C(0x6bcdf07a423aa96b),
+    APR_UINT64_C(0xad4ab7112eb3929d), APR_UINT64_C(0x86c16c98d2c953c6),
+    APR_UINT64_C(0xd89d64d57a607744), APR_UINT64_C(0xe871c7bf077ba8b7),
+    APR_UINT64_C(0x87625f056c7c4a8b), APR_UINT64_C(0x11471cd764ad4972),
+    APR_UINT64_C(0xa93af6c6c79b5d2d), APR_UINT64_C(0xd598e40d3dd89bcf),
+    APR_UINT64_C(0xd389b47879823479), APR_UINT64_C(0x4aff1d108d4ec2c3),
+    APR_UINT64_C(0x843610cb4bf160cb), APR_UINT64_C(0xcedf722a585139ba),
+    APR_UINT64_C(0xa54394fe1eedb8fe), APR_UINT64_C(0xc2974eb4ee658828),
+    APR_UINT64_C(0xce947a3da6a9273e), APR_UINT64_C(0x733d226229feea32),
+    APR_UINT64_C(0x811ccc668829b887), APR_UINT64_C(0x0806357d5a3f525f),
+    APR_UINT64_C(0xa163ff802a3426a8), APR_UINT64_C(0xca07c2dcb0cf26f7),
+    APR_UINT64_C(0xc9bcff6034c13052), APR_UINT64_C(0xfc89b393dd02f0b5),
+    APR_UINT64_C(0xfc2c3f3841f17c67), APR_UINT64_C(0xbbac2078d443ace2),
+    APR_UINT64_C(0x9d9ba7832936edc0), APR_UINT64_C(0xd54b944b84aa4c0d),
+    APR_UINT64_C(0xc5029163f384a931), APR_UINT64_C(0x0a9e795e65d4df11),
+    APR_UINT64_C(0xf64335bcf065d37d), APR_UINT64_C(0x4d4617b5ff4a16d5),
+    APR_UINT64_C(0x99ea0196163fa42e), APR_UINT64_C(0x504bced1bf8e4e45),
+    APR_UINT64_C(0xc06481fb9bcf8d39), APR_UINT64_C(0xe45ec2862f71e1d6),
+    APR_UINT64_C(0xf07da27a82c37088), APR_UINT64_C(0x5d767327bb4e5a4c),
+    APR_UINT64_C(0x964e858c91ba2655), APR_UINT64_C(0x3a6a07f8d510f86f),
+    APR_UINT64_C(0xbbe226efb628afea), APR_UINT64_C(0x890489f70a55368b),
+    APR_UINT64_C(0xeadab0aba3b2dbe5), APR_UINT64_C(0x2b45ac74ccea842e),
+    APR_UINT64_C(0x92c8ae6b464fc96f), APR_UINT64_C(0x3b0b8bc90012929d),
+    APR_UINT64_C(0xb77ada0617e3bbcb), APR_UINT64_C(0x09ce6ebb40173744),
+    APR_UINT64_C(0xe55990879ddcaabd), APR_UINT64_C(0xcc420a6a101d0515),
+    APR_UINT64_C(0x8f57fa54c2a9eab6), APR_UINT64_C(0x9fa946824a12232d),
+    APR_UINT64_C(0xb32df8e9f3546564), APR_UINT64_C(0x47939822dc96abf9),
+    APR_UINT64_C(0xdff9772470297ebd), APR_UINT64_C(0x59787e2b93bc56f7),
+    APR_UINT64_C(0x8bfbea76c619ef36), APR_UINT64_C(0x57eb4edb3c55b65a),
+    APR_UINT64_C(0xaefae51477a06b03), APR_UINT64_C(0xede622920b6b23f1),
+    APR_UINT64_C(0xdab99e59958885c4), APR_UINT64_C(0xe95fab368e45eced),
+    APR_UINT64_C(0x88b402f7fd75539b), APR_UINT64_C(0x11dbcb0218ebb414),
+    APR_UINT64_C(0xaae103b5fcd2a881), APR_UINT64_C(0xd652bdc29f26a119),
+    APR_UINT64_C(0xd59944a37c0752a2), APR_UINT64_C(0x4be76d3346f0495f),
+    APR_UINT64_C(0x857fcae62d8493a5), APR_UINT64_C(0x6f70a4400c562ddb),
+    APR_UINT64_C(0xa6dfbd9fb8e5b88e), APR_UINT64_C(0xcb4ccd500f6bb952),
+    APR_UINT64_C(0xd097ad07a71f26b2), APR_UINT64_C(0x7e2000a41346a7a7),
+    APR_UINT64_C(0x825ecc24c873782f), APR_UINT64_C(0x8ed400668c0c28c8),
+    APR_UINT64_C(0xa2f67f2dfa90563b), APR_UINT64_C(0x728900802f0f32fa),
+    APR_UINT64_C(0xcbb41ef979346bca), APR_UINT64_C(0x4f2b40a03ad2ffb9),
+    APR_UINT64_C(0xfea126b7d78186bc), APR_UINT64_C(0xe2f610c84987bfa8),
+    APR_UINT64_C(0x9f24b832e6b0f436), APR_UINT64_C(0x0dd9ca7d2df4d7c9),
+    APR_UINT64_C(0xc6ede63fa05d3143), APR_UINT64_C(0x91503d1c79720dbb),
+    APR_UINT64_C(0xf8a95fcf88747d94), APR_UINT64_C(0x75a44c6397ce912a),
+    APR_UINT64_C(0x9b69dbe1b548ce7c), APR_UINT64_C(0xc986afbe3ee11aba),
+    APR_UINT64_C(0xc24452da229b021b), APR_UINT64_C(0xfbe85badce996168),
+    APR_UINT64_C(0xf2d56790ab41c2a2), APR_UINT64_C(0xfae27299423fb9c3),
+    APR_UINT64_C(0x97c560ba6b0919a5), APR_UINT64_C(0xdccd879fc967d41a),
+    APR_UINT64_C(0xbdb6b8e905cb600f), APR_UINT64_C(0x5400e987bbc1c920),
+    APR_UINT64_C(0xed246723473e3813), APR_UINT64_C(0x290123e9aab23b68),
+    APR_UINT64_C(0x9436c0760c86e30b), APR_UINT64_C(0xf9a0b6720aaf6521),
+    APR_UINT64_C(0xb94470938fa89bce), APR_UINT64_C(0xf808e40e8d5b3e69),
+    APR_UINT64_C(0xe7958cb87392c2c2), APR_UINT64_C(0xb60b1d1230b20e04),
+    APR_UINT64_C(0x90bd77f3483bb9b9), APR_UINT64_C(0xb1c6f22b5e6f48c2),
+    APR_UINT64_C(0xb4ecd5f01a4aa828), APR_UINT64_C(0x1e38aeb6360b1af3),
+    APR_UINT64_C(0xe2280b6c20dd5232), APR_UINT64_C(0x25c6da63c38de1b0),
+    APR_UINT64_C(0x8d590723948a535f), APR_UINT64_C(0x579c487e5a38ad0e),
+    APR_UINT64_C(0xb0af48ec79ace837), APR_UINT64_C(0x2d835a9df0c6d851),
+    APR_UINT64_C(0xdcdb1b2798182244), APR_UINT64_C(0xf8e431456cf88e65),
+    APR_UINT64_C(0x8a08f0f8bf0f156b), APR_UINT64_C(0x1b8e9ecb641b58ff),
+    APR_UINT64_C(0xac8b2d36eed2dac5), APR_UINT64_C(0xe272467e3d222f3f),
+    APR_UINT64_C(0xd7adf884aa879177), APR_UINT64_C(0x5b0ed81dcc6abb0f),
+    APR_UINT64_C(0x86ccbb52ea94baea), APR_UINT64_C(0x98e947129fc2b4e9),
+    APR_UINT64_C(0xa87fea27a539e9a5), APR_UINT64_C(0x3f2398d747b36224),
+    APR_UINT64_C(0xd29fe4b18e88640e), APR_UINT64_C(0x8eec7f0d19a03aad),
+    APR_UINT64_C(0x83a3eeeef9153e89), APR_UINT64_C(0x1953cf68300424ac),
+    APR_UINT64_C(0xa48ceaaab75a8e2b), APR_UINT64_C(0x5fa8c3423c052dd7),
+    APR_UINT64_C(0xcdb02555653131b6), APR_UINT64_C(0x3792f412cb06794d),
+    APR_UINT64_C(0x808e17555f3ebf11), APR_UINT64_C(0xe2bbd88bbee40bd0),
+    APR_UINT64_C(0xa0b19d2ab70e6ed6), APR_UINT64_C(0x5b6aceaeae9d0ec4),
+    APR_UINT64_C(0xc8de047564d20a8b), APR_UINT64_C(0xf245825a5a445275),
+    APR_UINT64_C(0xfb158592be068d2e), APR_UINT64_C(0xeed6e2f0f0d56712),
+    APR_UINT64_C(0x9ced737bb6c4183d), APR_UINT64_C(0x55464dd69685606b),
+    APR_UINT64_C(0xc428d05aa4751e4c), APR_UINT64_C(0xaa97e14c3c26b886),
+    APR_UINT64_C(0xf53304714d9265df), APR_UINT64_C(0xd53dd99f4b3066a8),
+    APR_UINT64_C(0x993fe2c6d07b7fab), APR_UINT64_C(0xe546a8038efe4029),
+    APR_UINT64_C(0xbf8fdb78849a5f96), APR_UINT64_C(0xde98520472bdd033),
+    APR_UINT64_C(0xef73d256a5c0f77c), APR_UINT64_C(0x963e66858f6d4440),
+    APR_UINT64_C(0x95a8637627989aad), APR_UINT64_C(0xdde7001379a44aa8),
+    APR_UINT64_C(0xbb127c53b17ec159), APR_UINT64_C(0x5560c018580d5d52),
+    APR_UINT64_C(0xe9d71b689dde71af), APR_UINT64_C(0xaab8f01e6e10b4a6),
+    APR_UINT64_C(0x9226712162ab070d), APR_UINT64_C(0xcab3961304ca70e8),
+    APR_UINT64_C(0xb6b00d69bb55c8d1), APR_UINT64_C(0x3d607b97c5fd0d22),
+    APR_UINT64_C(0xe45c10c42a2b3b05), APR_UINT64_C(0x8cb89a7db77c506a),
+    APR_UINT64_C(0x8eb98a7a9a5b04e3), APR_UINT64_C(0x77f3608e92adb242),
+    APR_UINT64_C(0xb267ed1940f1c61c), APR_UINT64_C(0x55f038b237591ed3),
+    APR_UINT64_C(0xdf01e85f912e37a3), APR_UINT64_C(0x6b6c46dec52f6688),
+    APR_UINT64_C(0x8b61313bbabce2c6), APR_UINT64_C(0x2323ac4b3b3da015),
+    APR_UINT64_C(0xae397d8aa96c1b77), APR_UINT64_C(0xabec975e0a0d081a),
+    APR_UINT64_C(0xd9c7dced53c72255), APR_UINT64_C(0x96e7bd358c904a21),
+    APR_UINT64_C(0x881cea14545c7575), APR_UINT64_C(0x7e50d64177da2e54),
+    APR_UINT64_C(0xaa242499697392d2), APR_UINT64_C(0xdde50bd1d5d0b9e9),
+    APR_UINT64_C(0xd4ad2dbfc3d07787), APR_UINT64_C(0x955e4ec64b44e864),
+    APR_UINT64_C(0x84ec3c97da624ab4), APR_UINT64_C(0xbd5af13bef0b113e),
+    APR_UINT64_C(0xa6274bbdd0fadd61), APR_UINT64_C(0xecb1ad8aeacdd58e),
+    APR_UINT64_C(0xcfb11ead453994ba), APR_UINT64_C(0x67de18eda5814af2),
+    APR_UINT64_C(0x81ceb32c4b43fcf4), APR_UINT64_C(0x80eacf948770ced7),
+    APR_UINT64_C(0xa2425ff75e14fc31), APR_UINT64_C(0xa1258379a94d028d),
+    APR_UINT64_C(0xcad2f7f5359a3b3e), APR_UINT64_C(0x096ee45813a04330),
+    APR_UINT64_C(0xfd87b5f28300ca0d), APR_UINT64_C(0x8bca9d6e188853fc),
+    APR_UINT64_C(0x9e74d1b791e07e48), APR_UINT64_C(0x775ea264cf55347e),
+    APR_UINT64_C(0xc612062576589dda), APR_UINT64_C(0x95364afe032a819e),
+    APR_UINT64_C(0xf79687aed3eec551), APR_UINT64_C(0x3a83ddbd83f52205),
+    APR_UINT64_C(0x9abe14cd44753b52), APR_UINT64_C(0xc4926a9672793543),
+    APR_UINT64_C(0xc16d9a0095928a27), APR_UINT64_C(0x75b7053c0f178294),
+    APR_UINT64_C(0xf1c90080baf72cb1), APR_UINT64_C(0x5324c68b12dd6339),
+    APR_UINT64_C(0x971da05074da7bee), APR_UINT64_C(0xd3f6fc16ebca5e04),
+    APR_UINT64_C(0xbce5086492111aea), APR_UINT64_C(0x88f4bb1ca6bcf585),
+    APR_UINT64_C(0xec1e4a7db69561a5), APR_UINT64_C(0x2b31e9e3d06c32e6),
+    APR_UINT64_C(0x9392ee8e921d5d07), APR_UINT64_C(0x3aff322e62439fd0),
+    APR_UINT64_C(0xb877aa3236a4b449), APR_UINT64_C(0x09befeb9fad487c3),
+    APR_UINT64_C(0xe69594bec44de15b), APR_UINT64_C(0x4c2ebe687989a9b4),
+    APR_UINT64_C(0x901d7cf73ab0acd9), APR_UINT64_C(0x0f9d37014bf60a11),
+    APR_UINT64_C(0xb424dc35095cd80f), APR_UINT64_C(0x538484c19ef38c95),
+    APR_UINT64_C(0xe12e13424bb40e13), APR_UINT64_C(0x2865a5f206b06fba),
+    APR_UINT64_C(0x8cbccc096f5088cb), APR_UINT64_C(0xf93f87b7442e45d4),
+    APR_UINT64_C(0xafebff0bcb24aafe), APR_UINT64_C(0xf78f69a51539d749),
+    APR_UINT64_C(0xdbe6fecebdedd5be), APR_UINT64_C(0xb573440e5a884d1c),
+    APR_UINT64_C(0x89705f4136b4a597), APR_UINT64_C(0x31680a88f8953031),
+    APR_UINT64_C(0xabcc77118461cefc), APR_UINT64_C(0xfdc20d2b36ba7c3e),
+    APR_UINT64_C(0xd6bf94d5e57a42bc), APR_UINT64_C(0x3d32907604691b4d),
+    APR_UINT64_C(0x8637bd05af6c69b5), APR_UINT64_C(0xa63f9a49c2c1b110),
+    APR_UINT64_C(0xa7c5ac471b478423), APR_UINT64_C(0x0fcf80dc33721d54),
+    APR_UINT64_C(0xd1b71758e219652b), APR_UINT64_C(0xd3c36113404ea4a9),
+    APR_UINT64_C(0x83126e978d4fdf3b), APR_UINT64_C(0x645a1cac083126ea),
+    APR_UINT64_C(0xa3d70a3d70a3d70a), APR_UINT64_C(0x3d70a3d70a3d70a4),
+    APR_UINT64_C(0xcccccccccccccccc), APR_UINT64_C(0xcccccccccccccccd),
+    APR_UINT64_C(0x8000000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xa000000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xc800000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xfa00000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x9c40000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xc350000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xf424000000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x9896800000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xbebc200000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xee6b280000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x9502f90000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xba43b74000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xe8d4a51000000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x9184e72a00000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xb5e620f480000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xe35fa931a0000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x8e1bc9bf04000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xb1a2bc2ec5000000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xde0b6b3a76400000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x8ac7230489e80000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xad78ebc5ac620000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xd8d726b7177a8000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x878678326eac9000), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xa968163f0a57b400), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xd3c21bcecceda100), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x84595161401484a0), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xa56fa5b99019a5c8), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0xcecb8f27f4200f3a), APR_UINT64_C(0x0000000000000000),
+    APR_UINT64_C(0x813f3978f8940984), APR_UINT64_C(0x4000000000000000),
+    APR_UINT64_C(0xa18f07d736b90be5), APR_UINT64_C(0x5000000000000000),
+    APR_UINT64_C(0xc9f2c9cd04674ede), APR_UINT64_C(0xa400000000000000),
+    APR_UINT64_C(0xfc6f7c4045812296), APR_UINT64_C(0x4d00000000000000),
+    APR_UINT64_C(0x9dc5ada82b70b59d), APR_UINT64_C(0xf020000000000000),
+    APR_UINT64_C(0xc5371912364ce305), APR_UINT64_C(0x6c28000000000000),
+    APR_UINT64_C(0xf684df56c3e01bc6), APR_UINT64_C(0xc732000000000000),
+    APR_UINT64_C(0x9a130b963a6c115c), APR_UINT64_C(0x3c7f400000000000),
+    APR_UINT64_C(0xc097ce7bc90715b3), APR_UINT64_C(0x4b9f100000000000),
+    APR_UINT64_C(0xf0bdc21abb48db20), APR_UINT64_C(0x1e86d40000000000),
+    APR_UINT64_C(0x96769950b50d88f4), APR_UINT64_C(0x1314448000000000),
+    APR_UINT64_C(0xbc143fa4e250eb31), APR_UINT64_C(0x17d955a000000000),
+    APR_UINT64_C(0xeb194f8e1ae525fd), APR_UINT64_C(0x5dcfab0800000000),
+    APR_UINT64_C(0x92efd1b8d0cf37be), APR_UINT64_C(0x5aa1cae500000000),
+    APR_UINT64_C(0xb7abc627050305ad), APR_UINT64_C(0xf14a3d9e40000000),
+    APR_UINT64_C(0xe596b7b0c643c719), APR_UINT64_C(0x6d9ccd05d0000000),
+    APR_UINT64_C(0x8f7e32ce7bea5c6f), APR_UINT64_C(0xe4820023a2000000),
+    APR_UINT64_C(0xb35dbf821ae4f38b), APR_UINT64_C(0xdda2802c8a800000),
+    APR_UINT64_C(0xe0352f62a19e306e), APR_UINT64_C(0xd50b2037ad200000),
+    APR_UINT64_C(0x8c213d9da502de45), APR_UINT64_C(0x4526f422cc340000),
+    APR_UINT64_C(0xaf298d050e4395d6), APR_UINT64_C(0x9670b12b7f410000),
+    APR_UINT64_C(0xdaf3f04651d47b4c), APR_UINT64_C(0x3c0cdd765f114000),
+    APR_UINT64_C(0x88d8762bf324cd0f), APR_UINT64_C(0xa5880a69fb6ac800),
+    APR_UINT64_C(0xab0e93b6efee0053), APR_UINT64_C(0x8eea0d047a457a00),
+    APR_UINT64_C(0xd5d238a4abe98068), APR_UINT64_C(0x72a4904598d6d880),
+    APR_UINT64_C(0x85a36366eb71f041), APR_UINT64_C(0x47a6da2b7f864750),
+    APR_UINT64_C(0xa70c3c40a64e6c51), APR_UINT64_C(0x999090b65f67d924),
+    APR_UINT64_C(0xd0cf4b50cfe20765), APR_UINT64_C(0xfff4b4e3f741cf6d),
+    APR_UINT64_C(0x82818f1281ed449f), APR_UINT64_C(0xbff8f10e7a8921a4),
+    APR_UINT64_C(0xa321f2d7226895c7), APR_UINT64_C(0xaff72d52192b6a0d),
+    APR_UINT64_C(0xcbea6f8ceb02bb39), APR_UINT64_C(0x9bf4f8a69f764490),
+    APR_UINT64_C(0xfee50b7025c36a08), APR_UINT64_C(0x02f236d04753d5b4),
+    APR_UINT64_C(0x9f4f2726179a2245), APR_UINT64_C(0x01d762422c946590),
+    APR_UINT64_C(0xc722f0ef9d80aad6), APR_UINT64_C(0x424d3ad2b7b97ef5),
+    APR_UINT64_C(0xf8ebad2b84e0d58b), APR_UINT64_C(0xd2e0898765a7deb2),
+    APR_UINT64_C(0x9b934c3b330c8577), APR_UINT64_C(0x63cc55f49f88eb2f),
+    APR_UINT64_C(0xc2781f49ffcfa6d5), APR_UINT64_C(0x3cbf6b71c76b25fb),
+    APR_UINT64_C(0xf316271c7fc3908a), APR_UINT64_C(0x8bef464e3945ef7a),
+    APR_UINT64_C(0x97edd871cfda3a56), APR_UINT64_C(0x97758bf0e3cbb5ac),
+    APR_UINT64_C(0xbde94e8e43d0c8ec), APR_UINT64_C(0x3d52eeed1cbea317),
+    APR_UINT64_C(0xed63a231d4c4fb27), APR_UINT64_C(0x4ca7aaa863ee4bdd),
+    APR_UINT64_C(0x945e455f24fb1cf8), APR_UINT64_C(0x8fe8caa93e74ef6a),
+    APR_UINT64_C(0xb975d6b6ee39e436), APR_UINT64_C(0xb3e2fd538e122b44),
+    APR_UINT64_C(0xe7d34c64a9c85d44), APR_UINT64_C(0x60dbbca87196b616),
+    APR_UINT64_C(0x90e40fbeea1d3a4a), APR_UINT64_C(0xbc8955e946fe31cd),
+    APR_UINT64_C(0xb51d13aea4a488dd), APR_UINT64_C(0x6babab6398bdbe41),
+    APR_UINT64_C(0xe264589a4dcdab14), APR_UINT64_C(0xc696963c7eed2dd1),
+    APR_UINT64_C(0x8d7eb76070a08aec), APR_UINT64_C(0xfc1e1de5cf543ca2),
+    APR_UINT64_C(0xb0de65388cc8ada8), APR_UINT64_C(0x3b25a55f43294bcb),
+    APR_UINT64_C(0xdd15fe86affad912), APR_UINT64_C(0x49ef0eb713f39ebe),
+    APR_UINT64_C(0x8a2dbf142dfcc7ab), APR_UINT64_C(0x6e3569326c784337),
+    APR_UINT64_C(0xacb92ed9397bf996), APR_UINT64_C(0x49c2c37f07965404),
+    APR_UINT64_C(0xd7e77a8f87daf7fb), APR_UINT64_C(0xdc33745ec97be906),
+    APR_UINT64_C(0x86f0ac99b4e8dafd), APR_UINT64_C(0x69a028bb3ded71a3),
+    APR_UINT64_C(0xa8acd7c0222311bc), APR_UINT64_C(0xc40832ea0d68ce0c),
+    APR_UINT64_C(0xd2d80db02aabd62b), APR_UINT64_C(0xf50a3fa490c30190),
+    APR_UINT64_C(0x83c7088e1aab65db), APR_UINT64_C(0x792667c6da79e0fa),
+    APR_UINT64_C(0xa4b8cab1a1563f52), APR_UINT64_C(0x577001b891185938),
+    APR_UINT64_C(0xcde6fd5e09abcf26), APR_UINT64_C(0xed4c0226b55e6f86),
+    APR_UINT64_C(0x80b05e5ac60b6178), APR_UINT64_C(0x544f8158315b05b4),
+    APR_UINT64_C(0xa0dc75f1778e39d6), APR_UINT64_C(0x696361ae3db1c721),
+    APR_UINT64_C(0xc913936dd571c84c), APR_UINT64_C(0x03bc3a19cd1e38e9),
+    APR_UINT64_C(0xfb5878494ace3a5f), APR_UINT64_C(0x04ab48a04065c723),
+    APR_UINT64_C(0x9d174b2dcec0e47b), APR_UINT64_C(0x62eb0d64283f9c76),
+    APR_UINT64_C(0xc45d1df942711d9a), APR_UINT64_C(0x3ba5d0bd324f8394),
+    APR_UINT64_C(0xf5746577930d6500), APR_UINT64_C(0xca8f44ec7ee36479),
+    APR_UINT64_C(0x9968bf6abbe85f20), APR_UINT64_C(0x7e998b13cf4e1ecb),
+    APR_UINT64_C(0xbfc2ef456ae276e8), APR_UINT64_C(0x9e3fedd8c321a67e),
+    APR_UINT64_C(0xefb3ab16c59b14a2), APR_UINT64_C(0xc5cfe94ef3ea101e),
+    APR_UINT64_C(0x95d04aee3b80ece5), APR_UINT64_C(0xbba1f1d158724a12),
+    APR_UINT64_C(0xbb445da9ca61281f), APR_UINT64_C(0x2a8a6e45ae8edc97),
+    APR_UINT64_C(0xea1575143cf97226), APR_UINT64_C(0xf52d09d71a3293bd),
+    APR_UINT64_C(0x924d692ca61be758), APR_UINT64_C(0x593c2626705f9c56),
+    APR_UINT64_C(0xb6e0c377cfa2e12e), APR_UINT64_C(0x6f8b2fb00c77836c),
+    APR_UINT64_C(0xe498f455c38b997a), APR_UINT64_C(0x0b6dfb9c0f956447),
+    APR_UINT64_C(0x8edf98b59a373fec), APR_UINT64_C(0x4724bd4189bd5eac),
+    APR_UINT64_C(0xb2977ee300c50fe7), APR_UINT64_C(0x58edec91ec2cb657),
+    APR_UINT64_C(0xdf3d5e9bc0f653e1), APR_UINT64_C(0x2f2967b66737e3ed),
+    APR_UINT64_C(0x8b865b215899f46c), APR_UINT64_C(0xbd79e0d20082ee74),
+    APR_UINT64_C(0xae67f1e9aec07187), APR_UINT64_C(0xecd8590680a3aa11),
+    APR_UINT64_C(0xda01ee641a708de9), APR_UINT64_C(0xe80e6f4820cc9495),
+    APR_UINT64_C(0x884134fe908658b2), APR_UINT64_C(0x3109058d147fdcdd),
+    APR_UINT64_C(0xaa51823e34a7eede), APR_UINT64_C(0xbd4b46f0599fd415),
+    APR_UINT64_C(0xd4e5e2cdc1d1ea96), APR_UINT64_C(0x6c9e18ac7007c91a),
+    APR_UINT64_C(0x850fadc09923329e), APR_UINT64_C(0x03e2cf6bc604ddb0),
+    APR_UINT64_C(0xa6539930bf6bff45), APR_UINT64_C(0x84db8346b786151c),
+    APR_UINT64_C(0xcfe87f7cef46ff16), APR_UINT64_C(0xe612641865679a63),
+    APR_UINT64_C(0x81f14fae158c5f6e), APR_UINT64_C(0x4fcb7e8f3f60c07e),
+    APR_UINT64_C(0xa26da3999aef7749), APR_UINT64_C(0xe3be5e330f38f09d),
+    APR_UINT64_C(0xcb090c8001ab551c), APR_UINT64_C(0x5cadf5bfd3072cc5),
+    APR_UINT64_C(0xfdcb4fa002162a63), APR_UINT64_C(0x73d9732fc7c8f7f6),
+    APR_UINT64_C(0x9e9f11c4014dda7e), APR_UINT64_C(0x2867e7fddcdd9afa),
+    APR_UINT64_C(0xc646d63501a1511d), APR_UINT64_C(0xb281e1fd541501b8),
+    APR_UINT64_C(0xf7d88bc24209a565), APR_UINT64_C(0x1f225a7ca91a4226),
+    APR_UINT64_C(0x9ae757596946075f), APR_UINT64_C(0x3375788de9b06958),
+    APR_UINT64_C(0xc1a12d2fc3978937), APR_UINT64_C(0x0052d6b1641c83ae),
+    APR_UINT64_C(0xf209787bb47d6b84), APR_UINT64_C(0xc0678c5dbd23a49a),
+    APR_UINT64_C(0x9745eb4d50ce6332), APR_UINT64_C(0xf840b7ba963646e0),
+    APR_UINT64_C(0xbd176620a501fbff), APR_UINT64_C(0xb650e5a93bc3d898),
+    APR_UINT64_C(0xec5d3fa8ce427aff), APR_UINT64_C(0xa3e51f138ab4cebe),
+    APR_UINT64_C(0x93ba47c980e98cdf), APR_UINT64_C(0xc66f336c36b10137),
+    APR_UINT64_C(0xb8a8d9bbe123f017), APR_UINT64_C(0xb80b0047445d4184),
+    APR_UINT64_C(0xe6d3102ad96cec1d), APR_UINT64_C(0xa60dc059157491e5),
+    APR_UINT64_C(0x9043ea1ac7e41392), APR_UINT64_C(0x87c89837ad68db2f),
+    APR_UINT64_C(0xb454e4a179dd1877), APR_UINT64_C(0x29babe4598c311fb),
+    APR_UINT64_C(0xe16a1dc9d8545e94), APR_UINT64_C(0xf4296dd6fef3d67a),
+    APR_UINT64_C(0x8ce2529e2734bb1d), APR_UINT64_C(0x1899e4a65f58660c),
+    APR_UINT64_C(0xb01ae745b101e9e4), APR_UINT64_C(0x5ec05dcff72e7f8f),
+    APR_UINT64_C(0xdc21a1171d42645d), APR_UINT64_C(0x76707543f4fa1f73),
+    APR_UINT64_C(0x899504ae72497eba), APR_UINT64_C(0x6a06494a791c53a8),
+    APR_UINT64_C(0xabfa45da0edbde69), APR_UINT64_C(0x0487db9d17636892),
+    APR_UINT64_C(0xd6f8d7509292d603), APR_UINT64_C(0x45a9d2845d3c42b6),
+    APR_UINT64_C(0x865b86925b9bc5c2), APR_UINT64_C(0x0b8a2392ba45a9b2),
+    APR_UINT64_C(0xa7f26836f282b732), APR_UINT64_C(0x8e6cac7768d7141e),
+    APR_UINT64_C(0xd1ef0244af2364ff), APR_UINT64_C(0x3207d795430cd926),
+    APR_UINT64_C(0x8335616aed761f1f), APR_UINT64_C(0x7f44e6bd49e807b8),
+    APR_UINT64_C(0xa402b9c5a8d3a6e7), APR_UINT64_C(0x5f16206c9c6209a6),
+    APR_UINT64_C(0xcd036837130890a1), APR_UINT64_C(0x36dba887c37a8c0f),
+    APR_UINT64_C(0x802221226be55a64), APR_UINT64_C(0xc2494954da2c9789),
+    APR_UINT64_C(0xa02aa96b06deb0fd), APR_UINT64_C(0xf2db9baa10b7bd6c),
+    APR_UINT64_C(0xc83553c5c8965d3d), APR_UINT64_C(0x6f92829494e5acc7),
+    APR_UINT64_C(0xfa42a8b73abbf48c), APR_UINT64_C(0xcb772339ba1f17f9),
+    APR_UINT64_C(0x9c69a97284b578d7), APR_UINT64_C(0xff2a760414536efb),
+    APR_UINT64_C(0xc38413cf25e2d70d), APR_UINT64_C(0xfef5138519684aba),
+    APR_UINT64_C(0xf46518c2ef5b8cd1), APR_UINT64_C(0x7eb258665fc25d69),
+    APR_UINT64_C(0x98bf2f79d5993802), APR_UINT64_C(0xef2f773ffbd97a61),
+    APR_UINT64_C(0xbeeefb584aff8603), APR_UINT64_C(0xaafb550ffacfd8fa),
+    APR_UINT64_C(0xeeaaba2e5dbf6784), APR_UINT64_C(0x95ba2a53f983cf38),
+    APR_UINT64_C(0x952ab45cfa97a0b2), APR_UINT64_C(0xdd945a747bf26183),
+    APR_UINT64_C(0xba756174393d88df), APR_UINT64_C(0x94f971119aeef9e4),
+    APR_UINT64_C(0xe912b9d1478ceb17), APR_UINT64_C(0x7a37cd5601aab85d),
+    APR_UINT64_C(0x91abb422ccb812ee), APR_UINT64_C(0xac62e055c10ab33a),
+    APR_UINT64_C(0xb616a12b7fe617aa), APR_UINT64_C(0x577b986b314d6009),
+    APR_UINT64_C(0xe39c49765fdf9d94), APR_UINT64_C(0xed5a7e85fda0b80b),
+    APR_UINT64_C(0x8e41ade9fbebc27d), APR_UINT64_C(0x14588f13be847307),
+    APR_UINT64_C(0xb1d219647ae6b31c), APR_UINT64_C(0x596eb2d8ae258fc8),
+    APR_UINT64_C(0xde469fbd99a05fe3), APR_UINT64_C(0x6fca5f8ed9aef3bb),
+    APR_UINT64_C(0x8aec23d680043bee), APR_UINT64_C(0x25de7bb9480d5854),
+    APR_UINT64_C(0xada72ccc20054ae9), APR_UINT64_C(0xaf561aa79a10ae6a),
+    APR_UINT64_C(0xd910f7ff28069da4), APR_UINT64_C(0x1b2ba1518094da04),
+    APR_UINT64_C(0x87aa9aff79042286), APR_UINT64_C(0x90fb44d2f05d0842),
+    APR_UINT64_C(0xa99541bf57452b28), APR_UINT64_C(0x353a1607ac744a53),
+    APR_UINT64_C(0xd3fa922f2d1675f2), APR_UINT64_C(0x42889b8997915ce8),
+    APR_UINT64_C(0x847c9b5d7c2e09b7), APR_UINT64_C(0x69956135febada11),
+    APR_UINT64_C(0xa59bc234db398c25), APR_UINT64_C(0x43fab9837e699095),
+    APR_UINT64_C(0xcf02b2c21207ef2e), APR_UINT64_C(0x94f967e45e03f4bb),
+    APR_UINT64_C(0x8161afb94b44f57d), APR_UINT64_C(0x1d1be0eebac278f5),
+    APR_UINT64_C(0xa1ba1ba79e1632dc), APR_UINT64_C(0x6462d92a69731732),
+    APR_UINT64_C(0xca28a291859bbf93), APR_UINT64_C(0x7d7b8f7503cfdcfe),
+    APR_UINT64_C(0xfcb2cb35e702af78), APR_UINT64_C(0x5cda735244c3d43e),
+    APR_UINT64_C(0x9defbf01b061adab), APR_UINT64_C(0x3a0888136afa64a7),
+    APR_UINT64_C(0xc56baec21c7a1916), APR_UINT64_C(0x088aaa1845b8fdd0),
+    APR_UINT64_C(0xf6c69a72a3989f5b), APR_UINT64_C(0x8aad549e57273d45),
+    APR_UINT64_C(0x9a3c2087a63f6399), APR_UINT64_C(0x36ac54e2f678864b),
+    APR_UINT64_C(0xc0cb28a98fcf3c7f), APR_UINT64_C(0x84576a1bb416a7dd),
+    APR_UINT64_C(0xf0fdf2d3f3c30b9f), APR_UINT64_C(0x656d44a2a11c51d5),
+    APR_UINT64_C(0x969eb7c47859e743), APR_UINT64_C(0x9f644ae5a4b1b325),
+    APR_UINT64_C(0xbc4665b596706114), APR_UINT64_C(0x873d5d9f0dde1fee),
+    APR_UINT64_C(0xeb57ff22fc0c7959), APR_UINT64_C(0xa90cb506d155a7ea),
+    APR_UINT64_C(0x9316ff75dd87cbd8), APR_UINT64_C(0x09a7f12442d588f2),
+    APR_UINT64_C(0xb7dcbf5354e9bece), APR_UINT64_C(0x0c11ed6d538aeb2f),
+    APR_UINT64_C(0xe5d3ef282a242e81), APR_UINT64_C(0x8f1668c8a86da5fa),
+    APR_UINT64_C(0x8fa475791a569d10), APR_UINT64_C(0xf96e017d694487bc),
+    APR_UINT64_C(0xb38d92d760ec4455), APR_UINT64_C(0x37c981dcc395a9ac),
+    APR_UINT64_C(0xe070f78d3927556a), APR_UINT64_C(0x85bbe253f47b1417),
+    APR_UINT64_C(0x8c469ab843b89562), APR_UINT64_C(0x93956d7478ccec8e),
+    APR_UINT64_C(0xaf58416654a6babb), APR_UINT64_C(0x387ac8d1970027b2),
+    APR_UINT64_C(0xdb2e51bfe9d0696a), APR_UINT64_C(0x06997b05fcc0319e),
+    APR_UINT64_C(0x88fcf317f22241e2), APR_UINT64_C(0x441fece3bdf81f03),
+    APR_UINT64_C(0xab3c2fddeeaad25a), APR_UINT64_C(0xd527e81cad7626c3),
+    APR_UINT64_C(0xd60b3bd56a5586f1), APR_UINT64_C(0x8a71e223d8d3b074),
+    APR_UINT64_C(0x85c7056562757456), APR_UINT64_C(0xf6872d5667844e49),
+    APR_UINT64_C(0xa738c6bebb12d16c), APR_UINT64_C(0xb428f8ac016561db),
+    APR_UINT64_C(0xd106f86e69d785c7), APR_UINT64_C(0xe13336d701beba52),
+    APR_UINT64_C(0x82a45b450226b39c), APR_UINT64_C(0xecc0024661173473),
+    APR_UINT64_C(0xa34d721642b06084), APR_UINT64_C(0x27f002d7f95d0190),
+    APR_UINT64_C(0xcc20ce9bd35c78a5), APR_UINT64_C(0x31ec038df7b441f4),
+    APR_UINT64_C(0xff290242c83396ce), APR_UINT64_C(0x7e67047175a15271),
+    APR_UINT64_C(0x9f79a169bd203e41), APR_UINT64_C(0x0f0062c6e984d386),
+    APR_UINT64_C(0xc75809c42c684dd1), APR_UINT64_C(0x52c07b78a3e60868),
+    APR_UINT64_C(0xf92e0c3537826145), APR_UINT64_C(0xa7709a56ccdf8a82),
+    APR_UINT64_C(0x9bbcc7a142b17ccb), APR_UINT64_C(0x88a66076400bb691),
+    APR_UINT64_C(0xc2abf989935ddbfe), APR_UINT64_C(0x6acff893d00ea435),
+    APR_UINT64_C(0xf356f7ebf83552fe), APR_UINT64_C(0x0583f6b8c4124d43),
+    APR_UINT64_C(0x98165af37b2153de), APR_UINT64_C(0xc3727a337a8b704a),
+    APR_UINT64_C(0xbe1bf1b059e9a8d6), APR_UINT64_C(0x744f18c0592e4c5c),
+    APR_UINT64_C(0xeda2ee1c7064130c), APR_UINT64_C(0x1162def06f79df73),
+    APR_UINT64_C(0x9485d4d1c63e8be7), APR_UINT64_C(0x8addcb5645ac2ba8),
+    APR_UINT64_C(0xb9a74a0637ce2ee1), APR_UINT64_C(0x6d953e2bd7173692),
+    APR_UINT64_C(0xe8111c87c5c1ba99), APR_UINT64_C(0xc8fa8db6ccdd0437),
+    APR_UINT64_C(0x910ab1d4db9914a0), APR_UINT64_C(0x1d9c9892400a22a2),
+    APR_UINT64_C(0xb54d5e4a127f59c8), APR_UINT64_C(0x2503beb6d00cab4b),
+    APR_UINT64_C(0xe2a0b5dc971f303a), APR_UINT64_C(0x2e44ae64840fd61d),
+    APR_UINT64_C(0x8da471a9de737e24), APR_UINT64_C(0x5ceaecfed289e5d2),
+    APR_UINT64_C(0xb10d8e1456105dad), APR_UINT64_C(0x7425a83e872c5f47),
+    APR_UINT64_C(0xdd50f1996b947518), APR_UINT64_C(0xd12f124e28f77719),
+    APR_UINT64_C(0x8a5296ffe33cc92f), APR_UINT64_C(0x82bd6b70d99aaa6f),
+    APR_UINT64_C(0xace73cbfdc0bfb7b), APR_UINT64_C(0x636cc64d1001550b),
+    APR_UINT64_C(0xd8210befd30efa5a), APR_UINT64_C(0x3c47f7e05401aa4e),
+    APR_UINT64_C(0x8714a775e3e95c78), APR_UINT64_C(0x65acfaec34810a71),
+    APR_UINT64_C(0xa8d9d1535ce3b396), APR_UINT64_C(0x7f1839a741a14d0d),
+    APR_UINT64_C(0xd31045a8341ca07c), APR_UINT64_C(0x1ede48111209a050),
+    APR_UINT64_C(0x83ea2b892091e44d), APR_UINT64_C(0x934aed0aab460432),
+    APR_UINT64_C(0xa4e4b66b68b65d60), APR_UINT64_C(0xf81da84d5617853f),
+    APR_UINT64_C(0xce1de40642e3f4b9), APR_UINT64_C(0x36251260ab9d668e),
+    APR_UINT64_C(0x80d2ae83e9ce78f3), APR_UINT64_C(0xc1d72b7c6b426019),
+    APR_UINT64_C(0xa1075a24e4421730), APR_UINT64_C(0xb24cf65b8612f81f),
+    APR_UINT64_C(0xc94930ae1d529cfc), APR_UINT64_C(0xdee033f26797b627),
+    APR_UINT64_C(0xfb9b7cd9a4a7443c), APR_UINT64_C(0x169840ef017da3b1),
+    APR_UINT64_C(0x9d412e0806e88aa5), APR_UINT64_C(0x8e1f289560ee864e),
+    APR_UINT64_C(0xc491798a08a2ad4e), APR_UINT64_C(0xf1a6f2bab92a27e2),
+    APR_UINT64_C(0xf5b5d7ec8acb58a2), APR_UINT64_C(0xae10af696774b1db),
+    APR_UINT64_C(0x9991a6f3d6bf1765), APR_UINT64_C(0xacca6da1e0a8ef29),
+    APR_UINT64_C(0xbff610b0cc6edd3f), APR_UINT64_C(0x17fd090a58d32af3),
+    APR_UINT64_C(0xeff394dcff8a948e), APR_UINT64_C(0xddfc4b4cef07f5b0),
+    APR_UINT64_C(0x95f83d0a1fb69cd9), APR_UINT64_C(0x4abdaf101564f98e),
+    APR_UINT64_C(0xbb764c4ca7a4440f), APR_UINT64_C(0x9d6d1ad41abe37f1),
+    APR_UINT64_C(0xea53df5fd18d5513), APR_UINT64_C(0x84c86189216dc5ed),
+    APR_UINT64_C(0x92746b9be2f8552c), APR_UINT64_C(0x32fd3cf5b4e49bb4),
+    APR_UINT64_C(0xb7118682dbb66a77), APR_UINT64_C(0x3fbc8c33221dc2a1),
+    APR_UINT64_C(0xe4d5e82392a40515), APR_UINT64_C(0x0fabaf3feaa5334a),
+    APR_UINT64_C(0x8f05b1163ba6832d), APR_UINT64_C(0x29cb4d87f2a7400e),
+    APR_UINT64_C(0xb2c71d5bca9023f8), APR_UINT64_C(0x743e20e9ef511012),
+    APR_UINT64_C(0xdf78e4b2bd342cf6), APR_UINT64_C(0x914da9246b255416),
+    APR_UINT64_C(0x8bab8eefb6409c1a), APR_UINT64_C(0x1ad089b6c2f7548e),
+    APR_UINT64_C(0xae9672aba3d0c320), APR_UINT64_C(0xa184ac2473b529b1),
+    APR_UINT64_C(0xda3c0f568cc4f3e8), APR_UINT64_C(0xc9e5d72d90a2741e),
+    APR_UINT64_C(0x8865899617fb1871), APR_UINT64_C(0x7e2fa67c7a658892),
+    APR_UINT64_C(0xaa7eebfb9df9de8d), APR_UINT64_C(0xddbb901b98feeab7),
+    APR_UINT64_C(0xd51ea6fa85785631), APR_UINT64_C(0x552a74227f3ea565),
+    APR_UINT64_C(0x8533285c936b35de), APR_UINT64_C(0xd53a88958f87275f),
+    APR_UINT64_C(0xa67ff273b8460356), APR_UINT64_C(0x8a892abaf368f137),
+    APR_UINT64_C(0xd01fef10a657842c), APR_UINT64_C(0x2d2b7569b0432d85),
+    APR_UINT64_C(0x8213f56a67f6b29b), APR_UINT64_C(0x9c3b29620e29fc73),
+    APR_UINT64_C(0xa298f2c501f45f42), APR_UINT64_C(0x8349f3ba91b47b8f),
+    APR_UINT64_C(0xcb3f2f7642717713), APR_UINT64_C(0x241c70a936219a73),
+    APR_UINT64_C(0xfe0efb53d30dd4d7), APR_UINT64_C(0xed238cd383aa0110),
+    APR_UINT64_C(0x9ec95d1463e8a506), APR_UINT64_C(0xf4363804324a40aa),
+    APR_UINT64_C(0xc67bb4597ce2ce48), APR_UINT64_C(0xb143c6053edcd0d5),
+    APR_UINT64_C(0xf81aa16fdc1b81da), APR_UINT64_C(0xdd94b7868e94050a),
+    APR_UINT64_C(0x9b10a4e5e9913128), APR_UINT64_C(0xca7cf2b4191c8326),
+    APR_UINT64_C(0xc1d4ce1f63f57d72), APR_UINT64_C(0xfd1c2f611f63a3f0),
+    APR_UINT64_C(0xf24a01a73cf2dccf), APR_UINT64_C(0xbc633b39673c8cec),
+    APR_UINT64_C(0x976e41088617ca01), APR_UINT64_C(0xd5be0503e085d813),
+    APR_UINT64_C(0xbd49d14aa79dbc82), APR_UINT64_C(0x4b2d8644d8a74e18),
+    APR_UINT64_C(0xec9c459d51852ba2), APR_UINT64_C(0xddf8e7d60ed1219e),
+    APR_UINT64_C(0x93e1ab8252f33b45), APR_UINT64_C(0xcabb90e5c942b503),
+    APR_UINT64_C(0xb8da1662e7b00a17), APR_UINT64_C(0x3d6a751f3b936243),
+    APR_UINT64_C(0xe7109bfba19c0c9d), APR_UINT64_C(0x0cc512670a783ad4),
+    APR_UINT64_C(0x906a617d450187e2), APR_UINT64_C(0x27fb2b80668b24c5),
+    APR_UINT64_C(0xb484f9dc9641e9da), APR_UINT64_C(0xb1f9f660802dedf6),
+    APR_UINT64_C(0xe1a63853bbd26451), APR_UINT64_C(0x5e7873f8a0396973),
+    APR_UINT64_C(0x8d07e33455637eb2), APR_UINT64_C(0xdb0b487b6423e1e8),
+    APR_UINT64_C(0xb049dc016abc5e5f), APR_UINT64_C(0x91ce1a9a3d2cda62),
+    APR_UINT64_C(0xdc5c5301c56b75f7), APR_UINT64_C(0x7641a140cc7810fb),
+    APR_UINT64_C(0x89b9b3e11b6329ba), APR_UINT64_C(0xa9e904c87fcb0a9d),
+    APR_UINT64_C(0xac2820d9623bf429), APR_UINT64_C(0x546345fa9fbdcd44),
+    APR_UINT64_C(0xd732290fbacaf133), APR_UINT64_C(0xa97c177947ad4095),
+    APR_UINT64_C(0x867f59a9d4bed6c0), APR_UINT64_C(0x49ed8eabcccc485d),
+    APR_UINT64_C(0xa81f301449ee8c70), APR_UINT64_C(0x5c68f256bfff5a74),
+    APR_UINT64_C(0xd226fc195c6a2f8c), APR_UINT64_C(0x73832eec6fff3111),
+    APR_UINT64_C(0x83585d8fd9c25db7), APR_UINT64_C(0xc831fd53c5ff7eab),
+    APR_UINT64_C(0xa42e74f3d032f525), APR_UINT64_C(0xba3e7ca8b77f5e55),
+    APR_UINT64_C(0xcd3a1230c43fb26f), APR_UINT64_C(0x28ce1bd2e55f35eb),
+    APR_UINT64_C(0x80444b5e7aa7cf85), APR_UINT64_C(0x7980d163cf5b81b3),
+    APR_UINT64_C(0xa0555e361951c366), APR_UINT64_C(0xd7e105bcc332621f),
+    APR_UINT64_C(0xc86ab5c39fa63440), APR_UINT64_C(0x8dd9472bf3fefaa7),
+    APR_UINT64_C(0xfa856334878fc150), APR_UINT64_C(0xb14f98f6f0feb951),
+    APR_UINT64_C(0x9c935e00d4b9d8d2), APR_UINT64_C(0x6ed1bf9a569f33d3),
+    APR_UINT64_C(0xc3b8358109e84f07), APR_UINT64_C(0x0a862f80ec4700c8),
+    APR_UINT64_C(0xf4a642e14c6262c8), APR_UINT64_C(0xcd27bb612758c0fa),
+    APR_UINT64_C(0x98e7e9cccfbd7dbd), APR_UINT64_C(0x8038d51cb897789c),
+    APR_UINT64_C(0xbf21e44003acdd2c), APR_UINT64_C(0xe0470a63e6bd56c3),
+    APR_UINT64_C(0xeeea5d5004981478), APR_UINT64_C(0x1858ccfce06cac74),
+    APR_UINT64_C(0x95527a5202df0ccb), APR_UINT64_C(0x0f37801e0c43ebc8),
+    APR_UINT64_C(0xbaa718e68396cffd), APR_UINT64_C(0xd30560258f54e6ba),
+    APR_UINT64_C(0xe950df20247c83fd), APR_UINT64_C(0x47c6b82ef32a2069),
+    APR_UINT64_C(0x91d28b7416cdd27e), APR_UINT64_C(0x4cdc331d57fa5441),
+    APR_UINT64_C(0xb6472e511c81471d), APR_UINT64_C(0xe0133fe4adf8e952),
+    APR_UINT64_C(0xe3d8f9e563a198e5), APR_UINT64_C(0x58180fddd97723a6),
+    APR_UINT64_C(0x8e679c2f5e44ff8f), APR_UINT64_C(0x570f09eaa7ea7648),};
+
+/* The powers of ten exactly represented by a double */
+static const double dtoa_exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Whether the double arithmetic rounds to double precision, for the
+ * Clinger fast path to be exact (not with the x87 unit, say).
+ */
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+#define DTOA_CLINGER 0
+#else
+#define DTOA_CLINGER 1
+#endif
+
+/* floor(q * log2(10)) + 63, for q in [-342, 308] */
+static APR_INLINE int dtoa_power(int q)
+{
+    apr_int64_t x = (apr_int64_t)q * (152170 + 65536);
+
+    return (int)((x >= 0 ? x : x - 65535) / 65536) + 63;
+}
+
+/* The bits of w * 10^q rounded to the nearest double, after Eisel-Lemire,
+ * or -1 if undecided.
+ */
+static apr_int64_t dtoa_eisel_lemire(apr_uint64_t w, int q)
+{
+    const apr_uint64_t *pow5;
+    apr_uint64_t hi, lo, mantissa;
+    int lz, upperbit, shift;
+    apr_int64_t power2;
+
+    if (!w || q < -342) {
+        return 0;
+    }
+    if (q > 308) {
+        return (apr_int64_t)DTOA_EXPONENT;
+    }
+
+    lz = dtoa_clz64(w);
+    w <<= lz;
+
+    pow5 = dtoa_pow5_128 + 2 * (q + 342);
+    hi = dtoa_mul128(w, pow5[0], &lo);
+    if ((hi & 0x1FF) == 0x1FF) {
+        /* the truncation of 5^q may matter, use its next 64 bits */
+        apr_uint64_t lo2, hi2 = dtoa_mul128(w, pow5[1], &lo2);
+
+        lo += hi2;
+        if (hi2 > lo) {
+            hi++;
+        }
+    }
+    if (lo == ~APR_UINT64_C(0) && (q < -27 || q > 55)) {
+        return -1;
+    }
+
+    upperbit = (int)(hi >> 63);
+    shift = upperbit + 64 - 52 - 3;
+    mantissa = hi >> shift;
+    power2 = dtoa_power(q) + upperbit - lz + 1023;
+
+    if (power2 <= 0) {
+        /* subnormal */
+        if (-power2 + 1 >= 64) {
+            return 0;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = (mantissa < DTOA_HIDDEN_BIT) ? 0 : 1;
+        return (apr_int64_t)(((apr_uint64_t)power2 << 52) | mantissa);
+    }
+
+    /* exactly halfway, round to even */
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1
+            && (mantissa << shift) == hi) {
+        mantissa &= ~APR_UINT64_C(1);
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (DTOA_HIDDEN_BIT << 1)) {
+        mantissa = DTOA_HIDDEN_BIT;
+        power2++;
+    }
+    mantissa &= ~DTOA_HIDDEN_BIT;
+    if (power2 >= 0x7FF) {
+        return (apr_int64_t)DTOA_EXPONENT;
+    }
+
+    return (apr_int64_t)(((apr_uint64_t)power2 << 52) | mantissa);
+}
+
+APR_DECLARE(double) apr_strtod_fast(const char *buf, char **end)
+{
+    const char *p = buf, *q;
+    apr_uint64_t w = 0, bits;
+    apr_int64_t exp10 = 0, r;
+    int neg = 0, sig = 0, seen = 0, truncated = 0;
+    double d;
+
+    while (apr_isspace(*p)) {
+        p++;
+    }
+    if (*p == '-' || *p == '+') {
+        neg = (*p++ == '-');
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        goto fallback;
+    }
+
+    /* up to 19 significant digits, which fit in 64 bits */
+    for (; apr_isdigit(*p); p++) {
+        if (sig < 19) {
+            w = w * 10 + (*p - '0');
+            sig += (w != 0);
+        }
+        else {
+            exp10++;
+            truncated |= (*p != '0');
+        }
+        seen = 1;
+    }
+    if (*p == '.') {
+        for (p++; apr_isdigit(*p); p++) {
+            if (sig < 19) {
+                w = w * 10 + (*p - '0');
+                sig += (w != 0);
+                exp10--;
+            }
+            else {
+                truncated |= (*p != '0');
+            }
+            seen = 1;
+        }
+    }
+    if (!seen) {
+        /* infinity, nan, or nothing */
+        goto fallback;
+    }
+    if (*p == 'e' || *p == 'E') {
+        apr_int64_t e = 0;
+        int eneg = 0;
+
+        q = p + 1;
+        if (*q == '-' || *q == '+') {
+            eneg = (*q++ == '-');
+        }
+        if (apr_isdigit(*q)) {
+            for (; apr_isdigit(*q); q++) {
+                if (e < 100000) {
+                    e = e * 10 + (*q - '0');
+                }
+            }
+            exp10 += eneg ? -e : e;
+            p = q;
+        }
+    }
+    if (end) {
+        *end = (char *)p;
+    }
+    errno = 0;
+
+    if (!w) {
+        return neg ? -0.0 : 0.0;
+    }
+
+#if DTOA_CLINGER
+    if (!truncated && w <= (APR_UINT64_C(1) << 53)) {
+        if (exp10 >= -22 && exp10 <= 22) {
+            d = (double)w;
+            d = (exp10 < 0) ? d / dtoa_exact_pow10[-exp10]
+                            : d * dtoa_exact_pow10[exp10];
+            return neg ? -d : d;
+        }
+        if (exp10 > 22 && exp10 <= 22 + 15
+                && w <= (APR_UINT64_C(1) << 53) / dtoa_pow10[exp10 - 22]) {
+            d = (double)(w * dtoa_pow10[exp10 - 22]) * 1e22;
+            return neg ? -d : d;
+        }
+    }
+#endif
+
+    if (exp10 < -400) {
+        exp10 = -400;
+    }
+    else if (exp10 > 400) {
+        exp10 = 400;
+    }
+    r = dtoa_eisel_lemire(w, (int)exp10);
+    if (r >= 0 && truncated
+            && dtoa_eisel_lemire(w + 1, (int)exp10) != r) {
+        /* the digits beyond the 19th decide */
+        r = -1;
+    }
+    if (r < 0) {
+        return strtod(buf, NULL);
+    }
+
+    bits = (apr_uint64_t)r;
+    if (bits == DTOA_EXPONENT || !bits) {
+        errno = ERANGE;
+    }
+    if (neg) {
+        bits |= DTOA_SIGN;
+    }
+    memcpy(&d, &bits, sizeof(d));
+
+    return d;
+
+fallback:
+    return strtod(buf, end);
+}
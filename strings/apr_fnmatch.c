@@ -480,3 +480,335 @@ APR_DECLARE(apr_status_t) apr_match_glob(const char *pattern,
     apr_dir_close(dir);
     return APR_SUCCESS;
 }
+
+
+/* Compiled patterns: the pattern is parsed once into a program of tokens
+ * each matching one character of the string (but the '*'), the brackets
+ * into the bitmaps of the characters they match, as fnmatch_ch() tells,
+ * so the semantics are exactly those of apr_fnmatch().  The leading
+ * literal characters are kept apart as a prefix, compared at once.
+ */
+typedef enum {
+    FNM_TOK_CHAR,       /* a literal character (lower case if caseless) */
+    FNM_TOK_ANY,        /* '?' */
+    FNM_TOK_SET,        /* a bracket expression */
+    FNM_TOK_STAR,       /* '*', consecutive ones merged */
+    FNM_TOK_SLASH       /* a '/' in APR_FNM_PATHNAME mode */
+} fnmatch_tok_e;
+
+typedef struct {
+    fnmatch_tok_e type;
+    unsigned char c;
+    const unsigned char *set;   /* 256 bits */
+} fnmatch_tok_t;
+
+struct apr_fnmatch_t {
+    const char *pattern;
+    int flags;
+    /* The literal characters (and slashes) leading the pattern */
+    const char *prefix;
+    apr_size_t plen;
+    /* Whether the tokens start a segment of the string, for APR_FNM_PERIOD */
+    int segment;
+    const fnmatch_tok_t *toks;
+    int ntoks;
+};
+
+#define FNM_FOLD(c, nocase) \
+    ((nocase) ? (unsigned char)apr_tolower(c) : (unsigned char)(c))
+
+APR_DECLARE(apr_fnmatch_t *) apr_fnmatch_compile(const char *pattern,
+                                                 int flags, apr_pool_t *p)
+{
+    const int nocase = !!(flags & APR_FNM_CASE_BLIND);
+    const int escape = !(flags & APR_FNM_NOESCAPE);
+    const int slash = !!(flags & APR_FNM_PATHNAME);
+    apr_fnmatch_t *fnm = apr_pcalloc(p, sizeof(*fnm));
+    fnmatch_tok_t *toks, *tok;
+    char *prefix;
+    const char *pat;
+
+    fnm->pattern = apr_pstrdup(p, pattern);
+    fnm->flags = flags;
+    toks = apr_palloc(p, (strlen(pattern) + 1) * sizeof(*toks));
+
+    for (pat = fnm->pattern, tok = toks; *pat; tok++) {
+        if (slash && (*pat == '/'
+                      || (escape && *pat == '\\' && pat[1] == '/'))) {
+            tok->type = FNM_TOK_SLASH;
+            tok->c = '/';
+            pat += (*pat == '/') ? 1 : 2;
+        }
+        else if (*pat == '*') {
+            tok->type = FNM_TOK_STAR;
+            while (*pat == '*') {
+                ++pat;
+            }
+        }
+        else if (*pat == '?') {
+            tok->type = FNM_TOK_ANY;
+            ++pat;
+        }
+        else if (*pat == '[') {
+            static const char probe[2] = {'a', 0};
+            const char *end = pat, *str = probe;
+
+            /* A '[' not opening a (well formed) bracket is literal */
+            fnmatch_ch(&end, &str, flags);
+            if (end == pat + 1) {
+                tok->type = FNM_TOK_CHAR;
+                tok->c = '[';
+                ++pat;
+            }
+            else {
+                unsigned char *set = apr_pcalloc(p, 256 / 8);
+                int c;
+
+                for (c = 1; c < 256; c++) {
+                    char s[2];
+                    const char *b = pat;
+
+                    s[0] = (char)c;
+                    s[1] = '\0';
+                    str = s;
+                    if (!fnmatch_ch(&b, &str, flags)) {
+                        set[c >> 3] |= 1 << (c & 7);
+                    }
+                }
+                tok->type = FNM_TOK_SET;
+                tok->set = set;
+                pat = end;
+            }
+        }
+        else {
+            if (escape && *pat == '\\' && pat[1]) {
+                ++pat;
+            }
+            tok->type = FNM_TOK_CHAR;
+            tok->c = FNM_FOLD(*pat, nocase);
+            ++pat;
+        }
+    }
+
+    /* The literal prefix */
+    fnm->prefix = prefix = apr_palloc(p, tok - toks + 1);
+    for (fnm->toks = toks; fnm->toks < tok
+                           && (fnm->toks->type == FNM_TOK_CHAR
+                               || fnm->toks->type == FNM_TOK_SLASH);
+         fnm->toks++) {
+        prefix[fnm->plen++] = (char)fnm->toks->c;
+    }
+    prefix[fnm->plen] = '\0';
+    fnm->ntoks = tok - fnm->toks;
+    fnm->segment = !fnm->plen || (slash && prefix[fnm->plen - 1] == '/');
+
+    return fnm;
+}
+
+/* Match the string past the prefix against the tokens, the classic way:
+ * on a mismatch the last '*' swallows one more character and the tokens
+ * following it are tried again.  A '*' never swallows a '/' with
+ * APR_FNM_PATHNAME, so the segments match independently.
+ */
+static int fnmatch_tokens(const apr_fnmatch_t *fnm, const char *string)
+{
+    const int nocase = !!(fnm->flags & APR_FNM_CASE_BLIND);
+    const int slash = !!(fnm->flags & APR_FNM_PATHNAME);
+    const int period = !!(fnm->flags & APR_FNM_PERIOD);
+    const fnmatch_tok_t *toks = fnm->toks;
+    const char *s = string, *star_s = NULL;
+    int i = 0, star_i = -1;
+
+    /* A leading period must be matched by a period */
+    if (period && fnm->segment && *s == '.'
+            && (!fnm->ntoks || toks[0].type != FNM_TOK_CHAR)) {
+        return APR_FNM_NOMATCH;
+    }
+
+    while (*s) {
+        if (i < fnm->ntoks) {
+            const fnmatch_tok_t *tok = &toks[i];
+            unsigned char c = (unsigned char)*s;
+
+            switch (tok->type) {
+            case FNM_TOK_STAR:
+                star_i = ++i;
+                star_s = s;
+                continue;
+            case FNM_TOK_ANY:
+                if (!slash || c != '/') {
+                    ++s;
+                    ++i;
+                    continue;
+                }
+                break;
+            case FNM_TOK_SET:
+                if ((!slash || c != '/')
+                        && (tok->set[c >> 3] & (1 << (c & 7)))) {
+                    ++s;
+                    ++i;
+                    continue;
+                }
+                break;
+            case FNM_TOK_CHAR:
+                if (FNM_FOLD(c, nocase) == tok->c) {
+                    ++s;
+                    ++i;
+                    continue;
+                }
+                break;
+            case FNM_TOK_SLASH:
+                if (c == '/') {
+                    ++s;
+                    ++i;
+                    star_i = -1;
+                    if (period && *s == '.' && (i == fnm->ntoks
+                                || toks[i].type != FNM_TOK_CHAR)) {
+                        return APR_FNM_NOMATCH;
+                    }
+                    continue;
+                }
+                break;
+            }
+        }
+
+        /* Mismatch, let the last '*' of the segment swallow one more */
+        if (star_i < 0 || (slash && *star_s == '/')) {
+            return APR_FNM_NOMATCH;
+        }
+        s = ++star_s;
+        i = star_i;
+    }
+
+    while (i < fnm->ntoks && toks[i].type == FNM_TOK_STAR) {
+        ++i;
+    }
+
+    return (i == fnm->ntoks) ? 0 : APR_FNM_NOMATCH;
+}
+
+APR_DECLARE(int) apr_fnmatch_exec(const apr_fnmatch_t *fnm,
+                                  const char *string)
+{
+    apr_size_t i;
+
+    if (fnm->flags & APR_FNM_CASE_BLIND) {
+        for (i = 0; i < fnm->plen; i++) {
+            if ((unsigned char)apr_tolower(string[i])
+                    != (unsigned char)fnm->prefix[i]) {
+                return APR_FNM_NOMATCH;
+            }
+        }
+    }
+    else if (strncmp(string, fnm->prefix, fnm->plen)) {
+        return APR_FNM_NOMATCH;
+    }
+
+    return fnmatch_tokens(fnm, string + fnm->plen);
+}
+
+
+/* Lists of patterns: a trie of their prefixes, walked along the string
+ * once, each pattern being tried past its prefix only when the walk
+ * reaches its node.
+ */
+typedef struct {
+    int child;          /* the first child, or 0 */
+    int sibling;        /* the next sibling, or 0 */
+    int first;          /* the first pattern of the node, or -1 */
+    unsigned char c;
+} fnmatch_node_t;
+
+struct apr_fnmatch_list_t {
+    apr_fnmatch_t **fnms;
+    /* The next pattern of the same node (by increasing index), or -1 */
+    int *next;
+    const fnmatch_node_t *nodes;
+    int flags;
+};
+
+APR_DECLARE(apr_fnmatch_list_t *) apr_fnmatch_list_compile(
+        const apr_array_header_t *patterns, int flags, apr_pool_t *p)
+{
+    apr_fnmatch_list_t *list = apr_pcalloc(p, sizeof(*list));
+    apr_array_header_t *nodes = apr_array_make(p, 64, sizeof(fnmatch_node_t));
+    fnmatch_node_t *node;
+    int i;
+
+    list->flags = flags;
+    list->fnms = apr_palloc(p, (patterns->nelts + 1)
+                               * sizeof(apr_fnmatch_t *));
+    list->next = apr_palloc(p, (patterns->nelts + 1) * sizeof(int));
+
+    node = apr_array_push(nodes);
+    node->child = node->sibling = 0;
+    node->first = -1;
+
+    /* Backwards, so that the lists of the nodes end up in order */
+    for (i = patterns->nelts - 1; i >= 0; i--) {
+        apr_fnmatch_t *fnm = apr_fnmatch_compile(
+                APR_ARRAY_IDX(patterns, i, const char *), flags, p);
+        apr_size_t k;
+        int n = 0;
+
+        for (k = 0; k < fnm->plen; k++) {
+            unsigned char c = (unsigned char)fnm->prefix[k];
+            int m = ((fnmatch_node_t *)nodes->elts)[n].child;
+
+            while (m && ((fnmatch_node_t *)nodes->elts)[m].c != c) {
+                m = ((fnmatch_node_t *)nodes->elts)[m].sibling;
+            }
+            if (!m) {
+                m = nodes->nelts;
+                node = apr_array_push(nodes);
+                node->c = c;
+                node->child = 0;
+                node->first = -1;
+                node->sibling = ((fnmatch_node_t *)nodes->elts)[n].child;
+                ((fnmatch_node_t *)nodes->elts)[n].child = m;
+            }
+            n = m;
+        }
+
+        node = &((fnmatch_node_t *)nodes->elts)[n];
+        list->fnms[i] = fnm;
+        list->next[i] = node->first;
+        node->first = i;
+    }
+    list->nodes = (const fnmatch_node_t *)nodes->elts;
+
+    return list;
+}
+
+APR_DECLARE(int) apr_fnmatch_list_exec(const apr_fnmatch_list_t *list,
+                                       const char *string)
+{
+    const int nocase = !!(list->flags & APR_FNM_CASE_BLIND);
+    const fnmatch_node_t *nodes = list->nodes;
+    const char *s = string;
+    int n = 0, best = -1, i;
+
+    for (;;) {
+        unsigned char c;
+
+        for (i = nodes[n].first; i >= 0 && (best < 0 || i < best);
+             i = list->next[i]) {
+            if (!fnmatch_tokens(list->fnms[i], s)) {
+                best = i;
+                break;
+            }
+        }
+        if (!*s) {
+            break;
+        }
+
+        c = FNM_FOLD(*s, nocase);
+        for (n = nodes[n].child; n && nodes[n].c != c; n = nodes[n].sibling);
+        if (!n) {
+            break;
+        }
+        ++s;
+    }
+
+    return best;
+}
@@ -104,6 +104,13 @@ static char *apr_cvt(double arg, int ndigits, int *decpt, int *sign,
      * Do integer part
      */
     if (fi != 0) {
+        /* only the leading digits of the huge numbers fit, the rest is
+         * counted in the exponent and padded with zeros by the caller
+         */
+        while (fi >= 1e70) {
+            fi = floor(fi / 10);
+            r2++;
+        }
         p1 = &buf[NDIG];
         while (p1 > &buf[0] && fi != 0) {
             fj = modf(fi / 10, &fi);
@@ -256,6 +263,35 @@ static char *apr_gcvt(double number, int ndigit, char *buf, boolean_e altform)
     cc++;                                           \
 }
 
+/*
+ * The INS_CHARS macro inserts len characters at once, flushing as
+ * INS_CHAR would
+ */
+#define INS_CHARS(str, len, sp, bep, cc)            \
+{                                                   \
+    const char *s_ = (str);                         \
+    apr_size_t n_ = (len);                          \
+                                                    \
+    cc += (int)n_;                                  \
+    while (sp && n_) {                              \
+        apr_size_t k_;                              \
+        if (sp >= bep) {                            \
+            vbuff->curpos = sp;                     \
+            if (flush_func(vbuff))                  \
+                return -1;                          \
+            sp = vbuff->curpos;                     \
+            bep = vbuff->endpos;                    \
+        }                                           \
+        k_ = bep - sp;                              \
+        if (k_ > n_)                                \
+            k_ = n_;                                \
+        memcpy(sp, s_, k_);                         \
+        sp += k_;                                   \
+        s_ += k_;                                   \
+        n_ -= k_;                                   \
+    }                                               \
+}
+
 #define NUM(c) (c - '0')
 
 #define STR_TO_DEC(str, num)                        \
@@ -310,6 +346,14 @@ while (width > len)
     has_prefix=YES;
 
 
+/* "00" to "99", for the decimal conversions to write two digits at once */
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
 /*
  * Convert num to its decimal format.
  * Return value:
@@ -355,15 +399,23 @@ static char *conv_10(register apr_int32_t num, register int is_unsigned,
     }
 
     /*
-     * We use a do-while loop so that we write at least 1 digit 
+     * Two digits at a time, then the last one if any
      */
-    do {
-        register apr_uint32_t new_magnitude = magnitude / 10;
+    while (magnitude >= 100) {
+        register apr_uint32_t new_magnitude = magnitude / 100;
+        const char *d = &digit_pairs[(magnitude - new_magnitude * 100) * 2];
 
-        *--p = (char) (magnitude - new_magnitude * 10 + '0');
+        *--p = d[1];
+        *--p = d[0];
         magnitude = new_magnitude;
     }
-    while (magnitude);
+    if (magnitude >= 10) {
+        *--p = digit_pairs[magnitude * 2 + 1];
+        *--p = digit_pairs[magnitude * 2];
+    }
+    else {
+        *--p = (char) (magnitude + '0');
+    }
 
     *len = buf_end - p;
     return (p);
@@ -407,15 +459,24 @@ static char *conv_10_quad(apr_int64_t num, register int is_unsigned,
     }
 
     /*
-     * We use a do-while loop so that we write at least 1 digit 
+     * Two digits at a time, the magnitude being above 32 bits
      */
     do {
-        apr_uint64_t new_magnitude = magnitude / 10;
+        apr_uint64_t new_magnitude = magnitude / 100;
+        const char *d = &digit_pairs[(magnitude - new_magnitude * 100) * 2];
 
-        *--p = (char) (magnitude - new_magnitude * 10 + '0');
+        *--p = d[1];
+        *--p = d[0];
         magnitude = new_magnitude;
     }
-    while (magnitude);
+    while (magnitude >= 100);
+    if (magnitude >= 10) {
+        *--p = digit_pairs[magnitude * 2 + 1];
+        *--p = digit_pairs[magnitude * 2];
+    }
+    else {
+        *--p = (char) (magnitude + '0');
+    }
 
     *len = buf_end - p;
     return (p);
@@ -550,7 +611,7 @@ static char *conv_fp(register char format, register double num,
         }
         else {
             while (decimal_point-- > 0)
-                *s++ = *p++;
+                *s++ = *p ? *p++ : '0';
             if (precision > 0 || add_dp)
                 *s++ = '.';
         }
@@ -567,6 +628,17 @@ static char *conv_fp(register char format, register double num,
     while (*p)
         *s++ = *p++;
 
+    /*
+     * pad the fraction of the huge numbers, whose digits all went to
+     * the integer part
+     */
+    if (format == 'f' && precision > 0 && s[-1] == '.') {
+        if (precision > NDIG - 2)
+            precision = NDIG - 2;
+        while (precision-- > 0)
+            *s++ = '0';
+    }
+
     if (format != 'f') {
         char temp[EXPONENT_LENGTH];        /* for exponent conversion */
         apr_size_t t_len;
@@ -677,15 +749,175 @@ static char *conv_os_thread_t_hex(apr_os_thread_t *tid, char *buf_end, apr_size_
 #endif
 
 /*
- * Do format conversion placing the output in buffer
+ * A conversion specification, as parsed from the format
  */
-APR_DECLARE(int) apr_vformatter(int (*flush_func)(apr_vformatter_buff_t *),
-    apr_vformatter_buff_t *vbuff, const char *fmt, va_list ap)
+typedef struct {
+    char conv;                  /* the conversion, NUL to stop */
+    char conv_p;                /* the extension following a 'p' */
+    char pad_char;
+    unsigned char var_type;
+    unsigned char left, alternate_form, print_sign, print_blank;
+    unsigned char adjust_width, adjust_precision;
+    unsigned char width_arg, precision_arg; /* '*' */
+    apr_size_t min_width, precision;
+} format_spec_t;
+
+enum var_type_enum {
+    IS_QUAD, IS_LONG, IS_SHORT, IS_INT
+};
+
+/*
+ * The literal text and the conversion following it, the last one of a
+ * compiled format stopping (NUL)
+ */
+typedef struct {
+    const char *text;
+    apr_size_t len;
+    format_spec_t spec;
+} format_item_t;
+
+struct apr_format_t {
+    const char *fmt;
+    format_item_t *items;
+};
+
+/*
+ * Parse the conversion specification following a '%', returning the
+ * position of its last character (or of the NUL ending the format)
+ */
+static const char *parse_spec(const char *fmt, format_spec_t *spec)
+{
+    spec->left = spec->alternate_form = NO;
+    spec->print_sign = spec->print_blank = NO;
+    spec->adjust_width = spec->adjust_precision = NO;
+    spec->width_arg = spec->precision_arg = NO;
+    spec->min_width = spec->precision = 0;
+    spec->pad_char = ' ';
+    spec->conv_p = NUL;
+
+    /*
+     * Try to avoid checking for flags, width or precision
+     */
+    if (!apr_islower(*fmt)) {
+        /*
+         * Recognize flags: -, #, BLANK, +
+         */
+        for (;; fmt++) {
+            if (*fmt == '-')
+                spec->left = YES;
+            else if (*fmt == '+')
+                spec->print_sign = YES;
+            else if (*fmt == '#')
+                spec->alternate_form = YES;
+            else if (*fmt == ' ')
+                spec->print_blank = YES;
+            else if (*fmt == '0')
+                spec->pad_char = '0';
+            else
+                break;
+        }
+
+        /*
+         * Check if a width was specified
+         */
+        if (apr_isdigit(*fmt)) {
+            STR_TO_DEC(fmt, spec->min_width);
+            spec->adjust_width = YES;
+        }
+        else if (*fmt == '*') {
+            fmt++;
+            spec->adjust_width = YES;
+            spec->width_arg = YES;
+        }
+
+        /*
+         * Check if a precision was specified
+         */
+        if (*fmt == '.') {
+            spec->adjust_precision = YES;
+            fmt++;
+            if (apr_isdigit(*fmt)) {
+                STR_TO_DEC(fmt, spec->precision);
+            }
+            else if (*fmt == '*') {
+                fmt++;
+                spec->precision_arg = YES;
+            }
+        }
+    }
+
+    /*
+     * Modifier check.  In same cases, APR_OFF_T_FMT can be
+     * "lld" and APR_INT64_T_FMT can be "ld" (that is, off_t is
+     * "larger" than int64). Check that case 1st.
+     * Note that if APR_OFF_T_FMT is "d",
+     * the first if condition is never true. If APR_INT64_T_FMT
+     * is "d' then the second if condition is never true.
+     */
+    if ((sizeof(APR_OFF_T_FMT) > sizeof(APR_INT64_T_FMT)) &&
+        ((sizeof(APR_OFF_T_FMT) == 4 &&
+         fmt[0] == APR_OFF_T_FMT[0] &&
+         fmt[1] == APR_OFF_T_FMT[1]) ||
+        (sizeof(APR_OFF_T_FMT) == 3 &&
+         fmt[0] == APR_OFF_T_FMT[0]) ||
+        (sizeof(APR_OFF_T_FMT) > 4 &&
+         strncmp(fmt, APR_OFF_T_FMT, 
+                 sizeof(APR_OFF_T_FMT) - 2) == 0))) {
+        /* Need to account for trailing 'd' and null in sizeof() */
+        spec->var_type = IS_QUAD;
+        fmt += (sizeof(APR_OFF_T_FMT) - 2);
+    }
+    else if ((sizeof(APR_INT64_T_FMT) == 4 &&
+         fmt[0] == APR_INT64_T_FMT[0] &&
+         fmt[1] == APR_INT64_T_FMT[1]) ||
+        (sizeof(APR_INT64_T_FMT) == 3 &&
+         fmt[0] == APR_INT64_T_FMT[0]) ||
+        (sizeof(APR_INT64_T_FMT) > 4 &&
+         strncmp(fmt, APR_INT64_T_FMT, 
+                 sizeof(APR_INT64_T_FMT) - 2) == 0)) {
+        /* Need to account for trailing 'd' and null in sizeof() */
+        spec->var_type = IS_QUAD;
+        fmt += (sizeof(APR_INT64_T_FMT) - 2);
+    }
+    else if (*fmt == 'q') {
+        spec->var_type = IS_QUAD;
+        fmt++;
+    }
+    else if (*fmt == 'l') {
+        spec->var_type = IS_LONG;
+        fmt++;
+    }
+    else if (*fmt == 'h') {
+        spec->var_type = IS_SHORT;
+        fmt++;
+    }
+    else {
+        spec->var_type = IS_INT;
+    }
+
+    spec->conv = *fmt;
+    if (*fmt == 'p') {
+        spec->conv_p = *++fmt;
+        /* if %p ends the string, oh well ignore it */
+        if (spec->conv_p == NUL) {
+            spec->conv = NUL;
+        }
+    }
+
+    return fmt;
+}
+
+/*
+ * Do format conversion placing the output in buffer, from the format
+ * string fmt parsed on the fly or from the items of a compiled one
+ */
+static int format_core(int (*flush_func)(apr_vformatter_buff_t *),
+                       apr_vformatter_buff_t *vbuff, const char *fmt,
+                       const format_item_t *item, va_list ap)
 {
     register char *sp;
     register char *bep;
     register int cc = 0;
-    register apr_size_t i;
 
     register char *s = NULL;
     char *q;
@@ -708,9 +940,6 @@ APR_DECLARE(int) apr_vformatter(int (*flush_func)(apr_vformatter_buff_t *),
     char num_buf[NUM_BUF_SIZE];
     char char_buf[2];                /* for printing %% and %<unknown> */
 
-    enum var_type_enum {
-            IS_QUAD, IS_LONG, IS_SHORT, IS_INT
-    };
     enum var_type_enum var_type = IS_INT;
 
     /*
@@ -723,138 +952,76 @@ APR_DECLARE(int) apr_vformatter(int (*flush_func)(apr_vformatter_buff_t *),
     boolean_e adjust_width;
     int is_negative;
 
+    format_spec_t parsed;
+    const format_spec_t *spec;
+    const char *text;
+    apr_size_t len;
+
     sp = vbuff->curpos;
     bep = vbuff->endpos;
 
-    while (*fmt) {
-        if (*fmt != '%') {
-            INS_CHAR(*fmt, sp, bep, cc);
+    for (;;) {
+        /*
+         * The literal text up to the next conversion
+         */
+        if (item) {
+            text = item->text;
+            len = item->len;
+            spec = &item->spec;
+            item++;
         }
         else {
+            for (text = fmt; *fmt && *fmt != '%'; fmt++);
+            len = fmt - text;
+            parsed.conv = NUL;
+            if (*fmt) {
+                fmt = parse_spec(fmt + 1, &parsed);
+                if (*fmt) {
+                    fmt++;
+                }
+            }
+            spec = &parsed;
+        }
+        INS_CHARS(text, len, sp, bep, cc);
+
+        /*
+         * The last character of the format string was %.
+         * We ignore it.
+         */
+        if (spec->conv == NUL) {
+            break;
+        }
+
+        {
             /*
              * Default variable settings
              */
             boolean_e print_something = YES;
-            adjust = RIGHT;
-            alternate_form = print_sign = print_blank = NO;
-            pad_char = ' ';
+            adjust = spec->left ? LEFT : RIGHT;
+            alternate_form = spec->alternate_form;
+            print_sign = spec->print_sign;
+            print_blank = spec->print_blank;
+            pad_char = spec->pad_char;
             prefix_char = NUL;
-
-            fmt++;
-
-            /*
-             * Try to avoid checking for flags, width or precision
-             */
-            if (!apr_islower(*fmt)) {
-                /*
-                 * Recognize flags: -, #, BLANK, +
-                 */
-                for (;; fmt++) {
-                    if (*fmt == '-')
-                        adjust = LEFT;
-                    else if (*fmt == '+')
-                        print_sign = YES;
-                    else if (*fmt == '#')
-                        alternate_form = YES;
-                    else if (*fmt == ' ')
-                        print_blank = YES;
-                    else if (*fmt == '0')
-                        pad_char = '0';
-                    else
-                        break;
-                }
-
-                /*
-                 * Check if a width was specified
-                 */
-                if (apr_isdigit(*fmt)) {
-                    STR_TO_DEC(fmt, min_width);
-                    adjust_width = YES;
-                }
-                else if (*fmt == '*') {
-                    int v = va_arg(ap, int);
-                    fmt++;
-                    adjust_width = YES;
-                    if (v < 0) {
-                        adjust = LEFT;
-                        min_width = (apr_size_t)(-v);
-                    }
-                    else
-                        min_width = (apr_size_t)v;
+            var_type = spec->var_type;
+
+            adjust_width = spec->adjust_width;
+            min_width = spec->min_width;
+            if (spec->width_arg) {
+                int v = va_arg(ap, int);
+                if (v < 0) {
+                    adjust = LEFT;
+                    min_width = (apr_size_t)(-v);
                 }
                 else
-                    adjust_width = NO;
-
-                /*
-                 * Check if a precision was specified
-                 */
-                if (*fmt == '.') {
-                    adjust_precision = YES;
-                    fmt++;
-                    if (apr_isdigit(*fmt)) {
-                        STR_TO_DEC(fmt, precision);
-                    }
-                    else if (*fmt == '*') {
-                        int v = va_arg(ap, int);
-                        fmt++;
-                        precision = (v < 0) ? 0 : (apr_size_t)v;
-                    }
-                    else
-                        precision = 0;
-                }
-                else
-                    adjust_precision = NO;
+                    min_width = (apr_size_t)v;
             }
-            else
-                adjust_precision = adjust_width = NO;
 
-            /*
-             * Modifier check.  In same cases, APR_OFF_T_FMT can be
-             * "lld" and APR_INT64_T_FMT can be "ld" (that is, off_t is
-             * "larger" than int64). Check that case 1st.
-             * Note that if APR_OFF_T_FMT is "d",
-             * the first if condition is never true. If APR_INT64_T_FMT
-             * is "d' then the second if condition is never true.
-             */
-            if ((sizeof(APR_OFF_T_FMT) > sizeof(APR_INT64_T_FMT)) &&
-                ((sizeof(APR_OFF_T_FMT) == 4 &&
-                 fmt[0] == APR_OFF_T_FMT[0] &&
-                 fmt[1] == APR_OFF_T_FMT[1]) ||
-                (sizeof(APR_OFF_T_FMT) == 3 &&
-                 fmt[0] == APR_OFF_T_FMT[0]) ||
-                (sizeof(APR_OFF_T_FMT) > 4 &&
-                 strncmp(fmt, APR_OFF_T_FMT, 
-                         sizeof(APR_OFF_T_FMT) - 2) == 0))) {
-                /* Need to account for trailing 'd' and null in sizeof() */
-                var_type = IS_QUAD;
-                fmt += (sizeof(APR_OFF_T_FMT) - 2);
-            }
-            else if ((sizeof(APR_INT64_T_FMT) == 4 &&
-                 fmt[0] == APR_INT64_T_FMT[0] &&
-                 fmt[1] == APR_INT64_T_FMT[1]) ||
-                (sizeof(APR_INT64_T_FMT) == 3 &&
-                 fmt[0] == APR_INT64_T_FMT[0]) ||
-                (sizeof(APR_INT64_T_FMT) > 4 &&
-                 strncmp(fmt, APR_INT64_T_FMT, 
-                         sizeof(APR_INT64_T_FMT) - 2) == 0)) {
-                /* Need to account for trailing 'd' and null in sizeof() */
-                var_type = IS_QUAD;
-                fmt += (sizeof(APR_INT64_T_FMT) - 2);
-            }
-            else if (*fmt == 'q') {
-                var_type = IS_QUAD;
-                fmt++;
-            }
-            else if (*fmt == 'l') {
-                var_type = IS_LONG;
-                fmt++;
-            }
-            else if (*fmt == 'h') {
-                var_type = IS_SHORT;
-                fmt++;
-            }
-            else {
-                var_type = IS_INT;
+            adjust_precision = spec->adjust_precision;
+            precision = spec->precision;
+            if (spec->precision_arg) {
+                int v = va_arg(ap, int);
+                precision = (v < 0) ? 0 : (apr_size_t)v;
             }
 
             /*
@@ -868,480 +1035,524 @@ APR_DECLARE(int) apr_vformatter(int (*flush_func)(apr_vformatter_buff_t *),
              * NOTE: pad_char may be set to '0' because of the 0 flag.
              *   It is reset to ' ' by non-numeric formats
              */
-            switch (*fmt) {
-            case 'u':
-                if (var_type == IS_QUAD) {
-                    i_quad = va_arg(ap, apr_uint64_t);
-                    s = conv_10_quad(i_quad, 1, &is_negative,
-                            &num_buf[NUM_BUF_SIZE], &s_len);
-                }
-                else {
-                    if (var_type == IS_LONG)
-                        i_num = (apr_int32_t) va_arg(ap, apr_uint32_t);
-                    else if (var_type == IS_SHORT)
-                        i_num = (apr_int32_t) (unsigned short) va_arg(ap, unsigned int);
-                    else
-                        i_num = (apr_int32_t) va_arg(ap, unsigned int);
-                    s = conv_10(i_num, 1, &is_negative,
-                            &num_buf[NUM_BUF_SIZE], &s_len);
-                }
-                FIX_PRECISION(adjust_precision, precision, s, s_len);
-                break;
+        switch (spec->conv) {
+        case 'u':
+            if (var_type == IS_QUAD) {
+                i_quad = va_arg(ap, apr_uint64_t);
+                s = conv_10_quad(i_quad, 1, &is_negative,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            else {
+                if (var_type == IS_LONG)
+                    i_num = (apr_int32_t) va_arg(ap, apr_uint32_t);
+                else if (var_type == IS_SHORT)
+                    i_num = (apr_int32_t) (unsigned short) va_arg(ap, unsigned int);
+                else
+                    i_num = (apr_int32_t) va_arg(ap, unsigned int);
+                s = conv_10(i_num, 1, &is_negative,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            FIX_PRECISION(adjust_precision, precision, s, s_len);
+            break;
+
+        case 'd':
+        case 'i':
+            if (var_type == IS_QUAD) {
+                i_quad = va_arg(ap, apr_int64_t);
+                s = conv_10_quad(i_quad, 0, &is_negative,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            else {
+                if (var_type == IS_LONG)
+                    i_num = va_arg(ap, apr_int32_t);
+                else if (var_type == IS_SHORT)
+                    i_num = (short) va_arg(ap, int);
+                else
+                    i_num = va_arg(ap, int);
+                s = conv_10(i_num, 0, &is_negative,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            FIX_PRECISION(adjust_precision, precision, s, s_len);
+
+            if (is_negative)
+                prefix_char = '-';
+            else if (print_sign)
+                prefix_char = '+';
+            else if (print_blank)
+                prefix_char = ' ';
+            break;
+
+
+        case 'o':
+            if (var_type == IS_QUAD) {
+                ui_quad = va_arg(ap, apr_uint64_t);
+                s = conv_p2_quad(ui_quad, 3, spec->conv,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            else {
+                if (var_type == IS_LONG)
+                    ui_num = va_arg(ap, apr_uint32_t);
+                else if (var_type == IS_SHORT)
+                    ui_num = (unsigned short) va_arg(ap, unsigned int);
+                else
+                    ui_num = va_arg(ap, unsigned int);
+                s = conv_p2(ui_num, 3, spec->conv,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            FIX_PRECISION(adjust_precision, precision, s, s_len);
+            if (alternate_form && *s != '0') {
+                *--s = '0';
+                s_len++;
+            }
+            break;
 
-            case 'd':
-            case 'i':
-                if (var_type == IS_QUAD) {
-                    i_quad = va_arg(ap, apr_int64_t);
-                    s = conv_10_quad(i_quad, 0, &is_negative,
-                            &num_buf[NUM_BUF_SIZE], &s_len);
+
+        case 'x':
+        case 'X':
+            if (var_type == IS_QUAD) {
+                ui_quad = va_arg(ap, apr_uint64_t);
+                s = conv_p2_quad(ui_quad, 4, spec->conv,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            else {
+                if (var_type == IS_LONG)
+                    ui_num = va_arg(ap, apr_uint32_t);
+                else if (var_type == IS_SHORT)
+                    ui_num = (unsigned short) va_arg(ap, unsigned int);
+                else
+                    ui_num = va_arg(ap, unsigned int);
+                s = conv_p2(ui_num, 4, spec->conv,
+                        &num_buf[NUM_BUF_SIZE], &s_len);
+            }
+            FIX_PRECISION(adjust_precision, precision, s, s_len);
+            if (alternate_form && ui_num != 0) {
+                *--s = spec->conv;  /* 'x' or 'X' */
+                *--s = '0';
+                s_len += 2;
+            }
+            break;
+
+
+        case 's':
+            s = va_arg(ap, char *);
+            if (s != NULL) {
+                if (!adjust_precision) {
+                    s_len = strlen(s);
                 }
                 else {
-                    if (var_type == IS_LONG)
-                        i_num = va_arg(ap, apr_int32_t);
-                    else if (var_type == IS_SHORT)
-                        i_num = (short) va_arg(ap, int);
-                    else
-                        i_num = va_arg(ap, int);
-                    s = conv_10(i_num, 0, &is_negative,
-                            &num_buf[NUM_BUF_SIZE], &s_len);
+                    /* From the C library standard in section 7.9.6.1:
+                     * ...if the precision is specified, no more then
+                     * that many characters are written.  If the
+                     * precision is not specified or is greater
+                     * than the size of the array, the array shall
+                     * contain a null character.
+                     *
+                     * My reading is is precision is specified and
+                     * is less then or equal to the size of the
+                     * array, no null character is required.  So
+                     * we can't do a strlen.
+                     *
+                     * This figures out the length of the string
+                     * up to the precision.  Once it's long enough
+                     * for the specified precision, we don't care
+                     * anymore.
+                     *
+                     * NOTE: you must do the length comparison
+                     * before the check for the null character.
+                     * Otherwise, you'll check one beyond the
+                     * last valid character.
+                     */
+                    const char *walk;
+
+                    for (walk = s, s_len = 0;
+                         (s_len < precision) && (*walk != '\0');
+                         ++walk, ++s_len);
                 }
-                FIX_PRECISION(adjust_precision, precision, s, s_len);
+            }
+            else {
+                s = S_NULL;
+                s_len = S_NULL_LEN;
+            }
+            pad_char = ' ';
+            break;
+
 
+        case 'f':
+        case 'e':
+        case 'E':
+            fp_num = va_arg(ap, double);
+            /*
+             * We use &num_buf[ 1 ], so that we have room for the sign
+             */
+            s = NULL;
+#ifdef HAVE_ISNAN
+            if (isnan(fp_num)) {
+                s = "nan";
+                s_len = 3;
+            }
+#endif
+#ifdef HAVE_ISINF
+            if (!s && isinf(fp_num)) {
+                s = "inf";
+                s_len = 3;
+            }
+#endif
+            if (!s) {
+                s = conv_fp(spec->conv, fp_num, alternate_form,
+                            (int)((adjust_precision == NO) ? FLOAT_DIGITS : precision),
+                            &is_negative, &num_buf[1], &s_len);
                 if (is_negative)
                     prefix_char = '-';
                 else if (print_sign)
                     prefix_char = '+';
                 else if (print_blank)
                     prefix_char = ' ';
-                break;
+            }
+            break;
+
+
+        case 'g':
+        case 'G':
+            if (adjust_precision == NO)
+                precision = FLOAT_DIGITS;
+            else if (precision == 0)
+                precision = 1;
+            /*
+             * * We use &num_buf[ 1 ], so that we have room for the sign
+             */
+            s = apr_gcvt(va_arg(ap, double), (int) precision, &num_buf[1],
+                        alternate_form);
+            if (*s == '-')
+                prefix_char = *s++;
+            else if (print_sign)
+                prefix_char = '+';
+            else if (print_blank)
+                prefix_char = ' ';
+
+            s_len = strlen(s);
+
+            if (alternate_form && (q = strchr(s, '.')) == NULL) {
+                s[s_len++] = '.';
+                s[s_len] = '\0'; /* delimit for following strchr() */
+            }
+            if (spec->conv == 'G' && (q = strchr(s, 'e')) != NULL)
+                *q = 'E';
+            break;
+
+
+        case 'c':
+            char_buf[0] = (char) (va_arg(ap, int));
+            s = &char_buf[0];
+            s_len = 1;
+            pad_char = ' ';
+            break;
+
+
+        case '%':
+            char_buf[0] = '%';
+            s = &char_buf[0];
+            s_len = 1;
+            pad_char = ' ';
+            break;
+
 
+        case 'n':
+            if (var_type == IS_QUAD)
+                *(va_arg(ap, apr_int64_t *)) = cc;
+            else if (var_type == IS_LONG)
+                *(va_arg(ap, long *)) = cc;
+            else if (var_type == IS_SHORT)
+                *(va_arg(ap, short *)) = cc;
+            else
+                *(va_arg(ap, int *)) = cc;
+            print_something = NO;
+            break;
 
-            case 'o':
-                if (var_type == IS_QUAD) {
-                    ui_quad = va_arg(ap, apr_uint64_t);
-                    s = conv_p2_quad(ui_quad, 3, *fmt,
+            /*
+             * This is where we extend the printf format, with a second
+             * type specifier
+             */
+        case 'p':
+            switch (spec->conv_p) {
+            /*
+             * If the pointer size is equal to or smaller than the size
+             * of the largest unsigned int, we convert the pointer to a
+             * hex number, otherwise we print "%p" to indicate that we
+             * don't handle "%p".
+             */
+            case 'p':
+#if APR_SIZEOF_VOIDP == 8
+                if (sizeof(void *) <= sizeof(apr_uint64_t)) {
+                    ui_quad = (apr_uint64_t) va_arg(ap, void *);
+                    s = conv_p2_quad(ui_quad, 4, 'x',
                             &num_buf[NUM_BUF_SIZE], &s_len);
                 }
-                else {
-                    if (var_type == IS_LONG)
-                        ui_num = va_arg(ap, apr_uint32_t);
-                    else if (var_type == IS_SHORT)
-                        ui_num = (unsigned short) va_arg(ap, unsigned int);
-                    else
-                        ui_num = va_arg(ap, unsigned int);
-                    s = conv_p2(ui_num, 3, *fmt,
+#else
+                if (sizeof(void *) <= sizeof(apr_uint32_t)) {
+                    ui_num = (apr_uint32_t) va_arg(ap, void *);
+                    s = conv_p2(ui_num, 4, 'x',
                             &num_buf[NUM_BUF_SIZE], &s_len);
                 }
-                FIX_PRECISION(adjust_precision, precision, s, s_len);
-                if (alternate_form && *s != '0') {
-                    *--s = '0';
-                    s_len++;
+#endif
+                else {
+                    s = "%p";
+                    s_len = 2;
+                    prefix_char = NUL;
                 }
+                pad_char = ' ';
                 break;
 
+            /* print an apr_sockaddr_t as a.b.c.d:port */
+            case 'I':
+            {
+                apr_sockaddr_t *sa;
 
-            case 'x':
-            case 'X':
-                if (var_type == IS_QUAD) {
-                    ui_quad = va_arg(ap, apr_uint64_t);
-                    s = conv_p2_quad(ui_quad, 4, *fmt,
-                            &num_buf[NUM_BUF_SIZE], &s_len);
+                sa = va_arg(ap, apr_sockaddr_t *);
+                if (sa != NULL) {
+                    s = conv_apr_sockaddr(sa, &num_buf[NUM_BUF_SIZE], &s_len);
+                    if (adjust_precision && precision < s_len)
+                        s_len = precision;
                 }
                 else {
-                    if (var_type == IS_LONG)
-                        ui_num = va_arg(ap, apr_uint32_t);
-                    else if (var_type == IS_SHORT)
-                        ui_num = (unsigned short) va_arg(ap, unsigned int);
-                    else
-                        ui_num = va_arg(ap, unsigned int);
-                    s = conv_p2(ui_num, 4, *fmt,
-                            &num_buf[NUM_BUF_SIZE], &s_len);
-                }
-                FIX_PRECISION(adjust_precision, precision, s, s_len);
-                if (alternate_form && ui_num != 0) {
-                    *--s = *fmt;        /* 'x' or 'X' */
-                    *--s = '0';
-                    s_len += 2;
+                    s = S_NULL;
+                    s_len = S_NULL_LEN;
                 }
-                break;
-
-
-            case 's':
-                s = va_arg(ap, char *);
-                if (s != NULL) {
-                    if (!adjust_precision) {
-                        s_len = strlen(s);
-                    }
-                    else {
-                        /* From the C library standard in section 7.9.6.1:
-                         * ...if the precision is specified, no more then
-                         * that many characters are written.  If the
-                         * precision is not specified or is greater
-                         * than the size of the array, the array shall
-                         * contain a null character.
-                         *
-                         * My reading is is precision is specified and
-                         * is less then or equal to the size of the
-                         * array, no null character is required.  So
-                         * we can't do a strlen.
-                         *
-                         * This figures out the length of the string
-                         * up to the precision.  Once it's long enough
-                         * for the specified precision, we don't care
-                         * anymore.
-                         *
-                         * NOTE: you must do the length comparison
-                         * before the check for the null character.
-                         * Otherwise, you'll check one beyond the
-                         * last valid character.
-                         */
-                        const char *walk;
-
-                        for (walk = s, s_len = 0;
-                             (s_len < precision) && (*walk != '\0');
-                             ++walk, ++s_len);
-                    }
+                pad_char = ' ';
+            }
+            break;
+
+            /* print a struct in_addr as a.b.c.d */
+            case 'A':
+            {
+                struct in_addr *ia;
+
+                ia = va_arg(ap, struct in_addr *);
+                if (ia != NULL) {
+                    s = conv_in_addr(ia, &num_buf[NUM_BUF_SIZE], &s_len);
+                    if (adjust_precision && precision < s_len)
+                        s_len = precision;
                 }
                 else {
                     s = S_NULL;
                     s_len = S_NULL_LEN;
                 }
                 pad_char = ' ';
-                break;
+            }
+            break;
 
+            /* print the error for an apr_status_t */
+            case 'm':
+            {
+                apr_status_t *mrv;
 
-            case 'f':
-            case 'e':
-            case 'E':
-                fp_num = va_arg(ap, double);
-                /*
-                 * We use &num_buf[ 1 ], so that we have room for the sign
-                 */
-                s = NULL;
-#ifdef HAVE_ISNAN
-                if (isnan(fp_num)) {
-                    s = "nan";
-                    s_len = 3;
-                }
-#endif
-#ifdef HAVE_ISINF
-                if (!s && isinf(fp_num)) {
-                    s = "inf";
-                    s_len = 3;
+                mrv = va_arg(ap, apr_status_t *);
+                if (mrv != NULL) {
+                    s = apr_strerror(*mrv, num_buf, NUM_BUF_SIZE-1);
+                    s_len = strlen(s);
                 }
-#endif
-                if (!s) {
-                    s = conv_fp(*fmt, fp_num, alternate_form,
-                                (int)((adjust_precision == NO) ? FLOAT_DIGITS : precision),
-                                &is_negative, &num_buf[1], &s_len);
-                    if (is_negative)
-                        prefix_char = '-';
-                    else if (print_sign)
-                        prefix_char = '+';
-                    else if (print_blank)
-                        prefix_char = ' ';
+                else {
+                    s = S_NULL;
+                    s_len = S_NULL_LEN;
                 }
-                break;
-
-
-            case 'g':
-            case 'G':
-                if (adjust_precision == NO)
-                    precision = FLOAT_DIGITS;
-                else if (precision == 0)
-                    precision = 1;
-                /*
-                 * * We use &num_buf[ 1 ], so that we have room for the sign
-                 */
-                s = apr_gcvt(va_arg(ap, double), (int) precision, &num_buf[1],
-                            alternate_form);
-                if (*s == '-')
-                    prefix_char = *s++;
-                else if (print_sign)
-                    prefix_char = '+';
-                else if (print_blank)
-                    prefix_char = ' ';
-
-                s_len = strlen(s);
+                pad_char = ' ';
+            }
+            break;
 
-                if (alternate_form && (q = strchr(s, '.')) == NULL) {
-                    s[s_len++] = '.';
-                    s[s_len] = '\0'; /* delimit for following strchr() */
+            case 'T':
+#if APR_HAS_THREADS
+            {
+                apr_os_thread_t *tid;
+
+                tid = va_arg(ap, apr_os_thread_t *);
+                if (tid != NULL) {
+                    s = conv_os_thread_t(tid, &num_buf[NUM_BUF_SIZE], &s_len);
+                    if (adjust_precision && precision < s_len)
+                        s_len = precision;
+                }
+                else {
+                    s = S_NULL;
+                    s_len = S_NULL_LEN;
                 }
-                if (*fmt == 'G' && (q = strchr(s, 'e')) != NULL)
-                    *q = 'E';
-                break;
-
-
-            case 'c':
-                char_buf[0] = (char) (va_arg(ap, int));
-                s = &char_buf[0];
-                s_len = 1;
                 pad_char = ' ';
-                break;
-
-
-            case '%':
-                char_buf[0] = '%';
+            }
+#else
+                char_buf[0] = '0';
                 s = &char_buf[0];
                 s_len = 1;
                 pad_char = ' ';
-                break;
-
-
-            case 'n':
-                if (var_type == IS_QUAD)
-                    *(va_arg(ap, apr_int64_t *)) = cc;
-                else if (var_type == IS_LONG)
-                    *(va_arg(ap, long *)) = cc;
-                else if (var_type == IS_SHORT)
-                    *(va_arg(ap, short *)) = cc;
-                else
-                    *(va_arg(ap, int *)) = cc;
-                print_something = NO;
-                break;
-
-                /*
-                 * This is where we extend the printf format, with a second
-                 * type specifier
-                 */
-            case 'p':
-                switch(*++fmt) {
-                /*
-                 * If the pointer size is equal to or smaller than the size
-                 * of the largest unsigned int, we convert the pointer to a
-                 * hex number, otherwise we print "%p" to indicate that we
-                 * don't handle "%p".
-                 */
-                case 'p':
-#if APR_SIZEOF_VOIDP == 8
-                    if (sizeof(void *) <= sizeof(apr_uint64_t)) {
-                        ui_quad = (apr_uint64_t) va_arg(ap, void *);
-                        s = conv_p2_quad(ui_quad, 4, 'x',
-                                &num_buf[NUM_BUF_SIZE], &s_len);
-                    }
-#else
-                    if (sizeof(void *) <= sizeof(apr_uint32_t)) {
-                        ui_num = (apr_uint32_t) va_arg(ap, void *);
-                        s = conv_p2(ui_num, 4, 'x',
-                                &num_buf[NUM_BUF_SIZE], &s_len);
-                    }
 #endif
-                    else {
-                        s = "%p";
-                        s_len = 2;
-                        prefix_char = NUL;
-                    }
-                    pad_char = ' ';
-                    break;
-
-                /* print an apr_sockaddr_t as a.b.c.d:port */
-                case 'I':
-                {
-                    apr_sockaddr_t *sa;
-
-                    sa = va_arg(ap, apr_sockaddr_t *);
-                    if (sa != NULL) {
-                        s = conv_apr_sockaddr(sa, &num_buf[NUM_BUF_SIZE], &s_len);
-                        if (adjust_precision && precision < s_len)
-                            s_len = precision;
-                    }
-                    else {
-                        s = S_NULL;
-                        s_len = S_NULL_LEN;
-                    }
-                    pad_char = ' ';
-                }
                 break;
 
-                /* print a struct in_addr as a.b.c.d */
-                case 'A':
-                {
-                    struct in_addr *ia;
-
-                    ia = va_arg(ap, struct in_addr *);
-                    if (ia != NULL) {
-                        s = conv_in_addr(ia, &num_buf[NUM_BUF_SIZE], &s_len);
-                        if (adjust_precision && precision < s_len)
-                            s_len = precision;
-                    }
-                    else {
-                        s = S_NULL;
-                        s_len = S_NULL_LEN;
-                    }
-                    pad_char = ' ';
-                }
-                break;
-
-                /* print the error for an apr_status_t */
-                case 'm':
-                {
-                    apr_status_t *mrv;
-
-                    mrv = va_arg(ap, apr_status_t *);
-                    if (mrv != NULL) {
-                        s = apr_strerror(*mrv, num_buf, NUM_BUF_SIZE-1);
-                        s_len = strlen(s);
-                    }
-                    else {
-                        s = S_NULL;
-                        s_len = S_NULL_LEN;
-                    }
-                    pad_char = ' ';
-                }
-                break;
-
-                case 'T':
+            case 't':
 #if APR_HAS_THREADS
-                {
-                    apr_os_thread_t *tid;
-
-                    tid = va_arg(ap, apr_os_thread_t *);
-                    if (tid != NULL) {
-                        s = conv_os_thread_t(tid, &num_buf[NUM_BUF_SIZE], &s_len);
-                        if (adjust_precision && precision < s_len)
-                            s_len = precision;
-                    }
-                    else {
-                        s = S_NULL;
-                        s_len = S_NULL_LEN;
-                    }
-                    pad_char = ' ';
+            {
+                apr_os_thread_t *tid;
+
+                tid = va_arg(ap, apr_os_thread_t *);
+                if (tid != NULL) {
+                    s = conv_os_thread_t_hex(tid, &num_buf[NUM_BUF_SIZE], &s_len);
+                    if (adjust_precision && precision < s_len)
+                        s_len = precision;
                 }
-#else
-                    char_buf[0] = '0';
-                    s = &char_buf[0];
-                    s_len = 1;
-                    pad_char = ' ';
-#endif
-                    break;
-
-                case 't':
-#if APR_HAS_THREADS
-                {
-                    apr_os_thread_t *tid;
-
-                    tid = va_arg(ap, apr_os_thread_t *);
-                    if (tid != NULL) {
-                        s = conv_os_thread_t_hex(tid, &num_buf[NUM_BUF_SIZE], &s_len);
-                        if (adjust_precision && precision < s_len)
-                            s_len = precision;
-                    }
-                    else {
-                        s = S_NULL;
-                        s_len = S_NULL_LEN;
-                    }
-                    pad_char = ' ';
+                else {
+                    s = S_NULL;
+                    s_len = S_NULL_LEN;
                 }
+                pad_char = ' ';
+            }
 #else
-                    char_buf[0] = '0';
-                    s = &char_buf[0];
-                    s_len = 1;
-                    pad_char = ' ';
+                char_buf[0] = '0';
+                s = &char_buf[0];
+                s_len = 1;
+                pad_char = ' ';
 #endif
-                    break;
-
-                case 'B':
-                case 'F':
-                case 'S':
-                {
-                    char buf[5];
-                    apr_off_t size = 0;
-
-                    if (*fmt == 'B') {
-                        apr_uint32_t *arg = va_arg(ap, apr_uint32_t *);
-                        size = (arg) ? *arg : 0;
-                    }
-                    else if (*fmt == 'F') {
-                        apr_off_t *arg = va_arg(ap, apr_off_t *);
-                        size = (arg) ? *arg : 0;
-                    }
-                    else {
-                        apr_size_t *arg = va_arg(ap, apr_size_t *);
-                        size = (arg) ? *arg : 0;
-                    }
-
-                    s = apr_strfsize(size, buf);
-                    s_len = strlen(s);
-                    pad_char = ' ';
-                }
                 break;
 
-                case NUL:
-                    /* if %p ends the string, oh well ignore it */
-                    continue;
+            /* print a double * as the shortest round-trip string */
+            case 'd':
+            {
+                double *arg = va_arg(ap, double *);
 
-                default:
-                    s = "bogus %p";
-                    s_len = 8;
-                    prefix_char = NUL;
-                    (void)va_arg(ap, void *); /* skip the bogus argument on the stack */
-                    break;
+                if (arg != NULL) {
+                    s = &num_buf[0];
+                    s_len = apr_dtoa(s, *arg);
+                }
+                else {
+                    s = S_NULL;
+                    s_len = S_NULL_LEN;
                 }
-                break;
-
-            case NUL:
-                /*
-                 * The last character of the format string was %.
-                 * We ignore it.
-                 */
-                continue;
-
-
-                /*
-                 * The default case is for unrecognized %'s.
-                 * We print %<char> to help the user identify what
-                 * option is not understood.
-                 * This is also useful in case the user wants to pass
-                 * the output of format_converter to another function
-                 * that understands some other %<char> (like syslog).
-                 * Note that we can't point s inside fmt because the
-                 * unknown <char> could be preceded by width etc.
-                 */
-            default:
-                char_buf[0] = '%';
-                char_buf[1] = *fmt;
-                s = char_buf;
-                s_len = 2;
                 pad_char = ' ';
-                break;
             }
+            break;
+
+            case 'B':
+            case 'F':
+            case 'S':
+            {
+                char buf[5];
+                apr_off_t size = 0;
+
+                if (spec->conv_p == 'B') {
+                    apr_uint32_t *arg = va_arg(ap, apr_uint32_t *);
+                    size = (arg) ? *arg : 0;
+                }
+                else if (spec->conv_p == 'F') {
+                    apr_off_t *arg = va_arg(ap, apr_off_t *);
+                    size = (arg) ? *arg : 0;
+                }
+                else {
+                    apr_size_t *arg = va_arg(ap, apr_size_t *);
+                    size = (arg) ? *arg : 0;
+                }
 
-            if (prefix_char != NUL && s != S_NULL && s != char_buf) {
-                *--s = prefix_char;
-                s_len++;
+                s = apr_strfsize(size, buf);
+                s_len = strlen(s);
+                pad_char = ' ';
             }
+            break;
 
-            if (adjust_width && adjust == RIGHT && min_width > s_len) {
-                if (pad_char == '0' && prefix_char != NUL) {
-                    INS_CHAR(*s, sp, bep, cc);
-                    s++;
-                    s_len--;
-                    min_width--;
-                }
-                PAD(min_width, s_len, pad_char);
+            default:
+                s = "bogus %p";
+                s_len = 8;
+                prefix_char = NUL;
+                (void)va_arg(ap, void *); /* skip the bogus argument on the stack */
+                break;
             }
+            break;
 
             /*
-             * Print the string s. 
+             * The default case is for unrecognized %'s.
+             * We print %<char> to help the user identify what
+             * option is not understood.
+             * This is also useful in case the user wants to pass
+             * the output of format_converter to another function
+             * that understands some other %<char> (like syslog).
+             * Note that we can't point s inside fmt because the
+             * unknown <char> could be preceded by width etc.
              */
-            if (print_something == YES) {
-                for (i = s_len; i != 0; i--) {
-                    INS_CHAR(*s, sp, bep, cc);
-                    s++;
-                }
+        default:
+            char_buf[0] = '%';
+            char_buf[1] = spec->conv;
+            s = char_buf;
+            s_len = 2;
+            pad_char = ' ';
+            break;
+        }
+
+        if (prefix_char != NUL && s != S_NULL && s != char_buf) {
+            *--s = prefix_char;
+            s_len++;
+        }
+
+        if (adjust_width && adjust == RIGHT && min_width > s_len) {
+            if (pad_char == '0' && prefix_char != NUL) {
+                INS_CHAR(*s, sp, bep, cc);
+                s++;
+                s_len--;
+                min_width--;
             }
+            PAD(min_width, s_len, pad_char);
+        }
 
-            if (adjust_width && adjust == LEFT && min_width > s_len)
-                PAD(min_width, s_len, pad_char);
+        /*
+         * Print the string s. 
+         */
+        if (print_something == YES) {
+            INS_CHARS(s, s_len, sp, bep, cc);
+        }
+
+        if (adjust_width && adjust == LEFT && min_width > s_len)
+            PAD(min_width, s_len, pad_char);
         }
-        fmt++;
     }
     vbuff->curpos = sp;
 
     return cc;
 }
 
+APR_DECLARE(int) apr_vformatter(int (*flush_func)(apr_vformatter_buff_t *),
+    apr_vformatter_buff_t *vbuff, const char *fmt, va_list ap)
+{
+    return format_core(flush_func, vbuff, fmt, NULL, ap);
+}
+
+APR_DECLARE(apr_format_t *) apr_format_compile(const char *fmt,
+                                               apr_pool_t *p)
+{
+    apr_format_t *format = apr_palloc(p, sizeof(*format));
+    format_item_t *item;
+    const char *f;
+    int n = 1;
+
+    for (f = fmt; *f; f++) {
+        n += (*f == '%');
+    }
+    format->fmt = fmt = apr_pstrdup(p, fmt);
+    format->items = item = apr_palloc(p, n * sizeof(format_item_t));
+
+    for (;; item++) {
+        for (item->text = fmt; *fmt && *fmt != '%'; fmt++);
+        item->len = fmt - item->text;
+        item->spec.conv = NUL;
+        if (!*fmt) {
+            break;
+        }
+        fmt = parse_spec(fmt + 1, &item->spec);
+        if (item->spec.conv == NUL) {
+            break;
+        }
+        fmt++;
+    }
+
+    return format;
+}
+
+APR_DECLARE(int) apr_format_vformatter(
+        int (*flush_func)(apr_vformatter_buff_t *),
+        apr_vformatter_buff_t *vbuff, const apr_format_t *format, va_list ap)
+{
+    return format_core(flush_func, vbuff, NULL, format->items, ap);
+}
 
 static int snprintf_flush(apr_vformatter_buff_t *vbuff)
 {
@@ -1405,3 +1616,40 @@ APR_DECLARE(int) apr_vsnprintf(char *buf, apr_size_t len, const char *format,
     }
     return (cc == -1) ? (int)len - 1 : cc;
 }
+
+
+APR_DECLARE_NONSTD(int) apr_format_exec(char *buf, apr_size_t len,
+                                        const apr_format_t *format, ...)
+{
+    int cc;
+    va_list ap;
+
+    va_start(ap, format);
+    cc = apr_format_vexec(buf, len, format, ap);
+    va_end(ap);
+
+    return cc;
+}
+
+
+APR_DECLARE(int) apr_format_vexec(char *buf, apr_size_t len,
+                                  const apr_format_t *format, va_list ap)
+{
+    int cc;
+    apr_vformatter_buff_t vbuff;
+
+    if (len == 0) {
+        /* See above note */
+        vbuff.curpos = NULL;
+        vbuff.endpos = NULL;
+    } else {
+        /* save one byte for nul terminator */
+        vbuff.curpos = buf;
+        vbuff.endpos = buf + len - 1;
+    }
+    cc = format_core(snprintf_flush, &vbuff, NULL, format->items, ap);
+    if (len != 0) {
+        *vbuff.curpos = '\0';
+    }
+    return (cc == -1) ? (int)len - 1 : cc;
+}
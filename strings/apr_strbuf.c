@@ -0,0 +1,389 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_strbuf.h"
+#include "apr_lib.h"
+
+#define APR_WANT_MEMFUNC
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
+/* The first chunk of pool buffers, and the largest chunk: past it the
+ * buffer grows by chunks of that size, what was appended never moving.
+ */
+#define STRBUF_MIN_CHUNK 256
+#define STRBUF_MAX_CHUNK (1024 * 1024)
+
+typedef struct strbuf_chunk_t strbuf_chunk_t;
+
+struct strbuf_chunk_t {
+    strbuf_chunk_t *next;
+    apr_memnode_t *node;        /* holding the chunk, from the allocator */
+    char *data;
+    apr_size_t len;
+    apr_size_t size;
+};
+
+#define SIZEOF_STRBUF_CHUNK_T APR_ALIGN_DEFAULT(sizeof(strbuf_chunk_t))
+
+struct apr_strbuf_t {
+    apr_pool_t *pool;
+    apr_allocator_t *allocator;
+    strbuf_chunk_t *first;
+    strbuf_chunk_t *last;       /* being appended to, next ones are empty */
+    apr_size_t length;
+    apr_size_t next_size;
+};
+
+#define SIZEOF_STRBUF_T APR_ALIGN_DEFAULT(sizeof(apr_strbuf_t))
+
+static strbuf_chunk_t *strbuf_chunk_alloc(apr_strbuf_t *sb, apr_size_t size)
+{
+    strbuf_chunk_t *chunk;
+
+    if (sb->allocator) {
+        apr_memnode_t *node;
+
+        node = apr_allocator_alloc(sb->allocator,
+                                   SIZEOF_STRBUF_CHUNK_T + size);
+        if (!node) {
+            return NULL;
+        }
+        chunk = (strbuf_chunk_t *)node->first_avail;
+        chunk->node = node;
+        chunk->data = node->first_avail + SIZEOF_STRBUF_CHUNK_T;
+        /* the allocator rounds up, use all of it */
+        chunk->size = node->endp - chunk->data;
+    }
+    else {
+        chunk = apr_palloc(sb->pool, SIZEOF_STRBUF_CHUNK_T + size);
+        chunk->node = NULL;
+        chunk->data = (char *)chunk + SIZEOF_STRBUF_CHUNK_T;
+        chunk->size = size;
+    }
+    chunk->next = NULL;
+    chunk->len = 0;
+
+    return chunk;
+}
+
+/* Move to the next chunk, allocating one of at least min bytes when there
+ * is none left from before a clear.
+ */
+static apr_status_t strbuf_grow(apr_strbuf_t *sb, apr_size_t min)
+{
+    strbuf_chunk_t *chunk;
+    apr_size_t size;
+
+    if (sb->last->next) {
+        sb->last = sb->last->next;
+        return APR_SUCCESS;
+    }
+
+    size = sb->next_size;
+    if (size < min) {
+        size = min;
+    }
+    chunk = strbuf_chunk_alloc(sb, size);
+    if (!chunk) {
+        return APR_ENOMEM;
+    }
+    if (sb->next_size < STRBUF_MAX_CHUNK) {
+        sb->next_size *= 2;
+    }
+    sb->last->next = chunk;
+    sb->last = chunk;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_strbuf_t *) apr_strbuf_make(apr_pool_t *p, apr_size_t size)
+{
+    apr_strbuf_t *sb;
+
+    if (!size) {
+        size = STRBUF_MIN_CHUNK;
+    }
+    sb = apr_palloc(p, SIZEOF_STRBUF_T);
+    sb->pool = p;
+    sb->allocator = NULL;
+    sb->length = 0;
+    sb->next_size = size < STRBUF_MAX_CHUNK ? size * 2 : size;
+    sb->first = sb->last = strbuf_chunk_alloc(sb, size);
+
+    return sb;
+}
+
+APR_DECLARE(apr_strbuf_t *) apr_strbuf_create(apr_allocator_t *allocator,
+                                              apr_size_t size)
+{
+    apr_memnode_t *node;
+    strbuf_chunk_t *chunk;
+    apr_strbuf_t *sb;
+
+    /* The buffer lives in the node of its first chunk */
+    node = apr_allocator_alloc(allocator, SIZEOF_STRBUF_T
+                                          + SIZEOF_STRBUF_CHUNK_T + size);
+    if (!node) {
+        return NULL;
+    }
+    sb = (apr_strbuf_t *)node->first_avail;
+    chunk = (strbuf_chunk_t *)(node->first_avail + SIZEOF_STRBUF_T);
+    chunk->next = NULL;
+    chunk->node = node;
+    chunk->data = (char *)chunk + SIZEOF_STRBUF_CHUNK_T;
+    chunk->len = 0;
+    chunk->size = node->endp - chunk->data;
+
+    sb->pool = NULL;
+    sb->allocator = allocator;
+    sb->first = sb->last = chunk;
+    sb->length = 0;
+    sb->next_size = chunk->size < STRBUF_MAX_CHUNK ? chunk->size * 2
+                                                   : chunk->size;
+
+    return sb;
+}
+
+APR_DECLARE(void) apr_strbuf_destroy(apr_strbuf_t *sb)
+{
+    apr_memnode_t *nodes = NULL, **next = &nodes;
+    strbuf_chunk_t *chunk;
+
+    if (!sb->allocator) {
+        return;
+    }
+
+    /* The first node holds the buffer itself, free them all at once */
+    for (chunk = sb->first; chunk; chunk = chunk->next) {
+        *next = chunk->node;
+        next = &chunk->node->next;
+    }
+    *next = NULL;
+    apr_allocator_free(sb->allocator, nodes);
+}
+
+APR_DECLARE(void) apr_strbuf_clear(apr_strbuf_t *sb)
+{
+    strbuf_chunk_t *chunk;
+
+    for (chunk = sb->first; chunk; chunk = chunk->next) {
+        chunk->len = 0;
+        if (chunk == sb->last) {
+            break;
+        }
+    }
+    sb->last = sb->first;
+    sb->length = 0;
+}
+
+APR_DECLARE(apr_size_t) apr_strbuf_length(const apr_strbuf_t *sb)
+{
+    return sb->length;
+}
+
+APR_DECLARE(apr_status_t) apr_strbuf_write(apr_strbuf_t *sb,
+                                           const char *str, apr_size_t len)
+{
+    while (len) {
+        strbuf_chunk_t *chunk = sb->last;
+        apr_size_t n = chunk->size - chunk->len;
+
+        if (!n) {
+            apr_status_t rv = strbuf_grow(sb, len);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            continue;
+        }
+        if (n > len) {
+            n = len;
+        }
+        memcpy(chunk->data + chunk->len, str, n);
+        chunk->len += n;
+        sb->length += n;
+        str += n;
+        len -= n;
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_strbuf_puts(apr_strbuf_t *sb, const char *str)
+{
+    return apr_strbuf_write(sb, str, strlen(str));
+}
+
+APR_DECLARE(apr_status_t) apr_strbuf_putc(apr_strbuf_t *sb, const char c)
+{
+    strbuf_chunk_t *chunk = sb->last;
+
+    if (chunk->len == chunk->size) {
+        apr_status_t rv = strbuf_grow(sb, 1);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        chunk = sb->last;
+    }
+    chunk->data[chunk->len++] = c;
+    sb->length++;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE_NONSTD(apr_status_t) apr_strbuf_putstrs(apr_strbuf_t *sb, ...)
+{
+    apr_status_t rv = APR_SUCCESS;
+    const char *str;
+    va_list va;
+
+    va_start(va, sb);
+    while ((str = va_arg(va, const char *)) != NULL) {
+        rv = apr_strbuf_write(sb, str, strlen(str));
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    va_end(va);
+
+    return rv;
+}
+
+typedef struct {
+    apr_vformatter_buff_t vbuff;
+    apr_strbuf_t *sb;
+} strbuf_vformatter_t;
+
+/* Account for what was formatted in the current chunk, then move to the
+ * next one.
+ */
+static int strbuf_flush(apr_vformatter_buff_t *buff)
+{
+    strbuf_vformatter_t *vd = (strbuf_vformatter_t *)buff;
+    apr_strbuf_t *sb = vd->sb;
+    strbuf_chunk_t *chunk = sb->last;
+    apr_size_t n = buff->curpos - (chunk->data + chunk->len);
+
+    chunk->len += n;
+    sb->length += n;
+    if (strbuf_grow(sb, 1) != APR_SUCCESS) {
+        return -1;
+    }
+    chunk = sb->last;
+    buff->curpos = chunk->data + chunk->len;
+    buff->endpos = chunk->data + chunk->size;
+
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_strbuf_vprintf(apr_strbuf_t *sb,
+                                             const char *fmt, va_list va)
+{
+    strbuf_vformatter_t vd;
+    strbuf_chunk_t *chunk = sb->last;
+    apr_size_t n;
+
+    vd.sb = sb;
+    vd.vbuff.curpos = chunk->data + chunk->len;
+    vd.vbuff.endpos = chunk->data + chunk->size;
+    if (apr_vformatter(strbuf_flush, &vd.vbuff, fmt, va) == -1) {
+        return APR_ENOMEM;
+    }
+
+    chunk = sb->last;
+    n = vd.vbuff.curpos - (chunk->data + chunk->len);
+    chunk->len += n;
+    sb->length += n;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE_NONSTD(apr_status_t) apr_strbuf_printf(apr_strbuf_t *sb,
+                                                   const char *fmt, ...)
+{
+    apr_status_t rv;
+    va_list va;
+
+    va_start(va, fmt);
+    rv = apr_strbuf_vprintf(sb, fmt, va);
+    va_end(va);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_strbuf_to_iovec(const apr_strbuf_t *sb,
+                                              struct iovec *vec, int *nvec)
+{
+    const strbuf_chunk_t *chunk;
+    int n = 0;
+
+    for (chunk = sb->first; chunk; chunk = chunk->next) {
+        if (chunk->len) {
+            if (n == *nvec) {
+                return APR_INCOMPLETE;
+            }
+            vec[n].iov_base = chunk->data;
+            vec[n].iov_len = chunk->len;
+            n++;
+        }
+        if (chunk == sb->last) {
+            break;
+        }
+    }
+    *nvec = n;
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_strbuf_to_brigade(const apr_strbuf_t *sb,
+                                        apr_bucket_brigade *bb)
+{
+    const strbuf_chunk_t *chunk;
+
+    for (chunk = sb->first; chunk; chunk = chunk->next) {
+        if (chunk->len) {
+            apr_bucket *e = apr_bucket_transient_create(chunk->data,
+                                                        chunk->len,
+                                                        bb->bucket_alloc);
+            APR_BRIGADE_INSERT_TAIL(bb, e);
+        }
+        if (chunk == sb->last) {
+            break;
+        }
+    }
+}
+
+APR_DECLARE(char *) apr_strbuf_pflatten(const apr_strbuf_t *sb,
+                                        apr_size_t *len, apr_pool_t *p)
+{
+    const strbuf_chunk_t *chunk;
+    char *str, *s;
+
+    s = str = apr_palloc(p, sb->length + 1);
+    for (chunk = sb->first; chunk; chunk = chunk->next) {
+        memcpy(s, chunk->data, chunk->len);
+        s += chunk->len;
+        if (chunk == sb->last) {
+            break;
+        }
+    }
+    *s = '\0';
+    if (len) {
+        *len = sb->length;
+    }
+
+    return str;
+}
@@ -16,6 +16,7 @@
 
 #include "apr_strmatch.h"
 #include "apr_lib.h"
+#include "apr_encode_private.h"
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
 
@@ -31,12 +32,17 @@ static const char *match_no_op(const apr_strmatch_pattern *this_pattern,
     return s;
 }
 
+/* The shifts of Boyer-Moore-Horspool, capped to fit (shorter shifts are
+ * safe), so that the table stays in a few cache lines.
+ */
+#define SHIFT_MAX  0xFFFF
+
 static const char *match_boyer_moore_horspool(
                                const apr_strmatch_pattern *this_pattern,
                                const char *s, apr_size_t slen)
 {
     const char *s_end = s + slen;
-    apr_size_t *shift = (apr_size_t *)(this_pattern->context);
+    apr_uint16_t *shift = (apr_uint16_t *)(this_pattern->context);
     const char *s_next = s + this_pattern->length - 1;
     const char *p_start = this_pattern->pattern;
     const char *p_end = p_start + this_pattern->length - 1;
@@ -60,7 +66,7 @@ static const char *match_boyer_moore_horspool_nocase(
                                const char *s, apr_size_t slen)
 {
     const char *s_end = s + slen;
-    apr_size_t *shift = (apr_size_t *)(this_pattern->context);
+    apr_uint16_t *shift = (apr_uint16_t *)(this_pattern->context);
     const char *s_next = s + this_pattern->length - 1;
     const char *p_start = this_pattern->pattern;
     const char *p_end = p_start + this_pattern->length - 1;
@@ -79,13 +85,80 @@ static const char *match_boyer_moore_horspool_nocase(
     return NULL;
 }
 
+/*
+ * Short patterns: the offsets whose first and last bytes match are found
+ * by blocks (see apr__strmatch_pair()), and only those are compared whole.
+ * Longer patterns shift far enough with Boyer-Moore-Horspool to do as well
+ * when case sensitive, never when caseless, tolower() being the bottleneck.
+ */
+#define PAIR_MAX   64
+
+typedef struct {
+    unsigned char first, last;
+    /* The bits telling the cases of first and last apart, if caseless */
+    unsigned char ffold, lfold;
+    int case_sensitive;
+} strmatch_pair_t;
+
+static const char *match_pair(const apr_strmatch_pattern *this_pattern,
+                              const char *s, apr_size_t slen)
+{
+    const strmatch_pair_t *pair = this_pattern->context;
+    const unsigned char *us = (const unsigned char *)s;
+    const char *p = this_pattern->pattern;
+    apr_size_t plen = this_pattern->length;
+    apr_size_t n, i = 0, j;
+
+    if (slen < plen) {
+        return NULL;
+    }
+    n = slen - plen + 1;
+
+    while ((i += apr__strmatch_pair(us + i, n - i, plen, pair->first,
+                                    pair->last, pair->ffold,
+                                    pair->lfold)) < n) {
+        if (pair->case_sensitive) {
+            if (plen <= 2 || !memcmp(s + i + 1, p + 1, plen - 2)) {
+                return s + i;
+            }
+        }
+        else {
+            for (j = 1; j + 1 < plen; j++) {
+                if (apr_tolower(s[i + j]) != apr_tolower(p[j])) {
+                    break;
+                }
+            }
+            if (j + 1 >= plen) {
+                return s + i;
+            }
+        }
+        i++;
+    }
+    return NULL;
+}
+
+/* The bit telling the cases of c apart, for the pair filter to OR with,
+ * or -1 if they differ by more than one bit.
+ */
+static int pair_fold(char c, int case_sensitive)
+{
+    int fold;
+
+    if (case_sensitive) {
+        return 0;
+    }
+    fold = (unsigned char)apr_tolower(c) ^ (unsigned char)apr_toupper(c);
+
+    return (fold & (fold - 1)) ? -1 : fold;
+}
+
 APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(
                                               apr_pool_t *p, const char *s,
                                               int case_sensitive)
 {
     apr_strmatch_pattern *pattern;
     apr_size_t i;
-    apr_size_t *shift;
+    apr_uint16_t *shift;
 
     pattern = apr_palloc(p, sizeof(*pattern));
     pattern->pattern = s;
@@ -96,23 +169,238 @@ APR_DECLARE(const apr_strmatch_pattern *) apr_strmatch_precompile(
         return pattern;
     }
 
-    shift = (apr_size_t *)apr_palloc(p, sizeof(apr_size_t) * NUM_CHARS);
+    if (pattern->length <= PAIR_MAX || !case_sensitive) {
+        int ffold = pair_fold(s[0], case_sensitive);
+        int lfold = pair_fold(s[pattern->length - 1], case_sensitive);
+
+        if (ffold >= 0 && lfold >= 0) {
+            strmatch_pair_t *pair = apr_palloc(p, sizeof(*pair));
+
+            pair->ffold = (unsigned char)ffold;
+            pair->lfold = (unsigned char)lfold;
+            pair->first = (unsigned char)s[0] | pair->ffold;
+            pair->last = (unsigned char)s[pattern->length - 1] | pair->lfold;
+            pair->case_sensitive = case_sensitive;
+            pattern->compare = match_pair;
+            pattern->context = pair;
+            return pattern;
+        }
+    }
+
+    shift = (apr_uint16_t *)apr_palloc(p, sizeof(apr_uint16_t) * NUM_CHARS);
     for (i = 0; i < NUM_CHARS; i++) {
-        shift[i] = pattern->length;
+        shift[i] = (apr_uint16_t)(pattern->length < SHIFT_MAX
+                                  ? pattern->length : SHIFT_MAX);
     }
     if (case_sensitive) {
         pattern->compare = match_boyer_moore_horspool;
         for (i = 0; i < pattern->length - 1; i++) {
-            shift[(unsigned char)s[i]] = pattern->length - i - 1;
+            if (pattern->length - i - 1 < SHIFT_MAX) {
+                shift[(unsigned char)s[i]] =
+                    (apr_uint16_t)(pattern->length - i - 1);
+            }
         }
     }
     else {
         pattern->compare = match_boyer_moore_horspool_nocase;
         for (i = 0; i < pattern->length - 1; i++) {
-            shift[(unsigned char)apr_tolower(s[i])] = pattern->length - i - 1;
+            if (pattern->length - i - 1 < SHIFT_MAX) {
+                shift[(unsigned char)apr_tolower(s[i])] =
+                    (apr_uint16_t)(pattern->length - i - 1);
+            }
         }
     }
     pattern->context = shift;
 
     return pattern;
 }
+
+/*
+ * Multiple patterns: an Aho-Corasick automaton, its trie completed into a
+ * DFA over the classes of the bytes used by the patterns, so that each
+ * byte of the string costs one lookup whatever the number of patterns.
+ */
+
+/* The transitions are the offsets of the rows of the next states, with
+ * this bit set when some pattern ends there */
+#define MULTI_MATCH     0x80000000U
+#define MULTI_ROW(t)    ((t) & ~MULTI_MATCH)
+
+struct apr_strmatch_multi_t {
+    /* The class of each byte, zero for those of no pattern */
+    apr_uint16_t classes[NUM_CHARS];
+    apr_size_t nclasses;
+    /* The transitions, nclasses per state */
+    apr_uint32_t *next;
+    /* The pattern spelled by each state (or -1), and the next state along
+     * the failure links that spells one (or the root) */
+    int *own;
+    apr_uint32_t *dict;
+    apr_size_t *lengths;
+};
+
+APR_DECLARE(const apr_strmatch_multi_t *) apr_strmatch_multi_precompile(
+        apr_pool_t *p, const char *const *patterns, int npatterns,
+        int case_sensitive)
+{
+    apr_strmatch_multi_t *multi;
+    apr_size_t total = 1, nstates = 1, ncl, i, head, tail;
+    apr_uint32_t *next, *fail, *queue;
+    int n, c;
+
+    if (npatterns < 0) {
+        return NULL;
+    }
+    multi = apr_pcalloc(p, sizeof(*multi));
+    multi->lengths = apr_palloc(p, sizeof(apr_size_t) * (npatterns + 1));
+
+    /* Number the bytes used, case folded if need be */
+    for (n = 0; n < npatterns; n++) {
+        const unsigned char *s = (const unsigned char *)patterns[n];
+
+        if (!*s) {
+            return NULL;
+        }
+        for (; *s; s++) {
+            c = case_sensitive ? *s : apr_tolower(*s);
+            if (!multi->classes[c]) {
+                multi->classes[c] = (apr_uint16_t)++multi->nclasses;
+            }
+        }
+        multi->lengths[n] = (const char *)s - patterns[n];
+        total += multi->lengths[n];
+    }
+    if (!case_sensitive) {
+        for (c = 0; c < NUM_CHARS; c++) {
+            multi->classes[c] = multi->classes[apr_tolower(c)];
+        }
+    }
+    ncl = ++multi->nclasses;
+
+    if (total > MULTI_MATCH / ncl) {
+        return NULL;
+    }
+    next = apr_pcalloc(p, sizeof(apr_uint32_t) * total * ncl);
+    fail = apr_palloc(p, sizeof(apr_uint32_t) * total);
+    queue = apr_palloc(p, sizeof(apr_uint32_t) * total);
+    multi->dict = apr_pcalloc(p, sizeof(apr_uint32_t) * total);
+    multi->own = apr_palloc(p, sizeof(int) * total);
+    multi->own[0] = -1;
+    multi->next = next;
+
+    /* The trie, where no edge leads back to the root (row zero) */
+    for (n = 0; n < npatterns; n++) {
+        const unsigned char *s = (const unsigned char *)patterns[n];
+        apr_size_t row = 0;
+
+        for (; *s; s++) {
+            apr_uint32_t *t = &next[row + multi->classes[*s]];
+
+            if (!*t) {
+                multi->own[nstates] = -1;
+                *t = (apr_uint32_t)(nstates++ * ncl);
+            }
+            row = *t;
+        }
+        if (multi->own[row / ncl] < 0) {
+            multi->own[row / ncl] = n;
+        }
+    }
+
+    /* The failure links by breadth, completing the rows of the states
+     * with those of their failure states, complete already */
+    head = tail = 0;
+    for (c = 0; c < (int)ncl; c++) {
+        if (next[c]) {
+            fail[next[c] / ncl] = 0;
+            queue[tail++] = next[c] / ncl;
+        }
+    }
+    while (head < tail) {
+        apr_size_t st = queue[head++];
+        apr_uint32_t *row = &next[st * ncl];
+        const apr_uint32_t *frow = &next[fail[st] * ncl];
+
+        for (c = 0; c < (int)ncl; c++) {
+            if (row[c]) {
+                apr_size_t u = row[c] / ncl, f = frow[c] / ncl;
+
+                fail[u] = (apr_uint32_t)f;
+                multi->dict[u] = multi->own[f] >= 0 ? (apr_uint32_t)f
+                                                    : multi->dict[f];
+                queue[tail++] = (apr_uint32_t)u;
+            }
+            else {
+                row[c] = frow[c];
+            }
+        }
+    }
+
+    for (i = 0; i < nstates * ncl; i++) {
+        apr_size_t u = next[i] / ncl;
+
+        if (multi->own[u] >= 0 || multi->dict[u]) {
+            next[i] |= MULTI_MATCH;
+        }
+    }
+
+    return multi;
+}
+
+APR_DECLARE(const char *) apr_strmatch_multi(
+        const apr_strmatch_multi_t *multi, const char *s, apr_size_t slen,
+        int *index)
+{
+    const unsigned char *u = (const unsigned char *)s, *end = u + slen;
+    const apr_uint16_t *classes = multi->classes;
+    const apr_uint32_t *next = multi->next;
+    apr_uint32_t t = 0;
+
+    while (u < end) {
+        t = next[MULTI_ROW(t) + classes[*u++]];
+        if (t & MULTI_MATCH) {
+            apr_size_t st = MULTI_ROW(t) / multi->nclasses;
+            int i = multi->own[st] >= 0 ? multi->own[st]
+                                        : multi->own[multi->dict[st]];
+
+            if (index) {
+                *index = i;
+            }
+            return (const char *)u - multi->lengths[i];
+        }
+    }
+
+    return NULL;
+}
+
+APR_DECLARE(int) apr_strmatch_multi_scan(const apr_strmatch_multi_t *multi,
+                                         const char *s, apr_size_t slen,
+                                         apr_strmatch_multi_fn_t *fn,
+                                         void *baton)
+{
+    const unsigned char *u = (const unsigned char *)s, *end = u + slen;
+    const apr_uint16_t *classes = multi->classes;
+    const apr_uint32_t *next = multi->next;
+    apr_uint32_t t = 0;
+
+    while (u < end) {
+        t = next[MULTI_ROW(t) + classes[*u++]];
+        if (t & MULTI_MATCH) {
+            apr_size_t st = MULTI_ROW(t) / multi->nclasses;
+
+            if (multi->own[st] < 0) {
+                st = multi->dict[st];
+            }
+            do {
+                int i = multi->own[st];
+
+                if (!fn(baton, i, (const char *)u - multi->lengths[i])) {
+                    return 0;
+                }
+                st = multi->dict[st];
+            } while (st);
+        }
+    }
+
+    return 1;
+}
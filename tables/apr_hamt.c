@@ -0,0 +1,515 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_hamt.h"
+#include "apr_atomic.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
+
+/*
+ * The trie consumes 5 bits of the hash of a key per level.  A node holds
+ * the entries whose 5 bits are unique at its level inline, and a child
+ * node for the bits shared by several entries, with a bitmap for each
+ * (as in CHAMP, Steindorfer and Vinju 2015): the entries come first and
+ * the children after, both in the order of their bits.  Below the 32 bits
+ * of the hash, a collision node holds the remaining entries in a list,
+ * its datamap being their number.
+ *
+ * A child with a single entry is always inlined in its parent, so that
+ * the trie is the same whatever the order of the modifications.
+ *
+ * The nodes are immutable once shared: those created since the map was
+ * last copied carry its current edit token, and only those are modified
+ * in place.  Copying a map drops its token.
+ */
+#define HAMT_BITS 5
+#define HAMT_MASK 31
+#define HAMT_FRAG(hash, shift) (((hash) >> (shift)) & HAMT_MASK)
+#define HAMT_COLLISION(shift) ((shift) >= 32)
+
+typedef struct hamt_entry_t {
+    unsigned int hash;
+    apr_ssize_t klen;
+    const void *key;
+    const void *val;
+} hamt_entry_t;
+
+typedef struct hamt_node_t hamt_node_t;
+struct hamt_node_t {
+    apr_uint32_t datamap;
+    apr_uint32_t nodemap;
+    void *edit;
+};
+
+struct apr_hamt_t {
+    apr_pool_t *pool;
+    hamt_node_t *root;
+    unsigned int count;
+    apr_hashfunc_t hash_func;
+    void *volatile edit;
+};
+
+#define NODE_ENTRIES(n) ((hamt_entry_t *)((n) + 1))
+
+static APR_INLINE unsigned int hamt_popcount(apr_uint32_t x)
+{
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0F0F0F0F;
+    return (x * 0x01010101) >> 24;
+#endif
+}
+
+static APR_INLINE unsigned int node_ndata(const hamt_node_t *n,
+                                          unsigned int shift)
+{
+    return HAMT_COLLISION(shift) ? n->datamap : hamt_popcount(n->datamap);
+}
+
+static APR_INLINE hamt_node_t **node_subs(const hamt_node_t *n,
+                                          unsigned int shift)
+{
+    return (hamt_node_t **)(NODE_ENTRIES(n) + node_ndata(n, shift));
+}
+
+/* The hash functions of apr_hash_t do not mix all their bits, while all
+ * of them index the trie.
+ */
+static APR_INLINE unsigned int hamt_hash(const apr_hamt_t *h,
+                                         const void *key, apr_ssize_t *klen)
+{
+    apr_uint32_t x = h->hash_func(key, klen);
+
+    x ^= x >> 16;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35U;
+    x ^= x >> 16;
+    return x;
+}
+
+static APR_INLINE int entry_match(const hamt_entry_t *e, unsigned int hash,
+                                  const void *key, apr_ssize_t klen)
+{
+    return e->hash == hash && e->klen == klen
+           && (e->key == key || !memcmp(e->key, key, klen));
+}
+
+static hamt_node_t *node_alloc(apr_hamt_t *h, unsigned int ndata,
+                               unsigned int nsubs)
+{
+    hamt_node_t *n = apr_palloc(h->pool, sizeof(hamt_node_t)
+                                         + ndata * sizeof(hamt_entry_t)
+                                         + nsubs * sizeof(hamt_node_t *));
+    n->edit = h->edit;
+    return n;
+}
+
+/* Copy a node, with the entry at index "del" removed (if any), the entry
+ * "ins" inserted at index "at" (if any), and the same for the children.
+ */
+static hamt_node_t *node_copy(apr_hamt_t *h, const hamt_node_t *n,
+                              unsigned int shift,
+                              apr_uint32_t datamap, apr_uint32_t nodemap,
+                              int del, const hamt_entry_t *ins, int at,
+                              int sdel, hamt_node_t *sins, int sat)
+{
+    unsigned int ndata = node_ndata(n, shift), nsubs = hamt_popcount(n->nodemap);
+    unsigned int new_ndata = ndata - (del >= 0) + (ins != NULL);
+    unsigned int new_nsubs = nsubs - (sdel >= 0) + (sins != NULL);
+    hamt_node_t *c = node_alloc(h, new_ndata, new_nsubs);
+    const hamt_entry_t *from = NODE_ENTRIES(n);
+    hamt_entry_t *to = NODE_ENTRIES(c);
+    hamt_node_t **sfrom = node_subs(n, shift), **sto;
+    unsigned int i;
+
+    c->datamap = datamap;
+    c->nodemap = nodemap;
+    for (i = 0; i < ndata; i++) {
+        if ((int)i == at && ins) {
+            *to++ = *ins;
+        }
+        if ((int)i != del) {
+            *to++ = from[i];
+        }
+    }
+    if (ins && at >= (int)ndata) {
+        *to++ = *ins;
+    }
+    sto = (hamt_node_t **)to;
+    for (i = 0; i < nsubs; i++) {
+        if ((int)i == sat && sins) {
+            *sto++ = sins;
+        }
+        if ((int)i != sdel) {
+            *sto++ = sfrom[i];
+        }
+    }
+    if (sins && sat >= (int)nsubs) {
+        *sto++ = sins;
+    }
+    return c;
+}
+
+/* A node for two entries whose hashes agree up to shift */
+static hamt_node_t *node_pair(apr_hamt_t *h, const hamt_entry_t *e1,
+                              const hamt_entry_t *e2, unsigned int shift)
+{
+    hamt_node_t *n;
+
+    if (HAMT_COLLISION(shift)) {
+        n = node_alloc(h, 2, 0);
+        n->datamap = 2;
+        n->nodemap = 0;
+        NODE_ENTRIES(n)[0] = *e1;
+        NODE_ENTRIES(n)[1] = *e2;
+    }
+    else {
+        unsigned int f1 = HAMT_FRAG(e1->hash, shift);
+        unsigned int f2 = HAMT_FRAG(e2->hash, shift);
+
+        if (f1 != f2) {
+            n = node_alloc(h, 2, 0);
+            n->datamap = (1U << f1) | (1U << f2);
+            n->nodemap = 0;
+            NODE_ENTRIES(n)[f1 < f2 ? 0 : 1] = *e1;
+            NODE_ENTRIES(n)[f1 < f2 ? 1 : 0] = *e2;
+        }
+        else {
+            n = node_alloc(h, 0, 1);
+            n->datamap = 0;
+            n->nodemap = 1U << f1;
+            *node_subs(n, shift) = node_pair(h, e1, e2, shift + HAMT_BITS);
+        }
+    }
+    return n;
+}
+
+static hamt_node_t *node_set(apr_hamt_t *h, hamt_node_t *n,
+                             unsigned int shift, const hamt_entry_t *ne,
+                             int *added)
+{
+    int editable = (n->edit == h->edit);
+    hamt_entry_t *entries = NODE_ENTRIES(n);
+    apr_uint32_t bit;
+    unsigned int i;
+
+    if (HAMT_COLLISION(shift)) {
+        for (i = 0; i < n->datamap; i++) {
+            if (entry_match(&entries[i], ne->hash, ne->key, ne->klen)) {
+                if (!editable) {
+                    n = node_copy(h, n, shift, n->datamap, 0,
+                                  -1, NULL, -1, -1, NULL, -1);
+                }
+                NODE_ENTRIES(n)[i] = *ne;
+                return n;
+            }
+        }
+        *added = 1;
+        return node_copy(h, n, shift, n->datamap + 1, 0,
+                         -1, ne, n->datamap, -1, NULL, -1);
+    }
+
+    bit = 1U << HAMT_FRAG(ne->hash, shift);
+    if (n->datamap & bit) {
+        unsigned int di = hamt_popcount(n->datamap & (bit - 1));
+        hamt_node_t *sub;
+
+        if (entry_match(&entries[di], ne->hash, ne->key, ne->klen)) {
+            if (!editable) {
+                n = node_copy(h, n, shift, n->datamap, n->nodemap,
+                              -1, NULL, -1, -1, NULL, -1);
+            }
+            NODE_ENTRIES(n)[di] = *ne;
+            return n;
+        }
+
+        /* The entry moves down with the new one */
+        *added = 1;
+        sub = node_pair(h, &entries[di], ne, shift + HAMT_BITS);
+        return node_copy(h, n, shift, n->datamap & ~bit, n->nodemap | bit,
+                         di, NULL, -1, -1, sub,
+                         hamt_popcount(n->nodemap & (bit - 1)));
+    }
+    if (n->nodemap & bit) {
+        unsigned int si = hamt_popcount(n->nodemap & (bit - 1));
+        hamt_node_t **subs = node_subs(n, shift);
+        hamt_node_t *sub = node_set(h, subs[si], shift + HAMT_BITS, ne, added);
+
+        if (sub != subs[si]) {
+            if (!editable) {
+                n = node_copy(h, n, shift, n->datamap, n->nodemap,
+                              -1, NULL, -1, -1, NULL, -1);
+                subs = node_subs(n, shift);
+            }
+            subs[si] = sub;
+        }
+        return n;
+    }
+
+    *added = 1;
+    return node_copy(h, n, shift, n->datamap | bit, n->nodemap,
+                     -1, ne, hamt_popcount(n->datamap & (bit - 1)),
+                     -1, NULL, -1);
+}
+
+/* The single entry of a node with no children, if so */
+static const hamt_entry_t *node_single(const hamt_node_t *n,
+                                       unsigned int shift)
+{
+    if (!n->nodemap && node_ndata(n, shift) == 1) {
+        return NODE_ENTRIES(n);
+    }
+    return NULL;
+}
+
+static hamt_node_t *node_delete(apr_hamt_t *h, hamt_node_t *n,
+                                unsigned int shift, unsigned int hash,
+                                const void *key, apr_ssize_t klen,
+                                int *removed)
+{
+    hamt_entry_t *entries = NODE_ENTRIES(n);
+    apr_uint32_t bit;
+    unsigned int i;
+
+    if (HAMT_COLLISION(shift)) {
+        for (i = 0; i < n->datamap; i++) {
+            if (entry_match(&entries[i], hash, key, klen)) {
+                *removed = 1;
+                if (n->datamap == 1) {
+                    return NULL;
+                }
+                return node_copy(h, n, shift, n->datamap - 1, 0,
+                                 i, NULL, -1, -1, NULL, -1);
+            }
+        }
+        return n;
+    }
+
+    bit = 1U << HAMT_FRAG(hash, shift);
+    if (n->datamap & bit) {
+        unsigned int di = hamt_popcount(n->datamap & (bit - 1));
+
+        if (!entry_match(&entries[di], hash, key, klen)) {
+            return n;
+        }
+        *removed = 1;
+        if (n->datamap == bit && !n->nodemap) {
+            return NULL;
+        }
+        return node_copy(h, n, shift, n->datamap & ~bit, n->nodemap,
+                         di, NULL, -1, -1, NULL, -1);
+    }
+    if (n->nodemap & bit) {
+        unsigned int si = hamt_popcount(n->nodemap & (bit - 1));
+        hamt_node_t **subs = node_subs(n, shift);
+        hamt_node_t *sub = node_delete(h, subs[si], shift + HAMT_BITS,
+                                       hash, key, klen, removed);
+        const hamt_entry_t *single;
+
+        if (sub == subs[si]) {
+            return n;
+        }
+        if (!sub) {
+            if (n->nodemap == bit && !n->datamap) {
+                return NULL;
+            }
+            return node_copy(h, n, shift, n->datamap, n->nodemap & ~bit,
+                             -1, NULL, -1, si, NULL, -1);
+        }
+        if ((single = node_single(sub, shift + HAMT_BITS)) != NULL) {
+            /* Inline the last entry of the child */
+            return node_copy(h, n, shift, n->datamap | bit,
+                             n->nodemap & ~bit,
+                             -1, single,
+                             hamt_popcount(n->datamap & (bit - 1)),
+                             si, NULL, -1);
+        }
+        if (n->edit != h->edit) {
+            n = node_copy(h, n, shift, n->datamap, n->nodemap,
+                          -1, NULL, -1, -1, NULL, -1);
+            subs = node_subs(n, shift);
+        }
+        subs[si] = sub;
+        return n;
+    }
+    return n;
+}
+
+static int node_do(apr_hash_do_callback_fn_t *comp, void *rec,
+                   const hamt_node_t *n, unsigned int shift)
+{
+    const hamt_entry_t *entries = NODE_ENTRIES(n);
+    hamt_node_t **subs = node_subs(n, shift);
+    unsigned int i, ndata = node_ndata(n, shift);
+    unsigned int nsubs = hamt_popcount(n->nodemap);
+
+    for (i = 0; i < ndata; i++) {
+        if (!comp(rec, entries[i].key, entries[i].klen, entries[i].val)) {
+            return 0;
+        }
+    }
+    for (i = 0; i < nsubs; i++) {
+        if (!node_do(comp, rec, subs[i], shift + HAMT_BITS)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+APR_DECLARE(apr_hamt_t *) apr_hamt_make_custom(apr_pool_t *p,
+                                               apr_hashfunc_t hash_func)
+{
+    apr_hamt_t *h = apr_pcalloc(p, sizeof(apr_hamt_t));
+
+    h->pool = p;
+    h->hash_func = hash_func;
+    return h;
+}
+
+APR_DECLARE(apr_hamt_t *) apr_hamt_make(apr_pool_t *p)
+{
+    return apr_hamt_make_custom(p, apr_hashfunc_default);
+}
+
+APR_DECLARE(apr_hamt_t *) apr_hamt_copy(apr_pool_t *p, apr_hamt_t *h)
+{
+    apr_hamt_t *copy = apr_palloc(p, sizeof(apr_hamt_t));
+
+    copy->pool = p;
+    copy->root = h->root;
+    copy->count = h->count;
+    copy->hash_func = h->hash_func;
+    copy->edit = NULL;
+
+    /* The nodes are shared from now on */
+    if (apr_atomic_readptr_explicit(&h->edit, APR_ATOMIC_RELAXED)) {
+        apr_atomic_setptr_explicit(&h->edit, NULL, APR_ATOMIC_RELAXED);
+    }
+    return copy;
+}
+
+APR_DECLARE(void) apr_hamt_set(apr_hamt_t *h, const void *key,
+                               apr_ssize_t klen, const void *val)
+{
+    unsigned int hash = hamt_hash(h, key, &klen);
+
+    if (!h->edit) {
+        h->edit = apr_palloc(h->pool, 1);
+    }
+
+    if (val) {
+        hamt_entry_t ne;
+        int added = 0;
+
+        ne.hash = hash;
+        ne.klen = klen;
+        ne.key = key;
+        ne.val = val;
+        if (!h->root) {
+            h->root = node_alloc(h, 1, 0);
+            h->root->datamap = 1U << HAMT_FRAG(hash, 0);
+            h->root->nodemap = 0;
+            NODE_ENTRIES(h->root)[0] = ne;
+            added = 1;
+        }
+        else {
+            h->root = node_set(h, h->root, 0, &ne, &added);
+        }
+        h->count += added;
+    }
+    else if (h->root) {
+        int removed = 0;
+
+        h->root = node_delete(h, h->root, 0, hash, key, klen, &removed);
+        h->count -= removed;
+    }
+}
+
+APR_DECLARE(void *) apr_hamt_get(const apr_hamt_t *h, const void *key,
+                                 apr_ssize_t klen)
+{
+    unsigned int hash = hamt_hash(h, key, &klen), shift = 0, i;
+    const hamt_node_t *n = h->root;
+
+    while (n) {
+        const hamt_entry_t *entries = NODE_ENTRIES(n);
+        apr_uint32_t bit;
+
+        if (HAMT_COLLISION(shift)) {
+            for (i = 0; i < n->datamap; i++) {
+                if (entry_match(&entries[i], hash, key, klen)) {
+                    return (void *)entries[i].val;
+                }
+            }
+            break;
+        }
+
+        bit = 1U << HAMT_FRAG(hash, shift);
+        if (n->datamap & bit) {
+            const hamt_entry_t *e;
+
+            e = &entries[hamt_popcount(n->datamap & (bit - 1))];
+            if (entry_match(e, hash, key, klen)) {
+                return (void *)e->val;
+            }
+            break;
+        }
+        if (!(n->nodemap & bit)) {
+            break;
+        }
+        n = node_subs(n, shift)[hamt_popcount(n->nodemap & (bit - 1))];
+        shift += HAMT_BITS;
+    }
+    return NULL;
+}
+
+APR_DECLARE(unsigned int) apr_hamt_count(const apr_hamt_t *h)
+{
+    return h->count;
+}
+
+APR_DECLARE(int) apr_hamt_do(apr_hash_do_callback_fn_t *comp, void *rec,
+                             const apr_hamt_t *h)
+{
+    if (!h->root) {
+        return 1;
+    }
+    return node_do(comp, rec, h->root, 0);
+}
+
+static int hamt_overlay_set(void *rec, const void *key, apr_ssize_t klen,
+                            const void *val)
+{
+    apr_hamt_set(rec, key, klen, val);
+    return 1;
+}
+
+APR_DECLARE(apr_hamt_t *) apr_hamt_overlay(apr_pool_t *p,
+                                           const apr_hamt_t *overlay,
+                                           apr_hamt_t *base)
+{
+    apr_hamt_t *h = apr_hamt_copy(p, base);
+
+    apr_hamt_do(hamt_overlay_set, h, overlay);
+    return h;
+}
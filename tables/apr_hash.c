@@ -21,6 +21,9 @@
 #include "apr_time.h"
 
 #include "apr_hash.h"
+#include "apr_siphash.h"
+#include "apr_atomic.h"
+#include "apr_thread_pool.h"
 
 #if APR_HAVE_STDLIB_H
 #include <stdlib.h>
@@ -40,6 +43,22 @@
  * are resolved by hanging a linked list of hash entries off each
  * element of the array. Although this is a really simple design it
  * isn't too bad given that pools have a low allocation overhead.
+ *
+ * With APR_HASH_INCREMENTAL, growing the array does not rehash all the
+ * entries at once: the previous array is kept and a few of its buckets
+ * are migrated to the new one by each insertion, so the cost of the
+ * growth is spread over the following operations.  The readers look at
+ * both arrays rather than migrating, so that a table which is not
+ * modified can still be read by concurrent threads, and deleting the
+ * current entry of an iteration does not move the others.
+ *
+ * The flat form (apr_hash_make_flat) uses open addressing instead: the
+ * entries are stored inline in an array of slots, with a parallel array
+ * of control bytes telling whether each slot is empty, deleted (a
+ * tombstone) or full, in which case the byte holds 7 bits of the hash.
+ * Lookups scan the control bytes 8 at a time (in a 64-bit word), and
+ * only compare the slots whose byte matches, so most probes touch one
+ * cache line of control bytes and one slot.
  */
 
 typedef struct apr_hash_entry_t apr_hash_entry_t;
@@ -52,6 +71,13 @@ struct apr_hash_entry_t {
     const void       *val;
 };
 
+typedef struct apr_hash_slot_t {
+    unsigned int      hash;
+    apr_ssize_t       klen;
+    const void       *key;
+    const void       *val;
+} apr_hash_slot_t;
+
 /*
  * Data structure for iterating through a hash table.
  *
@@ -62,6 +88,7 @@ struct apr_hash_entry_t {
 struct apr_hash_index_t {
     apr_hash_t         *ht;
     apr_hash_entry_t   *this, *next;
+    apr_hash_slot_t    *slot;   /* Flat tables */
     unsigned int        index;
 };
 
@@ -79,9 +106,29 @@ struct apr_hash_t {
     unsigned int         count, max, seed;
     apr_hashfunc_t       hash_func;
     apr_hash_entry_t    *free;  /* List of recycled entries */
+    unsigned char       *ctrl;      /* Flat tables: control bytes */
+    apr_hash_slot_t     *slots;     /* Flat tables: entries */
+    unsigned int         deleted;   /* Flat tables: tombstones */
+    apr_hash_entry_t   **old_array; /* Incremental: array being migrated */
+    unsigned int         old_max, migrate, incremental;
+    unsigned int         keyed;     /* APR_HASH_SIPHASH or APR_HASH_FASTHASH */
+    unsigned char        key[APR_SIPHASH_KSIZE];
 };
 
 #define INITIAL_MAX 15 /* tunable == 2^n - 1 */
+#define MIGRATE_BUCKETS 4 /* old buckets migrated per operation */
+
+/*
+ * The control bytes of flat tables: the slots are probed by groups of
+ * FLAT_GROUP, and the first FLAT_GROUP control bytes are cloned after
+ * the last one so that a group can always be loaded at once.
+ */
+#define FLAT_GROUP      8
+#define FLAT_EMPTY      0x80
+#define FLAT_DELETED    0xFE
+#define FLAT_FULL(c)    (((c) & 0x80) == 0)
+#define FLAT_ONES       APR_UINT64_C(0x0101010101010101)
+#define FLAT_LIMIT(max) ((max) + 1 - ((max) + 1) / 8)
 
 
 /*
@@ -93,7 +140,69 @@ static apr_hash_entry_t **alloc_array(apr_hash_t *ht, unsigned int max)
    return apr_pcalloc(ht->pool, sizeof(*ht->array) * (max + 1));
 }
 
-APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
+static void alloc_flat(apr_hash_t *ht, unsigned int max)
+{
+    ht->ctrl = apr_palloc(ht->pool, max + 1 + FLAT_GROUP);
+    memset(ht->ctrl, FLAT_EMPTY, max + 1 + FLAT_GROUP);
+    ht->slots = apr_palloc(ht->pool, sizeof(*ht->slots) * (max + 1));
+    ht->max = max;
+    ht->deleted = 0;
+}
+
+/*
+ * The keyed hashes use a key per table derived from a random secret per
+ * process. The secret is initialized once and for all by the first thread
+ * getting to it, the others wait for it to be published.
+ */
+#define HASH_SECRET_UNSET   0
+#define HASH_SECRET_INIT    1
+#define HASH_SECRET_READY   2
+
+static unsigned char hash_secret[APR_SIPHASH_KSIZE];
+static apr_uint32_t hash_secret_state = HASH_SECRET_UNSET;
+
+static void init_secret(void)
+{
+    apr_uint64_t k[2];
+    apr_time_t now = apr_time_now();
+
+#if APR_HAS_RANDOM
+    if (apr_generate_random_bytes(hash_secret, sizeof(hash_secret))
+            != APR_SUCCESS)
+#endif
+    {
+        k[0] = (apr_uint64_t)now ^ (apr_uintptr_t)&now;
+        k[1] = (apr_uint64_t)now ^ (apr_uintptr_t)hash_secret;
+        memcpy(hash_secret, k, sizeof(hash_secret));
+    }
+}
+
+static void make_key(apr_hash_t *ht)
+{
+    apr_uint64_t k[2];
+
+    if (apr_atomic_read32(&hash_secret_state) != HASH_SECRET_READY) {
+        if (apr_atomic_cas32(&hash_secret_state, HASH_SECRET_INIT,
+                             HASH_SECRET_UNSET) == HASH_SECRET_UNSET) {
+            init_secret();
+            apr_atomic_set32(&hash_secret_state, HASH_SECRET_READY);
+        }
+        else {
+            while (apr_atomic_read32(&hash_secret_state)
+                   != HASH_SECRET_READY) {
+#if APR_HAS_THREADS
+                apr_thread_yield();
+#endif
+            }
+        }
+    }
+
+    k[0] = apr_siphash24(&ht->seed, sizeof(ht->seed), hash_secret);
+    k[1] = apr_siphash24(&k[0], sizeof(k[0]), hash_secret);
+    memcpy(ht->key, k, sizeof(ht->key));
+}
+
+static apr_hash_t *hash_make(apr_pool_t *pool, apr_uint32_t flags)
 {
     apr_hash_t *ht;
     apr_time_t now = apr_time_now();
@@ -105,12 +214,34 @@ APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
     ht->max = INITIAL_MAX;
     ht->seed = (unsigned int)((now >> 32) ^ now ^ (apr_uintptr_t)pool ^
                               (apr_uintptr_t)ht ^ (apr_uintptr_t)&now) - 1;
-    ht->array = alloc_array(ht, ht->max);
+    ht->old_array = NULL;
+    ht->old_max = ht->migrate = 0;
+    ht->incremental = 0;
+    ht->keyed = flags & (APR_HASH_SIPHASH | APR_HASH_FASTHASH);
+    if (ht->keyed) {
+        make_key(ht);
+    }
+    if (flags & APR_HASH_FLAT) {
+        ht->array = NULL;
+        alloc_flat(ht, INITIAL_MAX);
+    }
+    else {
+        ht->array = alloc_array(ht, ht->max);
+        ht->ctrl = NULL;
+        ht->slots = NULL;
+        ht->deleted = 0;
+        ht->incremental = (flags & APR_HASH_INCREMENTAL) != 0;
+    }
     ht->hash_func = NULL;
 
     return ht;
 }
 
+APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
+{
+    return hash_make(pool, 0);
+}
+
 APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
                                                apr_hashfunc_t hash_func)
 {
@@ -119,6 +250,71 @@ APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
     return ht;
 }
 
+APR_DECLARE(apr_hash_t *) apr_hash_make_flat(apr_pool_t *pool)
+{
+    return hash_make(pool, APR_HASH_FLAT);
+}
+
+APR_DECLARE(apr_hash_t *) apr_hash_make_flat_custom(apr_pool_t *pool,
+                                                    apr_hashfunc_t hash_func)
+{
+    apr_hash_t *ht = apr_hash_make_flat(pool);
+    ht->hash_func = hash_func;
+    return ht;
+}
+
+APR_DECLARE(apr_hash_t *) apr_hash_make_ex(apr_pool_t *pool,
+                                           apr_hashfunc_t hash_func,
+                                           apr_uint32_t flags)
+{
+    apr_hash_t *ht = hash_make(pool, flags);
+    ht->hash_func = hash_func;
+    return ht;
+}
+
+
+/*
+ * Incremental growth: migrate up to n buckets of the old array.
+ */
+
+static void migrate_buckets(apr_hash_t *ht, unsigned int n)
+{
+    while (n-- && ht->old_array) {
+        apr_hash_entry_t *he = ht->old_array[ht->migrate], *next;
+        for (; he; he = next) {
+            unsigned int i = he->hash & ht->max;
+            next = he->next;
+            he->next = ht->array[i];
+            ht->array[i] = he;
+        }
+        ht->old_array[ht->migrate] = NULL;
+        if (++ht->migrate > ht->old_max) {
+            ht->old_array = NULL;
+        }
+    }
+}
+
+/*
+ * The buckets to walk: the ones of the array, then the ones of the old
+ * array not migrated yet.
+ */
+static APR_INLINE unsigned int hash_buckets(const apr_hash_t *ht)
+{
+    unsigned int n = ht->max + 1;
+
+    if (ht->old_array)
+        n += ht->old_max + 1 - ht->migrate;
+    return n;
+}
+
+static APR_INLINE apr_hash_entry_t *hash_bucket(const apr_hash_t *ht,
+                                                unsigned int i)
+{
+    if (i <= ht->max)
+        return ht->array[i];
+    return ht->old_array[ht->migrate + i - (ht->max + 1)];
+}
+
 
 /*
  * Hash iteration functions.
@@ -126,17 +322,37 @@ APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
 
 APR_DECLARE(apr_hash_index_t *) apr_hash_next(apr_hash_index_t *hi)
 {
+    if (hi->ht->ctrl) {
+        while (hi->index <= hi->ht->max) {
+            unsigned int i = hi->index++;
+            if (FLAT_FULL(hi->ht->ctrl[i])) {
+                hi->slot = &hi->ht->slots[i];
+                return hi;
+            }
+        }
+        return NULL;
+    }
+
     hi->this = hi->next;
     while (!hi->this) {
-        if (hi->index > hi->ht->max)
+        if (hi->index >= hash_buckets(hi->ht))
             return NULL;
 
-        hi->this = hi->ht->array[hi->index++];
+        hi->this = hash_bucket(hi->ht, hi->index++);
     }
     hi->next = hi->this->next;
     return hi;
 }
 
+static void hash_index_init(apr_hash_index_t *hi, const apr_hash_t *ht)
+{
+    hi->ht = (apr_hash_t *)ht;
+    hi->index = 0;
+    hi->this = NULL;
+    hi->next = NULL;
+    hi->slot = NULL;
+}
+
 APR_DECLARE(apr_hash_index_t *) apr_hash_first(apr_pool_t *p, apr_hash_t *ht)
 {
     apr_hash_index_t *hi;
@@ -145,10 +361,20 @@ APR_DECLARE(apr_hash_index_t *) apr_hash_first(apr_pool_t *p, apr_hash_t *ht)
     else
         hi = &ht->iterator;
 
-    hi->ht = ht;
-    hi->index = 0;
-    hi->this = NULL;
-    hi->next = NULL;
+    hash_index_init(hi, ht);
+    return apr_hash_next(hi);
+}
+
+/* The storage of an apr_hash_iter_t must fit an apr_hash_index_t */
+typedef char hash_iter_fits_index[sizeof(apr_hash_iter_t)
+                                  >= sizeof(apr_hash_index_t) ? 1 : -1];
+
+APR_DECLARE(apr_hash_index_t *) apr_hash_iter_init(apr_hash_iter_t *it,
+                                                   apr_hash_t *ht)
+{
+    apr_hash_index_t *hi = (apr_hash_index_t *)it;
+
+    hash_index_init(hi, ht);
     return apr_hash_next(hi);
 }
 
@@ -157,6 +383,12 @@ APR_DECLARE(void) apr_hash_this(apr_hash_index_t *hi,
                                 apr_ssize_t *klen,
                                 void **val)
 {
+    if (hi->ht->ctrl) {
+        if (key)  *key  = hi->slot->key;
+        if (klen) *klen = hi->slot->klen;
+        if (val)  *val  = (void *)hi->slot->val;
+        return;
+    }
     if (key)  *key  = hi->this->key;
     if (klen) *klen = hi->this->klen;
     if (val)  *val  = (void *)hi->this->val;
@@ -198,6 +430,16 @@ static void expand_array(apr_hash_t *ht)
 
     new_max = ht->max * 2 + 1;
     new_array = alloc_array(ht, new_max);
+    if (ht->incremental) {
+        /* let the insertions migrate the old array */
+        migrate_buckets(ht, APR_UINT32_MAX);
+        ht->old_array = ht->array;
+        ht->old_max = ht->max;
+        ht->migrate = 0;
+        ht->array = new_array;
+        ht->max = new_max;
+        return;
+    }
     for (hi = apr_hash_first(NULL, ht); hi; hi = apr_hash_next(hi)) {
         unsigned int i = hi->this->hash & new_max;
         hi->this->next = new_array[i];
@@ -273,6 +515,66 @@ APR_DECLARE_NONSTD(unsigned int) apr_hashfunc_default(const char *char_key,
     return hashfunc_default(char_key, klen, 0);
 }
 
+/*
+ * APR_HASH_FASTHASH: a keyed 64-bit word at a time multiply-rotate hash
+ * (in the spirit of xxHash64), with a final avalanche.
+ */
+#define FH_P1 APR_UINT64_C(0x9E3779B185EBCA87)
+#define FH_P2 APR_UINT64_C(0xC2B2AE3D27D4EB4F)
+#define FH_P3 APR_UINT64_C(0x165667B19E3779F9)
+#define FH_P4 APR_UINT64_C(0x85EBCA77C2B2AE63)
+#define FH_ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+#define FH_ROUND(h, k, w) do { \
+    apr_uint64_t r_ = (k) + (w) * FH_P2; \
+    r_ = FH_ROTL(r_, 31) * FH_P1; \
+    (h) ^= r_; \
+    (h) = FH_ROTL((h), 27) * FH_P1 + FH_P4; \
+} while (0)
+
+static apr_uint64_t fasthash(const unsigned char *key, apr_size_t len,
+                             const unsigned char secret[APR_SIPHASH_KSIZE])
+{
+    apr_uint64_t k[2], h, w;
+
+    memcpy(k, secret, sizeof(k));
+    h = k[0] + len * FH_P3;
+    for (; len >= 8; len -= 8, key += 8) {
+        memcpy(&w, key, 8);
+        FH_ROUND(h, k[1], w);
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, key, len);
+        FH_ROUND(h, k[1], w);
+    }
+
+    h ^= h >> 33;
+    h *= FH_P2;
+    h ^= h >> 29;
+    h *= FH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+static APR_INLINE unsigned int hash_key(const apr_hash_t *ht,
+                                        const void *key, apr_ssize_t *klen)
+{
+    apr_uint64_t h;
+
+    if (ht->hash_func)
+        return ht->hash_func(key, klen);
+    if (!ht->keyed)
+        return hashfunc_default(key, klen, ht->seed);
+
+    if (*klen == APR_HASH_KEY_STRING)
+        *klen = strlen(key);
+    if (ht->keyed & APR_HASH_SIPHASH)
+        h = apr_siphash(key, *klen, ht->key, 1, 3);
+    else
+        h = fasthash(key, *klen, ht->key);
+    return (unsigned int)(h ^ (h >> 32));
+}
+
 /*
  * This is where we keep the details of the hash function and control
  * the maximum collision rate.
@@ -290,10 +592,7 @@ static apr_hash_entry_t **find_entry(apr_hash_t *ht,
     apr_hash_entry_t **hep, *he;
     unsigned int hash;
 
-    if (ht->hash_func)
-        hash = ht->hash_func(key, &klen);
-    else
-        hash = hashfunc_default(key, &klen, ht->seed);
+    hash = hash_key(ht, key, &klen);
 
     /* scan linked list */
     for (hep = &ht->array[hash & ht->max], he = *hep;
@@ -303,15 +602,34 @@ static apr_hash_entry_t **find_entry(apr_hash_t *ht,
             && memcmp(he->key, key, klen) == 0)
             break;
     }
+    if (!he && ht->old_array && (hash & ht->old_max) >= ht->migrate) {
+        /* not migrated yet? */
+        apr_hash_entry_t **old_hep;
+        for (old_hep = &ht->old_array[hash & ht->old_max], he = *old_hep;
+             he; old_hep = &he->next, he = *old_hep) {
+            if (he->hash == hash
+                && he->klen == klen
+                && memcmp(he->key, key, klen) == 0)
+                return old_hep;
+        }
+    }
     if (he || !val)
         return hep;
 
+    /* Only the insertions migrate, the new entry goes first in its
+     * bucket then (hep may be stale).
+     */
+    if (ht->old_array) {
+        migrate_buckets(ht, MIGRATE_BUCKETS);
+        hep = &ht->array[hash & ht->max];
+    }
+
     /* add a new entry for non-NULL values */
     if ((he = ht->free) != NULL)
         ht->free = he->next;
     else
         he = apr_palloc(ht->pool, sizeof(*he));
-    he->next = NULL;
+    he->next = *hep;
     he->hash = hash;
     he->key  = key;
     he->klen = klen;
@@ -321,6 +639,162 @@ static apr_hash_entry_t **find_entry(apr_hash_t *ht,
     return hep;
 }
 
+/*
+ * Flat tables: the hash is mixed so that both the index (low bits) and
+ * the control byte (high bits) are well distributed.
+ */
+
+static APR_INLINE unsigned int flat_mix(unsigned int hash)
+{
+    hash *= 0x9E3779B1U;
+    return hash ^ (hash >> 15);
+}
+
+static APR_INLINE apr_uint64_t flat_group(const unsigned char *ctrl)
+{
+    apr_uint64_t group;
+    memcpy(&group, ctrl, sizeof(group));
+    return group;
+}
+
+/* Whether any byte of the group equals c */
+static APR_INLINE int flat_match(apr_uint64_t group, unsigned char c)
+{
+    group ^= FLAT_ONES * c;
+    return ((group - FLAT_ONES) & ~group & (FLAT_ONES << 7)) != 0;
+}
+
+static APR_INLINE void flat_set_ctrl(apr_hash_t *ht, unsigned int i,
+                                     unsigned char c)
+{
+    ht->ctrl[i] = c;
+    if (i < FLAT_GROUP) {
+        ht->ctrl[ht->max + 1 + i] = c;
+    }
+}
+
+/* First empty or deleted slot for the (mixed) hash */
+static unsigned int flat_free_slot(apr_hash_t *ht, unsigned int mix)
+{
+    unsigned int pos = mix & ht->max, j;
+
+    for (;;) {
+        for (j = 0; j < FLAT_GROUP; j++) {
+            unsigned int i = (pos + j) & ht->max;
+            if (!FLAT_FULL(ht->ctrl[i])) {
+                return i;
+            }
+        }
+        pos = (pos + FLAT_GROUP) & ht->max;
+    }
+}
+
+static void flat_rehash(apr_hash_t *ht)
+{
+    unsigned char *old_ctrl = ht->ctrl;
+    apr_hash_slot_t *old_slots = ht->slots;
+    unsigned int old_max = ht->max, new_max = ht->max, i;
+
+    /* Grow if more than half full, otherwise only drop the tombstones */
+    if (ht->count >= (ht->max + 1) / 2) {
+        new_max = ht->max * 2 + 1;
+    }
+    alloc_flat(ht, new_max);
+    for (i = 0; i <= old_max; i++) {
+        if (FLAT_FULL(old_ctrl[i])) {
+            unsigned int mix = flat_mix(old_slots[i].hash);
+            unsigned int j = flat_free_slot(ht, mix);
+            flat_set_ctrl(ht, j, (unsigned char)(mix >> 25));
+            ht->slots[j] = old_slots[i];
+        }
+    }
+}
+
+/*
+ * Same as find_entry() for flat tables, returns the slot of the key or
+ * NULL if it's not there (and val is NULL).
+ */
+static apr_hash_slot_t *flat_find(apr_hash_t *ht,
+                                  const void *key,
+                                  apr_ssize_t klen,
+                                  const void *val)
+{
+    apr_hash_slot_t *slot;
+    unsigned int hash, mix, pos, i, j;
+    unsigned char tag;
+
+    hash = hash_key(ht, key, &klen);
+    mix = flat_mix(hash);
+    tag = (unsigned char)(mix >> 25);
+
+    /* probe the groups until one has an empty slot */
+    for (pos = mix & ht->max; ; pos = (pos + FLAT_GROUP) & ht->max) {
+        apr_uint64_t group = flat_group(ht->ctrl + pos);
+        if (flat_match(group, tag)) {
+            for (j = 0; j < FLAT_GROUP; j++) {
+                i = (pos + j) & ht->max;
+                slot = &ht->slots[i];
+                if (ht->ctrl[i] == tag
+                    && slot->hash == hash
+                    && slot->klen == klen
+                    && memcmp(slot->key, key, klen) == 0)
+                    return slot;
+            }
+        }
+        if (flat_match(group, FLAT_EMPTY))
+            break;
+    }
+    if (!val)
+        return NULL;
+
+    /* add a new entry for non-NULL values, keeping some empty slots */
+    if (ht->count + ht->deleted >= FLAT_LIMIT(ht->max))
+        flat_rehash(ht);
+    i = flat_free_slot(ht, mix);
+    if (ht->ctrl[i] == FLAT_DELETED)
+        ht->deleted--;
+    flat_set_ctrl(ht, i, tag);
+    slot = &ht->slots[i];
+    slot->hash = hash;
+    slot->key  = key;
+    slot->klen = klen;
+    slot->val  = val;
+    ht->count++;
+    return slot;
+}
+
+static void flat_delete(apr_hash_t *ht, apr_hash_slot_t *slot)
+{
+    /* Keep the key for an iterator on this slot (apr_hash_this) */
+    flat_set_ctrl(ht, (unsigned int)(slot - ht->slots), FLAT_DELETED);
+    slot->val = NULL;
+    ht->deleted++;
+    --ht->count;
+}
+
+static apr_hash_t *flat_copy(apr_pool_t *pool, const apr_hash_t *orig)
+{
+    apr_hash_t *ht;
+
+    ht = apr_palloc(pool, sizeof(apr_hash_t));
+    ht->pool = pool;
+    ht->free = NULL;
+    ht->array = NULL;
+    ht->count = orig->count;
+    ht->seed = orig->seed;
+    ht->hash_func = orig->hash_func;
+    ht->keyed = orig->keyed;
+    memcpy(ht->key, orig->key, sizeof(ht->key));
+    ht->old_array = NULL;
+    ht->old_max = ht->migrate = 0;
+    ht->incremental = 0;
+    alloc_flat(ht, orig->max);
+    memcpy(ht->ctrl, orig->ctrl, orig->max + 1 + FLAT_GROUP);
+    memcpy(ht->slots, orig->slots, sizeof(*ht->slots) * (orig->max + 1));
+    ht->deleted = orig->deleted;
+    return ht;
+}
+
 APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
                                         const apr_hash_t *orig)
 {
@@ -328,6 +802,9 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     apr_hash_entry_t *new_vals;
     unsigned int i, j;
 
+    if (orig->ctrl)
+        return flat_copy(pool, orig);
+
     ht = apr_palloc(pool, sizeof(apr_hash_t) +
                     sizeof(*ht->array) * (orig->max + 1) +
                     sizeof(apr_hash_entry_t) * orig->count);
@@ -337,24 +814,38 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     ht->max = orig->max;
     ht->seed = orig->seed;
     ht->hash_func = orig->hash_func;
+    ht->keyed = orig->keyed;
+    memcpy(ht->key, orig->key, sizeof(ht->key));
+    ht->ctrl = NULL;
+    ht->slots = NULL;
+    ht->deleted = 0;
+    ht->old_array = NULL;
+    ht->old_max = ht->migrate = 0;
+    ht->incremental = orig->incremental;
     ht->array = (apr_hash_entry_t **)((char *)ht + sizeof(apr_hash_t));
 
     new_vals = (apr_hash_entry_t *)((char *)(ht) + sizeof(apr_hash_t) +
                                     sizeof(*ht->array) * (orig->max + 1));
+    memset(ht->array, 0, sizeof(*ht->array) * (ht->max + 1));
     j = 0;
-    for (i = 0; i <= ht->max; i++) {
-        apr_hash_entry_t **new_entry = &(ht->array[i]);
-        apr_hash_entry_t *orig_entry = orig->array[i];
-        while (orig_entry) {
-            *new_entry = &new_vals[j++];
-            (*new_entry)->hash = orig_entry->hash;
-            (*new_entry)->key = orig_entry->key;
-            (*new_entry)->klen = orig_entry->klen;
-            (*new_entry)->val = orig_entry->val;
-            new_entry = &((*new_entry)->next);
-            orig_entry = orig_entry->next;
+    for (i = 0; i < hash_buckets(orig); i++) {
+        apr_hash_entry_t *orig_entry;
+
+        /* the copy has no old array, the entries not migrated yet in
+         * the original's are rehashed
+         */
+        for (orig_entry = hash_bucket(orig, i); orig_entry;
+             orig_entry = orig_entry->next) {
+            apr_hash_entry_t *new_entry = &new_vals[j++];
+            unsigned int k = orig_entry->hash & ht->max;
+
+            new_entry->hash = orig_entry->hash;
+            new_entry->key = orig_entry->key;
+            new_entry->klen = orig_entry->klen;
+            new_entry->val = orig_entry->val;
+            new_entry->next = ht->array[k];
+            ht->array[k] = new_entry;
         }
-        *new_entry = NULL;
     }
     return ht;
 }
@@ -364,6 +855,12 @@ APR_DECLARE(void *) apr_hash_get(apr_hash_t *ht,
                                  apr_ssize_t klen)
 {
     apr_hash_entry_t *he;
+
+    if (ht->ctrl) {
+        apr_hash_slot_t *slot = flat_find(ht, key, klen, NULL);
+        return slot ? (void *)slot->val : NULL;
+    }
+
     he = *find_entry(ht, key, klen, NULL);
     if (he)
         return (void *)he->val;
@@ -377,6 +874,18 @@ APR_DECLARE(void) apr_hash_set(apr_hash_t *ht,
                                const void *val)
 {
     apr_hash_entry_t **hep;
+
+    if (ht->ctrl) {
+        apr_hash_slot_t *slot = flat_find(ht, key, klen, val);
+        if (slot) {
+            if (!val)
+                flat_delete(ht, slot);
+            else
+                slot->val = val;
+        }
+        return;
+    }
+
     hep = find_entry(ht, key, klen, val);
     if (*hep) {
         if (!val) {
@@ -405,6 +914,12 @@ APR_DECLARE(void *) apr_hash_get_or_set(apr_hash_t *ht,
                                         const void *val)
 {
     apr_hash_entry_t **hep;
+
+    if (ht->ctrl) {
+        apr_hash_slot_t *slot = flat_find(ht, key, klen, val);
+        return slot ? (void *)slot->val : NULL;
+    }
+
     hep = find_entry(ht, key, klen, val);
     if (*hep) {
         val = (*hep)->val;
@@ -427,7 +942,8 @@ APR_DECLARE(void) apr_hash_clear(apr_hash_t *ht)
 {
     apr_hash_index_t *hi;
     for (hi = apr_hash_first(NULL, ht); hi; hi = apr_hash_next(hi))
-        apr_hash_set(ht, hi->this->key, hi->this->klen, NULL);
+        apr_hash_set(ht, apr_hash_this_key(hi), apr_hash_this_key_len(hi),
+                     NULL);
 }
 
 APR_DECLARE(apr_hash_t*) apr_hash_overlay(apr_pool_t *p,
@@ -437,6 +953,43 @@ APR_DECLARE(apr_hash_t*) apr_hash_overlay(apr_pool_t *p,
     return apr_hash_merge(p, overlay, base, NULL, NULL);
 }
 
+/*
+ * Merge when any of the tables is flat: the result is a copy of base
+ * (hence of the same form) where the overlay's entries are set.
+ */
+static apr_hash_t *flat_merge(apr_pool_t *p,
+                              const apr_hash_t *overlay,
+                              const apr_hash_t *base,
+                              void * (*merger)(apr_pool_t *p,
+                                               const void *key,
+                                               apr_ssize_t klen,
+                                               const void *h1_val,
+                                               const void *h2_val,
+                                               const void *data),
+                              const void *data)
+{
+    apr_hash_t *res = apr_hash_copy(p, base);
+    apr_hash_index_t hix, *hi;
+
+    hix.ht    = (apr_hash_t *)overlay;
+    hix.index = 0;
+    hix.this  = NULL;
+    hix.next  = NULL;
+    hix.slot  = NULL;
+    for (hi = apr_hash_next(&hix); hi; hi = apr_hash_next(hi)) {
+        const void *key;
+        apr_ssize_t klen;
+        void *val, *cur;
+
+        apr_hash_this(hi, &key, &klen, &val);
+        if (merger && (cur = apr_hash_get(res, key, klen)) != NULL) {
+            val = (*merger)(p, key, klen, val, cur, data);
+        }
+        apr_hash_set(res, key, klen, val);
+    }
+    return res;
+}
+
 APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
                                          const apr_hash_t *overlay,
                                          const apr_hash_t *base,
@@ -471,10 +1024,22 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
     }
 #endif
 
+    if (overlay->ctrl || base->ctrl) {
+        return flat_merge(p, overlay, base, merger, data);
+    }
+
     res = apr_palloc(p, sizeof(apr_hash_t));
     res->pool = p;
     res->free = NULL;
+    res->ctrl = NULL;
+    res->slots = NULL;
+    res->deleted = 0;
+    res->old_array = NULL;
+    res->old_max = res->migrate = 0;
+    res->incremental = base->incremental;
     res->hash_func = base->hash_func;
+    res->keyed = base->keyed;
+    memcpy(res->key, base->key, sizeof(res->key));
     res->count = base->count;
     res->max = (overlay->max > base->max) ? overlay->max : base->max;
     if (base->count + overlay->count > res->max) {
@@ -487,8 +1052,8 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
                               (base->count + overlay->count));
     }
     j = 0;
-    for (k = 0; k <= base->max; k++) {
-        for (iter = base->array[k]; iter; iter = iter->next) {
+    for (k = 0; k < hash_buckets(base); k++) {
+        for (iter = hash_bucket(base, k); iter; iter = iter->next) {
             i = iter->hash & res->max;
             new_vals[j].klen = iter->klen;
             new_vals[j].key = iter->key;
@@ -500,12 +1065,9 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
         }
     }
 
-    for (k = 0; k <= overlay->max; k++) {
-        for (iter = overlay->array[k]; iter; iter = iter->next) {
-            if (res->hash_func)
-                hash = res->hash_func(iter->key, &iter->klen);
-            else
-                hash = hashfunc_default(iter->key, &iter->klen, res->seed);
+    for (k = 0; k < hash_buckets(overlay); k++) {
+        for (iter = hash_bucket(overlay, k); iter; iter = iter->next) {
+            hash = hash_key(res, iter->key, &iter->klen);
             i = hash & res->max;
             for (ent = res->array[i]; ent; ent = ent->next) {
                 if ((ent->klen == iter->klen) &&
@@ -550,15 +1112,17 @@ APR_DECLARE(int) apr_hash_do(apr_hash_do_callback_fn_t *comp,
     apr_hash_index_t *hi;
     int rv, dorv  = 1;
 
-    hix.ht    = (apr_hash_t *)ht;
-    hix.index = 0;
-    hix.this  = NULL;
-    hix.next  = NULL;
+    hash_index_init(&hix, ht);
 
     if ((hi = apr_hash_next(&hix))) {
         /* Scan the entire table */
         do {
-            rv = (*comp)(rec, hi->this->key, hi->this->klen, hi->this->val);
+            const void *key;
+            apr_ssize_t klen;
+            void *val;
+
+            apr_hash_this(hi, &key, &klen, &val);
+            rv = (*comp)(rec, key, klen, val);
         } while (rv && (hi = apr_hash_next(hi)));
 
         if (rv == 0) {
@@ -568,4 +1132,290 @@ APR_DECLARE(int) apr_hash_do(apr_hash_do_callback_fn_t *comp,
     return dorv;
 }
 
+#if APR_HAS_THREADS
+
+/* The buckets (or slots) are split in parts, claimed in turn by the
+ * caller and the tasks until none is left or a callback stops the scan.
+ */
+typedef struct hash_do_parallel_t {
+    apr_hash_do_callback_fn_t *comp;
+    void *rec;
+    const apr_hash_t *ht;
+    unsigned int step;
+    apr_uint32_t nparts;
+    volatile apr_uint32_t next;
+    volatile apr_uint32_t stop;
+} hash_do_parallel_t;
+
+static void hash_do_parts(hash_do_parallel_t *hdp)
+{
+    const apr_hash_t *ht = hdp->ht;
+    apr_uint32_t part;
+
+    while (!apr_atomic_read32(&hdp->stop)
+           && (part = apr_atomic_inc32(&hdp->next)) < hdp->nparts) {
+        unsigned int i = part * hdp->step, end = i + hdp->step;
+        unsigned int n = ht->ctrl ? ht->max + 1 : hash_buckets(ht);
+
+        if (end > n || end < i) {
+            end = n;
+        }
+        for (; i < end; i++) {
+            if (ht->ctrl) {
+                const apr_hash_slot_t *slot = &ht->slots[i];
+
+                if (FLAT_FULL(ht->ctrl[i])
+                        && !hdp->comp(hdp->rec, slot->key, slot->klen,
+                                      slot->val)) {
+                    apr_atomic_set32(&hdp->stop, 1);
+                    return;
+                }
+            }
+            else {
+                const apr_hash_entry_t *e;
+
+                for (e = hash_bucket(ht, i); e; e = e->next) {
+                    if (!hdp->comp(hdp->rec, e->key, e->klen, e->val)) {
+                        apr_atomic_set32(&hdp->stop, 1);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void * APR_THREAD_FUNC hash_do_task(apr_thread_t *thd, void *data)
+{
+    hash_do_parts(data);
+    return NULL;
+}
+
+APR_DECLARE(int) apr_hash_do_parallel(apr_hash_do_callback_fn_t *comp,
+                                      void *rec, const apr_hash_t *ht,
+                                      struct apr_thread_pool *tp,
+                                      unsigned int nparts)
+{
+    hash_do_parallel_t hdp;
+    unsigned int nbuckets, ntasks, i;
+
+    if (!tp) {
+        return apr_hash_do(comp, rec, ht);
+    }
+
+    nbuckets = ht->ctrl ? ht->max + 1 : hash_buckets(ht);
+    ntasks = (unsigned int)apr_thread_pool_thread_max_get(tp);
+    if (!nparts) {
+        nparts = ntasks * 4;
+    }
+    if (nparts < 1) {
+        nparts = 1;
+    }
+    if (nparts > nbuckets) {
+        nparts = nbuckets;
+    }
+
+    hdp.comp = comp;
+    hdp.rec = rec;
+    hdp.ht = ht;
+    hdp.step = (nbuckets + nparts - 1) / nparts;
+    hdp.nparts = (nbuckets + hdp.step - 1) / hdp.step;
+    hdp.next = 0;
+    hdp.stop = 0;
+
+    /* The caller takes its share, so the scan completes even if no
+     * thread of the pool is available (or it is one of them).
+     */
+    if (ntasks > hdp.nparts - 1) {
+        ntasks = hdp.nparts - 1;
+    }
+    for (i = 0; i < ntasks; i++) {
+        if (apr_thread_pool_push(tp, hash_do_task, &hdp,
+                                 APR_THREAD_TASK_PRIORITY_HIGHEST,
+                                 &hdp) != APR_SUCCESS) {
+            break;
+        }
+    }
+    hash_do_parts(&hdp);
+
+    /* Drop the tasks not started yet and wait for the running ones */
+    if (i) {
+        apr_thread_pool_tasks_cancel(tp, &hdp);
+    }
+
+    return !hdp.stop;
+}
+
+#endif /* APR_HAS_THREADS */
+
+/*
+ * Hash tables keyed by integers or pointers.
+ *
+ * They are generated from one template: the keys are stored inline in
+ * an array of slots probed linearly from the hash (the fmix64 finalizer
+ * of MurmurHash3, which mixes all the bits of the key), a NULL value
+ * marking an empty slot.  A deleted entry is filled by the next ones of
+ * its run which can move back (backward shift), so there are no
+ * tombstones and a lookup stops at the first empty slot.
+ */
+
+#define TYPED_LIMIT(max) (((max) + 1) / 4 * 3)
+
+static APR_INLINE unsigned int typed_fmix64(apr_uint64_t k)
+{
+    k ^= k >> 33;
+    k *= APR_UINT64_C(0xFF51AFD7ED558CCD);
+    k ^= k >> 33;
+    k *= APR_UINT64_C(0xC4CEB9FE1A85EC53);
+    k ^= k >> 33;
+    return (unsigned int)k;
+}
+
+#define TYPED_HASH_u64(key) typed_fmix64(key)
+#define TYPED_HASH_ptr(key) typed_fmix64((apr_uintptr_t)(key))
+
+#define HASH_TYPED_IMPLEMENT(T, key_t)                                      \
+                                                                            \
+typedef struct hash_##T##_slot_t {                                          \
+    key_t key;                                                              \
+    const void *val;                                                        \
+} hash_##T##_slot_t;                                                        \
+                                                                            \
+struct apr_hash_##T##_t {                                                   \
+    apr_pool_t *pool;                                                       \
+    hash_##T##_slot_t *slots;                                               \
+    unsigned int max;                                                       \
+    unsigned int count;                                                     \
+};                                                                          \
+                                                                            \
+APR_DECLARE(apr_hash_##T##_t *) apr_hash_make_##T(apr_pool_t *pool)         \
+{                                                                           \
+    apr_hash_##T##_t *ht = apr_palloc(pool, sizeof(*ht));                   \
+                                                                            \
+    ht->pool = pool;                                                        \
+    ht->max = INITIAL_MAX;                                                  \
+    ht->count = 0;                                                          \
+    ht->slots = apr_pcalloc(pool, (ht->max + 1) * sizeof(*ht->slots));      \
+    return ht;                                                              \
+}                                                                           \
+                                                                            \
+APR_DECLARE(apr_hash_##T##_t *) apr_hash_##T##_copy(apr_pool_t *pool,       \
+                                          const apr_hash_##T##_t *orig)     \
+{                                                                           \
+    apr_hash_##T##_t *ht = apr_palloc(pool, sizeof(*ht));                   \
+                                                                            \
+    *ht = *orig;                                                            \
+    ht->pool = pool;                                                        \
+    ht->slots = apr_palloc(pool, (ht->max + 1) * sizeof(*ht->slots));       \
+    memcpy(ht->slots, orig->slots, (ht->max + 1) * sizeof(*ht->slots));     \
+    return ht;                                                              \
+}                                                                           \
+                                                                            \
+/* The slot of the key, or the empty one ending its run */                  \
+static APR_INLINE hash_##T##_slot_t *hash_##T##_find(                       \
+                                          const apr_hash_##T##_t *ht,       \
+                                          key_t key)                        \
+{                                                                           \
+    unsigned int i = TYPED_HASH_##T(key) & ht->max;                         \
+                                                                            \
+    while (ht->slots[i].val && ht->slots[i].key != key) {                   \
+        i = (i + 1) & ht->max;                                              \
+    }                                                                       \
+    return &ht->slots[i];                                                   \
+}                                                                           \
+                                                                            \
+static void hash_##T##_expand(apr_hash_##T##_t *ht)                         \
+{                                                                           \
+    hash_##T##_slot_t *old = ht->slots;                                     \
+    unsigned int i, old_max = ht->max;                                      \
+                                                                            \
+    ht->max = old_max * 2 + 1;                                              \
+    ht->slots = apr_pcalloc(ht->pool, (ht->max + 1) * sizeof(*ht->slots));  \
+    for (i = 0; i <= old_max; i++) {                                        \
+        if (old[i].val) {                                                   \
+            *hash_##T##_find(ht, old[i].key) = old[i];                      \
+        }                                                                   \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static void hash_##T##_delete(apr_hash_##T##_t *ht, unsigned int i)         \
+{                                                                           \
+    unsigned int j = i, k;                                                  \
+                                                                            \
+    for (;;) {                                                              \
+        j = (j + 1) & ht->max;                                              \
+        if (!ht->slots[j].val) {                                            \
+            break;                                                          \
+        }                                                                   \
+        /* the entry at j moves back unless its home is in (i, j] */        \
+        k = TYPED_HASH_##T(ht->slots[j].key) & ht->max;                     \
+        if (((j - k) & ht->max) >= ((j - i) & ht->max)) {                   \
+            ht->slots[i] = ht->slots[j];                                    \
+            i = j;                                                          \
+        }                                                                   \
+    }                                                                       \
+    ht->slots[i].val = NULL;                                                \
+    ht->count--;                                                            \
+}                                                                           \
+                                                                            \
+APR_DECLARE(void) apr_hash_##T##_set(apr_hash_##T##_t *ht, key_t key,       \
+                                     const void *val)                       \
+{                                                                           \
+    hash_##T##_slot_t *slot = hash_##T##_find(ht, key);                     \
+                                                                            \
+    if (slot->val) {                                                        \
+        if (val) {                                                          \
+            slot->val = val;                                                \
+        }                                                                   \
+        else {                                                              \
+            hash_##T##_delete(ht, (unsigned int)(slot - ht->slots));        \
+        }                                                                   \
+        return;                                                             \
+    }                                                                       \
+    if (!val) {                                                             \
+        return;                                                             \
+    }                                                                       \
+    if (ht->count >= TYPED_LIMIT(ht->max)) {                                \
+        hash_##T##_expand(ht);                                              \
+        slot = hash_##T##_find(ht, key);                                    \
+    }                                                                       \
+    slot->key = key;                                                        \
+    slot->val = val;                                                        \
+    ht->count++;                                                            \
+}                                                                           \
+                                                                            \
+APR_DECLARE(void *) apr_hash_##T##_get(const apr_hash_##T##_t *ht,          \
+                                       key_t key)                           \
+{                                                                           \
+    return (void *)hash_##T##_find(ht, key)->val;                           \
+}                                                                           \
+                                                                            \
+APR_DECLARE(unsigned int) apr_hash_##T##_count(const apr_hash_##T##_t *ht)  \
+{                                                                           \
+    return ht->count;                                                       \
+}                                                                           \
+                                                                            \
+APR_DECLARE(void) apr_hash_##T##_clear(apr_hash_##T##_t *ht)                \
+{                                                                           \
+    memset(ht->slots, 0, (ht->max + 1) * sizeof(*ht->slots));               \
+    ht->count = 0;                                                          \
+}                                                                           \
+                                                                            \
+APR_DECLARE(int) apr_hash_##T##_do(apr_hash_##T##_do_callback_fn_t *comp,   \
+                                   void *rec, const apr_hash_##T##_t *ht)   \
+{                                                                           \
+    unsigned int i;                                                         \
+                                                                            \
+    for (i = 0; i <= ht->max; i++) {                                        \
+        if (ht->slots[i].val                                                \
+                && !comp(rec, ht->slots[i].key, ht->slots[i].val)) {        \
+            return FALSE;                                                   \
+        }                                                                   \
+    }                                                                       \
+    return TRUE;                                                            \
+}
+
+HASH_TYPED_IMPLEMENT(u64, apr_uint64_t)
+HASH_TYPED_IMPLEMENT(ptr, const void *)
+
 APR_POOL_IMPLEMENT_ACCESSOR(hash)
@@ -0,0 +1,275 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_heap.h"
+#include "apr_tables.h"
+
+/* The elements are kept in an array where the children of the node at
+ * index i are at indexes i * arity + 1 to i * arity + arity.  An element
+ * pushed with a handle has its index tracked in there, the handles of
+ * the elements gone being reused.
+ */
+#define HEAP_MAX_ARITY 16
+
+typedef struct heap_entry_t {
+    void *data;
+    apr_heap_handle_t *handle;
+} heap_entry_t;
+
+struct apr_heap_handle_t {
+    apr_size_t index;
+    apr_heap_handle_t *next;
+};
+
+struct apr_heap_t {
+    apr_pool_t *pool;
+    apr_array_header_t *entries;
+    apr_heap_compare_fn *compare;
+    apr_size_t arity;
+    apr_heap_handle_t *free_handles;
+};
+
+#define HEAP_ENTRIES(heap) ((heap_entry_t *)(heap)->entries->elts)
+
+static APR_INLINE void heap_place(heap_entry_t *entries, apr_size_t i,
+                                  heap_entry_t e)
+{
+    entries[i] = e;
+    if (e.handle) {
+        e.handle->index = i;
+    }
+}
+
+static APR_INLINE void heap_handle_release(apr_heap_t *heap,
+                                           apr_heap_handle_t *handle)
+{
+    if (handle) {
+        handle->next = heap->free_handles;
+        heap->free_handles = handle;
+    }
+}
+
+/* Move the element at i up to its place, returning it */
+static apr_size_t heap_sift_up(apr_heap_t *heap, apr_size_t i)
+{
+    heap_entry_t *entries = HEAP_ENTRIES(heap);
+    heap_entry_t e = entries[i];
+
+    while (i > 0) {
+        apr_size_t parent = (i - 1) / heap->arity;
+
+        if (heap->compare(e.data, entries[parent].data) >= 0) {
+            break;
+        }
+        heap_place(entries, i, entries[parent]);
+        i = parent;
+    }
+    heap_place(entries, i, e);
+    return i;
+}
+
+/* Move the element at i down to its place */
+static void heap_sift_down(apr_heap_t *heap, apr_size_t i)
+{
+    heap_entry_t *entries = HEAP_ENTRIES(heap);
+    apr_size_t n = heap->entries->nelts;
+    heap_entry_t e = entries[i];
+
+    for (;;) {
+        apr_size_t child = i * heap->arity + 1, last, first, c;
+
+        if (child >= n) {
+            break;
+        }
+        last = child + heap->arity;
+        if (last > n) {
+            last = n;
+        }
+        for (first = child, c = child + 1; c < last; c++) {
+            if (heap->compare(entries[c].data, entries[first].data) < 0) {
+                first = c;
+            }
+        }
+        if (heap->compare(entries[first].data, e.data) >= 0) {
+            break;
+        }
+        heap_place(entries, i, entries[first]);
+        i = first;
+    }
+    heap_place(entries, i, e);
+}
+
+/* Fill the hole left at the root by the first element with the last one,
+ * which nearly always belongs to the bottom: the hole goes down with the
+ * first child of each level to a leaf, and the last element up from there
+ * (Floyd's variant), saving a comparison per level.
+ */
+static void heap_sift_root(apr_heap_t *heap)
+{
+    heap_entry_t *entries = HEAP_ENTRIES(heap);
+    apr_size_t n = heap->entries->nelts, i = 0;
+
+    for (;;) {
+        apr_size_t child = i * heap->arity + 1, last, first, c;
+
+        if (child >= n) {
+            break;
+        }
+        last = child + heap->arity;
+        if (last > n) {
+            last = n;
+        }
+        for (first = child, c = child + 1; c < last; c++) {
+            if (heap->compare(entries[c].data, entries[first].data) < 0) {
+                first = c;
+            }
+        }
+        heap_place(entries, i, entries[first]);
+        i = first;
+    }
+    heap_place(entries, i, entries[n]);
+    heap_sift_up(heap, i);
+}
+
+static void heap_fix(apr_heap_t *heap, apr_size_t i)
+{
+    if (heap_sift_up(heap, i) == i) {
+        heap_sift_down(heap, i);
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_heap_create(apr_heap_t **heap,
+                                          unsigned int arity, int nelts,
+                                          apr_heap_compare_fn *compare,
+                                          apr_uint32_t flags,
+                                          apr_pool_t *p)
+{
+    apr_heap_t *new_heap;
+
+    if (!arity) {
+        arity = APR_HEAP_ARITY;
+    }
+    if (arity < 2 || arity > HEAP_MAX_ARITY) {
+        return APR_EINVAL;
+    }
+
+    new_heap = apr_pcalloc(p, sizeof(apr_heap_t));
+    new_heap->pool = p;
+    new_heap->entries = apr_array_make_ex(p, nelts, sizeof(heap_entry_t),
+                                          (flags & APR_HEAP_ALLOCATOR)
+                                          ? APR_ARRAY_ALLOCATOR : 0);
+    if (!new_heap->entries) {
+        return APR_ENOMEM;
+    }
+    new_heap->compare = compare;
+    new_heap->arity = arity;
+
+    *heap = new_heap;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_heap_push(apr_heap_t *heap, void *data,
+                                apr_heap_handle_t **handle)
+{
+    heap_entry_t *e = apr_array_push(heap->entries);
+
+    e->data = data;
+    e->handle = NULL;
+    if (handle) {
+        e->handle = heap->free_handles;
+        if (e->handle) {
+            heap->free_handles = e->handle->next;
+        }
+        else {
+            e->handle = apr_palloc(heap->pool, sizeof(apr_heap_handle_t));
+        }
+        *handle = e->handle;
+    }
+    heap_sift_up(heap, heap->entries->nelts - 1);
+}
+
+APR_DECLARE(void *) apr_heap_peek(const apr_heap_t *heap)
+{
+    if (!heap->entries->nelts) {
+        return NULL;
+    }
+    return HEAP_ENTRIES(heap)[0].data;
+}
+
+APR_DECLARE(void *) apr_heap_pop(apr_heap_t *heap)
+{
+    heap_entry_t *entries = HEAP_ENTRIES(heap);
+    apr_size_t n = heap->entries->nelts;
+    void *data;
+
+    if (!n) {
+        return NULL;
+    }
+    data = entries[0].data;
+    heap_handle_release(heap, entries[0].handle);
+
+    heap->entries->nelts = (int)--n;
+    if (n) {
+        heap_sift_root(heap);
+    }
+    return data;
+}
+
+APR_DECLARE(void *) apr_heap_remove(apr_heap_t *heap,
+                                    apr_heap_handle_t *handle)
+{
+    heap_entry_t *entries = HEAP_ENTRIES(heap);
+    apr_size_t i = handle->index, n = heap->entries->nelts;
+    void *data = entries[i].data;
+
+    heap_handle_release(heap, handle);
+
+    heap->entries->nelts = (int)--n;
+    if (i < n) {
+        heap_place(entries, i, entries[n]);
+        heap_fix(heap, i);
+    }
+    return data;
+}
+
+APR_DECLARE(void) apr_heap_update(apr_heap_t *heap,
+                                  apr_heap_handle_t *handle)
+{
+    heap_fix(heap, handle->index);
+}
+
+APR_DECLARE(void *) apr_heap_handle_data(const apr_heap_t *heap,
+                                         const apr_heap_handle_t *handle)
+{
+    return HEAP_ENTRIES(heap)[handle->index].data;
+}
+
+APR_DECLARE(apr_size_t) apr_heap_size(const apr_heap_t *heap)
+{
+    return heap->entries->nelts;
+}
+
+APR_DECLARE(void) apr_heap_clear(apr_heap_t *heap)
+{
+    heap_entry_t *entries = HEAP_ENTRIES(heap);
+    int i;
+
+    for (i = 0; i < heap->entries->nelts; i++) {
+        heap_handle_release(heap, entries[i].handle);
+    }
+    heap->entries->nelts = 0;
+}
@@ -24,6 +24,10 @@
  */
 
 #include "apr_skiplist.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+
+typedef struct skiplist_cs skiplist_cs;
 
 typedef struct {
     apr_skiplistnode **data;
@@ -31,6 +35,11 @@ typedef struct {
     apr_pool_t *p;
 } apr_skiplist_q; 
 
+/* The towers (the nodes of an element at all its levels) are allocated
+ * and recycled as a whole, by height up to this one.
+ */
+#define SKIPLIST_TOWERS_MAX 16
+
 struct apr_skiplist {
     apr_skiplist_compare compare;
     apr_skiplist_compare comparek;
@@ -46,7 +55,12 @@ struct apr_skiplist {
     apr_array_header_t *memlist;
     apr_skiplist_q nodes_q,
                    stack_q;
+    apr_skiplist_q towers_q[SKIPLIST_TOWERS_MAX];
+    size_t cached;      /* nodes in nodes_q and towers_q */
+    size_t cache_max;
+    apr_size_t mem;     /* memory usage */
     apr_pool_t *pool;
+    skiplist_cs *cs;    /* APR_SKIPLIST_CONCURRENT */
 };
 
 struct apr_skiplistnode {
@@ -71,58 +85,58 @@ static unsigned int get_b_rand(void)
     return randseq & (1U << ph++);
 }
 
+typedef struct chunk_t chunk_t;
+
 typedef struct {
     size_t size;
-    apr_array_header_t *list;
+    chunk_t *free;
 } memlist_t;
 
-typedef struct {
-    void *ptr;
-    char inuse;
-} chunk_t;
+/* Header of the pool chunks, for apr_skiplist_free() to find their memlist
+ * without a lookup, and the free ones to be linked.
+ */
+struct chunk_t {
+    memlist_t *memlist;
+    chunk_t *next;
+};
 
 APR_DECLARE(void *) apr_skiplist_alloc(apr_skiplist *sl, size_t size)
 {
     if (sl->pool) {
-        void *ptr;
-        int found_size = 0;
+        chunk_t *chunk;
+        memlist_t *memlist = NULL;
         int i;
-        chunk_t *newchunk;
-        memlist_t *memlist = (memlist_t *)sl->memlist->elts;
         for (i = 0; i < sl->memlist->nelts; i++) {
-            if (memlist->size == size) {
-                int j;
-                chunk_t *chunk = (chunk_t *)memlist->list->elts;
-                found_size = 1;
-                for (j = 0; j < memlist->list->nelts; j++) {
-                    if (!chunk->inuse) {
-                        chunk->inuse = 1;
-                        return chunk->ptr;
-                    }
-                    chunk++;
-                }
-                break; /* no free of this size; punt */
+            memlist_t *ml = APR_ARRAY_IDX(sl->memlist, i, memlist_t *);
+            if (ml->size == size) {
+                memlist = ml;
+                break;
             }
-            memlist++;
+        }
+        if (memlist && memlist->free) {
+            chunk = memlist->free;
+            memlist->free = chunk->next;
+            return chunk + 1;
         }
         /* no free chunks */
-        ptr = apr_palloc(sl->pool, size);
-        if (!ptr) {
-            return ptr;
+        chunk = apr_palloc(sl->pool, sizeof(chunk_t) + size);
+        if (!chunk) {
+            return NULL;
         }
         /*
          * is this a new sized chunk? If so, we need to create a new
-         * array of them. Otherwise, re-use what we already have.
+         * list of them. Otherwise, re-use what we already have.
          */
-        if (!found_size) {
-            memlist = apr_array_push(sl->memlist);
+        if (!memlist) {
+            memlist = apr_palloc(sl->pool, sizeof(memlist_t));
             memlist->size = size;
-            memlist->list = apr_array_make(sl->pool, 20, sizeof(chunk_t));
+            memlist->free = NULL;
+            APR_ARRAY_PUSH(sl->memlist, memlist_t *) = memlist;
         }
-        newchunk = apr_array_push(memlist->list);
-        newchunk->ptr = ptr;
-        newchunk->inuse = 1;
-        return ptr;
+        chunk->memlist = memlist;
+        chunk->next = NULL;
+        sl->mem += sizeof(chunk_t) + size;
+        return chunk + 1;
     }
     else {
         return malloc(size);
@@ -134,21 +148,10 @@ APR_DECLARE(void) apr_skiplist_free(apr_skiplist *sl, void *mem)
     if (!sl->pool) {
         free(mem);
     }
-    else {
-        int i;
-        memlist_t *memlist = (memlist_t *)sl->memlist->elts;
-        for (i = 0; i < sl->memlist->nelts; i++) {
-            int j;
-            chunk_t *chunk = (chunk_t *)memlist->list->elts;
-            for (j = 0; j < memlist->list->nelts; j++) {
-                if (chunk->ptr == mem) {
-                    chunk->inuse = 0;
-                    return;
-                }
-                chunk++;
-            }
-            memlist++;
-        }
+    else if (mem) {
+        chunk_t *chunk = (chunk_t *)mem - 1;
+        chunk->next = chunk->memlist->free;
+        chunk->memlist->free = chunk;
     }
 }
 
@@ -186,32 +189,91 @@ static APR_INLINE void skiplist_qclear(apr_skiplist_q *q)
     q->pos = 0;
 }
 
+/* Allocate the nodes of a tower (bottom first), or a single node */
+static apr_skiplistnode *skiplist_new_tower(apr_skiplist *sl, int height)
+{
+    apr_skiplistnode *m = NULL;
+    if (height <= SKIPLIST_TOWERS_MAX) {
+        m = skiplist_qpop(&sl->towers_q[height - 1]);
+    }
+    if (m) {
+        sl->cached -= height;
+    }
+    else {
+        if (sl->pool) {
+            m = apr_palloc(sl->pool, height * sizeof *m);
+        }
+        else {
+            m = malloc(height * sizeof *m);
+        }
+        if (m) {
+            sl->mem += height * sizeof *m;
+        }
+    }
+    return m;
+}
+
+static void skiplist_put_tower(apr_skiplist *sl, apr_skiplistnode *m,
+                               int height)
+{
+    if (height > SKIPLIST_TOWERS_MAX
+            || (sl->cache_max && sl->cached + height > sl->cache_max)
+            || skiplist_qpush(&sl->towers_q[height - 1], m)) {
+        /* Not recycled, pool memory is left to the pool */
+        if (!sl->pool) {
+            free(m);
+            sl->mem -= height * sizeof *m;
+        }
+        return;
+    }
+    sl->cached += height;
+}
+
+/* The single nodes are for the heads of the levels */
 static apr_skiplistnode *skiplist_new_node(apr_skiplist *sl)
 {
     apr_skiplistnode *m = skiplist_qpop(&sl->nodes_q);
-    if (!m) {
+    if (m) {
+        sl->cached--;
+    }
+    else {
         if (sl->pool) {
             m = apr_palloc(sl->pool, sizeof *m);
         }
         else {
             m = malloc(sizeof *m);
         }
+        if (m) {
+            sl->mem += sizeof *m;
+        }
     }
     return m;
 }
 
-static apr_status_t skiplist_put_node(apr_skiplist *sl, apr_skiplistnode *m)
+static void skiplist_put_node(apr_skiplist *sl, apr_skiplistnode *m)
 {
-    return skiplist_qpush(&sl->nodes_q, m);
+    if ((sl->cache_max && sl->cached >= sl->cache_max)
+            || skiplist_qpush(&sl->nodes_q, m)) {
+        if (!sl->pool) {
+            free(m);
+            sl->mem -= sizeof *m;
+        }
+        return;
+    }
+    sl->cached++;
 }
 
 static apr_status_t skiplisti_init(apr_skiplist **s, apr_pool_t *p)
 {
     apr_skiplist *sl;
     if (p) {
+        int i;
         sl = apr_pcalloc(p, sizeof(apr_skiplist));
-        sl->memlist = apr_array_make(p, 20, sizeof(memlist_t));
+        sl->memlist = apr_array_make(p, 20, sizeof(memlist_t *));
         sl->pool = sl->nodes_q.p = sl->stack_q.p = p;
+        for (i = 0; i < SKIPLIST_TOWERS_MAX; i++) {
+            sl->towers_q[i].p = p;
+        }
     }
     else {
         sl = calloc(1, sizeof(apr_skiplist));
@@ -223,6 +285,544 @@ static apr_status_t skiplisti_init(apr_skiplist **s, apr_pool_t *p)
     return APR_SUCCESS;
 }
 
+/*
+ * Concurrent (lock-free) skip list, see APR_SKIPLIST_CONCURRENT.
+ *
+ * Each node has an array of "next" pointers (one per level), whose low bit
+ * marks (logically deletes) the node at that level. Inserting links the
+ * node at level 0 first (which makes it part of the list) and then at the
+ * upper levels, removing marks the upper levels first and then level 0
+ * (whoever succeeds in marking level 0 owns the removal). Marked nodes are
+ * unlinked ("snipped") by any operation walking through them.
+ *
+ * Since a removed node may still be accessed by concurrent operations, it
+ * is reclaimed with an epoch based scheme: each operation runs in the
+ * global epoch it entered ("active" counters), the nodes are retired in
+ * the ("limbo") list of their remover's epoch, and those lists are freed
+ * when the global epoch advances three times, which requires that no
+ * operation remains in the previous epoch each time. So an operation
+ * runs in the current global epoch or the previous one only, and once
+ * retired a node can't be reached by the ones possibly still running
+ * three epochs later.
+ *
+ * The nodes are always malloc()ed here (pools aren't thread-safe), the
+ * removed elements' freefunc is called when their node is reclaimed.
+ */
+
+#define CS_MAX_HEIGHT 32
+
+#define CS_MARKED(n) ((apr_uintptr_t)(n) & 1)
+#define CS_MARK(n)   ((cs_node *)((apr_uintptr_t)(n) | 1))
+#define CS_PTR(n)    ((cs_node *)((apr_uintptr_t)(n) & ~(apr_uintptr_t)1))
+
+/* Atomic compare-and-swap of a next pointer, returns the previous value */
+#define CS_CAS(ptr, with, cmp) \
+    ((cs_node *)apr_atomic_casptr((void *volatile *)(ptr), (with), (cmp)))
+
+typedef struct cs_node cs_node;
+struct cs_node {
+    void *data;                 /* first, see apr_skiplist_element() */
+    cs_node *retired;           /* link in the limbo list */
+    apr_skiplist_compare comp;  /* the one used for insertion */
+    apr_skiplist_freefunc myfree;
+    volatile apr_uint32_t pending;
+    int height;
+    cs_node *volatile next[1];  /* really [height] */
+};
+
+struct skiplist_cs {
+    volatile apr_uint32_t epoch;
+    volatile apr_uint32_t active[4];
+    cs_node *volatile limbo[4];
+    volatile apr_uint32_t size;
+    volatile apr_uint32_t height;
+    volatile apr_uint32_t seed;
+    volatile apr_uint64_t mem;
+    cs_node *head;
+};
+
+#define CS_NODE_SIZE(height) \
+    (APR_OFFSETOF(cs_node, next) + (height) * sizeof(cs_node *))
+
+static cs_node *cs_new_node(skiplist_cs *cs, int height)
+{
+    cs_node *n = malloc(CS_NODE_SIZE(height));
+    if (n) {
+        apr_atomic_add64(&cs->mem, CS_NODE_SIZE(height));
+        n->data = NULL;
+        n->retired = NULL;
+        n->myfree = NULL;
+        n->pending = 2; /* inserter and remover */
+        n->height = height;
+    }
+    return n;
+}
+
+static void cs_free_node(skiplist_cs *cs, cs_node *n)
+{
+    if (n->myfree && n->data) {
+        n->myfree(n->data);
+    }
+    apr_atomic_sub64(&cs->mem, CS_NODE_SIZE(n->height));
+    free(n);
+}
+
+static apr_uint32_t cs_enter(skiplist_cs *cs)
+{
+    for (;;) {
+        apr_uint32_t e = apr_atomic_read32(&cs->epoch);
+        apr_atomic_inc32(&cs->active[e % 4]);
+        if (apr_atomic_read32(&cs->epoch) == e) {
+            return e;
+        }
+        /* raced with an epoch change, don't stay in the old one */
+        apr_atomic_dec32(&cs->active[e % 4]);
+    }
+}
+
+static APR_INLINE void cs_leave(skiplist_cs *cs, apr_uint32_t e)
+{
+    apr_atomic_dec32(&cs->active[e % 4]);
+}
+
+/* Try to advance the global epoch from e (the caller's, which must still be
+ * entered to prevent a further advance while reclaiming), and reclaim the
+ * nodes retired two epochs before (the operations still running are
+ * either in epoch e or e + 1 now).
+ */
+static void cs_advance(skiplist_cs *cs, apr_uint32_t e)
+{
+    cs_node *n, *next;
+
+    if (apr_atomic_read32(&cs->epoch) != e
+            || apr_atomic_read32(&cs->active[(e - 1) % 4]) != 0
+            || apr_atomic_cas32(&cs->epoch, e + 1, e) != e) {
+        return;
+    }
+    n = apr_atomic_xchgptr((void *volatile *)&cs->limbo[(e - 2) % 4], NULL);
+    while (n) {
+        next = n->retired;
+        cs_free_node(cs, n);
+        n = next;
+    }
+}
+
+static void cs_retire(skiplist_cs *cs, cs_node *n, apr_uint32_t e)
+{
+    cs_node *head;
+
+    do {
+        head = cs->limbo[e % 4];
+        n->retired = head;
+    } while (CS_CAS(&cs->limbo[e % 4], n, head) != head);
+
+    cs_advance(cs, e);
+}
+
+static int cs_random_height(skiplist_cs *cs, int max)
+{
+    apr_uint32_t r = apr_atomic_add32(&cs->seed, 0x9e3779b9U);
+    int h = 1;
+
+    r ^= r >> 16;
+    r *= 0x85ebca6bU;
+    r ^= r >> 13;
+    r *= 0xc2b2ae35U;
+    r ^= r >> 16;
+    while ((r & 1) && h < max) {
+        r >>= 1;
+        h++;
+    }
+    return h;
+}
+
+/* Walk the list for data, filling in preds/succs (if not NULL) with the
+ * nodes between which data belongs at each level, and unlinking the marked
+ * nodes on the way. With after, the position is after the elements equal
+ * to data (thus the first greater one), otherwise before them.
+ */
+static cs_node *cs_search(skiplist_cs *cs, void *data,
+                          apr_skiplist_compare comp, int after,
+                          cs_node **preds, cs_node **succs)
+{
+    cs_node *pred, *curr, *succ;
+    int l;
+
+retry:
+    pred = cs->head;
+    curr = NULL;
+    for (l = (int)apr_atomic_read32(&cs->height) - 1; l >= 0; l--) {
+        curr = CS_PTR(pred->next[l]);
+        while (curr) {
+            succ = curr->next[l];
+            if (CS_MARKED(succ)) {
+                if (CS_CAS(&pred->next[l], CS_PTR(succ), curr) != curr) {
+                    goto retry;
+                }
+                curr = CS_PTR(succ);
+                continue;
+            }
+            if (after ? comp(data, curr->data) < 0
+                      : comp(data, curr->data) <= 0) {
+                break;
+            }
+            pred = curr;
+            curr = succ;
+        }
+        if (preds) {
+            preds[l] = pred;
+            succs[l] = curr;
+        }
+    }
+    return curr;
+}
+
+/* Unlink node (marked at all levels) from every level it's linked at */
+static void cs_unlink(skiplist_cs *cs, cs_node *node)
+{
+    apr_skiplist_compare comp = node->comp;
+    cs_node *pred, *curr, *succ, *p;
+    int l;
+
+retry:
+    pred = cs->head;
+    for (l = (int)apr_atomic_read32(&cs->height) - 1; l >= 0; l--) {
+        curr = CS_PTR(pred->next[l]);
+        while (curr) {
+            succ = curr->next[l];
+            if (CS_MARKED(succ)) {
+                if (CS_CAS(&pred->next[l], CS_PTR(succ), curr) != curr) {
+                    goto retry;
+                }
+                curr = CS_PTR(succ);
+                continue;
+            }
+            if (comp(node->data, curr->data) <= 0) {
+                break;
+            }
+            pred = curr;
+            curr = succ;
+        }
+        if (l >= node->height) {
+            continue;
+        }
+        /* The node may be anywhere among its duplicates at this level,
+         * walk them (unlinking marked ones) without moving pred which is
+         * where the lower level starts from.
+         */
+        p = pred;
+        while (curr) {
+            succ = curr->next[l];
+            if (CS_MARKED(succ)) {
+                if (CS_CAS(&p->next[l], CS_PTR(succ), curr) != curr) {
+                    goto retry;
+                }
+                if (curr == node) {
+                    break;
+                }
+                curr = CS_PTR(succ);
+                continue;
+            }
+            if (comp(node->data, curr->data) != 0) {
+                break;
+            }
+            p = curr;
+            curr = succ;
+        }
+    }
+}
+
+/* Release the inserter's or remover's hold on node, the last one makes
+ * sure it's unlinked and retires it.
+ */
+static void cs_release(apr_skiplist *sl, cs_node *node, apr_uint32_t e)
+{
+    if (apr_atomic_dec32(&node->pending) == 0) {
+        cs_unlink(sl->cs, node);
+        cs_retire(sl->cs, node, e);
+    }
+}
+
+/* Logically delete node, returns whether the caller owns its removal */
+static int cs_claim(cs_node *node)
+{
+    cs_node *succ;
+    int l;
+
+    for (l = node->height - 1; l > 0; l--) {
+        do {
+            succ = node->next[l];
+        } while (!CS_MARKED(succ)
+                 && CS_CAS(&node->next[l], CS_MARK(succ), succ) != succ);
+    }
+    for (;;) {
+        succ = node->next[0];
+        if (CS_MARKED(succ)) {
+            return 0;
+        }
+        if (CS_CAS(&node->next[0], CS_MARK(succ), succ) == succ) {
+            return 1;
+        }
+    }
+}
+
+static int cs_remove(apr_skiplist *sl, cs_node *node,
+                     apr_skiplist_freefunc myfree, apr_uint32_t e)
+{
+    if (!cs_claim(node)) {
+        return 0;
+    }
+    node->myfree = myfree;
+    apr_atomic_dec32(&sl->cs->size);
+    cs_release(sl, node, e);
+    return 1;
+}
+
+static cs_node *cs_insert(apr_skiplist *sl, void *data,
+                          apr_skiplist_compare comp, int add,
+                          apr_skiplist_freefunc myfree)
+{
+    skiplist_cs *cs = sl->cs;
+    cs_node *preds[CS_MAX_HEIGHT], *succs[CS_MAX_HEIGHT];
+    cs_node *node, *succ;
+    apr_uint32_t e, height;
+    int h, l;
+
+    h = cs_random_height(cs, (sl->preheight && sl->preheight < CS_MAX_HEIGHT)
+                             ? sl->preheight : CS_MAX_HEIGHT);
+    node = cs_new_node(cs, h);
+    if (!node) {
+        return NULL;
+    }
+    node->data = data;
+    node->comp = comp;
+
+    while ((height = apr_atomic_read32(&cs->height)) < (apr_uint32_t)h) {
+        apr_atomic_cas32(&cs->height, h, height);
+    }
+
+    e = cs_enter(cs);
+    apr_atomic_inc32(&cs->size);
+    for (;;) {
+        if (add <= 0) {
+            succ = cs_search(cs, data, comp, 0, preds, succs);
+            if (succ && comp(data, succ->data) == 0) {
+                if (!add) {
+                    /* Keep the existing element(s) */
+                    apr_atomic_dec32(&cs->size);
+                    cs_leave(cs, e);
+                    cs_free_node(cs, node);
+                    return NULL;
+                }
+                /* Remove the existing element(s) first */
+                cs_remove(sl, succ, myfree, e);
+                continue;
+            }
+        }
+        else {
+            cs_search(cs, data, comp, 1, preds, succs);
+        }
+        for (l = 0; l < h; l++) {
+            node->next[l] = succs[l];
+        }
+        if (CS_CAS(&preds[0]->next[0], node, succs[0]) == succs[0]) {
+            break;
+        }
+    }
+
+    /* Now that the node is in the list, link it at the upper levels unless
+     * it gets removed in the meantime.
+     */
+    for (l = 1; l < h; l++) {
+        for (;;) {
+            succ = node->next[l];
+            if (CS_MARKED(succ)) {
+                goto done;
+            }
+            if (succ != succs[l]
+                    && CS_CAS(&node->next[l], succs[l], succ) != succ) {
+                goto done;
+            }
+            if (CS_CAS(&preds[l]->next[l], node, succs[l]) == succs[l]) {
+                break;
+            }
+            cs_search(cs, data, comp, add > 0, preds, succs);
+            if (CS_MARKED(node->next[0])) {
+                goto done;
+            }
+        }
+    }
+
+done:
+    cs_release(sl, node, e);
+    cs_leave(cs, e);
+    return node;
+}
+
+static void *cs_find(apr_skiplist *sl, void *data, apr_skiplistnode **iter,
+                     apr_skiplist_compare comp, int last)
+{
+    skiplist_cs *cs = sl->cs;
+    cs_node *curr, *found = NULL;
+    apr_uint32_t e;
+
+    e = cs_enter(cs);
+    curr = cs_search(cs, data, comp, 0, NULL, NULL);
+    while (curr && comp(data, curr->data) == 0) {
+        if (!CS_MARKED(curr->next[0])) {
+            found = curr;
+            if (!last) {
+                break;
+            }
+        }
+        curr = CS_PTR(curr->next[0]);
+    }
+    cs_leave(cs, e);
+
+    if (iter) {
+        *iter = (apr_skiplistnode *)found;
+    }
+    return found ? found->data : NULL;
+}
+
+static int cs_remove_compare(apr_skiplist *sl, void *data,
+                             apr_skiplist_freefunc myfree,
+                             apr_skiplist_compare comp)
+{
+    skiplist_cs *cs = sl->cs;
+    cs_node *curr;
+    apr_uint32_t e;
+    int removed = 0;
+
+    e = cs_enter(cs);
+    curr = cs_search(cs, data, comp, 0, NULL, NULL);
+    while (curr && comp(data, curr->data) == 0) {
+        if (cs_remove(sl, curr, myfree, e)) {
+            removed = 1;
+            break;
+        }
+        curr = CS_PTR(curr->next[0]);
+    }
+    cs_leave(cs, e);
+
+    return removed ? (int)apr_atomic_read32(&cs->height) : 0;
+}
+
+static void *cs_pop(apr_skiplist *sl, apr_skiplist_freefunc myfree, int peek)
+{
+    skiplist_cs *cs = sl->cs;
+    cs_node *curr;
+    apr_uint32_t e;
+    void *data = NULL;
+
+    e = cs_enter(cs);
+    for (curr = CS_PTR(cs->head->next[0]); curr;
+         curr = CS_PTR(curr->next[0])) {
+        if (peek ? !CS_MARKED(curr->next[0])
+                 : cs_remove(sl, curr, myfree, e)) {
+            data = curr->data;
+            break;
+        }
+    }
+    cs_leave(cs, e);
+
+    return data;
+}
+
+static void cs_remove_all(apr_skiplist *sl, apr_skiplist_freefunc myfree)
+{
+    skiplist_cs *cs = sl->cs;
+    cs_node *n, *next;
+    int i;
+
+    for (n = CS_PTR(cs->head->next[0]); n; n = next) {
+        next = CS_PTR(n->next[0]);
+        if (CS_MARKED(n->next[0])) {
+            /* removed, freed from its limbo list below */
+            continue;
+        }
+        n->myfree = myfree;
+        cs_free_node(cs, n);
+    }
+    for (i = 0; i < 4; i++) {
+        for (n = cs->limbo[i]; n; n = next) {
+            next = n->retired;
+            cs_free_node(cs, n);
+        }
+        cs->limbo[i] = NULL;
+    }
+    memset((void *)cs->head->next, 0, CS_MAX_HEIGHT * sizeof(cs_node *));
+    cs->size = 0;
+    cs->height = 1;
+}
+
+static void cs_destroy(apr_skiplist *sl)
+{
+    free(sl->cs->head);
+    free(sl->cs);
+    sl->cs = NULL;
+}
+
+static apr_status_t skiplist_cs_cleanup(void *data)
+{
+    apr_skiplist *sl = data;
+
+    if (sl->cs) {
+        cs_remove_all(sl, NULL);
+        cs_destroy(sl);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_skiplist_init_ex(apr_skiplist **s,
+                                               apr_pool_t *p,
+                                               apr_uint32_t flags)
+{
+    apr_status_t rv;
+    apr_skiplist *sl;
+    skiplist_cs *cs;
+
+    if (flags & ~APR_SKIPLIST_CONCURRENT) {
+        *s = NULL;
+        return APR_EINVAL;
+    }
+    if (!(flags & APR_SKIPLIST_CONCURRENT)) {
+        return apr_skiplist_init(s, p);
+    }
+
+    rv = skiplisti_init(&sl, p);
+    if (rv != APR_SUCCESS) {
+        *s = NULL;
+        return rv;
+    }
+    cs = calloc(1, sizeof(*cs));
+    if (cs) {
+        cs->head = calloc(1, CS_NODE_SIZE(CS_MAX_HEIGHT));
+        if (!cs->head) {
+            free(cs);
+            cs = NULL;
+        }
+    }
+    if (!cs) {
+        if (!p) {
+            free(sl);
+        }
+        *s = NULL;
+        return APR_ENOMEM;
+    }
+    cs->head->height = CS_MAX_HEIGHT;
+    cs->height = 1;
+    cs->seed = (apr_uint32_t)(apr_uintptr_t)cs ^ (apr_uint32_t)rand();
+    sl->cs = cs;
+    if (p) {
+        apr_pool_cleanup_register(p, sl, skiplist_cs_cleanup,
+                                  apr_pool_cleanup_null);
+    }
+
+    *s = sl;
+    return APR_SUCCESS;
+}
+
 static int indexing_comp(void *a, void *b)
 {
     void *ac = (void *) (((apr_skiplist *) a)->compare);
@@ -259,7 +859,7 @@ APR_DECLARE(void) apr_skiplist_set_compare(apr_skiplist *sl,
                           apr_skiplist_compare comp,
                           apr_skiplist_compare compk)
 {
-    if (sl->compare && sl->comparek) {
+    if (sl->compare && sl->comparek && !sl->cs) {
         apr_skiplist_add_index(sl, comp, compk);
     }
     else {
@@ -275,6 +875,9 @@ APR_DECLARE(void) apr_skiplist_add_index(apr_skiplist *sl,
     apr_skiplistnode *m;
     apr_skiplist *ni;
     int icount = 0;
+    if (sl->cs) {
+        return;                 /* No index for concurrent skip lists */
+    }
     apr_skiplist_find(sl->index, (void *)comp, &m);
     if (m) {
         return;                 /* Index already there! */
@@ -358,6 +961,15 @@ static void *find_compare(apr_skiplist *sli, void *data,
         }
         return NULL;
     }
+    if (sli->cs) {
+        if (comp != sli->compare) {
+            if (iter) {
+                *iter = NULL;
+            }
+            return NULL;
+        }
+        return cs_find(sli, data, iter, sli->comparek, last);
+    }
     if (comp == sli->compare || !sli->index) {
         sl = sli;
     }
@@ -404,9 +1016,60 @@ APR_DECLARE(void *) apr_skiplist_last(apr_skiplist *sl, void *data,
 }
 
 
+static apr_skiplistnode *skiplisti_lower_bound(apr_skiplist *sl, void *data,
+                                               apr_skiplist_compare comp)
+{
+    apr_skiplistnode *m = sl->top;
+    if (!m) {
+        return NULL;
+    }
+    for (;;) {
+        while (m->next && comp(data, m->next->data) > 0) {
+            m = m->next;
+        }
+        if (!m->down) {
+            break;
+        }
+        m = m->down;
+    }
+    return m->next;
+}
+
+APR_DECLARE(void *) apr_skiplist_range_first(apr_skiplist *sl, void *lo,
+                                             void *hi,
+                                             apr_skiplistnode **iter)
+{
+    apr_skiplistnode *m;
+    if (sl->cs || !sl->comparek) {
+        m = NULL;
+    }
+    else if (lo) {
+        m = skiplisti_lower_bound(sl, lo, sl->comparek);
+    }
+    else {
+        m = apr_skiplist_getlist(sl);
+    }
+    if (m && hi && sl->comparek(hi, m->data) <= 0) {
+        m = NULL;
+    }
+    *iter = m;
+    return (m) ? m->data : NULL;
+}
+
+APR_DECLARE(void *) apr_skiplist_range_next(apr_skiplist *sl, void *hi,
+                                            apr_skiplistnode **iter)
+{
+    void *data = apr_skiplist_next(sl, iter);
+    if (data && hi && sl->comparek(hi, data) <= 0) {
+        *iter = NULL;
+        return NULL;
+    }
+    return data;
+}
+
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_getlist(apr_skiplist *sl)
 {
-    if (!sl->bottom) {
+    if (!sl->bottom || sl->cs) {
         return NULL;
     }
     return sl->bottom->next;
@@ -452,9 +1115,13 @@ static apr_skiplistnode *insert_compare(apr_skiplist *sl, void *data,
                                         apr_skiplist_compare comp, int add,
                                         apr_skiplist_freefunc myfree)
 {
-    apr_skiplistnode *m, *p, *tmp, *ret = NULL;
+    apr_skiplistnode *m, *p, *tmp, *tower, *ret = NULL;
     int ch, top_nh, nh = 1;
 
+    if (sl->cs) {
+        return (apr_skiplistnode *)cs_insert(sl, data, comp, add, myfree);
+    }
+
     ch = skiplist_height(sl);
     if (sl->preheight) {
         while (nh < sl->preheight && get_b_rand()) {
@@ -517,9 +1184,14 @@ static apr_skiplistnode *insert_compare(apr_skiplist *sl, void *data,
         ch--;
     }
     /* Pop the stack and insert nodes */
+    tower = skiplist_new_tower(sl, nh);
+    if (!tower) {
+        skiplist_qclear(&sl->stack_q);
+        return NULL;
+    }
     p = NULL;
     while ((m = skiplist_qpop(&sl->stack_q))) {
-        tmp = skiplist_new_node(sl);
+        tmp = tower++;
         tmp->next = m->next;
         if (m->next) {
             m->next->prev = tmp;
@@ -544,7 +1216,7 @@ static apr_skiplistnode *insert_compare(apr_skiplist *sl, void *data,
     /* Now we are sure the node is inserted, grow our tree to 'nh' tall */
     for (; sl->height < nh; sl->height++) {
         m = skiplist_new_node(sl);
-        tmp = skiplist_new_node(sl);
+        tmp = tower++;
         m->up = m->prev = m->nextindex = m->previndex = NULL;
         m->next = tmp;
         m->down = sl->top;
@@ -617,6 +1289,105 @@ APR_DECLARE(apr_skiplistnode *) apr_skiplist_add(apr_skiplist *sl, void *data)
     return apr_skiplist_add_compare(sl, data, sl->compare);
 }
 
+APR_DECLARE(apr_status_t) apr_skiplist_bulk_load_sorted(apr_skiplist *sl,
+                                                        void **elts,
+                                                        size_t nelts)
+{
+    apr_skiplistnode *last[sizeof(size_t) * 8 + 1];
+    apr_skiplistnode *m, *p;
+    size_t i;
+    int nh, h;
+
+    if (!sl->compare) {
+        return APR_EINVAL;
+    }
+    for (i = 1; i < nelts; i++) {
+        if (sl->compare(elts[i - 1], elts[i]) > 0) {
+            return APR_EINVAL;
+        }
+    }
+    if (!nelts) {
+        return APR_SUCCESS;
+    }
+
+    if (sl->cs || sl->size || (sl->index && sl->index->size)) {
+        /* Not a fresh list (or indexes to maintain), add one at a time */
+        for (i = 0; i < nelts; i++) {
+            if (!apr_skiplist_add(sl, elts[i])) {
+                return APR_ENOMEM;
+            }
+        }
+        return APR_SUCCESS;
+    }
+
+    /* The height of the perfect skip list for nelts (log2), or the
+     * preheight if smaller.
+     */
+    for (nh = 1; (nelts >> nh) != 0; nh++)
+        ;
+    if (sl->preheight && nh > sl->preheight) {
+        nh = sl->preheight;
+    }
+
+    /* The (empty) list may still have its top node, start over */
+    apr_skiplist_remove_all(sl, NULL);
+
+    /* The head of each level, from the bottom up */
+    p = NULL;
+    for (h = 0; h < nh; h++) {
+        m = skiplist_new_node(sl);
+        if (!m) {
+            return APR_ENOMEM;
+        }
+        m->data = NULL;
+        m->next = m->prev = m->up = NULL;
+        m->nextindex = m->previndex = NULL;
+        m->sl = sl;
+        m->down = p;
+        if (p) {
+            p->up = m;
+        }
+        else {
+            sl->bottom = sl->bottomend = m;
+        }
+        last[h] = p = m;
+    }
+    sl->top = sl->topend = p;
+    sl->height = nh;
+
+    /* The i-th (1-based) element has a tower of one plus the number of
+     * trailing zero bits in i, so the levels come out halved each time.
+     */
+    for (i = 1; i <= nelts; i++) {
+        apr_skiplistnode *tower;
+        int th = 1;
+        while (th < nh && !(i & ((size_t)1 << (th - 1)))) {
+            th++;
+        }
+        tower = skiplist_new_tower(sl, th);
+        if (!tower) {
+            return APR_ENOMEM;
+        }
+        p = NULL;
+        for (h = 0; h < th; h++) {
+            m = tower + h;
+            m->data = elts[i - 1];
+            m->next = m->up = NULL;
+            m->nextindex = m->previndex = NULL;
+            m->sl = sl;
+            m->prev = last[h];
+            last[h]->next = m;
+            m->down = p;
+            if (p) {
+                p->up = m;
+            }
+            last[h] = p = m;
+        }
+        sl->size++;
+    }
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_skiplistnode *) apr_skiplist_replace_compare(apr_skiplist *sl,
                                     void *data, apr_skiplist_freefunc myfree,
                                     apr_skiplist_compare comp)
@@ -656,6 +1427,7 @@ static int skiplisti_remove(apr_skiplist *sl, apr_skiplistnode *m,
                             apr_skiplist_freefunc myfree)
 {
     apr_skiplistnode *p;
+    int h = 0;
     if (!m) {
         return 0;
     }
@@ -677,8 +1449,10 @@ static int skiplisti_remove(apr_skiplist *sl, apr_skiplistnode *m,
         if (!m && myfree && p->data) {
             myfree(p->data);
         }
-        skiplist_put_node(sl, p);
+        h++;
     } while (m);
+    /* p is the bottom node, where the tower starts */
+    skiplist_put_tower(sl, p, h);
     sl->size--;
     while (sl->top && sl->top->next == NULL) {
         /* While the row is empty and we are not on the bottom row */
@@ -705,6 +1479,13 @@ APR_DECLARE(int) apr_skiplist_remove_node(apr_skiplist *sl,
     if (!m) {
         return 0;
     }
+    if (sl->cs) {
+        skiplist_cs *cs = sl->cs;
+        apr_uint32_t e = cs_enter(cs);
+        int removed = cs_remove(sl, (cs_node *)iter, myfree, e);
+        cs_leave(cs, e);
+        return removed ? (int)apr_atomic_read32(&cs->height) : 0;
+    }
     while (m->down) {
         m = m->down;
     }
@@ -723,6 +1504,12 @@ APR_DECLARE(int) apr_skiplist_remove_compare(apr_skiplist *sli,
     if (!comp) {
         return 0;
     }
+    if (sli->cs) {
+        if (comp != sli->comparek) {
+            return 0;
+        }
+        return cs_remove_compare(sli, data, myfree, comp);
+    }
     if (comp == sli->comparek || !sli->index) {
         sl = sli;
     }
@@ -756,12 +1543,15 @@ APR_DECLARE(void) apr_skiplist_remove_all(apr_skiplist *sl, apr_skiplist_freefun
      * making this call without memory leaks
      */
     apr_skiplistnode *m, *p, *u;
+    int h;
+    if (sl->cs) {
+        cs_remove_all(sl, myfree);
+        return;
+    }
     m = sl->bottom;
-    while (m) {
+    if (m) {
+        /* The heads */
         p = m->next;
-        if (myfree && p && p->data) {
-            myfree(p->data);
-        }
         do {
             u = m->up;
             skiplist_put_node(sl, m);
@@ -769,6 +1559,17 @@ APR_DECLARE(void) apr_skiplist_remove_all(apr_skiplist *sl, apr_skiplist_freefun
         } while (m);
         m = p;
     }
+    while (m) {
+        p = m->next;
+        if (myfree && m->data) {
+            myfree(m->data);
+        }
+        for (h = 0, u = m; u; u = u->up) {
+            h++;
+        }
+        skiplist_put_tower(sl, m, h);
+        m = p;
+    }
     sl->top = sl->bottom = NULL;
     sl->topend = sl->bottomend = NULL;
     sl->height = 0;
@@ -779,6 +1580,9 @@ APR_DECLARE(void *) apr_skiplist_pop(apr_skiplist *a, apr_skiplist_freefunc myfr
 {
     apr_skiplistnode *sln;
     void *data = NULL;
+    if (a->cs) {
+        return cs_pop(a, myfree, 0);
+    }
     sln = apr_skiplist_getlist(a);
     if (sln) {
         data = sln->data;
@@ -790,6 +1594,9 @@ APR_DECLARE(void *) apr_skiplist_pop(apr_skiplist *a, apr_skiplist_freefunc myfr
 APR_DECLARE(void *) apr_skiplist_peek(apr_skiplist *a)
 {
     apr_skiplistnode *sln;
+    if (a->cs) {
+        return cs_pop(a, NULL, 1);
+    }
     sln = apr_skiplist_getlist(a);
     if (sln) {
         return sln->data;
@@ -799,11 +1606,17 @@ APR_DECLARE(void *) apr_skiplist_peek(apr_skiplist *a)
 
 APR_DECLARE(size_t) apr_skiplist_size(const apr_skiplist *sl)
 {
+    if (sl->cs) {
+        return apr_atomic_read32(&sl->cs->size);
+    }
     return sl->size;
 }
 
 APR_DECLARE(int) apr_skiplist_height(const apr_skiplist *sl)
 {
+    if (sl->cs) {
+        return (int)apr_atomic_read32(&sl->cs->height);
+    }
     return skiplist_height(sl);
 }
 
@@ -817,6 +1630,71 @@ APR_DECLARE(void) apr_skiplist_set_preheight(apr_skiplist *sl, int to)
     sl->preheight = (to > 0) ? to : 0;
 }
 
+APR_DECLARE(void) apr_skiplist_set_cache_max(apr_skiplist *sl, size_t max)
+{
+    int i;
+
+    sl->cache_max = max;
+    if (!max || sl->cached <= max) {
+        return;
+    }
+
+    /* Trim the caches, from the biggest towers */
+    for (i = SKIPLIST_TOWERS_MAX - 1; i >= 0 && sl->cached > max; i--) {
+        apr_skiplist_q *q = &sl->towers_q[i];
+        while (q->pos && sl->cached > max) {
+            apr_skiplistnode *m = skiplist_qpop(q);
+            sl->cached -= i + 1;
+            if (!sl->pool) {
+                free(m);
+                sl->mem -= (i + 1) * sizeof *m;
+            }
+        }
+    }
+    while (sl->nodes_q.pos && sl->cached > max) {
+        apr_skiplistnode *m = skiplist_qpop(&sl->nodes_q);
+        sl->cached--;
+        if (!sl->pool) {
+            free(m);
+            sl->mem -= sizeof *m;
+        }
+    }
+}
+
+static apr_size_t skiplist_q_usage(const apr_skiplist_q *q)
+{
+    return q->size * sizeof(*q->data);
+}
+
+APR_DECLARE(apr_size_t) apr_skiplist_memory_usage(const apr_skiplist *sl)
+{
+    apr_size_t usage = sizeof(*sl) + sl->mem;
+    int i;
+
+    if (sl->cs) {
+        return usage + sizeof(skiplist_cs) + CS_NODE_SIZE(CS_MAX_HEIGHT)
+                     + (apr_size_t)apr_atomic_read64(&sl->cs->mem);
+    }
+
+    usage += skiplist_q_usage(&sl->nodes_q) + skiplist_q_usage(&sl->stack_q);
+    for (i = 0; i < SKIPLIST_TOWERS_MAX; i++) {
+        usage += skiplist_q_usage(&sl->towers_q[i]);
+    }
+    if (sl->memlist) {
+        usage += sl->memlist->nalloc * sizeof(memlist_t *)
+                 + sl->memlist->nelts * sizeof(memlist_t);
+    }
+    if (sl->index) {
+        apr_skiplistnode *m;
+        for (m = apr_skiplist_getlist(sl->index); m;
+             apr_skiplist_next(sl->index, &m)) {
+            usage += apr_skiplist_memory_usage(m->data);
+        }
+        usage += apr_skiplist_memory_usage(sl->index);
+    }
+    return usage;
+}
+
 static void skiplisti_destroy(void *vsl)
 {
     apr_skiplist_destroy(vsl, NULL);
@@ -824,13 +1702,30 @@ static void skiplisti_destroy(void *vsl)
 
 APR_DECLARE(void) apr_skiplist_destroy(apr_skiplist *sl, apr_skiplist_freefunc myfree)
 {
+    if (sl->cs) {
+        cs_remove_all(sl, myfree);
+        cs_destroy(sl);
+        if (sl->pool) {
+            apr_pool_cleanup_kill(sl->pool, sl, skiplist_cs_cleanup);
+        }
+        else {
+            free(sl);
+        }
+        return;
+    }
     while (apr_skiplist_pop(sl->index, skiplisti_destroy) != NULL)
         ;
     apr_skiplist_remove_all(sl, myfree);
     if (!sl->pool) {
+        int i;
         while (sl->nodes_q.pos)
             free(sl->nodes_q.data[--sl->nodes_q.pos]);
         free(sl->nodes_q.data);
+        for (i = 0; i < SKIPLIST_TOWERS_MAX; i++) {
+            while (sl->towers_q[i].pos)
+                free(sl->towers_q[i].data[--sl->towers_q[i].pos]);
+            free(sl->towers_q[i].data);
+        }
         free(sl->stack_q.data);
         free(sl);
     }
@@ -841,6 +1736,13 @@ APR_DECLARE(apr_skiplist *) apr_skiplist_merge(apr_skiplist *sl1, apr_skiplist *
     /* Check integrity! */
     apr_skiplist temp;
     struct apr_skiplistnode *b2;
+    if (sl1->cs || sl2->cs) {
+        void *data;
+        while ((data = apr_skiplist_pop(sl2, NULL)) != NULL) {
+            apr_skiplist_insert(sl1, data);
+        }
+        return sl1;
+    }
     if (sl1->bottomend == NULL || sl1->bottomend->prev == NULL) {
         apr_skiplist_remove_all(sl1, NULL);
         temp = *sl1;
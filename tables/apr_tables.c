@@ -25,9 +25,12 @@
 
 #include "apr_general.h"
 #include "apr_pools.h"
+#include "apr_allocator.h"
 #include "apr_tables.h"
 #include "apr_strings.h"
 #include "apr_lib.h"
+#include "apr_atomic.h"
+#include "apr_thread_pool.h"
 #if APR_HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -73,6 +76,69 @@ static void make_array_core(apr_array_header_t *res, apr_pool_t *p,
     res->elt_size = elt_size;
     res->nelts = 0;		/* No active elements yet... */
     res->nalloc = nelts;	/* ...but this many allocated */
+    res->node = NULL;
+}
+
+/* Size to grow the array to for holding (at least) nelts elements */
+static int array_next_size(const apr_array_header_t *arr, int nelts)
+{
+    int new_size = (arr->nalloc <= 0) ? 1 : arr->nalloc * 2;
+
+    while (new_size < nelts) {
+        new_size *= 2;
+    }
+    return new_size;
+}
+
+/* Reallocate the elements of the array for new_size elements, the ones
+ * of APR_ARRAY_ALLOCATOR arrays being given back to the allocator.
+ */
+static void array_realloc(apr_array_header_t *arr, int new_size, int clear)
+{
+    apr_size_t elt_size = arr->elt_size;
+    int ncopy = (arr->nalloc < new_size) ? arr->nalloc : new_size;
+    char *new_data;
+
+    if (arr->node) {
+        apr_allocator_t *allocator = apr_pool_allocator_get(arr->pool);
+        apr_memnode_t *node;
+
+        node = apr_allocator_alloc(allocator, elt_size * new_size);
+        if (node == NULL) {
+            apr_abortfunc_t abort_fn = apr_pool_abort_get(arr->pool);
+            if (abort_fn) {
+                abort_fn(APR_ENOMEM);
+            }
+            return;
+        }
+        new_data = node->first_avail;
+        new_size = (int)((node->endp - node->first_avail) / elt_size);
+        memcpy(new_data, arr->elts, ncopy * elt_size);
+        apr_allocator_free(allocator, arr->node);
+        arr->node = node;
+    }
+    else {
+        new_data = apr_palloc(arr->pool, elt_size * new_size);
+        memcpy(new_data, arr->elts, ncopy * elt_size);
+    }
+    if (clear && new_size > ncopy) {
+        memset(new_data + ncopy * elt_size, 0, elt_size * (new_size - ncopy));
+    }
+    arr->elts = new_data;
+    arr->nalloc = new_size;
+}
+
+static apr_status_t array_cleanup(void *data)
+{
+    apr_array_header_t *arr = data;
+
+    if (arr->node) {
+        apr_allocator_free(apr_pool_allocator_get(arr->pool), arr->node);
+        arr->node = NULL;
+        arr->elts = NULL;
+        arr->nelts = arr->nalloc = 0;
+    }
+    return APR_SUCCESS;
 }
 
 APR_DECLARE(int) apr_is_empty_array(const apr_array_header_t *a)
@@ -90,6 +156,45 @@ APR_DECLARE(apr_array_header_t *) apr_array_make(apr_pool_t *p,
     return res;
 }
 
+APR_DECLARE(apr_array_header_t *) apr_array_make_ex(apr_pool_t *p,
+                                                    int nelts, int elt_size,
+                                                    apr_uint32_t flags)
+{
+    apr_array_header_t *res;
+    apr_allocator_t *allocator;
+    apr_memnode_t *node;
+
+    /* Debug pools have no allocator, their arrays stay in the pool */
+    allocator = apr_pool_allocator_get(p);
+    if (!(flags & APR_ARRAY_ALLOCATOR) || !allocator) {
+        return apr_array_make(p, nelts, elt_size);
+    }
+
+    if (nelts < 1) {
+        nelts = 1;
+    }
+    node = apr_allocator_alloc(allocator, (apr_size_t)elt_size * nelts);
+    if (node == NULL) {
+        apr_abortfunc_t abort_fn = apr_pool_abort_get(p);
+        if (abort_fn) {
+            abort_fn(APR_ENOMEM);
+        }
+        return NULL;
+    }
+
+    res = (apr_array_header_t *) apr_palloc(p, sizeof(apr_array_header_t));
+    res->pool = p;
+    res->elt_size = elt_size;
+    res->nelts = 0;
+    res->nalloc = (int)((node->endp - node->first_avail) / elt_size);
+    res->elts = node->first_avail;
+    res->node = node;
+    memset(res->elts, 0, (apr_size_t)elt_size * res->nalloc);
+    apr_pool_cleanup_register(p, res, array_cleanup, apr_pool_cleanup_null);
+
+    return res;
+}
+
 APR_DECLARE(void) apr_array_clear(apr_array_header_t *arr)
 {
     arr->nelts = 0;
@@ -104,36 +209,52 @@ APR_DECLARE(void *) apr_array_pop(apr_array_header_t *arr)
     return arr->elts + (arr->elt_size * (--arr->nelts));
 }
 
-APR_DECLARE(void *) apr_array_push(apr_array_header_t *arr)
+APR_DECLARE(void) apr_array_reserve(apr_array_header_t *arr, int nelts)
 {
-    if (arr->nelts == arr->nalloc) {
-        int new_size = (arr->nalloc <= 0) ? 1 : arr->nalloc * 2;
-        char *new_data;
+    if (nelts > arr->nalloc) {
+        array_realloc(arr, nelts, 1);
+    }
+}
 
-        new_data = apr_palloc(arr->pool, arr->elt_size * new_size);
+APR_DECLARE(void) apr_array_shrink_to_fit(apr_array_header_t *arr)
+{
+    /* Pool memory can't be given back, so only allocator arrays shrink */
+    if (arr->node && arr->nelts < arr->nalloc) {
+        int nelts = arr->nelts ? arr->nelts : 1;
+        apr_size_t size;
+
+        size = apr_allocator_align(apr_pool_allocator_get(arr->pool),
+                                   (apr_size_t)arr->elt_size * nelts);
+        if (size < (apr_size_t)(arr->node->endp - (char *)arr->node)) {
+            array_realloc(arr, nelts, 0);
+        }
+    }
+}
 
-        memcpy(new_data, arr->elts, arr->nalloc * arr->elt_size);
-        memset(new_data + arr->nalloc * arr->elt_size, 0,
-               arr->elt_size * (new_size - arr->nalloc));
-        arr->elts = new_data;
-        arr->nalloc = new_size;
+APR_DECLARE(void *) apr_array_push(apr_array_header_t *arr)
+{
+    if (arr->nelts == arr->nalloc) {
+        array_realloc(arr, array_next_size(arr, arr->nelts + 1), 1);
     }
 
     ++arr->nelts;
     return arr->elts + (arr->elt_size * (arr->nelts - 1));
 }
 
-static void *apr_array_push_noclear(apr_array_header_t *arr)
+APR_DECLARE(void *) apr_array_push_n(apr_array_header_t *arr, int nelts)
 {
-    if (arr->nelts == arr->nalloc) {
-        int new_size = (arr->nalloc <= 0) ? 1 : arr->nalloc * 2;
-        char *new_data;
+    if (arr->nelts + nelts > arr->nalloc) {
+        array_realloc(arr, array_next_size(arr, arr->nelts + nelts), 1);
+    }
 
-        new_data = apr_palloc(arr->pool, arr->elt_size * new_size);
+    arr->nelts += nelts;
+    return arr->elts + (arr->elt_size * (arr->nelts - nelts));
+}
 
-        memcpy(new_data, arr->elts, arr->nalloc * arr->elt_size);
-        arr->elts = new_data;
-        arr->nalloc = new_size;
+static void *apr_array_push_noclear(apr_array_header_t *arr)
+{
+    if (arr->nelts == arr->nalloc) {
+        array_realloc(arr, array_next_size(arr, arr->nelts + 1), 0);
     }
 
     ++arr->nelts;
@@ -146,22 +267,12 @@ APR_DECLARE(void) apr_array_cat(apr_array_header_t *dst,
     int elt_size = dst->elt_size;
 
     if (dst->nelts + src->nelts > dst->nalloc) {
-	int new_size = (dst->nalloc <= 0) ? 1 : dst->nalloc * 2;
-	char *new_data;
-
-	while (dst->nelts + src->nelts > new_size) {
-	    new_size *= 2;
-	}
-
-	new_data = apr_pcalloc(dst->pool, elt_size * new_size);
-	memcpy(new_data, dst->elts, dst->nalloc * elt_size);
-
-	dst->elts = new_data;
-	dst->nalloc = new_size;
+        array_realloc(dst, array_next_size(dst, dst->nelts + src->nelts), 1);
     }
 
-    memcpy(dst->elts + dst->nelts * elt_size, src->elts,
-	   elt_size * src->nelts);
+    /* src may share the storage of dst (apr_array_copy_hdr(), or itself) */
+    memmove(dst->elts + dst->nelts * elt_size, src->elts,
+            elt_size * src->nelts);
     dst->nelts += src->nelts;
 }
 
@@ -193,6 +304,7 @@ static APR_INLINE void copy_array_hdr_core(apr_array_header_t *res,
     res->elt_size = arr->elt_size;
     res->nelts = arr->nelts;
     res->nalloc = arr->nelts;	/* Force overflow on push */
+    res->node = NULL;
 }
 
 APR_DECLARE(apr_array_header_t *)
@@ -201,6 +313,11 @@ APR_DECLARE(apr_array_header_t *)
 {
     apr_array_header_t *res;
 
+    /* The elements of allocator arrays don't outlive their growth */
+    if (arr->node) {
+        return apr_array_copy(p, arr);
+    }
+
     res = (apr_array_header_t *) apr_palloc(p, sizeof(apr_array_header_t));
     res->pool = p;
     copy_array_hdr_core(res, arr);
@@ -281,6 +398,546 @@ APR_DECLARE(char *) apr_array_pstrcat(apr_pool_t *p,
     return res;
 }
 
+/*****************************************************************
+ *
+ * Sorting and searching arrays
+ */
+
+/* The ranges sorted by insertion */
+#define SORT_INSERTION 16
+
+/* The arrays sorted by one thread, per part of a parallel sort */
+#define SORT_PARALLEL_MIN 4096
+
+#define SORT_AT(base, i, size) ((base) + (apr_size_t)(i) * (size))
+
+static APR_INLINE void sort_swap(char *a, char *b, apr_size_t size)
+{
+    apr_uint64_t w;
+    char c;
+
+    if (a == b) {
+        return;
+    }
+    while (size >= sizeof(w)) {
+        memcpy(&w, a, sizeof(w));
+        memcpy(a, b, sizeof(w));
+        memcpy(b, &w, sizeof(w));
+        a += sizeof(w);
+        b += sizeof(w);
+        size -= sizeof(w);
+    }
+    while (size--) {
+        c = *a;
+        *a++ = *b;
+        *b++ = c;
+    }
+}
+
+/* Stable */
+static void sort_insertion(char *base, apr_size_t n, apr_size_t size,
+                           apr_array_compare_fn *compare)
+{
+    apr_size_t i, j;
+
+    for (i = 1; i < n; i++) {
+        for (j = i; j > 0; j--) {
+            char *a = SORT_AT(base, j - 1, size), *b = a + size;
+
+            if (compare(a, b) <= 0) {
+                break;
+            }
+            sort_swap(a, b, size);
+        }
+    }
+}
+
+static void sort_sift_down(char *base, apr_size_t i, apr_size_t n,
+                           apr_size_t size, apr_array_compare_fn *compare)
+{
+    for (;;) {
+        apr_size_t child = 2 * i + 1;
+
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && compare(SORT_AT(base, child, size),
+                                     SORT_AT(base, child + 1, size)) < 0) {
+            child++;
+        }
+        if (compare(SORT_AT(base, i, size), SORT_AT(base, child, size)) >= 0) {
+            break;
+        }
+        sort_swap(SORT_AT(base, i, size), SORT_AT(base, child, size), size);
+        i = child;
+    }
+}
+
+static void sort_heap(char *base, apr_size_t n, apr_size_t size,
+                      apr_array_compare_fn *compare)
+{
+    apr_size_t i;
+
+    for (i = n / 2; i-- > 0;) {
+        sort_sift_down(base, i, n, size, compare);
+    }
+    for (i = n; i-- > 1;) {
+        sort_swap(base, SORT_AT(base, i, size), size);
+        sort_sift_down(base, 0, i, size, compare);
+    }
+}
+
+/* Quicksort with a median of three pivot, falling back to heapsort once
+ * the depth shows that the pivots are bad (introsort).
+ */
+static void sort_intro(char *base, apr_size_t n, apr_size_t size,
+                       apr_array_compare_fn *compare, int depth)
+{
+    while (n > SORT_INSERTION) {
+        char *a = SORT_AT(base, 1, size), *b = SORT_AT(base, n / 2, size),
+             *c = SORT_AT(base, n - 1, size);
+        apr_size_t i, j;
+
+        if (!depth--) {
+            sort_heap(base, n, size, compare);
+            return;
+        }
+
+        /* The pivot goes first, the elements around it bounding the scans */
+        if (compare(a, b) > 0) {
+            sort_swap(a, b, size);
+        }
+        if (compare(b, c) > 0) {
+            sort_swap(b, c, size);
+            if (compare(a, b) > 0) {
+                sort_swap(a, b, size);
+            }
+        }
+        sort_swap(base, b, size);
+
+        i = 0;
+        j = n;
+        for (;;) {
+            do {
+                i++;
+            } while (compare(SORT_AT(base, i, size), base) < 0);
+            do {
+                j--;
+            } while (compare(base, SORT_AT(base, j, size)) < 0);
+            if (i >= j) {
+                break;
+            }
+            sort_swap(SORT_AT(base, i, size), SORT_AT(base, j, size), size);
+        }
+        sort_swap(base, SORT_AT(base, j, size), size);
+
+        /* Recurse into the smaller side, loop on the larger one */
+        if (j < n - j - 1) {
+            sort_intro(base, j, size, compare, depth);
+            base = SORT_AT(base, j + 1, size);
+            n -= j + 1;
+        }
+        else {
+            sort_intro(SORT_AT(base, j + 1, size), n - j - 1, size, compare,
+                       depth);
+            n = j;
+        }
+    }
+    sort_insertion(base, n, size, compare);
+}
+
+static void sort_unstable(char *base, apr_size_t n, apr_size_t size,
+                          apr_array_compare_fn *compare)
+{
+    apr_size_t i;
+    int depth = 0;
+
+    for (i = n; i > 1; i >>= 1) {
+        depth += 2;
+    }
+    sort_intro(base, n, size, compare, depth);
+}
+
+/* Merge the runs a and b to dst, which may be where b is */
+static void sort_merge_runs(char *dst, const char *a, apr_size_t na,
+                            const char *b, apr_size_t nb, apr_size_t size,
+                            apr_array_compare_fn *compare)
+{
+    while (na && nb) {
+        if (compare(b, a) < 0) {
+            memcpy(dst, b, size);
+            b += size;
+            nb--;
+        }
+        else {
+            memcpy(dst, a, size);
+            a += size;
+            na--;
+        }
+        dst += size;
+    }
+    memmove(dst, a, na * size);
+    memmove(dst + na * size, b, nb * size);
+}
+
+/* Mergesort, tmp holding half of the elements */
+static void sort_merge(char *base, char *tmp, apr_size_t n, apr_size_t size,
+                       apr_array_compare_fn *compare)
+{
+    apr_size_t mid = n / 2;
+
+    if (n <= SORT_INSERTION) {
+        sort_insertion(base, n, size, compare);
+        return;
+    }
+    sort_merge(base, tmp, mid, size, compare);
+    sort_merge(SORT_AT(base, mid, size), tmp, n - mid, size, compare);
+    if (compare(SORT_AT(base, mid - 1, size), SORT_AT(base, mid, size)) <= 0) {
+        /* already in order */
+        return;
+    }
+    memcpy(tmp, base, mid * size);
+    sort_merge_runs(base, tmp, mid, SORT_AT(base, mid, size), n - mid, size,
+                    compare);
+}
+
+APR_DECLARE(apr_status_t) apr_array_sort(apr_array_header_t *arr,
+                                         apr_array_compare_fn *compare,
+                                         int flags)
+{
+    apr_size_t n = arr->nelts > 0 ? arr->nelts : 0, size = arr->elt_size;
+    char *tmp;
+
+    if (n < 2) {
+        return APR_SUCCESS;
+    }
+    if (!(flags & APR_ARRAY_SORT_STABLE)) {
+        sort_unstable(arr->elts, n, size, compare);
+        return APR_SUCCESS;
+    }
+
+    tmp = malloc(n / 2 * size);
+    if (!tmp) {
+        return APR_ENOMEM;
+    }
+    sort_merge(arr->elts, tmp, n, size, compare);
+    free(tmp);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void *) apr_array_bsearch(const apr_array_header_t *arr,
+                                      const void *key,
+                                      apr_array_compare_fn *compare,
+                                      int *index)
+{
+    apr_size_t lo = 0, hi = arr->nelts > 0 ? arr->nelts : 0;
+    char *elt;
+
+    /* the first element not before the key */
+    while (lo < hi) {
+        apr_size_t mid = lo + (hi - lo) / 2;
+
+        if (compare(key, SORT_AT(arr->elts, mid, arr->elt_size)) > 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (index) {
+        *index = (int)lo;
+    }
+
+    elt = SORT_AT(arr->elts, lo, arr->elt_size);
+    if (lo < (apr_size_t)arr->nelts && compare(key, elt) == 0) {
+        return elt;
+    }
+    return NULL;
+}
+
+APR_DECLARE(apr_status_t) apr_array_sort_u64(apr_array_header_t *arr,
+                                             apr_size_t key_offset)
+{
+    apr_size_t n = arr->nelts > 0 ? arr->nelts : 0, size = arr->elt_size;
+    apr_size_t (*counts)[256], i;
+    apr_uint64_t key, first;
+    char *src = arr->elts, *dst, *buf;
+    int pass;
+
+    if (key_offset > size || size - key_offset < sizeof(apr_uint64_t)) {
+        return APR_EINVAL;
+    }
+    if (n < 2) {
+        return APR_SUCCESS;
+    }
+
+    buf = malloc(n * size + 8 * sizeof(*counts));
+    if (!buf) {
+        return APR_ENOMEM;
+    }
+    counts = (apr_size_t (*)[256])(void *)buf;
+    dst = buf + 8 * sizeof(*counts);
+    memset(counts, 0, 8 * sizeof(*counts));
+
+    /* The counts of each byte of the keys, for all the passes at once */
+    for (i = 0; i < n; i++) {
+        memcpy(&key, SORT_AT(src, i, size) + key_offset, sizeof(key));
+        for (pass = 0; pass < 8; pass++) {
+            counts[pass][(key >> (pass * 8)) & 0xff]++;
+        }
+    }
+    memcpy(&first, src + key_offset, sizeof(first));
+
+    /* Least significant byte first, each pass being stable */
+    for (pass = 0; pass < 8; pass++) {
+        apr_size_t *count = counts[pass], sum = 0, c;
+        int shift = pass * 8;
+        char *t;
+
+        if (count[(first >> shift) & 0xff] == n) {
+            /* the same byte in all the keys */
+            continue;
+        }
+        for (c = 0; c < 256; c++) {
+            apr_size_t nc = count[c];
+
+            count[c] = sum;
+            sum += nc;
+        }
+        for (i = 0; i < n; i++) {
+            const char *e = SORT_AT(src, i, size);
+
+            memcpy(&key, e + key_offset, sizeof(key));
+            memcpy(SORT_AT(dst, count[(key >> shift) & 0xff]++, size), e,
+                   size);
+        }
+        t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != arr->elts) {
+        memcpy(arr->elts, src, n * size);
+    }
+
+    free(buf);
+    return APR_SUCCESS;
+}
+
+static APR_INLINE const char *sort_str(const char *e, apr_size_t key_offset)
+{
+    const char *s;
+
+    memcpy(&s, e + key_offset, sizeof(s));
+    return s;
+}
+
+#define SORT_CHAR(e, key_offset, depth) \
+    ((unsigned char)sort_str(e, key_offset)[depth])
+
+/* Multikey quicksort (Bentley & Sedgewick): the elements are split in
+ * three by the character at depth, those equal continuing with the next
+ * character.
+ */
+static void sort_mkq(char *base, apr_size_t n, apr_size_t size,
+                     apr_size_t key_offset, apr_size_t depth)
+{
+    while (n > SORT_INSERTION) {
+        apr_size_t lt = 0, i = 1, gt = n, m;
+        int a = SORT_CHAR(base, key_offset, depth),
+            b = SORT_CHAR(SORT_AT(base, n / 2, size), key_offset, depth),
+            c = SORT_CHAR(SORT_AT(base, n - 1, size), key_offset, depth), v;
+
+        /* The median of three goes first */
+        if (a < b) {
+            m = b < c ? n / 2 : a < c ? n - 1 : 0;
+        }
+        else {
+            m = a < c ? 0 : b < c ? n - 1 : n / 2;
+        }
+        sort_swap(base, SORT_AT(base, m, size), size);
+        v = SORT_CHAR(base, key_offset, depth);
+
+        while (i < gt) {
+            int ci = SORT_CHAR(SORT_AT(base, i, size), key_offset, depth);
+
+            if (ci < v) {
+                sort_swap(SORT_AT(base, lt, size), SORT_AT(base, i, size),
+                          size);
+                lt++;
+                i++;
+            }
+            else if (ci > v) {
+                gt--;
+                sort_swap(SORT_AT(base, i, size), SORT_AT(base, gt, size),
+                          size);
+            }
+            else {
+                i++;
+            }
+        }
+
+        sort_mkq(base, lt, size, key_offset, depth);
+        if (v) {
+            sort_mkq(SORT_AT(base, lt, size), gt - lt, size, key_offset,
+                     depth + 1);
+        }
+        base = SORT_AT(base, gt, size);
+        n -= gt;
+    }
+
+    /* Insertion, the keys sharing their first depth characters */
+    {
+        apr_size_t i, j;
+
+        for (i = 1; i < n; i++) {
+            for (j = i; j > 0; j--) {
+                char *e = SORT_AT(base, j - 1, size);
+
+                if (strcmp(sort_str(e, key_offset) + depth,
+                           sort_str(e + size, key_offset) + depth) <= 0) {
+                    break;
+                }
+                sort_swap(e, e + size, size);
+            }
+        }
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_array_sort_str(apr_array_header_t *arr,
+                                             apr_size_t key_offset)
+{
+    apr_size_t n = arr->nelts > 0 ? arr->nelts : 0, size = arr->elt_size;
+
+    if (key_offset > size || size - key_offset < sizeof(const char *)) {
+        return APR_EINVAL;
+    }
+    sort_mkq(arr->elts, n, size, key_offset, 0);
+    return APR_SUCCESS;
+}
+
+#if APR_HAS_THREADS
+
+/* The parts are sorted concurrently, then merged by pairs concurrently,
+ * level after level, the runs going back and forth between the array
+ * and the buffer.
+ */
+typedef struct sort_parallel_t {
+    char *src;
+    char *dst;
+    apr_size_t n;
+    apr_size_t size;
+    apr_size_t nparts;
+    apr_size_t width;
+    apr_array_compare_fn *compare;
+    int flags;
+} sort_parallel_t;
+
+static APR_INLINE apr_size_t sort_part_start(const sort_parallel_t *sp,
+                                             apr_size_t i)
+{
+    apr_size_t q = sp->n / sp->nparts, r = sp->n % sp->nparts;
+
+    if (i > sp->nparts) {
+        i = sp->nparts;
+    }
+    return i * q + (i < r ? i : r);
+}
+
+static apr_status_t sort_parts(apr_size_t begin, apr_size_t end, void *baton)
+{
+    const sort_parallel_t *sp = baton;
+    apr_size_t i;
+
+    for (i = begin; i < end; i++) {
+        apr_size_t start = sort_part_start(sp, i);
+        apr_size_t n = sort_part_start(sp, i + 1) - start;
+
+        if (sp->flags & APR_ARRAY_SORT_STABLE) {
+            sort_merge(SORT_AT(sp->src, start, sp->size),
+                       SORT_AT(sp->dst, start, sp->size), n, sp->size,
+                       sp->compare);
+        }
+        else {
+            sort_unstable(SORT_AT(sp->src, start, sp->size), n, sp->size,
+                          sp->compare);
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t sort_merges(apr_size_t begin, apr_size_t end,
+                                void *baton)
+{
+    const sort_parallel_t *sp = baton;
+    apr_size_t i;
+
+    for (i = begin; i < end; i++) {
+        apr_size_t a = sort_part_start(sp, 2 * i * sp->width);
+        apr_size_t b = sort_part_start(sp, (2 * i + 1) * sp->width);
+        apr_size_t c = sort_part_start(sp, (2 * i + 2) * sp->width);
+
+        sort_merge_runs(SORT_AT(sp->dst, a, sp->size),
+                        SORT_AT(sp->src, a, sp->size), b - a,
+                        SORT_AT(sp->src, b, sp->size), c - b,
+                        sp->size, sp->compare);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_array_sort_parallel(apr_array_header_t *arr,
+                                                  apr_array_compare_fn *compare,
+                                                  int flags,
+                                                  apr_thread_pool_t *tp,
+                                                  apr_pool_t *p)
+{
+    apr_size_t n = arr->nelts > 0 ? arr->nelts : 0, size = arr->elt_size;
+    apr_size_t nthreads;
+    sort_parallel_t sp;
+    apr_status_t rv;
+    char *tmp, *t;
+
+    if (!tp || n < 2 * SORT_PARALLEL_MIN) {
+        return apr_array_sort(arr, compare, flags);
+    }
+
+    /* A part per thread, the caller's included, by powers of two */
+    nthreads = apr_thread_pool_thread_max_get(tp) + 1;
+    for (sp.nparts = 2; sp.nparts < nthreads
+                        && sp.nparts * 2 * SORT_PARALLEL_MIN <= n;) {
+        sp.nparts *= 2;
+    }
+
+    tmp = malloc(n * size);
+    if (!tmp) {
+        return APR_ENOMEM;
+    }
+    sp.src = arr->elts;
+    sp.dst = tmp;
+    sp.n = n;
+    sp.size = size;
+    sp.compare = compare;
+    sp.flags = flags;
+
+    rv = apr_parallel_for(tp, 0, sp.nparts, 1, sort_parts, &sp, p);
+    for (sp.width = 1; rv == APR_SUCCESS && sp.width < sp.nparts;
+         sp.width *= 2) {
+        rv = apr_parallel_for(tp, 0, sp.nparts / (2 * sp.width), 1,
+                              sort_merges, &sp, p);
+        t = sp.src;
+        sp.src = sp.dst;
+        sp.dst = t;
+    }
+    if (rv == APR_SUCCESS && sp.src != arr->elts) {
+        memcpy(arr->elts, sp.src, n * size);
+    }
+
+    free(tmp);
+    return rv;
+}
+
+#endif /* APR_HAS_THREADS */
+
+
 
 /*****************************************************************
  *
@@ -328,6 +985,25 @@ APR_DECLARE(char *) apr_array_pstrcat(apr_pool_t *p,
     checksum &= CASE_MASK;                     \
 }
 
+/* Tables with at least TABLE_HINDEX_MIN elements also have a hashed index
+ * of their keys, see table_hindex_find().
+ */
+#define TABLE_HINDEX_MIN 16
+#define TABLE_HINDEX_USED(t) ((t)->hindex && (t)->hindex->used)
+
+typedef struct
+{
+    apr_uint32_t hash;
+    int elt;    /* offset within the table + 1, or 0 for an empty slot */
+} table_hslot_t;
+
+typedef struct
+{
+    table_hslot_t *slots;
+    int mask;
+    int used;   /* number of keys indexed, 0 when the index is not used */
+} table_hindex_t;
+
 /** The opaque string-content table type */
 struct apr_table_t {
     /* This has to be first to promote backwards compatibility with
@@ -355,6 +1031,19 @@ struct apr_table_t {
     apr_uint32_t index_initialized;
     int index_first[TABLE_HASH_SIZE];
     int index_last[TABLE_HASH_SIZE];
+    /* Open addressing index of the first entry for each key, built when
+     * the table grows large enough that scanning the entries between
+     * index_first and index_last becomes costly.
+     */
+    table_hindex_t *hindex;
+    /* Offset of the first entry not indexed yet (APR_TABLE_BULK_LAZY),
+     * or -1 if all the entries are indexed.
+     */
+    int lazy;
+    /* Whether the entries and the hashed index may be shared with a
+     * snapshot (or the table this is a snapshot of), see TABLE_OWN().
+     */
+    apr_uint32_t shared;
 };
 
 /* keep state for apr_table_getm() */
@@ -387,6 +1076,168 @@ static apr_table_entry_t *do_table_push(const char *func, apr_table_t *t)
 #define table_push(t)	((apr_table_entry_t *) apr_array_push_noclear(&(t)->a))
 #endif /* MAKE_TABLE_PROFILE */
 
+/* Hash of a key, case folded like the checksum, collisions included */
+static apr_uint32_t table_hash_key(const char *key)
+{
+    const unsigned char *k = (const unsigned char *)key;
+    apr_uint32_t hash = 2166136261U;
+
+    for (; *k; k++) {
+        hash = (hash ^ (*k & (CASE_MASK & 0xff))) * 16777619U;
+    }
+    return hash;
+}
+
+/* Offset of the first entry with the key, or -1 */
+static int table_hindex_find(const apr_table_t *t, const char *key)
+{
+    const table_hindex_t *hi = t->hindex;
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)t->a.elts;
+    apr_uint32_t hash = table_hash_key(key);
+    int i;
+
+    for (i = hash & hi->mask; hi->slots[i].elt; i = (i + 1) & hi->mask) {
+        const table_hslot_t *slot = &hi->slots[i];
+        if (slot->hash == hash && !strcasecmp(elts[slot->elt - 1].key, key)) {
+            return slot->elt - 1;
+        }
+    }
+    return -1;
+}
+
+static void table_hindex_insert(apr_table_t *t, int elt)
+{
+    table_hindex_t *hi = t->hindex;
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)t->a.elts;
+    const char *key = elts[elt].key;
+    apr_uint32_t hash = table_hash_key(key);
+    int i;
+
+    for (i = hash & hi->mask; hi->slots[i].elt; i = (i + 1) & hi->mask) {
+        const table_hslot_t *slot = &hi->slots[i];
+        if (slot->hash == hash && !strcasecmp(elts[slot->elt - 1].key, key)) {
+            /* not the first entry with this key */
+            return;
+        }
+    }
+    hi->slots[i].hash = hash;
+    hi->slots[i].elt = elt + 1;
+    hi->used++;
+}
+
+static void table_hindex_build(apr_table_t *t)
+{
+    table_hindex_t *hi = t->hindex;
+    int size = TABLE_HINDEX_MIN * 2, i;
+
+    while (size < t->a.nelts * 2) {
+        size *= 2;
+    }
+    if (!hi) {
+        hi = t->hindex = apr_palloc(t->a.pool, sizeof(*hi));
+        hi->slots = NULL;
+        hi->mask = -1;
+    }
+    if (size > hi->mask + 1) {
+        hi->slots = apr_palloc(t->a.pool, sizeof(*hi->slots) * size);
+        hi->mask = size - 1;
+    }
+    memset(hi->slots, 0, sizeof(*hi->slots) * (hi->mask + 1));
+    hi->used = 0;
+    for (i = 0; i < t->a.nelts; i++) {
+        table_hindex_insert(t, i);
+    }
+}
+
+/* Account for the entry appended at offset elt */
+static void table_hindex_add(apr_table_t *t, int elt)
+{
+    if (!TABLE_HINDEX_USED(t)) {
+        if (t->a.nelts >= TABLE_HINDEX_MIN) {
+            table_hindex_build(t);
+        }
+    }
+    else if (t->a.nelts * 2 > t->hindex->mask + 1) {
+        table_hindex_build(t);
+    }
+    else {
+        table_hindex_insert(t, elt);
+    }
+}
+
+/* Index the entries from offset "from" to the end */
+static void table_index_tail(apr_table_t *t, int from)
+{
+    int i;
+    int hash;
+    apr_table_entry_t *next_elt = (apr_table_entry_t *) t->a.elts + from;
+
+    for (i = from; i < t->a.nelts; i++, next_elt++) {
+        hash = TABLE_HASH(next_elt->key);
+        t->index_last[hash] = i;
+        if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
+            t->index_first[hash] = i;
+            TABLE_SET_INDEX_INITIALIZED(t, hash);
+        }
+    }
+
+    if (TABLE_HINDEX_USED(t) && t->a.nelts * 2 <= t->hindex->mask + 1) {
+        for (i = from; i < t->a.nelts; i++) {
+            table_hindex_insert(t, i);
+        }
+    }
+    else if (t->a.nelts >= TABLE_HINDEX_MIN) {
+        table_hindex_build(t);
+    }
+    t->lazy = -1;
+}
+
+static void table_reindex(apr_table_t *t)
+{
+    t->index_initialized = 0;
+    if (t->hindex) {
+        t->hindex->used = 0;
+    }
+    table_index_tail(t, 0);
+}
+
+/*
+ * Index the entries added by apr_table_addn_bulk(APR_TABLE_BULK_LAZY),
+ * the table is modified by the first (read only) function using it.
+ */
+static APR_INLINE void table_check_index(const apr_table_t *t)
+{
+    if (t->lazy >= 0) {
+        table_index_tail((apr_table_t *)t, t->lazy);
+    }
+}
+
+/* Copy the entries and the hashed index shared with a snapshot */
+static void table_unshare(apr_table_t *t)
+{
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)t->a.elts;
+    int nelts = t->a.nelts, rebuild = TABLE_HINDEX_USED(t);
+
+    make_array_core(&t->a, t->a.pool, t->a.nalloc, sizeof(apr_table_entry_t),
+                    0);
+    memcpy(t->a.elts, elts, nelts * sizeof(apr_table_entry_t));
+    t->a.nelts = nelts;
+    t->hindex = NULL;
+    if (rebuild) {
+        table_hindex_build(t);
+    }
+    apr_atomic_set32(&t->shared, 0);
+}
+
+/* To be called before modifying a table: the first modification after a
+ * snapshot copies the entries.
+ */
+#define TABLE_OWN(t) do {                   \
+    if (apr_atomic_read32(&(t)->shared)) {  \
+        table_unshare(t);                   \
+    }                                       \
+} while (0)
+
 APR_DECLARE(const apr_array_header_t *) apr_table_elts(const apr_table_t *t)
 {
     return (const apr_array_header_t *)t;
@@ -406,6 +1257,9 @@ APR_DECLARE(apr_table_t *) apr_table_make(apr_pool_t *p, int nelts)
     t->creator = __builtin_return_address(0);
 #endif
     t->index_initialized = 0;
+    t->hindex = NULL;
+    t->lazy = -1;
+    t->shared = 0;
     return t;
 }
 
@@ -422,12 +1276,43 @@ APR_DECLARE(apr_table_t *) apr_table_copy(apr_pool_t *p, const apr_table_t *t)
 	abort();
     }
 #endif
+    table_check_index(t);
     make_array_core(&new->a, p, t->a.nalloc, sizeof(apr_table_entry_t), 0);
     memcpy(new->a.elts, t->a.elts, t->a.nelts * sizeof(apr_table_entry_t));
     new->a.nelts = t->a.nelts;
     memcpy(new->index_first, t->index_first, sizeof(int) * TABLE_HASH_SIZE);
     memcpy(new->index_last, t->index_last, sizeof(int) * TABLE_HASH_SIZE);
     new->index_initialized = t->index_initialized;
+    new->hindex = NULL;
+    new->lazy = -1;
+    new->shared = 0;
+    if (TABLE_HINDEX_USED(t)) {
+        table_hindex_build(new);
+    }
+    return new;
+}
+
+APR_DECLARE(apr_table_t *) apr_table_snapshot(apr_pool_t *p,
+                                              const apr_table_t *t)
+{
+    apr_table_t *new = apr_palloc(p, sizeof(apr_table_t));
+
+#if APR_POOL_DEBUG
+    /* we share the entries too, so it's necessary that t->a.pool
+     * have a life span at least as long as p
+     */
+    if (!apr_pool_is_ancestor(t->a.pool, p)) {
+	fprintf(stderr, "apr_table_snapshot: t's pool is not an ancestor of p\n");
+	abort();
+    }
+#endif
+    table_check_index(t);
+    *new = *t;
+    new->a.pool = p;
+    new->shared = 1;
+    if (!apr_atomic_read32(&((apr_table_t *)t)->shared)) {
+        apr_atomic_set32(&((apr_table_t *)t)->shared, 1);
+    }
     return new;
 }
 
@@ -445,27 +1330,20 @@ APR_DECLARE(apr_table_t *) apr_table_clone(apr_pool_t *p, const apr_table_t *t)
     return new;
 }
 
-static void table_reindex(apr_table_t *t)
-{
-    int i;
-    int hash;
-    apr_table_entry_t *next_elt = (apr_table_entry_t *) t->a.elts;
-
-    t->index_initialized = 0;
-    for (i = 0; i < t->a.nelts; i++, next_elt++) {
-        hash = TABLE_HASH(next_elt->key);
-        t->index_last[hash] = i;
-        if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
-            t->index_first[hash] = i;
-            TABLE_SET_INDEX_INITIALIZED(t, hash);
-        }
-    }
-}
-
 APR_DECLARE(void) apr_table_clear(apr_table_t *t)
 {
+    if (apr_atomic_read32(&t->shared)) {
+        make_array_core(&t->a, t->a.pool, t->a.nalloc,
+                        sizeof(apr_table_entry_t), 0);
+        t->hindex = NULL;
+        apr_atomic_set32(&t->shared, 0);
+    }
     t->a.nelts = 0;
     t->index_initialized = 0;
+    if (t->hindex) {
+        t->hindex->used = 0;
+    }
+    t->lazy = -1;
 }
 
 APR_DECLARE(const char *) apr_table_get(const apr_table_t *t, const char *key)
@@ -478,11 +1356,16 @@ APR_DECLARE(const char *) apr_table_get(const apr_table_t *t, const char *key)
     if (key == NULL) {
 	return NULL;
     }
+    table_check_index(t);
 
     hash = TABLE_HASH(key);
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
         return NULL;
     }
+    if (TABLE_HINDEX_USED(t)) {
+        int i = table_hindex_find(t, key);
+        return (i < 0) ? NULL : ((apr_table_entry_t *) t->a.elts)[i].val;
+    }
     COMPUTE_KEY_CHECKSUM(key, checksum);
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
@@ -506,6 +1389,8 @@ APR_DECLARE(void) apr_table_set(apr_table_t *t, const char *key,
     apr_uint32_t checksum;
     int hash;
 
+    TABLE_OWN(t);
+    table_check_index(t);
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
@@ -515,6 +1400,13 @@ APR_DECLARE(void) apr_table_set(apr_table_t *t, const char *key,
     }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    if (TABLE_HINDEX_USED(t)) {
+        int i = table_hindex_find(t, key);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+    }
     table_end =((apr_table_entry_t *) t->a.elts) + t->a.nelts;
 
     for (; next_elt <= end_elt; next_elt++) {
@@ -567,6 +1459,7 @@ add_new_elt:
     next_elt->key = apr_pstrdup(t->a.pool, key);
     next_elt->val = apr_pstrdup(t->a.pool, val);
     next_elt->key_checksum = checksum;
+    table_hindex_add(t, t->a.nelts - 1);
 }
 
 APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
@@ -578,6 +1471,8 @@ APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
     apr_uint32_t checksum;
     int hash;
 
+    TABLE_OWN(t);
+    table_check_index(t);
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
@@ -587,6 +1482,13 @@ APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
     }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    if (TABLE_HINDEX_USED(t)) {
+        int i = table_hindex_find(t, key);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+    }
     table_end =((apr_table_entry_t *) t->a.elts) + t->a.nelts;
 
     for (; next_elt <= end_elt; next_elt++) {
@@ -639,6 +1541,7 @@ add_new_elt:
     next_elt->key = (char *)key;
     next_elt->val = (char *)val;
     next_elt->key_checksum = checksum;
+    table_hindex_add(t, t->a.nelts - 1);
 }
 
 APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
@@ -650,6 +1553,8 @@ APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
     int hash;
     int must_reindex;
 
+    TABLE_OWN(t);
+    table_check_index(t);
     hash = TABLE_HASH(key);
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
         return;
@@ -657,6 +1562,13 @@ APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
     COMPUTE_KEY_CHECKSUM(key, checksum);
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    if (TABLE_HINDEX_USED(t)) {
+        int i = table_hindex_find(t, key);
+        if (i < 0) {
+            return;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+    }
     must_reindex = 0;
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
@@ -703,6 +1615,8 @@ APR_DECLARE(void) apr_table_merge(apr_table_t *t, const char *key,
     apr_uint32_t checksum;
     int hash;
 
+    TABLE_OWN(t);
+    table_check_index(t);
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
@@ -712,6 +1626,13 @@ APR_DECLARE(void) apr_table_merge(apr_table_t *t, const char *key,
     }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    if (TABLE_HINDEX_USED(t)) {
+        int i = table_hindex_find(t, key);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+    }
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
@@ -730,6 +1651,7 @@ add_new_elt:
     next_elt->key = apr_pstrdup(t->a.pool, key);
     next_elt->val = apr_pstrdup(t->a.pool, val);
     next_elt->key_checksum = checksum;
+    table_hindex_add(t, t->a.nelts - 1);
 }
 
 APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
@@ -758,6 +1680,8 @@ APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
     }
 #endif
 
+    TABLE_OWN(t);
+    table_check_index(t);
     COMPUTE_KEY_CHECKSUM(key, checksum);
     hash = TABLE_HASH(key);
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
@@ -767,6 +1691,13 @@ APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
     }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
+    if (TABLE_HINDEX_USED(t)) {
+        int i = table_hindex_find(t, key);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+    }
 
     for (; next_elt <= end_elt; next_elt++) {
 	if ((checksum == next_elt->key_checksum) &&
@@ -785,6 +1716,7 @@ add_new_elt:
     next_elt->key = (char *)key;
     next_elt->val = (char *)val;
     next_elt->key_checksum = checksum;
+    table_hindex_add(t, t->a.nelts - 1);
 }
 
 APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
@@ -794,6 +1726,8 @@ APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
     apr_uint32_t checksum;
     int hash;
 
+    TABLE_OWN(t);
+    table_check_index(t);
     hash = TABLE_HASH(key);
     t->index_last[hash] = t->a.nelts;
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
@@ -805,6 +1739,7 @@ APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
     elts->key = apr_pstrdup(t->a.pool, key);
     elts->val = apr_pstrdup(t->a.pool, val);
     elts->key_checksum = checksum;
+    table_hindex_add(t, t->a.nelts - 1);
 }
 
 APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
@@ -827,6 +1762,8 @@ APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
     }
 #endif
 
+    TABLE_OWN(t);
+    table_check_index(t);
     hash = TABLE_HASH(key);
     t->index_last[hash] = t->a.nelts;
     if (!TABLE_INDEX_IS_INITIALIZED(t, hash)) {
@@ -838,6 +1775,60 @@ APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
     elts->key = (char *)key;
     elts->val = (char *)val;
     elts->key_checksum = checksum;
+    table_hindex_add(t, t->a.nelts - 1);
+}
+
+APR_DECLARE(void) apr_table_addn_bulk(apr_table_t *t,
+                                      const apr_table_pair_t *pairs,
+                                      int npairs, unsigned int flags)
+{
+    apr_table_entry_t *elts;
+    const int n = t->a.nelts;
+    int i;
+
+    if (npairs <= 0) {
+        return;
+    }
+    TABLE_OWN(t);
+
+#if APR_POOL_DEBUG
+    for (i = 0; i < npairs; i++) {
+	if (!apr_pool_is_ancestor(apr_pool_find(pairs[i].key), t->a.pool)) {
+	    fprintf(stderr, "apr_table_addn_bulk: key not in ancestor pool of t\n");
+	    abort();
+	}
+	if (!apr_pool_is_ancestor(apr_pool_find(pairs[i].val), t->a.pool)) {
+	    fprintf(stderr, "apr_table_addn_bulk: val not in ancestor pool of t\n");
+	    abort();
+	}
+    }
+#endif
+
+    /* Make room for all the pairs at once */
+    if (n + npairs > t->a.nalloc) {
+        int new_size = (t->a.nalloc <= 0) ? 1 : t->a.nalloc * 2;
+        if (new_size < n + npairs) {
+            new_size = n + npairs;
+        }
+        array_realloc(&t->a, new_size, 0);
+    }
+
+    elts = (apr_table_entry_t *) t->a.elts + n;
+    for (i = 0; i < npairs; i++, elts++) {
+        elts->key = (char *)pairs[i].key;
+        elts->val = (char *)pairs[i].val;
+        COMPUTE_KEY_CHECKSUM(elts->key, elts->key_checksum);
+    }
+    t->a.nelts += npairs;
+
+    if (flags & APR_TABLE_BULK_LAZY) {
+        if (t->lazy < 0) {
+            t->lazy = n;
+        }
+    }
+    else {
+        table_index_tail(t, t->lazy < 0 ? n : t->lazy);
+    }
 }
 
 APR_DECLARE(apr_table_t *) apr_table_overlay(apr_pool_t *p,
@@ -868,6 +1859,8 @@ APR_DECLARE(apr_table_t *) apr_table_overlay(apr_pool_t *p,
     res->a.pool = p;
     copy_array_hdr_core(&res->a, &overlay->a);
     apr_array_cat(&res->a, &base->a);
+    res->hindex = NULL;
+    res->shared = 0;
     table_reindex(res);
     return res;
 }
@@ -965,6 +1958,8 @@ APR_DECLARE(int) apr_table_vdo(apr_table_do_callback_fn_t *comp,
     apr_table_entry_t *elts = (apr_table_entry_t *) t->a.elts;
     int vdorv = 1;
 
+    table_check_index(t);
+
     argp = va_arg(vp, char *);
     do {
         int rv = 1, i;
@@ -974,8 +1969,13 @@ APR_DECLARE(int) apr_table_vdo(apr_table_do_callback_fn_t *comp,
             if (TABLE_INDEX_IS_INITIALIZED(t, hash)) {
                 apr_uint32_t checksum;
                 COMPUTE_KEY_CHECKSUM(argp, checksum);
-                for (i = t->index_first[hash];
-                     rv && (i <= t->index_last[hash]); ++i) {
+                i = t->index_first[hash];
+                if (TABLE_HINDEX_USED(t)) {
+                    /* skip to the first match, if any */
+                    int first = table_hindex_find(t, argp);
+                    i = (first < 0) ? t->index_last[hash] + 1 : first;
+                }
+                for (; rv && (i <= t->index_last[hash]); ++i) {
                     if (elts[i].key && (checksum == elts[i].key_checksum) &&
                                         !strcasecmp(elts[i].key, argp)) {
                         rv = (*comp) (rec, elts[i].key, elts[i].val);
@@ -1093,6 +2093,70 @@ static apr_table_entry_t **table_mergesort(apr_pool_t *pool,
     return values;
 }
 
+/*
+ * Linear time alternative to sorting for apr_table_compress(): the hashed
+ * index gives the first entry of each key, so the duplicates are chained
+ * to it in the order of the table. Returns whether any was found.
+ */
+static int table_hindex_compress(apr_table_t *t, unsigned flags)
+{
+    apr_table_entry_t *elts = (apr_table_entry_t *)t->a.elts;
+    const int n = t->a.nelts;
+    int *next, *last;
+    int i, j, dups_found = 0;
+
+    next = apr_palloc(t->a.pool, 2 * n * sizeof(int));
+    last = next + n;
+    for (i = 0; i < n; i++) {
+        int first = table_hindex_find(t, elts[i].key);
+        next[i] = -1;
+        if (first == i) {
+            last[i] = i;
+        }
+        else {
+            next[last[first]] = i;
+            last[first] = i;
+            dups_found = 1;
+        }
+    }
+    if (!dups_found) {
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (next[i] < 0 || !elts[i].key) {
+            continue;
+        }
+        if (flags == APR_OVERLAP_TABLES_MERGE) {
+            apr_size_t len = 0;
+            char *new_val;
+            char *val_dst;
+            for (j = i; j >= 0; j = next[j]) {
+                len += strlen(elts[j].val);
+                len += 2; /* for ", " or trailing null */
+            }
+            new_val = (char *)apr_palloc(t->a.pool, len);
+            val_dst = new_val;
+            for (j = i; j >= 0; j = next[j]) {
+                if (j != i) {
+                    *val_dst++ = ',';
+                    *val_dst++ = ' ';
+                }
+                strcpy(val_dst, elts[j].val);
+                val_dst += strlen(elts[j].val);
+            }
+            elts[i].val = new_val;
+        }
+        else { /* overwrite */
+            elts[i].val = elts[last[i]].val;
+        }
+        for (j = next[i]; j >= 0; j = next[j]) {
+            elts[j].key = NULL;
+        }
+    }
+    return 1;
+}
+
 APR_DECLARE(void) apr_table_compress(apr_table_t *t, unsigned flags)
 {
     apr_table_entry_t **sort_array;
@@ -1111,6 +2175,13 @@ APR_DECLARE(void) apr_table_compress(apr_table_t *t, unsigned flags)
         return;
     }
 
+    TABLE_OWN(t);
+    table_check_index(t);
+    if (TABLE_HINDEX_USED(t)) {
+        dups_found = table_hindex_compress(t, flags);
+        goto shift_elts;
+    }
+
     /* Copy pointers to all the table elements into an
      * array and sort to allow for easy detection of
      * duplicate keys
@@ -1188,6 +2259,7 @@ APR_DECLARE(void) apr_table_compress(apr_table_t *t, unsigned flags)
         }
     }
 
+shift_elts:
     /* Shift elements to the left to fill holes left by removing duplicates */
     if (dups_found) {
         apr_table_entry_t *src = (apr_table_entry_t *)t->a.elts;
@@ -1209,8 +2281,15 @@ static void apr_table_cat(apr_table_t *t, const apr_table_t *s)
     const int n = t->a.nelts;
     register int idx;
 
+    TABLE_OWN(t);
+    table_check_index(t);
+    table_check_index(s);
     apr_array_cat(&t->a,&s->a);
 
+    for (idx = n; idx < t->a.nelts; ++idx) {
+        table_hindex_add(t, idx);
+    }
+
     if (n == 0) {
         memcpy(t->index_first,s->index_first,sizeof(int) * TABLE_HASH_SIZE);
         memcpy(t->index_last, s->index_last, sizeof(int) * TABLE_HASH_SIZE);
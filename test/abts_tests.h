@@ -78,6 +78,8 @@ const struct testlist {
     {testbase64},
     {testmd4},
     {testmd5},
+    {testsha},
+    {testcrc32},
     {testcrypto},
     {testdbd},
     {testdate},
@@ -88,9 +90,26 @@ const struct testlist {
     {testrmm},
     {testdbm},
     {testqueue},
+    {testthreadpool},
+    {testreactor},
+    {testfiber},
+    {testresolver},
+    {testnearcache},
+    {testcache},
+    {testbloom},
+    {teststatcache},
+    {testfileappender},
+    {testutf8},
+    {testepoch},
+    {testcounter},
+    {testshmhash},
+    {testshmring},
+    {teststrbuf},
     {testreslist},
     {testlfsabi},
     {testskiplist},
+    {testheap},
+    {testhamt},
     {testsiphash},
     {testjson},
     {testjose}
@@ -0,0 +1,555 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* bench.c
+ * This program times the core data structures (pools, hash tables,
+ * tables, skip lists, queues, the thread pool) and the string matching,
+ * base64 and JSON codecs.  Each benchmark is run a few times to warm up,
+ * then repeatedly, and the percentiles of the time per operation over
+ * the repetitions are printed, as text or JSON, so that runs before and
+ * after a change can be compared.
+ *
+ * To run,
+ *
+ *   ./bench [-c percent] [-r repetitions] [-w warmups] [-f benchmark] [-j]
+ *
+ * where percent scales the number of iterations of each repetition (100
+ * by default), benchmark selects the benchmarks whose name starts with
+ * it, and -j prints JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apr.h"
+#include "apr_atomic.h"
+#include "apr_buckets.h"
+#include "apr_encode.h"
+#include "apr_getopt.h"
+#include "apr_general.h"
+#include "apr_hash.h"
+#include "apr_json.h"
+#include "apr_queue.h"
+#include "apr_skiplist.h"
+#include "apr_strings.h"
+#include "apr_strmatch.h"
+#include "apr_tables.h"
+#include "apr_thread_pool.h"
+#include "apr_time.h"
+
+#define NKEYS 4096
+
+typedef struct bench_t {
+    const char *name;
+    /* Runs the benchmark iters times, returning the number of operations
+     * and bytes processed */
+    apr_status_t (*func)(apr_pool_t *p, long iters,
+                         apr_uint64_t *ops, apr_uint64_t *bytes);
+    long iters;
+} bench_t;
+
+static const char *keys[NKEYS];
+static int ints[NKEYS];
+
+static apr_status_t bench_pool_palloc(apr_pool_t *p, long iters,
+                                      apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_pool_t *sub;
+    long i;
+    int j;
+
+    apr_pool_create(&sub, p);
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < 1024; j++) {
+            apr_size_t n = 16 + (j % 16) * 8;
+
+            if (!apr_palloc(sub, n)) {
+                return APR_ENOMEM;
+            }
+            *bytes += n;
+        }
+        apr_pool_clear(sub);
+        *ops += j;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_pool_clear(apr_pool_t *p, long iters,
+                                     apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_pool_t *sub;
+    long i;
+    int j;
+
+    apr_pool_create(&sub, p);
+    for (i = 0; i < iters; i++) {
+        /* A few blocks each time, like a request */
+        for (j = 0; j < 4; j++) {
+            apr_palloc(sub, 8000);
+        }
+        apr_pool_clear(sub);
+        *ops += 1;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_pool_create(apr_pool_t *p, long iters,
+                                      apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_pool_t *sub;
+    long i;
+
+    for (i = 0; i < iters; i++) {
+        if (apr_pool_create(&sub, p) != APR_SUCCESS) {
+            return APR_ENOMEM;
+        }
+        apr_pool_destroy(sub);
+        *ops += 1;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_hash(apr_pool_t *p, long iters,
+                               apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_hash_t *h = apr_hash_make(p);
+    long i;
+    int j;
+
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < NKEYS; j++) {
+            apr_hash_set(h, keys[j], APR_HASH_KEY_STRING, keys[j]);
+        }
+        for (j = 0; j < NKEYS; j++) {
+            if (apr_hash_get(h, keys[j], APR_HASH_KEY_STRING) != keys[j]) {
+                return APR_EGENERAL;
+            }
+        }
+        apr_hash_clear(h);
+        *ops += 2 * NKEYS;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_table(apr_pool_t *p, long iters,
+                                apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    static const char *const names[] = {
+        "Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+        "Connection", "Cookie", "Cache-Control", "Referer", "Content-Type",
+        "Content-Length", "If-Modified-Since", "If-None-Match", "Origin",
+        "X-Forwarded-For", "Authorization"
+    };
+    apr_table_t *t = apr_table_make(p, 16);
+    long i;
+    int j;
+
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < 16; j++) {
+            apr_table_addn(t, names[j], "value");
+        }
+        for (j = 0; j < 16; j++) {
+            if (!apr_table_get(t, names[15 - j])) {
+                return APR_EGENERAL;
+            }
+        }
+        apr_table_clear(t);
+        *ops += 32;
+    }
+
+    return APR_SUCCESS;
+}
+
+static int int_compare(void *a, void *b)
+{
+    int x = *(int *)a, y = *(int *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+static apr_status_t bench_skiplist(apr_pool_t *p, long iters,
+                                   apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_skiplist *sl;
+    apr_status_t rv;
+    long i;
+    int j;
+
+    if ((rv = apr_skiplist_init(&sl, p)) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_skiplist_set_compare(sl, int_compare, int_compare);
+
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < NKEYS; j++) {
+            if (!apr_skiplist_insert(sl, &ints[j])) {
+                return APR_EGENERAL;
+            }
+        }
+        for (j = 0; j < NKEYS; j++) {
+            if (!apr_skiplist_find(sl, &ints[NKEYS - 1 - j], NULL)) {
+                return APR_EGENERAL;
+            }
+        }
+        apr_skiplist_remove_all(sl, NULL);
+        *ops += 2 * NKEYS;
+    }
+
+    return APR_SUCCESS;
+}
+
+#if APR_HAS_THREADS
+static apr_status_t bench_queue(apr_pool_t *p, long iters,
+                                apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_queue_t *q;
+    apr_status_t rv;
+    void *data;
+    long i;
+    int j;
+
+    if ((rv = apr_queue_create(&q, 1024, p)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < 1024; j++) {
+            if ((rv = apr_queue_trypush(q, &ints[j])) != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        for (j = 0; j < 1024; j++) {
+            if ((rv = apr_queue_trypop(q, &data)) != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        *ops += 2 * 1024;
+    }
+
+    return apr_queue_term(q);
+}
+
+static volatile apr_uint32_t tasks_done;
+
+static void *APR_THREAD_FUNC count_task(apr_thread_t *thd, void *data)
+{
+    apr_atomic_inc32(&tasks_done);
+    return NULL;
+}
+
+static apr_status_t bench_thread_pool(apr_pool_t *p, long iters,
+                                      apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_thread_pool_t *tp;
+    apr_status_t rv;
+    long i;
+    int j;
+
+    if ((rv = apr_thread_pool_create(&tp, 4, 4, p)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < iters; i++) {
+        apr_atomic_set32(&tasks_done, 0);
+        for (j = 0; j < 256; j++) {
+            rv = apr_thread_pool_push(tp, count_task, NULL,
+                                      APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        while (apr_atomic_read32(&tasks_done) < 256) {
+            apr_thread_yield();
+        }
+        *ops += 256;
+    }
+
+    return apr_thread_pool_destroy(tp);
+}
+#endif /* APR_HAS_THREADS */
+
+static apr_status_t bench_strmatch(apr_pool_t *p, long iters,
+                                   apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    static const char needle[] = "Content-Disposition";
+    const apr_strmatch_pattern *pattern;
+    char *text = apr_palloc(p, 65536);
+    long i;
+    int j;
+
+    /* The needle is only found at the end */
+    for (j = 0; j < 65536; j++) {
+        text[j] = "Content-Type: text/plain\r\n"[j % 26];
+    }
+    memcpy(text + 65536 - sizeof(needle), needle, sizeof(needle));
+
+    for (j = 0; j < 2; j++) {
+        pattern = apr_strmatch_precompile(p, needle, !j);
+        for (i = 0; i < iters; i++) {
+            if (!apr_strmatch(pattern, text, 65535)) {
+                return APR_EGENERAL;
+            }
+            *ops += 1;
+            *bytes += 65535;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_base64(apr_pool_t *p, long iters,
+                                 apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    /* Room for the NUL terminators too */
+    char *src = apr_palloc(p, 49153), *enc = apr_palloc(p, 65537);
+    apr_size_t len;
+    apr_status_t rv;
+    long i;
+    int j;
+
+    for (j = 0; j < 49152; j++) {
+        src[j] = (char)(j * 131 + (j >> 8));
+    }
+
+    for (i = 0; i < iters; i++) {
+        rv = apr_encode_base64(enc, src, 49152, APR_ENCODE_NONE, &len);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        rv = apr_decode_base64(src, enc, len, APR_ENCODE_NONE, &len);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        *ops += 2;
+        *bytes += 2 * 49152;
+    }
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_json(apr_pool_t *p, long iters,
+                               apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_json_value_t *json;
+    apr_pool_t *sub;
+    apr_off_t offset;
+    apr_status_t rv;
+    const char *doc = "[";
+    apr_size_t len;
+    long i;
+    int j;
+
+    /* Objects as found in APIs, with strings needing no escapes mostly */
+    for (j = 0; j < 256; j++) {
+        doc = apr_psprintf(p, "%s%s{\"id\": %d, \"name\": \"item %d\", "
+                           "\"path\": \"/a/b/c\\/d\", \"tags\": [\"x\", "
+                           "\"y\"], \"value\": %d.5, \"ok\": true, "
+                           "\"next\": null}", doc, j ? ", " : "", j, j, j);
+    }
+    doc = apr_pstrcat(p, doc, "]", NULL);
+    len = strlen(doc);
+
+    apr_pool_create(&sub, p);
+    for (i = 0; i < iters; i++) {
+        rv = apr_json_decode(&json, doc, len, &offset, APR_JSON_FLAGS_NONE,
+                             10, sub);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        rv = apr_json_encode(bb, NULL, NULL, json, APR_JSON_FLAGS_NONE, sub);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        apr_brigade_cleanup(bb);
+        apr_pool_clear(sub);
+        *ops += 2;
+        *bytes += 2 * len;
+    }
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    return APR_SUCCESS;
+}
+
+static bench_t benchmarks[] = {
+    { "pool_palloc",        bench_pool_palloc,        1000 },
+    { "pool_clear",         bench_pool_clear,         100000 },
+    { "pool_create",        bench_pool_create,        100000 },
+    { "hash",               bench_hash,               100 },
+    { "table",              bench_table,              20000 },
+    { "skiplist",           bench_skiplist,           20 },
+#if APR_HAS_THREADS
+    { "queue",              bench_queue,              500 },
+    { "thread_pool",        bench_thread_pool,        100 },
+#endif
+    { "strmatch",           bench_strmatch,           200 },
+    { "base64",             bench_base64,             200 },
+    { "json",               bench_json,               50 },
+    { NULL }
+};
+
+static int double_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* Nearest rank percentile of the sorted samples */
+static double percentile(const double *samples, int n, int pct)
+{
+    int rank = (n * pct + 99) / 100;
+
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_pool_t *pool, *p;
+    apr_getopt_t *opt;
+    const char *optarg, *filter = NULL;
+    char optchar, errmsg[200];
+    apr_status_t rv;
+    long scale = 100;
+    int reps = 10, warmups = 2, json = 0, first = 1, r;
+    double *samples;
+    bench_t *b;
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS) {
+        exit(-1);
+    }
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    while ((rv = apr_getopt(opt, "c:r:w:f:j", &optchar,
+                            &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            scale = atol(optarg);
+        }
+        else if (optchar == 'r') {
+            reps = atoi(optarg);
+        }
+        else if (optchar == 'w') {
+            warmups = atoi(optarg);
+        }
+        else if (optchar == 'f') {
+            filter = optarg;
+        }
+        else if (optchar == 'j') {
+            json = 1;
+        }
+    }
+    if ((rv != APR_SUCCESS && rv != APR_EOF) || scale <= 0 || reps <= 0
+            || warmups < 0) {
+        fprintf(stderr, "usage: %s [-c percent] [-r repetitions] "
+                "[-w warmups] [-f benchmark] [-j]\n", argv[0]);
+        exit(-1);
+    }
+
+    for (r = 0; r < NKEYS; r++) {
+        keys[r] = apr_psprintf(pool, "key-%d", r);
+        ints[r] = (r * 2654435761u) % 1000003;
+    }
+    samples = apr_palloc(pool, reps * sizeof(double));
+
+    if (json) {
+        printf("{\"scale\": %ld, \"repetitions\": %d, \"benchmarks\": [",
+               scale, reps);
+    }
+    else {
+        printf("APR Microbenchmarks\n==============\n\n");
+        printf("%-14s %12s %10s %10s %10s %10s %10s\n", "benchmark", "ops",
+               "min ns/op", "p50", "p90", "p99", "p50 MB/s");
+    }
+
+    for (b = benchmarks; b->name; b++) {
+        apr_uint64_t ops = 0, bytes = 0;
+        long iters = b->iters * scale / 100;
+        double mbs;
+
+        if (filter && strncmp(b->name, filter, strlen(filter)) != 0) {
+            continue;
+        }
+
+        for (r = -warmups; r < reps; r++) {
+            apr_uint64_t rops = 0, rbytes = 0;
+            apr_time_t start, elapsed;
+
+            apr_pool_create(&p, pool);
+            start = apr_time_now();
+            rv = b->func(p, iters > 0 ? iters : 1, &rops, &rbytes);
+            elapsed = apr_time_now() - start;
+            apr_pool_destroy(p);
+
+            if (rv != APR_SUCCESS) {
+                fprintf(stderr, "%s failed: [%d] %s\n", b->name,
+                        rv, apr_strerror(rv, errmsg, sizeof errmsg));
+                exit(-2);
+            }
+            if (r < 0) {
+                continue;
+            }
+            samples[r] = (double)elapsed * 1000.0 / (double)(rops ? rops : 1);
+            ops = rops;
+            bytes = rbytes;
+        }
+        qsort(samples, reps, sizeof(double), double_compare);
+
+        /* Throughput at the median time per operation */
+        mbs = 0;
+        if (bytes && ops && percentile(samples, reps, 50) > 0) {
+            mbs = (double)bytes / (double)ops * 1000.0
+                  / percentile(samples, reps, 50);
+        }
+
+        if (json) {
+            printf("%s\n  {\"name\": \"%s\", \"ops\": %" APR_UINT64_T_FMT
+                   ", \"ns_per_op\": {\"min\": %.2f, \"p50\": %.2f, "
+                   "\"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}, "
+                   "\"mb_per_s\": %.1f}", first ? "" : ",", b->name, ops,
+                   samples[0], percentile(samples, reps, 50),
+                   percentile(samples, reps, 90),
+                   percentile(samples, reps, 99), samples[reps - 1], mbs);
+        }
+        else {
+            printf("%-14s %12" APR_UINT64_T_FMT " %10.1f %10.1f %10.1f "
+                   "%10.1f %10.1f\n", b->name, ops, samples[0],
+                   percentile(samples, reps, 50),
+                   percentile(samples, reps, 90),
+                   percentile(samples, reps, 99), mbs);
+        }
+        first = 0;
+    }
+
+    if (json) {
+        printf("\n]}\n");
+    }
+    return 0;
+}
@@ -0,0 +1,364 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* bucketperf.c
+ * This program times the common bucket and brigade operations, and
+ * prints the time per operation and the throughput of each, so that
+ * changes to the bucket allocator or bucket types can be compared.
+ *
+ * To run,
+ *
+ *   ./bucketperf [-c percent] [-f benchmark]
+ *
+ * where percent scales the number of iterations (100 by default), and
+ * benchmark selects the benchmarks whose name starts with it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apr.h"
+#include "apr_buckets.h"
+#include "apr_file_io.h"
+#include "apr_getopt.h"
+#include "apr_general.h"
+#include "apr_strings.h"
+#include "apr_time.h"
+
+#define FILE_SIZE (4 * 1024 * 1024)
+
+typedef struct bench_t {
+    const char *name;
+    /* Runs the benchmark iters times, returning the number of operations
+     * and bytes processed */
+    apr_status_t (*func)(apr_pool_t *p, long iters,
+                         apr_uint64_t *ops, apr_uint64_t *bytes);
+    long iters;
+} bench_t;
+
+static const char *datafile;
+
+static apr_status_t bench_brigade_write(apr_pool_t *p, long iters,
+                                        apr_uint64_t *ops,
+                                        apr_uint64_t *bytes)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    static const char chunk[64] = "0123456789abcdef0123456789abcdef"
+                                  "0123456789abcdef0123456789abcde\n";
+    apr_status_t rv;
+    long i;
+    int j;
+
+    for (i = 0; i < iters; i++) {
+        /* 1MB in each brigade */
+        for (j = 0; j < 16384; j++) {
+            rv = apr_brigade_write(bb, NULL, NULL, chunk, sizeof(chunk));
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+        apr_brigade_cleanup(bb);
+        *ops += j;
+        *bytes += j * sizeof(chunk);
+    }
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_brigade_split_line(apr_pool_t *p, long iters,
+                                             apr_uint64_t *ops,
+                                             apr_uint64_t *bytes)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_bucket_brigade *line = apr_brigade_create(p, ba);
+    char *data = apr_palloc(p, 65536);
+    apr_status_t rv;
+    apr_off_t len;
+    long i;
+    int j;
+
+    /* Lines of 1 to 256 bytes */
+    for (j = 0; j < 65536; j++) {
+        data[j] = (j * 31 % 256) == 0 ? '\n' : 'a' + j % 26;
+    }
+    data[65535] = '\n';
+
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < 65536; j += 8000) {
+            APR_BRIGADE_INSERT_TAIL(bb,
+                    apr_bucket_immortal_create(data + j,
+                                               j + 8000 < 65536 ? 8000
+                                                                : 65536 - j,
+                                               ba));
+        }
+        while (!APR_BRIGADE_EMPTY(bb)) {
+            rv = apr_brigade_split_line(line, bb, APR_BLOCK_READ, 8192);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            apr_brigade_length(line, 0, &len);
+            apr_brigade_cleanup(line);
+            *ops += 1;
+            *bytes += len;
+        }
+    }
+
+    apr_brigade_destroy(line);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_brigade_flatten(apr_pool_t *p, long iters,
+                                          apr_uint64_t *ops,
+                                          apr_uint64_t *bytes)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    char *data = apr_pcalloc(p, 65536), *buf = apr_palloc(p, 65536);
+    apr_size_t len;
+    apr_status_t rv;
+    long i;
+    int j;
+
+    /* 64KB in buckets of 16 to 2048 bytes */
+    for (j = 0; j < 65536; ) {
+        apr_size_t n = 16 << (j % 8);
+
+        if (n > (apr_size_t)(65536 - j)) {
+            n = 65536 - j;
+        }
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create(data + j, n,
+                                                               ba));
+        j += n;
+    }
+
+    for (i = 0; i < iters; i++) {
+        len = 65536;
+        rv = apr_brigade_flatten(bb, buf, &len);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        *ops += 1;
+        *bytes += len;
+    }
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_bucket_alloc(apr_pool_t *p, long iters,
+                                       apr_uint64_t *ops,
+                                       apr_uint64_t *bytes)
+{
+    static const apr_size_t sizes[] = {
+        32, 64, 128, 512, 2048, 8000, 16384, 65536
+    };
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    void *blocks[64];
+    long i;
+    int j;
+
+    for (i = 0; i < iters; i++) {
+        /* Keep a few blocks alive across the frees, like brigades do */
+        for (j = 0; j < 64; j++) {
+            apr_size_t n = sizes[(i + j) % 8];
+
+            blocks[j] = apr_bucket_alloc(n, ba);
+            if (!blocks[j]) {
+                return APR_ENOMEM;
+            }
+            *bytes += n;
+        }
+        for (j = 0; j < 64; j++) {
+            apr_bucket_free(blocks[(j * 7) % 64]);
+        }
+        *ops += 64;
+    }
+
+    apr_bucket_alloc_destroy(ba);
+    return APR_SUCCESS;
+}
+
+static apr_status_t file_read(apr_pool_t *p, long iters, int enable_mmap,
+                              apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_file_t *f;
+    apr_bucket *e;
+    const char *data;
+    apr_size_t len;
+    apr_status_t rv;
+    long i;
+
+    rv = apr_file_open(&f, datafile, APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < iters; i++) {
+        e = apr_brigade_insert_file(bb, f, 0, FILE_SIZE, p);
+        apr_bucket_file_enable_mmap(e, enable_mmap);
+        while (!APR_BRIGADE_EMPTY(bb)) {
+            e = APR_BRIGADE_FIRST(bb);
+            rv = apr_bucket_read(e, &data, &len, APR_BLOCK_READ);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            *ops += 1;
+            *bytes += len;
+            apr_bucket_delete(e);
+        }
+    }
+
+    apr_file_close(f);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    return APR_SUCCESS;
+}
+
+static apr_status_t bench_file_read(apr_pool_t *p, long iters,
+                                    apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    return file_read(p, iters, 0, ops, bytes);
+}
+
+#if APR_HAS_MMAP
+static apr_status_t bench_mmap_read(apr_pool_t *p, long iters,
+                                    apr_uint64_t *ops, apr_uint64_t *bytes)
+{
+    return file_read(p, iters, 1, ops, bytes);
+}
+#endif
+
+static bench_t benchmarks[] = {
+    { "brigade_write",      bench_brigade_write,      100 },
+    { "brigade_split_line", bench_brigade_split_line, 1000 },
+    { "brigade_flatten",    bench_brigade_flatten,    20000 },
+    { "bucket_alloc",       bench_bucket_alloc,       100000 },
+    { "file_read",          bench_file_read,          100 },
+#if APR_HAS_MMAP
+    { "mmap_read",          bench_mmap_read,          100 },
+#endif
+    { NULL }
+};
+
+static apr_status_t create_datafile(apr_pool_t *p)
+{
+    apr_file_t *f;
+    char *buf = apr_palloc(p, 65536);
+    apr_status_t rv;
+    int i;
+
+    memset(buf, 'x', 65536);
+    datafile = "bucketperf.dat";
+    rv = apr_file_open(&f, datafile,
+                       APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE,
+                       APR_FPROT_OS_DEFAULT, p);
+    for (i = 0; rv == APR_SUCCESS && i < FILE_SIZE / 65536; i++) {
+        rv = apr_file_write_full(f, buf, 65536, NULL);
+    }
+    if (rv == APR_SUCCESS) {
+        rv = apr_file_close(f);
+    }
+
+    return rv;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_pool_t *pool, *p;
+    apr_getopt_t *opt;
+    const char *optarg, *filter = NULL;
+    char optchar, errmsg[200];
+    apr_status_t rv;
+    long scale = 100;
+    bench_t *b;
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS) {
+        exit(-1);
+    }
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    while ((rv = apr_getopt(opt, "c:f:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            scale = atol(optarg);
+        }
+        else if (optchar == 'f') {
+            filter = optarg;
+        }
+    }
+    if ((rv != APR_SUCCESS && rv != APR_EOF) || scale <= 0) {
+        fprintf(stderr, "usage: %s [-c percent] [-f benchmark]\n", argv[0]);
+        exit(-1);
+    }
+
+    if ((rv = create_datafile(pool)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not create the data file: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("APR Bucket Performance Test\n==============\n\n");
+    printf("%-20s %12s %12s %12s\n", "benchmark", "ops", "ns/op", "MB/s");
+
+    for (b = benchmarks; b->name; b++) {
+        apr_uint64_t ops = 0, bytes = 0;
+        apr_time_t start, elapsed;
+        long iters = b->iters * scale / 100;
+
+        if (filter && strncmp(b->name, filter, strlen(filter)) != 0) {
+            continue;
+        }
+
+        apr_pool_create(&p, pool);
+        start = apr_time_now();
+        rv = b->func(p, iters > 0 ? iters : 1, &ops, &bytes);
+        elapsed = apr_time_now() - start;
+        apr_pool_destroy(p);
+
+        if (rv != APR_SUCCESS) {
+            fprintf(stderr, "%s failed: [%d] %s\n", b->name,
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            apr_file_remove(datafile, pool);
+            exit(-2);
+        }
+        if (elapsed <= 0) {
+            elapsed = 1;
+        }
+        printf("%-20s %12" APR_UINT64_T_FMT " %12.1f %12.1f\n", b->name,
+               ops, (double)elapsed * 1000.0 / (double)(ops ? ops : 1),
+               (double)bytes / (double)elapsed);
+    }
+
+    apr_file_remove(datafile, pool);
+    return 0;
+}
@@ -0,0 +1,555 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* pollperf.c
+ * This program times an event loop server, run with apr_pollset and with
+ * apr_pollcb for each of the poll methods available, answering over the
+ * loopback the requests of a load generator: each of the connections
+ * sends a request as soon as the response to the previous one arrived,
+ * until it made its share of the requests.  It prints the throughput,
+ * the percentiles of the latency of the requests and the number of calls
+ * (poll, recv and send) the server made per request.
+ *
+ * The server echoes the requests, or answers HTTP-like requests with a
+ * response of the given size, or sends the response from a file with
+ * apr_socket_sendfile().
+ *
+ * To run,
+ *
+ *   ./pollperf [-n connections] [-m requests] [-b size] [-h | -f]
+ *
+ * where requests is the number of requests of each connection, size the
+ * size of the responses, -h selects the HTTP-like and -f the sendfile
+ * responses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apr.h"
+#include "apr_file_io.h"
+#include "apr_getopt.h"
+#include "apr_general.h"
+#include "apr_network_io.h"
+#include "apr_poll.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+
+#if !APR_HAS_THREADS
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for threads.\n");
+    return 0;
+}
+#else /* !APR_HAS_THREADS */
+
+#define DATAFILE "pollperf.dat"
+#define BUFSIZE 65536
+
+static const char http_request[] =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: pollperf\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+typedef struct conn_t {
+    apr_socket_t *sock;
+    apr_pollfd_t pfd;
+    /* Server side: the received part of the request, and what's left of
+     * the response to send; client side: the received part of the
+     * response and the requests made */
+    apr_size_t in;
+    apr_size_t out;
+    apr_off_t offset;
+    int requests;
+    apr_time_t sent;
+} conn_t;
+
+typedef struct server_t {
+    apr_pollset_t *pollset;
+    apr_pollcb_t *pollcb;
+    conn_t *conns;
+    int open;
+    apr_status_t rv;
+    apr_uint64_t calls;
+} server_t;
+
+static int num_conns = 32;
+static int num_requests = 1000;
+static apr_size_t response_len;
+static apr_size_t request_len;
+static const char *request;
+static char *response;
+static apr_file_t *datafile;
+
+static apr_status_t poll_set(server_t *s, conn_t *c, apr_int16_t reqevents)
+{
+    apr_status_t rv;
+
+    if (c->pfd.reqevents == reqevents) {
+        return APR_SUCCESS;
+    }
+    rv = s->pollset ? apr_pollset_remove(s->pollset, &c->pfd)
+                    : apr_pollcb_remove(s->pollcb, &c->pfd);
+    if (rv == APR_SUCCESS) {
+        c->pfd.reqevents = reqevents;
+        rv = s->pollset ? apr_pollset_add(s->pollset, &c->pfd)
+                        : apr_pollcb_add(s->pollcb, &c->pfd);
+    }
+    return rv;
+}
+
+/* Sends what's left of the response, polling for writability if the
+ * socket is full */
+static apr_status_t server_send(server_t *s, conn_t *c)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t len;
+
+    while (c->out) {
+        len = c->out;
+#if APR_HAS_SENDFILE
+        if (datafile) {
+            rv = apr_socket_sendfile(c->sock, datafile, NULL, &c->offset,
+                                     &len, 0);
+            c->offset += len;
+        }
+        else
+#endif
+        {
+            rv = apr_socket_send(c->sock, response + response_len - c->out,
+                                 &len);
+        }
+        s->calls++;
+        c->out -= len;
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    if (APR_STATUS_IS_EAGAIN(rv)) {
+        return poll_set(s, c, APR_POLLOUT);
+    }
+    if (rv == APR_SUCCESS) {
+        return poll_set(s, c, APR_POLLIN);
+    }
+    return rv;
+}
+
+static apr_status_t server_event(server_t *s, conn_t *c, apr_int16_t events)
+{
+    char buf[BUFSIZE];
+    apr_size_t len;
+    apr_status_t rv;
+
+    if (c->out) {
+        return server_send(s, c);
+    }
+
+    for (;;) {
+        len = sizeof(buf);
+        rv = apr_socket_recv(c->sock, buf, &len);
+        s->calls++;
+        if (APR_STATUS_IS_EAGAIN(rv)) {
+            return APR_SUCCESS;
+        }
+        if (rv == APR_EOF) {
+            s->pollset ? apr_pollset_remove(s->pollset, &c->pfd)
+                       : apr_pollcb_remove(s->pollcb, &c->pfd);
+            apr_socket_close(c->sock);
+            s->open--;
+            return APR_SUCCESS;
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        /* The client waits for the response before the next request */
+        c->in += len;
+        if (c->in >= request_len) {
+            c->in -= request_len;
+            c->out = response_len;
+            c->offset = 0;
+            return server_send(s, c);
+        }
+    }
+}
+
+static apr_status_t server_cb(void *baton, apr_pollfd_t *pfd)
+{
+    return server_event(baton, pfd->client_data, pfd->rtnevents);
+}
+
+static void * APR_THREAD_FUNC server_thread(apr_thread_t *thd, void *data)
+{
+    server_t *s = data;
+    const apr_pollfd_t *descs;
+    apr_int32_t num, i;
+    apr_status_t rv = APR_SUCCESS;
+
+    while (s->open > 0) {
+        if (s->pollset) {
+            rv = apr_pollset_poll(s->pollset, -1, &num, &descs);
+            s->calls++;
+            for (i = 0; rv == APR_SUCCESS && i < num; i++) {
+                rv = server_event(s, descs[i].client_data,
+                                  descs[i].rtnevents);
+            }
+        }
+        else {
+            rv = apr_pollcb_poll(s->pollcb, -1, server_cb, s);
+            s->calls++;
+        }
+        if (rv != APR_SUCCESS && !APR_STATUS_IS_EINTR(rv)) {
+            break;
+        }
+        rv = APR_SUCCESS;
+    }
+
+    s->rv = rv;
+    return NULL;
+}
+
+static apr_status_t client_send(conn_t *c)
+{
+    apr_size_t len = request_len;
+    apr_status_t rv;
+
+    /* The requests are small enough for the socket buffer */
+    c->sent = apr_time_now();
+    rv = apr_socket_send(c->sock, request, &len);
+    if (rv == APR_SUCCESS && len != request_len) {
+        rv = APR_EGENERAL;
+    }
+    c->requests++;
+    return rv;
+}
+
+static int time_compare(const void *a, const void *b)
+{
+    apr_time_t x = *(const apr_time_t *)a, y = *(const apr_time_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* Runs the load against a server using the given interface and method */
+static apr_status_t run(int use_pollcb, apr_pollset_method_e method,
+                        apr_pool_t *p)
+{
+    apr_socket_t *listener;
+    apr_sockaddr_t *sa;
+    apr_pollset_t *client;
+    apr_thread_t *thread;
+    conn_t *conns;
+    server_t s = { 0 };
+    const apr_pollfd_t *descs;
+    apr_time_t *latencies, start, elapsed;
+    apr_int32_t num, i;
+    apr_size_t len;
+    apr_status_t rv;
+    char buf[BUFSIZE];
+    const char *name;
+    int total = num_conns * num_requests, done = 0;
+
+    if (use_pollcb) {
+        rv = apr_pollcb_create_ex(&s.pollcb, num_conns, p,
+                                  APR_POLLSET_NODEFAULT, method);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        name = apr_pollcb_method_name(s.pollcb);
+    }
+    else {
+        rv = apr_pollset_create_ex(&s.pollset, num_conns, p,
+                                   APR_POLLSET_NODEFAULT, method);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        name = apr_pollset_method_name(s.pollset);
+    }
+    if ((rv = apr_pollset_create(&client, num_conns, p, 0)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* Connect the clients, and accept them, one at a time */
+    if ((rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0,
+                                    p)) != APR_SUCCESS
+            || (rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM,
+                                       APR_PROTO_TCP, p)) != APR_SUCCESS
+            || (rv = apr_socket_opt_set(listener, APR_SO_REUSEADDR,
+                                        1)) != APR_SUCCESS
+            || (rv = apr_socket_bind(listener, sa)) != APR_SUCCESS
+            || (rv = apr_socket_listen(listener, 16)) != APR_SUCCESS
+            || (rv = apr_socket_addr_get(&sa, APR_LOCAL,
+                                         listener)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    conns = apr_pcalloc(p, 2 * num_conns * sizeof(conn_t));
+    s.conns = conns + num_conns;
+    for (i = 0; i < num_conns; i++) {
+        conn_t *c = &conns[i], *sc = &s.conns[i];
+
+        if ((rv = apr_socket_create(&c->sock, APR_INET, SOCK_STREAM,
+                                    APR_PROTO_TCP, p)) != APR_SUCCESS
+                || (rv = apr_socket_connect(c->sock, sa)) != APR_SUCCESS
+                || (rv = apr_socket_accept(&sc->sock, listener,
+                                           p)) != APR_SUCCESS) {
+            return rv;
+        }
+        apr_socket_opt_set(c->sock, APR_TCP_NODELAY, 1);
+        apr_socket_opt_set(sc->sock, APR_TCP_NODELAY, 1);
+        apr_socket_timeout_set(c->sock, 0);
+        apr_socket_timeout_set(sc->sock, 0);
+
+        c->pfd.desc_type = APR_POLL_SOCKET;
+        c->pfd.desc.s = c->sock;
+        c->pfd.reqevents = APR_POLLIN;
+        c->pfd.client_data = c;
+        sc->pfd = c->pfd;
+        sc->pfd.desc.s = sc->sock;
+        sc->pfd.client_data = sc;
+
+        rv = apr_pollset_add(client, &c->pfd);
+        if (rv == APR_SUCCESS) {
+            rv = use_pollcb ? apr_pollcb_add(s.pollcb, &sc->pfd)
+                            : apr_pollset_add(s.pollset, &sc->pfd);
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    apr_socket_close(listener);
+    s.open = num_conns;
+
+    rv = apr_thread_create(&thread, NULL, server_thread, &s, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    latencies = apr_palloc(p, total * sizeof(apr_time_t));
+    start = apr_time_now();
+    for (i = 0; rv == APR_SUCCESS && i < num_conns; i++) {
+        rv = client_send(&conns[i]);
+    }
+
+    while (rv == APR_SUCCESS && done < total) {
+        rv = apr_pollset_poll(client, -1, &num, &descs);
+        if (APR_STATUS_IS_EINTR(rv)) {
+            rv = APR_SUCCESS;
+            continue;
+        }
+        for (i = 0; rv == APR_SUCCESS && i < num; i++) {
+            conn_t *c = descs[i].client_data;
+
+            len = sizeof(buf);
+            rv = apr_socket_recv(c->sock, buf, &len);
+            if (APR_STATUS_IS_EAGAIN(rv)) {
+                rv = APR_SUCCESS;
+                continue;
+            }
+            c->in += len;
+            if (rv == APR_SUCCESS && c->in >= response_len) {
+                c->in -= response_len;
+                latencies[done++] = apr_time_now() - c->sent;
+                if (c->requests < num_requests) {
+                    rv = client_send(c);
+                }
+            }
+        }
+    }
+    elapsed = apr_time_now() - start;
+
+    /* Closing the clients stops the server */
+    for (i = 0; i < num_conns; i++) {
+        apr_socket_close(conns[i].sock);
+    }
+    apr_thread_join(&s.rv, thread);
+    if (rv == APR_SUCCESS) {
+        rv = s.rv;
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (elapsed <= 0) {
+        elapsed = 1;
+    }
+
+    qsort(latencies, total, sizeof(apr_time_t), time_compare);
+    printf("%-8s %-8s %12.0f %10.1f %8" APR_TIME_T_FMT " %8" APR_TIME_T_FMT
+           " %8" APR_TIME_T_FMT " %10.2f\n",
+           use_pollcb ? "pollcb" : "pollset", name,
+           (double)total * APR_USEC_PER_SEC / (double)elapsed,
+           (double)total * response_len / (double)elapsed,
+           latencies[total / 2], latencies[(total * 90 - 1) / 100],
+           latencies[(total * 99 - 1) / 100],
+           (double)s.calls / (double)total);
+
+    return APR_SUCCESS;
+}
+
+static const struct {
+    apr_pollset_method_e method;
+    const char *name;
+} methods[] = {
+    { APR_POLLSET_SELECT,   "select" },
+    { APR_POLLSET_POLL,     "poll" },
+    { APR_POLLSET_KQUEUE,   "kqueue" },
+    { APR_POLLSET_PORT,     "port" },
+    { APR_POLLSET_EPOLL,    "epoll" },
+    { APR_POLLSET_AIO_MSGQ, "asio" },
+    { APR_POLLSET_IOURING,  "io_uring" }
+};
+
+int main(int argc, const char * const *argv)
+{
+    apr_pool_t *pool, *p;
+    apr_getopt_t *opt;
+    const char *optarg;
+    char optchar, errmsg[200];
+    apr_status_t rv;
+    apr_size_t size = 0;
+    int http = 0, sendfile = 0, i, j;
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS) {
+        exit(-1);
+    }
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    while ((rv = apr_getopt(opt, "n:m:b:hf", &optchar,
+                            &optarg)) == APR_SUCCESS) {
+        if (optchar == 'n') {
+            num_conns = atoi(optarg);
+        }
+        else if (optchar == 'm') {
+            num_requests = atoi(optarg);
+        }
+        else if (optchar == 'b') {
+            size = (apr_size_t)apr_atoi64(optarg);
+        }
+        else if (optchar == 'h') {
+            http = 1;
+        }
+        else if (optchar == 'f') {
+            sendfile = 1;
+        }
+    }
+    if ((rv != APR_SUCCESS && rv != APR_EOF) || num_conns <= 0
+            || num_conns > 1000 || num_requests <= 0 || (http && sendfile)
+            || (!sendfile && size > BUFSIZE)) {
+        fprintf(stderr, "usage: %s [-n connections] [-m requests] "
+                "[-b size] [-h | -f]\n", argv[0]);
+        exit(-1);
+    }
+
+    if (sendfile) {
+#if APR_HAS_SENDFILE
+        char *buf = apr_palloc(pool, BUFSIZE);
+        apr_size_t n;
+
+        response_len = size ? size : 65536;
+        memset(buf, 'x', BUFSIZE);
+        rv = apr_file_open(&datafile, DATAFILE,
+                           APR_FOPEN_READ | APR_FOPEN_WRITE
+                           | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE
+                           | APR_FOPEN_SENDFILE_ENABLED,
+                           APR_FPROT_OS_DEFAULT, pool);
+        for (n = 0; rv == APR_SUCCESS && n < response_len; n += BUFSIZE) {
+            rv = apr_file_write_full(datafile, buf,
+                                     response_len - n < BUFSIZE
+                                     ? response_len - n : BUFSIZE, NULL);
+        }
+        if (rv != APR_SUCCESS) {
+            fprintf(stderr, "Could not create the data file: [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-1);
+        }
+        request = http_request;
+        request_len = sizeof(http_request) - 1;
+#else
+        fprintf(stderr, "sendfile is not supported on this platform\n");
+        exit(-1);
+#endif
+    }
+    else if (http) {
+        const char *headers;
+
+        size = size ? size : 1024;
+        headers = apr_psprintf(pool, "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: text/plain\r\n"
+                               "Content-Length: %" APR_SIZE_T_FMT "\r\n"
+                               "\r\n", size);
+        response_len = strlen(headers) + size;
+        response = apr_palloc(pool, response_len);
+        memcpy(response, headers, strlen(headers));
+        memset(response + strlen(headers), 'x', size);
+        request = http_request;
+        request_len = sizeof(http_request) - 1;
+    }
+    else {
+        response_len = request_len = size ? size : 64;
+        response = apr_palloc(pool, response_len);
+        memset(response, 'x', response_len);
+        request = response;
+    }
+
+    printf("APR Poll Performance Test\n==============\n\n");
+    printf("%d connections, %d requests each, %s responses of %"
+           APR_SIZE_T_FMT " bytes\n\n", num_conns, num_requests,
+           sendfile ? "sendfile" : http ? "HTTP" : "echo", response_len);
+    printf("%-8s %-8s %12s %10s %8s %8s %8s %10s\n", "api", "method",
+           "requests/s", "MB/s", "p50 usec", "p90", "p99", "calls/req");
+
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+            apr_pool_create(&p, pool);
+            rv = run(j, methods[i].method, p);
+            apr_pool_destroy(p);
+
+            if (rv == APR_ENOTIMPL) {
+                continue;
+            }
+            if (rv != APR_SUCCESS) {
+                fprintf(stderr, "%s %s failed: [%d] %s\n",
+                        j ? "pollcb" : "pollset", methods[i].name,
+                        rv, apr_strerror(rv, errmsg, sizeof errmsg));
+                if (datafile) {
+                    apr_file_remove(DATAFILE, pool);
+                }
+                exit(-2);
+            }
+        }
+    }
+
+    if (datafile) {
+        apr_file_close(datafile);
+        apr_file_remove(DATAFILE, pool);
+    }
+    return 0;
+}
+
+#endif /* !APR_HAS_THREADS */
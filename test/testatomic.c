@@ -347,6 +347,120 @@ static void test_inc_neg164(abts_case *tc, void *data)
 }
 
 
+static void test_or_and32(abts_case *tc, void *data)
+{
+    apr_uint32_t y32 = 0x0f;
+    apr_uint32_t oldval;
+
+    oldval = apr_atomic_or32(&y32, 0xf0);
+    ABTS_UINT_EQUAL(tc, 0x0f, oldval);
+    ABTS_UINT_EQUAL(tc, 0xff, y32);
+
+    oldval = apr_atomic_and32(&y32, 0x3c);
+    ABTS_UINT_EQUAL(tc, 0xff, oldval);
+    ABTS_UINT_EQUAL(tc, 0x3c, y32);
+}
+
+static void test_or_and64(abts_case *tc, void *data)
+{
+    apr_uint64_t y64 = APR_UINT64_C(0x100000000);
+    apr_uint64_t oldval;
+
+    oldval = apr_atomic_or64(&y64, 1);
+    ABTS_ULLONG_EQUAL(tc, APR_UINT64_C(0x100000000), oldval);
+    ABTS_ULLONG_EQUAL(tc, APR_UINT64_C(0x100000001), y64);
+
+    oldval = apr_atomic_and64(&y64, ~APR_UINT64_C(0x100000000));
+    ABTS_ULLONG_EQUAL(tc, APR_UINT64_C(0x100000001), oldval);
+    ABTS_ULLONG_EQUAL(tc, 1, y64);
+}
+
+static void test_explicit32(abts_case *tc, void *data)
+{
+    apr_uint32_t y32;
+
+    apr_atomic_set32_explicit(&y32, 2, APR_ATOMIC_RELAXED);
+    ABTS_UINT_EQUAL(tc, 2, apr_atomic_read32_explicit(&y32, APR_ATOMIC_RELAXED));
+    apr_atomic_set32_explicit(&y32, 3, APR_ATOMIC_RELEASE);
+    ABTS_UINT_EQUAL(tc, 3, apr_atomic_read32_explicit(&y32, APR_ATOMIC_ACQUIRE));
+    apr_atomic_set32_explicit(&y32, 4, APR_ATOMIC_SEQ_CST);
+    ABTS_UINT_EQUAL(tc, 4, apr_atomic_read32_explicit(&y32, APR_ATOMIC_SEQ_CST));
+
+    ABTS_UINT_EQUAL(tc, 4, apr_atomic_add32_explicit(&y32, 1, APR_ATOMIC_RELAXED));
+    ABTS_UINT_EQUAL(tc, 5, apr_atomic_add32_explicit(&y32, 1, APR_ATOMIC_ACQ_REL));
+    ABTS_UINT_EQUAL(tc, 6, apr_atomic_read32(&y32));
+}
+
+static void test_explicit64(abts_case *tc, void *data)
+{
+    apr_uint64_t y64;
+
+    apr_atomic_set64_explicit(&y64, APR_UINT64_C(0x100000000),
+                              APR_ATOMIC_RELAXED);
+    ABTS_ULLONG_EQUAL(tc, APR_UINT64_C(0x100000000),
+                      apr_atomic_read64_explicit(&y64, APR_ATOMIC_RELAXED));
+    apr_atomic_set64_explicit(&y64, 3, APR_ATOMIC_RELEASE);
+    ABTS_ULLONG_EQUAL(tc, 3, apr_atomic_read64_explicit(&y64, APR_ATOMIC_ACQUIRE));
+
+    ABTS_ULLONG_EQUAL(tc, 3, apr_atomic_add64_explicit(&y64, 1, APR_ATOMIC_RELAXED));
+    ABTS_ULLONG_EQUAL(tc, 4, apr_atomic_read64(&y64));
+}
+
+static void test_explicitptr(abts_case *tc, void *data)
+{
+    int a = 0, b = 0;
+    void *target_ptr = NULL;
+
+    apr_atomic_setptr_explicit(&target_ptr, &a, APR_ATOMIC_RELEASE);
+    ABTS_PTR_EQUAL(tc, (void *)&a,
+                   apr_atomic_readptr_explicit(&target_ptr, APR_ATOMIC_ACQUIRE));
+    apr_atomic_setptr_explicit(&target_ptr, &b, APR_ATOMIC_SEQ_CST);
+    ABTS_PTR_EQUAL(tc, (void *)&b,
+                   apr_atomic_readptr_explicit(&target_ptr, APR_ATOMIC_RELAXED));
+}
+
+static void check_cas_tagptr(abts_case *tc, volatile apr_atomic_tagptr_t *tp)
+{
+    int a = 0, b = 0;
+    apr_atomic_tagptr_t with, cmp, old;
+
+    tp->ptr = &a;
+    tp->tag = 1;
+
+    /* Same pointer, other tag */
+    cmp.ptr = &a;
+    cmp.tag = 0;
+    with.ptr = &b;
+    with.tag = 2;
+    old = apr_atomic_cas_tagptr(tp, with, cmp);
+    ABTS_PTR_EQUAL(tc, (void *)&a, old.ptr);
+    ABTS_ASSERT(tc, "cas_tagptr returned a wrong tag", old.tag == 1);
+    ABTS_PTR_EQUAL(tc, (void *)&a, tp->ptr);
+
+    cmp.tag = 1;
+    old = apr_atomic_cas_tagptr(tp, with, cmp);
+    ABTS_PTR_EQUAL(tc, (void *)&a, old.ptr);
+    ABTS_ASSERT(tc, "cas_tagptr returned a wrong tag", old.tag == 1);
+
+    old = apr_atomic_read_tagptr(tp);
+    ABTS_PTR_EQUAL(tc, (void *)&b, old.ptr);
+    ABTS_ASSERT(tc, "read_tagptr returned a wrong tag", old.tag == 2);
+}
+
+static void test_cas_tagptr(abts_case *tc, void *data)
+{
+    char *mem = apr_palloc(p, 3 * sizeof(apr_atomic_tagptr_t));
+    apr_atomic_tagptr_t *tp;
+
+    tp = (apr_atomic_tagptr_t *)APR_ALIGN((apr_uintptr_t)mem,
+                                          sizeof(apr_atomic_tagptr_t));
+    check_cas_tagptr(tc, tp);
+
+    /* Not aligned on its size, as with the pool's default alignment */
+    tp = (apr_atomic_tagptr_t *)((char *)tp + sizeof(void *));
+    check_cas_tagptr(tc, tp);
+}
+
 #if APR_HAS_THREADS
 
 void *APR_THREAD_FUNC thread_func_mutex(apr_thread_t *thd, void *data);
@@ -913,6 +1027,118 @@ static void test_atomics_threaded_setread64(abts_case *tc, void *data)
     apr_thread_join(&retval, thread);
 }
 
+static apr_uint32_t atomic_bits;
+
+static void *APR_THREAD_FUNC thread_func_bits(apr_thread_t *thd, void *data)
+{
+    apr_uint32_t bit = 1u << *(int *)data;
+    apr_status_t rv = APR_SUCCESS;
+    int i;
+
+    for (i = 0; i < NUM_ITERATIONS; i++) {
+        if (apr_atomic_or32(&atomic_bits, bit) & bit) {
+            rv = APR_EGENERAL;
+        }
+        if (!(apr_atomic_and32(&atomic_bits, ~bit) & bit)) {
+            rv = APR_EGENERAL;
+        }
+    }
+
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_atomics_threaded_bits(abts_case *tc, void *data)
+{
+    apr_thread_t *thread[NUM_THREADS];
+    int bits[NUM_THREADS];
+    apr_status_t rv;
+    int i;
+
+    atomic_bits = 0;
+    for (i = 0; i < NUM_THREADS; i++) {
+        bits[i] = i;
+        rv = apr_thread_create(&thread[i], NULL, thread_func_bits, &bits[i], p);
+        ABTS_ASSERT(tc, "Failed creating thread", rv == APR_SUCCESS);
+    }
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        apr_status_t retval;
+        rv = apr_thread_join(&retval, thread[i]);
+        ABTS_ASSERT(tc, "Thread join failed", rv == APR_SUCCESS);
+        ABTS_ASSERT(tc, "A bit changed under its owner", retval == APR_SUCCESS);
+    }
+
+    ABTS_UINT_EQUAL(tc, 0, apr_atomic_read32(&atomic_bits));
+}
+
+/* Each swap moves the pointer between two objects and increments the tag,
+ * such that no update may be lost unless the pair is torn.
+ */
+static int tagptr_objs[2];
+
+static void *APR_THREAD_FUNC thread_func_tagptr(apr_thread_t *thd, void *data)
+{
+    volatile apr_atomic_tagptr_t *tp = data;
+    int i;
+
+    for (i = 0; i < NUM_ITERATIONS; i++) {
+        apr_atomic_tagptr_t cmp = apr_atomic_read_tagptr(tp), with, old;
+
+        for (;;) {
+            with.ptr = &tagptr_objs[(cmp.tag + 1) % 2];
+            with.tag = cmp.tag + 1;
+            old = apr_atomic_cas_tagptr(tp, with, cmp);
+            if (old.ptr == cmp.ptr && old.tag == cmp.tag) {
+                break;
+            }
+            cmp = old;
+        }
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void check_threaded_tagptr(abts_case *tc, volatile apr_atomic_tagptr_t *tp)
+{
+    apr_thread_t *thread[NUM_THREADS];
+    apr_atomic_tagptr_t last;
+    apr_status_t rv;
+    int i;
+
+    tp->ptr = &tagptr_objs[0];
+    tp->tag = 0;
+    for (i = 0; i < NUM_THREADS; i++) {
+        rv = apr_thread_create(&thread[i], NULL, thread_func_tagptr,
+                               (void *)tp, p);
+        ABTS_ASSERT(tc, "Failed creating thread", rv == APR_SUCCESS);
+    }
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        apr_status_t retval;
+        rv = apr_thread_join(&retval, thread[i]);
+        ABTS_ASSERT(tc, "Thread join failed", rv == APR_SUCCESS);
+    }
+
+    last = apr_atomic_read_tagptr(tp);
+    ABTS_ASSERT(tc, "Lost tagged pointer updates",
+                last.tag == NUM_THREADS * NUM_ITERATIONS);
+    ABTS_PTR_EQUAL(tc, (void *)&tagptr_objs[last.tag % 2], last.ptr);
+}
+
+static void test_atomics_threaded_tagptr(abts_case *tc, void *data)
+{
+    char *mem = apr_palloc(p, 3 * sizeof(apr_atomic_tagptr_t));
+    apr_atomic_tagptr_t *tp;
+
+    tp = (apr_atomic_tagptr_t *)APR_ALIGN((apr_uintptr_t)mem,
+                                          sizeof(apr_atomic_tagptr_t));
+    check_threaded_tagptr(tc, tp);
+    check_threaded_tagptr(tc, (apr_atomic_tagptr_t *)((char *)tp
+                                                      + sizeof(void *)));
+}
+
 #endif /* !APR_HAS_THREADS */
 
 abts_suite *testatomic(abts_suite *suite)
@@ -947,6 +1173,12 @@ abts_suite *testatomic(abts_suite *suite)
     abts_run_test(suite, test_set_add_inc_sub64, NULL);
     abts_run_test(suite, test_wrap_zero64, NULL);
     abts_run_test(suite, test_inc_neg164, NULL);
+    abts_run_test(suite, test_or_and32, NULL);
+    abts_run_test(suite, test_or_and64, NULL);
+    abts_run_test(suite, test_explicit32, NULL);
+    abts_run_test(suite, test_explicit64, NULL);
+    abts_run_test(suite, test_explicitptr, NULL);
+    abts_run_test(suite, test_cas_tagptr, NULL);
 
 #if APR_HAS_THREADS
     abts_run_test(suite, test_atomics_threaded, NULL);
@@ -954,6 +1186,8 @@ abts_suite *testatomic(abts_suite *suite)
     abts_run_test(suite, test_atomics_busyloop_threaded, NULL);
     abts_run_test(suite, test_atomics_busyloop_threaded64, NULL);
     abts_run_test(suite, test_atomics_threaded_setread64, NULL);
+    abts_run_test(suite, test_atomics_threaded_bits, NULL);
+    abts_run_test(suite, test_atomics_threaded_tagptr, NULL);
 #endif
 
     return suite;
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "apr_base64.h"
+#include "apr_encode.h"
 
 #include "abts.h"
 #include "testutil.h"
@@ -74,11 +75,41 @@ static void test_base64(abts_case *tc, void *data)
     }
 }
 
+static void test_base64_long(abts_case *tc, void *data)
+{
+    unsigned char orig[500], dec[500];
+    char enc[700];
+    int i, len;
+
+    for (i = 0; i < (int)sizeof(orig); i++) {
+        orig[i] = (unsigned char)(i * 7 + (i >> 3));
+    }
+
+    /* the same as apr_encode does, and read back */
+    for (len = 0; len < (int)sizeof(orig); len += 13) {
+        apr_size_t elen;
+        const char *ref = apr_pencode_base64_binary(p, orig, len,
+                                                    APR_ENCODE_NONE, &elen);
+
+        ABTS_INT_EQUAL(tc, (int)elen + 1,
+                       apr_base64_encode_binary(enc, orig, len));
+        ABTS_STR_EQUAL(tc, ref, enc);
+        ABTS_INT_EQUAL(tc, len, apr_base64_decode_binary(dec, enc));
+        ABTS_ASSERT(tc, "round trip", !memcmp(orig, dec, len));
+    }
+
+    /* stopping at the base64url characters */
+    apr_base64_encode_binary(enc, orig, 300);
+    enc[150] = '-';
+    ABTS_INT_EQUAL(tc, 150 / 4 * 3 + 1, apr_base64_decode_binary(dec, enc));
+}
+
 abts_suite *testbase64(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_base64, NULL);
+    abts_run_test(suite, test_base64_long, NULL);
 
     return suite;
 }
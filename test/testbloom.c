@@ -0,0 +1,179 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_bloom.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
+#include "abts.h"
+#include "testutil.h"
+
+#include <string.h>
+
+#define NKEYS 10000
+
+static void test_size(abts_case *tc, void *data)
+{
+    apr_bloom_t *bloom;
+    apr_size_t one, tenth;
+
+    ABTS_SIZE_EQUAL(tc, 0, apr_bloom_size(NKEYS, 0.0));
+    ABTS_SIZE_EQUAL(tc, 0, apr_bloom_size(NKEYS, 1.0));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_bloom_create(&bloom, NKEYS, 1.5, p));
+
+    /* About 10 bits a key for 1%, and 5 more for a tenth of it */
+    one = apr_bloom_size(NKEYS, 0.01);
+    tenth = apr_bloom_size(NKEYS, 0.001);
+    ABTS_TRUE(tc, one % 64 == 0);
+    ABTS_TRUE(tc, one >= NKEYS * 9 / 8 && one <= NKEYS * 12 / 8);
+    ABTS_TRUE(tc, tenth > one + NKEYS * 4 / 8);
+}
+
+static void test_add_test(abts_case *tc, void *data)
+{
+    apr_bloom_t *bloom;
+    apr_status_t rv;
+    int i, fp = 0;
+
+    rv = apr_bloom_create(&bloom, NKEYS, 0.01, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < NKEYS; i++) {
+        char *key = apr_itoa(p, i);
+        apr_bloom_add(bloom, key, strlen(key));
+    }
+    for (i = 0; i < NKEYS; i++) {
+        char *key = apr_itoa(p, i);
+        if (!apr_bloom_test(bloom, key, strlen(key))) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, NKEYS, i);
+
+    /* The sizing holds with the keys expected */
+    for (i = NKEYS; i < NKEYS * 11; i++) {
+        char *key = apr_itoa(p, i);
+        fp += apr_bloom_test(bloom, key, strlen(key));
+    }
+    ABTS_TRUE(tc, fp < NKEYS * 10 / 100 * 3 / 2);
+
+    apr_bloom_clear(bloom);
+    ABTS_INT_EQUAL(tc, 0, apr_bloom_test(bloom, "0", 1));
+}
+
+static void test_image(abts_case *tc, void *data)
+{
+    apr_bloom_t *bloom, *copy;
+    apr_size_t size;
+    apr_uint64_t *buf;
+    void *mem;
+    apr_status_t rv;
+
+    rv = apr_bloom_create(&bloom, 100, 0.01, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_bloom_add(bloom, "key", 3);
+
+    /* As if written to a file and read back */
+    apr_bloom_image_get(bloom, &mem, &size);
+    ABTS_SIZE_EQUAL(tc, apr_bloom_size(100, 0.01), size);
+    buf = apr_palloc(p, size);
+    memcpy(buf, mem, size);
+
+    rv = apr_bloom_attach(&copy, buf, size - 1, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_bloom_attach(&copy, buf, size, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_TRUE(tc, apr_bloom_test(copy, "key", 3));
+    ABTS_INT_EQUAL(tc, 0, apr_bloom_test(copy, "other", 5));
+    ABTS_TRUE(tc, apr_bloom_hash(copy, "key", 3)
+                  == apr_bloom_hash(bloom, "key", 3));
+
+    memset(buf, 0, size);
+    rv = apr_bloom_attach(&copy, buf, size, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    /* Created in place, seen through an attached object */
+    rv = apr_bloom_create_in(&bloom, buf, size - 64, 100, 0.01, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_bloom_create_in(&bloom, buf, size, 100, 0.01, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_bloom_attach(&copy, buf, size, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_bloom_add_hash(bloom, APR_UINT64_C(0x0123456789abcdef));
+    ABTS_TRUE(tc, apr_bloom_test_hash(copy,
+                                      APR_UINT64_C(0x0123456789abcdef)));
+}
+
+#if APR_HAS_THREADS
+
+#define NTHREADS 4
+
+static apr_bloom_t *shared_bloom;
+
+static void * APR_THREAD_FUNC add_thread(apr_thread_t *thd, void *data)
+{
+    int i, base = *(int *)data;
+
+    for (i = 0; i < NKEYS; i++) {
+        apr_uint64_t key = (apr_uint64_t)(base + i);
+        apr_bloom_add(shared_bloom, &key, sizeof(key));
+    }
+    return NULL;
+}
+
+static void test_concurrent(abts_case *tc, void *data)
+{
+    apr_thread_t *threads[NTHREADS];
+    int bases[NTHREADS];
+    apr_status_t rv, retval;
+    int i;
+
+    rv = apr_bloom_create(&shared_bloom, NKEYS * NTHREADS, 0.01, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < NTHREADS; i++) {
+        bases[i] = i * NKEYS;
+        rv = apr_thread_create(&threads[i], NULL, add_thread, &bases[i], p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        apr_thread_join(&retval, threads[i]);
+    }
+
+    /* No bit lost to a racing thread */
+    for (i = 0; i < NKEYS * NTHREADS; i++) {
+        apr_uint64_t key = (apr_uint64_t)i;
+        if (!apr_bloom_test(shared_bloom, &key, sizeof(key))) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, NKEYS * NTHREADS, i);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testbloom(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_size, NULL);
+    abts_run_test(suite, test_add_test, NULL);
+    abts_run_test(suite, test_image, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_concurrent, NULL);
+#endif
+
+    return suite;
+}
@@ -18,6 +18,10 @@
 #include "testutil.h"
 #include "apr_buckets.h"
 #include "apr_strings.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+#include "apr_thread_pool.h"
+#include "apr_time.h"
 
 static void test_create(abts_case *tc, void *data)
 {
@@ -265,6 +269,55 @@ static void test_splitboundary(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+/* Compare the boundary split of many small buckets with the flat search */
+static void test_splitboundary_straddle(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    static const char boundary[] = "\r\n--abcabd";
+    static const char *pieces[] = {
+        "x\r\n--ab", "cab", "c\r", "\n--abc", "abc\r\n-", "-abcab",
+        "d", "tail"
+    };
+    char flat[128];
+    apr_size_t flat_len = 0, n;
+    int i, step;
+
+    for (i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); i++) {
+        strcpy(flat + flat_len, pieces[i]);
+        flat_len += strlen(pieces[i]);
+    }
+
+    /* Whatever the bucket sizes, the result is the one of the flat data */
+    for (step = 1; step <= (int)flat_len; step++) {
+        apr_bucket_brigade *bin = apr_brigade_create(p, ba);
+        apr_bucket_brigade *bout = apr_brigade_create(p, ba);
+        const char *pos = strstr(flat, boundary);
+        apr_off_t scanned;
+        apr_size_t off;
+
+        for (off = 0; off < flat_len; off += step) {
+            n = flat_len - off < (apr_size_t)step ? flat_len - off : step;
+            APR_BRIGADE_INSERT_TAIL(bin,
+                apr_bucket_transient_create(flat + off, n, ba));
+        }
+
+        APR_ASSERT_SUCCESS(tc, "split boundary",
+                           apr_brigade_split_boundary_ex(bout, bin,
+                                              APR_BLOCK_READ, boundary,
+                                              APR_BUCKETS_STRING, 100,
+                                              &scanned));
+        ABTS_INT_EQUAL(tc, (int)(pos - flat), (int)scanned);
+        flatten_match(tc, "before boundary", bout,
+                      apr_pstrndup(p, flat, pos - flat));
+        flatten_match(tc, "after boundary", bin, "tail");
+
+        apr_brigade_destroy(bout);
+        apr_brigade_destroy(bin);
+    }
+
+    apr_bucket_alloc_destroy(ba);
+}
+
 /* Test that bucket E has content EDATA of length ELEN. */
 static void test_bucket_content(abts_case *tc,
                                 apr_bucket *e,
@@ -495,6 +548,421 @@ static void test_truncfile(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+static void test_file_readahead(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_size_t size = 256 * 1024, total = 0, prev = 0, len;
+    char *contents = apr_palloc(p, size + 1);
+    apr_file_t *f;
+    apr_bucket *e;
+    const char *buf;
+    apr_size_t i;
+
+    for (i = 0; i < size; i++) {
+        contents[i] = 'a' + i % 23;
+    }
+    contents[size] = '\0';
+    f = make_test_file(tc, "readahead.bin", contents);
+
+    e = apr_bucket_file_create(f, 0, size, p, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    apr_bucket_file_enable_mmap(e, 0);
+    APR_ASSERT_SUCCESS(tc, "set read ahead",
+                       apr_bucket_file_set_read_ahead(e, 64 * 1024));
+
+    /* Sequential reads grow up to the maximum */
+    while (e != APR_BRIGADE_SENTINEL(bb)) {
+        APR_ASSERT_SUCCESS(tc, "read file bucket",
+                           apr_bucket_read(e, &buf, &len, APR_BLOCK_READ));
+        ABTS_ASSERT(tc, "read content",
+                    memcmp(buf, contents + total, len) == 0);
+        ABTS_ASSERT(tc, "read size grows",
+                    len >= prev || total + len == size);
+        ABTS_ASSERT(tc, "read size bounded", len <= 64 * 1024);
+        if (total == 0) {
+            ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+        }
+        total += len;
+        prev = len;
+        e = APR_BUCKET_NEXT(e);
+    }
+    ABTS_SIZE_EQUAL(tc, size, total);
+    ABTS_ASSERT(tc, "read size grew", prev > APR_BUCKET_BUFF_SIZE);
+
+#if APR_HAS_MMAP
+    /* Only the limit is mapped, the rest is split */
+    apr_brigade_cleanup(bb);
+    e = apr_bucket_file_create(f, 0, size, p, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    APR_ASSERT_SUCCESS(tc, "set mmap limits",
+                       apr_bucket_file_set_mmap_limits(e, 1, 100000));
+    APR_ASSERT_SUCCESS(tc, "read file bucket",
+                       apr_bucket_read(e, &buf, &len, APR_BLOCK_READ));
+    ABTS_ASSERT(tc, "mmap bucket", APR_BUCKET_IS_MMAP(e));
+    ABTS_SIZE_EQUAL(tc, 100000, len);
+    ABTS_ASSERT(tc, "mmap content", memcmp(buf, contents, len) == 0);
+    ABTS_ASSERT(tc, "rest is a file bucket",
+                APR_BUCKET_IS_FILE(APR_BUCKET_NEXT(e)));
+
+    /* Buckets of the same region share the mapping through a cache */
+    {
+        apr_mmap_cache_t *cache;
+        apr_bucket *e2;
+        const char *buf2;
+
+        if (apr_mmap_cache_create(&cache, 1024 * 1024, p) == APR_SUCCESS) {
+            apr_brigade_cleanup(bb);
+            e = apr_bucket_file_create(f, 0, size, p, ba);
+            APR_BRIGADE_INSERT_TAIL(bb, e);
+            e2 = apr_bucket_file_create(f, 0, size, p, ba);
+            APR_BRIGADE_INSERT_TAIL(bb, e2);
+            APR_ASSERT_SUCCESS(tc, "set mmap cache",
+                               apr_bucket_file_set_mmap_cache(e, cache));
+            APR_ASSERT_SUCCESS(tc, "set mmap cache",
+                               apr_bucket_file_set_mmap_cache(e2, cache));
+            APR_ASSERT_SUCCESS(tc, "read file bucket",
+                               apr_bucket_read(e, &buf, &len, APR_BLOCK_READ));
+            APR_ASSERT_SUCCESS(tc, "read file bucket",
+                               apr_bucket_read(e2, &buf2, &len,
+                                               APR_BLOCK_READ));
+            ABTS_ASSERT(tc, "mmap bucket", APR_BUCKET_IS_MMAP(e2));
+            ABTS_PTR_EQUAL(tc, buf, buf2);
+            ABTS_ASSERT(tc, "mmap content", memcmp(buf2, contents, len) == 0);
+        }
+    }
+#endif
+
+    apr_file_close(f);
+    apr_file_remove("readahead.bin", p);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+#if APR_HAS_THREADS
+static volatile apr_uint32_t aio_notified;
+
+static void aio_notify(void *baton)
+{
+    apr_atomic_inc32(&aio_notified);
+}
+
+static void test_file_aio(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_size_t size = 20000, total = 0, len;
+    char *contents = apr_palloc(p, size + 1);
+    apr_thread_pool_t *tp;
+    apr_bucket_file_aio_t *aio;
+    apr_pool_t *subp;
+    apr_file_t *f;
+    apr_bucket *e;
+    const char *buf;
+    apr_status_t rv;
+    apr_size_t i;
+
+    for (i = 0; i < size; i++) {
+        contents[i] = 'A' + i % 19;
+    }
+    contents[size] = '\0';
+    f = make_test_file(tc, "aiofile.bin", contents);
+
+    APR_ASSERT_SUCCESS(tc, "create thread pool",
+                       apr_thread_pool_create(&tp, 1, 2, p));
+    apr_pool_create(&subp, p);
+    APR_ASSERT_SUCCESS(tc, "create aio",
+                       apr_bucket_file_aio_create(&aio, tp, aio_notify, NULL,
+                                                  subp));
+
+    apr_atomic_set32(&aio_notified, 0);
+    e = apr_bucket_file_create(f, 0, size, p, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    apr_bucket_file_set_aio(e, aio);
+
+    /* The first nonblocking read is always in flight */
+    rv = apr_bucket_read(e, &buf, &len, APR_NONBLOCK_READ);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+    ABTS_ASSERT(tc, "still a file bucket", APR_BUCKET_IS_FILE(e));
+
+    while (e != APR_BRIGADE_SENTINEL(bb)) {
+        rv = apr_bucket_read(e, &buf, &len, APR_NONBLOCK_READ);
+        if (rv == APR_EAGAIN) {
+            apr_sleep(1000);
+            continue;
+        }
+        APR_ASSERT_SUCCESS(tc, "read file bucket", rv);
+        ABTS_ASSERT(tc, "heap bucket", APR_BUCKET_IS_HEAP(e));
+        ABTS_ASSERT(tc, "read content",
+                    memcmp(buf, contents + total, len) == 0);
+        total += len;
+        e = APR_BUCKET_NEXT(e);
+    }
+    ABTS_SIZE_EQUAL(tc, size, total);
+    ABTS_ASSERT(tc, "notified", apr_atomic_read32(&aio_notified) >= 3);
+
+    /* A blocking read waits for the read in flight */
+    apr_brigade_cleanup(bb);
+    e = apr_bucket_file_create(f, 0, size, p, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    apr_bucket_file_set_aio(e, aio);
+    rv = apr_bucket_read(e, &buf, &len, APR_NONBLOCK_READ);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+    APR_ASSERT_SUCCESS(tc, "blocking read",
+                       apr_bucket_read(e, &buf, &len, APR_BLOCK_READ));
+    ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+    ABTS_ASSERT(tc, "read content", memcmp(buf, contents, len) == 0);
+
+    /* Destroying a bucket with a read in flight */
+    e = APR_BUCKET_NEXT(e);
+    rv = apr_bucket_read(e, &buf, &len, APR_NONBLOCK_READ);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+    apr_brigade_cleanup(bb);
+
+    apr_pool_destroy(subp);
+    apr_thread_pool_destroy(tp);
+    apr_file_close(f);
+    apr_file_remove("aiofile.bin", p);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+#endif
+
+static void test_coalesce(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    char *expect = apr_palloc(p, 32000), *big, tmp[3];
+    apr_size_t n = 0, len = 32000;
+    apr_bucket *e;
+    int i, count = 0;
+
+    for (i = 0; i < 1000; i++) {
+        memcpy(tmp, "abc", 3);
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(tmp, 3, ba));
+        memcpy(expect + n, "abc", 3);
+        n += 3;
+    }
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("", 0, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_pool_create("x", 1, p, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("yz", 2, ba));
+    memcpy(expect + n, "xyz", 3);
+    n += 3;
+    big = apr_palloc(p, 10000);
+    memset(big, 'B', 10000);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(big, 10000, ba));
+    memcpy(expect + n, big, 10000);
+    n += 10000;
+
+    APR_ASSERT_SUCCESS(tc, "coalesce", apr_brigade_coalesce(bb, 1000));
+
+    /* Overwriting the transient data must not matter anymore */
+    memset(big, 'b', 10000);
+
+    /* 3000 bytes in three 999 byte buckets and a 3 byte one, FLUSH,
+     * "xyz" in one bucket and the big one */
+    for (e = APR_BRIGADE_FIRST(bb); e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e)) {
+        ABTS_ASSERT(tc, "no transient bucket", !APR_BUCKET_IS_TRANSIENT(e));
+        ABTS_ASSERT(tc, "no empty data bucket",
+                    e->length || APR_BUCKET_IS_METADATA(e));
+        if (count == 4) {
+            ABTS_ASSERT(tc, "flush bucket in place", APR_BUCKET_IS_FLUSH(e));
+        }
+        else if (count < 4) {
+            ABTS_SIZE_EQUAL(tc, count < 3 ? 999 : 3, e->length);
+        }
+        count++;
+    }
+    ABTS_INT_EQUAL(tc, 7, count);
+    ABTS_SIZE_EQUAL(tc, 3, APR_BUCKET_PREV(APR_BRIGADE_LAST(bb))->length);
+
+    APR_ASSERT_SUCCESS(tc, "flatten", apr_brigade_flatten(bb, expect + n,
+                                                          &len));
+    ABTS_SIZE_EQUAL(tc, n, len);
+    ABTS_ASSERT(tc, "content", memcmp(expect, expect + n, n) == 0);
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_brigade_setaside(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    char *expect = apr_palloc(p, 2 * 10006), tmp[3];
+    char *big = apr_palloc(p, 10000);
+    const char *first_data;
+    apr_size_t len = 10006;
+    apr_bucket *e;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        memcpy(tmp, "abc", 3);
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(tmp, 3, ba));
+    }
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+    memset(big, 'B', 10000);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(big, 10000, ba));
+    memcpy(expect, "abcabc", 6);
+    memcpy(expect + 6, big, 10000);
+
+    APR_ASSERT_SUCCESS(tc, "setaside", apr_brigade_setaside(bb, p));
+
+    /* Overwriting the transient data must not matter anymore */
+    memset(tmp, 'x', 3);
+    memset(big, 'b', 10000);
+
+    for (e = APR_BRIGADE_FIRST(bb); e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e)) {
+        ABTS_ASSERT(tc, "no transient bucket", !APR_BUCKET_IS_TRANSIENT(e));
+    }
+
+    /* The small buckets share one buffer */
+    e = APR_BRIGADE_FIRST(bb);
+    ABTS_ASSERT(tc, "heap bucket", APR_BUCKET_IS_HEAP(e));
+    ABTS_PTR_EQUAL(tc, e->data, APR_BUCKET_NEXT(e)->data);
+    ABTS_INT_EQUAL(tc, 3, (int)APR_BUCKET_NEXT(e)->start);
+    first_data = ((apr_bucket_heap *)e->data)->base;
+
+    /* Setting aside again copies nothing */
+    APR_ASSERT_SUCCESS(tc, "setaside again", apr_brigade_setaside(bb, p));
+    ABTS_PTR_EQUAL(tc, first_data, ((apr_bucket_heap *)e->data)->base);
+
+    APR_ASSERT_SUCCESS(tc, "flatten", apr_brigade_flatten(bb, expect + 10006,
+                                                          &len));
+    ABTS_SIZE_EQUAL(tc, 10006, len);
+    ABTS_ASSERT(tc, "content", memcmp(expect, expect + 10006, 10006) == 0);
+
+    /* The shared buffer outlives the first bucket */
+    apr_bucket_delete(e);
+    len = 3;
+    APR_ASSERT_SUCCESS(tc, "flatten", apr_brigade_flatten(bb, tmp, &len));
+    ABTS_ASSERT(tc, "second bucket", memcmp(tmp, "abc", 3) == 0);
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static apr_status_t codec_roundtrip(abts_case *tc,
+                                    apr_brigade_codec_type_e type,
+                                    const char *expect, apr_size_t n)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *in = apr_brigade_create(p, ba);
+    apr_bucket_brigade *zbb = apr_brigade_create(p, ba);
+    apr_bucket_brigade *out = apr_brigade_create(p, ba);
+    apr_brigade_codec_t *enc, *dec;
+    apr_off_t zlen;
+    apr_size_t i, len;
+    apr_bucket *e;
+    char *buf;
+    apr_status_t rv;
+
+    rv = apr_brigade_codec_create(&enc, type, 0, 6, 0, ba, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    APR_ASSERT_SUCCESS(tc, "create decoder",
+                       apr_brigade_codec_create(&dec, type,
+                                                APR_BRIGADE_CODEC_DECODE,
+                                                APR_BRIGADE_CODEC_LEVEL_DEFAULT,
+                                                0, ba, p));
+
+    /* Feed the data in small pieces, with a FLUSH in the middle */
+    for (i = 0; i < n; i += 1000) {
+        len = n - i < 1000 ? n - i : 1000;
+        APR_BRIGADE_INSERT_TAIL(in, apr_bucket_transient_create(expect + i,
+                                                                len, ba));
+        if (i == 20000) {
+            APR_BRIGADE_INSERT_TAIL(in, apr_bucket_flush_create(ba));
+        }
+        APR_ASSERT_SUCCESS(tc, "compress",
+                           apr_brigade_codec_process(enc, zbb, in,
+                                                     APR_BLOCK_READ));
+        ABTS_ASSERT(tc, "input consumed", APR_BRIGADE_EMPTY(in));
+    }
+    APR_BRIGADE_INSERT_TAIL(in, apr_bucket_eos_create(ba));
+    APR_ASSERT_SUCCESS(tc, "finish", apr_brigade_codec_process(enc, zbb, in,
+                                                               APR_BLOCK_READ));
+    ABTS_ASSERT(tc, "EOS last", APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(zbb)));
+    apr_brigade_length(zbb, 1, &zlen);
+    ABTS_ASSERT(tc, "data compressed", zlen > 0 && zlen < (apr_off_t)n / 2);
+
+    /* Decompress it byte by byte, but for the metadata */
+    while (!APR_BRIGADE_EMPTY(zbb)) {
+        e = APR_BRIGADE_FIRST(zbb);
+        if (e->length > 1) {
+            apr_bucket_split(e, 1);
+        }
+        APR_BUCKET_REMOVE(e);
+        APR_BRIGADE_INSERT_TAIL(in, e);
+        APR_ASSERT_SUCCESS(tc, "decompress",
+                           apr_brigade_codec_process(dec, out, in,
+                                                     APR_BLOCK_READ));
+        if (APR_BUCKET_IS_FLUSH(e)) {
+            apr_brigade_length(out, 1, &zlen);
+            ABTS_INT_EQUAL(tc, 21000, (int)zlen);
+        }
+    }
+    ABTS_ASSERT(tc, "EOS passed", APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(out)));
+
+    APR_ASSERT_SUCCESS(tc, "flatten", apr_brigade_pflatten(out, &buf, &len,
+                                                           p));
+    ABTS_SIZE_EQUAL(tc, n, len);
+    ABTS_ASSERT(tc, "content", memcmp(buf, expect, n) == 0);
+
+    /* A truncated stream */
+    APR_BRIGADE_INSERT_TAIL(in, apr_bucket_immortal_create(expect, 100, ba));
+    APR_ASSERT_SUCCESS(tc, "compress", apr_brigade_codec_process(enc, zbb, in,
+                                                                 APR_BLOCK_READ));
+    APR_BRIGADE_INSERT_TAIL(zbb, apr_bucket_flush_create(ba));
+    APR_ASSERT_SUCCESS(tc, "flush", apr_brigade_codec_process(enc, in, zbb,
+                                                              APR_BLOCK_READ));
+    APR_BRIGADE_INSERT_TAIL(in, apr_bucket_eos_create(ba));
+    rv = apr_brigade_codec_process(dec, out, in, APR_BLOCK_READ);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+
+    apr_brigade_destroy(in);
+    apr_brigade_destroy(zbb);
+    apr_brigade_destroy(out);
+    return APR_SUCCESS;
+}
+
+static void test_codec(abts_case *tc, void *data)
+{
+    apr_size_t i, n = 50000;
+    char *expect = apr_palloc(p, n);
+    apr_brigade_codec_t *ctx;
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+
+    for (i = 0; i < n; i++) {
+        expect[i] = "abcdefghij"[(i * 7 + i / 13) % 10];
+    }
+
+    if (!apr_brigade_codec_supported(APR_BRIGADE_CODEC_GZIP)) {
+        ABTS_NOT_IMPL(tc, "brigade compression");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "gzip",
+                       codec_roundtrip(tc, APR_BRIGADE_CODEC_GZIP, expect, n));
+    APR_ASSERT_SUCCESS(tc, "zlib",
+                       codec_roundtrip(tc, APR_BRIGADE_CODEC_ZLIB, expect, n));
+    APR_ASSERT_SUCCESS(tc, "deflate",
+                       codec_roundtrip(tc, APR_BRIGADE_CODEC_DEFLATE, expect,
+                                       n));
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_brigade_codec_create(&ctx, APR_BRIGADE_CODEC_GZIP, 0,
+                                            10, 0, ba, p));
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_brigade_codec_create(&ctx, APR_BRIGADE_CODEC_GZIP, 0,
+                                            APR_BRIGADE_CODEC_LEVEL_DEFAULT,
+                                            16, ba, p));
+    apr_bucket_alloc_destroy(ba);
+}
+
 static const char hello[] = "hello, world";
 
 static void test_partition(abts_case *tc, void *data)
@@ -544,6 +1012,31 @@ static void test_write_split(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+/* Small writes past a full buffer go on in a new buffer, not in a bucket
+ * each */
+static void test_write_full(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_bucket *e;
+    apr_off_t len;
+    int i, n = 0;
+
+    for (i = 0; i < 1000; i++) {
+        apr_brigade_write(bb, NULL, NULL, "0123456789abcdef", 16);
+    }
+    for (e = APR_BRIGADE_FIRST(bb); e != APR_BRIGADE_SENTINEL(bb);
+         e = APR_BUCKET_NEXT(e)) {
+        n++;
+    }
+    ABTS_ASSERT(tc, "too many buckets", n <= 16000 / APR_BUCKET_BUFF_SIZE + 1);
+    apr_brigade_length(bb, 1, &len);
+    ABTS_INT_EQUAL(tc, 16000, (int)len);
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
 static void test_write_putstrs(abts_case *tc, void *data)
 {
     apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
@@ -567,6 +1060,249 @@ static void test_write_putstrs(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+static void test_format(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_format_t *format = apr_format_compile("%s:%05d;", p);
+    char *expect = "", *flat;
+    apr_size_t len;
+    int i;
+
+    /* enough to flush the buffer of apr_brigade_format() */
+    for (i = 0; i < 1000; i++) {
+        APR_ASSERT_SUCCESS(tc, "apr_brigade_format",
+                           apr_brigade_format(bb, NULL, NULL, format,
+                                              "key", i));
+        expect = apr_psprintf(p, "%s%s:%05d;", expect, "key", i);
+    }
+    APR_ASSERT_SUCCESS(tc, "apr_brigade_pflatten",
+                       apr_brigade_pflatten(bb, &flat, &len, p));
+    ABTS_SIZE_EQUAL(tc, strlen(expect), len);
+    ABTS_STR_NEQUAL(tc, expect, flat, len);
+
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_alloc_large(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_size_t size16 = apr_bucket_alloc_aligned_floor(ba, 16 * 1024);
+    apr_size_t size64 = apr_bucket_alloc_aligned_floor(ba, 64 * 1024);
+    char *b16, *b64, *b;
+
+    b16 = apr_bucket_alloc(size16, ba);
+    b64 = apr_bucket_alloc(size64, ba);
+    ABTS_PTR_NOTNULL(tc, b16);
+    ABTS_PTR_NOTNULL(tc, b64);
+    memset(b16, 'a', size16);
+    memset(b64, 'b', size64);
+    apr_bucket_free(b16);
+    apr_bucket_free(b64);
+
+    /* Same sizes are recycled from their own free list */
+    b = apr_bucket_alloc(size64, ba);
+    ABTS_PTR_EQUAL(tc, b64, b);
+    apr_bucket_free(b);
+    b = apr_bucket_alloc(size16 - 100, ba);
+    ABTS_PTR_EQUAL(tc, b16, b);
+    apr_bucket_free(b);
+
+    /* Nothing is kept without room */
+    apr_bucket_alloc_max_free_set(ba, 0);
+    b = apr_bucket_alloc(size16, ba);
+    ABTS_PTR_NOTNULL(tc, b);
+    memset(b, 'c', size16);
+    apr_bucket_free(b);
+
+    apr_bucket_alloc_destroy(ba);
+}
+
+static void test_pipe_read_size(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_file_t *rd, *wr;
+    apr_bucket *e;
+    apr_size_t total = APR_BUCKET_READ_MAX * 2, written, n, len;
+    apr_size_t size = APR_BUCKET_BUFF_SIZE;
+    const char *str;
+    char *buf;
+    apr_status_t rv;
+    int reads = 0;
+
+    rv = apr_file_pipe_create_ex(&rd, &wr, APR_READ_BLOCK, p);
+    APR_ASSERT_SUCCESS(tc, "create pipe", rv);
+
+    /* As much as the pipe takes without blocking */
+    buf = apr_palloc(p, total);
+    memset(buf, 'a', total);
+    for (written = 0; written < total; written += n) {
+        n = total - written;
+        if (apr_file_write(wr, buf + written, &n) != APR_SUCCESS) {
+            break;
+        }
+    }
+    apr_file_close(wr);
+    ABTS_ASSERT(tc, "pipe takes a read", written >= APR_BUCKET_BUFF_SIZE);
+
+    /* Each read filling its buffer doubles the next one */
+    e = apr_bucket_pipe_create(rd, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    while (written) {
+        rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+        APR_ASSERT_SUCCESS(tc, "read pipe bucket", rv);
+        n = written < size ? written : size;
+        ABTS_SIZE_EQUAL(tc, n, len);
+        if (len != n) {
+            break;
+        }
+        ABTS_SIZE_EQUAL(tc, len <= APR_BUCKET_BUFF_SIZE
+                            ? APR_BUCKET_BUFF_SIZE : size,
+                        ((apr_bucket_heap *)e->data)->alloc_len);
+        written -= len;
+        if (len == size && size < APR_BUCKET_READ_MAX) {
+            size *= 2;
+        }
+        e = APR_BUCKET_NEXT(e);
+        reads++;
+    }
+    ABTS_ASSERT(tc, "some reads", reads > 0);
+    rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+    APR_ASSERT_SUCCESS(tc, "read pipe bucket at EOF", rv);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    apr_brigade_cleanup(bb);
+
+    /* Without growing */
+    rv = apr_file_pipe_create_ex(&rd, &wr, APR_READ_BLOCK, p);
+    APR_ASSERT_SUCCESS(tc, "create pipe", rv);
+    n = APR_BUCKET_BUFF_SIZE * 2;
+    rv = apr_file_write_full(wr, buf, n, NULL);
+    APR_ASSERT_SUCCESS(tc, "write pipe", rv);
+    apr_file_close(wr);
+    e = apr_bucket_pipe_create(rd, ba);
+    APR_BRIGADE_INSERT_TAIL(bb, e);
+    apr_bucket_pipe_set_read_max(e, 0);
+    rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+    APR_ASSERT_SUCCESS(tc, "read pipe bucket", rv);
+    ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+    e = APR_BUCKET_NEXT(e);
+    rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+    APR_ASSERT_SUCCESS(tc, "read pipe bucket", rv);
+    ABTS_SIZE_EQUAL(tc, APR_BUCKET_BUFF_SIZE, len);
+    apr_brigade_cleanup(bb);
+
+    apr_bucket_alloc_destroy(ba);
+}
+
+static int buffer_freed;
+
+static void buffer_free(void *data)
+{
+    buffer_freed++;
+}
+
+static void test_buffer(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba1 = apr_bucket_alloc_create(p);
+    apr_bucket_alloc_t *ba2 = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb1 = apr_brigade_create(p, ba1);
+    apr_bucket_brigade *bb2 = apr_brigade_create(p, ba2);
+    apr_bucket_buffer *buffer;
+    apr_bucket *e, *c;
+    static const char payload[] = "hello, world";
+
+    buffer_freed = 0;
+    buffer = apr_bucket_buffer_alloc(payload, strlen(payload), buffer_free);
+    ABTS_PTR_NOTNULL(tc, buffer);
+
+    e = apr_bucket_buffer_create(buffer, 0, strlen(payload), ba1);
+    ABTS_ASSERT(tc, "buffer bucket", APR_BUCKET_IS_BUFFER(e));
+    APR_BRIGADE_INSERT_TAIL(bb1, e);
+    apr_bucket_split(e, 5);
+    test_bucket_content(tc, e, "hello", 5);
+    test_bucket_content(tc, APR_BUCKET_NEXT(e), ", world", 7);
+
+    e = apr_bucket_buffer_create(buffer, 7, 5, ba2);
+    APR_BRIGADE_INSERT_TAIL(bb2, e);
+    apr_bucket_copy(e, &c);
+    APR_BRIGADE_INSERT_TAIL(bb2, c);
+    test_bucket_content(tc, c, "world", 5);
+    ABTS_INT_EQUAL(tc, 5, apr_atomic_read32(&buffer->refcount));
+
+    apr_bucket_buffer_release(buffer);
+    apr_brigade_destroy(bb1);
+    ABTS_INT_EQUAL(tc, 0, buffer_freed);
+    apr_brigade_destroy(bb2);
+    ABTS_INT_EQUAL(tc, 1, buffer_freed);
+
+    /* A copied buffer does not refer to the caller's data */
+    buffer = apr_bucket_buffer_alloc(payload, strlen(payload), NULL);
+    ABTS_PTR_NOTNULL(tc, buffer);
+    ABTS_PTR_NOTNULL(tc, buffer->base);
+    ABTS_ASSERT(tc, "copied buffer", buffer->base != payload);
+    bb1 = apr_brigade_create(p, ba1);
+    APR_BRIGADE_INSERT_TAIL(bb1, apr_bucket_buffer_create(buffer, 0, 5, ba1));
+    apr_bucket_buffer_release(buffer);
+    test_bucket_content(tc, APR_BRIGADE_FIRST(bb1), "hello", 5);
+    apr_brigade_destroy(bb1);
+
+    apr_bucket_alloc_destroy(ba1);
+    apr_bucket_alloc_destroy(ba2);
+}
+
+#if APR_HAS_THREADS
+#define BUFFER_THREADS 4
+#define BUFFER_ROUNDS  10000
+
+static void * APR_THREAD_FUNC buffer_thread(apr_thread_t *thd, void *data)
+{
+    apr_bucket_buffer *buffer = data;
+    apr_pool_t *pool = apr_thread_pool_get(thd);
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(pool);
+    apr_bucket_brigade *bb = apr_brigade_create(pool, ba);
+    int i;
+
+    for (i = 0; i < BUFFER_ROUNDS; i++) {
+        apr_bucket *e = apr_bucket_buffer_create(buffer, 0, buffer->length,
+                                                 ba);
+        APR_BRIGADE_INSERT_TAIL(bb, e);
+        apr_bucket_split(e, i % buffer->length);
+        if (i % 16 == 15) {
+            apr_brigade_cleanup(bb);
+        }
+    }
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+
+    return NULL;
+}
+
+static void test_buffer_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *threads[BUFFER_THREADS];
+    apr_bucket_buffer *buffer;
+    apr_status_t rv;
+    int i;
+
+    buffer_freed = 0;
+    buffer = apr_bucket_buffer_alloc("shared", 6, buffer_free);
+    ABTS_PTR_NOTNULL(tc, buffer);
+    for (i = 0; i < BUFFER_THREADS; i++) {
+        rv = apr_thread_create(&threads[i], NULL, buffer_thread, buffer, p);
+        APR_ASSERT_SUCCESS(tc, "Problem creating thread", rv);
+    }
+    for (i = 0; i < BUFFER_THREADS; i++) {
+        apr_thread_join(&rv, threads[i]);
+    }
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&buffer->refcount));
+    ABTS_INT_EQUAL(tc, 0, buffer_freed);
+    apr_bucket_buffer_release(buffer);
+    ABTS_INT_EQUAL(tc, 1, buffer_freed);
+}
+#endif
+
 abts_suite *testbuckets(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -578,13 +1314,29 @@ abts_suite *testbuckets(abts_suite *suite)
     abts_run_test(suite, test_bwrite, NULL);
     abts_run_test(suite, test_splitline, NULL);
     abts_run_test(suite, test_splitboundary, NULL);
+    abts_run_test(suite, test_splitboundary_straddle, NULL);
     abts_run_test(suite, test_splits, NULL);
     abts_run_test(suite, test_insertfile, NULL);
     abts_run_test(suite, test_manyfile, NULL);
     abts_run_test(suite, test_truncfile, NULL);
+    abts_run_test(suite, test_file_readahead, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_file_aio, NULL);
+#endif
     abts_run_test(suite, test_partition, NULL);
+    abts_run_test(suite, test_coalesce, NULL);
+    abts_run_test(suite, test_brigade_setaside, NULL);
+    abts_run_test(suite, test_codec, NULL);
     abts_run_test(suite, test_write_split, NULL);
+    abts_run_test(suite, test_write_full, NULL);
     abts_run_test(suite, test_write_putstrs, NULL);
+    abts_run_test(suite, test_format, NULL);
+    abts_run_test(suite, test_alloc_large, NULL);
+    abts_run_test(suite, test_pipe_read_size, NULL);
+    abts_run_test(suite, test_buffer, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_buffer_threads, NULL);
+#endif
 
     return suite;
 }
@@ -0,0 +1,287 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_cache.h"
+#include "apr_atomic.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
+#include "abts.h"
+#include "testutil.h"
+
+#include <string.h>
+
+static apr_uint32_t freed;
+
+static void free_value(void *value, void *baton)
+{
+    apr_atomic_inc32(&freed);
+}
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_cache_t *cache;
+    apr_status_t rv;
+
+    rv = apr_cache_create(&cache, 4096, -1, 0, NULL, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_cache_create(&cache, 4096, 0, 0, NULL, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_cache_create(&cache, 4096, 0, 3, NULL, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_get_set(abts_case *tc, void *data)
+{
+    apr_cache_t *cache;
+    apr_cache_stats_t stats;
+    apr_cache_entry_t *e, *e2;
+    apr_status_t rv;
+
+    apr_atomic_set32(&freed, 0);
+    rv = apr_cache_create(&cache, 64 * 1024, 0, 0, free_value, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_cache_get(cache, "key", 3, &e);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    rv = apr_cache_set(cache, "key", 3, "value", 5, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_cache_get(cache, "key", 3, &e);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "value", apr_cache_entry_value(e));
+
+    /* Replaced, the old value is freed once released only */
+    rv = apr_cache_set(cache, "key", 3, "other", 5, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&freed));
+    rv = apr_cache_get(cache, "key", 3, &e2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "other", apr_cache_entry_value(e2));
+    ABTS_STR_EQUAL(tc, "value", apr_cache_entry_value(e));
+    apr_cache_release(e);
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&freed));
+
+    apr_cache_delete(cache, "key", 3);
+    rv = apr_cache_get(cache, "key", 3, &e);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&freed));
+    apr_cache_release(e2);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&freed));
+
+    apr_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.misses);
+    ABTS_SIZE_EQUAL(tc, 0, stats.entries);
+    ABTS_SIZE_EQUAL(tc, 0, stats.cost);
+
+    /* Freed when cleared */
+    rv = apr_cache_set(cache, "key", 3, "value", 5, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_cache_clear(cache);
+    ABTS_INT_EQUAL(tc, 3, apr_atomic_read32(&freed));
+}
+
+static void test_expiry(abts_case *tc, void *data)
+{
+    apr_cache_t *cache;
+    apr_cache_entry_t *e;
+    apr_status_t rv;
+
+    rv = apr_cache_create(&cache, 64 * 1024, apr_time_from_sec(60), 0,
+                          NULL, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_cache_set(cache, "short", 5, "value", 5,
+                       apr_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_cache_set(cache, "long", 4, "value", 5, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_sleep(apr_time_from_msec(20));
+    rv = apr_cache_get(cache, "short", 5, &e);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_cache_get(cache, "long", 4, &e);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_cache_release(e);
+}
+
+static void test_eviction(abts_case *tc, void *data)
+{
+    apr_cache_t *cache;
+    apr_cache_stats_t stats;
+    apr_cache_entry_t *e;
+    apr_status_t rv;
+    int i;
+
+    apr_atomic_set32(&freed, 0);
+
+    /* A single shard, room for about ten values */
+    rv = apr_cache_create(&cache, 10 * 1024 + 512, 0, 1, free_value, NULL,
+                          p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_cache_set(cache, "hot", 3, "hot", 1024, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* A scan of keys used once does not evict the one used again */
+    for (i = 0; i < 100; i++) {
+        char *key = apr_itoa(p, i);
+
+        rv = apr_cache_get(cache, "hot", 3, &e);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        apr_cache_release(e);
+
+        rv = apr_cache_set(cache, key, strlen(key), key, 1024, 0);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_cache_get(cache, "0", 1, &e);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_cache_get(cache, "99", 2, &e);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_cache_release(e);
+
+    apr_cache_stats_get(cache, &stats);
+    ABTS_TRUE(tc, stats.evictions >= 90);
+    ABTS_INT_EQUAL(tc, (int)stats.evictions, (int)apr_atomic_read32(&freed));
+    ABTS_TRUE(tc, stats.cost <= 10 * 1024 + 512);
+
+    /* Too big for the shard, freed right away, and the previous value
+     * goes too.
+     */
+    rv = apr_cache_set(cache, "hot", 3, "huge", 20 * 1024, 0);
+    ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+    rv = apr_cache_get(cache, "hot", 3, &e);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    ABTS_INT_EQUAL(tc, (int)stats.evictions + 2,
+                   (int)apr_atomic_read32(&freed));
+
+    apr_cache_clear(cache);
+    apr_cache_stats_get(cache, &stats);
+    ABTS_SIZE_EQUAL(tc, 0, stats.entries);
+    ABTS_SIZE_EQUAL(tc, 0, stats.cost);
+}
+
+static apr_uint32_t computed;
+
+static apr_status_t compute_value(void **value, apr_size_t *cost,
+                                  apr_interval_time_t *ttl,
+                                  const void *key, apr_size_t klen,
+                                  void *baton)
+{
+    apr_atomic_inc32(&computed);
+    if (baton) {
+        apr_sleep(*(apr_interval_time_t *)baton);
+    }
+    if (klen == 4 && !memcmp(key, "fail", 4)) {
+        return APR_EGENERAL;
+    }
+    *value = "computed";
+    *cost = 8;
+    return APR_SUCCESS;
+}
+
+static void test_compute(abts_case *tc, void *data)
+{
+    apr_cache_t *cache;
+    apr_cache_stats_t stats;
+    apr_cache_entry_t *e;
+    apr_status_t rv;
+
+    apr_atomic_set32(&computed, 0);
+    rv = apr_cache_create(&cache, 64 * 1024, 0, 0, NULL, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_cache_get_or_compute(cache, "key", 3, compute_value, NULL, &e);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "computed", apr_cache_entry_value(e));
+    apr_cache_release(e);
+    rv = apr_cache_get_or_compute(cache, "key", 3, compute_value, NULL, &e);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_cache_release(e);
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&computed));
+
+    /* Errors are not cached */
+    rv = apr_cache_get_or_compute(cache, "fail", 4, compute_value, NULL, &e);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    rv = apr_cache_get(cache, "fail", 4, &e);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    apr_cache_stats_get(cache, &stats);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.computes);
+    ABTS_SIZE_EQUAL(tc, 1, stats.entries);
+}
+
+#if APR_HAS_THREADS
+
+#define NTHREADS 8
+
+static apr_cache_t *shared_cache;
+static apr_uint32_t values_got;
+
+static void * APR_THREAD_FUNC compute_thread(apr_thread_t *thd, void *data)
+{
+    apr_cache_entry_t *e;
+
+    if (apr_cache_get_or_compute(shared_cache, "key", 3, compute_value,
+                                 data, &e) == APR_SUCCESS) {
+        if (!strcmp(apr_cache_entry_value(e), "computed")) {
+            apr_atomic_inc32(&values_got);
+        }
+        apr_cache_release(e);
+    }
+    return NULL;
+}
+
+static void test_single_flight(abts_case *tc, void *data)
+{
+    apr_interval_time_t delay = apr_time_from_msec(50);
+    apr_thread_t *threads[NTHREADS];
+    apr_status_t rv, retval;
+    int i;
+
+    apr_atomic_set32(&computed, 0);
+    rv = apr_cache_create(&shared_cache, 64 * 1024, 0, 0, NULL, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < NTHREADS; i++) {
+        rv = apr_thread_create(&threads[i], NULL, compute_thread, &delay, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        apr_thread_join(&retval, threads[i]);
+    }
+
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&computed));
+    ABTS_INT_EQUAL(tc, NTHREADS, apr_atomic_read32(&values_got));
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testcache(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_get_set, NULL);
+    abts_run_test(suite, test_expiry, NULL);
+    abts_run_test(suite, test_eviction, NULL);
+    abts_run_test(suite, test_compute, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_single_flight, NULL);
+#endif
+
+    return suite;
+}
@@ -0,0 +1,190 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_counter.h"
+#include "apr_shm.h"
+#include "apr_thread_proc.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define NUM_INCS 100000
+
+static void test_count(abts_case *tc, void *data)
+{
+    apr_counter_t *counter;
+    apr_status_t rv;
+
+    rv = apr_counter_create(&counter, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ULLONG_EQUAL(tc, 0, apr_counter_read(counter));
+
+    apr_counter_inc(counter);
+    apr_counter_add(counter, 41);
+    ABTS_ULLONG_EQUAL(tc, 42, apr_counter_read(counter));
+
+    apr_counter_add(counter, APR_UINT64_C(0x100000000));
+    ABTS_ULLONG_EQUAL(tc, APR_UINT64_C(0x10000002a),
+                      apr_counter_read(counter));
+
+    apr_counter_reset(counter);
+    ABTS_ULLONG_EQUAL(tc, 0, apr_counter_read(counter));
+}
+
+static void test_attach(abts_case *tc, void *data)
+{
+    apr_counter_t *counter, *attached;
+    apr_size_t size = apr_counter_size(4);
+    char *mem = apr_pcalloc(p, size);
+    apr_status_t rv;
+
+    rv = apr_counter_attach(&attached, mem, size, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_counter_init(&counter, 4, mem, size - 1, p);
+    ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+
+    rv = apr_counter_init(&counter, 4, mem, size, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_counter_attach(&attached, mem, size - 1, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_counter_attach(&attached, mem, size, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_counter_add(counter, 2);
+    apr_counter_add(attached, 3);
+    ABTS_ULLONG_EQUAL(tc, 5, apr_counter_read(counter));
+    ABTS_ULLONG_EQUAL(tc, 5, apr_counter_read(attached));
+}
+
+#if APR_HAS_THREADS
+
+#define NUM_THREADS 8
+
+static void * APR_THREAD_FUNC count_thread(apr_thread_t *thd, void *data)
+{
+    apr_counter_t *counter = data;
+    int i;
+
+    for (i = 0; i < NUM_INCS; i++) {
+        apr_counter_inc(counter);
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void test_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *thds[NUM_THREADS];
+    apr_counter_t *counter;
+    apr_status_t rv, thread_rv;
+    int i;
+
+    rv = apr_counter_create(&counter, 4, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        rv = apr_thread_create(&thds[i], NULL, count_thread, counter, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        rv = apr_thread_join(&thread_rv, thds[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    ABTS_ULLONG_EQUAL(tc, (apr_uint64_t)NUM_THREADS * NUM_INCS,
+                      apr_counter_read(counter));
+}
+
+#endif /* APR_HAS_THREADS */
+
+#if APR_HAS_FORK
+
+#define NUM_PROCS 4
+
+static void test_procs(abts_case *tc, void *data)
+{
+    apr_counter_t *counter;
+    apr_proc_t procs[NUM_PROCS];
+    apr_shm_t *shm;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_shm_create(&shm, apr_counter_size(0), NULL, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "anonymous shm not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create shm segment", rv);
+
+    rv = apr_counter_init(&counter, 0, apr_shm_baseaddr_get(shm),
+                          apr_shm_size_get(shm), p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < NUM_PROCS; i++) {
+        rv = apr_proc_fork(&procs[i], p);
+        if (rv == APR_INCHILD) {
+            apr_counter_t *attached;
+            int j;
+
+            if (apr_counter_attach(&attached, apr_shm_baseaddr_get(shm),
+                                   apr_shm_size_get(shm), p)) {
+                _exit(1);
+            }
+            for (j = 0; j < NUM_INCS; j++) {
+                apr_counter_inc(attached);
+            }
+            _exit(0);
+        }
+        ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+    }
+    for (i = 0; i < NUM_PROCS; i++) {
+        apr_exit_why_e why;
+        int code;
+
+        rv = apr_proc_wait(&procs[i], &code, &why, APR_WAIT);
+        ABTS_ASSERT(tc, "child did not terminate with success",
+                    rv == APR_CHILD_DONE && why == APR_PROC_EXIT && code == 0);
+    }
+
+    ABTS_ULLONG_EQUAL(tc, (apr_uint64_t)NUM_PROCS * NUM_INCS,
+                      apr_counter_read(counter));
+
+    rv = apr_shm_destroy(shm);
+    APR_ASSERT_SUCCESS(tc, "destroy shm segment", rv);
+}
+
+#endif /* APR_HAS_FORK */
+
+abts_suite *testcounter(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_count, NULL);
+    abts_run_test(suite, test_attach, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_threads, NULL);
+#endif
+#if APR_HAS_FORK
+    abts_run_test(suite, test_procs, NULL);
+#endif
+
+    return suite;
+}
@@ -0,0 +1,108 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_crc32.h"
+#include "apr_memcache.h"
+#include "apr_redis.h"
+#include "abts.h"
+#include "testutil.h"
+
+#include <string.h>
+
+#define DATA_SIZE 1024
+
+/* The bytewise reference */
+static apr_uint32_t crc32_ref(const unsigned char *p, apr_size_t len)
+{
+    apr_uint32_t crc = 0xffffffff;
+    int k;
+
+    while (len--) {
+        crc ^= *p++;
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+static void test_crc32_vectors(abts_case *tc, void *data)
+{
+    ABTS_INT_EQUAL(tc, 0, apr_crc32(0, "", 0));
+    ABTS_INT_EQUAL(tc, 0xe8b7be43, apr_crc32(0, "a", 1));
+    ABTS_INT_EQUAL(tc, 0xcbf43926, apr_crc32(0, "123456789", 9));
+    ABTS_INT_EQUAL(tc, 0x414fa339,
+                   apr_crc32(0, "The quick brown fox jumps over the lazy dog",
+                             43));
+}
+
+static void test_crc32_sizes(abts_case *tc, void *data)
+{
+    unsigned char buf[DATA_SIZE + 8];
+    apr_size_t len, off;
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (unsigned char)(i * 7 + (i >> 8));
+    }
+
+    /* every length and alignment, as the tail and head are bytewise */
+    for (off = 0; off < 8; off++) {
+        for (len = 0; len <= 64; len++) {
+            ABTS_INT_EQUAL(tc, crc32_ref(buf + off, len),
+                           apr_crc32(0, buf + off, len));
+        }
+        ABTS_INT_EQUAL(tc, crc32_ref(buf + off, DATA_SIZE),
+                       apr_crc32(0, buf + off, DATA_SIZE));
+    }
+}
+
+static void test_crc32_update(abts_case *tc, void *data)
+{
+    const char *s = "The quick brown fox jumps over the lazy dog";
+    apr_size_t len = strlen(s), i;
+
+    for (i = 0; i <= len; i++) {
+        ABTS_INT_EQUAL(tc, 0x414fa339,
+                       apr_crc32(apr_crc32(0, s, i), s + i, len - i));
+    }
+}
+
+static void test_crc32_hashes(abts_case *tc, void *data)
+{
+    const char *key = "testmemcache1234";
+
+    /* the key distributions of existing deployments do not change */
+    ABTS_INT_EQUAL(tc, crc32_ref((const unsigned char *)key, strlen(key)),
+                   apr_memcache_hash_crc32(NULL, key, strlen(key)));
+    ABTS_INT_EQUAL(tc, crc32_ref((const unsigned char *)key, strlen(key)),
+                   apr_redis_hash_crc32(NULL, key, strlen(key)));
+    ABTS_INT_EQUAL(tc, (apr_crc32(0, key, strlen(key)) >> 16) & 0x7fff,
+                   apr_memcache_hash_default(NULL, key, strlen(key)));
+}
+
+abts_suite *testcrc32(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_crc32_vectors, NULL);
+    abts_run_test(suite, test_crc32_sizes, NULL);
+    abts_run_test(suite, test_crc32_update, NULL);
+    abts_run_test(suite, test_crc32_hashes, NULL);
+
+    return suite;
+}
@@ -1838,6 +1838,723 @@ static void test_crypto_block_openssl_pad(abts_case *tc, void *data)
     apr_pool_destroy(pool);
 
 }
+
+static unsigned char *unhex(apr_pool_t *pool, const char *hex, apr_size_t *len)
+{
+    apr_size_t i, n = strlen(hex) / 2;
+    unsigned char *buf = apr_palloc(pool, n + 1);
+
+    for (i = 0; i < n; i++) {
+        sscanf(hex + 2 * i, "%2hhx", &buf[i]);
+    }
+    if (len) {
+        *len = n;
+    }
+    return buf;
+}
+
+static apr_crypto_key_t *keyraw(abts_case *tc, apr_pool_t *pool,
+        const apr_crypto_t *f, apr_crypto_key_t *key,
+        apr_crypto_block_key_type_e type, apr_crypto_block_key_mode_e mode,
+        const char *secret, const char *description)
+{
+    apr_crypto_key_rec_t *rec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_SECRET,
+            pool);
+    apr_status_t rv;
+
+    if (!f) {
+        return NULL;
+    }
+
+    rec->type = type;
+    rec->mode = mode;
+    rec->pad = 1;
+    rec->k.secret.secret = unhex(pool, secret, &rec->k.secret.secretLen);
+
+    rv = apr_crypto_key(&key, rec, f, pool);
+    if (APR_ENOCIPHER == rv) {
+        ABTS_NOT_IMPL(tc, apr_psprintf(pool, "skipped: %s key returned "
+                "APR_ENOCIPHER", description));
+        return NULL;
+    }
+    ABTS_ASSERT(tc, apr_psprintf(pool, "failed to apr_crypto_key %s",
+            description), rv == APR_SUCCESS);
+
+    return rv ? NULL : key;
+}
+
+/**
+ * Resetting an OpenSSL block context to a new IV.
+ */
+static void test_crypto_block_reset_openssl(abts_case *tc, void *data)
+{
+    apr_pool_t *pool = NULL;
+    apr_crypto_t *f;
+    apr_crypto_key_t *key;
+    apr_crypto_block_t *enc = NULL, *dec = NULL;
+    const unsigned char *in = (const unsigned char *) TEST_STRING;
+    const unsigned char *iv1, *iv2;
+    unsigned char ct[3][32], pt[32], *out;
+    apr_size_t ctlen[3], len, fin;
+    apr_status_t rv;
+    int i;
+
+    apr_pool_create(&pool, NULL);
+    f = make(tc, pool, get_openssl_driver(tc, pool));
+    key = keyraw(tc, pool, f, NULL, APR_KEY_AES_256, APR_MODE_CBC,
+            "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+            "KEY_AES_256/MODE_CBC");
+    if (!key) {
+        apr_pool_destroy(pool);
+        return;
+    }
+    iv1 = unhex(pool, "00112233445566778899aabbccddeeff", NULL);
+    iv2 = unhex(pool, "ffeeddccbbaa99887766554433221100", NULL);
+
+    /* one init, then a reset for each message: iv1, iv2, iv1 again */
+    rv = apr_crypto_block_encrypt_init(&enc, &iv1, key, NULL, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 3; i++) {
+        if (i) {
+            rv = apr_crypto_block_reset(enc, i == 1 ? iv2 : iv1);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+        out = ct[i];
+        rv = apr_crypto_block_encrypt(&out, &len, in, sizeof(TEST_STRING), enc);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_block_encrypt_finish(ct[i] + len, &fin, enc);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ctlen[i] = len + fin;
+        ABTS_INT_EQUAL(tc, 16, (int) ctlen[i]);
+    }
+    ABTS_ASSERT(tc, "a new IV gives a new ciphertext",
+            memcmp(ct[0], ct[1], 16) != 0);
+    ABTS_ASSERT(tc, "the same IV gives the same ciphertext",
+            memcmp(ct[0], ct[2], 16) == 0);
+
+    /* and the other way around */
+    rv = apr_crypto_block_decrypt_init(&dec, NULL, iv1, key, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 3; i++) {
+        if (i) {
+            rv = apr_crypto_block_reset(dec, i == 1 ? iv2 : iv1);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+        out = pt;
+        rv = apr_crypto_block_decrypt(&out, &len, ct[i], ctlen[i], dec);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_block_decrypt_finish(pt + len, &fin, dec);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, (int) sizeof(TEST_STRING), (int) (len + fin));
+        ABTS_STR_EQUAL(tc, TEST_STRING, (char *) pt);
+    }
+
+    /* CBC wants an IV, and a cleaned up context is set up again */
+    rv = apr_crypto_block_reset(dec, NULL);
+    ABTS_INT_EQUAL(tc, APR_ENOIV, rv);
+    apr_crypto_block_cleanup(enc);
+    rv = apr_crypto_block_reset(enc, iv2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    out = pt;
+    rv = apr_crypto_block_encrypt(&out, &len, in, sizeof(TEST_STRING), enc);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_crypto_block_encrypt_finish(pt + len, &fin, enc);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "same ciphertext after cleanup",
+            memcmp(ct[1], pt, 16) == 0);
+
+    apr_pool_destroy(pool);
+}
+
+/* NIST GCM test case 4 and the RFC 8439 section 2.8.2 example */
+static const struct {
+    apr_crypto_block_key_type_e type;
+    apr_crypto_block_key_mode_e mode;
+    const char *description;
+    const char *key;
+    const char *iv;
+    const char *aad;
+    const char *pt;
+    const char *ct;
+} aead_vectors[] = {
+    {APR_KEY_AES_128, APR_MODE_GCM, "KEY_AES_128/MODE_GCM",
+     "feffe9928665731c6d6a8f9467308308",
+     "cafebabefacedbaddecaf888",
+     "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+     "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+     "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+     "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+     "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091"
+     "5bc94fbc3221a5db94fae95ae7121a47"},
+    {APR_KEY_CHACHA20, APR_MODE_POLY1305, "KEY_CHACHA20/MODE_POLY1305",
+     "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f",
+     "070000004041424344454647",
+     "50515253c0c1c2c3c4c5c6c7",
+     "4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+     "73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+     "6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+     "637265656e20776f756c642062652069742e",
+     "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+     "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+     "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+     "3ff4def08e4b7a9de576d26586cec64b6116"
+     "1ae10b594f09e26a7e902ecbd0600691"}
+};
+
+/**
+ * One-shot AEAD with OpenSSL.
+ */
+static void test_crypto_aead_openssl(abts_case *tc, void *data)
+{
+    apr_pool_t *pool = NULL;
+    apr_crypto_t *f;
+    apr_crypto_key_t *key, *other;
+    apr_crypto_block_t *block = NULL, *fresh;
+    unsigned char *iv, *aad, *pt, *ct, *out, sealed[256], opened[256];
+    apr_crypto_key_rec_t *rec;
+    apr_size_t aadlen, ptlen, ctlen, len;
+    apr_status_t rv;
+    char *secret;
+    int i, round;
+
+    apr_pool_create(&pool, NULL);
+    f = make(tc, pool, get_openssl_driver(tc, pool));
+    if (!f) {
+        apr_pool_destroy(pool);
+        return;
+    }
+
+    for (i = 0; i < sizeof(aead_vectors) / sizeof(aead_vectors[0]); i++) {
+        key = keyraw(tc, pool, f, NULL, aead_vectors[i].type,
+                aead_vectors[i].mode, aead_vectors[i].key,
+                aead_vectors[i].description);
+        if (!key) {
+            continue;
+        }
+        iv = unhex(pool, aead_vectors[i].iv, NULL);
+        aad = unhex(pool, aead_vectors[i].aad, &aadlen);
+        pt = unhex(pool, aead_vectors[i].pt, &ptlen);
+        ct = unhex(pool, aead_vectors[i].ct, &ctlen);
+
+        rv = apr_crypto_aead_seal(&block, NULL, &len, pt, ptlen, aad, aadlen,
+                iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, (int) ctlen, (int) len);
+
+        /* twice on the same context, the second reusing the key schedule */
+        for (round = 0; round < 2; round++) {
+            memset(sealed, 0, sizeof(sealed));
+            rv = apr_crypto_aead_seal(&block, sealed, &len, pt, ptlen,
+                    aad, aadlen, iv, key, pool);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_INT_EQUAL(tc, (int) ctlen, (int) len);
+            ABTS_ASSERT(tc, aead_vectors[i].description,
+                    memcmp(sealed, ct, ctlen) == 0);
+
+            rv = apr_crypto_aead_open(&block, opened, &len, sealed, ctlen,
+                    aad, aadlen, iv, key, pool);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_INT_EQUAL(tc, (int) ptlen, (int) len);
+            ABTS_ASSERT(tc, aead_vectors[i].description,
+                    memcmp(opened, pt, ptlen) == 0);
+        }
+
+        /* any change to the ciphertext, tag or additional data is caught */
+        sealed[3] ^= 1;
+        rv = apr_crypto_aead_open(&block, opened, &len, sealed, ctlen,
+                aad, aadlen, iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+        ABTS_ASSERT(tc, "plaintext cleared", opened[0] == 0 && opened[3] == 0);
+        sealed[3] ^= 1;
+        sealed[ctlen - 1] ^= 0x80;
+        rv = apr_crypto_aead_open(&block, opened, &len, sealed, ctlen,
+                aad, aadlen, iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+        sealed[ctlen - 1] ^= 0x80;
+        rv = apr_crypto_aead_open(&block, opened, &len, sealed, ctlen,
+                aad, aadlen - 1, iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+        rv = apr_crypto_aead_open(&block, opened, &len, sealed,
+                APR_CRYPTO_AEAD_TAGSIZE - 1, aad, aadlen, iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+        rv = apr_crypto_aead_open(&block, opened, &len, sealed, ctlen,
+                aad, aadlen, iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        /* empty messages, without additional data */
+        rv = apr_crypto_aead_seal(&block, sealed, &len, NULL, 0, NULL, 0,
+                iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, APR_CRYPTO_AEAD_TAGSIZE, (int) len);
+        rv = apr_crypto_aead_open(&block, opened, &len, sealed,
+                APR_CRYPTO_AEAD_TAGSIZE, NULL, 0, iv, key, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 0, (int) len);
+
+        /* a key derived again in the same structure is not mistaken for
+         * the previous one by the context
+         */
+        secret = apr_pstrdup(pool, aead_vectors[i].key);
+        secret[0] = secret[0] == '0' ? '1' : '0';
+        other = keyraw(tc, pool, f, key, aead_vectors[i].type,
+                aead_vectors[i].mode, secret, aead_vectors[i].description);
+        ABTS_PTR_EQUAL(tc, key, other);
+        if (!other) {
+            continue;
+        }
+        rv = apr_crypto_aead_seal(&block, sealed, &len, pt, ptlen,
+                aad, aadlen, iv, other, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_ASSERT(tc, "new key, new ciphertext",
+                memcmp(sealed, ct, ctlen) != 0);
+        fresh = NULL;
+        out = apr_palloc(pool, ctlen);
+        rv = apr_crypto_aead_seal(&fresh, out, &len, pt, ptlen,
+                aad, aadlen, iv, other, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_ASSERT(tc, "same as a fresh context",
+                memcmp(sealed, out, ctlen) == 0);
+
+        /* the AEAD keys don't do the unauthenticated block API */
+        fresh = NULL;
+        rv = apr_crypto_block_encrypt_init(&fresh,
+                (const unsigned char **) &iv, other, NULL, pool);
+        ABTS_INT_EQUAL(tc, APR_ENOCIPHER, rv);
+    }
+
+    /* nor the block keys the AEAD API */
+    key = keyraw(tc, pool, f, NULL, APR_KEY_AES_128, APR_MODE_CBC,
+            aead_vectors[0].key, "KEY_AES_128/MODE_CBC");
+    rv = apr_crypto_aead_seal(&block, sealed, &len, sealed, 16, NULL, 0,
+            sealed, key, pool);
+    ABTS_INT_EQUAL(tc, APR_ENOCIPHER, rv);
+    rec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_SECRET, pool);
+    rec->type = APR_KEY_3DES_192;
+    rec->mode = APR_MODE_GCM;
+    rec->k.secret.secret = unhex(pool, aead_vectors[1].key,
+            &rec->k.secret.secretLen);
+    key = NULL;
+    rv = apr_crypto_key(&key, rec, f, pool);
+    ABTS_INT_EQUAL(tc, APR_ENOCIPHER, rv);
+
+    apr_pool_destroy(pool);
+}
+
+/* Run a stream through a brigade stage in buckets of split bytes, each
+ * processed apart, and flatten what comes out before the EOS */
+static apr_status_t brigade_crypt(apr_crypto_brigade_t *ctx,
+        apr_bucket_alloc_t *ba, apr_pool_t *pool,
+        const unsigned char *in, apr_size_t inlen, apr_size_t split,
+        char **out, apr_size_t *outlen)
+{
+    apr_bucket_brigade *bbin = apr_brigade_create(pool, ba);
+    apr_bucket_brigade *bbout = apr_brigade_create(pool, ba);
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t off, n;
+
+    for (off = 0; off < inlen && rv == APR_SUCCESS; off += n) {
+        n = inlen - off < split ? inlen - off : split;
+        APR_BRIGADE_INSERT_TAIL(bbin, apr_bucket_transient_create(
+                (const char *) in + off, n, ba));
+        rv = apr_crypto_brigade_process(ctx, bbout, bbin, APR_BLOCK_READ);
+    }
+    if (rv == APR_SUCCESS) {
+        APR_BRIGADE_INSERT_TAIL(bbin, apr_bucket_eos_create(ba));
+        rv = apr_crypto_brigade_process(ctx, bbout, bbin, APR_BLOCK_READ);
+    }
+    if (rv == APR_SUCCESS && !APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(bbout))) {
+        rv = APR_EGENERAL;
+    }
+    if (rv == APR_SUCCESS) {
+        rv = apr_brigade_pflatten(bbout, out, outlen, pool);
+    }
+
+    apr_brigade_destroy(bbin);
+    apr_brigade_destroy(bbout);
+    return rv;
+}
+
+/**
+ * Test of one shot HMAC and reused digests with the keyed state of the key.
+ */
+static void test_crypto_hmac_openssl(abts_case *tc, void *data)
+{
+    /* RFC 4231 test case 2 */
+    const char *msg = "what do ya want for nothing?";
+    const char *expect = "5bdcc146bf60754e6a042426089575c7"
+                         "5a003f089d2739839dec58b964ec3843";
+    apr_pool_t *pool = NULL;
+    apr_crypto_t *f;
+    apr_crypto_key_t *key = NULL, *hash = NULL;
+    apr_crypto_key_rec_t *rec;
+    apr_crypto_digest_t *digest = NULL;
+    apr_crypto_digest_rec_t *sign, *verify;
+    unsigned char *mac, out[64], small[16];
+    apr_size_t len;
+    apr_status_t rv;
+    int round;
+
+    apr_pool_create(&pool, NULL);
+    f = make(tc, pool, get_openssl_driver(tc, pool));
+    if (!f) {
+        apr_pool_destroy(pool);
+        return;
+    }
+    mac = unhex(pool, expect, NULL);
+
+    rec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_HMAC, pool);
+    rec->k.hmac.digest = APR_CRYPTO_DIGEST_SHA256;
+    rec->k.hmac.secret = (const unsigned char *) "Jefe";
+    rec->k.hmac.secretLen = 4;
+    rv = apr_crypto_key(&key, rec, f, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (rv) {
+        apr_pool_destroy(pool);
+        return;
+    }
+
+    rv = apr_crypto_hmac(key, (const unsigned char *) msg, strlen(msg),
+            NULL, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 32, (int) len);
+
+    len = sizeof(small);
+    rv = apr_crypto_hmac(key, (const unsigned char *) msg, strlen(msg),
+            small, &len);
+    ABTS_INT_EQUAL(tc, APR_ENOSPACE, rv);
+    ABTS_INT_EQUAL(tc, 32, (int) len);
+
+    sign = apr_crypto_digest_rec_make(APR_CRYPTO_DTYPE_SIGN, pool);
+    verify = apr_crypto_digest_rec_make(APR_CRYPTO_DTYPE_VERIFY, pool);
+    verify->d.verify.v = mac;
+    verify->d.verify.vlen = 32;
+
+    /* the contexts are given back to the key and reused each round */
+    for (round = 0; round < 3; round++) {
+        memset(out, 0, sizeof(out));
+        len = sizeof(out);
+        rv = apr_crypto_hmac(key, (const unsigned char *) msg, strlen(msg),
+                out, &len);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 32, (int) len);
+        ABTS_ASSERT(tc, "one shot hmac", memcmp(out, mac, 32) == 0);
+
+        rv = apr_crypto_digest_init(&digest, key, sign, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_digest_update(digest, (const unsigned char *) msg, 4);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_digest_update(digest,
+                (const unsigned char *) msg + 4, strlen(msg) - 4);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_digest_final(digest);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 32, (int) sign->d.sign.slen);
+        ABTS_ASSERT(tc, "reused digest",
+                memcmp(sign->d.sign.s, mac, 32) == 0);
+
+        rv = apr_crypto_digest_init(&digest, key, verify, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_digest_update(digest, (const unsigned char *) msg,
+                strlen(msg) - round);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_digest_final(digest);
+        ABTS_INT_EQUAL(tc, round ? APR_ENOVERIFY : APR_SUCCESS, rv);
+
+        rv = apr_crypto_digest(key, verify, (const unsigned char *) msg,
+                strlen(msg), pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* not a MAC */
+    rec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_HASH, pool);
+    rec->k.hash.digest = APR_CRYPTO_DIGEST_SHA256;
+    rv = apr_crypto_key(&hash, rec, f, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    len = sizeof(out);
+    rv = apr_crypto_hmac(hash, (const unsigned char *) msg, strlen(msg),
+            out, &len);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    apr_pool_destroy(pool);
+}
+
+/* Encrypt a fixed block with a fixed IV, to compare the keys */
+static unsigned char *cache_encrypt(abts_case *tc, const apr_crypto_key_t *key,
+        apr_pool_t *pool)
+{
+    static const unsigned char in[32] = "thirty two bytes of plaintext..";
+    const unsigned char *iv = (const unsigned char *) "0123456789abcdef";
+    apr_crypto_block_t *block = NULL;
+    unsigned char *out = NULL;
+    apr_size_t blockSize, len, flen;
+    apr_status_t rv;
+
+    rv = apr_crypto_block_encrypt_init(&block, &iv, key, &blockSize, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_crypto_block_encrypt(&out, &len, in, sizeof(in), block);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_crypto_block_encrypt_finish(out + len, &flen, block);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, (int) sizeof(in), (int) (len + flen));
+
+    return out;
+}
+
+/**
+ * Test of the cache of the keys derived from passphrases.
+ */
+static void test_crypto_key_cache_openssl(abts_case *tc, void *data)
+{
+    const char *passes[] = { "secret", "another secret", "and a third" };
+    apr_pool_t *pool = NULL;
+    apr_crypto_t *f;
+    apr_crypto_key_cache_t *cache;
+    apr_crypto_key_rec_t *rec;
+    apr_crypto_key_t *key;
+    unsigned char *expect[3], *out;
+    apr_status_t rv;
+    int i, round;
+
+    apr_pool_create(&pool, NULL);
+    f = make(tc, pool, get_openssl_driver(tc, pool));
+    if (!f) {
+        apr_pool_destroy(pool);
+        return;
+    }
+
+    rv = apr_crypto_key_cache_create(&cache, 0, f, pool);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_crypto_key_cache_create(&cache, 2, f, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (rv) {
+        apr_pool_destroy(pool);
+        return;
+    }
+
+    rec = apr_crypto_key_rec_make(APR_CRYPTO_KTYPE_PASSPHRASE, pool);
+    rec->type = APR_KEY_AES_256;
+    rec->mode = APR_MODE_CBC;
+    rec->pad = 0;
+    rec->k.passphrase.salt = (const unsigned char *) "salty";
+    rec->k.passphrase.saltLen = 5;
+    rec->k.passphrase.iterations = 1000;
+
+    /* the keys the driver derives itself */
+    for (i = 0; i < 3; i++) {
+        rec->k.passphrase.pass = passes[i];
+        rec->k.passphrase.passLen = strlen(passes[i]);
+        key = NULL;
+        rv = apr_crypto_key(&key, rec, f, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        expect[i] = cache_encrypt(tc, key, pool);
+    }
+
+    /* derived, then found, then derived again when evicted by the third */
+    for (round = 0; round < 3; round++) {
+        for (i = 0; i < 3; i++) {
+            rec->k.passphrase.pass = passes[i];
+            rec->k.passphrase.passLen = strlen(passes[i]);
+            key = NULL;
+            rv = apr_crypto_key_cached(&key, rec, cache, pool);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            out = cache_encrypt(tc, key, pool);
+            ABTS_ASSERT(tc, passes[i], memcmp(out, expect[i], 32) == 0);
+
+            key = NULL;
+            rv = apr_crypto_key_cached(&key, rec, cache, pool);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            out = cache_encrypt(tc, key, pool);
+            ABTS_ASSERT(tc, passes[i], memcmp(out, expect[i], 32) == 0);
+        }
+        if (round == 1) {
+            apr_crypto_key_cache_clear(cache);
+        }
+    }
+
+    /* another salt, iteration count or key length is another key */
+    rec->k.passphrase.salt = (const unsigned char *) "salt";
+    rec->k.passphrase.saltLen = 4;
+    key = NULL;
+    rv = apr_crypto_key_cached(&key, rec, cache, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    out = cache_encrypt(tc, key, pool);
+    ABTS_ASSERT(tc, "other salt", memcmp(out, expect[2], 32) != 0);
+
+    rec->k.passphrase.salt = (const unsigned char *) "salty";
+    rec->k.passphrase.saltLen = 5;
+    rec->k.passphrase.iterations = 999;
+    key = NULL;
+    rv = apr_crypto_key_cached(&key, rec, cache, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    out = cache_encrypt(tc, key, pool);
+    ABTS_ASSERT(tc, "other iterations", memcmp(out, expect[2], 32) != 0);
+
+    rec->k.passphrase.iterations = 1000;
+    rec->type = APR_KEY_AES_128;
+    key = NULL;
+    rv = apr_crypto_key_cached(&key, rec, cache, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    out = cache_encrypt(tc, key, pool);
+    ABTS_ASSERT(tc, "other cipher", memcmp(out, expect[2], 32) != 0);
+    key = NULL;
+    rv = apr_crypto_key(&key, rec, f, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "aes-128", memcmp(out, cache_encrypt(tc, key, pool),
+            32) == 0);
+
+    apr_pool_destroy(pool);
+}
+
+/**
+ * Streaming encryption and decryption of brigades with OpenSSL.
+ */
+static void test_crypto_brigade_openssl(abts_case *tc, void *data)
+{
+    static const apr_size_t sizes[] = { 0, 1, 99, 100, 101, 250, 40000 };
+    static const apr_size_t splits[] = { 1, 7, 4096, 100000 };
+    static const struct {
+        apr_crypto_block_key_type_e type;
+        apr_crypto_block_key_mode_e mode;
+        apr_uint32_t flags;
+        apr_size_t chunk;
+        const char *description;
+    } stages[] = {
+        { APR_KEY_AES_256, APR_MODE_CBC, 0, 0, "KEY_AES_256/MODE_CBC" },
+        { APR_KEY_AES_128, APR_MODE_GCM, APR_CRYPTO_BRIGADE_AEAD, 100,
+          "KEY_AES_128/MODE_GCM" },
+        { APR_KEY_CHACHA20, APR_MODE_POLY1305, APR_CRYPTO_BRIGADE_AEAD, 0,
+          "KEY_CHACHA20/MODE_POLY1305" }
+    };
+    apr_pool_t *pool = NULL;
+    apr_bucket_alloc_t *ba;
+    apr_crypto_t *f;
+    apr_crypto_key_t *key;
+    apr_crypto_brigade_t *enc, *dec;
+    apr_bucket_brigade *bb;
+    const unsigned char *iv1, *iv2;
+    unsigned char *in;
+    char *ct, *pt, *ct2;
+    apr_size_t i, ctlen, ptlen, ct2len, chunk;
+    apr_status_t rv;
+    int s, j, k;
+
+    apr_pool_create(&pool, NULL);
+    f = make(tc, pool, get_openssl_driver(tc, pool));
+    if (!f) {
+        apr_pool_destroy(pool);
+        return;
+    }
+    ba = apr_bucket_alloc_create(pool);
+    in = apr_palloc(pool, 40000);
+    for (i = 0; i < 40000; i++) {
+        in[i] = (unsigned char) (i * 7 + (i >> 8));
+    }
+    iv1 = unhex(pool, "00112233445566778899aabbccddeeff", NULL);
+    iv2 = unhex(pool, "ffeeddccbbaa99887766554433221100", NULL);
+
+    for (s = 0; s < sizeof(stages) / sizeof(stages[0]); s++) {
+        key = keyraw(tc, pool, f, NULL, stages[s].type, stages[s].mode,
+                "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+                + (stages[s].type == APR_KEY_AES_128 ? 32 : 0),
+                stages[s].description);
+        if (!key) {
+            continue;
+        }
+        chunk = stages[s].chunk ? stages[s].chunk
+                                : APR_CRYPTO_BRIGADE_CHUNK_DEFAULT;
+
+        rv = apr_crypto_brigade_create(&enc, key, iv1, stages[s].chunk,
+                stages[s].flags, ba, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_crypto_brigade_create(&dec, key, iv1, stages[s].chunk,
+                stages[s].flags | APR_CRYPTO_BRIGADE_DECRYPT, ba, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (!enc || !dec) {
+            continue;
+        }
+
+        /* round trips, the contexts being reset for each stream */
+        for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+            for (k = 0; k < sizeof(splits) / sizeof(splits[0]); k++) {
+                if (j || k) {
+                    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                            apr_crypto_brigade_reset(enc, iv1));
+                    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                            apr_crypto_brigade_reset(dec, iv1));
+                }
+                rv = brigade_crypt(enc, ba, pool, in, sizes[j], splits[k],
+                        &ct, &ctlen);
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                if (stages[s].flags & APR_CRYPTO_BRIGADE_AEAD) {
+                    ABTS_SIZE_EQUAL(tc, sizes[j] + (sizes[j] / chunk + 1)
+                            * APR_CRYPTO_AEAD_TAGSIZE, ctlen);
+                }
+                else {
+                    ABTS_SIZE_EQUAL(tc, (sizes[j] / 16 + 1) * 16, ctlen);
+                }
+                rv = brigade_crypt(dec, ba, pool, (unsigned char *) ct,
+                        ctlen, splits[(k + 1) % 4], &pt, &ptlen);
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                ABTS_SIZE_EQUAL(tc, sizes[j], ptlen);
+                ABTS_ASSERT(tc, "round trip", rv == APR_SUCCESS
+                        && memcmp(pt, in, sizes[j]) == 0);
+            }
+        }
+
+        /* the same stream whatever the buckets, another one for another IV */
+        apr_crypto_brigade_reset(enc, iv1);
+        rv = brigade_crypt(enc, ba, pool, in, 250, 7, &ct, &ctlen);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        apr_crypto_brigade_reset(enc, iv1);
+        rv = brigade_crypt(enc, ba, pool, in, 250, 250, &ct2, &ct2len);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_ASSERT(tc, "same stream", ct2len == ctlen
+                && memcmp(ct, ct2, ctlen) == 0);
+        apr_crypto_brigade_reset(enc, iv2);
+        rv = brigade_crypt(enc, ba, pool, in, 250, 250, &ct2, &ct2len);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_ASSERT(tc, "new IV, new stream", ct2len == ctlen
+                && memcmp(ct, ct2, ctlen) != 0);
+
+        /* no more data once ended, until reset */
+        bb = apr_brigade_create(pool, ba);
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("x", 1, ba));
+        rv = apr_crypto_brigade_process(enc, bb, bb, APR_BLOCK_READ);
+        ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+        apr_brigade_cleanup(bb);
+
+        if (!(stages[s].flags & APR_CRYPTO_BRIGADE_AEAD)) {
+            continue;
+        }
+
+        /* tampering, truncation at and within a chunk, reordering */
+        ct2 = apr_pmemdup(pool, ct, ctlen);
+        ct2[150] ^= 1;
+        apr_crypto_brigade_reset(dec, iv1);
+        rv = brigade_crypt(dec, ba, pool, (unsigned char *) ct2, ctlen,
+                4096, &pt, &ptlen);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+        if (chunk != 100) {
+            continue;
+        }
+        apr_crypto_brigade_reset(dec, iv1);
+        rv = brigade_crypt(dec, ba, pool, (unsigned char *) ct, 2 * 116,
+                4096, &pt, &ptlen);
+        ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+        apr_crypto_brigade_reset(dec, iv1);
+        rv = brigade_crypt(dec, ba, pool, (unsigned char *) ct, 116 + 50,
+                4096, &pt, &ptlen);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+        memcpy(ct2, ct + 116, 116);
+        memcpy(ct2 + 116, ct, 116);
+        apr_crypto_brigade_reset(dec, iv1);
+        rv = brigade_crypt(dec, ba, pool, (unsigned char *) ct2, ctlen,
+                4096, &pt, &ptlen);
+        ABTS_INT_EQUAL(tc, APR_ENOVERIFY, rv);
+    }
+
+    apr_pool_destroy(pool);
+}
 #endif /* APU_HAVE_OPENSSL */
 
 #if APU_HAVE_NSS
@@ -2239,6 +2956,7 @@ static void test_crypto_get_block_key_modes_openssl(abts_case *tc, void *data)
     apr_hash_t *modes;
     int *mode_ecb;
     int *mode_cbc;
+    int *mode_gcm;
 
     apr_pool_create(&pool, NULL);
     driver = get_openssl_driver(tc, pool);
@@ -2255,6 +2973,10 @@ static void test_crypto_get_block_key_modes_openssl(abts_case *tc, void *data)
         ABTS_PTR_NOTNULL(tc, mode_cbc);
         ABTS_INT_EQUAL(tc, *mode_cbc, APR_MODE_CBC);
 
+        mode_gcm = apr_hash_get(modes, "gcm", APR_HASH_KEY_STRING);
+        ABTS_PTR_NOTNULL(tc, mode_gcm);
+        ABTS_INT_EQUAL(tc, *mode_gcm, APR_MODE_GCM);
+
     }
 
     apr_pool_destroy(pool);
@@ -2675,6 +3397,95 @@ static void test_crypto_thread_random(abts_case *tc, void *data)
 
     apr_pool_destroy(pool);
 }
+
+#if APR_HAS_FORK
+typedef struct {
+    abts_case *tc;
+    apr_pool_t *pool;
+} fork_thread_t;
+
+static void *APR_THREAD_FUNC fork_thread_func(apr_thread_t *thd, void *data)
+{
+    fork_thread_t *ft = data;
+    abts_case *tc = ft->tc;
+    unsigned char randbytes[64];
+    apr_file_t *pread = NULL;
+    apr_file_t *pwrite = NULL;
+    apr_size_t nbytes;
+    apr_proc_t proc;
+    apr_status_t rv;
+
+    /* Fill the buffer of this thread's CPRNG before forking */
+    rv = apr_crypto_random_thread_bytes(randbytes, 16);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_file_pipe_create(&pread, &pwrite, ft->pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_proc_fork(&proc, ft->pool);
+    if (rv == APR_INCHILD) {
+        apr_file_close(pread);
+        rv = apr_crypto_random_thread_bytes(randbytes, 64);
+        if (rv == APR_SUCCESS) {
+            apr_file_write_full(pwrite, randbytes, 64, &nbytes);
+        }
+        apr_file_close(pwrite);
+
+        exit(rv != APR_SUCCESS);
+    }
+    else if (rv == APR_INPARENT) {
+        int exitcode;
+        apr_exit_why_e why;
+        unsigned char childbytes[64];
+
+        apr_file_close(pwrite);
+        rv = apr_file_read_full(pread, childbytes, 64, &nbytes);
+        ABTS_INT_EQUAL(tc, 64, (int)nbytes);
+        apr_file_close(pread);
+
+        apr_proc_wait(&proc, &exitcode, &why, APR_WAIT);
+        ABTS_ASSERT(tc, "apr_crypto_random_thread_bytes failed in child",
+                    why == APR_PROC_EXIT && exitcode == 0);
+
+        rv = apr_crypto_random_thread_bytes(randbytes, 64);
+        ABTS_ASSERT(tc, "apr_crypto_random_thread_bytes failed in parent",
+                    rv == APR_SUCCESS);
+        ABTS_ASSERT(tc, "parent and child threads generated same random bytes",
+                    memcmp(randbytes, childbytes, 64) != 0);
+    }
+    else {
+        ABTS_FAIL(tc, "apr_proc_fork failed");
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void test_crypto_fork_thread_random(abts_case *tc, void *data)
+{
+    apr_pool_t *pool = NULL;
+    apr_thread_t *thread;
+    fork_thread_t ft;
+    apr_status_t rv, ret;
+
+    rv = apr_pool_create(&pool, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_crypto_prng_init(pool, NULL, APR_CRYPTO_CIPHER_AUTO, 0, NULL,
+                              APR_CRYPTO_PRNG_PER_THREAD);
+    ABTS_ASSERT(tc, "apr_crypto_prng_init failed", rv == APR_SUCCESS);
+
+    /* From a thread, for its CPRNG to go away with it */
+    ft.tc = tc;
+    ft.pool = pool;
+    rv = apr_thread_create(&thread, NULL, fork_thread_func, &ft, pool);
+    ABTS_ASSERT(tc, "apr_thread_create failed", rv == APR_SUCCESS);
+    rv = apr_thread_join(&ret, thread);
+    ABTS_ASSERT(tc, "apr_thread_join failed", rv == APR_SUCCESS);
+
+    apr_pool_destroy(pool);
+}
+#endif /* APR_HAS_FORK */
 #endif /* APR_HAS_THREADS */
 #endif /* APU_HAVE_CRYPTO_PRNG */
 
@@ -2694,6 +3505,16 @@ abts_suite *testcrypto(abts_suite *suite)
     abts_run_test(suite, test_crypto_digest_openssl, NULL);
     /* test a padded encrypt / decrypt operation - openssl */
     abts_run_test(suite, test_crypto_block_openssl_pad, NULL);
+    /* test resetting a block context to a new IV - openssl */
+    abts_run_test(suite, test_crypto_block_reset_openssl, NULL);
+    /* test one-shot authenticated encryption - openssl */
+    abts_run_test(suite, test_crypto_aead_openssl, NULL);
+    /* test one-shot hmac and reused digests - openssl */
+    abts_run_test(suite, test_crypto_hmac_openssl, NULL);
+    /* test the cache of the keys of passphrases - openssl */
+    abts_run_test(suite, test_crypto_key_cache_openssl, NULL);
+    /* test streaming encryption of brigades - openssl */
+    abts_run_test(suite, test_crypto_brigade_openssl, NULL);
     /* test block key types openssl */
     abts_run_test(suite, test_crypto_get_block_key_types_openssl, NULL);
     /* test block key modes openssl */
@@ -2774,6 +3595,9 @@ abts_suite *testcrypto(abts_suite *suite)
 #endif
 #if APR_HAS_THREADS
     abts_run_test(suite, test_crypto_thread_random, NULL);
+#if APR_HAS_FORK
+    abts_run_test(suite, test_crypto_fork_thread_random, NULL);
+#endif
 #endif
 #endif
 
@@ -173,6 +173,58 @@ static void test_date_parse_http(abts_case *tc, void *data)
     }
 }
 
+static void test_date_parse_fixdate(abts_case *tc, void *data)
+{
+    static const char *const bad[] = {
+        "Sun, 06 Nov 1994 24:49:37 GMT",
+        "Sun, 31 Apr 1994 08:49:37 GMT",
+        "Sun, 06 Nox 1994 08:49:37 GMT",
+        "Sun, 06 Nov 1894 08:49:37 GMT",
+        "Sun, 06 Nov 1994 08:49:3",
+        "Sun, 06 N",
+        "Sun, 06 Nov 19a4 08:49:37 GMT",
+        NULL
+    };
+    int i;
+
+    ABTS_TRUE(tc, apr_date_parse_http("Sun, 06 Nov 1994 08:49:37 GMT")
+                  == APR_TIME_C(784111777) * APR_USEC_PER_SEC);
+    ABTS_TRUE(tc, apr_date_parse_http("  Sun, 06 Nov 1994 08:49:37 +0000")
+                  == APR_TIME_C(784111777) * APR_USEC_PER_SEC);
+    ABTS_TRUE(tc, apr_date_parse_http("Sunday, 06-Nov-94 08:49:37 GMT")
+                  == APR_TIME_C(784111777) * APR_USEC_PER_SEC);
+    for (i = 0; bad[i]; i++) {
+        ABTS_TRUE(tc, apr_date_parse_http(bad[i]) == APR_DATE_BAD);
+    }
+}
+
+static void test_date_rfc822_recent(abts_case *tc, void *data)
+{
+    char expected[APR_RFC822_DATE_LEN], str[APR_RFC822_DATE_LEN];
+    apr_time_t t, base = apr_time_now();
+    int i;
+
+    /* the same seconds, and those sharing their cache slots */
+    for (i = 0; i < 200; i++) {
+        t = base + (apr_time_t)(i % 50) * (APR_USEC_PER_SEC / 2)
+                 + (i / 50) * APR_TIME_C(16) * APR_USEC_PER_SEC;
+        apr_rfc822_date(expected, t);
+        apr_date_rfc822_recent(str, t);
+        ABTS_STR_EQUAL(tc, expected, str);
+        apr_date_rfc822_recent(str, t);
+        ABTS_STR_EQUAL(tc, expected, str);
+    }
+
+    t = -APR_USEC_PER_SEC / 2;
+    apr_rfc822_date(expected, t);
+    apr_date_rfc822_recent(str, t);
+    ABTS_STR_EQUAL(tc, expected, str);
+    t = 0;
+    apr_rfc822_date(expected, t);
+    apr_date_rfc822_recent(str, t);
+    ABTS_STR_EQUAL(tc, expected, str);
+}
+
 static void test_date_rfc(abts_case *tc, void *data)
 {
     apr_time_t date;
@@ -222,6 +274,8 @@ abts_suite *testdate(abts_suite *suite)
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_date_parse_http, NULL);
+    abts_run_test(suite, test_date_parse_fixdate, NULL);
+    abts_run_test(suite, test_date_rfc822_recent, NULL);
     abts_run_test(suite, test_date_rfc, NULL);
     abts_run_test(suite, test_date_exp_get, NULL);
 
@@ -104,14 +104,25 @@ static void select_rows(abts_case *tc, apr_dbd_t* handle,
     apr_pool_create(&tpool, pool);
     i = count;
     while (i > 0) {
+        int col3 = -1;
+
         row = NULL;
         rv = apr_dbd_get_row(driver, pool, res, &row, -1);
         ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
         ABTS_PTR_NOTNULL(tc, row);
+        if (row) {
+            rv = apr_dbd_datum_get(driver, row, 2, APR_DBD_TYPE_INT, &col3);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_INT_EQUAL(tc, count - i, col3);
+        }
         apr_pool_clear(tpool);
         i--;
     }
     ABTS_ASSERT(tc, "Missing Rows!", i == 0);
+    /* a stream is done with once read to the end */
+    row = NULL;
+    rv = apr_dbd_get_row(driver, pool, res, &row, -1);
+    ABTS_ASSERT(tc, "Extra Rows!", rv == -1);
 
     res = NULL;
     i = count;
@@ -136,6 +147,160 @@ static void select_rows(abts_case *tc, apr_dbd_t* handle,
     ABTS_ASSERT(tc, "If we overseek, get_row should return -1", rv == -1);
 }
 
+static void send_queries(abts_case *tc, apr_dbd_t* handle,
+                         const apr_dbd_driver_t* driver, int count)
+{
+    apr_pool_t* pool = p;
+    const char* sql = "SELECT * FROM apr_dbd_test WHERE col3 < %d";
+    apr_dbd_prepared_t *statement = NULL;
+    apr_dbd_results_t *res;
+    apr_socket_t *sock;
+    const char *args[1];
+    int i, nrows;
+    apr_status_t rv;
+
+    rv = apr_dbd_prepare(driver, pool, handle, sql, NULL, &statement);
+    ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
+
+    /* keep them all in flight, then collect them in order */
+    for (i = 0; i <= count; i++) {
+        args[0] = apr_itoa(pool, i);
+        rv = apr_dbd_send_query(driver, pool, handle, statement, args);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_INT_EQUAL(tc, APR_ENOTIMPL, apr_dbd_socket_get(driver,
+                                                                pool, handle,
+                                                                &sock));
+            return;
+        }
+        ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
+    }
+    rv = apr_dbd_socket_get(driver, pool, handle, &sock);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i <= count; i++) {
+        res = NULL;
+        rv = apr_dbd_poll_result(driver, pool, handle, &res, &nrows, 1);
+        ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
+        ABTS_INT_EQUAL(tc, i, nrows);
+        ABTS_PTR_NOTNULL(tc, res);
+        if (res)
+            ABTS_INT_EQUAL(tc, i, apr_dbd_num_tuples(driver, res));
+    }
+    rv = apr_dbd_poll_result(driver, pool, handle, NULL, NULL, 0);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+}
+
+static void cached_statements(abts_case *tc, apr_dbd_t* handle,
+                              const apr_dbd_driver_t* driver, int count)
+{
+    apr_pool_t* pool = p;
+    const char* sql = "SELECT * FROM apr_dbd_test WHERE col3 < %d";
+    const char* sql2 = "SELECT * FROM apr_dbd_test WHERE col3 > %d";
+    apr_dbd_stmt_cache_t *cache;
+    apr_dbd_prepared_t *statement, *again;
+    apr_dbd_results_t *res;
+    int i, rv;
+
+    rv = apr_dbd_stmt_cache_create(&cache, driver, handle, 1, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_dbd_stmt_cache_prepare(cache, sql, NULL, &statement);
+    ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
+    rv = apr_dbd_stmt_cache_prepare(cache, sql, NULL, &again);
+    ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
+    ABTS_PTR_EQUAL(tc, statement, again);
+
+    /* one drops the other, prepared again when needed */
+    for (i = 0; i < count; i++) {
+        res = NULL;
+        rv = apr_dbd_stmt_cache_pvselect(cache, pool, &res,
+                                         i % 2 ? sql2 : sql, 1,
+                                         apr_itoa(pool, i));
+        ABTS_ASSERT(tc, sql, rv == APR_SUCCESS);
+        ABTS_INT_EQUAL(tc, i % 2 ? count - 1 - i : i,
+                       apr_dbd_num_tuples(driver, res));
+    }
+
+    apr_dbd_stmt_cache_clear(cache);
+}
+
+static void bulk_load(abts_case *tc, apr_dbd_t* handle,
+                      const apr_dbd_driver_t* driver, int count)
+{
+    apr_pool_t* pool = p;
+    const char *cols[] = { "col1", "col2", "col3" };
+    const char *values[3];
+    const char* sql = "SELECT * FROM apr_dbd_test WHERE col3 >= 100";
+    apr_dbd_bulk_t *bulk = NULL;
+    apr_dbd_results_t *res = NULL;
+    apr_dbd_row_t *row = NULL;
+    int i, nrows = -1;
+    apr_status_t rv;
+
+    rv = apr_dbd_bulk_begin(driver, pool, handle, "apr_dbd_test", cols, 3,
+                            &bulk);
+    if (rv == APR_ENOTIMPL) {
+        return;
+    }
+    ABTS_INT_EQUAL(tc, 0, rv);
+
+    for (i = 0; i < count; i++) {
+        values[0] = apr_psprintf(pool, "bulk\t%d\\", i);
+        values[1] = i % 2 ? NULL : "x";
+        values[2] = apr_itoa(pool, 100 + i);
+        rv = apr_dbd_bulk_append_row(bulk, values);
+        ABTS_INT_EQUAL(tc, 0, rv);
+    }
+    rv = apr_dbd_bulk_end(bulk, &nrows);
+    ABTS_INT_EQUAL(tc, 0, rv);
+    ABTS_INT_EQUAL(tc, count, nrows);
+
+    rv = apr_dbd_select(driver, pool, handle, &res,
+                        apr_pstrcat(pool, sql, " ORDER BY col3", NULL), 1);
+    ABTS_INT_EQUAL(tc, 0, rv);
+    ABTS_INT_EQUAL(tc, count, apr_dbd_num_tuples(driver, res));
+    for (i = 0; i < count; i++) {
+        rv = apr_dbd_get_row(driver, pool, res, &row, -1);
+        ABTS_INT_EQUAL(tc, 0, rv);
+        ABTS_STR_EQUAL(tc, apr_psprintf(pool, "bulk\t%d\\", i),
+                       apr_dbd_get_entry(driver, row, 0));
+        if (i % 2) {
+            ABTS_PTR_EQUAL(tc, NULL, apr_dbd_get_entry(driver, row, 1));
+        }
+    }
+
+    /* a failed row takes the whole load with it */
+    rv = apr_dbd_bulk_begin(driver, pool, handle, "apr_dbd_test", cols, 3,
+                            &bulk);
+    ABTS_INT_EQUAL(tc, 0, rv);
+    values[0] = "bulk";
+    values[1] = NULL;
+    values[2] = "200";
+    rv = apr_dbd_bulk_append_row(bulk, values);
+    ABTS_INT_EQUAL(tc, 0, rv);
+    values[0] = NULL;
+    rv = apr_dbd_bulk_append_row(bulk, values);
+    if (rv == 0) {
+        /* pgsql only reports the NOT NULL at the end */
+        rv = apr_dbd_bulk_end(bulk, &nrows);
+    }
+    else {
+        ABTS_INT_EQUAL(tc, rv, apr_dbd_bulk_end(bulk, &nrows));
+    }
+    ABTS_ASSERT(tc, "bulk load with a NULL col1 should fail", rv != 0);
+    ABTS_INT_EQUAL(tc, 0, nrows);
+
+    res = NULL;
+    rv = apr_dbd_select(driver, pool, handle, &res, sql, 1);
+    ABTS_INT_EQUAL(tc, 0, rv);
+    ABTS_INT_EQUAL(tc, count, apr_dbd_num_tuples(driver, res));
+
+    rv = apr_dbd_query(driver, handle, &nrows,
+                       "DELETE FROM apr_dbd_test WHERE col3 >= 100");
+    ABTS_INT_EQUAL(tc, 0, rv);
+    ABTS_INT_EQUAL(tc, count, nrows);
+}
+
 static void test_escape(abts_case *tc, apr_dbd_t *handle,
                         const apr_dbd_driver_t *driver)
 {
@@ -160,6 +325,9 @@ static void test_dbd_generic(abts_case *tc, apr_dbd_t* handle,
     select_rows(tc, handle, driver, 0);
     insert_data(tc, handle, driver, 5);
     select_rows(tc, handle, driver, 5);
+    send_queries(tc, handle, driver, 5);
+    cached_statements(tc, handle, driver, 5);
+    bulk_load(tc, handle, driver, 5);
     delete_rows(tc, handle, driver);
     select_rows(tc, handle, driver, 0);
     drop_table(tc, handle, driver);
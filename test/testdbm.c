@@ -19,6 +19,7 @@
 #include "apr_pools.h"
 #include "apr_errno.h"
 #include "apr_dbm.h"
+#include "apr_sdbm.h"
 #include "apr_uuid.h"
 #include "apr_strings.h"
 #include "abts.h"
@@ -200,6 +201,447 @@ static void test_dbm(abts_case *tc, void *data)
     apr_dbm_close(db);
 }
 
+#if APU_HAVE_SDBM
+#define SDBM_SHARED_KEYS 3000
+
+static apr_status_t sdbm_fetch_key(apr_sdbm_t *db, int i,
+                                   apr_sdbm_datum_t *val)
+{
+    char buf[32];
+    apr_sdbm_datum_t key;
+
+    key.dsize = apr_snprintf(buf, sizeof(buf), "key-%d", i);
+    key.dptr = buf;
+    return apr_sdbm_fetch(db, val, key);
+}
+
+/* a writer and a reader of a shared database, the reader seeing the
+ * pages mapped and remapped as the files grow
+ */
+static void test_sdbm_shared(abts_case *tc, void *data)
+{
+    apr_sdbm_t *wdb, *rdb;
+    apr_sdbm_datum_t key, val;
+    apr_status_t rv;
+    char kbuf[32], vbuf[64];
+    int i, j, n;
+
+    apr_file_remove("data/test-shared" APR_SDBM_DIRFEXT, p);
+    apr_file_remove("data/test-shared" APR_SDBM_PAGFEXT, p);
+    rv = apr_sdbm_open(&wdb, "data/test-shared", APR_FOPEN_READ
+                       | APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                       | APR_FOPEN_SHARELOCK, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open shared sdbm for writing", rv);
+    rv = apr_sdbm_open(&rdb, "data/test-shared", APR_FOPEN_READ
+                       | APR_FOPEN_SHARELOCK, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open shared sdbm for reading", rv);
+
+    for (i = 0; i < SDBM_SHARED_KEYS; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        val.dsize = apr_snprintf(vbuf, sizeof(vbuf), "value-%d-%d", i, i * 7);
+        val.dptr = vbuf;
+        rv = apr_sdbm_store(wdb, key, val, APR_SDBM_INSERT);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        if (i % 500 == 499) {
+            for (j = 0; j <= i; j++) {
+                rv = sdbm_fetch_key(rdb, j, &val);
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                apr_snprintf(vbuf, sizeof(vbuf), "value-%d-%d", j, j * 7);
+                ABTS_PTR_NOTNULL(tc, val.dptr);
+                if (val.dptr == NULL)
+                    break;
+                ABTS_INT_EQUAL(tc, (int)strlen(vbuf), val.dsize);
+                ABTS_TRUE(tc, memcmp(vbuf, val.dptr, val.dsize) == 0);
+            }
+        }
+    }
+
+    /* deletions leave the files' sizes, hence the maps, as they are */
+    for (i = 0; i < SDBM_SHARED_KEYS; i += 2) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        rv = apr_sdbm_delete(wdb, key);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < SDBM_SHARED_KEYS; i++) {
+        rv = sdbm_fetch_key(rdb, i, &val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, i % 2, val.dptr != NULL);
+        rv = sdbm_fetch_key(wdb, i, &val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, i % 2, val.dptr != NULL);
+    }
+
+    rv = apr_sdbm_lock(rdb, APR_FLOCK_SHARED);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    n = 0;
+    for (rv = apr_sdbm_firstkey(rdb, &key);
+         rv == APR_SUCCESS && key.dptr != NULL;
+         rv = apr_sdbm_nextkey(rdb, &key)) {
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, SDBM_SHARED_KEYS / 2, n);
+    apr_sdbm_unlock(rdb);
+
+    apr_sdbm_close(rdb);
+    apr_sdbm_close(wdb);
+}
+
+typedef struct {
+    int i, n, fail;
+    char kbuf[32], vbuf[64];
+} bulk_baton_t;
+
+static apr_status_t bulk_next(void *baton, apr_datum_t *key,
+                              apr_datum_t *value)
+{
+    bulk_baton_t *b = baton;
+
+    if (b->i == b->fail)
+        return APR_EGENERAL;
+    if (b->i == b->n)
+        return APR_EOF;
+
+    key->dsize = apr_snprintf(b->kbuf, sizeof(b->kbuf), "key-%d", b->i);
+    key->dptr = b->kbuf;
+    value->dsize = apr_snprintf(b->vbuf, sizeof(b->vbuf), "bulk-%d", b->i);
+    value->dptr = b->vbuf;
+    b->i++;
+
+    return APR_SUCCESS;
+}
+
+static void test_dbm_bulk_load(abts_case *tc, void *data)
+{
+    apr_dbm_t *db;
+    apr_datum_t key, val;
+    apr_status_t rv;
+    bulk_baton_t b;
+    char kbuf[32], vbuf[64];
+    int i, n;
+
+    rv = apr_dbm_open_ex(&db, "sdbm", "data/test-bulk", APR_DBM_RWTRUNC,
+                         APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open sdbm", rv);
+
+    /* some stored beforehand, the even ones to be replaced */
+    for (i = 0; i < 1000; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d",
+                                 i % 2 ? 30000 + i : i);
+        key.dptr = kbuf;
+        val.dsize = apr_snprintf(vbuf, sizeof(vbuf), "old-%d", i);
+        val.dptr = vbuf;
+        rv = apr_dbm_store(db, key, val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* a failing callback leaves the database as it was */
+    b.i = 0;
+    b.n = 20000;
+    b.fail = 100;
+    rv = apr_dbm_bulk_load(db, bulk_next, &b);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", 2);
+    key.dptr = kbuf;
+    rv = apr_dbm_fetch(db, key, &val);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 5, (int)val.dsize);
+
+    b.i = 0;
+    b.fail = -1;
+    rv = apr_dbm_bulk_load(db, bulk_next, &b);
+    APR_ASSERT_SUCCESS(tc, "bulk load", rv);
+
+    /* and stores keep splitting the pages it wrote */
+    for (i = 20000; i < 22000; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        val.dsize = apr_snprintf(vbuf, sizeof(vbuf), "bulk-%d", i);
+        val.dptr = vbuf;
+        rv = apr_dbm_store(db, key, val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    for (i = 0; i < 22000; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        rv = apr_dbm_fetch(db, key, &val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        apr_snprintf(vbuf, sizeof(vbuf), "bulk-%d", i);
+        ABTS_PTR_NOTNULL(tc, val.dptr);
+        if (val.dptr == NULL)
+            break;
+        ABTS_INT_EQUAL(tc, (int)strlen(vbuf), (int)val.dsize);
+        ABTS_TRUE(tc, memcmp(vbuf, val.dptr, val.dsize) == 0);
+    }
+    for (i = 1; i < 1000; i += 2) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", 30000 + i);
+        key.dptr = kbuf;
+        ABTS_INT_EQUAL(tc, 1, apr_dbm_exists(db, key));
+    }
+
+    n = 0;
+    for (rv = apr_dbm_firstkey(db, &key);
+         rv == APR_SUCCESS && key.dptr != NULL;
+         rv = apr_dbm_nextkey(db, &key)) {
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, 22500, n);
+
+    apr_dbm_close(db);
+}
+
+#define CDB_KEYS 50000
+
+/* a constant database, rebuilt while a reader keeps the previous one */
+static void test_dbm_cdb(abts_case *tc, void *data)
+{
+    apr_dbm_t *db, *rdb;
+    apr_datum_t key, val;
+    apr_file_t *f;
+    apr_status_t rv;
+    bulk_baton_t b;
+    char kbuf[32], vbuf[64];
+    int i, n;
+
+    rv = apr_dbm_open_ex(&db, "cdb", "data/test-cdb2", APR_DBM_RWTRUNC,
+                         APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open cdb for writing", rv);
+    b.i = 0;
+    b.n = CDB_KEYS;
+    b.fail = -1;
+    rv = apr_dbm_bulk_load(db, bulk_next, &b);
+    APR_ASSERT_SUCCESS(tc, "bulk load cdb", rv);
+    apr_dbm_close(db);
+
+    rv = apr_dbm_open_ex(&rdb, "cdb", "data/test-cdb2", APR_DBM_READONLY,
+                         APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open cdb for reading", rv);
+    key.dptr = "key-1";
+    key.dsize = 5;
+    rv = apr_dbm_store(rdb, key, key);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    /* rewrite it, replacing the even values and deleting the others */
+    rv = apr_dbm_open_ex(&db, "cdb", "data/test-cdb2", APR_DBM_READWRITE,
+                         APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "reopen cdb for writing", rv);
+    for (i = 0; i < CDB_KEYS; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        if (i % 2) {
+            rv = apr_dbm_delete(db, key);
+        }
+        else {
+            val.dsize = apr_snprintf(vbuf, sizeof(vbuf), "new-%d", i);
+            val.dptr = vbuf;
+            rv = apr_dbm_store(db, key, val);
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    apr_dbm_close(db);
+
+    /* the reader still sees the database it opened */
+    for (i = 0; i < CDB_KEYS; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        rv = apr_dbm_fetch(rdb, key, &val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        n = apr_snprintf(vbuf, sizeof(vbuf), "bulk-%d", i);
+        ABTS_PTR_NOTNULL(tc, val.dptr);
+        if (val.dptr == NULL)
+            break;
+        ABTS_INT_EQUAL(tc, n, (int)val.dsize);
+        ABTS_TRUE(tc, memcmp(vbuf, val.dptr, n) == 0);
+    }
+    key.dptr = "absent";
+    key.dsize = 6;
+    ABTS_INT_EQUAL(tc, 0, apr_dbm_exists(rdb, key));
+    apr_dbm_close(rdb);
+
+    rv = apr_dbm_open_ex(&rdb, "cdb", "data/test-cdb2", APR_DBM_READONLY,
+                         APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open rewritten cdb", rv);
+    for (i = 0; i < CDB_KEYS; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        rv = apr_dbm_fetch(rdb, key, &val);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (i % 2) {
+            ABTS_PTR_EQUAL(tc, NULL, val.dptr);
+            continue;
+        }
+        n = apr_snprintf(vbuf, sizeof(vbuf), "new-%d", i);
+        ABTS_PTR_NOTNULL(tc, val.dptr);
+        if (val.dptr == NULL)
+            break;
+        ABTS_INT_EQUAL(tc, n, (int)val.dsize);
+        ABTS_TRUE(tc, memcmp(vbuf, val.dptr, n) == 0);
+    }
+    n = 0;
+    for (rv = apr_dbm_firstkey(rdb, &key);
+         rv == APR_SUCCESS && key.dptr != NULL;
+         rv = apr_dbm_nextkey(rdb, &key)) {
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, CDB_KEYS / 2, n);
+    apr_dbm_close(rdb);
+
+    /* anything else is refused */
+    rv = apr_file_open(&f, "data/test-cdb2", APR_FOPEN_WRITE
+                       | APR_FOPEN_TRUNCATE, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "truncate cdb", rv);
+    rv = apr_file_write_full(f, "aprcdb\0\1 but not quite a cdb file", 32,
+                             NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_file_close(f);
+    rv = apr_dbm_open_ex(&rdb, "cdb", "data/test-cdb2", APR_DBM_READONLY,
+                         APR_FPROT_OS_DEFAULT, p);
+    ABTS_TRUE(tc, rv != APR_SUCCESS);
+    apr_file_remove("data/test-cdb2", p);
+}
+
+#define SDBM_V2_KEYS 2000
+#define SDBM_V2_BIG  (100 * 1024)
+
+static void sdbm_v2_value(char *buf, int i, int size)
+{
+    int j;
+
+    for (j = 0; j < size; j++)
+        buf[j] = (char)(i + j * 31);
+}
+
+static apr_status_t sdbm_v2_next(void *baton, apr_sdbm_datum_t *key,
+                                 apr_sdbm_datum_t *value)
+{
+    bulk_baton_t *b = baton;
+
+    if (b->i == b->n)
+        return APR_EOF;
+
+    key->dsize = apr_snprintf(b->kbuf, sizeof(b->kbuf), "bulk-%d", b->i);
+    key->dptr = b->kbuf;
+    value->dsize = apr_snprintf(b->vbuf, sizeof(b->vbuf), "bulk-%d", b->i);
+    value->dptr = b->vbuf;
+    b->i++;
+
+    return APR_SUCCESS;
+}
+
+/* the version 2 format: larger pages, and values larger than them */
+static void test_sdbm_v2(abts_case *tc, void *data)
+{
+    apr_sdbm_t *db;
+    apr_sdbm_datum_t key, val;
+    apr_status_t rv;
+    bulk_baton_t b;
+    char kbuf[32], vbuf[64];
+    char *big = apr_palloc(p, SDBM_V2_BIG);
+    int i, n;
+
+    apr_file_remove("data/test-v2" APR_SDBM_DIRFEXT, p);
+    apr_file_remove("data/test-v2" APR_SDBM_PAGFEXT, p);
+    rv = apr_sdbm_open_ex(&db, "data/test-v2", APR_FOPEN_READ
+                          | APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                          APR_FPROT_OS_DEFAULT, 3000, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_sdbm_open_ex(&db, "data/test-v2", APR_FOPEN_READ
+                          | APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                          APR_FPROT_OS_DEFAULT, 4096, p);
+    APR_ASSERT_SUCCESS(tc, "open version 2 sdbm", rv);
+    ABTS_INT_EQUAL(tc, 4096, (int)apr_sdbm_pagesize(db));
+
+    for (i = 0; i < SDBM_V2_KEYS; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        if (i % 100 == 0) {
+            val.dsize = SDBM_V2_BIG - i;
+            sdbm_v2_value(big, i, val.dsize);
+            val.dptr = big;
+        }
+        else {
+            val.dsize = apr_snprintf(vbuf, sizeof(vbuf), "value-%d", i);
+            val.dptr = vbuf;
+        }
+        rv = apr_sdbm_store(db, key, val, APR_SDBM_INSERT);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* replace and delete some of the large ones, reusing their pages */
+    for (i = 0; i < SDBM_V2_KEYS; i += 200) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        val.dsize = SDBM_V2_BIG / 2;
+        sdbm_v2_value(big, i + 1, val.dsize);
+        val.dptr = big;
+        rv = apr_sdbm_store(db, key, val, APR_SDBM_REPLACE);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i + 100);
+        rv = apr_sdbm_delete(db, key);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    apr_sdbm_close(db);
+
+    /* reopened in its own format, whatever the page size asked for */
+    rv = apr_sdbm_open_ex(&db, "data/test-v2", APR_FOPEN_READ
+                          | APR_FOPEN_WRITE, APR_FPROT_OS_DEFAULT, 1024, p);
+    APR_ASSERT_SUCCESS(tc, "reopen version 2 sdbm", rv);
+    ABTS_INT_EQUAL(tc, 4096, (int)apr_sdbm_pagesize(db));
+
+    b.i = 0;
+    b.n = 5000;
+    b.fail = -1;
+    rv = apr_sdbm_bulk_load(db, sdbm_v2_next, &b);
+    APR_ASSERT_SUCCESS(tc, "bulk load version 2 sdbm", rv);
+
+    for (i = 0; i < SDBM_V2_KEYS; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "key-%d", i);
+        key.dptr = kbuf;
+        rv = apr_sdbm_fetch(db, &val, key);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (i % 200 == 100) {
+            ABTS_PTR_EQUAL(tc, NULL, val.dptr);
+            continue;
+        }
+        ABTS_PTR_NOTNULL(tc, val.dptr);
+        if (val.dptr == NULL)
+            break;
+        if (i % 100 == 0) {
+            n = i % 200 ? SDBM_V2_BIG - i : SDBM_V2_BIG / 2;
+            ABTS_INT_EQUAL(tc, n, val.dsize);
+            sdbm_v2_value(big, i % 200 ? i : i + 1, n);
+            ABTS_TRUE(tc, memcmp(big, val.dptr, n) == 0);
+        }
+        else {
+            n = apr_snprintf(vbuf, sizeof(vbuf), "value-%d", i);
+            ABTS_INT_EQUAL(tc, n, val.dsize);
+            ABTS_TRUE(tc, memcmp(vbuf, val.dptr, n) == 0);
+        }
+    }
+    for (i = 0; i < b.n; i++) {
+        key.dsize = apr_snprintf(kbuf, sizeof(kbuf), "bulk-%d", i);
+        key.dptr = kbuf;
+        rv = apr_sdbm_fetch(db, &val, key);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, key.dsize, val.dsize);
+    }
+
+    n = 0;
+    for (rv = apr_sdbm_firstkey(db, &key);
+         rv == APR_SUCCESS && key.dptr != NULL;
+         rv = apr_sdbm_nextkey(db, &key)) {
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, SDBM_V2_KEYS - SDBM_V2_KEYS / 200 + b.n, n);
+
+    apr_sdbm_close(db);
+}
+#endif
+
 abts_suite *testdbm(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -212,6 +654,11 @@ abts_suite *testdbm(abts_suite *suite)
 #endif
 #if APU_HAVE_SDBM
     abts_run_test(suite, test_dbm, "sdbm");
+    abts_run_test(suite, test_sdbm_shared, NULL);
+    abts_run_test(suite, test_dbm_bulk_load, NULL);
+    abts_run_test(suite, test_sdbm_v2, NULL);
+    abts_run_test(suite, test_dbm, "cdb");
+    abts_run_test(suite, test_dbm_cdb, NULL);
 #endif
 #if APU_HAVE_DB
     abts_run_test(suite, test_dbm, "db");
@@ -22,6 +22,8 @@
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_lib.h"
+#include "apr_atomic.h"
+#include "apr_strings.h"
 #include "apr_thread_proc.h"
 #include "testutil.h"
 
@@ -443,6 +445,164 @@ static void test_readmore_info(abts_case* tc, void* data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static void test_read_batch(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_dir_t *dir;
+    apr_file_t *thefile;
+    apr_finfo_t finfos[7];
+    apr_size_t i, n, files, dirs;
+    int pass;
+    char *fname;
+    char buf[40];
+    apr_int32_t wanted = APR_FINFO_TYPE | APR_FINFO_SIZE | APR_FINFO_INODE;
+
+    rv = apr_dir_make("data/batch", APR_FPROT_OS_DEFAULT, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* file i is i bytes long */
+    memset(buf, 'x', sizeof buf);
+    for (i = 0; i < 40; i++) {
+        fname = apr_psprintf(p, "data/batch/%" APR_SIZE_T_FMT, i);
+        rv = apr_file_open(&thefile, fname,
+                           APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                           APR_FPROT_OS_DEFAULT, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_file_write_full(thefile, buf, i, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        apr_file_close(thefile);
+    }
+
+    rv = apr_dir_open(&dir, "data/batch", p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* twice, around a rewind */
+    for (pass = 0; pass < 2; pass++) {
+        files = dirs = 0;
+        for (;;) {
+            rv = apr_dir_read_batch(finfos, 7, &n, wanted, dir);
+            if (APR_STATUS_IS_ENOENT(rv)) {
+                ABTS_SIZE_EQUAL(tc, 0, n);
+                break;
+            }
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_ASSERT(tc, "batch read nothing", n > 0 && n <= 7);
+            for (i = 0; i < n; i++) {
+                ABTS_TRUE(tc, (finfos[i].valid & (wanted | APR_FINFO_NAME))
+                              == (wanted | APR_FINFO_NAME));
+                if (finfos[i].filetype == APR_DIR) {
+                    dirs++;
+                }
+                else {
+                    ABTS_INT_EQUAL(tc, APR_REG, finfos[i].filetype);
+                    ABTS_INT_EQUAL(tc, atoi(finfos[i].name),
+                                   (int)finfos[i].size);
+                    files++;
+                }
+            }
+        }
+        ABTS_SIZE_EQUAL(tc, 40, files);
+        ABTS_SIZE_EQUAL(tc, 2, dirs);
+
+        rv = apr_dir_rewind(dir);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    apr_dir_close(dir);
+
+    for (i = 0; i < 40; i++) {
+        fname = apr_psprintf(p, "data/batch/%" APR_SIZE_T_FMT, i);
+        rv = apr_file_remove(fname, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_dir_remove("data/batch", p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static apr_status_t count_entry(void *baton, const char *path,
+                                const apr_finfo_t *finfo, int depth,
+                                int *prune, apr_pool_t *pool)
+{
+    apr_uint32_t *counts = baton;
+
+    apr_atomic_inc32(finfo->filetype == APR_DIR ? &counts[0] : &counts[1]);
+    if (depth > 3 || strncmp(path, "data/walk/", 10) != 0) {
+        apr_atomic_inc32(&counts[2]);
+    }
+    /* prune all the "p" directories */
+    if (finfo->filetype == APR_DIR && finfo->name[0] == 'p') {
+        *prune = 1;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t fail_entry(void *baton, const char *path,
+                               const apr_finfo_t *finfo, int depth,
+                               int *prune, apr_pool_t *pool)
+{
+    return APR_EGENERAL;
+}
+
+static void test_walk(abts_case *tc, void *data)
+{
+    static const char *const dirs[] = {
+        "data/walk", "data/walk/a", "data/walk/a/b", "data/walk/a/b/c",
+        "data/walk/d", "data/walk/p", "data/walk/p/q", NULL
+    };
+    apr_status_t rv;
+    apr_file_t *thefile;
+    apr_uint32_t counts[3];
+    int i, j, nthreads;
+
+    for (i = 0; dirs[i]; i++) {
+        rv = apr_dir_make(dirs[i], APR_FPROT_OS_DEFAULT, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        for (j = 0; j < 10; j++) {
+            rv = apr_file_open(&thefile, apr_psprintf(p, "%s/f%d", dirs[i], j),
+                               APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                               APR_FPROT_OS_DEFAULT, p);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            apr_file_close(thefile);
+        }
+    }
+
+    for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+        /* the whole tree but p's contents */
+        memset(counts, 0, sizeof counts);
+        rv = apr_dir_walk("data/walk/", 0, -1, 0, nthreads,
+                          count_entry, counts, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 5, counts[0]);
+        ABTS_INT_EQUAL(tc, 50, counts[1]);
+        ABTS_INT_EQUAL(tc, 0, counts[2]);
+
+        /* down to a/b */
+        memset(counts, 0, sizeof counts);
+        rv = apr_dir_walk("data/walk", APR_FINFO_SIZE, 1, 0, nthreads,
+                          count_entry, counts, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 4, counts[0]);
+        ABTS_INT_EQUAL(tc, 30, counts[1]);
+
+        rv = apr_dir_walk("data/walk", 0, -1, 0, nthreads,
+                          fail_entry, NULL, p);
+        ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    }
+
+    rv = apr_dir_walk("data/walk/nothere", 0, -1,
+                      APR_DIR_WALK_SKIP_ERRORS, 1, count_entry, counts, p);
+    ABTS_TRUE(tc, APR_STATUS_IS_ENOENT(rv));
+
+    for (i--; i >= 0; i--) {
+        for (j = 0; j < 10; j++) {
+            rv = apr_file_remove(apr_psprintf(p, "%s/f%d", dirs[i], j), p);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+        rv = apr_dir_remove(dirs[i], p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+}
+
 abts_suite *testdir(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -464,6 +624,8 @@ abts_suite *testdir(abts_suite *suite)
     abts_run_test(suite, test_closedir, NULL);
     abts_run_test(suite, test_uncleared_errno, NULL);
     abts_run_test(suite, test_readmore_info, NULL);
+    abts_run_test(suite, test_read_batch, NULL);
+    abts_run_test(suite, test_walk, NULL);
 
     return suite;
 }
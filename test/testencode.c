@@ -1101,6 +1101,308 @@ static void test_decode_errors(abts_case * tc, void *data)
     ABTS_SIZE_EQUAL(tc, 2, len);
 }
 
+/* Straightforward encodings, to check the block ones against */
+static char *ref_base64(const unsigned char *src, apr_size_t len, int flags)
+{
+    const char *alpha = (flags & APR_ENCODE_BASE64URL)
+        ? "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+        : "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *dest = apr_palloc(p, len / 3 * 4 + 5), *d = dest;
+    apr_uint32_t acc = 0;
+    apr_size_t i;
+    int bits = 0;
+
+    for (i = 0; i < len; i++) {
+        acc = (acc << 8) | src[i];
+        for (bits += 8; bits >= 6; bits -= 6) {
+            *d++ = alpha[(acc >> (bits - 6)) & 0x3f];
+        }
+    }
+    if (bits) {
+        *d++ = alpha[(acc << (6 - bits)) & 0x3f];
+    }
+    while (!(flags & APR_ENCODE_NOPADDING) && (d - dest) % 4) {
+        *d++ = '=';
+    }
+    *d = '\0';
+
+    return dest;
+}
+
+static char *ref_base16(const unsigned char *src, apr_size_t len, int flags)
+{
+    const char *digits = (flags & APR_ENCODE_LOWER) ? "0123456789abcdef"
+                                                    : "0123456789ABCDEF";
+    char *dest = apr_palloc(p, len * 3 + 1), *d = dest;
+    apr_size_t i;
+
+    for (i = 0; i < len; i++) {
+        if ((flags & APR_ENCODE_COLON) && i) {
+            *d++ = ':';
+        }
+        *d++ = digits[src[i] >> 4];
+        *d++ = digits[src[i] & 0xf];
+    }
+    *d = '\0';
+
+    return dest;
+}
+
+static void test_encode_blocks(abts_case * tc, void *data)
+{
+    static const int b64flags[] = {
+        APR_ENCODE_NONE, APR_ENCODE_BASE64URL, APR_ENCODE_NOPADDING,
+        APR_ENCODE_BASE64URL | APR_ENCODE_NOPADDING
+    };
+    static const int b16flags[] = {
+        APR_ENCODE_NONE, APR_ENCODE_LOWER, APR_ENCODE_COLON
+    };
+    unsigned char src[1031];
+    apr_size_t len, dlen, i;
+    unsigned int seed = 1;
+    int f;
+
+    for (i = 0; i < sizeof(src); i++) {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (unsigned char)(seed >> 16);
+    }
+
+    /* every length around the block sizes, and a few long ones */
+    for (len = 0; len < sizeof(src); len += (len < 160 ? 1 : 97)) {
+        for (f = 0; f < 4; f++) {
+            const char *ref = ref_base64(src, len, b64flags[f]);
+            const char *enc = apr_pencode_base64_binary(p, src, len,
+                                                        b64flags[f], NULL);
+            const unsigned char *dec;
+
+            ABTS_STR_EQUAL(tc, ref, enc);
+            dec = apr_pdecode_base64_binary(p, enc, APR_ENCODE_STRING,
+                                            APR_ENCODE_NONE, &dlen);
+            ABTS_SIZE_EQUAL(tc, len, dlen);
+            ABTS_ASSERT(tc, "base64 round trip", !memcmp(src, dec, len));
+        }
+
+        for (f = 0; f < 3; f++) {
+            const char *ref = ref_base16(src, len, b16flags[f]);
+            const char *enc = apr_pencode_base16_binary(p, src, len,
+                                                        b16flags[f], NULL);
+            const unsigned char *dec;
+
+            ABTS_STR_EQUAL(tc, ref, enc);
+            dec = apr_pdecode_base16_binary(p, enc, APR_ENCODE_STRING,
+                                            b16flags[f], &dlen);
+            ABTS_SIZE_EQUAL(tc, len, dlen);
+            ABTS_ASSERT(tc, "base16 round trip", !memcmp(src, dec, len));
+        }
+    }
+
+    /* a bad character anywhere in a long text is found */
+    {
+        char *enc = apr_pstrdup(p, ref_base64(src, 300, APR_ENCODE_NONE));
+        char *hex = apr_pstrdup(p, ref_base16(src, 300, APR_ENCODE_NONE));
+        unsigned char dest[400];
+        apr_status_t rv;
+
+        for (i = 0; i < 400; i += 7) {
+            char c = enc[i];
+
+            enc[i] = '*';
+            rv = apr_decode_base64_binary(dest, enc, APR_ENCODE_STRING,
+                                          APR_ENCODE_NONE, &dlen);
+            ABTS_INT_EQUAL(tc, i % 4 == 1 ? APR_EINCOMPLETE : APR_BADCH, rv);
+            rv = apr_decode_base64_binary(dest, enc, APR_ENCODE_STRING,
+                                          APR_ENCODE_RELAXED, &dlen);
+            ABTS_SIZE_EQUAL(tc, i / 4 * 3 + (i % 4 ? i % 4 - 1 : 0), dlen);
+            enc[i] = c;
+
+            c = hex[i];
+            hex[i] = 'g';
+            rv = apr_decode_base16_binary(dest, hex, APR_ENCODE_STRING,
+                                          APR_ENCODE_NONE, &dlen);
+            ABTS_INT_EQUAL(tc, i % 2 ? APR_EINCOMPLETE : APR_BADCH, rv);
+            ABTS_SIZE_EQUAL(tc, i / 2, dlen);
+            hex[i] = c;
+        }
+    }
+}
+
+/* The reference encoding broken into CRLF ended lines of wrap characters */
+static char *ref_wrapped(const unsigned char *src, apr_size_t len, int flags,
+                         apr_size_t wrap)
+{
+    const char *ref = ref_base64(src, len, flags);
+    apr_size_t n = strlen(ref), i;
+    char *out = apr_palloc(p, n + n / 2 + 3), *o = out;
+
+    for (i = 0; i < n; i++) {
+        *o++ = ref[i];
+        if (wrap && ((i + 1) % wrap == 0 || i + 1 == n)) {
+            *o++ = '\r';
+            *o++ = '\n';
+        }
+    }
+    *o = '\0';
+
+    return out;
+}
+
+static void test_encode_stream(abts_case * tc, void *data)
+{
+    static const apr_size_t chunks[] = { 1, 2, 5, 7, 100, 3000 };
+    static const apr_size_t wraps[] = { 0, 64, 76 };
+    static const int flags[] = { APR_ENCODE_NONE, APR_ENCODE_BASE64URL };
+    unsigned char src[3000];
+    char *enc, *dec;
+    apr_encode_stream_t *ectx, *dctx;
+    apr_size_t i, n, len, dlen, max, c, w;
+    unsigned int seed = 7;
+    apr_status_t rv;
+    int f;
+
+    for (i = 0; i < sizeof(src); i++) {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (unsigned char)(seed >> 16);
+    }
+
+    enc = apr_palloc(p, sizeof(src) * 2 + 8);
+    dec = apr_palloc(p, sizeof(src) + 8);
+
+    for (f = 0; f < 2; f++) {
+        for (w = 0; w < 3; w++) {
+            const char *ref = ref_wrapped(src, sizeof(src) - f, flags[f],
+                                          wraps[w]);
+
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                    apr_encode_base64_stream_create(&ectx, flags[f],
+                                                    wraps[w], p));
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                    apr_decode_base64_stream_create(&dctx, APR_ENCODE_NONE,
+                                                    p));
+
+            /* reused across streams, chunked any way */
+            for (c = 0; c < 6; c++) {
+                for (i = len = 0; i < sizeof(src) - f; i += n) {
+                    n = chunks[c];
+                    if (n > sizeof(src) - f - i) {
+                        n = sizeof(src) - f - i;
+                    }
+                    apr_encode_stream_update(ectx, NULL, NULL, n, &max);
+                    rv = apr_encode_stream_update(ectx, enc + len,
+                                                  (char *)src + i, n, &dlen);
+                    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                    ABTS_ASSERT(tc, "encoded length within the maximum",
+                                dlen <= max);
+                    len += dlen;
+                }
+                rv = apr_encode_stream_finish(ectx, enc + len, &dlen);
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                len += dlen;
+                enc[len] = '\0';
+                ABTS_STR_EQUAL(tc, ref, enc);
+
+                for (i = dlen = 0; i < len; i += n) {
+                    n = chunks[5 - c];
+                    if (n > len - i) {
+                        n = len - i;
+                    }
+                    rv = apr_encode_stream_update(dctx, dec + dlen, enc + i,
+                                                  n, &max);
+                    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                    dlen += max;
+                }
+                rv = apr_encode_stream_finish(dctx, dec + dlen, &max);
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+                dlen += max;
+                ABTS_SIZE_EQUAL(tc, sizeof(src) - f, dlen);
+                ABTS_ASSERT(tc, "stream round trip", !memcmp(src, dec, dlen));
+            }
+        }
+    }
+
+    /* decoding errors */
+    apr_decode_base64_stream_create(&dctx, APR_ENCODE_NONE, p);
+    rv = apr_encode_stream_update(dctx, dec, "Zm9v Y*mFy", 10, &dlen);
+    ABTS_INT_EQUAL(tc, APR_BADCH, rv);
+    ABTS_SIZE_EQUAL(tc, 3, dlen);
+    apr_encode_stream_finish(dctx, dec, &dlen);
+    rv = apr_encode_stream_update(dctx, dec, "Zg==\r\nZg", 8, &dlen);
+    ABTS_INT_EQUAL(tc, APR_BADCH, rv);
+    ABTS_SIZE_EQUAL(tc, 1, dlen);
+    apr_encode_stream_finish(dctx, dec, &dlen);
+    rv = apr_encode_stream_update(dctx, dec, "Zm9vY", 5, &dlen);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_encode_stream_finish(dctx, dec, &dlen);
+    ABTS_INT_EQUAL(tc, APR_EINCOMPLETE, rv);
+
+    apr_decode_base64_stream_create(&dctx, APR_ENCODE_RELAXED, p);
+    rv = apr_encode_stream_update(dctx, dec, "Zm9vYg*mFy", 10, &dlen);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 3, dlen);
+    rv = apr_encode_stream_update(dctx, dec + 3, "Zm9v", 4, &dlen);
+    ABTS_SIZE_EQUAL(tc, 0, dlen);
+    rv = apr_encode_stream_finish(dctx, dec + 3, &dlen);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 1, dlen);
+    ABTS_ASSERT(tc, "relaxed decoding", !memcmp(dec, "foob", 4));
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+            apr_encode_base64_stream_create(&ectx, APR_ENCODE_NONE, 75, p));
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+            apr_decode_base64_stream_create(&dctx, APR_ENCODE_COLON, p));
+}
+
+static void test_encode_stream_brigade(abts_case * tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *in = apr_brigade_create(p, ba);
+    apr_bucket_brigade *mid = apr_brigade_create(p, ba);
+    apr_bucket_brigade *out = apr_brigade_create(p, ba);
+    apr_encode_stream_t *ectx, *dctx;
+    apr_size_t size = 100000, i, len;
+    unsigned char *src = apr_palloc(p, size);
+    char *flat;
+    apr_bucket *e;
+
+    for (i = 0; i < size; i++) {
+        src[i] = (unsigned char)(i * 7 + i / 251);
+    }
+    for (i = 0; i < size; i += 7001) {
+        APR_BRIGADE_INSERT_TAIL(in,
+                apr_bucket_transient_create((char *)src + i,
+                        size - i < 7001 ? size - i : 7001, ba));
+    }
+    APR_BRIGADE_INSERT_TAIL(in, apr_bucket_eos_create(ba));
+
+    apr_encode_base64_stream_create(&ectx, APR_ENCODE_NONE, 76, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+            apr_encode_stream_process(ectx, mid, in, APR_BLOCK_READ));
+    ABTS_ASSERT(tc, "input consumed", APR_BRIGADE_EMPTY(in));
+    ABTS_ASSERT(tc, "EOS passed", APR_BUCKET_IS_EOS(APR_BRIGADE_LAST(mid)));
+    for (e = APR_BRIGADE_FIRST(mid); e != APR_BRIGADE_LAST(mid);
+         e = APR_BUCKET_NEXT(e)) {
+        ABTS_ASSERT(tc, "bounded buckets", e->length <= APR_BUCKET_BUFF_SIZE);
+    }
+
+    apr_brigade_pflatten(mid, &flat, &len, p);
+    ABTS_SIZE_EQUAL(tc, strlen(ref_wrapped(src, size, APR_ENCODE_NONE, 76)),
+                    len);
+    ABTS_ASSERT(tc, "brigade encoding",
+                !memcmp(ref_wrapped(src, size, APR_ENCODE_NONE, 76), flat,
+                        len));
+
+    apr_decode_base64_stream_create(&dctx, APR_ENCODE_NONE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+            apr_encode_stream_process(dctx, out, mid, APR_BLOCK_READ));
+    apr_brigade_pflatten(out, &flat, &len, p);
+    ABTS_SIZE_EQUAL(tc, size, len);
+    ABTS_ASSERT(tc, "brigade round trip", !memcmp(src, flat, size));
+
+    apr_brigade_destroy(out);
+    apr_brigade_destroy(mid);
+    apr_brigade_destroy(in);
+    apr_bucket_alloc_destroy(ba);
+}
+
 abts_suite *testencode(abts_suite * suite)
 {
     suite = ADD_SUITE(suite);
@@ -1119,6 +1421,9 @@ abts_suite *testencode(abts_suite * suite)
     abts_run_test(suite, test_decode_base16_binary, NULL);
     abts_run_test(suite, test_encode_errors, NULL);
     abts_run_test(suite, test_decode_errors, NULL);
+    abts_run_test(suite, test_encode_blocks, NULL);
+    abts_run_test(suite, test_encode_stream, NULL);
+    abts_run_test(suite, test_encode_stream_brigade, NULL);
 
     return suite;
 }
@@ -0,0 +1,256 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_epoch.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+#include "abts.h"
+#include "testutil.h"
+
+static apr_uint32_t reclaimed;
+
+static apr_status_t count_reclaim(void *data)
+{
+    apr_atomic_inc32(&reclaimed);
+    return APR_SUCCESS;
+}
+
+static apr_status_t count_cleanup(void *data)
+{
+    apr_atomic_inc32(&reclaimed);
+    return APR_SUCCESS;
+}
+
+static void test_retire(abts_case *tc, void *data)
+{
+    apr_epoch_t *epoch;
+    apr_epoch_token_t token, nested;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    rv = apr_epoch_create(&epoch, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    token = apr_epoch_enter(epoch);
+    nested = apr_epoch_enter(epoch);
+    apr_epoch_exit(epoch, nested);
+    apr_epoch_exit(epoch, token);
+
+    reclaimed = 0;
+    rv = apr_epoch_retire(epoch, NULL, count_reclaim);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_epoch_retire(epoch, NULL, count_reclaim);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&reclaimed));
+
+    rv = apr_epoch_synchronize(epoch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&reclaimed));
+
+    /* Nothing left */
+    rv = apr_epoch_synchronize(epoch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&reclaimed));
+
+    apr_pool_create(&pool, p);
+    apr_pool_cleanup_register(pool, NULL, count_cleanup,
+                              apr_pool_cleanup_null);
+    rv = apr_epoch_retire_pool(epoch, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_epoch_synchronize(epoch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, apr_atomic_read32(&reclaimed));
+}
+
+static void test_cleanup(abts_case *tc, void *data)
+{
+    apr_epoch_t *epoch;
+    apr_pool_t *pool, *child;
+    apr_status_t rv;
+
+    apr_pool_create(&pool, p);
+    rv = apr_epoch_create(&epoch, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* A child of the domain's pool is destroyed once only */
+    apr_pool_create(&child, pool);
+    apr_pool_cleanup_register(child, NULL, count_cleanup,
+                              apr_pool_cleanup_null);
+
+    reclaimed = 0;
+    rv = apr_epoch_retire(epoch, NULL, count_reclaim);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_epoch_retire_pool(epoch, child);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_pool_destroy(pool);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&reclaimed));
+}
+
+#if APR_HAS_THREADS
+
+static void * APR_THREAD_FUNC sync_thread(apr_thread_t *thd, void *data)
+{
+    apr_epoch_t *epoch = data;
+
+    apr_thread_exit(thd, apr_epoch_synchronize(epoch));
+    return NULL;
+}
+
+static void test_wait_readers(abts_case *tc, void *data)
+{
+    apr_epoch_t *epoch;
+    apr_epoch_token_t token;
+    apr_thread_t *thd;
+    apr_status_t rv, thread_rv;
+
+    rv = apr_epoch_create(&epoch, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    reclaimed = 0;
+    token = apr_epoch_enter(epoch);
+    rv = apr_epoch_retire(epoch, NULL, count_reclaim);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_create(&thd, NULL, sync_thread, epoch, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_sleep(apr_time_from_msec(50));
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&reclaimed));
+
+    apr_epoch_exit(epoch, token);
+    rv = apr_thread_join(&thread_rv, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, thread_rv);
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&reclaimed));
+}
+
+#define SNAPSHOT_MAGIC 0x5eed
+#define NUM_READERS 4
+#define NUM_SWAPS 500
+
+typedef struct snapshot_t {
+    apr_pool_t *pool;
+    int magic;
+} snapshot_t;
+
+typedef struct swap_data_t {
+    apr_epoch_t *epoch;
+    void *volatile current;
+    apr_uint32_t done;
+    apr_uint32_t bad;
+} swap_data_t;
+
+static snapshot_t *snapshot_make(apr_pool_t *parent)
+{
+    apr_pool_t *pool;
+    snapshot_t *s;
+
+    apr_pool_create(&pool, parent);
+    s = apr_palloc(pool, sizeof(*s));
+    s->pool = pool;
+    s->magic = SNAPSHOT_MAGIC;
+    return s;
+}
+
+static apr_status_t snapshot_reclaim(void *data)
+{
+    snapshot_t *s = data;
+
+    s->magic = 0;
+    apr_pool_destroy(s->pool);
+    return APR_SUCCESS;
+}
+
+static void * APR_THREAD_FUNC reader_thread(apr_thread_t *thd, void *data)
+{
+    swap_data_t *sd = data;
+
+    while (!apr_atomic_read32(&sd->done)) {
+        apr_epoch_token_t token = apr_epoch_enter(sd->epoch);
+        snapshot_t *s = apr_atomic_casptr(&sd->current, NULL, NULL);
+
+        if (s->magic != SNAPSHOT_MAGIC) {
+            apr_atomic_inc32(&sd->bad);
+        }
+        apr_epoch_exit(sd->epoch, token);
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void test_swap(abts_case *tc, void *data)
+{
+    apr_thread_t *thds[NUM_READERS];
+    apr_pool_t *pool;
+    swap_data_t sd;
+    apr_status_t rv, thread_rv;
+    int i;
+
+    /* Not allocated by the readers, only by us */
+    apr_pool_create(&pool, p);
+
+    rv = apr_epoch_create(&sd.epoch, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    sd.current = snapshot_make(pool);
+    sd.done = 0;
+    sd.bad = 0;
+
+    for (i = 0; i < NUM_READERS; i++) {
+        rv = apr_thread_create(&thds[i], NULL, reader_thread, &sd, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    for (i = 0; i < NUM_SWAPS; i++) {
+        snapshot_t *old = apr_atomic_xchgptr(&sd.current,
+                                             snapshot_make(pool));
+
+        rv = apr_epoch_retire(sd.epoch, old, snapshot_reclaim);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (i % 4 == 3) {
+            rv = apr_epoch_synchronize(sd.epoch);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+    }
+
+    apr_atomic_set32(&sd.done, 1);
+    for (i = 0; i < NUM_READERS; i++) {
+        rv = apr_thread_join(&thread_rv, thds[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&sd.bad));
+
+    rv = apr_epoch_synchronize(sd.epoch);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testepoch(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_retire, NULL);
+    abts_run_test(suite, test_cleanup, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_wait_readers, NULL);
+    abts_run_test(suite, test_swap, NULL);
+#endif
+
+    return suite;
+}
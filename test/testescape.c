@@ -301,11 +301,81 @@ static void test_escape(abts_case *tc, void *data)
     apr_pool_destroy(pool);
 }
 
+static apr_status_t escape_by(int which, char *dest, const char *src,
+                              apr_ssize_t slen, apr_size_t *len)
+{
+    switch (which) {
+    case 0:
+        return apr_escape_shell(dest, src, slen, len);
+    case 1:
+        return apr_escape_path_segment(dest, src, slen, len);
+    case 2:
+        return apr_escape_path(dest, src, slen, 1, len);
+    case 3:
+        return apr_escape_urlencoded(dest, src, slen, len);
+    case 4:
+        return apr_escape_entity(dest, src, slen, 0, len);
+    case 5:
+        return apr_escape_entity(dest, src, slen, 1, len);
+    default:
+        return apr_escape_echo(dest, src, slen, 1, len);
+    }
+}
+
+/* Long runs to copy as they are, broken by bytes to escape, at any
+ * alignment: the same as escaping the bytes one by one.
+ */
+static void test_escape_runs(abts_case *tc, void *data)
+{
+    static const apr_size_t lens[] = { 0, 1, 15, 16, 17, 31, 32, 33, 100, 200 };
+    char text[300], *str, *ref, *dest;
+    apr_size_t i, j, off, len, n, size;
+    int which;
+
+    for (i = 0; i < sizeof(text); i++) {
+        text[i] = (i % 37 == 5 || i % 53 == 7) ? (char)((i * 7) % 255 + 1)
+                                               : (char)('a' + i % 26);
+    }
+    str = apr_palloc(p, sizeof(text) + 64);
+    ref = apr_palloc(p, sizeof(text) * 6 + 1);
+    dest = apr_palloc(p, sizeof(text) * 6 + 1);
+
+    for (which = 0; which < 7; which++) {
+        for (off = 0; off < 64; off++) {
+            for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+                len = lens[i];
+
+                for (j = n = 0; j < len; j++) {
+                    escape_by(which, ref + n, text + off + j, 1, &size);
+                    n += size - 1;
+                }
+                ref[n] = '\0';
+
+                /* not NUL terminated */
+                escape_by(which, dest, text + off, len, &size);
+                ABTS_STR_EQUAL(tc, ref, dest);
+                ABTS_SIZE_EQUAL(tc, n + 1, size);
+                escape_by(which, NULL, text + off, len, &size);
+                ABTS_SIZE_EQUAL(tc, n + 1, size);
+
+                /* NUL terminated, at this alignment */
+                memcpy(str + off, text + off, len);
+                str[off + len] = '\0';
+                escape_by(which, dest, str + off, APR_ESCAPE_STRING, &size);
+                ABTS_STR_EQUAL(tc, ref, dest);
+                escape_by(which, NULL, str + off, APR_ESCAPE_STRING, &size);
+                ABTS_SIZE_EQUAL(tc, n + 1, size);
+            }
+        }
+    }
+}
+
 abts_suite *testescape(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_escape, NULL);
+    abts_run_test(suite, test_escape_runs, NULL);
 
     return suite;
 }
@@ -0,0 +1,310 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_fiber.h"
+#include "apr_network_io.h"
+#include "apr_time.h"
+#include "abts.h"
+#include "testutil.h"
+
+#define NUM_ROUNDS 100
+
+static apr_fiber_sched_t *make_sched(abts_case *tc)
+{
+    apr_fiber_sched_t *sched = NULL;
+    apr_status_t rv;
+
+    rv = apr_fiber_sched_create(&sched, 4, 0, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "fibers not supported");
+        return NULL;
+    }
+    APR_ASSERT_SUCCESS(tc, "create scheduler", rv);
+    return sched;
+}
+
+typedef struct {
+    int id;
+    int *order;
+    int *n;
+    apr_interval_time_t delay;
+    apr_time_t start;
+    int early;
+} step_t;
+
+static void yield_fiber(apr_fiber_t *fiber, void *baton)
+{
+    step_t *s = baton;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        s->order[(*s->n)++] = s->id;
+        apr_fiber_yield();
+    }
+}
+
+static void test_yield(abts_case *tc, void *data)
+{
+    static const int expected[] = { 0, 1, 2, 0, 1, 2, 0, 1, 2 };
+    apr_fiber_sched_t *sched = make_sched(tc);
+    step_t steps[3];
+    int order[9], n = 0, i;
+
+    if (!sched) {
+        return;
+    }
+    for (i = 0; i < 3; i++) {
+        steps[i].id = i;
+        steps[i].order = order;
+        steps[i].n = &n;
+        APR_ASSERT_SUCCESS(tc, "create fiber",
+                           apr_fiber_create(NULL, sched, yield_fiber,
+                                            &steps[i]));
+    }
+    APR_ASSERT_SUCCESS(tc, "run", apr_fiber_sched_run(sched));
+    ABTS_INT_EQUAL(tc, 9, n);
+    for (i = 0; i < 9; i++) {
+        ABTS_INT_EQUAL(tc, expected[i], order[i]);
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_fiber_current());
+}
+
+static void sleep_fiber(apr_fiber_t *fiber, void *baton)
+{
+    step_t *s = baton;
+
+    apr_fiber_sleep(s->delay);
+    if (apr_time_now() - s->start < s->delay) {
+        s->early = 1;
+    }
+    s->order[(*s->n)++] = s->id;
+}
+
+static void test_sleep(abts_case *tc, void *data)
+{
+    static const int delays[] = { 60, 20, 40 };
+    apr_fiber_sched_t *sched = make_sched(tc);
+    apr_time_t start = apr_time_now();
+    step_t steps[3];
+    int order[3], n = 0, i;
+
+    if (!sched) {
+        return;
+    }
+    for (i = 0; i < 3; i++) {
+        steps[i].id = delays[i];
+        steps[i].order = order;
+        steps[i].n = &n;
+        steps[i].delay = apr_time_from_msec(delays[i]);
+        steps[i].start = start;
+        steps[i].early = 0;
+        apr_fiber_create(NULL, sched, sleep_fiber, &steps[i]);
+    }
+    APR_ASSERT_SUCCESS(tc, "run", apr_fiber_sched_run(sched));
+    ABTS_INT_EQUAL(tc, 3, n);
+    ABTS_INT_EQUAL(tc, 20, order[0]);
+    ABTS_INT_EQUAL(tc, 40, order[1]);
+    ABTS_INT_EQUAL(tc, 60, order[2]);
+    for (i = 0; i < 3; i++) {
+        ABTS_INT_EQUAL(tc, 0, steps[i].early);
+    }
+    /* slept concurrently */
+    ABTS_ASSERT(tc, "fibers slept in turn",
+                apr_time_now() - start < apr_time_from_msec(150));
+}
+
+typedef struct {
+    apr_fiber_sched_t *sched;
+    int depth;
+    int *count;
+    apr_status_t nested_run;
+} spawn_t;
+
+static void spawn_fiber(apr_fiber_t *fiber, void *baton)
+{
+    spawn_t *s = baton;
+
+    (*s->count)++;
+    if (s->depth == 0) {
+        s->nested_run = apr_fiber_sched_run(s->sched);
+    }
+    if (s->depth < 10) {
+        spawn_t *child = apr_palloc(p, sizeof(*child));
+
+        *child = *s;
+        child->depth++;
+        apr_fiber_create(NULL, s->sched, spawn_fiber, child);
+        apr_fiber_create(NULL, s->sched, spawn_fiber, child);
+    }
+}
+
+static void test_spawn(abts_case *tc, void *data)
+{
+    apr_fiber_sched_t *sched = make_sched(tc);
+    apr_fiber_t *fiber;
+    spawn_t s;
+    int count = 0;
+
+    if (!sched) {
+        return;
+    }
+    s.sched = sched;
+    s.depth = 0;
+    s.count = &count;
+    s.nested_run = APR_SUCCESS;
+    APR_ASSERT_SUCCESS(tc, "create fiber",
+                       apr_fiber_create(&fiber, sched, spawn_fiber, &s));
+    ABTS_PTR_NOTNULL(tc, fiber);
+    APR_ASSERT_SUCCESS(tc, "run", apr_fiber_sched_run(sched));
+    /* a full binary tree, whose stacks are recycled */
+    ABTS_INT_EQUAL(tc, (1 << 11) - 1, count);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, s.nested_run);
+
+    /* the scheduler can be run again */
+    s.depth = 10;
+    count = 0;
+    apr_fiber_create(NULL, sched, spawn_fiber, &s);
+    APR_ASSERT_SUCCESS(tc, "rerun", apr_fiber_sched_run(sched));
+    ABTS_INT_EQUAL(tc, 1, count);
+}
+
+typedef struct {
+    apr_socket_t *listener;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    apr_status_t timeout_rv;
+    int rounds;
+} pingpong_t;
+
+static void server_fiber(apr_fiber_t *fiber, void *baton)
+{
+    pingpong_t *pp = baton;
+    apr_socket_t *sock;
+    char buf[16];
+    apr_size_t len;
+
+    pp->rv = apr_fiber_socket_wait(pp->listener, APR_POLLIN, -1);
+    if (pp->rv == APR_SUCCESS) {
+        pp->rv = apr_socket_accept(&sock, pp->listener, p);
+    }
+    if (pp->rv != APR_SUCCESS) {
+        return;
+    }
+
+    /* nothing sent yet */
+    apr_socket_timeout_set(sock, apr_time_from_msec(20));
+    len = sizeof(buf);
+    pp->timeout_rv = apr_fiber_socket_recv(sock, buf, &len);
+    apr_socket_timeout_set(sock, -1);
+
+    for (;;) {
+        len = sizeof(buf);
+        pp->rv = apr_fiber_socket_recv(sock, buf, &len);
+        if (pp->rv != APR_SUCCESS) {
+            break;
+        }
+        pp->rv = apr_fiber_socket_send(sock, buf, &len);
+        if (pp->rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    if (APR_STATUS_IS_EOF(pp->rv)) {
+        pp->rv = APR_SUCCESS;
+    }
+    apr_socket_close(sock);
+}
+
+static void client_fiber(apr_fiber_t *fiber, void *baton)
+{
+    pingpong_t *pp = baton;
+    apr_socket_t *sock;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_socket_create(&sock, pp->sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    if (rv == APR_SUCCESS) {
+        rv = apr_socket_connect(sock, pp->sa);
+    }
+    if (rv != APR_SUCCESS) {
+        pp->rv = rv;
+        return;
+    }
+    /* let the server time out once */
+    apr_fiber_sleep(apr_time_from_msec(50));
+
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        char buf[16];
+        apr_size_t len = 4;
+
+        if (apr_fiber_socket_send(sock, "ping", &len) != APR_SUCCESS) {
+            break;
+        }
+        len = sizeof(buf);
+        if (apr_fiber_socket_recv(sock, buf, &len) != APR_SUCCESS
+                || len != 4) {
+            break;
+        }
+        pp->rounds++;
+    }
+    apr_socket_close(sock);
+}
+
+static void test_ping_pong(abts_case *tc, void *data)
+{
+    apr_fiber_sched_t *sched = make_sched(tc);
+    pingpong_t pp;
+    apr_status_t rv;
+
+    if (!sched) {
+        return;
+    }
+    memset(&pp, 0, sizeof(pp));
+    pp.timeout_rv = APR_SUCCESS;
+
+    rv = apr_sockaddr_info_get(&pp.sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "resolve", rv);
+    rv = apr_socket_create(&pp.listener, APR_INET, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "create listener", rv);
+    rv = apr_socket_bind(pp.listener, pp.sa);
+    APR_ASSERT_SUCCESS(tc, "bind", rv);
+    rv = apr_socket_listen(pp.listener, 5);
+    APR_ASSERT_SUCCESS(tc, "listen", rv);
+    rv = apr_socket_addr_get(&pp.sa, APR_LOCAL, pp.listener);
+    APR_ASSERT_SUCCESS(tc, "get address", rv);
+
+    apr_fiber_create(NULL, sched, server_fiber, &pp);
+    apr_fiber_create(NULL, sched, client_fiber, &pp);
+    APR_ASSERT_SUCCESS(tc, "run", apr_fiber_sched_run(sched));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, pp.rv);
+    ABTS_INT_EQUAL(tc, APR_TIMEUP, pp.timeout_rv);
+    ABTS_INT_EQUAL(tc, NUM_ROUNDS, pp.rounds);
+    apr_socket_close(pp.listener);
+}
+
+abts_suite *testfiber(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_yield, NULL);
+    abts_run_test(suite, test_sleep, NULL);
+    abts_run_test(suite, test_spawn, NULL);
+    abts_run_test(suite, test_ping_pong, NULL);
+
+    return suite;
+}
@@ -670,6 +670,323 @@ static void test_gets_buffered_big(abts_case *tc, void *data)
     apr_file_close(f);
 }
 
+static void test_gets_seekback(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testgets_seekback.dat";
+    char buf[256];
+    apr_size_t nbytes;
+    apr_off_t off = 0;
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_WRITE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+    rv = apr_file_puts("first\nsecond\nthird", f);
+    APR_ASSERT_SUCCESS(tc, "write test data", rv);
+    apr_file_close(f);
+
+    /* An unbuffered file is read ahead, but left right after the line */
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "re-open test file", rv);
+
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read first line", rv);
+    ABTS_STR_EQUAL(tc, "first\n", buf);
+    rv = apr_file_seek(f, APR_CUR, &off);
+    APR_ASSERT_SUCCESS(tc, "get file offset", rv);
+    ABTS_INT_EQUAL(tc, 6, (int)off);
+
+    nbytes = 3;
+    rv = apr_file_read(f, buf, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "read some bytes", rv);
+    ABTS_INT_EQUAL(tc, 3, (int)nbytes);
+    ABTS_ASSERT(tc, "bytes after the line", !memcmp(buf, "sec", 3));
+
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read rest of second line", rv);
+    ABTS_STR_EQUAL(tc, "ond\n", buf);
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read last line", rv);
+    ABTS_STR_EQUAL(tc, "third", buf);
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    apr_file_close(f);
+}
+
+static void test_getline(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testgetline.dat";
+    char *hugestr;
+    const char *line;
+    apr_size_t len, hugelen = APR_BUFFERSIZE * 3 + 10;
+    int i;
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_WRITE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+    hugestr = apr_palloc(p, hugelen + 1);
+    memset(hugestr, 'a', hugelen);
+    hugestr[hugelen - 1] = '\n';
+    hugestr[hugelen] = '\0';
+    for (i = 0; i < 1000; i++) {
+        if (apr_file_printf(f, "line %d\n", i) <= 0) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 1000, i);
+    rv = apr_file_puts(hugestr, f);
+    APR_ASSERT_SUCCESS(tc, "write long line", rv);
+    rv = apr_file_puts("\nlast", f);
+    APR_ASSERT_SUCCESS(tc, "write last lines", rv);
+    apr_file_close(f);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "re-open test file", rv);
+    rv = apr_file_getline(f, &line, &len);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    apr_file_close(f);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ | APR_FOPEN_BUFFERED,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "re-open test file buffered", rv);
+
+    for (i = 0; i < 1000; i++) {
+        char expected[32];
+
+        apr_snprintf(expected, sizeof(expected), "line %d\n", i);
+        rv = apr_file_getline(f, &line, &len);
+        if (rv != APR_SUCCESS || len != strlen(expected)
+            || memcmp(line, expected, len)) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 1000, i);
+
+    rv = apr_file_getline(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read long line", rv);
+    ABTS_SIZE_EQUAL(tc, hugelen, len);
+    ABTS_ASSERT(tc, "long line", !memcmp(line, hugestr, hugelen));
+
+    rv = apr_file_ungetc('x', f);
+    APR_ASSERT_SUCCESS(tc, "call ungetc", rv);
+    rv = apr_file_getline(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read ungetc line", rv);
+    ABTS_SIZE_EQUAL(tc, 2, len);
+    ABTS_ASSERT(tc, "ungetc line", !memcmp(line, "x\n", 2));
+
+    rv = apr_file_getline(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read last line", rv);
+    ABTS_SIZE_EQUAL(tc, 4, len);
+    ABTS_ASSERT(tc, "last line", !memcmp(line, "last", 4));
+
+    rv = apr_file_getline(f, &line, &len);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    rv = apr_file_getline(f, &line, &len);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    apr_file_close(f);
+}
+
+static void test_readv(abts_case *tc, void *data)
+{
+    apr_file_t *f;
+    apr_size_t nbytes;
+    struct iovec vec[3];
+    char buf1[4], buf2[6], buf3[64];
+    const char *fname = "data/testreadv.dat";
+    const char *content = "readvector data";
+    int buffered;
+
+    for (buffered = 0; buffered < 2; buffered++) {
+        APR_ASSERT_SUCCESS(tc, "open file for writing",
+                           apr_file_open(&f, fname,
+                                         APR_FOPEN_WRITE|APR_FOPEN_CREATE|APR_FOPEN_TRUNCATE,
+                                         APR_FPROT_OS_DEFAULT, p));
+        APR_ASSERT_SUCCESS(tc, "write",
+                           apr_file_write_full(f, content, strlen(content),
+                                               NULL));
+        apr_file_close(f);
+
+        APR_ASSERT_SUCCESS(tc, "open file for reading",
+                           apr_file_open(&f, fname,
+                                         APR_FOPEN_READ |
+                                         (buffered ? APR_FOPEN_BUFFERED : 0),
+                                         APR_FPROT_OS_DEFAULT, p));
+        vec[0].iov_base = buf1;
+        vec[0].iov_len = sizeof(buf1);
+        vec[1].iov_base = buf2;
+        vec[1].iov_len = sizeof(buf2);
+        vec[2].iov_base = buf3;
+        vec[2].iov_len = sizeof(buf3);
+        APR_ASSERT_SUCCESS(tc, "readv", apr_file_readv(f, vec, 3, &nbytes));
+        ABTS_ASSERT(tc, "readv read at least the first buffer",
+                    nbytes >= sizeof(buf1));
+        ABTS_ASSERT(tc, "readv read at most the file", nbytes <= 15);
+        ABTS_ASSERT(tc, "readv data", !memcmp(buf1, "read", 4));
+        if (nbytes == 15) {
+            ABTS_ASSERT(tc, "readv data", !memcmp(buf2, "vector", 6));
+            ABTS_ASSERT(tc, "readv data", !memcmp(buf3, " data", 5));
+            ABTS_INT_EQUAL(tc, APR_EOF, apr_file_readv(f, vec, 3, &nbytes));
+            ABTS_SIZE_EQUAL(tc, 0, nbytes);
+        }
+        apr_file_close(f);
+    }
+    apr_file_remove(fname, p);
+}
+
+static void test_pread_pwrite(abts_case *tc, void *data)
+{
+    apr_file_t *f;
+    apr_size_t nbytes;
+    apr_off_t off;
+    struct iovec vec[2];
+    char buf[64], buf2[8];
+    const char *fname = "data/testpread.dat";
+    int buffered;
+
+    for (buffered = 0; buffered < 2; buffered++) {
+        APR_ASSERT_SUCCESS(tc, "open file",
+                           apr_file_open(&f, fname,
+                                         APR_FOPEN_READ|APR_FOPEN_WRITE|APR_FOPEN_CREATE|APR_FOPEN_TRUNCATE |
+                                         (buffered ? APR_FOPEN_BUFFERED : 0),
+                                         APR_FPROT_OS_DEFAULT, p));
+        nbytes = 10;
+        APR_ASSERT_SUCCESS(tc, "write",
+                           apr_file_write(f, "0123456789", &nbytes));
+
+        /* positional writes, left pending by the buffered write above */
+        nbytes = 3;
+        APR_ASSERT_SUCCESS(tc, "pwrite",
+                           apr_file_pwrite(f, "abc", &nbytes, 2));
+        ABTS_SIZE_EQUAL(tc, 3, nbytes);
+        vec[0].iov_base = "XY";
+        vec[0].iov_len = 2;
+        vec[1].iov_base = "Z";
+        vec[1].iov_len = 1;
+        APR_ASSERT_SUCCESS(tc, "pwritev",
+                           apr_file_pwritev(f, vec, 2, &nbytes, 12));
+        ABTS_SIZE_EQUAL(tc, 3, nbytes);
+
+        /* the file pointer did not move */
+        off = 0;
+        APR_ASSERT_SUCCESS(tc, "seek", apr_file_seek(f, APR_CUR, &off));
+        ABTS_INT_EQUAL(tc, 10, (int)off);
+
+        nbytes = sizeof(buf);
+        APR_ASSERT_SUCCESS(tc, "pread", apr_file_pread(f, buf, &nbytes, 0));
+        ABTS_SIZE_EQUAL(tc, 15, nbytes);
+        ABTS_ASSERT(tc, "pread data",
+                    !memcmp(buf, "01abc56789\0\0XYZ", 15));
+
+        vec[0].iov_base = buf;
+        vec[0].iov_len = 4;
+        vec[1].iov_base = buf2;
+        vec[1].iov_len = sizeof(buf2);
+        APR_ASSERT_SUCCESS(tc, "preadv",
+                           apr_file_preadv(f, vec, 2, &nbytes, 1));
+        ABTS_SIZE_EQUAL(tc, 12, nbytes);
+        ABTS_ASSERT(tc, "preadv data", !memcmp(buf, "1abc", 4));
+        ABTS_ASSERT(tc, "preadv data", !memcmp(buf2, "56789\0\0X", 8));
+
+        nbytes = sizeof(buf);
+        ABTS_INT_EQUAL(tc, APR_EOF, apr_file_pread(f, buf, &nbytes, 15));
+        ABTS_SIZE_EQUAL(tc, 0, nbytes);
+
+        /* sequential reads carry on from where they were */
+        off = 0;
+        APR_ASSERT_SUCCESS(tc, "seek", apr_file_seek(f, APR_SET, &off));
+        nbytes = 4;
+        APR_ASSERT_SUCCESS(tc, "read", apr_file_read(f, buf, &nbytes));
+        nbytes = 1;
+        APR_ASSERT_SUCCESS(tc, "pwrite over the read buffer",
+                           apr_file_pwrite(f, "!", &nbytes, 4));
+        nbytes = 2;
+        APR_ASSERT_SUCCESS(tc, "read", apr_file_read(f, buf, &nbytes));
+        ABTS_ASSERT(tc, "read sees the pwrite", !memcmp(buf, "!5", 2));
+
+        apr_file_close(f);
+    }
+    apr_file_remove(fname, p);
+}
+
+static void test_direct_noreuse(abts_case *tc, void *data)
+{
+    apr_file_t *f;
+    apr_status_t rv;
+    apr_size_t nbytes, i, total = 3 * 1024 * 1024 + 123;
+    char *contents = apr_palloc(p, total), *buf = apr_palloc(p, total);
+    char *mybuf = apr_palloc(p, 64 * 1024 + 1);
+    const char *fname = "data/testdirect.dat";
+    apr_int32_t flags[2] = { APR_FOPEN_DIRECT, APR_FOPEN_NOREUSE };
+    int j;
+
+    for (i = 0; i < total; i++) {
+        contents[i] = (char)('a' + i % 23);
+    }
+
+    for (j = 0; j < 2; j++) {
+        rv = apr_file_open(&f, fname,
+                           APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                           | APR_FOPEN_TRUNCATE | flags[j],
+                           APR_FPROT_OS_DEFAULT, p);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_NOT_IMPL(tc, "direct I/O");
+            continue;
+        }
+        APR_ASSERT_SUCCESS(tc, "open for writing", rv);
+
+        /* odd sized writes, the tail being unaligned */
+        for (i = 0; i < total; i += nbytes) {
+            nbytes = total - i < 10007 ? total - i : 10007;
+            APR_ASSERT_SUCCESS(tc, "write",
+                               apr_file_write_full(f, contents + i, nbytes,
+                                                   NULL));
+        }
+        APR_ASSERT_SUCCESS(tc, "close", apr_file_close(f));
+
+        APR_ASSERT_SUCCESS(tc, "open for reading",
+                           apr_file_open(&f, fname,
+                                         APR_FOPEN_READ | APR_FOPEN_WRITE
+                                         | flags[j],
+                                         APR_FPROT_OS_DEFAULT, p));
+        APR_ASSERT_SUCCESS(tc, "read",
+                           apr_file_read_full(f, buf, total, &nbytes));
+        ABTS_SIZE_EQUAL(tc, total, nbytes);
+        ABTS_ASSERT(tc, "read content", !memcmp(buf, contents, total));
+
+        /* unaligned positional I/O, and an unaligned buffer */
+        nbytes = 5;
+        APR_ASSERT_SUCCESS(tc, "pread", apr_file_pread(f, buf, &nbytes,
+                                                       4099));
+        ABTS_ASSERT(tc, "pread content", !memcmp(buf, contents + 4099, 5));
+        APR_ASSERT_SUCCESS(tc, "buffer set",
+                           apr_file_buffer_set(f, mybuf + 1, 64 * 1024));
+        if (flags[j] == APR_FOPEN_DIRECT) {
+            ABTS_ASSERT(tc, "aligned buffer size",
+                        apr_file_buffer_size_get(f) < 64 * 1024);
+        }
+        nbytes = 3;
+        APR_ASSERT_SUCCESS(tc, "pwrite", apr_file_pwrite(f, "XYZ", &nbytes,
+                                                         8191));
+        nbytes = 1024 * 1024;
+        APR_ASSERT_SUCCESS(tc, "pread",
+                           apr_file_pread(f, buf, &nbytes, 4096));
+        ABTS_SIZE_EQUAL(tc, 1024 * 1024, nbytes);
+        ABTS_ASSERT(tc, "pread content", !memcmp(buf + 4095, "XYZ", 3));
+        ABTS_ASSERT(tc, "pread content",
+                    !memcmp(buf + 4098, contents + 8194, 1000));
+        apr_file_close(f);
+    }
+    apr_file_remove(fname, p);
+}
+
 static void test_bigread(abts_case *tc, void *data)
 {
     apr_file_t *f = NULL;
@@ -2279,11 +2596,16 @@ abts_suite *testfile(abts_suite *suite)
     abts_run_test(suite, test_gets_small_buf, NULL);
     abts_run_test(suite, test_gets_ungetc, NULL);
     abts_run_test(suite, test_gets_buffered_big, NULL);
+    abts_run_test(suite, test_gets_seekback, NULL);
+    abts_run_test(suite, test_getline, NULL);
     abts_run_test(suite, test_puts, NULL);
     abts_run_test(suite, test_writev, NULL);
     abts_run_test(suite, test_writev_full, NULL);
     abts_run_test(suite, test_writev_buffered, NULL);
     abts_run_test(suite, test_writev_buffered_seek, NULL);
+    abts_run_test(suite, test_readv, NULL);
+    abts_run_test(suite, test_pread_pwrite, NULL);
+    abts_run_test(suite, test_direct_noreuse, NULL);
     abts_run_test(suite, test_bigread, NULL);
     abts_run_test(suite, test_mod_neg, NULL);
     abts_run_test(suite, test_truncate, NULL);
@@ -0,0 +1,220 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_file_appender.h"
+#include "apr_file_io.h"
+#include "apr_thread_proc.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#define APPENDFILE "data/appender.log"
+#define NTHREADS 8
+#define NRECORDS 2000
+
+static apr_file_t *open_log(abts_case *tc, apr_pool_t *pool)
+{
+    apr_file_t *f = NULL;
+
+    APR_ASSERT_SUCCESS(tc, "open log",
+                       apr_file_open(&f, APPENDFILE,
+                                     APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                                     | APR_FOPEN_TRUNCATE | APR_FOPEN_APPEND,
+                                     APR_FPROT_OS_DEFAULT, pool));
+    return f;
+}
+
+static char *read_log(abts_case *tc, apr_size_t *len)
+{
+    apr_file_t *f;
+    apr_finfo_t finfo;
+    char *buf;
+
+    APR_ASSERT_SUCCESS(tc, "open log",
+                       apr_file_open(&f, APPENDFILE, APR_FOPEN_READ,
+                                     APR_FPROT_OS_DEFAULT, p));
+    APR_ASSERT_SUCCESS(tc, "stat log",
+                       apr_file_info_get(&finfo, APR_FINFO_SIZE, f));
+    *len = (apr_size_t)finfo.size;
+    buf = apr_palloc(p, *len + 1);
+    if (*len) {
+        APR_ASSERT_SUCCESS(tc, "read log",
+                           apr_file_read_full(f, buf, *len, NULL));
+    }
+    buf[*len] = '\0';
+    apr_file_close(f);
+    return buf;
+}
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_file_appender_t *app;
+    apr_file_t *f = open_log(tc, p);
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_file_appender_create(&app, f, 0, 0, 0, p));
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_file_appender_create(&app, f, 4096, 0,
+                                            APR_FILE_APPENDER_THREAD, p));
+    apr_file_close(f);
+}
+
+static apr_size_t hooked;
+
+static apr_status_t count_hook(void *baton, apr_file_t *file, apr_size_t len)
+{
+    hooked += len;
+    return APR_SUCCESS;
+}
+
+static void test_write(abts_case *tc, void *data)
+{
+    apr_file_appender_t *app;
+    apr_pool_t *pool;
+    apr_file_t *f;
+    struct iovec vec[2];
+    char big[100];
+    apr_size_t len;
+    char *log;
+
+    apr_pool_create(&pool, p);
+    f = open_log(tc, pool);
+    APR_ASSERT_SUCCESS(tc, "create appender",
+                       apr_file_appender_create(&app, f, 64, 0, 0, pool));
+    apr_file_appender_hook_set(app, count_hook, NULL);
+    apr_file_appender_sync_set(app, 1, 0);
+    hooked = 0;
+
+    APR_ASSERT_SUCCESS(tc, "write",
+                       apr_file_appender_write(app, "one\n", 4));
+    vec[0].iov_base = "tw";
+    vec[0].iov_len = 2;
+    vec[1].iov_base = "o\n";
+    vec[1].iov_len = 2;
+    APR_ASSERT_SUCCESS(tc, "writev", apr_file_appender_writev(app, vec, 2));
+
+    /* nothing written until committed */
+    read_log(tc, &len);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    APR_ASSERT_SUCCESS(tc, "flush", apr_file_appender_flush(app));
+    log = read_log(tc, &len);
+    ABTS_STR_EQUAL(tc, "one\ntwo\n", log);
+    ABTS_SIZE_EQUAL(tc, 8, hooked);
+
+    /* a record larger than the buffers goes after the pending ones */
+    APR_ASSERT_SUCCESS(tc, "write",
+                       apr_file_appender_write(app, "three\n", 6));
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\n';
+    APR_ASSERT_SUCCESS(tc, "write big",
+                       apr_file_appender_write(app, big, sizeof(big)));
+    APR_ASSERT_SUCCESS(tc, "write",
+                       apr_file_appender_write(app, "four\n", 5));
+
+    /* the pool's cleanup commits the rest */
+    apr_pool_destroy(pool);
+    log = read_log(tc, &len);
+    ABTS_SIZE_EQUAL(tc, 8 + 6 + sizeof(big) + 5, len);
+    ABTS_TRUE(tc, strncmp(log + 8, "three\nxxx", 9) == 0);
+    ABTS_STR_EQUAL(tc, "four\n", log + len - 5);
+}
+
+#if APR_HAS_THREADS
+typedef struct writer_t {
+    apr_file_appender_t *app;
+    int id;
+} writer_t;
+
+static void *APR_THREAD_FUNC appender_writer(apr_thread_t *thd, void *data)
+{
+    writer_t *w = data;
+    char rec[32];
+    int i;
+
+    for (i = 0; i < NRECORDS; i++) {
+        int len = apr_snprintf(rec, sizeof(rec), "%d:%d\n", w->id, i);
+
+        if (apr_file_appender_write(w->app, rec, len) != APR_SUCCESS) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(abts_case *tc, void *data)
+{
+    apr_file_appender_t *app;
+    apr_thread_t *threads[NTHREADS];
+    writer_t writers[NTHREADS];
+    int next[NTHREADS];
+    apr_pool_t *pool;
+    apr_file_t *f;
+    apr_status_t rv;
+    apr_size_t len;
+    char *log, *line, *last;
+    int i, n = 0;
+
+    apr_pool_create(&pool, p);
+    f = open_log(tc, pool);
+    APR_ASSERT_SUCCESS(tc, "create appender",
+                       apr_file_appender_create(&app, f, 1024,
+                                                apr_time_from_msec(5),
+                                                APR_FILE_APPENDER_THREAD,
+                                                pool));
+    for (i = 0; i < NTHREADS; i++) {
+        next[i] = 0;
+        writers[i].app = app;
+        writers[i].id = i;
+        APR_ASSERT_SUCCESS(tc, "create thread",
+                           apr_thread_create(&threads[i], NULL,
+                                             appender_writer, &writers[i],
+                                             pool));
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        apr_thread_join(&rv, threads[i]);
+    }
+    APR_ASSERT_SUCCESS(tc, "flush", apr_file_appender_flush(app));
+
+    /* every record whole, each thread's in order */
+    log = read_log(tc, &len);
+    for (line = apr_strtok(log, "\n", &last); line;
+         line = apr_strtok(NULL, "\n", &last)) {
+        int id, seq;
+
+        if (sscanf(line, "%d:%d", &id, &seq) != 2
+            || id < 0 || id >= NTHREADS || seq != next[id]) {
+            break;
+        }
+        next[id]++;
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, NTHREADS * NRECORDS, n);
+    apr_pool_destroy(pool);
+}
+#endif
+
+abts_suite *testfileappender(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_write, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_threads, NULL);
+#endif
+
+    return suite;
+}
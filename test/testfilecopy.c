@@ -123,6 +123,83 @@ static void append_exist(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Couldn't remove copy file", rv);
 }
 
+#define BIG_SIZE (3 * 1024 * 1024 + 17)
+
+static char *read_whole(abts_case *tc, const char *fname, apr_size_t *len,
+                        apr_pool_t *pool)
+{
+    apr_file_t *f;
+    apr_finfo_t finfo;
+    char *buf;
+    apr_status_t rv;
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ, APR_FPROT_OS_DEFAULT, pool);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open file", rv);
+    rv = apr_file_info_get(&finfo, APR_FINFO_SIZE, f);
+    APR_ASSERT_SUCCESS(tc, "Couldn't stat file", rv);
+    buf = apr_palloc(pool, (apr_size_t)finfo.size + 1);
+    rv = apr_file_read_full(f, buf, (apr_size_t)finfo.size, len);
+    APR_ASSERT_SUCCESS(tc, "Couldn't read file", rv);
+    apr_file_close(f);
+    return buf;
+}
+
+static void copy_ex_large(abts_case *tc, void *data)
+{
+    apr_file_t *f;
+    char *pattern, *got;
+    apr_size_t i, len;
+    apr_status_t rv;
+
+    pattern = apr_palloc(p, BIG_SIZE);
+    for (i = 0; i < BIG_SIZE; i++) {
+        pattern[i] = (char)(i * 7 + i / 4096);
+    }
+    rv = apr_file_open(&f, "data/file_copy_big.dat",
+                       APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create file", rv);
+    rv = apr_file_write_full(f, pattern, BIG_SIZE, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't write file", rv);
+    apr_file_close(f);
+
+    apr_file_remove("data/file_copy.dat", p);
+    rv = apr_file_copy_ex("data/file_copy_big.dat", "data/file_copy.dat",
+                          APR_FPROT_FILE_SOURCE_PERMS, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Error copying file", rv);
+    got = read_whole(tc, "data/file_copy.dat", &len, p);
+    ABTS_SIZE_EQUAL(tc, BIG_SIZE, len);
+    ABTS_ASSERT(tc, "copy differs", memcmp(got, pattern, BIG_SIZE) == 0);
+
+    rv = apr_file_copy_ex("data/file_copy_big.dat", "data/file_copy.dat",
+                          APR_FPROT_FILE_SOURCE_PERMS, APR_FILE_COPY_APPEND,
+                          p);
+    APR_ASSERT_SUCCESS(tc, "Error appending file", rv);
+    got = read_whole(tc, "data/file_copy.dat", &len, p);
+    ABTS_SIZE_EQUAL(tc, 2 * BIG_SIZE, len);
+    ABTS_ASSERT(tc, "append differs",
+                memcmp(got, pattern, BIG_SIZE) == 0
+                && memcmp(got + BIG_SIZE, pattern, BIG_SIZE) == 0);
+
+    /* Cloning depends on the file system, so either outcome goes */
+    rv = apr_file_copy_ex("data/file_copy_big.dat", "data/file_copy.dat",
+                          APR_FPROT_FILE_SOURCE_PERMS, APR_FILE_COPY_CLONE,
+                          p);
+    if (rv == APR_SUCCESS) {
+        got = read_whole(tc, "data/file_copy.dat", &len, p);
+        ABTS_SIZE_EQUAL(tc, BIG_SIZE, len);
+        ABTS_ASSERT(tc, "clone differs",
+                    memcmp(got, pattern, BIG_SIZE) == 0);
+    }
+    else {
+        ABTS_INT_EQUAL(tc, APR_ENOTIMPL, rv);
+    }
+
+    apr_file_remove("data/file_copy.dat", p);
+    rv = apr_file_remove("data/file_copy_big.dat", p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't remove big file", rv);
+}
+
 abts_suite *testfilecopy(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -133,6 +210,8 @@ abts_suite *testfilecopy(abts_suite *suite)
     abts_run_test(suite, append_nonexist, NULL);
     abts_run_test(suite, append_exist, NULL);
 
+    abts_run_test(suite, copy_ex_large, NULL);
+
     return suite;
 }
 
@@ -128,6 +128,77 @@ static void more_int64_fmts(abts_case *tc, void *data)
     ABTS_STR_EQUAL(tc, "-314159265358979323", buf);
 }
 
+static void decimal_fmts(abts_case *tc, void *data)
+{
+    char buf[100], expect[100];
+    apr_uint64_t u;
+    int i;
+
+    for (u = 1, i = 0; i < 20; i++, u *= 10) {
+        apr_uint64_t v;
+
+        for (v = u - 1; v <= u + 1; v++) {
+            apr_snprintf(buf, sizeof buf, "%" APR_UINT64_T_FMT, v);
+            sprintf(expect, "%llu", (unsigned long long)v);
+            ABTS_STR_EQUAL(tc, expect, buf);
+            apr_snprintf(buf, sizeof buf, "%" APR_INT64_T_FMT,
+                         -(apr_int64_t)(v >> 1));
+            sprintf(expect, "%lld", -(long long)(v >> 1));
+            ABTS_STR_EQUAL(tc, expect, buf);
+            apr_snprintf(buf, sizeof buf, "%d|%u", (int)v, (unsigned int)v);
+            sprintf(expect, "%d|%u", (int)v, (unsigned int)v);
+            ABTS_STR_EQUAL(tc, expect, buf);
+        }
+    }
+
+    apr_snprintf(buf, sizeof buf, "%d %d %u", APR_INT32_MIN, APR_INT32_MAX,
+                 APR_UINT32_MAX);
+    ABTS_STR_EQUAL(tc, "-2147483648 2147483647 4294967295", buf);
+    apr_snprintf(buf, sizeof buf, "%" APR_INT64_T_FMT " %" APR_UINT64_T_FMT,
+                 APR_INT64_MIN, APR_UINT64_MAX);
+    ABTS_STR_EQUAL(tc, "-9223372036854775808 18446744073709551615", buf);
+}
+
+#define COMPILED_FMT(fmt, ...) \
+    do { \
+        int len = apr_snprintf(buf, sizeof buf, fmt, __VA_ARGS__); \
+        ABTS_INT_EQUAL(tc, len, apr_format_exec(cbuf, sizeof cbuf, \
+                       apr_format_compile(fmt, p), __VA_ARGS__)); \
+        ABTS_STR_EQUAL(tc, buf, cbuf); \
+    } while (0)
+
+static void compiled_fmt(abts_case *tc, void *data)
+{
+    char buf[200], cbuf[200];
+    apr_status_t rv = APR_ENOTIMPL;
+    apr_format_t *format;
+    double d = 0.1;
+    int n = 0;
+
+    COMPILED_FMT("plain", NULL);
+    COMPILED_FMT("%d|%5d|%-5d|%05d|%+d|% d|%i", -42, 42, 42, -42, 42, 42, 7);
+    COMPILED_FMT("%*d|%-*d|%.*d|%*.*d", 6, 1, 6, 2, 4, 3, -6, 3, 4);
+    COMPILED_FMT("%u %lu %hu", 3000000000U, (long)7, 70000);
+    COMPILED_FMT("%x %#X %o %#o %08x", 255, 255, 8, 8, 0xbeef);
+    COMPILED_FMT("%" APR_INT64_T_FMT "/%" APR_UINT64_T_HEX_FMT,
+                 APR_INT64_C(-1234567890123), APR_UINT64_C(0xfeedfacecafe));
+    COMPILED_FMT("[%s|%10s|%-10s|%.3s|%s]", "a", "right", "left", "truncate",
+                 (char *)NULL);
+    COMPILED_FMT("%c%%%c", 'x', 'y');
+    COMPILED_FMT("%f %.2e %g %G %#g", 3.25, 12345.678, 0.0001, 1e20, 1.0);
+    COMPILED_FMT("%pm and %pd", &rv, &d);
+    COMPILED_FMT("unknown %y %", 1);
+    COMPILED_FMT("trailing %p", NULL);
+    COMPILED_FMT("%s%n-%d", "abc", &n, 5);
+    ABTS_INT_EQUAL(tc, 3, n);
+
+    /* truncated as apr_snprintf() does */
+    format = apr_format_compile("%s=%d", p);
+    ABTS_INT_EQUAL(tc, 5, apr_format_exec(cbuf, 6, format, "abcd", 42));
+    ABTS_STR_EQUAL(tc, "abcd=", cbuf);
+    ABTS_INT_EQUAL(tc, 7, apr_format_exec(NULL, 0, format, "abcd", 42));
+}
+
 static void error_fmt(abts_case *tc, void *data)
 {
     char ebuf[150], sbuf[150], *s;
@@ -159,6 +230,8 @@ abts_suite *testfmt(abts_suite *suite)
     abts_run_test(suite, uint64_t_fmt, NULL);
     abts_run_test(suite, uint64_t_hex_fmt, NULL);
     abts_run_test(suite, more_int64_fmts, NULL);
+    abts_run_test(suite, decimal_fmts, NULL);
+    abts_run_test(suite, compiled_fmt, NULL);
     abts_run_test(suite, error_fmt, NULL);
 
     return suite;
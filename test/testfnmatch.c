@@ -174,6 +174,136 @@ static void test_fnmatch(abts_case *tc, void *data)
     }
 }
 
+static void test_fnmatch_compile(abts_case *tc, void *data)
+{
+    struct pattern_s *test;
+    char buf[80];
+    int i, res;
+
+    for (test = patterns; test->pattern; ++test) {
+        for (i = 0; i <= APR_FNM_BITS; ++i) {
+            res = apr_fnmatch_exec(apr_fnmatch_compile(test->pattern, i, p),
+                                   test->string);
+            if (res != apr_fnmatch(test->pattern, test->string, i)) {
+                sprintf(buf, "apr_fnmatch_exec(\"%s\", \"%s\", %d) "
+                        "returns %d\n", test->pattern, test->string, i, res);
+                abts_fail(tc, buf, __LINE__);
+                return;
+            }
+        }
+    }
+}
+
+static char *random_string(apr_size_t max, const char *chars,
+                           unsigned int *seed)
+{
+    apr_size_t len, n = strlen(chars), i;
+    char *s;
+
+    *seed = *seed * 1103515245 + 12345;
+    len = (*seed >> 16) % (max + 1);
+    s = apr_palloc(p, len + 1);
+    for (i = 0; i < len; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        s[i] = chars[(*seed >> 16) % n];
+    }
+    s[len] = '\0';
+
+    return s;
+}
+
+/* Random patterns and strings, checked against apr_fnmatch() */
+static void test_fnmatch_random(abts_case *tc, void *data)
+{
+    unsigned int seed = 5;
+    char buf[120];
+    int n, k, i;
+
+    for (n = 0; n < 2000; n++) {
+        char *pattern = random_string(8, "ab.//**?[]!-\\A", &seed);
+        apr_fnmatch_t *fnm[APR_FNM_BITS + 1];
+
+        for (i = 0; i <= APR_FNM_BITS; ++i) {
+            fnm[i] = apr_fnmatch_compile(pattern, i, p);
+        }
+        for (k = 0; k < 20; k++) {
+            char *string = random_string(8, "ab.//Ab-[]*\\", &seed);
+
+            for (i = 0; i <= APR_FNM_BITS; ++i) {
+                int res = apr_fnmatch_exec(fnm[i], string);
+
+                if (res != apr_fnmatch(pattern, string, i)) {
+                    sprintf(buf, "apr_fnmatch_exec(\"%s\", \"%s\", %d) "
+                            "returns %d\n", pattern, string, i, res);
+                    abts_fail(tc, buf, __LINE__);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void test_fnmatch_list(abts_case *tc, void *data)
+{
+    static const char *const globs[] = {
+        "/api/v1/users", "/api/*/users", "/api/v1/*", "*.css", "/static/*",
+        "/static/*.css", "/api/v1/users/*"
+    };
+    apr_array_header_t *list = apr_array_make(p, 8, sizeof(const char *));
+    const apr_fnmatch_list_t *fnms;
+    unsigned int seed = 9;
+    int n, i, k;
+
+    for (i = 0; i < (int)(sizeof(globs) / sizeof(globs[0])); i++) {
+        APR_ARRAY_PUSH(list, const char *) = globs[i];
+    }
+    fnms = apr_fnmatch_list_compile(list, APR_FNM_PATHNAME, p);
+    ABTS_INT_EQUAL(tc, 0, apr_fnmatch_list_exec(fnms, "/api/v1/users"));
+    ABTS_INT_EQUAL(tc, 1, apr_fnmatch_list_exec(fnms, "/api/v2/users"));
+    ABTS_INT_EQUAL(tc, 2, apr_fnmatch_list_exec(fnms, "/api/v1/groups"));
+    ABTS_INT_EQUAL(tc, 4, apr_fnmatch_list_exec(fnms, "/static/a.css"));
+    ABTS_INT_EQUAL(tc, 6, apr_fnmatch_list_exec(fnms, "/api/v1/users/x"));
+    ABTS_INT_EQUAL(tc, 3, apr_fnmatch_list_exec(fnms, "a.css"));
+    ABTS_INT_EQUAL(tc, -1, apr_fnmatch_list_exec(fnms, "/a.css"));
+    ABTS_INT_EQUAL(tc, -1, apr_fnmatch_list_exec(fnms, ""));
+
+    fnms = apr_fnmatch_list_compile(list, APR_FNM_CASE_BLIND, p);
+    ABTS_INT_EQUAL(tc, 1, apr_fnmatch_list_exec(fnms, "/API/V2/Users"));
+    ABTS_INT_EQUAL(tc, 3, apr_fnmatch_list_exec(fnms, "/a.CSS"));
+
+    apr_array_clear(list);
+    fnms = apr_fnmatch_list_compile(list, 0, p);
+    ABTS_INT_EQUAL(tc, -1, apr_fnmatch_list_exec(fnms, "a"));
+
+    /* Random lists, checked against apr_fnmatch() on each pattern */
+    for (n = 0; n < 50; n++) {
+        apr_array_clear(list);
+        for (i = 0; i < 40; i++) {
+            APR_ARRAY_PUSH(list, const char *) =
+                random_string(6, "aab/b.*?[]", &seed);
+        }
+        for (i = 0; i <= APR_FNM_BITS; ++i) {
+            fnms = apr_fnmatch_list_compile(list, i, p);
+            for (k = 0; k < 20; k++) {
+                char *string = random_string(6, "aAb/b.", &seed);
+                int expected;
+
+                for (expected = 0; expected < list->nelts; expected++) {
+                    if (!apr_fnmatch(APR_ARRAY_IDX(list, expected, char *),
+                                     string, i)) {
+                        break;
+                    }
+                }
+                if (expected == list->nelts) {
+                    expected = -1;
+                }
+                ABTS_INT_EQUAL(tc, expected,
+                               apr_fnmatch_list_exec(fnms, string));
+            }
+        }
+    }
+}
+
 static void test_fnmatch_test(abts_case *tc, void *data)
 {
     static const struct test {
@@ -247,6 +377,9 @@ abts_suite *testfnmatch(abts_suite *suite)
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test_fnmatch, NULL);
+    abts_run_test(suite, test_fnmatch_compile, NULL);
+    abts_run_test(suite, test_fnmatch_random, NULL);
+    abts_run_test(suite, test_fnmatch_list, NULL);
     abts_run_test(suite, test_fnmatch_test, NULL);
     abts_run_test(suite, test_glob, NULL);
     abts_run_test(suite, test_glob_currdir, NULL);
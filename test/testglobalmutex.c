@@ -17,6 +17,7 @@
 #include "testglobalmutex.h"
 #include "apr_thread_proc.h"
 #include "apr_global_mutex.h"
+#include "apr_portable.h"
 #include "apr_strings.h"
 #include "apr_errno.h"
 #include "testutil.h"
@@ -67,6 +68,7 @@ static const char *mutexname(apr_lockmech_e mech)
     case APR_LOCK_SYSVSEM: return "sysvsem";
     case APR_LOCK_PROC_PTHREAD: return "proc_pthread";
     case APR_LOCK_POSIXSEM: return "posixsem";
+    case APR_LOCK_FUTEX: return "futex";
     case APR_LOCK_DEFAULT: return "default";
     case APR_LOCK_DEFAULT_TIMED: return "default_timed";
     default: return "unknown";
@@ -109,6 +111,37 @@ static void test_exclusive(abts_case *tc, void *data)
     }
 }
 
+static void test_unthreaded(abts_case *tc, void *data)
+{
+    apr_global_mutex_t *global_lock;
+    apr_status_t rv;
+
+    rv = apr_global_mutex_create_ex(&global_lock, LOCKNAME, APR_LOCK_DEFAULT,
+                                    APR_GLOBAL_MUTEX_UNTHREADED, p);
+    APR_ASSERT_SUCCESS(tc, "Error creating mutex", rv);
+
+#if APR_HAS_THREADS && !APR_PROC_MUTEX_IS_GLOBAL
+    {
+        apr_os_global_mutex_t osmutex;
+
+        /* only the process lock is taken */
+        apr_os_global_mutex_get(&osmutex, global_lock);
+        ABTS_PTR_EQUAL(tc, NULL, osmutex.thread_mutex);
+    }
+#endif
+
+    APR_ASSERT_SUCCESS(tc, "Error locking mutex",
+                       apr_global_mutex_lock(global_lock));
+    APR_ASSERT_SUCCESS(tc, "Error unlocking mutex",
+                       apr_global_mutex_unlock(global_lock));
+    APR_ASSERT_SUCCESS(tc, "Error trylocking mutex",
+                       apr_global_mutex_trylock(global_lock));
+    APR_ASSERT_SUCCESS(tc, "Error unlocking mutex",
+                       apr_global_mutex_unlock(global_lock));
+    APR_ASSERT_SUCCESS(tc, "Error destroying mutex",
+                       apr_global_mutex_destroy(global_lock));
+}
+
 abts_suite *testglobalmutex(abts_suite *suite)
 {
     apr_lockmech_e mech = APR_LOCK_DEFAULT;
@@ -127,6 +160,10 @@ abts_suite *testglobalmutex(abts_suite *suite)
     mech = APR_LOCK_PROC_PTHREAD;
     abts_run_test(suite, test_exclusive, &mech);
 #endif
+#if APR_HAS_FUTEX_SERIALIZE
+    mech = APR_LOCK_FUTEX;
+    abts_run_test(suite, test_exclusive, &mech);
+#endif
 #if APR_HAS_FCNTL_SERIALIZE
     mech = APR_LOCK_FCNTL;
     abts_run_test(suite, test_exclusive, &mech);
@@ -137,6 +174,7 @@ abts_suite *testglobalmutex(abts_suite *suite)
 #endif
     mech = APR_LOCK_DEFAULT_TIMED;
     abts_run_test(suite, test_exclusive, &mech);
+    abts_run_test(suite, test_unthreaded, NULL);
 
     return suite;
 }
@@ -0,0 +1,201 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_hamt.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#define NKEYS 2000
+
+static const char **make_keys(const char *prefix)
+{
+    const char **keys = apr_palloc(p, NKEYS * sizeof(char *));
+    int i;
+
+    for (i = 0; i < NKEYS; i++) {
+        keys[i] = apr_psprintf(p, "%s%d", prefix, i);
+    }
+    return keys;
+}
+
+static int count_do(void *rec, const void *key, apr_ssize_t klen,
+                    const void *val)
+{
+    (*(int *)rec)++;
+    return 1;
+}
+
+/* Only 16 distinct hashes, so most keys collide */
+static unsigned int bad_hash(const char *key, apr_ssize_t *klen)
+{
+    unsigned int h = apr_hashfunc_default(key, klen);
+
+    return h & 0xf;
+}
+
+static void check_keys(abts_case *tc, apr_hamt_t *h, const char **keys,
+                       int from, int to, const char *val)
+{
+    int i;
+
+    for (i = from; i < to; i++) {
+        const char *v = apr_hamt_get(h, keys[i], APR_HASH_KEY_STRING);
+        if (v != (val ? val : keys[i])) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, to, i);
+}
+
+static void test_set_get(abts_case *tc, void *data)
+{
+    const char **keys = make_keys("key");
+    apr_hamt_t *h = apr_hamt_make(p);
+    int i, n = 0;
+
+    ABTS_INT_EQUAL(tc, 0, apr_hamt_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hamt_get(h, "key0", APR_HASH_KEY_STRING));
+    apr_hamt_set(h, "key0", APR_HASH_KEY_STRING, NULL);
+
+    for (i = 0; i < NKEYS; i++) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    ABTS_INT_EQUAL(tc, NKEYS, apr_hamt_count(h));
+    check_keys(tc, h, keys, 0, NKEYS, NULL);
+    ABTS_PTR_EQUAL(tc, NULL, apr_hamt_get(h, "nokey", APR_HASH_KEY_STRING));
+    ABTS_PTR_EQUAL(tc, keys[5], apr_hamt_get(h, "key57", 4));
+
+    /* replacing */
+    apr_hamt_set(h, "key1", APR_HASH_KEY_STRING, "one");
+    ABTS_INT_EQUAL(tc, NKEYS, apr_hamt_count(h));
+    ABTS_STR_EQUAL(tc, "one", apr_hamt_get(h, "key1", APR_HASH_KEY_STRING));
+
+    /* removing */
+    for (i = 0; i < NKEYS; i += 2) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, NULL);
+    }
+    ABTS_INT_EQUAL(tc, NKEYS / 2, apr_hamt_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hamt_get(h, keys[0], APR_HASH_KEY_STRING));
+    check_keys(tc, h, keys, NKEYS - 1, NKEYS, NULL);
+    apr_hamt_do(count_do, &n, h);
+    ABTS_INT_EQUAL(tc, NKEYS / 2, n);
+
+    for (i = 1; i < NKEYS; i += 2) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, NULL);
+    }
+    ABTS_INT_EQUAL(tc, 0, apr_hamt_count(h));
+    n = 0;
+    apr_hamt_do(count_do, &n, h);
+    ABTS_INT_EQUAL(tc, 0, n);
+}
+
+static void test_copy(abts_case *tc, void *data)
+{
+    const char **keys = make_keys("copy");
+    apr_hamt_t *h = apr_hamt_make(p), *c1, *c2;
+    int i;
+
+    for (i = 0; i < NKEYS / 2; i++) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    c1 = apr_hamt_copy(p, h);
+
+    /* the copy and the original diverge */
+    for (i = NKEYS / 2; i < NKEYS; i++) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    for (i = 0; i < NKEYS / 2; i += 2) {
+        apr_hamt_set(c1, keys[i], APR_HASH_KEY_STRING, "c1");
+    }
+    c2 = apr_hamt_copy(p, c1);
+    for (i = 1; i < NKEYS / 2; i += 2) {
+        apr_hamt_set(c1, keys[i], APR_HASH_KEY_STRING, NULL);
+    }
+
+    ABTS_INT_EQUAL(tc, NKEYS, apr_hamt_count(h));
+    check_keys(tc, h, keys, 0, NKEYS, NULL);
+
+    ABTS_INT_EQUAL(tc, NKEYS / 4, apr_hamt_count(c1));
+    ABTS_STR_EQUAL(tc, "c1", apr_hamt_get(c1, keys[0], APR_HASH_KEY_STRING));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hamt_get(c1, keys[1], APR_HASH_KEY_STRING));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hamt_get(c1, keys[NKEYS - 1],
+                                          APR_HASH_KEY_STRING));
+
+    ABTS_INT_EQUAL(tc, NKEYS / 2, apr_hamt_count(c2));
+    ABTS_STR_EQUAL(tc, "c1", apr_hamt_get(c2, keys[0], APR_HASH_KEY_STRING));
+    ABTS_PTR_EQUAL(tc, keys[1], apr_hamt_get(c2, keys[1],
+                                             APR_HASH_KEY_STRING));
+}
+
+static void test_collisions(abts_case *tc, void *data)
+{
+    const char **keys = make_keys("collide");
+    apr_hamt_t *h = apr_hamt_make_custom(p, bad_hash), *c;
+    int i, n = 0;
+
+    for (i = 0; i < NKEYS / 4; i++) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    c = apr_hamt_copy(p, h);
+    for (i = 0; i < NKEYS / 4; i += 3) {
+        apr_hamt_set(h, keys[i], APR_HASH_KEY_STRING, NULL);
+    }
+    apr_hamt_set(h, keys[1], APR_HASH_KEY_STRING, "one");
+
+    ABTS_INT_EQUAL(tc, NKEYS / 4, apr_hamt_count(c));
+    check_keys(tc, c, keys, 0, NKEYS / 4, NULL);
+    ABTS_INT_EQUAL(tc, NKEYS / 4 - (NKEYS / 4 + 2) / 3, apr_hamt_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hamt_get(h, keys[3], APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "one", apr_hamt_get(h, keys[1], APR_HASH_KEY_STRING));
+    check_keys(tc, h, keys, 2, 3, NULL);
+    apr_hamt_do(count_do, &n, h);
+    ABTS_INT_EQUAL(tc, apr_hamt_count(h), n);
+}
+
+static void test_overlay(abts_case *tc, void *data)
+{
+    apr_hamt_t *base = apr_hamt_make(p), *over = apr_hamt_make(p), *res;
+
+    apr_hamt_set(base, "a", APR_HASH_KEY_STRING, "base-a");
+    apr_hamt_set(base, "b", APR_HASH_KEY_STRING, "base-b");
+    apr_hamt_set(over, "b", APR_HASH_KEY_STRING, "over-b");
+    apr_hamt_set(over, "c", APR_HASH_KEY_STRING, "over-c");
+
+    res = apr_hamt_overlay(p, over, base);
+    ABTS_INT_EQUAL(tc, 3, apr_hamt_count(res));
+    ABTS_STR_EQUAL(tc, "base-a", apr_hamt_get(res, "a", APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "over-b", apr_hamt_get(res, "b", APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "over-c", apr_hamt_get(res, "c", APR_HASH_KEY_STRING));
+
+    apr_hamt_set(base, "a", APR_HASH_KEY_STRING, NULL);
+    ABTS_INT_EQUAL(tc, 2, apr_hamt_count(over));
+    ABTS_INT_EQUAL(tc, 1, apr_hamt_count(base));
+    ABTS_STR_EQUAL(tc, "base-a", apr_hamt_get(res, "a", APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "base-b", apr_hamt_get(base, "b", APR_HASH_KEY_STRING));
+}
+
+abts_suite *testhamt(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_set_get, NULL);
+    abts_run_test(suite, test_copy, NULL);
+    abts_run_test(suite, test_collisions, NULL);
+    abts_run_test(suite, test_overlay, NULL);
+
+    return suite;
+}
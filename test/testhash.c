@@ -20,6 +20,8 @@
 #include "apr_general.h"
 #include "apr_pools.h"
 #include "apr_hash.h"
+#include "apr_atomic.h"
+#include "apr_thread_pool.h"
 
 #define MAX_LTH 256
 #define MAX_DEPTH 11
@@ -539,6 +541,428 @@ static void overlay_fetch(abts_case *tc, void *data)
                        apr_hash_get(overlay, "overlay5", APR_HASH_KEY_STRING));
 }
 
+#define FLAT_KEYS 5000
+
+static unsigned int hash_collide(const char *key, apr_ssize_t *klen)
+{
+    if (*klen == APR_HASH_KEY_STRING)
+        *klen = strlen(key);
+    return 42;
+}
+
+static void flat_set_get(abts_case *tc, void *data)
+{
+    apr_hash_t *h;
+    int i, n, *keys;
+
+    /* with data, all the keys collide */
+    if (data) {
+        h = apr_hash_make_flat_custom(p, hash_collide);
+        n = 300;
+    }
+    else {
+        h = apr_hash_make_flat(p);
+        n = FLAT_KEYS;
+    }
+    ABTS_PTR_NOTNULL(tc, h);
+
+    keys = apr_palloc(p, sizeof(int) * n);
+    for (i = 0; i < n; i++) {
+        keys[i] = i;
+        apr_hash_set(h, &keys[i], sizeof(int), &keys[i]);
+    }
+    ABTS_INT_EQUAL(tc, n, apr_hash_count(h));
+    for (i = 0; i < n; i++) {
+        ABTS_PTR_EQUAL(tc, &keys[i], apr_hash_get(h, &i, sizeof(int)));
+    }
+
+    /* delete the odd keys, then put them back with get_or_set */
+    for (i = 1; i < n; i += 2) {
+        apr_hash_set(h, &keys[i], sizeof(int), NULL);
+        ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, &i, sizeof(int)));
+    }
+    ABTS_INT_EQUAL(tc, n / 2, apr_hash_count(h));
+    for (i = 0; i < n; i++) {
+        ABTS_PTR_EQUAL(tc, &keys[i],
+                       apr_hash_get_or_set(h, &keys[i], sizeof(int),
+                                           &keys[i]));
+    }
+    ABTS_INT_EQUAL(tc, n, apr_hash_count(h));
+
+    apr_hash_set(h, "key", APR_HASH_KEY_STRING, "value");
+    ABTS_STR_EQUAL(tc, "value", apr_hash_get(h, "key", APR_HASH_KEY_STRING));
+}
+
+static void flat_churn(abts_case *tc, void *data)
+{
+    apr_hash_t *h;
+    int i, keys[64];
+
+    h = apr_hash_make_flat(p);
+
+    /* Leave tombstones behind, the table must not fill up with them */
+    for (i = 0; i < 64 * 1000; i++) {
+        int k = i % 64;
+        keys[k] = i;
+        apr_hash_set(h, &keys[k], sizeof(int), &keys[k]);
+        if (k == 63) {
+            for (k = 0; k < 64; k++) {
+                apr_hash_set(h, &keys[k], sizeof(int), NULL);
+            }
+            ABTS_INT_EQUAL(tc, 0, apr_hash_count(h));
+        }
+    }
+}
+
+static void flat_iterate_delete(abts_case *tc, void *data)
+{
+    apr_hash_t *h;
+    apr_hash_index_t *hi;
+    int i, n = 0, sum = 0, keys[100];
+
+    h = apr_hash_make_flat(p);
+    for (i = 0; i < 100; i++) {
+        keys[i] = i;
+        apr_hash_set(h, &keys[i], sizeof(int), &keys[i]);
+    }
+
+    /* deleting the current entry is allowed */
+    for (hi = apr_hash_first(p, h); hi; hi = apr_hash_next(hi)) {
+        const int *key = apr_hash_this_key(hi);
+        ABTS_PTR_EQUAL(tc, key, apr_hash_this_val(hi));
+        ABTS_INT_EQUAL(tc, sizeof(int), apr_hash_this_key_len(hi));
+        sum += *key;
+        n++;
+        apr_hash_set(h, key, sizeof(int), NULL);
+    }
+    ABTS_INT_EQUAL(tc, 100, n);
+    ABTS_INT_EQUAL(tc, 99 * 100 / 2, sum);
+    ABTS_INT_EQUAL(tc, 0, apr_hash_count(h));
+}
+
+static void *merge_sum(apr_pool_t *pool, const void *key, apr_ssize_t klen,
+                       const void *h1_val, const void *h2_val,
+                       const void *data)
+{
+    return apr_psprintf(pool, "%s+%s", (const char *)h1_val,
+                        (const char *)h2_val);
+}
+
+static void flat_copy_merge(abts_case *tc, void *data)
+{
+    apr_hash_t *base, *overlay, *copy, *res;
+    int count;
+    char StrArray[MAX_DEPTH][MAX_LTH];
+
+    base = apr_hash_make_flat(p);
+    overlay = apr_hash_make(p);
+    apr_hash_set(base, "key1", APR_HASH_KEY_STRING, "base1");
+    apr_hash_set(base, "key2", APR_HASH_KEY_STRING, "base2");
+    apr_hash_set(overlay, "key2", APR_HASH_KEY_STRING, "over2");
+    apr_hash_set(overlay, "key3", APR_HASH_KEY_STRING, "over3");
+
+    copy = apr_hash_copy(p, base);
+    apr_hash_set(copy, "key1", APR_HASH_KEY_STRING, NULL);
+    ABTS_INT_EQUAL(tc, 1, apr_hash_count(copy));
+    ABTS_INT_EQUAL(tc, 2, apr_hash_count(base));
+    ABTS_STR_EQUAL(tc, "base1", apr_hash_get(base, "key1",
+                                             APR_HASH_KEY_STRING));
+
+    res = apr_hash_overlay(p, overlay, base);
+    count = apr_hash_count(res);
+    ABTS_INT_EQUAL(tc, 3, count);
+    dump_hash(p, res, StrArray);
+    ABTS_STR_EQUAL(tc, "Key key1 (4) Value base1\n", StrArray[0]);
+    ABTS_STR_EQUAL(tc, "Key key2 (4) Value over2\n", StrArray[1]);
+    ABTS_STR_EQUAL(tc, "Key key3 (4) Value over3\n", StrArray[2]);
+
+    res = apr_hash_merge(p, base, overlay, merge_sum, NULL);
+    ABTS_INT_EQUAL(tc, 3, apr_hash_count(res));
+    ABTS_STR_EQUAL(tc, "base2+over2", apr_hash_get(res, "key2",
+                                                   APR_HASH_KEY_STRING));
+}
+
+static void incremental_growth(abts_case *tc, void *data)
+{
+    apr_hash_t *h, *copy;
+    apr_hash_index_t *hi;
+    int i, j, n, *keys;
+
+    h = apr_hash_make_ex(p, NULL, APR_HASH_INCREMENTAL);
+    ABTS_PTR_NOTNULL(tc, h);
+
+    keys = apr_palloc(p, sizeof(int) * FLAT_KEYS);
+    for (i = 0; i < FLAT_KEYS; i++) {
+        keys[i] = i;
+        apr_hash_set(h, &keys[i], sizeof(int), &keys[i]);
+        /* all the keys must be found while migrating */
+        if ((i & (i + 1)) == 0 || i % 97 == 0) {
+            for (j = 0; j <= i; j++) {
+                if (apr_hash_get(h, &j, sizeof(int)) != &keys[j]) {
+                    break;
+                }
+            }
+            ABTS_INT_EQUAL(tc, i + 1, j);
+
+            /* and walked, without finishing the migration */
+            for (n = 0, hi = apr_hash_first(p, h); hi; hi = apr_hash_next(hi))
+                n++;
+            ABTS_INT_EQUAL(tc, i + 1, n);
+            copy = apr_hash_overlay(p, h, apr_hash_copy(p, h));
+            ABTS_INT_EQUAL(tc, i + 1, apr_hash_count(copy));
+            for (j = 0; j <= i; j++) {
+                if (apr_hash_get(copy, &j, sizeof(int)) != &keys[j]) {
+                    break;
+                }
+            }
+            ABTS_INT_EQUAL(tc, i + 1, j);
+        }
+    }
+    ABTS_INT_EQUAL(tc, FLAT_KEYS, apr_hash_count(h));
+
+    /* delete the even keys */
+    for (i = 0; i < FLAT_KEYS; i += 2) {
+        apr_hash_set(h, &keys[i], sizeof(int), NULL);
+    }
+    ABTS_INT_EQUAL(tc, FLAT_KEYS / 2, apr_hash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, &keys[0], sizeof(int)));
+    ABTS_PTR_EQUAL(tc, &keys[1], apr_hash_get(h, &keys[1], sizeof(int)));
+
+    copy = apr_hash_copy(p, h);
+    ABTS_INT_EQUAL(tc, FLAT_KEYS / 2, apr_hash_count(copy));
+
+    for (n = 0, hi = apr_hash_first(p, h); hi; hi = apr_hash_next(hi)) {
+        ABTS_INT_EQUAL(tc, 1, *(const int *)apr_hash_this_key(hi) % 2);
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, FLAT_KEYS / 2, n);
+
+    apr_hash_clear(h);
+    ABTS_INT_EQUAL(tc, 0, apr_hash_count(h));
+    ABTS_PTR_EQUAL(tc, &keys[3], apr_hash_get(copy, &keys[3], sizeof(int)));
+}
+
+static void keyed_hash(abts_case *tc, void *data)
+{
+    apr_uint32_t flags = (apr_uint32_t)(apr_uintptr_t)data;
+    apr_hash_t *h, *copy;
+    char *keys[MAX_LTH];
+    int i, j;
+
+    h = apr_hash_make_ex(p, NULL, flags);
+    ABTS_PTR_NOTNULL(tc, h);
+
+    /* all the lengths up to and around the word size */
+    for (i = 0; i < MAX_LTH; i++) {
+        keys[i] = apr_palloc(p, i + 1);
+        for (j = 0; j < i; j++) {
+            keys[i][j] = 'a' + (j % 26);
+        }
+        keys[i][i] = '\0';
+        apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    ABTS_INT_EQUAL(tc, MAX_LTH, apr_hash_count(h));
+
+    copy = apr_hash_copy(p, h);
+    for (i = 0; i < MAX_LTH; i++) {
+        ABTS_PTR_EQUAL(tc, keys[i], apr_hash_get(h, keys[i], i));
+        ABTS_PTR_EQUAL(tc, keys[i], apr_hash_get(copy, keys[i],
+                                                 APR_HASH_KEY_STRING));
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, "zz", APR_HASH_KEY_STRING));
+
+    apr_hash_set(h, keys[10], APR_HASH_KEY_STRING, NULL);
+    ABTS_INT_EQUAL(tc, MAX_LTH - 1, apr_hash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, keys[10], 10));
+    ABTS_PTR_EQUAL(tc, keys[11], apr_hash_get(h, keys[11], 11));
+}
+
+static void iter_init(abts_case *tc, void *data)
+{
+    apr_hash_t *h = data ? apr_hash_make_flat(p) : apr_hash_make(p);
+    apr_hash_iter_t it;
+    apr_hash_index_t *hi;
+    int i, count = 0, sum = 0, keys[100];
+
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_iter_init(&it, h));
+
+    for (i = 0; i < 100; i++) {
+        keys[i] = i;
+        apr_hash_set(h, &keys[i], sizeof(int), &keys[i]);
+    }
+    for (hi = apr_hash_iter_init(&it, h); hi; hi = apr_hash_next(hi)) {
+        sum += *(const int *)apr_hash_this_val(hi);
+        count++;
+    }
+    ABTS_INT_EQUAL(tc, 100, count);
+    ABTS_INT_EQUAL(tc, 99 * 100 / 2, sum);
+}
+
+#if APR_HAS_THREADS
+
+static int sum_values(void *rec, const void *key,
+                      apr_ssize_t klen, const void *value)
+{
+    apr_atomic_add32(rec, *(const apr_uint32_t *)value);
+    return 1;
+}
+
+static int stop_at_zero(void *rec, const void *key,
+                        apr_ssize_t klen, const void *value)
+{
+    apr_atomic_inc32(rec);
+    return *(const apr_uint32_t *)value != 0;
+}
+
+static void do_parallel(abts_case *tc, void *data)
+{
+    apr_hash_t *h = data ? apr_hash_make_flat(p) : apr_hash_make(p);
+    apr_thread_pool_t *tp;
+    apr_uint32_t *vals, sum, calls;
+    int i, n = 10000;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_thread_pool_create(&tp, 0, 4, p));
+
+    vals = apr_palloc(p, n * sizeof(apr_uint32_t));
+    for (i = 0; i < n; i++) {
+        vals[i] = i;
+        apr_hash_set(h, &vals[i], sizeof(apr_uint32_t), &vals[i]);
+    }
+
+    sum = 0;
+    ABTS_INT_EQUAL(tc, 1, apr_hash_do_parallel(sum_values, &sum, h, tp, 0));
+    ABTS_INT_EQUAL(tc, (n - 1) * n / 2, sum);
+
+    /* More parts than buckets, or none but the caller */
+    sum = 0;
+    ABTS_INT_EQUAL(tc, 1, apr_hash_do_parallel(sum_values, &sum, h, tp,
+                                               (unsigned int)n * 100));
+    ABTS_INT_EQUAL(tc, (n - 1) * n / 2, sum);
+    sum = 0;
+    ABTS_INT_EQUAL(tc, 1, apr_hash_do_parallel(sum_values, &sum, h, NULL, 0));
+    ABTS_INT_EQUAL(tc, (n - 1) * n / 2, sum);
+
+    /* Stopped by the value 0 */
+    calls = 0;
+    ABTS_INT_EQUAL(tc, 0, apr_hash_do_parallel(stop_at_zero, &calls, h, tp,
+                                               0));
+    ABTS_TRUE(tc, calls >= 1 && calls <= (apr_uint32_t)n);
+
+    apr_thread_pool_destroy(tp);
+}
+
+#endif /* APR_HAS_THREADS */
+
+#define TYPED_KEYS 5000
+
+static int typed_u64_sum(void *rec, apr_uint64_t key, const void *val)
+{
+    *(apr_uint64_t *)rec += key;
+    return 1;
+}
+
+static void typed_u64(abts_case *tc, void *data)
+{
+    apr_hash_u64_t *h, *c;
+    apr_uint64_t sum = 0, expected = 0;
+    int *vals, i, missing = 0;
+
+    h = apr_hash_make_u64(p);
+    ABTS_PTR_NOTNULL(tc, h);
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_u64_get(h, 0));
+
+    /* key 0 and keys differing in their high bits only */
+    vals = apr_palloc(p, sizeof(int) * TYPED_KEYS);
+    for (i = 0; i < TYPED_KEYS; i++) {
+        vals[i] = i;
+        apr_hash_u64_set(h, (apr_uint64_t)i << 40, &vals[i]);
+    }
+    ABTS_INT_EQUAL(tc, TYPED_KEYS, apr_hash_u64_count(h));
+    for (i = 0; i < TYPED_KEYS; i++) {
+        if (apr_hash_u64_get(h, (apr_uint64_t)i << 40) != &vals[i]) {
+            missing++;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, missing);
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_u64_get(h, 1));
+
+    /* replacing and deleting, the others must still be found */
+    apr_hash_u64_set(h, 0, &vals[1]);
+    ABTS_PTR_EQUAL(tc, &vals[1], apr_hash_u64_get(h, 0));
+    c = apr_hash_u64_copy(p, h);
+    for (i = 0; i < TYPED_KEYS; i += 3) {
+        apr_hash_u64_set(h, (apr_uint64_t)i << 40, NULL);
+    }
+    apr_hash_u64_set(h, 1, NULL);
+    ABTS_INT_EQUAL(tc, TYPED_KEYS - (TYPED_KEYS + 2) / 3,
+                   apr_hash_u64_count(h));
+    for (i = 0; i < TYPED_KEYS; i++) {
+        void *val = apr_hash_u64_get(h, (apr_uint64_t)i << 40);
+
+        if (val != (i % 3 ? &vals[i] : NULL)) {
+            missing++;
+        }
+        else if (i % 3) {
+            expected += (apr_uint64_t)i << 40;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, missing);
+    ABTS_INT_EQUAL(tc, 1, apr_hash_u64_do(typed_u64_sum, &sum, h));
+    ABTS_TRUE(tc, sum == expected);
+
+    /* the copy is not affected */
+    ABTS_INT_EQUAL(tc, TYPED_KEYS, apr_hash_u64_count(c));
+    ABTS_PTR_EQUAL(tc, &vals[3], apr_hash_u64_get(c, (apr_uint64_t)3 << 40));
+
+    apr_hash_u64_clear(h);
+    ABTS_INT_EQUAL(tc, 0, apr_hash_u64_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_u64_get(h, (apr_uint64_t)1 << 40));
+    ABTS_INT_EQUAL(tc, TYPED_KEYS, apr_hash_u64_count(c));
+}
+
+static int typed_ptr_check(void *rec, const void *key, const void *val)
+{
+    (*(int *)rec)++;
+    return key == val;
+}
+
+static void typed_ptr(abts_case *tc, void *data)
+{
+    apr_hash_ptr_t *h;
+    int *keys, *others, i, n = 0, missing = 0;
+
+    h = apr_hash_make_ptr(p);
+    ABTS_PTR_NOTNULL(tc, h);
+
+    keys = apr_palloc(p, sizeof(int) * TYPED_KEYS);
+    others = apr_palloc(p, sizeof(int) * TYPED_KEYS);
+    for (i = 0; i < TYPED_KEYS; i++) {
+        apr_hash_ptr_set(h, &keys[i], &keys[i]);
+    }
+    ABTS_INT_EQUAL(tc, TYPED_KEYS, apr_hash_ptr_count(h));
+
+    /* churn, no slot is left behind by the deletions */
+    for (i = 0; i < TYPED_KEYS * 10; i++) {
+        int k = i % TYPED_KEYS;
+
+        apr_hash_ptr_set(h, &keys[k], NULL);
+        apr_hash_ptr_set(h, &others[(k * 7) % TYPED_KEYS], &keys[k]);
+        apr_hash_ptr_set(h, &keys[k], &keys[k]);
+        apr_hash_ptr_set(h, &others[(k * 7) % TYPED_KEYS], NULL);
+    }
+    ABTS_INT_EQUAL(tc, TYPED_KEYS, apr_hash_ptr_count(h));
+    for (i = 0; i < TYPED_KEYS; i++) {
+        if (apr_hash_ptr_get(h, &keys[i]) != &keys[i]) {
+            missing++;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, missing);
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_ptr_get(h, &n));
+
+    ABTS_INT_EQUAL(tc, 1, apr_hash_ptr_do(typed_ptr_check, &n, h));
+    ABTS_INT_EQUAL(tc, TYPED_KEYS, n);
+}
+
 abts_suite *testhash(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -565,6 +989,25 @@ abts_suite *testhash(abts_suite *suite)
     abts_run_test(suite, overlay_same, NULL);
     abts_run_test(suite, overlay_fetch, NULL);
 
+    abts_run_test(suite, flat_set_get, NULL);
+    abts_run_test(suite, flat_set_get, (void *)1);
+    abts_run_test(suite, flat_churn, NULL);
+    abts_run_test(suite, flat_iterate_delete, NULL);
+    abts_run_test(suite, flat_copy_merge, NULL);
+    abts_run_test(suite, incremental_growth, NULL);
+    abts_run_test(suite, keyed_hash, (void *)APR_HASH_SIPHASH);
+    abts_run_test(suite, keyed_hash, (void *)APR_HASH_FASTHASH);
+    abts_run_test(suite, keyed_hash, (void *)(APR_HASH_FASTHASH |
+                                              APR_HASH_FLAT));
+    abts_run_test(suite, iter_init, NULL);
+    abts_run_test(suite, iter_init, (void *)1);
+    abts_run_test(suite, typed_u64, NULL);
+    abts_run_test(suite, typed_ptr, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, do_parallel, NULL);
+    abts_run_test(suite, do_parallel, (void *)1);
+#endif
+
     return suite;
 }
 
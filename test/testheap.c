@@ -0,0 +1,140 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_heap.h"
+#include "abts.h"
+#include "testutil.h"
+
+#include <stdlib.h>
+
+#define NELTS 1000
+
+static int compare_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_heap_t *heap;
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_heap_create(&heap, 1, 0, compare_int,
+                                                   0, p));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_heap_create(&heap, 17, 0, compare_int,
+                                                   0, p));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_heap_create(&heap, 0, 0, compare_int,
+                                                    0, p));
+    ABTS_SIZE_EQUAL(tc, 0, apr_heap_size(heap));
+    ABTS_PTR_EQUAL(tc, NULL, apr_heap_peek(heap));
+    ABTS_PTR_EQUAL(tc, NULL, apr_heap_pop(heap));
+}
+
+static void test_order(abts_case *tc, void *data)
+{
+    unsigned int arities[] = { 2, 3, 4, 8, 16 };
+    int *values = apr_palloc(p, NELTS * sizeof(int));
+    apr_size_t a;
+    int i;
+
+    srand(42);
+    for (i = 0; i < NELTS; i++) {
+        values[i] = rand() % (NELTS / 2);
+    }
+
+    for (a = 0; a < sizeof(arities) / sizeof(arities[0]); a++) {
+        apr_heap_t *heap;
+        int *v, last = -1;
+
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_heap_create(&heap, arities[a], 4, compare_int,
+                                       APR_HEAP_ALLOCATOR, p));
+        for (i = 0; i < NELTS; i++) {
+            apr_heap_push(heap, &values[i], NULL);
+        }
+        ABTS_SIZE_EQUAL(tc, NELTS, apr_heap_size(heap));
+
+        for (i = 0; (v = apr_heap_pop(heap)) != NULL; i++) {
+            if (*v < last) {
+                break;
+            }
+            last = *v;
+        }
+        ABTS_INT_EQUAL(tc, NELTS, i);
+        ABTS_SIZE_EQUAL(tc, 0, apr_heap_size(heap));
+    }
+}
+
+static void test_handles(abts_case *tc, void *data)
+{
+    apr_heap_t *heap;
+    apr_heap_handle_t *handles[NELTS];
+    int *values = apr_palloc(p, NELTS * sizeof(int));
+    int *v, i, n, last = -1;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_heap_create(&heap, 0, 0, compare_int, 0, p));
+
+    srand(7);
+    for (i = 0; i < NELTS; i++) {
+        values[i] = rand() % NELTS;
+        apr_heap_push(heap, &values[i], &handles[i]);
+    }
+
+    /* Remove every third element, move every other one */
+    for (i = 0; i < NELTS; i += 3) {
+        v = apr_heap_remove(heap, handles[i]);
+        ABTS_PTR_EQUAL(tc, &values[i], v);
+    }
+    for (i = 1; i < NELTS; i += 3) {
+        ABTS_PTR_EQUAL(tc, &values[i], apr_heap_handle_data(heap,
+                                                            handles[i]));
+        values[i] = (i % 2) ? -i : values[i] + NELTS;
+        apr_heap_update(heap, handles[i]);
+    }
+    n = NELTS - (NELTS + 2) / 3;
+    ABTS_SIZE_EQUAL(tc, n, apr_heap_size(heap));
+
+    v = apr_heap_peek(heap);
+    ABTS_INT_EQUAL(tc, -(NELTS - 3), *v);
+    last = *v;
+    for (i = 0; (v = apr_heap_pop(heap)) != NULL; i++) {
+        if (*v < last) {
+            break;
+        }
+        last = *v;
+    }
+    ABTS_INT_EQUAL(tc, n, i);
+
+    /* The handles of the elements gone are reused */
+    apr_heap_push(heap, &values[0], &handles[0]);
+    apr_heap_push(heap, &values[1], &handles[1]);
+    apr_heap_clear(heap);
+    ABTS_SIZE_EQUAL(tc, 0, apr_heap_size(heap));
+    ABTS_PTR_EQUAL(tc, NULL, apr_heap_peek(heap));
+}
+
+abts_suite *testheap(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_order, NULL);
+    abts_run_test(suite, test_handles, NULL);
+
+    return suite;
+}
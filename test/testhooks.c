@@ -32,10 +32,12 @@
   toy_hook_probe_complete(ud, #name, src, rv)
 
 #include "apr_hooks.h"
+#include "apr_optional_hooks.h"
 
 #define TEST_DECLARE(type) type
 
 APR_DECLARE_EXTERNAL_HOOK(test,TEST,int, toyhook, (char *x, apr_size_t s))
+APR_DECLARE_EXTERNAL_HOOK(test,TEST,int, opthook, (char *x, apr_size_t s))
 
 APR_HOOK_STRUCT(
     APR_HOOK_LINK(toyhook)
@@ -50,6 +52,9 @@ static void toy_hook_probe_complete(void *ud, const char *name,
 APR_IMPLEMENT_EXTERNAL_HOOK_RUN_ALL(test,TEST,int, toyhook,
                                     (char *x, apr_size_t s), (x, s), 0, -1)
 
+APR_IMPLEMENT_OPTIONAL_HOOK_RUN_ALL(test,TEST,int, opthook,
+                                    (char *x, apr_size_t s), (x, s), 0, -1)
+
 typedef struct {
     char *buf;
     apr_size_t buf_size;
@@ -183,12 +188,126 @@ static void test_pred_ordering(abts_case *tc, void *data)
     /* FAILS ABTS_STR_EQUAL(tc, "1223", buf); */
 }
 
+static void test_chain_ordering(abts_case *tc, void *data)
+{
+    char buf[6] = {0};
+    static const char *hook2_predecessors[] = {"1", NULL};
+    static const char *hook3_predecessors[] = {"2", NULL};
+    static const char *hook4_predecessors[] = {"3", NULL};
+    static const char *hook4_successors[] = {"5", NULL};
+
+    apr_hook_global_pool = p;
+    apr_hook_deregister_all();
+
+    /* Registered backwards, and ordered against APR_HOOK_* by the
+     * constraints */
+    apr_hook_debug_current = "5";
+    test_hook_toyhook(toyhook_5, NULL, NULL, APR_HOOK_FIRST);
+    apr_hook_debug_current = "4";
+    test_hook_toyhook(toyhook_4, hook4_predecessors, hook4_successors,
+                      APR_HOOK_FIRST);
+    apr_hook_debug_current = "3";
+    test_hook_toyhook(toyhook_3, hook3_predecessors, NULL, APR_HOOK_MIDDLE);
+    apr_hook_debug_current = "2";
+    test_hook_toyhook(toyhook_2, hook2_predecessors, NULL, APR_HOOK_MIDDLE);
+    apr_hook_debug_current = "1";
+    test_hook_toyhook(toyhook_1, NULL, NULL, APR_HOOK_LAST);
+
+    apr_hook_sort_all();
+
+    probe_buf_pool = p;
+    test_run_toyhook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "12345", buf);
+
+    /* Sorting again is a noop */
+    apr_hook_sort_all();
+    buf[0] = '\0';
+    test_run_toyhook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "12345", buf);
+}
+
+static void test_dispatch_table(abts_case *tc, void *data)
+{
+    char buf[6] = {0};
+
+    apr_hook_global_pool = p;
+    apr_hook_deregister_all();
+    ABTS_PTR_EQUAL(tc, NULL, _hooks.run_toyhook);
+
+    apr_hook_debug_current = "3";
+    test_hook_toyhook(toyhook_3, NULL, NULL, APR_HOOK_MIDDLE);
+    apr_hook_debug_current = "1";
+    test_hook_toyhook(toyhook_1, NULL, NULL, APR_HOOK_FIRST);
+    ABTS_PTR_EQUAL(tc, NULL, _hooks.run_toyhook);
+
+    apr_hook_sort_all();
+    ABTS_PTR_NOTNULL(tc, _hooks.run_toyhook);
+    ABTS_PTR_EQUAL(tc, (apr_hook_fn_t *)toyhook_1, _hooks.run_toyhook[0]);
+    ABTS_PTR_EQUAL(tc, (apr_hook_fn_t *)toyhook_3, _hooks.run_toyhook[1]);
+    ABTS_PTR_EQUAL(tc, NULL, _hooks.run_toyhook[2]);
+
+    /* A registration invalidates the table until the next sort */
+    apr_hook_debug_current = "2";
+    test_hook_toyhook(toyhook_2, NULL, NULL, APR_HOOK_LAST);
+    ABTS_PTR_EQUAL(tc, NULL, _hooks.run_toyhook);
+
+    probe_buf_pool = p;
+    test_run_toyhook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "132", buf);
+
+    apr_hook_sort_all();
+    ABTS_PTR_EQUAL(tc, (apr_hook_fn_t *)toyhook_2, _hooks.run_toyhook[2]);
+}
+
+static void test_optional_hook(abts_case *tc, void *data)
+{
+    char buf[6] = {0};
+
+    apr_hook_global_pool = p;
+    apr_hook_deregister_all();
+
+    ABTS_INT_EQUAL(tc, 0, test_run_opthook(buf, sizeof buf));
+    ABTS_STR_EQUAL(tc, "", buf);
+
+    APR_OPTIONAL_HOOK(test, opthook, toyhook_4, NULL, NULL, APR_HOOK_LAST);
+    APR_OPTIONAL_HOOK(test, opthook, toyhook_2, NULL, NULL, APR_HOOK_FIRST);
+
+    /* Unsorted until apr_hook_sort_all() */
+    test_run_opthook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "42", buf);
+    ABTS_PTR_EQUAL(tc, NULL, apr_optional_hook_table_get("opthook"));
+
+    apr_hook_sort_all();
+    ABTS_PTR_NOTNULL(tc, apr_optional_hook_table_get("opthook"));
+    buf[0] = '\0';
+    test_run_opthook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "24", buf);
+
+    APR_OPTIONAL_HOOK(test, opthook, toyhook_3, NULL, NULL, APR_HOOK_MIDDLE);
+    buf[0] = '\0';
+    test_run_opthook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "243", buf);
+
+    apr_hook_sort_all();
+    buf[0] = '\0';
+    test_run_opthook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "234", buf);
+
+    apr_hook_deregister_all();
+    buf[0] = '\0';
+    test_run_opthook(buf, sizeof buf);
+    ABTS_STR_EQUAL(tc, "", buf);
+}
+
 abts_suite *testhooks(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_basic_ordering, NULL);
     abts_run_test(suite, test_pred_ordering, NULL);
+    abts_run_test(suite, test_chain_ordering, NULL);
+    abts_run_test(suite, test_dispatch_table, NULL);
+    abts_run_test(suite, test_optional_hook, NULL);
 
     return suite;
 }
@@ -17,6 +17,7 @@
 #include "testutil.h"
 #include "apr_general.h"
 #include "apr_network_io.h"
+#include "apr_strings.h"
 #include "apr_errno.h"
 
 static void test_bad_input(abts_case *tc, void *data)
@@ -222,6 +223,176 @@ static void test_parse_addr_port(abts_case *tc, void *data)
     }
 }
 
+static apr_sockaddr_t *ipset_addr(abts_case *tc, const char *ipstr,
+                                   apr_int32_t family)
+{
+    apr_sockaddr_t *sa = NULL;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, ipstr, family, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, ipstr, rv);
+    return sa;
+}
+
+static void test_ipset(abts_case *tc, void *data)
+{
+    static const struct {
+        const char *ipstr;
+        const char *mask;
+    } subnets[] = {
+        {"10.0.0.0",            "8"}
+        ,{"10.1.0.0",           "16"}
+        ,{"10.1.2.3",           NULL}
+        ,{"192.168",            NULL}
+        ,{"172.16.0.0",         "255.240.0.0"}
+#if APR_HAVE_IPV6
+        ,{"fe80::",             "10"}
+        ,{"2001:db8::",         "32"}
+        ,{"2001:db8:1::",       "48"}
+#endif
+    };
+    static const struct {
+        const char *ipstr;
+        apr_int32_t family;
+        int subnet; /* index of the longest match, or -1 */
+    } addrs[] = {
+        {"10.9.9.9",            APR_INET,  0}
+        ,{"10.1.9.9",           APR_INET,  1}
+        ,{"10.1.2.3",           APR_INET,  2}
+        ,{"10.1.2.4",           APR_INET,  1}
+        ,{"11.1.2.3",           APR_INET, -1}
+        ,{"192.168.200.1",      APR_INET,  3}
+        ,{"192.169.0.1",        APR_INET, -1}
+        ,{"172.31.255.255",     APR_INET,  4}
+        ,{"172.32.0.0",         APR_INET, -1}
+#if APR_HAVE_IPV6
+        ,{"::ffff:10.1.2.3",    APR_INET6, 2}
+        ,{"::ffff:11.1.2.3",    APR_INET6, -1}
+        ,{"fe80::1",            APR_INET6, 5}
+        ,{"febf::1",            APR_INET6, 5}
+        ,{"fec0::1",            APR_INET6, -1}
+        ,{"2001:db8:2::1",      APR_INET6, 6}
+        ,{"2001:db8:1:2::1",    APR_INET6, 7}
+        ,{"2001:db9::1",        APR_INET6, -1}
+        ,{"::a01:203",          APR_INET6, -1} /* not 10.1.2.3 */
+#endif
+    };
+    apr_ipsubnet_t *ipsub;
+    apr_ipset_t *ipset;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    void *value;
+    int i;
+
+    rv = apr_ipset_create(&ipset, p);
+    APR_ASSERT_SUCCESS(tc, "create ipset", rv);
+
+    /* Added in reverse so that prefixes get inserted above nodes */
+    for (i = sizeof subnets / sizeof subnets[0]; i-- > 0;) {
+        rv = apr_ipsubnet_create(&ipsub, subnets[i].ipstr, subnets[i].mask, p);
+        APR_ASSERT_SUCCESS(tc, subnets[i].ipstr, rv);
+        rv = apr_ipset_add(ipset, ipsub, (void *)&subnets[i]);
+        APR_ASSERT_SUCCESS(tc, subnets[i].ipstr, rv);
+    }
+    ABTS_SIZE_EQUAL(tc, sizeof subnets / sizeof subnets[0],
+                    apr_ipset_count(ipset));
+
+    for (i = 0; i < sizeof addrs / sizeof addrs[0]; i++) {
+        sa = ipset_addr(tc, addrs[i].ipstr, addrs[i].family);
+        if (!sa) {
+            continue;
+        }
+        value = NULL;
+        if (addrs[i].subnet < 0) {
+            ABTS_ASSERT(tc, addrs[i].ipstr, !apr_ipset_test(ipset, sa, &value));
+        }
+        else {
+            ABTS_ASSERT(tc, addrs[i].ipstr, apr_ipset_test(ipset, sa, &value));
+            ABTS_PTR_EQUAL(tc, &subnets[addrs[i].subnet], value);
+        }
+    }
+
+    /* Adding the same subnet again replaces its value */
+    rv = apr_ipsubnet_create(&ipsub, "10.1.0.0", "255.255.0.0", p);
+    APR_ASSERT_SUCCESS(tc, "10.1.0.0", rv);
+    rv = apr_ipset_add(ipset, ipsub, NULL);
+    APR_ASSERT_SUCCESS(tc, "10.1.0.0", rv);
+    ABTS_SIZE_EQUAL(tc, sizeof subnets / sizeof subnets[0],
+                    apr_ipset_count(ipset));
+    sa = ipset_addr(tc, "10.1.9.9", APR_INET);
+    value = &value;
+    ABTS_TRUE(tc, sa && apr_ipset_test(ipset, sa, &value));
+    ABTS_PTR_EQUAL(tc, NULL, value);
+
+    /* A non contiguous mask can't be added */
+    rv = apr_ipsubnet_create(&ipsub, "10.0.0.0", "255.0.255.0", p);
+    APR_ASSERT_SUCCESS(tc, "10.0.0.0", rv);
+    ABTS_INT_EQUAL(tc, APR_EBADMASK, apr_ipset_add(ipset, ipsub, NULL));
+}
+
+/* Cross-check the ip-set against a linear scan of apr_ipsubnet_test() */
+static void test_ipset_random(abts_case *tc, void *data)
+{
+    enum { NSUBNETS = 500, NADDRS = 5000 };
+    apr_ipsubnet_t *subs[NSUBNETS];
+    int bits[NSUBNETS];
+    apr_ipset_t *ipset;
+    apr_sockaddr_t *sa;
+    apr_uint32_t seed = 12345;
+    apr_status_t rv;
+    char ipstr[16], mask[4];
+    void *value;
+    int i, j, longest;
+
+#define IPSET_RAND() (seed = seed * 1103515245 + 12345, seed >> 8)
+
+    rv = apr_ipset_create(&ipset, p);
+    APR_ASSERT_SUCCESS(tc, "create ipset", rv);
+
+    for (i = 0; i < NSUBNETS; i++) {
+        /* Few first octets for overlaps, mostly long prefixes */
+        apr_snprintf(ipstr, sizeof ipstr, "%u.%u.%u.%u",
+                     (unsigned)(IPSET_RAND() % 4 + 1),
+                     (unsigned)(IPSET_RAND() % 256),
+                     (unsigned)(IPSET_RAND() % 256),
+                     (unsigned)(IPSET_RAND() % 256));
+        bits[i] = (int)(IPSET_RAND() % 32) + 1;
+        apr_snprintf(mask, sizeof mask, "%d", bits[i]);
+        rv = apr_ipsubnet_create(&subs[i], ipstr, mask, p);
+        APR_ASSERT_SUCCESS(tc, ipstr, rv);
+        rv = apr_ipset_add(ipset, subs[i], &bits[i]);
+        APR_ASSERT_SUCCESS(tc, ipstr, rv);
+    }
+
+    for (i = 0; i < NADDRS; i++) {
+        apr_snprintf(ipstr, sizeof ipstr, "%u.%u.%u.%u",
+                     (unsigned)(IPSET_RAND() % 5 + 1),
+                     (unsigned)(IPSET_RAND() % 256),
+                     (unsigned)(IPSET_RAND() % 256),
+                     (unsigned)(IPSET_RAND() % 256));
+        sa = ipset_addr(tc, ipstr, APR_INET);
+        if (!sa) {
+            continue;
+        }
+        longest = 0;
+        for (j = 0; j < NSUBNETS; j++) {
+            if (bits[j] > longest && apr_ipsubnet_test(subs[j], sa)) {
+                longest = bits[j];
+            }
+        }
+        value = NULL;
+        if (!longest) {
+            ABTS_ASSERT(tc, ipstr, !apr_ipset_test(ipset, sa, &value));
+        }
+        else {
+            ABTS_ASSERT(tc, ipstr, apr_ipset_test(ipset, sa, &value));
+            ABTS_INT_EQUAL(tc, longest, value ? *(int *)value : 0);
+        }
+    }
+
+#undef IPSET_RAND
+}
+
 abts_suite *testipsub(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -232,6 +403,8 @@ abts_suite *testipsub(abts_suite *suite)
     abts_run_test(suite, test_badmask_str, NULL);
     abts_run_test(suite, test_badip_str, NULL);
     abts_run_test(suite, test_parse_addr_port, NULL);
+    abts_run_test(suite, test_ipset, NULL);
+    abts_run_test(suite, test_ipset_random, NULL);
     return suite;
 }
 
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "apr_jose.h"
+#include "apr_encode.h"
 
 #include "abts.h"
 #include "testutil.h"
@@ -642,6 +643,66 @@ static void test_jose_encode_jws_compact_unsecured(abts_case *tc, void *data)
     ABTS_STR_NEQUAL(tc, expect, buf, len);
 }
 
+static void test_jose_encode_jws_compact_large(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    apr_jose_t *jose;
+    apr_jose_t *jwt;
+    apr_jose_signature_t signature;
+    apr_json_value_t *claims;
+    char *big, *buf, *expect;
+    apr_size_t len;
+    apr_off_t offset;
+    apr_status_t status;
+    int i;
+
+    const char *ph = "{\"alg\":\"none\"}";
+
+    apr_jose_cb_t cb;
+
+    cb.sign = sign_cb;
+    cb.ctx = tc;
+
+    /* claims spanning several buckets, not a multiple of three */
+    big = apr_palloc(p, 3 * APR_BUCKET_BUFF_SIZE + 2);
+    for (i = 0; i < 3 * APR_BUCKET_BUFF_SIZE + 1; i++) {
+        big[i] = 'a' + i % 26;
+    }
+    big[i] = '\0';
+
+    claims = apr_json_object_create(p);
+    apr_json_object_set(claims, "iss", APR_JSON_VALUE_STRING,
+            apr_json_string_create(p, "joe", APR_JSON_VALUE_STRING), p);
+    apr_json_object_set(claims, "big", APR_JSON_VALUE_STRING,
+            apr_json_string_create(p, big, APR_JSON_VALUE_STRING), p);
+
+    signature.header = NULL;
+    apr_json_decode(&signature.protected_header, ph, APR_JSON_VALUE_STRING, &offset,
+            APR_JSON_FLAGS_WHITESPACE, 10, p);
+
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+
+    apr_json_encode(bb, NULL, NULL, claims, APR_JSON_FLAGS_WHITESPACE, p);
+    apr_brigade_pflatten(bb, &buf, &len, p);
+    expect = apr_pstrcat(p, "eyJhbGciOiJub25lIn0.",
+            apr_pencode_base64(p, buf, len, APR_ENCODE_BASE64URL, NULL), ".",
+            NULL);
+    apr_brigade_cleanup(bb);
+
+    jwt = apr_jose_jwt_make(NULL, claims, p);
+    jose = apr_jose_jws_make(NULL, &signature, NULL, jwt, p);
+
+    status = apr_jose_encode(bb, NULL, NULL, jose, &cb, p);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+
+    apr_brigade_pflatten(bb, &buf, &len, p);
+    ABTS_SIZE_EQUAL(tc, strlen(expect), len);
+    ABTS_STR_NEQUAL(tc, expect, buf, len);
+}
+
 /**
  * Test from https://tools.ietf.org/html/rfc7515#appendix-A.1
  */
@@ -1396,6 +1457,173 @@ static void test_jose_decode_jwe_json_flattened(abts_case *tc, void *data)
 
 }
 
+typedef struct {
+    abts_case *tc;
+    int calls;
+} count_ctx_t;
+
+static apr_status_t count_verify_cb(apr_bucket_brigade *bb,
+        apr_jose_t *jose, apr_jose_signature_t *signature, void *ctx,
+        int *vflags, apr_pool_t *pool)
+{
+    count_ctx_t *count = ctx;
+
+    count->calls++;
+
+    return verify_cb(bb, jose, signature, count->tc, vflags, pool);
+}
+
+static apr_status_t decode_cached(apr_jose_t **jose, const char *source,
+        apr_jose_cb_t *cb, apr_jose_cache_t *cache)
+{
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+
+    apr_brigade_write(bb, NULL, NULL, source, strlen(source));
+
+    *jose = NULL;
+    return apr_jose_decode_cached(jose, "JWT", bb, cb, cache, 10,
+            APR_JOSE_FLAG_NONE, p);
+}
+
+static const char *unsecured_jwt(const char *claims)
+{
+    return apr_pstrcat(p,
+            apr_pencode_base64(p, "{\"alg\":\"none\",\"typ\":\"JWT\"}",
+                    APR_ENCODE_STRING, APR_ENCODE_BASE64URL, NULL),
+            ".",
+            apr_pencode_base64(p, claims, APR_ENCODE_STRING,
+                    APR_ENCODE_BASE64URL, NULL),
+            ".", NULL);
+}
+
+static void test_jose_decode_cached(abts_case *tc, void *data)
+{
+    apr_jose_cache_t *cache;
+    apr_jose_t *jose;
+    apr_json_kv_t *kv;
+    apr_status_t status;
+    count_ctx_t count;
+    apr_jose_cb_t cb;
+
+    const char *valid = unsecured_jwt("{\"iss\":\"joe\",\"exp\":4102444800}");
+    const char *other = unsecured_jwt("{\"iss\":\"ann\",\"exp\":4102444800}");
+    const char *noexp = unsecured_jwt("{\"iss\":\"bob\"}");
+    const char *expired = unsecured_jwt("{\"iss\":\"joe\",\"exp\":1300819380}");
+
+    count.tc = tc;
+    count.calls = 0;
+
+    cb.verify = count_verify_cb;
+    cb.decrypt = decrypt_cb;
+    cb.ctx = &count;
+
+    status = apr_jose_cache_create(&cache, 16, apr_time_from_sec(60), p);
+    if (status == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "No random source for the cache key");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+
+    /* first decode verifies, second is remembered */
+    status = decode_cached(&jose, valid, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 1, count.calls);
+    status = decode_cached(&jose, valid, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 1, count.calls);
+    ABTS_INT_EQUAL(tc, APR_JOSE_TYPE_JWT, jose->type);
+    kv = apr_json_object_get(jose->jose.jwt->claims, "iss",
+            APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, kv);
+    ABTS_INT_EQUAL(tc, APR_JSON_STRING, kv->v->type);
+    ABTS_INT_EQUAL(tc, 3, (int)kv->v->value.string.len);
+    ABTS_ASSERT(tc, "claims", !strncmp(kv->v->value.string.p, "joe", 3));
+
+    /* a different token is verified */
+    status = decode_cached(&jose, other, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 2, count.calls);
+
+    /* no expiry, remembered for the ttl */
+    status = decode_cached(&jose, noexp, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    status = decode_cached(&jose, noexp, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 3, count.calls);
+
+    /* expired, never remembered */
+    status = decode_cached(&jose, expired, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    status = decode_cached(&jose, expired, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 5, count.calls);
+
+    /* forgotten */
+    apr_jose_cache_clear(cache);
+    status = decode_cached(&jose, valid, &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 6, count.calls);
+
+    /* no cache */
+    status = decode_cached(&jose, valid, &cb, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, 7, count.calls);
+
+    /* rejected tokens are not remembered */
+    status = decode_cached(&jose, "eyJhbGciOiJYWVoifQ.e30.", &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_ENOTIMPL, status);
+    status = decode_cached(&jose, "eyJhbGciOiJYWVoifQ.e30.", &cb, cache);
+    ABTS_INT_EQUAL(tc, APR_ENOTIMPL, status);
+    ABTS_INT_EQUAL(tc, 9, count.calls);
+}
+
+static void test_jose_jwks_get(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    apr_jose_t *jose;
+    apr_json_value_t *key;
+    apr_json_kv_t *kv;
+    apr_status_t status;
+
+    const char *source = "["
+            "{\"kty\":\"oct\",\"kid\":\"one\",\"k\":\"AQ\"},"
+            "{\"kty\":\"oct\",\"k\":\"Ag\"},"
+            "{\"kty\":\"oct\",\"kid\":\"two\",\"k\":\"Aw\"},"
+            "{\"kty\":\"oct\",\"kid\":\"one\",\"k\":\"BA\"}"
+            "]";
+
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+
+    apr_brigade_write(bb, NULL, NULL, source, strlen(source));
+
+    status = apr_jose_decode(&jose, "JWK-SET+JSON", bb, NULL, 10,
+            APR_JOSE_FLAG_NONE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, APR_JOSE_TYPE_JWKS, jose->type);
+
+    key = apr_jose_jwks_get(jose, "two", APR_HASH_KEY_STRING);
+    ABTS_PTR_NOTNULL(tc, key);
+    kv = apr_json_object_get(key, "k", APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, kv);
+    ABTS_ASSERT(tc, "key two", !strncmp(kv->v->value.string.p, "Aw", 2));
+
+    /* the first of duplicates wins */
+    key = apr_jose_jwks_get(jose, "one", 3);
+    ABTS_PTR_NOTNULL(tc, key);
+    kv = apr_json_object_get(key, "k", APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, kv);
+    ABTS_ASSERT(tc, "key one", !strncmp(kv->v->value.string.p, "AQ", 2));
+
+    ABTS_PTR_EQUAL(tc, NULL, apr_jose_jwks_get(jose, "three",
+            APR_HASH_KEY_STRING));
+}
+
 abts_suite *testjose(abts_suite *suite)
 {
         suite = ADD_SUITE(suite);
@@ -1410,11 +1638,15 @@ abts_suite *testjose(abts_suite *suite)
 
         abts_run_test(suite, test_jose_encode_jws_compact_unsecured, NULL);
         abts_run_test(suite, test_jose_encode_jws_compact_hs256, NULL);
+        abts_run_test(suite, test_jose_encode_jws_compact_large, NULL);
         abts_run_test(suite, test_jose_encode_jws_json_general, NULL);
         abts_run_test(suite, test_jose_encode_jws_json_flattened, NULL);
         abts_run_test(suite, test_jose_encode_jwe_compact_rsaes_oaep_aes_gcm, NULL);
         abts_run_test(suite, test_jose_encode_jwe_json_general, NULL);
         abts_run_test(suite, test_jose_encode_jwe_json_flattened, NULL);
 
+        abts_run_test(suite, test_jose_decode_cached, NULL);
+        abts_run_test(suite, test_jose_jwks_get, NULL);
+
         return suite;
 }
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "apr_json.h"
+#include "apr_strings.h"
 
 #include "abts.h"
 #include "testutil.h"
@@ -149,6 +150,682 @@ static void test_json_string(abts_case * tc, void *data)
             (memcmp(expected, json->value.string.p, json->value.string.len) == 0));
 }
 
+static void test_json_long_string(abts_case * tc, void *data)
+{
+    apr_json_value_t *json = NULL;
+    apr_status_t status;
+    char src[128], expected[128];
+    int i, n;
+
+    /* Escapes, UTF-8 and the ends at every offset of the scanned blocks */
+    for (i = 0; i < 40; i++) {
+        n = apr_snprintf(src, sizeof(src),
+                         "%*s\"%.*s\\n\xc3\xa9%.*s\\\"x\"%*s",
+                         i % 5, "", i, "abcdefghijklmnopqrstuvwxyz0123456789ABCD",
+                         40 - i, "abcdefghijklmnopqrstuvwxyz0123456789ABCD",
+                         i, "");
+        apr_snprintf(expected, sizeof(expected), "%.*s\n\xc3\xa9%.*s\"x",
+                     i, "abcdefghijklmnopqrstuvwxyz0123456789ABCD",
+                     40 - i, "abcdefghijklmnopqrstuvwxyz0123456789ABCD");
+
+        status = apr_json_decode(&json, src, n, NULL,
+                APR_JSON_FLAGS_WHITESPACE, 10, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+        if (status != APR_SUCCESS) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_JSON_STRING, json->type);
+        ABTS_STR_EQUAL(tc, expected, json->value.string.p);
+        ABTS_SIZE_EQUAL(tc, strlen(expected), json->value.string.len);
+        ABTS_INT_EQUAL(tc, i % 5, json->pre ? strlen(json->pre) : 0);
+        ABTS_INT_EQUAL(tc, i, json->post ? strlen(json->post) : 0);
+    }
+
+    /* Invalid UTF-8 past the first blocks */
+    status = apr_json_decode(&json,
+            "\"0123456789abcdef0123456789abcdef\xc3\x28\"",
+            APR_JSON_VALUE_STRING, NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+
+    /* Unterminated */
+    status = apr_json_decode(&json, "\"0123456789abcdef0123456789abcdef",
+            APR_JSON_VALUE_STRING, NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_EOF, status);
+}
+
+static void test_json_number(abts_case * tc, void *data)
+{
+    apr_json_value_t *json = NULL;
+    apr_status_t status;
+
+    status = apr_json_decode(&json, "[1234567890123456, -12, 0.5, "
+            "3.25e2, 1E-3, 7.]", APR_JSON_VALUE_STRING, NULL,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    if (status != APR_SUCCESS) {
+        return;
+    }
+    ABTS_INT_EQUAL(tc, 6, json->value.array->array->nelts);
+
+    json = APR_ARRAY_IDX(json->value.array->array, 0, apr_json_value_t *);
+    ABTS_INT_EQUAL(tc, APR_JSON_LONG, json->type);
+    ABTS_LLONG_EQUAL(tc, APR_INT64_C(1234567890123456), json->value.lnumber);
+
+    status = apr_json_decode(&json, "-12", APR_JSON_VALUE_STRING, NULL,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, APR_JSON_LONG, json->type);
+    ABTS_LLONG_EQUAL(tc, -12, json->value.lnumber);
+
+    status = apr_json_decode(&json, "3.25e2", APR_JSON_VALUE_STRING, NULL,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, APR_JSON_DOUBLE, json->type);
+    ABTS_ASSERT(tc, "3.25e2", json->value.dnumber == 325.0);
+
+    status = apr_json_decode(&json, "-123456789012345678",
+            APR_JSON_VALUE_STRING, NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_LLONG_EQUAL(tc, APR_INT64_C(-123456789012345678),
+            json->value.lnumber);
+
+    status = apr_json_decode(&json, "-9223372036854775808",
+            APR_JSON_VALUE_STRING, NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_LLONG_EQUAL(tc, APR_INT64_MIN, json->value.lnumber);
+
+    status = apr_json_decode(&json, "1e", APR_JSON_VALUE_STRING, NULL,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_EOF, status);
+
+    status = apr_json_decode(&json, "1ex", APR_JSON_VALUE_STRING, NULL,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+}
+
+typedef struct decoder_events_t {
+    apr_pool_t *pool;
+    const char *log;
+} decoder_events_t;
+
+static apr_status_t decoder_start(void *ctx, const apr_json_string_t *key,
+        apr_json_type_e type)
+{
+    decoder_events_t *ev = ctx;
+
+    ev->log = apr_psprintf(ev->pool, "%s%.*s%s%c", ev->log,
+            key ? (int)key->len : 0, key ? key->p : "", key ? ":" : "",
+            type == APR_JSON_OBJECT ? '{' : '[');
+    return APR_SUCCESS;
+}
+
+static apr_status_t decoder_end(void *ctx, apr_json_type_e type)
+{
+    decoder_events_t *ev = ctx;
+
+    ev->log = apr_psprintf(ev->pool, "%s%c", ev->log,
+            type == APR_JSON_OBJECT ? '}' : ']');
+    return APR_SUCCESS;
+}
+
+static apr_status_t decoder_value(void *ctx, const apr_json_string_t *key,
+        apr_json_value_t *val)
+{
+    decoder_events_t *ev = ctx;
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(ev->pool);
+    apr_bucket_brigade *bb = apr_brigade_create(ev->pool, ba);
+    char buf[256];
+    apr_size_t len = sizeof(buf) - 1;
+
+    apr_json_encode(bb, NULL, NULL, val, APR_JSON_FLAGS_NONE, ev->pool);
+    apr_brigade_flatten(bb, buf, &len);
+    buf[len] = '\0';
+
+    ev->log = apr_psprintf(ev->pool, "%s%.*s%s%s,", ev->log,
+            key ? (int)key->len : 0, key ? key->p : "", key ? ":" : "", buf);
+    return APR_SUCCESS;
+}
+
+static const apr_json_decoder_cb_t decoder_cb = {
+    decoder_start, decoder_end, decoder_value
+};
+
+/* Feed src in chunks of the given size */
+static apr_status_t decoder_run(const char *src, apr_size_t chunk,
+        int depth, decoder_events_t *ev, apr_json_value_t **result)
+{
+    apr_json_decoder_t *dec;
+    apr_size_t len = strlen(src), n;
+    apr_status_t status;
+
+    ev->pool = p;
+    ev->log = "";
+    status = apr_json_decoder_create(&dec, &decoder_cb, ev, depth, 10, p);
+    while (status == APR_SUCCESS && len) {
+        n = len < chunk ? len : chunk;
+        status = apr_json_decoder_feed(dec, src, n);
+        src += n;
+        len -= n;
+    }
+    if (status == APR_SUCCESS) {
+        status = apr_json_decoder_finish(dec, result);
+    }
+    return status;
+}
+
+static void test_json_decoder(abts_case * tc, void *data)
+{
+    const char *src = "{ \"a\" : [1, -2.5e1, \"x\\\"y\", true],"
+            " \"b\": {\"c\": null, \"d\": {}}, \"e\": [] , \"f\":false }";
+    decoder_events_t ev;
+    apr_json_value_t *json, *expected;
+    apr_status_t status;
+    apr_size_t chunk;
+
+    status = apr_json_decode(&expected, src, APR_JSON_VALUE_STRING, NULL,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+
+    /* Whatever the chunks, the same events and values */
+    for (chunk = 1; chunk <= strlen(src); chunk++) {
+        status = decoder_run(src, chunk, APR_JSON_DECODER_NODOM, &ev, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+        ABTS_STR_EQUAL(tc, "{a:[1,-25.0,\"x\\\"y\",true,]"
+                "b:{c:null,d:{}}e:[]f:false,}", ev.log);
+
+        status = decoder_run(src, chunk, 1, &ev, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+        ABTS_STR_EQUAL(tc, "{a:[1,-25.0,\"x\\\"y\",true],"
+                "b:{\"c\":null,\"d\":{}},e:[],f:false,}", ev.log);
+
+        json = NULL;
+        status = decoder_run(src, chunk, 0, &ev, &json);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+        ABTS_PTR_NOTNULL(tc, json);
+        ABTS_STR_EQUAL(tc, "{\"a\":[1,-25.0,\"x\\\"y\",true],"
+                "\"b\":{\"c\":null,\"d\":{}},\"e\":[],\"f\":false},", ev.log);
+    }
+
+    /* A top level scalar ends with the text */
+    status = decoder_run("  12 ", 2, 0, &ev, &json);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_LLONG_EQUAL(tc, 12, json->value.lnumber);
+    status = decoder_run("12", 1, 0, &ev, &json);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_LLONG_EQUAL(tc, 12, json->value.lnumber);
+
+    /* A trailing comma right before the end, as apr_json_decode() */
+    for (chunk = 1; chunk <= 12; chunk++) {
+        json = NULL;
+        status = decoder_run("{\"a\":[1,],}", chunk, 0, &ev, &json);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+        ABTS_PTR_NOTNULL(tc, json);
+        ABTS_STR_EQUAL(tc, "{\"a\":[1]},", ev.log);
+        status = decoder_run("[1, ]", chunk, 0, &ev, NULL);
+        ABTS_INT_EQUAL(tc, APR_BADCH, status);
+        status = decoder_run("{\"a\":1,\n}", chunk, 0, &ev, NULL);
+        ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    }
+
+    /* Errors */
+    status = decoder_run("[,]", 1, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = decoder_run("[1,,]", 1, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = decoder_run("{\"a\":1,]", 1, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = decoder_run("{\"a\" 1}", 3, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = decoder_run("[tru]", 2, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = decoder_run("[1] 2", 2, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = decoder_run("[[[[[[[[[[[1]]]]]]]]]]]", 4, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, status);
+    status = decoder_run("{\"a\": [1, 2", 4, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_EOF, status);
+    status = decoder_run("\"abc", 2, 0, &ev, NULL);
+    ABTS_INT_EQUAL(tc, APR_EOF, status);
+}
+
+static void test_json_decoder_brigade(abts_case * tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_json_decoder_t *dec;
+    apr_json_value_t *json = NULL;
+    apr_status_t status;
+
+    apr_brigade_puts(bb, NULL, NULL, "[\"long");
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+    APR_BRIGADE_INSERT_TAIL(bb,
+            apr_bucket_immortal_create(" string\", 4", 11, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("2]", 2, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(ba));
+
+    status = apr_json_decoder_create(&dec, NULL, NULL, 0, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    status = apr_json_decoder_feed_brigade(dec, bb);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_TRUE(tc, APR_BUCKET_IS_EOS(APR_BRIGADE_FIRST(bb)));
+    ABTS_INT_EQUAL(tc, 19, (int)apr_json_decoder_offset(dec));
+
+    status = apr_json_decoder_finish(dec, &json);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_PTR_NOTNULL(tc, json);
+    ABTS_INT_EQUAL(tc, APR_JSON_ARRAY, json->type);
+    ABTS_STR_EQUAL(tc, "long string",
+            apr_json_array_get(json, 0)->value.string.p);
+    ABTS_LLONG_EQUAL(tc, 42, apr_json_array_get(json, 1)->value.lnumber);
+}
+
+static void test_json_lazy(abts_case * tc, void *data)
+{
+    const char *src = "{\"name\":\"plain\",\"esc\":\"a\\nb\","
+            "\"dup\":1,\"dup\":2,\"list\":[\"x\",{\"y\":true}]}";
+    const char *dst = "{\"name\":\"plain\",\"esc\":\"a\\nb\","
+            "\"dup\":2,\"list\":[\"x\",{\"y\":true}]}";
+    apr_json_value_t *json = NULL;
+    apr_json_kv_t *kv;
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    char buf[1024];
+    apr_size_t len = sizeof(buf);
+    apr_off_t offset = 0;
+    apr_status_t status;
+
+    status = apr_json_decode(&json, src, APR_JSON_VALUE_STRING, &offset,
+            APR_JSON_FLAGS_LAZY, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, APR_JSON_OBJECT, json->type);
+    ABTS_PTR_EQUAL(tc, NULL, json->value.object->hash);
+
+    /* plain strings point into the source */
+    kv = apr_json_object_get(json, "name", APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, kv);
+    ABTS_PTR_NOTNULL(tc, json->value.object->hash);
+    ABTS_TRUE(tc, kv->v->value.string.p > src
+            && kv->v->value.string.p < src + strlen(src));
+    ABTS_INT_EQUAL(tc, 5, (int)kv->v->value.string.len);
+    ABTS_STR_NEQUAL(tc, "plain", kv->v->value.string.p, 5);
+    ABTS_TRUE(tc, kv->k->value.string.p > src
+            && kv->k->value.string.p < src + strlen(src));
+
+    /* escaped ones are still unescaped */
+    kv = apr_json_object_get(json, "esc", APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, kv);
+    ABTS_INT_EQUAL(tc, 3, (int)kv->v->value.string.len);
+    ABTS_STR_EQUAL(tc, "a\nb", kv->v->value.string.p);
+
+    /* the last duplicate wins, as when not lazy */
+    kv = apr_json_object_get(json, "dup", APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, kv);
+    ABTS_LLONG_EQUAL(tc, 2, kv->v->value.lnumber);
+
+    kv = apr_json_object_get(json, "missing", APR_JSON_VALUE_STRING);
+    ABTS_PTR_EQUAL(tc, NULL, kv);
+
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+    status = apr_json_encode(bb, NULL, NULL, json, APR_JSON_FLAGS_NONE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    apr_brigade_flatten(bb, buf, &len);
+    ABTS_SIZE_EQUAL(tc, strlen(dst), len);
+    ABTS_STR_NEQUAL(tc, dst, buf, len);
+}
+
+static void test_json_lazy_duplicate(abts_case * tc, void *data)
+{
+    const char *src = "{\"a\":1,\"b\":2,\"a\":3}";
+    const char *dst = "{\"a\":3,\"b\":2}";
+    apr_json_value_t *json = NULL;
+    apr_json_kv_t *kv;
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    char buf[64];
+    apr_size_t len = sizeof(buf);
+    apr_off_t offset = 0;
+    apr_status_t status;
+    int count = 0;
+
+    /* walked first, the duplicate is gone as when not lazy */
+    status = apr_json_decode(&json, src, APR_JSON_VALUE_STRING, &offset,
+            APR_JSON_FLAGS_LAZY, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    for (kv = apr_json_object_first(json); kv;
+            kv = apr_json_object_next(json, kv)) {
+        count++;
+    }
+    ABTS_INT_EQUAL(tc, 2, count);
+
+    /* encoded first, likewise */
+    offset = 0;
+    status = apr_json_decode(&json, src, APR_JSON_VALUE_STRING, &offset,
+            APR_JSON_FLAGS_LAZY, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+    status = apr_json_encode(bb, NULL, NULL, json, APR_JSON_FLAGS_NONE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    apr_brigade_flatten(bb, buf, &len);
+    ABTS_SIZE_EQUAL(tc, strlen(dst), len);
+    ABTS_STR_NEQUAL(tc, dst, buf, len);
+}
+
+static apr_status_t json_count_flush(apr_bucket_brigade *bb, void *ctx)
+{
+    apr_off_t len = 0;
+
+    apr_brigade_length(bb, 1, &len);
+    *(apr_off_t *)ctx += len;
+
+    return apr_brigade_cleanup(bb);
+}
+
+static void test_json_encode(abts_case * tc, void *data)
+{
+    static const struct {
+        double d;
+        const char *json;
+    } doubles[] = {
+        { 0.0, "0.0" }, { -0.0, "-0.0" }, { 1.5, "1.5" }, { -2.0, "-2.0" },
+        { 800.0, "800.0" }, { 0.1, "0.1" }, { 1e21, "1e21" },
+        { 3.14159265358979, "3.14159265358979" }, { -1e-7, "-1e-7" },
+        { 1.7976931348623157e308, "1.7976931348623157e308" }
+    };
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    apr_json_value_t *json, *array;
+    apr_off_t flushed = 0;
+    apr_size_t len, i;
+    char *buf, *big;
+
+    ba = apr_bucket_alloc_create(p);
+    bb = apr_brigade_create(p, ba);
+
+    /* escapes, valid and invalid UTF-8 */
+    json = apr_json_string_create(p, "q\"b\\n\n\x01\x1f\xc3\xa9\xe2\x82\xac"
+            "\xf0\x9f\x98\x80\xff\xc3", APR_JSON_VALUE_STRING);
+    apr_json_encode(bb, NULL, NULL, json, APR_JSON_FLAGS_NONE, p);
+    apr_brigade_pflatten(bb, &buf, &len, p);
+    ABTS_STR_NEQUAL(tc, "\"q\\\"b\\\\n\\n\\u0001\\u001f\xc3\xa9\xe2\x82\xac"
+            "\xf0\x9f\x98\x80\xef\xbf\xbd\xef\xbf\xbd\"", buf, len);
+    apr_brigade_cleanup(bb);
+
+    /* numbers */
+    array = apr_json_array_create(p, 4);
+    apr_json_array_add(array, apr_json_long_create(p, 0));
+    apr_json_array_add(array, apr_json_long_create(p, -42));
+    apr_json_array_add(array, apr_json_long_create(p, APR_INT64_MAX));
+    apr_json_array_add(array, apr_json_long_create(p, APR_INT64_MIN));
+    apr_json_encode(bb, NULL, NULL, array, APR_JSON_FLAGS_NONE, p);
+    apr_brigade_pflatten(bb, &buf, &len, p);
+    ABTS_STR_NEQUAL(tc, "[0,-42,9223372036854775807,-9223372036854775808]",
+            buf, len);
+    apr_brigade_cleanup(bb);
+
+    for (i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+        const char *expected = doubles[i].json;
+
+        json = apr_json_double_create(p, doubles[i].d);
+        apr_json_encode(bb, NULL, NULL, json, APR_JSON_FLAGS_NONE, p);
+        apr_brigade_pflatten(bb, &buf, &len, p);
+        ABTS_SIZE_EQUAL(tc, strlen(expected), len);
+        ABTS_STR_NEQUAL(tc, expected, buf, len);
+        apr_brigade_cleanup(bb);
+    }
+
+    /* spanning many buckets, flushed on the way */
+    big = apr_palloc(p, 100000);
+    for (i = 0; i < 100000; i++) {
+        big[i] = 'a' + i % 26;
+    }
+    array = apr_json_array_create(p, 100);
+    for (i = 0; i < 100; i++) {
+        apr_json_array_add(array, apr_json_string_create(p, big,
+                i * 1000));
+    }
+    apr_json_encode(bb, json_count_flush, &flushed, array,
+            APR_JSON_FLAGS_NONE, p);
+    ABTS_TRUE(tc, flushed > 0);
+    json_count_flush(bb, &flushed);
+    /* the strings, their quotes, the commas and the brackets */
+    ABTS_LLONG_EQUAL(tc, 4950000 + 200 + 99 + 2, flushed);
+
+    apr_json_encode(bb, NULL, NULL, apr_json_string_create(p, big, 100000),
+            APR_JSON_FLAGS_NONE, p);
+    apr_brigade_pflatten(bb, &buf, &len, p);
+    ABTS_SIZE_EQUAL(tc, 100002, len);
+    ABTS_STR_NEQUAL(tc, big, buf + 1, 100000);
+    apr_brigade_cleanup(bb);
+}
+
+static const char *path_src =
+    "{\"user\":{\"id\":42,\"name\":\"jo\",\"a/b\":1,\"m~n\":2},"
+    "\"items\":[{\"price\":10,\"tags\":[\"x\"]},{\"sku\":\"s\"},"
+    "{\"price\":2.5,\"skip\":{\"deep\":[1,{\"x\":\"\\u00e9\"}]}}],"
+    "\"count\":3}";
+
+static void test_json_path(abts_case * tc, void *data)
+{
+    apr_json_value_t *json, *val;
+    apr_json_path_t *path;
+    apr_array_header_t *matches;
+    apr_off_t offset;
+    apr_status_t status;
+
+    status = apr_json_decode(&json, path_src, APR_JSON_VALUE_STRING, &offset,
+            APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_json_path_compile(&path, "user", p));
+    ABTS_INT_EQUAL(tc, APR_BADCH, apr_json_path_compile(&path, "/a~2", p));
+    ABTS_INT_EQUAL(tc, APR_BADCH, apr_json_path_compile(&path, "/a~", p));
+
+    apr_json_path_compile(&path, "/user/id", p);
+    val = apr_json_path_get(path, json);
+    ABTS_PTR_NOTNULL(tc, val);
+    ABTS_LLONG_EQUAL(tc, 42, val->value.lnumber);
+
+    apr_json_path_compile(&path, "/user/a~1b", p);
+    val = apr_json_path_get(path, json);
+    ABTS_PTR_NOTNULL(tc, val);
+    ABTS_LLONG_EQUAL(tc, 1, val->value.lnumber);
+
+    apr_json_path_compile(&path, "/user/m~0n", p);
+    val = apr_json_path_get(path, json);
+    ABTS_PTR_NOTNULL(tc, val);
+    ABTS_LLONG_EQUAL(tc, 2, val->value.lnumber);
+
+    apr_json_path_compile(&path, "/items/1/sku", p);
+    val = apr_json_path_get(path, json);
+    ABTS_PTR_NOTNULL(tc, val);
+    ABTS_STR_EQUAL(tc, "s", val->value.string.p);
+
+    apr_json_path_compile(&path, "/items/3", p);
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_path_get(path, json));
+    apr_json_path_compile(&path, "/items/01", p);
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_path_get(path, json));
+    apr_json_path_compile(&path, "/user/id/x", p);
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_path_get(path, json));
+
+    apr_json_path_compile(&path, "", p);
+    ABTS_PTR_EQUAL(tc, json, apr_json_path_get(path, json));
+
+    apr_json_path_compile(&path, "/items/*/price", p);
+    matches = apr_array_make(p, 4, sizeof(apr_json_value_t *));
+    ABTS_INT_EQUAL(tc, 2, apr_json_path_eval(path, json, matches));
+    val = APR_ARRAY_IDX(matches, 0, apr_json_value_t *);
+    ABTS_LLONG_EQUAL(tc, 10, val->value.lnumber);
+    val = APR_ARRAY_IDX(matches, 1, apr_json_value_t *);
+    ABTS_INT_EQUAL(tc, APR_JSON_DOUBLE, val->type);
+    val = apr_json_path_get(path, json);
+    ABTS_LLONG_EQUAL(tc, 10, val->value.lnumber);
+
+    apr_json_path_compile(&path, "/*/id", p);
+    ABTS_INT_EQUAL(tc, 1, apr_json_path_eval(path, json, matches));
+}
+
+typedef struct path_match_t {
+    apr_pool_t *pool;
+    apr_array_header_t *found;
+} path_match_t;
+
+static apr_status_t path_match_cb(void *ctx, int index, apr_json_value_t *val)
+{
+    path_match_t *m = ctx;
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(m->pool);
+    apr_bucket_brigade *bb = apr_brigade_create(m->pool, ba);
+    char *buf;
+    apr_size_t len;
+
+    apr_json_encode(bb, NULL, NULL, val, APR_JSON_FLAGS_NONE, m->pool);
+    apr_brigade_pflatten(bb, &buf, &len, m->pool);
+    APR_ARRAY_PUSH(m->found, char *) = apr_psprintf(m->pool, "%d:%.*s",
+            index, (int)len, buf);
+
+    return APR_SUCCESS;
+}
+
+static void test_json_path_decoder(abts_case * tc, void *data)
+{
+    const char *exprs[] = { "/items/*/price", "/user", "/count", "/nope/x" };
+    apr_json_path_t *paths[4];
+    apr_json_decoder_t *dec;
+    path_match_t m;
+    apr_status_t status;
+    apr_size_t i, len = strlen(path_src);
+
+    for (i = 0; i < 4; i++) {
+        apr_json_path_compile(&paths[i], exprs[i], p);
+    }
+    m.pool = p;
+    m.found = apr_array_make(p, 4, sizeof(char *));
+
+    status = apr_json_path_decoder_create(&dec, paths, 4, path_match_cb, &m,
+            10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    /* three bytes at a time, for the tokens to span the chunks */
+    for (i = 0; i < len && status == APR_SUCCESS; i += 3) {
+        status = apr_json_decoder_feed(dec, path_src + i,
+                len - i < 3 ? len - i : 3);
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_json_decoder_finish(dec, NULL));
+
+    ABTS_INT_EQUAL(tc, 4, m.found->nelts);
+    if (m.found->nelts == 4) {
+        ABTS_STR_EQUAL(tc, "1:{\"id\":42,\"name\":\"jo\",\"a/b\":1,\"m~n\":2}",
+                APR_ARRAY_IDX(m.found, 0, char *));
+        ABTS_STR_EQUAL(tc, "0:10", APR_ARRAY_IDX(m.found, 1, char *));
+        ABTS_STR_EQUAL(tc, "0:2.5", APR_ARRAY_IDX(m.found, 2, char *));
+        ABTS_STR_EQUAL(tc, "2:3", APR_ARRAY_IDX(m.found, 3, char *));
+    }
+
+    /* the skipped parts are still checked */
+    status = apr_json_path_decoder_create(&dec, paths, 1, path_match_cb, &m,
+            10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    status = apr_json_decoder_feed(dec, "{\"a\":[1,tru]}", 13);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_json_path_decoder_create(&dec, paths,
+            65, path_match_cb, &m, 10, p));
+}
+
+static void test_json_tape(abts_case * tc, void *data)
+{
+    const char *src = " {\"a\": [1, {\"b\": [true, null]}, 2.5, \"x\\ty\"],"
+                      " \"e\": {}, \"f\": [], \"c\": \"plain\", \"c\": 0} ";
+    apr_json_tape_t *tape;
+    const apr_json_node_t *root, *a, *node, *key;
+    const char *str;
+    apr_size_t len;
+    apr_off_t offset;
+    apr_status_t status;
+    int n;
+
+    status = apr_json_decode_tape(&tape, src, APR_JSON_VALUE_STRING,
+            &offset, APR_JSON_FLAGS_LAZY, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    ABTS_INT_EQUAL(tc, (int)strlen(src), (int)offset);
+
+    root = apr_json_tape_root(tape);
+    ABTS_INT_EQUAL(tc, APR_JSON_OBJECT, apr_json_node_type(root));
+    ABTS_SIZE_EQUAL(tc, 5, apr_json_node_count(root));
+
+    /* the members in order, the nested ones skipped over */
+    for (n = 0, key = apr_json_node_object_first(root); key;
+         n++, key = apr_json_node_object_next(root, key)) {
+        str = apr_json_node_string(key, &len);
+        ABTS_ASSERT(tc, "key", len == 1 && *str == "aefcc"[n]);
+    }
+    ABTS_INT_EQUAL(tc, 5, n);
+
+    a = apr_json_node_object_get(root, "a", APR_JSON_VALUE_STRING);
+    ABTS_PTR_NOTNULL(tc, a);
+    ABTS_INT_EQUAL(tc, APR_JSON_ARRAY, apr_json_node_type(a));
+    ABTS_SIZE_EQUAL(tc, 4, apr_json_node_count(a));
+
+    node = apr_json_node_array_first(a);
+    ABTS_LLONG_EQUAL(tc, 1, apr_json_node_long(node));
+    node = apr_json_node_array_next(a, node);
+    ABTS_INT_EQUAL(tc, APR_JSON_OBJECT, apr_json_node_type(node));
+    node = apr_json_node_object_get(node, "b", 1);
+    ABTS_INT_EQUAL(tc, 1, apr_json_node_boolean(
+            apr_json_node_array_get(node, 0)));
+    ABTS_INT_EQUAL(tc, APR_JSON_NULL, apr_json_node_type(
+            apr_json_node_array_get(node, 1)));
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_node_array_get(node, 2));
+
+    node = apr_json_node_array_get(a, 2);
+    ABTS_ASSERT(tc, "double", apr_json_node_double(node) == 2.5);
+    node = apr_json_node_array_next(a, node);
+    ABTS_STR_EQUAL(tc, "x\ty", apr_json_node_string(node, NULL));
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_node_array_next(a, node));
+
+    node = apr_json_node_object_get(root, "e", 1);
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_node_object_first(node));
+    node = apr_json_node_object_get(root, "f", 1);
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_node_array_first(node));
+    ABTS_PTR_EQUAL(tc, NULL, apr_json_node_object_get(root, "g", 1));
+
+    /* the first of duplicate keys, pointing into the text */
+    node = apr_json_node_object_get(root, "c", 1);
+    str = apr_json_node_string(node, &len);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+    ABTS_ASSERT(tc, "lazy", str > src && str < src + strlen(src));
+
+    /* a trailing comma right before the end, as apr_json_decode() */
+    status = apr_json_decode_tape(&tape, "{\"a\":[1,{},],\"b\":2,}",
+            APR_JSON_VALUE_STRING, NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, status);
+    root = apr_json_tape_root(tape);
+    ABTS_SIZE_EQUAL(tc, 2, apr_json_node_count(root));
+    a = apr_json_node_object_get(root, "a", APR_JSON_VALUE_STRING);
+    ABTS_SIZE_EQUAL(tc, 2, apr_json_node_count(a));
+    key = apr_json_node_object_next(root, apr_json_node_object_first(root));
+    str = apr_json_node_string(key, &len);
+    ABTS_ASSERT(tc, "key", len == 1 && *str == 'b');
+
+    status = apr_json_decode_tape(&tape, "[1,[2,3]]x", APR_JSON_VALUE_STRING,
+            &offset, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    ABTS_INT_EQUAL(tc, 9, (int)offset);
+    status = apr_json_decode_tape(&tape, "[1, ]", APR_JSON_VALUE_STRING,
+            NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = apr_json_decode_tape(&tape, "[,]", APR_JSON_VALUE_STRING,
+            NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_BADCH, status);
+    status = apr_json_decode_tape(&tape, "{\"a\":[1,2", APR_JSON_VALUE_STRING,
+            NULL, APR_JSON_FLAGS_NONE, 10, p);
+    ABTS_INT_EQUAL(tc, APR_EOF, status);
+    status = apr_json_decode_tape(&tape, "[[[1]]]", APR_JSON_VALUE_STRING,
+            NULL, APR_JSON_FLAGS_NONE, 2, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, status);
+}
+
 static void test_json_overlay(abts_case * tc, void *data)
 {
     const char *o = "{\"o1\":\"foo\",\"common\":\"bar\",\"o2\":\"baz\"}";
@@ -271,7 +948,7 @@ static void test_json_create(abts_case* tc, void* data)
     buf[len] = 0;
 
     ABTS_STR_EQUAL(tc,
-                   "{\"null\":null,\"bool\":true,\"double\":12.340000,"
+                   "{\"null\":null,\"bool\":true,\"double\":12.34,"
                    "\"long\":1234,\"string\":\"str\"}",
                    buf);
 }
@@ -284,6 +961,16 @@ abts_suite *testjson(abts_suite * suite)
     abts_run_test(suite, test_json_level, NULL);
     abts_run_test(suite, test_json_eof, NULL);
     abts_run_test(suite, test_json_string, NULL);
+    abts_run_test(suite, test_json_long_string, NULL);
+    abts_run_test(suite, test_json_number, NULL);
+    abts_run_test(suite, test_json_decoder, NULL);
+    abts_run_test(suite, test_json_decoder_brigade, NULL);
+    abts_run_test(suite, test_json_lazy, NULL);
+    abts_run_test(suite, test_json_lazy_duplicate, NULL);
+    abts_run_test(suite, test_json_encode, NULL);
+    abts_run_test(suite, test_json_path, NULL);
+    abts_run_test(suite, test_json_path_decoder, NULL);
+    abts_run_test(suite, test_json_tape, NULL);
     abts_run_test(suite, test_json_overlay, NULL);
     abts_run_test(suite, test_json_object_iterate, NULL);
     abts_run_test(suite, test_json_array_iterate, NULL);
@@ -19,12 +19,17 @@
 #include "apr_thread_mutex.h"
 #include "apr_thread_rwlock.h"
 #include "apr_thread_cond.h"
+#include "apr_thread_sema.h"
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_getopt.h"
 #include "apr_atomic.h"
+#include "apr_mutex_stats.h"
 #include "testutil.h"
 
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
 #if APR_HAS_THREADS
 
 #define MAX_ITER 40000
@@ -40,6 +45,7 @@ static void *APR_THREAD_FUNC thread_cond_consumer(apr_thread_t *thd, void *data)
 static apr_thread_mutex_t *thread_mutex;
 static apr_thread_rwlock_t *rwlock;
 static int i = 0, x = 0;
+static volatile int rwlock_broken = 0;
 
 static int buff[MAX_COUNTER];
 
@@ -64,9 +70,15 @@ static void *APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data)
 
     while (1)
     {
+        int seen;
+
         apr_thread_rwlock_rdlock(rwlock);
+        seen = x;
         if (i == MAX_ITER)
             exitLoop = 0;
+        /* No writer meanwhile */
+        if (x != seen)
+            rwlock_broken = 1;
         apr_thread_rwlock_unlock(rwlock);
 
         if (!exitLoop)
@@ -210,8 +222,9 @@ static void test_thread_mutex(abts_case *tc, void *data)
 {
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
+    unsigned int flags = (unsigned int)(apr_uintptr_t)data;
 
-    s1 = apr_thread_mutex_create(&thread_mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    s1 = apr_thread_mutex_create(&thread_mutex, flags, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, s1);
     ABTS_PTR_NOTNULL(tc, thread_mutex);
 
@@ -272,7 +285,9 @@ static void test_thread_rwlock(abts_case *tc, void *data)
     apr_thread_t *t1, *t2, *t3, *t4;
     apr_status_t s1, s2, s3, s4;
 
-    s1 = apr_thread_rwlock_create(&rwlock, p);
+    unsigned int flags = (unsigned int)(apr_uintptr_t)data;
+
+    s1 = apr_thread_rwlock_create_ex(&rwlock, flags, p);
     if (s1 == APR_ENOTIMPL) {
         ABTS_NOT_IMPL(tc, "rwlocks not implemented");
         return;
@@ -282,6 +297,7 @@ static void test_thread_rwlock(abts_case *tc, void *data)
 
     i = 0;
     x = 0;
+    rwlock_broken = 0;
 
     s1 = apr_thread_create(&t1, NULL, thread_rwlock_func, NULL, p);
     APR_ASSERT_SUCCESS(tc, "create thread 1", s1);
@@ -298,6 +314,114 @@ static void test_thread_rwlock(abts_case *tc, void *data)
     apr_thread_join(&s4, t4);
 
     ABTS_INT_EQUAL(tc, MAX_ITER, x);
+    ABTS_INT_EQUAL(tc, 0, rwlock_broken);
+
+    apr_thread_rwlock_destroy(rwlock);
+}
+
+static void *APR_THREAD_FUNC thread_rwlock_try_func(apr_thread_t *thd,
+                                                    void *data)
+{
+    apr_status_t rv;
+
+    /* The other thread holds the lock for reading, or writing if data */
+    rv = apr_thread_rwlock_trywrlock(rwlock);
+    if (rv == APR_SUCCESS) {
+        apr_thread_rwlock_unlock(rwlock);
+    }
+    else if (APR_STATUS_IS_EBUSY(rv) && !data) {
+        rv = apr_thread_rwlock_tryrdlock(rwlock);
+        if (rv == APR_SUCCESS) {
+            apr_thread_rwlock_unlock(rwlock);
+            rv = APR_EBUSY;
+        }
+        else {
+            rv = APR_EGENERAL;
+        }
+    }
+    else if (APR_STATUS_IS_EBUSY(rv)) {
+        rv = apr_thread_rwlock_tryrdlock(rwlock);
+        if (rv == APR_SUCCESS) {
+            apr_thread_rwlock_unlock(rwlock);
+            rv = APR_EGENERAL;
+        }
+    }
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_thread_rwlock_try(abts_case *tc, void *data)
+{
+    apr_thread_t *t1;
+    apr_status_t s1, rv;
+    unsigned int flags = (unsigned int)(apr_uintptr_t)data;
+
+    s1 = apr_thread_rwlock_create_ex(&rwlock, flags, p);
+    if (s1 == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "rwlocks not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "rwlock_create", s1);
+
+    /* Read locked: no writer, more readers */
+    APR_ASSERT_SUCCESS(tc, "rdlock", apr_thread_rwlock_rdlock(rwlock));
+    s1 = apr_thread_create(&t1, NULL, thread_rwlock_try_func, NULL, p);
+    APR_ASSERT_SUCCESS(tc, "create thread", s1);
+    apr_thread_join(&rv, t1);
+    ABTS_INT_EQUAL(tc, APR_EBUSY, rv);
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(rwlock));
+
+    /* Write locked: nobody */
+    APR_ASSERT_SUCCESS(tc, "wrlock", apr_thread_rwlock_wrlock(rwlock));
+    s1 = apr_thread_create(&t1, NULL, thread_rwlock_try_func, (void *)1, p);
+    APR_ASSERT_SUCCESS(tc, "create thread", s1);
+    apr_thread_join(&rv, t1);
+    ABTS_TRUE(tc, APR_STATUS_IS_EBUSY(rv));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(rwlock));
+
+    /* Unlocked */
+    APR_ASSERT_SUCCESS(tc, "trywrlock", apr_thread_rwlock_trywrlock(rwlock));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(rwlock));
+
+    apr_thread_rwlock_destroy(rwlock);
+}
+
+static void *APR_THREAD_FUNC thread_rwlock_writer_func(apr_thread_t *thd,
+                                                       void *data)
+{
+    apr_status_t rv;
+
+    rv = apr_thread_rwlock_wrlock(rwlock);
+    if (rv == APR_SUCCESS) {
+        rv = apr_thread_rwlock_unlock(rwlock);
+    }
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_thread_rwlock_recursive(abts_case *tc, void *data)
+{
+    apr_thread_t *t1;
+    apr_status_t s1, rv;
+    unsigned int flags = (unsigned int)(apr_uintptr_t)data;
+
+    s1 = apr_thread_rwlock_create_ex(&rwlock, flags, p);
+    if (s1 == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "rwlocks not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "rwlock_create", s1);
+
+    /* Read locking again while a writer waits must not deadlock */
+    APR_ASSERT_SUCCESS(tc, "rdlock", apr_thread_rwlock_rdlock(rwlock));
+    s1 = apr_thread_create(&t1, NULL, thread_rwlock_writer_func, NULL, p);
+    APR_ASSERT_SUCCESS(tc, "create thread", s1);
+    apr_sleep(apr_time_from_msec(100));
+    APR_ASSERT_SUCCESS(tc, "rdlock again", apr_thread_rwlock_rdlock(rwlock));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(rwlock));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_rwlock_unlock(rwlock));
+    apr_thread_join(&rv, t1);
+    APR_ASSERT_SUCCESS(tc, "writer", rv);
 
     apr_thread_rwlock_destroy(rwlock);
 }
@@ -394,6 +518,114 @@ static void test_timeoutcond(abts_case *tc, void *data)
                        apr_thread_cond_destroy(timeout_cond));
 }
 
+#define SEMA_PRODUCERS 4
+#define SEMA_CONSUMERS 2
+
+static apr_thread_sema_t *sema;
+static apr_uint32_t sema_posted, sema_taken;
+
+static void *APR_THREAD_FUNC thread_sema_producer(apr_thread_t *thd,
+                                                  void *data)
+{
+    int n;
+
+    for (n = 0; n < MAX_ITER / SEMA_PRODUCERS; n++) {
+        apr_atomic_inc32(&sema_posted);
+        if (apr_thread_sema_post(sema)) {
+            apr_thread_exit(thd, APR_EGENERAL);
+        }
+    }
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void *APR_THREAD_FUNC thread_sema_consumer(apr_thread_t *thd,
+                                                  void *data)
+{
+    int n;
+
+    for (n = 0; n < MAX_ITER / SEMA_CONSUMERS; n++) {
+        if (apr_thread_sema_wait(sema)) {
+            apr_thread_exit(thd, APR_EGENERAL);
+        }
+        /* Never taken before posted */
+        if (apr_atomic_inc32(&sema_taken) >= apr_atomic_read32(&sema_posted)) {
+            apr_thread_exit(thd, APR_EGENERAL);
+        }
+    }
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static void test_sema(abts_case *tc, void *data)
+{
+    apr_thread_t *producers[SEMA_PRODUCERS], *consumers[SEMA_CONSUMERS];
+    apr_status_t rv;
+    int n;
+
+    APR_ASSERT_SUCCESS(tc, "create semaphore",
+                       apr_thread_sema_create(&sema, 0, p));
+    sema_posted = sema_taken = 0;
+
+    for (n = 0; n < SEMA_CONSUMERS; n++) {
+        rv = apr_thread_create(&consumers[n], NULL, thread_sema_consumer,
+                               NULL, p);
+        APR_ASSERT_SUCCESS(tc, "create consumer thread", rv);
+    }
+    for (n = 0; n < SEMA_PRODUCERS; n++) {
+        rv = apr_thread_create(&producers[n], NULL, thread_sema_producer,
+                               NULL, p);
+        APR_ASSERT_SUCCESS(tc, "create producer thread", rv);
+    }
+    for (n = 0; n < SEMA_PRODUCERS; n++) {
+        JOIN_WITH_SUCCESS(tc, producers[n]);
+    }
+    for (n = 0; n < SEMA_CONSUMERS; n++) {
+        JOIN_WITH_SUCCESS(tc, consumers[n]);
+    }
+
+    ABTS_INT_EQUAL(tc, MAX_ITER, apr_atomic_read32(&sema_taken));
+    rv = apr_thread_sema_trywait(sema);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EBUSY(rv));
+
+    APR_ASSERT_SUCCESS(tc, "destroy semaphore",
+                       apr_thread_sema_destroy(sema));
+}
+
+static void test_timeoutsema(abts_case *tc, void *data)
+{
+    apr_interval_time_t timeout = apr_time_from_msec(100);
+    apr_time_t begin, end;
+    apr_status_t rv;
+
+    APR_ASSERT_SUCCESS(tc, "create semaphore",
+                       apr_thread_sema_create(&sema, 2, p));
+
+    APR_ASSERT_SUCCESS(tc, "take the first count",
+                       apr_thread_sema_trywait(sema));
+    APR_ASSERT_SUCCESS(tc, "take the second count",
+                       apr_thread_sema_timedwait(sema, 0));
+    rv = apr_thread_sema_trywait(sema);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EBUSY(rv));
+    rv = apr_thread_sema_timedwait(sema, 0);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    begin = apr_time_now();
+    rv = apr_thread_sema_timedwait(sema, timeout);
+    end = apr_time_now();
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_ASSERT(tc, "Timer returned too early", end - begin >= timeout);
+    ABTS_ASSERT(tc, "Timer returned too late",
+                end - begin - timeout < 500000);
+
+    APR_ASSERT_SUCCESS(tc, "post", apr_thread_sema_post(sema));
+    APR_ASSERT_SUCCESS(tc, "take the posted count",
+                       apr_thread_sema_timedwait(sema, timeout));
+
+    APR_ASSERT_SUCCESS(tc, "destroy semaphore",
+                       apr_thread_sema_destroy(sema));
+}
+
 /* Test whether _timedlock times out appropriately.  Since
  * double-locking a non-recursive mutex has undefined behaviour, and
  * double-locking a recursive mutex succeeds immediately, a thread is
@@ -492,6 +724,88 @@ static void test_thread_unnestedmutex(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static void *APR_THREAD_FUNC thread_named_mutex_function(apr_thread_t *thd,
+                                                         void *data)
+{
+    apr_status_t rv = apr_thread_mutex_lock(data);
+
+    if (rv == APR_SUCCESS) {
+        rv = apr_thread_mutex_unlock(data);
+    }
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static int find_named_mutex(void *baton, const apr_mutex_stats_t *stats)
+{
+    apr_mutex_stats_t *found = baton;
+
+    if (strcmp(stats->name, "testlock") == 0) {
+        *found = *stats;
+        return 0;
+    }
+    return 1;
+}
+
+static void test_named_mutex(abts_case *tc, void *data)
+{
+    apr_pool_t *pool;
+    apr_thread_mutex_t *m;
+    apr_thread_t *t;
+    apr_mutex_stats_t stats;
+    apr_file_t *in, *out;
+    char buf[1024];
+    apr_size_t len = sizeof(buf) - 1;
+    apr_status_t rv;
+
+    apr_pool_create(&pool, p);
+    rv = apr_thread_mutex_create(&m, APR_THREAD_MUTEX_DEFAULT, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_mutex_name_set(m, "testlock");
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Mutex statistics not implemented");
+        apr_pool_destroy(pool);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the thread waits for us */
+    APR_ASSERT_SUCCESS(tc, "lock", apr_thread_mutex_lock(m));
+    rv = apr_thread_create(&t, NULL, thread_named_mutex_function, m, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_sleep(apr_time_from_msec(100));
+    APR_ASSERT_SUCCESS(tc, "unlock", apr_thread_mutex_unlock(m));
+    JOIN_WITH_SUCCESS(tc, t);
+
+    memset(&stats, 0, sizeof(stats));
+    apr_mutex_stats_do(find_named_mutex, &stats);
+    ABTS_STR_EQUAL(tc, "thread", stats.kind);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.locks);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.contended);
+    ABTS_ASSERT(tc, "waited", stats.wait_max > 0
+                              && stats.wait_max == stats.wait_time);
+
+    APR_ASSERT_SUCCESS(tc, "pipe", apr_file_pipe_create(&in, &out, p));
+    APR_ASSERT_SUCCESS(tc, "dump", apr_mutex_stats_dump(out, p));
+    apr_file_close(out);
+    apr_file_read_full(in, buf, len, &len);
+    apr_file_close(in);
+    buf[len] = '\0';
+    ABTS_PTR_NOTNULL(tc, strstr(buf, "thread testlock locks=2 contended=1 "));
+
+    apr_mutex_stats_reset();
+    memset(&stats, 0, sizeof(stats));
+    apr_mutex_stats_do(find_named_mutex, &stats);
+    ABTS_STR_EQUAL(tc, "testlock", stats.name);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.locks);
+
+    /* gone with its pool */
+    apr_pool_destroy(pool);
+    memset(&stats, 0, sizeof(stats));
+    apr_mutex_stats_do(find_named_mutex, &stats);
+    ABTS_PTR_EQUAL(tc, NULL, stats.name);
+}
+
 #ifdef WIN32
 static void *APR_THREAD_FUNC
 thread_win32_abandoned_mutex_function(apr_thread_t *thd, void *data)
@@ -550,14 +864,34 @@ abts_suite *testlock(abts_suite *suite)
 #if !APR_HAS_THREADS
     abts_run_test(suite, threads_not_impl, NULL);
 #else
-    abts_run_test(suite, test_thread_mutex, NULL);
+    abts_run_test(suite, test_thread_mutex,
+                  (void *)(apr_uintptr_t)APR_THREAD_MUTEX_DEFAULT);
+    abts_run_test(suite, test_thread_mutex,
+                  (void *)(apr_uintptr_t)APR_THREAD_MUTEX_ADAPTIVE);
+    abts_run_test(suite, test_thread_mutex,
+                  (void *)(apr_uintptr_t)(APR_THREAD_MUTEX_ADAPTIVE |
+                                          APR_THREAD_MUTEX_NESTED));
     abts_run_test(suite, test_thread_timedmutex, NULL);
     abts_run_test(suite, test_thread_nestedmutex, NULL);
     abts_run_test(suite, test_thread_unnestedmutex, NULL);
-    abts_run_test(suite, test_thread_rwlock, NULL);
+    abts_run_test(suite, test_thread_rwlock,
+                  (void *)(apr_uintptr_t)APR_THREAD_RWLOCK_DEFAULT);
+    abts_run_test(suite, test_thread_rwlock,
+                  (void *)(apr_uintptr_t)APR_THREAD_RWLOCK_SCALABLE);
+    abts_run_test(suite, test_thread_rwlock_try,
+                  (void *)(apr_uintptr_t)APR_THREAD_RWLOCK_DEFAULT);
+    abts_run_test(suite, test_thread_rwlock_try,
+                  (void *)(apr_uintptr_t)APR_THREAD_RWLOCK_SCALABLE);
+    abts_run_test(suite, test_thread_rwlock_recursive,
+                  (void *)(apr_uintptr_t)APR_THREAD_RWLOCK_DEFAULT);
+    abts_run_test(suite, test_thread_rwlock_recursive,
+                  (void *)(apr_uintptr_t)APR_THREAD_RWLOCK_SCALABLE);
     abts_run_test(suite, test_cond, NULL);
     abts_run_test(suite, test_timeoutcond, NULL);
+    abts_run_test(suite, test_sema, NULL);
+    abts_run_test(suite, test_timeoutsema, NULL);
     abts_run_test(suite, test_timeoutmutex, NULL);
+    abts_run_test(suite, test_named_mutex, NULL);
 #ifdef WIN32
     abts_run_test(suite, test_win32_abandoned_mutex, NULL);
 #endif
@@ -14,16 +14,40 @@
  * limitations under the License.
  */
 
+/* testlockperf.c
+ * This program times the locks with 1, 2, 4... threads up to the number
+ * of cores, each taking the lock counter times, and prints for each run
+ * the throughput and the fairness (Jain's index of the throughputs of the
+ * threads, 1 when they all progressed at the same pace).
+ *
+ * To run,
+ *
+ *   ./testlockperf [-c counter] [-t threads] [-s length] [-r percent] [-m]
+ *
+ * where length is the number of spins in the critical section (0 by
+ * default), percent the share of read locks taken on the rwlock (0 by
+ * default), and -m adds every apr_lockmech_e of the global mutexes
+ * (contended by threads) and process mutexes (contended by processes).
+ */
+
 #include "apr_thread_proc.h"
 #include "apr_thread_mutex.h"
 #include "apr_thread_rwlock.h"
+#include "apr_proc_mutex.h"
+#include "apr_global_mutex.h"
+#include "apr_shm.h"
 #include "apr_file_io.h"
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_getopt.h"
+#include "apr_strings.h"
 #include "errno.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include "testutil.h"
 
 #if !APR_HAS_THREADS
@@ -36,247 +60,375 @@ int main(void)
 #else /* !APR_HAS_THREADS */
 
 #define DEFAULT_MAX_COUNTER 1000000
+/* When the number of cores is unknown */
 #define MAX_THREADS 6
+#define LOCKFILE "lockperf.lock"
+
+typedef enum {
+    LOCK_THREAD_MUTEX,
+    LOCK_THREAD_RWLOCK,
+    LOCK_GLOBAL_MUTEX,
+    LOCK_PROC_MUTEX
+} lock_kind_e;
+
+typedef struct lock_t {
+    const char *name;
+    lock_kind_e kind;
+    apr_thread_mutex_t *thread_mutex;
+    apr_thread_rwlock_t *thread_rwlock;
+    apr_global_mutex_t *global_mutex;
+    apr_proc_mutex_t *proc_mutex;
+    apr_interval_time_t timeout;
+} lock_t;
+
+/* What the workers share, in shared memory for the processes */
+typedef struct shared_t {
+    long counter;
+    apr_time_t finish[1];
+} shared_t;
+
+typedef struct worker_t {
+    lock_t *lock;
+    shared_t *shared;
+    int index;
+    long writes;
+} worker_t;
 
 static int verbose = 0;
-static long mutex_counter;
 static long max_counter = DEFAULT_MAX_COUNTER;
+static int cs_length = 0;
+static int read_percent = 0;
 
-static apr_thread_mutex_t *thread_lock;
-void * APR_THREAD_FUNC thread_mutex_func(apr_thread_t *thd, void *data);
-apr_status_t test_thread_mutex(int num_threads); /* apr_thread_mutex_t */
-
-static apr_thread_rwlock_t *thread_rwlock;
-void * APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data);
-apr_status_t test_thread_rwlock(int num_threads); /* apr_thread_rwlock_t */
+apr_pool_t *pool;
 
-int test_thread_mutex_nested(int num_threads);
+static apr_status_t lock_acquire(lock_t *lock, int write)
+{
+    switch (lock->kind) {
+    case LOCK_THREAD_MUTEX:
+        if (lock->timeout) {
+            return apr_thread_mutex_timedlock(lock->thread_mutex,
+                                              lock->timeout);
+        }
+        return apr_thread_mutex_lock(lock->thread_mutex);
+    case LOCK_THREAD_RWLOCK:
+        return write ? apr_thread_rwlock_wrlock(lock->thread_rwlock)
+                     : apr_thread_rwlock_rdlock(lock->thread_rwlock);
+    case LOCK_GLOBAL_MUTEX:
+        return apr_global_mutex_lock(lock->global_mutex);
+    default:
+        return apr_proc_mutex_lock(lock->proc_mutex);
+    }
+}
 
-apr_pool_t *pool;
-int i = 0, x = 0;
+static apr_status_t lock_release(lock_t *lock)
+{
+    switch (lock->kind) {
+    case LOCK_THREAD_MUTEX:
+        return apr_thread_mutex_unlock(lock->thread_mutex);
+    case LOCK_THREAD_RWLOCK:
+        return apr_thread_rwlock_unlock(lock->thread_rwlock);
+    case LOCK_GLOBAL_MUTEX:
+        return apr_global_mutex_unlock(lock->global_mutex);
+    default:
+        return apr_proc_mutex_unlock(lock->proc_mutex);
+    }
+}
 
-void * APR_THREAD_FUNC thread_mutex_func(apr_thread_t *thd, void *data)
+static void worker_loop(worker_t *w)
 {
-    int i;
+    unsigned int seed = 2166136261u ^ (unsigned int)w->index;
+    volatile long spin;
+    long i, seen = 0;
+    int k, write = 1;
 
     for (i = 0; i < max_counter; i++) {
-        if (data) {
-            apr_thread_mutex_timedlock(thread_lock, *(apr_interval_time_t *)data);
+        if (read_percent && w->lock->kind == LOCK_THREAD_RWLOCK) {
+            seed = seed * 1103515245u + 12345u;
+            write = (int)((seed >> 16) % 100) >= read_percent;
+        }
+        lock_acquire(w->lock, write);
+        if (write) {
+            w->shared->counter++;
+            w->writes++;
         }
         else {
-            apr_thread_mutex_lock(thread_lock);
+            seen += w->shared->counter;
         }
-        mutex_counter++;
-        apr_thread_mutex_unlock(thread_lock);
+        for (k = 0, spin = seen; k < cs_length; k++) {
+            spin++;
+        }
+        lock_release(w->lock);
     }
-    return NULL;
+    w->shared->finish[w->index] = apr_time_now();
 }
 
-void * APR_THREAD_FUNC thread_rwlock_func(apr_thread_t *thd, void *data)
+static void * APR_THREAD_FUNC worker_thread(apr_thread_t *thd, void *data)
 {
-    int i;
-
-    for (i = 0; i < max_counter; i++) {
-        apr_thread_rwlock_wrlock(thread_rwlock);
-        mutex_counter++;
-        apr_thread_rwlock_unlock(thread_rwlock);
-    }
+    worker_loop(data);
     return NULL;
 }
 
-int test_thread_mutex(int num_threads)
+/* Runs the workers, with the lock held by the caller, which the start
+ * of the run releases */
+static apr_status_t run_workers(lock_t *lock, worker_t *w, int num_workers,
+                                apr_time_t *time_start)
 {
-    apr_thread_t *t[MAX_THREADS];
-    apr_status_t s[MAX_THREADS];
-    apr_time_t time_start, time_stop;
+    apr_thread_t **t = apr_palloc(pool, num_workers * sizeof(*t));
+    apr_status_t rv;
     int i;
 
-    mutex_counter = 0;
+    if (lock->kind == LOCK_PROC_MUTEX) {
+        apr_proc_t *procs = apr_palloc(pool, num_workers * sizeof(*procs));
+        apr_exit_why_e why;
+        int exitcode, failed = 0;
+
+        /* Not to be printed again by the children */
+        fflush(stdout);
+
+        for (i = 0; i < num_workers; ++i) {
+            rv = apr_proc_fork(&procs[i], pool);
+            if (rv == APR_INCHILD) {
+                /* As the parent, to keep apr_terminate() balanced */
+                apr_initialize();
+                if (apr_proc_mutex_child_init(&lock->proc_mutex, LOCKFILE,
+                                              pool)) {
+                    exit(1);
+                }
+                worker_loop(&w[i]);
+                exit(0);
+            }
+            if (rv != APR_INPARENT) {
+                return rv;
+            }
+        }
 
-    printf("apr_thread_mutex_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_mutex_t (UNNESTED)");
-    s[0] = apr_thread_mutex_create(&thread_lock, APR_THREAD_MUTEX_UNNESTED, pool);
-    if (s[0] != APR_SUCCESS) {
-        printf("Failed!\n");
-        return s[0];
-    }
-    printf("OK\n");
-
-    apr_thread_mutex_lock(thread_lock);
-    /* set_concurrency(4)? -aaron */
-    printf("    Starting %d threads    ", num_threads); 
-    for (i = 0; i < num_threads; ++i) {
-        s[i] = apr_thread_create(&t[i], NULL, thread_mutex_func, NULL, pool);
-        if (s[i] != APR_SUCCESS) {
-            printf("Failed!\n");
-            return s[i];
+        *time_start = apr_time_now();
+        lock_release(lock);
+
+        for (i = 0; i < num_workers; ++i) {
+            apr_proc_wait(&procs[i], &exitcode, &why, APR_WAIT);
+            if (why != APR_PROC_EXIT || exitcode) {
+                failed = 1;
+            }
+            /* Only the writes of the threads are counted by the workers */
+            w[i].writes = max_counter;
         }
+        return failed ? APR_EGENERAL : APR_SUCCESS;
     }
-    printf("OK\n");
 
-    time_start = apr_time_now();
-    apr_thread_mutex_unlock(thread_lock);
-
-    /* printf("%-60s", "    Waiting for threads to exit"); */
-    for (i = 0; i < num_threads; ++i) {
-        apr_thread_join(&s[i], t[i]);
+    for (i = 0; i < num_workers; ++i) {
+        rv = apr_thread_create(&t[i], NULL, worker_thread, &w[i], pool);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
     }
-    /* printf("OK\n"); */
 
-    time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
-    if (mutex_counter != max_counter * num_threads)
-        printf("error: counter = %ld\n", mutex_counter);
+    *time_start = apr_time_now();
+    lock_release(lock);
 
+    for (i = 0; i < num_workers; ++i) {
+        apr_thread_join(&rv, t[i]);
+    }
     return APR_SUCCESS;
 }
 
-int test_thread_mutex_nested(int num_threads)
+static apr_status_t test_lock(lock_t *lock, int num_workers)
 {
-    apr_thread_t *t[MAX_THREADS];
-    apr_status_t s[MAX_THREADS];
+    apr_size_t size = sizeof(shared_t) + num_workers * sizeof(apr_time_t);
     apr_time_t time_start, time_stop;
+    double total, sum = 0, sumsq = 0, rate;
+    apr_shm_t *shm = NULL;
+    shared_t *shared;
+    worker_t *w;
+    long writes = 0;
+    apr_status_t rv;
     int i;
 
-    mutex_counter = 0;
-
-    printf("apr_thread_mutex_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_mutex_t (NESTED)");
-    s[0] = apr_thread_mutex_create(&thread_lock, APR_THREAD_MUTEX_NESTED, pool);
-    if (s[0] != APR_SUCCESS) {
-        printf("Failed!\n");
-        return s[0];
-    }
-    printf("OK\n");
-
-    apr_thread_mutex_lock(thread_lock);
-    /* set_concurrency(4)? -aaron */
-    printf("    Starting %d threads    ", num_threads); 
-    for (i = 0; i < num_threads; ++i) {
-        s[i] = apr_thread_create(&t[i], NULL, thread_mutex_func, NULL, pool);
-        if (s[i] != APR_SUCCESS) {
-            printf("Failed!\n");
-            return s[i];
+    if (lock->kind == LOCK_PROC_MUTEX) {
+        rv = apr_shm_create(&shm, size, NULL, pool);
+        if (rv != APR_SUCCESS) {
+            return rv;
         }
+        shared = apr_shm_baseaddr_get(shm);
+        memset(shared, 0, size);
+    }
+    else {
+        shared = apr_pcalloc(pool, size);
     }
-    printf("OK\n");
-
-    time_start = apr_time_now();
-    apr_thread_mutex_unlock(thread_lock);
 
-    /* printf("%-60s", "    Waiting for threads to exit"); */
-    for (i = 0; i < num_threads; ++i) {
-        apr_thread_join(&s[i], t[i]);
+    w = apr_pcalloc(pool, num_workers * sizeof(*w));
+    for (i = 0; i < num_workers; ++i) {
+        w[i].lock = lock;
+        w[i].shared = shared;
+        w[i].index = i;
     }
-    /* printf("OK\n"); */
 
+    rv = lock_acquire(lock, 1);
+    if (rv == APR_SUCCESS) {
+        rv = run_workers(lock, w, num_workers, &time_start);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
     time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
-    if (mutex_counter != max_counter * num_threads)
-        printf("error: counter = %ld\n", mutex_counter);
 
-    return APR_SUCCESS;
+    /* The throughput of each worker, until it was done */
+    for (i = 0; i < num_workers; ++i) {
+        apr_time_t elapsed = shared->finish[i] - time_start;
+
+        rate = (double)max_counter * APR_USEC_PER_SEC
+               / (double)(elapsed > 0 ? elapsed : 1);
+        sum += rate;
+        sumsq += rate * rate;
+        writes += w[i].writes;
+        if (verbose) {
+            printf("    worker %-3d %12" APR_TIME_T_FMT " usec %14.0f ops/s\n",
+                   i, elapsed, rate);
+        }
+    }
+    total = (double)max_counter * num_workers * APR_USEC_PER_SEC
+            / (double)(time_stop > time_start ? time_stop - time_start : 1);
+
+    printf("%-38s %7d %12" APR_TIME_T_FMT " %14.0f %8.3f\n", lock->name,
+           num_workers, time_stop - time_start, total,
+           sumsq > 0 ? sum * sum / (num_workers * sumsq) : 1.0);
+    if (shared->counter != writes) {
+        printf("error: counter = %ld, expected %ld\n", shared->counter,
+               writes);
+        rv = APR_EGENERAL;
+    }
+
+    if (shm) {
+        apr_shm_destroy(shm);
+    }
+    return rv;
 }
 
-static int test_thread_mutex_timed(int num_threads)
+static apr_status_t test_thread_locks(int num_threads)
 {
-    apr_thread_t *t[MAX_THREADS];
-    apr_status_t s[MAX_THREADS];
-    apr_time_t time_start, time_stop;
-    apr_time_t timeout;
-    int i;
-
-    mutex_counter = 0;
-
-    timeout = apr_time_from_sec(5);
+    lock_t lock = { 0 };
+    apr_status_t rv;
 
-    printf("apr_thread_mutex_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_mutex_t (TIMED)");
-    s[0] = apr_thread_mutex_create(&thread_lock, APR_THREAD_MUTEX_TIMED, pool);
-    if (s[0] != APR_SUCCESS) {
-        printf("Failed!\n");
-        return s[0];
+    lock.name = "thread_mutex (UNNESTED)";
+    lock.kind = LOCK_THREAD_MUTEX;
+    rv = apr_thread_mutex_create(&lock.thread_mutex,
+                                 APR_THREAD_MUTEX_UNNESTED, pool);
+    if (rv == APR_SUCCESS) {
+        rv = test_lock(&lock, num_threads);
     }
-    printf("OK\n");
-
-    apr_thread_mutex_lock(thread_lock);
-    /* set_concurrency(4)? -aaron */
-    printf("    Starting %d threads    ", num_threads); 
-    for (i = 0; i < num_threads; ++i) {
-        s[i] = apr_thread_create(&t[i], NULL, thread_mutex_func, &timeout, pool);
-        if (s[i] != APR_SUCCESS) {
-            printf("Failed!\n");
-            return s[i];
-        }
+    if (rv != APR_SUCCESS) {
+        return rv;
     }
-    printf("OK\n");
-
-    time_start = apr_time_now();
-    apr_thread_mutex_unlock(thread_lock);
 
-    /* printf("%-60s", "    Waiting for threads to exit"); */
-    for (i = 0; i < num_threads; ++i) {
-        apr_thread_join(&s[i], t[i]);
+    lock.name = "thread_mutex (NESTED)";
+    rv = apr_thread_mutex_create(&lock.thread_mutex,
+                                 APR_THREAD_MUTEX_NESTED, pool);
+    if (rv == APR_SUCCESS) {
+        rv = test_lock(&lock, num_threads);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
     }
-    /* printf("OK\n"); */
-
-    time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
-    if (mutex_counter != max_counter * num_threads)
-        printf("error: counter = %ld\n", mutex_counter);
 
-    return APR_SUCCESS;
+    lock.name = "thread_mutex (TIMED)";
+    lock.timeout = apr_time_from_sec(5);
+    rv = apr_thread_mutex_create(&lock.thread_mutex,
+                                 APR_THREAD_MUTEX_TIMED, pool);
+    if (rv == APR_SUCCESS) {
+        rv = test_lock(&lock, num_threads);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    lock.timeout = 0;
+
+    lock.name = read_percent
+                ? apr_psprintf(pool, "thread_rwlock (%d%% reads)",
+                               read_percent)
+                : "thread_rwlock";
+    lock.kind = LOCK_THREAD_RWLOCK;
+    rv = apr_thread_rwlock_create(&lock.thread_rwlock, pool);
+    if (rv == APR_SUCCESS) {
+        rv = test_lock(&lock, num_threads);
+    }
+    return rv;
 }
 
-int test_thread_rwlock(int num_threads)
+typedef struct lockmech_t {
+    apr_lockmech_e num;
+    const char *name;
+} lockmech_t;
+
+static const lockmech_t lockmechs[] = {
+    {APR_LOCK_DEFAULT, "default"}
+#if APR_HAS_FLOCK_SERIALIZE
+    ,{APR_LOCK_FLOCK, "flock"}
+#endif
+#if APR_HAS_SYSVSEM_SERIALIZE
+    ,{APR_LOCK_SYSVSEM, "sysvsem"}
+#endif
+#if APR_HAS_POSIXSEM_SERIALIZE
+    ,{APR_LOCK_POSIXSEM, "posix"}
+#endif
+#if APR_HAS_FCNTL_SERIALIZE
+    ,{APR_LOCK_FCNTL, "fcntl"}
+#endif
+#if APR_HAS_PROC_PTHREAD_SERIALIZE
+    ,{APR_LOCK_PROC_PTHREAD, "proc_pthread"}
+#endif
+#if APR_HAS_FUTEX_SERIALIZE
+    ,{APR_LOCK_FUTEX, "futex"}
+#endif
+    ,{APR_LOCK_DEFAULT_TIMED, "default_timed"}
+};
+
+static apr_status_t test_mech_locks(int num_workers)
 {
-    apr_thread_t *t[MAX_THREADS];
-    apr_status_t s[MAX_THREADS];
-    apr_time_t time_start, time_stop;
+    apr_status_t rv;
     int i;
 
-    mutex_counter = 0;
+    for (i = 0; i < sizeof(lockmechs) / sizeof(lockmechs[0]); i++) {
+        lock_t lock = { 0 };
+
+        lock.name = apr_psprintf(pool, "global_mutex (%s)",
+                                 lockmechs[i].name);
+        lock.kind = LOCK_GLOBAL_MUTEX;
+        rv = apr_global_mutex_create(&lock.global_mutex, LOCKFILE,
+                                     lockmechs[i].num, pool);
+        if (rv == APR_SUCCESS) {
+            rv = test_lock(&lock, num_workers);
+            apr_global_mutex_destroy(lock.global_mutex);
+        }
+        if (rv != APR_SUCCESS && rv != APR_ENOTIMPL) {
+            return rv;
+        }
 
-    printf("apr_thread_rwlock_t Tests\n");
-    printf("%-60s", "    Initializing the apr_thread_rwlock_t");
-    s[0] = apr_thread_rwlock_create(&thread_rwlock, pool);
-    if (s[0] != APR_SUCCESS) {
-        printf("Failed!\n");
-        return s[0];
-    }
-    printf("OK\n");
-
-    apr_thread_rwlock_wrlock(thread_rwlock);
-    /* set_concurrency(4)? -aaron */
-    printf("    Starting %d threads    ", num_threads); 
-    for (i = 0; i < num_threads; ++i) {
-        s[i] = apr_thread_create(&t[i], NULL, thread_rwlock_func, NULL, pool);
-        if (s[i] != APR_SUCCESS) {
-            printf("Failed!\n");
-            return s[i];
+        lock.name = apr_psprintf(pool, "proc_mutex (%s, processes)",
+                                 lockmechs[i].name);
+        lock.kind = LOCK_PROC_MUTEX;
+        rv = apr_proc_mutex_create(&lock.proc_mutex, LOCKFILE,
+                                   lockmechs[i].num, pool);
+        if (rv == APR_SUCCESS) {
+            rv = test_lock(&lock, num_workers);
+            apr_proc_mutex_destroy(lock.proc_mutex);
+        }
+        if (rv != APR_SUCCESS && rv != APR_ENOTIMPL) {
+            return rv;
         }
     }
-    printf("OK\n");
+    return APR_SUCCESS;
+}
 
-    time_start = apr_time_now();
-    apr_thread_rwlock_unlock(thread_rwlock);
+static int num_cores(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
 
-    /* printf("%-60s", "    Waiting for threads to exit"); */
-    for (i = 0; i < num_threads; ++i) {
-        apr_thread_join(&s[i], t[i]);
+    if (n > 0) {
+        return (int)n;
     }
-    /* printf("OK\n"); */
-
-    time_stop = apr_time_now();
-    printf("microseconds: %" APR_INT64_T_FMT " usec\n",
-           (time_stop - time_start));
-    if (mutex_counter != max_counter * num_threads)
-        printf("error: counter = %ld\n", mutex_counter);
-
-    return APR_SUCCESS;
+#endif
+    return MAX_THREADS;
 }
 
 int main(int argc, const char * const *argv)
@@ -286,9 +438,10 @@ int main(int argc, const char * const *argv)
     apr_getopt_t *opt;
     char optchar;
     const char *optarg;
+    int max_threads = 0, mechs = 0, i;
 
     printf("APR Lock Performance Test\n==============\n\n");
-        
+
     apr_initialize();
     atexit(apr_terminate);
 
@@ -300,11 +453,24 @@ int main(int argc, const char * const *argv)
                 rv, apr_strerror(rv, errmsg, sizeof errmsg));
         exit(-1);
     }
-        
-    while ((rv = apr_getopt(opt, "c:v", &optchar, &optarg)) == APR_SUCCESS) {
+
+    while ((rv = apr_getopt(opt, "c:t:s:r:mv", &optchar,
+                            &optarg)) == APR_SUCCESS) {
         if (optchar == 'c') {
             max_counter = atol(optarg);
         }
+        else if (optchar == 't') {
+            max_threads = atoi(optarg);
+        }
+        else if (optchar == 's') {
+            cs_length = atoi(optarg);
+        }
+        else if (optchar == 'r') {
+            read_percent = atoi(optarg);
+        }
+        else if (optchar == 'm') {
+            mechs = 1;
+        }
         else if (optchar == 'v') {
             verbose = 1;
         }
@@ -315,33 +481,39 @@ int main(int argc, const char * const *argv)
                 rv, apr_strerror(rv, errmsg, sizeof errmsg));
         exit(-1);
     }
+    if (max_counter <= 0 || max_threads < 0 || cs_length < 0
+            || read_percent < 0 || read_percent > 100) {
+        fprintf(stderr, "usage: %s [-c counter] [-t threads] [-s length] "
+                "[-r percent] [-m] [-v]\n", argv[0]);
+        exit(-1);
+    }
+    if (!max_threads) {
+        max_threads = num_cores();
+    }
+
+    printf("%d iterations per thread, critical section of %d spins\n\n",
+           (int)max_counter, cs_length);
+    printf("%-38s %7s %12s %14s %8s\n", "lock", "threads", "usec", "ops/s",
+           "fairness");
 
-    for (i = 1; i <= MAX_THREADS; ++i) {
-        if ((rv = test_thread_mutex(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_mutex test failed : [%d] %s\n",
+    /* 1, 2, 4... and all the cores */
+    for (i = 1; i <= max_threads; i = (i * 2 > max_threads && i < max_threads)
+                                       ? max_threads : i * 2) {
+        if ((rv = test_thread_locks(i)) != APR_SUCCESS) {
+            fprintf(stderr,"thread lock test failed : [%d] %s\n",
                     rv, apr_strerror(rv, (char*)errmsg, 200));
             exit(-3);
         }
 
-        if ((rv = test_thread_mutex_nested(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_mutex (NESTED) test failed : [%d] %s\n",
+        if (mechs && (rv = test_mech_locks(i)) != APR_SUCCESS) {
+            fprintf(stderr,"global/proc mutex test failed : [%d] %s\n",
                     rv, apr_strerror(rv, (char*)errmsg, 200));
+            apr_file_remove(LOCKFILE, pool);
             exit(-4);
         }
-
-        if ((rv = test_thread_mutex_timed(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_mutex (TIMED) test failed : [%d] %s\n",
-                    rv, apr_strerror(rv, (char*)errmsg, 200));
-            exit(-5);
-        }
-
-        if ((rv = test_thread_rwlock(i)) != APR_SUCCESS) {
-            fprintf(stderr,"thread_rwlock test failed : [%d] %s\n",
-                    rv, apr_strerror(rv, (char*)errmsg, 200));
-            exit(-6);
-        }
     }
 
+    apr_file_remove(LOCKFILE, pool);
     return 0;
 }
 
@@ -662,6 +662,702 @@ static void test_memcache_setget(abts_case * tc, void *data)
     }
 }
 
+/* consistent hashing moves few keys when a server is added or disabled,
+ * no server needs to be running since none is connected to.
+ */
+
+#define CONSISTENT_SERVERS 40
+#define CONSISTENT_KEYS 1000
+
+static void consistent_map(apr_memcache_t *memcache,
+                           apr_memcache_server_t **map)
+{
+    int i;
+
+    for (i = 0; i < CONSISTENT_KEYS; i++) {
+        char key[32];
+        apr_uint32_t hash;
+
+        apr_snprintf(key, sizeof(key), "%s%d", prefix, i);
+        hash = apr_memcache_hash(memcache, key, strlen(key));
+        map[i] = apr_memcache_find_server_hash(memcache, hash);
+    }
+}
+
+static void consistent_check(abts_case *tc, apr_memcache_t *memcache,
+                             int ketama)
+{
+    apr_pool_t *pool = p;
+    apr_status_t rv;
+    apr_memcache_continuum_t *continuum;
+    apr_memcache_server_t *server;
+    apr_memcache_server_t *before[CONSISTENT_KEYS], *after[CONSISTENT_KEYS];
+    int i, moved, mapped;
+
+    for (i = 0; i < CONSISTENT_SERVERS; i++) {
+        rv = apr_memcache_server_create(pool, HOST, PORT + i, 0, 1, 1, 60,
+                                        &server);
+        ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+        rv = apr_memcache_add_server(memcache, server);
+        ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+    }
+    if (ketama) {
+        rv = apr_memcache_continuum_create(&continuum, memcache, 0, pool);
+        ABTS_ASSERT(tc, "continuum create failed", rv == APR_SUCCESS);
+        memcache->server_baton = continuum;
+    }
+    consistent_map(memcache, before);
+
+    /* every server gets some keys */
+    for (i = 0, mapped = 0; i < CONSISTENT_KEYS; i++) {
+        ABTS_PTR_NOTNULL(tc, before[i]);
+        if (before[i] == memcache->live_servers[0]) {
+            mapped++;
+        }
+    }
+    ABTS_ASSERT(tc, "server has no key", mapped > 0);
+
+    /* one more server takes about 1/41 of the keys */
+    rv = apr_memcache_server_create(pool, HOST, PORT + i, 0, 1, 1, 60,
+                                    &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_memcache_add_server(memcache, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+    if (ketama) {
+        rv = apr_memcache_continuum_create(&continuum, memcache, 0, pool);
+        ABTS_ASSERT(tc, "continuum create failed", rv == APR_SUCCESS);
+        memcache->server_baton = continuum;
+    }
+    consistent_map(memcache, after);
+    for (i = 0, moved = 0; i < CONSISTENT_KEYS; i++) {
+        if (after[i] != before[i]) {
+            ABTS_PTR_EQUAL(tc, server, after[i]);
+            moved++;
+        }
+    }
+    ABTS_ASSERT(tc, "too many keys moved", moved < CONSISTENT_KEYS / 10);
+
+    /* only the keys of a dead server move */
+    consistent_map(memcache, before);
+    server = memcache->live_servers[CONSISTENT_SERVERS / 2];
+    rv = apr_memcache_disable_server(memcache, server);
+    ABTS_ASSERT(tc, "server disable failed", rv == APR_SUCCESS);
+    consistent_map(memcache, after);
+    for (i = 0, moved = 0; i < CONSISTENT_KEYS; i++) {
+        ABTS_PTR_NOTNULL(tc, after[i]);
+        ABTS_ASSERT(tc, "dead server selected", after[i] != server);
+        if (after[i] != before[i]) {
+            ABTS_PTR_EQUAL(tc, server, before[i]);
+            moved++;
+        }
+    }
+    ABTS_ASSERT(tc, "too many keys moved", moved < CONSISTENT_KEYS / 10);
+
+    rv = apr_memcache_enable_server(memcache, server);
+    ABTS_ASSERT(tc, "server enable failed", rv == APR_SUCCESS);
+    consistent_map(memcache, after);
+    for (i = 0; i < CONSISTENT_KEYS; i++) {
+        ABTS_PTR_EQUAL(tc, before[i], after[i]);
+    }
+}
+
+static void test_memcache_ketama(abts_case * tc, void *data)
+{
+    apr_status_t rv;
+    apr_memcache_t *memcache;
+
+    rv = apr_memcache_create(p, CONSISTENT_SERVERS + 1, 0, &memcache);
+    ABTS_ASSERT(tc, "memcache create failed", rv == APR_SUCCESS);
+
+    memcache->hash_func = apr_memcache_hash_ketama;
+    memcache->server_func = apr_memcache_find_server_hash_ketama;
+    consistent_check(tc, memcache, 1);
+}
+
+static void test_memcache_jump(abts_case * tc, void *data)
+{
+    apr_status_t rv;
+    apr_memcache_t *memcache;
+
+    rv = apr_memcache_create(p, CONSISTENT_SERVERS + 1, 0, &memcache);
+    ABTS_ASSERT(tc, "memcache create failed", rv == APR_SUCCESS);
+
+    memcache->hash_func = apr_memcache_hash_crc32;
+    memcache->server_func = apr_memcache_find_server_hash_jump;
+    consistent_check(tc, memcache, 0);
+}
+
+#if APR_HAS_THREADS
+
+/* a memcached answering the get and meta commands, the keys starting with
+ * "miss" being not found and those starting with "exist" having another
+ * CAS, no server needs to be running.
+ */
+
+#define FAKE_SERVERS 2
+#define FAKE_KEYS 50
+#define FAKE_MAX_KEYS 7
+
+typedef struct {
+    apr_socket_t *listener;
+    char last[256];
+    int lines;
+    int keys;
+    int max_keys;
+} fake_server_t;
+
+static void fake_send(apr_socket_t *sock, const char *data)
+{
+    apr_size_t len, left = strlen(data);
+
+    while (left) {
+        len = left;
+        if (apr_socket_send(sock, data, &len) != APR_SUCCESS) {
+            break;
+        }
+        data += len;
+        left -= len;
+    }
+}
+
+static void fake_reply(apr_socket_t *sock, fake_server_t *fs, char *line,
+                       apr_pool_t *pool)
+{
+    char *key, *last;
+    int keys = 0;
+
+    /* the data of a set */
+    if (strncmp(line, "get ", 4) != 0 && line[0] != 'm') {
+        return;
+    }
+    apr_cpystrn(fs->last, line, sizeof(fs->last));
+
+    if (strncmp(line, "mn", 2) == 0) {
+        fs->lines++;
+        fake_send(sock, "MN\r\n");
+        return;
+    }
+    if (line[0] == 'm') {
+        char *opaque;
+
+        apr_strtok(line, " ", &last);
+        key = apr_strtok(NULL, " ", &last);
+        opaque = strstr(last, " O");
+        if (strncmp(line, "mg", 2) == 0) {
+            fs->keys++;
+            if (strncmp(key, "miss", 4) == 0) {
+                if (!strstr(last, " q")) {
+                    fake_send(sock, "EN\r\n");
+                }
+            }
+            else {
+                const char *data = apr_pstrcat(pool, key, txt, NULL);
+
+                fake_send(sock, apr_psprintf(pool, "VA %" APR_SIZE_T_FMT
+                                             " f7 c42%s\r\n%s\r\n",
+                                             strlen(data),
+                                             opaque ? opaque : "", data));
+            }
+        }
+        else if (strncmp(key, "miss", 4) == 0) {
+            fake_send(sock, "NF\r\n");
+        }
+        else if (strncmp(key, "exist", 5) == 0) {
+            fake_send(sock, "EX\r\n");
+        }
+        else {
+            fake_send(sock, line[1] == 's' ? "HD c43\r\n" : "HD\r\n");
+        }
+        return;
+    }
+
+    fs->lines++;
+    for (key = apr_strtok(line + 4, " ", &last); key;
+         key = apr_strtok(NULL, " ", &last)) {
+        const char *data;
+
+        keys++;
+        if (strncmp(key, "miss", 4) == 0) {
+            continue;
+        }
+        data = apr_pstrcat(pool, key, txt, NULL);
+        fake_send(sock, apr_psprintf(pool, "VALUE %s 7 %" APR_SIZE_T_FMT
+                                     "\r\n%s\r\n",
+                                     key, strlen(data), data));
+    }
+    fake_send(sock, "END\r\n");
+
+    fs->keys += keys;
+    if (keys > fs->max_keys) {
+        fs->max_keys = keys;
+    }
+}
+
+static void * APR_THREAD_FUNC fake_server(apr_thread_t *thd, void *data)
+{
+    fake_server_t *fs = data;
+    apr_socket_t *sock;
+    apr_pool_t *pool;
+    char buf[8192];
+    apr_size_t have = 0, len;
+    apr_status_t rv;
+
+    apr_pool_create(&pool, NULL);
+    rv = apr_socket_accept(&sock, fs->listener, pool);
+    if (rv == APR_SUCCESS) {
+        apr_socket_timeout_set(sock, apr_time_from_sec(5));
+        /* until the client closes the connection */
+        for (;;) {
+            char *eol;
+
+            len = sizeof(buf) - 1 - have;
+            rv = apr_socket_recv(sock, buf + have, &len);
+            if (rv != APR_SUCCESS || len == 0) {
+                break;
+            }
+            have += len;
+            buf[have] = '\0';
+            while ((eol = strstr(buf, "\r\n")) != NULL) {
+                *eol = '\0';
+                fake_reply(sock, fs, buf, pool);
+                have -= eol + 2 - buf;
+                memmove(buf, eol + 2, have + 1);
+            }
+        }
+        apr_socket_close(sock);
+    }
+    apr_pool_destroy(pool);
+
+    return NULL;
+}
+
+/* starts n fake servers, each being the only server of a connection */
+static void fake_start(abts_case *tc, apr_pool_t *pool, apr_pool_t *tpool,
+                       apr_uint32_t flags, int n, fake_server_t *fs,
+                       apr_thread_t **threads, apr_memcache_t **memcache)
+{
+    apr_status_t rv;
+    apr_memcache_server_t *server;
+    apr_sockaddr_t *sa;
+    int i;
+
+    memset(fs, 0, n * sizeof(fake_server_t));
+
+    rv = apr_memcache_create(pool, n, flags, memcache);
+    ABTS_ASSERT(tc, "memcache create failed", rv == APR_SUCCESS);
+
+    for (i = 0; i < n; i++) {
+        rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, tpool);
+        APR_ASSERT_SUCCESS(tc, "sockaddr failed", rv);
+        rv = apr_socket_create(&fs[i].listener, sa->family, SOCK_STREAM,
+                               APR_PROTO_TCP, tpool);
+        APR_ASSERT_SUCCESS(tc, "socket create failed", rv);
+        rv = apr_socket_bind(fs[i].listener, sa);
+        APR_ASSERT_SUCCESS(tc, "socket bind failed", rv);
+        rv = apr_socket_listen(fs[i].listener, 1);
+        APR_ASSERT_SUCCESS(tc, "socket listen failed", rv);
+        rv = apr_socket_addr_get(&sa, APR_LOCAL, fs[i].listener);
+        APR_ASSERT_SUCCESS(tc, "socket addr failed", rv);
+
+        /* a single connection, which the server accepts */
+        rv = apr_memcache_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1,
+                                        apr_time_from_sec(60), &server);
+        ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+        rv = apr_memcache_add_server(*memcache, server);
+        ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+
+        rv = apr_thread_create(&threads[i], NULL, fake_server, &fs[i], tpool);
+        APR_ASSERT_SUCCESS(tc, "thread create failed", rv);
+    }
+}
+
+static void multget_check(abts_case *tc, apr_uint32_t flags)
+{
+    apr_pool_t *pool, *tpool;
+    apr_status_t rv;
+    apr_memcache_t *memcache;
+    apr_memcache_multget_t *multget;
+    apr_hash_t *values;
+    apr_thread_t *threads[FAKE_SERVERS];
+    fake_server_t fs[FAKE_SERVERS];
+    int i, n, keys = 0, execs = 0;
+
+    apr_pool_create(&tpool, p);
+    apr_pool_create(&pool, p);
+    fake_start(tc, pool, tpool, flags, FAKE_SERVERS, fs, threads, &memcache);
+
+    rv = apr_memcache_multget_create(&multget, memcache, FAKE_MAX_KEYS,
+                                     apr_time_from_sec(5), pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the context is reused, the second time with fewer keys */
+    for (n = FAKE_KEYS; n > 0; n -= FAKE_KEYS - 3) {
+        values = NULL;
+        for (i = 0; i < n; i++) {
+            apr_memcache_add_multget_key(pool,
+                                         apr_psprintf(pool, "%s%d",
+                                                      i % 5 ? "key" : "miss",
+                                                      i),
+                                         &values);
+        }
+        keys += n;
+        execs++;
+
+        rv = apr_memcache_multget_exec(multget, pool, values);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, n, apr_hash_count(values));
+
+        for (i = 0; i < n; i++) {
+            const char *key = apr_psprintf(pool, "%s%d",
+                                           i % 5 ? "key" : "miss", i);
+            apr_memcache_value_t *value = apr_hash_get(values, key,
+                                                       APR_HASH_KEY_STRING);
+
+            ABTS_PTR_NOTNULL(tc, value);
+            if (i % 5 == 0) {
+                ABTS_INT_EQUAL(tc, APR_NOTFOUND, value->status);
+                continue;
+            }
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, value->status);
+            ABTS_INT_EQUAL(tc, 7, value->flags);
+            ABTS_STR_EQUAL(tc, apr_pstrcat(pool, key, txt, NULL),
+                           value->data);
+            ABTS_INT_EQUAL(tc, strlen(key) + strlen(txt), value->len);
+        }
+    }
+
+    /* closes the connections, ending the servers */
+    apr_pool_destroy(pool);
+    n = 0;
+    for (i = 0; i < FAKE_SERVERS; i++) {
+        apr_thread_join(&rv, threads[i]);
+        if (flags & APR_MEMCACHE_META) {
+            /* one mg per key, then one mn */
+            ABTS_INT_EQUAL(tc, execs, fs[i].lines);
+        }
+        else {
+            ABTS_TRUE(tc, fs[i].lines > 0);
+            ABTS_TRUE(tc, fs[i].max_keys <= FAKE_MAX_KEYS);
+        }
+        n += fs[i].keys;
+    }
+    ABTS_INT_EQUAL(tc, keys, n);
+
+    apr_pool_destroy(tpool);
+}
+
+static void test_memcache_multget_exec(abts_case * tc, void *data)
+{
+    multget_check(tc, 0);
+}
+
+static void test_memcache_multget_meta(abts_case * tc, void *data)
+{
+    multget_check(tc, APR_MEMCACHE_META);
+}
+
+static void test_memcache_meta_cmds(abts_case * tc, void *data)
+{
+    apr_pool_t *pool, *tpool;
+    apr_status_t rv;
+    apr_memcache_t *memcache;
+    apr_thread_t *thread;
+    fake_server_t fs;
+    apr_uint64_t cas = 0;
+    apr_uint16_t flags = 0;
+    apr_size_t len;
+    char *result;
+
+    apr_pool_create(&tpool, p);
+    apr_pool_create(&pool, p);
+    fake_start(tc, pool, tpool, APR_MEMCACHE_META, 1, &fs, &thread,
+               &memcache);
+
+    /* the value, its flags and CAS, and a new TTL in one round trip */
+    rv = apr_memcache_meta_getp(memcache, pool, "key1", 30, &result, &len,
+                                &flags, &cas);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "mg key1 v f c T30", fs.last);
+    ABTS_STR_EQUAL(tc, apr_pstrcat(pool, "key1", txt, NULL), result);
+    ABTS_INT_EQUAL(tc, strlen(result), len);
+    ABTS_INT_EQUAL(tc, 7, flags);
+    ABTS_TRUE(tc, cas == 42);
+
+    rv = apr_memcache_meta_getp(memcache, pool, "miss1", -1, &result, &len,
+                                NULL, NULL);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    ABTS_STR_EQUAL(tc, "mg miss1 v f c", fs.last);
+
+    rv = apr_memcache_meta_set(memcache, "key2", "data", 4, 60, 3, cas,
+                               &cas);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "ms key2 4 T60 F3 C42 c", fs.last);
+    ABTS_TRUE(tc, cas == 43);
+
+    rv = apr_memcache_meta_set(memcache, "exist2", "data", 4, 60, 0, cas,
+                               NULL);
+    ABTS_INT_EQUAL(tc, APR_EEXIST, rv);
+    rv = apr_memcache_meta_set(memcache, "miss2", "data", 4, 60, 0, cas,
+                               NULL);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    rv = apr_memcache_meta_delete(memcache, "key3", 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "md key3", fs.last);
+    rv = apr_memcache_meta_delete(memcache, "exist3", 42);
+    ABTS_INT_EQUAL(tc, APR_EEXIST, rv);
+    ABTS_STR_EQUAL(tc, "md exist3 C42", fs.last);
+    rv = apr_memcache_meta_delete(memcache, "miss3", 0);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    apr_pool_destroy(pool);
+    apr_thread_join(&rv, thread);
+    apr_pool_destroy(tpool);
+}
+
+static void test_memcache_nearcache(abts_case * tc, void *data)
+{
+    apr_pool_t *pool, *tpool, *qpool;
+    apr_status_t rv;
+    apr_memcache_t *memcache;
+    apr_memcache_value_t *value;
+    apr_hash_t *values = NULL;
+    apr_thread_t *thread;
+    fake_server_t fs;
+    apr_uint16_t flags = 0;
+    apr_size_t len;
+    char *result;
+    int i;
+
+    apr_pool_create(&tpool, p);
+    apr_pool_create(&pool, p);
+    apr_pool_create(&qpool, p);
+    fake_start(tc, pool, tpool, 0, 1, &fs, &thread, &memcache);
+    rv = apr_nearcache_create(&memcache->nearcache, 64 * 1024, 0, 0, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* got from the server once */
+    for (i = 0; i < 2; i++) {
+        rv = apr_memcache_getp(memcache, pool, "key1", &result, &len, &flags);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_STR_EQUAL(tc, apr_pstrcat(pool, "key1", txt, NULL), result);
+        ABTS_INT_EQUAL(tc, strlen(result), len);
+        ABTS_INT_EQUAL(tc, 7, flags);
+    }
+
+    /* only the keys not cached are queried */
+    apr_memcache_add_multget_key(pool, "key1", &values);
+    apr_memcache_add_multget_key(pool, "key2", &values);
+    apr_memcache_add_multget_key(pool, "miss3", &values);
+    rv = apr_memcache_multgetp(memcache, qpool, pool, values);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_EQUAL(tc, NULL, strstr(fs.last, "key1"));
+    value = apr_hash_get(values, "key1", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, value->status);
+    ABTS_STR_EQUAL(tc, apr_pstrcat(pool, "key1", txt, NULL), value->data);
+    value = apr_hash_get(values, "miss3", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, value->status);
+    rv = apr_memcache_getp(memcache, pool, "key2", &result, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* a write invalidates */
+    rv = apr_memcache_meta_delete(memcache, "key1", 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_memcache_getp(memcache, pool, "key1", &result, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "get key1", fs.last);
+
+    apr_pool_destroy(pool);
+    apr_thread_join(&rv, thread);
+    ABTS_INT_EQUAL(tc, 4, fs.keys);
+    apr_pool_destroy(tpool);
+    apr_pool_destroy(qpool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+/* The asynchronous connection is served by the test itself, the replies
+ * being sent a few bytes at a time to be parsed as they come.
+ */
+
+typedef struct {
+    int n;
+    apr_status_t status[8];
+} async_results_t;
+
+static void async_done(apr_memcache_async_t *ac, apr_status_t status,
+                       void *baton)
+{
+    async_results_t *r = baton;
+
+    r->status[r->n++] = status;
+}
+
+static apr_status_t async_poll_cb(void *baton, apr_pollfd_t *pfd)
+{
+    return apr_memcache_async_process(pfd->client_data, pfd->rtnevents);
+}
+
+static void async_recv(abts_case *tc, apr_socket_t *sock,
+                       const char *expected)
+{
+    apr_size_t len = strlen(expected), have = 0, n;
+    char buf[512];
+
+    while (have < len) {
+        n = len - have;
+        if (apr_socket_recv(sock, buf + have, &n) != APR_SUCCESS) {
+            break;
+        }
+        have += n;
+    }
+    buf[have] = '\0';
+    ABTS_STR_EQUAL(tc, expected, buf);
+}
+
+static const char async_replies[] =
+    "STORED\r\n"
+    "VALUE k1 5 2\r\nv1\r\nEND\r\n"
+    "END\r\n"
+    "VALUE k1 5 2\r\nv1\r\nVALUE k2 0 3 42\r\nabc\r\nEND\r\n"
+    "NOT_STORED\r\n"
+    "SERVER_ERROR out of memory\r\n";
+
+static void test_memcache_async(abts_case * tc, void *data)
+{
+    apr_pool_t *pool;
+    apr_status_t rv;
+    apr_memcache_server_t *server;
+    apr_memcache_async_t *ac;
+    apr_memcache_value_t v1 = { 0 }, missing = { 0 }, *mv;
+    apr_hash_t *values = NULL;
+    apr_hash_index_t *hi;
+    apr_pollcb_t *pollcb;
+    apr_socket_t *listener, *sock;
+    apr_sockaddr_t *sa;
+    async_results_t results = { 0 };
+    const char *request, *get;
+    apr_size_t i;
+
+    apr_pool_create(&pool, p);
+
+    rv = apr_pollcb_create(&pollcb, 4, pool, 0);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        apr_pool_destroy(pool);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "pollcb create failed", rv);
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, pool);
+    APR_ASSERT_SUCCESS(tc, "sockaddr failed", rv);
+    rv = apr_socket_create(&listener, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, pool);
+    APR_ASSERT_SUCCESS(tc, "socket create failed", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "socket bind failed", rv);
+    rv = apr_socket_listen(listener, 1);
+    APR_ASSERT_SUCCESS(tc, "socket listen failed", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "socket addr failed", rv);
+
+    rv = apr_memcache_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1, 60,
+                                    &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_memcache_async_create(&ac, server, pollcb, NULL, pool);
+    APR_ASSERT_SUCCESS(tc, "async create failed", rv);
+    rv = apr_socket_accept(&sock, listener, pool);
+    APR_ASSERT_SUCCESS(tc, "socket accept failed", rv);
+    apr_socket_timeout_set(sock, apr_time_from_sec(5));
+
+    /* all sent before any reply */
+    v1.key = "k1";
+    missing.key = "missing";
+    apr_memcache_add_multget_key(pool, "k1", &values);
+    apr_memcache_add_multget_key(pool, "k2", &values);
+    apr_memcache_add_multget_key(pool, "k3", &values);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_set(ac, "k1", "v1", 2, 0, 5,
+                                          async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_getp(ac, pool, &v1,
+                                           async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_getp(ac, pool, &missing,
+                                           async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_multgetp(ac, pool, values,
+                                               async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_set(ac, "k1", "v2", 2, 0, 0,
+                                          async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_set(ac, "k1", "v3", 2, 0, 0,
+                                          async_done, &results));
+    ABTS_SIZE_EQUAL(tc, 6, apr_memcache_async_pending(ac));
+
+    get = "get";
+    for (hi = apr_hash_first(pool, values); hi; hi = apr_hash_next(hi)) {
+        mv = apr_hash_this_val(hi);
+        get = apr_pstrcat(pool, get, " ", mv->key, NULL);
+    }
+    request = apr_pstrcat(pool, "set k1 5 0 2\r\nv1\r\n"
+                          "get k1\r\n"
+                          "get missing\r\n",
+                          get, "\r\n"
+                          "set k1 0 0 2\r\nv2\r\n"
+                          "set k1 0 0 2\r\nv3\r\n", NULL);
+    async_recv(tc, sock, request);
+
+    for (i = 0; i < sizeof(async_replies) - 1; i += 7) {
+        apr_size_t len = sizeof(async_replies) - 1 - i;
+
+        if (len > 7) {
+            len = 7;
+        }
+        apr_socket_send(sock, async_replies + i, &len);
+        rv = apr_pollcb_poll(pollcb, apr_time_from_sec(1), async_poll_cb,
+                             NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, 6, results.n);
+    ABTS_SIZE_EQUAL(tc, 0, apr_memcache_async_pending(ac));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, results.status[0]);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, results.status[1]);
+    ABTS_STR_EQUAL(tc, "v1", v1.data);
+    ABTS_INT_EQUAL(tc, 5, v1.flags);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, results.status[2]);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, missing.status);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, results.status[3]);
+    mv = apr_hash_get(values, "k1", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, mv->status);
+    ABTS_STR_EQUAL(tc, "v1", mv->data);
+    mv = apr_hash_get(values, "k2", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, mv->status);
+    ABTS_SIZE_EQUAL(tc, 3, mv->len);
+    ABTS_STR_EQUAL(tc, "abc", mv->data);
+    mv = apr_hash_get(values, "k3", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, mv->status);
+    ABTS_INT_EQUAL(tc, APR_EEXIST, results.status[4]);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, results.status[5]);
+
+    /* the pending commands fail with the connection */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_memcache_async_getp(ac, pool, &v1,
+                                           async_done, &results));
+    apr_socket_close(sock);
+    rv = apr_pollcb_poll(pollcb, apr_time_from_sec(1), async_poll_cb, NULL);
+    ABTS_TRUE(tc, rv != APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, 7, results.n);
+    ABTS_INT_EQUAL(tc, rv, results.status[6]);
+    ABTS_INT_EQUAL(tc, rv, apr_memcache_async_getp(ac, pool, &v1,
+                                                   async_done, &results));
+    ABTS_INT_EQUAL(tc, 7, results.n);
+
+    apr_pool_destroy(pool);
+}
+
 abts_suite *testmemcache(abts_suite * suite)
 {
     suite = ADD_SUITE(suite);
@@ -672,6 +1368,15 @@ abts_suite *testmemcache(abts_suite * suite)
     abts_run_test(suite, test_memcache_multiget, NULL);
     abts_run_test(suite, test_memcache_addreplace, NULL);
     abts_run_test(suite, test_memcache_incrdecr, NULL);
+    abts_run_test(suite, test_memcache_ketama, NULL);
+    abts_run_test(suite, test_memcache_jump, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_memcache_multget_exec, NULL);
+    abts_run_test(suite, test_memcache_multget_meta, NULL);
+    abts_run_test(suite, test_memcache_meta_cmds, NULL);
+    abts_run_test(suite, test_memcache_nearcache, NULL);
+#endif
+    abts_run_test(suite, test_memcache_async, NULL);
 
     return suite;
 }
@@ -174,6 +174,67 @@ static void test_mmap_offset(abts_case *tc, void *data)
     ABTS_STR_NEQUAL(tc, addr, thisfdata + 5, thisfsize - 5);
 }
 
+static void test_mmap_hints(abts_case *tc, void *data)
+{
+    apr_off_t *offset = data;
+    apr_mmap_t *mm;
+    apr_status_t rv;
+
+    rv = apr_mmap_create(&mm, thefile, *offset, thisfsize,
+                         APR_MMAP_READ | APR_MMAP_SEQUENTIAL
+                         | APR_MMAP_WILLNEED | APR_MMAP_HUGEPAGE, ptest);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_NEQUAL(tc, mm->mm, thisfdata, thisfsize);
+    rv = apr_mmap_delete(mm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_mmap_cache(abts_case *tc, void *data)
+{
+    apr_off_t *offset = data;
+    apr_mmap_cache_t *cache;
+    apr_mmap_t *mm1, *mm2, *dup;
+    apr_pool_t *pool;
+    void *addr;
+    apr_status_t rv;
+
+    rv = apr_mmap_cache_create(&cache, 0, ptest);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "mapping cache");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_pool_create(&pool, ptest);
+    rv = apr_mmap_cache_get(&mm1, cache, thefile, *offset, thisfsize,
+                            APR_MMAP_READ, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_NEQUAL(tc, mm1->mm, thisfdata, thisfsize);
+    rv = apr_mmap_cache_get(&mm2, cache, thefile, *offset, thisfsize,
+                            APR_MMAP_READ | APR_MMAP_RANDOM, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_EQUAL(tc, mm1->mm, mm2->mm);
+    addr = mm1->mm;
+
+    /* The region outlives the first ring */
+    rv = apr_mmap_dup(&dup, mm1, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_mmap_delete(mm1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_mmap_delete(dup);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_NEQUAL(tc, mm2->mm, thisfdata, thisfsize);
+
+    /* Not sharing the region of another size */
+    rv = apr_mmap_cache_get(&mm1, cache, thefile, *offset, thisfsize - 1,
+                            APR_MMAP_READ, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_TRUE(tc, addr != mm1->mm);
+    ABTS_STR_NEQUAL(tc, mm1->mm, thisfdata, thisfsize - 1);
+
+    apr_pool_destroy(pool);
+}
+
 #endif
 
 abts_suite *testmmap(abts_suite *suite)
@@ -194,6 +255,8 @@ abts_suite *testmmap(abts_suite *suite)
         abts_run_test(suite, test_mmap_contents, &test_set[i].offset);
         abts_run_test(suite, test_mmap_offset, &test_set[i].offset);
         abts_run_test(suite, test_mmap_delete, NULL);
+        abts_run_test(suite, test_mmap_hints, &test_set[i].offset);
+        abts_run_test(suite, test_mmap_cache, &test_set[i].offset);
         abts_run_test(suite, test_file_close, NULL);
         apr_pool_clear(ptest);
     }
@@ -216,6 +216,9 @@ int main(void)
 #endif
 #if APR_HAS_PROC_PTHREAD_SERIALIZE
         ,{APR_LOCK_PROC_PTHREAD, "proc_pthread"}
+#endif
+#if APR_HAS_FUTEX_SERIALIZE
+        ,{APR_LOCK_FUTEX, "futex"}
 #endif
         ,{APR_LOCK_DEFAULT_TIMED, "default_timed"}
     };
@@ -0,0 +1,202 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_nearcache.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#include <string.h>
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_nearcache_t *nc;
+    apr_status_t rv;
+
+    rv = apr_nearcache_create(&nc, 4096, -1, 0, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_nearcache_create(&nc, 4096, 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_create(&nc, 4096, 0, 3, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_get_set(abts_case *tc, void *data)
+{
+    apr_nearcache_t *nc;
+    apr_nearcache_stats_t stats;
+    apr_uint16_t flags;
+    apr_size_t len;
+    char *value;
+    apr_status_t rv;
+
+    rv = apr_nearcache_create(&nc, 64 * 1024, 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_nearcache_get(nc, "key", 3, p, &value, &len, &flags);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    rv = apr_nearcache_set(nc, "key", 3, "value", 5, 42, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_get(nc, "key", 3, p, &value, &len, &flags);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "value", value);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+    ABTS_INT_EQUAL(tc, 42, flags);
+
+    /* Replaced */
+    rv = apr_nearcache_set(nc, "key", 3, "other", 5, 0, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_get(nc, "key", 3, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "other", value);
+
+    apr_nearcache_delete(nc, "key", 3);
+    rv = apr_nearcache_get(nc, "key", 3, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    apr_nearcache_stats_get(nc, &stats);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.hits);
+    ABTS_INT_EQUAL(tc, 2, (int)stats.misses);
+    ABTS_SIZE_EQUAL(tc, 0, stats.entries);
+    ABTS_SIZE_EQUAL(tc, 0, stats.bytes);
+}
+
+static void test_expiry(abts_case *tc, void *data)
+{
+    apr_nearcache_t *nc;
+    apr_size_t len;
+    char *value;
+    apr_status_t rv;
+
+    rv = apr_nearcache_create(&nc, 64 * 1024, apr_time_from_sec(60), 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_nearcache_set(nc, "short", 5, "value", 5, 0,
+                           apr_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_set(nc, "long", 4, "value", 5, 0, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_sleep(apr_time_from_msec(20));
+    rv = apr_nearcache_get(nc, "short", 5, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_nearcache_get(nc, "long", 4, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_eviction(abts_case *tc, void *data)
+{
+    apr_nearcache_t *nc;
+    apr_nearcache_stats_t stats;
+    char big[1024];
+    apr_size_t len;
+    char *value;
+    apr_status_t rv;
+    int i;
+
+    memset(big, 'x', sizeof(big));
+
+    /* A single shard, room for about three values */
+    rv = apr_nearcache_create(&nc, 3 * sizeof(big) + 512, 0, 1, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 3; i++) {
+        char *key = apr_itoa(p, i);
+        rv = apr_nearcache_set(nc, key, strlen(key), big, sizeof(big), 0, 0);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* Using "0" makes "1" the least recently used, evicted for "3" */
+    rv = apr_nearcache_get(nc, "0", 1, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_set(nc, "3", 1, big, sizeof(big), 0, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_nearcache_get(nc, "1", 1, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_nearcache_get(nc, "0", 1, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_get(nc, "2", 1, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_nearcache_get(nc, "3", 1, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_nearcache_stats_get(nc, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.evictions);
+    ABTS_SIZE_EQUAL(tc, 3, stats.entries);
+    ABTS_TRUE(tc, stats.bytes <= 3 * sizeof(big) + 512);
+
+    /* Too big for the shard, and the previous value goes */
+    rv = apr_nearcache_set(nc, "0", 1, big, sizeof(big), 0, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    {
+        char *huge = apr_palloc(p, 4 * sizeof(big));
+        rv = apr_nearcache_set(nc, "0", 1, huge, 4 * sizeof(big), 0, 0);
+        ABTS_INT_EQUAL(tc, APR_ENOSPC, rv);
+    }
+    rv = apr_nearcache_get(nc, "0", 1, p, &value, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    apr_nearcache_clear(nc);
+    apr_nearcache_stats_get(nc, &stats);
+    ABTS_SIZE_EQUAL(tc, 0, stats.entries);
+    ABTS_SIZE_EQUAL(tc, 0, stats.bytes);
+}
+
+static void test_shards(abts_case *tc, void *data)
+{
+    apr_nearcache_t *nc;
+    apr_nearcache_stats_t stats;
+    apr_size_t len;
+    char *value;
+    apr_status_t rv;
+    int i, found = 0;
+
+    rv = apr_nearcache_create(&nc, 1024 * 1024, 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 1000; i++) {
+        char *key = apr_psprintf(p, "key%d", i);
+        rv = apr_nearcache_set(nc, key, strlen(key), key, strlen(key), 0, 0);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < 1000; i++) {
+        char *key = apr_psprintf(p, "key%d", i);
+        if (apr_nearcache_get(nc, key, strlen(key), p, &value, &len,
+                              NULL) == APR_SUCCESS && !strcmp(key, value)) {
+            found++;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 1000, found);
+
+    apr_nearcache_stats_get(nc, &stats);
+    ABTS_SIZE_EQUAL(tc, 1000, stats.entries);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.evictions);
+}
+
+abts_suite *testnearcache(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_get_set, NULL);
+    abts_run_test(suite, test_expiry, NULL);
+    abts_run_test(suite, test_eviction, NULL);
+    abts_run_test(suite, test_shards, NULL);
+
+    return suite;
+}
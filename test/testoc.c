@@ -20,6 +20,7 @@
 #include "apr_general.h"
 #include "apr_lib.h"
 #include "apr_strings.h"
+#include "apr_poll.h"
 
 #if APR_HAS_OTHER_CHILD
 
@@ -96,6 +97,72 @@ static void test_child_kill(abts_case *tc, void *data)
     apr_proc_other_child_refresh_all(APR_OC_REASON_RUNNING);
     ABTS_STR_EQUAL(tc, "APR_OC_REASON_DEATH", reasonstr);
 }    
+
+static void test_child_exit_file(abts_case *tc, void *data)
+{
+    apr_proc_t newproc;
+    apr_procattr_t *procattr = NULL;
+    apr_pollset_t *pollset;
+    apr_pollfd_t pfd;
+    const apr_pollfd_t *descs;
+    apr_file_t *exitfile;
+    apr_int32_t num;
+    const char *args[3];
+    apr_status_t rv;
+
+    args[0] = apr_pstrdup(p, "occhild" EXTENSION);
+    args[1] = apr_pstrdup(p, "-X");
+    args[2] = NULL;
+
+    rv = apr_procattr_create(&procattr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_procattr_io_set(procattr, APR_FULL_BLOCK, APR_NO_PIPE, 
+                             APR_NO_PIPE);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_procattr_cmdtype_set(procattr, APR_PROGRAM_ENV);
+    APR_ASSERT_SUCCESS(tc, "Couldn't set copy environment", rv);
+
+    rv = apr_proc_create(&newproc, TESTBINPATH "occhild" EXTENSION, args, NULL, procattr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_proc_exit_file_get(&exitfile, &newproc, p);
+    if (rv == APR_ENOTIMPL) {
+        apr_proc_kill(&newproc, SIGKILL);
+        apr_proc_wait(&newproc, NULL, NULL, APR_WAIT);
+        ABTS_NOT_IMPL(tc, "Process exit file not implemented on this platform");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "Couldn't get the exit file", rv);
+
+    reasonstr[0] = '\0';
+    apr_proc_other_child_register(&newproc, ocmaint, &newproc, newproc.in, p);
+
+    rv = apr_pollset_create(&pollset, 1, p, 0);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create pollset", rv);
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.desc_type = APR_POLL_FILE;
+    pfd.desc.f = exitfile;
+    pfd.reqevents = APR_POLLIN;
+    pfd.p = p;
+    rv = apr_pollset_add(pollset, &pfd);
+    APR_ASSERT_SUCCESS(tc, "Couldn't add the exit file", rv);
+
+    rv = apr_pollset_poll(pollset, 0, &num, &descs);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    rv = apr_proc_kill(&newproc, SIGKILL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_pollset_poll(pollset, apr_time_from_sec(10), &num, &descs);
+    APR_ASSERT_SUCCESS(tc, "Exit file not signaled", rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+
+    rv = apr_proc_other_child_refresh_proc(&newproc, APR_OC_REASON_RUNNING);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "APR_OC_REASON_DEATH", reasonstr);
+
+    apr_proc_other_child_unregister(&newproc);
+}
 #else
 
 static void oc_not_impl(abts_case *tc, void *data)
@@ -113,6 +180,7 @@ abts_suite *testoc(abts_suite *suite)
 #else
 
     abts_run_test(suite, test_child_kill, NULL); 
+    abts_run_test(suite, test_child_exit_file, NULL);
 
 #endif
     return suite;
@@ -23,6 +23,8 @@
 #include "apr_thread_pool.h"
 #include "apr_md5.h"
 #include "apr_sha1.h"
+#include "apr_time.h"
+#include "apr_thread_cond.h"
 
 #include "abts.h"
 #include "testutil.h"
@@ -196,6 +198,155 @@ static void test_bcryptpass(abts_case *tc, void *data)
 }
 
 
+static void test_password_cache(abts_case *tc, void *data)
+{
+    unsigned char salt[] = "anchovy_anchovy";
+    apr_password_cache_t *cache;
+    apr_time_t first, cached;
+    char hash[100];
+    int i;
+
+    APR_ASSERT_SUCCESS(tc, "bcrypt encode password",
+                       apr_bcrypt_encode("s3cret", 8, salt, sizeof(salt),
+                                         hash, sizeof(hash)));
+    APR_ASSERT_SUCCESS(tc, "create cache",
+                       apr_password_cache_create(&cache, 16,
+                                                 apr_time_from_sec(60), p));
+
+    first = apr_time_now();
+    APR_ASSERT_SUCCESS(tc, "validated",
+                       apr_password_validate_cached(cache, "joe", "s3cret",
+                                                    hash));
+    first = apr_time_now() - first;
+
+    /* a hundred lookups still take less than a single bcrypt */
+    cached = apr_time_now();
+    for (i = 0; i < 100; i++) {
+        APR_ASSERT_SUCCESS(tc, "validated again",
+                           apr_password_validate_cached(cache, "joe",
+                                                        "s3cret", hash));
+    }
+    cached = apr_time_now() - cached;
+    ABTS_ASSERT(tc, apr_psprintf(p, "cached validations (%" APR_TIME_T_FMT
+                                 "us) faster than one (%" APR_TIME_T_FMT "us)",
+                                 cached, first),
+                cached < first);
+
+    ABTS_INT_EQUAL(tc, APR_EMISMATCH,
+                   apr_password_validate_cached(cache, "joe", "s3cret2",
+                                                hash));
+    ABTS_INT_EQUAL(tc, APR_EMISMATCH,
+                   apr_password_validate_cached(cache, "joe", "s3cre",
+                                                hash));
+
+    /* more credentials than the cache holds */
+    for (i = 0; i < 40; i++) {
+        char *user = apr_psprintf(p, "user%d", i);
+        char *sha = apr_palloc(p, 100);
+
+        apr_sha1_base64(user, (int)strlen(user), sha);
+        APR_ASSERT_SUCCESS(tc, "SHA1 validated",
+                           apr_password_validate_cached(cache, user, user,
+                                                        sha));
+        APR_ASSERT_SUCCESS(tc, "SHA1 validated again",
+                           apr_password_validate_cached(cache, user, user,
+                                                        sha));
+        ABTS_INT_EQUAL(tc, APR_EMISMATCH,
+                       apr_password_validate_cached(cache, user, "x", sha));
+    }
+
+    apr_password_cache_clear(cache);
+    APR_ASSERT_SUCCESS(tc, "validated after clear",
+                       apr_password_validate_cached(cache, "joe", "s3cret",
+                                                    hash));
+    APR_ASSERT_SUCCESS(tc, "validated without cache",
+                       apr_password_validate_cached(NULL, NULL, "s3cret",
+                                                    hash));
+}
+
+#if APR_HAS_THREADS
+
+#define NUM_ASYNC 8
+
+typedef struct {
+    apr_thread_mutex_t *mutex;
+    apr_thread_cond_t *cond;
+    apr_status_t status[NUM_ASYNC];
+    int count;
+} async_results_t;
+
+typedef struct {
+    async_results_t *results;
+    int i;
+} async_baton_t;
+
+static void async_done(void *baton, apr_status_t status)
+{
+    async_baton_t *b = baton;
+
+    apr_thread_mutex_lock(b->results->mutex);
+    b->results->status[b->i] = status;
+    b->results->count++;
+    apr_thread_cond_signal(b->results->cond);
+    apr_thread_mutex_unlock(b->results->mutex);
+}
+
+static void test_password_async(abts_case *tc, void *data)
+{
+    unsigned char salt[] = "herring_herring";
+    async_baton_t batons[NUM_ASYNC];
+    async_results_t results;
+    apr_password_cache_t *cache;
+    apr_thread_pool_t *tp;
+    char hash[100];
+    int round, i;
+
+    APR_ASSERT_SUCCESS(tc, "bcrypt encode password",
+                       apr_bcrypt_encode("s3cret", 5, salt, sizeof(salt),
+                                         hash, sizeof(hash)));
+    APR_ASSERT_SUCCESS(tc, "create cache",
+                       apr_password_cache_create(&cache, 16,
+                                                 apr_time_from_sec(60), p));
+    APR_ASSERT_SUCCESS(tc, "create thread pool",
+                       apr_thread_pool_create(&tp, 2, 2, p));
+    apr_thread_mutex_create(&results.mutex, APR_THREAD_MUTEX_DEFAULT, p);
+    apr_thread_cond_create(&results.cond, p);
+
+    /* the second round finds the good ones in the cache */
+    for (round = 0; round < 2; round++) {
+        results.count = 0;
+        for (i = 0; i < NUM_ASYNC; i++) {
+            char passwd[8];
+
+            apr_cpystrn(passwd, i % 2 ? "wrong" : "s3cret", sizeof(passwd));
+            batons[i].results = &results;
+            batons[i].i = i;
+            results.status[i] = APR_EGENERAL;
+            APR_ASSERT_SUCCESS(tc, "validation pushed",
+                               apr_password_validate_async(tp, cache,
+                                   "joe", passwd, hash, async_done,
+                                   &batons[i]));
+            /* the strings were copied */
+            memset(passwd, 0, sizeof(passwd));
+        }
+
+        apr_thread_mutex_lock(results.mutex);
+        while (results.count < NUM_ASYNC) {
+            apr_thread_cond_wait(results.cond, results.mutex);
+        }
+        apr_thread_mutex_unlock(results.mutex);
+
+        for (i = 0; i < NUM_ASYNC; i++) {
+            ABTS_INT_EQUAL(tc, i % 2 ? APR_EMISMATCH : APR_SUCCESS,
+                           results.status[i]);
+        }
+    }
+
+    apr_thread_pool_destroy(tp);
+}
+
+#endif /* APR_HAS_THREADS */
+
 abts_suite *testpass(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -209,6 +360,10 @@ abts_suite *testpass(abts_suite *suite)
     abts_run_test(suite, test_shapass, NULL);
     abts_run_test(suite, test_md5pass, NULL);
     abts_run_test(suite, test_bcryptpass, NULL);
+    abts_run_test(suite, test_password_cache, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_password_async, NULL);
+#endif
 #ifdef GLIBCSHA_ALGO_SUPPORTED
     abts_run_test(suite, test_glibc_shapass, NULL);
 #endif
@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "testutil.h"
 #include "apr_file_io.h"
@@ -220,6 +221,56 @@ static void wait_pipe(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Wait for pipe failed", rv);
 }
 
+static void pipe_size(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_size_t size = 0;
+
+    rv = apr_file_pipe_create(&readp, &writep, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create pipe", rv);
+
+    rv = apr_file_pipe_size_get(writep, &size);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_file_pipe_size_get() not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "Couldn't get pipe size", rv);
+    ABTS_ASSERT(tc, "pipe has a size", size > 0);
+
+    /* within the default limit of unprivileged processes on Linux */
+    rv = apr_file_pipe_size_set(writep, 256 * 1024);
+    APR_ASSERT_SUCCESS(tc, "Couldn't set pipe size", rv);
+    rv = apr_file_pipe_size_get(readp, &size);
+    APR_ASSERT_SUCCESS(tc, "Couldn't get pipe size", rv);
+    ABTS_ASSERT(tc, "pipe size was set", size >= 256 * 1024);
+}
+
+static void write_gift(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    char *buf = apr_palloc(p, 8192), out[8192];
+    apr_size_t nbytes, total, i;
+
+    for (i = 0; i < sizeof(out); i++) {
+        buf[i] = 'a' + i % 26;
+    }
+
+    rv = apr_file_pipe_create(&readp, &writep, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create pipe", rv);
+
+    nbytes = sizeof(out);
+    rv = apr_file_pipe_write_gift(writep, buf, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "Couldn't gift to pipe", rv);
+    ABTS_SIZE_EQUAL(tc, sizeof(out), nbytes);
+
+    for (total = 0; total < sizeof(out); total += nbytes) {
+        nbytes = sizeof(out) - total;
+        rv = apr_file_read(readp, out + total, &nbytes);
+        APR_ASSERT_SUCCESS(tc, "Couldn't read from pipe", rv);
+    }
+    ABTS_ASSERT(tc, "data read back", memcmp(buf, out, sizeof(out)) == 0);
+}
+
 abts_suite *testpipe(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -234,6 +285,11 @@ abts_suite *testpipe(abts_suite *suite)
     abts_run_test(suite, test_pipe_writefull, NULL);
     abts_run_test(suite, close_pipe, NULL);
     abts_run_test(suite, wait_pipe, NULL);
+    abts_run_test(suite, close_pipe, NULL);
+    abts_run_test(suite, pipe_size, NULL);
+    abts_run_test(suite, close_pipe, NULL);
+    abts_run_test(suite, write_gift, NULL);
+    abts_run_test(suite, close_pipe, NULL);
 
     return suite;
 }
@@ -567,6 +567,259 @@ static void pollset_remove(abts_case *tc, void *data)
              (hot_files[1].client_data == (void *)1)));
 }
 
+static const apr_pollset_method_e all_methods[] = {
+    APR_POLLSET_SELECT,
+    APR_POLLSET_KQUEUE,
+    APR_POLLSET_PORT,
+    APR_POLLSET_EPOLL,
+    APR_POLLSET_POLL,
+    APR_POLLSET_IOURING
+};
+
+/* The kernel detaches the thread from a destroyed io_uring asynchronously,
+ * interrupting its next blocking system call, so let it happen while
+ * sleeping (which is restarted) rather than in the next test.
+ */
+static void destroy_pollset(abts_case *tc, apr_pollset_t *pollset,
+                            apr_pollset_method_e method)
+{
+    apr_status_t rv;
+
+    rv = apr_pollset_destroy(pollset);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    if (method == APR_POLLSET_IOURING) {
+        apr_sleep(apr_time_from_msec(100));
+    }
+}
+
+static void pollset_oneshot(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollset;
+    const apr_pollfd_t *hot_files;
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    int i;
+
+    for (i = 0; i < sizeof all_methods / sizeof all_methods[0]; i++) {
+        rv = apr_pollset_create_ex(&pollset, 5, p, APR_POLLSET_NODEFAULT,
+                                   all_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        /* UDP sockets are always writable */
+        pfd.p = p;
+        pfd.desc_type = APR_POLL_SOCKET;
+        pfd.reqevents = APR_POLLOUT | APR_POLLONESHOT;
+        pfd.desc.s = s[0];
+        pfd.client_data = (void *)1;
+        rv = apr_pollset_add(pollset, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        ABTS_PTR_EQUAL(tc, (void *)1, hot_files[0].client_data);
+
+        /* disarmed */
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+        ABTS_INT_EQUAL(tc, 0, num);
+
+        /* rearmed, with other client data */
+        pfd.client_data = (void *)2;
+        rv = apr_pollset_rearm(pollset, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        ABTS_PTR_EQUAL(tc, (void *)2, hot_files[0].client_data);
+
+        /* level-triggered now */
+        pfd.reqevents = APR_POLLOUT;
+        rv = apr_pollset_rearm(pollset, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+
+        /* edge-triggered, where supported */
+        if (all_methods[i] == APR_POLLSET_EPOLL
+                || all_methods[i] == APR_POLLSET_KQUEUE
+                || all_methods[i] == APR_POLLSET_IOURING) {
+            pfd.reqevents = APR_POLLOUT | APR_POLLET;
+            rv = apr_pollset_rearm(pollset, &pfd);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_INT_EQUAL(tc, 1, num);
+            rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+            ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+        }
+
+        destroy_pollset(tc, pollset, all_methods[i]);
+    }
+}
+
+static void pollset_poll_batch(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollset;
+    apr_pollfd_t hot_files[3];
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    int i, j, seen;
+
+    for (i = 0; i < sizeof all_methods / sizeof all_methods[0]; i++) {
+        rv = apr_pollset_create_ex(&pollset, 5, p, APR_POLLSET_NODEFAULT,
+                                   all_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        /* UDP sockets are always writable */
+        pfd.p = p;
+        pfd.desc_type = APR_POLL_SOCKET;
+        pfd.reqevents = APR_POLLOUT | APR_POLLONESHOT;
+        for (j = 0; j < 4; j++) {
+            pfd.desc.s = s[j];
+            pfd.client_data = (void *)(apr_uintptr_t)j;
+            rv = apr_pollset_add(pollset, &pfd);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+
+        rv = apr_pollset_poll_ex(pollset, 1000, hot_files, 0, &num);
+        ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+        ABTS_INT_EQUAL(tc, 0, num);
+
+        /* the one not returned is still signalled next */
+        seen = 0;
+        rv = apr_pollset_poll_ex(pollset, 1000, hot_files, 3, &num);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 3, num);
+        for (j = 0; j < num; j++) {
+            seen |= 1 << (apr_uintptr_t)hot_files[j].client_data;
+        }
+        rv = apr_pollset_poll_ex(pollset, 1000, hot_files, 3, &num);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        seen |= 1 << (apr_uintptr_t)hot_files[0].client_data;
+        ABTS_INT_EQUAL(tc, 0xf, seen);
+
+        /* all disarmed */
+        rv = apr_pollset_poll_ex(pollset, 1000, hot_files, 3, &num);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+        ABTS_INT_EQUAL(tc, 0, num);
+
+        destroy_pollset(tc, pollset, all_methods[i]);
+    }
+}
+
+static void pollset_wakeup_many(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollset;
+    const apr_pollfd_t *hot_files;
+    apr_int32_t num;
+    int i, j, k;
+
+    for (i = 0; i < sizeof all_methods / sizeof all_methods[0]; i++) {
+        rv = apr_pollset_create_ex(&pollset, 1, p,
+                                   APR_POLLSET_WAKEABLE | APR_POLLSET_NODEFAULT,
+                                   all_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        /* the wakeups sent before polling are reported once */
+        for (j = 0; j < 2; j++) {
+            for (k = 0; k < 10; k++) {
+                rv = apr_pollset_wakeup(pollset);
+                ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            }
+            rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+            ABTS_INT_EQUAL(tc, APR_EINTR, rv);
+            rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+            ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+        }
+
+        destroy_pollset(tc, pollset, all_methods[i]);
+    }
+}
+
+static void pollset_remove_many(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *pollset;
+    const apr_pollfd_t *hot_files;
+    apr_pollfd_t pfd;
+    apr_int32_t num;
+    int i, j;
+
+    for (i = 0; i < sizeof all_methods / sizeof all_methods[0]; i++) {
+        rv = apr_pollset_create_ex(&pollset, LARGE_NUM_SOCKETS, p,
+                                   APR_POLLSET_NODEFAULT, all_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        pfd.p = p;
+        pfd.desc_type = APR_POLL_SOCKET;
+        pfd.reqevents = APR_POLLOUT;
+        for (j = 0; j < LARGE_NUM_SOCKETS; j++) {
+            pfd.desc.s = s[j];
+            pfd.client_data = (void *)(apr_uintptr_t)j;
+            rv = apr_pollset_add(pollset, &pfd);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+
+        /* remove the even ones, twice */
+        for (j = 0; j < LARGE_NUM_SOCKETS; j += 2) {
+            pfd.desc.s = s[j];
+            rv = apr_pollset_remove(pollset, &pfd);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            rv = apr_pollset_remove(pollset, &pfd);
+            ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+        }
+
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, LARGE_NUM_SOCKETS / 2, num);
+        for (j = 0; j < num; j++) {
+            apr_uintptr_t k = (apr_uintptr_t)hot_files[j].client_data;
+            ABTS_INT_EQUAL(tc, 1, (int)(k % 2));
+            ABTS_PTR_EQUAL(tc, s[k], hot_files[j].desc.s);
+        }
+
+        /* add them back, reusing the removed entries */
+        for (j = 0; j < LARGE_NUM_SOCKETS; j += 2) {
+            pfd.desc.s = s[j];
+            pfd.client_data = (void *)(apr_uintptr_t)j;
+            rv = apr_pollset_add(pollset, &pfd);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+
+        rv = apr_pollset_poll(pollset, 1000, &num, &hot_files);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, LARGE_NUM_SOCKETS, num);
+        for (j = 0; j < num; j++) {
+            apr_uintptr_t k = (apr_uintptr_t)hot_files[j].client_data;
+            ABTS_PTR_EQUAL(tc, s[k], hot_files[j].desc.s);
+        }
+
+        destroy_pollset(tc, pollset, all_methods[i]);
+    }
+}
+
 #define POLLCB_PREREQ \
     do { \
         if (pollcb == NULL) { \
@@ -673,6 +926,58 @@ static void timeout_pollin_pollcb(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static apr_status_t oneshot_pollcb_cb(void *baton, apr_pollfd_t *descriptor)
+{
+    pollcb_baton_t *pcb = (pollcb_baton_t *) baton;
+    ABTS_PTR_EQUAL(pcb->tc, s[0], descriptor->desc.s);
+    pcb->count++;
+    return APR_SUCCESS;
+}
+
+static void oneshot_pollcb(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollcb_t *pollcb;
+    apr_pollfd_t socket_pollfd;
+    pollcb_baton_t pcb;
+    int i;
+
+    for (i = 0; i < sizeof all_methods / sizeof all_methods[0]; i++) {
+        rv = apr_pollcb_create_ex(&pollcb, 5, p, APR_POLLSET_NODEFAULT,
+                                  all_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        socket_pollfd.desc_type = APR_POLL_SOCKET;
+        socket_pollfd.reqevents = APR_POLLOUT | APR_POLLONESHOT;
+        socket_pollfd.desc.s = s[0];
+        socket_pollfd.client_data = s[0];
+        rv = apr_pollcb_add(pollcb, &socket_pollfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        pcb.tc = tc;
+        pcb.count = 0;
+        rv = apr_pollcb_poll(pollcb, 1000, oneshot_pollcb_cb, &pcb);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, pcb.count);
+
+        rv = apr_pollcb_poll(pollcb, 1000, oneshot_pollcb_cb, &pcb);
+        ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+        ABTS_INT_EQUAL(tc, 1, pcb.count);
+
+        rv = apr_pollcb_rearm(pollcb, &socket_pollfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollcb_poll(pollcb, 1000, oneshot_pollcb_cb, &pcb);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 2, pcb.count);
+
+        rv = apr_pollcb_remove(pollcb, &socket_pollfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+}
+
 static void pollset_default(abts_case *tc, void *data)
 {
     apr_status_t rv1, rv2;
@@ -947,12 +1252,17 @@ abts_suite *testpoll(abts_suite *suite)
     abts_run_test(suite, send_last_pollset, NULL);
     abts_run_test(suite, clear_last_pollset, NULL);
     abts_run_test(suite, pollset_remove, NULL);
+    abts_run_test(suite, pollset_oneshot, NULL);
+    abts_run_test(suite, pollset_poll_batch, NULL);
+    abts_run_test(suite, pollset_wakeup_many, NULL);
+    abts_run_test(suite, pollset_remove_many, NULL);
     abts_run_test(suite, close_all_sockets, NULL);
     abts_run_test(suite, create_all_sockets, NULL);
     abts_run_test(suite, setup_pollcb, NULL);
     abts_run_test(suite, trigger_pollcb, NULL);
     abts_run_test(suite, timeout_pollcb, NULL);
     abts_run_test(suite, timeout_pollin_pollcb, NULL);
+    abts_run_test(suite, oneshot_pollcb, NULL);
     abts_run_test(suite, pollset_wakeup, NULL);
     abts_run_test(suite, pollcb_wakeup, NULL);
     abts_run_test(suite, close_all_sockets, NULL);
@@ -14,11 +14,16 @@
  * limitations under the License.
  */
 
+/* The allocations of this suite use the inline apr_palloc() */
+#define APR_POOL_INLINE
 
 #include "apr_general.h"
 #include "apr_pools.h"
+#include "apr_allocator.h"
 #include "apr_errno.h"
 #include "apr_file_io.h"
+#include "apr_strings.h"
+#include "apr_thread_proc.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -164,6 +169,108 @@ static void test_cleanups(abts_case *tc, void *data)
     }
 }
 
+static apr_pool_t *handles_pool;
+static apr_pool_cleanup_t *handles[4];
+
+static apr_status_t count_cleanup(void *data)
+{
+    (*(int *)data)++;
+    return APR_SUCCESS;
+}
+
+/* Kill a cleanup which ran already and one still to run */
+static apr_status_t kill_handles_cleanup(void *data)
+{
+    apr_pool_cleanup_kill_handle(handles_pool, handles[3]);
+    apr_pool_cleanup_kill_handle(handles_pool, handles[0]);
+    return APR_SUCCESS;
+}
+
+static void test_cleanup_handles(abts_case *tc, void *data)
+{
+    int counts[4], i, n;
+    apr_status_t rv;
+
+    APR_ASSERT_SUCCESS(tc, "create pool",
+                       apr_pool_create(&handles_pool, p));
+
+    for (n = 0; n < 3; n++) {
+        memset(counts, 0, sizeof counts);
+        for (i = 0; i < 3; i++) {
+            handles[i] = apr_pool_cleanup_register_ex(handles_pool,
+                                                      &counts[i],
+                                                      count_cleanup,
+                                                      apr_pool_cleanup_null);
+        }
+        apr_pool_cleanup_register(handles_pool, NULL, kill_handles_cleanup,
+                                  apr_pool_cleanup_null);
+        handles[3] = apr_pool_cleanup_register_ex(handles_pool, &counts[3],
+                                                  count_cleanup,
+                                                  apr_pool_cleanup_null);
+
+        /* unlink from the middle of the list */
+        apr_pool_cleanup_kill_handle(handles_pool, handles[1]);
+        rv = apr_pool_cleanup_run_handle(handles_pool, handles[2]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, counts[2]);
+
+        /* reuse the freed cleanups */
+        handles[1] = apr_pool_cleanup_register_ex(handles_pool, &counts[1],
+                                                  count_cleanup,
+                                                  apr_pool_cleanup_null);
+        apr_pool_cleanup_kill(handles_pool, &counts[1], count_cleanup);
+        ABTS_INT_EQUAL(tc, 0, counts[1]);
+
+        apr_pool_clear(handles_pool);
+        ABTS_INT_EQUAL(tc, 0, counts[0]);
+        ABTS_INT_EQUAL(tc, 0, counts[1]);
+        ABTS_INT_EQUAL(tc, 1, counts[2]);
+        ABTS_INT_EQUAL(tc, 1, counts[3]);
+    }
+
+    apr_pool_destroy(handles_pool);
+}
+
+/* Subpools are recycled on destroy, check they are fresh when reused */
+static void test_pool_recycling(abts_case *tc, void *data)
+{
+    apr_pool_t *parent, *sub, *subsub;
+    int counts[2] = {0, 0}, n;
+    void *ud;
+    char *mem;
+
+    APR_ASSERT_SUCCESS(tc, "create pool", apr_pool_create(&parent, p));
+
+    for (n = 0; n < 3; n++) {
+        APR_ASSERT_SUCCESS(tc, "create subpool",
+                           apr_pool_create(&sub, parent));
+        ABTS_PTR_EQUAL(tc, parent, apr_pool_parent_get(sub));
+        ABTS_TRUE(tc, apr_pool_is_ancestor(parent, sub));
+
+        ud = NULL;
+        apr_pool_userdata_get(&ud, "recycled", sub);
+        ABTS_PTR_EQUAL(tc, NULL, ud);
+        apr_pool_userdata_setn("recycled", "recycled", NULL, sub);
+        apr_pool_tag(sub, "recycled");
+
+        /* use more than the first node */
+        mem = apr_palloc(sub, 100000);
+        memset(mem, 'x', 100000);
+        APR_ASSERT_SUCCESS(tc, "create subsubpool",
+                           apr_pool_create(&subsub, sub));
+        apr_pool_cleanup_register(sub, &counts[0], count_cleanup,
+                                  apr_pool_cleanup_null);
+        apr_pool_cleanup_register(subsub, &counts[1], count_cleanup,
+                                  apr_pool_cleanup_null);
+
+        apr_pool_destroy(sub);
+        ABTS_INT_EQUAL(tc, n + 1, counts[0]);
+        ABTS_INT_EQUAL(tc, n + 1, counts[1]);
+    }
+
+    apr_pool_destroy(parent);
+}
+
 static void test_tags(abts_case *tc, void *data)
 {
     /* if APR_POOL_DEBUG is set, all pools are tagged by default */
@@ -176,6 +283,458 @@ static void test_tags(abts_case *tc, void *data)
     ABTS_STR_EQUAL(tc, "main pool", apr_pool_get_tag(pmain));
 }
 
+static void test_sized_recycling(abts_case *tc, void *data)
+{
+    apr_size_t sizes[] = { 1, 8, 24, 100, 256, 257, 1000, 5000,
+                           APR_POOL_SIZED_MAX };
+    void *mem[9];
+    apr_pool_t *pool;
+    apr_pool_stats_t stats;
+    apr_size_t footprint;
+    int i, n;
+
+    APR_ASSERT_SUCCESS(tc, "create pool", apr_pool_create(&pool, p));
+
+    for (i = 0; i < 9; i++) {
+        mem[i] = apr_pool_alloc_sized(pool, sizes[i]);
+        ABTS_PTR_NOTNULL(tc, mem[i]);
+        memset(mem[i], i, sizes[i]);
+    }
+    for (i = 0; i < 9; i++) {
+        apr_pool_free_sized(pool, mem[i], sizes[i]);
+    }
+    /* LIFO reuse of the same size classes */
+    for (i = 8; i >= 0; i--) {
+        void *again = apr_pool_alloc_sized(pool, sizes[i]);
+        ABTS_PTR_EQUAL(tc, mem[i], again);
+    }
+    /* A larger size in the same class reuses the block */
+    apr_pool_free_sized(pool, mem[6], sizes[6]);
+    ABTS_PTR_EQUAL(tc, mem[6], apr_pool_alloc_sized(pool, 1024));
+
+    /* Churning must not grow the pool */
+    if (apr_pool_stats_get(pool, &stats) == APR_SUCCESS) {
+        footprint = stats.footprint;
+        for (n = 0; n < 1000; n++) {
+            void *m = apr_pool_alloc_sized(pool, 3000);
+            memset(m, 0, 3000);
+            apr_pool_free_sized(pool, m, 3000);
+        }
+        apr_pool_stats_get(pool, &stats);
+        ABTS_ASSERT(tc, "pool did not grow",
+                    stats.footprint <= footprint + 8192);
+    }
+
+    apr_pool_clear(pool);
+    ABTS_PTR_NOTNULL(tc, apr_pool_alloc_sized(pool, 100));
+    apr_pool_destroy(pool);
+}
+
+static void test_pool_stats(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_allocator_stats_t astats;
+    apr_pool_stats_t stats;
+    apr_pool_t *pool;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+    rv = apr_pool_create_ex(&pool, NULL, NULL, allocator);
+    APR_ASSERT_SUCCESS(tc, "create pool", rv);
+    apr_allocator_owner_set(allocator, pool);
+
+    rv = apr_pool_stats_get(pool, &stats);
+    if (rv == APR_ENOTIMPL) {
+        apr_pool_destroy(pool);
+        ABTS_NOT_IMPL(tc, "Pool statistics");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "get pool stats", rv);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.nodes_fetched);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.bytes_alloc);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.clears);
+
+    for (i = 0; i < 10; i++) {
+        apr_palloc(pool, 4000);
+    }
+    apr_psprintf(pool, "%s", "stats");
+    apr_pool_stats_get(pool, &stats);
+    ABTS_ASSERT(tc, "bytes allocated", stats.bytes_alloc >= 40000 + 6);
+    ABTS_ASSERT(tc, "nodes fetched", stats.nodes_fetched > 1);
+    ABTS_ASSERT(tc, "footprint", stats.footprint >= stats.bytes_alloc);
+    ABTS_ASSERT(tc, "peak", stats.peak_footprint == stats.footprint);
+
+    apr_pool_clear(pool);
+    apr_pool_stats_get(pool, &stats);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.clears);
+    ABTS_ASSERT(tc, "footprint after clear",
+                stats.footprint < stats.peak_footprint);
+
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_ASSERT(tc, "allocator nodes", astats.nodes_alloc == stats.nodes_fetched);
+    ABTS_ASSERT(tc, "allocator free bytes",
+                astats.bytes_free == astats.bytes_footprint - stats.footprint);
+    ABTS_ASSERT(tc, "allocator peak",
+                astats.bytes_peak == astats.bytes_footprint);
+
+    /* Reuse what was freed by the clear */
+    for (i = 0; i < 10; i++) {
+        apr_palloc(pool, 4000);
+    }
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_ASSERT(tc, "allocator recycled", astats.nodes_recycled > 0);
+    ABTS_ASSERT(tc, "allocator peak",
+                astats.bytes_peak == astats.bytes_footprint);
+
+    apr_pool_destroy(pool);
+}
+
+static void test_allocator_region(abts_case *tc, void *data)
+{
+    apr_uint32_t flags[2] = { 0, APR_ALLOCATOR_REGION_HUGEPAGES };
+    apr_allocator_t *allocator;
+    apr_pool_t *pool, *subp;
+    apr_status_t rv;
+    int i, j;
+
+    for (i = 0; i < 2; i++) {
+        rv = apr_allocator_create(&allocator);
+        APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+
+        rv = apr_allocator_region_set(allocator, 256 * 1024, flags[i],
+                                      APR_ALLOCATOR_NUMA_NODE_ANY);
+        if (rv == APR_ENOTIMPL) {
+            apr_allocator_destroy(allocator);
+            ABTS_NOT_IMPL(tc, "Allocator regions");
+            return;
+        }
+        APR_ASSERT_SUCCESS(tc, "set allocator region", rv);
+        apr_allocator_max_free_set(allocator, 64 * 1024);
+
+        rv = apr_pool_create_ex(&pool, NULL, NULL, allocator);
+        APR_ASSERT_SUCCESS(tc, "create pool", rv);
+        apr_allocator_owner_set(allocator, pool);
+
+        /* Spans several regions, and some nodes are larger than one */
+        for (j = 0; j < 64; j++) {
+            char *mem;
+
+            rv = apr_pool_create(&subp, pool);
+            APR_ASSERT_SUCCESS(tc, "create subpool", rv);
+            mem = apr_palloc(subp, (j % 8) * 12000 + 100);
+            ABTS_PTR_NOTNULL(tc, mem);
+            memset(mem, j, (j % 8) * 12000 + 100);
+            if (j % 16 == 0) {
+                mem = apr_palloc(subp, 300 * 1024);
+                ABTS_PTR_NOTNULL(tc, mem);
+                memset(mem, j, 300 * 1024);
+            }
+            if (j % 3 == 0) {
+                apr_pool_destroy(subp);
+            }
+        }
+
+        apr_pool_destroy(pool);
+    }
+}
+
+#define TRIM_NODES 8
+
+static void test_allocator_trim(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_allocator_stats_t stats;
+    apr_memnode_t *nodes[TRIM_NODES];
+    apr_size_t size;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+
+    for (i = 0; i < TRIM_NODES; i++) {
+        nodes[i] = apr_allocator_alloc(allocator, 10000);
+        ABTS_PTR_NOTNULL(tc, nodes[i]);
+    }
+    size = nodes[0]->endp - (char *)nodes[0];
+    for (i = 0; i < TRIM_NODES; i++) {
+        apr_allocator_free(allocator, nodes[i]);
+    }
+
+    /* Everything was used since the allocator was created */
+    ABTS_INT_EQUAL(tc, 0, (int)apr_allocator_trim(allocator, 0));
+
+    /* Then half of the idle nodes go each time */
+    ABTS_INT_EQUAL(tc, (int)(TRIM_NODES / 2 * size),
+                   (int)apr_allocator_trim(allocator, 0));
+    apr_allocator_stats_get(allocator, &stats);
+    ABTS_INT_EQUAL(tc, (int)(TRIM_NODES / 2 * size), (int)stats.bytes_free);
+    ABTS_INT_EQUAL(tc, TRIM_NODES / 2, (int)stats.nodes_released);
+    ABTS_INT_EQUAL(tc, (int)stats.bytes_free, (int)stats.bytes_footprint);
+
+    /* Unless they are used meanwhile */
+    for (i = 0; i < TRIM_NODES / 2; i++) {
+        nodes[i] = apr_allocator_alloc(allocator, 10000);
+    }
+    for (i = 0; i < TRIM_NODES / 2; i++) {
+        apr_allocator_free(allocator, nodes[i]);
+    }
+    ABTS_INT_EQUAL(tc, 0, (int)apr_allocator_trim(allocator, 0));
+    ABTS_INT_EQUAL(tc, (int)(TRIM_NODES / 4 * size),
+                   (int)apr_allocator_trim(allocator, 0));
+
+    /* Served from the remaining nodes */
+    nodes[0] = apr_allocator_alloc(allocator, 10000);
+    apr_allocator_stats_get(allocator, &stats);
+    ABTS_INT_EQUAL(tc, TRIM_NODES, (int)stats.nodes_alloc);
+    apr_allocator_free(allocator, nodes[0]);
+
+    ABTS_INT_EQUAL(tc, (int)(TRIM_NODES / 4 * size),
+                   (int)apr_allocator_trim(allocator, APR_ALLOCATOR_TRIM_ALL));
+    apr_allocator_stats_get(allocator, &stats);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.bytes_free);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.bytes_footprint);
+
+    nodes[0] = apr_allocator_alloc(allocator, 10000);
+    ABTS_PTR_NOTNULL(tc, nodes[0]);
+    memset(nodes[0]->first_avail, 1, 10000);
+    apr_allocator_free(allocator, nodes[0]);
+
+    apr_allocator_destroy(allocator);
+
+    /* The nodes of a region only give back their memory */
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+    rv = apr_allocator_region_set(allocator, 256 * 1024, 0,
+                                  APR_ALLOCATOR_NUMA_NODE_ANY);
+    if (rv == APR_SUCCESS) {
+        for (i = 0; i < TRIM_NODES; i++) {
+            nodes[i] = apr_allocator_alloc(allocator, 10000);
+            ABTS_PTR_NOTNULL(tc, nodes[i]);
+        }
+        for (i = 0; i < TRIM_NODES; i++) {
+            apr_allocator_free(allocator, nodes[i]);
+        }
+        ABTS_ASSERT(tc, "region nodes advised",
+                    apr_allocator_trim(allocator, APR_ALLOCATOR_TRIM_ALL)
+                    > 0);
+        apr_allocator_stats_get(allocator, &stats);
+        ABTS_ASSERT(tc, "region nodes kept",
+                    stats.bytes_free >= TRIM_NODES * size);
+
+        nodes[0] = apr_allocator_alloc(allocator, 10000);
+        ABTS_PTR_NOTNULL(tc, nodes[0]);
+        memset(nodes[0]->first_avail, 1, 10000);
+        apr_allocator_free(allocator, nodes[0]);
+    }
+    apr_allocator_destroy(allocator);
+}
+
+static int profile_has(const char *profile, apr_size_t len, const char *s)
+{
+    apr_size_t n = strlen(s);
+
+    for (; len >= n; profile++, len--) {
+        if (!memcmp(profile, s, n)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_pool_profile(abts_case *tc, void *data)
+{
+    apr_pool_t *subp;
+    apr_size_t len;
+    void *profile;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_pool_profile_set(1024);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Pool profiler");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "start profiling", rv);
+
+    apr_pool_create(&subp, p);
+    apr_pool_tag(subp, "profiled-pool");
+    for (i = 0; i < 100; i++) {
+        apr_palloc(subp, 1000);
+    }
+    apr_pool_profile_set(0);
+    apr_pool_destroy(subp);
+
+    rv = apr_pool_profile_get(&profile, &len, p);
+    APR_ASSERT_SUCCESS(tc, "get profile", rv);
+    ABTS_ASSERT(tc, "profile", len > 0);
+    ABTS_INT_EQUAL(tc, 1, profile_has(profile, len, "alloc_space"));
+    ABTS_INT_EQUAL(tc, 1, profile_has(profile, len, "pool_tag"));
+    ABTS_INT_EQUAL(tc, 1, profile_has(profile, len, "profiled-pool"));
+
+    apr_pool_profile_clear();
+    rv = apr_pool_profile_get(&profile, &len, p);
+    APR_ASSERT_SUCCESS(tc, "get profile", rv);
+    ABTS_INT_EQUAL(tc, 0, profile_has(profile, len, "profiled-pool"));
+}
+
+#if APR_HAS_THREADS
+#define TCACHE_THREADS 4
+#define TCACHE_LOOPS 200
+
+static void * APR_THREAD_FUNC tcache_thread(apr_thread_t *thd, void *data)
+{
+    apr_pool_t *parent = data, *subp;
+    apr_status_t rv = APR_SUCCESS;
+    int i, j;
+
+    for (i = 0; i < TCACHE_LOOPS && rv == APR_SUCCESS; i++) {
+        rv = apr_pool_create(&subp, parent);
+        if (rv != APR_SUCCESS)
+            break;
+        for (j = 1; j < 16; j++) {
+            char *mem = apr_palloc(subp, j * 1000);
+            memset(mem, j, j * 1000);
+        }
+        apr_pool_clear(subp);
+        apr_palloc(subp, 20000);
+        apr_pool_destroy(subp);
+    }
+
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_allocator_thread_cache(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_thread_mutex_t *mutex;
+    apr_thread_t *threads[TCACHE_THREADS];
+    apr_pool_t *pool;
+    apr_status_t rv, retval;
+    int i;
+
+    rv = apr_allocator_create_ex(&allocator, APR_ALLOCATOR_THREAD_CACHE);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Allocator thread cache");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create allocator with thread cache", rv);
+
+    rv = apr_pool_create_ex(&pool, NULL, NULL, allocator);
+    APR_ASSERT_SUCCESS(tc, "create pool", rv);
+    apr_allocator_owner_set(allocator, pool);
+
+    rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT, pool);
+    APR_ASSERT_SUCCESS(tc, "create allocator mutex", rv);
+    apr_allocator_mutex_set(allocator, mutex);
+
+    for (i = 0; i < TCACHE_THREADS; i++) {
+        rv = apr_thread_create(&threads[i], NULL, tcache_thread, pool, p);
+        APR_ASSERT_SUCCESS(tc, "create thread", rv);
+    }
+    for (i = 0; i < TCACHE_THREADS; i++) {
+        rv = apr_thread_join(&retval, threads[i]);
+        APR_ASSERT_SUCCESS(tc, "join thread", rv);
+        APR_ASSERT_SUCCESS(tc, "thread allocations", retval);
+    }
+
+    /* This destroys the allocator and its thread caches too */
+    apr_pool_destroy(pool);
+}
+
+#define TCACHE_ALLOCATORS 6
+
+static void test_allocator_thread_cache_evict(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocators[TCACHE_ALLOCATORS];
+    apr_allocator_stats_t stats;
+    apr_memnode_t *node;
+    apr_status_t rv;
+    int i, n;
+
+    for (i = 0; i < TCACHE_ALLOCATORS; i++) {
+        rv = apr_allocator_create_ex(&allocators[i],
+                                     APR_ALLOCATOR_THREAD_CACHE);
+        if (rv == APR_ENOTIMPL) {
+            ABTS_NOT_IMPL(tc, "Allocator thread cache");
+            return;
+        }
+        APR_ASSERT_SUCCESS(tc, "create allocator with thread cache", rv);
+    }
+
+    /* More allocators than the thread has slots: the caches are evicted
+     * round after round, and must be reused rather than stranding their
+     * nodes (which the allocator would replace).
+     */
+    for (n = 0; n < 100; n++) {
+        for (i = 0; i < TCACHE_ALLOCATORS; i++) {
+            node = apr_allocator_alloc(allocators[i], 1000);
+            ABTS_PTR_NOTNULL(tc, node);
+            apr_allocator_free(allocators[i], node);
+        }
+    }
+
+    for (i = 0; i < TCACHE_ALLOCATORS; i++) {
+        apr_allocator_stats_get(allocators[i], &stats);
+        ABTS_ASSERT(tc, "nodes reused", stats.nodes_alloc <= 2);
+        apr_allocator_destroy(allocators[i]);
+    }
+}
+#endif /* APR_HAS_THREADS */
+
+static void test_palloc_inline(abts_case *tc, void *data)
+{
+    apr_pool_t *subp;
+    apr_pool_stats_t stats;
+    apr_size_t n = 13, total = 0;
+    char *a, *b, *c;
+    int i;
+
+    apr_pool_create(&subp, p);
+
+    /* constant and variable sizes, aligned */
+    a = apr_palloc(subp, 5);
+    b = apr_palloc(subp, n);
+    c = apr_pcalloc(subp, 24);
+    ABTS_INT_EQUAL(tc, 0, (int)((apr_uintptr_t)a % 8));
+    ABTS_INT_EQUAL(tc, 0, (int)((apr_uintptr_t)b % 8));
+    ABTS_INT_EQUAL(tc, 0, (int)((apr_uintptr_t)c % 8));
+#if !APR_POOL_DEBUG
+    ABTS_PTR_EQUAL(tc, a + 8, b);
+    ABTS_PTR_EQUAL(tc, b + 16, c);
+#endif
+    for (i = 0; i < 24; i++) {
+        if (c[i]) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 24, i);
+    memset(a, 'a', 5);
+    memset(b, 'b', n);
+    total = 8 + 16 + 24;
+
+    /* the active node runs out of room, refilled by the function */
+    for (i = 0; i < 100; i++) {
+        n = 1000 + i;
+        a = apr_palloc(subp, n);
+        ABTS_INT_EQUAL(tc, 0, (int)((apr_uintptr_t)a % 8));
+        memset(a, i, n);
+        total += APR_ALIGN_DEFAULT(n);
+    }
+    a = apr_palloc(subp, 100000);
+    memset(a, 0, 100000);
+    total += 100000;
+
+    if (apr_pool_stats_get(subp, &stats) == APR_SUCCESS) {
+        ABTS_SIZE_EQUAL(tc, total, stats.bytes_alloc);
+    }
+
+    apr_pool_destroy(subp);
+}
+
 abts_suite *testpool(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -186,8 +745,20 @@ abts_suite *testpool(abts_suite *suite)
     abts_run_test(suite, test_notancestor, NULL);
     abts_run_test(suite, alloc_bytes, NULL);
     abts_run_test(suite, calloc_bytes, NULL);
+    abts_run_test(suite, test_palloc_inline, NULL);
     abts_run_test(suite, test_cleanups, NULL);
+    abts_run_test(suite, test_cleanup_handles, NULL);
+    abts_run_test(suite, test_pool_recycling, NULL);
     abts_run_test(suite, test_tags, NULL);
+    abts_run_test(suite, test_sized_recycling, NULL);
+    abts_run_test(suite, test_pool_stats, NULL);
+    abts_run_test(suite, test_allocator_region, NULL);
+    abts_run_test(suite, test_allocator_trim, NULL);
+    abts_run_test(suite, test_pool_profile, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_allocator_thread_cache, NULL);
+    abts_run_test(suite, test_allocator_thread_cache_evict, NULL);
+#endif
 
     return suite;
 }
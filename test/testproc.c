@@ -19,6 +19,8 @@
 #include "apr_general.h"
 #include "apr_lib.h"
 #include "apr_strings.h"
+#include "apr_proc_pool.h"
+#include "apr_signal.h"
 #include "testutil.h"
 
 #define TESTSTR "This is a test"
@@ -225,6 +227,154 @@ static void test_proc_args(abts_case* tc, void* data)
     ABTS_STR_EQUAL(tc, expected, actual);
 }
 
+static void test_proc_spawn(abts_case *tc, void *data)
+{
+    const char *args[3];
+    apr_procattr_t *attr;
+    apr_proc_t proc;
+    apr_exit_why_e why;
+    apr_status_t rv;
+    int spawn, exitcode;
+
+    for (spawn = 0; spawn <= 1; ++spawn) {
+        char buf[256];
+        apr_size_t length = sizeof(buf) - 1;
+
+        rv = apr_procattr_create(&attr, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_procattr_spawn_set(attr, spawn);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_procattr_io_set(attr, APR_NO_PIPE, APR_FULL_BLOCK,
+                                 APR_NO_FILE);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_procattr_dir_set(attr, "data");
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_procattr_cmdtype_set(attr, APR_SHELLCMD_ENV);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        args[0] = "echo";
+        args[1] = "spawned";
+        args[2] = NULL;
+        rv = apr_proc_create(&proc, "echo", args, NULL, attr, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        rv = apr_file_read_full(proc.out, buf, length, &length);
+        ABTS_TRUE(tc, rv == APR_SUCCESS || APR_STATUS_IS_EOF(rv));
+        buf[length] = '\0';
+        ABTS_STR_EQUAL(tc, "spawned\n", buf);
+        apr_file_close(proc.out);
+
+        rv = apr_proc_wait(&proc, &exitcode, &why, APR_WAIT);
+        ABTS_INT_EQUAL(tc, APR_CHILD_DONE, rv);
+        ABTS_INT_EQUAL(tc, APR_PROC_EXIT, why);
+        ABTS_INT_EQUAL(tc, 0, exitcode);
+
+        /* A missing program fails either in apr_proc_create() or in the
+         * child, depending on the C library when spawned.
+         */
+        rv = apr_procattr_create(&attr, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_procattr_spawn_set(attr, spawn);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        args[0] = "data/no_such_program";
+        args[1] = NULL;
+        rv = apr_proc_create(&proc, args[0], args, NULL, attr, p);
+        if (rv == APR_SUCCESS) {
+            rv = apr_proc_wait(&proc, &exitcode, &why, APR_WAIT);
+            ABTS_INT_EQUAL(tc, APR_CHILD_DONE, rv);
+            ABTS_TRUE(tc, exitcode != 0);
+        }
+        else {
+            ABTS_INT_EQUAL(tc, 1, spawn);
+            ABTS_TRUE(tc, APR_STATUS_IS_ENOENT(rv));
+        }
+    }
+}
+
+#if APR_HAS_FORK
+static void test_proc_pool(abts_case *tc, void *data)
+{
+    apr_proc_pool_t *pp;
+    apr_procattr_t *attr;
+    apr_proc_t proc;
+    apr_exit_why_e why;
+    const char *args[2];
+    char buf[256];
+    apr_size_t length;
+    apr_status_t rv;
+    int exitcode;
+
+    rv = apr_proc_pool_create(&pp, p);
+    APR_ASSERT_SUCCESS(tc, "create process pool", rv);
+
+    rv = apr_procattr_create(&attr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_procattr_io_set(attr, APR_FULL_BLOCK, APR_FULL_BLOCK,
+                             APR_NO_FILE);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_procattr_dir_set(attr, "data");
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_procattr_cmdtype_set(attr, APR_PROGRAM_ENV);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    args[0] = "proc_child" EXTENSION;
+    args[1] = NULL;
+    rv = apr_proc_pool_spawn(pp, &proc, proc_child, args, NULL, attr, p);
+    APR_ASSERT_SUCCESS(tc, "spawn from the process pool", rv);
+
+    /* The child waits for its input */
+    rv = apr_proc_pool_wait(pp, &proc, &exitcode, &why, APR_NOWAIT);
+    ABTS_INT_EQUAL(tc, APR_CHILD_NOTDONE, rv);
+
+    length = strlen(TESTSTR);
+    rv = apr_file_write_full(proc.in, TESTSTR, length, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_file_close(proc.in);
+
+    length = sizeof(buf) - 1;
+    rv = apr_file_read_full(proc.out, buf, length, &length);
+    ABTS_TRUE(tc, rv == APR_SUCCESS || APR_STATUS_IS_EOF(rv));
+    buf[length] = '\0';
+    ABTS_STR_EQUAL(tc, TESTSTR, buf);
+    apr_file_close(proc.out);
+
+    rv = apr_proc_pool_wait(pp, &proc, &exitcode, &why, APR_WAIT);
+    ABTS_INT_EQUAL(tc, APR_CHILD_DONE, rv);
+    ABTS_INT_EQUAL(tc, APR_PROC_EXIT, why);
+    ABTS_INT_EQUAL(tc, 0, exitcode);
+
+    /* Once waited for, the child is forgotten */
+    rv = apr_proc_pool_wait(pp, &proc, &exitcode, &why, APR_NOWAIT);
+    ABTS_INT_EQUAL(tc, ECHILD, rv);
+
+    rv = apr_procattr_create(&attr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_procattr_cmdtype_set(attr, APR_SHELLCMD_ENV);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    args[0] = "exit 3";
+    args[1] = NULL;
+    rv = apr_proc_pool_spawn(pp, &proc, "exit 3", args, NULL, attr, p);
+    APR_ASSERT_SUCCESS(tc, "spawn a shell from the process pool", rv);
+
+    rv = apr_proc_pool_wait(pp, &proc, &exitcode, &why, APR_WAIT);
+    ABTS_INT_EQUAL(tc, APR_CHILD_DONE, rv);
+    ABTS_INT_EQUAL(tc, APR_PROC_EXIT, why);
+    ABTS_INT_EQUAL(tc, 3, exitcode);
+}
+#endif
+
+static void test_signal_description(abts_case *tc, void *data)
+{
+    const char *desc;
+
+    desc = apr_signal_description_get(SIGTERM);
+    ABTS_PTR_NOTNULL(tc, desc);
+    ABTS_ASSERT(tc, "no description of SIGTERM", *desc != '\0');
+    ABTS_PTR_EQUAL(tc, desc, apr_signal_description_get(SIGTERM));
+    ABTS_STR_EQUAL(tc, "unknown signal (number)",
+                   apr_signal_description_get(-1));
+}
+
 abts_suite *testproc(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -234,6 +384,11 @@ abts_suite *testproc(abts_suite *suite)
     abts_run_test(suite, test_proc_wait, NULL);
     abts_run_test(suite, test_file_redir, NULL);
     abts_run_test(suite, test_proc_args, NULL);
+    abts_run_test(suite, test_proc_spawn, NULL);
+#if APR_HAS_FORK
+    abts_run_test(suite, test_proc_pool, NULL);
+#endif
+    abts_run_test(suite, test_signal_description, NULL);
 
     return suite;
 }
@@ -22,8 +22,10 @@
 #include "apr_general.h"
 #include "apr_strings.h"
 #include "apr_getopt.h"
+#include "apr_portable.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "testutil.h"
 
 #if APR_HAS_FORK
@@ -240,6 +242,60 @@ static void proc_mutex(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
 }
 
+#if APR_HAS_FUTEX_SERIALIZE
+/* A futex placed in an apr_shm, left locked by a dying child */
+static void proc_mutex_futex_owner_dead(abts_case *tc, void *data)
+{
+    apr_os_proc_mutex_t ospmutex;
+    apr_proc_mutex_t *mutex = NULL;
+    apr_shm_t *shm;
+    apr_proc_t proc;
+    apr_exit_why_e why;
+    apr_status_t rv;
+    int code;
+
+    rv = apr_shm_create(&shm, sizeof(apr_uint32_t), NULL, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "anonymous shm not implemented");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create shm segment", rv);
+
+    memset(&ospmutex, 0, sizeof(ospmutex));
+    ospmutex.futex_interproc = apr_shm_baseaddr_get(shm);
+    *ospmutex.futex_interproc = 0;
+    rv = apr_os_proc_mutex_put_ex(&mutex, &ospmutex, APR_LOCK_FUTEX, 1, p);
+    APR_ASSERT_SUCCESS(tc, "put the futex in shm", rv);
+    ABTS_STR_EQUAL(tc, "futex", apr_proc_mutex_name(mutex));
+
+    rv = apr_proc_fork(&proc, p);
+    if (rv == APR_INCHILD) {
+        _exit(apr_proc_mutex_lock(mutex) ? 1 : 0);
+    }
+    ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+    rv = apr_proc_wait(&proc, &code, &why, APR_WAIT);
+    ABTS_ASSERT(tc, "child did not terminate with success",
+                rv == APR_CHILD_DONE && why == APR_PROC_EXIT && code == 0);
+
+    /* Still owned, until a waiter notices the owner gone */
+    rv = apr_proc_mutex_trylock(mutex);
+    ABTS_ASSERT(tc, "futex should be busy", APR_STATUS_IS_EBUSY(rv));
+    rv = apr_proc_mutex_timedlock(mutex, apr_time_from_sec(5));
+    APR_ASSERT_SUCCESS(tc, "take over from the dead owner", rv);
+    rv = apr_proc_mutex_unlock(mutex);
+    APR_ASSERT_SUCCESS(tc, "unlock the futex", rv);
+
+    rv = apr_proc_mutex_trylock(mutex);
+    APR_ASSERT_SUCCESS(tc, "trylock the futex", rv);
+    rv = apr_proc_mutex_unlock(mutex);
+    APR_ASSERT_SUCCESS(tc, "unlock the futex", rv);
+
+    rv = apr_proc_mutex_destroy(mutex);
+    APR_ASSERT_SUCCESS(tc, "destroy the futex", rv);
+    rv = apr_shm_destroy(shm);
+    APR_ASSERT_SUCCESS(tc, "destroy shm segment", rv);
+}
+#endif
 
 abts_suite *testprocmutex(abts_suite *suite)
 {
@@ -259,6 +315,9 @@ abts_suite *testprocmutex(abts_suite *suite)
 #endif
 #if APR_HAS_PROC_PTHREAD_SERIALIZE
         ,{APR_LOCK_PROC_PTHREAD, "proc_pthread"}
+#endif
+#if APR_HAS_FUTEX_SERIALIZE
+        ,{APR_LOCK_FUTEX, "futex"}
 #endif
         ,{APR_LOCK_DEFAULT_TIMED, "default_timed"}
     };
@@ -268,6 +327,9 @@ abts_suite *testprocmutex(abts_suite *suite)
     for (i = 0; i < sizeof(lockmechs) / sizeof(lockmechs[0]); i++) {
         abts_run_test(suite, proc_mutex, &lockmechs[i]);
     }
+#if APR_HAS_FUTEX_SERIALIZE
+    abts_run_test(suite, proc_mutex_futex_owner_dead, NULL);
+#endif
     return suite;
 }
 
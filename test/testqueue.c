@@ -17,6 +17,8 @@
 #include "apu.h"
 #include "apr_queue.h"
 #include "apr_thread_pool.h"
+#include "apr_thread_proc.h"
+#include "apr_atomic.h"
 #include "apr_time.h"
 #include "abts.h"
 #include "testutil.h"
@@ -129,7 +131,7 @@ static void test_queue_timeout(abts_case *tc, void *data)
     unsigned int i;
     void *value;
 
-    rv = apr_queue_create(&q, 5, p);
+    rv = apr_queue_create_ex(&q, 5, data ? APR_QUEUE_LOCKFREE : 0, p);
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 
     for (i = 0; i < 2; ++i) {
@@ -170,6 +172,164 @@ static void test_queue_timeout(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+static void test_queue_batch(abts_case *tc, void *data)
+{
+    apr_queue_t *q;
+    apr_status_t rv;
+    void *in[8], *out[8];
+    unsigned int i, n;
+
+    rv = apr_queue_create_ex(&q, 5, data ? APR_QUEUE_LOCKFREE : 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 8; i++) {
+        in[i] = (char *)NULL + i + 1;
+    }
+
+    rv = apr_queue_pop_batch(q, out, 8, &n, 0);
+    ABTS_TRUE(tc, APR_STATUS_IS_EAGAIN(rv));
+    ABTS_INT_EQUAL(tc, 0, n);
+
+    /* Only 5 fit */
+    rv = apr_queue_push_batch(q, in, 8, &n, -1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 5, n);
+    ABTS_INT_EQUAL(tc, 5, apr_queue_size(q));
+
+    rv = apr_queue_push_batch(q, in + n, 8 - n, &n, apr_time_from_msec(1));
+    ABTS_TRUE(tc, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_INT_EQUAL(tc, 0, n);
+
+    rv = apr_queue_pop_batch(q, out, 3, &n, -1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, n);
+    for (i = 0; i < 3; i++) {
+        ABTS_PTR_EQUAL(tc, in[i], out[i]);
+    }
+
+    rv = apr_queue_push_batch(q, in + 5, 3, &n, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, n);
+
+    rv = apr_queue_pop_batch(q, out, 8, &n, apr_time_from_msec(1));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 5, n);
+    for (i = 0; i < 5; i++) {
+        ABTS_PTR_EQUAL(tc, in[i + 3], out[i]);
+    }
+    ABTS_INT_EQUAL(tc, 0, apr_queue_size(q));
+
+    rv = apr_queue_pop_batch(q, out, 8, &n, apr_time_from_msec(1));
+    ABTS_TRUE(tc, APR_STATUS_IS_TIMEUP(rv));
+
+    rv = apr_queue_term(q);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_queue_push_batch(q, in, 8, &n, 0);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_INT_EQUAL(tc, 0, n);
+}
+
+#define LOCKFREE_THREADS    4
+#define LOCKFREE_ITEMS      10000
+
+static volatile apr_uint32_t lockfree_popped;
+static volatile apr_uint64_t lockfree_sum;
+
+static void * APR_THREAD_FUNC lockfree_producer(apr_thread_t *thd, void *data)
+{
+    apr_queue_t *q = data;
+    apr_size_t i;
+
+    for (i = 1; i <= LOCKFREE_ITEMS; i++) {
+        while (apr_queue_push(q, (void *)i) == APR_EINTR)
+            ;
+    }
+
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC lockfree_consumer(apr_thread_t *thd, void *data)
+{
+    apr_queue_t *q = data;
+    apr_status_t rv;
+    void *v;
+
+    for (;;) {
+        rv = apr_queue_pop(q, &v);
+        if (rv == APR_EINTR)
+            continue;
+        if (rv != APR_SUCCESS)
+            break;
+        apr_atomic_add64(&lockfree_sum, (apr_size_t)v);
+        apr_atomic_inc32(&lockfree_popped);
+    }
+
+    return NULL;
+}
+
+static void test_queue_lockfree(abts_case *tc, void *data)
+{
+    apr_queue_t *q;
+    apr_status_t rv;
+    apr_thread_t *producers[LOCKFREE_THREADS], *consumers[LOCKFREE_THREADS];
+    apr_size_t i;
+    void *v;
+
+    rv = apr_queue_create_ex(&q, 3, 0x80, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    /* FIFO order, wrapping around the ring */
+    rv = apr_queue_create_ex(&q, 3, APR_QUEUE_LOCKFREE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 1; i <= 10; i++) {
+        rv = apr_queue_trypush(q, (void *)i);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_queue_trypush(q, (void *)(i + 100));
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 2, apr_queue_size(q));
+        rv = apr_queue_trypop(q, &v);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_PTR_EQUAL(tc, (void *)i, v);
+        rv = apr_queue_trypop(q, &v);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_PTR_EQUAL(tc, (void *)(i + 100), v);
+        ABTS_INT_EQUAL(tc, 0, apr_queue_size(q));
+    }
+    rv = apr_queue_term(q);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_queue_trypop(q, &v);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+
+    /* Many producers and consumers on a small ring */
+    lockfree_popped = 0;
+    lockfree_sum = 0;
+    rv = apr_queue_create_ex(&q, 16, APR_QUEUE_LOCKFREE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < LOCKFREE_THREADS; i++) {
+        rv = apr_thread_create(&consumers[i], NULL, lockfree_consumer, q, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_thread_create(&producers[i], NULL, lockfree_producer, q, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < LOCKFREE_THREADS; i++) {
+        apr_status_t retval;
+        apr_thread_join(&retval, producers[i]);
+    }
+    while (apr_queue_size(q)) {
+        apr_sleep(1000);
+    }
+    rv = apr_queue_term(q);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < LOCKFREE_THREADS; i++) {
+        apr_status_t retval;
+        apr_thread_join(&retval, consumers[i]);
+    }
+
+    ABTS_INT_EQUAL(tc, LOCKFREE_THREADS * LOCKFREE_ITEMS, lockfree_popped);
+    ABTS_TRUE(tc, lockfree_sum == (apr_uint64_t)LOCKFREE_THREADS
+                                  * LOCKFREE_ITEMS * (LOCKFREE_ITEMS + 1) / 2);
+}
+
 #endif /* APR_HAS_THREADS */
 
 abts_suite *testqueue(abts_suite *suite)
@@ -179,6 +339,10 @@ abts_suite *testqueue(abts_suite *suite)
 #if APR_HAS_THREADS
     abts_run_test(suite, test_queue_producer_consumer, NULL);
     abts_run_test(suite, test_queue_timeout, NULL);
+    abts_run_test(suite, test_queue_timeout, (void *)1);
+    abts_run_test(suite, test_queue_lockfree, NULL);
+    abts_run_test(suite, test_queue_batch, NULL);
+    abts_run_test(suite, test_queue_batch, (void *)1);
 #endif /* APR_HAS_THREADS */
 
     return suite;
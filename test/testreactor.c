@@ -0,0 +1,299 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_reactor.h"
+#include "apr_file_io.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+#include "abts.h"
+#include "testutil.h"
+
+#define NUM_TASKS 1000
+
+static apr_reactor_t *reactor;
+
+typedef struct {
+    apr_time_t start;
+    apr_interval_time_t delay;
+    int *order;
+    int *nfired;
+    int late;
+} fired_t;
+
+static void record_timer(apr_reactor_t *r, apr_reactor_timer_t *timer,
+                         void *baton)
+{
+    fired_t *f = baton;
+
+    if (apr_time_now() - f->start < f->delay) {
+        f->late = -1; /* early! */
+    }
+    f->order[(*f->nfired)++] = (int)(f->delay / 1000);
+}
+
+/* Run the reactor until the count is reached, for up to 2s */
+static void run_until(abts_case *tc, int *count, int n)
+{
+    apr_time_t deadline = apr_time_now() + apr_time_from_sec(2);
+    apr_status_t rv;
+
+    while (*count < n && apr_time_now() < deadline) {
+        rv = apr_reactor_run_once(reactor, apr_time_from_msec(100),
+                                  NULL, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, n, *count);
+}
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+
+    rv = apr_reactor_create(&reactor, 4, p, 0, APR_POLLSET_DEFAULT);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_NOTNULL(tc, apr_reactor_pollcb_get(reactor));
+}
+
+static void test_timers_order(abts_case *tc, void *data)
+{
+    /* 70ms and more are beyond the first level of the wheel */
+    static const int delays[] = { 30, 100, 10, 70, 20 };
+    static const int sorted[] = { 10, 20, 30, 70, 100 };
+    fired_t fired[5];
+    int order[5], nfired = 0;
+    apr_status_t rv;
+    int i;
+
+    if (!reactor) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        return;
+    }
+
+    for (i = 0; i < 5; i++) {
+        fired[i].start = apr_reactor_now(reactor);
+        fired[i].delay = apr_time_from_msec(delays[i]);
+        fired[i].order = order;
+        fired[i].nfired = &nfired;
+        fired[i].late = 0;
+        rv = apr_reactor_timer_add(reactor, fired[i].delay, 0,
+                                   record_timer, &fired[i], NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    run_until(tc, &nfired, 5);
+    for (i = 0; i < nfired; i++) {
+        ABTS_INT_EQUAL(tc, sorted[i], order[i]);
+        ABTS_INT_EQUAL(tc, 0, fired[i].late);
+    }
+
+    rv = apr_reactor_timer_add(reactor, -1, 0, record_timer, fired, NULL);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+}
+
+static void count_and_cancel(apr_reactor_t *r, apr_reactor_timer_t *timer,
+                             void *baton)
+{
+    int *count = baton;
+
+    if (++*count == 3) {
+        apr_reactor_timer_cancel(r, timer);
+    }
+}
+
+static void test_timer_periodic(abts_case *tc, void *data)
+{
+    apr_reactor_timer_t *timer;
+    apr_time_t start;
+    int count = 0;
+    apr_status_t rv;
+
+    if (!reactor) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        return;
+    }
+
+    rv = apr_reactor_timer_add(reactor, 0, apr_time_from_msec(5),
+                               count_and_cancel, &count, &timer);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    run_until(tc, &count, 3);
+
+    /* cancelled */
+    start = apr_time_now();
+    while (apr_time_now() - start < apr_time_from_msec(30)) {
+        rv = apr_reactor_run_once(reactor, apr_time_from_msec(10),
+                                  NULL, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, 3, count);
+}
+
+static void count_timer(apr_reactor_t *r, apr_reactor_timer_t *timer,
+                        void *baton)
+{
+    ++*(int *)baton;
+}
+
+static void test_timer_cancel(abts_case *tc, void *data)
+{
+    apr_reactor_timer_t *timer, *far;
+    apr_time_t start;
+    int count = 0;
+    apr_status_t rv;
+
+    if (!reactor) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        return;
+    }
+
+    rv = apr_reactor_timer_add(reactor, apr_time_from_msec(10), 0,
+                               count_timer, &count, &timer);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_reactor_timer_add(reactor, apr_time_from_sec(3600 * 24), 0,
+                               count_timer, &count, &far);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_reactor_timer_cancel(reactor, timer);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the far timer does not shorten the timeout */
+    start = apr_time_now();
+    rv = apr_reactor_run_once(reactor, apr_time_from_msec(30), NULL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "returned too early",
+                apr_time_now() - start >= apr_time_from_msec(20));
+    ABTS_INT_EQUAL(tc, 0, count);
+
+    rv = apr_reactor_timer_cancel(reactor, far);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_reactor_timer_cancel(reactor, far);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+}
+
+static apr_status_t read_pipe(void *baton, apr_pollfd_t *descriptor)
+{
+    char ch;
+
+    apr_file_getc(&ch, descriptor->desc.f);
+    ++*(int *)baton;
+    return APR_SUCCESS;
+}
+
+static void test_descriptor(abts_case *tc, void *data)
+{
+    apr_file_t *in, *out;
+    apr_pollfd_t pfd = { 0 };
+    int count = 0;
+    apr_status_t rv;
+
+    if (!reactor) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        return;
+    }
+
+    rv = apr_file_pipe_create(&in, &out, p);
+    APR_ASSERT_SUCCESS(tc, "create pipe", rv);
+
+    pfd.p = p;
+    pfd.desc_type = APR_POLL_FILE;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.f = in;
+    rv = apr_pollcb_add(apr_reactor_pollcb_get(reactor), &pfd);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "pipes not pollable");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_file_putc('x', out);
+    rv = apr_reactor_run_once(reactor, apr_time_from_sec(1),
+                              read_pipe, &count);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, count);
+
+    rv = apr_pollcb_remove(apr_reactor_pollcb_get(reactor), &pfd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_file_close(in);
+    apr_file_close(out);
+}
+
+#if APR_HAS_THREADS
+
+static void count_task(apr_reactor_t *r, void *baton)
+{
+    ++*(int *)baton;
+}
+
+static void stop_task(apr_reactor_t *r, void *baton)
+{
+    apr_reactor_stop(r);
+}
+
+static void * APR_THREAD_FUNC push_tasks(apr_thread_t *thd, void *data)
+{
+    int i;
+
+    for (i = 0; i < NUM_TASKS; i++) {
+        apr_reactor_task_push(reactor, count_task, data);
+    }
+    apr_reactor_task_push(reactor, stop_task, NULL);
+
+    return NULL;
+}
+
+static void test_tasks(abts_case *tc, void *data)
+{
+    apr_thread_t *thread;
+    apr_status_t rv, retval;
+    int count = 0;
+
+    if (!reactor) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        return;
+    }
+
+    rv = apr_thread_create(&thread, NULL, push_tasks, &count, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* The tasks are run by this thread only */
+    rv = apr_reactor_run(reactor, NULL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, NUM_TASKS, count);
+
+    apr_thread_join(&retval, thread);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testreactor(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_timers_order, NULL);
+    abts_run_test(suite, test_timer_periodic, NULL);
+    abts_run_test(suite, test_timer_cancel, NULL);
+    abts_run_test(suite, test_descriptor, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_tasks, NULL);
+#endif
+
+    return suite;
+}
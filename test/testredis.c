@@ -22,6 +22,7 @@
 #include "apr_hash.h"
 #include "apr_redis.h"
 #include "apr_network_io.h"
+#include "apr_thread_proc.h"
 
 #include <stdio.h>
 #if APR_HAVE_STDLIB_H
@@ -585,6 +586,891 @@ static void test_redis_setexget(abts_case * tc, void *data)
     }
 }
 
+static void test_redis_multi(abts_case * tc, void *data)
+{
+    apr_pool_t *pool = p;
+    apr_status_t rv;
+    apr_redis_t *redis;
+    apr_redis_server_t *server;
+    apr_hash_t *values = NULL, *tdata;
+    apr_hash_index_t *hi;
+    apr_array_header_t *keys;
+    apr_redis_value_t *value;
+    apr_uint32_t deleted;
+
+    if (!has_redis_server()) {
+        ABTS_SKIP(tc, data, "Redis server not found.");
+        return;
+    }
+
+    rv = apr_redis_create(pool, 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+
+    rv = apr_redis_server_create(pool, HOST, PORT, 0, 1, 1, 60, 60, &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+
+    rv = apr_redis_add_server(redis, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+
+    tdata = apr_hash_make(pool);
+    keys = apr_array_make(pool, TDATA_SET, sizeof(const char *));
+    while (apr_hash_count(tdata) < TDATA_SET) {
+        value = apr_pcalloc(pool, sizeof(*value));
+        value->key = apr_psprintf(pool, "%smulti%u", prefix,
+                                  apr_hash_count(tdata));
+        value->data = apr_pstrndup(pool, txt,
+                                   randval((apr_uint32_t)strlen(txt)));
+        value->len = strlen(value->data);
+        apr_hash_set(tdata, value->key, APR_HASH_KEY_STRING, value);
+        APR_ARRAY_PUSH(keys, const char *) = value->key;
+        apr_redis_add_multget_key(pool, value->key, &values);
+    }
+    apr_redis_add_multget_key(pool, "nothere3423", &values);
+
+    rv = apr_redis_multset(redis, pool, tdata);
+    ABTS_ASSERT(tc, "multset failed", rv == APR_SUCCESS);
+
+    rv = apr_redis_multgetp(redis, pool, pool, values);
+    ABTS_ASSERT(tc, "multgetp failed", rv == APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, TDATA_SET + 1, apr_hash_count(values));
+    for (hi = apr_hash_first(pool, tdata); hi; hi = apr_hash_next(hi)) {
+        apr_redis_value_t *set = apr_hash_this_val(hi);
+
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, set->status);
+        value = apr_hash_get(values, set->key, APR_HASH_KEY_STRING);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, value->status);
+        ABTS_INT_EQUAL(tc, set->len, value->len);
+        ABTS_STR_EQUAL(tc, set->data, value->data);
+    }
+    value = apr_hash_get(values, "nothere3423", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, value->status);
+
+    rv = apr_redis_multdelete(redis, pool, keys, &deleted);
+    ABTS_ASSERT(tc, "multdelete failed", rv == APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, TDATA_SET, deleted);
+}
+
+#if APR_HAS_THREADS
+
+/* What the pipeline sends, and what a server would reply */
+static const char pipeline_request[] =
+    "*3\r\n$3\r\nSET\r\n$2\r\nk1\r\n$2\r\nv1\r\n"
+    "*2\r\n$3\r\nGET\r\n$2\r\nk1\r\n"
+    "*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n"
+    "*2\r\n$3\r\nDEL\r\n$2\r\nk1\r\n"
+    "*3\r\n$6\r\nINCRBY\r\n$7\r\ncounter\r\n$2\r\n-5\r\n"
+    "*3\r\n$4\r\nMGET\r\n$2\r\nk1\r\n$7\r\nmissing\r\n"
+    "*2\r\n$5\r\nBOGUS\r\n$2\r\nk1\r\n";
+
+static const char pipeline_response[] =
+    "+OK\r\n"
+    "$2\r\nv1\r\n"
+    "$-1\r\n"
+    ":1\r\n"
+    ":-5\r\n"
+    "*2\r\n$2\r\nv1\r\n$-1\r\n"
+    "-ERR unknown command 'BOGUS'\r\n";
+
+typedef struct {
+    apr_socket_t *listener;
+    const char *expected;       /* the request, once complete */
+    char request[sizeof(pipeline_request)];
+    apr_size_t len;
+    const char *response;
+    apr_size_t rlen;
+} fake_server_t;
+
+static void * APR_THREAD_FUNC fake_server(apr_thread_t *thd, void *data)
+{
+    fake_server_t *fs = data;
+    apr_socket_t *sock;
+    apr_pool_t *pool;
+    apr_size_t len;
+    apr_status_t rv;
+
+    apr_pool_create(&pool, NULL);
+    rv = apr_socket_accept(&sock, fs->listener, pool);
+    if (rv == APR_SUCCESS) {
+        apr_socket_timeout_set(sock, apr_time_from_sec(5));
+        while (fs->len < strlen(fs->expected)) {
+            len = strlen(fs->expected) - fs->len;
+            rv = apr_socket_recv(sock, fs->request + fs->len, &len);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            fs->len += len;
+        }
+        while (fs->rlen) {
+            len = fs->rlen;
+            rv = apr_socket_send(sock, fs->response, &len);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            fs->response += len;
+            fs->rlen -= len;
+        }
+        apr_socket_close(sock);
+    }
+    apr_pool_destroy(pool);
+
+    return NULL;
+}
+
+static void test_redis_pipeline(abts_case * tc, void *data)
+{
+    apr_pool_t *pool;
+    apr_status_t rv;
+    apr_redis_t *redis;
+    apr_redis_server_t *server;
+    apr_redis_pipeline_t *pl;
+    apr_redis_reply_t *set, *get, *missing, *del, *incr, *mget, *bogus;
+    apr_sockaddr_t *sa;
+    apr_thread_t *thread;
+    fake_server_t fs = { 0 };
+    const char *argv[3];
+
+    apr_pool_create(&pool, p);
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, pool);
+    APR_ASSERT_SUCCESS(tc, "sockaddr failed", rv);
+    rv = apr_socket_create(&fs.listener, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, pool);
+    APR_ASSERT_SUCCESS(tc, "socket create failed", rv);
+    rv = apr_socket_bind(fs.listener, sa);
+    APR_ASSERT_SUCCESS(tc, "socket bind failed", rv);
+    rv = apr_socket_listen(fs.listener, 1);
+    APR_ASSERT_SUCCESS(tc, "socket listen failed", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, fs.listener);
+    APR_ASSERT_SUCCESS(tc, "socket addr failed", rv);
+
+    rv = apr_redis_create(pool, 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+    rv = apr_redis_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1, 60, 60,
+                                 &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_redis_add_server(redis, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+
+    fs.expected = pipeline_request;
+    fs.response = pipeline_response;
+    fs.rlen = sizeof(pipeline_response) - 1;
+    rv = apr_thread_create(&thread, NULL, fake_server, &fs, pool);
+    APR_ASSERT_SUCCESS(tc, "thread create failed", rv);
+
+    rv = apr_redis_pipeline_create(&pl, redis, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_pipeline_set(pl, "k1", "v1", 2, &set));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_redis_pipeline_get(pl, "k1", &get));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_pipeline_get(pl, "missing", &missing));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_pipeline_delete(pl, "k1", &del));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_pipeline_incr(pl, "counter", -5, &incr));
+    argv[0] = "MGET";
+    argv[1] = "k1";
+    argv[2] = "missing";
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_pipeline_add(pl, "k1", 3, argv, NULL, &mget));
+    argv[0] = "BOGUS";
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_pipeline_add(pl, "k1", 2, argv, NULL, &bogus));
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, set->status);
+
+    rv = apr_redis_pipeline_exec(pl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_join(&rv, thread);
+
+    /* all the commands were sent in one go, before any reply */
+    ABTS_INT_EQUAL(tc, sizeof(pipeline_request) - 1, fs.len);
+    ABTS_STR_EQUAL(tc, pipeline_request, fs.request);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, set->status);
+    ABTS_INT_EQUAL(tc, APR_RR_STATUS, set->type);
+    ABTS_STR_EQUAL(tc, "OK", set->str);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, get->status);
+    ABTS_INT_EQUAL(tc, APR_RR_STRING, get->type);
+    ABTS_INT_EQUAL(tc, 2, get->len);
+    ABTS_STR_EQUAL(tc, "v1", get->str);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, missing->status);
+    ABTS_INT_EQUAL(tc, APR_RR_NIL, missing->type);
+    ABTS_INT_EQUAL(tc, APR_RR_INTEGER, del->type);
+    ABTS_INT_EQUAL(tc, 1, (int)del->integer);
+    ABTS_INT_EQUAL(tc, -5, (int)incr->integer);
+    ABTS_INT_EQUAL(tc, APR_RR_ARRAY, mget->type);
+    ABTS_INT_EQUAL(tc, 2, mget->nelts);
+    if (mget->nelts == 2) {
+        ABTS_STR_EQUAL(tc, "v1", mget->elts[0]->str);
+        ABTS_INT_EQUAL(tc, APR_NOTFOUND, mget->elts[1]->status);
+    }
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, bogus->status);
+    ABTS_INT_EQUAL(tc, APR_RR_ERROR, bogus->type);
+    ABTS_STR_EQUAL(tc, "ERR unknown command 'BOGUS'", bogus->str);
+
+    /* the pipeline is empty now */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_redis_pipeline_exec(pl));
+
+    /* and nothing listens anymore */
+    apr_socket_close(fs.listener);
+    rv = apr_redis_create(pool, 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+    rv = apr_redis_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1, 60, 60,
+                                 &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_redis_add_server(redis, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+    rv = apr_redis_pipeline_create(&pl, redis, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_redis_pipeline_get(pl, "k1", &get));
+    rv = apr_redis_pipeline_exec(pl);
+    ABTS_TRUE(tc, rv != APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, rv, get->status);
+    ABTS_INT_EQUAL(tc, APR_RC_SERVER_DEAD, server->status);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, apr_redis_pipeline_get(pl, "k1", &get));
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, get->status);
+
+    apr_pool_destroy(pool);
+}
+
+/* The RESP3 replies, and arrays too large for the first buffer */
+#define BIG_LEN 100000
+
+static void test_redis_resp3(abts_case * tc, void *data)
+{
+    apr_pool_t *pool;
+    apr_status_t rv;
+    apr_redis_t *redis;
+    apr_redis_server_t *server;
+    apr_redis_pipeline_t *pl;
+    apr_redis_reply_t *r[6];
+    apr_sockaddr_t *sa;
+    apr_thread_t *thread;
+    fake_server_t fs = { 0 };
+    const char *argv[1];
+    char cmd[3], *big;
+    int i;
+
+    apr_pool_create(&pool, p);
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, pool);
+    APR_ASSERT_SUCCESS(tc, "sockaddr failed", rv);
+    rv = apr_socket_create(&fs.listener, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, pool);
+    APR_ASSERT_SUCCESS(tc, "socket create failed", rv);
+    rv = apr_socket_bind(fs.listener, sa);
+    APR_ASSERT_SUCCESS(tc, "socket bind failed", rv);
+    rv = apr_socket_listen(fs.listener, 1);
+    APR_ASSERT_SUCCESS(tc, "socket listen failed", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, fs.listener);
+    APR_ASSERT_SUCCESS(tc, "socket addr failed", rv);
+
+    rv = apr_redis_create(pool, 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+    rv = apr_redis_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1, 60, 60,
+                                 &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_redis_add_server(redis, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+
+    big = apr_palloc(pool, BIG_LEN + 1);
+    memset(big, 'x', BIG_LEN);
+    big[BIG_LEN] = '\0';
+
+    fs.expected = "*1\r\n$2\r\nX0\r\n*1\r\n$2\r\nX1\r\n*1\r\n$2\r\nX2\r\n"
+                  "*1\r\n$2\r\nX3\r\n*1\r\n$2\r\nX4\r\n*1\r\n$2\r\nX5\r\n";
+    fs.response = apr_pstrcat(pool,
+        "|1\r\n+ttl\r\n:3\r\n%2\r\n+a\r\n#t\r\n+b\r\n,1.5\r\n",
+        "~2\r\n_\r\n=8\r\ntxt:abcd\r\n",
+        "(12345678901234567890\r\n",
+        "!5\r\nERR x\r\n",
+        "*3\r\n$", apr_itoa(pool, BIG_LEN), "\r\n", big, "\r\n",
+        "*1\r\n*0\r\n$", apr_itoa(pool, BIG_LEN), "\r\n", big, "\r\n",
+        ">2\r\n+pushed\r\n:1\r\n", NULL);
+    fs.rlen = strlen(fs.response);
+    rv = apr_thread_create(&thread, NULL, fake_server, &fs, pool);
+    APR_ASSERT_SUCCESS(tc, "thread create failed", rv);
+
+    rv = apr_redis_pipeline_create(&pl, redis, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 6; i++) {
+        apr_snprintf(cmd, sizeof(cmd), "X%d", i);
+        argv[0] = cmd;
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_redis_pipeline_add(pl, "k", 1, argv, NULL, &r[i]));
+    }
+    rv = apr_redis_pipeline_exec(pl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_join(&rv, thread);
+
+    /* the attribute is skipped */
+    ABTS_INT_EQUAL(tc, APR_RR_MAP, r[0]->type);
+    ABTS_INT_EQUAL(tc, 4, r[0]->nelts);
+    if (r[0]->nelts == 4) {
+        ABTS_STR_EQUAL(tc, "a", r[0]->elts[0]->str);
+        ABTS_INT_EQUAL(tc, APR_RR_BOOLEAN, r[0]->elts[1]->type);
+        ABTS_INT_EQUAL(tc, 1, (int)r[0]->elts[1]->integer);
+        ABTS_INT_EQUAL(tc, APR_RR_DOUBLE, r[0]->elts[3]->type);
+        ABTS_STR_EQUAL(tc, "1.5", r[0]->elts[3]->str);
+        ABTS_TRUE(tc, r[0]->elts[3]->number == 1.5);
+    }
+    ABTS_INT_EQUAL(tc, APR_RR_SET, r[1]->type);
+    ABTS_INT_EQUAL(tc, 2, r[1]->nelts);
+    if (r[1]->nelts == 2) {
+        ABTS_INT_EQUAL(tc, APR_RR_NIL, r[1]->elts[0]->type);
+        ABTS_INT_EQUAL(tc, APR_NOTFOUND, r[1]->elts[0]->status);
+        ABTS_INT_EQUAL(tc, APR_RR_STRING, r[1]->elts[1]->type);
+        ABTS_INT_EQUAL(tc, 4, r[1]->elts[1]->len);
+        ABTS_STR_EQUAL(tc, "abcd", r[1]->elts[1]->str);
+    }
+    ABTS_INT_EQUAL(tc, APR_RR_BIGNUM, r[2]->type);
+    ABTS_STR_EQUAL(tc, "12345678901234567890", r[2]->str);
+    ABTS_INT_EQUAL(tc, APR_RR_ERROR, r[3]->type);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, r[3]->status);
+    ABTS_STR_EQUAL(tc, "ERR x", r[3]->str);
+    ABTS_INT_EQUAL(tc, APR_RR_ARRAY, r[4]->type);
+    ABTS_INT_EQUAL(tc, 3, r[4]->nelts);
+    if (r[4]->nelts == 3) {
+        ABTS_INT_EQUAL(tc, BIG_LEN, r[4]->elts[0]->len);
+        ABTS_STR_EQUAL(tc, big, r[4]->elts[0]->str);
+        ABTS_INT_EQUAL(tc, 1, r[4]->elts[1]->nelts);
+        ABTS_INT_EQUAL(tc, 0, r[4]->elts[1]->elts[0]->nelts);
+        ABTS_STR_EQUAL(tc, big, r[4]->elts[2]->str);
+    }
+    ABTS_INT_EQUAL(tc, APR_RR_PUSH, r[5]->type);
+    ABTS_INT_EQUAL(tc, 2, r[5]->nelts);
+    if (r[5]->nelts == 2) {
+        ABTS_STR_EQUAL(tc, "pushed", r[5]->elts[0]->str);
+        ABTS_INT_EQUAL(tc, 1, (int)r[5]->elts[1]->integer);
+    }
+
+    apr_socket_close(fs.listener);
+    apr_pool_destroy(pool);
+}
+
+/* A server of one subscriber and one client connection, which invalidates
+ * the key after the first GET and flushes everything after the second.
+ */
+typedef struct {
+    apr_socket_t *sock;
+    char buf[1024];
+    apr_size_t have;
+} fake_conn_t;
+
+typedef struct {
+    apr_socket_t *listener;
+    char commands[1024];
+    int gets;
+    int trackings;
+} tracking_server_t;
+
+static const char subscribed[] =
+    "*3\r\n$9\r\nsubscribe\r\n$20\r\n__redis__:invalidate\r\n:1\r\n";
+static const char invalidated[] =
+    "*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n"
+    "*1\r\n$2\r\nk1\r\n";
+static const char flushed[] =
+    "*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*-1\r\n";
+
+static int fake_line(fake_conn_t *fc, char *line, apr_size_t size)
+{
+    char *eol;
+    apr_size_t len;
+
+    while ((eol = memchr(fc->buf, '\n', fc->have)) == NULL) {
+        len = sizeof(fc->buf) - fc->have;
+        if (len == 0 || apr_socket_recv(fc->sock, fc->buf + fc->have,
+                                        &len) != APR_SUCCESS) {
+            return 0;
+        }
+        fc->have += len;
+    }
+
+    /* without the \r\n */
+    len = eol + 1 - fc->buf;
+    apr_cpystrn(line, fc->buf, len - 1 < size ? len - 1 : size);
+    fc->have -= len;
+    memmove(fc->buf, eol + 1, fc->have);
+    return 1;
+}
+
+/* reads a command, its arguments joined by spaces */
+static int fake_command(fake_conn_t *fc, char *cmd, apr_size_t size)
+{
+    char line[256];
+    int argc;
+
+    cmd[0] = '\0';
+    if (!fake_line(fc, line, sizeof(line)) || line[0] != '*') {
+        return 0;
+    }
+    for (argc = atoi(line + 1); argc > 0; argc--) {
+        if (!fake_line(fc, line, sizeof(line))
+                || !fake_line(fc, line, sizeof(line))) {
+            return 0;
+        }
+        if (cmd[0]) {
+            apr_cpystrn(cmd + strlen(cmd), " ", size - strlen(cmd));
+        }
+        apr_cpystrn(cmd + strlen(cmd), line, size - strlen(cmd));
+    }
+    return 1;
+}
+
+static void fake_send_str(apr_socket_t *sock, const char *str)
+{
+    apr_size_t len = strlen(str);
+
+    while (len && apr_socket_send(sock, str, &len) == APR_SUCCESS) {
+        str += len;
+        len = strlen(str);
+    }
+}
+
+static void * APR_THREAD_FUNC tracking_server(apr_thread_t *thd, void *data)
+{
+    tracking_server_t *ts = data;
+    fake_conn_t sub = { 0 }, client = { 0 };
+    char cmd[256];
+    apr_pool_t *pool;
+
+    apr_pool_create(&pool, NULL);
+    if (apr_socket_accept(&sub.sock, ts->listener, pool) != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return NULL;
+    }
+    apr_socket_timeout_set(sub.sock, apr_time_from_sec(5));
+    if (fake_command(&sub, cmd, sizeof(cmd)) && !strcmp(cmd, "CLIENT ID")) {
+        fake_send_str(sub.sock, ":7\r\n");
+    }
+    if (fake_command(&sub, cmd, sizeof(cmd))
+            && !strcmp(cmd, "SUBSCRIBE __redis__:invalidate")) {
+        fake_send_str(sub.sock, subscribed);
+    }
+
+    if (apr_socket_accept(&client.sock, ts->listener, pool) == APR_SUCCESS) {
+        apr_socket_timeout_set(client.sock, apr_time_from_sec(5));
+        /* until the client closes the connection */
+        while (fake_command(&client, cmd, sizeof(cmd))) {
+            apr_cpystrn(ts->commands + strlen(ts->commands), cmd,
+                        sizeof(ts->commands) - strlen(ts->commands));
+            apr_cpystrn(ts->commands + strlen(ts->commands), "|",
+                        sizeof(ts->commands) - strlen(ts->commands));
+            if (!strncmp(cmd, "CLIENT TRACKING", 15)) {
+                ts->trackings++;
+                fake_send_str(client.sock, "+OK\r\n");
+            }
+            else if (!strcmp(cmd, "GET k1")) {
+                fake_send_str(client.sock, "$2\r\nv1\r\n");
+                fake_send_str(sub.sock, ts->gets++ ? flushed : invalidated);
+            }
+        }
+        apr_socket_close(client.sock);
+    }
+    apr_socket_close(sub.sock);
+    apr_pool_destroy(pool);
+
+    return NULL;
+}
+
+static void test_redis_tracking(abts_case * tc, void *data)
+{
+    apr_pool_t *pool, *tpool;
+    apr_status_t rv;
+    apr_redis_t *redis;
+    apr_redis_server_t *server;
+    apr_redis_tracking_t *tr;
+    apr_nearcache_stats_t stats;
+    apr_sockaddr_t *sa;
+    apr_thread_t *thread;
+    tracking_server_t ts = { 0 };
+    apr_size_t len;
+    char *result;
+
+    apr_pool_create(&tpool, p);
+    apr_pool_create(&pool, p);
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, tpool);
+    APR_ASSERT_SUCCESS(tc, "sockaddr failed", rv);
+    rv = apr_socket_create(&ts.listener, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, tpool);
+    APR_ASSERT_SUCCESS(tc, "socket create failed", rv);
+    rv = apr_socket_bind(ts.listener, sa);
+    APR_ASSERT_SUCCESS(tc, "socket bind failed", rv);
+    rv = apr_socket_listen(ts.listener, 2);
+    APR_ASSERT_SUCCESS(tc, "socket listen failed", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, ts.listener);
+    APR_ASSERT_SUCCESS(tc, "socket addr failed", rv);
+
+    rv = apr_redis_create(pool, 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+    /* a single connection, kept (the ttl is in microseconds) */
+    rv = apr_redis_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1,
+                                 apr_time_from_sec(60), 60, &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_redis_add_server(redis, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+    rv = apr_nearcache_create(&redis->nearcache, 64 * 1024, 0, 0, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_create(&thread, NULL, tracking_server, &ts, tpool);
+    APR_ASSERT_SUCCESS(tc, "thread create failed", rv);
+
+    rv = apr_redis_tracking_create(&tr, redis, server, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 7, (int)server->tracking_id);
+
+    /* got from the server then cached, until invalidated */
+    rv = apr_redis_getp(redis, pool, "k1", &result, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "v1", result);
+    rv = apr_redis_getp(redis, pool, "k1", &result, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "v1", result);
+    rv = apr_redis_tracking_process(tr, apr_time_from_sec(5));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_redis_getp(redis, pool, "k1", &result, &len, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "v1", result);
+
+    /* then flushed */
+    rv = apr_redis_tracking_process(tr, apr_time_from_sec(5));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_nearcache_stats_get(redis->nearcache, &stats);
+    ABTS_SIZE_EQUAL(tc, 0, stats.entries);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.hits);
+
+    rv = apr_redis_tracking_process(tr, apr_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, APR_TIMEUP, rv);
+
+    /* closes the connections, ending the server */
+    apr_pool_destroy(pool);
+    apr_thread_join(&rv, thread);
+    ABTS_INT_EQUAL(tc, 1, ts.trackings);
+    ABTS_INT_EQUAL(tc, 2, ts.gets);
+    ABTS_TRUE(tc, strncmp(ts.commands,
+                          "CLIENT TRACKING on REDIRECT 7|GET k1|GET k1|",
+                          44) == 0);
+    apr_pool_destroy(tpool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+/* The asynchronous connection is served by the test itself, the replies
+ * being sent a few bytes at a time to be parsed as they come.
+ */
+
+typedef struct {
+    int n;
+    apr_redis_reply_t *replies[8];
+} async_results_t;
+
+static void async_done(apr_redis_async_t *ac, apr_redis_reply_t *reply,
+                       void *baton)
+{
+    async_results_t *r = baton;
+
+    r->replies[r->n++] = reply;
+}
+
+static apr_status_t async_poll_cb(void *baton, apr_pollfd_t *pfd)
+{
+    return apr_redis_async_process(pfd->client_data, pfd->rtnevents);
+}
+
+static void async_recv(abts_case *tc, apr_socket_t *sock,
+                       const char *expected)
+{
+    apr_size_t len = strlen(expected), have = 0, n;
+    char buf[512];
+
+    while (have < len) {
+        n = len - have;
+        if (apr_socket_recv(sock, buf + have, &n) != APR_SUCCESS) {
+            break;
+        }
+        have += n;
+    }
+    buf[have] = '\0';
+    ABTS_STR_EQUAL(tc, expected, buf);
+}
+
+#define ASYNC_LARGE 10000
+
+static void test_redis_async(abts_case * tc, void *data)
+{
+    apr_pool_t *pool;
+    apr_status_t rv;
+    apr_redis_server_t *server;
+    apr_redis_async_t *ac;
+    apr_pollcb_t *pollcb;
+    apr_socket_t *listener, *sock;
+    apr_sockaddr_t *sa;
+    async_results_t results = { 0 };
+    const char *keys[3] = { "k1", "k2", "missing" };
+    const char *bogus[1] = { "BOGUS" };
+    char *large, *replies;
+    apr_size_t i, len;
+
+    apr_pool_create(&pool, p);
+
+    rv = apr_pollcb_create(&pollcb, 4, pool, 0);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_pollcb not supported");
+        apr_pool_destroy(pool);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "pollcb create failed", rv);
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, pool);
+    APR_ASSERT_SUCCESS(tc, "sockaddr failed", rv);
+    rv = apr_socket_create(&listener, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, pool);
+    APR_ASSERT_SUCCESS(tc, "socket create failed", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "socket bind failed", rv);
+    rv = apr_socket_listen(listener, 1);
+    APR_ASSERT_SUCCESS(tc, "socket listen failed", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "socket addr failed", rv);
+
+    rv = apr_redis_server_create(pool, "127.0.0.1", sa->port, 0, 1, 1, 60,
+                                 60, &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_redis_async_create(&ac, server, pollcb, NULL, pool);
+    APR_ASSERT_SUCCESS(tc, "async create failed", rv);
+    rv = apr_socket_accept(&sock, listener, pool);
+    APR_ASSERT_SUCCESS(tc, "socket accept failed", rv);
+    apr_socket_timeout_set(sock, apr_time_from_sec(5));
+
+    /* all sent before any reply */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_set(ac, pool, "k1", "v1", 2,
+                                       async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_get(ac, pool, "k1",
+                                       async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_get(ac, pool, "missing",
+                                       async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_mget(ac, pool, 3, keys,
+                                        async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_command(ac, pool, 1, bogus, NULL,
+                                           async_done, &results));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_get(ac, pool, "large",
+                                       async_done, &results));
+    ABTS_SIZE_EQUAL(tc, 6, apr_redis_async_pending(ac));
+
+    async_recv(tc, sock,
+               "*3\r\n$3\r\nSET\r\n$2\r\nk1\r\n$2\r\nv1\r\n"
+               "*2\r\n$3\r\nGET\r\n$2\r\nk1\r\n"
+               "*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n"
+               "*4\r\n$4\r\nMGET\r\n$2\r\nk1\r\n$2\r\nk2\r\n"
+               "$7\r\nmissing\r\n"
+               "*1\r\n$5\r\nBOGUS\r\n"
+               "*2\r\n$3\r\nGET\r\n$5\r\nlarge\r\n");
+
+    /* the last reply is larger than the connection's buffer */
+    large = apr_palloc(pool, ASYNC_LARGE + 1);
+    memset(large, 'x', ASYNC_LARGE);
+    large[ASYNC_LARGE] = '\0';
+    replies = apr_pstrcat(pool,
+                          "+OK\r\n"
+                          "$2\r\nv1\r\n"
+                          "$-1\r\n"
+                          "*3\r\n$2\r\nv1\r\n$3\r\nabc\r\n$-1\r\n"
+                          "-ERR unknown command\r\n",
+                          apr_psprintf(pool, "$%d\r\n", ASYNC_LARGE),
+                          large, "\r\n", NULL);
+    len = strlen(replies);
+    for (i = 0; i < len; i += 7) {
+        apr_size_t n = len - i;
+
+        if (n > 7 && i < 100) {
+            n = 7;
+        }
+        apr_socket_send(sock, replies + i, &n);
+        rv = apr_pollcb_poll(pollcb, apr_time_from_sec(1), async_poll_cb,
+                             NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (n > 7) {
+            break;
+        }
+    }
+    while (results.n < 6 && rv == APR_SUCCESS) {
+        rv = apr_pollcb_poll(pollcb, apr_time_from_sec(1), async_poll_cb,
+                             NULL);
+    }
+    ABTS_INT_EQUAL(tc, 6, results.n);
+    ABTS_SIZE_EQUAL(tc, 0, apr_redis_async_pending(ac));
+    if (results.n != 6) {
+        apr_pool_destroy(pool);
+        return;
+    }
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, results.replies[0]->status);
+    ABTS_INT_EQUAL(tc, APR_RR_STATUS, results.replies[0]->type);
+    ABTS_STR_EQUAL(tc, "OK", results.replies[0]->str);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, results.replies[1]->status);
+    ABTS_STR_EQUAL(tc, "v1", results.replies[1]->str);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, results.replies[2]->status);
+    ABTS_INT_EQUAL(tc, APR_RR_ARRAY, results.replies[3]->type);
+    ABTS_SIZE_EQUAL(tc, 3, results.replies[3]->nelts);
+    if (results.replies[3]->nelts == 3) {
+        ABTS_STR_EQUAL(tc, "v1", results.replies[3]->elts[0]->str);
+        ABTS_STR_EQUAL(tc, "abc", results.replies[3]->elts[1]->str);
+        ABTS_INT_EQUAL(tc, APR_NOTFOUND,
+                       results.replies[3]->elts[2]->status);
+    }
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, results.replies[4]->status);
+    ABTS_STR_EQUAL(tc, "ERR unknown command", results.replies[4]->str);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, results.replies[5]->status);
+    ABTS_SIZE_EQUAL(tc, ASYNC_LARGE, results.replies[5]->len);
+    ABTS_STR_EQUAL(tc, large, results.replies[5]->str);
+
+    /* the pending commands fail with the connection */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_redis_async_get(ac, pool, "k1",
+                                       async_done, &results));
+    apr_socket_close(sock);
+    rv = apr_pollcb_poll(pollcb, apr_time_from_sec(1), async_poll_cb, NULL);
+    ABTS_TRUE(tc, rv != APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, 7, results.n);
+    ABTS_INT_EQUAL(tc, rv, results.replies[6]->status);
+    ABTS_INT_EQUAL(tc, rv, apr_redis_async_get(ac, pool, "k1",
+                                               async_done, &results));
+    ABTS_INT_EQUAL(tc, 7, results.n);
+
+    apr_pool_destroy(pool);
+}
+
+/* consistent hashing moves few keys when a server is added or disabled,
+ * no server needs to be running since none is connected to.
+ */
+
+#define CONSISTENT_SERVERS 40
+#define CONSISTENT_KEYS 1000
+
+static void consistent_map(apr_redis_t *redis, apr_redis_server_t **map)
+{
+    int i;
+
+    for (i = 0; i < CONSISTENT_KEYS; i++) {
+        char key[32];
+        apr_uint32_t hash;
+
+        apr_snprintf(key, sizeof(key), "%s%d", prefix, i);
+        hash = apr_redis_hash(redis, key, strlen(key));
+        map[i] = apr_redis_find_server_hash(redis, hash);
+    }
+}
+
+static void consistent_check(abts_case *tc, apr_redis_t *redis,
+                             int ketama)
+{
+    apr_pool_t *pool = p;
+    apr_status_t rv;
+    apr_redis_continuum_t *continuum;
+    apr_redis_server_t *server;
+    apr_redis_server_t *before[CONSISTENT_KEYS], *after[CONSISTENT_KEYS];
+    int i, moved, mapped;
+
+    for (i = 0; i < CONSISTENT_SERVERS; i++) {
+        rv = apr_redis_server_create(pool, HOST, PORT + i, 0, 1, 1, 60, 60,
+                                     &server);
+        ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+        rv = apr_redis_add_server(redis, server);
+        ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+    }
+    if (ketama) {
+        rv = apr_redis_continuum_create(&continuum, redis, 0, pool);
+        ABTS_ASSERT(tc, "continuum create failed", rv == APR_SUCCESS);
+        redis->server_baton = continuum;
+    }
+    consistent_map(redis, before);
+
+    /* every server gets some keys */
+    for (i = 0, mapped = 0; i < CONSISTENT_KEYS; i++) {
+        ABTS_PTR_NOTNULL(tc, before[i]);
+        if (before[i] == redis->live_servers[0]) {
+            mapped++;
+        }
+    }
+    ABTS_ASSERT(tc, "server has no key", mapped > 0);
+
+    /* one more server takes about 1/41 of the keys */
+    rv = apr_redis_server_create(pool, HOST, PORT + i, 0, 1, 1, 60, 60,
+                                 &server);
+    ABTS_ASSERT(tc, "server create failed", rv == APR_SUCCESS);
+    rv = apr_redis_add_server(redis, server);
+    ABTS_ASSERT(tc, "server add failed", rv == APR_SUCCESS);
+    if (ketama) {
+        rv = apr_redis_continuum_create(&continuum, redis, 0, pool);
+        ABTS_ASSERT(tc, "continuum create failed", rv == APR_SUCCESS);
+        redis->server_baton = continuum;
+    }
+    consistent_map(redis, after);
+    for (i = 0, moved = 0; i < CONSISTENT_KEYS; i++) {
+        if (after[i] != before[i]) {
+            ABTS_PTR_EQUAL(tc, server, after[i]);
+            moved++;
+        }
+    }
+    ABTS_ASSERT(tc, "too many keys moved", moved < CONSISTENT_KEYS / 10);
+
+    /* only the keys of a dead server move */
+    consistent_map(redis, before);
+    server = redis->live_servers[CONSISTENT_SERVERS / 2];
+    rv = apr_redis_disable_server(redis, server);
+    ABTS_ASSERT(tc, "server disable failed", rv == APR_SUCCESS);
+    consistent_map(redis, after);
+    for (i = 0, moved = 0; i < CONSISTENT_KEYS; i++) {
+        ABTS_PTR_NOTNULL(tc, after[i]);
+        ABTS_ASSERT(tc, "dead server selected", after[i] != server);
+        if (after[i] != before[i]) {
+            ABTS_PTR_EQUAL(tc, server, before[i]);
+            moved++;
+        }
+    }
+    ABTS_ASSERT(tc, "too many keys moved", moved < CONSISTENT_KEYS / 10);
+
+    rv = apr_redis_enable_server(redis, server);
+    ABTS_ASSERT(tc, "server enable failed", rv == APR_SUCCESS);
+    consistent_map(redis, after);
+    for (i = 0; i < CONSISTENT_KEYS; i++) {
+        ABTS_PTR_EQUAL(tc, before[i], after[i]);
+    }
+}
+
+static void test_redis_ketama(abts_case * tc, void *data)
+{
+    apr_status_t rv;
+    apr_redis_t *redis;
+
+    rv = apr_redis_create(p, CONSISTENT_SERVERS + 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+
+    redis->hash_func = apr_redis_hash_ketama;
+    redis->server_func = apr_redis_find_server_hash_ketama;
+    consistent_check(tc, redis, 1);
+}
+
+static void test_redis_jump(abts_case * tc, void *data)
+{
+    apr_status_t rv;
+    apr_redis_t *redis;
+
+    rv = apr_redis_create(p, CONSISTENT_SERVERS + 1, 0, &redis);
+    ABTS_ASSERT(tc, "redis create failed", rv == APR_SUCCESS);
+
+    redis->hash_func = apr_redis_hash_crc32;
+    redis->server_func = apr_redis_find_server_hash_jump;
+    consistent_check(tc, redis, 0);
+}
+
 abts_suite *testredis(abts_suite * suite)
 {
     suite = ADD_SUITE(suite);
@@ -596,6 +1482,15 @@ abts_suite *testredis(abts_suite * suite)
     abts_run_test(suite, test_redis_setexget, NULL);
     /* abts_run_test(suite, test_redis_multiget, NULL); */
     abts_run_test(suite, test_redis_incrdecr, NULL);
+    abts_run_test(suite, test_redis_multi, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_redis_pipeline, NULL);
+    abts_run_test(suite, test_redis_resp3, NULL);
+    abts_run_test(suite, test_redis_tracking, NULL);
+#endif
+    abts_run_test(suite, test_redis_async, NULL);
+    abts_run_test(suite, test_redis_ketama, NULL);
+    abts_run_test(suite, test_redis_jump, NULL);
 
     return suite;
 }
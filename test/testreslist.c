@@ -21,6 +21,7 @@
 #include "apu.h"
 #include "apr_reslist.h"
 #include "apr_thread_pool.h"
+#include "apr_portable.h"
 
 #if APR_HAVE_TIME_H
 #include <time.h>
@@ -46,6 +47,10 @@ typedef struct {
     apr_interval_time_t sleep_upon_destruct;
     int c_count;
     int d_count;
+    int v_count;
+    int v_fail;               /* the validator fails */
+    apr_status_t status;      /* returned by the constructor if not success */
+    apr_os_thread_t c_thread; /* of the last constructor call */
 } my_parameters_t;
 
 typedef struct {
@@ -67,6 +72,11 @@ static apr_status_t my_constructor(void **resource, void *params,
     my_resource_t *res;
     my_parameters_t *my_params = params;
 
+    my_params->c_thread = apr_os_thread_current();
+    if (my_params->status != APR_SUCCESS) {
+        return my_params->status;
+    }
+
     /* Create some resource */
     res = apr_palloc(pool, sizeof(*res));
     res->id = my_params->c_count++;
@@ -91,6 +101,16 @@ static apr_status_t my_destructor(void *resource, void *params,
     return APR_SUCCESS;
 }
 
+static apr_status_t my_validator(void *resource, void *params,
+                                 apr_pool_t *pool)
+{
+    my_parameters_t *my_params = params;
+
+    my_params->v_count++;
+
+    return my_params->v_fail ? APR_EGENERAL : APR_SUCCESS;
+}
+
 typedef struct {
     int tid;
     abts_case *tc;
@@ -299,6 +319,270 @@ static void test_reslist_no_ttl(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, params->d_count, 1);
 }
 
+static void test_reslist_sharded(abts_case *tc, void *data)
+{
+    int i;
+    apr_status_t rv;
+    apr_reslist_t *rl;
+    my_parameters_t *params;
+    apr_thread_pool_t *thrp;
+    my_thread_info_t thread_info[CONSUMER_THREADS];
+
+    rv = apr_thread_pool_create(&thrp, CONSUMER_THREADS/2, CONSUMER_THREADS, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    params = apr_pcalloc(p, sizeof(*params));
+    params->sleep_upon_construct = CONSTRUCT_SLEEP_TIME;
+    params->sleep_upon_destruct = DESTRUCT_SLEEP_TIME;
+
+    rv = apr_reslist_create(&rl, RESLIST_MIN, RESLIST_SMAX, RESLIST_HMAX,
+                            RESLIST_TTL, my_constructor, my_destructor,
+                            params, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_reslist_shards_set(rl, -1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_reslist_shards_set(rl, 4);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_reslist_shards_set(rl, 4);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    for (i = 0; i < CONSUMER_THREADS; i++) {
+        thread_info[i].tid = i;
+        thread_info[i].tc = tc;
+        thread_info[i].reslist = rl;
+        thread_info[i].work_delay_sleep = WORK_DELAY_SLEEP_TIME;
+        thread_info[i].acquire_flags = (int)(apr_uintptr_t)data;
+        rv = apr_thread_pool_push(thrp, resource_consuming_thread,
+                                  &thread_info[i], 0, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_reslist_acquired_count(rl));
+    ABTS_TRUE(tc, params->c_count - params->d_count <= RESLIST_HMAX);
+
+    /* The hard maximum holds across the shards */
+    test_timeout(tc, rl, (int)(apr_uintptr_t)data);
+
+    /* All expired, the maintenance shrinks the list back to smax */
+    apr_sleep(RESLIST_TTL);
+    rv = apr_reslist_maintain(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, RESLIST_SMAX, params->c_count - params->d_count);
+
+    rv = apr_reslist_destroy(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, params->c_count, params->d_count);
+}
+
+static void * APR_THREAD_FUNC shard_thread(apr_thread_t *thd, void *data)
+{
+    apr_reslist_t *rl = data;
+    my_resource_t *res;
+    apr_status_t rv;
+
+    rv = apr_reslist_acquire(rl, (void **)&res);
+    if (rv == APR_SUCCESS) {
+        rv = apr_reslist_release(rl, res);
+    }
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_reslist_shards_steal(abts_case *tc, void *data)
+{
+    apr_status_t rv, thread_rv;
+    apr_reslist_t *rl;
+    apr_thread_t *thd;
+    my_parameters_t *params;
+    my_resource_t *res;
+
+    params = apr_pcalloc(p, sizeof(*params));
+
+    rv = apr_reslist_create(&rl, 0, 0, /*max*/1, 0,
+                            my_constructor, my_destructor, params, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_reslist_shards_set(rl, 2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_reslist_timeout_set(rl, apr_time_from_sec(10));
+
+    /* Released to the thread's shard, acquired from ours */
+    rv = apr_thread_create(&thd, NULL, shard_thread, rl, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_join(&thread_rv, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, thread_rv);
+
+    rv = apr_reslist_acquire(rl, (void **)&res);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, res->id);
+    ABTS_INT_EQUAL(tc, 1, apr_reslist_acquired_count(rl));
+
+    /* Released to our shard, waited for by the thread */
+    rv = apr_thread_create(&thd, NULL, shard_thread, rl, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_sleep(apr_time_from_msec(50));
+    rv = apr_reslist_release(rl, res);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_join(&thread_rv, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, thread_rv);
+
+    ABTS_INT_EQUAL(tc, 0, apr_reslist_acquired_count(rl));
+    ABTS_INT_EQUAL(tc, 1, params->c_count);
+
+    rv = apr_reslist_destroy(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, params->d_count);
+}
+
+static void test_reslist_maintainer(abts_case *tc, void *data)
+{
+    int i;
+    apr_status_t rv;
+    apr_reslist_t *rl;
+    my_parameters_t *params;
+    apr_thread_pool_t *thrp;
+    my_thread_info_t thread_info[CONSUMER_THREADS];
+    my_resource_t *resources[RESLIST_HMAX];
+    void *vp;
+
+    rv = apr_thread_pool_create(&thrp, CONSUMER_THREADS/2, CONSUMER_THREADS, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    params = apr_pcalloc(p, sizeof(*params));
+    params->sleep_upon_construct = CONSTRUCT_SLEEP_TIME;
+    params->sleep_upon_destruct = DESTRUCT_SLEEP_TIME;
+
+    rv = apr_reslist_create(&rl, RESLIST_MIN, RESLIST_SMAX, RESLIST_HMAX,
+                            RESLIST_TTL, my_constructor, my_destructor,
+                            params, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (data) {
+        rv = apr_reslist_shards_set(rl, 4);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    rv = apr_reslist_maintainer_start(rl, 0, NULL);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_reslist_maintainer_start(rl, RESLIST_TTL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_reslist_maintainer_start(rl, RESLIST_TTL, NULL);
+    ABTS_INT_EQUAL(tc, APR_EBUSY, rv);
+
+    for (i = 0; i < CONSUMER_THREADS; i++) {
+        thread_info[i].tid = i;
+        thread_info[i].tc = tc;
+        thread_info[i].reslist = rl;
+        thread_info[i].work_delay_sleep = WORK_DELAY_SLEEP_TIME;
+        thread_info[i].acquire_flags = 0;
+        rv = apr_thread_pool_push(thrp, resource_consuming_thread,
+                                  &thread_info[i], 0, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_reslist_acquired_count(rl));
+
+    /* The hard maximum holds with the maintainer, which may take its time
+     * to create the resources though
+     */
+    apr_reslist_timeout_set(rl, apr_time_from_sec(10));
+    for (i = 0; i < RESLIST_HMAX; i++) {
+        rv = apr_reslist_acquire(rl, (void **)&resources[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    apr_reslist_timeout_set(rl, apr_time_from_msec(10));
+    rv = apr_reslist_acquire(rl, &vp);
+    ABTS_TRUE(tc, APR_STATUS_IS_TIMEUP(rv));
+    for (i = 0; i < RESLIST_HMAX; i++) {
+        rv = apr_reslist_release(rl, resources[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    rv = apr_reslist_maintainer_stop(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_TRUE(tc, params->c_count - params->d_count <= RESLIST_HMAX);
+
+    rv = apr_reslist_destroy(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, params->c_count, params->d_count);
+}
+
+static void test_reslist_maintainer_warm(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_reslist_t *rl;
+    my_parameters_t *params;
+    my_resource_t *res, *res2, *held[3];
+    int i;
+
+    params = apr_pcalloc(p, sizeof(*params));
+
+    rv = apr_reslist_create(&rl, /*min*/1, /*smax*/2, /*max*/2, /*no ttl*/0,
+                            my_constructor, my_destructor, params, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, params->c_count);
+    rv = apr_reslist_maintainer_start(rl, apr_time_from_msec(10),
+                                      my_validator);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_reslist_timeout_set(rl, apr_time_from_sec(10));
+
+    /* The warm one, then one created for us by the maintainer */
+    rv = apr_reslist_acquire(rl, (void **)&res);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, res->id);
+    rv = apr_reslist_acquire(rl, (void **)&res2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, res2->id);
+    ABTS_TRUE(tc, !apr_os_thread_equal(params->c_thread,
+                                       apr_os_thread_current()));
+
+    /* Destroyed by the maintainer */
+    rv = apr_reslist_invalidate(rl, res2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 1000 && params->d_count < 1; i++) {
+        apr_sleep(apr_time_from_msec(1));
+    }
+    ABTS_INT_EQUAL(tc, 1, params->d_count);
+
+    /* The bad ones fail validation and get replaced */
+    rv = apr_reslist_release(rl, res);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    params->v_fail = 1;
+    for (i = 0; i < 1000 && params->d_count < 3; i++) {
+        apr_sleep(apr_time_from_msec(1));
+    }
+    params->v_fail = 0;
+    ABTS_TRUE(tc, params->v_count > 0);
+    ABTS_TRUE(tc, params->d_count >= 3);
+
+    /* Failures to create reach the acquirers, once the available ones
+     * are taken
+     */
+    params->status = APR_EGENERAL;
+    for (i = 0; i < 3; i++) {
+        rv = apr_reslist_acquire(rl, (void **)&held[i]);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    ABTS_TRUE(tc, i < 3);
+    params->status = APR_SUCCESS;
+    while (i-- > 0) {
+        rv = apr_reslist_release(rl, held[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    rv = apr_reslist_destroy(rl);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, params->c_count, params->d_count);
+}
+
 #endif /* APR_HAS_THREADS */
 
 abts_suite *testreslist(abts_suite *suite)
@@ -311,6 +595,14 @@ abts_suite *testreslist(abts_suite *suite)
     abts_run_test(suite, test_reslist,
                   (void*)(apr_uintptr_t)APR_RESLIST_ACQUIRE_FIFO);
     abts_run_test(suite, test_reslist_no_ttl, NULL);
+    abts_run_test(suite, test_reslist_sharded,
+                  (void*)(apr_uintptr_t)APR_RESLIST_ACQUIRE_LIFO);
+    abts_run_test(suite, test_reslist_sharded,
+                  (void*)(apr_uintptr_t)APR_RESLIST_ACQUIRE_FIFO);
+    abts_run_test(suite, test_reslist_shards_steal, NULL);
+    abts_run_test(suite, test_reslist_maintainer, NULL);
+    abts_run_test(suite, test_reslist_maintainer, (void *)1);
+    abts_run_test(suite, test_reslist_maintainer_warm, NULL);
 #endif
 
     return suite;
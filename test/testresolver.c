@@ -0,0 +1,211 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_resolver.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#define NUM_LOOKUPS 10
+
+static void check_loopback(abts_case *tc, apr_sockaddr_t *sa)
+{
+    char *ip;
+
+    ABTS_PTR_NOTNULL(tc, sa);
+    if (!sa) {
+        return;
+    }
+    apr_sockaddr_ip_get(&ip, sa);
+    ABTS_STR_EQUAL(tc, "127.0.0.1", ip);
+    ABTS_INT_EQUAL(tc, 8080, sa->port);
+}
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_resolver_t *r;
+    apr_status_t rv;
+
+    rv = apr_resolver_create(&r, -1, 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_resolver_create(&r, apr_time_from_sec(60), 0, -1, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_resolver_create(&r, apr_time_from_sec(60), 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_lookup(abts_case *tc, void *data)
+{
+    apr_resolver_t *r;
+    apr_sockaddr_t *sa, *sa2;
+    apr_status_t rv;
+
+    rv = apr_resolver_create(&r, apr_time_from_sec(60), apr_time_from_sec(1),
+                             0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Missed then cached, both copied to the given pool */
+    rv = apr_resolver_lookup(&sa, r, "127.0.0.1", APR_INET, 8080, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    check_loopback(tc, sa);
+    rv = apr_resolver_lookup(&sa2, r, "127.0.0.1", APR_INET, 8080, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    check_loopback(tc, sa2);
+    ABTS_TRUE(tc, sa != sa2);
+
+    /* Another port is another entry */
+    rv = apr_resolver_lookup(&sa, r, "127.0.0.1", APR_INET, 80, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 80, sa->port);
+
+    rv = apr_resolver_clear(r);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_resolver_lookup(&sa, r, "127.0.0.1", APR_INET, 8080, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    check_loopback(tc, sa);
+}
+
+static void test_lookup_negative(abts_case *tc, void *data)
+{
+    apr_resolver_t *r;
+    apr_sockaddr_t *sa;
+    apr_status_t rv, rv2;
+
+    rv = apr_resolver_create(&r, apr_time_from_sec(60), apr_time_from_sec(60),
+                             0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* An IPv6 address can't be an IPv4 one */
+    rv = apr_resolver_lookup(&sa, r, "::1", APR_INET, 80, 0, p);
+    ABTS_TRUE(tc, rv != APR_SUCCESS);
+    ABTS_PTR_EQUAL(tc, NULL, sa);
+    rv2 = apr_resolver_lookup(&sa, r, "::1", APR_INET, 80, 0, p);
+    ABTS_INT_EQUAL(tc, rv, rv2);
+    ABTS_PTR_EQUAL(tc, NULL, sa);
+}
+
+#if APR_HAS_THREADS
+
+typedef struct {
+    apr_uint32_t done;
+    apr_uint32_t failed;
+} async_data_t;
+
+static void lookup_done(apr_sockaddr_t *sa, apr_status_t status, void *baton)
+{
+    async_data_t *d = baton;
+    char *ip;
+
+    if (status != APR_SUCCESS || !sa || sa->port != 8080
+            || apr_sockaddr_ip_get(&ip, sa) != APR_SUCCESS
+            || strcmp(ip, "127.0.0.1") != 0) {
+        apr_atomic_inc32(&d->failed);
+    }
+    apr_atomic_inc32(&d->done);
+}
+
+static void wait_done(abts_case *tc, async_data_t *d, apr_uint32_t n)
+{
+    apr_time_t deadline = apr_time_now() + apr_time_from_sec(2);
+
+    while (apr_atomic_read32(&d->done) < n && apr_time_now() < deadline) {
+        apr_sleep(apr_time_from_msec(1));
+    }
+    ABTS_INT_EQUAL(tc, n, apr_atomic_read32(&d->done));
+    ABTS_INT_EQUAL(tc, 0, apr_atomic_read32(&d->failed));
+}
+
+static void test_lookup_async(abts_case *tc, void *data)
+{
+    apr_thread_pool_t *tpool;
+    apr_resolver_t *r;
+    apr_pool_t *pools[NUM_LOOKUPS];
+    async_data_t d = { 0 };
+    apr_status_t rv;
+    int i;
+
+    rv = apr_thread_pool_create(&tpool, 1, 2, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_resolver_create(&r, apr_time_from_sec(60), 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_resolver_thread_pool_set(r, tpool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Each callback gets its own pool, used by the resolving thread */
+    for (i = 0; i < NUM_LOOKUPS; i++) {
+        apr_pool_create(&pools[i], p);
+        rv = apr_resolver_lookup_async(r, "127.0.0.1", APR_INET, 8080, 0,
+                                       lookup_done, &d, pools[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    wait_done(tc, &d, NUM_LOOKUPS);
+
+    /* Cached, called back synchronously */
+    rv = apr_resolver_lookup_async(r, "127.0.0.1", APR_INET, 8080, 0,
+                                   lookup_done, &d, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, NUM_LOOKUPS + 1, apr_atomic_read32(&d.done));
+
+    apr_thread_pool_destroy(tpool);
+    for (i = 0; i < NUM_LOOKUPS; i++) {
+        apr_pool_destroy(pools[i]);
+    }
+}
+
+static void test_lookup_stale(abts_case *tc, void *data)
+{
+    apr_thread_pool_t *tpool;
+    apr_resolver_t *r;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_thread_pool_create(&tpool, 1, 1, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    /* Expired right away, but served for a minute more */
+    rv = apr_resolver_create(&r, 0, 0, apr_time_from_sec(60), p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_resolver_thread_pool_set(r, tpool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < NUM_LOOKUPS; i++) {
+        rv = apr_resolver_lookup(&sa, r, "127.0.0.1", APR_INET, 8080, 0, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        check_loopback(tc, sa);
+    }
+
+    /* Wait for the revalidations before destroying the resolver */
+    apr_thread_pool_destroy(tpool);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testresolver(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_lookup, NULL);
+    abts_run_test(suite, test_lookup_negative, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_lookup_async, NULL);
+    abts_run_test(suite, test_lookup_stale, NULL);
+#endif
+
+    return suite;
+}
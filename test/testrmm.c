@@ -21,6 +21,9 @@
 #include "apr_lib.h"
 #include "apr_strings.h"
 #include "apr_time.h"
+#include "apr_thread_proc.h"
+#include "apr_thread_mutex.h"
+#include "apr_atomic.h"
 #include "abts.h"
 #include "testutil.h"
 
@@ -177,6 +180,201 @@ static void test_rmm(abts_case *tc, void *data)
     apr_pool_destroy(pool);
 }
 
+#define SLAB_SHM_SIZE (1024 * 1024)
+
+static void test_rmm_slab(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pool_t *pool;
+    apr_shm_t *shm;
+    apr_rmm_t *rmm, *attached;
+    apr_rmm_stats_t stats;
+    apr_rmm_off_t off[4], big;
+    char *c;
+    int i;
+
+    rv = apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_shm_create(&shm, SLAB_SHM_SIZE, NULL, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (rv != APR_SUCCESS)
+        return;
+
+    rv = apr_rmm_init_ex(&rmm, NULL, apr_shm_baseaddr_get(shm),
+                         SLAB_SHM_SIZE, APR_RMM_SLAB, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_rmm_attach(&attached, NULL, apr_shm_baseaddr_get(shm), pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    off[0] = apr_rmm_malloc(rmm, 1);
+    off[1] = apr_rmm_malloc(rmm, 100);
+    off[2] = apr_rmm_calloc(rmm, 100);
+    off[3] = apr_rmm_malloc(attached, 4000);
+    for (i = 0; i < 4; i++) {
+        ABTS_TRUE(tc, !!off[i]);
+        ABTS_TRUE(tc, !((apr_size_t)apr_rmm_addr_get(rmm, off[i]) & 7));
+    }
+    c = apr_rmm_addr_get(rmm, off[2]);
+    for (i = 0; i < 100; i++) {
+        ABTS_INT_EQUAL(tc, 0, c[i]);
+    }
+    memset(apr_rmm_addr_get(rmm, off[1]), 'x', 100);
+
+    rv = apr_rmm_stats_get(rmm, &stats);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, SLAB_SHM_SIZE, stats.size);
+    ABTS_SIZE_EQUAL(tc, 16 + 128 + 128 + 4096, stats.slab_inuse);
+    ABTS_SIZE_EQUAL(tc, 8 + 104 + 104 + 4000, stats.slab_requested);
+    ABTS_TRUE(tc, stats.slab_carved > stats.slab_inuse);
+    ABTS_TRUE(tc, stats.free_blocks == 1);
+    ABTS_SIZE_EQUAL(tc, stats.free, stats.largest_free);
+
+    /* The freed objects are reused first, from any handle */
+    rv = apr_rmm_free(attached, off[1]);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_rmm_free(rmm, off[1]);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    ABTS_TRUE(tc, apr_rmm_malloc(rmm, 120) == off[1]);
+
+    /* Bigger allocations come from the first-fit lists */
+    big = apr_rmm_malloc(rmm, 64 * 1024);
+    ABTS_TRUE(tc, !!big);
+
+    /* Growing out of the size classes keeps the content */
+    memset(apr_rmm_addr_get(rmm, off[1]), 'y', 120);
+    off[1] = apr_rmm_realloc(rmm, apr_rmm_addr_get(rmm, off[1]), 40000);
+    ABTS_TRUE(tc, !!off[1]);
+    c = apr_rmm_addr_get(rmm, off[1]);
+    for (i = 0; i < 120; i++) {
+        ABTS_INT_EQUAL(tc, 'y', c[i]);
+    }
+
+    rv = apr_rmm_free(rmm, big);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_rmm_free(rmm, off[1]);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 4; i++) {
+        if (i != 1) {
+            rv = apr_rmm_free(rmm, off[i]);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        }
+    }
+
+    rv = apr_rmm_stats_get(rmm, &stats);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, stats.slab_inuse);
+    ABTS_SIZE_EQUAL(tc, 0, stats.slab_requested);
+
+    rv = apr_rmm_destroy(rmm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_destroy(shm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+#if APR_HAS_THREADS
+
+#define SLAB_THREADS 4
+#define SLAB_ROUNDS 2000
+#define SLAB_HELD 16
+
+static apr_uint32_t slab_marks;
+
+static void * APR_THREAD_FUNC slab_thread(apr_thread_t *thd, void *data)
+{
+    apr_rmm_t *rmm = data;
+    apr_rmm_off_t held[SLAB_HELD] = { 0 };
+    apr_size_t sizes[SLAB_HELD];
+    apr_status_t rv = APR_SUCCESS;
+    unsigned char mark = (unsigned char)(apr_atomic_inc32(&slab_marks) + 1);
+    int i, j;
+
+    for (i = 0; i < SLAB_ROUNDS; i++) {
+        int k = i % SLAB_HELD;
+
+        if (held[k]) {
+            unsigned char *c = apr_rmm_addr_get(rmm, held[k]);
+
+            for (j = 0; j < (int)sizes[k]; j++) {
+                if (c[j] != mark) {
+                    rv = APR_EGENERAL;
+                }
+            }
+            if (apr_rmm_free(rmm, held[k]) != APR_SUCCESS) {
+                rv = APR_EGENERAL;
+            }
+        }
+        sizes[k] = 1 + (i * 37) % 3000;
+        held[k] = apr_rmm_malloc(rmm, sizes[k]);
+        if (!held[k]) {
+            rv = APR_ENOMEM;
+            break;
+        }
+        memset(apr_rmm_addr_get(rmm, held[k]), mark, sizes[k]);
+    }
+    for (i = 0; i < SLAB_HELD; i++) {
+        if (held[i]) {
+            apr_rmm_free(rmm, held[i]);
+        }
+    }
+
+    apr_thread_exit(thd, rv);
+    return NULL;
+}
+
+static void test_rmm_slab_threads(abts_case *tc, void *data)
+{
+    apr_status_t rv, thread_rv;
+    apr_pool_t *pool;
+    apr_shm_t *shm;
+    apr_rmm_t *rmm;
+    apr_anylock_t lock;
+    apr_thread_t *thds[SLAB_THREADS];
+    apr_rmm_stats_t stats;
+    int i;
+
+    rv = apr_pool_create(&pool, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_shm_create(&shm, SLAB_SHM_SIZE, NULL, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (rv != APR_SUCCESS)
+        return;
+
+    lock.type = apr_anylock_threadmutex;
+    rv = apr_thread_mutex_create(&lock.lock.tm, APR_THREAD_MUTEX_DEFAULT,
+                                 pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_rmm_init_ex(&rmm, &lock, apr_shm_baseaddr_get(shm),
+                         SLAB_SHM_SIZE, APR_RMM_SLAB, pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < SLAB_THREADS; i++) {
+        rv = apr_thread_create(&thds[i], NULL, slab_thread, rmm, pool);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < SLAB_THREADS; i++) {
+        rv = apr_thread_join(&thread_rv, thds[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, thread_rv);
+    }
+
+    rv = apr_rmm_stats_get(rmm, &stats);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, stats.slab_inuse);
+    ABTS_SIZE_EQUAL(tc, 0, stats.slab_requested);
+
+    rv = apr_rmm_destroy(rmm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_destroy(shm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(pool);
+}
+
+#endif /* APR_HAS_THREADS */
+
 #endif /* APR_HAS_SHARED_MEMORY */
 
 abts_suite *testrmm(abts_suite *suite)
@@ -185,6 +383,10 @@ abts_suite *testrmm(abts_suite *suite)
 
 #if APR_HAS_SHARED_MEMORY
     abts_run_test(suite, test_rmm, NULL);
+    abts_run_test(suite, test_rmm_slab, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_rmm_slab_threads, NULL);
+#endif
 #endif
 
     return suite;
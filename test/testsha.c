@@ -0,0 +1,183 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+
+#include "apr_general.h"
+#include "apr_random.h"
+#include "apr_sha1.h"
+#include "apr_sha256.h"
+#include "apr_strings.h"
+#define APR_WANT_STRFUNC
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+/* The FIPS 180-2 examples, the last one being a million 'a' */
+static const struct {
+    const char *string;
+    const char *sha1;
+    const char *sha256;
+} vectors[] = {
+    {"",
+     "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+     "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc",
+     "a9993e364706816aba3e25717850c26c9cd0d89d",
+     "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {NULL,
+     "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+     "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"}
+};
+
+#define MILLION 1000000
+
+static const char *hex(const unsigned char *digest, apr_size_t len)
+{
+    char *s = apr_palloc(p, 2 * len + 1);
+    apr_size_t i;
+
+    for (i = 0; i < len; i++) {
+        apr_snprintf(s + 2 * i, 3, "%02x", digest[i]);
+    }
+    return s;
+}
+
+static const char *vector_string(int i, apr_size_t *len)
+{
+    char *s;
+
+    if (vectors[i].string) {
+        *len = strlen(vectors[i].string);
+        return vectors[i].string;
+    }
+    s = apr_palloc(p, MILLION);
+    memset(s, 'a', MILLION);
+    *len = MILLION;
+    return s;
+}
+
+static void test_sha1(abts_case *tc, void *data)
+{
+    unsigned char digest[APR_SHA1_DIGESTSIZE];
+    apr_sha1_ctx_t ctx;
+    apr_size_t len, off, n;
+    const char *s;
+    int i;
+
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        s = vector_string(i, &len);
+
+        apr_sha1_init(&ctx);
+        apr_sha1_update_binary(&ctx, (const unsigned char *)s,
+                               (unsigned int)len);
+        apr_sha1_final(digest, &ctx);
+        ABTS_STR_EQUAL(tc, vectors[i].sha1, hex(digest, sizeof(digest)));
+
+        /* pieces of all sizes, straddling the blocks */
+        apr_sha1_init(&ctx);
+        for (off = 0, n = 1; off < len; off += n, n = n * 7 % 191 + 1) {
+            if (n > len - off) {
+                n = len - off;
+            }
+            apr_sha1_update_binary(&ctx, (const unsigned char *)s + off,
+                                   (unsigned int)n);
+        }
+        apr_sha1_final(digest, &ctx);
+        ABTS_STR_EQUAL(tc, vectors[i].sha1, hex(digest, sizeof(digest)));
+    }
+}
+
+static void test_sha256(abts_case *tc, void *data)
+{
+    unsigned char digest[APR_SHA256_DIGESTSIZE];
+    apr_crypto_hash_t *h = apr_crypto_sha256_new(p);
+    apr_size_t len, off, n;
+    const char *s;
+    int i;
+
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        s = vector_string(i, &len);
+
+        apr_sha256(digest, s, len);
+        ABTS_STR_EQUAL(tc, vectors[i].sha256, hex(digest, sizeof(digest)));
+
+        h->init(h);
+        for (off = 0, n = 1; off < len; off += n, n = n * 7 % 191 + 1) {
+            if (n > len - off) {
+                n = len - off;
+            }
+            h->add(h, s + off, n);
+        }
+        h->finish(h, digest);
+        ABTS_STR_EQUAL(tc, vectors[i].sha256, hex(digest, sizeof(digest)));
+    }
+}
+
+/* Batches of all sizes of buffers of all lengths around the block and
+ * padding boundaries, against the digests one at a time.
+ */
+static void test_sha256_multi(abts_case *tc, void *data)
+{
+    unsigned char (*digests)[APR_SHA256_DIGESTSIZE];
+    unsigned char expected[APR_SHA256_DIGESTSIZE];
+    struct iovec vec[40];
+    unsigned char *buf;
+    apr_size_t n, i;
+
+    buf = apr_palloc(p, 4096);
+    for (i = 0; i < 4096; i++) {
+        buf[i] = (unsigned char)(i * 131 + (i >> 8));
+    }
+    digests = apr_palloc(p, sizeof(*digests) * 40);
+
+    for (n = 0; n <= 40; n++) {
+        for (i = 0; i < n; i++) {
+            /* lengths 0..200 and some longer, from various offsets */
+            vec[i].iov_base = (char *)buf + (n * 7 + i) % 64;
+            vec[i].iov_len = i % 5 == 4 ? 1000 + 61 * i
+                                        : (n * 13 + i * 29) % 201;
+        }
+        apr_sha256_multi(digests, vec, n);
+        for (i = 0; i < n; i++) {
+            apr_sha256(expected, vec[i].iov_base, vec[i].iov_len);
+            ABTS_ASSERT(tc, apr_psprintf(p, "digest %" APR_SIZE_T_FMT
+                                         " of %" APR_SIZE_T_FMT, i, n),
+                        !memcmp(expected, digests[i], sizeof(expected)));
+        }
+    }
+
+    vec[0].iov_base = "abc";
+    vec[0].iov_len = 3;
+    vec[1].iov_base = "";
+    vec[1].iov_len = 0;
+    apr_sha256_multi(digests, vec, 2);
+    ABTS_STR_EQUAL(tc, vectors[1].sha256, hex(digests[0], 32));
+    ABTS_STR_EQUAL(tc, vectors[0].sha256, hex(digests[1], 32));
+}
+
+abts_suite *testsha(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite);
+
+    abts_run_test(suite, test_sha1, NULL);
+    abts_run_test(suite, test_sha256, NULL);
+    abts_run_test(suite, test_sha256_multi, NULL);
+
+    return suite;
+}
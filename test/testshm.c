@@ -61,6 +61,50 @@ static void test_check_size(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
 }
 
+static void test_create_flags(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_shm_t *shm = NULL;
+    const char *filename = data;
+    apr_int32_t flags = APR_SHM_HUGEPAGES | APR_SHM_PREFAULT
+                        | APR_SHM_NUMA_INTERLEAVE;
+    char *mem;
+    int i;
+
+    if (filename) {
+        apr_shm_remove(filename, p);
+    }
+    rv = apr_shm_create_ex(&shm, SHARED_SIZE, filename, p, flags);
+    APR_ASSERT_SUCCESS(tc, "Error allocating shared memory block", rv);
+    if (rv != APR_SUCCESS) {
+        return;
+    }
+    ABTS_SIZE_EQUAL(tc, SHARED_SIZE, apr_shm_size_get(shm));
+
+    mem = apr_shm_baseaddr_get(shm);
+    for (i = 0; i < SHARED_SIZE; i++) {
+        ABTS_INT_EQUAL(tc, 0, mem[i]);
+    }
+    memset(mem, 'x', SHARED_SIZE);
+
+    rv = apr_shm_destroy(shm);
+    APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
+
+    rv = apr_shm_create_ex(&shm, SHARED_SIZE, filename, p, APR_SHM_MLOCK);
+    if (rv == APR_ENOTIMPL || APR_STATUS_IS_ENOMEM(rv)
+            || rv == APR_FROM_OS_ERROR(EPERM)
+            || rv == APR_FROM_OS_ERROR(EAGAIN)) {
+        ABTS_NOT_IMPL(tc, "Locking shared memory not allowed");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "Error allocating locked shared memory block", rv);
+    if (rv == APR_SUCCESS) {
+        memset(apr_shm_baseaddr_get(shm), 'x', SHARED_SIZE);
+        rv = apr_shm_destroy(shm);
+        APR_ASSERT_SUCCESS(tc, "Error destroying shared memory block", rv);
+    }
+}
+
 static void test_shm_allocate(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -295,6 +339,8 @@ abts_suite *testshm(abts_suite *suite)
     abts_run_test(suite, test_anon_create, NULL);
     abts_run_test(suite, test_check_size, NULL);
     abts_run_test(suite, test_shm_allocate, NULL);
+    abts_run_test(suite, test_create_flags, NULL);
+    abts_run_test(suite, test_create_flags, (void *)SHARED_FILENAME);
 #if APR_HAS_FORK
     abts_run_test(suite, test_anon, NULL);
 #endif
@@ -0,0 +1,337 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_shm_hash.h"
+#include "apr_shm.h"
+#include "apr_thread_proc.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if APR_HAS_SHARED_MEMORY
+
+#define HASH_SIZE (64 * 1024)
+#define HASH_FILENAME "data/apr.testshmhash.shm"
+
+static int create_table(abts_case *tc, apr_shm_hash_t **ht, apr_size_t size,
+                        const char *filename, unsigned int nstripes,
+                        apr_uint32_t flags)
+{
+    apr_status_t rv;
+
+    rv = apr_shm_hash_create(ht, size, filename, 0, nstripes, flags, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "shared memory not implemented");
+        return 0;
+    }
+    APR_ASSERT_SUCCESS(tc, "create shm hash table", rv);
+    return rv == APR_SUCCESS;
+}
+
+static void test_set_get(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    apr_size_t vlen;
+    void *val;
+
+    if (!create_table(tc, &ht, HASH_SIZE, NULL, 0, 0)) {
+        return;
+    }
+
+    rv = apr_shm_hash_get(ht, "key", APR_HASH_KEY_STRING, &val, &vlen, p);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    rv = apr_shm_hash_set(ht, "key", APR_HASH_KEY_STRING, "value", 5, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_set(ht, "key2", 4, "value2", 6, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, apr_shm_hash_count(ht));
+
+    rv = apr_shm_hash_get(ht, "key", 3, &val, &vlen, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 5, vlen);
+    ABTS_STR_EQUAL(tc, "value", val);
+
+    rv = apr_shm_hash_set(ht, "key", 3, "a longer value", 14, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, apr_shm_hash_count(ht));
+    rv = apr_shm_hash_get(ht, "key", 3, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "a longer value", val);
+
+    rv = apr_shm_hash_delete(ht, "key", 3);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_delete(ht, "key", 3);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_shm_hash_get(ht, "key", 3, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_shm_hash_get(ht, "key2", 4, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "value2", val);
+    ABTS_INT_EQUAL(tc, 1, apr_shm_hash_count(ht));
+
+    rv = apr_shm_hash_destroy(ht);
+    APR_ASSERT_SUCCESS(tc, "destroy shm hash table", rv);
+}
+
+static void test_ttl(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    void *val;
+
+    if (!create_table(tc, &ht, HASH_SIZE, NULL, 0, 0)) {
+        return;
+    }
+
+    rv = apr_shm_hash_set(ht, "short", 5, "1", 1, apr_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_set(ht, "long", 4, "2", 1, apr_time_from_sec(3600));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_get(ht, "short", 5, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_sleep(apr_time_from_msec(20));
+
+    rv = apr_shm_hash_get(ht, "short", 5, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_shm_hash_get(ht, "long", 4, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, apr_shm_hash_count(ht));
+
+    apr_shm_hash_destroy(ht);
+}
+
+static apr_status_t fill_table(apr_shm_hash_t *ht, int n, const char *hot)
+{
+    apr_status_t rv = APR_SUCCESS;
+    char key[32], val[100];
+    void *copy;
+    int i;
+
+    memset(val, 'v', sizeof(val));
+    for (i = 0; i < n && rv == APR_SUCCESS; i++) {
+        apr_snprintf(key, sizeof(key), "key%d", i);
+        rv = apr_shm_hash_set(ht, key, APR_HASH_KEY_STRING,
+                              val, sizeof(val), 0);
+        if (hot) {
+            apr_shm_hash_get(ht, hot, APR_HASH_KEY_STRING, &copy, NULL, p);
+        }
+    }
+    return rv;
+}
+
+static void test_full(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    void *val;
+
+    if (!create_table(tc, &ht, 8192, NULL, 1, 0)) {
+        return;
+    }
+
+    rv = fill_table(ht, 1000, NULL);
+    ABTS_INT_EQUAL(tc, APR_ENOMEM, rv);
+    ABTS_ASSERT(tc, "table should hold entries",
+                apr_shm_hash_count(ht) > 10);
+    rv = apr_shm_hash_get(ht, "key0", APR_HASH_KEY_STRING, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Deleting makes room again */
+    rv = apr_shm_hash_delete(ht, "key0", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_set(ht, "again", APR_HASH_KEY_STRING, "1", 1, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_shm_hash_destroy(ht);
+}
+
+static void test_lru(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    void *val;
+
+    if (!create_table(tc, &ht, 8192, NULL, 1, APR_SHM_HASH_LRU)) {
+        return;
+    }
+
+    rv = fill_table(ht, 1000, "key0");
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* The oldest entries went away, except for the one kept in use */
+    rv = apr_shm_hash_get(ht, "key0", APR_HASH_KEY_STRING, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_get(ht, "key1", APR_HASH_KEY_STRING, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+    rv = apr_shm_hash_get(ht, "key999", APR_HASH_KEY_STRING, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "table should not hold everything",
+                apr_shm_hash_count(ht) < 1000);
+
+    apr_shm_hash_destroy(ht);
+}
+
+static int count_cb(void *rec, const void *key, apr_size_t klen,
+                    const void *val, apr_size_t vlen)
+{
+    int *count = rec;
+
+    (*count)++;
+    return *count < 5;
+}
+
+static void test_do(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht;
+    int count = 0;
+
+    if (!create_table(tc, &ht, HASH_SIZE, NULL, 0, 0)) {
+        return;
+    }
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, fill_table(ht, 3, NULL));
+    ABTS_INT_EQUAL(tc, 1, apr_shm_hash_do(count_cb, &count, ht));
+    ABTS_INT_EQUAL(tc, 3, count);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, fill_table(ht, 10, NULL));
+    count = 0;
+    ABTS_INT_EQUAL(tc, 0, apr_shm_hash_do(count_cb, &count, ht));
+    ABTS_INT_EQUAL(tc, 5, count);
+
+    apr_shm_hash_destroy(ht);
+}
+
+static void test_attach(abts_case *tc, void *data)
+{
+    apr_shm_hash_t *ht, *attached;
+    apr_status_t rv;
+    void *val;
+
+    apr_shm_remove(HASH_FILENAME, p);
+    if (!create_table(tc, &ht, HASH_SIZE, HASH_FILENAME, 0, 0)) {
+        return;
+    }
+
+    rv = apr_shm_hash_attach(&attached, HASH_FILENAME, p);
+    APR_ASSERT_SUCCESS(tc, "attach shm hash table", rv);
+
+    rv = apr_shm_hash_set(ht, "key", 3, "value", 5, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_get(attached, "key", 3, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "value", val);
+    rv = apr_shm_hash_delete(attached, "key", 3);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_hash_get(ht, "key", 3, &val, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_NOTFOUND, rv);
+
+    rv = apr_shm_hash_detach(attached);
+    APR_ASSERT_SUCCESS(tc, "detach shm hash table", rv);
+    rv = apr_shm_hash_destroy(ht);
+    APR_ASSERT_SUCCESS(tc, "destroy shm hash table", rv);
+}
+
+#if APR_HAS_FORK
+
+#define NUM_PROCS 4
+#define NUM_KEYS 200
+
+static void test_procs(abts_case *tc, void *data)
+{
+    apr_uint32_t flags = (apr_uint32_t)(apr_uintptr_t)data;
+    apr_proc_t procs[NUM_PROCS];
+    apr_shm_hash_t *ht;
+    apr_status_t rv;
+    char key[32];
+    void *val;
+    int i, j;
+
+    if (!create_table(tc, &ht, 256 * 1024, NULL, 4, flags)) {
+        return;
+    }
+
+    for (i = 0; i < NUM_PROCS; i++) {
+        rv = apr_proc_fork(&procs[i], p);
+        if (rv == APR_INCHILD) {
+            for (j = 0; j < NUM_KEYS; j++) {
+                apr_snprintf(key, sizeof(key), "%d-%d", i, j);
+                if (apr_shm_hash_set(ht, key, APR_HASH_KEY_STRING,
+                                     key, strlen(key), 0)
+                        || apr_shm_hash_set(ht, "shared", 6, key,
+                                            strlen(key), 0)) {
+                    _exit(1);
+                }
+                if (j % 2 && apr_shm_hash_delete(ht, key,
+                                                 APR_HASH_KEY_STRING)) {
+                    _exit(1);
+                }
+            }
+            _exit(0);
+        }
+        ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+    }
+    for (i = 0; i < NUM_PROCS; i++) {
+        apr_exit_why_e why;
+        int code;
+
+        rv = apr_proc_wait(&procs[i], &code, &why, APR_WAIT);
+        ABTS_ASSERT(tc, "child did not terminate with success",
+                    rv == APR_CHILD_DONE && why == APR_PROC_EXIT && code == 0);
+    }
+
+    ABTS_INT_EQUAL(tc, NUM_PROCS * NUM_KEYS / 2 + 1, apr_shm_hash_count(ht));
+    for (i = 0; i < NUM_PROCS; i++) {
+        for (j = 0; j < NUM_KEYS; j += 2) {
+            apr_snprintf(key, sizeof(key), "%d-%d", i, j);
+            rv = apr_shm_hash_get(ht, key, APR_HASH_KEY_STRING, &val, NULL, p);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            ABTS_STR_EQUAL(tc, key, val);
+        }
+    }
+
+    apr_shm_hash_destroy(ht);
+}
+
+#endif /* APR_HAS_FORK */
+
+#endif /* APR_HAS_SHARED_MEMORY */
+
+abts_suite *testshmhash(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_SHARED_MEMORY
+    abts_run_test(suite, test_set_get, NULL);
+    abts_run_test(suite, test_ttl, NULL);
+    abts_run_test(suite, test_full, NULL);
+    abts_run_test(suite, test_lru, NULL);
+    abts_run_test(suite, test_do, NULL);
+    abts_run_test(suite, test_attach, NULL);
+#if APR_HAS_FORK
+    abts_run_test(suite, test_procs, NULL);
+    abts_run_test(suite, test_procs, (void *)APR_SHM_HASH_SPINLOCK);
+#endif
+#endif
+
+    return suite;
+}
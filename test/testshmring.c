@@ -0,0 +1,303 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_shm_ring.h"
+#include "apr_shm.h"
+#include "apr_thread_proc.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if APR_HAS_SHARED_MEMORY
+
+#define RING_FILENAME "data/apr.testshmring.shm"
+
+static int create_ring(abts_case *tc, apr_shm_ring_t **ring, apr_size_t size,
+                       const char *filename, apr_uint32_t flags)
+{
+    apr_status_t rv;
+
+    rv = apr_shm_ring_create(ring, size, filename, flags, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "shared memory not implemented");
+        return 0;
+    }
+    APR_ASSERT_SUCCESS(tc, "create shm ring", rv);
+    return rv == APR_SUCCESS;
+}
+
+static void test_write_peek(abts_case *tc, void *data)
+{
+    apr_shm_ring_t *ring;
+    apr_status_t rv;
+    apr_size_t len;
+    void *buf;
+
+    if (!create_ring(tc, &ring, 1000, NULL, 0)) {
+        return;
+    }
+    ABTS_SIZE_EQUAL(tc, 1024, apr_shm_ring_capacity(ring));
+
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+    rv = apr_shm_ring_peek(ring, &buf, &len, apr_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, APR_TIMEUP, rv);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_shm_ring_write(ring, "first", 5));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_shm_ring_write(ring, "", 0));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_shm_ring_write(ring, "third", 5));
+
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+    ABTS_ASSERT(tc, "first record", memcmp(buf, "first", 5) == 0);
+
+    /* Peeking again without releasing returns the same record */
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "first record again", memcmp(buf, "first", 5) == 0);
+    apr_shm_ring_release(ring);
+
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    apr_shm_ring_release(ring);
+
+    rv = apr_shm_ring_peek(ring, &buf, &len, -1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+    ABTS_ASSERT(tc, "third record", memcmp(buf, "third", 5) == 0);
+    apr_shm_ring_release(ring);
+
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    rv = apr_shm_ring_destroy(ring);
+    APR_ASSERT_SUCCESS(tc, "destroy shm ring", rv);
+}
+
+static void test_full_wrap(abts_case *tc, void *data)
+{
+    apr_shm_ring_t *ring;
+    apr_status_t rv;
+    char rec[300];
+    apr_size_t len, wlen;
+    void *buf;
+    int i, n;
+
+    if (!create_ring(tc, &ring, 1024, NULL, 0)) {
+        return;
+    }
+
+    rv = apr_shm_ring_write(ring, rec, 512);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    /* Fill up, then go round with lengths unaligned to the capacity */
+    memset(rec, 'x', sizeof(rec));
+    for (n = 0; apr_shm_ring_write(ring, rec, 100) == APR_SUCCESS; n++)
+        ;
+    ABTS_INT_EQUAL(tc, 9, n);
+    rv = apr_shm_ring_write(ring, rec, 100);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    for (i = 0; i < 1000; i++) {
+        rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        ABTS_ASSERT(tc, "record content", len == 0
+                    || ((char *)buf)[0] == ((char *)buf)[len - 1]);
+        apr_shm_ring_release(ring);
+
+        wlen = (i * 37) % sizeof(rec);
+        memset(rec, 'a' + i % 26, wlen);
+        while (apr_shm_ring_write(ring, rec, wlen) == APR_EAGAIN) {
+            rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+            ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+            apr_shm_ring_release(ring);
+        }
+    }
+
+    apr_shm_ring_destroy(ring);
+}
+
+static void test_reserve_commit(abts_case *tc, void *data)
+{
+    apr_shm_ring_t *ring;
+    apr_status_t rv;
+    void *buf1, *buf2, *buf;
+    apr_size_t len;
+
+    if (!create_ring(tc, &ring, 1024, NULL, APR_SHM_RING_MPSC)) {
+        return;
+    }
+
+    rv = apr_shm_ring_reserve(ring, 4, &buf1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_ring_reserve(ring, 6, &buf2);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_ASSERT(tc, "aligned record", ((apr_uintptr_t)buf2 & 7) == 0);
+    memcpy(buf1, "one!", 4);
+    memcpy(buf2, "two!!!", 6);
+
+    /* The second record is held up by the first one */
+    apr_shm_ring_commit(ring, buf2);
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    apr_shm_ring_commit(ring, buf1);
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_EQUAL(tc, buf1, buf);
+    ABTS_SIZE_EQUAL(tc, 4, len);
+    apr_shm_ring_release(ring);
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_EQUAL(tc, buf2, buf);
+    ABTS_SIZE_EQUAL(tc, 6, len);
+    apr_shm_ring_release(ring);
+
+    apr_shm_ring_destroy(ring);
+}
+
+static void test_attach(abts_case *tc, void *data)
+{
+    apr_shm_ring_t *ring, *attached;
+    apr_status_t rv;
+    apr_size_t len;
+    void *buf;
+
+    apr_shm_remove(RING_FILENAME, p);
+    if (!create_ring(tc, &ring, 4096, RING_FILENAME, 0)) {
+        return;
+    }
+
+    rv = apr_shm_ring_attach(&attached, RING_FILENAME, p);
+    APR_ASSERT_SUCCESS(tc, "attach shm ring", rv);
+    ABTS_SIZE_EQUAL(tc, 4096, apr_shm_ring_capacity(attached));
+
+    rv = apr_shm_ring_write(attached, "hello", 5);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_shm_ring_peek(ring, &buf, &len, 0);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+    ABTS_ASSERT(tc, "attached record", memcmp(buf, "hello", 5) == 0);
+    apr_shm_ring_release(ring);
+
+    rv = apr_shm_ring_detach(attached);
+    APR_ASSERT_SUCCESS(tc, "detach shm ring", rv);
+    rv = apr_shm_ring_destroy(ring);
+    APR_ASSERT_SUCCESS(tc, "destroy shm ring", rv);
+}
+
+#if APR_HAS_FORK
+
+#define NUM_PROCS 4
+#define NUM_RECORDS 5000
+
+/* The children write records "<child> <seq>", which the parent reads in
+ * order for each child, sleeping whenever the ring runs empty.
+ */
+static void test_procs(abts_case *tc, void *data)
+{
+    apr_uint32_t flags = (apr_uint32_t)(apr_uintptr_t)data;
+    int nprocs = (flags & APR_SHM_RING_MPSC) ? NUM_PROCS : 1;
+    apr_proc_t procs[NUM_PROCS];
+    int next[NUM_PROCS] = { 0 };
+    apr_shm_ring_t *ring;
+    apr_status_t rv;
+    char rec[32];
+    apr_size_t len;
+    void *buf;
+    int i, j, received;
+
+    if (!create_ring(tc, &ring, 4096, NULL, flags)) {
+        return;
+    }
+
+    for (i = 0; i < nprocs; i++) {
+        rv = apr_proc_fork(&procs[i], p);
+        if (rv == APR_INCHILD) {
+            for (j = 0; j < NUM_RECORDS; j++) {
+                len = apr_snprintf(rec, sizeof(rec), "%d %d", i, j);
+                while ((rv = apr_shm_ring_write(ring, rec, len))
+                       == APR_EAGAIN) {
+                    apr_sleep(100);
+                }
+                if (rv != APR_SUCCESS) {
+                    _exit(1);
+                }
+            }
+            _exit(0);
+        }
+        ABTS_ASSERT(tc, "fork failed", rv == APR_INPARENT);
+    }
+
+    for (received = 0; received < nprocs * NUM_RECORDS; received++) {
+        rv = apr_shm_ring_peek(ring, &buf, &len, apr_time_from_sec(10));
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        ABTS_ASSERT(tc, "record too long", len < sizeof(rec));
+        memcpy(rec, buf, len);
+        rec[len] = '\0';
+        apr_shm_ring_release(ring);
+
+        i = atoi(rec);
+        ABTS_ASSERT(tc, "bad child", i >= 0 && i < nprocs);
+        ABTS_INT_EQUAL(tc, next[i], atoi(strchr(rec, ' ') + 1));
+        next[i]++;
+    }
+
+    for (i = 0; i < nprocs; i++) {
+        apr_exit_why_e why;
+        int code;
+
+        rv = apr_proc_wait(&procs[i], &code, &why, APR_WAIT);
+        ABTS_ASSERT(tc, "child did not terminate with success",
+                    rv == APR_CHILD_DONE && why == APR_PROC_EXIT && code == 0);
+    }
+
+    apr_shm_ring_destroy(ring);
+}
+
+#endif /* APR_HAS_FORK */
+
+#endif /* APR_HAS_SHARED_MEMORY */
+
+abts_suite *testshmring(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if APR_HAS_SHARED_MEMORY
+    abts_run_test(suite, test_write_peek, NULL);
+    abts_run_test(suite, test_full_wrap, NULL);
+    abts_run_test(suite, test_reserve_commit, NULL);
+    abts_run_test(suite, test_attach, NULL);
+#if APR_HAS_FORK
+    abts_run_test(suite, test_procs, NULL);
+    abts_run_test(suite, test_procs, (void *)APR_SHM_RING_MPSC);
+#endif
+#endif
+
+    return suite;
+}
@@ -138,11 +138,65 @@ static void test_siphash_vectors(abts_case *tc, void *data)
     ABTS_ASSERT(tc, "SipHash-2-4 test vectors", test_vectors());
 }
 
+static void test_siphash_128(abts_case *tc, void *data)
+{
+    /* From the authors' vectors_sip128, for the empty message */
+    const u8 vector[16] = { 0xa3, 0x81, 0x7f, 0x04, 0xba, 0x25, 0xa8, 0xe6,
+                            0x6d, 0xf6, 0x72, 0x14, 0xc7, 0x55, 0x02, 0x93 };
+    u8 in[MAXLEN], out[APR_SIPHASH128_DSIZE], k[16];
+    apr_uint64_t h[2], h2[2];
+    int i;
+
+    for (i = 0; i < 16; ++i) k[i] = i;
+    for (i = 0; i < MAXLEN; ++i) in[i] = i;
+
+    apr_siphash24_128_auth(out, in, 0, k);
+    ABTS_ASSERT(tc, "SipHash-2-4-128 test vector", !memcmp(out, vector, 16));
+
+    /* the two halves differ, and from the 64bit hash */
+    for (i = 0; i < MAXLEN; ++i) {
+        apr_siphash24_128(h, in, i, k);
+        ABTS_ASSERT(tc, "halves", h[0] != h[1]);
+        ABTS_ASSERT(tc, "64bit", h[0] != apr_siphash24(in, i, k));
+        apr_siphash24_128(h2, in, i, k);
+        ABTS_ASSERT(tc, "stable", h[0] == h2[0] && h[1] == h2[1]);
+    }
+}
+
+static void test_siphash_batch(abts_case *tc, void *data)
+{
+    u8 in[4 * MAXLEN], k[16];
+    struct iovec vec[37];
+    apr_uint64_t out[37];
+    int i, n;
+
+    for (i = 0; i < 16; ++i) k[i] = i;
+    for (i = 0; i < (int)sizeof(in); ++i) in[i] = (u8)(i * 7);
+
+    /* all the counts, lengths of all the residues and very unequal ones */
+    for (n = 0; n <= 37; n++) {
+        for (i = 0; i < n; i++) {
+            vec[i].iov_base = in + i;
+            vec[i].iov_len = (i * 13 + n) % (i % 5 ? 24 : 3 * MAXLEN);
+        }
+        memset(out, 0, sizeof(out));
+        apr_siphash24_batch(out, vec, n, k);
+        for (i = 0; i < n; i++) {
+            if (out[i] != apr_siphash24(vec[i].iov_base, vec[i].iov_len, k)) {
+                break;
+            }
+        }
+        ABTS_INT_EQUAL(tc, n, i);
+    }
+}
+
 abts_suite *testsiphash(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_siphash_vectors, NULL);
+    abts_run_test(suite, test_siphash_128, NULL);
+    abts_run_test(suite, test_siphash_batch, NULL);
 
     return suite;
 }
@@ -20,6 +20,8 @@
 #include "apr_general.h"
 #include "apr_pools.h"
 #include "apr_skiplist.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
 #if APR_HAVE_STDIO_H
 #include <stdio.h>
 #endif
@@ -520,6 +522,320 @@ static void skiplist_test(abts_case *tc, void *data) {
 }
 
 
+static void skiplist_bulk_load(abts_case *tc, void *data)
+{
+    apr_skiplist *sl;
+    apr_skiplistnode *iter;
+    void *elts[1000];
+    int vals[1000], i, *v, k;
+
+    for (i = 0; i < 1000; i++) {
+        vals[i] = i / 2 * 2; /* duplicates */
+        elts[i] = &vals[i];
+    }
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_skiplist_init(&sl, ptmp));
+    apr_skiplist_set_compare(sl, comp, comp);
+    elts[0] = &vals[999];
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_skiplist_bulk_load_sorted(sl, elts, 2));
+    elts[0] = &vals[0];
+    ABTS_SIZE_EQUAL(tc, 0, apr_skiplist_size(sl));
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_skiplist_bulk_load_sorted(sl, elts, 1000));
+    ABTS_SIZE_EQUAL(tc, 1000, skiplist_get_size(tc, sl));
+    ABTS_INT_EQUAL(tc, 10, apr_skiplist_height(sl));
+
+    /* in order, the duplicates too */
+    i = 0;
+    for (iter = apr_skiplist_getlist(sl); iter; apr_skiplist_next(sl, &iter)) {
+        ABTS_PTR_EQUAL(tc, &vals[i], apr_skiplist_element(iter));
+        i++;
+    }
+    for (i = 0; i < 1000; i += 2) {
+        /* any duplicate met on the path */
+        v = apr_skiplist_find(sl, &vals[i], NULL);
+        ABTS_TRUE(tc, v == &vals[i] || v == &vals[i + 1]);
+        v = apr_skiplist_last(sl, &vals[i], NULL);
+        ABTS_PTR_EQUAL(tc, &vals[i + 1], v);
+    }
+    k = 1;
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_find(sl, &k, NULL));
+
+    /* still a regular skip list */
+    ABTS_PTR_NOTNULL(tc, apr_skiplist_insert(sl, &k));
+    ABTS_PTR_EQUAL(tc, &k, apr_skiplist_find(sl, &k, NULL));
+    ABTS_TRUE(tc, apr_skiplist_remove(sl, &vals[500], NULL) != 0);
+    ABTS_TRUE(tc, apr_skiplist_remove(sl, &vals[500], NULL) != 0);
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_find(sl, &vals[500], NULL));
+
+    /* non empty now, so added one at a time */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_skiplist_bulk_load_sorted(sl, elts, 10));
+    ABTS_SIZE_EQUAL(tc, 1009, skiplist_get_size(tc, sl));
+    ABTS_INT_EQUAL(tc, 0, *(int *)apr_skiplist_pop(sl, NULL));
+
+    apr_skiplist_destroy(sl, NULL);
+    apr_pool_clear(ptmp);
+}
+
+static void skiplist_range(abts_case *tc, void *data)
+{
+    apr_skiplist *sl;
+    apr_skiplistnode *iter, *next;
+    int vals[100], i, n, *v, lo, hi;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_skiplist_init(&sl, ptmp));
+    apr_skiplist_set_compare(sl, comp, comp);
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_range_first(sl, NULL, NULL, &iter));
+    ABTS_PTR_EQUAL(tc, NULL, iter);
+    for (i = 0; i < 100; i++) {
+        vals[i] = i * 10;
+        apr_skiplist_add(sl, &vals[i]);
+    }
+
+    /* [245, 500) */
+    lo = 245;
+    hi = 500;
+    n = 0;
+    for (v = apr_skiplist_range_first(sl, &lo, &hi, &iter); v;
+         v = apr_skiplist_range_next(sl, &hi, &iter)) {
+        ABTS_INT_EQUAL(tc, 250 + 10 * n, *v);
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, 25, n);
+    ABTS_PTR_EQUAL(tc, NULL, iter);
+
+    /* bounds on elements: [0, 10) and [990, +inf) */
+    lo = 0;
+    hi = 10;
+    v = apr_skiplist_range_first(sl, &lo, &hi, &iter);
+    ABTS_PTR_EQUAL(tc, &vals[0], v);
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_range_next(sl, &hi, &iter));
+    lo = 990;
+    v = apr_skiplist_range_first(sl, &lo, NULL, &iter);
+    ABTS_PTR_EQUAL(tc, &vals[99], v);
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_range_next(sl, NULL, &iter));
+    lo = hi = 500;
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_range_first(sl, &lo, &hi, &iter));
+    lo = 1000;
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_range_first(sl, &lo, NULL, &iter));
+
+    /* expiry sweep: remove everything below 300 */
+    hi = 300;
+    v = apr_skiplist_range_first(sl, NULL, &hi, &iter);
+    while (v) {
+        next = iter;
+        v = apr_skiplist_range_next(sl, &hi, &next);
+        apr_skiplist_remove_node(sl, iter, NULL);
+        iter = next;
+    }
+    ABTS_SIZE_EQUAL(tc, 70, skiplist_get_size(tc, sl));
+    ABTS_INT_EQUAL(tc, 300, *(int *)apr_skiplist_peek(sl));
+
+    apr_skiplist_destroy(sl, NULL);
+    apr_pool_clear(ptmp);
+}
+
+static void skiplist_memory(abts_case *tc, void *data)
+{
+    apr_skiplist *sl;
+    apr_size_t empty, full, cached;
+    int vals[1000], i;
+    void *mem1, *mem2;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_skiplist_init(&sl, NULL));
+    apr_skiplist_set_compare(sl, comp, comp);
+    empty = apr_skiplist_memory_usage(sl);
+    for (i = 0; i < 1000; i++) {
+        vals[i] = i;
+        apr_skiplist_insert(sl, &vals[i]);
+    }
+    full = apr_skiplist_memory_usage(sl);
+    ABTS_TRUE(tc, full > empty + 1000 * sizeof(void *));
+
+    /* the nodes are recycled */
+    apr_skiplist_remove_all(sl, NULL);
+    cached = apr_skiplist_memory_usage(sl);
+    ABTS_TRUE(tc, cached >= full);
+    for (i = 0; i < 1000; i++) {
+        apr_skiplist_insert(sl, &vals[i]);
+    }
+    /* (not all, since the towers' heights are random) */
+    ABTS_TRUE(tc, apr_skiplist_memory_usage(sl) < 2 * full);
+    for (i = 0; i < 1000; i += 2) {
+        apr_skiplist_remove(sl, &vals[i], NULL);
+    }
+    ABTS_SIZE_EQUAL(tc, 500, skiplist_get_size(tc, sl));
+
+    /* up to a limit */
+    apr_skiplist_set_cache_max(sl, 10);
+    ABTS_TRUE(tc, apr_skiplist_memory_usage(sl) < full);
+    apr_skiplist_remove_all(sl, NULL);
+    ABTS_TRUE(tc, apr_skiplist_memory_usage(sl) < full / 2);
+    apr_skiplist_destroy(sl, NULL);
+
+    /* apr_skiplist_alloc() recycles by size */
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_skiplist_init(&sl, ptmp));
+    empty = apr_skiplist_memory_usage(sl);
+    mem1 = apr_skiplist_alloc(sl, 24);
+    ABTS_PTR_NOTNULL(tc, mem1);
+    ABTS_TRUE(tc, apr_skiplist_memory_usage(sl) >= empty + 24);
+    mem2 = apr_skiplist_alloc(sl, 32);
+    ABTS_TRUE(tc, mem1 != mem2);
+    apr_skiplist_free(sl, mem1);
+    ABTS_PTR_EQUAL(tc, mem1, apr_skiplist_alloc(sl, 24));
+    ABTS_PTR_NOTNULL(tc, apr_skiplist_alloc(sl, 24));
+    apr_skiplist_free(sl, mem2);
+    ABTS_PTR_EQUAL(tc, mem2, apr_skiplist_alloc(sl, 32));
+    apr_pool_clear(ptmp);
+}
+
+static void skiplist_concurrent(abts_case *tc, void *data)
+{
+    apr_skiplist *sl;
+    int vals[100], i, *v;
+    apr_skiplistnode *iter;
+
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_skiplist_init_ex(&sl, ptmp, 0x80));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_skiplist_init_ex(&sl, ptmp, APR_SKIPLIST_CONCURRENT));
+    apr_skiplist_set_compare(sl, comp, comp);
+
+    /* the same semantics as the sequential skip list */
+    for (i = 0; i < 100; i++) {
+        vals[i] = (i * 37) % 100;
+        ABTS_PTR_NOTNULL(tc, apr_skiplist_insert(sl, &vals[i]));
+    }
+    ABTS_SIZE_EQUAL(tc, 100, apr_skiplist_size(sl));
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_insert(sl, &vals[0]));
+    ABTS_PTR_NOTNULL(tc, apr_skiplist_add(sl, &vals[0]));
+    ABTS_SIZE_EQUAL(tc, 101, apr_skiplist_size(sl));
+    for (i = 0; i < 100; i++) {
+        v = apr_skiplist_find(sl, &i, &iter);
+        ABTS_PTR_NOTNULL(tc, v);
+        ABTS_INT_EQUAL(tc, i, *v);
+        ABTS_PTR_EQUAL(tc, v, apr_skiplist_element(iter));
+    }
+    i = 100;
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_find(sl, &i, NULL));
+
+    i = 0;
+    ABTS_INT_EQUAL(tc, 0, *(int *)apr_skiplist_peek(sl));
+    ABTS_TRUE(tc, apr_skiplist_remove(sl, &i, NULL) != 0);
+    ABTS_TRUE(tc, apr_skiplist_remove(sl, &i, NULL) != 0);
+    ABTS_INT_EQUAL(tc, 0, apr_skiplist_remove(sl, &i, NULL));
+    i = 50;
+    v = apr_skiplist_find(sl, &i, &iter);
+    ABTS_TRUE(tc, apr_skiplist_remove_node(sl, iter, NULL) != 0);
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_find(sl, &i, NULL));
+    ABTS_SIZE_EQUAL(tc, 98, apr_skiplist_size(sl));
+
+    for (i = 1; i < 100; i++) {
+        if (i == 50) {
+            continue;
+        }
+        v = apr_skiplist_pop(sl, NULL);
+        ABTS_PTR_NOTNULL(tc, v);
+        ABTS_INT_EQUAL(tc, i, *v);
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_pop(sl, NULL));
+    ABTS_SIZE_EQUAL(tc, 0, apr_skiplist_size(sl));
+
+    apr_skiplist_destroy(sl, NULL);
+    apr_pool_clear(ptmp);
+}
+
+#if APR_HAS_THREADS
+
+#define CONCURRENT_THREADS 4
+#define CONCURRENT_ELEMS 20000
+
+static apr_skiplist *concurrent_sl;
+static volatile apr_uint32_t concurrent_popped[CONCURRENT_THREADS *
+                                               CONCURRENT_ELEMS];
+static int *concurrent_elems[CONCURRENT_THREADS * CONCURRENT_ELEMS];
+static volatile apr_uint32_t concurrent_removed, concurrent_freed;
+
+static void concurrent_free(void *data)
+{
+    apr_atomic_inc32(&concurrent_freed);
+    free(data);
+}
+
+static void * APR_THREAD_FUNC concurrent_thread(apr_thread_t *thd,
+                                                void *data)
+{
+    int id = *(int *)data, i, *v;
+
+    for (i = 0; i < CONCURRENT_ELEMS; i++) {
+        v = malloc(sizeof(*v));
+        *v = i * CONCURRENT_THREADS + id;
+        apr_skiplist_add(concurrent_sl, v);
+        if (i % 3 == 0) {
+            /* unless already popped by a thread emptying the list */
+            int n = *v;
+            if (apr_skiplist_remove(concurrent_sl, v, concurrent_free)) {
+                apr_atomic_inc32(&concurrent_popped[n]);
+                apr_atomic_inc32(&concurrent_removed);
+            }
+        }
+        else if (i % 3 == 1) {
+            apr_skiplist_find(concurrent_sl, v, NULL);
+            apr_skiplist_peek(concurrent_sl);
+        }
+    }
+
+    /* Empty the list, concurrently with the other threads still adding,
+     * the popped elements may still be compared by the other threads so
+     * they are freed at the end.
+     */
+    while ((v = apr_skiplist_pop(concurrent_sl, NULL)) != NULL) {
+        apr_atomic_inc32(&concurrent_popped[*v]);
+        concurrent_elems[*v] = v;
+    }
+    return NULL;
+}
+
+static void skiplist_concurrent_threads(abts_case *tc, void *data)
+{
+    apr_thread_t *t[CONCURRENT_THREADS];
+    int ids[CONCURRENT_THREADS], i, n;
+    apr_status_t rv;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_skiplist_init_ex(&concurrent_sl, ptmp,
+                                        APR_SKIPLIST_CONCURRENT));
+    apr_skiplist_set_compare(concurrent_sl, comp, comp);
+
+    for (i = 0; i < CONCURRENT_THREADS; i++) {
+        ids[i] = i;
+        rv = apr_thread_create(&t[i], NULL, concurrent_thread, &ids[i], ptmp);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < CONCURRENT_THREADS; i++) {
+        apr_thread_join(&rv, t[i]);
+    }
+
+    /* each element was removed or popped once */
+    n = CONCURRENT_THREADS * CONCURRENT_ELEMS;
+    for (i = 0; i < n; i++) {
+        ABTS_INT_EQUAL(tc, 1, concurrent_popped[i]);
+    }
+    ABTS_SIZE_EQUAL(tc, 0, apr_skiplist_size(concurrent_sl));
+    ABTS_PTR_EQUAL(tc, NULL, apr_skiplist_pop(concurrent_sl, NULL));
+
+    /* and the removed ones freed at last */
+    apr_skiplist_destroy(concurrent_sl, NULL);
+    ABTS_INT_EQUAL(tc, concurrent_removed, concurrent_freed);
+    for (i = 0; i < n; i++) {
+        free(concurrent_elems[i]);
+    }
+    apr_pool_clear(ptmp);
+}
+
+#endif /* APR_HAS_THREADS */
+
 abts_suite *testskiplist(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -538,6 +854,13 @@ abts_suite *testskiplist(abts_suite *suite)
     abts_run_test(suite, skiplist_random_loop, NULL);
 
     abts_run_test(suite, skiplist_test, NULL);
+    abts_run_test(suite, skiplist_bulk_load, NULL);
+    abts_run_test(suite, skiplist_range, NULL);
+    abts_run_test(suite, skiplist_memory, NULL);
+    abts_run_test(suite, skiplist_concurrent, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, skiplist_concurrent_threads, NULL);
+#endif
 
     apr_pool_destroy(ptmp);
 
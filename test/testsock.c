@@ -559,6 +559,91 @@ static void test_wait(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "couldn't close server socket", rv);
 }
 
+static void test_systimeout(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *server;
+    apr_socket_t *server_connection;
+    apr_sockaddr_t *server_addr;
+    apr_socket_t *client;
+    apr_interval_time_t delay = 100000;
+    apr_time_t start_time;
+    apr_size_t nbytes;
+    apr_int32_t on;
+    char buf[8];
+
+    server = setup_socket(tc);
+    if (!server) return;
+
+    rv = apr_sockaddr_info_get(&server_addr, socket_name, socket_type, 8021, 0, p);
+    APR_ASSERT_SUCCESS(tc, "setting up sockaddr", rv);
+
+    rv = apr_socket_create(&client, server_addr->family, SOCK_STREAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "creating client socket", rv);
+
+    rv = apr_socket_connect(client, server_addr);
+    APR_ASSERT_SUCCESS(tc, "connecting client to server", rv);
+
+    rv = apr_socket_accept(&server_connection, server, p);
+    APR_ASSERT_SUCCESS(tc, "accepting client connection", rv);
+
+    rv = apr_socket_opt_set(client, APR_SO_SYSTIMEOUT, 1);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "APR_SO_SYSTIMEOUT");
+        apr_socket_close(client);
+        apr_socket_close(server_connection);
+        apr_socket_close(server);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "setting APR_SO_SYSTIMEOUT", rv);
+
+    /* the timeout is the system's, on a blocking socket */
+    rv = apr_socket_timeout_set(client, delay);
+    APR_ASSERT_SUCCESS(tc, "setting client socket timeout", rv);
+    apr_socket_opt_get(client, APR_SO_NONBLOCK, &on);
+    ABTS_INT_EQUAL(tc, 0, on);
+
+    start_time = apr_time_now();
+    nbytes = sizeof(buf);
+    rv = apr_socket_recv(client, buf, &nbytes);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+    ABTS_SIZE_EQUAL(tc, 0, nbytes);
+    ABTS_ASSERT(tc, "apr_socket_recv() waited for the time out",
+                apr_time_now() - start_time >= delay / 2);
+
+    nbytes = 4;
+    rv = apr_socket_send(server_connection, "data", &nbytes);
+    APR_ASSERT_SUCCESS(tc, "Couldn't write to client", rv);
+
+    nbytes = sizeof(buf);
+    rv = apr_socket_recv(client, buf, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "Couldn't read from server", rv);
+    ABTS_SIZE_EQUAL(tc, 4, nbytes);
+
+    /* a zero timeout still means non-blocking */
+    rv = apr_socket_timeout_set(client, 0);
+    APR_ASSERT_SUCCESS(tc, "setting client socket timeout", rv);
+    nbytes = sizeof(buf);
+    rv = apr_socket_recv(client, buf, &nbytes);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+
+    /* and back to polling for the timeout */
+    rv = apr_socket_timeout_set(client, delay);
+    APR_ASSERT_SUCCESS(tc, "setting client socket timeout", rv);
+    rv = apr_socket_opt_set(client, APR_SO_SYSTIMEOUT, 0);
+    APR_ASSERT_SUCCESS(tc, "clearing APR_SO_SYSTIMEOUT", rv);
+    apr_socket_opt_get(client, APR_SO_NONBLOCK, &on);
+    ABTS_INT_EQUAL(tc, 1, on);
+    nbytes = sizeof(buf);
+    rv = apr_socket_recv(client, buf, &nbytes);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    apr_socket_close(client);
+    apr_socket_close(server_connection);
+    rv = apr_socket_close(server);
+    APR_ASSERT_SUCCESS(tc, "couldn't close server socket", rv);
+}
+
 /* Make sure that setting a connected socket non-blocking works
  * when the listening socket was non-blocking.
  * If APR thinks that non-blocking is inherited but it really
@@ -749,6 +834,7 @@ abts_suite *testsock(abts_suite *suite)
     abts_run_test(suite, test_print_addr, NULL);
     abts_run_test(suite, test_get_addr, NULL);
     abts_run_test(suite, test_wait, NULL);
+    abts_run_test(suite, test_systimeout, NULL);
     abts_run_test(suite, test_nonblock_inheritance, NULL);
     abts_run_test(suite, test_freebind, NULL);
     abts_run_test(suite, test_zone, NULL);
@@ -19,6 +19,7 @@
 #include "apr_general.h"
 #include "apr_lib.h"
 #include "apr_strings.h"
+#include "apr_buckets.h"
 #include "testutil.h"
 
 #define STRLEN 21
@@ -192,6 +193,158 @@ static void sendto_receivefrom6(abts_case *tc, void *data)
 }
 #endif
 
+#define MMSG_COUNT 100
+#define MMSG_SEGMENT 1000
+#define MMSG_SEGMENTS 3
+
+static void udp_pair(abts_case *tc, apr_socket_t **client,
+                     apr_socket_t **server, apr_sockaddr_t **to)
+{
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+
+    rv = apr_socket_create(server, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating server socket", rv);
+    rv = apr_socket_bind(*server, sa);
+    APR_ASSERT_SUCCESS(tc, "Problem binding server socket", rv);
+    rv = apr_socket_addr_get(to, APR_LOCAL, *server);
+    APR_ASSERT_SUCCESS(tc, "Problem getting server address", rv);
+    rv = apr_socket_timeout_set(*server, apr_time_from_sec(1));
+    APR_ASSERT_SUCCESS(tc, "Problem setting server timeout", rv);
+
+    rv = apr_socket_create(client, APR_INET, SOCK_DGRAM, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating client socket", rv);
+}
+
+/* Receive until the given number of bytes or messages arrived */
+static void recv_mmsg(abts_case *tc, apr_socket_t *sock,
+                      apr_socket_msg_t *msgs, apr_int32_t nmsgs,
+                      apr_size_t size, apr_int32_t *total,
+                      apr_size_t *bytes)
+{
+    apr_int32_t i, n;
+    apr_status_t rv;
+
+    *total = 0;
+    *bytes = 0;
+    while (*total < nmsgs && *bytes < size) {
+        for (i = *total; i < nmsgs; i++) {
+            msgs[i].len = size;
+        }
+        rv = apr_socket_recvmmsg(sock, msgs + *total, nmsgs - *total, 0, &n);
+        APR_ASSERT_SUCCESS(tc, "Problem receiving", rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        ABTS_TRUE(tc, n > 0);
+        for (i = *total; i < *total + n; i++) {
+            *bytes += msgs[i].len;
+        }
+        *total += n;
+    }
+}
+
+static void socket_sendmmsg_recvmmsg(abts_case *tc, void *data)
+{
+    apr_socket_t *client, *server;
+    apr_sockaddr_t *to;
+    apr_socket_msg_t msgs[MMSG_COUNT];
+    char *bufs = apr_pcalloc(p, MMSG_COUNT * 16);
+    apr_size_t bytes;
+    apr_int32_t i, n;
+    apr_status_t rv;
+
+    udp_pair(tc, &client, &server, &to);
+
+    for (i = 0; i < MMSG_COUNT; i++) {
+        msgs[i].buf = bufs + i * 16;
+        msgs[i].len = apr_snprintf(msgs[i].buf, 16, "datagram %d", i);
+        msgs[i].addr = to;
+        msgs[i].segment = 0;
+    }
+    rv = apr_socket_sendmmsg(client, msgs, MMSG_COUNT, 0, &n);
+    APR_ASSERT_SUCCESS(tc, "Problem sending", rv);
+    ABTS_INT_EQUAL(tc, MMSG_COUNT, n);
+
+    memset(bufs, 0, MMSG_COUNT * 16);
+    for (i = 0; i < MMSG_COUNT; i++) {
+        msgs[i].addr = apr_pcalloc(p, sizeof(apr_sockaddr_t));
+        msgs[i].addr->pool = p;
+    }
+    recv_mmsg(tc, server, msgs, MMSG_COUNT, 16, &n, &bytes);
+    ABTS_INT_EQUAL(tc, MMSG_COUNT, n);
+    for (i = 0; i < n; i++) {
+        char expected[16];
+        apr_snprintf(expected, sizeof(expected), "datagram %d", i);
+        ABTS_STR_EQUAL(tc, expected, msgs[i].buf);
+        ABTS_INT_EQUAL(tc, APR_INET, msgs[i].addr->family);
+        ABTS_SIZE_EQUAL(tc, 0, msgs[i].segment);
+    }
+
+    rv = apr_socket_sendmmsg(client, msgs, -1, 0, &n);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+}
+
+static void socket_sendmmsg_segment(abts_case *tc, void *data)
+{
+    apr_socket_t *client, *server;
+    apr_sockaddr_t *to;
+    apr_socket_msg_t msg, msgs[MMSG_SEGMENTS];
+    char *buf = apr_palloc(p, MMSG_SEGMENT * MMSG_SEGMENTS);
+    char *out = apr_pcalloc(p, MMSG_SEGMENT * MMSG_SEGMENTS);
+    apr_size_t bytes;
+    apr_int32_t i, n;
+    apr_status_t rv;
+    int gro;
+
+    udp_pair(tc, &client, &server, &to);
+    gro = (apr_socket_opt_set(server, APR_SO_UDP_GRO, 1) == APR_SUCCESS);
+
+    for (i = 0; i < MMSG_SEGMENT * MMSG_SEGMENTS; i++) {
+        buf[i] = 'a' + i % 26;
+    }
+    msg.buf = buf;
+    msg.len = MMSG_SEGMENT * MMSG_SEGMENTS;
+    msg.addr = to;
+    msg.segment = MMSG_SEGMENT;
+    rv = apr_socket_sendmmsg(client, &msg, 1, 0, &n);
+    APR_ASSERT_SUCCESS(tc, "Problem sending", rv);
+    ABTS_INT_EQUAL(tc, 1, n);
+    ABTS_SIZE_EQUAL(tc, MMSG_SEGMENT * MMSG_SEGMENTS, msg.len);
+
+    /* Either the datagrams or their coalescing into one message */
+    for (i = 0; i < MMSG_SEGMENTS; i++) {
+        msgs[i].buf = out + i * MMSG_SEGMENT;
+        msgs[i].addr = NULL;
+    }
+    recv_mmsg(tc, server, msgs, MMSG_SEGMENTS, MMSG_SEGMENT * MMSG_SEGMENTS,
+              &n, &bytes);
+    ABTS_SIZE_EQUAL(tc, MMSG_SEGMENT * MMSG_SEGMENTS, bytes);
+    for (i = 0; i < n; i++) {
+        if (msgs[i].len > MMSG_SEGMENT) {
+            ABTS_TRUE(tc, gro);
+            ABTS_SIZE_EQUAL(tc, MMSG_SEGMENT, msgs[i].segment);
+        }
+        else {
+            ABTS_SIZE_EQUAL(tc, MMSG_SEGMENT, msgs[i].len);
+        }
+    }
+    ABTS_TRUE(tc, memcmp(buf, out, MMSG_SEGMENT * MMSG_SEGMENTS) == 0);
+
+    msg.segment = 65536;
+    rv = apr_socket_sendmmsg(client, &msg, 1, 0, &n);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+}
+
 static void socket_userdata(abts_case *tc, void *data)
 {
     apr_socket_t *sock1, *sock2;
@@ -217,6 +370,394 @@ static void socket_userdata(abts_case *tc, void *data)
     ABTS_STR_EQUAL(tc, "SOCK2", user);
 }
 
+static void socket_pair(abts_case *tc, apr_socket_t **client,
+                        apr_socket_t **server)
+{
+    apr_socket_t *listener;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating listener", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "Problem binding listener", rv);
+    rv = apr_socket_listen(listener, 1);
+    APR_ASSERT_SUCCESS(tc, "Problem listening", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "Problem getting listener address", rv);
+
+    rv = apr_socket_create(client, APR_INET, SOCK_STREAM, APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating client", rv);
+    rv = apr_socket_connect(*client, sa);
+    APR_ASSERT_SUCCESS(tc, "Problem connecting", rv);
+    rv = apr_socket_accept(server, listener, p);
+    APR_ASSERT_SUCCESS(tc, "Problem accepting", rv);
+
+    apr_socket_close(listener);
+}
+
+static void socket_connect_any(abts_case *tc, void *data)
+{
+    apr_socket_t *listener, *unbound, *client, *server;
+    apr_sockaddr_t *sa, *refused, *remote;
+    apr_size_t len = 1;
+    apr_status_t rv;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_create(&listener, APR_INET, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating listener", rv);
+    rv = apr_socket_bind(listener, sa);
+    APR_ASSERT_SUCCESS(tc, "Problem binding listener", rv);
+    rv = apr_socket_listen(listener, 1);
+    APR_ASSERT_SUCCESS(tc, "Problem listening", rv);
+    rv = apr_socket_addr_get(&sa, APR_LOCAL, listener);
+    APR_ASSERT_SUCCESS(tc, "Problem getting listener address", rv);
+
+    /* A bound socket which does not listen refuses the connections */
+    rv = apr_sockaddr_info_get(&refused, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+    rv = apr_socket_create(&unbound, APR_INET, SOCK_STREAM,
+                           APR_PROTO_TCP, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating socket", rv);
+    rv = apr_socket_bind(unbound, refused);
+    APR_ASSERT_SUCCESS(tc, "Problem binding socket", rv);
+    rv = apr_socket_addr_get(&remote, APR_LOCAL, unbound);
+    APR_ASSERT_SUCCESS(tc, "Problem getting socket address", rv);
+    rv = apr_sockaddr_info_get(&refused, "127.0.0.1", APR_INET,
+                               remote->port, 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem generating sockaddr", rv);
+
+    rv = apr_socket_connect_any(&client, refused, SOCK_STREAM,
+                                APR_PROTO_TCP, -1, -1, 0, p);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_ECONNREFUSED(rv));
+    ABTS_PTR_EQUAL(tc, NULL, client);
+
+    /* The refused attempt lets the next one start at once */
+    refused->next = sa;
+    rv = apr_socket_connect_any(&client, refused, SOCK_STREAM,
+                                APR_PROTO_TCP, apr_time_from_sec(10),
+                                apr_time_from_sec(5), 0, p);
+    APR_ASSERT_SUCCESS(tc, "Problem connecting to any", rv);
+    rv = apr_socket_addr_get(&remote, APR_REMOTE, client);
+    APR_ASSERT_SUCCESS(tc, "Problem getting remote address", rv);
+    ABTS_INT_EQUAL(tc, sa->port, remote->port);
+
+    rv = apr_socket_accept(&server, listener, p);
+    APR_ASSERT_SUCCESS(tc, "Problem accepting", rv);
+    rv = apr_socket_send(client, "x", &len);
+    APR_ASSERT_SUCCESS(tc, "Problem sending", rv);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+    apr_socket_close(unbound);
+    apr_socket_close(listener);
+}
+
+static void recv_all(abts_case *tc, apr_socket_t *sock, char *buf,
+                     apr_size_t size, apr_size_t *total)
+{
+    apr_status_t rv;
+
+    *total = 0;
+    for (;;) {
+        apr_size_t n = size - *total;
+        rv = apr_socket_recv(sock, buf + *total, &n);
+        *total += n;
+        if (rv == APR_EOF || *total == size) {
+            break;
+        }
+        APR_ASSERT_SUCCESS(tc, "Problem receiving", rv);
+    }
+}
+
+static void brigade_write_vector(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *c, *d;
+    apr_file_t *f;
+    char template[] = "data/writesockXXXXXX";
+    char *big, *expect, *out;
+    apr_size_t n, size = 0, total;
+    apr_status_t rv;
+    int i;
+
+    /* Many small buckets, a big one, a file, and small ones again */
+    expect = apr_palloc(p, 64 * 1024);
+    out = apr_palloc(p, 64 * 1024);
+    for (i = 0; i < 300; i++) {
+        const char *str = apr_psprintf(p, "bucket%d;", i);
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(str,
+                                                  strlen(str), ba));
+        memcpy(expect + size, str, strlen(str));
+        size += strlen(str);
+    }
+    big = apr_palloc(p, 20000);
+    memset(big, 'x', 20000);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_pool_create(big, 20000, p, ba));
+    memcpy(expect + size, big, 20000);
+    size += 20000;
+
+    rv = apr_file_mktemp(&f, template, APR_FOPEN_CREATE | APR_FOPEN_READ
+                         | APR_FOPEN_WRITE | APR_FOPEN_EXCL
+                         | APR_FOPEN_DELONCLOSE
+                         | APR_FOPEN_SENDFILE_ENABLED, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating temp file", rv);
+    rv = apr_file_write_full(f, expect, 16000, NULL);
+    APR_ASSERT_SUCCESS(tc, "Problem writing temp file", rv);
+    apr_brigade_insert_file(bb, f, 1000, 15000, p);
+    memmove(expect + size, expect + 1000, 15000);
+    size += 15000;
+
+    for (i = 0; i < 10; i++) {
+        APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("tail", 4,
+                                                               ba));
+        memcpy(expect + size, "tail", 4);
+        size += 4;
+    }
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+
+    socket_pair(tc, &c, &d);
+    rv = apr_brigade_write_socket(bb, c, &n);
+    APR_ASSERT_SUCCESS(tc, "Problem writing brigade", rv);
+    ABTS_SIZE_EQUAL(tc, size, n);
+    ABTS_TRUE(tc, APR_BUCKET_IS_FLUSH(APR_BRIGADE_FIRST(bb)));
+    apr_socket_close(c);
+
+    recv_all(tc, d, out, 64 * 1024, &total);
+    ABTS_SIZE_EQUAL(tc, size, total);
+    ABTS_TRUE(tc, memcmp(expect, out, size) == 0);
+
+    apr_socket_close(d);
+    apr_brigade_destroy(bb);
+    apr_file_close(f);
+    apr_bucket_alloc_destroy(ba);
+}
+
+#if APR_HAS_SPLICE
+#define SPLICE_SIZE (48 * 1024)
+
+static void socket_splice(abts_case *tc, void *data)
+{
+    apr_socket_t *a, *b, *c, *d;
+    char *in = apr_palloc(p, SPLICE_SIZE), *out = apr_palloc(p, SPLICE_SIZE);
+    apr_size_t n, total = 0;
+    apr_status_t rv;
+    int i;
+
+    for (i = 0; i < SPLICE_SIZE; i++) {
+        in[i] = 'a' + i % 26;
+    }
+    socket_pair(tc, &a, &b);
+    socket_pair(tc, &c, &d);
+
+    n = SPLICE_SIZE;
+    rv = apr_socket_send(a, in, &n);
+    APR_ASSERT_SUCCESS(tc, "Problem sending", rv);
+    ABTS_SIZE_EQUAL(tc, SPLICE_SIZE, n);
+    apr_socket_close(a);
+
+    do {
+        n = SPLICE_SIZE;
+        rv = apr_socket_splice(c, b, &n);
+        total += n;
+    } while (rv == APR_SUCCESS);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, SPLICE_SIZE, total);
+    apr_socket_close(c);
+
+    recv_all(tc, d, out, SPLICE_SIZE, &total);
+    ABTS_SIZE_EQUAL(tc, SPLICE_SIZE, total);
+    ABTS_TRUE(tc, memcmp(in, out, SPLICE_SIZE) == 0);
+
+    apr_socket_close(b);
+    apr_socket_close(d);
+}
+
+static void brigade_write_socket(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *c, *d;
+    apr_file_t *rd, *wr;
+    char out[64];
+    apr_size_t n;
+    apr_status_t rv;
+
+    socket_pair(tc, &c, &d);
+    rv = apr_file_pipe_create(&rd, &wr, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating pipe", rv);
+    rv = apr_file_puts("hello, ", wr);
+    APR_ASSERT_SUCCESS(tc, "Problem writing to pipe", rv);
+    apr_file_close(wr);
+
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_pipe_create(rd, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create("world", 5, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(ba));
+
+    rv = apr_brigade_write_socket(bb, c, &n);
+    APR_ASSERT_SUCCESS(tc, "Problem sending brigade", rv);
+    ABTS_SIZE_EQUAL(tc, 12, n);
+    ABTS_TRUE(tc, APR_BUCKET_IS_EOS(APR_BRIGADE_FIRST(bb)));
+    apr_socket_close(c);
+
+    recv_all(tc, d, out, sizeof(out), &n);
+    ABTS_SIZE_EQUAL(tc, 12, n);
+    ABTS_TRUE(tc, memcmp(out, "hello, world", 12) == 0);
+
+    apr_socket_close(d);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+#endif /* APR_HAS_SPLICE */
+
+#define ZEROCOPY_SIZE (64 * 1024)
+
+static void socket_sendv_zerocopy(abts_case *tc, void *data)
+{
+    apr_socket_t *a, *b;
+    char *in = apr_palloc(p, ZEROCOPY_SIZE), *out = apr_palloc(p, ZEROCOPY_SIZE);
+    struct iovec vec;
+    apr_uint32_t id, lo, hi;
+    apr_time_t deadline;
+    apr_size_t n, total;
+    apr_status_t rv;
+    int i, copied;
+
+    socket_pair(tc, &a, &b);
+    rv = apr_socket_opt_set(a, APR_SO_ZEROCOPY, 1);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "zero copy not supported");
+        apr_socket_close(a);
+        apr_socket_close(b);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "Problem setting APR_SO_ZEROCOPY", rv);
+
+    for (i = 0; i < ZEROCOPY_SIZE; i++) {
+        in[i] = 'a' + i % 26;
+    }
+    vec.iov_base = in;
+    vec.iov_len = ZEROCOPY_SIZE;
+
+    n = 1;
+    rv = apr_socket_sendv_zerocopy(b, &vec, 1, &n, &id);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    ABTS_SIZE_EQUAL(tc, 0, n);
+
+    rv = apr_socket_sendv_zerocopy(a, &vec, 1, &n, &id);
+    APR_ASSERT_SUCCESS(tc, "Problem sending", rv);
+    ABTS_SIZE_EQUAL(tc, ZEROCOPY_SIZE, n);
+    ABTS_INT_EQUAL(tc, 0, id);
+
+    recv_all(tc, b, out, ZEROCOPY_SIZE, &total);
+    ABTS_SIZE_EQUAL(tc, ZEROCOPY_SIZE, total);
+    ABTS_TRUE(tc, memcmp(in, out, ZEROCOPY_SIZE) == 0);
+
+    /* The data were received, so the pages are released soon */
+    deadline = apr_time_now() + apr_time_from_sec(1);
+    do {
+        rv = apr_socket_zerocopy_reap(a, &lo, &hi, &copied);
+        if (rv != APR_EAGAIN) {
+            break;
+        }
+        apr_sleep(apr_time_from_msec(1));
+    } while (apr_time_now() < deadline);
+    APR_ASSERT_SUCCESS(tc, "Problem reaping completion", rv);
+    ABTS_INT_EQUAL(tc, 0, lo);
+    ABTS_INT_EQUAL(tc, 0, hi);
+
+    rv = apr_socket_zerocopy_reap(a, &lo, &hi, &copied);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    apr_socket_close(a);
+    apr_socket_close(b);
+}
+
+#if APR_HAS_SENDFILE
+
+#define SENDFILE_SIZE 10000
+
+static void sendfile_hdtr_helper(abts_case *tc, apr_file_t *f,
+                                 const char *content, int trailers)
+{
+    static char header1[] = "HEAD", header2[] = "ERS\n", trailer[] = "\nEND";
+    struct iovec headers[2], trailerv[1];
+    apr_hdtr_t hdtr;
+    apr_socket_t *a, *b;
+    apr_size_t size = 8 + SENDFILE_SIZE + (trailers ? 4 : 0);
+    char *out = apr_palloc(p, size);
+    apr_size_t n, total;
+    apr_off_t off = 0;
+    apr_int32_t on;
+    apr_status_t rv;
+
+    headers[0].iov_base = header1;
+    headers[0].iov_len = 4;
+    headers[1].iov_base = header2;
+    headers[1].iov_len = 4;
+    trailerv[0].iov_base = trailer;
+    trailerv[0].iov_len = 4;
+    hdtr.headers = headers;
+    hdtr.numheaders = 2;
+    hdtr.trailers = trailerv;
+    hdtr.numtrailers = trailers ? 1 : 0;
+
+    socket_pair(tc, &a, &b);
+
+    n = SENDFILE_SIZE;
+    rv = apr_socket_sendfile(a, f, &hdtr, &off, &n, 0);
+    APR_ASSERT_SUCCESS(tc, "Problem sending file", rv);
+    ABTS_SIZE_EQUAL(tc, size, n);
+    /* TCP_CORK is not left set */
+    rv = apr_socket_opt_get(a, APR_TCP_NOPUSH, &on);
+    APR_ASSERT_SUCCESS(tc, "Problem getting APR_TCP_NOPUSH", rv);
+    ABTS_INT_EQUAL(tc, 0, on);
+    apr_socket_close(a);
+
+    recv_all(tc, b, out, size, &total);
+    ABTS_SIZE_EQUAL(tc, size, total);
+    ABTS_TRUE(tc, memcmp(out, "HEADERS\n", 8) == 0);
+    ABTS_TRUE(tc, memcmp(out + 8, content, SENDFILE_SIZE) == 0);
+    if (trailers) {
+        ABTS_TRUE(tc, memcmp(out + 8 + SENDFILE_SIZE, "\nEND", 4) == 0);
+    }
+    apr_socket_close(b);
+}
+
+static void socket_sendfile_hdtr(abts_case *tc, void *data)
+{
+    char *content = apr_palloc(p, SENDFILE_SIZE);
+    char template[] = "data/sendfileXXXXXX";
+    apr_file_t *f;
+    apr_size_t n;
+    apr_status_t rv;
+    int i;
+
+    for (i = 0; i < SENDFILE_SIZE; i++) {
+        content[i] = 'A' + i % 26;
+    }
+    rv = apr_file_mktemp(&f, template, APR_FOPEN_CREATE | APR_FOPEN_READ
+                         | APR_FOPEN_WRITE | APR_FOPEN_DELONCLOSE, p);
+    APR_ASSERT_SUCCESS(tc, "Problem creating file", rv);
+    n = SENDFILE_SIZE;
+    rv = apr_file_write_full(f, content, n, NULL);
+    APR_ASSERT_SUCCESS(tc, "Problem writing file", rv);
+
+    /* Headers sent with MSG_MORE, then with TCP_CORK for the trailers */
+    sendfile_hdtr_helper(tc, f, content, 0);
+    sendfile_hdtr_helper(tc, f, content, 1);
+
+    apr_file_close(f);
+}
+
+#endif /* APR_HAS_SENDFILE */
+
 abts_suite *testsockets(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -233,7 +774,21 @@ abts_suite *testsockets(abts_suite *suite)
     abts_run_test(suite, sendto_receivefrom6, NULL);
 #endif
 
+    abts_run_test(suite, socket_sendmmsg_recvmmsg, NULL);
+    abts_run_test(suite, socket_sendmmsg_segment, NULL);
+
     abts_run_test(suite, socket_userdata, NULL);
+    abts_run_test(suite, socket_connect_any, NULL);
+
+    abts_run_test(suite, brigade_write_vector, NULL);
+    abts_run_test(suite, socket_sendv_zerocopy, NULL);
+#if APR_HAS_SENDFILE
+    abts_run_test(suite, socket_sendfile_hdtr, NULL);
+#endif
+#if APR_HAS_SPLICE
+    abts_run_test(suite, socket_splice, NULL);
+    abts_run_test(suite, brigade_write_socket, NULL);
+#endif
     
     return suite;
 }
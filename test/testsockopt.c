@@ -18,6 +18,7 @@
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_lib.h"
+#include "apr_time.h"
 #include "testutil.h"
 
 static apr_socket_t *sock = NULL;
@@ -123,6 +124,95 @@ static void close_socket(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+#define GROUP_SIZE    4
+#define GROUP_CLIENTS 16
+
+static void listen_group_flags(abts_case *tc, apr_uint32_t flags)
+{
+    apr_socket_listen_group_t *group;
+    apr_socket_t *clients[GROUP_CLIENTS], *s;
+    apr_sockaddr_t *sa, *bound, *target = NULL;
+    apr_time_t deadline;
+    apr_port_t port = 0;
+    apr_status_t rv;
+    int i, accepted;
+
+    rv = apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0, 0, p);
+    APR_ASSERT_SUCCESS(tc, "get loopback address", rv);
+
+    rv = apr_socket_listen_group_create(&group, sa, SOCK_STREAM,
+                                        APR_PROTO_TCP, GROUP_SIZE, 16,
+                                        flags, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "listen groups not supported");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create listen group", rv);
+    ABTS_INT_EQUAL(tc, GROUP_SIZE, apr_socket_listen_group_size(group));
+    ABTS_PTR_EQUAL(tc, NULL, apr_socket_listen_group_get(group, GROUP_SIZE));
+
+    /* all bound to the same (picked) port */
+    for (i = 0; i < GROUP_SIZE; i++) {
+        s = apr_socket_listen_group_get(group, i);
+        rv = apr_socket_addr_get(&bound, APR_LOCAL, s);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (!i) {
+            target = bound;
+            port = bound->port;
+            ABTS_ASSERT(tc, "no port picked", port != 0);
+        }
+        ABTS_INT_EQUAL(tc, port, bound->port);
+        apr_socket_timeout_set(s, 0);
+    }
+
+    for (i = 0; i < GROUP_CLIENTS; i++) {
+        rv = apr_socket_create(&clients[i], APR_INET, SOCK_STREAM,
+                               APR_PROTO_TCP, p);
+        APR_ASSERT_SUCCESS(tc, "create client", rv);
+        rv = apr_socket_connect(clients[i], target);
+        APR_ASSERT_SUCCESS(tc, "connect to the group", rv);
+    }
+
+    /* each connection is accepted by one of the sockets */
+    accepted = 0;
+    deadline = apr_time_now() + apr_time_from_sec(2);
+    while (accepted < GROUP_CLIENTS && apr_time_now() < deadline) {
+        int before = accepted;
+
+        for (i = 0; i < GROUP_SIZE; i++) {
+            apr_socket_t *conn;
+
+            while (apr_socket_accept(&conn,
+                                     apr_socket_listen_group_get(group, i),
+                                     p) == APR_SUCCESS) {
+                apr_socket_close(conn);
+                accepted++;
+            }
+        }
+        if (accepted == before) {
+            apr_sleep(apr_time_from_msec(1));
+        }
+    }
+    ABTS_INT_EQUAL(tc, GROUP_CLIENTS, accepted);
+
+    for (i = 0; i < GROUP_CLIENTS; i++) {
+        apr_socket_close(clients[i]);
+    }
+    for (i = 0; i < GROUP_SIZE; i++) {
+        apr_socket_close(apr_socket_listen_group_get(group, i));
+    }
+}
+
+static void listen_group(abts_case *tc, void *data)
+{
+    listen_group_flags(tc, 0);
+}
+
+static void listen_group_steer_cpu(abts_case *tc, void *data)
+{
+    listen_group_flags(tc, APR_LISTEN_GROUP_STEER_CPU);
+}
+
 abts_suite *testsockopt(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -133,6 +223,8 @@ abts_suite *testsockopt(abts_suite *suite)
     abts_run_test(suite, remove_keepalive, NULL);
     abts_run_test(suite, corkable, NULL);
     abts_run_test(suite, close_socket, NULL);
+    abts_run_test(suite, listen_group, NULL);
+    abts_run_test(suite, listen_group_steer_cpu, NULL);
 
     return suite;
 }
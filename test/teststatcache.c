@@ -0,0 +1,146 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_stat_cache.h"
+#include "apr_file_io.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#define STATFILE "data/statcache.txt"
+
+static void write_file(abts_case *tc, const char *fname, const char *data)
+{
+    apr_file_t *f;
+    apr_status_t rv;
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                                  | APR_FOPEN_APPEND,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open file", rv);
+    rv = apr_file_write_full(f, data, strlen(data), NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't write file", rv);
+    apr_file_close(f);
+}
+
+static void test_create(abts_case *tc, void *data)
+{
+    apr_stat_cache_t *sc;
+    apr_status_t rv;
+
+    rv = apr_stat_cache_create(&sc, 64 * 1024, -1, 0, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_stat_cache_create(&sc, 64 * 1024, 0, 0, p);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_stat_cache_create(&sc, 64 * 1024, apr_time_from_sec(1), 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_ttl(abts_case *tc, void *data)
+{
+    apr_stat_cache_t *sc;
+    apr_finfo_t finfo;
+    apr_status_t rv;
+
+    apr_file_remove(STATFILE, p);
+    rv = apr_stat_cache_create(&sc, 64 * 1024, apr_time_from_sec(60), 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Nonexistent files are cached too */
+    rv = apr_stat_cache_stat(sc, &finfo, STATFILE, APR_FINFO_SIZE, p);
+    ABTS_TRUE(tc, APR_STATUS_IS_ENOENT(rv));
+    write_file(tc, STATFILE, "12345");
+    rv = apr_stat_cache_stat(sc, &finfo, STATFILE, APR_FINFO_SIZE, p);
+    ABTS_TRUE(tc, APR_STATUS_IS_ENOENT(rv));
+
+    apr_stat_cache_invalidate(sc, STATFILE);
+    rv = apr_stat_cache_stat(sc, &finfo, STATFILE, APR_FINFO_SIZE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 5, (int)finfo.size);
+    ABTS_STR_EQUAL(tc, STATFILE, finfo.fname);
+    ABTS_PTR_EQUAL(tc, p, finfo.pool);
+
+    /* Served from the cache, stale */
+    write_file(tc, STATFILE, "67890");
+    rv = apr_stat_cache_stat(sc, &finfo, STATFILE, APR_FINFO_NORM, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 5, (int)finfo.size);
+    ABTS_INT_EQUAL(tc, APR_REG, finfo.filetype);
+
+    apr_stat_cache_clear(sc);
+    rv = apr_stat_cache_stat(sc, &finfo, STATFILE, APR_FINFO_SIZE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 10, (int)finfo.size);
+
+    apr_file_remove(STATFILE, p);
+}
+
+/* Wait for the cache to see the file's new size */
+static apr_status_t wait_size(apr_stat_cache_t *sc, const char *fname,
+                              apr_off_t size)
+{
+    apr_finfo_t finfo;
+    apr_status_t rv = APR_SUCCESS;
+    int i;
+
+    for (i = 0; i < 500; i++) {
+        rv = apr_stat_cache_stat(sc, &finfo, fname, APR_FINFO_SIZE, p);
+        if (size < 0 ? APR_STATUS_IS_ENOENT(rv)
+                     : (rv == APR_SUCCESS && finfo.size == size)) {
+            return APR_SUCCESS;
+        }
+        apr_sleep(apr_time_from_msec(10));
+    }
+    return rv == APR_SUCCESS ? APR_EGENERAL : rv;
+}
+
+static void test_notify(abts_case *tc, void *data)
+{
+    apr_stat_cache_t *sc;
+    apr_finfo_t finfo;
+    apr_status_t rv;
+
+    apr_file_remove(STATFILE, p);
+    rv = apr_stat_cache_create(&sc, 64 * 1024, 0, APR_STAT_CACHE_NOTIFY, p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "file system notifications");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_stat_cache_stat(sc, &finfo, STATFILE, APR_FINFO_SIZE, p);
+    ABTS_TRUE(tc, APR_STATUS_IS_ENOENT(rv));
+
+    write_file(tc, STATFILE, "12345");
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, wait_size(sc, STATFILE, 5));
+    write_file(tc, STATFILE, "67890");
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, wait_size(sc, STATFILE, 10));
+
+    rv = apr_file_remove(STATFILE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, wait_size(sc, STATFILE, -1));
+}
+
+abts_suite *teststatcache(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test_create, NULL);
+    abts_run_test(suite, test_ttl, NULL);
+    abts_run_test(suite, test_notify, NULL);
+
+    return suite;
+}
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 
 #if APR_HAVE_LIMITS_H
 #include <limits.h>
@@ -350,6 +351,108 @@ static void string_strfsize(abts_case *tc, void *data)
     }
 }
 
+static void string_dtoa(abts_case *tc, void *data)
+{
+    static const struct {
+        double d;
+        const char *s;
+    } ts[] = {
+        { 0.0, "0" }, { -0.0, "-0" }, { 1.0, "1" }, { -1.5, "-1.5" },
+        { 0.1, "0.1" }, { 0.3, "0.3" }, { 1.0 / 3, "0.3333333333333333" },
+        { 800.0, "800" }, { 123456.789, "123456.789" },
+        { 1e20, "100000000000000000000" }, { 1e21, "1e21" },
+        { 1.5e300, "1.5e300" }, { 0.000001, "0.000001" },
+        { 1.5e-7, "1.5e-7" }, { 5e-324, "5e-324" },
+        { 2.2250738585072014e-308, "2.2250738585072014e-308" },
+        { 1.7976931348623157e308, "1.7976931348623157e308" },
+        { 9007199254740993.0, "9007199254740992" }
+    };
+    char buf[APR_DTOA_SIZE];
+    apr_size_t i;
+
+    for (i = 0; i < sizeof(ts) / sizeof(ts[0]); i++) {
+        apr_size_t len = apr_dtoa(buf, ts[i].d);
+
+        ABTS_STR_EQUAL(tc, ts[i].s, buf);
+        ABTS_SIZE_EQUAL(tc, strlen(ts[i].s), len);
+    }
+}
+
+static void string_strtod_fast(abts_case *tc, void *data)
+{
+    static const char *ts[] = {
+        "0", "-0", "1", "0.1", "3.14159", "1e23", "8.98846567431158e307",
+        "1.7976931348623157e308", "1.8e308", "2.2250738585072011e-308",
+        "4.9406564584124654e-324", "2e-324", "1e-400", "123456789012345678901",
+        "9007199254740993", "9007199254740993.0000000000000000001",
+        "0.0000000000000000000000000000000000000001e40", "  +12.5e+1x",
+        "7.2057594037927933e16", "1.00000000000000011102230246251565404236"
+    };
+    char buf[APR_DTOA_SIZE], *end1, *end2;
+    apr_uint64_t seed = 42;
+    double d1, d2;
+    int i;
+
+    for (i = 0; i < (int)(sizeof(ts) / sizeof(ts[0])); i++) {
+        d1 = apr_strtod_fast(ts[i], &end1);
+        d2 = strtod(ts[i], &end2);
+        ABTS_ASSERT(tc, ts[i], !memcmp(&d1, &d2, sizeof(d1)));
+        ABTS_PTR_EQUAL(tc, end2, end1);
+    }
+
+    d1 = apr_strtod_fast("1e999", NULL);
+    ABTS_INT_EQUAL(tc, ERANGE, errno);
+    d1 = apr_strtod_fast("1.5", NULL);
+    ABTS_INT_EQUAL(tc, 0, errno);
+
+    /* any double reads back from apr_dtoa(), and as strtod() does */
+    for (i = 0; i < 100000; i++) {
+        apr_uint64_t bits;
+
+        seed = seed * APR_UINT64_C(6364136223846793005)
+               + APR_UINT64_C(1442695040888963407);
+        bits = seed ^ (seed >> 29);
+        memcpy(&d1, &bits, sizeof(d1));
+        if (d1 != d1 || d1 - d1 != 0) {
+            continue;
+        }
+        apr_dtoa(buf, d1);
+        d2 = apr_strtod_fast(buf, NULL);
+        if (memcmp(&d1, &d2, sizeof(d1))) {
+            ABTS_FAIL(tc, buf);
+            break;
+        }
+        d2 = strtod(buf, NULL);
+        if (memcmp(&d1, &d2, sizeof(d1))) {
+            ABTS_FAIL(tc, buf);
+            break;
+        }
+        /* and with more digits than needed, against strtod() */
+        sprintf(buf, "%.20e", d1);
+        d1 = apr_strtod_fast(buf, NULL);
+        d2 = strtod(buf, NULL);
+        if (memcmp(&d1, &d2, sizeof(d1))) {
+            ABTS_FAIL(tc, buf);
+            break;
+        }
+    }
+}
+
+static void snprintf_shortest(abts_case *tc, void *data)
+{
+    char buf[64];
+    double d = 0.1, big = 1e300;
+
+    apr_snprintf(buf, sizeof(buf), "[%pd]", &d);
+    ABTS_STR_EQUAL(tc, "[0.1]", buf);
+    apr_snprintf(buf, sizeof(buf), "[%6pd]", &d);
+    ABTS_STR_EQUAL(tc, "[   0.1]", buf);
+
+    /* a huge %f no longer reads past its digits */
+    ABTS_INT_EQUAL(tc, 301, (int)strlen(apr_psprintf(p, "%.0f", big)));
+    ABTS_INT_EQUAL(tc, 308, (int)strlen(apr_psprintf(p, "%f", big)));
+}
+
 static void string_cpystrn(abts_case *tc, void *data)
 {
     char buf[6], *ret;
@@ -423,6 +526,9 @@ abts_suite *teststr(abts_suite *suite)
     abts_run_test(suite, string_strtoff, NULL);
     abts_run_test(suite, overflow_strfsize, NULL);
     abts_run_test(suite, string_strfsize, NULL);
+    abts_run_test(suite, string_dtoa, NULL);
+    abts_run_test(suite, string_strtod_fast, NULL);
+    abts_run_test(suite, snprintf_shortest, NULL);
     abts_run_test(suite, string_cpystrn, NULL);
     abts_run_test(suite, snprintf_overflow, NULL);
     abts_run_test(suite, skip_prefix, NULL);
@@ -0,0 +1,176 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testutil.h"
+
+#include "apr.h"
+#include "apr_general.h"
+#include "apr_strbuf.h"
+#include "apr_strings.h"
+#define APR_WANT_STDIO
+#define APR_WANT_STRFUNC
+#include "apr_want.h"
+
+static void test_pool(abts_case *tc, void *data)
+{
+    apr_strbuf_t *sb = apr_strbuf_make(p, 4);
+    apr_size_t len;
+    char *str;
+
+    ABTS_SIZE_EQUAL(tc, 0, apr_strbuf_length(sb));
+    ABTS_STR_EQUAL(tc, "", apr_strbuf_pflatten(sb, &len, p));
+    ABTS_SIZE_EQUAL(tc, 0, len);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_puts(sb, "Hello"));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_putc(sb, ','));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_putstrs(sb, " ", "world",
+                                                       NULL));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_printf(sb, "! %d+%s=%05d",
+                                                      1, "one", 2));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_write(sb, "\0x", 2));
+
+    str = apr_strbuf_pflatten(sb, &len, p);
+    ABTS_SIZE_EQUAL(tc, 27, len);
+    ABTS_SIZE_EQUAL(tc, 27, apr_strbuf_length(sb));
+    ABTS_STR_EQUAL(tc, "Hello, world! 1+one=00002", str);
+    ABTS_INT_EQUAL(tc, 'x', str[26]);
+    ABTS_INT_EQUAL(tc, 0, str[27]);
+
+    apr_strbuf_clear(sb);
+    ABTS_SIZE_EQUAL(tc, 0, apr_strbuf_length(sb));
+    apr_strbuf_puts(sb, "again");
+    ABTS_STR_EQUAL(tc, "again", apr_strbuf_pflatten(sb, NULL, p));
+}
+
+/* Long strings of all kinds of pieces, in chunks of growing sizes then
+ * reused after a clear, checked against the same string built at once.
+ */
+static void test_build(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_strbuf_t *sb;
+    char *expected = apr_palloc(p, 100000), *e;
+    apr_size_t len;
+    int round, i, mode;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_allocator_create(&allocator));
+
+    for (mode = 0; mode < 2; mode++) {
+        if (mode) {
+            sb = apr_strbuf_create(allocator, 0);
+            ABTS_PTR_NOTNULL(tc, sb);
+        }
+        else {
+            sb = apr_strbuf_make(p, 0);
+        }
+        for (round = 0; round < 2; round++) {
+            apr_strbuf_clear(sb);
+            e = expected;
+            for (i = 0; e - expected < 90000; i++) {
+                switch (i % 4) {
+                case 0:
+                    apr_strbuf_putc(sb, 'a' + i % 26);
+                    *e++ = 'a' + i % 26;
+                    break;
+                case 1:
+                    apr_strbuf_printf(sb, "[%d:%s]", i, "item");
+                    e += sprintf(e, "[%d:%s]", i, "item");
+                    break;
+                case 2:
+                    len = i % 1000;
+                    memset(e, '-', len);
+                    apr_strbuf_write(sb, e, len);
+                    e += len;
+                    break;
+                default:
+                    apr_strbuf_puts(sb, "xyz");
+                    memcpy(e, "xyz", 3);
+                    e += 3;
+                }
+            }
+            *e = '\0';
+            ABTS_SIZE_EQUAL(tc, e - expected, apr_strbuf_length(sb));
+            ABTS_STR_EQUAL(tc, expected, apr_strbuf_pflatten(sb, &len, p));
+            ABTS_SIZE_EQUAL(tc, e - expected, len);
+        }
+        apr_strbuf_destroy(sb);
+    }
+
+    apr_allocator_destroy(allocator);
+}
+
+static void test_views(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_strbuf_t *sb = apr_strbuf_make(p, 8);
+    struct iovec vec[8];
+    char buf[64];
+    apr_size_t len, n;
+    int nvec, i;
+
+    nvec = 8;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_to_iovec(sb, vec, &nvec));
+    ABTS_INT_EQUAL(tc, 0, nvec);
+
+    /* chunks of 8, 16 and 32 bytes */
+    apr_strbuf_puts(sb, "01234567");
+    apr_strbuf_puts(sb, "89abcdefghijklmn");
+    apr_strbuf_puts(sb, "opqrstuvwxyz");
+    nvec = 8;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_to_iovec(sb, vec, &nvec));
+    ABTS_INT_EQUAL(tc, 3, nvec);
+    for (i = 0, n = 0; i < nvec; i++) {
+        memcpy(buf + n, vec[i].iov_base, vec[i].iov_len);
+        n += vec[i].iov_len;
+    }
+    ABTS_SIZE_EQUAL(tc, 36, n);
+    ABTS_ASSERT(tc, "iovec content",
+                !memcmp(buf, "0123456789abcdefghijklmnopqrstuvwxyz", 36));
+
+    nvec = 2;
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, apr_strbuf_to_iovec(sb, vec, &nvec));
+    ABTS_INT_EQUAL(tc, 2, nvec);
+
+    apr_strbuf_to_brigade(sb, bb);
+    len = sizeof(buf);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_brigade_flatten(bb, buf, &len));
+    ABTS_SIZE_EQUAL(tc, 36, len);
+    ABTS_ASSERT(tc, "brigade content",
+                !memcmp(buf, "0123456789abcdefghijklmnopqrstuvwxyz", 36));
+    apr_brigade_destroy(bb);
+
+    /* the emptied chunks after a clear are not seen */
+    apr_strbuf_clear(sb);
+    apr_strbuf_puts(sb, "abc");
+    nvec = 8;
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_strbuf_to_iovec(sb, vec, &nvec));
+    ABTS_INT_EQUAL(tc, 1, nvec);
+    ABTS_SIZE_EQUAL(tc, 3, vec[0].iov_len);
+
+    apr_bucket_alloc_destroy(ba);
+}
+
+abts_suite *teststrbuf(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite);
+
+    abts_run_test(suite, test_pool, NULL);
+    abts_run_test(suite, test_build, NULL);
+    abts_run_test(suite, test_views, NULL);
+
+    return suite;
+}
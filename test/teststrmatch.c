@@ -19,6 +19,9 @@
 #include "apr.h"
 #include "apr_general.h"
 #include "apr_strmatch.h"
+#include "apr_cstr.h"
+#include "apr_lib.h"
+#include "apr_strings.h"
 #if APR_HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -81,11 +84,203 @@ static void test_str(abts_case *tc, void *data)
     ABTS_PTR_EQUAL(tc, input6 + 35, match);
 }
 
+struct multi_found {
+    int n;
+    int index[8];
+    apr_size_t at[8];
+    const char *s;
+};
+
+static int multi_collect(void *baton, int index, const char *match)
+{
+    struct multi_found *found = baton;
+
+    if (found->n < 8) {
+        found->index[found->n] = index;
+        found->at[found->n] = match - found->s;
+    }
+    return ++found->n < 100;
+}
+
+static int multi_cmp(int cs, const char *a, const char *b, apr_size_t n)
+{
+    return cs ? strncmp(a, b, n) : apr_cstr_casecmpn(a, b, n);
+}
+
+/* Patterns of all the lengths, short and long, found up to the ends of
+ * their strings, checked against a search of each offset.
+ */
+static void test_lengths(abts_case *tc, void *data)
+{
+    static const apr_size_t lengths[] = { 1, 2, 3, 5, 16, 17, 31, 33, 64,
+                                          65, 100 };
+    apr_size_t n, i, at, len, slen = 200;
+    char *text = apr_palloc(p, slen), *pat;
+    const apr_strmatch_pattern *pattern;
+    const char *expected;
+    unsigned int seed = 7;
+    int cs;
+
+    for (i = 0; i < slen; i++) {
+        seed = seed * 1103515245 + 12345;
+        text[i] = "abAB-"[(seed >> 16) % 5];
+    }
+
+    for (n = 0; n < sizeof(lengths) / sizeof(lengths[0]); n++) {
+        len = lengths[n];
+        for (at = 0; at + len <= slen; at += 1 + at / 4) {
+            for (cs = 0; cs < 2; cs++) {
+                pat = apr_pstrmemdup(p, text + at, len);
+                if (!cs) {
+                    pat[0] = apr_toupper(pat[0]);
+                    pat[len - 1] = apr_tolower(pat[len - 1]);
+                }
+                pattern = apr_strmatch_precompile(p, pat, cs);
+                for (i = 0, expected = NULL; i + len <= slen; i++) {
+                    if (!multi_cmp(cs, text + i, pat, len)) {
+                        expected = text + i;
+                        break;
+                    }
+                }
+                ABTS_PTR_NOTNULL(tc, expected);
+                ABTS_PTR_EQUAL(tc, expected,
+                               apr_strmatch(pattern, text, slen));
+                /* short of the last byte, and in fewer bytes than the pattern */
+                if (expected == text + slen - len) {
+                    ABTS_PTR_EQUAL(tc, NULL,
+                                   apr_strmatch(pattern, text, slen - 1));
+                }
+                ABTS_PTR_EQUAL(tc, NULL,
+                               apr_strmatch(pattern, text + slen - len + 1,
+                                            len - 1));
+            }
+        }
+    }
+}
+
+static void test_multi(abts_case *tc, void *data)
+{
+    static const char *const patterns[] = { "he", "she", "his", "hers" };
+    static const char *const nocase[] = { "HeRs", "XYZ" };
+    static const char *const empty[] = { "a", "" };
+    const apr_strmatch_multi_t *multi;
+    struct multi_found found;
+    const char *s = "ushers", *upper = "USHERS";
+    int index = -1;
+
+    multi = apr_strmatch_multi_precompile(p, patterns, 4, 1);
+    ABTS_PTR_NOTNULL(tc, multi);
+
+    ABTS_PTR_EQUAL(tc, s + 1, apr_strmatch_multi(multi, s, 6, &index));
+    ABTS_INT_EQUAL(tc, 1, index);
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi(multi, s, 3, NULL));
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi(multi, upper, 6, NULL));
+
+    memset(&found, 0, sizeof(found));
+    found.s = s;
+    ABTS_INT_EQUAL(tc, 1, apr_strmatch_multi_scan(multi, s, 6, multi_collect,
+                                                  &found));
+    ABTS_INT_EQUAL(tc, 3, found.n);
+    ABTS_INT_EQUAL(tc, 1, found.index[0]);
+    ABTS_SIZE_EQUAL(tc, 1, found.at[0]);
+    ABTS_INT_EQUAL(tc, 0, found.index[1]);
+    ABTS_SIZE_EQUAL(tc, 2, found.at[1]);
+    ABTS_INT_EQUAL(tc, 3, found.index[2]);
+    ABTS_SIZE_EQUAL(tc, 2, found.at[2]);
+
+    multi = apr_strmatch_multi_precompile(p, nocase, 2, 0);
+    ABTS_PTR_NOTNULL(tc, multi);
+    ABTS_PTR_EQUAL(tc, s + 2, apr_strmatch_multi(multi, s, 6, &index));
+    ABTS_INT_EQUAL(tc, 0, index);
+    ABTS_PTR_EQUAL(tc, upper + 2, apr_strmatch_multi(multi, upper, 6, NULL));
+
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi_precompile(p, empty, 2, 1));
+    multi = apr_strmatch_multi_precompile(p, NULL, 0, 1);
+    ABTS_PTR_NOTNULL(tc, multi);
+    ABTS_PTR_EQUAL(tc, NULL, apr_strmatch_multi(multi, s, 6, NULL));
+}
+
+static int multi_count(void *baton, int index, const char *match)
+{
+    (*(int *)baton)++;
+    return 1;
+}
+
+/* Many random patterns, checked against a search of each of them */
+static void test_multi_random(abts_case *tc, void *data)
+{
+    char *patterns[60], text[3000];
+    const apr_strmatch_multi_t *multi;
+    const char *first = NULL, *match;
+    apr_size_t i, best = 0;
+    int n, m, count = 0, expected = 0, index, cs;
+    unsigned int seed = 3;
+
+    for (n = 0; n < 60; n++) {
+        int len = 1 + n % 6;
+
+        patterns[n] = apr_palloc(p, len + 1);
+        for (i = 0; i < (apr_size_t)len; i++) {
+            seed = seed * 1103515245 + 12345;
+            patterns[n][i] = "abcAB"[(seed >> 16) % (n < 30 ? 3 : 5)];
+        }
+        patterns[n][len] = '\0';
+    }
+    for (i = 0; i < sizeof(text); i++) {
+        seed = seed * 1103515245 + 12345;
+        text[i] = "abcdAB"[(seed >> 16) % 6];
+    }
+
+    for (cs = 0; cs < 2; cs++) {
+        multi = apr_strmatch_multi_precompile(p, (const char *const *)patterns,
+                                              60, cs);
+        ABTS_PTR_NOTNULL(tc, multi);
+
+        count = expected = 0;
+        first = NULL;
+        for (n = 0; n < 60; n++) {
+            apr_size_t len = strlen(patterns[n]);
+
+            /* identical patterns are found under the first index */
+            for (m = 0; m < n; m++) {
+                if (!multi_cmp(cs, patterns[m], patterns[n], len + 1)) {
+                    break;
+                }
+            }
+            if (m < n) {
+                continue;
+            }
+            for (i = 0; i + len <= sizeof(text); i++) {
+                if (!multi_cmp(cs, text + i, patterns[n], len)) {
+                    expected++;
+                    if (!first || i + len < best
+                            || (i + len == best && text + i < first)) {
+                        first = text + i;
+                        best = i + len;
+                    }
+                }
+            }
+        }
+
+        apr_strmatch_multi_scan(multi, text, sizeof(text), multi_count,
+                                &count);
+        ABTS_INT_EQUAL(tc, expected, count);
+        match = apr_strmatch_multi(multi, text, sizeof(text), &index);
+        ABTS_PTR_EQUAL(tc, first, match);
+        ABTS_ASSERT(tc, "first pattern index",
+                    !multi_cmp(cs, match, patterns[index],
+                               strlen(patterns[index])));
+    }
+}
+
 abts_suite *teststrmatch(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_str, NULL);
+    abts_run_test(suite, test_lengths, NULL);
+    abts_run_test(suite, test_multi, NULL);
+    abts_run_test(suite, test_multi_random, NULL);
 
     return suite;
 }
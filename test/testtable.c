@@ -20,6 +20,7 @@
 #include "apr_general.h"
 #include "apr_pools.h"
 #include "apr_tables.h"
+#include "apr_thread_pool.h"
 #if APR_HAVE_STDIO_H
 #include <stdio.h>
 #endif
@@ -42,6 +43,249 @@ static void array_clear(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 0, a1->nelts);
 }
 
+static void array_growth(abts_case *tc, void *data)
+{
+    int flags, i, *v;
+
+    for (flags = 0; flags <= APR_ARRAY_ALLOCATOR; flags += APR_ARRAY_ALLOCATOR) {
+        apr_pool_t *subp;
+        apr_array_header_t *a, *c;
+
+        apr_pool_create(&subp, p);
+        a = apr_array_make_ex(subp, 0, sizeof(int), flags);
+        ABTS_PTR_NOTNULL(tc, a);
+        ABTS_INT_EQUAL(tc, 0, a->nelts);
+
+        apr_array_reserve(a, 1000);
+        ABTS_ASSERT(tc, "reserve capacity", a->nalloc >= 1000);
+        ABTS_INT_EQUAL(tc, 0, a->nelts);
+
+        for (i = 0; i < 500; i++) {
+            APR_ARRAY_PUSH(a, int) = i;
+        }
+        v = apr_array_push_n(a, 2000);
+        ABTS_INT_EQUAL(tc, 2500, a->nelts);
+        ABTS_PTR_EQUAL(tc, (int *)a->elts + 500, v);
+        for (i = 0; i < 2000; i++) {
+            ABTS_INT_EQUAL(tc, 0, v[i]);
+            v[i] = 500 + i;
+        }
+        for (i = 0; i < a->nelts; i++) {
+            ABTS_INT_EQUAL(tc, i, APR_ARRAY_IDX(a, i, int));
+        }
+
+        c = apr_array_copy_hdr(subp, a);
+        a->nelts = 10;
+        apr_array_shrink_to_fit(a);
+        ABTS_ASSERT(tc, "shrink capacity", a->nalloc >= 10);
+        if (a->node) {
+            ABTS_ASSERT(tc, "shrunk", a->nalloc < 2500);
+        }
+        for (i = 0; i < 10; i++) {
+            ABTS_INT_EQUAL(tc, i, APR_ARRAY_IDX(a, i, int));
+        }
+        APR_ARRAY_PUSH(a, int) = 10;
+        ABTS_INT_EQUAL(tc, 10, APR_ARRAY_IDX(a, 10, int));
+
+        /* the header copy still sees the elements */
+        ABTS_INT_EQUAL(tc, 2500, c->nelts);
+        for (i = 0; i < c->nelts; i++) {
+            ABTS_INT_EQUAL(tc, i, APR_ARRAY_IDX(c, i, int));
+        }
+
+        apr_array_cat(a, c);
+        ABTS_INT_EQUAL(tc, 2511, a->nelts);
+        ABTS_INT_EQUAL(tc, 2499, APR_ARRAY_IDX(a, 2510, int));
+
+        apr_pool_destroy(subp);
+    }
+}
+
+/* Sorted elements, with the original position for the stable sorts */
+typedef struct {
+    apr_uint64_t key;
+    int seq;
+    const char *str;
+} sort_elt_t;
+
+#define SORT_ELTS 40000
+
+static apr_uint32_t sort_random(apr_uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static int sort_compare(const void *a, const void *b)
+{
+    const sort_elt_t *x = a, *y = b;
+
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int sort_compare_str(const void *a, const void *b)
+{
+    return strcmp(((const sort_elt_t *)a)->str, ((const sort_elt_t *)b)->str);
+}
+
+/* Random keys among nkeys (zero for sorted, then reversed, keys) */
+static apr_array_header_t *sort_make(apr_pool_t *pool, int n, int nkeys)
+{
+    apr_array_header_t *a = apr_array_make(pool, n, sizeof(sort_elt_t));
+    apr_uint32_t seed = (apr_uint32_t)n + nkeys;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        sort_elt_t *e = apr_array_push(a);
+
+        if (nkeys > 0) {
+            e->key = sort_random(&seed) % nkeys;
+        }
+        else {
+            e->key = nkeys ? n - i : i;
+        }
+        e->key <<= (i % 3) * 20;
+        e->seq = i;
+        e->str = apr_psprintf(pool, "prefix/%" APR_UINT64_T_FMT, e->key);
+    }
+    return a;
+}
+
+/* Sorted, by the strings or the keys, and stably if asked */
+static int sort_check(apr_array_header_t *a, int by_str, int stable)
+{
+    sort_elt_t *e = (sort_elt_t *)a->elts;
+    int i;
+
+    for (i = 1; i < a->nelts; i++) {
+        int c = by_str ? sort_compare_str(&e[i - 1], &e[i])
+                       : sort_compare(&e[i - 1], &e[i]);
+
+        if (c > 0 || (c == 0 && stable && e[i - 1].seq > e[i].seq)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+static const int sort_nkeys[] = { 7, 1000, 1000000, 0, -1, 1 };
+
+static void array_sort(abts_case *tc, void *data)
+{
+    apr_size_t i;
+    int n;
+
+    for (i = 0; i < sizeof(sort_nkeys) / sizeof(sort_nkeys[0]); i++) {
+        for (n = 0; n <= SORT_ELTS; n = n * 10 + 3) {
+            apr_pool_t *subp;
+            apr_array_header_t *a, *b, *c, *d;
+
+            apr_pool_create(&subp, p);
+            a = sort_make(subp, n, sort_nkeys[i]);
+            b = apr_array_copy(subp, a);
+            c = apr_array_copy(subp, a);
+            d = apr_array_copy(subp, a);
+
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                           apr_array_sort(a, sort_compare, 0));
+            ABTS_INT_EQUAL(tc, 0, sort_check(a, 0, 0));
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                           apr_array_sort(b, sort_compare,
+                                          APR_ARRAY_SORT_STABLE));
+            ABTS_INT_EQUAL(tc, 0, sort_check(b, 0, 1));
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                           apr_array_sort_u64(c, APR_OFFSETOF(sort_elt_t,
+                                                              key)));
+            ABTS_INT_EQUAL(tc, 0, sort_check(c, 0, 1));
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                           apr_array_sort_str(d, APR_OFFSETOF(sort_elt_t,
+                                                              str)));
+            ABTS_INT_EQUAL(tc, 0, sort_check(d, 1, 0));
+            apr_pool_destroy(subp);
+        }
+    }
+
+    /* the keys must be within the elements */
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_array_sort_u64(sort_make(p, 2, 1),
+                                      sizeof(sort_elt_t) - 4));
+    ABTS_INT_EQUAL(tc, APR_EINVAL,
+                   apr_array_sort_str(sort_make(p, 2, 1),
+                                      sizeof(sort_elt_t)));
+}
+
+static int sort_compare_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+static void array_bsearch(abts_case *tc, void *data)
+{
+    apr_array_header_t *a = apr_array_make(p, 0, sizeof(int));
+    int i, key, index;
+
+    key = 1;
+    ABTS_PTR_EQUAL(tc, NULL, apr_array_bsearch(a, &key, sort_compare_int,
+                                               &index));
+    ABTS_INT_EQUAL(tc, 0, index);
+
+    /* even numbers, twice each */
+    for (i = 0; i < 200; i++) {
+        APR_ARRAY_PUSH(a, int) = i / 2 * 2;
+    }
+    for (key = -1; key <= 200; key++) {
+        int *found = apr_array_bsearch(a, &key, sort_compare_int, &index);
+
+        if (key % 2 == 0 && key < 200) {
+            ABTS_PTR_EQUAL(tc, &APR_ARRAY_IDX(a, key, int), found);
+            ABTS_INT_EQUAL(tc, key, index);
+        }
+        else {
+            ABTS_PTR_EQUAL(tc, NULL, found);
+            ABTS_INT_EQUAL(tc, key < 0 ? 0 : key < 200 ? key + 1 : 200,
+                           index);
+        }
+    }
+    key = 42;
+    ABTS_PTR_NOTNULL(tc, apr_array_bsearch(a, &key, sort_compare_int, NULL));
+}
+
+#if APR_HAS_THREADS
+static void array_sort_parallel(abts_case *tc, void *data)
+{
+    apr_thread_pool_t *tp;
+    apr_size_t i;
+    int n;
+
+    APR_ASSERT_SUCCESS(tc, "create thread pool",
+                       apr_thread_pool_create(&tp, 0, 3, p));
+
+    for (i = 0; i < sizeof(sort_nkeys) / sizeof(sort_nkeys[0]); i++) {
+        for (n = 10; n <= SORT_ELTS * 4; n *= 20) {
+            apr_pool_t *subp;
+            apr_array_header_t *a, *b;
+
+            apr_pool_create(&subp, p);
+            a = sort_make(subp, n, sort_nkeys[i]);
+            b = apr_array_copy(subp, a);
+
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                           apr_array_sort_parallel(a, sort_compare, 0,
+                                                   tp, subp));
+            ABTS_INT_EQUAL(tc, 0, sort_check(a, 0, 0));
+            ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                           apr_array_sort_parallel(b, sort_compare,
+                                                   APR_ARRAY_SORT_STABLE,
+                                                   tp, subp));
+            ABTS_INT_EQUAL(tc, 0, sort_check(b, 0, 1));
+            apr_pool_destroy(subp);
+        }
+    }
+
+    apr_thread_pool_destroy(tp);
+}
+#endif
+
 static void table_make(abts_case *tc, void *data)
 {
     t1 = apr_table_make(p, 5);
@@ -222,11 +466,237 @@ static void table_overlap3(abts_case *tc, void *data)
 
 }
 
+#define MANY_KEYS 200
+
+static int count_do(void *rec, const char *key, const char *value)
+{
+    (*(int *)rec)++;
+    return 1;
+}
+
+static void table_many(abts_case *tc, void *data)
+{
+    const apr_array_header_t *arr;
+    const apr_table_entry_t *elts;
+    apr_table_t *t, *copy;
+    char key[32];
+    int i, n;
+
+    t = apr_table_make(p, 2);
+    for (i = 0; i < MANY_KEYS; i++) {
+        apr_snprintf(key, sizeof(key), "X-Header-%d", i);
+        apr_table_add(t, key, apr_itoa(p, i));
+    }
+    ABTS_INT_EQUAL(tc, MANY_KEYS, apr_table_elts(t)->nelts);
+
+    /* case insensitive lookups */
+    for (i = 0; i < MANY_KEYS; i++) {
+        apr_snprintf(key, sizeof(key), "x-HEADER-%d", i);
+        ABTS_STR_EQUAL(tc, apr_itoa(p, i), apr_table_get(t, key));
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Header-1000"));
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "Y"));
+
+    /* duplicates: get returns the first, set replaces them all */
+    apr_table_add(t, "x-header-5", "dup");
+    ABTS_STR_EQUAL(tc, "5", apr_table_get(t, "X-Header-5"));
+    n = 0;
+    apr_table_do(count_do, &n, t, "X-Header-5", NULL);
+    ABTS_INT_EQUAL(tc, 2, n);
+    apr_table_set(t, "X-HEADER-5", "five");
+    ABTS_STR_EQUAL(tc, "five", apr_table_get(t, "X-Header-5"));
+    ABTS_INT_EQUAL(tc, MANY_KEYS, apr_table_elts(t)->nelts);
+
+    apr_table_merge(t, "x-header-7", "seven");
+    ABTS_STR_EQUAL(tc, "7, seven", apr_table_get(t, "X-Header-7"));
+
+    /* unset shifts the entries, which must still be found */
+    apr_table_unset(t, "X-Header-0");
+    apr_table_unset(t, "X-Header-100");
+    for (i = 1; i < MANY_KEYS; i++) {
+        apr_snprintf(key, sizeof(key), "X-Header-%d", i);
+        if (i == 100) {
+            ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, key));
+        }
+        else {
+            ABTS_PTR_NOTNULL(tc, apr_table_get(t, key));
+        }
+    }
+
+    /* the insertion order is kept */
+    arr = apr_table_elts(t);
+    elts = (const apr_table_entry_t *)arr->elts;
+    ABTS_INT_EQUAL(tc, MANY_KEYS - 2, arr->nelts);
+    ABTS_STR_EQUAL(tc, "X-Header-1", elts[0].key);
+    ABTS_STR_EQUAL(tc, "X-Header-101", elts[99].key);
+    ABTS_STR_EQUAL(tc, "X-Header-199", elts[arr->nelts - 1].key);
+
+    copy = apr_table_copy(p, t);
+    ABTS_STR_EQUAL(tc, "150", apr_table_get(copy, "x-header-150"));
+    apr_table_setn(copy, "new", "value");
+    ABTS_STR_EQUAL(tc, "value", apr_table_get(copy, "NEW"));
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "NEW"));
+
+    apr_table_overlap(copy, t, APR_OVERLAP_TABLES_SET);
+    ABTS_INT_EQUAL(tc, MANY_KEYS - 1, apr_table_elts(copy)->nelts);
+    ABTS_STR_EQUAL(tc, "150", apr_table_get(copy, "x-header-150"));
+
+    apr_table_clear(t);
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Header-1"));
+    apr_table_set(t, "X-Header-1", "one");
+    ABTS_STR_EQUAL(tc, "one", apr_table_get(t, "X-Header-1"));
+}
+
+static void table_bulk(abts_case *tc, void *data)
+{
+    apr_table_pair_t pairs[MANY_KEYS];
+    apr_table_t *t, *copy;
+    char key[32];
+    int i, n;
+
+    for (i = 0; i < MANY_KEYS; i++) {
+        apr_snprintf(key, sizeof(key), "Bulk-%d", i % (MANY_KEYS / 2));
+        pairs[i].key = apr_pstrdup(p, key);
+        pairs[i].val = apr_itoa(p, i);
+    }
+
+    t = apr_table_make(p, 1);
+    apr_table_addn_bulk(t, pairs, 10, 0);
+    ABTS_INT_EQUAL(tc, 10, apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "3", apr_table_get(t, "bulk-3"));
+    apr_table_addn_bulk(t, pairs + 10, MANY_KEYS - 10, 0);
+    ABTS_INT_EQUAL(tc, MANY_KEYS, apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "3", apr_table_get(t, "bulk-3"));
+    ABTS_STR_EQUAL(tc, "99", apr_table_get(t, "BULK-99"));
+    n = 0;
+    apr_table_do(count_do, &n, t, "Bulk-42", NULL);
+    ABTS_INT_EQUAL(tc, 2, n);
+
+    /* lazily indexed, mixed with the other functions */
+    t = apr_table_make(p, 1);
+    apr_table_addn(t, "first", "1");
+    apr_table_addn_bulk(t, pairs, MANY_KEYS / 2, APR_TABLE_BULK_LAZY);
+    apr_table_addn_bulk(t, pairs + MANY_KEYS / 2, MANY_KEYS / 2,
+                        APR_TABLE_BULK_LAZY);
+    ABTS_INT_EQUAL(tc, MANY_KEYS + 1, apr_table_elts(t)->nelts);
+    copy = apr_table_copy(p, t);
+    ABTS_STR_EQUAL(tc, "1", apr_table_get(t, "First"));
+    ABTS_STR_EQUAL(tc, "7", apr_table_get(t, "Bulk-7"));
+    ABTS_STR_EQUAL(tc, "7", apr_table_get(copy, "Bulk-7"));
+
+    apr_table_addn_bulk(t, pairs, 1, APR_TABLE_BULK_LAZY);
+    apr_table_unset(t, "bulk-0");
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "Bulk-0"));
+    ABTS_INT_EQUAL(tc, MANY_KEYS - 1, apr_table_elts(t)->nelts);
+
+    apr_table_addn_bulk(t, pairs, 1, APR_TABLE_BULK_LAZY);
+    apr_table_setn(t, "bulk-1", "one");
+    ABTS_STR_EQUAL(tc, "one", apr_table_get(t, "Bulk-1"));
+    ABTS_STR_EQUAL(tc, "0", apr_table_get(t, "Bulk-0"));
+
+    apr_table_addn_bulk(copy, pairs, 1, APR_TABLE_BULK_LAZY);
+    apr_table_overlap(t, copy, APR_OVERLAP_TABLES_SET);
+    ABTS_INT_EQUAL(tc, MANY_KEYS / 2 + 1, apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "0", apr_table_get(t, "Bulk-0"));
+}
+
+static void table_overlap_many(abts_case *tc, void *data)
+{
+    const apr_array_header_t *arr;
+    const apr_table_entry_t *elts;
+    apr_table_t *t1, *t2, *t;
+    char key[32];
+    int i;
+
+    t1 = apr_table_make(p, 1);
+    t2 = apr_table_make(p, 1);
+    for (i = 0; i < MANY_KEYS; i++) {
+        apr_snprintf(key, sizeof(key), "Env-%d", i);
+        apr_table_addn(t1, apr_pstrdup(p, key), "a");
+        if (i % 3 == 0) {
+            apr_table_addn(t2, apr_pstrdup(p, key), "b");
+            apr_table_addn(t2, apr_pstrdup(p, key), "c");
+        }
+    }
+    apr_table_addn(t2, "Other", "d");
+
+    t = apr_table_copy(p, t1);
+    apr_table_overlap(t, t2, APR_OVERLAP_TABLES_MERGE);
+    arr = apr_table_elts(t);
+    elts = (const apr_table_entry_t *)arr->elts;
+    ABTS_INT_EQUAL(tc, MANY_KEYS + 1, arr->nelts);
+    ABTS_STR_EQUAL(tc, "Env-0", elts[0].key);
+    ABTS_STR_EQUAL(tc, "a, b, c", elts[0].val);
+    ABTS_STR_EQUAL(tc, "Env-1", elts[1].key);
+    ABTS_STR_EQUAL(tc, "a", elts[1].val);
+    ABTS_STR_EQUAL(tc, "Other", elts[MANY_KEYS].key);
+    ABTS_STR_EQUAL(tc, "a, b, c", apr_table_get(t, "env-99"));
+
+    t = apr_table_copy(p, t1);
+    apr_table_overlap(t, t2, APR_OVERLAP_TABLES_SET);
+    ABTS_INT_EQUAL(tc, MANY_KEYS + 1, apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "c", apr_table_get(t, "env-99"));
+    ABTS_STR_EQUAL(tc, "a", apr_table_get(t, "env-98"));
+    ABTS_STR_EQUAL(tc, "d", apr_table_get(t, "other"));
+
+    apr_table_compress(t2, APR_OVERLAP_TABLES_SET);
+    ABTS_INT_EQUAL(tc, MANY_KEYS / 3 + 2, apr_table_elts(t2)->nelts);
+    ABTS_STR_EQUAL(tc, "c", apr_table_get(t2, "env-0"));
+}
+
+static void table_snapshot(abts_case *tc, void *data)
+{
+    apr_table_t *t, *snap, *snap2;
+    char key[32];
+    int i;
+
+    t = apr_table_make(p, 2);
+    for (i = 0; i < MANY_KEYS; i++) {
+        apr_snprintf(key, sizeof(key), "Snap-%d", i);
+        apr_table_add(t, key, apr_itoa(p, i));
+    }
+
+    snap = apr_table_snapshot(p, t);
+    ABTS_PTR_EQUAL(tc, apr_table_elts(t)->elts, apr_table_elts(snap)->elts);
+    ABTS_STR_EQUAL(tc, "150", apr_table_get(snap, "snap-150"));
+
+    /* modifying the table leaves the snapshot alone, and vice versa */
+    apr_table_set(t, "Snap-1", "one");
+    apr_table_unset(t, "Snap-2");
+    ABTS_STR_EQUAL(tc, "one", apr_table_get(t, "snap-1"));
+    ABTS_STR_EQUAL(tc, "1", apr_table_get(snap, "snap-1"));
+    ABTS_STR_EQUAL(tc, "2", apr_table_get(snap, "snap-2"));
+    ABTS_INT_EQUAL(tc, MANY_KEYS, apr_table_elts(snap)->nelts);
+
+    snap2 = apr_table_snapshot(p, snap);
+    apr_table_addn(snap, "New", "value");
+    apr_table_merge(snap, "Snap-3", "three");
+    ABTS_STR_EQUAL(tc, "value", apr_table_get(snap, "new"));
+    ABTS_STR_EQUAL(tc, "3, three", apr_table_get(snap, "snap-3"));
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(snap2, "new"));
+    ABTS_STR_EQUAL(tc, "3", apr_table_get(snap2, "snap-3"));
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "new"));
+    ABTS_STR_EQUAL(tc, "3", apr_table_get(t, "snap-3"));
+
+    apr_table_clear(snap2);
+    ABTS_INT_EQUAL(tc, 0, apr_table_elts(snap2)->nelts);
+    ABTS_INT_EQUAL(tc, MANY_KEYS + 1, apr_table_elts(snap)->nelts);
+    apr_table_setn(snap2, "Other", "x");
+    ABTS_STR_EQUAL(tc, "x", apr_table_get(snap2, "other"));
+    ABTS_STR_EQUAL(tc, "0", apr_table_get(snap, "snap-0"));
+}
+
 abts_suite *testtable(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, array_clear, NULL);
+    abts_run_test(suite, array_growth, NULL);
+    abts_run_test(suite, array_sort, NULL);
+    abts_run_test(suite, array_bsearch, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, array_sort_parallel, NULL);
+#endif
     abts_run_test(suite, table_make, NULL);
     abts_run_test(suite, table_get, NULL);
     abts_run_test(suite, table_getm, NULL);
@@ -239,6 +709,10 @@ abts_suite *testtable(abts_suite *suite)
     abts_run_test(suite, table_overlap, NULL);
     abts_run_test(suite, table_overlap2, NULL);
     abts_run_test(suite, table_overlap3, NULL);
+    abts_run_test(suite, table_many, NULL);
+    abts_run_test(suite, table_bulk, NULL);
+    abts_run_test(suite, table_overlap_many, NULL);
+    abts_run_test(suite, table_snapshot, NULL);
 
     return suite;
 }
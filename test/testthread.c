@@ -18,6 +18,7 @@
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_time.h"
+#include "apr_atomic.h"
 #include "testutil.h"
 
 #if APR_HAS_THREADS
@@ -107,6 +108,226 @@ static void check_thread_once(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 1, value);
 }
 
+static void * APR_THREAD_FUNC thread_func_noop(apr_thread_t *thd, void *data)
+{
+    return NULL;
+}
+
+static void check_thread_attrs(abts_case *tc, void *data)
+{
+    apr_threadattr_t *attr;
+    apr_thread_t *thd;
+    apr_status_t rv, retval;
+    int cpu = -1;
+
+    rv = apr_thread_name_set("a-rather-long-thread-name", NULL, p);
+    if (rv != APR_ENOTIMPL) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    rv = apr_threadattr_create(&attr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_threadattr_affinity_set(attr, &cpu, 1);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Thread affinity");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    cpu = 0;
+    rv = apr_threadattr_affinity_set(attr, &cpu, 1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_create(&thd, attr, thread_func_noop, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static apr_uint32_t thread_cleanups;
+
+static apr_status_t thread_cleanup(void *data)
+{
+    apr_atomic_inc32(&thread_cleanups);
+    return APR_SUCCESS;
+}
+
+static void * APR_THREAD_FUNC thread_func_pool(apr_thread_t *thd, void *data)
+{
+    *(apr_pool_t **)data = apr_thread_pool_get(thd);
+    apr_thread_data_set(data, "thread_cleanup", thread_cleanup, thd);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC thread_func_locked(apr_thread_t *thd,
+                                                 void *data)
+{
+    apr_thread_mutex_lock(thread_lock);
+    apr_thread_mutex_unlock(thread_lock);
+    apr_atomic_set32(data, 1);
+    return NULL;
+}
+
+static void check_thread_cache(abts_case *tc, void *data)
+{
+    apr_pool_t *sp, *tp1 = NULL, *tp2 = NULL;
+    apr_threadattr_t *attr;
+    apr_thread_t *thd;
+    apr_status_t rv, retval;
+    apr_uint32_t done = 0;
+
+    apr_pool_create(&sp, p);
+    rv = apr_threadattr_create(&attr, sp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_threadattr_cache_set(attr, 1);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Thread cache");
+        apr_pool_destroy(sp);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the second thread runs with the (cleared) pool of the first */
+    rv = apr_thread_create(&thd, attr, thread_func_pool, &tp1, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&thread_cleanups));
+
+    rv = apr_thread_create(&thd, attr, thread_func_pool, &tp2, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_join(&retval, thd);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&thread_cleanups));
+    ABTS_PTR_NOTNULL(tc, tp1);
+    ABTS_PTR_EQUAL(tc, tp1, tp2);
+
+    /* a detached thread may outlive its threadattr */
+    rv = apr_threadattr_detach_set(attr, 1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_mutex_lock(thread_lock);
+    rv = apr_thread_create(&thd, attr, thread_func_locked, &done, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_pool_destroy(sp);
+    apr_thread_mutex_unlock(thread_lock);
+    while (!apr_atomic_read32(&done)) {
+        apr_sleep(apr_time_from_msec(1));
+    }
+}
+
+static apr_uint32_t threadkey_dests;
+
+static void threadkey_dest(void *value)
+{
+    apr_atomic_add32(&threadkey_dests, *(int *)value);
+}
+
+static void * APR_THREAD_FUNC thread_func_key(apr_thread_t *thd, void *data)
+{
+    apr_threadkey_t *key = data;
+    static int one = 1;
+    void *value;
+
+    apr_threadkey_private_get(&value, key);
+    if (value) {
+        return NULL;
+    }
+    apr_threadkey_private_set(&one, key);
+    apr_threadkey_private_get(&value, key);
+
+    return value;
+}
+
+static void check_threadkey(abts_case *tc, void *data)
+{
+    apr_threadkey_t *key, *key2;
+    apr_thread_t *thd[4];
+    apr_status_t rv, retval;
+    void *value;
+    int i, two = 2;
+
+    rv = apr_threadkey_private_create(&key, threadkey_dest, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_threadkey_private_set(&two, key);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < 4; i++) {
+        rv = apr_thread_create(&thd[i], NULL, thread_func_key, key, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < 4; i++) {
+        rv = apr_thread_join(&retval, thd[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    /* each thread saw its own value, and destroyed it on exit */
+    ABTS_INT_EQUAL(tc, 4, apr_atomic_read32(&threadkey_dests));
+    rv = apr_threadkey_private_get(&value, key);
+    ABTS_PTR_EQUAL(tc, &two, value);
+
+    rv = apr_threadkey_private_delete(key);
+    if (rv == APR_ENOTIMPL) {
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* a new key starts empty, whatever the slot of the deleted one */
+    rv = apr_threadkey_private_create(&key2, NULL, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_threadkey_private_get(&value, key2);
+    ABTS_PTR_EQUAL(tc, NULL, value);
+    apr_threadkey_private_delete(key2);
+}
+
+#define NUM_KEYS 12
+
+static apr_uint32_t threadkeys_dests;
+static apr_threadkey_t *threadkeys[NUM_KEYS];
+
+static void threadkeys_dest(void *value)
+{
+    apr_atomic_add32(&threadkeys_dests, *(int *)value);
+}
+
+static void * APR_THREAD_FUNC thread_func_keys(apr_thread_t *thd, void *data)
+{
+    static int values[NUM_KEYS];
+    int i;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        values[i] = i + 1;
+        apr_threadkey_private_set(&values[i], threadkeys[i]);
+    }
+    return NULL;
+}
+
+static void check_threadkeys(abts_case *tc, void *data)
+{
+    apr_thread_t *thd[2];
+    apr_status_t rv, retval;
+    int i;
+
+    /* more keys than fit in a byte of slots, each with its destructor */
+    for (i = 0; i < NUM_KEYS; i++) {
+        rv = apr_threadkey_private_create(&threadkeys[i], threadkeys_dest, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < 2; i++) {
+        rv = apr_thread_create(&thd[i], NULL, thread_func_keys, NULL, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < 2; i++) {
+        rv = apr_thread_join(&retval, thd[i]);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    /* every value destroyed once per thread: 2 * (1 + ... + 12) */
+    ABTS_INT_EQUAL(tc, NUM_KEYS * (NUM_KEYS + 1),
+                   apr_atomic_read32(&threadkeys_dests));
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        apr_threadkey_private_delete(threadkeys[i]);
+    }
+}
+
 #else
 
 static void threads_not_impl(abts_case *tc, void *data)
@@ -128,6 +349,10 @@ abts_suite *testthread(abts_suite *suite)
     abts_run_test(suite, join_threads, NULL);
     abts_run_test(suite, check_locks, NULL);
     abts_run_test(suite, check_thread_once, NULL);
+    abts_run_test(suite, check_thread_attrs, NULL);
+    abts_run_test(suite, check_thread_cache, NULL);
+    abts_run_test(suite, check_threadkey, NULL);
+    abts_run_test(suite, check_threadkeys, NULL);
 #endif
 
     return suite;
@@ -0,0 +1,527 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_thread_pool.h"
+#include "apr_atomic.h"
+#include "apr_time.h"
+#include "apr_strings.h"
+#include "abts.h"
+#include "testutil.h"
+
+#if APR_HAS_THREADS
+
+#define SPAWN_DEPTH 10
+#define SPAWN_TASKS ((1 << (SPAWN_DEPTH + 1)) - 1)
+#define OWNED_TASKS 100
+
+static apr_thread_pool_t *thrp;
+static volatile apr_uint32_t tasks_done;
+static volatile apr_uint32_t owned_done;
+static volatile apr_uint32_t owned_pushed;
+static int owner_tag;
+
+/* Wait for the counter to reach the value, for up to 10s */
+static apr_uint32_t wait_count(volatile apr_uint32_t *count, apr_uint32_t n)
+{
+    int i;
+
+    for (i = 0; i < 10000 && apr_atomic_read32(count) < n; i++) {
+        apr_sleep(apr_time_from_msec(1));
+    }
+    return apr_atomic_read32(count);
+}
+
+/* Each task spawns two children until the depth is reached */
+static void * APR_THREAD_FUNC spawn_task(apr_thread_t *thd, void *data)
+{
+    apr_size_t depth = (apr_size_t)data;
+
+    if (depth) {
+        apr_thread_pool_push(thrp, spawn_task, (void *)(depth - 1),
+                             APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+        apr_thread_pool_top(thrp, spawn_task, (void *)(depth - 1),
+                            APR_THREAD_TASK_PRIORITY_HIGH, NULL);
+    }
+    apr_atomic_inc32(&tasks_done);
+
+    return NULL;
+}
+
+static apr_thread_pool_attr_t *make_attr(apr_uint32_t flags)
+{
+    apr_thread_pool_attr_t *attr;
+
+    apr_thread_pool_attr_create(&attr, p);
+    apr_thread_pool_attr_flags_set(attr, flags);
+    return attr;
+}
+
+static void spawn_tasks(abts_case *tc, apr_uint32_t flags)
+{
+    apr_status_t rv;
+
+    tasks_done = 0;
+
+    rv = apr_thread_pool_create_ex(&thrp, 2, 4, make_attr(flags), p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Work stealing thread pool");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_pool_push(thrp, spawn_task, (void *)SPAWN_DEPTH,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    ABTS_INT_EQUAL(tc, SPAWN_TASKS, wait_count(&tasks_done, SPAWN_TASKS));
+    ABTS_INT_EQUAL(tc, SPAWN_TASKS, apr_thread_pool_tasks_run_count(thrp));
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_tasks_count(thrp));
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_threadpool_spawn(abts_case *tc, void *data)
+{
+    spawn_tasks(tc, 0);
+}
+
+static void test_threadpool_ws_spawn(abts_case *tc, void *data)
+{
+    spawn_tasks(tc, APR_THREAD_POOL_WORK_STEALING);
+}
+
+static void * APR_THREAD_FUNC owned_task(apr_thread_t *thd, void *data)
+{
+    apr_sleep(apr_time_from_msec(1));
+    apr_atomic_inc32(&owned_done);
+    return NULL;
+}
+
+/* Push tasks from a worker, hence to its own queue with work stealing */
+static void * APR_THREAD_FUNC owner_task(apr_thread_t *thd, void *data)
+{
+    int i;
+
+    for (i = 0; i < OWNED_TASKS; i++) {
+        apr_thread_pool_push(thrp, owned_task, NULL,
+                             APR_THREAD_TASK_PRIORITY_NORMAL, &owner_tag);
+    }
+    apr_atomic_set32(&owned_pushed, 1);
+
+    return NULL;
+}
+
+static void test_threadpool_ws_cancel(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_uint32_t done;
+
+    owned_done = 0;
+    owned_pushed = 0;
+
+    rv = apr_thread_pool_create_ex(&thrp, 2, 2,
+                                   make_attr(APR_THREAD_POOL_WORK_STEALING),
+                                   p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Work stealing thread pool");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_pool_push(thrp, owner_task, NULL,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, wait_count(&owned_pushed, 1));
+
+    rv = apr_thread_pool_tasks_cancel(thrp, &owner_tag);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_tasks_count(thrp));
+
+    /* Nothing runs after cancellation */
+    done = apr_atomic_read32(&owned_done);
+    ABTS_TRUE(tc, done < OWNED_TASKS);
+    apr_sleep(apr_time_from_msec(20));
+    ABTS_INT_EQUAL(tc, done, apr_atomic_read32(&owned_done));
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+#define SCHED_TASKS 1000
+/* Tasks are due by groups of 4 every 2ms */
+#define SCHED_DELAY(i) (apr_time_from_msec(100) + \
+                        apr_time_from_msec((SCHED_TASKS - (i)) / 4 * 2))
+
+static apr_size_t sched_order[SCHED_TASKS];
+static volatile apr_uint32_t sched_done;
+
+static void * APR_THREAD_FUNC sched_task(apr_thread_t *thd, void *data)
+{
+    sched_order[apr_atomic_inc32(&sched_done)] = (apr_size_t)data;
+    return NULL;
+}
+
+static void test_threadpool_schedule(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_size_t i;
+    apr_uint32_t n;
+
+    sched_done = 0;
+
+    /* A single thread so that the tasks run in order */
+    rv = apr_thread_pool_create(&thrp, 0, 1, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* Schedule the tasks in reverse order of their due time, with half of
+     * them owned and cancelled before they run.
+     */
+    for (i = 0; i < SCHED_TASKS; i++) {
+        rv = apr_thread_pool_schedule(thrp, sched_task, (void *)i,
+                                      SCHED_DELAY(i),
+                                      i % 2 ? &owner_tag : NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    ABTS_INT_EQUAL(tc, SCHED_TASKS,
+                   apr_thread_pool_scheduled_tasks_count(thrp));
+
+    rv = apr_thread_pool_tasks_cancel(thrp, &owner_tag);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, SCHED_TASKS / 2,
+                   apr_thread_pool_scheduled_tasks_count(thrp));
+
+    n = wait_count(&sched_done, SCHED_TASKS / 2);
+    ABTS_INT_EQUAL(tc, SCHED_TASKS / 2, n);
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_scheduled_tasks_count(thrp));
+
+    /* By due time, then by scheduling order */
+    for (i = 0; i < n; i++) {
+        ABTS_INT_EQUAL(tc, 0, sched_order[i] % 2);
+        if (i) {
+            apr_size_t prev = sched_order[i - 1], cur = sched_order[i];
+            ABTS_TRUE(tc, SCHED_DELAY(cur) > SCHED_DELAY(prev)
+                          || (SCHED_DELAY(cur) == SCHED_DELAY(prev)
+                              && cur > prev));
+        }
+    }
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+#define INIT_THREADS 3
+
+static volatile apr_uint32_t init_mask;
+
+static void worker_init(apr_thread_t *thd, apr_size_t index, void *data)
+{
+    abts_case *tc = data;
+
+    ABTS_TRUE(tc, index < INIT_THREADS);
+    apr_atomic_add32(&init_mask, 1 << index);
+}
+
+static void test_threadpool_attr(abts_case *tc, void *data)
+{
+    apr_thread_pool_attr_t *attr;
+    apr_threadattr_t *thdattr;
+    apr_status_t rv;
+    int cpu = 0;
+
+    init_mask = 0;
+
+    rv = apr_thread_pool_attr_create(&attr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_threadattr_create(&thdattr, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_threadattr_stacksize_set(thdattr, 256 * 1024);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_thread_pool_attr_threadattr_set(attr, thdattr);
+    apr_thread_pool_attr_worker_init_set(attr, worker_init, tc);
+    apr_thread_pool_attr_name_set(attr, "testpool");
+
+    rv = apr_thread_pool_attr_affinity_set(attr, 42, NULL, 1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_thread_pool_attr_affinity_set(attr,
+                                           APR_THREAD_POOL_AFFINITY_EXPLICIT,
+                                           NULL, 1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_thread_pool_attr_affinity_set(attr,
+                                           APR_THREAD_POOL_AFFINITY_COMPACT,
+                                           &cpu, 1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_thread_pool_create_ex(&thrp, INIT_THREADS, INIT_THREADS, attr, p);
+    if (rv == APR_ENOTIMPL) {
+        /* No affinity here, try without */
+        apr_thread_pool_attr_affinity_set(attr, APR_THREAD_POOL_AFFINITY_NONE,
+                                          NULL, 0);
+        rv = apr_thread_pool_create_ex(&thrp, INIT_THREADS, INIT_THREADS,
+                                       attr, p);
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    ABTS_INT_EQUAL(tc, (1 << INIT_THREADS) - 1,
+                   wait_count(&init_mask, (1 << INIT_THREADS) - 1));
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+#define STATS_TASKS 50
+
+static void * APR_THREAD_FUNC sleep_task(apr_thread_t *thd, void *data)
+{
+    apr_sleep(apr_time_from_msec(1));
+    apr_atomic_inc32(&tasks_done);
+    return NULL;
+}
+
+static void test_threadpool_stats(abts_case *tc, void *data)
+{
+    apr_thread_pool_histogram_t hist;
+    apr_thread_pool_stats_t stats;
+    apr_status_t rv;
+    int i;
+
+    memset(&hist, 0, sizeof(hist));
+    ABTS_INT_EQUAL(tc, 0, (int)apr_thread_pool_histogram_value_at(&hist, 50));
+    hist.count = 3;
+    hist.max = 100;
+    hist.buckets[1] = 2;
+    hist.buckets[22] = 1; /* 96..111 */
+    ABTS_INT_EQUAL(tc, 1, (int)apr_thread_pool_histogram_value_at(&hist, 50));
+    ABTS_INT_EQUAL(tc, 100, (int)apr_thread_pool_histogram_value_at(&hist,
+                                                                    100));
+
+    tasks_done = 0;
+
+    rv = apr_thread_pool_create_ex(&thrp, 2, 2,
+                                   make_attr(APR_THREAD_POOL_STATS), p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < STATS_TASKS; i++) {
+        rv = apr_thread_pool_push(thrp, sleep_task, NULL,
+                                  APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_thread_pool_schedule(thrp, sleep_task, NULL,
+                                  apr_time_from_msec(1), NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    ABTS_INT_EQUAL(tc, STATS_TASKS + 1,
+                   wait_count(&tasks_done, STATS_TASKS + 1));
+
+    rv = apr_thread_pool_stats_get(thrp, &stats);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, STATS_TASKS + 1, stats.tasks_run);
+    ABTS_INT_EQUAL(tc, 2, stats.threads);
+
+    ABTS_INT_EQUAL(tc, STATS_TASKS, (int)stats.wait[1].count);
+    ABTS_INT_EQUAL(tc, STATS_TASKS, (int)stats.run[1].count);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.run[0].count);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.scheduled_wait.count);
+    ABTS_INT_EQUAL(tc, 1, (int)stats.scheduled_run.count);
+    ABTS_INT_EQUAL(tc, STATS_TASKS, (int)stats.queue_depth.count);
+    ABTS_TRUE(tc, stats.queue_depth.max > 0);
+    ABTS_TRUE(tc, apr_thread_pool_histogram_value_at(&stats.run[1], 50)
+                  >= apr_time_from_msec(1));
+    ABTS_TRUE(tc, stats.run[1].sum >= STATS_TASKS * apr_time_from_msec(1));
+    ABTS_TRUE(tc, stats.wait[1].max >= stats.wait[1].sum / STATS_TASKS);
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* No histograms without APR_THREAD_POOL_STATS */
+    tasks_done = 0;
+    rv = apr_thread_pool_create_ex(&thrp, 1, 1, make_attr(0), p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_thread_pool_push(thrp, sleep_task, NULL,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, wait_count(&tasks_done, 1));
+    rv = apr_thread_pool_stats_get(thrp, &stats);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, stats.tasks_run);
+    ABTS_INT_EQUAL(tc, 0, (int)stats.run[1].count);
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+#define GROUP_TASKS 200
+#define LOOP_SIZE 100000
+
+static volatile apr_uint32_t group_done;
+
+static apr_status_t group_leaf(void *baton)
+{
+    apr_atomic_inc32(&group_done);
+    return APR_SUCCESS;
+}
+
+/* Wait for a nested group from a task, with only two workers */
+static apr_status_t group_nested(void *baton)
+{
+    apr_pool_t *pool;
+    apr_task_group_t *group;
+    apr_status_t rv;
+    int i;
+
+    apr_pool_create(&pool, NULL);
+    rv = apr_task_group_create(&group, thrp, pool);
+    for (i = 0; i < 4 && rv == APR_SUCCESS; i++) {
+        rv = apr_task_group_spawn(group, group_leaf, NULL);
+    }
+    if (rv == APR_SUCCESS) {
+        rv = apr_task_group_wait(group);
+    }
+    apr_pool_destroy(pool);
+    apr_atomic_inc32(&group_done);
+    return rv;
+}
+
+static apr_status_t group_fail(void *baton)
+{
+    return APR_EGENERAL;
+}
+
+static void test_task_group(abts_case *tc, void *data)
+{
+    apr_uint32_t flags = (apr_uint32_t)(apr_uintptr_t)data;
+    apr_task_group_t *group;
+    apr_status_t rv;
+    int i;
+
+    rv = apr_thread_pool_create_ex(&thrp, 1, 2, make_attr(flags), p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Work stealing thread pool");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_task_group_create(&group, thrp, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    group_done = 0;
+    for (i = 0; i < GROUP_TASKS; i++) {
+        rv = apr_task_group_spawn(group, i % 10 ? group_leaf : group_nested,
+                                  NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_task_group_wait(group);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, GROUP_TASKS + GROUP_TASKS / 10 * 4, group_done);
+
+    /* the first error is reported, the other tasks still run */
+    group_done = 0;
+    apr_task_group_spawn(group, group_leaf, NULL);
+    apr_task_group_spawn(group, group_fail, NULL);
+    apr_task_group_spawn(group, group_leaf, NULL);
+    rv = apr_task_group_wait(group);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    ABTS_INT_EQUAL(tc, 2, group_done);
+
+    /* cancelled until waited for */
+    apr_task_group_cancel(group);
+    rv = apr_task_group_spawn(group, group_leaf, NULL);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    rv = apr_task_group_wait(group);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    rv = apr_task_group_spawn(group, group_leaf, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_task_group_wait(group);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, group_done);
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static apr_status_t loop_range(apr_size_t begin, apr_size_t end, void *baton)
+{
+    apr_uint32_t *visits = baton;
+
+    for (; begin < end; begin++) {
+        apr_atomic_inc32(&visits[begin]);
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t loop_fail(apr_size_t begin, apr_size_t end, void *baton)
+{
+    if (begin <= LOOP_SIZE / 2 && LOOP_SIZE / 2 < end) {
+        return APR_EGENERAL;
+    }
+    return loop_range(begin, end, baton);
+}
+
+static void test_parallel_for(abts_case *tc, void *data)
+{
+    apr_uint32_t flags = (apr_uint32_t)(apr_uintptr_t)data;
+    apr_uint32_t *visits;
+    apr_size_t i, once;
+    apr_status_t rv;
+
+    rv = apr_thread_pool_create_ex(&thrp, 2, 4, make_attr(flags), p);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "Work stealing thread pool");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    visits = apr_pcalloc(p, LOOP_SIZE * sizeof(*visits));
+
+    rv = apr_parallel_for(thrp, 0, LOOP_SIZE, 0, loop_range, visits, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_parallel_for(thrp, 10, LOOP_SIZE, 7, loop_range, visits, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_parallel_for(thrp, 5, 5, 0, loop_range, visits, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = once = 0; i < LOOP_SIZE; i++) {
+        once += (visits[i] == (i < 10 ? 1 : 2));
+    }
+    ABTS_INT_EQUAL(tc, LOOP_SIZE, once);
+
+    rv = apr_parallel_for(thrp, 0, LOOP_SIZE, 100, loop_fail, visits, p);
+    ABTS_INT_EQUAL(tc, APR_EGENERAL, rv);
+    ABTS_INT_EQUAL(tc, 2, visits[LOOP_SIZE / 2]);
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+#endif /* APR_HAS_THREADS */
+
+abts_suite *testthreadpool(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite);
+
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_threadpool_spawn, NULL);
+    abts_run_test(suite, test_threadpool_ws_spawn, NULL);
+    abts_run_test(suite, test_threadpool_ws_cancel, NULL);
+    abts_run_test(suite, test_threadpool_schedule, NULL);
+    abts_run_test(suite, test_threadpool_attr, NULL);
+    abts_run_test(suite, test_threadpool_stats, NULL);
+    abts_run_test(suite, test_task_group, NULL);
+    abts_run_test(suite, test_task_group,
+                  (void *)(apr_uintptr_t)APR_THREAD_POOL_WORK_STEALING);
+    abts_run_test(suite, test_parallel_for, NULL);
+    abts_run_test(suite, test_parallel_for,
+                  (void *)(apr_uintptr_t)APR_THREAD_POOL_WORK_STEALING);
+#endif /* APR_HAS_THREADS */
+
+    return suite;
+}
@@ -20,7 +20,10 @@
 #include "apr_lib.h"
 #include "testutil.h"
 #include "apr_strings.h"
+#include "apr_env.h"
 #include <time.h>
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
 
 #define STR_SIZE 45
 
@@ -70,6 +73,39 @@ static void test_now(abts_case *tc, void *data)
              (timediff > -2) && (timediff < 2));
 }
 
+static void test_now_coarse(abts_case *tc, void *data)
+{
+    apr_time_t coarse = apr_time_now_coarse();
+    apr_time_t current = apr_time_now();
+
+    /* The coarse clock lags by up to a tick */
+    ABTS_ASSERT(tc, "coarse time does not agree",
+                coarse <= current + apr_time_from_msec(1)
+                && current - coarse < APR_USEC_PER_SEC);
+}
+
+static void test_monotonic(abts_case *tc, void *data)
+{
+    apr_interval_time_t t0, t1;
+    apr_uint64_t c0, c1, rate;
+
+    t0 = apr_time_monotonic();
+    c0 = apr_time_cycles();
+    apr_sleep(apr_time_from_msec(20));
+    t1 = apr_time_monotonic();
+    c1 = apr_time_cycles();
+
+    ABTS_ASSERT(tc, "monotonic time did not advance",
+                t1 - t0 >= apr_time_from_msec(15)
+                && t1 - t0 < 5 * APR_USEC_PER_SEC);
+
+    rate = apr_time_cycles_per_sec();
+    ABTS_ASSERT(tc, "no cycles rate", rate > 0);
+    ABTS_ASSERT(tc, "cycles do not agree with the monotonic time",
+                c1 > c0 && (double)(c1 - c0) / rate >= 0.015
+                && (double)(c1 - c0) / rate < 5.0);
+}
+
 static void test_gmtstr(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -275,6 +311,105 @@ static void test_strftimeoffset(abts_case *tc, void *data)
     ABTS_TRUE(tc, rv == APR_SUCCESS);
 }
 
+#if !defined(WIN32) && !defined(__EMX__)
+
+static int exp_matches(const apr_time_exp_t *xt, const struct tm *tm)
+{
+    return xt->tm_sec == tm->tm_sec && xt->tm_min == tm->tm_min
+           && xt->tm_hour == tm->tm_hour && xt->tm_mday == tm->tm_mday
+           && xt->tm_mon == tm->tm_mon && xt->tm_year == tm->tm_year
+           && xt->tm_wday == tm->tm_wday && xt->tm_yday == tm->tm_yday
+           && xt->tm_isdst == (tm->tm_isdst > 0);
+}
+
+/* Times all over four centuries, around leap days and before the epoch */
+static void test_exp_gmt_many(abts_case *tc, void *data)
+{
+    apr_int64_t secs;
+    unsigned int seed = 42;
+    int i;
+
+    for (i = 0; i < 100000; i++) {
+        apr_time_exp_t xt;
+        struct tm tm;
+        time_t tt;
+
+        seed = seed * 1103515245 + 12345;
+        secs = (apr_int64_t)(seed % 150000) * 86400
+               - APR_INT64_C(6000000000) + (seed >> 8) % 86400;
+        if (sizeof(time_t) < 8 && (secs < -APR_INT64_C(2147483647)
+                                   || secs > APR_INT64_C(2147483647))) {
+            continue;
+        }
+        tt = (time_t)secs;
+        gmtime_r(&tt, &tm);
+        apr_time_exp_gmt(&xt, apr_time_from_sec(secs));
+        if (!exp_matches(&xt, &tm)) {
+            ABTS_FAIL(tc, apr_psprintf(p, "Mismatch at %" APR_INT64_T_FMT,
+                                       secs));
+            return;
+        }
+    }
+}
+
+/* A zone with daylight saving, explored around and across its changes
+ * one after another (as when the span is cached) and in a batch.
+ */
+static void test_exp_lt_zone(abts_case *tc, void *data)
+{
+    /* 2021-03-14 07:00:00Z and 2021-11-07 06:00:00Z */
+    static const apr_int64_t changes[] = { 1615705200, 1636264800 };
+    apr_time_t times[64];
+    apr_time_exp_t xts[64];
+    char *tz = NULL;
+    int i, j, n = 0;
+
+    apr_env_get(&tz, "TZ", p);
+    apr_env_set("TZ", "EST5EDT,M3.2.0,M11.1.0", p);
+    apr_time_zone_refresh();
+
+    for (i = 0; i < 2; i++) {
+        for (j = -20; j < 12; j++) {
+            apr_int64_t secs = changes[i] + j * (j < -2 || j > 2 ? 3600 : 1);
+            apr_time_exp_t xt;
+            struct tm tm;
+            time_t tt = (time_t)secs;
+
+            localtime_r(&tt, &tm);
+            apr_time_exp_lt(&xt, apr_time_from_sec(secs) + 123);
+            ABTS_ASSERT(tc, apr_psprintf(p, "Mismatch at %" APR_INT64_T_FMT,
+                                         secs), exp_matches(&xt, &tm));
+            ABTS_INT_EQUAL(tc, tm.tm_isdst ? -14400 : -18000, xt.tm_gmtoff);
+            ABTS_INT_EQUAL(tc, 123, xt.tm_usec);
+            times[n++] = apr_time_from_sec(secs);
+        }
+    }
+
+    apr_time_exp_lt_n(xts, times, n);
+    for (i = 0; i < n; i++) {
+        apr_time_exp_t xt;
+
+        apr_time_exp_lt(&xt, times[i]);
+        ABTS_ASSERT(tc, "batch mismatch", !memcmp(&xt, &xts[i], sizeof(xt)));
+    }
+
+    /* A change of zone is seen after a refresh */
+    apr_env_set("TZ", "UTC0", p);
+    apr_time_zone_refresh();
+    apr_time_exp_lt(&xts[0], times[0]);
+    ABTS_INT_EQUAL(tc, 0, xts[0].tm_gmtoff);
+
+    if (tz) {
+        apr_env_set("TZ", tz, p);
+    }
+    else {
+        apr_env_delete("TZ", p);
+    }
+    apr_time_zone_refresh();
+}
+
+#endif /* !WIN32 && !__EMX__ */
+
 /* 0.9.4 and earlier rejected valid dates in 2038 */
 static void test_2038(abts_case *tc, void *data)
 {
@@ -298,6 +433,8 @@ abts_suite *testtime(abts_suite *suite)
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test_now, NULL);
+    abts_run_test(suite, test_now_coarse, NULL);
+    abts_run_test(suite, test_monotonic, NULL);
     abts_run_test(suite, test_gmtstr, NULL);
     abts_run_test(suite, test_exp_lt, NULL);
     abts_run_test(suite, test_exp_get_gmt, NULL);
@@ -310,6 +447,10 @@ abts_suite *testtime(abts_suite *suite)
     abts_run_test(suite, test_exp_tz, NULL);
     abts_run_test(suite, test_strftimeoffset, NULL);
     abts_run_test(suite, test_2038, NULL);
+#if !defined(WIN32) && !defined(__EMX__)
+    abts_run_test(suite, test_exp_gmt_many, NULL);
+    abts_run_test(suite, test_exp_lt_zone, NULL);
+#endif
 
     return suite;
 }
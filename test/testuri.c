@@ -319,12 +319,131 @@ static void test_uph(abts_case *tc, void *data)
     }
 }
 
+static void check_span(abts_case *tc, const char *expected,
+                       const apr_uri_span_t *span)
+{
+    if (expected) {
+        ABTS_PTR_NOTNULL(tc, span->str);
+        if (span->str) {
+            ABTS_STR_EQUAL(tc, expected,
+                           apr_pstrmemdup(p, span->str, span->len));
+        }
+    }
+    else {
+        ABTS_PTR_EQUAL(tc, NULL, span->str);
+    }
+}
+
+/* The views give the pieces apr_uri_parse() copies */
+static void test_view(abts_case *tc, void *data)
+{
+    int i;
+    apr_uri_t info;
+    apr_uri_view_t view;
+    struct aup_test *t;
+
+    for (i = 0; i < sizeof(aup_tests) / sizeof(aup_tests[0]); i++) {
+        t = &aup_tests[i];
+        ABTS_INT_EQUAL(tc, t->rv, apr_uri_parse_view(t->uri, &view));
+        if (t->rv == APR_SUCCESS) {
+            apr_uri_parse(p, t->uri, &info);
+            check_span(tc, info.scheme, &view.scheme);
+            check_span(tc, info.hostinfo, &view.hostinfo);
+            check_span(tc, info.user, &view.user);
+            check_span(tc, info.password, &view.password);
+            check_span(tc, info.hostname, &view.hostname);
+            check_span(tc, info.port_str, &view.port_str);
+            check_span(tc, info.path, &view.path);
+            check_span(tc, info.query, &view.query);
+            check_span(tc, info.fragment, &view.fragment);
+            ABTS_INT_EQUAL(tc, info.port, view.port);
+        }
+    }
+
+    /* only decimal ports */
+    ABTS_INT_EQUAL(tc, APR_EGENERAL,
+                   apr_uri_parse_view("http://host:+80/", &view));
+    ABTS_INT_EQUAL(tc, APR_EGENERAL,
+                   apr_uri_parse_view("http://host:65536/", &view));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_uri_parse_view("HTTPS://host:/", &view));
+    ABTS_INT_EQUAL(tc, 443, view.port);
+}
+
+static void test_normalize(abts_case *tc, void *data)
+{
+    static const struct {
+        const char *path;
+        unsigned int flags;
+        apr_status_t rv;
+        const char *expected;
+    } tests[] = {
+        { "/a/b/c/./../../g", APR_URI_NORM_DOTS, APR_SUCCESS, "/a/g" },
+        { "/a/./b/../c/", APR_URI_NORM_DOTS, APR_SUCCESS, "/a/c/" },
+        { "/a/b/..", APR_URI_NORM_DOTS, APR_SUCCESS, "/a/" },
+        { "/a/b/.", APR_URI_NORM_DOTS, APR_SUCCESS, "/a/b/" },
+        { "/../../x", APR_URI_NORM_DOTS, APR_SUCCESS, "/x" },
+        { "/..", APR_URI_NORM_DOTS, APR_SUCCESS, "/" },
+        { "mid/content=5/../6", APR_URI_NORM_DOTS, APR_SUCCESS, "mid/6" },
+        { "../x/./y", APR_URI_NORM_DOTS, APR_SUCCESS, "x/y" },
+        { "a//..//b", APR_URI_NORM_DOTS, APR_SUCCESS, "a//b" },
+        { "/a/.b/..c/...", APR_URI_NORM_DOTS, APR_SUCCESS, "/a/.b/..c/..." },
+        { "", APR_URI_NORM_DOTS, APR_SUCCESS, "" },
+        { "/a%20b/%7euser", APR_URI_NORM_DECODE, APR_SUCCESS, "/a b/~user" },
+        { "/a/%2e%2E/b", APR_URI_NORM_DECODE, APR_SUCCESS, "/a/../b" },
+        { "/a/%2e%2E/b", APR_URI_NORM_DECODE | APR_URI_NORM_DOTS,
+          APR_SUCCESS, "/b" },
+        { "/a%2Fb/../c", APR_URI_NORM_DECODE | APR_URI_NORM_DOTS,
+          APR_SUCCESS, "/c" },
+        { "/a/%2e%2", APR_URI_NORM_DECODE, APR_EGENERAL, NULL },
+        { "/a/%zz", APR_URI_NORM_DECODE, APR_EGENERAL, NULL },
+        { "/a/%00", APR_URI_NORM_DECODE, APR_EGENERAL, NULL },
+        { "/a/%zz/../b", APR_URI_NORM_DOTS, APR_SUCCESS, "/a/b" },
+    };
+    int i;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        char *path = apr_pstrdup(p, tests[i].path);
+        apr_size_t len = strlen(path);
+        apr_status_t rv;
+
+        rv = apr_uri_normalize_path(path, &len, tests[i].flags);
+        ABTS_INT_EQUAL(tc, tests[i].rv, rv);
+        if (rv == APR_SUCCESS) {
+            ABTS_STR_EQUAL(tc, tests[i].expected,
+                           apr_pstrmemdup(p, path, len));
+        }
+    }
+}
+
+/* Normalizing the path of a view in the buffer leaves the query alone */
+static void test_view_normalize(abts_case *tc, void *data)
+{
+    char buf[] = "http://example.com/a/%7Eb/../c?q=/../#f";
+    apr_uri_view_t view;
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_uri_parse_view(buf, &view));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_uri_normalize_path(buf + (view.path.str - buf),
+                                          &view.path.len,
+                                          APR_URI_NORM_DECODE
+                                          | APR_URI_NORM_DOTS));
+    check_span(tc, "/a/c", &view.path);
+    check_span(tc, "q=/../", &view.query);
+    check_span(tc, "f", &view.fragment);
+    check_span(tc, "example.com", &view.hostname);
+    check_span(tc, NULL, &view.port_str);
+}
+
 abts_suite *testuri(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_aup, NULL);
     abts_run_test(suite, test_uph, NULL);
+    abts_run_test(suite, test_view, NULL);
+    abts_run_test(suite, test_normalize, NULL);
+    abts_run_test(suite, test_view_normalize, NULL);
 
     return suite;
 }
@@ -0,0 +1,153 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "apr_utf8.h"
+#include "apr_strings.h"
+
+#include "abts.h"
+#include "testutil.h"
+
+static void test_validate(abts_case *tc, void *data)
+{
+    /* the sequences to test, put at each offset of a longer text so as to
+     * straddle the vector blocks */
+    static const struct {
+        const char *seq;
+        apr_status_t rv;
+    } tests[] = {
+        { "\xc3\xa9", APR_SUCCESS },
+        { "\xe2\x82\xac", APR_SUCCESS },
+        { "\xf0\x9f\x98\x80", APR_SUCCESS },
+        { "\xf4\x8f\xbf\xbf", APR_SUCCESS },
+        { "\xed\x9f\xbf", APR_SUCCESS },
+        { "\x80", APR_EINVAL },
+        { "\xc0\x80", APR_EINVAL },
+        { "\xc1\xbf", APR_EINVAL },
+        { "\xe0\x9f\xbf", APR_EINVAL },
+        { "\xed\xa0\x80", APR_EINVAL },
+        { "\xf0\x8f\xbf\xbf", APR_EINVAL },
+        { "\xf4\x90\x80\x80", APR_EINVAL },
+        { "\xf8\x88\x80\x80\x80", APR_EINVAL },
+        { "\xc3" "a", APR_EINVAL },
+        { "\xe2\x82" "a", APR_EINVAL },
+        { "\xc3\xa9\xa9", APR_EINVAL },
+    };
+    char buf[80];
+    apr_size_t i, off, n, len;
+    apr_status_t rv;
+
+    memset(buf, 'x', sizeof(buf));
+    rv = apr_utf8_validate(buf, sizeof(buf), &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, sizeof(buf), len);
+
+    rv = apr_utf8_validate("caf\xc3\xa9", APR_UTF8_STRING, &len);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 5, len);
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        n = strlen(tests[i].seq);
+        for (off = 0; off + n <= sizeof(buf); off++) {
+            memset(buf, 'x', sizeof(buf));
+            memcpy(buf + off, tests[i].seq, n);
+            rv = apr_utf8_validate(buf, sizeof(buf), &len);
+            ABTS_INT_EQUAL(tc, tests[i].rv, rv);
+            if (rv == APR_SUCCESS) {
+                ABTS_SIZE_EQUAL(tc, sizeof(buf), len);
+            }
+            else {
+                ABTS_ASSERT(tc, "error reported before the sequence",
+                            len >= off && len < off + n);
+            }
+
+            /* truncated at the end of the text */
+            if (tests[i].rv == APR_SUCCESS) {
+                rv = apr_utf8_validate(buf, off + n - 1, &len);
+                ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+                ABTS_SIZE_EQUAL(tc, off, len);
+            }
+        }
+    }
+}
+
+static void test_utf16(abts_case *tc, void *data)
+{
+    static const char utf8[] = "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"
+                               "0123456789abcdefghijklmnopqrstuvwxyz";
+    static const apr_uint16_t utf16[] = {
+        'A', 0xe9, 0x20ac, 0xd83d, 0xde00
+    };
+    apr_uint16_t words[64];
+    char bytes[64];
+    apr_size_t inlen, outlen, i;
+    apr_status_t rv;
+
+    inlen = sizeof(utf8) - 1;
+    outlen = sizeof(words) / sizeof(words[0]);
+    rv = apr_utf8_to_utf16(utf8, &inlen, words, &outlen);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, inlen);
+    ABTS_SIZE_EQUAL(tc, 64 - 5 - 36, outlen);
+    ABTS_TRUE(tc, memcmp(words, utf16, sizeof(utf16)) == 0);
+    for (i = 0; i < 36; i++) {
+        ABTS_INT_EQUAL(tc, utf8[10 + i], words[5 + i]);
+    }
+
+    inlen = 64 - outlen;
+    outlen = sizeof(bytes);
+    rv = apr_utf16_to_utf8(words, &inlen, bytes, &outlen);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, inlen);
+    ABTS_SIZE_EQUAL(tc, sizeof(bytes) - (sizeof(utf8) - 1), outlen);
+    ABTS_TRUE(tc, memcmp(bytes, utf8, sizeof(utf8) - 1) == 0);
+
+    /* no room for the surrogate pair */
+    inlen = 10;
+    outlen = 4;
+    rv = apr_utf8_to_utf16(utf8, &inlen, words, &outlen);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 4, inlen);
+    ABTS_SIZE_EQUAL(tc, 1, outlen);
+
+    /* truncated and invalid input */
+    inlen = 9;
+    outlen = sizeof(words) / sizeof(words[0]);
+    rv = apr_utf8_to_utf16(utf8, &inlen, words, &outlen);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    ABTS_SIZE_EQUAL(tc, 3, inlen);
+
+    inlen = 4;
+    rv = apr_utf16_to_utf8(utf16, &inlen, bytes, &outlen);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    ABTS_SIZE_EQUAL(tc, 1, inlen);
+
+    inlen = 1;
+    outlen = sizeof(bytes);
+    rv = apr_utf16_to_utf8(utf16 + 4, &inlen, bytes, &outlen);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    ABTS_SIZE_EQUAL(tc, 1, inlen);
+}
+
+abts_suite *testutf8(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite);
+
+    abts_run_test(suite, test_validate, NULL);
+    abts_run_test(suite, test_utf16, NULL);
+
+    return suite;
+}
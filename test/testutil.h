@@ -120,6 +120,8 @@ abts_suite *testpass(abts_suite *suite);
 abts_suite *testbase64(abts_suite *suite);
 abts_suite *testmd4(abts_suite *suite);
 abts_suite *testmd5(abts_suite *suite);
+abts_suite *testsha(abts_suite *suite);
+abts_suite *testcrc32(abts_suite *suite);
 abts_suite *testcrypto(abts_suite *suite);
 abts_suite *testdbd(abts_suite *suite);
 abts_suite *testdate(abts_suite *suite);
@@ -127,12 +129,29 @@ abts_suite *testmemcache(abts_suite *suite);
 abts_suite *testredis(abts_suite *suite);
 abts_suite *testreslist(abts_suite *suite);
 abts_suite *testqueue(abts_suite *suite);
+abts_suite *testthreadpool(abts_suite *suite);
+abts_suite *testreactor(abts_suite *suite);
+abts_suite *testfiber(abts_suite *suite);
+abts_suite *testresolver(abts_suite *suite);
+abts_suite *testnearcache(abts_suite *suite);
+abts_suite *testcache(abts_suite *suite);
+abts_suite *testbloom(abts_suite *suite);
+abts_suite *teststatcache(abts_suite *suite);
+abts_suite *testfileappender(abts_suite *suite);
+abts_suite *testutf8(abts_suite *suite);
+abts_suite *testepoch(abts_suite *suite);
+abts_suite *testcounter(abts_suite *suite);
+abts_suite *testshmhash(abts_suite *suite);
+abts_suite *testshmring(abts_suite *suite);
+abts_suite *teststrbuf(abts_suite *suite);
 abts_suite *testxml(abts_suite *suite);
 abts_suite *testxlate(abts_suite *suite);
 abts_suite *testrmm(abts_suite *suite);
 abts_suite *testdbm(abts_suite *suite);
 abts_suite *testlfsabi(abts_suite *suite);
 abts_suite *testskiplist(abts_suite *suite);
+abts_suite *testheap(abts_suite *suite);
+abts_suite *testhamt(abts_suite *suite);
 abts_suite *testsiphash(abts_suite *suite);
 abts_suite *testjson(abts_suite *suite);
 abts_suite *testjose(abts_suite *suite);
@@ -17,6 +17,7 @@
 #include "testutil.h"
 #include "apr_general.h"
 #include "apr_uuid.h"
+#include "apr_time.h"
 
 static void test_uuid_parse(abts_case *tc, void *data)
 {
@@ -45,12 +46,98 @@ static void test_gen2(abts_case *tc, void *data)
              memcmp(&uuid, &uuid2, sizeof(uuid)) != 0);
 }
 
+static void test_uuid_format_parse(abts_case *tc, void *data)
+{
+    static const unsigned char bytes[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    apr_uuid_t uuid;
+    char buf[APR_UUID_FORMATTED_LENGTH + 1];
+
+    memcpy(uuid.data, bytes, 16);
+    apr_uuid_format(buf, &uuid);
+    ABTS_STR_EQUAL(tc, "01234567-89ab-cdef-fedc-ba9876543210", buf);
+
+    memset(&uuid, 0, sizeof(uuid));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+            apr_uuid_parse(&uuid, "01234567-89AB-CDef-fedc-ba9876543210"));
+    ABTS_ASSERT(tc, "parse of mixed case",
+            memcmp(uuid.data, bytes, 16) == 0);
+
+    ABTS_INT_EQUAL(tc, APR_BADARG,
+            apr_uuid_parse(&uuid, "01234567-89ab-cdef-fedc-ba987654321g"));
+    ABTS_INT_EQUAL(tc, APR_BADARG,
+            apr_uuid_parse(&uuid, "01234567-89ab-cdef-fedc-ba98765432100"));
+    ABTS_INT_EQUAL(tc, APR_BADARG,
+            apr_uuid_parse(&uuid, "01234567-89ab-cdef-fedc-ba987654321"));
+    ABTS_INT_EQUAL(tc, APR_BADARG,
+            apr_uuid_parse(&uuid, "01234567+89ab-cdef-fedc-ba9876543210"));
+    ABTS_INT_EQUAL(tc, APR_BADARG, apr_uuid_parse(&uuid, ""));
+}
+
+static void test_uuid_v4(abts_case *tc, void *data)
+{
+    apr_uuid_t uuid, uuid2;
+    apr_status_t rv;
+
+    rv = apr_uuid_get_v4(&uuid);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "no random source for apr_uuid_get_v4");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_uuid_get_v4(&uuid2));
+    ABTS_INT_EQUAL(tc, 0x40, uuid.data[6] & 0xF0);
+    ABTS_INT_EQUAL(tc, 0x80, uuid.data[8] & 0xC0);
+    ABTS_ASSERT(tc, "generated the same UUID twice",
+             memcmp(&uuid, &uuid2, sizeof(uuid)) != 0);
+}
+
+static void test_uuid_v7(abts_case *tc, void *data)
+{
+    apr_uuid_t uuid, prev;
+    apr_uint64_t ms;
+    apr_time_t now = apr_time_now();
+    apr_status_t rv;
+    int i;
+
+    rv = apr_uuid_get_v7(&prev);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "no random source for apr_uuid_get_v7");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0x70, prev.data[6] & 0xF0);
+    ABTS_INT_EQUAL(tc, 0x80, prev.data[8] & 0xC0);
+
+    for (i = 0, ms = 0; i < 6; ++i) {
+        ms = (ms << 8) | prev.data[i];
+    }
+    ABTS_ASSERT(tc, "timestamp of the UUID",
+            ms >= (apr_uint64_t)apr_time_as_msec(now)
+            && ms <= (apr_uint64_t)apr_time_as_msec(now) + 1000);
+
+    /* In order, even when faster than the clock */
+    for (i = 0; i < 1000; ++i) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_uuid_get_v7(&uuid));
+        if (memcmp(&prev, &uuid, sizeof(uuid)) >= 0) {
+            ABTS_FAIL(tc, "v7 UUIDs out of order");
+            break;
+        }
+        prev = uuid;
+    }
+}
+
 abts_suite *testuuid(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
 
     abts_run_test(suite, test_uuid_parse, NULL);
     abts_run_test(suite, test_gen2, NULL);
+    abts_run_test(suite, test_uuid_format_parse, NULL);
+    abts_run_test(suite, test_uuid_v4, NULL);
+    abts_run_test(suite, test_uuid_v7, NULL);
 
     return suite;
 }
@@ -112,6 +112,73 @@ static void test_transformation(abts_case *tc, void *data)
     one_test(tc, "UTF-7", "UTF-8", test_utf7, test_utf8, p);
 }
 
+static void test_builtin(abts_case *tc, void *data)
+{
+    static const char utf16le[] = "E\0\xdf\0\x3d\xd8\x00\xde";
+    static const char utf8[] = "E\xc3\x9f\xf0\x9f\x98\x80";
+    char buf[16];
+    apr_size_t inbytes_left, outbytes_left;
+    apr_xlate_t *convset;
+    apr_status_t rv;
+    int onoff;
+
+    rv = apr_xlate_open(&convset, "UTF-8", "UTF-16LE", p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (rv != APR_SUCCESS)
+        return;
+    apr_xlate_sb_get(convset, &onoff);
+    ABTS_INT_EQUAL(tc, 0, onoff);
+
+    inbytes_left = sizeof(utf16le) - 1;
+    outbytes_left = sizeof(buf);
+    rv = apr_xlate_conv_buffer(convset, utf16le, &inbytes_left,
+                               buf, &outbytes_left);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 0, inbytes_left);
+    ABTS_SIZE_EQUAL(tc, sizeof(buf) - (sizeof(utf8) - 1), outbytes_left);
+    ABTS_TRUE(tc, memcmp(buf, utf8, sizeof(utf8) - 1) == 0);
+
+    /* Out of output space in the middle of a character */
+    inbytes_left = sizeof(utf16le) - 1;
+    outbytes_left = 5;
+    rv = apr_xlate_conv_buffer(convset, utf16le, &inbytes_left,
+                               buf, &outbytes_left);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_SIZE_EQUAL(tc, 4, inbytes_left);
+    ABTS_SIZE_EQUAL(tc, 2, outbytes_left);
+    apr_xlate_close(convset);
+
+    rv = apr_xlate_open(&convset, "ISO-8859-1", "UTF-8", p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    if (rv != APR_SUCCESS)
+        return;
+
+    /* Truncated, then invalid, then unrepresentable input */
+    inbytes_left = 2;
+    outbytes_left = sizeof(buf);
+    rv = apr_xlate_conv_buffer(convset, "E\xc3", &inbytes_left,
+                               buf, &outbytes_left);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    ABTS_SIZE_EQUAL(tc, 1, inbytes_left);
+
+    inbytes_left = 3;
+    outbytes_left = sizeof(buf);
+    rv = apr_xlate_conv_buffer(convset, "E\xc0\x80", &inbytes_left,
+                               buf, &outbytes_left);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    ABTS_SIZE_EQUAL(tc, 2, inbytes_left);
+
+    inbytes_left = sizeof(utf8) - 1;
+    outbytes_left = sizeof(buf);
+    rv = apr_xlate_conv_buffer(convset, utf8, &inbytes_left,
+                               buf, &outbytes_left);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    ABTS_SIZE_EQUAL(tc, 4, inbytes_left);
+    ABTS_SIZE_EQUAL(tc, sizeof(buf) - 2, outbytes_left);
+    ABTS_TRUE(tc, memcmp(buf, "E\xdf", 2) == 0);
+    apr_xlate_close(convset);
+}
+
 #endif /* APR_HAS_XLATE */
 
 abts_suite *testxlate(abts_suite *suite)
@@ -120,6 +187,7 @@ abts_suite *testxlate(abts_suite *suite)
 
 #if APR_HAS_XLATE
     abts_run_test(suite, test_transformation, NULL);
+    abts_run_test(suite, test_builtin, NULL);
 #endif
 
     return suite;
@@ -16,6 +16,7 @@
 
 #include "apr.h"
 #include "apr_general.h"
+#include "apr_strings.h"
 #include "apr_xml.h"
 #include "abts.h"
 #include "testutil.h"
@@ -174,6 +175,11 @@ static void roundtrip(abts_case* tc, char* xml, char* expected, int lineno)
     apr_size_t len = strlen(xml);
     apr_size_t i;
     apr_pool_t *pool;
+    apr_bucket_alloc_t *ba;
+    apr_bucket_brigade *bb;
+    char *buf;
+    apr_size_t size;
+    int style;
 
     apr_pool_create(&pool, p);
 
@@ -192,12 +198,35 @@ static void roundtrip(abts_case* tc, char* xml, char* expected, int lineno)
     if (rv != APR_SUCCESS)
         return;
 
+    /* Quoted on the fly into a brigade */
+    ba = apr_bucket_alloc_create(pool);
+    bb = apr_brigade_create(pool, ba);
+    rv = apr_xml_to_brigade(bb, NULL, NULL, doc->root,
+                            APR_XML_X2T_FULL_NS_LANG, doc->namespaces, NULL,
+                            1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_brigade_pflatten(bb, &buf, &len, pool);
+    abts_str_equal(tc, expected, apr_pstrmemdup(pool, buf, len), lineno);
+
     apr_xml_quote_elem(pool, doc->root);
 
     apr_xml_to_text(pool, doc->root, APR_XML_X2T_FULL_NS_LANG, doc->namespaces, NULL, &actual, NULL);
 
     abts_str_equal(tc, expected, actual, lineno);
 
+    /* Already quoted, in all the styles */
+    for (style = APR_XML_X2T_FULL; style <= APR_XML_X2T_PARSED; style++) {
+        apr_brigade_cleanup(bb);
+        rv = apr_xml_to_brigade(bb, NULL, NULL, doc->root, style,
+                                doc->namespaces, NULL, 0);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        apr_brigade_pflatten(bb, &buf, &len, pool);
+        apr_xml_to_text(pool, doc->root, style, doc->namespaces, NULL,
+                        &actual, &size);
+        ABTS_SIZE_EQUAL(tc, size - 1, len);
+        ABTS_TRUE(tc, memcmp(actual, buf, len) == 0);
+    }
+
     apr_pool_destroy(pool);
 }
 
@@ -324,6 +353,194 @@ static void test_xml_parser_geterror(abts_case *tc, void *data)
 #endif
 }
 
+typedef struct {
+    apr_xml_parser *parser;
+    apr_pool_t *pool;
+    char *events;
+    int elems;
+    int stop_at;
+} stream_baton_t;
+
+static apr_status_t stream_start(void *baton, const apr_xml_elem *elem)
+{
+    stream_baton_t *sb = baton;
+    apr_array_header_t *namespaces = apr_xml_parser_namespaces(sb->parser);
+    const apr_xml_attr *attr;
+
+    ++sb->elems;
+    if (elem->parent && elem->parent->parent) {
+        /* past the first levels, only count the elements */
+        return APR_SUCCESS;
+    }
+    sb->events = apr_psprintf(sb->pool, "%s<{%s}%s lang=%s", sb->events,
+                              elem->ns < 0 ? ""
+                              : APR_XML_GET_URI_ITEM(namespaces, elem->ns),
+                              elem->name, elem->lang ? elem->lang : "");
+    for (attr = elem->attr; attr; attr = attr->next) {
+        sb->events = apr_psprintf(sb->pool, "%s {%s}%s=%s", sb->events,
+                                  attr->ns < 0 ? ""
+                                  : APR_XML_GET_URI_ITEM(namespaces, attr->ns),
+                                  attr->name, attr->value);
+    }
+    sb->events = apr_pstrcat(sb->pool, sb->events, ">", NULL);
+    return APR_SUCCESS;
+}
+
+static apr_status_t count_start(void *baton, const apr_xml_elem *elem)
+{
+    stream_baton_t *sb = baton;
+
+    if (++sb->elems == sb->stop_at) {
+        return APR_EINTR;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t stream_cdata(void *baton, const apr_xml_elem *elem,
+                                 const char *data, apr_size_t len)
+{
+    stream_baton_t *sb = baton;
+
+    if (!elem->parent || !elem->parent->parent) {
+        sb->events = apr_pstrcat(sb->pool, sb->events,
+                                 apr_pstrmemdup(sb->pool, data, len), NULL);
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t stream_end(void *baton, const apr_xml_elem *elem)
+{
+    stream_baton_t *sb = baton;
+
+    if (!elem->parent || !elem->parent->parent) {
+        sb->events = apr_pstrcat(sb->pool, sb->events, "</", elem->name, ">",
+                                 NULL);
+    }
+    return APR_SUCCESS;
+}
+
+static void test_xml_stream(abts_case *tc, void *data)
+{
+    const char *xml = "<D:multistatus xmlns:D=\"DAV:\" xml:lang=\"en\">"
+                      "<D:response xmlns:x=\"urn:x\" x:a=\"1\" b=\"2\">"
+                      "<x:deep><x:deeper/></x:deep>text"
+                      "</D:response>"
+                      "<response xmlns=\"urn:y\">more</response>"
+                      "</D:multistatus>";
+    apr_size_t i, len = strlen(xml);
+    stream_baton_t sb;
+    apr_xml_doc *doc;
+
+    sb.pool = p;
+    sb.events = "";
+    sb.elems = 0;
+    sb.parser = apr_xml_parser_create_stream(p, stream_start, stream_cdata,
+                                             stream_end, &sb);
+    ABTS_PTR_NOTNULL(tc, sb.parser);
+
+    /* Feed parser by one character, cdata coming in pieces. */
+    for (i = 0; i < len; i++) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_xml_parser_feed(sb.parser, xml + i, 1));
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_xml_parser_done(sb.parser, &doc));
+    ABTS_PTR_EQUAL(tc, NULL, doc->root);
+    ABTS_INT_EQUAL(tc, 5, sb.elems);
+    ABTS_STR_EQUAL(tc, "<{DAV:}multistatus lang=en>"
+                       "<{DAV:}response lang=en {}b=2 {urn:x}a=1>text"
+                       "</response>"
+                       "<{urn:y}response lang=en>more</response>"
+                       "</multistatus>", sb.events);
+}
+
+static const char *elem_uri(apr_xml_doc *doc, const apr_xml_elem *elem)
+{
+    return elem->ns < 0 ? "" : APR_XML_GET_URI_ITEM(doc->namespaces,
+                                                    elem->ns);
+}
+
+/* Prefixes redeclared in nested elements, then back in scope */
+static void test_xml_ns_scopes(abts_case *tc, void *data)
+{
+    const char *xml = "<a:root xmlns:a=\"urn:a\" xmlns=\"urn:d\">"
+                      "<a:x xmlns:a=\"urn:b\"><a:y a:v=\"1\"/></a:x>"
+                      "<a:x/>"
+                      "<z xmlns=\"\"><a:w/></z>"
+                      "<z/>"
+                      "</a:root>";
+    const char *bad = "<r><p:x xmlns:p=\"urn:p\"/><p:y/></r>";
+    apr_xml_parser *parser;
+    apr_xml_doc *doc;
+    apr_xml_elem *x1, *x2, *z1, *z2;
+
+    parser = apr_xml_parser_create(p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_xml_parser_feed(parser, xml, strlen(xml)));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, apr_xml_parser_done(parser, &doc));
+
+    ABTS_STR_EQUAL(tc, "urn:a", elem_uri(doc, doc->root));
+    x1 = doc->root->first_child;
+    x2 = x1->next;
+    z1 = x2->next;
+    z2 = z1->next;
+    ABTS_STR_EQUAL(tc, "x", x1->name);
+    ABTS_STR_EQUAL(tc, "urn:b", elem_uri(doc, x1));
+    ABTS_STR_EQUAL(tc, "urn:b", elem_uri(doc, x1->first_child));
+    ABTS_STR_EQUAL(tc, "urn:b", APR_XML_GET_URI_ITEM(doc->namespaces,
+                                            x1->first_child->attr->ns));
+    ABTS_STR_EQUAL(tc, "urn:a", elem_uri(doc, x2));
+    ABTS_INT_EQUAL(tc, APR_XML_NS_NONE, z1->ns);
+    ABTS_STR_EQUAL(tc, "urn:a", elem_uri(doc, z1->first_child));
+    ABTS_STR_EQUAL(tc, "urn:d", elem_uri(doc, z2));
+    ABTS_STR_EQUAL(tc, "z", z2->name);
+
+    /* the names are shared, and so are the URIs */
+    ABTS_PTR_EQUAL(tc, x1->name, x2->name);
+    ABTS_PTR_EQUAL(tc, z1->name, z2->name);
+    ABTS_INT_EQUAL(tc, x2->ns, doc->root->ns);
+
+    /* a prefix is unknown past the element declaring it */
+    parser = apr_xml_parser_create(p);
+    apr_xml_parser_feed(parser, bad, strlen(bad));
+    ABTS_TRUE(tc, apr_xml_parser_done(parser, &doc) != APR_SUCCESS);
+}
+
+/* Many elements in constant memory, up to a callback stopping the parse */
+static void test_xml_stream_many(abts_case *tc, void *data)
+{
+    const char *item = "<item xmlns=\"urn:items\" id=\"x\"><v>data</v></item>";
+    apr_size_t len = strlen(item);
+    apr_pool_t *pool;
+    stream_baton_t sb;
+    char errbuf[64];
+    int i;
+
+    apr_pool_create(&pool, p);
+    sb.pool = pool;
+    sb.events = "";
+    sb.elems = 0;
+    sb.stop_at = 2 * 100000 + 2;
+    sb.parser = apr_xml_parser_create_stream(pool, count_start, NULL, NULL,
+                                             &sb);
+
+    ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                   apr_xml_parser_feed(sb.parser, "<items>", 7));
+    for (i = 0; i < 100000; i++) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS,
+                       apr_xml_parser_feed(sb.parser, item, len));
+    }
+    ABTS_INT_EQUAL(tc, 1, apr_xml_parser_namespaces(sb.parser)->nelts - 1);
+    ABTS_INT_EQUAL(tc, APR_EINTR,
+                   apr_xml_parser_feed(sb.parser, item, len));
+    ABTS_INT_EQUAL(tc, APR_EINTR, apr_xml_parser_feed(sb.parser, item, len));
+    ABTS_INT_EQUAL(tc, 2 * 100000 + 2, sb.elems);
+    ABTS_STR_EQUAL(tc, "A callback stopped the parsing.",
+                   apr_xml_parser_geterror(sb.parser, errbuf,
+                                           sizeof(errbuf)));
+
+    apr_pool_destroy(pool);
+}
+
 abts_suite *testxml(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -332,6 +549,9 @@ abts_suite *testxml(abts_suite *suite)
     abts_run_test(suite, test_billion_laughs, NULL);
     abts_run_test(suite, test_xml_roundtrip, NULL);
     abts_run_test(suite, test_xml_parser_geterror, NULL);
+    abts_run_test(suite, test_xml_stream, NULL);
+    abts_run_test(suite, test_xml_ns_scopes, NULL);
+    abts_run_test(suite, test_xml_stream_many, NULL);
 
     return suite;
 }
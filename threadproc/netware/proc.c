@@ -302,6 +302,13 @@ APR_DECLARE(apr_status_t) apr_procattr_error_check_set(apr_procattr_t *attr,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_procattr_spawn_set(apr_procattr_t *attr,
+                                                 apr_int32_t spawn)
+{
+    /* won't ever be used on this platform, so don't save the flag */
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t) apr_procattr_addrspace_set(apr_procattr_t *attr,
                                                        apr_int32_t addrspace)
 {
@@ -359,18 +366,12 @@ APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *newproc,
     }
 
     if (attr->child_in && (attr->child_in->filedes != -1)) {
-        apr_pool_cleanup_kill(apr_file_pool_get(attr->child_in), 
-                              attr->child_in, apr_unix_file_cleanup);
         apr_file_close(attr->child_in);
     }
     if (attr->child_out && (attr->child_out->filedes != -1)) {
-        apr_pool_cleanup_kill(apr_file_pool_get(attr->child_out), 
-                              attr->child_out, apr_unix_file_cleanup);
         apr_file_close(attr->child_out);
     }
     if (attr->child_err && (attr->child_err->filedes != -1)) {
-        apr_pool_cleanup_kill(apr_file_pool_get(attr->child_err), 
-                              attr->child_err, apr_unix_file_cleanup);
         apr_file_close(attr->child_err);
     }
 
@@ -380,6 +381,13 @@ APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *newproc,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_proc_exit_file_get(apr_file_t **file,
+                                                 apr_proc_t *proc,
+                                                 apr_pool_t *pool)
+{
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_proc_wait_all_procs(apr_proc_t *proc,
                                                   int *exitcode,
                                                   apr_exit_why_e *exitwhy,
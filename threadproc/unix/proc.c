@@ -21,6 +21,13 @@
 #include "apr_random.h"
 #include "apr_crypto.h"
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(HAVE_KQUEUE)
+#include <sys/event.h>
+#endif
+
 /* Heavy on no'ops, here's what we want to pass if there is APR_NO_FILE
  * requested for a specific child handle;
  */
@@ -37,6 +44,7 @@ APR_DECLARE(apr_status_t) apr_procattr_create(apr_procattr_t **new,
     (*new)->pool = pool;
     (*new)->cmdtype = APR_PROGRAM;
     (*new)->uid = (*new)->gid = -1;
+    (*new)->spawn = 1;
     return APR_SUCCESS;
 }
 
@@ -324,6 +332,13 @@ APR_DECLARE(apr_status_t) apr_procattr_error_check_set(apr_procattr_t *attr,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_procattr_spawn_set(apr_procattr_t *attr,
+                                                 apr_int32_t spawn)
+{
+    attr->spawn = spawn;
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t) apr_procattr_addrspace_set(apr_procattr_t *attr,
                                                        apr_int32_t addrspace)
 {
@@ -361,6 +376,222 @@ APR_DECLARE(apr_status_t) apr_procattr_group_set(apr_procattr_t *attr,
     return rv;
 }
 
+/* Join the arguments of an APR_SHELLCMD(_ENV) into the single string
+ * given to "sh -c", unless the caller built it already.
+ */
+static const char *shell_command(const char * const *args, apr_pool_t *pool)
+{
+    apr_size_t onearg_len = 0;
+    char *ch, *onearg;
+    int i;
+
+    for (i = 0; args[i]; ++i) {
+        onearg_len += strlen(args[i]);
+        onearg_len++; /* for space delimiter */
+    }
+
+    switch (i) {
+    case 0:
+        /* bad parameters; we're doomed */
+        return NULL;
+    case 1:
+        /* no args, or caller already built a single string from
+         * progname and args
+         */
+        return args[0];
+    }
+
+    ch = onearg = apr_palloc(pool, onearg_len);
+    for (i = 0; args[i]; ++i) {
+        apr_size_t len = strlen(args[i]);
+
+        memcpy(ch, args[i], len);
+        ch += len;
+        *ch = ' ';
+        ++ch;
+    }
+    --ch; /* back up to trailing blank */
+    *ch = '\0';
+
+    return onearg;
+}
+
+#ifdef APR_PROC_SPAWN
+#if defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR)
+#define spawn_file_actions_addchdir posix_spawn_file_actions_addchdir
+#elif defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP)
+#define spawn_file_actions_addchdir posix_spawn_file_actions_addchdir_np
+#endif
+
+extern char **environ;
+
+/* Whether the child described by attr can be started by posix_spawn(),
+ * which spares the parent the copy of its page tables made by fork()
+ * (the C library usually spawns with vfork() or clone(CLONE_VFORK)).
+ * What can only be done by code running in the child needs fork().
+ */
+static int spawn_possible(apr_procattr_t *attr)
+{
+    if (!attr->spawn || attr->detached) {
+        return 0;
+    }
+#ifdef RLIMIT_CPU
+    if (attr->limit_cpu) {
+        return 0;
+    }
+#endif
+#if defined(RLIMIT_DATA) || defined(RLIMIT_VMEM) || defined(RLIMIT_AS)
+    if (attr->limit_mem) {
+        return 0;
+    }
+#endif
+#ifdef RLIMIT_NPROC
+    if (attr->limit_nproc) {
+        return 0;
+    }
+#endif
+#ifdef RLIMIT_NOFILE
+    if (attr->limit_nofile) {
+        return 0;
+    }
+#endif
+#ifndef spawn_file_actions_addchdir
+    if (attr->currdir) {
+        return 0;
+    }
+#endif
+    /* The user, group and permissions are only changed by root */
+    if ((attr->uid != -1 || attr->gid != -1 || attr->perms_set_callbacks)
+            && !geteuid()) {
+        return 0;
+    }
+    return 1;
+}
+
+static int spawn_child_fd(posix_spawn_file_actions_t *actions,
+                          apr_file_t *child, int fd)
+{
+    if (!child) {
+        return 0;
+    }
+    if (child->filedes == -1) {
+        return posix_spawn_file_actions_addclose(actions, fd);
+    }
+    if (child->filedes != fd) {
+        return posix_spawn_file_actions_adddup2(actions, child->filedes, fd);
+    }
+    return 0;
+}
+
+/* Close the inheritable descriptor the child's fd was dup2()ed from,
+ * once, as the fork() path does with apr_file_close().
+ */
+static int spawn_child_close(posix_spawn_file_actions_t *actions,
+                             apr_file_t *child, int fd, int *closed, int n)
+{
+    int i;
+
+    if (!child || child->filedes == -1 || child->filedes == fd
+            || child->filedes <= STDERR_FILENO) {
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        if (closed[i] == child->filedes) {
+            return 0;
+        }
+    }
+    closed[n] = child->filedes;
+    return posix_spawn_file_actions_addclose(actions, child->filedes);
+}
+
+static apr_status_t proc_spawn(apr_proc_t *new,
+                               const char *progname,
+                               const char * const *args,
+                               const char * const *env,
+                               apr_procattr_t *attr,
+                               apr_pool_t *pool)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t sattr;
+    sigset_t sigdef;
+    const char *newargs[4];
+    int closed[3] = { -1, -1, -1 };
+    pid_t pid;
+    int rv;
+
+    if ((rv = posix_spawn_file_actions_init(&actions))) {
+        return rv;
+    }
+    if ((rv = posix_spawnattr_init(&sattr))) {
+        posix_spawn_file_actions_destroy(&actions);
+        return rv;
+    }
+
+    if (!(rv = spawn_child_fd(&actions, attr->child_in, STDIN_FILENO))
+        && !(rv = spawn_child_fd(&actions, attr->child_out, STDOUT_FILENO))
+        && !(rv = spawn_child_fd(&actions, attr->child_err, STDERR_FILENO))
+        && !(rv = spawn_child_close(&actions, attr->child_in,
+                                    STDIN_FILENO, closed, 0))
+        && !(rv = spawn_child_close(&actions, attr->child_out,
+                                    STDOUT_FILENO, closed, 1))) {
+        rv = spawn_child_close(&actions, attr->child_err,
+                               STDERR_FILENO, closed, 2);
+    }
+#ifdef spawn_file_actions_addchdir
+    if (!rv && attr->currdir) {
+        rv = spawn_file_actions_addchdir(&actions, attr->currdir);
+    }
+#endif
+    if (!rv) {
+        /* As the fork() path, reset SIGCHLD for the child */
+        sigemptyset(&sigdef);
+        sigaddset(&sigdef, SIGCHLD);
+        if (!(rv = posix_spawnattr_setsigdefault(&sattr, &sigdef))) {
+            rv = posix_spawnattr_setflags(&sattr, POSIX_SPAWN_SETSIGDEF);
+        }
+    }
+
+    if (!rv) {
+        char * const *argv = (char * const *)args;
+        char * const *envp = (char * const *)env;
+
+        switch (attr->cmdtype) {
+        case APR_SHELLCMD:
+        case APR_SHELLCMD_ENV:
+            newargs[0] = SHELL_PATH;
+            newargs[1] = "-c";
+            newargs[2] = shell_command(args, pool);
+            newargs[3] = NULL;
+            argv = (char * const *)newargs;
+            if (attr->cmdtype == APR_SHELLCMD_ENV) {
+                envp = environ;
+            }
+            rv = posix_spawn(&pid, SHELL_PATH, &actions, &sattr, argv, envp);
+            break;
+        case APR_PROGRAM:
+            rv = posix_spawn(&pid, progname, &actions, &sattr, argv, envp);
+            break;
+        case APR_PROGRAM_ENV:
+            rv = posix_spawn(&pid, progname, &actions, &sattr, argv, environ);
+            break;
+        default:
+            /* APR_PROGRAM_PATH */
+            rv = posix_spawnp(&pid, progname, &actions, &sattr, argv, environ);
+            break;
+        }
+    }
+
+    posix_spawnattr_destroy(&sattr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (rv) {
+        return rv;
+    }
+    new->pid = pid;
+    return APR_SUCCESS;
+}
+#endif /* APR_PROC_SPAWN */
+
 APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *new,
                                           const char *progname,
                                           const char * const *args,
@@ -368,7 +599,6 @@ APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *new,
                                           apr_procattr_t *attr,
                                           apr_pool_t *pool)
 {
-    int i;
     const char * const empty_envp[] = {NULL};
 
     if (!env) { /* Specs require an empty array instead of NULL;
@@ -408,6 +638,16 @@ APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *new,
         }
     }
 
+#ifdef APR_PROC_SPAWN
+    if (spawn_possible(attr)) {
+        apr_status_t rv = proc_spawn(new, progname, args, env, attr, pool);
+
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    else
+#endif
     if ((new->pid = fork()) < 0) {
         return errno;
     }
@@ -430,16 +670,19 @@ APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *new,
         if (attr->child_in) {
             apr_pool_cleanup_kill(apr_file_pool_get(attr->child_in),
                                   attr->child_in, apr_unix_file_cleanup);
+            attr->child_in->cleanup = NULL;
         }
 
         if (attr->child_out) {
             apr_pool_cleanup_kill(apr_file_pool_get(attr->child_out),
                                   attr->child_out, apr_unix_file_cleanup);
+            attr->child_out->cleanup = NULL;
         }
 
         if (attr->child_err) {
             apr_pool_cleanup_kill(apr_file_pool_get(attr->child_err),
                                   attr->child_err, apr_unix_file_cleanup);
+            attr->child_err->cleanup = NULL;
         }
 
         apr_pool_cleanup_for_exec();
@@ -522,50 +765,11 @@ APR_DECLARE(apr_status_t) apr_proc_create(apr_proc_t *new,
 
         if (attr->cmdtype == APR_SHELLCMD ||
             attr->cmdtype == APR_SHELLCMD_ENV) {
-            int onearg_len = 0;
             const char *newargs[4];
 
             newargs[0] = SHELL_PATH;
             newargs[1] = "-c";
-
-            i = 0;
-            while (args[i]) {
-                onearg_len += strlen(args[i]);
-                onearg_len++; /* for space delimiter */
-                i++;
-            }
-
-            switch(i) {
-            case 0:
-                /* bad parameters; we're doomed */
-                break;
-            case 1:
-                /* no args, or caller already built a single string from
-                 * progname and args
-                 */
-                newargs[2] = args[0];
-                break;
-            default:
-            {
-                char *ch, *onearg;
-                
-                ch = onearg = apr_palloc(pool, onearg_len);
-                i = 0;
-                while (args[i]) {
-                    size_t len = strlen(args[i]);
-
-                    memcpy(ch, args[i], len);
-                    ch += len;
-                    *ch = ' ';
-                    ++ch;
-                    ++i;
-                }
-                --ch; /* back up to trailing blank */
-                *ch = '\0';
-                newargs[2] = onearg;
-            }
-            }
-
+            newargs[2] = shell_command(args, pool);
             newargs[3] = NULL;
 
             if (attr->detached) {
@@ -697,6 +901,40 @@ APR_DECLARE(apr_status_t) apr_proc_wait(apr_proc_t *proc,
     return errno;
 }
 
+APR_DECLARE(apr_status_t) apr_proc_exit_file_get(apr_file_t **file,
+                                                 apr_proc_t *proc,
+                                                 apr_pool_t *pool)
+{
+    int fd;
+
+#if defined(SYS_pidfd_open)
+    /* A pidfd polls readable once the process has terminated */
+    fd = syscall(SYS_pidfd_open, proc->pid, 0);
+    if (fd < 0) {
+        return errno;
+    }
+#elif defined(HAVE_KQUEUE)
+    /* So does a kqueue watching the process' exit */
+    struct kevent ev;
+
+    fd = kqueue();
+    if (fd < 0) {
+        return errno;
+    }
+    EV_SET(&ev, proc->pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT,
+           0, NULL);
+    if (kevent(fd, &ev, 1, NULL, 0, NULL) < 0) {
+        apr_status_t rv = errno;
+        close(fd);
+        return rv;
+    }
+#else
+    return APR_ENOTIMPL;
+#endif
+
+    return apr_os_pipe_put_ex(file, &fd, 1, pool);
+}
+
 #if APR_HAVE_STRUCT_RLIMIT
 APR_DECLARE(apr_status_t) apr_procattr_limit_set(apr_procattr_t *attr,
                                                  apr_int32_t what,
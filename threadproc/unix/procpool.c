@@ -0,0 +1,806 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_arch_threadproc.h"
+#include "apr_proc_pool.h"
+#include "apr_strings.h"
+#include "apr_hash.h"
+#include "apr_portable.h"
+
+#if APR_HAS_FORK
+
+#if APR_HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#if APR_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+/* The application talks to the spawner over a stream socket pair.  Each
+ * request gets a socket pair of its own, one end of which is passed to
+ * the spawner (with SCM_RIGHTS, along with the child's stdio) in a single
+ * byte message: the request is then written, and its reply read, on that
+ * private socket.  So requests need no lock, and a blocking wait holds
+ * nothing but its own socket.
+ */
+
+#define PROC_POOL_SPAWN 1
+#define PROC_POOL_WAIT  2
+
+/* The child's stdio: passed, or to be closed */
+#define PROC_POOL_FD(i)     (1 << (i))
+#define PROC_POOL_CLOSED(i) (1 << ((i) + 3))
+
+/* The resource limits */
+#define PROC_POOL_LIMIT_CPU    0x01
+#define PROC_POOL_LIMIT_MEM    0x02
+#define PROC_POOL_LIMIT_NPROC  0x04
+#define PROC_POOL_LIMIT_NOFILE 0x08
+
+typedef struct proc_pool_req_t {
+    apr_int32_t type;
+    apr_uint32_t len;          /* of the strings following */
+    /* PROC_POOL_SPAWN */
+    apr_int32_t cmdtype;
+    apr_int32_t detached;
+    apr_int32_t errchk;
+    apr_int32_t stdio;         /* PROC_POOL_FD/CLOSED */
+    apr_int32_t has_currdir;
+    apr_int32_t nargs;
+    apr_int32_t nenv;
+    apr_uid_t uid;
+    apr_gid_t gid;
+    apr_child_errfn_t *errfn;  /* valid in the spawner, a fork() */
+#if APR_HAVE_STRUCT_RLIMIT
+    apr_int32_t limits;        /* PROC_POOL_LIMIT_* */
+    struct rlimit limit[4];
+#endif
+    /* PROC_POOL_WAIT */
+    pid_t pid;
+    apr_int32_t waithow;
+} proc_pool_req_t;
+
+typedef struct proc_pool_rep_t {
+    apr_status_t status;
+    pid_t pid;
+    int exit_int;              /* as returned by waitpid() */
+} proc_pool_rep_t;
+
+struct apr_proc_pool_t {
+    apr_pool_t *pool;
+    int fd;
+    pid_t pid;
+};
+
+#ifdef MSG_NOSIGNAL
+#define PROC_POOL_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define PROC_POOL_SEND_FLAGS 0
+#endif
+
+extern char **environ;
+
+static apr_status_t send_full(int fd, const void *buf, apr_size_t len)
+{
+    const char *pos = buf;
+
+    while (len) {
+        ssize_t n = send(fd, pos, len, PROC_POOL_SEND_FLAGS);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        pos += n;
+        len -= n;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t recv_full(int fd, void *buf, apr_size_t len)
+{
+    char *pos = buf;
+
+    while (len) {
+        ssize_t n = read(fd, pos, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (n == 0) {
+            return APR_EOF;
+        }
+        pos += n;
+        len -= n;
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t make_socketpair(int sv[2])
+{
+#ifdef HAVE_SOCK_CLOEXEC
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        return errno;
+    }
+#else
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        return errno;
+    }
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+#endif
+    return APR_SUCCESS;
+}
+
+/*
+ * The spawner
+ */
+
+typedef struct spawner_child_t spawner_child_t;
+struct spawner_child_t {
+    spawner_child_t *next;     /* in the free list */
+    pid_t pid;
+    int done;
+    int exit_int;
+    int waiter;                /* reply socket of a blocking wait, or -1 */
+};
+
+typedef struct spawner_t {
+    apr_pool_t *pool;
+    apr_hash_t *children;      /* pid => spawner_child_t */
+    spawner_child_t *free;
+} spawner_t;
+
+static int sigchld_pipe[2];
+
+static void spawner_sigchld(int signo)
+{
+    int errno_saved = errno;
+    (void)write(sigchld_pipe[1], "", 1);
+    errno = errno_saved;
+}
+
+static void spawner_reply(int fd, apr_status_t status, pid_t pid,
+                          int exit_int)
+{
+    proc_pool_rep_t rep;
+
+    memset(&rep, 0, sizeof(rep));
+    rep.status = status;
+    rep.pid = pid;
+    rep.exit_int = exit_int;
+    (void)send_full(fd, &rep, sizeof(rep));
+    close(fd);
+}
+
+static void spawner_reap(spawner_t *s)
+{
+    pid_t pid;
+    int exit_int;
+
+    while ((pid = waitpid(-1, &exit_int, WNOHANG)) > 0) {
+        spawner_child_t *c = apr_hash_get(s->children, &pid, sizeof(pid));
+
+        if (!c) {
+            continue; /* the intermediate process of a detach */
+        }
+        if (c->waiter != -1) {
+            spawner_reply(c->waiter, APR_CHILD_DONE, pid, exit_int);
+            apr_hash_set(s->children, &c->pid, sizeof(c->pid), NULL);
+            c->next = s->free;
+            s->free = c;
+        }
+        else {
+            c->done = 1;
+            c->exit_int = exit_int;
+        }
+    }
+}
+
+static apr_status_t spawner_spawn(spawner_t *s, const proc_pool_req_t *req,
+                                  char *strs, int *fds, apr_pool_t *rp,
+                                  pid_t *pid)
+{
+    static apr_file_t closed_file = { NULL, -1, };
+    apr_procattr_t *attr;
+    apr_file_t *stdio[3];
+    const char **args, **env;
+    const char *cwd, *progname;
+    char **environ_saved;
+    apr_proc_t proc;
+    apr_status_t rv;
+    int i, n = 1;
+
+    rv = apr_procattr_create(&attr, rp);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    for (i = 0; i < 3; ++i) {
+        stdio[i] = NULL;
+        if (req->stdio & PROC_POOL_FD(i)) {
+            apr_os_file_put(&stdio[i], &fds[n++], 0, rp);
+        }
+        else if (req->stdio & PROC_POOL_CLOSED(i)) {
+            stdio[i] = &closed_file;
+        }
+    }
+    attr->child_in = stdio[0];
+    attr->child_out = stdio[1];
+    attr->child_err = stdio[2];
+
+    cwd = strs;
+    strs += strlen(strs) + 1;
+    progname = strs;
+    strs += strlen(strs) + 1;
+    if (req->has_currdir) {
+        attr->currdir = strs;
+        strs += strlen(strs) + 1;
+    }
+    args = apr_palloc(rp, (req->nargs + 1) * sizeof(char *));
+    for (i = 0; i < req->nargs; ++i) {
+        args[i] = strs;
+        strs += strlen(strs) + 1;
+    }
+    args[i] = NULL;
+    env = apr_palloc(rp, (req->nenv + 1) * sizeof(char *));
+    for (i = 0; i < req->nenv; ++i) {
+        env[i] = strs;
+        strs += strlen(strs) + 1;
+    }
+    env[i] = NULL;
+
+    attr->cmdtype = req->cmdtype;
+    attr->detached = req->detached;
+    attr->errchk = req->errchk;
+    attr->errfn = req->errfn;
+    attr->uid = req->uid;
+    attr->gid = req->gid;
+#if APR_HAVE_STRUCT_RLIMIT
+#ifdef RLIMIT_CPU
+    if (req->limits & PROC_POOL_LIMIT_CPU) {
+        attr->limit_cpu = apr_pmemdup(rp, &req->limit[0],
+                                      sizeof(struct rlimit));
+    }
+#endif
+#if defined(RLIMIT_DATA) || defined(RLIMIT_VMEM) || defined(RLIMIT_AS)
+    if (req->limits & PROC_POOL_LIMIT_MEM) {
+        attr->limit_mem = apr_pmemdup(rp, &req->limit[1],
+                                      sizeof(struct rlimit));
+    }
+#endif
+#ifdef RLIMIT_NPROC
+    if (req->limits & PROC_POOL_LIMIT_NPROC) {
+        attr->limit_nproc = apr_pmemdup(rp, &req->limit[2],
+                                        sizeof(struct rlimit));
+    }
+#endif
+#ifdef RLIMIT_NOFILE
+    if (req->limits & PROC_POOL_LIMIT_NOFILE) {
+        attr->limit_nofile = apr_pmemdup(rp, &req->limit[3],
+                                         sizeof(struct rlimit));
+    }
+#endif
+#endif
+
+    /* Run from the caller's directory and environment */
+    if (chdir(cwd) < 0) {
+        rv = errno;
+    }
+    else {
+        environ_saved = environ;
+        environ = (char **)env;
+        rv = apr_proc_create(&proc, progname, args, env, attr, rp);
+        environ = environ_saved;
+    }
+
+    for (i = 0; i < 3; ++i) {
+        if (stdio[i] && stdio[i]->filedes != -1) {
+            apr_file_close(stdio[i]);
+        }
+    }
+
+    if (rv == APR_SUCCESS) {
+        spawner_child_t *c = s->free;
+
+        if (c) {
+            s->free = c->next;
+        }
+        else {
+            c = apr_palloc(s->pool, sizeof(*c));
+        }
+        c->pid = proc.pid;
+        c->done = 0;
+        c->waiter = -1;
+        apr_hash_set(s->children, &c->pid, sizeof(c->pid), c);
+        *pid = proc.pid;
+    }
+    return rv;
+}
+
+static void spawner_wait(spawner_t *s, const proc_pool_req_t *req, int fd)
+{
+    spawner_child_t *c;
+    pid_t pid = req->pid;
+
+    spawner_reap(s);
+
+    c = apr_hash_get(s->children, &pid, sizeof(pid));
+    if (!c) {
+        spawner_reply(fd, APR_FROM_OS_ERROR(ECHILD), pid, 0);
+    }
+    else if (c->done) {
+        spawner_reply(fd, APR_CHILD_DONE, pid, c->exit_int);
+        apr_hash_set(s->children, &c->pid, sizeof(c->pid), NULL);
+        c->next = s->free;
+        s->free = c;
+    }
+    else if (c->waiter != -1) {
+        spawner_reply(fd, APR_EBUSY, pid, 0);
+    }
+    else if (req->waithow != APR_WAIT) {
+        spawner_reply(fd, APR_CHILD_NOTDONE, pid, 0);
+    }
+    else {
+        c->waiter = fd; /* replied by spawner_reap() */
+    }
+}
+
+/* Serve a request, returns APR_EOF when the application is gone */
+static apr_status_t spawner_serve(spawner_t *s, int ctl)
+{
+    union {
+        struct cmsghdr cm;
+        char buf[CMSG_SPACE(4 * sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    proc_pool_req_t req;
+    apr_pool_t *rp;
+    char byte, *strs;
+    int fds[4], nfds = 0, i;
+    ssize_t n;
+    pid_t pid = 0;
+    apr_status_t rv;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    do {
+        n = recvmsg(ctl, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return APR_EOF;
+    }
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+        }
+    }
+    if (nfds == 0) {
+        return APR_SUCCESS;
+    }
+    for (i = 0; i < nfds; ++i) {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    apr_pool_create(&rp, s->pool);
+    rv = recv_full(fds[0], &req, sizeof(req));
+    if (rv == APR_SUCCESS) {
+        strs = apr_palloc(rp, req.len + 1);
+        rv = recv_full(fds[0], strs, req.len);
+        strs[req.len] = '\0';
+    }
+    if (rv != APR_SUCCESS) {
+        for (i = 0; i < nfds; ++i) {
+            close(fds[i]);
+        }
+    }
+    else if (req.type == PROC_POOL_WAIT) {
+        for (i = 1; i < nfds; ++i) {
+            close(fds[i]);
+        }
+        spawner_wait(s, &req, fds[0]);
+    }
+    else {
+        rv = spawner_spawn(s, &req, strs, fds, rp, &pid);
+        spawner_reply(fds[0], rv, pid, 0);
+    }
+    apr_pool_destroy(rp);
+
+    return APR_SUCCESS;
+}
+
+static void spawner_main(int ctl)
+{
+    struct sigaction sa;
+    sigset_t sigset;
+    spawner_t s;
+
+    if (apr_pool_create_unmanaged_ex(&s.pool, NULL, NULL) != APR_SUCCESS) {
+        return;
+    }
+    s.children = apr_hash_make(s.pool);
+    s.free = NULL;
+
+    if (pipe(sigchld_pipe) < 0) {
+        return;
+    }
+    fcntl(sigchld_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sigchld_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(sigchld_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(sigchld_pipe[1], F_SETFL, O_NONBLOCK);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = spawner_sigchld;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &sigset, NULL);
+
+    for (;;) {
+        struct pollfd pfd[2];
+
+        pfd[0].fd = ctl;
+        pfd[0].events = POLLIN;
+        pfd[0].revents = 0;
+        pfd[1].fd = sigchld_pipe[0];
+        pfd[1].events = POLLIN;
+        pfd[1].revents = 0;
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfd[1].revents) {
+            char buf[64];
+
+            while (read(sigchld_pipe[0], buf, sizeof(buf)) > 0)
+                ;
+            spawner_reap(&s);
+        }
+        if (pfd[0].revents && spawner_serve(&s, ctl) == APR_EOF) {
+            break;
+        }
+    }
+}
+
+/*
+ * The application side
+ */
+
+static apr_status_t proc_pool_request(apr_proc_pool_t *proc_pool,
+                                      const void *buf, apr_size_t len,
+                                      const int *stdio, int nstdio,
+                                      proc_pool_rep_t *rep)
+{
+    union {
+        struct cmsghdr cm;
+        char buf[CMSG_SPACE(4 * sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    char byte = 0;
+    int sv[2], fds[4], i;
+    ssize_t n;
+    apr_status_t rv;
+
+    rv = make_socketpair(sv);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    fds[0] = sv[1];
+    for (i = 0; i < nstdio; ++i) {
+        fds[i + 1] = stdio[i];
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE((nstdio + 1) * sizeof(int));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN((nstdio + 1) * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, (nstdio + 1) * sizeof(int));
+
+    /* A one byte message is never split, so requests of several threads
+     * do not mix on the spawner's socket.
+     */
+    do {
+        n = sendmsg(proc_pool->fd, &msg, PROC_POOL_SEND_FLAGS);
+    } while (n < 0 && errno == EINTR);
+    rv = (n < 0) ? errno : APR_SUCCESS;
+    close(sv[1]);
+
+    if (rv == APR_SUCCESS) {
+        rv = send_full(sv[0], buf, len);
+    }
+    if (rv == APR_SUCCESS) {
+        rv = recv_full(sv[0], rep, sizeof(*rep));
+    }
+    close(sv[0]);
+
+    if (rv == EPIPE || rv == ECONNRESET) {
+        rv = APR_EOF;
+    }
+    return rv;
+}
+
+static apr_status_t proc_pool_cleanup(void *data)
+{
+    apr_proc_pool_t *proc_pool = data;
+    pid_t pid;
+
+    /* The spawner exits when its socket is closed */
+    close(proc_pool->fd);
+    do {
+        pid = waitpid(proc_pool->pid, NULL, 0);
+    } while (pid < 0 && errno == EINTR);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_proc_pool_create(apr_proc_pool_t **proc_pool,
+                                               apr_pool_t *p)
+{
+    apr_proc_pool_t *pp;
+    int sv[2];
+    pid_t pid;
+    apr_status_t rv;
+
+    rv = make_socketpair(sv);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    if ((pid = fork()) < 0) {
+        rv = errno;
+        close(sv[0]);
+        close(sv[1]);
+        return rv;
+    }
+    if (pid == 0) {
+        /* the spawner */
+        close(sv[0]);
+        apr_pool_cleanup_for_exec();
+        spawner_main(sv[1]);
+        _exit(0);
+    }
+    close(sv[1]);
+
+    pp = apr_pcalloc(p, sizeof(*pp));
+    pp->pool = p;
+    pp->fd = sv[0];
+    pp->pid = pid;
+    apr_pool_cleanup_register(p, pp, proc_pool_cleanup,
+                              apr_pool_cleanup_null);
+
+    *proc_pool = pp;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_proc_pool_spawn(apr_proc_pool_t *proc_pool,
+                                              apr_proc_t *new,
+                                              const char *progname,
+                                              const char * const *args,
+                                              const char * const *env,
+                                              apr_procattr_t *attr,
+                                              apr_pool_t *p)
+{
+    apr_file_t *stdio[3];
+    proc_pool_req_t *req;
+    proc_pool_rep_t rep;
+    const char * const empty_envp[] = {NULL};
+    char *cwd, *buf, *pos;
+    apr_size_t len;
+    int fds[3], nfds = 0, i;
+    apr_status_t rv;
+
+    if (attr->perms_set_callbacks) {
+        return APR_ENOTIMPL;
+    }
+
+    rv = apr_filepath_get(&cwd, APR_FILEPATH_NATIVE, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    if (attr->cmdtype == APR_PROGRAM_ENV
+            || attr->cmdtype == APR_PROGRAM_PATH
+            || attr->cmdtype == APR_SHELLCMD_ENV) {
+        env = (const char * const *)environ;
+    }
+    else if (!env) {
+        env = empty_envp;
+    }
+
+    len = strlen(cwd) + 1 + strlen(progname) + 1;
+    if (attr->currdir) {
+        len += strlen(attr->currdir) + 1;
+    }
+    for (i = 0; args[i]; ++i) {
+        len += strlen(args[i]) + 1;
+    }
+    for (i = 0; env[i]; ++i) {
+        len += strlen(env[i]) + 1;
+    }
+
+    buf = apr_pcalloc(p, sizeof(*req) + len);
+    req = (proc_pool_req_t *)buf;
+    req->type = PROC_POOL_SPAWN;
+    req->len = len;
+    req->cmdtype = attr->cmdtype;
+    req->detached = attr->detached;
+    req->errchk = attr->errchk;
+    req->has_currdir = (attr->currdir != NULL);
+    req->uid = attr->uid;
+    req->gid = attr->gid;
+    req->errfn = attr->errfn;
+#if APR_HAVE_STRUCT_RLIMIT
+#ifdef RLIMIT_CPU
+    if (attr->limit_cpu) {
+        req->limits |= PROC_POOL_LIMIT_CPU;
+        req->limit[0] = *attr->limit_cpu;
+    }
+#endif
+#if defined(RLIMIT_DATA) || defined(RLIMIT_VMEM) || defined(RLIMIT_AS)
+    if (attr->limit_mem) {
+        req->limits |= PROC_POOL_LIMIT_MEM;
+        req->limit[1] = *attr->limit_mem;
+    }
+#endif
+#ifdef RLIMIT_NPROC
+    if (attr->limit_nproc) {
+        req->limits |= PROC_POOL_LIMIT_NPROC;
+        req->limit[2] = *attr->limit_nproc;
+    }
+#endif
+#ifdef RLIMIT_NOFILE
+    if (attr->limit_nofile) {
+        req->limits |= PROC_POOL_LIMIT_NOFILE;
+        req->limit[3] = *attr->limit_nofile;
+    }
+#endif
+#endif
+
+    stdio[0] = attr->child_in;
+    stdio[1] = attr->child_out;
+    stdio[2] = attr->child_err;
+    for (i = 0; i < 3; ++i) {
+        if (!stdio[i]) {
+            continue;
+        }
+        if (stdio[i]->filedes == -1) {
+            req->stdio |= PROC_POOL_CLOSED(i);
+        }
+        else {
+            req->stdio |= PROC_POOL_FD(i);
+            fds[nfds++] = stdio[i]->filedes;
+        }
+    }
+
+    pos = buf + sizeof(*req);
+    pos = apr_cpystrn(pos, cwd, len) + 1;
+    pos = apr_cpystrn(pos, progname, len) + 1;
+    if (attr->currdir) {
+        pos = apr_cpystrn(pos, attr->currdir, len) + 1;
+    }
+    for (i = 0; args[i]; ++i) {
+        pos = apr_cpystrn(pos, args[i], len) + 1;
+    }
+    req->nargs = i;
+    for (i = 0; env[i]; ++i) {
+        pos = apr_cpystrn(pos, env[i], len) + 1;
+    }
+    req->nenv = i;
+
+    rv = proc_pool_request(proc_pool, buf, sizeof(*req) + len,
+                           fds, nfds, &rep);
+    if (rv == APR_SUCCESS) {
+        rv = rep.status;
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    new->pid = rep.pid;
+    new->in = attr->parent_in;
+    new->out = attr->parent_out;
+    new->err = attr->parent_err;
+
+    /* As apr_proc_create(), the child's ends are closed in the parent */
+    for (i = 0; i < 3; ++i) {
+        if (stdio[i] && stdio[i]->filedes != -1) {
+            apr_file_close(stdio[i]);
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_proc_pool_wait(apr_proc_pool_t *proc_pool,
+                                             apr_proc_t *proc,
+                                             int *exitcode,
+                                             apr_exit_why_e *exitwhy,
+                                             apr_wait_how_e waithow)
+{
+    proc_pool_req_t req;
+    proc_pool_rep_t rep;
+    apr_status_t rv;
+
+    memset(&req, 0, sizeof(req));
+    req.type = PROC_POOL_WAIT;
+    req.pid = proc->pid;
+    req.waithow = waithow;
+
+    rv = proc_pool_request(proc_pool, &req, sizeof(req), NULL, 0, &rep);
+    if (rv == APR_SUCCESS) {
+        rv = rep.status;
+    }
+    if (rv != APR_CHILD_DONE) {
+        return rv;
+    }
+
+    if (WIFEXITED(rep.exit_int)) {
+        if (exitwhy) {
+            *exitwhy = APR_PROC_EXIT;
+        }
+        if (exitcode) {
+            *exitcode = WEXITSTATUS(rep.exit_int);
+        }
+    }
+    else if (WIFSIGNALED(rep.exit_int)) {
+        if (exitwhy) {
+            *exitwhy = APR_PROC_SIGNAL;
+#ifdef WCOREDUMP
+            if (WCOREDUMP(rep.exit_int)) {
+                *exitwhy |= APR_PROC_SIGNAL_CORE;
+            }
+#endif
+        }
+        if (exitcode) {
+            *exitcode = WTERMSIG(rep.exit_int);
+        }
+    }
+    else {
+        /* unexpected condition */
+        return APR_EGENERAL;
+    }
+
+    return APR_CHILD_DONE;
+}
+
+#endif /* APR_HAS_FORK */
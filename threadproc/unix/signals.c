@@ -20,6 +20,7 @@
 #include "apr_pools.h"
 #include "apr_signal.h"
 #include "apr_strings.h"
+#include "apr_atomic.h"
 
 #include <assert.h>
 #if APR_HAS_THREADS && APR_HAVE_PTHREAD_H
@@ -134,6 +135,10 @@ const char *apr_signal_description_get(int signum)
 #endif
 
 static const char *signal_description[APR_NUMSIG];
+static char signal_number[APR_NUMSIG][sizeof("signal #") + 4];
+
+/* 0: not described yet, 1: being described, 2: described */
+static apr_uint32_t signal_described;
 
 #define store_desc(index, string) \
         do { \
@@ -145,7 +150,7 @@ static const char *signal_description[APR_NUMSIG];
             } \
         } while (0)
 
-void apr_signal_init(apr_pool_t *pglobal)
+static void signal_describe(void)
 {
     int sig;
 
@@ -255,16 +260,39 @@ void apr_signal_init(apr_pool_t *pglobal)
 #endif
 
     for (sig = 0; sig < APR_NUMSIG; ++sig)
-        if (signal_description[sig] == NULL)
-            signal_description[sig] = apr_psprintf(pglobal, "signal #%d", sig);
+        if (signal_description[sig] == NULL) {
+            apr_snprintf(signal_number[sig], sizeof(signal_number[sig]),
+                         "signal #%d", sig);
+            signal_description[sig] = signal_number[sig];
+        }
+}
+
+void apr_signal_init(apr_pool_t *pglobal)
+{
+    /* The descriptions are built by the first apr_signal_description_get() */
 }
 
 const char *apr_signal_description_get(int signum)
 {
-    return
-        (signum >= 0 && signum < APR_NUMSIG)
-        ? signal_description[signum]
-        : "unknown signal (number)";
+    if (signum < 0 || signum >= APR_NUMSIG) {
+        return "unknown signal (number)";
+    }
+
+    if (apr_atomic_read32(&signal_described) != 2) {
+        if (apr_atomic_cas32(&signal_described, 1, 0) == 0) {
+            signal_describe();
+            apr_atomic_set32(&signal_described, 2);
+        }
+        else {
+            while (apr_atomic_read32(&signal_described) != 2) {
+#if APR_HAS_THREADS
+                apr_thread_yield();
+#endif
+            }
+        }
+    }
+
+    return signal_description[signum];
 }
 
 #endif /* SYS_SIGLIST_DECLARED || HAVE_DECL_SYS_SIGLIST */
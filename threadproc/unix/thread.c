@@ -22,12 +22,73 @@
 
 #if APR_HAVE_PTHREAD_H
 
+/* The threads (and pools) kept by a threadattr for reuse.  The cache is
+ * referenced by the threadattr and by each running thread created from
+ * it, since a detached thread may well exit after the threadattr's pool
+ * is gone; the last one to leave frees it.
+ */
+struct apr_thread_cache_t {
+    pthread_mutex_t mutex;
+    apr_thread_t *list;
+    apr_size_t count;
+    apr_size_t max;
+    apr_size_t refs;
+};
+
+static void thread_cache_free(struct apr_thread_cache_t *cache)
+{
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+static void thread_cache_release(struct apr_thread_cache_t *cache)
+{
+    int last;
+
+    pthread_mutex_lock(&cache->mutex);
+    last = (--cache->refs == 0);
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (last) {
+        thread_cache_free(cache);
+    }
+}
+
+/* Keep no more than max threads in the cache */
+static void thread_cache_trim(struct apr_thread_cache_t *cache,
+                              apr_size_t max)
+{
+    apr_thread_t *list = NULL, *thd;
+
+    pthread_mutex_lock(&cache->mutex);
+    cache->max = max;
+    while (cache->count > max) {
+        thd = cache->list;
+        cache->list = thd->next;
+        cache->count--;
+        thd->next = list;
+        list = thd;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    while ((thd = list) != NULL) {
+        list = thd->next;
+        apr_pool_destroy(thd->pool);
+    }
+}
+
 /* Destroy the threadattr object */
 static apr_status_t threadattr_cleanup(void *data)
 {
     apr_threadattr_t *attr = data;
     apr_status_t rv;
 
+    if (attr->cache) {
+        thread_cache_trim(attr->cache, 0);
+        thread_cache_release(attr->cache);
+        attr->cache = NULL;
+    }
+
     rv = pthread_attr_destroy(&attr->attr);
 #ifdef HAVE_ZOS_PTHREADS
     if (rv) {
@@ -42,7 +103,7 @@ APR_DECLARE(apr_status_t) apr_threadattr_create(apr_threadattr_t **new,
 {
     apr_status_t stat;
 
-    (*new) = apr_palloc(pool, sizeof(apr_threadattr_t));
+    (*new) = apr_pcalloc(pool, sizeof(apr_threadattr_t));
     (*new)->pool = pool;
     stat = pthread_attr_init(&(*new)->attr);
 
@@ -143,10 +204,102 @@ APR_DECLARE(apr_status_t) apr_threadattr_max_free_set(apr_threadattr_t *attr,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_threadattr_cache_set(apr_threadattr_t *attr,
+                                                   apr_size_t max)
+{
+    struct apr_thread_cache_t *cache = attr->cache;
+
+    if (!cache) {
+        if (!max) {
+            return APR_SUCCESS;
+        }
+        cache = calloc(1, sizeof(*cache));
+        if (!cache) {
+            return APR_ENOMEM;
+        }
+        pthread_mutex_init(&cache->mutex, NULL);
+        cache->refs = 1;
+        attr->cache = cache;
+    }
+    thread_cache_trim(cache, max);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_threadattr_affinity_set(apr_threadattr_t *attr,
+                                                      const int *cpus,
+                                                      int ncpus)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+    cpu_set_t set;
+    int i, rv;
+
+    CPU_ZERO(&set);
+    if (ncpus <= 0) {
+        for (i = 0; i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &set);
+        }
+    }
+    for (i = 0; i < ncpus; i++) {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
+            return APR_EINVAL;
+        }
+        CPU_SET(cpus[i], &set);
+    }
+
+    rv = pthread_attr_setaffinity_np(&attr->attr, sizeof(set), &set);
+    if (rv == 0) {
+        return APR_SUCCESS;
+    }
+    return rv;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
 #if APR_HAS_THREAD_LOCAL
 static APR_THREAD_LOCAL apr_thread_t *current_thread = NULL;
 #endif
 
+/* Done with the thread, give its pool back to the cache if any */
+static void free_thread(apr_thread_t *thd)
+{
+    struct apr_thread_cache_t *cache = thd->cache;
+    apr_pool_t *p = thd->pool;
+    int last;
+
+    if (!cache) {
+        apr_pool_destroy(p);
+        return;
+    }
+
+    /* Make the thread ready for the next apr_thread_create() now, with
+     * everything allocated from its cleared pool.
+     */
+    apr_pool_owner_set(p, 0);
+    apr_pool_clear(p);
+    thd = apr_pcalloc(p, sizeof(apr_thread_t));
+    thd->td = apr_pcalloc(p, sizeof(pthread_t));
+    thd->pool = p;
+
+    pthread_mutex_lock(&cache->mutex);
+    if (cache->count < cache->max) {
+        thd->next = cache->list;
+        cache->list = thd;
+        cache->count++;
+        p = NULL;
+    }
+    last = (--cache->refs == 0);
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (p) {
+        apr_pool_destroy(p);
+    }
+    if (last) {
+        thread_cache_free(cache);
+    }
+}
+
 static void *dummy_worker(void *opaque)
 {
     apr_thread_t *thread = (apr_thread_t*)opaque;
@@ -159,7 +312,7 @@ static void *dummy_worker(void *opaque)
     apr_pool_owner_set(thread->pool, 0);
     ret = thread->func(thread, thread->data);
     if (thread->detached) {
-        apr_pool_destroy(thread->pool);
+        free_thread(thread);
     }
 
     return ret;
@@ -172,8 +325,36 @@ static apr_status_t alloc_thread(apr_thread_t **new,
 {
     apr_status_t stat;
     apr_abortfunc_t abort_fn = apr_pool_abort_get(pool);
+    struct apr_thread_cache_t *cache = NULL;
     apr_pool_t *p;
 
+    /* Reuse an exited thread if the threadattr keeps them (not for the
+     * current thread which never exits as far as APR is concerned).
+     */
+    if (func && attr && attr->cache) {
+        cache = attr->cache;
+
+        pthread_mutex_lock(&cache->mutex);
+        *new = cache->list;
+        if (*new) {
+            cache->list = (*new)->next;
+            cache->count--;
+        }
+        cache->refs++;
+        pthread_mutex_unlock(&cache->mutex);
+
+        if (*new) {
+            p = (*new)->pool;
+            apr_pool_abort_set(abort_fn, p);
+            if (attr->max_free) {
+                apr_allocator_max_free_set(apr_pool_allocator_get(p),
+                                           attr->max_free);
+            }
+            (*new)->next = NULL;
+            goto init;
+        }
+    }
+
     /* The thread can be detached anytime (from the creation or later with
      * apr_thread_detach), so it needs its own pool and allocator to not
      * depend on a parent pool which could be destroyed before the thread
@@ -183,7 +364,7 @@ static apr_status_t alloc_thread(apr_thread_t **new,
      */
     stat = apr_pool_create_unmanaged_ex(&p, abort_fn, NULL);
     if (stat != APR_SUCCESS) {
-        return stat;
+        goto failed;
     }
     if (attr && attr->max_free) {
         apr_allocator_max_free_set(apr_pool_allocator_get(p), attr->max_free);
@@ -192,20 +373,30 @@ static apr_status_t alloc_thread(apr_thread_t **new,
     (*new) = (apr_thread_t *)apr_pcalloc(p, sizeof(apr_thread_t));
     if ((*new) == NULL) {
         apr_pool_destroy(p);
-        return APR_ENOMEM;
+        stat = APR_ENOMEM;
+        goto failed;
     }
-
     (*new)->pool = p;
-    (*new)->data = data;
-    (*new)->func = func;
-    (*new)->detached = (attr && apr_threadattr_detach_get(attr) == APR_DETACH);
     (*new)->td = (pthread_t *)apr_pcalloc(p, sizeof(pthread_t));
     if ((*new)->td == NULL) {
         apr_pool_destroy(p);
-        return APR_ENOMEM;
+        stat = APR_ENOMEM;
+        goto failed;
     }
 
+init:
+    (*new)->data = data;
+    (*new)->func = func;
+    (*new)->detached = (attr && apr_threadattr_detach_get(attr) == APR_DETACH);
+    (*new)->cache = cache;
+
     return APR_SUCCESS;
+
+failed:
+    if (cache) {
+        thread_cache_release(cache);
+    }
+    return stat;
 }
 
 APR_DECLARE(apr_status_t) apr_thread_create(apr_thread_t **new,
@@ -231,7 +422,7 @@ APR_DECLARE(apr_status_t) apr_thread_create(apr_thread_t **new,
 #ifdef HAVE_ZOS_PTHREADS
         stat = errno;
 #endif
-        apr_pool_destroy((*new)->pool);
+        free_thread(*new);
         return stat;
     }
 
@@ -295,7 +486,7 @@ APR_DECLARE(void) apr_thread_exit(apr_thread_t *thd,
 {
     thd->exitval = retval;
     if (thd->detached) {
-        apr_pool_destroy(thd->pool);
+        free_thread(thd);
     }
     pthread_exit(NULL);
 }
@@ -318,7 +509,7 @@ APR_DECLARE(apr_status_t) apr_thread_join(apr_status_t *retval,
     }
 
     *retval = thd->exitval;
-    apr_pool_destroy(thd->pool);
+    free_thread(thd);
     return APR_SUCCESS;
 }
 
@@ -363,6 +554,40 @@ APR_DECLARE(void) apr_thread_yield(void)
 #endif
 }
 
+/* Linux' TASK_COMM_LEN, including the terminating NUL */
+#define THREAD_NAME_MAX 16
+
+APR_DECLARE(apr_status_t) apr_thread_name_set(const char *name,
+                                              apr_thread_t *thread,
+                                              apr_pool_t *pool)
+{
+#ifdef HAVE_PTHREAD_SETNAME_NP
+    pthread_t td;
+    apr_size_t name_len;
+
+    if (!name) {
+        return APR_BADARG;
+    }
+
+    if (thread) {
+        td = *thread->td;
+    }
+    else {
+        td = pthread_self();
+    }
+
+    /* Keep the end of long names, usually the most specific part */
+    name_len = strlen(name);
+    if (name_len >= THREAD_NAME_MAX) {
+        name += name_len - THREAD_NAME_MAX + 1;
+    }
+
+    return pthread_setname_np(td, name);
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_thread_data_get(void **data, const char *key,
                                               apr_thread_t *thread)
 {
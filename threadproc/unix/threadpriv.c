@@ -17,14 +17,99 @@
 #include "apr.h"
 #include "apr_portable.h"
 #include "apr_arch_threadproc.h"
+#include "apr_atomic.h"
 
 #if APR_HAS_THREADS
 
 #if APR_HAVE_PTHREAD_H
+
+#if APR_HAS_THREAD_LOCAL
+/* The values of the first keys are cached in thread local cells, so that
+ * apr_threadkey_private_get() is a TLS load rather than a call into the
+ * thread library.  The pthread keys still hold the values (for
+ * apr_os_threadkey_get() users) and run the destructors, through one
+ * trampoline per slot which clears the cell first.  A cell is valid for
+ * the key whose generation it holds, so that the slot of a deleted key can
+ * be reused without visiting the threads.
+ */
+#define THREADKEY_SLOTS 32
+
+typedef struct {
+    void *value;
+    apr_uint32_t gen;
+} threadkey_cell_t;
+
+static APR_THREAD_LOCAL threadkey_cell_t threadkey_cells[THREADKEY_SLOTS];
+
+static apr_uint32_t threadkey_used;
+static apr_uint32_t threadkey_gens[THREADKEY_SLOTS];
+static void (*threadkey_dests[THREADKEY_SLOTS])(void *);
+
+static void threadkey_dest(int slot, void *value)
+{
+    threadkey_cells[slot].value = NULL;
+    threadkey_dests[slot](value);
+}
+
+#define THREADKEY_DEST(n) \
+    static void threadkey_dest_##n(void *value) \
+    { \
+        threadkey_dest(n, value); \
+    }
+THREADKEY_DEST(0) THREADKEY_DEST(1) THREADKEY_DEST(2) THREADKEY_DEST(3)
+THREADKEY_DEST(4) THREADKEY_DEST(5) THREADKEY_DEST(6) THREADKEY_DEST(7)
+THREADKEY_DEST(8) THREADKEY_DEST(9) THREADKEY_DEST(10) THREADKEY_DEST(11)
+THREADKEY_DEST(12) THREADKEY_DEST(13) THREADKEY_DEST(14) THREADKEY_DEST(15)
+THREADKEY_DEST(16) THREADKEY_DEST(17) THREADKEY_DEST(18) THREADKEY_DEST(19)
+THREADKEY_DEST(20) THREADKEY_DEST(21) THREADKEY_DEST(22) THREADKEY_DEST(23)
+THREADKEY_DEST(24) THREADKEY_DEST(25) THREADKEY_DEST(26) THREADKEY_DEST(27)
+THREADKEY_DEST(28) THREADKEY_DEST(29) THREADKEY_DEST(30) THREADKEY_DEST(31)
+
+static void (* const threadkey_trampolines[THREADKEY_SLOTS])(void *) = {
+    threadkey_dest_0, threadkey_dest_1, threadkey_dest_2, threadkey_dest_3,
+    threadkey_dest_4, threadkey_dest_5, threadkey_dest_6, threadkey_dest_7,
+    threadkey_dest_8, threadkey_dest_9, threadkey_dest_10, threadkey_dest_11,
+    threadkey_dest_12, threadkey_dest_13, threadkey_dest_14, threadkey_dest_15,
+    threadkey_dest_16, threadkey_dest_17, threadkey_dest_18, threadkey_dest_19,
+    threadkey_dest_20, threadkey_dest_21, threadkey_dest_22, threadkey_dest_23,
+    threadkey_dest_24, threadkey_dest_25, threadkey_dest_26, threadkey_dest_27,
+    threadkey_dest_28, threadkey_dest_29, threadkey_dest_30, threadkey_dest_31
+};
+
+static int threadkey_slot_alloc(void)
+{
+    apr_uint32_t used, slot;
+
+    do {
+        used = apr_atomic_read32(&threadkey_used);
+        if (used == 0xffffffffU) {
+            return -1;
+        }
+        for (slot = 0; used & (1U << slot); slot++)
+            ;
+    } while (apr_atomic_cas32(&threadkey_used, used | (1U << slot),
+                              used) != used);
+
+    return slot;
+}
+
+static void threadkey_slot_free(int slot)
+{
+    apr_uint32_t used;
+
+    do {
+        used = apr_atomic_read32(&threadkey_used);
+    } while (apr_atomic_cas32(&threadkey_used, used & ~(1U << slot),
+                              used) != used);
+}
+#endif /* APR_HAS_THREAD_LOCAL */
+
 APR_DECLARE(apr_status_t) apr_threadkey_private_create(apr_threadkey_t **key,
                                                        void (*dest)(void *),
                                                        apr_pool_t *pool)
 {
+    apr_status_t stat;
+
     (*key) = (apr_threadkey_t *)apr_pcalloc(pool, sizeof(apr_threadkey_t));
 
     if ((*key) == NULL) {
@@ -32,20 +117,62 @@ APR_DECLARE(apr_status_t) apr_threadkey_private_create(apr_threadkey_t **key,
     }
 
     (*key)->pool = pool;
+    (*key)->slot = -1;
+
+#if APR_HAS_THREAD_LOCAL
+    (*key)->slot = threadkey_slot_alloc();
+    if ((*key)->slot >= 0) {
+        int slot = (*key)->slot;
+
+        /* Zero initialized cells never match */
+        (*key)->gen = ++threadkey_gens[slot];
+        if (!(*key)->gen) {
+            (*key)->gen = ++threadkey_gens[slot];
+        }
+        threadkey_dests[slot] = dest;
+        if (dest) {
+            dest = threadkey_trampolines[slot];
+        }
+    }
+#endif
 
-    return pthread_key_create(&(*key)->key, dest);
+    stat = pthread_key_create(&(*key)->key, dest);
+#if APR_HAS_THREAD_LOCAL
+    if (stat && (*key)->slot >= 0) {
+        threadkey_slot_free((*key)->slot);
+    }
+#endif
 
+    return stat;
 }
 
 APR_DECLARE(apr_status_t) apr_threadkey_private_get(void **new,
                                                     apr_threadkey_t *key)
 {
+#if APR_HAS_THREAD_LOCAL
+    if (key->slot >= 0) {
+        threadkey_cell_t *cell = &threadkey_cells[key->slot];
+
+        if (cell->gen == key->gen) {
+            *new = cell->value;
+            return APR_SUCCESS;
+        }
+    }
+#endif
+
 #ifdef PTHREAD_GETSPECIFIC_TAKES_TWO_ARGS
     if (pthread_getspecific(key->key,new))
        *new = NULL;
 #else
     (*new) = pthread_getspecific(key->key);
 #endif
+
+#if APR_HAS_THREAD_LOCAL
+    if (key->slot >= 0) {
+        threadkey_cells[key->slot].value = *new;
+        threadkey_cells[key->slot].gen = key->gen;
+    }
+#endif
     return APR_SUCCESS;
 }
 
@@ -55,6 +182,12 @@ APR_DECLARE(apr_status_t) apr_threadkey_private_set(void *priv,
     apr_status_t stat;
 
     if ((stat = pthread_setspecific(key->key, priv)) == 0) {
+#if APR_HAS_THREAD_LOCAL
+        if (key->slot >= 0) {
+            threadkey_cells[key->slot].value = priv;
+            threadkey_cells[key->slot].gen = key->gen;
+        }
+#endif
         return APR_SUCCESS;
     }
     else {
@@ -68,6 +201,12 @@ APR_DECLARE(apr_status_t) apr_threadkey_private_delete(apr_threadkey_t *key)
     apr_status_t stat;
 
     if ((stat = pthread_key_delete(key->key)) == 0) {
+#if APR_HAS_THREAD_LOCAL
+        if (key->slot >= 0) {
+            threadkey_slot_free(key->slot);
+            key->slot = -1;
+        }
+#endif
         return APR_SUCCESS;
     }
 
@@ -111,6 +250,7 @@ APR_DECLARE(apr_status_t) apr_os_threadkey_put(apr_threadkey_t **key,
     }
 
     (*key)->key = *thekey;
+    (*key)->slot = -1;
     return APR_SUCCESS;
 }
 #endif /* APR_HAVE_PTHREAD_H */
@@ -19,6 +19,7 @@
 #include "apr_lib.h"
 #include "apr_private.h"
 #include "apr_strings.h"
+#include "apr_atomic.h"
 
 /* private APR headers */
 #include "apr_arch_internal_time.h"
@@ -38,6 +39,10 @@
 #if !defined(HAVE_STRUCT_TM_TM_GMTOFF) && !defined(HAVE_STRUCT_TM___TM_GMTOFF)
 static apr_int32_t server_gmt_offset;
 #define NO_GMTOFF_IN_STRUCT_TM
+#if !defined(NETWARE)
+/* server_gmt_offset is computed on first use, not by apr_initialize() */
+static apr_uint32_t server_gmt_offset_set;
+#endif
 #endif          
 
 static apr_int32_t get_offset(struct tm *tm)
@@ -56,6 +61,9 @@ static apr_int32_t get_offset(struct tm *tm)
         return server_gmt_offset + daylightOffset;
     }
 #else
+    if (!apr_atomic_read32(&server_gmt_offset_set)) {
+        apr_unix_setup_time();
+    }
     if (tm->tm_isdst)
         return server_gmt_offset + 3600;
 #endif
@@ -78,41 +86,143 @@ APR_DECLARE(apr_time_t) apr_time_now(void)
     return tv.tv_sec * (apr_time_t)APR_USEC_PER_SEC + (apr_time_t)tv.tv_usec;
 }
 
-static void explode_time(apr_time_exp_t *xt, apr_time_t t,
-                         apr_int32_t offset, int use_localtime)
+APR_DECLARE(apr_time_t) apr_time_now_coarse(void)
 {
-    struct tm tm;
-    time_t tt = (t / APR_USEC_PER_SEC) + offset;
-    xt->tm_usec = t % APR_USEC_PER_SEC;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_REALTIME_COARSE)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0) {
+        return ts.tv_sec * (apr_time_t)APR_USEC_PER_SEC
+               + (apr_time_t)(ts.tv_nsec / 1000);
+    }
+#endif
+    return apr_time_now();
+}
 
-#if APR_HAS_THREADS && defined (_POSIX_THREAD_SAFE_FUNCTIONS)
-    if (use_localtime)
-        localtime_r(&tt, &tm);
-    else
-        gmtime_r(&tt, &tm);
+APR_DECLARE(apr_interval_time_t) apr_time_monotonic(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return ts.tv_sec * (apr_interval_time_t)APR_USEC_PER_SEC
+               + (apr_interval_time_t)(ts.tv_nsec / 1000);
+    }
+#endif
+    return apr_time_now();
+}
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define TIME_CYCLES_TSC
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define TIME_CYCLES_CNTVCT
+#elif defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+#define TIME_CYCLES_NSEC
+#endif
+
+APR_DECLARE(apr_uint64_t) apr_time_cycles(void)
+{
+#if defined(TIME_CYCLES_TSC)
+    apr_uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((apr_uint64_t)hi << 32) | lo;
+#elif defined(TIME_CYCLES_CNTVCT)
+    apr_uint64_t cnt;
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(cnt) :: "memory");
+    return cnt;
+#elif defined(TIME_CYCLES_NSEC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * APR_UINT64_C(1000000000) + ts.tv_nsec;
+#else
+    return (apr_uint64_t)apr_time_monotonic();
+#endif
+}
+
+#ifdef TIME_CYCLES_TSC
+static apr_uint64_t time_cycles_rate;
+#endif
+
+APR_DECLARE(apr_uint64_t) apr_time_cycles_per_sec(void)
+{
+#if defined(TIME_CYCLES_TSC)
+    apr_uint64_t rate = apr_atomic_read64(&time_cycles_rate);
+
+    if (!rate) {
+        /* Concurrent first calls calibrate as well, the last one wins */
+        apr_interval_time_t t0, t1;
+        apr_uint64_t c0, c1;
+
+        t0 = apr_time_monotonic();
+        c0 = apr_time_cycles();
+        apr_sleep(apr_time_from_msec(10));
+        t1 = apr_time_monotonic();
+        c1 = apr_time_cycles();
+        if (t1 <= t0) {
+            t1 = t0 + 1;
+        }
+        rate = (c1 - c0) * APR_USEC_PER_SEC / (apr_uint64_t)(t1 - t0);
+        if (!rate) {
+            rate = 1;
+        }
+        apr_atomic_set64(&time_cycles_rate, rate);
+    }
+    return rate;
+#elif defined(TIME_CYCLES_CNTVCT)
+    apr_uint64_t freq;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+    return freq;
+#elif defined(TIME_CYCLES_NSEC)
+    return APR_UINT64_C(1000000000);
 #else
-    if (use_localtime)
-        tm = *localtime(&tt);
-    else
-        tm = *gmtime(&tt);
+    return APR_USEC_PER_SEC;
 #endif
+}
+
+/* Break down the seconds since the epoch as gmtime() does, in the
+ * proleptic Gregorian calendar (the days to civil algorithm of Howard
+ * Hinnant, with years starting on March 1st).
+ */
+static void explode_secs(apr_time_exp_t *xt, apr_int64_t secs)
+{
+    apr_int64_t days = secs / 86400, rem = secs % 86400, era, z, y;
+    apr_uint32_t doe, yoe, doy, mp;
 
-    xt->tm_sec  = tm.tm_sec;
-    xt->tm_min  = tm.tm_min;
-    xt->tm_hour = tm.tm_hour;
-    xt->tm_mday = tm.tm_mday;
-    xt->tm_mon  = tm.tm_mon;
-    xt->tm_year = tm.tm_year;
-    xt->tm_wday = tm.tm_wday;
-    xt->tm_yday = tm.tm_yday;
-    xt->tm_isdst = tm.tm_isdst;
-    xt->tm_gmtoff = get_offset(&tm);
+    if (rem < 0) {
+        rem += 86400;
+        days--;
+    }
+    xt->tm_hour = (apr_int32_t)(rem / 3600);
+    xt->tm_min = (apr_int32_t)(rem / 60 % 60);
+    xt->tm_sec = (apr_int32_t)(rem % 60);
+    /* 1 jan 1970 was a Thursday */
+    xt->tm_wday = (apr_int32_t)((days % 7 + 11) % 7);
+
+    z = days + 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = (apr_uint32_t)(z - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    y = (apr_int64_t)yoe + era * 400;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    xt->tm_mday = (apr_int32_t)(doy - (153 * mp + 2) / 5 + 1);
+    if (mp < 10) {
+        xt->tm_mon = (apr_int32_t)mp + 2;
+        xt->tm_yday = (apr_int32_t)doy + 59
+                      + (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0));
+    }
+    else {
+        xt->tm_mon = (apr_int32_t)mp - 10;
+        xt->tm_yday = (apr_int32_t)doy - 306;
+        y++;
+    }
+    xt->tm_year = (apr_int32_t)(y - 1900);
 }
 
 APR_DECLARE(apr_status_t) apr_time_exp_tz(apr_time_exp_t *result,
                                           apr_time_t input, apr_int32_t offs)
 {
-    explode_time(result, input, offs, 0);
+    explode_secs(result, input / APR_USEC_PER_SEC + offs);
+    result->tm_usec = input % APR_USEC_PER_SEC;
+    result->tm_isdst = 0;
     result->tm_gmtoff = offs;
     return APR_SUCCESS;
 }
@@ -123,6 +233,133 @@ APR_DECLARE(apr_status_t) apr_time_exp_gmt(apr_time_exp_t *result,
     return apr_time_exp_tz(result, input, 0);
 }
 
+#if !defined(__EMX__)
+
+#define ZONE_PACK(offset, isdst) \
+    ((apr_uint64_t)(apr_uint32_t)(offset) << 1 | ((isdst) > 0))
+
+/* The local time zone of a second, from the system, as ZONE_PACK() */
+static apr_uint64_t zone_get(apr_int64_t secs)
+{
+    struct tm tm;
+    time_t tt = (time_t)secs;
+
+#if APR_HAS_THREADS && defined (_POSIX_THREAD_SAFE_FUNCTIONS)
+    localtime_r(&tt, &tm);
+#else
+    tm = *localtime(&tt);
+#endif
+    return ZONE_PACK(get_offset(&tm), tm.tm_isdst);
+}
+
+/* From in to out, the farthest second in the zone of in before a change */
+static apr_int64_t zone_edge(apr_int64_t in, apr_int64_t out,
+                             apr_uint64_t packed)
+{
+    if (zone_get(out) == packed) {
+        return out;
+    }
+    while (in - out > 1 || out - in > 1) {
+        apr_int64_t mid = in + (out - in) / 2;
+        if (zone_get(mid) == packed) {
+            in = mid;
+        }
+        else {
+            out = mid;
+        }
+    }
+    return in;
+}
+
+/*
+ * A span of seconds in the same local time zone. The one around the last
+ * lookup is cached: a day before and after where the zone is the same at
+ * both ends (two transitions within a day have never been seen), or else
+ * up to the transitions found by bisection. Readers copy it with atomic
+ * loads then check that seq did not change meanwhile, as a sequence lock;
+ * seq is odd while a single writer updates it.
+ */
+#define ZONE_SPAN 86400
+
+typedef struct {
+    apr_int64_t start;          /* the first second of the span */
+    apr_int64_t end;            /* past the span, zero when invalid */
+    apr_uint64_t packed;        /* ZONE_PACK() */
+} zone_span_t;
+
+static struct {
+    apr_uint32_t seq;
+    apr_uint64_t start;
+    apr_uint64_t end;
+    apr_uint64_t packed;
+} zone_cache;
+
+static void zone_lookup(zone_span_t *span, apr_int64_t secs)
+{
+    apr_uint32_t seq;
+
+    seq = apr_atomic_read32_explicit(&zone_cache.seq, APR_ATOMIC_ACQUIRE);
+    if (!(seq & 1)) {
+        span->start = (apr_int64_t)
+            apr_atomic_read64_explicit(&zone_cache.start, APR_ATOMIC_ACQUIRE);
+        span->end = (apr_int64_t)
+            apr_atomic_read64_explicit(&zone_cache.end, APR_ATOMIC_ACQUIRE);
+        span->packed =
+            apr_atomic_read64_explicit(&zone_cache.packed, APR_ATOMIC_ACQUIRE);
+        if (apr_atomic_read32_explicit(&zone_cache.seq,
+                                       APR_ATOMIC_RELAXED) == seq
+                && secs >= span->start && secs < span->end) {
+            return;
+        }
+    }
+
+    span->packed = zone_get(secs);
+    span->start = zone_edge(secs, secs - ZONE_SPAN, span->packed);
+    span->end = zone_edge(secs, secs + ZONE_SPAN, span->packed) + 1;
+
+    /* Cache it unless another thread does */
+    if (!(seq & 1) && apr_atomic_cas32(&zone_cache.seq, seq + 1, seq) == seq) {
+        apr_atomic_set64_explicit(&zone_cache.start,
+                                  (apr_uint64_t)span->start,
+                                  APR_ATOMIC_RELAXED);
+        apr_atomic_set64_explicit(&zone_cache.end, (apr_uint64_t)span->end,
+                                  APR_ATOMIC_RELAXED);
+        apr_atomic_set64_explicit(&zone_cache.packed, span->packed,
+                                  APR_ATOMIC_RELAXED);
+        apr_atomic_set32_explicit(&zone_cache.seq, seq + 2,
+                                  APR_ATOMIC_RELEASE);
+    }
+}
+
+static void zone_explode(apr_time_exp_t *xt, apr_time_t t,
+                         const zone_span_t *span, apr_int64_t secs)
+{
+    apr_int32_t offset = (apr_int32_t)(apr_uint32_t)(span->packed >> 1);
+
+    explode_secs(xt, secs + offset);
+    xt->tm_usec = t % APR_USEC_PER_SEC;
+    xt->tm_isdst = (apr_int32_t)(span->packed & 1);
+    xt->tm_gmtoff = offset;
+}
+
+#endif /* !__EMX__ */
+
+APR_DECLARE(void) apr_time_zone_refresh(void)
+{
+#if !defined(__EMX__)
+    apr_uint32_t seq;
+
+    tzset();
+    /* Wait out a concurrent update, which is short */
+    do {
+        seq = apr_atomic_read32_explicit(&zone_cache.seq, APR_ATOMIC_RELAXED);
+    } while ((seq & 1)
+             || apr_atomic_cas32(&zone_cache.seq, seq + 1, seq) != seq);
+    apr_atomic_set64_explicit(&zone_cache.end, 0, APR_ATOMIC_RELAXED);
+    apr_atomic_set32_explicit(&zone_cache.seq, seq + 2, APR_ATOMIC_RELEASE);
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_time_exp_lt(apr_time_exp_t *result,
                                                 apr_time_t input)
 {
@@ -130,11 +367,43 @@ APR_DECLARE(apr_status_t) apr_time_exp_lt(apr_time_exp_t *result,
     /* EMX gcc (OS/2) has a timezone global we can use */
     return apr_time_exp_tz(result, input, -timezone);
 #else
-    explode_time(result, input, 0, 1);
+    apr_int64_t secs = input / APR_USEC_PER_SEC;
+    zone_span_t span;
+
+    zone_lookup(&span, secs);
+    zone_explode(result, input, &span, secs);
     return APR_SUCCESS;
 #endif /* __EMX__ */
 }
 
+APR_DECLARE(apr_status_t) apr_time_exp_lt_n(apr_time_exp_t *results,
+                                            const apr_time_t *inputs,
+                                            apr_size_t n)
+{
+#if defined(__EMX__)
+    apr_size_t i;
+
+    for (i = 0; i < n; i++) {
+        apr_time_exp_tz(&results[i], inputs[i], -timezone);
+    }
+#else
+    zone_span_t span;
+    apr_size_t i;
+
+    span.start = span.end = 0;
+    for (i = 0; i < n; i++) {
+        apr_int64_t secs = inputs[i] / APR_USEC_PER_SEC;
+
+        /* Sorted times mostly stay in the span of the previous one */
+        if (secs < span.start || secs >= span.end) {
+            zone_lookup(&span, secs);
+        }
+        zone_explode(&results[i], inputs[i], &span, secs);
+    }
+#endif
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t) apr_time_exp_get(apr_time_t *t, apr_time_exp_t *xt)
 {
     apr_time_t year = xt->tm_year;
@@ -343,6 +612,8 @@ APR_DECLARE(void) apr_unix_setup_time(void)
     t.tm_isdst = 0; /* we know this GMT time isn't daylight-savings */
     t2 = mktime(&t);
     server_gmt_offset = (apr_int32_t) difftime(t1, t2);
+    /* Concurrent first uses compute the same offset, no need to exclude */
+    apr_atomic_set32(&server_gmt_offset_set, 1);
 #endif /* NO_GMTOFF_IN_STRUCT_TM */
 }
 
@@ -34,15 +34,16 @@
  */
 #define IsLeapYear(y) ((!(y % 4)) ? (((y % 400) && !(y % 100)) ? 0 : 1) : 0)
 
+static int tz_init = 0;
+
 static DWORD get_local_timezone(TIME_ZONE_INFORMATION **tzresult)
 {
     static TIME_ZONE_INFORMATION tz;
     static DWORD result;
-    static int init = 0;
 
-    if (!init) {
+    if (!tz_init) {
         result = GetTimeZoneInformation(&tz);
-        init = 1;
+        tz_init = 1;
     }
 
     *tzresult = &tz;
@@ -97,6 +98,45 @@ APR_DECLARE(apr_time_t) apr_time_now(void)
     return aprtime; 
 }
 
+APR_DECLARE(apr_time_t) apr_time_now_coarse(void)
+{
+    /* The system time is only updated at each tick already */
+    return apr_time_now();
+}
+
+static LONGLONG perf_frequency(void)
+{
+    LARGE_INTEGER freq;
+
+    /* Fixed at boot, and never zero since Windows XP */
+    QueryPerformanceFrequency(&freq);
+    return freq.QuadPart;
+}
+
+APR_DECLARE(apr_interval_time_t) apr_time_monotonic(void)
+{
+    LARGE_INTEGER count;
+    LONGLONG freq = perf_frequency();
+
+    QueryPerformanceCounter(&count);
+    /* in two parts, the counter times 10^6 overflowing after days */
+    return (count.QuadPart / freq) * APR_USEC_PER_SEC
+           + (count.QuadPart % freq) * APR_USEC_PER_SEC / freq;
+}
+
+APR_DECLARE(apr_uint64_t) apr_time_cycles(void)
+{
+    LARGE_INTEGER count;
+
+    QueryPerformanceCounter(&count);
+    return (apr_uint64_t)count.QuadPart;
+}
+
+APR_DECLARE(apr_uint64_t) apr_time_cycles_per_sec(void)
+{
+    return (apr_uint64_t)perf_frequency();
+}
+
 APR_DECLARE(apr_status_t) apr_time_exp_gmt(apr_time_exp_t *result,
                                            apr_time_t input)
 {
@@ -177,6 +217,23 @@ APR_DECLARE(apr_status_t) apr_time_exp_lt(apr_time_exp_t *result,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_time_exp_lt_n(apr_time_exp_t *results,
+                                            const apr_time_t *inputs,
+                                            apr_size_t n)
+{
+    apr_size_t i;
+
+    for (i = 0; i < n; i++) {
+        apr_time_exp_lt(&results[i], inputs[i]);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_time_zone_refresh(void)
+{
+    tz_init = 0;
+}
+
 APR_DECLARE(apr_status_t) apr_time_exp_get(apr_time_t *t,
                                            apr_time_exp_t *xt)
 {
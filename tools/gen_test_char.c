@@ -37,8 +37,8 @@
 
 int main(int argc, char *argv[])
 {
-    unsigned c;
-    unsigned char flags;
+    unsigned c, f, l;
+    unsigned char flags, table[256];
 
     printf("/* this file is automatically generated by gen_test_char, "
            "do not edit. \"make include/private/apr_escape_test_char.h\" to regenerate. */\n"
@@ -122,10 +122,43 @@ int main(int argc, char *argv[])
             flags |= T_ESCAPE_LDAP_FILTER;
         }
 
+        table[c] = flags;
         printf("%u%c", flags, (c < 255) ? ',' : ' ');
     }
 
     printf("\n};\n");
 
+    /* The same by nibbles for the vectorized scans, with the NUL that ends
+     * the strings, and the space that apr_escape_urlencoded() turns to '+'.
+     */
+    table[0] = 0xFF;
+    table[' '] |= T_ESCAPE_URLENCODED;
+
+    printf("\n"
+           "/* Bit h of [f][l] (of [f][16 + l]) is set when the byte h << 4 | l\n"
+           " * (the byte (h + 8) << 4 | l) has the flag 1 << f, or is NUL.\n"
+           " */\n"
+           "static const unsigned char test_char_nibbles[8][32] = {");
+
+    for (f = 0; f < 8; ++f) {
+        printf("\n    {");
+        for (l = 0; l < 32; ++l) {
+            flags = 0;
+            for (c = 0; c < 8; ++c) {
+                unsigned b = (c + (l & 16 ? 8 : 0)) << 4 | (l & 15);
+
+                if (table[b] & (1 << f)) {
+                    flags |= 1 << c;
+                }
+            }
+            if (l == 16)
+                printf("\n     ");
+            printf("%u%s", flags, (l < 31) ? "," : "");
+        }
+        printf("}%c", (f < 7) ? ',' : ' ');
+    }
+
+    printf("\n};\n");
+
     return 0;
 }
@@ -25,6 +25,7 @@
 #include "apr.h"
 #include "apr_general.h"
 #include "apr_strings.h"
+#include "apr_lib.h"
 
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
@@ -163,6 +164,9 @@ APR_DECLARE(char *) apr_uri_unparse(apr_pool_t *p,
  * tricks we could pull in assembly language that we don't pull here... like we
  * can do word-at-time scans for delimiter characters using the same technique
  * that fast memchr()s use.  But that would be way non-portable. -djg
+ *
+ * The C libraries now do such scans (and vector ones) in strcspn(), which
+ * finds the ends of the hostinfo and path, the table below the scheme.
  */
 
 /* We have a apr_table_t that we can index by character and it tells us if the
@@ -702,38 +706,21 @@ static const unsigned char uri_delims[256] = {
 #endif
 
 
-/* it works like this:
-    if (uri_delims[ch] & NOTEND_foobar) {
-        then we're not at a delimiter for foobar
-    }
-*/
-
-#define NOTEND_HOSTINFO   (T_SLASH | T_QUESTION | T_HASH | T_NUL)
-#define NOTEND_PATH       (T_QUESTION | T_HASH | T_NUL)
+#define SPAN_SET(span, b, e) ((span).str = (b), (span).len = (e) - (b))
 
-/* parse_uri_components():
- * Parse a given URI, fill in all supplied fields of a uri_components
- * structure. This eliminates the necessity of extracting host, port,
- * path, query info repeatedly in the modules.
- * Side effects:
- *  - fills in fields of uri_components *uptr
- *  - none on any of the r->* fields
+/* uri_parse_view():
+ * Parse a given URI into pieces of it, the core of apr_uri_parse() and
+ * apr_uri_parse_view(). The port number is left to the callers, which
+ * differ on the port strings they accept.
  */
-APR_DECLARE(apr_status_t) apr_uri_parse(apr_pool_t *p, const char *uri, 
-                                        apr_uri_t *uptr)
+static apr_status_t uri_parse_view(const char *uri, apr_uri_view_t *v)
 {
     const char *s;
     const char *s1;
     const char *hostinfo;
-    char *endstr;
-    int port;
     int v6_offset1 = 0, v6_offset2 = 0;
 
-    /* Initialize the structure. parse_uri() and parse_uri_components()
-     * can be called more than once per request.
-     */
-    memset (uptr, '\0', sizeof(*uptr));
-    uptr->is_initialized = 1;
+    memset(v, '\0', sizeof(*v));
 
     /* We assume the processor has a branch predictor like most --
      * it assumes forward branches are untaken and backwards are taken.  That's
@@ -758,30 +745,26 @@ deal_with_path:
         /* we expect uri to point to first character of path ... remember
          * that the path could be empty -- http://foobar?query for example
          */
-        s = uri;
-        while ((uri_delims[*(unsigned char *)s] & NOTEND_PATH) == 0) {
-            ++s;
-        }
+        s = uri + strcspn(uri, "?#");
         if (s != uri) {
-            uptr->path = apr_pstrmemdup(p, uri, s - uri);
+            SPAN_SET(v->path, uri, s);
         }
         if (*s == 0) {
             return APR_SUCCESS;
         }
         if (*s == '?') {
             ++s;
-            s1 = strchr(s, '#');
-            if (s1) {
-                uptr->fragment = apr_pstrdup(p, s1 + 1);
-                uptr->query = apr_pstrmemdup(p, s, s1 - s);
-            }
-            else {
-                uptr->query = apr_pstrdup(p, s);
+            s1 = s + strcspn(s, "#");
+            SPAN_SET(v->query, s, s1);
+            if (*s1) {
+                ++s1;
+                SPAN_SET(v->fragment, s1, s1 + strlen(s1));
             }
             return APR_SUCCESS;
         }
         /* otherwise it's a fragment */
-        uptr->fragment = apr_pstrdup(p, s + 1);
+        ++s;
+        SPAN_SET(v->fragment, s, s + strlen(s));
         return APR_SUCCESS;
     }
 
@@ -795,7 +778,7 @@ deal_with_path:
     }
     /* scheme must be non-empty and followed by : */
     if (s != uri && s[0] == ':') {
-        uptr->scheme = apr_pstrmemdup(p, uri, s - uri);
+        SPAN_SET(v->scheme, uri, s);
         s++;
     }
     else {
@@ -834,11 +817,9 @@ deal_with_path:
 
 deal_with_authority:
     hostinfo = s;
-    while ((uri_delims[*(unsigned char *)s] & NOTEND_HOSTINFO) == 0) {
-        ++s;
-    }
+    s += strcspn(s, "/?#");
     uri = s;        /* whatever follows hostinfo is start of uri */
-    uptr->hostinfo = apr_pstrmemdup(p, hostinfo, uri - hostinfo);
+    SPAN_SET(v->hostinfo, hostinfo, uri);
 
     /* If there's a username:password@host:port, the @ we want is the last @...
      * too bad there's no memrchr()... For the C purists, note that hostinfo
@@ -871,43 +852,209 @@ deal_with_host:
         }
         if (s == NULL) {
             /* we expect the common case to have no port */
-            uptr->hostname = apr_pstrmemdup(p,
-                                            hostinfo + v6_offset1,
-                                            uri - hostinfo - v6_offset2);
+            v->hostname.str = hostinfo + v6_offset1;
+            v->hostname.len = uri - hostinfo - v6_offset2;
             goto deal_with_path;
         }
-        uptr->hostname = apr_pstrmemdup(p,
-                                        hostinfo + v6_offset1,
-                                        s - hostinfo - v6_offset2);
+        v->hostname.str = hostinfo + v6_offset1;
+        v->hostname.len = s - hostinfo - v6_offset2;
         ++s;
-        uptr->port_str = apr_pstrmemdup(p, s, uri - s);
-        if (uri != s) {
-            port = strtol(uptr->port_str, &endstr, 10);
-            uptr->port = port;
-            if (*endstr == '\0') {
-                goto deal_with_path;
-            }
-            /* Invalid characters after ':' found */
-            return APR_EGENERAL;
-        }
-        uptr->port = apr_uri_port_of_scheme(uptr->scheme);
+        SPAN_SET(v->port_str, s, uri);
         goto deal_with_path;
     }
 
     /* first colon delimits username:password */
     s1 = memchr(hostinfo, ':', s - hostinfo);
     if (s1) {
-        uptr->user = apr_pstrmemdup(p, hostinfo, s1 - hostinfo);
+        SPAN_SET(v->user, hostinfo, s1);
         ++s1;
-        uptr->password = apr_pstrmemdup(p, s1, s - s1);
+        SPAN_SET(v->password, s1, s);
     }
     else {
-        uptr->user = apr_pstrmemdup(p, hostinfo, s - hostinfo);
+        SPAN_SET(v->user, hostinfo, s);
     }
     hostinfo = s + 1;
     goto deal_with_host;
 }
 
+/* The default port of a scheme given by its length */
+static apr_port_t port_of_scheme(const char *scheme_str, apr_size_t len)
+{
+    schemes_t *scheme;
+
+    for (scheme = schemes; scheme->name != NULL; ++scheme) {
+        if (strncasecmp(scheme_str, scheme->name, len) == 0
+                && scheme->name[len] == '\0') {
+            return scheme->default_port;
+        }
+    }
+    return 0;
+}
+
+#define SPAN_DUP(p, span) \
+    ((span).str ? apr_pstrmemdup((p), (span).str, (span).len) : NULL)
+
+/* parse_uri_components():
+ * Parse a given URI, fill in all supplied fields of a uri_components
+ * structure. This eliminates the necessity of extracting host, port,
+ * path, query info repeatedly in the modules.
+ * Side effects:
+ *  - fills in fields of uri_components *uptr
+ *  - none on any of the r->* fields
+ */
+APR_DECLARE(apr_status_t) apr_uri_parse(apr_pool_t *p, const char *uri, 
+                                        apr_uri_t *uptr)
+{
+    apr_uri_view_t v;
+    apr_status_t rv;
+    char *endstr;
+
+    /* Initialize the structure. parse_uri() and parse_uri_components()
+     * can be called more than once per request.
+     */
+    memset (uptr, '\0', sizeof(*uptr));
+    uptr->is_initialized = 1;
+
+    rv = uri_parse_view(uri, &v);
+    uptr->scheme = SPAN_DUP(p, v.scheme);
+    uptr->hostinfo = SPAN_DUP(p, v.hostinfo);
+    uptr->user = SPAN_DUP(p, v.user);
+    uptr->password = SPAN_DUP(p, v.password);
+    uptr->hostname = SPAN_DUP(p, v.hostname);
+    uptr->port_str = SPAN_DUP(p, v.port_str);
+    uptr->path = SPAN_DUP(p, v.path);
+    uptr->query = SPAN_DUP(p, v.query);
+    uptr->fragment = SPAN_DUP(p, v.fragment);
+    if (rv != APR_SUCCESS || !uptr->port_str) {
+        return rv;
+    }
+
+    if (*uptr->port_str) {
+        uptr->port = strtol(uptr->port_str, &endstr, 10);
+        if (*endstr != '\0') {
+            /* Invalid characters after ':' found */
+            return APR_EGENERAL;
+        }
+    }
+    else {
+        uptr->port = apr_uri_port_of_scheme(uptr->scheme);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_uri_parse_view(const char *uri,
+                                             apr_uri_view_t *view)
+{
+    apr_status_t rv;
+    apr_size_t i;
+    apr_uint32_t port = 0;
+
+    rv = uri_parse_view(uri, view);
+    if (rv != APR_SUCCESS || !view->port_str.str) {
+        return rv;
+    }
+
+    if (!view->port_str.len) {
+        if (view->scheme.str) {
+            view->port = port_of_scheme(view->scheme.str, view->scheme.len);
+        }
+        return APR_SUCCESS;
+    }
+    for (i = 0; i < view->port_str.len; i++) {
+        if (!apr_isdigit(view->port_str.str[i])) {
+            return APR_EGENERAL;
+        }
+        port = port * 10 + (view->port_str.str[i] - '0');
+        if (port > 65535) {
+            return APR_EGENERAL;
+        }
+    }
+    view->port = (apr_port_t)port;
+    return APR_SUCCESS;
+}
+
+/* Percent-decode the character at s, or return -1 */
+static int uri_hex_char(const char *s)
+{
+    int hi, lo;
+
+    if (!apr_isxdigit(s[1]) || !apr_isxdigit(s[2])) {
+        return -1;
+    }
+    hi = apr_isdigit(s[1]) ? s[1] - '0' : (s[1] | 0x20) - 'a' + 10;
+    lo = apr_isdigit(s[2]) ? s[2] - '0' : (s[2] | 0x20) - 'a' + 10;
+    return hi << 4 | lo;
+}
+
+APR_DECLARE(apr_status_t) apr_uri_normalize_path(char *path,
+                                                 apr_size_t *len,
+                                                 unsigned int flags)
+{
+    const char *r = path, *end = path + *len;
+    char *w = path, *seg = path;
+
+    /* Each segment is decoded in place up to the next slash, then seen
+     * to be a dot segment or not.
+     */
+    for (;;) {
+        while (r < end && *r != '/') {
+            if (*r == '%' && (flags & APR_URI_NORM_DECODE)) {
+                int c;
+
+                if (end - r < 3 || (c = uri_hex_char(r)) < 0 || c == 0) {
+                    return APR_EGENERAL;
+                }
+                if (c == '/') {
+                    /* an encoded slash is not a segment delimiter */
+                    *w++ = *r++;
+                    *w++ = *r++;
+                    *w++ = *r++;
+                    continue;
+                }
+                *w++ = (char)c;
+                r += 3;
+                continue;
+            }
+            *w++ = *r++;
+        }
+
+        if ((flags & APR_URI_NORM_DOTS)
+                && (w - seg == 1 || (w - seg == 2 && seg[1] == '.'))
+                && seg[0] == '.') {
+            if (w - seg == 1) {
+                w = seg;
+            }
+            else if (seg - path > 1) {
+                /* remove the previous segment, up to its leading slash */
+                w = seg - 1;
+                while (w > path && w[-1] != '/') {
+                    --w;
+                }
+            }
+            else {
+                /* nothing above the root */
+                w = seg;
+            }
+            if (r < end) {
+                ++r;
+            }
+        }
+        else if (r < end) {
+            *w++ = *r++;
+        }
+        else {
+            break;
+        }
+        seg = w;
+        if (r == end) {
+            break;
+        }
+    }
+
+    *len = w - path;
+    return APR_SUCCESS;
+}
+
 /* Special case for CONNECT parsing: it comes with the hostinfo part only */
 /* See the INTERNET-DRAFT document "Tunneling SSL Through a WWW Proxy"
  * currently at http://www.mcom.com/newsref/std/tunneling_ssl.html
@@ -0,0 +1,347 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_bloom.h"
+#include "apr_siphash.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+/* The image starts with a header line followed by the blocks, each a
+ * line of 512 bits in 64bit words.  The high half of a hash selects the
+ * block, and the low half times an odd salt per bit selects the bits, as
+ * in the split block filters of Impala or Parquet but with a variable
+ * number of bits.
+ */
+#define BLOOM_LINE 64
+#define BLOOM_WORDS (BLOOM_LINE / 8)
+#define BLOOM_BITS (BLOOM_LINE * 8)
+#define BLOOM_MAGIC 0x41505242 /* "APRB" */
+#define BLOOM_VERSION 1
+#define BLOOM_MAX_K 16
+
+#define BLOOM_LN2 0.69314718055994530942
+
+typedef struct bloom_header_t {
+    apr_uint32_t magic;
+    apr_uint32_t version;
+    apr_uint32_t nblocks;
+    apr_uint32_t k;
+    unsigned char seed[APR_SIPHASH_KSIZE];
+    apr_uint64_t reserved[4];
+} bloom_header_t;
+
+struct apr_bloom_t {
+    bloom_header_t *hdr;
+    volatile apr_uint64_t *blocks;
+    apr_uint32_t nblocks;
+    apr_uint32_t k;
+    apr_size_t size;
+};
+
+static const apr_uint32_t bloom_salts[BLOOM_MAX_K] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+    0x9e3779b1U, 0x85ebca6bU, 0xc2b2ae35U, 0x27d4eb2fU,
+    0x165667b1U, 0xcc9e2d51U, 0x1b873593U, 0xe6546b65U
+};
+
+/* Sizing needs a logarithm and an exponential, which are computed here
+ * rather than linking with the math library.
+ */
+static double bloom_log(double x)
+{
+    double z, z2, term, sum;
+    int e = 0, i;
+
+    while (x >= 2.0) {
+        x /= 2.0;
+        e++;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        e--;
+    }
+    /* log(x) = 2 atanh((x - 1) / (x + 1)), with x in [1, 2) */
+    z = (x - 1.0) / (x + 1.0);
+    z2 = z * z;
+    term = z;
+    sum = 0.0;
+    for (i = 1; i < 64 && term > 1e-18; i += 2) {
+        sum += term / i;
+        term *= z2;
+    }
+    return 2.0 * sum + e * BLOOM_LN2;
+}
+
+static double bloom_exp(double x)
+{
+    double term = 1.0, sum = 1.0;
+    int n = 0, i;
+
+    /* exp(x) = exp(r) 2^n, with r in [0, ln2) */
+    while (x < 0.0) {
+        x += BLOOM_LN2;
+        n--;
+    }
+    while (x >= BLOOM_LN2) {
+        x -= BLOOM_LN2;
+        n++;
+    }
+    for (i = 1; i < 32; i++) {
+        term *= x / i;
+        sum += term;
+    }
+    for (; n < 0; n++) {
+        sum /= 2.0;
+    }
+    for (; n > 0; n--) {
+        sum *= 2.0;
+    }
+    return sum;
+}
+
+/* The false positive probability of a blocked filter, the loads of the
+ * blocks following a Poisson distribution.
+ */
+static double bloom_blocked_fpp(double n, double nblocks, apr_uint32_t k)
+{
+    double lambda = n / nblocks, lnq, pmf, cdf, fpp = 0.0;
+    apr_uint32_t l, i;
+
+    lnq = bloom_log(1.0 - 1.0 / BLOOM_BITS);
+    pmf = bloom_exp(-lambda);
+    cdf = 0.0;
+    for (l = 0; cdf < 1.0 - 1e-9 && l < lambda * 4 + 64; l++) {
+        double miss = 1.0 - bloom_exp(lnq * k * l), hit = 1.0;
+
+        for (i = 0; i < k; i++) {
+            hit *= miss;
+        }
+        fpp += pmf * hit;
+        cdf += pmf;
+        pmf *= lambda / (l + 1);
+    }
+    return fpp;
+}
+
+static int bloom_geometry(apr_uint64_t n, double fpp,
+                          apr_uint32_t *nblocks, apr_uint32_t *k)
+{
+    double bits, blocks, kk;
+    int i;
+
+    if (!(fpp > 0.0 && fpp < 1.0)) {
+        return 0;
+    }
+    if (!n) {
+        n = 1;
+    }
+
+    /* The classic filter: m = -n ln(fpp) / ln2^2, k = m / n ln2 */
+    bits = -(double)n * bloom_log(fpp) / (BLOOM_LN2 * BLOOM_LN2);
+    kk = bits / n * BLOOM_LN2 + 0.5;
+    *k = kk < 1.0 ? 1 : kk > BLOOM_MAX_K ? BLOOM_MAX_K : (apr_uint32_t)kk;
+    blocks = bits / BLOOM_BITS + 1.0;
+
+    /* Grow until blocked, unless the blocks are so loaded that the
+     * classic estimate will do.
+     */
+    for (i = 0; i < 64 && n / blocks < 1024.0; i++) {
+        if (bloom_blocked_fpp((double)n, (double)(apr_uint64_t)blocks,
+                              *k) <= fpp) {
+            break;
+        }
+        blocks += blocks / 32 + 1.0;
+    }
+
+    if (blocks >= 4294967296.0
+            || blocks >= (double)(APR_SIZE_MAX / BLOOM_LINE - 1)) {
+        return 0;
+    }
+    *nblocks = (apr_uint32_t)blocks;
+    return 1;
+}
+
+static apr_bloom_t *bloom_make(void *mem, apr_pool_t *p)
+{
+    apr_bloom_t *bloom = apr_pcalloc(p, sizeof(apr_bloom_t));
+
+    bloom->hdr = mem;
+    bloom->blocks = (apr_uint64_t *)((char *)mem + BLOOM_LINE);
+    bloom->nblocks = bloom->hdr->nblocks;
+    bloom->k = bloom->hdr->k;
+    bloom->size = BLOOM_LINE + (apr_size_t)bloom->nblocks * BLOOM_LINE;
+    return bloom;
+}
+
+APR_DECLARE(apr_size_t) apr_bloom_size(apr_uint64_t n, double fpp)
+{
+    apr_uint32_t nblocks, k;
+
+    if (!bloom_geometry(n, fpp, &nblocks, &k)) {
+        return 0;
+    }
+    return BLOOM_LINE + (apr_size_t)nblocks * BLOOM_LINE;
+}
+
+APR_DECLARE(apr_status_t) apr_bloom_create(apr_bloom_t **bloom,
+                                           apr_uint64_t n, double fpp,
+                                           apr_pool_t *p)
+{
+    apr_size_t size = apr_bloom_size(n, fpp);
+    char *mem;
+
+    if (!size) {
+        return APR_EINVAL;
+    }
+    mem = apr_palloc(p, size + BLOOM_LINE - 1);
+    mem = (char *)APR_ALIGN((apr_uintptr_t)mem, BLOOM_LINE);
+
+    return apr_bloom_create_in(bloom, mem, size, n, fpp, p);
+}
+
+APR_DECLARE(apr_status_t) apr_bloom_create_in(apr_bloom_t **bloom,
+                                              void *mem, apr_size_t size,
+                                              apr_uint64_t n, double fpp,
+                                              apr_pool_t *p)
+{
+    bloom_header_t *hdr = mem;
+    apr_uint32_t nblocks, k;
+
+    if (((apr_uintptr_t)mem & 7) || !bloom_geometry(n, fpp, &nblocks, &k)
+            || size < BLOOM_LINE + (apr_size_t)nblocks * BLOOM_LINE) {
+        return APR_EINVAL;
+    }
+
+    memset(mem, 0, BLOOM_LINE + (apr_size_t)nblocks * BLOOM_LINE);
+#if APR_HAS_RANDOM
+    {
+        apr_status_t rv = apr_generate_random_bytes(hdr->seed,
+                                                    sizeof(hdr->seed));
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+    hdr->version = BLOOM_VERSION;
+    hdr->nblocks = nblocks;
+    hdr->k = k;
+    hdr->magic = BLOOM_MAGIC;
+
+    *bloom = bloom_make(mem, p);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_bloom_attach(apr_bloom_t **bloom,
+                                           void *mem, apr_size_t size,
+                                           apr_pool_t *p)
+{
+    bloom_header_t *hdr = mem;
+
+    if (((apr_uintptr_t)mem & 7) || size < BLOOM_LINE
+            || hdr->magic != BLOOM_MAGIC || hdr->version != BLOOM_VERSION
+            || !hdr->nblocks || !hdr->k || hdr->k > BLOOM_MAX_K
+            || hdr->nblocks > (size - BLOOM_LINE) / BLOOM_LINE) {
+        return APR_EINVAL;
+    }
+
+    *bloom = bloom_make(mem, p);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_bloom_image_get(const apr_bloom_t *bloom,
+                                      void **mem, apr_size_t *size)
+{
+    *mem = bloom->hdr;
+    *size = bloom->size;
+}
+
+APR_DECLARE(apr_uint64_t) apr_bloom_hash(const apr_bloom_t *bloom,
+                                         const void *key, apr_size_t klen)
+{
+    return apr_siphash24(key, klen, bloom->hdr->seed);
+}
+
+/* Compute the masks of the bits of a hash in the words of its block,
+ * and return the block.
+ */
+static APR_INLINE volatile apr_uint64_t *bloom_masks(const apr_bloom_t *bloom,
+                                                     apr_uint64_t hash,
+                                                     apr_uint64_t *masks)
+{
+    apr_uint64_t block = ((hash >> 32) * bloom->nblocks) >> 32;
+    apr_uint32_t lo = (apr_uint32_t)hash, i;
+
+    memset(masks, 0, BLOOM_WORDS * sizeof(apr_uint64_t));
+    for (i = 0; i < bloom->k; i++) {
+        apr_uint32_t bit = (apr_uint32_t)(lo * bloom_salts[i]) >> 23;
+
+        masks[bit >> 6] |= APR_UINT64_C(1) << (bit & 63);
+    }
+    return bloom->blocks + block * BLOOM_WORDS;
+}
+
+APR_DECLARE(void) apr_bloom_add_hash(apr_bloom_t *bloom, apr_uint64_t hash)
+{
+    apr_uint64_t masks[BLOOM_WORDS];
+    volatile apr_uint64_t *words = bloom_masks(bloom, hash, masks);
+    int i;
+
+    /* Only the words missing some bits are written, so adding a key
+     * already there does not take the cache line from the other cores.
+     */
+    for (i = 0; i < BLOOM_WORDS; i++) {
+        if (masks[i] && (words[i] & masks[i]) != masks[i]) {
+            apr_atomic_or64(&words[i], masks[i]);
+        }
+    }
+}
+
+APR_DECLARE(int) apr_bloom_test_hash(const apr_bloom_t *bloom,
+                                     apr_uint64_t hash)
+{
+    apr_uint64_t masks[BLOOM_WORDS];
+    volatile apr_uint64_t *words = bloom_masks(bloom, hash, masks);
+    int i;
+
+    for (i = 0; i < BLOOM_WORDS; i++) {
+        if ((words[i] & masks[i]) != masks[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+APR_DECLARE(void) apr_bloom_add(apr_bloom_t *bloom,
+                                const void *key, apr_size_t klen)
+{
+    apr_bloom_add_hash(bloom, apr_bloom_hash(bloom, key, klen));
+}
+
+APR_DECLARE(int) apr_bloom_test(const apr_bloom_t *bloom,
+                                const void *key, apr_size_t klen)
+{
+    return apr_bloom_test_hash(bloom, apr_bloom_hash(bloom, key, klen));
+}
+
+APR_DECLARE(void) apr_bloom_clear(apr_bloom_t *bloom)
+{
+    memset((void *)bloom->blocks, 0, (apr_size_t)bloom->nblocks * BLOOM_LINE);
+}
@@ -0,0 +1,626 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_cache.h"
+#include "apr_atomic.h"
+#include "apr_hash.h"
+#include "apr_ring.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+
+#include <stdlib.h> /* for malloc() and free() */
+#include <string.h>
+
+/* The uses counted for an entry, each buying it one more round in the
+ * main queue.
+ */
+#define FREQ_MAX 3
+
+/* The hashes of the keys last evicted from the small queue, per shard */
+#define GHOSTS 256
+
+#define QUEUE_NONE  0
+#define QUEUE_SMALL 1
+#define QUEUE_MAIN  2
+
+/* An entry is allocated with its key in a single block, and referenced
+ * by the cache (while indexed or queued) and by each of its users.
+ */
+struct apr_cache_entry_t {
+    APR_RING_ENTRY(apr_cache_entry_t) link;
+    apr_cache_t *cache;
+    void *value;
+    apr_time_t expires;         /* zero if it does not expire */
+    apr_size_t cost;            /* what it counts against the shard */
+    apr_size_t klen;
+    char *key;
+    apr_uint32_t hash;
+    apr_uint32_t refs;
+    apr_status_t status;        /* of the computation */
+    unsigned char freq;
+    unsigned char queue;
+    unsigned char indexed;
+    unsigned char pending;      /* being computed */
+};
+
+APR_RING_HEAD(cache_ring_t, apr_cache_entry_t);
+
+typedef struct cache_shard_t {
+    /* Protected by lock */
+    apr_hash_t *entries;
+    struct cache_ring_t small;
+    struct cache_ring_t main;
+    apr_size_t count;
+    apr_size_t cost;
+    apr_size_t small_cost;
+    apr_size_t max_cost;
+    apr_uint32_t *ghosts;
+    apr_uint32_t ghost_next;
+    apr_hash_t *ghost_index;
+    apr_uint64_t hits;
+    apr_uint64_t misses;
+    apr_uint64_t computes;
+    apr_uint64_t evictions;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *computed;
+#endif
+} cache_shard_t;
+
+struct apr_cache_t {
+    apr_pool_t *pool;
+    apr_interval_time_t ttl;
+    apr_cache_free_t *free_fn;
+    void *baton;
+    apr_uint32_t shift;
+    apr_uint32_t nshards;
+    cache_shard_t *shards;
+};
+
+#if APR_HAS_THREADS
+#define shard_lock(s)   apr_thread_mutex_lock((s)->lock)
+#define shard_unlock(s) apr_thread_mutex_unlock((s)->lock)
+#else
+#define shard_lock(s)
+#define shard_unlock(s)
+#endif
+
+/* The hash tables index their buckets with the low bits of the same hash,
+ * so spread its bits before taking the shard from the high ones.
+ */
+static cache_shard_t *shard_get(apr_cache_t *cache, const void *key,
+                                apr_size_t klen, apr_uint32_t *hash)
+{
+    apr_ssize_t len = klen;
+
+    *hash = apr_hashfunc_default(key, &len);
+    if (cache->nshards == 1) {
+        return cache->shards;
+    }
+    return &cache->shards[(apr_uint32_t)(*hash * 0x9e3779b1U)
+                          >> cache->shift];
+}
+
+static apr_cache_entry_t *entry_make(apr_cache_t *cache, const void *key,
+                                     apr_size_t klen, apr_uint32_t hash)
+{
+    apr_cache_entry_t *e = malloc(sizeof(*e) + klen);
+
+    if (e) {
+        memset(e, 0, sizeof(*e));
+        e->cache = cache;
+        e->klen = klen;
+        e->key = (char *)(e + 1);
+        memcpy(e->key, key, klen);
+        e->hash = hash;
+        e->refs = 1;
+    }
+    return e;
+}
+
+static void entry_unref(apr_cache_entry_t *e)
+{
+    if (apr_atomic_dec32(&e->refs) == 0) {
+        apr_cache_t *cache = e->cache;
+
+        if (cache->free_fn && e->value) {
+            cache->free_fn(e->value, cache->baton);
+        }
+        free(e);
+    }
+}
+
+/* Drop the references of the cache to the entries it removed, out of
+ * the lock since that may free their values.
+ */
+static void entries_unref(struct cache_ring_t *dead)
+{
+    while (!APR_RING_EMPTY(dead, apr_cache_entry_t, link)) {
+        apr_cache_entry_t *e = APR_RING_FIRST(dead);
+
+        APR_RING_REMOVE(e, link);
+        entry_unref(e);
+    }
+}
+
+/* Called with the lock held */
+static void entry_unlink(cache_shard_t *s, apr_cache_entry_t *e,
+                         struct cache_ring_t *dead)
+{
+    if (e->indexed) {
+        apr_hash_set(s->entries, e->key, e->klen, NULL);
+        e->indexed = 0;
+    }
+    if (e->queue != QUEUE_NONE) {
+        APR_RING_REMOVE(e, link);
+        if (e->queue == QUEUE_SMALL) {
+            s->small_cost -= e->cost;
+        }
+        s->cost -= e->cost;
+        s->count--;
+        e->queue = QUEUE_NONE;
+    }
+    APR_RING_INSERT_TAIL(dead, e, apr_cache_entry_t, link);
+}
+
+/* Called with the lock held */
+static void ghost_add(cache_shard_t *s, apr_uint32_t hash)
+{
+    apr_uint32_t *slot = &s->ghosts[s->ghost_next];
+
+    /* The index is keyed by the slots, forget the one reused (unless the
+     * same hash got a newer slot) before changing it.
+     */
+    if (apr_hash_get(s->ghost_index, slot, sizeof(*slot)) == slot) {
+        apr_hash_set(s->ghost_index, slot, sizeof(*slot), NULL);
+    }
+    apr_hash_set(s->ghost_index, &hash, sizeof(hash), NULL);
+    *slot = hash;
+    apr_hash_set(s->ghost_index, slot, sizeof(*slot), slot);
+
+    s->ghost_next = (s->ghost_next + 1) % GHOSTS;
+}
+
+/* Called with the lock held */
+static int ghost_take(cache_shard_t *s, apr_uint32_t hash)
+{
+    if (apr_hash_get(s->ghost_index, &hash, sizeof(hash))) {
+        apr_hash_set(s->ghost_index, &hash, sizeof(hash), NULL);
+        return 1;
+    }
+    return 0;
+}
+
+static APR_INLINE int entry_expired(apr_cache_entry_t *e, apr_time_t now)
+{
+    return e->expires && e->expires <= now;
+}
+
+/* Make room for cost in the shard, S3-FIFO wise: the entries not used
+ * again leave the small queue for the ghosts and the other ones go to the
+ * main queue, where each use buys one more round.
+ * Called with the lock held.
+ */
+static void shard_evict(cache_shard_t *s, apr_size_t cost,
+                        struct cache_ring_t *dead)
+{
+    apr_time_t now = 0;
+
+    while (s->cost + cost > s->max_cost) {
+        apr_cache_entry_t *e;
+
+        if (!now) {
+            now = apr_time_monotonic();
+        }
+        if (!APR_RING_EMPTY(&s->small, apr_cache_entry_t, link)
+            && (s->small_cost > s->max_cost / 10
+                || APR_RING_EMPTY(&s->main, apr_cache_entry_t, link))) {
+            e = APR_RING_LAST(&s->small);
+            if (e->freq && !entry_expired(e, now)) {
+                APR_RING_REMOVE(e, link);
+                s->small_cost -= e->cost;
+                e->freq = 0;
+                e->queue = QUEUE_MAIN;
+                APR_RING_INSERT_HEAD(&s->main, e, apr_cache_entry_t, link);
+                continue;
+            }
+            ghost_add(s, e->hash);
+        }
+        else {
+            e = APR_RING_LAST(&s->main);
+            if (e->freq && !entry_expired(e, now)) {
+                APR_RING_REMOVE(e, link);
+                e->freq--;
+                APR_RING_INSERT_HEAD(&s->main, e, apr_cache_entry_t, link);
+                continue;
+            }
+        }
+        entry_unlink(s, e, dead);
+        s->evictions++;
+    }
+}
+
+/* Queue an entry, making room for it first.
+ * Called with the lock held.
+ */
+static void entry_queue(cache_shard_t *s, apr_cache_entry_t *e,
+                        struct cache_ring_t *dead)
+{
+    shard_evict(s, e->cost, dead);
+
+    if (ghost_take(s, e->hash)) {
+        e->queue = QUEUE_MAIN;
+        APR_RING_INSERT_HEAD(&s->main, e, apr_cache_entry_t, link);
+    }
+    else {
+        e->queue = QUEUE_SMALL;
+        APR_RING_INSERT_HEAD(&s->small, e, apr_cache_entry_t, link);
+        s->small_cost += e->cost;
+    }
+    s->cost += e->cost;
+    s->count++;
+}
+
+/* Called with the lock held */
+static void shard_clear(cache_shard_t *s, struct cache_ring_t *dead)
+{
+    apr_hash_index_t *hi;
+
+    for (hi = apr_hash_first(NULL, s->entries); hi; hi = apr_hash_next(hi)) {
+        entry_unlink(s, apr_hash_this_val(hi), dead);
+    }
+}
+
+static apr_status_t cache_cleanup(void *data)
+{
+    apr_cache_t *cache = data;
+    struct cache_ring_t dead;
+    apr_uint32_t i;
+
+    APR_RING_INIT(&dead, apr_cache_entry_t, link);
+    for (i = 0; i < cache->nshards; i++) {
+        shard_clear(&cache->shards[i], &dead);
+    }
+    entries_unref(&dead);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_cache_create(apr_cache_t **cache,
+                                           apr_size_t max_cost,
+                                           apr_interval_time_t ttl,
+                                           apr_uint32_t shards,
+                                           apr_cache_free_t *free_fn,
+                                           void *baton,
+                                           apr_pool_t *p)
+{
+    apr_cache_t *c;
+    apr_uint32_t i;
+
+    if (ttl < 0) {
+        return APR_EINVAL;
+    }
+    if (!shards) {
+        shards = APR_CACHE_SHARDS;
+    }
+
+    c = apr_pcalloc(p, sizeof(*c));
+    c->pool = p;
+    c->ttl = ttl;
+    c->free_fn = free_fn;
+    c->baton = baton;
+    c->shift = 32;
+    c->nshards = 1;
+    while (c->nshards < shards && c->shift > 16) {
+        c->nshards <<= 1;
+        c->shift--;
+    }
+    c->shards = apr_pcalloc(p, c->nshards * sizeof(cache_shard_t));
+    for (i = 0; i < c->nshards; i++) {
+        cache_shard_t *s = &c->shards[i];
+
+        s->entries = apr_hash_make(p);
+        APR_RING_INIT(&s->small, apr_cache_entry_t, link);
+        APR_RING_INIT(&s->main, apr_cache_entry_t, link);
+        s->max_cost = max_cost / c->nshards;
+        s->ghosts = apr_pcalloc(p, GHOSTS * sizeof(apr_uint32_t));
+        s->ghost_index = apr_hash_make(p);
+#if APR_HAS_THREADS
+        {
+            apr_status_t rv;
+
+            rv = apr_thread_mutex_create(&s->lock, APR_THREAD_MUTEX_DEFAULT,
+                                         p);
+            if (rv == APR_SUCCESS) {
+                rv = apr_thread_cond_create(&s->computed, p);
+            }
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+#endif
+    }
+    apr_pool_cleanup_register(p, c, cache_cleanup, apr_pool_cleanup_null);
+
+    *cache = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_cache_get(apr_cache_t *cache,
+                                        const void *key, apr_size_t klen,
+                                        apr_cache_entry_t **entry)
+{
+    apr_uint32_t hash;
+    cache_shard_t *s = shard_get(cache, key, klen, &hash);
+    struct cache_ring_t dead;
+    apr_cache_entry_t *e;
+
+    APR_RING_INIT(&dead, apr_cache_entry_t, link);
+
+    shard_lock(s);
+    e = apr_hash_get(s->entries, key, klen);
+    if (e && !e->pending && entry_expired(e, apr_time_monotonic())) {
+        entry_unlink(s, e, &dead);
+        e = NULL;
+    }
+    if (e && !e->pending) {
+        if (e->freq < FREQ_MAX) {
+            e->freq++;
+        }
+        apr_atomic_inc32(&e->refs);
+        s->hits++;
+    }
+    else {
+        e = NULL;
+        s->misses++;
+    }
+    shard_unlock(s);
+
+    entries_unref(&dead);
+
+    *entry = e;
+    return e ? APR_SUCCESS : APR_NOTFOUND;
+}
+
+APR_DECLARE(apr_status_t) apr_cache_get_or_compute(apr_cache_t *cache,
+                                                   const void *key,
+                                                   apr_size_t klen,
+                                                   apr_cache_compute_t *compute,
+                                                   void *baton,
+                                                   apr_cache_entry_t **entry)
+{
+    apr_uint32_t hash;
+    cache_shard_t *s = shard_get(cache, key, klen, &hash);
+    struct cache_ring_t dead;
+    apr_interval_time_t ttl = 0;
+    apr_cache_entry_t *e;
+    apr_size_t cost = 0;
+    void *value = NULL;
+    apr_status_t rv;
+
+    APR_RING_INIT(&dead, apr_cache_entry_t, link);
+    *entry = NULL;
+
+    shard_lock(s);
+    e = apr_hash_get(s->entries, key, klen);
+    if (e && !e->pending && entry_expired(e, apr_time_monotonic())) {
+        entry_unlink(s, e, &dead);
+        e = NULL;
+    }
+    if (e) {
+        apr_atomic_inc32(&e->refs);
+        if (!e->pending && e->freq < FREQ_MAX) {
+            e->freq++;
+        }
+        s->hits++;
+#if APR_HAS_THREADS
+        while (e->pending) {
+            apr_thread_cond_wait(s->computed, s->lock);
+        }
+#else
+        if (e->pending) {
+            e->status = APR_EBUSY; /* asked for its own key */
+        }
+#endif
+        rv = e->status;
+        shard_unlock(s);
+
+        entries_unref(&dead);
+        if (rv != APR_SUCCESS) {
+            entry_unref(e);
+            return rv;
+        }
+        *entry = e;
+        return APR_SUCCESS;
+    }
+
+    s->misses++;
+    e = entry_make(cache, key, klen, hash);
+    if (!e) {
+        shard_unlock(s);
+        entries_unref(&dead);
+        return APR_ENOMEM;
+    }
+    /* Referenced by the cache and by us */
+    e->refs = 2;
+    e->pending = 1;
+    e->indexed = 1;
+    apr_hash_set(s->entries, e->key, klen, e);
+    s->computes++;
+    shard_unlock(s);
+
+    entries_unref(&dead);
+
+    rv = compute(&value, &cost, &ttl, key, klen, baton);
+
+    shard_lock(s);
+    e->pending = 0;
+    e->status = rv;
+    if (rv == APR_SUCCESS) {
+        if (!ttl) {
+            ttl = cache->ttl;
+        }
+        e->value = value;
+        e->cost = sizeof(*e) + klen + cost;
+        e->expires = ttl > 0 ? apr_time_monotonic() + ttl : 0;
+    }
+    /* Deleted or replaced meanwhile, the value is only returned */
+    if (e->indexed) {
+        if (rv == APR_SUCCESS && e->cost <= s->max_cost) {
+            entry_queue(s, e, &dead);
+        }
+        else {
+            entry_unlink(s, e, &dead);
+        }
+    }
+#if APR_HAS_THREADS
+    apr_thread_cond_broadcast(s->computed);
+#endif
+    shard_unlock(s);
+
+    entries_unref(&dead);
+    if (rv != APR_SUCCESS) {
+        entry_unref(e);
+        return rv;
+    }
+    *entry = e;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void *) apr_cache_entry_value(const apr_cache_entry_t *entry)
+{
+    return entry->value;
+}
+
+APR_DECLARE(void) apr_cache_release(apr_cache_entry_t *entry)
+{
+    entry_unref(entry);
+}
+
+APR_DECLARE(apr_status_t) apr_cache_set(apr_cache_t *cache,
+                                        const void *key, apr_size_t klen,
+                                        void *value, apr_size_t cost,
+                                        apr_interval_time_t ttl)
+{
+    apr_uint32_t hash;
+    cache_shard_t *s = shard_get(cache, key, klen, &hash);
+    struct cache_ring_t dead;
+    apr_cache_entry_t *e, *old;
+    apr_status_t rv = APR_SUCCESS;
+
+    APR_RING_INIT(&dead, apr_cache_entry_t, link);
+    if (!ttl) {
+        ttl = cache->ttl;
+    }
+
+    e = NULL;
+    cost += sizeof(*e) + klen;
+    if (cost <= s->max_cost) {
+        e = entry_make(cache, key, klen, hash);
+        if (!e) {
+            rv = APR_ENOMEM;
+        }
+    }
+    else {
+        rv = APR_ENOSPC;
+    }
+    if (!e) {
+        if (cache->free_fn && value) {
+            cache->free_fn(value, cache->baton);
+        }
+        if (rv == APR_ENOMEM) {
+            return rv;
+        }
+    }
+    else {
+        e->value = value;
+        e->cost = cost;
+        e->expires = ttl > 0 ? apr_time_monotonic() + ttl : 0;
+    }
+
+    shard_lock(s);
+    /* The previous value is stale even if this one does not fit */
+    old = apr_hash_get(s->entries, key, klen);
+    if (old) {
+        entry_unlink(s, old, &dead);
+    }
+    if (e) {
+        e->indexed = 1;
+        apr_hash_set(s->entries, e->key, klen, e);
+        entry_queue(s, e, &dead);
+    }
+    shard_unlock(s);
+
+    entries_unref(&dead);
+
+    return rv;
+}
+
+APR_DECLARE(void) apr_cache_delete(apr_cache_t *cache,
+                                   const void *key, apr_size_t klen)
+{
+    apr_uint32_t hash;
+    cache_shard_t *s = shard_get(cache, key, klen, &hash);
+    struct cache_ring_t dead;
+    apr_cache_entry_t *e;
+
+    APR_RING_INIT(&dead, apr_cache_entry_t, link);
+
+    shard_lock(s);
+    e = apr_hash_get(s->entries, key, klen);
+    if (e) {
+        entry_unlink(s, e, &dead);
+    }
+    shard_unlock(s);
+
+    entries_unref(&dead);
+}
+
+APR_DECLARE(void) apr_cache_clear(apr_cache_t *cache)
+{
+    struct cache_ring_t dead;
+    apr_uint32_t i;
+
+    APR_RING_INIT(&dead, apr_cache_entry_t, link);
+    for (i = 0; i < cache->nshards; i++) {
+        cache_shard_t *s = &cache->shards[i];
+
+        shard_lock(s);
+        shard_clear(s, &dead);
+        shard_unlock(s);
+    }
+    entries_unref(&dead);
+}
+
+APR_DECLARE(void) apr_cache_stats_get(apr_cache_t *cache,
+                                      apr_cache_stats_t *stats)
+{
+    apr_uint32_t i;
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < cache->nshards; i++) {
+        cache_shard_t *s = &cache->shards[i];
+
+        shard_lock(s);
+        stats->hits += s->hits;
+        stats->misses += s->misses;
+        stats->computes += s->computes;
+        stats->evictions += s->evictions;
+        stats->entries += s->count;
+        stats->cost += s->cost;
+        shard_unlock(s);
+    }
+}
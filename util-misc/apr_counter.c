@@ -0,0 +1,193 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_counter.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+#include "apr_thread_proc.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#ifdef HAVE_SCHED_GETCPU
+#include <sched.h>
+#endif
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/* The memory of a counter is a header line followed by the slots, each
+ * alone in its line, addressed relative to the start of the memory since
+ * attached processes may map it elsewhere.
+ */
+#define COUNTER_LINE 64
+#define COUNTER_MAGIC 0x43544e52 /* "CTNR" */
+#define COUNTER_DEFAULT_SLOTS 64
+
+typedef struct counter_header_t {
+    apr_uint32_t magic;
+    apr_uint32_t nslots;
+} counter_header_t;
+
+struct apr_counter_t {
+    char *base;
+    unsigned int nslots;
+};
+
+#define COUNTER_SLOT(c, i) \
+    ((volatile apr_uint64_t *)((c)->base + COUNTER_LINE * ((i) + 1)))
+
+#if APR_HAS_THREAD_LOCAL
+/* The slot of the current thread where its CPU is unknown, plus one (zero
+ * until assigned).
+ */
+static APR_THREAD_LOCAL apr_uint32_t counter_slot_hint;
+static apr_uint32_t counter_slot_next;
+#endif
+
+/* Processes sharing a counter should start from different slots too */
+static APR_INLINE apr_uint32_t counter_seed(void)
+{
+#if APR_HAVE_UNISTD_H
+    return (apr_uint32_t)getpid();
+#elif defined(WIN32)
+    return (apr_uint32_t)GetCurrentProcessId();
+#else
+    return 0;
+#endif
+}
+
+static APR_INLINE unsigned int counter_slot(apr_counter_t *counter)
+{
+#ifdef HAVE_SCHED_GETCPU
+    int cpu = sched_getcpu();
+
+    if (cpu >= 0) {
+        return (unsigned int)cpu % counter->nslots;
+    }
+#endif
+#if APR_HAS_THREAD_LOCAL
+    if (!counter_slot_hint) {
+        counter_slot_hint = counter_seed()
+                            + apr_atomic_inc32(&counter_slot_next) + 1;
+    }
+    return (counter_slot_hint - 1) % counter->nslots;
+#else
+    return counter_seed() % counter->nslots;
+#endif
+}
+
+APR_DECLARE(apr_size_t) apr_counter_size(unsigned int nslots)
+{
+    if (!nslots) {
+        nslots = COUNTER_DEFAULT_SLOTS;
+    }
+    return (apr_size_t)COUNTER_LINE * (nslots + 1);
+}
+
+APR_DECLARE(apr_status_t) apr_counter_init(apr_counter_t **counter,
+                                           unsigned int nslots,
+                                           void *membuf, apr_size_t memsize,
+                                           apr_pool_t *p)
+{
+    apr_counter_t *c;
+    counter_header_t *hdr = membuf;
+
+    if (!nslots) {
+        nslots = COUNTER_DEFAULT_SLOTS;
+    }
+    if (memsize < apr_counter_size(nslots)) {
+        return APR_ENOSPC;
+    }
+
+    memset(membuf, 0, apr_counter_size(nslots));
+    hdr->nslots = nslots;
+    hdr->magic = COUNTER_MAGIC;
+
+    c = apr_palloc(p, sizeof(*c));
+    c->base = membuf;
+    c->nslots = nslots;
+
+    *counter = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_counter_create(apr_counter_t **counter,
+                                             unsigned int nslots,
+                                             apr_pool_t *p)
+{
+    apr_size_t size = apr_counter_size(nslots);
+    char *mem = apr_palloc(p, size + COUNTER_LINE);
+
+    return apr_counter_init(counter, nslots,
+                            (void *)APR_ALIGN((apr_uintptr_t)mem,
+                                              COUNTER_LINE),
+                            size, p);
+}
+
+APR_DECLARE(apr_status_t) apr_counter_attach(apr_counter_t **counter,
+                                             void *membuf, apr_size_t memsize,
+                                             apr_pool_t *p)
+{
+    apr_counter_t *c;
+    counter_header_t *hdr = membuf;
+
+    if (memsize < sizeof(*hdr) || hdr->magic != COUNTER_MAGIC
+            || !hdr->nslots || memsize < apr_counter_size(hdr->nslots)) {
+        return APR_EINVAL;
+    }
+
+    c = apr_palloc(p, sizeof(*c));
+    c->base = membuf;
+    c->nslots = hdr->nslots;
+
+    *counter = c;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_counter_add(apr_counter_t *counter, apr_uint64_t val)
+{
+    apr_atomic_add64_explicit(COUNTER_SLOT(counter, counter_slot(counter)),
+                              val, APR_ATOMIC_RELAXED);
+}
+
+APR_DECLARE(void) apr_counter_inc(apr_counter_t *counter)
+{
+    apr_counter_add(counter, 1);
+}
+
+APR_DECLARE(apr_uint64_t) apr_counter_read(apr_counter_t *counter)
+{
+    apr_uint64_t sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < counter->nslots; i++) {
+        sum += apr_atomic_read64_explicit(COUNTER_SLOT(counter, i),
+                                          APR_ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+APR_DECLARE(void) apr_counter_reset(apr_counter_t *counter)
+{
+    unsigned int i;
+
+    for (i = 0; i < counter->nslots; i++) {
+        apr_atomic_set64_explicit(COUNTER_SLOT(counter, i), 0,
+                                  APR_ATOMIC_RELAXED);
+    }
+}
@@ -40,6 +40,9 @@
 #endif
 
 #include "apr_date.h"
+#include "apr_atomic.h"
+
+#define IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
 
 /*
  * Compare a string to a mask
@@ -146,7 +149,7 @@ APR_DECLARE(apr_time_t) apr_date_parse_http(const char *date)
 {
     apr_time_exp_t ds;
     apr_time_t result;
-    int mint, mon;
+    int mint, mon, fixdate;
     const char *monstr, *timstr;
     static const int months[12] =
     {
@@ -166,14 +169,33 @@ APR_DECLARE(apr_time_t) apr_date_parse_http(const char *date)
     if (*date == '\0') 
         return APR_DATE_BAD;
 
-    if ((date = strchr(date, ' ')) == NULL)       /* Find space after weekday */
-        return APR_DATE_BAD;
+    /* The fixed layout of the RFC 1123 dates that HTTP generates, checked
+     * in order so that shorter strings stop at their NUL; the month is
+     * checked below.
+     */
+    fixdate = (date[3] == ',' && date[4] == ' '
+               && IS_DIGIT(date[5]) && IS_DIGIT(date[6]) && date[7] == ' '
+               && date[8] && date[9] && date[10] && date[11] == ' '
+               && IS_DIGIT(date[12]) && IS_DIGIT(date[13])
+               && IS_DIGIT(date[14]) && IS_DIGIT(date[15])
+               && date[16] == ' '
+               && IS_DIGIT(date[17]) && IS_DIGIT(date[18]) && date[19] == ':'
+               && IS_DIGIT(date[20]) && IS_DIGIT(date[21]) && date[22] == ':'
+               && IS_DIGIT(date[23]) && IS_DIGIT(date[24])
+               && date[25] == ' ');
+    if (fixdate) {
+        date += 5;
+    }
+    else {
+        if ((date = strchr(date, ' ')) == NULL)   /* Find space after weekday */
+            return APR_DATE_BAD;
 
-    ++date;        /* Now pointing to first char after space, which should be */
+        ++date;    /* Now pointing to first char after space, which should be */
 
-    /* start of the actual date information for all 4 formats. */
+        /* start of the actual date information for all 4 formats. */
+    }
 
-    if (apr_date_checkmask(date, "## @$$ #### ##:##:## *")) {
+    if (fixdate || apr_date_checkmask(date, "## @$$ #### ##:##:## *")) {
         /* RFC 1123 format with two days */
         ds.tm_year = ((date[7] - '0') * 10 + (date[8] - '0') - 19) * 100;
         if (ds.tm_year < 0)
@@ -635,3 +657,66 @@ APR_DECLARE(apr_time_t) apr_date_parse_rfc(const char *date)
     
     return result;
 }
+
+/*
+ * The dates of the recent seconds, each in the slot of its second modulo
+ * DATE_CACHE_SIZE, such that the slot of the current second is rewritten
+ * only DATE_CACHE_SIZE seconds later. A slot is a sequence lock: its seq
+ * is odd while a writer fills it, and readers copy the date with atomic
+ * loads then check that seq did not change. Writers that lose the race
+ * for a slot just don't cache their date.
+ */
+#define DATE_CACHE_SIZE 16
+#define DATE_CACHE_WORDS ((APR_RFC822_DATE_LEN + 7) / 8)
+
+typedef struct date_cache_t {
+    apr_uint32_t seq;           /* zero until first written */
+    apr_uint64_t sec;
+    apr_uint64_t str[DATE_CACHE_WORDS];
+} date_cache_t;
+
+static date_cache_t date_cache[DATE_CACHE_SIZE];
+
+APR_DECLARE(apr_status_t) apr_date_rfc822_recent(char *date_str,
+                                                 apr_time_t t)
+{
+    apr_uint64_t sec = (apr_uint64_t)apr_time_sec(t), str[DATE_CACHE_WORDS];
+    date_cache_t *cache = &date_cache[sec % DATE_CACHE_SIZE];
+    apr_uint32_t seq;
+    int i;
+
+    if (t < 0) {
+        return apr_rfc822_date(date_str, t);
+    }
+
+    seq = apr_atomic_read32_explicit(&cache->seq, APR_ATOMIC_ACQUIRE);
+    if (seq && !(seq & 1)
+            && apr_atomic_read64_explicit(&cache->sec,
+                                          APR_ATOMIC_ACQUIRE) == sec) {
+        /* the acquire loads keep the check of seq after them */
+        for (i = 0; i < DATE_CACHE_WORDS; i++) {
+            str[i] = apr_atomic_read64_explicit(&cache->str[i],
+                                                APR_ATOMIC_ACQUIRE);
+        }
+        if (apr_atomic_read32_explicit(&cache->seq,
+                                       APR_ATOMIC_RELAXED) == seq) {
+            memcpy(date_str, str, APR_RFC822_DATE_LEN);
+            return APR_SUCCESS;
+        }
+    }
+
+    apr_rfc822_date(date_str, t);
+
+    if (!(seq & 1) && apr_atomic_cas32(&cache->seq, seq + 1, seq) == seq) {
+        memset(str, 0, sizeof(str));
+        memcpy(str, date_str, APR_RFC822_DATE_LEN);
+        apr_atomic_set64_explicit(&cache->sec, sec, APR_ATOMIC_RELAXED);
+        for (i = 0; i < DATE_CACHE_WORDS; i++) {
+            apr_atomic_set64_explicit(&cache->str[i], str[i],
+                                      APR_ATOMIC_RELAXED);
+        }
+        apr_atomic_set32_explicit(&cache->seq, seq + 2, APR_ATOMIC_RELEASE);
+    }
+
+    return APR_SUCCESS;
+}
@@ -0,0 +1,275 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_epoch.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
+#include "apr_time.h"
+
+#include <stdlib.h> /* for malloc() and free() */
+
+/* Memory waiting for the readers which may use it to exit. The nodes are
+ * malloc()ed since retiring can happen at any time from any thread, when
+ * the pool of the domain may not be safe to allocate from.
+ */
+typedef struct epoch_retired_t epoch_retired_t;
+struct epoch_retired_t {
+    epoch_retired_t *next;
+    void *data;
+    apr_epoch_reclaim_fn_t reclaim;
+};
+
+#if APR_HAS_THREADS
+
+/* The readers of a slot, counted separately for the two parities of the
+ * epoch, alone in its cache line.
+ */
+#define EPOCH_SLOTS 64
+#define EPOCH_SLOT_SIZE 64
+typedef struct epoch_slot_t {
+    apr_uint32_t readers[2];
+    char pad[EPOCH_SLOT_SIZE - 2 * sizeof(apr_uint32_t)];
+} epoch_slot_t;
+
+/* How many times apr_epoch_synchronize() yields before it sleeps, and the
+ * longest it sleeps at once, while the readers drain.
+ */
+#define EPOCH_YIELDS 16
+#define EPOCH_MAX_SLEEP apr_time_from_msec(1)
+
+#if APR_HAS_THREAD_LOCAL
+/* The reader slot of the current thread, plus one (zero until assigned) */
+static APR_THREAD_LOCAL apr_uint32_t epoch_slot_hint;
+static apr_uint32_t epoch_slot_next;
+#endif
+
+#endif /* APR_HAS_THREADS */
+
+struct apr_epoch_t {
+    apr_pool_t *pool;
+#if APR_HAS_THREADS
+    epoch_slot_t *slots;
+    apr_uint32_t current;           /* its low bit is the new readers' parity */
+    apr_thread_mutex_t *sync_lock;  /* serializes apr_epoch_synchronize() */
+    apr_thread_mutex_t *list_lock;  /* protects retired */
+#endif
+    epoch_retired_t *retired;       /* the most recently retired first */
+};
+
+#if APR_HAS_THREADS
+#define list_lock(e)   apr_thread_mutex_lock((e)->list_lock)
+#define list_unlock(e) apr_thread_mutex_unlock((e)->list_lock)
+#else
+#define list_lock(e)
+#define list_unlock(e)
+#endif
+
+static apr_status_t epoch_reclaim(epoch_retired_t *r)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    while (r) {
+        epoch_retired_t *next = r->next;
+        apr_status_t rv2 = r->reclaim(r->data);
+
+        if (rv == APR_SUCCESS) {
+            rv = rv2;
+        }
+        free(r);
+        r = next;
+    }
+
+    return rv;
+}
+
+/* Registered as a pre-cleanup, such that the pools retired from children
+ * of the domain's pool are destroyed by us before their parent does it.
+ */
+static apr_status_t epoch_cleanup(void *data)
+{
+    apr_epoch_t *epoch = data;
+    epoch_retired_t *r = epoch->retired;
+
+    epoch->retired = NULL;
+    epoch_reclaim(r);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t epoch_pool_reclaim(void *data)
+{
+    apr_pool_destroy(data);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_create(apr_epoch_t **epoch,
+                                           apr_pool_t *p)
+{
+    apr_epoch_t *e;
+
+    e = apr_pcalloc(p, sizeof(*e));
+    e->pool = p;
+#if APR_HAS_THREADS
+    {
+        char *mem = apr_pcalloc(p, (EPOCH_SLOTS + 1) * EPOCH_SLOT_SIZE);
+        apr_status_t rv;
+
+        e->slots = (epoch_slot_t *)APR_ALIGN((apr_uintptr_t)mem,
+                                             EPOCH_SLOT_SIZE);
+        if ((rv = apr_thread_mutex_create(&e->sync_lock,
+                                          APR_THREAD_MUTEX_DEFAULT, p))
+            || (rv = apr_thread_mutex_create(&e->list_lock,
+                                             APR_THREAD_MUTEX_DEFAULT, p))) {
+            return rv;
+        }
+    }
+#endif
+    apr_pool_pre_cleanup_register(p, e, epoch_cleanup);
+
+    *epoch = e;
+    return APR_SUCCESS;
+}
+
+/* The token is the slot of the reader and the parity it entered with, a
+ * thread exiting from the slot it entered since synchronizers would
+ * otherwise miss an increment but not its decrement.
+ */
+APR_DECLARE(apr_epoch_token_t) apr_epoch_enter(apr_epoch_t *epoch)
+{
+#if APR_HAS_THREADS
+    apr_uint32_t slot, cur, parity;
+
+#if APR_HAS_THREAD_LOCAL
+    if (!epoch_slot_hint) {
+        epoch_slot_hint = apr_atomic_inc32(&epoch_slot_next) + 1;
+    }
+    slot = (epoch_slot_hint - 1) % EPOCH_SLOTS;
+#else
+    slot = 0;
+#endif
+
+    for (;;) {
+        cur = apr_atomic_read32(&epoch->current);
+        parity = cur & 1;
+        apr_atomic_inc32(&epoch->slots[slot].readers[parity]);
+
+        /* Unless a synchronizer flipped the epoch meanwhile, any later one
+         * will see this reader in the counters it waits for.
+         */
+        if (apr_atomic_read32(&epoch->current) == cur) {
+            return (slot << 1) | parity;
+        }
+        apr_atomic_dec32(&epoch->slots[slot].readers[parity]);
+    }
+#else
+    return 0;
+#endif
+}
+
+APR_DECLARE(void) apr_epoch_exit(apr_epoch_t *epoch,
+                                 apr_epoch_token_t token)
+{
+#if APR_HAS_THREADS
+    apr_atomic_dec32(&epoch->slots[token >> 1].readers[token & 1]);
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_retire(apr_epoch_t *epoch, void *data,
+                                           apr_epoch_reclaim_fn_t reclaim)
+{
+    epoch_retired_t *r;
+
+    r = malloc(sizeof(*r));
+    if (!r) {
+        return APR_ENOMEM;
+    }
+    r->data = data;
+    r->reclaim = reclaim;
+
+    list_lock(epoch);
+    r->next = epoch->retired;
+    epoch->retired = r;
+    list_unlock(epoch);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_epoch_retire_pool(apr_epoch_t *epoch,
+                                                apr_pool_t *pool)
+{
+    return apr_epoch_retire(epoch, pool, epoch_pool_reclaim);
+}
+
+#if APR_HAS_THREADS
+static apr_uint32_t epoch_readers(apr_epoch_t *epoch, apr_uint32_t parity)
+{
+    apr_uint32_t n = 0;
+    int i;
+
+    for (i = 0; i < EPOCH_SLOTS; i++) {
+        n += apr_atomic_read32(&epoch->slots[i].readers[parity]);
+    }
+    return n;
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_epoch_synchronize(apr_epoch_t *epoch)
+{
+    epoch_retired_t *r;
+#if APR_HAS_THREADS
+    apr_interval_time_t delay = 0;
+    apr_uint32_t cur;
+    int yields = 0;
+
+    apr_thread_mutex_lock(epoch->sync_lock);
+#endif
+
+    /* What is retired before the flip was unlinked before it, and only the
+     * readers entered with the previous parity can still use it.
+     */
+    list_lock(epoch);
+    r = epoch->retired;
+    epoch->retired = NULL;
+    list_unlock(epoch);
+
+#if APR_HAS_THREADS
+    cur = apr_atomic_read32(&epoch->current);
+    apr_atomic_xchg32(&epoch->current, cur + 1);
+
+    /* The previous synchronizer drained the other parity before releasing
+     * sync_lock, so only those readers left.
+     */
+    while (epoch_readers(epoch, cur & 1)) {
+        if (yields < EPOCH_YIELDS) {
+            apr_thread_yield();
+            yields++;
+        }
+        else {
+            delay = delay ? delay * 2 : 10;
+            if (delay > EPOCH_MAX_SLEEP) {
+                delay = EPOCH_MAX_SLEEP;
+            }
+            apr_sleep(delay);
+        }
+    }
+
+    apr_thread_mutex_unlock(epoch->sync_lock);
+#endif
+
+    return epoch_reclaim(r);
+}
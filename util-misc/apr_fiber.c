@@ -0,0 +1,610 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_fiber.h"
+#include "apr_heap.h"
+#include "apr_thread_proc.h"
+
+#if defined(HAVE_UCONTEXT_H) && defined(HAVE_MAKECONTEXT) \
+    && defined(HAVE_SWAPCONTEXT) && (APR_HAS_THREAD_LOCAL || !APR_HAS_THREADS)
+#define APR_HAS_FIBERS 1
+#else
+#define APR_HAS_FIBERS 0
+#endif
+
+#if APR_HAS_FIBERS
+
+#include <ucontext.h>
+
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>             /* for sysconf */
+#endif
+
+/* The stacks are mapped with a guard page below them where possible */
+#if defined(HAVE_MMAP) && defined(HAVE_MPROTECT) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#if defined(MAP_ANON) && defined(_SC_PAGESIZE)
+#define FIBER_STACK_MMAP 1
+#endif
+#endif
+
+/* ASan must be told about the stack switches */
+#if defined(__SANITIZE_ADDRESS__)
+#define FIBER_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define FIBER_ASAN 1
+#endif
+#endif
+#ifdef FIBER_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#if APR_HAS_THREADS
+#define FIBER_THREAD_LOCAL APR_THREAD_LOCAL
+#else
+#define FIBER_THREAD_LOCAL
+#endif
+
+typedef enum {
+    FIBER_READY,
+    FIBER_RUNNING,
+    FIBER_WAITING,
+    FIBER_DONE
+} fiber_state_e;
+
+struct apr_fiber_t {
+    apr_fiber_sched_t *sched;
+    ucontext_t ctx;
+    fiber_state_e state;
+    apr_fiber_fn_t *func;
+    void *baton;
+    char *stack;                /* usable part */
+    apr_fiber_t *next;          /* ready or recycled */
+    apr_fiber_t *all_next;      /* all the fibers of the scheduler */
+    apr_time_t wakeup;
+    apr_heap_handle_t *timer;   /* if sleeping or waiting with a timeout */
+    apr_int16_t rtnevents;
+#ifdef FIBER_ASAN
+    void *asan_fake;
+#endif
+};
+
+struct apr_fiber_sched_t {
+    apr_pool_t *pool;
+    apr_pollcb_t *pollcb;
+    apr_heap_t *timers;
+    ucontext_t ctx;
+    apr_fiber_t *current;
+    apr_fiber_t *ready_head, *ready_tail;
+    apr_fiber_t *recycled;
+    apr_fiber_t *all;
+    apr_size_t stack_size;
+    apr_size_t guard_size;
+    apr_size_t count;           /* fibers not ended */
+    apr_size_t waiting_io;
+#ifdef FIBER_ASAN
+    void *asan_fake;
+    const void *asan_stack;
+    size_t asan_stack_size;
+#endif
+};
+
+/* The scheduler running on this thread, if any */
+static FIBER_THREAD_LOCAL apr_fiber_sched_t *current_sched;
+
+static int timer_compare(const void *a, const void *b)
+{
+    const apr_fiber_t *fa = a, *fb = b;
+
+    return (fa->wakeup < fb->wakeup) ? -1 : (fa->wakeup > fb->wakeup);
+}
+
+static apr_status_t fiber_sched_cleanup(void *data)
+{
+#ifdef FIBER_STACK_MMAP
+    apr_fiber_sched_t *sched = data;
+    apr_fiber_t *fiber;
+
+    for (fiber = sched->all; fiber; fiber = fiber->all_next) {
+        munmap(fiber->stack - sched->guard_size,
+               sched->stack_size + sched->guard_size);
+    }
+#endif
+    return APR_SUCCESS;
+}
+
+static void fiber_ready(apr_fiber_sched_t *sched, apr_fiber_t *fiber)
+{
+    fiber->state = FIBER_READY;
+    fiber->next = NULL;
+    if (sched->ready_tail) {
+        sched->ready_tail->next = fiber;
+    }
+    else {
+        sched->ready_head = fiber;
+    }
+    sched->ready_tail = fiber;
+}
+
+/* Switch from the scheduler to the fiber, until it parks or ends */
+static void fiber_switch_to(apr_fiber_sched_t *sched, apr_fiber_t *fiber)
+{
+    sched->current = fiber;
+    fiber->state = FIBER_RUNNING;
+#ifdef FIBER_ASAN
+    __sanitizer_start_switch_fiber(&sched->asan_fake, fiber->stack,
+                                   sched->stack_size);
+#endif
+    swapcontext(&sched->ctx, &fiber->ctx);
+#ifdef FIBER_ASAN
+    __sanitizer_finish_switch_fiber(sched->asan_fake, NULL, NULL);
+#endif
+    sched->current = NULL;
+}
+
+/* Switch from the fiber back to the scheduler, until it is run again */
+static void fiber_park(apr_fiber_t *fiber)
+{
+    apr_fiber_sched_t *sched = fiber->sched;
+
+#ifdef FIBER_ASAN
+    __sanitizer_start_switch_fiber(&fiber->asan_fake, sched->asan_stack,
+                                   sched->asan_stack_size);
+#endif
+    swapcontext(&fiber->ctx, &sched->ctx);
+#ifdef FIBER_ASAN
+    __sanitizer_finish_switch_fiber(fiber->asan_fake, &sched->asan_stack,
+                                    &sched->asan_stack_size);
+#endif
+}
+
+static void fiber_entry(void)
+{
+    apr_fiber_sched_t *sched = current_sched;
+    apr_fiber_t *fiber = sched->current;
+
+#ifdef FIBER_ASAN
+    __sanitizer_finish_switch_fiber(NULL, &sched->asan_stack,
+                                    &sched->asan_stack_size);
+#endif
+
+    fiber->func(fiber, fiber->baton);
+
+    fiber->state = FIBER_DONE;
+    sched->count--;
+#ifdef FIBER_ASAN
+    /* No fake stack to save, the fiber is gone */
+    __sanitizer_start_switch_fiber(NULL, sched->asan_stack,
+                                   sched->asan_stack_size);
+#endif
+    setcontext(&sched->ctx);
+}
+
+/* Wake up the fibers whose time has come */
+static void fiber_timers_expire(apr_fiber_sched_t *sched)
+{
+    apr_fiber_t *fiber = apr_heap_peek(sched->timers);
+    apr_time_t now;
+
+    if (!fiber) {
+        return;
+    }
+    now = apr_time_now();
+    while (fiber && fiber->wakeup <= now) {
+        apr_heap_pop(sched->timers);
+        fiber->timer = NULL;
+        fiber_ready(sched, fiber);
+        fiber = apr_heap_peek(sched->timers);
+    }
+}
+
+static apr_status_t fiber_poll_cb(void *baton, apr_pollfd_t *pfd)
+{
+    apr_fiber_sched_t *sched = baton;
+    apr_fiber_t *fiber = pfd->client_data;
+
+    /* Still signalled until the fiber removes its descriptor */
+    if (fiber->state == FIBER_WAITING) {
+        fiber->rtnevents = pfd->rtnevents;
+        if (fiber->timer) {
+            apr_heap_remove(sched->timers, fiber->timer);
+            fiber->timer = NULL;
+        }
+        fiber_ready(sched, fiber);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_sched_create(apr_fiber_sched_t **sched,
+                                                 apr_uint32_t size,
+                                                 apr_size_t stack_size,
+                                                 apr_pool_t *p)
+{
+    apr_fiber_sched_t *new_sched;
+    apr_size_t page = 16;
+    apr_status_t rv;
+
+    new_sched = apr_pcalloc(p, sizeof(*new_sched));
+    new_sched->pool = p;
+
+    rv = apr_pollcb_create(&new_sched->pollcb, size ? size : 1, p, 0);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_heap_create(&new_sched->timers, 0, 16, timer_compare, 0, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+#ifdef FIBER_STACK_MMAP
+    page = sysconf(_SC_PAGESIZE);
+    new_sched->guard_size = page;
+#endif
+    if (!stack_size) {
+        stack_size = APR_FIBER_STACK_SIZE;
+    }
+    new_sched->stack_size = (stack_size + page - 1) & ~(page - 1);
+
+    apr_pool_cleanup_register(p, new_sched, fiber_sched_cleanup,
+                              apr_pool_cleanup_null);
+
+    *sched = new_sched;
+    return APR_SUCCESS;
+}
+
+/* Kept apart from apr_fiber_create() so that no local modified there
+ * lives across getcontext(), which returns like setjmp().
+ */
+static int fiber_context(apr_fiber_t *fiber)
+{
+    if (getcontext(&fiber->ctx)) {
+        return -1;
+    }
+    fiber->ctx.uc_stack.ss_sp = fiber->stack;
+    fiber->ctx.uc_stack.ss_size = fiber->sched->stack_size;
+    fiber->ctx.uc_link = NULL;
+    makecontext(&fiber->ctx, fiber_entry, 0);
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_create(apr_fiber_t **fiber,
+                                           apr_fiber_sched_t *sched,
+                                           apr_fiber_fn_t *func,
+                                           void *baton)
+{
+    apr_fiber_t *new_fiber = sched->recycled;
+
+    if (new_fiber) {
+        sched->recycled = new_fiber->next;
+    }
+    else {
+        char *stack;
+
+#ifdef FIBER_STACK_MMAP
+        stack = mmap(NULL, sched->stack_size + sched->guard_size,
+                     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (stack == MAP_FAILED) {
+            return errno;
+        }
+        if (mprotect(stack, sched->guard_size, PROT_NONE)) {
+            apr_status_t rv = errno;
+            munmap(stack, sched->stack_size + sched->guard_size);
+            return rv;
+        }
+        stack += sched->guard_size;
+#else
+        stack = apr_palloc(sched->pool, sched->stack_size);
+#endif
+        new_fiber = apr_pcalloc(sched->pool, sizeof(*new_fiber));
+        new_fiber->sched = sched;
+        new_fiber->stack = stack;
+        new_fiber->all_next = sched->all;
+        sched->all = new_fiber;
+    }
+
+    if (fiber_context(new_fiber)) {
+        new_fiber->next = sched->recycled;
+        sched->recycled = new_fiber;
+        return errno;
+    }
+
+    new_fiber->func = func;
+    new_fiber->baton = baton;
+    new_fiber->timer = NULL;
+    sched->count++;
+    fiber_ready(sched, new_fiber);
+
+    if (fiber) {
+        *fiber = new_fiber;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_sched_run(apr_fiber_sched_t *sched)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    if (current_sched) {
+        return APR_EINVAL;
+    }
+    current_sched = sched;
+
+    while (sched->count) {
+        apr_fiber_t *fiber, *last = sched->ready_tail;
+        apr_interval_time_t timeout;
+
+        /* Run the fibers ready now, the ones they make ready next time */
+        while ((fiber = sched->ready_head) != NULL) {
+            sched->ready_head = fiber->next;
+            if (!sched->ready_head) {
+                sched->ready_tail = NULL;
+            }
+            fiber_switch_to(sched, fiber);
+            if (fiber->state == FIBER_DONE) {
+                fiber->next = sched->recycled;
+                sched->recycled = fiber;
+            }
+            if (fiber == last) {
+                break;
+            }
+        }
+        if (!sched->count) {
+            break;
+        }
+
+        if (sched->ready_head) {
+            timeout = 0;
+        }
+        else if ((fiber = apr_heap_peek(sched->timers)) != NULL) {
+            timeout = fiber->wakeup - apr_time_now();
+            if (timeout < 0) {
+                timeout = 0;
+            }
+        }
+        else {
+            timeout = -1;
+        }
+
+        if (sched->waiting_io) {
+            rv = apr_pollcb_poll(sched->pollcb, timeout, fiber_poll_cb, sched);
+            if (rv != APR_SUCCESS && !APR_STATUS_IS_TIMEUP(rv)
+                    && !APR_STATUS_IS_EINTR(rv)) {
+                break;
+            }
+            rv = APR_SUCCESS;
+        }
+        else if (timeout > 0) {
+            apr_sleep(timeout);
+        }
+        fiber_timers_expire(sched);
+    }
+
+    current_sched = NULL;
+    return rv;
+}
+
+APR_DECLARE(apr_fiber_t *) apr_fiber_current(void)
+{
+    return current_sched ? current_sched->current : NULL;
+}
+
+APR_DECLARE(void) apr_fiber_yield(void)
+{
+    apr_fiber_t *fiber = apr_fiber_current();
+
+    if (fiber) {
+        fiber_ready(fiber->sched, fiber);
+        fiber_park(fiber);
+    }
+}
+
+APR_DECLARE(void) apr_fiber_sleep(apr_interval_time_t t)
+{
+    apr_fiber_t *fiber = apr_fiber_current();
+
+    if (!fiber) {
+        apr_sleep(t);
+        return;
+    }
+    if (t <= 0) {
+        apr_fiber_yield();
+        return;
+    }
+
+    fiber->wakeup = apr_time_now() + t;
+    apr_heap_push(fiber->sched->timers, fiber, &fiber->timer);
+    fiber->state = FIBER_WAITING;
+    fiber_park(fiber);
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_socket_wait(apr_socket_t *sock,
+                                                apr_int16_t reqevents,
+                                                apr_interval_time_t timeout)
+{
+    apr_fiber_t *fiber = apr_fiber_current();
+    apr_fiber_sched_t *sched;
+    apr_pollfd_t pfd;
+    apr_status_t rv;
+
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = reqevents;
+    pfd.desc.s = sock;
+
+    if (!fiber) {
+        apr_int32_t n;
+
+        return apr_poll(&pfd, 1, &n, timeout);
+    }
+    sched = fiber->sched;
+
+    pfd.client_data = fiber;
+    rv = apr_pollcb_add(sched->pollcb, &pfd);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (timeout >= 0) {
+        fiber->wakeup = apr_time_now() + timeout;
+        apr_heap_push(sched->timers, fiber, &fiber->timer);
+    }
+    fiber->rtnevents = 0;
+    fiber->state = FIBER_WAITING;
+    sched->waiting_io++;
+
+    fiber_park(fiber);
+
+    sched->waiting_io--;
+    apr_pollcb_remove(sched->pollcb, &pfd);
+
+    return fiber->rtnevents ? APR_SUCCESS : APR_TIMEUP;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_socket_recv(apr_socket_t *sock,
+                                                char *buf, apr_size_t *len)
+{
+    apr_interval_time_t timeout;
+    apr_size_t size = *len;
+    apr_status_t rv;
+
+    if (!apr_fiber_current()) {
+        return apr_socket_recv(sock, buf, len);
+    }
+
+    apr_socket_timeout_get(sock, &timeout);
+    if (timeout) {
+        apr_socket_timeout_set(sock, 0);
+    }
+    for (;;) {
+        rv = apr_socket_recv(sock, buf, len);
+        if (!APR_STATUS_IS_EAGAIN(rv)) {
+            break;
+        }
+        rv = apr_fiber_socket_wait(sock, APR_POLLIN, timeout);
+        if (rv != APR_SUCCESS) {
+            *len = 0;
+            break;
+        }
+        *len = size;
+    }
+    if (timeout) {
+        apr_socket_timeout_set(sock, timeout);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_socket_send(apr_socket_t *sock,
+                                                const char *buf,
+                                                apr_size_t *len)
+{
+    apr_interval_time_t timeout;
+    apr_size_t size = *len;
+    apr_status_t rv;
+
+    if (!apr_fiber_current()) {
+        return apr_socket_send(sock, buf, len);
+    }
+
+    apr_socket_timeout_get(sock, &timeout);
+    if (timeout) {
+        apr_socket_timeout_set(sock, 0);
+    }
+    for (;;) {
+        rv = apr_socket_send(sock, buf, len);
+        if (!APR_STATUS_IS_EAGAIN(rv)) {
+            break;
+        }
+        rv = apr_fiber_socket_wait(sock, APR_POLLOUT, timeout);
+        if (rv != APR_SUCCESS) {
+            *len = 0;
+            break;
+        }
+        *len = size;
+    }
+    if (timeout) {
+        apr_socket_timeout_set(sock, timeout);
+    }
+    return rv;
+}
+
+#else /* !APR_HAS_FIBERS */
+
+APR_DECLARE(apr_status_t) apr_fiber_sched_create(apr_fiber_sched_t **sched,
+                                                 apr_uint32_t size,
+                                                 apr_size_t stack_size,
+                                                 apr_pool_t *p)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_create(apr_fiber_t **fiber,
+                                           apr_fiber_sched_t *sched,
+                                           apr_fiber_fn_t *func,
+                                           void *baton)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_sched_run(apr_fiber_sched_t *sched)
+{
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_fiber_t *) apr_fiber_current(void)
+{
+    return NULL;
+}
+
+APR_DECLARE(void) apr_fiber_yield(void)
+{
+}
+
+APR_DECLARE(void) apr_fiber_sleep(apr_interval_time_t t)
+{
+    apr_sleep(t);
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_socket_wait(apr_socket_t *sock,
+                                                apr_int16_t reqevents,
+                                                apr_interval_time_t timeout)
+{
+    apr_pollfd_t pfd = { 0 };
+    apr_int32_t n;
+
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = reqevents;
+    pfd.desc.s = sock;
+    return apr_poll(&pfd, 1, &n, timeout);
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_socket_recv(apr_socket_t *sock,
+                                                char *buf, apr_size_t *len)
+{
+    return apr_socket_recv(sock, buf, len);
+}
+
+APR_DECLARE(apr_status_t) apr_fiber_socket_send(apr_socket_t *sock,
+                                                const char *buf,
+                                                apr_size_t *len)
+{
+    return apr_socket_send(sock, buf, len);
+}
+
+#endif /* APR_HAS_FIBERS */
@@ -0,0 +1,446 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_file_appender.h"
+#include "apr_atomic.h"
+#include "apr_portable.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_cond.h"
+#include "apr_thread_proc.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+/* The shards of an appender, each alone in its line(s), and the threads
+ * always appending to the same one so that their records stay in order.
+ */
+#define APPENDER_SHARDS 8
+#define APPENDER_LINE 128
+
+/* The state of a buffer: the amount of data reserved in the low 32 bits,
+ * the number of writers copying into it above, and the sealed bit once
+ * it is being committed.
+ */
+#define STATE_USED   APR_UINT64_C(0xffffffff)
+#define STATE_WRITER APR_UINT64_C(0x100000000)
+#define STATE_SEALED APR_UINT64_C(0x8000000000000000)
+#define STATE_WRITERS(st) ((st) & ~(STATE_USED | STATE_SEALED))
+
+typedef struct appender_buf_t {
+    volatile apr_uint64_t state;
+    char *data;
+} appender_buf_t;
+
+/* Writers fill the active buffer of their shard while the other one is
+ * empty, or being committed.
+ */
+typedef struct appender_shard_t {
+    volatile apr_uint32_t active;
+    appender_buf_t bufs[2];
+} appender_shard_t;
+
+struct apr_file_appender_t {
+    apr_pool_t *pool;
+    apr_file_t *file;
+    apr_size_t bufsize;
+    apr_interval_time_t interval;
+    char *shards;
+    /* The first error of the commits */
+    volatile apr_uint32_t status;
+    /* When the last commit was made, for writers to commit on interval */
+    volatile apr_uint64_t last_commit;
+    /* Protected by commit_lock */
+    apr_size_t sync_bytes;
+    apr_interval_time_t sync_interval;
+    apr_size_t unsynced;
+    apr_time_t last_sync;
+    apr_file_appender_hook_fn_t *hook;
+    void *baton;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *commit_lock;
+    apr_thread_mutex_t *cond_lock;
+    apr_thread_cond_t *cond;
+    apr_thread_t *thread;
+    volatile apr_uint32_t stop;
+#endif
+};
+
+#define APPENDER_SHARD(a, i) \
+    ((appender_shard_t *)((a)->shards + APPENDER_LINE * (i)))
+
+#if APR_HAS_THREADS
+#define commit_lock(a)   apr_thread_mutex_lock((a)->commit_lock)
+#define commit_unlock(a) apr_thread_mutex_unlock((a)->commit_lock)
+#else
+#define commit_lock(a)
+#define commit_unlock(a)
+#endif
+
+#if APR_HAS_THREAD_LOCAL
+/* The shard of the current thread, plus one (zero until assigned) */
+static APR_THREAD_LOCAL apr_uint32_t appender_shard_hint;
+static apr_uint32_t appender_shard_next;
+#endif
+
+static APR_INLINE unsigned int appender_shard(void)
+{
+#if APR_HAS_THREAD_LOCAL
+    if (!appender_shard_hint) {
+        appender_shard_hint = apr_atomic_inc32(&appender_shard_next) + 1;
+    }
+    return (appender_shard_hint - 1) % APPENDER_SHARDS;
+#elif APR_HAS_THREADS
+    apr_os_thread_t tid = apr_os_thread_current();
+    const unsigned char *c = (const unsigned char *)&tid;
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < sizeof(tid); i++) {
+        hash = hash * 33 + c[i];
+    }
+    return hash % APPENDER_SHARDS;
+#else
+    return 0;
+#endif
+}
+
+static void appender_fail(apr_file_appender_t *app, apr_status_t rv)
+{
+    apr_atomic_cas32(&app->status, rv, APR_SUCCESS);
+}
+
+/* Write the buffers filled so far, with commit_lock held */
+static apr_status_t appender_commit(apr_file_appender_t *app)
+{
+    struct iovec vec[APPENDER_SHARDS];
+    appender_buf_t *bufs[APPENDER_SHARDS];
+    apr_size_t nvec = 0, len = 0, i;
+    apr_status_t rv = APR_SUCCESS;
+    apr_time_t now;
+
+    for (i = 0; i < APPENDER_SHARDS; i++) {
+        appender_shard_t *shard = APPENDER_SHARD(app, i);
+        apr_uint32_t idx = apr_atomic_read32(&shard->active);
+        appender_buf_t *b = &shard->bufs[idx];
+        apr_uint64_t st;
+
+        if (!(apr_atomic_read64(&b->state) & STATE_USED)) {
+            continue;
+        }
+
+        /* New writers go to the other buffer, wait for those copying
+         * into this one */
+        apr_atomic_set32(&shard->active, !idx);
+        apr_atomic_or64(&b->state, STATE_SEALED);
+        while (STATE_WRITERS(st = apr_atomic_read64(&b->state))) {
+#if APR_HAS_THREADS
+            apr_thread_yield();
+#endif
+        }
+
+        vec[nvec].iov_base = b->data;
+        vec[nvec].iov_len = (apr_size_t)(st & STATE_USED);
+        len += vec[nvec].iov_len;
+        bufs[nvec++] = b;
+    }
+
+    if (nvec) {
+        rv = apr_file_writev_full(app->file, vec, nvec, NULL);
+        for (i = 0; i < nvec; i++) {
+            apr_atomic_set64(&bufs[i]->state, 0);
+        }
+    }
+
+    now = apr_time_now();
+    apr_atomic_set64(&app->last_commit, (apr_uint64_t)now);
+    if (rv == APR_SUCCESS && len) {
+        app->unsynced += len;
+        if ((app->sync_bytes && app->unsynced >= app->sync_bytes)
+            || (app->sync_interval
+                && now - app->last_sync >= app->sync_interval)) {
+            rv = apr_file_datasync(app->file);
+            app->unsynced = 0;
+            app->last_sync = now;
+        }
+    }
+    if (rv == APR_SUCCESS && len && app->hook) {
+        rv = app->hook(app->baton, app->file, len);
+    }
+    if (rv != APR_SUCCESS) {
+        appender_fail(app, rv);
+    }
+    return rv;
+}
+
+static apr_status_t appender_append(apr_file_appender_t *app,
+                                    const struct iovec *vec,
+                                    apr_size_t nvec, apr_size_t len)
+{
+    appender_shard_t *shard = APPENDER_SHARD(app, appender_shard());
+    apr_status_t rv;
+    apr_size_t i;
+
+    if (len > app->bufsize) {
+        /* after the records so far, directly */
+        commit_lock(app);
+        rv = appender_commit(app);
+        if (rv == APR_SUCCESS) {
+            rv = apr_file_writev_full(app->file, vec, nvec, NULL);
+            if (rv != APR_SUCCESS) {
+                appender_fail(app, rv);
+            }
+        }
+        commit_unlock(app);
+        return rv;
+    }
+
+    for (;;) {
+        apr_uint32_t idx;
+        appender_buf_t *b;
+        apr_uint64_t st, used;
+        char *pos;
+
+        rv = apr_atomic_read32(&app->status);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        idx = apr_atomic_read32(&shard->active);
+        b = &shard->bufs[idx];
+        st = apr_atomic_read64(&b->state);
+        if (st & STATE_SEALED) {
+            /* switched meanwhile */
+            continue;
+        }
+        used = st & STATE_USED;
+        if (used + len > app->bufsize) {
+            /* full, commit it (or wait for the commit in progress) */
+            commit_lock(app);
+            appender_commit(app);
+            commit_unlock(app);
+            continue;
+        }
+        if (apr_atomic_cas64(&b->state, st + STATE_WRITER + len, st) != st) {
+            continue;
+        }
+
+        for (pos = b->data + used, i = 0; i < nvec; i++) {
+            memcpy(pos, vec[i].iov_base, vec[i].iov_len);
+            pos += vec[i].iov_len;
+        }
+        apr_atomic_sub64(&b->state, STATE_WRITER);
+
+#if APR_HAS_THREADS
+        if (app->thread) {
+            /* wake up the thread when half full */
+            if (used < app->bufsize / 2 && used + len >= app->bufsize / 2) {
+                apr_thread_cond_signal(app->cond);
+            }
+            return APR_SUCCESS;
+        }
+#endif
+        if (app->interval
+            && apr_time_now() - (apr_time_t)apr_atomic_read64(
+                                     &app->last_commit) >= app->interval) {
+#if APR_HAS_THREADS
+            /* unless another writer is at it */
+            if (apr_thread_mutex_trylock(app->commit_lock) == APR_SUCCESS) {
+                appender_commit(app);
+                commit_unlock(app);
+            }
+#else
+            appender_commit(app);
+#endif
+        }
+        return APR_SUCCESS;
+    }
+}
+
+#if APR_HAS_THREADS
+static void *APR_THREAD_FUNC appender_thread(apr_thread_t *thd, void *data)
+{
+    apr_file_appender_t *app = data;
+
+    apr_thread_mutex_lock(app->cond_lock);
+    while (!apr_atomic_read32(&app->stop)) {
+        apr_thread_cond_timedwait(app->cond, app->cond_lock, app->interval);
+        if (apr_atomic_read32(&app->stop)) {
+            break;
+        }
+        apr_thread_mutex_unlock(app->cond_lock);
+
+        commit_lock(app);
+        appender_commit(app);
+        commit_unlock(app);
+
+        apr_thread_mutex_lock(app->cond_lock);
+    }
+    apr_thread_mutex_unlock(app->cond_lock);
+
+    return NULL;
+}
+#endif
+
+static apr_status_t appender_cleanup(void *data)
+{
+    apr_file_appender_t *app = data;
+
+#if APR_HAS_THREADS
+    if (app->thread) {
+        apr_status_t rv;
+
+        apr_thread_mutex_lock(app->cond_lock);
+        apr_atomic_set32(&app->stop, 1);
+        apr_thread_cond_signal(app->cond);
+        apr_thread_mutex_unlock(app->cond_lock);
+        apr_thread_join(&rv, app->thread);
+        app->thread = NULL;
+    }
+#endif
+
+    /* the last records */
+    commit_lock(app);
+    appender_commit(app);
+    commit_unlock(app);
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_create(
+                                            apr_file_appender_t **appender,
+                                            apr_file_t *file,
+                                            apr_size_t bufsize,
+                                            apr_interval_time_t interval,
+                                            apr_int32_t flags,
+                                            apr_pool_t *p)
+{
+    apr_file_appender_t *app;
+    apr_status_t rv;
+    int i;
+
+    if (!bufsize || bufsize > APR_INT32_MAX || interval < 0
+        || ((flags & APR_FILE_APPENDER_THREAD) && !interval)) {
+        return APR_EINVAL;
+    }
+#if !APR_HAS_THREADS
+    if (flags & APR_FILE_APPENDER_THREAD) {
+        return APR_ENOTIMPL;
+    }
+#endif
+
+    app = apr_pcalloc(p, sizeof(*app));
+    app->pool = p;
+    app->file = file;
+    app->bufsize = bufsize;
+    app->interval = interval;
+    app->last_commit = (apr_uint64_t)apr_time_now();
+    app->last_sync = (apr_time_t)app->last_commit;
+
+    app->shards = apr_pcalloc(p, APPENDER_LINE * (APPENDER_SHARDS + 1));
+    app->shards = (char *)APR_ALIGN((apr_uintptr_t)app->shards,
+                                    APPENDER_LINE);
+    for (i = 0; i < APPENDER_SHARDS; i++) {
+        appender_shard_t *shard = APPENDER_SHARD(app, i);
+
+        shard->bufs[0].data = apr_palloc(p, bufsize);
+        shard->bufs[1].data = apr_palloc(p, bufsize);
+    }
+
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_create(&app->commit_lock, APR_THREAD_MUTEX_DEFAULT,
+                                 p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (flags & APR_FILE_APPENDER_THREAD) {
+        rv = apr_thread_mutex_create(&app->cond_lock,
+                                     APR_THREAD_MUTEX_DEFAULT, p);
+        if (rv == APR_SUCCESS) {
+            rv = apr_thread_cond_create(&app->cond, p);
+        }
+        if (rv == APR_SUCCESS) {
+            rv = apr_thread_create(&app->thread, NULL, appender_thread, app,
+                                   p);
+        }
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+    apr_pool_pre_cleanup_register(p, app, appender_cleanup);
+
+    *appender = app;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_write(
+                                            apr_file_appender_t *appender,
+                                            const void *buf,
+                                            apr_size_t len)
+{
+    struct iovec vec;
+
+    vec.iov_base = (void *)buf;
+    vec.iov_len = len;
+    return appender_append(appender, &vec, 1, len);
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_writev(
+                                            apr_file_appender_t *appender,
+                                            const struct iovec *vec,
+                                            apr_size_t nvec)
+{
+    apr_size_t len = 0, i;
+
+    for (i = 0; i < nvec; i++) {
+        len += vec[i].iov_len;
+    }
+    return appender_append(appender, vec, nvec, len);
+}
+
+APR_DECLARE(apr_status_t) apr_file_appender_flush(
+                                            apr_file_appender_t *appender)
+{
+    apr_status_t rv;
+
+    commit_lock(appender);
+    rv = appender_commit(appender);
+    commit_unlock(appender);
+    if (rv == APR_SUCCESS) {
+        rv = apr_atomic_read32(&appender->status);
+    }
+    return rv;
+}
+
+APR_DECLARE(void) apr_file_appender_sync_set(apr_file_appender_t *appender,
+                                             apr_size_t bytes,
+                                             apr_interval_time_t interval)
+{
+    commit_lock(appender);
+    appender->sync_bytes = bytes;
+    appender->sync_interval = interval;
+    commit_unlock(appender);
+}
+
+APR_DECLARE(void) apr_file_appender_hook_set(apr_file_appender_t *appender,
+                                           apr_file_appender_hook_fn_t *fn,
+                                           void *baton)
+{
+    commit_lock(appender);
+    appender->hook = fn;
+    appender->baton = baton;
+    commit_unlock(appender);
+}
@@ -0,0 +1,303 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_nearcache.h"
+#include "apr_hash.h"
+#include "apr_ring.h"
+#include "apr_strings.h"
+#include "apr_thread_mutex.h"
+
+#include <stdlib.h> /* for malloc() and free() */
+#include <string.h>
+
+/* One cached value, allocated with its key in a single block such that
+ * replacing or evicting it gives its memory back right away.
+ */
+typedef struct nearcache_entry_t nearcache_entry_t;
+struct nearcache_entry_t {
+    APR_RING_ENTRY(nearcache_entry_t) link;
+    apr_time_t expires;     /* zero if it does not expire */
+    apr_size_t size;        /* what it counts against the shard */
+    apr_size_t klen;
+    apr_size_t len;
+    apr_uint16_t flags;
+    char *key;
+    char *data;             /* nul terminated */
+};
+
+/* The entries of a shard are ringed in the order of use, the most recent
+ * first, such that the least recently used is evicted from the tail.
+ */
+typedef struct nearcache_shard_t {
+    /* Protected by lock */
+    apr_hash_t *entries;
+    APR_RING_HEAD(nearcache_ring_t, nearcache_entry_t) lru;
+    apr_size_t bytes;
+    apr_size_t max_bytes;
+    apr_uint64_t hits;
+    apr_uint64_t misses;
+    apr_uint64_t evictions;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+} nearcache_shard_t;
+
+struct apr_nearcache_t {
+    apr_pool_t *pool;
+    apr_interval_time_t ttl;
+    apr_uint32_t shift;
+    apr_uint32_t nshards;
+    nearcache_shard_t *shards;
+};
+
+#if APR_HAS_THREADS
+#define shard_lock(s)   apr_thread_mutex_lock((s)->lock)
+#define shard_unlock(s) apr_thread_mutex_unlock((s)->lock)
+#else
+#define shard_lock(s)
+#define shard_unlock(s)
+#endif
+
+/* The hash tables index their buckets with the low bits of the same hash,
+ * so spread its bits before taking the shard from the high ones.
+ */
+static nearcache_shard_t *shard_get(apr_nearcache_t *nc, const char *key,
+                                    apr_size_t klen)
+{
+    apr_ssize_t len = klen;
+    apr_uint32_t h = apr_hashfunc_default(key, &len);
+
+    if (nc->nshards == 1) {
+        return nc->shards;
+    }
+    return &nc->shards[(apr_uint32_t)(h * 0x9e3779b1U) >> nc->shift];
+}
+
+/* Called with the lock held */
+static void entry_remove(nearcache_shard_t *s, nearcache_entry_t *e)
+{
+    apr_hash_set(s->entries, e->key, e->klen, NULL);
+    APR_RING_REMOVE(e, link);
+    s->bytes -= e->size;
+    free(e);
+}
+
+/* Called with the lock held */
+static void shard_clear(nearcache_shard_t *s)
+{
+    while (!APR_RING_EMPTY(&s->lru, nearcache_entry_t, link)) {
+        entry_remove(s, APR_RING_FIRST(&s->lru));
+    }
+}
+
+static apr_status_t nearcache_cleanup(void *data)
+{
+    apr_nearcache_t *nc = data;
+    apr_uint32_t i;
+
+    for (i = 0; i < nc->nshards; i++) {
+        shard_clear(&nc->shards[i]);
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_nearcache_create(apr_nearcache_t **nearcache,
+                                               apr_size_t max_bytes,
+                                               apr_interval_time_t ttl,
+                                               apr_uint32_t shards,
+                                               apr_pool_t *p)
+{
+    apr_nearcache_t *nc;
+    apr_uint32_t i;
+
+    if (ttl < 0) {
+        return APR_EINVAL;
+    }
+    if (!shards) {
+        shards = APR_NEARCACHE_SHARDS;
+    }
+
+    nc = apr_pcalloc(p, sizeof(*nc));
+    nc->pool = p;
+    nc->ttl = ttl;
+    nc->shift = 32;
+    nc->nshards = 1;
+    while (nc->nshards < shards && nc->shift > 16) {
+        nc->nshards <<= 1;
+        nc->shift--;
+    }
+    nc->shards = apr_pcalloc(p, nc->nshards * sizeof(nearcache_shard_t));
+    for (i = 0; i < nc->nshards; i++) {
+        nearcache_shard_t *s = &nc->shards[i];
+
+        s->entries = apr_hash_make(p);
+        APR_RING_INIT(&s->lru, nearcache_entry_t, link);
+        s->max_bytes = max_bytes / nc->nshards;
+#if APR_HAS_THREADS
+        {
+            apr_status_t rv = apr_thread_mutex_create(&s->lock,
+                                                      APR_THREAD_MUTEX_DEFAULT,
+                                                      p);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+#endif
+    }
+    apr_pool_cleanup_register(p, nc, nearcache_cleanup, apr_pool_cleanup_null);
+
+    *nearcache = nc;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_nearcache_get(apr_nearcache_t *nc,
+                                            const char *key,
+                                            apr_size_t klen,
+                                            apr_pool_t *p,
+                                            char **data,
+                                            apr_size_t *len,
+                                            apr_uint16_t *flags)
+{
+    nearcache_shard_t *s = shard_get(nc, key, klen);
+    nearcache_entry_t *e;
+    apr_status_t rv = APR_NOTFOUND;
+
+    shard_lock(s);
+    e = apr_hash_get(s->entries, key, klen);
+    if (e && e->expires && e->expires <= apr_time_monotonic()) {
+        entry_remove(s, e);
+        e = NULL;
+    }
+    if (e) {
+        APR_RING_REMOVE(e, link);
+        APR_RING_INSERT_HEAD(&s->lru, e, nearcache_entry_t, link);
+        *data = apr_pmemdup(p, e->data, e->len + 1);
+        *len = e->len;
+        if (flags) {
+            *flags = e->flags;
+        }
+        s->hits++;
+        rv = APR_SUCCESS;
+    }
+    else {
+        s->misses++;
+    }
+    shard_unlock(s);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_nearcache_set(apr_nearcache_t *nc,
+                                            const char *key,
+                                            apr_size_t klen,
+                                            const char *data,
+                                            apr_size_t len,
+                                            apr_uint16_t flags,
+                                            apr_interval_time_t ttl)
+{
+    nearcache_shard_t *s = shard_get(nc, key, klen);
+    nearcache_entry_t *e, *old;
+    apr_size_t size = sizeof(*e) + klen + len + 1;
+
+    if (!ttl) {
+        ttl = nc->ttl;
+    }
+
+    e = NULL;
+    if (size <= s->max_bytes) {
+        e = malloc(size);
+        if (!e) {
+            return APR_ENOMEM;
+        }
+        e->expires = ttl > 0 ? apr_time_monotonic() + ttl : 0;
+        e->size = size;
+        e->klen = klen;
+        e->len = len;
+        e->flags = flags;
+        e->key = (char *)(e + 1);
+        e->data = e->key + klen;
+        memcpy(e->key, key, klen);
+        memcpy(e->data, data, len);
+        e->data[len] = '\0';
+    }
+
+    shard_lock(s);
+    /* The previous value is stale even if this one does not fit */
+    old = apr_hash_get(s->entries, key, klen);
+    if (old) {
+        entry_remove(s, old);
+    }
+    if (e) {
+        while (s->bytes + size > s->max_bytes) {
+            entry_remove(s, APR_RING_LAST(&s->lru));
+            s->evictions++;
+        }
+        APR_RING_INSERT_HEAD(&s->lru, e, nearcache_entry_t, link);
+        apr_hash_set(s->entries, e->key, klen, e);
+        s->bytes += size;
+    }
+    shard_unlock(s);
+
+    return e ? APR_SUCCESS : APR_ENOSPC;
+}
+
+APR_DECLARE(void) apr_nearcache_delete(apr_nearcache_t *nc,
+                                       const char *key,
+                                       apr_size_t klen)
+{
+    nearcache_shard_t *s = shard_get(nc, key, klen);
+    nearcache_entry_t *e;
+
+    shard_lock(s);
+    e = apr_hash_get(s->entries, key, klen);
+    if (e) {
+        entry_remove(s, e);
+    }
+    shard_unlock(s);
+}
+
+APR_DECLARE(void) apr_nearcache_clear(apr_nearcache_t *nc)
+{
+    apr_uint32_t i;
+
+    for (i = 0; i < nc->nshards; i++) {
+        nearcache_shard_t *s = &nc->shards[i];
+
+        shard_lock(s);
+        shard_clear(s);
+        shard_unlock(s);
+    }
+}
+
+APR_DECLARE(void) apr_nearcache_stats_get(apr_nearcache_t *nc,
+                                          apr_nearcache_stats_t *stats)
+{
+    apr_uint32_t i;
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < nc->nshards; i++) {
+        nearcache_shard_t *s = &nc->shards[i];
+
+        shard_lock(s);
+        stats->hits += s->hits;
+        stats->misses += s->misses;
+        stats->evictions += s->evictions;
+        stats->entries += apr_hash_count(s->entries);
+        stats->bytes += s->bytes;
+        shard_unlock(s);
+    }
+}
@@ -31,7 +31,9 @@
 #include "apr_thread_mutex.h"
 #include "apr_thread_cond.h"
 #include "apr_errno.h"
+#include "apr_atomic.h"
 #include "apr_queue.h"
+#include "apr_probes.h"
 
 #if APR_HAS_THREADS
 /* 
@@ -40,18 +42,40 @@
 #define QUEUE_DEBUG
  */
 
+/*
+ * The lock-free ring (APR_QUEUE_LOCKFREE) is a bounded MPMC queue where
+ * each cell has a sequence number telling whether it can be pushed to
+ * (seq == pos) or popped from (seq == pos + 1) at position pos.
+ * Positions are 64bit, so that they never wrap in practice.
+ */
+#define QUEUE_CACHELINE 64
+
+typedef struct queue_cell_t {
+    volatile apr_uint64_t seq;
+    void                 *data;
+} queue_cell_t;
+
+typedef struct queue_ring_t {
+    volatile apr_uint64_t in;  /**< next position to push */
+    char                  pad_in[QUEUE_CACHELINE - sizeof(apr_uint64_t)];
+    volatile apr_uint64_t out; /**< next position to pop */
+    char                  pad_out[QUEUE_CACHELINE - sizeof(apr_uint64_t)];
+    queue_cell_t         *cells;
+} queue_ring_t;
+
 struct apr_queue_t {
     void              **data;
     unsigned int        nelts; /**< # elements */
     unsigned int        in;    /**< next empty location */
     unsigned int        out;   /**< next filled location */
     unsigned int        bounds;/**< max size of queue */
-    unsigned int        full_waiters;
-    unsigned int        empty_waiters;
+    volatile apr_uint32_t full_waiters;
+    volatile apr_uint32_t empty_waiters;
     apr_thread_mutex_t *one_big_mutex;
     apr_thread_cond_t  *not_empty;
     apr_thread_cond_t  *not_full;
     int                 terminated;
+    queue_ring_t       *ring;  /**< APR_QUEUE_LOCKFREE */
 };
 
 #ifdef QUEUE_DEBUG
@@ -101,9 +125,22 @@ static apr_status_t queue_destroy(void *data)
 APR_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q, 
                                            unsigned int queue_capacity, 
                                            apr_pool_t *a)
+{
+    return apr_queue_create_ex(q, queue_capacity, 0, a);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_create_ex(apr_queue_t **q,
+                                              unsigned int queue_capacity,
+                                              apr_uint32_t flags,
+                                              apr_pool_t *a)
 {
     apr_status_t rv;
     apr_queue_t *queue;
+
+    if (flags & ~APR_QUEUE_LOCKFREE) {
+        return APR_EINVAL;
+    }
+
     queue = apr_palloc(a, sizeof(apr_queue_t));
     *q = queue;
 
@@ -125,8 +162,23 @@ APR_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q,
         return rv;
     }
 
-    /* Set all the data in the queue to NULL */
-    queue->data = apr_pcalloc(a, queue_capacity * sizeof(void*));
+    if (flags & APR_QUEUE_LOCKFREE) {
+        unsigned int i;
+
+        queue->ring = apr_pcalloc(a, sizeof(queue_ring_t));
+        queue->ring->cells = apr_palloc(a, queue_capacity
+                                           * sizeof(queue_cell_t));
+        for (i = 0; i < queue_capacity; i++) {
+            queue->ring->cells[i].seq = i;
+            queue->ring->cells[i].data = NULL;
+        }
+        queue->data = NULL;
+    }
+    else {
+        queue->ring = NULL;
+        /* Set all the data in the queue to NULL */
+        queue->data = apr_pcalloc(a, queue_capacity * sizeof(void*));
+    }
     queue->bounds = queue_capacity;
     queue->nelts = 0;
     queue->in = 0;
@@ -141,19 +193,223 @@ APR_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q,
 }
 
 /**
- * Push new data onto the queue. Blocks if the queue is full. Once
- * the push operation has completed, it signals other threads waiting
+ * Try to push to the lock-free ring, returns non-zero on success.
+ */
+static int ring_trypush(apr_queue_t *queue, void *data)
+{
+    queue_ring_t *ring = queue->ring;
+    queue_cell_t *cell;
+    apr_uint64_t pos, seq, cur;
+
+    if (!queue->bounds) {
+        return 0;
+    }
+
+    pos = apr_atomic_read64(&ring->in);
+    for (;;) {
+        cell = &ring->cells[pos % queue->bounds];
+        seq = apr_atomic_read64(&cell->seq);
+        if (seq == pos) {
+            cur = apr_atomic_cas64(&ring->in, pos + 1, pos);
+            if (cur == pos) {
+                break;
+            }
+            pos = cur;
+        }
+        else if ((apr_int64_t)(seq - pos) < 0) {
+            return 0; /* full */
+        }
+        else {
+            pos = apr_atomic_read64(&ring->in);
+        }
+    }
+
+    cell->data = data;
+    apr_atomic_set64(&cell->seq, pos + 1);
+
+    return 1;
+}
+
+/**
+ * Try to pop from the lock-free ring, returns non-zero on success.
+ */
+static int ring_trypop(apr_queue_t *queue, void **data)
+{
+    queue_ring_t *ring = queue->ring;
+    queue_cell_t *cell;
+    apr_uint64_t pos, seq, cur;
+
+    if (!queue->bounds) {
+        return 0;
+    }
+
+    pos = apr_atomic_read64(&ring->out);
+    for (;;) {
+        cell = &ring->cells[pos % queue->bounds];
+        seq = apr_atomic_read64(&cell->seq);
+        if (seq == pos + 1) {
+            cur = apr_atomic_cas64(&ring->out, pos + 1, pos);
+            if (cur == pos) {
+                break;
+            }
+            pos = cur;
+        }
+        else if ((apr_int64_t)(seq - (pos + 1)) < 0) {
+            return 0; /* empty */
+        }
+        else {
+            pos = apr_atomic_read64(&ring->out);
+        }
+    }
+
+    *data = cell->data;
+    apr_atomic_set64(&cell->seq, pos + queue->bounds);
+
+    return 1;
+}
+
+/**
+ * Wake up one of the threads blocked on the lock-free ring, if any.
+ * The waiters are counted (atomically) before they check the ring a last
+ * time under the mutex, so either they see our change or we see them.
+ */
+static apr_status_t ring_wakeup(apr_queue_t *queue,
+                                volatile apr_uint32_t *waiters,
+                                apr_thread_cond_t *cond,
+                                unsigned int count)
+{
+    apr_status_t rv;
+
+    if (!apr_atomic_read32(waiters)) {
+        return APR_SUCCESS;
+    }
+
+    rv = apr_thread_mutex_lock(queue->one_big_mutex);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (count > 1) {
+        rv = apr_thread_cond_broadcast(cond);
+    }
+    else {
+        rv = apr_thread_cond_signal(cond);
+    }
+    if (rv != APR_SUCCESS) {
+        apr_thread_mutex_unlock(queue->one_big_mutex);
+        return rv;
+    }
+    return apr_thread_mutex_unlock(queue->one_big_mutex);
+}
+
+/**
+ * Blocking (or not) push/pop of up to nelts elements on the lock-free ring,
+ * the mutex and condition variables are only used when the ring is
+ * full/empty for the first element, and to wake up the other side once.
+ */
+static apr_status_t ring_op(apr_queue_t *queue, void **data,
+                            unsigned int nelts, unsigned int *count,
+                            int push, apr_interval_time_t timeout)
+{
+    volatile apr_uint32_t *waiters;
+    apr_thread_cond_t *cond, *other_cond;
+    apr_status_t rv, rv2;
+    unsigned int n;
+    int done;
+
+    *count = 0;
+
+    if (push) {
+        waiters = &queue->full_waiters;
+        cond = queue->not_full;
+        other_cond = queue->not_empty;
+    }
+    else {
+        waiters = &queue->empty_waiters;
+        cond = queue->not_empty;
+        other_cond = queue->not_full;
+    }
+
+#define RING_TRY(i) (push ? ring_trypush(queue, data[i]) \
+                          : ring_trypop(queue, &data[i]))
+
+    if (!RING_TRY(0)) {
+        if (!timeout) {
+            return APR_EAGAIN;
+        }
+
+        rv = apr_thread_mutex_lock(queue->one_big_mutex);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        apr_atomic_inc32(waiters);
+        done = RING_TRY(0);
+        if (!done && !queue->terminated) {
+            if (push) {
+                APR_PROBE1(queue__push__block, queue);
+            }
+            else {
+                APR_PROBE1(queue__pop__block, queue);
+            }
+            if (timeout > 0) {
+                rv = apr_thread_cond_timedwait(cond, queue->one_big_mutex,
+                                               timeout);
+            }
+            else {
+                rv = apr_thread_cond_wait(cond, queue->one_big_mutex);
+            }
+            if (rv == APR_SUCCESS) {
+                done = RING_TRY(0);
+            }
+        }
+        apr_atomic_dec32(waiters);
+
+        rv2 = apr_thread_mutex_unlock(queue->one_big_mutex);
+        if (rv == APR_SUCCESS) {
+            rv = rv2;
+        }
+        if (!done) {
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            Q_DBG(push ? "queue full (intr)" : "queue empty (intr)", queue);
+            /* If we wake up and still can't, then we were interrupted */
+            return queue->terminated ? APR_EOF : APR_EINTR;
+        }
+    }
+
+    for (n = 1; n < nelts && RING_TRY(n); n++)
+        ;
+    *count = n;
+
+#undef RING_TRY
+
+    return ring_wakeup(queue, push ? &queue->empty_waiters
+                                   : &queue->full_waiters, other_cond, n);
+}
+
+/**
+ * Push up to nelts new data onto the queue. Blocks if the queue is full.
+ * Once the push operation has completed, it signals other threads waiting
  * in apr_queue_pop() that they may continue consuming sockets.
  */
-static apr_status_t queue_push(apr_queue_t *queue, void *data,
+static apr_status_t queue_push(apr_queue_t *queue, void **data,
+                               unsigned int nelts, unsigned int *pushed,
                                apr_interval_time_t timeout)
 {
     apr_status_t rv;
+    unsigned int n;
+
+    *pushed = 0;
 
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
 
+    if (queue->ring) {
+        return ring_op(queue, data, nelts, pushed, 1, timeout);
+    }
+
     rv = apr_thread_mutex_lock(queue->one_big_mutex);
     if (rv != APR_SUCCESS) {
         return rv;
@@ -166,6 +422,7 @@ static apr_status_t queue_push(apr_queue_t *queue, void *data,
         }
         if (!queue->terminated) {
             queue->full_waiters++;
+            APR_PROBE1(queue__push__block, queue);
             if (timeout > 0) {
                 rv = apr_thread_cond_timedwait(queue->not_full,
                                                queue->one_big_mutex,
@@ -197,15 +454,24 @@ static apr_status_t queue_push(apr_queue_t *queue, void *data,
         }
     }
 
-    queue->data[queue->in] = data;
-    queue->in++;
-    if (queue->in >= queue->bounds)
-        queue->in -= queue->bounds;
-    queue->nelts++;
+    n = 0;
+    do {
+        queue->data[queue->in] = data[n];
+        queue->in++;
+        if (queue->in >= queue->bounds)
+            queue->in -= queue->bounds;
+        queue->nelts++;
+    } while (++n < nelts && !apr_queue_full(queue));
+    *pushed = n;
 
     if (queue->empty_waiters) {
         Q_DBG("sig !empty", queue);
-        rv = apr_thread_cond_signal(queue->not_empty);
+        if (n > 1) {
+            rv = apr_thread_cond_broadcast(queue->not_empty);
+        }
+        else {
+            rv = apr_thread_cond_signal(queue->not_empty);
+        }
         if (rv != APR_SUCCESS) {
             apr_thread_mutex_unlock(queue->one_big_mutex);
             return rv;
@@ -218,7 +484,8 @@ static apr_status_t queue_push(apr_queue_t *queue, void *data,
 
 APR_DECLARE(apr_status_t) apr_queue_push(apr_queue_t *queue, void *data)
 {
-    return queue_push(queue, data, -1);
+    unsigned int pushed;
+    return queue_push(queue, &data, 1, &pushed, -1);
 }
 
 /**
@@ -228,38 +495,73 @@ APR_DECLARE(apr_status_t) apr_queue_push(apr_queue_t *queue, void *data)
  */
 APR_DECLARE(apr_status_t) apr_queue_trypush(apr_queue_t *queue, void *data)
 {
-    return queue_push(queue, data, 0);
+    unsigned int pushed;
+    return queue_push(queue, &data, 1, &pushed, 0);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_timedpush(apr_queue_t *queue, void *data,
                                               apr_interval_time_t timeout)
 {
-    return queue_push(queue, data, timeout);
+    unsigned int pushed;
+    return queue_push(queue, &data, 1, &pushed, timeout);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_push_batch(apr_queue_t *queue,
+                                               void **data,
+                                               unsigned int nelts,
+                                               unsigned int *pushed,
+                                               apr_interval_time_t timeout)
+{
+    if (!nelts) {
+        *pushed = 0;
+        return APR_SUCCESS;
+    }
+    return queue_push(queue, data, nelts, pushed, timeout);
 }
 
 /**
  * not thread safe
  */
 APR_DECLARE(unsigned int) apr_queue_size(apr_queue_t *queue) {
+    if (queue->ring) {
+        apr_uint64_t out = apr_atomic_read64(&queue->ring->out);
+        apr_uint64_t in = apr_atomic_read64(&queue->ring->in);
+
+        if (in <= out) {
+            return 0;
+        }
+        if (in - out > queue->bounds) {
+            return queue->bounds;
+        }
+        return (unsigned int)(in - out);
+    }
     return queue->nelts;
 }
 
 /**
- * Retrieves the next item from the queue. If there are no
+ * Retrieves up to nelts next items from the queue. If there are no
  * items available, it will either return APR_EAGAIN (timeout = 0),
  * or block until one becomes available (infinitely with timeout < 0,
  * otherwise until the given timeout expires). Once retrieved, the
- * item is placed into the address specified by 'data'.
+ * items are placed into the array specified by 'data'.
  */
 static apr_status_t queue_pop(apr_queue_t *queue, void **data,
+                              unsigned int nelts, unsigned int *popped,
                               apr_interval_time_t timeout)
 {
     apr_status_t rv;
+    unsigned int n;
+
+    *popped = 0;
 
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
 
+    if (queue->ring) {
+        return ring_op(queue, data, nelts, popped, 0, timeout);
+    }
+
     rv = apr_thread_mutex_lock(queue->one_big_mutex);
     if (rv != APR_SUCCESS) {
         return rv;
@@ -273,6 +575,7 @@ static apr_status_t queue_pop(apr_queue_t *queue, void **data,
         }
         if (!queue->terminated) {
             queue->empty_waiters++;
+            APR_PROBE1(queue__pop__block, queue);
             if (timeout > 0) {
                 rv = apr_thread_cond_timedwait(queue->not_empty,
                                                queue->one_big_mutex,
@@ -304,15 +607,25 @@ static apr_status_t queue_pop(apr_queue_t *queue, void **data,
         }
     } 
 
-    *data = queue->data[queue->out];
-    queue->nelts--;
+    n = 0;
+    do {
+        data[n] = queue->data[queue->out];
+        queue->nelts--;
+
+        queue->out++;
+        if (queue->out >= queue->bounds)
+            queue->out -= queue->bounds;
+    } while (++n < nelts && !apr_queue_empty(queue));
+    *popped = n;
 
-    queue->out++;
-    if (queue->out >= queue->bounds)
-        queue->out -= queue->bounds;
     if (queue->full_waiters) {
         Q_DBG("signal !full", queue);
-        rv = apr_thread_cond_signal(queue->not_full);
+        if (n > 1) {
+            rv = apr_thread_cond_broadcast(queue->not_full);
+        }
+        else {
+            rv = apr_thread_cond_signal(queue->not_full);
+        }
         if (rv != APR_SUCCESS) {
             apr_thread_mutex_unlock(queue->one_big_mutex);
             return rv;
@@ -325,18 +638,34 @@ static apr_status_t queue_pop(apr_queue_t *queue, void **data,
 
 APR_DECLARE(apr_status_t) apr_queue_pop(apr_queue_t *queue, void **data)
 {
-    return queue_pop(queue, data, -1);
+    unsigned int popped;
+    return queue_pop(queue, data, 1, &popped, -1);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_trypop(apr_queue_t *queue, void **data)
 {
-    return queue_pop(queue, data, 0);
+    unsigned int popped;
+    return queue_pop(queue, data, 1, &popped, 0);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_timedpop(apr_queue_t *queue, void **data,
                                              apr_interval_time_t timeout)
 {
-    return queue_pop(queue, data, timeout);
+    unsigned int popped;
+    return queue_pop(queue, data, 1, &popped, timeout);
+}
+
+APR_DECLARE(apr_status_t) apr_queue_pop_batch(apr_queue_t *queue,
+                                              void **data,
+                                              unsigned int nelts,
+                                              unsigned int *popped,
+                                              apr_interval_time_t timeout)
+{
+    if (!nelts) {
+        *popped = 0;
+        return APR_SUCCESS;
+    }
+    return queue_pop(queue, data, nelts, popped, timeout);
 }
 
 APR_DECLARE(apr_status_t) apr_queue_interrupt_all(apr_queue_t *queue)
@@ -0,0 +1,474 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_reactor.h"
+#include "apr_ring.h"
+#include "apr_atomic.h"
+#include "apr_thread_mutex.h"
+
+/* The timing wheel has WHEEL_LEVELS levels of WHEEL_SIZE slots, a slot of
+ * level N covering WHEEL_SIZE^N ticks.  A timer is stored at the lowest
+ * level whose current window (of WHEEL_SIZE slots) contains its expiry,
+ * and moved down ("cascaded") when the ticks reach its slot, so it is
+ * re-hashed at most WHEEL_LEVELS times.  The timers expiring beyond the
+ * top level's window (2^24 ticks, more than four hours) wait in the
+ * overflow ring.
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+
+#define TICK_USEC    1000
+
+typedef enum {
+    TIMER_FREE,
+    TIMER_PENDING,
+    TIMER_FIRING,
+    TIMER_CANCELLED
+} reactor_timer_state_e;
+
+struct apr_reactor_timer_t {
+    APR_RING_ENTRY(apr_reactor_timer_t) link;
+    apr_uint64_t expires;   /* tick */
+    apr_uint64_t period;    /* ticks, or zero for one-shot */
+    apr_reactor_timer_cb_t *func;
+    void *baton;
+    reactor_timer_state_e state;
+};
+
+APR_RING_HEAD(reactor_timer_ring_t, apr_reactor_timer_t);
+
+typedef struct reactor_task_t reactor_task_t;
+struct reactor_task_t {
+    APR_RING_ENTRY(reactor_task_t) link;
+    apr_reactor_task_cb_t *func;
+    void *baton;
+};
+
+APR_RING_HEAD(reactor_task_ring_t, reactor_task_t);
+
+struct apr_reactor_t {
+    apr_pool_t *pool;
+    apr_pollcb_t *pollcb;
+    apr_time_t base;        /* time of tick zero */
+    apr_time_t now;         /* cached time */
+    apr_uint64_t current;   /* last tick run */
+    apr_uint32_t ntimers;   /* pending timers */
+    struct reactor_timer_ring_t wheel[WHEEL_LEVELS][WHEEL_SIZE];
+    struct reactor_timer_ring_t overflow;
+    struct reactor_timer_ring_t free_timers;
+    /* Protected by lock */
+    struct reactor_task_ring_t tasks;
+    struct reactor_task_ring_t free_tasks;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+#endif
+    volatile apr_uint32_t stopped;
+};
+
+#if APR_HAS_THREADS
+#define reactor_lock(r)   apr_thread_mutex_lock((r)->lock)
+#define reactor_unlock(r) apr_thread_mutex_unlock((r)->lock)
+#else
+#define reactor_lock(r)
+#define reactor_unlock(r)
+#endif
+
+APR_DECLARE(apr_status_t) apr_reactor_create(apr_reactor_t **reactor,
+                                             apr_uint32_t size,
+                                             apr_pool_t *p,
+                                             apr_uint32_t flags,
+                                             apr_pollset_method_e method)
+{
+    apr_reactor_t *r;
+    apr_status_t rv;
+    int i, j;
+
+    *reactor = NULL;
+
+    r = apr_pcalloc(p, sizeof(*r));
+    rv = apr_pool_create(&r->pool, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    apr_pool_tag(r->pool, "apr_reactor");
+
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_create(&r->lock, APR_THREAD_MUTEX_DEFAULT,
+                                 r->pool);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(r->pool);
+        return rv;
+    }
+#endif
+
+    rv = apr_pollcb_create_ex(&r->pollcb, size, r->pool,
+                              flags | APR_POLLSET_WAKEABLE, method);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(r->pool);
+        return rv;
+    }
+
+    for (i = 0; i < WHEEL_LEVELS; i++) {
+        for (j = 0; j < WHEEL_SIZE; j++) {
+            APR_RING_INIT(&r->wheel[i][j], apr_reactor_timer_t, link);
+        }
+    }
+    APR_RING_INIT(&r->overflow, apr_reactor_timer_t, link);
+    APR_RING_INIT(&r->free_timers, apr_reactor_timer_t, link);
+    APR_RING_INIT(&r->tasks, reactor_task_t, link);
+    APR_RING_INIT(&r->free_tasks, reactor_task_t, link);
+
+    r->base = r->now = apr_time_now();
+
+    *reactor = r;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_pollcb_t *) apr_reactor_pollcb_get(apr_reactor_t *reactor)
+{
+    return reactor->pollcb;
+}
+
+APR_DECLARE(apr_time_t) apr_reactor_now(apr_reactor_t *reactor)
+{
+    return reactor->now;
+}
+
+/* Store a timer at the lowest level whose window contains its expiry */
+static void timer_insert(apr_reactor_t *r, apr_reactor_timer_t *t)
+{
+    struct reactor_timer_ring_t *slot = &r->overflow;
+    int level;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        if ((t->expires >> (shift + WHEEL_BITS)) ==
+                (r->current >> (shift + WHEEL_BITS))) {
+            slot = &r->wheel[level][(t->expires >> shift) & WHEEL_MASK];
+            break;
+        }
+    }
+    APR_RING_INSERT_TAIL(slot, t, apr_reactor_timer_t, link);
+}
+
+static void timer_free(apr_reactor_t *r, apr_reactor_timer_t *t)
+{
+    t->state = TIMER_FREE;
+    APR_RING_INSERT_TAIL(&r->free_timers, t, apr_reactor_timer_t, link);
+}
+
+/* Has the current tick just entered a new slot of the given level? */
+#define TICK_ON_BOUNDARY(r, level) \
+    (((r)->current & ((APR_UINT64_C(1) << (WHEEL_BITS * (level))) - 1)) == 0)
+
+static void wheel_cascade(apr_reactor_t *r)
+{
+    struct reactor_timer_ring_t moved;
+    int level = 1;
+
+    while (level < WHEEL_LEVELS && TICK_ON_BOUNDARY(r, level + 1)) {
+        level++;
+    }
+
+    /* From the highest level, so that each lower slot is complete when
+     * it gets cascaded in turn.
+     */
+    for (; level > 0; level--) {
+        struct reactor_timer_ring_t *slot;
+
+        if (level == WHEEL_LEVELS) {
+            slot = &r->overflow;
+        }
+        else {
+            int shift = WHEEL_BITS * level;
+            slot = &r->wheel[level][(r->current >> shift) & WHEEL_MASK];
+        }
+        APR_RING_INIT(&moved, apr_reactor_timer_t, link);
+        APR_RING_CONCAT(&moved, slot, apr_reactor_timer_t, link);
+        while (!APR_RING_EMPTY(&moved, apr_reactor_timer_t, link)) {
+            apr_reactor_timer_t *t = APR_RING_FIRST(&moved);
+            APR_RING_REMOVE(t, link);
+            timer_insert(r, t);
+        }
+    }
+}
+
+/* Run the timers expired up to the cached time */
+static void wheel_advance(apr_reactor_t *r)
+{
+    apr_uint64_t target = (apr_uint64_t)(r->now - r->base) / TICK_USEC;
+    struct reactor_timer_ring_t expired;
+
+    if (r->now < r->base) {
+        /* Clock went backward */
+        return;
+    }
+
+    while (r->current < target) {
+        if (!r->ntimers) {
+            r->current = target;
+            break;
+        }
+
+        r->current++;
+        if (TICK_ON_BOUNDARY(r, 1)) {
+            wheel_cascade(r);
+        }
+
+        APR_RING_INIT(&expired, apr_reactor_timer_t, link);
+        APR_RING_CONCAT(&expired, &r->wheel[0][r->current & WHEEL_MASK],
+                        apr_reactor_timer_t, link);
+        while (!APR_RING_EMPTY(&expired, apr_reactor_timer_t, link)) {
+            apr_reactor_timer_t *t = APR_RING_FIRST(&expired);
+
+            /* The callback may cancel or add (other) timers */
+            APR_RING_REMOVE(t, link);
+            t->state = TIMER_FIRING;
+            r->ntimers--;
+
+            t->func(r, t, t->baton);
+
+            if (t->state == TIMER_CANCELLED || !t->period) {
+                timer_free(r, t);
+            }
+            else {
+                t->state = TIMER_PENDING;
+                t->expires += t->period;
+                if (t->expires <= r->current) {
+                    /* Late, skip the missed periods */
+                    t->expires = r->current + 1;
+                }
+                timer_insert(r, t);
+                r->ntimers++;
+            }
+        }
+    }
+}
+
+/* The first tick when something may expire, or zero if there is nothing */
+static apr_uint64_t wheel_next(apr_reactor_t *r)
+{
+    int level;
+
+    if (!r->ntimers) {
+        return 0;
+    }
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        apr_uint64_t index = r->current >> shift;
+        int i;
+
+        /* A slot of a higher level holds timers expiring no earlier than
+         * its first tick, when it is cascaded.
+         */
+        for (i = (int)(index & WHEEL_MASK) + 1; i < WHEEL_SIZE; i++) {
+            if (!APR_RING_EMPTY(&r->wheel[level][i],
+                                apr_reactor_timer_t, link)) {
+                return ((index & ~(apr_uint64_t)WHEEL_MASK) | i) << shift;
+            }
+        }
+    }
+
+    return ((r->current >> (WHEEL_BITS * WHEEL_LEVELS)) + 1)
+           << (WHEEL_BITS * WHEEL_LEVELS);
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_timer_add(apr_reactor_t *reactor,
+                                                apr_interval_time_t delay,
+                                                apr_interval_time_t period,
+                                                apr_reactor_timer_cb_t *func,
+                                                void *baton,
+                                                apr_reactor_timer_t **timer)
+{
+    apr_reactor_timer_t *t;
+    apr_time_t when;
+
+    if (delay < 0 || period < 0) {
+        return APR_EINVAL;
+    }
+
+    if (!APR_RING_EMPTY(&reactor->free_timers, apr_reactor_timer_t, link)) {
+        t = APR_RING_FIRST(&reactor->free_timers);
+        APR_RING_REMOVE(t, link);
+    }
+    else {
+        /* The pool is shared with apr_reactor_task_push() */
+        reactor_lock(reactor);
+        t = apr_palloc(reactor->pool, sizeof(*t));
+        reactor_unlock(reactor);
+    }
+    APR_RING_ELEM_INIT(t, link);
+
+    when = reactor->now + delay;
+    if (when < reactor->base) {
+        when = reactor->base;
+    }
+    t->expires = ((apr_uint64_t)(when - reactor->base) + TICK_USEC - 1)
+                 / TICK_USEC;
+    if (t->expires <= reactor->current) {
+        t->expires = reactor->current + 1;
+    }
+    t->period = ((apr_uint64_t)period + TICK_USEC - 1) / TICK_USEC;
+    if (period && !t->period) {
+        t->period = 1;
+    }
+    t->func = func;
+    t->baton = baton;
+    t->state = TIMER_PENDING;
+
+    timer_insert(reactor, t);
+    reactor->ntimers++;
+
+    if (timer) {
+        *timer = t;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_timer_cancel(apr_reactor_t *reactor,
+                                                   apr_reactor_timer_t *timer)
+{
+    switch (timer->state) {
+    case TIMER_PENDING:
+        APR_RING_REMOVE(timer, link);
+        reactor->ntimers--;
+        timer_free(reactor, timer);
+        return APR_SUCCESS;
+    case TIMER_FIRING:
+        /* Freed when the callback returns */
+        timer->state = TIMER_CANCELLED;
+        return APR_SUCCESS;
+    default:
+        return APR_EINVAL;
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_task_push(apr_reactor_t *reactor,
+                                                apr_reactor_task_cb_t *func,
+                                                void *baton)
+{
+    reactor_task_t *task;
+    int was_empty;
+
+    reactor_lock(reactor);
+    if (!APR_RING_EMPTY(&reactor->free_tasks, reactor_task_t, link)) {
+        task = APR_RING_FIRST(&reactor->free_tasks);
+        APR_RING_REMOVE(task, link);
+    }
+    else {
+        task = apr_palloc(reactor->pool, sizeof(*task));
+        APR_RING_ELEM_INIT(task, link);
+    }
+    task->func = func;
+    task->baton = baton;
+    was_empty = APR_RING_EMPTY(&reactor->tasks, reactor_task_t, link);
+    APR_RING_INSERT_TAIL(&reactor->tasks, task, reactor_task_t, link);
+    reactor_unlock(reactor);
+
+    /* The reactor is already woken up otherwise */
+    if (was_empty) {
+        return apr_pollcb_wakeup(reactor->pollcb);
+    }
+    return APR_SUCCESS;
+}
+
+static void run_tasks(apr_reactor_t *r)
+{
+    struct reactor_task_ring_t run;
+    reactor_task_t *task;
+
+    APR_RING_INIT(&run, reactor_task_t, link);
+
+    reactor_lock(r);
+    APR_RING_CONCAT(&run, &r->tasks, reactor_task_t, link);
+    reactor_unlock(r);
+
+    if (APR_RING_EMPTY(&run, reactor_task_t, link)) {
+        return;
+    }
+
+    for (task = APR_RING_FIRST(&run);
+         task != APR_RING_SENTINEL(&run, reactor_task_t, link);
+         task = APR_RING_NEXT(task, link)) {
+        task->func(r, task->baton);
+    }
+
+    reactor_lock(r);
+    APR_RING_CONCAT(&r->free_tasks, &run, reactor_task_t, link);
+    reactor_unlock(r);
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_run_once(apr_reactor_t *reactor,
+                                               apr_interval_time_t timeout,
+                                               apr_pollcb_cb_t func,
+                                               void *baton)
+{
+    apr_uint64_t next;
+    apr_status_t rv;
+
+    run_tasks(reactor);
+
+    next = wheel_next(reactor);
+    if (next) {
+        apr_interval_time_t wait = reactor->base
+                                   + (apr_time_t)next * TICK_USEC
+                                   - apr_time_now();
+        if (wait < 0) {
+            wait = 0;
+        }
+        if (timeout < 0 || wait < timeout) {
+            timeout = wait;
+        }
+    }
+
+    rv = apr_pollcb_poll(reactor->pollcb, timeout, func, baton);
+    if (APR_STATUS_IS_TIMEUP(rv) || APR_STATUS_IS_EINTR(rv)) {
+        rv = APR_SUCCESS;
+    }
+
+    reactor->now = apr_time_now();
+    wheel_advance(reactor);
+
+    run_tasks(reactor);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_run(apr_reactor_t *reactor,
+                                          apr_pollcb_cb_t func,
+                                          void *baton)
+{
+    apr_status_t rv = APR_SUCCESS;
+
+    while (!apr_atomic_read32(&reactor->stopped)) {
+        rv = apr_reactor_run_once(reactor, -1, func, baton);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    apr_atomic_set32(&reactor->stopped, 0);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_reactor_stop(apr_reactor_t *reactor)
+{
+    apr_atomic_set32(&reactor->stopped, 1);
+    return apr_pollcb_wakeup(reactor->pollcb);
+}
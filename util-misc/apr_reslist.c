@@ -23,12 +23,15 @@
 #include "apr_thread_mutex.h"
 #include "apr_thread_cond.h"
 #include "apr_ring.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
 
 /**
  * A single resource element.
  */
 struct apr_res_t {
     apr_time_t freed;
+    apr_time_t checked; /* last validation by the maintainer */
     void *opaque;
     APR_RING_ENTRY(apr_res_t) link;
 };
@@ -40,6 +43,22 @@ typedef struct apr_res_t apr_res_t;
 APR_RING_HEAD(apr_resring_t, apr_res_t);
 typedef struct apr_resring_t apr_resring_t;
 
+#if APR_HAS_THREADS
+/**
+ * A shard of the available resources, where the threads hinted to it
+ * release them and acquire them first, under its own lock.
+ */
+typedef struct apr_res_shard_t {
+    int nidle;      /* number of available resources in this shard */
+    apr_resring_t avail_list;
+    apr_resring_t free_list;
+    apr_thread_mutex_t *lock;
+} apr_res_shard_t;
+
+/* How often the shards are maintained when there is no ttl */
+#define SHARD_MAINTAIN_INTERVAL apr_time_from_sec(1)
+#endif
+
 struct apr_reslist_t {
     apr_pool_t *pool; /* the pool used in constructor and destructor calls */
     int ntotal;     /* total number of resources managed by this list */
@@ -57,9 +76,122 @@ struct apr_reslist_t {
 #if APR_HAS_THREADS
     apr_thread_mutex_t *listlock;
     apr_thread_cond_t *avail;
+    int nshards;    /* number of shards, zero if not sharded */
+    apr_res_shard_t *shards;
+    apr_uint32_t nwaiters; /* threads waiting on avail, if sharded */
+    apr_time_t maintained; /* last maintenance, if sharded */
+    apr_thread_t *maintainer; /* background maintenance, if started */
+    apr_thread_mutex_t *poollock; /* pool use outside of listlock */
+    apr_thread_cond_t *maintain; /* wakes up the maintainer */
+    apr_reslist_validator validator;
+    apr_interval_time_t interval; /* maintenance and validation period */
+    apr_resring_t dead_list; /* resources for the maintainer to destroy */
+    int ndead;      /* number of resources in dead_list */
+    int nwait;      /* acquirers waiting for the maintainer */
+    int nbusy;      /* resources being created or validated */
+    int stopping;   /* the maintainer is asked to stop */
+    apr_uint32_t nfailures; /* resources the maintainer failed to create */
+    apr_status_t failure;   /* the last failure to create one */
 #endif
 };
 
+#if APR_HAS_THREADS
+#define reslist_maintained(reslist) ((reslist)->maintainer != NULL)
+#else
+#define reslist_maintained(reslist) 0
+#endif
+
+#if APR_HAS_THREADS
+#if APR_HAS_THREAD_LOCAL
+/* The shard of the current thread, plus one (zero until assigned) */
+static APR_THREAD_LOCAL apr_uint32_t shard_hint;
+#endif
+static apr_uint32_t shard_next;
+
+/**
+ * Get the shard of the current thread. The threads are given the shards
+ * in turn and stick to theirs, or spread per call without thread locals.
+ */
+static apr_res_shard_t *shard_get(apr_reslist_t *reslist)
+{
+    apr_uint32_t hint;
+
+#if APR_HAS_THREAD_LOCAL
+    if (!shard_hint) {
+        shard_hint = apr_atomic_inc32(&shard_next) + 1;
+    }
+    hint = shard_hint - 1;
+#else
+    hint = apr_atomic_inc32(&shard_next);
+#endif
+    return &reslist->shards[hint % (apr_uint32_t)reslist->nshards];
+}
+
+/**
+ * Move available resources to the list, where both are ordered from
+ * the latest freed to the oldest.
+ * Assumes: that the reslist is locked.
+ */
+static void avail_merge(apr_reslist_t *reslist, apr_resring_t *ring)
+{
+    apr_res_t *pos = APR_RING_FIRST(&reslist->avail_list);
+
+    while (!APR_RING_EMPTY(ring, apr_res_t, link)) {
+        apr_res_t *res = APR_RING_FIRST(ring);
+
+        APR_RING_REMOVE(res, link);
+        while (pos != APR_RING_SENTINEL(&reslist->avail_list, apr_res_t, link)
+               && pos->freed > res->freed) {
+            pos = APR_RING_NEXT(pos, link);
+        }
+        APR_RING_INSERT_BEFORE(pos, res, link);
+    }
+}
+
+/**
+ * Move the available resources of a shard back to the list.
+ * Assumes: that the reslist is locked, and the shard too unless the
+ * reslist is being cleaned up.
+ */
+static void shard_drain(apr_reslist_t *reslist, apr_res_shard_t *shard)
+{
+    avail_merge(reslist, &shard->avail_list);
+    reslist->nidle += shard->nidle;
+    shard->nidle = 0;
+}
+
+/**
+ * Take the latest available resource of any shard to the (empty) list.
+ * Assumes: that the reslist is locked.
+ */
+static int reslist_steal(apr_reslist_t *reslist)
+{
+    int i;
+
+    for (i = 0; i < reslist->nshards; i++) {
+        apr_res_shard_t *shard = &reslist->shards[i];
+        apr_res_t *res = NULL;
+
+        apr_thread_mutex_lock(shard->lock);
+        if (shard->nidle > 0) {
+            res = APR_RING_FIRST(&shard->avail_list);
+            APR_RING_REMOVE(res, link);
+            shard->nidle--;
+        }
+        apr_thread_mutex_unlock(shard->lock);
+
+        if (res) {
+            APR_RING_INSERT_HEAD(&reslist->avail_list, res, apr_res_t, link);
+            reslist->nidle++;
+            return 1;
+        }
+    }
+    return 0;
+}
+#else
+#define reslist_steal(reslist) 0
+#endif
+
 /**
  * Grab a resource from the resource list, latest or oldest depending on fifo.
  * Assumes: that the reslist is locked.
@@ -113,6 +245,14 @@ static apr_res_t *get_container(apr_reslist_t *reslist)
         res = APR_RING_FIRST(&reslist->free_list);
         APR_RING_REMOVE(res, link);
     }
+#if APR_HAS_THREADS
+    else if (reslist->maintainer) {
+        /* The maintainer uses the pool outside of the list lock */
+        apr_thread_mutex_lock(reslist->poollock);
+        res = apr_pcalloc(reslist->pool, sizeof(*res));
+        apr_thread_mutex_unlock(reslist->poollock);
+    }
+#endif
     else
         res = apr_pcalloc(reslist->pool, sizeof(*res));
     return res;
@@ -159,8 +299,20 @@ static apr_status_t reslist_cleanup(void *data_)
     apr_res_t *res;
 
 #if APR_HAS_THREADS
+    apr_reslist_maintainer_stop(rl);
+
     apr_thread_mutex_lock(rl->listlock);
     apr_pool_owner_set(rl->pool, 0);
+    {
+        int i;
+
+        /* Nothing uses the shards anymore, and their locks may already
+         * be gone with the pool.
+         */
+        for (i = 0; i < rl->nshards; i++) {
+            shard_drain(rl, &rl->shards[i]);
+        }
+    }
 #endif
 
     while (rl->nidle > 0) {
@@ -198,6 +350,22 @@ static apr_status_t reslist_maintain(apr_reslist_t *reslist)
     apr_res_t *res;
     int created_one = 0;
 
+#if APR_HAS_THREADS
+    /* Rebalance the shards through the list */
+    if (reslist->nshards) {
+        int i;
+
+        for (i = 0; i < reslist->nshards; i++) {
+            apr_res_shard_t *shard = &reslist->shards[i];
+
+            apr_thread_mutex_lock(shard->lock);
+            shard_drain(reslist, shard);
+            apr_thread_mutex_unlock(shard->lock);
+        }
+        reslist->maintained = apr_time_now();
+    }
+#endif
+
     /* Check if we need to create more resources, and if we are allowed to. */
     while (reslist->nidle < reslist->min && reslist->ntotal < reslist->hmax) {
         /* Create the resource */
@@ -251,6 +419,12 @@ APR_DECLARE(apr_status_t) apr_reslist_maintain(apr_reslist_t *reslist)
 
 #if APR_HAS_THREADS
     apr_thread_mutex_lock(reslist->listlock);
+    if (reslist->maintainer) {
+        /* Not here, the pool is the maintainer's */
+        apr_thread_cond_signal(reslist->maintain);
+        apr_thread_mutex_unlock(reslist->listlock);
+        return APR_SUCCESS;
+    }
     apr_pool_owner_set(reslist->pool, 0);
 #endif
     rv = reslist_maintain(reslist);
@@ -260,6 +434,317 @@ APR_DECLARE(apr_status_t) apr_reslist_maintain(apr_reslist_t *reslist)
     return rv;
 }
 
+#if APR_HAS_THREADS
+/**
+ * Hand a resource over to the maintainer for destruction, it still
+ * counts in the total until then.
+ * Assumes: that the reslist is locked.
+ */
+static void dead_push(apr_reslist_t *reslist, apr_res_t *res)
+{
+    APR_RING_INSERT_TAIL(&reslist->dead_list, res, apr_res_t, link);
+    reslist->ndead++;
+    apr_thread_cond_signal(reslist->maintain);
+}
+
+/**
+ * Destroy the dead resources, without the list lock while the destructors
+ * run unless the maintainer is gone.
+ * Assumes: that the reslist is locked.
+ */
+static void dead_destroy(apr_reslist_t *reslist)
+{
+    apr_resring_t ring;
+    int n = reslist->ndead;
+    apr_res_t *res;
+
+    if (!n) {
+        return;
+    }
+    APR_RING_INIT(&ring, apr_res_t, link);
+    APR_RING_CONCAT(&ring, &reslist->dead_list, apr_res_t, link);
+
+    if (reslist->maintainer) {
+        apr_thread_mutex_unlock(reslist->listlock);
+        apr_thread_mutex_lock(reslist->poollock);
+    }
+    apr_pool_owner_set(reslist->pool, 0);
+    for (res = APR_RING_FIRST(&ring);
+         res != APR_RING_SENTINEL(&ring, apr_res_t, link);
+         res = APR_RING_NEXT(res, link)) {
+        destroy_resource(reslist, res);
+    }
+    if (reslist->maintainer) {
+        apr_thread_mutex_unlock(reslist->poollock);
+        apr_thread_mutex_lock(reslist->listlock);
+    }
+
+    while (!APR_RING_EMPTY(&ring, apr_res_t, link)) {
+        res = APR_RING_FIRST(&ring);
+        APR_RING_REMOVE(res, link);
+        free_container(reslist, res);
+    }
+    reslist->ndead -= n;
+    reslist->ntotal -= n;
+}
+
+/**
+ * Move the expired resources, and those of the shards, out of the way
+ * of the acquirers.
+ * Assumes: that the reslist is locked.
+ */
+static void maintainer_expire(apr_reslist_t *reslist)
+{
+    apr_time_t now;
+    int i;
+
+    for (i = 0; i < reslist->nshards; i++) {
+        apr_res_shard_t *shard = &reslist->shards[i];
+
+        apr_thread_mutex_lock(shard->lock);
+        shard_drain(reslist, shard);
+        apr_thread_mutex_unlock(shard->lock);
+    }
+
+    if (!reslist->ttl) {
+        return;
+    }
+    now = apr_time_now();
+    while (reslist->nidle > 0) {
+        apr_res_t *res = APR_RING_LAST(&reslist->avail_list);
+        if (now - res->freed < reslist->ttl) {
+            break;
+        }
+        APR_RING_REMOVE(res, link);
+        reslist->nidle--;
+        dead_push(reslist, res);
+    }
+}
+
+/**
+ * Create the resources below min or waited for, without the list lock
+ * while the constructors run.
+ * Assumes: that the reslist is locked.
+ */
+static apr_status_t maintainer_create(apr_reslist_t *reslist)
+{
+    apr_status_t rv;
+    apr_res_t *res;
+
+    while (!reslist->stopping && reslist->ntotal < reslist->hmax
+           && (reslist->nidle < reslist->min
+               || reslist->nwait > reslist->nidle)) {
+        res = get_container(reslist);
+        reslist->ntotal++;
+        reslist->nbusy++;
+        apr_thread_mutex_unlock(reslist->listlock);
+
+        apr_thread_mutex_lock(reslist->poollock);
+        apr_pool_owner_set(reslist->pool, 0);
+        rv = reslist->constructor(&res->opaque, reslist->params,
+                                  reslist->pool);
+        apr_thread_mutex_unlock(reslist->poollock);
+
+        apr_thread_mutex_lock(reslist->listlock);
+        reslist->nbusy--;
+        if (rv != APR_SUCCESS) {
+            /* Let the waiters fail as they would have */
+            reslist->ntotal--;
+            free_container(reslist, res);
+            reslist->failure = rv;
+            reslist->nfailures++;
+            apr_thread_cond_broadcast(reslist->avail);
+            return rv;
+        }
+        res->checked = apr_time_now();
+        push_resource(reslist, res, 0);
+    }
+
+    return APR_SUCCESS;
+}
+
+/**
+ * Validate the available resources not validated since @a since, one at
+ * a time and without the list lock while the validator runs.
+ * Assumes: that the reslist is locked.
+ */
+static void maintainer_validate(apr_reslist_t *reslist, apr_time_t since)
+{
+    while (!reslist->stopping) {
+        apr_resring_t ring;
+        apr_status_t rv;
+        apr_res_t *res;
+
+        /* The oldest first, as the most likely to be stale */
+        for (res = APR_RING_LAST(&reslist->avail_list);
+             res != APR_RING_SENTINEL(&reslist->avail_list, apr_res_t, link);
+             res = APR_RING_PREV(res, link)) {
+            if (res->checked < since) {
+                break;
+            }
+        }
+        if (res == APR_RING_SENTINEL(&reslist->avail_list, apr_res_t, link)) {
+            break;
+        }
+        APR_RING_REMOVE(res, link);
+        reslist->nidle--;
+        reslist->nbusy++;
+        apr_thread_mutex_unlock(reslist->listlock);
+
+        apr_thread_mutex_lock(reslist->poollock);
+        apr_pool_owner_set(reslist->pool, 0);
+        rv = reslist->validator(res->opaque, reslist->params,
+                                reslist->pool);
+        apr_thread_mutex_unlock(reslist->poollock);
+
+        apr_thread_mutex_lock(reslist->listlock);
+        reslist->nbusy--;
+        if (rv != APR_SUCCESS) {
+            dead_push(reslist, res);
+            continue;
+        }
+        res->checked = apr_time_now();
+        APR_RING_INIT(&ring, apr_res_t, link);
+        APR_RING_INSERT_TAIL(&ring, res, apr_res_t, link);
+        avail_merge(reslist, &ring);
+        reslist->nidle++;
+        apr_thread_cond_signal(reslist->avail);
+    }
+}
+
+static void * APR_THREAD_FUNC reslist_maintainer(apr_thread_t *thd,
+                                                 void *data)
+{
+    apr_reslist_t *reslist = data;
+    apr_time_t validated = apr_time_now();
+
+    apr_thread_mutex_lock(reslist->listlock);
+    for (;;) {
+        apr_status_t rv;
+        apr_time_t now;
+
+        maintainer_expire(reslist);
+        dead_destroy(reslist);
+        if (reslist->stopping) {
+            break;
+        }
+        rv = maintainer_create(reslist);
+
+        now = apr_time_now();
+        if (reslist->validator && now - validated >= reslist->interval) {
+            maintainer_validate(reslist, now);
+            validated = now;
+        }
+
+        /* Sleep, at once if something needs to be done unless creating
+         * resources just failed (then retry only when asked to).
+         */
+        if (reslist->stopping || reslist->ndead) {
+            continue;
+        }
+        if (rv == APR_SUCCESS && reslist->ntotal < reslist->hmax
+            && (reslist->nidle < reslist->min
+                || reslist->nwait > reslist->nidle)) {
+            continue;
+        }
+        apr_thread_cond_timedwait(reslist->maintain, reslist->listlock,
+                                  reslist->interval);
+    }
+    apr_thread_mutex_unlock(reslist->listlock);
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+
+static apr_status_t maintainer_cleanup(void *data)
+{
+    return apr_reslist_maintainer_stop(data);
+}
+#endif
+
+APR_DECLARE(apr_status_t) apr_reslist_maintainer_start(apr_reslist_t *reslist,
+                                                       apr_interval_time_t interval,
+                                                       apr_reslist_validator validator)
+{
+#if APR_HAS_THREADS
+    apr_status_t rv = APR_SUCCESS;
+
+    if (interval <= 0) {
+        return APR_EINVAL;
+    }
+
+    apr_thread_mutex_lock(reslist->listlock);
+    if (reslist->maintainer) {
+        apr_thread_mutex_unlock(reslist->listlock);
+        return APR_EBUSY;
+    }
+    apr_pool_owner_set(reslist->pool, 0);
+    if (!reslist->poollock) {
+        rv = apr_thread_mutex_create(&reslist->poollock,
+                                     APR_THREAD_MUTEX_DEFAULT, reslist->pool);
+        if (rv == APR_SUCCESS) {
+            rv = apr_thread_cond_create(&reslist->maintain, reslist->pool);
+        }
+        if (rv != APR_SUCCESS) {
+            reslist->poollock = NULL;
+            apr_thread_mutex_unlock(reslist->listlock);
+            return rv;
+        }
+        APR_RING_INIT(&reslist->dead_list, apr_res_t, link);
+    }
+    reslist->validator = validator;
+    reslist->interval = interval;
+    reslist->stopping = 0;
+    rv = apr_thread_create(&reslist->maintainer, NULL, reslist_maintainer,
+                           reslist, reslist->pool);
+    if (rv != APR_SUCCESS) {
+        reslist->maintainer = NULL;
+    }
+    else {
+        apr_pool_pre_cleanup_register(reslist->pool, reslist,
+                                      maintainer_cleanup);
+    }
+    apr_thread_mutex_unlock(reslist->listlock);
+
+    return rv;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_reslist_maintainer_stop(apr_reslist_t *reslist)
+{
+#if APR_HAS_THREADS
+    apr_status_t rv, thread_rv;
+    apr_thread_t *thd;
+
+    apr_thread_mutex_lock(reslist->listlock);
+    thd = reslist->maintainer;
+    if (!thd || reslist->stopping) {
+        apr_thread_mutex_unlock(reslist->listlock);
+        return APR_SUCCESS;
+    }
+    reslist->stopping = 1;
+    apr_thread_cond_signal(reslist->maintain);
+    apr_thread_mutex_unlock(reslist->listlock);
+
+    rv = apr_thread_join(&thread_rv, thd);
+
+    /* The waiters create the resources themselves from now */
+    apr_thread_mutex_lock(reslist->listlock);
+    reslist->maintainer = NULL;
+    dead_destroy(reslist);
+    apr_thread_cond_broadcast(reslist->avail);
+    apr_thread_mutex_unlock(reslist->listlock);
+
+    apr_pool_cleanup_kill(reslist->pool, reslist, maintainer_cleanup);
+
+    return rv;
+#else
+    return APR_SUCCESS;
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_reslist_create(apr_reslist_t **reslist,
                                              int min, int smax, int hmax,
                                              apr_interval_time_t ttl,
@@ -335,12 +820,133 @@ APR_DECLARE(apr_status_t) apr_reslist_destroy(apr_reslist_t *reslist)
     return apr_pool_cleanup_run(reslist->pool, reslist, reslist_cleanup);
 }
 
+#if APR_HAS_THREADS
+/**
+ * Grab a resource from the shard of the current thread, destroying the
+ * expired ones on the way.
+ * Returns APR_EAGAIN if the shard has no (more) available resource.
+ */
+static apr_status_t shard_acquire(apr_reslist_t *reslist,
+                                  void **resource, int fifo)
+{
+    apr_res_shard_t *shard = shard_get(reslist);
+    apr_status_t rv = APR_EAGAIN;
+
+    apr_thread_mutex_lock(shard->lock);
+    while (shard->nidle > 0) {
+        apr_res_t *res;
+        void *opaque;
+        int expired;
+
+        if (fifo) {
+            res = APR_RING_LAST(&shard->avail_list);
+        }
+        else {
+            res = APR_RING_FIRST(&shard->avail_list);
+        }
+        APR_RING_REMOVE(res, link);
+        shard->nidle--;
+        opaque = res->opaque;
+        expired = reslist->ttl && apr_time_now() - res->freed >= reslist->ttl;
+        if (!expired) {
+            APR_RING_INSERT_TAIL(&shard->free_list, res, apr_res_t, link);
+            *resource = opaque;
+            rv = APR_SUCCESS;
+            break;
+        }
+
+        /* this res is expired - kill it, which is for the list to do */
+        apr_thread_mutex_unlock(shard->lock);
+        apr_thread_mutex_lock(reslist->listlock);
+        if (reslist->maintainer) {
+            dead_push(reslist, res);
+            apr_thread_mutex_unlock(reslist->listlock);
+            apr_thread_mutex_lock(shard->lock);
+            continue;
+        }
+        apr_pool_owner_set(reslist->pool, 0);
+        reslist->ntotal--;
+        rv = destroy_resource(reslist, res);
+        free_container(reslist, res);
+        apr_thread_cond_signal(reslist->avail);
+        apr_thread_mutex_unlock(reslist->listlock);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        rv = APR_EAGAIN;
+        apr_thread_mutex_lock(shard->lock);
+    }
+    apr_thread_mutex_unlock(shard->lock);
+
+    return rv;
+}
+
+/**
+ * Return a resource to the shard of the current thread, and maintain the
+ * list from time to time if nobody else is doing so.
+ */
+static apr_status_t shard_release(apr_reslist_t *reslist, void *resource)
+{
+    apr_res_shard_t *shard = shard_get(reslist);
+    apr_interval_time_t interval;
+    apr_status_t rv = APR_SUCCESS;
+    apr_res_t *res = NULL;
+    apr_time_t now;
+
+    apr_thread_mutex_lock(shard->lock);
+    if (APR_RING_EMPTY(&shard->free_list, apr_res_t, link)) {
+        /* The containers are allocated from the pool of the list */
+        apr_thread_mutex_unlock(shard->lock);
+        apr_thread_mutex_lock(reslist->listlock);
+        apr_pool_owner_set(reslist->pool, 0);
+        res = get_container(reslist);
+        apr_thread_mutex_unlock(reslist->listlock);
+        apr_thread_mutex_lock(shard->lock);
+    }
+    else {
+        res = APR_RING_FIRST(&shard->free_list);
+        APR_RING_REMOVE(res, link);
+    }
+    res->opaque = resource;
+    now = apr_time_now();
+    res->freed = now;
+    APR_RING_INSERT_HEAD(&shard->avail_list, res, apr_res_t, link);
+    shard->nidle++;
+    apr_thread_mutex_unlock(shard->lock);
+
+    /* The waiters look at the shards before waiting, so it is enough to
+     * signal those already counted.
+     */
+    if (apr_atomic_read32(&reslist->nwaiters)) {
+        apr_thread_mutex_lock(reslist->listlock);
+        apr_thread_cond_signal(reslist->avail);
+        apr_thread_mutex_unlock(reslist->listlock);
+    }
+
+    interval = reslist->ttl ? reslist->ttl : SHARD_MAINTAIN_INTERVAL;
+    if (now - reslist->maintained >= interval && !reslist->maintainer
+        && apr_thread_mutex_trylock(reslist->listlock) == APR_SUCCESS) {
+        apr_pool_owner_set(reslist->pool, 0);
+        if (now - reslist->maintained >= interval && !reslist->maintainer) {
+            rv = reslist_maintain(reslist);
+        }
+        apr_thread_mutex_unlock(reslist->listlock);
+    }
+
+    return rv;
+}
+#endif
+
 static apr_status_t reslist_acquire(apr_reslist_t *reslist,
                                     void **resource, int flags)
 {
     apr_status_t rv;
     apr_res_t *res;
     int fifo;
+#if APR_HAS_THREADS
+    apr_uint32_t nfailures = 0;
+    int waiting = 0;
+#endif
 
     if (flags & ~APR_RESLIST_ACQUIRE_MASK) {
         return APR_EINVAL;
@@ -348,12 +954,19 @@ static apr_status_t reslist_acquire(apr_reslist_t *reslist,
     fifo = flags & APR_RESLIST_ACQUIRE_FIFO;
 
 #if APR_HAS_THREADS
+    if (reslist->nshards) {
+        rv = shard_acquire(reslist, resource, fifo);
+        if (rv != APR_EAGAIN) {
+            return rv;
+        }
+    }
+
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
     /* If there are expired resources in the available list, kill
-     * them right away. */
-    if (reslist->ttl && reslist->nidle > 0) {
+     * them right away (unless that's for the maintainer). */
+    if (reslist->ttl && reslist->nidle > 0 && !reslist_maintained(reslist)) {
         apr_time_t now = apr_time_now();
         do {
             /* Peek at the oldest resource in the list */
@@ -377,8 +990,9 @@ static apr_status_t reslist_acquire(apr_reslist_t *reslist,
             }
         } while (reslist->nidle > 0);
     }
-    /* If there is still an idle resource, use it right away */
-    if (reslist->nidle > 0) {
+    /* If there is still an idle resource, here or in a shard, use it
+     * right away */
+    if (reslist->nidle > 0 || reslist_steal(reslist)) {
         res = pop_resource(reslist, fifo);
         *resource = res->opaque;
         free_container(reslist, res);
@@ -388,14 +1002,34 @@ static apr_status_t reslist_acquire(apr_reslist_t *reslist,
         return APR_SUCCESS;
     }
     /* If we've hit our max, block until we're allowed to create
-     * a new one, or something becomes free. */
-    while (reslist->ntotal >= reslist->hmax && reslist->nidle <= 0) {
+     * a new one, or something becomes free. With a maintainer, block
+     * until it creates one anyway. */
+#if APR_HAS_THREADS
+    if (reslist->nshards) {
+        apr_atomic_inc32(&reslist->nwaiters);
+    }
+    if (reslist->maintainer) {
+        nfailures = reslist->nfailures;
+        reslist->nwait++;
+        waiting = 1;
+    }
+#endif
+    rv = APR_SUCCESS;
+    while ((reslist_maintained(reslist) || reslist->ntotal >= reslist->hmax)
+           && reslist->nidle <= 0 && !reslist_steal(reslist)) {
 #if APR_HAS_THREADS
+        if (reslist->maintainer) {
+            if (waiting && reslist->nfailures != nfailures) {
+                /* It failed to, as we would have */
+                rv = reslist->failure;
+                break;
+            }
+            apr_thread_cond_signal(reslist->maintain);
+        }
         if (reslist->timeout) {
             if ((rv = apr_thread_cond_timedwait(reslist->avail, 
                 reslist->listlock, reslist->timeout)) != APR_SUCCESS) {
-                apr_thread_mutex_unlock(reslist->listlock);
-                return rv;
+                break;
             }
         }
         else {
@@ -405,6 +1039,18 @@ static apr_status_t reslist_acquire(apr_reslist_t *reslist,
         return APR_EAGAIN;
 #endif
     }
+#if APR_HAS_THREADS
+    if (reslist->nshards) {
+        apr_atomic_dec32(&reslist->nwaiters);
+    }
+    if (waiting) {
+        reslist->nwait--;
+    }
+    if (rv != APR_SUCCESS) {
+        apr_thread_mutex_unlock(reslist->listlock);
+        return rv;
+    }
+#endif
     /* If we popped out of the loop, first try to see if there
      * are new resources available for immediate use. */
     if (reslist->nidle > 0) {
@@ -452,13 +1098,22 @@ APR_DECLARE(apr_status_t) apr_reslist_release(apr_reslist_t *reslist,
     apr_res_t *res;
 
 #if APR_HAS_THREADS
+    if (reslist->nshards) {
+        return shard_release(reslist, resource);
+    }
+
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
     res = get_container(reslist);
     res->opaque = resource;
     push_resource(reslist, res, 0);
-    rv = reslist_maintain(reslist);
+    if (reslist_maintained(reslist)) {
+        rv = APR_SUCCESS;
+    }
+    else {
+        rv = reslist_maintain(reslist);
+    }
 #if APR_HAS_THREADS
     apr_thread_mutex_unlock(reslist->listlock);
 #endif
@@ -476,11 +1131,21 @@ APR_DECLARE(apr_uint32_t) apr_reslist_acquired_count(apr_reslist_t *reslist)
     apr_uint32_t count;
 
 #if APR_HAS_THREADS
+    int i;
+
     apr_thread_mutex_lock(reslist->listlock);
     apr_pool_owner_set(reslist->pool, 0);
 #endif
     count = reslist->ntotal - reslist->nidle;
 #if APR_HAS_THREADS
+    count -= reslist->ndead + reslist->nbusy;
+    for (i = 0; i < reslist->nshards; i++) {
+        apr_res_shard_t *shard = &reslist->shards[i];
+
+        apr_thread_mutex_lock(shard->lock);
+        count -= shard->nidle;
+        apr_thread_mutex_unlock(shard->lock);
+    }
     apr_thread_mutex_unlock(reslist->listlock);
 #endif
 
@@ -493,6 +1158,13 @@ APR_DECLARE(apr_status_t) apr_reslist_invalidate(apr_reslist_t *reslist,
     apr_status_t ret;
 #if APR_HAS_THREADS
     apr_thread_mutex_lock(reslist->listlock);
+    if (reslist->maintainer) {
+        apr_res_t *res = get_container(reslist);
+        res->opaque = resource;
+        dead_push(reslist, res);
+        apr_thread_mutex_unlock(reslist->listlock);
+        return APR_SUCCESS;
+    }
     apr_pool_owner_set(reslist->pool, 0);
 #endif
     ret = reslist->destructor(resource, reslist->params, reslist->pool);
@@ -504,6 +1176,41 @@ APR_DECLARE(apr_status_t) apr_reslist_invalidate(apr_reslist_t *reslist,
     return ret;
 }
 
+APR_DECLARE(apr_status_t) apr_reslist_shards_set(apr_reslist_t *reslist,
+                                                 int shards)
+{
+#if APR_HAS_THREADS
+    apr_res_shard_t *s;
+    apr_status_t rv;
+    int i;
+
+    if (shards < 0 || reslist->nshards) {
+        return APR_EINVAL;
+    }
+    if (shards <= 1) {
+        return APR_SUCCESS;
+    }
+
+    s = apr_pcalloc(reslist->pool, shards * sizeof(*s));
+    for (i = 0; i < shards; i++) {
+        APR_RING_INIT(&s[i].avail_list, apr_res_t, link);
+        APR_RING_INIT(&s[i].free_list, apr_res_t, link);
+        rv = apr_thread_mutex_create(&s[i].lock, APR_THREAD_MUTEX_DEFAULT,
+                                     reslist->pool);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    reslist->maintained = apr_time_now();
+    reslist->shards = s;
+    reslist->nshards = shards;
+
+    return APR_SUCCESS;
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
 APR_DECLARE(void) apr_reslist_cleanup_order_set(apr_reslist_t *rl,
                                                 apr_uint32_t mode)
 {
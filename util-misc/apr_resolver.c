@@ -0,0 +1,346 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_resolver.h"
+#include "apr_hash.h"
+#include "apr_strings.h"
+#include "apr_thread_mutex.h"
+
+typedef struct resolver_waiter_t resolver_waiter_t;
+struct resolver_waiter_t {
+    resolver_waiter_t *next;
+    apr_resolver_cb_t *func;
+    void *baton;
+    apr_pool_t *pool;
+    apr_sockaddr_t *sa;
+    apr_status_t status;
+};
+
+/* One cached name, whose addresses are allocated from an unmanaged pool
+ * of their own, such that a resolution can run in any thread and replace
+ * them once done.
+ */
+typedef struct resolver_entry_t {
+    apr_resolver_t *resolver;
+    const char *hostname;
+    apr_int32_t family;
+    apr_port_t port;
+    apr_int32_t flags;
+    /* Protected by the resolver's lock */
+    apr_pool_t *pool;
+    apr_sockaddr_t *sa;
+    apr_status_t status;
+    apr_time_t expires;     /* zero if not (or no longer) resolved */
+    int resolving;          /* a resolution is queued in the thread pool */
+    resolver_waiter_t *waiters;
+} resolver_entry_t;
+
+struct apr_resolver_t {
+    apr_pool_t *pool;
+    apr_interval_time_t ttl;
+    apr_interval_time_t negative_ttl;
+    apr_interval_time_t stale_ttl;
+    /* Protected by lock */
+    apr_hash_t *entries;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+    apr_thread_pool_t *tpool;
+#endif
+};
+
+#if APR_HAS_THREADS
+#define resolver_lock(r)   apr_thread_mutex_lock((r)->lock)
+#define resolver_unlock(r) apr_thread_mutex_unlock((r)->lock)
+#else
+#define resolver_lock(r)
+#define resolver_unlock(r)
+#endif
+
+static apr_status_t resolver_cleanup(void *data)
+{
+    apr_resolver_t *r = data;
+    apr_hash_index_t *hi;
+
+    for (hi = apr_hash_first(NULL, r->entries); hi; hi = apr_hash_next(hi)) {
+        resolver_entry_t *e = apr_hash_this_val(hi);
+        if (e->pool) {
+            apr_pool_destroy(e->pool);
+            e->pool = NULL;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_create(apr_resolver_t **resolver,
+                                              apr_interval_time_t ttl,
+                                              apr_interval_time_t negative_ttl,
+                                              apr_interval_time_t stale_ttl,
+                                              apr_pool_t *p)
+{
+    apr_resolver_t *r;
+
+    if (ttl < 0 || negative_ttl < 0 || stale_ttl < 0) {
+        return APR_EINVAL;
+    }
+
+    r = apr_pcalloc(p, sizeof(*r));
+    r->pool = p;
+    r->ttl = ttl;
+    r->negative_ttl = negative_ttl;
+    r->stale_ttl = stale_ttl;
+    r->entries = apr_hash_make(p);
+#if APR_HAS_THREADS
+    {
+        apr_status_t rv = apr_thread_mutex_create(&r->lock,
+                                                  APR_THREAD_MUTEX_DEFAULT, p);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+#endif
+    apr_pool_cleanup_register(p, r, resolver_cleanup, apr_pool_cleanup_null);
+
+    *resolver = r;
+    return APR_SUCCESS;
+}
+
+#if APR_HAS_THREADS
+APR_DECLARE(apr_status_t) apr_resolver_thread_pool_set(apr_resolver_t *r,
+                                                       apr_thread_pool_t *tpool)
+{
+    resolver_lock(r);
+    r->tpool = tpool;
+    resolver_unlock(r);
+
+    return APR_SUCCESS;
+}
+#endif
+
+/* Called with the lock held */
+static resolver_entry_t *entry_get(apr_resolver_t *r, const char *hostname,
+                                   apr_int32_t family, apr_port_t port,
+                                   apr_int32_t flags, apr_pool_t *p)
+{
+    resolver_entry_t *e;
+    const char *key;
+
+    /* The key is built in the caller's pool, and copied when added */
+    key = apr_psprintf(p, "%s|%d|%d|%d", hostname ? hostname : "",
+                       (int)family, (int)port, (int)flags);
+    e = apr_hash_get(r->entries, key, APR_HASH_KEY_STRING);
+    if (!e) {
+        key = apr_pstrdup(r->pool, key);
+        e = apr_pcalloc(r->pool, sizeof(*e));
+        e->resolver = r;
+        e->hostname = hostname ? apr_pstrdup(r->pool, hostname) : NULL;
+        e->family = family;
+        e->port = port;
+        e->flags = flags;
+        apr_hash_set(r->entries, key, APR_HASH_KEY_STRING, e);
+    }
+    return e;
+}
+
+/* Called with the lock held */
+static apr_status_t entry_copy(resolver_entry_t *e, apr_sockaddr_t **sa,
+                               apr_pool_t *p)
+{
+    *sa = NULL;
+    if (e->status != APR_SUCCESS) {
+        return e->status;
+    }
+    return apr_sockaddr_info_copy(sa, e->sa, p);
+}
+
+static void entry_resolve(resolver_entry_t *e, int queued)
+{
+    apr_resolver_t *r = e->resolver;
+    resolver_waiter_t *waiters = NULL, *w;
+    apr_sockaddr_t *sa = NULL;
+    apr_pool_t *pool, *old;
+    apr_status_t rv;
+
+    rv = apr_pool_create_unmanaged(&pool);
+    if (rv == APR_SUCCESS) {
+        rv = apr_sockaddr_info_get(&sa, e->hostname, e->family, e->port,
+                                   e->flags, pool);
+    }
+    else {
+        pool = NULL;
+    }
+
+    resolver_lock(r);
+    old = e->pool;
+    e->pool = pool;
+    e->sa = sa;
+    e->status = rv;
+    e->expires = apr_time_monotonic() + (rv == APR_SUCCESS ? r->ttl
+                                                     : r->negative_ttl);
+    if (queued) {
+        e->resolving = 0;
+        waiters = e->waiters;
+        e->waiters = NULL;
+        for (w = waiters; w; w = w->next) {
+            w->status = entry_copy(e, &w->sa, w->pool);
+        }
+    }
+    resolver_unlock(r);
+
+    if (old) {
+        apr_pool_destroy(old);
+    }
+    while (waiters) {
+        w = waiters;
+        waiters = w->next;
+        w->func(w->sa, w->status, w->baton);
+    }
+}
+
+#if APR_HAS_THREADS
+
+static void * APR_THREAD_FUNC resolver_task(apr_thread_t *thd, void *data)
+{
+    entry_resolve(data, 1);
+    return NULL;
+}
+
+/* Called with the lock held */
+static apr_status_t entry_queue(resolver_entry_t *e)
+{
+    apr_resolver_t *r = e->resolver;
+    apr_status_t rv;
+
+    if (e->resolving) {
+        return APR_SUCCESS;
+    }
+    if (!r->tpool) {
+        return APR_ENOTIMPL;
+    }
+    rv = apr_thread_pool_push(r->tpool, resolver_task, e,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, r);
+    if (rv == APR_SUCCESS) {
+        e->resolving = 1;
+    }
+    return rv;
+}
+
+#endif /* APR_HAS_THREADS */
+
+/* Called with the lock held, whether the entry can be served as is */
+static int entry_usable(resolver_entry_t *e, apr_time_t now)
+{
+    if (!e->expires) {
+        return 0;
+    }
+    if (now < e->expires) {
+        return 1;
+    }
+#if APR_HAS_THREADS
+    /* stale-while-revalidate */
+    if (e->status == APR_SUCCESS && now < e->expires + e->resolver->stale_ttl
+            && entry_queue(e) == APR_SUCCESS) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_lookup(apr_sockaddr_t **sa,
+                                              apr_resolver_t *r,
+                                              const char *hostname,
+                                              apr_int32_t family,
+                                              apr_port_t port,
+                                              apr_int32_t flags,
+                                              apr_pool_t *p)
+{
+    apr_time_t now = apr_time_monotonic();
+    resolver_entry_t *e;
+    apr_status_t rv;
+
+    resolver_lock(r);
+    e = entry_get(r, hostname, family, port, flags, p);
+    if (entry_usable(e, now)) {
+        rv = entry_copy(e, sa, p);
+        resolver_unlock(r);
+        return rv;
+    }
+    resolver_unlock(r);
+
+    entry_resolve(e, 0);
+
+    resolver_lock(r);
+    rv = entry_copy(e, sa, p);
+    resolver_unlock(r);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_lookup_async(apr_resolver_t *r,
+                                                    const char *hostname,
+                                                    apr_int32_t family,
+                                                    apr_port_t port,
+                                                    apr_int32_t flags,
+                                                    apr_resolver_cb_t *func,
+                                                    void *baton,
+                                                    apr_pool_t *p)
+{
+    apr_time_t now = apr_time_monotonic();
+    resolver_entry_t *e;
+    apr_sockaddr_t *sa;
+    apr_status_t rv;
+
+    resolver_lock(r);
+    e = entry_get(r, hostname, family, port, flags, p);
+    if (!entry_usable(e, now)) {
+#if APR_HAS_THREADS
+        if (entry_queue(e) == APR_SUCCESS) {
+            resolver_waiter_t *w = apr_palloc(p, sizeof(*w));
+            w->func = func;
+            w->baton = baton;
+            w->pool = p;
+            w->next = e->waiters;
+            e->waiters = w;
+            resolver_unlock(r);
+            return APR_SUCCESS;
+        }
+#endif
+        resolver_unlock(r);
+
+        entry_resolve(e, 0);
+
+        resolver_lock(r);
+    }
+    rv = entry_copy(e, &sa, p);
+    resolver_unlock(r);
+
+    func(sa, rv, baton);
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_resolver_clear(apr_resolver_t *r)
+{
+    apr_hash_index_t *hi;
+
+    resolver_lock(r);
+    for (hi = apr_hash_first(NULL, r->entries); hi; hi = apr_hash_next(hi)) {
+        resolver_entry_t *e = apr_hash_this_val(hi);
+        e->expires = 0;
+    }
+    resolver_unlock(r);
+
+    return APR_SUCCESS;
+}
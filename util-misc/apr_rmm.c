@@ -19,6 +19,7 @@
 #include "apr_errno.h"
 #include "apr_lib.h"
 #include "apr_strings.h"
+#include "apr_atomic.h"
 
 /* The RMM region is made up of two doubly-linked-list of blocks; the
  * list of used blocks, and the list of free blocks (either list may
@@ -47,7 +48,17 @@
  * (minus header block); subsequent allocation and deallocation of
  * blocks involves splitting blocks and coalescing adjacent blocks,
  * and switching them between the free and used lists as
- * appropriate. */
+ * appropriate.
+ *
+ * With APR_RMM_SLAB, the header block is followed by a table of size
+ * classes (hdr->slabs is its address, zero otherwise).  Each class has a
+ * lock-free LIFO of free objects, which are blocks with RMM_SLAB_USED or
+ * RMM_SLAB_FREE as their prev field, their size being the size requested
+ * and their next field linking the list.  The head of the list packs the
+ * address of the first object with a tag changed by every update, such
+ * that a compare and swap of both fails if the list changed meanwhile.
+ * The objects are carved out of slabs allocated as used blocks, under the
+ * lock, when the list of their class is empty. */
 
 typedef struct rmm_block_t {
     apr_size_t size;
@@ -61,16 +72,55 @@ typedef struct rmm_hdr_block_t {
     apr_size_t abssize;
     apr_rmm_off_t /* rmm_block_t */ firstused;
     apr_rmm_off_t /* rmm_block_t */ firstfree;
+    apr_rmm_off_t /* rmm_slab_t[] */ slabs;
 } rmm_hdr_block_t;
 
 #define RMM_HDR_BLOCK_SIZE (APR_ALIGN_DEFAULT(sizeof(rmm_hdr_block_t)))
 #define RMM_BLOCK_SIZE (APR_ALIGN_DEFAULT(sizeof(rmm_block_t)))
 
+/* A size class, alone in its cache line */
+#define RMM_SLAB_LINE 64
+typedef struct rmm_slab_t {
+    apr_uint64_t head;      /* RMM_SLAB_HEAD() of the first free object */
+    apr_uint64_t requested; /* bytes requested for the objects in use */
+    apr_uint32_t carved;    /* objects carved, only grows under the lock */
+    apr_uint32_t inuse;     /* objects allocated */
+    char pad[RMM_SLAB_LINE - 2 * sizeof(apr_uint64_t)
+             - 2 * sizeof(apr_uint32_t)];
+} rmm_slab_t;
+
+/* The classes go from 16 bytes to 32KB, in powers of two */
+#define RMM_SLAB_MIN_SHIFT 4
+#define RMM_SLAB_CLASSES 12
+#define RMM_SLAB_MAX (1 << (RMM_SLAB_MIN_SHIFT + RMM_SLAB_CLASSES - 1))
+#define RMM_SLAB_SIZE(i) ((apr_size_t)1 << (RMM_SLAB_MIN_SHIFT + (i)))
+#define RMM_SLAB_TABLE_SIZE (RMM_SLAB_CLASSES * sizeof(rmm_slab_t))
+
+/* How much a refill carves at least, in bytes and in objects */
+#define RMM_SLAB_CHUNK 16384
+#define RMM_SLAB_CHUNK_MIN 4
+
+/* The prev field of the slab objects, never a block address */
+#define RMM_SLAB_USED ((apr_rmm_off_t)-1)
+#define RMM_SLAB_FREE ((apr_rmm_off_t)-2)
+
+/* Addresses are counted in APR_ALIGN_DEFAULT units in the low 32 bits of
+ * the heads, whose high 32 bits are the tag.
+ */
+#define RMM_SLAB_UNIT_SHIFT 3
+#define RMM_SLAB_MAX_MEM ((apr_uint64_t)0xffffffff << RMM_SLAB_UNIT_SHIFT)
+#define RMM_SLAB_HEAD(off, tag) \
+    (((apr_uint64_t)(tag) << 32) | ((off) >> RMM_SLAB_UNIT_SHIFT))
+#define RMM_SLAB_OFF(head) \
+    ((apr_rmm_off_t)((head) & 0xffffffff) << RMM_SLAB_UNIT_SHIFT)
+#define RMM_SLAB_TAG(head) ((apr_uint32_t)((head) >> 32))
+
 struct apr_rmm_t {
     apr_pool_t *p;
     rmm_hdr_block_t *base;
     apr_size_t size;
     apr_anylock_t lock;
+    rmm_slab_t *slabs;
 };
 
 static apr_rmm_off_t find_block_by_offset(apr_rmm_t *rmm, apr_rmm_off_t next, 
@@ -213,11 +263,21 @@ static void move_block(apr_rmm_t *rmm, apr_rmm_off_t this, int free)
 APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock, 
                                        void *base, apr_size_t size,
                                        apr_pool_t *p)
+{
+    return apr_rmm_init_ex(rmm, lock, base, size, 0, p);
+}
+
+APR_DECLARE(apr_status_t) apr_rmm_init_ex(apr_rmm_t **rmm, apr_anylock_t *lock,
+                                          void *base, apr_size_t size,
+                                          apr_uint32_t flags, apr_pool_t *p)
 {
     apr_status_t rv;
     rmm_block_t *blk;
     apr_anylock_t nulllock;
-    
+
+    if ((flags & APR_RMM_SLAB) && (apr_uint64_t)size > RMM_SLAB_MAX_MEM) {
+        return APR_EINVAL;
+    }
     if (!lock) {
         nulllock.type = apr_anylock_none;
         nulllock.lock.pm = NULL;
@@ -235,6 +295,14 @@ APR_DECLARE(apr_status_t) apr_rmm_init(apr_rmm_t **rmm, apr_anylock_t *lock,
     (*rmm)->base->abssize = size;
     (*rmm)->base->firstused = 0;
     (*rmm)->base->firstfree = RMM_HDR_BLOCK_SIZE;
+    (*rmm)->base->slabs = 0;
+
+    if (flags & APR_RMM_SLAB) {
+        (*rmm)->base->slabs = APR_ALIGN(RMM_HDR_BLOCK_SIZE, RMM_SLAB_LINE);
+        (*rmm)->base->firstfree = (*rmm)->base->slabs + RMM_SLAB_TABLE_SIZE;
+        (*rmm)->slabs = (rmm_slab_t *)((char*)base + (*rmm)->base->slabs);
+        memset((*rmm)->slabs, 0, RMM_SLAB_TABLE_SIZE);
+    }
 
     blk = (rmm_block_t *)((char*)base + (*rmm)->base->firstfree);
 
@@ -272,6 +340,9 @@ APR_DECLARE(apr_status_t) apr_rmm_destroy(apr_rmm_t *rmm)
         } while (this);
         rmm->base->firstfree = 0;
     }
+    if (rmm->slabs) {
+        memset(rmm->slabs, 0, RMM_SLAB_TABLE_SIZE);
+    }
     rmm->base->abssize = 0;
     rmm->size = 0;
 
@@ -295,6 +366,9 @@ APR_DECLARE(apr_status_t) apr_rmm_attach(apr_rmm_t **rmm, apr_anylock_t *lock,
     (*rmm)->base = base;
     (*rmm)->size = (*rmm)->base->abssize;
     (*rmm)->lock = *lock;
+    if ((*rmm)->base->slabs) {
+        (*rmm)->slabs = (rmm_slab_t *)((char*)base + (*rmm)->base->slabs);
+    }
     return APR_SUCCESS;
 }
 
@@ -304,6 +378,149 @@ APR_DECLARE(apr_status_t) apr_rmm_detach(apr_rmm_t *rmm)
     return APR_SUCCESS;
 }
 
+static APR_INLINE int slab_class(apr_size_t size)
+{
+    int i = 0;
+
+    while (RMM_SLAB_SIZE(i) < size) {
+        i++;
+    }
+    return i;
+}
+
+static APR_INLINE rmm_block_t *slab_block(apr_rmm_t *rmm, apr_rmm_off_t this)
+{
+    return (rmm_block_t*)((char*)rmm->base + this);
+}
+
+/* Push the objects linked from first to last */
+static void slab_push(apr_rmm_t *rmm, rmm_slab_t *slab,
+                      apr_rmm_off_t first, apr_rmm_off_t last)
+{
+    apr_uint64_t head = apr_atomic_read64(&slab->head), prev;
+
+    for (;;) {
+        slab_block(rmm, last)->next = RMM_SLAB_OFF(head);
+        prev = apr_atomic_cas64(&slab->head,
+                                RMM_SLAB_HEAD(first, RMM_SLAB_TAG(head) + 1),
+                                head);
+        if (prev == head) {
+            return;
+        }
+        head = prev;
+    }
+}
+
+static apr_rmm_off_t slab_pop(apr_rmm_t *rmm, rmm_slab_t *slab)
+{
+    apr_uint64_t head = apr_atomic_read64(&slab->head), prev;
+
+    for (;;) {
+        apr_rmm_off_t this = RMM_SLAB_OFF(head), next;
+
+        if (!this) {
+            return 0;
+        }
+
+        /* The object may be popped and reused meanwhile, its next field
+         * being garbage then, but the tag of the head changed with it.
+         */
+        next = ((volatile rmm_block_t *)slab_block(rmm, this))->next;
+        prev = apr_atomic_cas64(&slab->head,
+                                RMM_SLAB_HEAD(next, RMM_SLAB_TAG(head) + 1),
+                                head);
+        if (prev == head) {
+            return this;
+        }
+        head = prev;
+    }
+}
+
+/* Carve a new slab for the class, keeping one object for the caller */
+static apr_rmm_off_t slab_refill(apr_rmm_t *rmm, int i)
+{
+    rmm_slab_t *slab = &rmm->slabs[i];
+    apr_size_t objsize = RMM_BLOCK_SIZE + RMM_SLAB_SIZE(i);
+    apr_size_t n = RMM_SLAB_CHUNK / objsize, k;
+    apr_rmm_off_t this = 0, first;
+
+    if (n < RMM_SLAB_CHUNK_MIN) {
+        n = RMM_SLAB_CHUNK_MIN;
+    }
+
+    APR_ANYLOCK_LOCK(&rmm->lock);
+
+    /* Another thread may have refilled it since we saw it empty */
+    if ((this = slab_pop(rmm, slab)) == 0) {
+        for (; n; n /= 2) {
+            this = find_block_of_size(rmm, RMM_BLOCK_SIZE + n * objsize);
+            if (this) {
+                break;
+            }
+        }
+        if (this) {
+            move_block(rmm, this, 0);
+            first = this + RMM_BLOCK_SIZE;
+            for (k = 0; k < n; k++) {
+                rmm_block_t *blk = slab_block(rmm, first + k * objsize);
+
+                blk->size = 0;
+                blk->prev = RMM_SLAB_FREE;
+                blk->next = first + (k + 1) * objsize;
+            }
+            apr_atomic_add32(&slab->carved, (apr_uint32_t)n);
+            if (n > 1) {
+                slab_push(rmm, slab, first + objsize,
+                          first + (n - 1) * objsize);
+            }
+            this = first;
+        }
+    }
+
+    APR_ANYLOCK_UNLOCK(&rmm->lock);
+    return this;
+}
+
+static apr_rmm_off_t slab_alloc(apr_rmm_t *rmm, apr_size_t reqsize)
+{
+    int i = slab_class(reqsize);
+    rmm_slab_t *slab = &rmm->slabs[i];
+    apr_rmm_off_t this;
+    rmm_block_t *blk;
+
+    this = slab_pop(rmm, slab);
+    if (!this && (this = slab_refill(rmm, i)) == 0) {
+        return 0;
+    }
+
+    blk = slab_block(rmm, this);
+    blk->size = reqsize;
+    blk->prev = RMM_SLAB_USED;
+    apr_atomic_inc32(&slab->inuse);
+    apr_atomic_add64(&slab->requested, reqsize);
+
+    return this + RMM_BLOCK_SIZE;
+}
+
+static apr_status_t slab_free(apr_rmm_t *rmm, apr_rmm_off_t this)
+{
+    rmm_block_t *blk = slab_block(rmm, this);
+    rmm_slab_t *slab;
+    apr_size_t reqsize = blk->size;
+
+    if (reqsize > RMM_SLAB_MAX) {
+        return APR_EINVAL;
+    }
+    slab = &rmm->slabs[slab_class(reqsize)];
+
+    blk->prev = RMM_SLAB_FREE;
+    apr_atomic_dec32(&slab->inuse);
+    apr_atomic_sub64(&slab->requested, reqsize);
+    slab_push(rmm, slab, this, this);
+
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_rmm_off_t) apr_rmm_malloc(apr_rmm_t *rmm, apr_size_t reqsize)
 {
     apr_size_t size;
@@ -314,6 +531,10 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_malloc(apr_rmm_t *rmm, apr_size_t reqsize)
         return 0;
     }
 
+    if (rmm->slabs && reqsize <= RMM_SLAB_MAX) {
+        return slab_alloc(rmm, APR_ALIGN_DEFAULT(reqsize));
+    }
+
     APR_ANYLOCK_LOCK(&rmm->lock);
 
     this = find_block_of_size(rmm, size);
@@ -337,6 +558,14 @@ APR_DECLARE(apr_rmm_off_t) apr_rmm_calloc(apr_rmm_t *rmm, apr_size_t reqsize)
         return 0;
     }
 
+    if (rmm->slabs && reqsize <= RMM_SLAB_MAX) {
+        this = slab_alloc(rmm, APR_ALIGN_DEFAULT(reqsize));
+        if (this) {
+            memset((char*)rmm->base + this, 0, APR_ALIGN_DEFAULT(reqsize));
+        }
+        return this;
+    }
+
     APR_ANYLOCK_LOCK(&rmm->lock);
 
     this = find_block_of_size(rmm, size);
@@ -399,6 +628,13 @@ APR_DECLARE(apr_status_t) apr_rmm_free(apr_rmm_t *rmm, apr_rmm_off_t this)
 
     blk = (rmm_block_t*)((char*)rmm->base + this);
 
+    if (rmm->slabs && blk->prev == RMM_SLAB_USED) {
+        return slab_free(rmm, this);
+    }
+    if (blk->prev == RMM_SLAB_FREE) {
+        return APR_EINVAL;
+    }
+
     if ((rv = APR_ANYLOCK_LOCK(&rmm->lock)) != APR_SUCCESS) {
         return rv;
     }
@@ -455,3 +691,45 @@ APR_DECLARE(apr_size_t) apr_rmm_overhead_get(int n)
      * structure. */
     return RMM_HDR_BLOCK_SIZE + n * (RMM_BLOCK_SIZE + APR_ALIGN_DEFAULT(1));
 }
+
+APR_DECLARE(apr_status_t) apr_rmm_stats_get(apr_rmm_t *rmm,
+                                            apr_rmm_stats_t *stats)
+{
+    apr_status_t rv;
+    apr_rmm_off_t this;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->size = rmm->size;
+
+    if ((rv = APR_ANYLOCK_LOCK(&rmm->lock)) != APR_SUCCESS) {
+        return rv;
+    }
+    for (this = rmm->base->firstfree; this; ) {
+        rmm_block_t *blk = (rmm_block_t*)((char*)rmm->base + this);
+
+        stats->free += blk->size;
+        stats->free_blocks++;
+        if (blk->size > stats->largest_free) {
+            stats->largest_free = blk->size;
+        }
+        this = blk->next;
+    }
+    APR_ANYLOCK_UNLOCK(&rmm->lock);
+
+    if (rmm->slabs) {
+        int i;
+
+        for (i = 0; i < RMM_SLAB_CLASSES; i++) {
+            rmm_slab_t *slab = &rmm->slabs[i];
+            apr_size_t objsize = RMM_BLOCK_SIZE + RMM_SLAB_SIZE(i);
+
+            stats->slab_carved += objsize * apr_atomic_read32(&slab->carved);
+            stats->slab_inuse += RMM_SLAB_SIZE(i)
+                                 * apr_atomic_read32(&slab->inuse);
+            stats->slab_requested += (apr_size_t)
+                apr_atomic_read64(&slab->requested);
+        }
+    }
+
+    return APR_SUCCESS;
+}
@@ -0,0 +1,600 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_shm_hash.h"
+#include "apr_shm.h"
+#include "apr_rmm.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+#include "apr_thread_proc.h"
+#include "apr_proc_mutex.h"
+#include "apr_portable.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+/* The segment starts with a header line, followed by the line of each
+ * stripe plus the one of the allocator lock, the buckets, and the memory
+ * of the entries managed by an apr_rmm.  Nothing in there is a pointer,
+ * since the processes may map the segment at different addresses.
+ */
+#define SHM_HASH_LINE 64
+#define SHM_HASH_MAGIC 0x53484854 /* "SHHT" */
+#define SHM_HASH_DEFAULT_STRIPES 16
+#define SHM_HASH_BUCKET_BYTES 512
+#define SHM_HASH_MIN_ROOM 1024
+
+/* How many times a spinlock is tried before yielding */
+#define SHM_HASH_SPINS 100
+
+typedef struct shm_hash_header_t {
+    apr_uint32_t magic;
+    apr_uint32_t flags;
+    apr_uint32_t nbuckets;
+    apr_uint32_t nstripes;
+} shm_hash_header_t;
+
+/* The LRU list of a stripe runs from its most to its least recently used
+ * entry, and is maintained with APR_SHM_HASH_LRU only.
+ */
+typedef struct shm_hash_stripe_t {
+    volatile apr_uint32_t lock;
+    volatile apr_uint32_t count;
+    apr_rmm_off_t lru_head;
+    apr_rmm_off_t lru_tail;
+} shm_hash_stripe_t;
+
+/* An entry is followed by its key then its value; offset zero, where the
+ * apr_rmm keeps its own header, ends the lists.
+ */
+typedef struct shm_hash_entry_t {
+    apr_rmm_off_t next;
+    apr_rmm_off_t lru_prev;
+    apr_rmm_off_t lru_next;
+    apr_time_t expires;
+    apr_uint32_t hash;
+    apr_uint32_t klen;
+    apr_size_t vlen;
+} shm_hash_entry_t;
+
+struct apr_shm_hash_t {
+    apr_pool_t *pool;
+    apr_shm_t *shm;
+    char *base;
+    shm_hash_header_t *hdr;
+    apr_rmm_off_t *buckets;
+    apr_rmm_t *rmm;
+    unsigned int nbuckets;
+    unsigned int nstripes;
+#if APR_HAS_FUTEX_SERIALIZE
+    apr_proc_mutex_t **mutexes;
+#endif
+};
+
+#define SHM_HASH_STRIPE(ht, i) \
+    ((shm_hash_stripe_t *)((ht)->base + SHM_HASH_LINE * ((i) + 1)))
+#define SHM_HASH_ALLOC_LOCK(ht) ((ht)->nstripes)
+
+#define SHM_HASH_ENTRY(ht, off) \
+    ((shm_hash_entry_t *)apr_rmm_addr_get((ht)->rmm, (off)))
+#define SHM_HASH_KEY(e) ((char *)(e) + sizeof(shm_hash_entry_t))
+#define SHM_HASH_VAL(e) (SHM_HASH_KEY(e) + (e)->klen)
+
+static apr_size_t shm_hash_buckets_offset(unsigned int nstripes)
+{
+    return (apr_size_t)SHM_HASH_LINE * (nstripes + 2);
+}
+
+static apr_size_t shm_hash_rmm_offset(unsigned int nbuckets,
+                                      unsigned int nstripes)
+{
+    return APR_ALIGN(shm_hash_buckets_offset(nstripes)
+                     + sizeof(apr_rmm_off_t) * nbuckets, SHM_HASH_LINE);
+}
+
+static apr_status_t shm_hash_lock(apr_shm_hash_t *ht, unsigned int i)
+{
+    volatile apr_uint32_t *word = &SHM_HASH_STRIPE(ht, i)->lock;
+    int spins = 0;
+
+#if APR_HAS_FUTEX_SERIALIZE
+    if (ht->mutexes) {
+        return apr_proc_mutex_lock(ht->mutexes[i]);
+    }
+#endif
+
+    while (apr_atomic_cas32(word, 1, 0) != 0) {
+        if (++spins < SHM_HASH_SPINS) {
+            continue;
+        }
+        spins = 0;
+#if APR_HAS_THREADS
+        apr_thread_yield();
+#else
+        apr_sleep(0);
+#endif
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t shm_hash_unlock(apr_shm_hash_t *ht, unsigned int i)
+{
+#if APR_HAS_FUTEX_SERIALIZE
+    if (ht->mutexes) {
+        return apr_proc_mutex_unlock(ht->mutexes[i]);
+    }
+#endif
+
+    apr_atomic_set32(&SHM_HASH_STRIPE(ht, i)->lock, 0);
+    return APR_SUCCESS;
+}
+
+/* The apr_rmm is shared by all the stripes, hence its own lock, always
+ * taken after the stripe's.
+ */
+static apr_rmm_off_t shm_hash_alloc(apr_shm_hash_t *ht, apr_size_t size)
+{
+    apr_rmm_off_t off;
+
+    if (shm_hash_lock(ht, SHM_HASH_ALLOC_LOCK(ht)) != APR_SUCCESS) {
+        return 0;
+    }
+    off = apr_rmm_malloc(ht->rmm, size);
+    shm_hash_unlock(ht, SHM_HASH_ALLOC_LOCK(ht));
+
+    return off;
+}
+
+static void shm_hash_free(apr_shm_hash_t *ht, apr_rmm_off_t off)
+{
+    if (shm_hash_lock(ht, SHM_HASH_ALLOC_LOCK(ht)) == APR_SUCCESS) {
+        apr_rmm_free(ht->rmm, off);
+        shm_hash_unlock(ht, SHM_HASH_ALLOC_LOCK(ht));
+    }
+}
+
+static void shm_hash_lru_unlink(apr_shm_hash_t *ht, shm_hash_stripe_t *s,
+                                shm_hash_entry_t *e)
+{
+    if (e->lru_prev) {
+        SHM_HASH_ENTRY(ht, e->lru_prev)->lru_next = e->lru_next;
+    }
+    else {
+        s->lru_head = e->lru_next;
+    }
+    if (e->lru_next) {
+        SHM_HASH_ENTRY(ht, e->lru_next)->lru_prev = e->lru_prev;
+    }
+    else {
+        s->lru_tail = e->lru_prev;
+    }
+}
+
+static void shm_hash_lru_push(apr_shm_hash_t *ht, shm_hash_stripe_t *s,
+                              shm_hash_entry_t *e, apr_rmm_off_t off)
+{
+    e->lru_prev = 0;
+    e->lru_next = s->lru_head;
+    if (s->lru_head) {
+        SHM_HASH_ENTRY(ht, s->lru_head)->lru_prev = off;
+    }
+    else {
+        s->lru_tail = off;
+    }
+    s->lru_head = off;
+}
+
+/* Unlink the entry referenced by *link from its bucket and free it */
+static void shm_hash_release(apr_shm_hash_t *ht, shm_hash_stripe_t *s,
+                             apr_rmm_off_t *link)
+{
+    apr_rmm_off_t off = *link;
+    shm_hash_entry_t *e = SHM_HASH_ENTRY(ht, off);
+
+    *link = e->next;
+    if (ht->hdr->flags & APR_SHM_HASH_LRU) {
+        shm_hash_lru_unlink(ht, s, e);
+    }
+    s->count--;
+    shm_hash_free(ht, off);
+}
+
+#define SHM_HASH_EXPIRED(e, now) ((e)->expires && (e)->expires <= (now))
+
+/* Look a key up in its bucket, releasing the expired entries on the way.
+ * Returns the link referencing the entry, or NULL if not found.
+ */
+static apr_rmm_off_t *shm_hash_find(apr_shm_hash_t *ht, shm_hash_stripe_t *s,
+                                    unsigned int bucket, const void *key,
+                                    apr_size_t klen, apr_uint32_t hash,
+                                    apr_time_t now)
+{
+    apr_rmm_off_t *link = &ht->buckets[bucket];
+
+    while (*link) {
+        shm_hash_entry_t *e = SHM_HASH_ENTRY(ht, *link);
+
+        if (SHM_HASH_EXPIRED(e, now)) {
+            shm_hash_release(ht, s, link);
+            continue;
+        }
+        if (e->hash == hash && e->klen == klen
+                && !memcmp(SHM_HASH_KEY(e), key, klen)) {
+            return link;
+        }
+        link = &e->next;
+    }
+    return NULL;
+}
+
+static void shm_hash_expire(apr_shm_hash_t *ht, unsigned int stripe,
+                            apr_time_t now)
+{
+    shm_hash_stripe_t *s = SHM_HASH_STRIPE(ht, stripe);
+    unsigned int i;
+
+    for (i = stripe; i < ht->nbuckets; i += ht->nstripes) {
+        apr_rmm_off_t *link = &ht->buckets[i];
+
+        while (*link) {
+            shm_hash_entry_t *e = SHM_HASH_ENTRY(ht, *link);
+
+            if (SHM_HASH_EXPIRED(e, now)) {
+                shm_hash_release(ht, s, link);
+            }
+            else {
+                link = &e->next;
+            }
+        }
+    }
+}
+
+static int shm_hash_evict(apr_shm_hash_t *ht, shm_hash_stripe_t *s)
+{
+    shm_hash_entry_t *victim;
+    apr_rmm_off_t *link;
+
+    if (!s->lru_tail) {
+        return 0;
+    }
+    victim = SHM_HASH_ENTRY(ht, s->lru_tail);
+
+    link = &ht->buckets[victim->hash % ht->nbuckets];
+    while (*link != s->lru_tail) {
+        link = &SHM_HASH_ENTRY(ht, *link)->next;
+    }
+    shm_hash_release(ht, s, link);
+    return 1;
+}
+
+static apr_status_t shm_hash_open(apr_shm_hash_t **ht, apr_shm_t *shm,
+                                  int create, apr_pool_t *pool)
+{
+    apr_shm_hash_t *new_ht;
+    apr_size_t size = apr_shm_size_get(shm), rmm_off;
+    apr_status_t rv;
+
+    new_ht = apr_pcalloc(pool, sizeof(apr_shm_hash_t));
+    new_ht->pool = pool;
+    new_ht->shm = shm;
+    new_ht->base = apr_shm_baseaddr_get(shm);
+    new_ht->hdr = (shm_hash_header_t *)new_ht->base;
+
+    if (size < SHM_HASH_LINE || new_ht->hdr->magic != SHM_HASH_MAGIC
+            || !new_ht->hdr->nbuckets || !new_ht->hdr->nstripes) {
+        return APR_EINVAL;
+    }
+    new_ht->nbuckets = new_ht->hdr->nbuckets;
+    new_ht->nstripes = new_ht->hdr->nstripes;
+    rmm_off = shm_hash_rmm_offset(new_ht->nbuckets, new_ht->nstripes);
+    if (size < rmm_off + SHM_HASH_MIN_ROOM) {
+        return APR_EINVAL;
+    }
+    new_ht->buckets = (apr_rmm_off_t *)(new_ht->base
+                                 + shm_hash_buckets_offset(new_ht->nstripes));
+
+    if (create) {
+        rv = apr_rmm_init(&new_ht->rmm, NULL, new_ht->base + rmm_off,
+                          size - rmm_off, pool);
+    }
+    else {
+        rv = apr_rmm_attach(&new_ht->rmm, NULL, new_ht->base + rmm_off,
+                            pool);
+    }
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+#if APR_HAS_FUTEX_SERIALIZE
+    if (!(new_ht->hdr->flags & APR_SHM_HASH_SPINLOCK)) {
+        unsigned int i;
+
+        new_ht->mutexes = apr_pcalloc(pool, sizeof(apr_proc_mutex_t *)
+                                            * (new_ht->nstripes + 1));
+        for (i = 0; i <= new_ht->nstripes; i++) {
+            apr_os_proc_mutex_t ospmutex;
+
+            memset(&ospmutex, 0, sizeof(ospmutex));
+            ospmutex.futex_interproc =
+                (apr_uint32_t *)&SHM_HASH_STRIPE(new_ht, i)->lock;
+            rv = apr_os_proc_mutex_put_ex(&new_ht->mutexes[i], &ospmutex,
+                                          APR_LOCK_FUTEX, 0, pool);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+    }
+#endif
+
+    *ht = new_ht;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_create(apr_shm_hash_t **ht,
+                                              apr_size_t size,
+                                              const char *filename,
+                                              unsigned int nbuckets,
+                                              unsigned int nstripes,
+                                              apr_uint32_t flags,
+                                              apr_pool_t *pool)
+{
+    shm_hash_header_t *hdr;
+    apr_shm_t *shm;
+    apr_size_t rmm_off;
+    apr_status_t rv;
+
+    if (!nbuckets) {
+        nbuckets = (unsigned int)(size / SHM_HASH_BUCKET_BYTES);
+        if (!nbuckets) {
+            nbuckets = 1;
+        }
+    }
+    if (!nstripes) {
+        nstripes = SHM_HASH_DEFAULT_STRIPES;
+    }
+    if (nstripes > nbuckets) {
+        nstripes = nbuckets;
+    }
+    rmm_off = shm_hash_rmm_offset(nbuckets, nstripes);
+    if (size < rmm_off + SHM_HASH_MIN_ROOM) {
+        return APR_EINVAL;
+    }
+#if !APR_HAS_FUTEX_SERIALIZE
+    /* Recorded for the attaching processes to agree on the locks */
+    flags |= APR_SHM_HASH_SPINLOCK;
+#endif
+
+    rv = apr_shm_create(&shm, size, filename, pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    hdr = apr_shm_baseaddr_get(shm);
+    memset(hdr, 0, rmm_off);
+    hdr->flags = flags & (APR_SHM_HASH_LRU | APR_SHM_HASH_SPINLOCK);
+    hdr->nbuckets = nbuckets;
+    hdr->nstripes = nstripes;
+    hdr->magic = SHM_HASH_MAGIC;
+
+    rv = shm_hash_open(ht, shm, 1, pool);
+    if (rv != APR_SUCCESS) {
+        apr_shm_destroy(shm);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_attach(apr_shm_hash_t **ht,
+                                              const char *filename,
+                                              apr_pool_t *pool)
+{
+    apr_shm_t *shm;
+    apr_status_t rv;
+
+    rv = apr_shm_attach(&shm, filename, pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rv = shm_hash_open(ht, shm, 0, pool);
+    if (rv != APR_SUCCESS) {
+        apr_shm_detach(shm);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_detach(apr_shm_hash_t *ht)
+{
+    apr_rmm_detach(ht->rmm);
+    return apr_shm_detach(ht->shm);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_destroy(apr_shm_hash_t *ht)
+{
+    apr_rmm_detach(ht->rmm);
+    return apr_shm_destroy(ht->shm);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_set(apr_shm_hash_t *ht,
+                                           const void *key, apr_ssize_t klen,
+                                           const void *val, apr_size_t vlen,
+                                           apr_interval_time_t ttl)
+{
+    apr_uint32_t hash = apr_hashfunc_default((const char *)key, &klen);
+    unsigned int bucket = hash % ht->nbuckets;
+    unsigned int stripe = bucket % ht->nstripes;
+    shm_hash_stripe_t *s = SHM_HASH_STRIPE(ht, stripe);
+    apr_size_t size = sizeof(shm_hash_entry_t) + klen + vlen;
+    apr_time_t now = apr_time_now();
+    shm_hash_entry_t *e;
+    apr_rmm_off_t off, *link;
+    apr_status_t rv;
+
+    if ((rv = shm_hash_lock(ht, stripe)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    /* Make room first, which may evict the previous value itself */
+    off = shm_hash_alloc(ht, size);
+    if (!off) {
+        shm_hash_expire(ht, stripe, now);
+        off = shm_hash_alloc(ht, size);
+    }
+    while (!off && (ht->hdr->flags & APR_SHM_HASH_LRU)
+                && shm_hash_evict(ht, s)) {
+        off = shm_hash_alloc(ht, size);
+    }
+    if (!off) {
+        shm_hash_unlock(ht, stripe);
+        return APR_ENOMEM;
+    }
+
+    e = SHM_HASH_ENTRY(ht, off);
+    e->expires = ttl > 0 ? now + ttl : 0;
+    e->hash = hash;
+    e->klen = (apr_uint32_t)klen;
+    e->vlen = vlen;
+    memcpy(SHM_HASH_KEY(e), key, klen);
+    memcpy(SHM_HASH_VAL(e), val, vlen);
+
+    link = shm_hash_find(ht, s, bucket, key, klen, hash, now);
+    if (link) {
+        apr_rmm_off_t old = *link;
+        shm_hash_entry_t *prev = SHM_HASH_ENTRY(ht, old);
+
+        e->next = prev->next;
+        *link = off;
+        if (ht->hdr->flags & APR_SHM_HASH_LRU) {
+            shm_hash_lru_unlink(ht, s, prev);
+        }
+        shm_hash_free(ht, old);
+    }
+    else {
+        e->next = ht->buckets[bucket];
+        ht->buckets[bucket] = off;
+        s->count++;
+    }
+    if (ht->hdr->flags & APR_SHM_HASH_LRU) {
+        shm_hash_lru_push(ht, s, e, off);
+    }
+
+    return shm_hash_unlock(ht, stripe);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_get(apr_shm_hash_t *ht,
+                                           const void *key, apr_ssize_t klen,
+                                           void **val, apr_size_t *vlen,
+                                           apr_pool_t *pool)
+{
+    apr_uint32_t hash = apr_hashfunc_default((const char *)key, &klen);
+    unsigned int bucket = hash % ht->nbuckets;
+    unsigned int stripe = bucket % ht->nstripes;
+    shm_hash_stripe_t *s = SHM_HASH_STRIPE(ht, stripe);
+    shm_hash_entry_t *e;
+    apr_rmm_off_t *link;
+    apr_status_t rv;
+    char *copy;
+
+    if ((rv = shm_hash_lock(ht, stripe)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    link = shm_hash_find(ht, s, bucket, key, klen, hash, apr_time_now());
+    if (!link) {
+        shm_hash_unlock(ht, stripe);
+        return APR_NOTFOUND;
+    }
+
+    e = SHM_HASH_ENTRY(ht, *link);
+    copy = apr_palloc(pool, e->vlen + 1);
+    memcpy(copy, SHM_HASH_VAL(e), e->vlen);
+    copy[e->vlen] = '\0';
+    *val = copy;
+    if (vlen) {
+        *vlen = e->vlen;
+    }
+    if (ht->hdr->flags & APR_SHM_HASH_LRU) {
+        shm_hash_lru_unlink(ht, s, e);
+        shm_hash_lru_push(ht, s, e, *link);
+    }
+
+    return shm_hash_unlock(ht, stripe);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_hash_delete(apr_shm_hash_t *ht,
+                                              const void *key,
+                                              apr_ssize_t klen)
+{
+    apr_uint32_t hash = apr_hashfunc_default((const char *)key, &klen);
+    unsigned int bucket = hash % ht->nbuckets;
+    unsigned int stripe = bucket % ht->nstripes;
+    shm_hash_stripe_t *s = SHM_HASH_STRIPE(ht, stripe);
+    apr_rmm_off_t *link;
+    apr_status_t rv;
+
+    if ((rv = shm_hash_lock(ht, stripe)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    link = shm_hash_find(ht, s, bucket, key, klen, hash, apr_time_now());
+    if (!link) {
+        shm_hash_unlock(ht, stripe);
+        return APR_NOTFOUND;
+    }
+    shm_hash_release(ht, s, link);
+
+    return shm_hash_unlock(ht, stripe);
+}
+
+APR_DECLARE(int) apr_shm_hash_do(apr_shm_hash_do_callback_fn_t *comp,
+                                 void *rec, apr_shm_hash_t *ht)
+{
+    apr_time_t now = apr_time_now();
+    unsigned int stripe, i;
+
+    for (stripe = 0; stripe < ht->nstripes; stripe++) {
+        if (shm_hash_lock(ht, stripe) != APR_SUCCESS) {
+            continue;
+        }
+        for (i = stripe; i < ht->nbuckets; i += ht->nstripes) {
+            apr_rmm_off_t off;
+
+            for (off = ht->buckets[i]; off; ) {
+                shm_hash_entry_t *e = SHM_HASH_ENTRY(ht, off);
+
+                if (!SHM_HASH_EXPIRED(e, now)
+                        && !comp(rec, SHM_HASH_KEY(e), e->klen,
+                                 SHM_HASH_VAL(e), e->vlen)) {
+                    shm_hash_unlock(ht, stripe);
+                    return 0;
+                }
+                off = e->next;
+            }
+        }
+        shm_hash_unlock(ht, stripe);
+    }
+    return 1;
+}
+
+APR_DECLARE(unsigned int) apr_shm_hash_count(apr_shm_hash_t *ht)
+{
+    unsigned int count = 0, i;
+
+    for (i = 0; i < ht->nstripes; i++) {
+        count += SHM_HASH_STRIPE(ht, i)->count;
+    }
+    return count;
+}
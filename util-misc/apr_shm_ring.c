@@ -0,0 +1,406 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_shm_ring.h"
+#include "apr_shm.h"
+#include "apr_atomic.h"
+#include "apr_general.h"
+#include "apr_thread_proc.h"
+
+#define APR_WANT_MEMFUNC
+#include "apr_want.h"
+
+#if APR_HAS_FUTEX_SERIALIZE
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+/* The segment starts with a header line, then the line written by the
+ * producers (the tail), the one written by the consumer (the head) and the
+ * one of the wake ups, followed by the data.  The head and tail are free
+ * running positions, taken modulo the capacity to address the data.
+ */
+#define SHM_RING_LINE 64
+#define SHM_RING_MAGIC 0x53485247 /* "SHRG" */
+#define SHM_RING_DATA_OFFSET (SHM_RING_LINE * 4)
+#define SHM_RING_MIN_CAPACITY 64
+#define SHM_RING_MAX_CAPACITY ((apr_size_t)1 << 30)
+
+/* How many times the consumer polls before sleeping, and how long it
+ * sleeps at most without futexes.
+ */
+#define SHM_RING_SPINS 100
+#define SHM_RING_POLL apr_time_from_msec(1)
+
+/* Each record starts with a word holding its length, flagged busy from
+ * its reservation to its commit.  A padding record fills the end of the
+ * data when the next record does not fit before wrapping around, its
+ * length being the whole room to skip.
+ */
+#define SHM_RING_BUSY 0x80000000U
+#define SHM_RING_PAD  0x40000000U
+#define SHM_RING_LEN  0x3fffffffU
+#define SHM_RING_HDR  8
+#define SHM_RING_RECORD(len) APR_ALIGN((len) + SHM_RING_HDR, 8)
+
+typedef struct shm_ring_header_t {
+    apr_uint32_t magic;
+    apr_uint32_t flags;
+    apr_uint32_t capacity;
+} shm_ring_header_t;
+
+typedef struct shm_ring_producer_t {
+    volatile apr_uint32_t tail;
+    volatile apr_uint32_t lock;
+} shm_ring_producer_t;
+
+typedef struct shm_ring_consumer_t {
+    volatile apr_uint32_t head;
+} shm_ring_consumer_t;
+
+typedef struct shm_ring_notify_t {
+    volatile apr_uint32_t sleeping;
+    volatile apr_uint32_t seq;
+} shm_ring_notify_t;
+
+struct apr_shm_ring_t {
+    apr_pool_t *pool;
+    apr_shm_t *shm;
+    shm_ring_header_t *hdr;
+    shm_ring_producer_t *prod;
+    shm_ring_consumer_t *cons;
+    shm_ring_notify_t *notify;
+    char *data;
+    apr_uint32_t capacity;
+    apr_uint32_t mask;
+    apr_uint32_t flags;
+};
+
+#define SHM_RING_WORD(ring, pos) \
+    ((volatile apr_uint32_t *)((ring)->data + ((pos) & (ring)->mask)))
+
+/* Reservations are serialized with APR_SHM_RING_MPSC only, the critical
+ * section being a few stores.
+ */
+static void shm_ring_lock(apr_shm_ring_t *ring)
+{
+    int spins = 0;
+
+    while (apr_atomic_cas32(&ring->prod->lock, 1, 0) != 0) {
+        if (++spins < SHM_RING_SPINS) {
+            continue;
+        }
+        spins = 0;
+#if APR_HAS_THREADS
+        apr_thread_yield();
+#else
+        apr_sleep(0);
+#endif
+    }
+}
+
+static void shm_ring_unlock(apr_shm_ring_t *ring)
+{
+    apr_atomic_set32(&ring->prod->lock, 0);
+}
+
+static apr_status_t shm_ring_open(apr_shm_ring_t **ring, apr_shm_t *shm,
+                                  apr_pool_t *pool)
+{
+    apr_shm_ring_t *new_ring;
+    char *base = apr_shm_baseaddr_get(shm);
+    apr_size_t size = apr_shm_size_get(shm);
+    shm_ring_header_t *hdr = (shm_ring_header_t *)base;
+
+    if (size < SHM_RING_DATA_OFFSET || hdr->magic != SHM_RING_MAGIC
+            || hdr->capacity < SHM_RING_MIN_CAPACITY
+            || (hdr->capacity & (hdr->capacity - 1))
+            || size < SHM_RING_DATA_OFFSET + (apr_size_t)hdr->capacity) {
+        return APR_EINVAL;
+    }
+
+    new_ring = apr_pcalloc(pool, sizeof(apr_shm_ring_t));
+    new_ring->pool = pool;
+    new_ring->shm = shm;
+    new_ring->hdr = hdr;
+    new_ring->prod = (shm_ring_producer_t *)(base + SHM_RING_LINE);
+    new_ring->cons = (shm_ring_consumer_t *)(base + SHM_RING_LINE * 2);
+    new_ring->notify = (shm_ring_notify_t *)(base + SHM_RING_LINE * 3);
+    new_ring->data = base + SHM_RING_DATA_OFFSET;
+    new_ring->capacity = hdr->capacity;
+    new_ring->mask = hdr->capacity - 1;
+    new_ring->flags = hdr->flags;
+
+    *ring = new_ring;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_create(apr_shm_ring_t **ring,
+                                              apr_size_t size,
+                                              const char *filename,
+                                              apr_uint32_t flags,
+                                              apr_pool_t *pool)
+{
+    shm_ring_header_t *hdr;
+    apr_size_t capacity = SHM_RING_MIN_CAPACITY;
+    apr_shm_t *shm;
+    apr_status_t rv;
+
+    if (!size || size > SHM_RING_MAX_CAPACITY) {
+        return APR_EINVAL;
+    }
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+
+    rv = apr_shm_create(&shm, SHM_RING_DATA_OFFSET + capacity, filename,
+                        pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    hdr = apr_shm_baseaddr_get(shm);
+    memset(hdr, 0, SHM_RING_DATA_OFFSET);
+    hdr->flags = flags & APR_SHM_RING_MPSC;
+    hdr->capacity = (apr_uint32_t)capacity;
+    hdr->magic = SHM_RING_MAGIC;
+
+    rv = shm_ring_open(ring, shm, pool);
+    if (rv != APR_SUCCESS) {
+        apr_shm_destroy(shm);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_attach(apr_shm_ring_t **ring,
+                                              const char *filename,
+                                              apr_pool_t *pool)
+{
+    apr_shm_t *shm;
+    apr_status_t rv;
+
+    rv = apr_shm_attach(&shm, filename, pool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    rv = shm_ring_open(ring, shm, pool);
+    if (rv != APR_SUCCESS) {
+        apr_shm_detach(shm);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_detach(apr_shm_ring_t *ring)
+{
+    return apr_shm_detach(ring->shm);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_destroy(apr_shm_ring_t *ring)
+{
+    return apr_shm_destroy(ring->shm);
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_reserve(apr_shm_ring_t *ring,
+                                               apr_size_t len, void **buf)
+{
+    apr_uint32_t tail, head, need, pad = 0, off;
+    int mpsc = ring->flags & APR_SHM_RING_MPSC;
+
+    if (len > ring->capacity / 2 - SHM_RING_HDR) {
+        return APR_EINVAL;
+    }
+    need = SHM_RING_RECORD((apr_uint32_t)len);
+
+    if (mpsc) {
+        shm_ring_lock(ring);
+    }
+
+    tail = ring->prod->tail;
+    head = apr_atomic_read32(&ring->cons->head);
+    off = tail & ring->mask;
+    if (off + need > ring->capacity) {
+        pad = ring->capacity - off;
+    }
+    if (tail + pad + need - head > ring->capacity) {
+        if (mpsc) {
+            shm_ring_unlock(ring);
+        }
+        return APR_EAGAIN;
+    }
+
+    /* Both headers are written before the tail is published, so the
+     * consumer never reads the ones of a previous turn.
+     */
+    if (pad) {
+        *SHM_RING_WORD(ring, tail) = SHM_RING_PAD | pad;
+        tail += pad;
+    }
+    *SHM_RING_WORD(ring, tail) = SHM_RING_BUSY | (apr_uint32_t)len;
+    *buf = (char *)SHM_RING_WORD(ring, tail) + SHM_RING_HDR;
+    apr_atomic_set32(&ring->prod->tail, tail + need);
+
+    if (mpsc) {
+        shm_ring_unlock(ring);
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(void) apr_shm_ring_commit(apr_shm_ring_t *ring, void *buf)
+{
+    volatile apr_uint32_t *word =
+        (volatile apr_uint32_t *)((char *)buf - SHM_RING_HDR);
+
+    apr_atomic_set32(word, *word & ~SHM_RING_BUSY);
+
+    /* Pairs with shm_ring_sleep(): either the consumer sees the record
+     * before sleeping, or we see it sleeping.
+     */
+    if (apr_atomic_read32(&ring->notify->sleeping)) {
+        apr_atomic_inc32(&ring->notify->seq);
+#if APR_HAS_FUTEX_SERIALIZE
+        /* Not FUTEX_PRIVATE_FLAG, the word is shared by processes */
+        syscall(SYS_futex, &ring->notify->seq, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+    }
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_write(apr_shm_ring_t *ring,
+                                             const void *data,
+                                             apr_size_t len)
+{
+    void *buf;
+    apr_status_t rv;
+
+    rv = apr_shm_ring_reserve(ring, len, &buf);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    memcpy(buf, data, len);
+    apr_shm_ring_commit(ring, buf);
+
+    return APR_SUCCESS;
+}
+
+/* Find the oldest committed record, skipping the padding */
+static apr_status_t shm_ring_next(apr_shm_ring_t *ring, void **buf,
+                                  apr_size_t *len)
+{
+    apr_uint32_t head = ring->cons->head, word;
+
+    while (head != apr_atomic_read32(&ring->prod->tail)) {
+        word = apr_atomic_read32(SHM_RING_WORD(ring, head));
+        if (word & SHM_RING_BUSY) {
+            break;
+        }
+        if (word & SHM_RING_PAD) {
+            head += word & SHM_RING_LEN;
+            apr_atomic_set32(&ring->cons->head, head);
+            continue;
+        }
+        *buf = (char *)SHM_RING_WORD(ring, head) + SHM_RING_HDR;
+        *len = word & SHM_RING_LEN;
+        return APR_SUCCESS;
+    }
+
+    return APR_EAGAIN;
+}
+
+static apr_status_t shm_ring_sleep(apr_shm_ring_t *ring, void **buf,
+                                   apr_size_t *len, apr_time_t deadline)
+{
+    apr_interval_time_t wait = -1;
+    apr_status_t rv;
+#if APR_HAS_FUTEX_SERIALIZE
+    struct timespec ts, *tsp = NULL;
+    apr_uint32_t seq;
+
+    apr_atomic_set32(&ring->notify->sleeping, 1);
+    seq = apr_atomic_read32(&ring->notify->seq);
+#endif
+
+    rv = shm_ring_next(ring, buf, len);
+    if (rv == APR_SUCCESS) {
+        goto done;
+    }
+    if (deadline) {
+        wait = deadline - apr_time_monotonic();
+        if (wait <= 0) {
+            rv = APR_TIMEUP;
+            goto done;
+        }
+    }
+
+#if APR_HAS_FUTEX_SERIALIZE
+    if (wait > 0) {
+        ts.tv_sec = apr_time_sec(wait);
+        ts.tv_nsec = apr_time_usec(wait) * 1000;
+        tsp = &ts;
+    }
+    syscall(SYS_futex, &ring->notify->seq, FUTEX_WAIT, seq, tsp, NULL, 0);
+#else
+    apr_sleep(wait > 0 && wait < SHM_RING_POLL ? wait : SHM_RING_POLL);
+#endif
+
+done:
+#if APR_HAS_FUTEX_SERIALIZE
+    apr_atomic_set32(&ring->notify->sleeping, 0);
+#endif
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_shm_ring_peek(apr_shm_ring_t *ring,
+                                            void **buf, apr_size_t *len,
+                                            apr_interval_time_t timeout)
+{
+    apr_time_t deadline = 0;
+    apr_status_t rv;
+    int spins = 0;
+
+    for (;;) {
+        rv = shm_ring_next(ring, buf, len);
+        if (rv == APR_SUCCESS || !timeout) {
+            return rv;
+        }
+        if (++spins < SHM_RING_SPINS) {
+            continue;
+        }
+        if (timeout > 0 && !deadline) {
+            deadline = apr_time_monotonic() + timeout;
+        }
+        rv = shm_ring_sleep(ring, buf, len, deadline);
+        if (rv != APR_EAGAIN) {
+            return rv;
+        }
+    }
+}
+
+APR_DECLARE(void) apr_shm_ring_release(apr_shm_ring_t *ring)
+{
+    apr_uint32_t head = ring->cons->head;
+    apr_uint32_t word = *SHM_RING_WORD(ring, head);
+
+    apr_atomic_set32(&ring->cons->head,
+                     head + SHM_RING_RECORD(word & SHM_RING_LEN));
+}
+
+APR_DECLARE(apr_size_t) apr_shm_ring_capacity(apr_shm_ring_t *ring)
+{
+    return ring->capacity;
+}
@@ -0,0 +1,478 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_private.h"
+#include "apr_stat_cache.h"
+#include "apr_nearcache.h"
+#include "apr_hash.h"
+#include "apr_strings.h"
+#include "apr_atomic.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
+
+#include <stdlib.h> /* for malloc() and free() */
+#include <string.h>
+
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT1)
+#define STAT_CACHE_INOTIFY
+#include <sys/inotify.h>
+#include <poll.h>
+#include <errno.h>
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define STAT_CACHE_EVENTS (IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE \
+                           | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF \
+                           | IN_MOVE_SELF)
+#endif
+
+/* What is cached for a path, the key being the path prefixed by 'L' when
+ * stat'ed for APR_FINFO_LINK and by 'F' otherwise.
+ */
+typedef struct stat_cache_rec_t {
+    apr_status_t rv;        /* APR_SUCCESS, APR_INCOMPLETE, or the error */
+    apr_finfo_t finfo;
+} stat_cache_rec_t;
+
+#ifdef STAT_CACHE_INOTIFY
+/* A watched directory */
+typedef struct stat_cache_watch_t {
+    int wd;
+    apr_size_t len;
+    char path[1];
+} stat_cache_watch_t;
+#endif
+
+struct apr_stat_cache_t {
+    apr_pool_t *pool;
+    apr_nearcache_t *nc;
+#ifdef STAT_CACHE_INOTIFY
+    int ifd;
+    /* Bumped by the events, such that a lookup knows whether its stat()
+     * may have raced with a change it would then cache */
+    volatile apr_uint32_t gen;
+    /* Protected by lock */
+    apr_hash_t *by_path;
+    apr_hash_t *by_wd;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *lock;
+    apr_thread_t *thread;
+    int wakeup[2];
+#endif
+#endif
+};
+
+#if defined(STAT_CACHE_INOTIFY) && APR_HAS_THREADS
+#define watch_lock(sc)   apr_thread_mutex_lock((sc)->lock)
+#define watch_unlock(sc) apr_thread_mutex_unlock((sc)->lock)
+#else
+#define watch_lock(sc)
+#define watch_unlock(sc)
+#endif
+
+/* Keys short enough are built on the stack */
+#define STAT_CACHE_KEYLEN 256
+
+static void stat_cache_drop(apr_stat_cache_t *sc, const char *path,
+                            apr_size_t len)
+{
+    char buf[STAT_CACHE_KEYLEN], *key = buf;
+
+    if (len + 1 > sizeof(buf)) {
+        key = malloc(len + 1);
+        if (!key) {
+            apr_nearcache_clear(sc->nc);
+            return;
+        }
+    }
+    memcpy(key + 1, path, len);
+    key[0] = 'F';
+    apr_nearcache_delete(sc->nc, key, len + 1);
+    key[0] = 'L';
+    apr_nearcache_delete(sc->nc, key, len + 1);
+    if (key != buf) {
+        free(key);
+    }
+}
+
+#ifdef STAT_CACHE_INOTIFY
+/* Watch a directory, unless it is already.  Returns whether it is. */
+static int stat_cache_watch(apr_stat_cache_t *sc, const char *dir,
+                            apr_size_t len, int *added)
+{
+    stat_cache_watch_t *w;
+    char *path;
+    int wd;
+
+    *added = 0;
+    watch_lock(sc);
+    w = apr_hash_get(sc->by_path, dir, len);
+    if (w) {
+        watch_unlock(sc);
+        return 1;
+    }
+
+    w = malloc(sizeof(*w) + len);
+    if (!w) {
+        watch_unlock(sc);
+        return 0;
+    }
+    memcpy(w->path, dir, len);
+    w->path[len] = '\0';
+    w->len = len;
+
+    /* Watching the directory of the path, which it may lack */
+    path = len ? w->path : ".";
+    wd = inotify_add_watch(sc->ifd, path, STAT_CACHE_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        watch_unlock(sc);
+        free(w);
+        return 0;
+    }
+    if (apr_hash_get(sc->by_wd, &wd, sizeof(wd))) {
+        /* the same directory by another name, keep the first */
+        watch_unlock(sc);
+        free(w);
+        return 0;
+    }
+    w->wd = wd;
+    apr_hash_set(sc->by_path, w->path, len, w);
+    apr_hash_set(sc->by_wd, &w->wd, sizeof(w->wd), w);
+    *added = 1;
+    watch_unlock(sc);
+
+    return 1;
+}
+
+/* Read and apply the pending events */
+static void stat_cache_drain(apr_stat_cache_t *sc)
+{
+    union {
+        struct inotify_event ev;    /* for the alignment */
+        char buf[4096];
+    } u;
+    const char *buf = u.buf;
+    char pbuf[STAT_CACHE_KEYLEN];
+    ssize_t n;
+
+    for (;;) {
+        const char *p;
+
+        n = read(sc->ifd, u.buf, sizeof(u.buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        apr_atomic_inc32(&sc->gen);
+
+        for (p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const void *)p;
+            stat_cache_watch_t *w;
+
+            p += sizeof(*ev) + ev->len;
+
+            if (ev->mask & (IN_Q_OVERFLOW | IN_MOVE_SELF)) {
+                /* lost events, or what was under the directory moved */
+                apr_nearcache_clear(sc->nc);
+            }
+            if (ev->mask & IN_Q_OVERFLOW) {
+                continue;
+            }
+
+            watch_lock(sc);
+            w = apr_hash_get(sc->by_wd, &ev->wd, sizeof(ev->wd));
+            if (!w) {
+                watch_unlock(sc);
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                apr_hash_set(sc->by_wd, &w->wd, sizeof(w->wd), NULL);
+                apr_hash_set(sc->by_path, w->path, w->len, NULL);
+                watch_unlock(sc);
+                stat_cache_drop(sc, w->path, w->len);
+                free(w);
+                continue;
+            }
+            if (ev->len) {
+                apr_size_t nlen = strlen(ev->name);
+                int sep = (w->len && w->path[w->len - 1] != '/');
+                apr_size_t len = (w->len ? w->len + sep : 0) + nlen;
+                char *path = pbuf;
+
+                if (len + 1 > sizeof(pbuf)) {
+                    path = malloc(len + 1);
+                }
+                if (path) {
+                    if (w->len) {
+                        memcpy(path, w->path, w->len);
+                        if (sep) {
+                            path[w->len] = '/';
+                        }
+                    }
+                    memcpy(path + len - nlen, ev->name, nlen);
+                    stat_cache_drop(sc, path, len);
+                    if (path != pbuf) {
+                        free(path);
+                    }
+                }
+                else {
+                    apr_nearcache_clear(sc->nc);
+                }
+            }
+            if (!ev->len || (ev->mask & (IN_CREATE | IN_DELETE
+                                         | IN_MOVED_FROM | IN_MOVED_TO))) {
+                /* the directory itself changed */
+                stat_cache_drop(sc, w->path, w->len);
+            }
+            watch_unlock(sc);
+        }
+    }
+}
+
+#if APR_HAS_THREADS
+static void * APR_THREAD_FUNC stat_cache_thread(apr_thread_t *thd, void *data)
+{
+    apr_stat_cache_t *sc = data;
+    struct pollfd pfd[2];
+
+    pfd[0].fd = sc->ifd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = sc->wakeup[0];
+    pfd[1].events = POLLIN;
+    for (;;) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfd[1].revents) {
+            break;
+        }
+        if (pfd[0].revents) {
+            stat_cache_drain(sc);
+        }
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+    return NULL;
+}
+#endif
+
+static apr_status_t stat_cache_cleanup(void *data)
+{
+    apr_stat_cache_t *sc = data;
+    apr_hash_index_t *hi;
+
+#if APR_HAS_THREADS
+    if (sc->thread) {
+        apr_status_t rv;
+
+        (void)write(sc->wakeup[1], "", 1);
+        apr_thread_join(&rv, sc->thread);
+        sc->thread = NULL;
+    }
+    if (sc->wakeup[0] >= 0) {
+        close(sc->wakeup[0]);
+        close(sc->wakeup[1]);
+        sc->wakeup[0] = sc->wakeup[1] = -1;
+    }
+#endif
+    if (sc->ifd >= 0) {
+        close(sc->ifd);
+        sc->ifd = -1;
+    }
+    /* The tables go with the pool, their keys with the watches */
+    for (hi = apr_hash_first(NULL, sc->by_wd); hi; hi = apr_hash_next(hi)) {
+        free(apr_hash_this_val(hi));
+    }
+
+    return APR_SUCCESS;
+}
+#endif /* STAT_CACHE_INOTIFY */
+
+APR_DECLARE(apr_status_t) apr_stat_cache_create(apr_stat_cache_t **statcache,
+                                                apr_size_t max_bytes,
+                                                apr_interval_time_t ttl,
+                                                apr_int32_t flags,
+                                                apr_pool_t *p)
+{
+    apr_stat_cache_t *sc;
+    apr_status_t rv;
+
+    if (ttl < 0 || (!ttl && !(flags & APR_STAT_CACHE_NOTIFY))) {
+        return APR_EINVAL;
+    }
+#ifndef STAT_CACHE_INOTIFY
+    if (flags & APR_STAT_CACHE_NOTIFY) {
+        return APR_ENOTIMPL;
+    }
+#endif
+
+    sc = apr_pcalloc(p, sizeof(*sc));
+    sc->pool = p;
+    rv = apr_nearcache_create(&sc->nc, max_bytes, ttl, 0, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+#ifdef STAT_CACHE_INOTIFY
+    sc->ifd = -1;
+#if APR_HAS_THREADS
+    sc->wakeup[0] = sc->wakeup[1] = -1;
+#endif
+    if (flags & APR_STAT_CACHE_NOTIFY) {
+        sc->by_path = apr_hash_make(p);
+        sc->by_wd = apr_hash_make(p);
+        /* Before the thread's pool goes */
+        apr_pool_pre_cleanup_register(p, sc, stat_cache_cleanup);
+
+        sc->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (sc->ifd < 0) {
+            return errno;
+        }
+#if APR_HAS_THREADS
+        rv = apr_thread_mutex_create(&sc->lock, APR_THREAD_MUTEX_DEFAULT, p);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        if (pipe(sc->wakeup) < 0) {
+            sc->wakeup[0] = sc->wakeup[1] = -1;
+            return errno;
+        }
+        rv = apr_thread_create(&sc->thread, NULL, stat_cache_thread, sc, p);
+        if (rv != APR_SUCCESS) {
+            sc->thread = NULL;
+            return rv;
+        }
+#endif
+    }
+#endif
+
+    *statcache = sc;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_stat_cache_stat(apr_stat_cache_t *sc,
+                                              apr_finfo_t *finfo,
+                                              const char *fname,
+                                              apr_int32_t wanted,
+                                              apr_pool_t *pool)
+{
+    char buf[STAT_CACHE_KEYLEN], *key = buf;
+    apr_size_t flen = strlen(fname);
+    stat_cache_rec_t rec;
+    char *data;
+    apr_size_t len;
+    apr_status_t rv;
+    int cache = 1;
+#ifdef STAT_CACHE_INOTIFY
+    apr_uint32_t gen = 0;
+    int added;
+#endif
+
+    if (flen + 1 > sizeof(buf)) {
+        key = apr_palloc(pool, flen + 1);
+    }
+    key[0] = (wanted & APR_FINFO_LINK) ? 'L' : 'F';
+    memcpy(key + 1, fname, flen);
+    wanted &= ~APR_FINFO_LINK;
+
+#if defined(STAT_CACHE_INOTIFY) && !APR_HAS_THREADS
+    if (sc->ifd >= 0) {
+        stat_cache_drain(sc);
+    }
+#endif
+
+    if (apr_nearcache_get(sc->nc, key, flen + 1, pool, &data, &len,
+                          NULL) == APR_SUCCESS && len == sizeof(rec)) {
+        memcpy(&rec, data, sizeof(rec));
+        if (rec.rv != APR_SUCCESS && rec.rv != APR_INCOMPLETE) {
+            return rec.rv;
+        }
+        if (!(wanted & ~rec.finfo.valid)
+            || (rec.rv == APR_INCOMPLETE && !(wanted & ~APR_FINFO_NORM))) {
+            *finfo = rec.finfo;
+            finfo->pool = pool;
+            finfo->fname = fname;
+            return (wanted & ~finfo->valid) ? APR_INCOMPLETE : APR_SUCCESS;
+        }
+    }
+
+#ifdef STAT_CACHE_INOTIFY
+    if (sc->ifd >= 0) {
+        const char *slash = strrchr(fname, '/');
+
+        /* The directory is watched first, for the events to come after */
+        gen = apr_atomic_read32(&sc->gen);
+        cache = stat_cache_watch(sc, fname,
+                                 slash ? (slash > fname ? slash - fname : 1)
+                                       : 0, &added);
+    }
+#endif
+
+    rv = apr_stat(finfo, fname, (key[0] == 'L' ? APR_FINFO_LINK : 0)
+                                | APR_FINFO_NORM | wanted, pool);
+
+#ifdef STAT_CACHE_INOTIFY
+    if (sc->ifd >= 0 && cache) {
+        if (rv == APR_SUCCESS || rv == APR_INCOMPLETE) {
+            if (finfo->filetype == APR_DIR) {
+                /* its own changes show in its watch, not in its parent's */
+                cache = stat_cache_watch(sc, fname, flen, &added) && !added;
+            }
+        }
+        if (apr_atomic_read32(&sc->gen) != gen) {
+            cache = 0;
+        }
+    }
+#endif
+
+    if (cache && (rv == APR_SUCCESS || rv == APR_INCOMPLETE
+                  || APR_STATUS_IS_ENOENT(rv) || APR_STATUS_IS_ENOTDIR(rv))) {
+        memset(&rec, 0, sizeof(rec));
+        rec.rv = rv;
+        if (rv == APR_SUCCESS || rv == APR_INCOMPLETE) {
+            rec.finfo = *finfo;
+            rec.finfo.pool = NULL;
+            rec.finfo.fname = NULL;
+            rec.finfo.name = NULL;
+            rec.finfo.filehand = NULL;
+            rec.finfo.valid &= ~APR_FINFO_NAME;
+        }
+        apr_nearcache_set(sc->nc, key, flen + 1, (const char *)&rec,
+                          sizeof(rec), 0, 0);
+    }
+
+    if (rv == APR_SUCCESS || rv == APR_INCOMPLETE) {
+        return (wanted & ~finfo->valid) ? APR_INCOMPLETE : APR_SUCCESS;
+    }
+    return rv;
+}
+
+APR_DECLARE(void) apr_stat_cache_invalidate(apr_stat_cache_t *sc,
+                                            const char *fname)
+{
+    stat_cache_drop(sc, fname, strlen(fname));
+}
+
+APR_DECLARE(void) apr_stat_cache_clear(apr_stat_cache_t *sc)
+{
+    apr_nearcache_clear(sc->nc);
+}
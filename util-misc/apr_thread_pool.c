@@ -19,14 +19,33 @@
 #include <assert.h>
 #include "apr_thread_pool.h"
 #include "apr_ring.h"
+#include "apr_skiplist.h"
 #include "apr_thread_cond.h"
 #include "apr_portable.h"
+#include "apr_atomic.h"
+#include "apr_strings.h"
+#include "apr_probes.h"
 
 #if APR_HAS_THREADS
 
-#define TASK_PRIORITY_SEGS 4
+#define TASK_PRIORITY_SEGS APR_THREAD_POOL_PRIORITY_BANDS
 #define TASK_PRIORITY_SEG(x) (((x)->dispatch.priority & 0xFF) / 64)
 
+/* Work stealing needs to know the current worker when pushing a task */
+#if APR_HAS_THREAD_LOCAL
+#define APR_THREAD_POOL_HAS_WS 1
+#else
+#define APR_THREAD_POOL_HAS_WS 0
+#endif
+
+/* How often a worker looks at the pool's queue while it has local tasks */
+#define WS_GLOBAL_INTERVAL 32
+/* How many tasks a worker recycles locally */
+#define WS_RECYCLED_MAX 64
+
+/* Number of exited threads whose pools are kept for the next ones */
+#define THREAD_CACHE_MAX 16
+
 typedef struct apr_thread_pool_task
 {
     APR_RING_ENTRY(apr_thread_pool_task) link;
@@ -38,6 +57,9 @@ typedef struct apr_thread_pool_task
         apr_byte_t priority;
         apr_time_t time;
     } dispatch;
+    apr_uint64_t seq; /* scheduled tasks' order for the same time */
+    apr_time_t queued; /* APR_THREAD_POOL_STATS */
+    int band;          /* priority segment, or TASK_PRIORITY_SEGS if scheduled */
 } apr_thread_pool_task_t;
 
 APR_RING_HEAD(apr_thread_pool_tasks, apr_thread_pool_task);
@@ -49,6 +71,21 @@ struct apr_thread_list_elt
     void *current_owner;
     enum { TH_RUN, TH_STOP, TH_PROBATION } state;
     int signal_work_done;
+    apr_thread_pool_t *me;
+    apr_size_t index;
+#if APR_THREAD_POOL_HAS_WS
+    /* Work stealing: the tasks below (and current_owner, signal_work_done)
+     * are protected by ws_lock, which nests inside the pool's lock.
+     */
+    apr_thread_mutex_t *ws_lock;
+    struct apr_thread_pool_tasks ws_tasks[TASK_PRIORITY_SEGS];
+    apr_size_t ws_cnt;
+    struct apr_thread_pool_tasks ws_recycled;
+    apr_size_t ws_recycled_cnt;
+    apr_size_t ws_run;
+    apr_uint32_t ws_ticks;
+    apr_uint32_t ws_seed;
+#endif
 };
 
 APR_RING_HEAD(apr_thread_list, apr_thread_list_elt);
@@ -70,7 +107,8 @@ struct apr_thread_pool
     volatile apr_size_t thd_high;
     volatile apr_size_t thd_timed_out;
     struct apr_thread_pool_tasks *tasks;
-    struct apr_thread_pool_tasks *scheduled_tasks;
+    apr_skiplist *scheduled_tasks;
+    apr_uint64_t scheduled_seq;
     struct apr_thread_list *busy_thds;
     struct apr_thread_list *idle_thds;
     struct apr_thread_list *dead_thds;
@@ -82,8 +120,126 @@ struct apr_thread_pool
     struct apr_thread_pool_tasks *recycled_tasks;
     struct apr_thread_list *recycled_thds;
     apr_thread_pool_task_t *task_idx[TASK_PRIORITY_SEGS];
+    int ws;
+    volatile apr_uint32_t ws_task_cnt;
+    apr_size_t thd_seq;
+    apr_threadattr_t *thdattr;
+    apr_thread_pool_worker_init_t init_func;
+    void *init_data;
+    const char *name;
+    int affinity;
+    int *cpus;
+    int ncpus;
+    struct thread_pool_hists *hists;
+};
+
+/* APR_THREAD_POOL_STATS, the last wait/run is for scheduled tasks */
+struct thread_pool_hists
+{
+    apr_thread_pool_histogram_t wait[TASK_PRIORITY_SEGS + 1];
+    apr_thread_pool_histogram_t run[TASK_PRIORITY_SEGS + 1];
+    apr_thread_pool_histogram_t depth;
+};
+
+#define HIST_SUB_BITS 2
+#define HIST_SUB (1 << HIST_SUB_BITS)
+
+static int hist_index(apr_uint64_t v)
+{
+    int msb = 0, idx;
+
+    if (v < HIST_SUB) {
+        return (int)v;
+    }
+    while (v >> (msb + 1)) {
+        msb++;
+    }
+    idx = (msb - HIST_SUB_BITS + 1) * HIST_SUB
+          + (int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+    if (idx >= APR_THREAD_POOL_HISTOGRAM_BUCKETS) {
+        idx = APR_THREAD_POOL_HISTOGRAM_BUCKETS - 1;
+    }
+    return idx;
+}
+
+/* Highest value of the bucket */
+static apr_uint64_t hist_value(int idx)
+{
+    int msb;
+
+    if (idx < HIST_SUB) {
+        return idx;
+    }
+    msb = idx / HIST_SUB + HIST_SUB_BITS - 1;
+    return ((apr_uint64_t)1 << msb)
+           + ((apr_uint64_t)(idx % HIST_SUB + 1) << (msb - HIST_SUB_BITS))
+           - 1;
+}
+
+static void hist_add(apr_thread_pool_histogram_t *hist, apr_int64_t value)
+{
+    apr_uint64_t v = value > 0 ? value : 0, max;
+
+    apr_atomic_inc64(&hist->buckets[hist_index(v)]);
+    apr_atomic_add64(&hist->sum, v);
+    apr_atomic_inc64(&hist->count);
+    max = apr_atomic_read64(&hist->max);
+    while (v > max) {
+        apr_uint64_t cur = apr_atomic_cas64(&hist->max, v, max);
+        if (cur == max) {
+            break;
+        }
+        max = cur;
+    }
+}
+
+static void hist_get(apr_thread_pool_histogram_t *to,
+                     apr_thread_pool_histogram_t *from)
+{
+    int i;
+
+    to->count = apr_atomic_read64(&from->count);
+    to->sum = apr_atomic_read64(&from->sum);
+    to->max = apr_atomic_read64(&from->max);
+    for (i = 0; i < APR_THREAD_POOL_HISTOGRAM_BUCKETS; i++) {
+        to->buckets[i] = apr_atomic_read64(&from->buckets[i]);
+    }
+}
+
+struct apr_thread_pool_attr_t
+{
+    apr_pool_t *pool;
+    apr_uint32_t flags;
+    apr_threadattr_t *thdattr;
+    apr_thread_pool_worker_init_t init_func;
+    void *init_data;
+    const char *name;
+    int affinity;
+    const int *cpus;
+    int ncpus;
 };
 
+#if APR_THREAD_POOL_HAS_WS
+/* The worker running on this thread, if any */
+static APR_THREAD_LOCAL struct apr_thread_list_elt *ws_current;
+#endif
+
+/*
+ * Order of the scheduled tasks: by time, then by scheduling order.
+ */
+static int scheduled_task_cmp(void *a, void *b)
+{
+    apr_thread_pool_task_t *t1 = a, *t2 = b;
+
+    if (t1->dispatch.time != t2->dispatch.time) {
+        return t1->dispatch.time < t2->dispatch.time ? -1 : 1;
+    }
+    if (t1->seq != t2->seq) {
+        return t1->seq < t2->seq ? -1 : 1;
+    }
+    return 0;
+}
+
 static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
                                           apr_size_t init_threads,
                                           apr_size_t max_threads,
@@ -135,11 +291,11 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
         goto CATCH_ENOMEM;
     }
     APR_RING_INIT(me->tasks, apr_thread_pool_task, link);
-    me->scheduled_tasks = apr_palloc(me->pool, sizeof(*me->scheduled_tasks));
-    if (!me->scheduled_tasks) {
+    if (apr_skiplist_init(&me->scheduled_tasks, me->pool) != APR_SUCCESS) {
         goto CATCH_ENOMEM;
     }
-    APR_RING_INIT(me->scheduled_tasks, apr_thread_pool_task, link);
+    apr_skiplist_set_compare(me->scheduled_tasks, scheduled_task_cmp,
+                             scheduled_task_cmp);
     me->recycled_tasks = apr_palloc(me->pool, sizeof(*me->recycled_tasks));
     if (!me->recycled_tasks) {
         goto CATCH_ENOMEM;
@@ -176,25 +332,55 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
     return rv;
 }
 
+/*
+ * Remove the task from the pool's queue.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void unlink_task(apr_thread_pool_t *me, apr_thread_pool_task_t *task)
+{
+    int seg = TASK_PRIORITY_SEG(task);
+
+    --me->task_cnt;
+    if (task == me->task_idx[seg]) {
+        me->task_idx[seg] = APR_RING_NEXT(task, link);
+        if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
+                                                   apr_thread_pool_task, link)
+            || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
+            me->task_idx[seg] = NULL;
+        }
+    }
+    APR_RING_REMOVE(task, link);
+}
+
 /*
  * NOTE: This function is not thread safe by itself. Caller should hold the lock
  */
 static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
 {
     apr_thread_pool_task_t *task = NULL;
-    int seg;
 
     /* check for scheduled tasks */
     if (me->scheduled_task_cnt > 0) {
-        task = APR_RING_FIRST(me->scheduled_tasks);
+        apr_time_t now = apr_time_monotonic();
+
+        task = apr_skiplist_peek(me->scheduled_tasks);
         assert(task != NULL);
-        assert(task !=
-               APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                 link));
         /* if it's time */
-        if (task->dispatch.time <= apr_time_now()) {
+        if (task->dispatch.time <= now) {
             --me->scheduled_task_cnt;
-            APR_RING_REMOVE(task, link);
+            apr_skiplist_pop(me->scheduled_tasks, NULL);
+            APR_RING_ELEM_INIT(task, link);
+
+            /* let an idle thread take the next one if it's expired too */
+            if (me->scheduled_task_cnt && me->idle_cnt) {
+                apr_thread_pool_task_t *next;
+
+                next = apr_skiplist_peek(me->scheduled_tasks);
+                if (next->dispatch.time <= now) {
+                    apr_thread_cond_signal(me->more_work);
+                }
+            }
             return task;
         }
     }
@@ -206,17 +392,7 @@ static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
     task = APR_RING_FIRST(me->tasks);
     assert(task != NULL);
     assert(task != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link));
-    --me->task_cnt;
-    seg = TASK_PRIORITY_SEG(task);
-    if (task == me->task_idx[seg]) {
-        me->task_idx[seg] = APR_RING_NEXT(task, link);
-        if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
-                                                   apr_thread_pool_task, link)
-            || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
-            me->task_idx[seg] = NULL;
-        }
-    }
-    APR_RING_REMOVE(task, link);
+    unlink_task(me, task);
     return task;
 }
 
@@ -224,12 +400,9 @@ static apr_interval_time_t waiting_time(apr_thread_pool_t * me)
 {
     apr_thread_pool_task_t *task = NULL;
 
-    task = APR_RING_FIRST(me->scheduled_tasks);
+    task = apr_skiplist_peek(me->scheduled_tasks);
     assert(task != NULL);
-    assert(task !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link));
-    return task->dispatch.time - apr_time_now();
+    return task->dispatch.time - apr_time_monotonic();
 }
 
 /*
@@ -245,6 +418,28 @@ static struct apr_thread_list_elt *elt_new(apr_thread_pool_t * me,
         if (NULL == elt) {
             return NULL;
         }
+#if APR_THREAD_POOL_HAS_WS
+        elt->ws_lock = NULL;
+        if (me->ws) {
+            int seg;
+
+            if (apr_thread_mutex_create(&elt->ws_lock,
+                                        APR_THREAD_MUTEX_DEFAULT,
+                                        me->pool) != APR_SUCCESS) {
+                return NULL;
+            }
+            for (seg = 0; seg < TASK_PRIORITY_SEGS; seg++) {
+                APR_RING_INIT(&elt->ws_tasks[seg], apr_thread_pool_task,
+                              link);
+            }
+            APR_RING_INIT(&elt->ws_recycled, apr_thread_pool_task, link);
+            elt->ws_cnt = 0;
+            elt->ws_recycled_cnt = 0;
+            elt->ws_run = 0;
+        }
+        elt->ws_seed = (apr_uint32_t)(apr_uintptr_t)elt | 1;
+#endif
+        elt->me = me;
     }
     else {
         elt = APR_RING_FIRST(me->recycled_thds);
@@ -259,6 +454,398 @@ static struct apr_thread_list_elt *elt_new(apr_thread_pool_t * me,
     return elt;
 }
 
+/*
+ * Run the task (or drop it if terminated already), recording its wait and
+ * run times with APR_THREAD_POOL_STATS.
+ */
+static void run_task(apr_thread_pool_t *me, apr_thread_pool_task_t *task,
+                     apr_thread_t *t)
+{
+    apr_time_t start = 0;
+
+    if (me->terminated) {
+        return;
+    }
+
+    if (me->hists) {
+        start = apr_time_monotonic();
+        hist_add(&me->hists->wait[task->band], start
+                 - (task->band == TASK_PRIORITY_SEGS ? task->dispatch.time
+                                                     : task->queued));
+    }
+
+    apr_thread_data_set(task, "apr_thread_pool_task", NULL, t);
+    APR_PROBE3(thread_pool__start, me, task->func, task->param);
+    task->func(t, task->param);
+    APR_PROBE3(thread_pool__end, me, task->func, task->param);
+
+    if (me->hists) {
+        hist_add(&me->hists->run[task->band], apr_time_monotonic() - start);
+    }
+}
+
+#if APR_THREAD_POOL_HAS_WS
+
+static apr_status_t thread_pool_spawn(apr_thread_pool_t *me);
+
+static apr_thread_pool_task_t *task_new(apr_thread_pool_t * me,
+                                        apr_thread_start_t func,
+                                        void *param, apr_byte_t priority,
+                                        void *owner, apr_time_t time);
+static void insert_task(apr_thread_pool_t *me, apr_thread_pool_task_t *t,
+                        int push);
+
+/*
+ * Insert the task in the worker's queue, at the bottom (push) or the top
+ * of the tasks of same priority.
+ *
+ * NOTE: Caller should hold elt->ws_lock
+ */
+static void ws_insert(struct apr_thread_list_elt *elt,
+                      apr_thread_pool_task_t *t, int push)
+{
+    struct apr_thread_pool_tasks *tasks = &elt->ws_tasks[TASK_PRIORITY_SEG(t)];
+    apr_thread_pool_task_t *t_loc;
+
+    if (push) {
+        t_loc = APR_RING_LAST(tasks);
+        while (t_loc != APR_RING_SENTINEL(tasks, apr_thread_pool_task, link)
+               && t_loc->dispatch.priority < t->dispatch.priority) {
+            t_loc = APR_RING_PREV(t_loc, link);
+        }
+        if (t_loc == APR_RING_SENTINEL(tasks, apr_thread_pool_task, link)) {
+            APR_RING_INSERT_HEAD(tasks, t, apr_thread_pool_task, link);
+        }
+        else {
+            APR_RING_INSERT_AFTER(t_loc, t, link);
+        }
+    }
+    else {
+        t_loc = APR_RING_FIRST(tasks);
+        while (t_loc != APR_RING_SENTINEL(tasks, apr_thread_pool_task, link)
+               && t_loc->dispatch.priority > t->dispatch.priority) {
+            t_loc = APR_RING_NEXT(t_loc, link);
+        }
+        APR_RING_INSERT_BEFORE(t_loc, t, link);
+    }
+    elt->ws_cnt++;
+}
+
+/*
+ * Take the first task of highest priority from the worker's queue, for
+ * the worker itself or a thief.
+ *
+ * NOTE: Caller should hold elt->ws_lock
+ */
+static apr_thread_pool_task_t *ws_remove_first(apr_thread_pool_t *me,
+                                               struct apr_thread_list_elt *elt)
+{
+    apr_thread_pool_task_t *task;
+    int seg;
+
+    if (!elt->ws_cnt) {
+        return NULL;
+    }
+    for (seg = TASK_PRIORITY_SEGS - 1; seg >= 0; seg--) {
+        if (!APR_RING_EMPTY(&elt->ws_tasks[seg], apr_thread_pool_task, link)) {
+            break;
+        }
+    }
+    assert(seg >= 0);
+    task = APR_RING_FIRST(&elt->ws_tasks[seg]);
+    APR_RING_REMOVE(task, link);
+    elt->ws_cnt--;
+    apr_atomic_dec32(&me->ws_task_cnt);
+    return task;
+}
+
+/*
+ * Pop a task from the worker's own queue.
+ */
+static apr_thread_pool_task_t *ws_pop_local(apr_thread_pool_t *me,
+                                            struct apr_thread_list_elt *elt)
+{
+    apr_thread_pool_task_t *task;
+
+    apr_thread_mutex_lock(elt->ws_lock);
+    task = ws_remove_first(me, elt);
+    if (task) {
+        elt->current_owner = task->owner;
+    }
+    apr_thread_mutex_unlock(elt->ws_lock);
+
+    return task;
+}
+
+/*
+ * Steal a task from a random busy worker, trying the others in turn.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_thread_pool_task_t *ws_steal(apr_thread_pool_t *me,
+                                        struct apr_thread_list_elt *elt)
+{
+    struct apr_thread_list_elt *victim;
+    apr_thread_pool_task_t *task = NULL;
+    apr_size_t n, i;
+
+    if (!apr_atomic_read32(&me->ws_task_cnt) || me->busy_cnt < 2) {
+        return NULL;
+    }
+
+    /* xorshift32 */
+    elt->ws_seed ^= elt->ws_seed << 13;
+    elt->ws_seed ^= elt->ws_seed >> 17;
+    elt->ws_seed ^= elt->ws_seed << 5;
+
+    victim = APR_RING_FIRST(me->busy_thds);
+    for (n = elt->ws_seed % me->busy_cnt; n; --n) {
+        victim = APR_RING_NEXT(victim, link);
+    }
+    for (i = 0; i < me->busy_cnt && !task; ++i) {
+        if (victim != elt) {
+            apr_thread_mutex_lock(victim->ws_lock);
+            task = ws_remove_first(me, victim);
+            apr_thread_mutex_unlock(victim->ws_lock);
+        }
+        victim = APR_RING_NEXT(victim, link);
+        if (victim == APR_RING_SENTINEL(me->busy_thds,
+                                        apr_thread_list_elt, link)) {
+            victim = APR_RING_FIRST(me->busy_thds);
+        }
+    }
+
+    return task;
+}
+
+/*
+ * Push a task from a worker to its own queue, the pool's lock is only
+ * taken to allocate a new task, wake up an idle thread or create one.
+ */
+static apr_status_t ws_push_local(apr_thread_pool_t *me,
+                                  struct apr_thread_list_elt *elt,
+                                  apr_thread_start_t func, void *param,
+                                  apr_byte_t priority, int push, void *owner)
+{
+    apr_thread_pool_task_t *t = NULL;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (me->terminated) {
+        /* Let the caller know that we are done */
+        return APR_NOTFOUND;
+    }
+
+    apr_thread_mutex_lock(elt->ws_lock);
+    if (elt->ws_recycled_cnt) {
+        t = APR_RING_FIRST(&elt->ws_recycled);
+        APR_RING_REMOVE(t, link);
+        elt->ws_recycled_cnt--;
+    }
+    apr_thread_mutex_unlock(elt->ws_lock);
+
+    if (t) {
+        APR_RING_ELEM_INIT(t, link);
+        t->func = func;
+        t->param = param;
+        t->owner = owner;
+        t->dispatch.priority = priority;
+        t->band = TASK_PRIORITY_SEG(t);
+        if (me->hists) {
+            t->queued = apr_time_monotonic();
+        }
+    }
+    else {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        t = task_new(me, func, param, priority, owner, 0);
+        apr_thread_mutex_unlock(me->lock);
+        if (NULL == t) {
+            return APR_ENOMEM;
+        }
+    }
+
+    apr_thread_mutex_lock(elt->ws_lock);
+    if (me->hists) {
+        hist_add(&me->hists->depth, elt->ws_cnt);
+    }
+    ws_insert(elt, t, push);
+    apr_thread_mutex_unlock(elt->ws_lock);
+    apr_atomic_inc32(&me->ws_task_cnt);
+
+    /* Let idle threads steal, or create a new one if needed */
+    if (me->idle_cnt || (me->thd_cnt < me->thd_max
+                         && elt->ws_cnt > me->threshold)) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        if (0 == me->idle_cnt && me->thd_cnt < me->thd_max
+                && elt->ws_cnt > me->threshold) {
+            rv = thread_pool_spawn(me);
+        }
+        apr_thread_cond_signal(me->more_work);
+        apr_thread_mutex_unlock(me->lock);
+    }
+
+    return rv;
+}
+
+/*
+ * Recycle the task run by the worker and signal apr_thread_pool_tasks_cancel()
+ * if needed, the pool's lock is taken only in the latter case or if the local
+ * recycled tasks are full.
+ */
+static void ws_task_done(apr_thread_pool_t *me,
+                         struct apr_thread_list_elt *elt,
+                         apr_thread_pool_task_t *task)
+{
+    int signal_work_done;
+
+    apr_thread_mutex_lock(elt->ws_lock);
+    elt->current_owner = NULL;
+    signal_work_done = elt->signal_work_done;
+    elt->signal_work_done = 0;
+    if (elt->ws_recycled_cnt < WS_RECYCLED_MAX) {
+        APR_RING_INSERT_TAIL(&elt->ws_recycled, task,
+                             apr_thread_pool_task, link);
+        elt->ws_recycled_cnt++;
+        task = NULL;
+    }
+    apr_thread_mutex_unlock(elt->ws_lock);
+
+    if (task || signal_work_done) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+        if (task) {
+            APR_RING_INSERT_TAIL(me->recycled_tasks, task,
+                                 apr_thread_pool_task, link);
+        }
+        if (signal_work_done) {
+            apr_thread_cond_signal(me->work_done);
+        }
+        apr_thread_mutex_unlock(me->lock);
+    }
+}
+
+/*
+ * Give the tasks of a dying worker back to the pool.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void ws_drain(apr_thread_pool_t *me, struct apr_thread_list_elt *elt)
+{
+    apr_thread_pool_task_t *task;
+    int drained = 0;
+
+    apr_thread_mutex_lock(elt->ws_lock);
+    while ((task = ws_remove_first(me, elt)) != NULL) {
+        APR_RING_ELEM_INIT(task, link);
+        insert_task(me, task, 1);
+        drained = 1;
+    }
+    APR_RING_CONCAT(me->recycled_tasks, &elt->ws_recycled,
+                    apr_thread_pool_task, link);
+    elt->ws_recycled_cnt = 0;
+    me->tasks_run += elt->ws_run;
+    elt->ws_run = 0;
+    apr_thread_mutex_unlock(elt->ws_lock);
+
+    if (drained) {
+        apr_thread_cond_signal(me->more_work);
+    }
+}
+
+/*
+ * Remove the tasks of the given owner (or all) from the workers' queues.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void ws_remove_owner_tasks(apr_thread_pool_t *me,
+                                  struct apr_thread_list *thds, void *owner)
+{
+    struct apr_thread_list_elt *elt;
+    apr_thread_pool_task_t *t_loc, *next;
+    int seg;
+
+    for (elt = APR_RING_FIRST(thds);
+         elt != APR_RING_SENTINEL(thds, apr_thread_list_elt, link);
+         elt = APR_RING_NEXT(elt, link)) {
+        apr_thread_mutex_lock(elt->ws_lock);
+        for (seg = 0; seg < TASK_PRIORITY_SEGS && elt->ws_cnt; seg++) {
+            t_loc = APR_RING_FIRST(&elt->ws_tasks[seg]);
+            while (t_loc != APR_RING_SENTINEL(&elt->ws_tasks[seg],
+                                              apr_thread_pool_task, link)) {
+                next = APR_RING_NEXT(t_loc, link);
+                if (!owner || t_loc->owner == owner) {
+                    APR_RING_REMOVE(t_loc, link);
+                    APR_RING_INSERT_TAIL(&elt->ws_recycled, t_loc,
+                                         apr_thread_pool_task, link);
+                    elt->ws_recycled_cnt++;
+                    elt->ws_cnt--;
+                    apr_atomic_dec32(&me->ws_task_cnt);
+                }
+                t_loc = next;
+            }
+        }
+        apr_thread_mutex_unlock(elt->ws_lock);
+    }
+}
+
+/*
+ * The work stealing loop of a busy worker: run the tasks from its own queue
+ * without the pool's lock, then from the pool's queue or other workers'.
+ * Entered and left with the pool's lock held.
+ */
+static void ws_run_tasks(apr_thread_pool_t *me,
+                         struct apr_thread_list_elt *elt, apr_thread_t *t)
+{
+    apr_thread_pool_task_t *task;
+    int locked = 1;
+
+    do {
+        task = NULL;
+        if (!locked && ++elt->ws_ticks % WS_GLOBAL_INTERVAL) {
+            task = ws_pop_local(me, elt);
+            if (task) {
+                ++elt->ws_run;
+            }
+        }
+        if (!task) {
+            if (!locked) {
+                apr_thread_mutex_lock(me->lock);
+                apr_pool_owner_set(me->pool, 0);
+                locked = 1;
+                if (elt->state == TH_STOP) {
+                    break;
+                }
+            }
+            task = pop_task(me);
+            if (!task) {
+                task = ws_pop_local(me, elt);
+            }
+            if (!task) {
+                task = ws_steal(me, elt);
+            }
+            if (!task) {
+                break;
+            }
+            ++me->tasks_run;
+            elt->current_owner = task->owner;
+            apr_thread_mutex_unlock(me->lock);
+            locked = 0;
+        }
+
+        run_task(me, task, t);
+
+        ws_task_done(me, elt, task);
+    } while (elt->state != TH_STOP);
+
+    if (!locked) {
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+    }
+}
+
+#endif /* APR_THREAD_POOL_HAS_WS */
+
 /*
  * The worker thread function. Take a task from the queue and perform it if
  * there is any. Otherwise, put itself into the idle thread list and waiting
@@ -269,19 +856,39 @@ static struct apr_thread_list_elt *elt_new(apr_thread_pool_t * me,
  */
 static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
 {
-    apr_thread_pool_t *me = param;
+    struct apr_thread_list_elt *elt = param;
+    apr_thread_pool_t *me = elt->me;
     apr_thread_pool_task_t *task = NULL;
     apr_interval_time_t wait;
-    struct apr_thread_list_elt *elt;
 
     apr_thread_mutex_lock(me->lock);
     apr_pool_owner_set(me->pool, 0);
 
-    elt = elt_new(me, t);
-    if (!elt) {
+    elt->thd = t;
+
+    /* Name and initialize the worker, without holding the lock for the
+     * user's code; the element is in no list yet.
+     */
+    if (me->name || me->init_func) {
         apr_thread_mutex_unlock(me->lock);
-        apr_thread_exit(t, APR_ENOMEM);
+        if (me->name) {
+            char name[64];
+
+            apr_snprintf(name, sizeof(name), "%s-%" APR_SIZE_T_FMT,
+                         me->name, elt->index);
+            apr_thread_name_set(name, NULL, NULL);
+        }
+        if (me->init_func) {
+            me->init_func(t, elt->index, me->init_data);
+        }
+        apr_thread_mutex_lock(me->lock);
+        apr_pool_owner_set(me->pool, 0);
+    }
+#if APR_THREAD_POOL_HAS_WS
+    if (me->ws) {
+        ws_current = elt;
     }
+#endif
 
     for (;;) {
         /* Test if not new element, it is awakened from idle */
@@ -294,6 +901,12 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
             ++me->busy_cnt;
             APR_RING_INSERT_TAIL(me->busy_thds, elt,
                                  apr_thread_list_elt, link);
+#if APR_THREAD_POOL_HAS_WS
+            if (me->ws) {
+                ws_run_tasks(me, elt, t);
+            }
+            else
+#endif
             do {
                 task = pop_task(me);
                 if (!task) {
@@ -303,11 +916,7 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
                 elt->current_owner = task->owner;
                 apr_thread_mutex_unlock(me->lock);
 
-                /* Run the task (or drop it if terminated already) */
-                if (!me->terminated) {
-                    apr_thread_data_set(task, "apr_thread_pool_task", NULL, t);
-                    task->func(t, task->param);
-                }
+                run_task(me, task, t);
 
                 apr_thread_mutex_lock(me->lock);
                 apr_pool_owner_set(me->pool, 0);
@@ -362,6 +971,13 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
         apr_pool_owner_set(me->pool, 0);
     }
 
+#if APR_THREAD_POOL_HAS_WS
+    if (me->ws) {
+        ws_drain(me, elt);
+        ws_current = NULL;
+    }
+#endif
+
     /* Dead thread, to be joined */
     APR_RING_INSERT_TAIL(me->dead_thds, elt, apr_thread_list_elt, link);
     if (--me->thd_cnt == 0 && me->terminated) {
@@ -373,6 +989,72 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
     return NULL;                /* should not be here, safe net */
 }
 
+/*
+ * Pin the next worker's thread attributes according to the affinity policy.
+ */
+static apr_status_t thread_pool_affinity(apr_thread_pool_t *me,
+                                         apr_size_t index)
+{
+    apr_size_t slots, slot, i;
+
+    switch (me->affinity) {
+    case APR_THREAD_POOL_AFFINITY_COMPACT:
+        i = index % me->ncpus;
+        break;
+    case APR_THREAD_POOL_AFFINITY_SCATTER:
+        /* Spread the (maximum) workers evenly over the CPUs */
+        slots = me->thd_max ? me->thd_max : 1;
+        slot = index % slots;
+        if (slots < (apr_size_t)me->ncpus) {
+            i = slot * me->ncpus / slots;
+        }
+        else {
+            i = slot % me->ncpus;
+        }
+        break;
+    default:
+        /* NONE, or EXPLICIT set once for all the workers */
+        return APR_SUCCESS;
+    }
+
+    return apr_threadattr_affinity_set(me->thdattr, &me->cpus[i], 1);
+}
+
+/*
+ * Create a new worker thread and its list element.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_status_t thread_pool_spawn(apr_thread_pool_t *me)
+{
+    struct apr_thread_list_elt *elt;
+    apr_thread_t *thd;
+    apr_status_t rv;
+
+    elt = elt_new(me, NULL);
+    if (!elt) {
+        return APR_ENOMEM;
+    }
+    elt->index = me->thd_seq++;
+
+    rv = thread_pool_affinity(me, elt->index);
+    if (APR_SUCCESS == rv) {
+        rv = apr_thread_create(&thd, me->thdattr, thread_pool_func, elt,
+                               me->pool);
+    }
+    if (APR_SUCCESS != rv) {
+        APR_RING_INSERT_TAIL(me->recycled_thds, elt,
+                             apr_thread_list_elt, link);
+        return rv;
+    }
+
+    ++me->thd_cnt;
+    if (me->thd_cnt > me->thd_high)
+        me->thd_high = me->thd_cnt;
+
+    return APR_SUCCESS;
+}
+
 /* Must be locked by the caller */
 static void join_dead_threads(apr_thread_pool_t *me)
 {
@@ -421,7 +1103,141 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
                                                  apr_size_t max_threads,
                                                  apr_pool_t * pool)
 {
-    apr_thread_t *t;
+    return apr_thread_pool_create_ex(me, init_threads, max_threads, NULL,
+                                     pool);
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_create(
+                                            apr_thread_pool_attr_t **attr,
+                                            apr_pool_t *pool)
+{
+    *attr = apr_pcalloc(pool, sizeof(apr_thread_pool_attr_t));
+    (*attr)->pool = pool;
+    (*attr)->affinity = APR_THREAD_POOL_AFFINITY_NONE;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_flags_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            apr_uint32_t flags)
+{
+    attr->flags = flags;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_threadattr_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            apr_threadattr_t *thdattr)
+{
+    attr->thdattr = thdattr;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_worker_init_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            apr_thread_pool_worker_init_t func,
+                                            void *data)
+{
+    attr->init_func = func;
+    attr->init_data = data;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_name_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            const char *name)
+{
+    attr->name = name;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_attr_affinity_set(
+                                            apr_thread_pool_attr_t *attr,
+                                            int policy,
+                                            const int *cpus, int ncpus)
+{
+    switch (policy) {
+    case APR_THREAD_POOL_AFFINITY_NONE:
+        break;
+    case APR_THREAD_POOL_AFFINITY_EXPLICIT:
+        if (!cpus) {
+            return APR_EINVAL;
+        }
+        /* fall through */
+    case APR_THREAD_POOL_AFFINITY_COMPACT:
+    case APR_THREAD_POOL_AFFINITY_SCATTER:
+        if (ncpus <= 0) {
+            return APR_EINVAL;
+        }
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    attr->affinity = policy;
+    attr->cpus = cpus;
+    attr->ncpus = ncpus;
+    return APR_SUCCESS;
+}
+
+/*
+ * Apply the attributes to the thread pool being created.
+ */
+static apr_status_t thread_pool_attr_apply(apr_thread_pool_t *me,
+                                           const apr_thread_pool_attr_t *attr)
+{
+    apr_status_t rv;
+    int i;
+
+    if (!attr) {
+        return APR_SUCCESS;
+    }
+
+#if !APR_THREAD_POOL_HAS_WS
+    if (attr->flags & APR_THREAD_POOL_WORK_STEALING)
+        return APR_ENOTIMPL;
+#endif
+    me->ws = (attr->flags & APR_THREAD_POOL_WORK_STEALING) != 0;
+    if (attr->flags & APR_THREAD_POOL_STATS) {
+        me->hists = apr_pcalloc(me->pool, sizeof(*me->hists));
+    }
+
+    me->thdattr = attr->thdattr;
+    me->init_func = attr->init_func;
+    me->init_data = attr->init_data;
+    if (attr->name) {
+        me->name = apr_pstrdup(me->pool, attr->name);
+    }
+
+    me->affinity = attr->affinity;
+    if (me->affinity != APR_THREAD_POOL_AFFINITY_NONE) {
+        me->ncpus = attr->ncpus;
+        me->cpus = apr_palloc(me->pool, me->ncpus * sizeof(int));
+        for (i = 0; i < me->ncpus; i++) {
+            me->cpus[i] = attr->cpus ? attr->cpus[i] : i;
+        }
+        if (!me->thdattr) {
+            rv = apr_threadattr_create(&me->thdattr, me->pool);
+            if (APR_SUCCESS != rv) {
+                return rv;
+            }
+        }
+        /* The whole set for EXPLICIT, and a check for the others */
+        rv = apr_threadattr_affinity_set(me->thdattr, me->cpus, me->ncpus);
+        if (APR_SUCCESS != rv) {
+            return rv;
+        }
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_thread_pool_create_ex(apr_thread_pool_t ** me,
+                                                    apr_size_t init_threads,
+                                                    apr_size_t max_threads,
+                                             const apr_thread_pool_attr_t *attr,
+                                                    apr_pool_t * pool)
+{
     apr_status_t rv = APR_SUCCESS;
     apr_thread_pool_t *tp;
 
@@ -430,6 +1246,24 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
     rv = thread_pool_construct(&tp, init_threads, max_threads, pool);
     if (APR_SUCCESS != rv)
         return rv;
+    rv = thread_pool_attr_apply(tp, attr);
+    if (APR_SUCCESS != rv) {
+        apr_pool_destroy(tp->pool);
+        return rv;
+    }
+
+    /* Threads come and go with the load, let them reuse each other's pool
+     * (a threadattr provided by the user is left as is).
+     */
+    if (!tp->thdattr) {
+        rv = apr_threadattr_create(&tp->thdattr, tp->pool);
+        if (APR_SUCCESS != rv) {
+            apr_pool_destroy(tp->pool);
+            return rv;
+        }
+        apr_threadattr_cache_set(tp->thdattr, THREAD_CACHE_MAX);
+    }
+
     apr_pool_pre_cleanup_register(tp->pool, tp, thread_pool_cleanup);
 
     /* Grab the mutex as apr_thread_create() and thread_pool_func() will 
@@ -439,14 +1273,10 @@ APR_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
     apr_thread_mutex_lock(tp->lock);
     apr_pool_owner_set(tp->pool, 0);
     while (init_threads--) {
-        rv = apr_thread_create(&t, NULL, thread_pool_func, tp, tp->pool);
+        rv = thread_pool_spawn(tp);
         if (APR_SUCCESS != rv) {
             break;
         }
-        tp->thd_cnt++;
-        if (tp->thd_cnt > tp->thd_high) {
-            tp->thd_high = tp->thd_cnt;
-        }
     }
     apr_thread_mutex_unlock(tp->lock);
 
@@ -489,10 +1319,15 @@ static apr_thread_pool_task_t *task_new(apr_thread_pool_t * me,
     t->param = param;
     t->owner = owner;
     if (time > 0) {
-        t->dispatch.time = apr_time_now() + time;
+        t->dispatch.time = apr_time_monotonic() + time;
+        t->band = TASK_PRIORITY_SEGS;
     }
     else {
         t->dispatch.priority = priority;
+        t->band = TASK_PRIORITY_SEG(t);
+    }
+    if (me->hists) {
+        t->queued = apr_time_monotonic();
     }
     return t;
 }
@@ -540,18 +1375,20 @@ static apr_thread_pool_task_t *add_if_empty(apr_thread_pool_t * me,
 }
 
 /*
-*   schedule a task to run in "time" microseconds. Find the spot in the ring where
-*   the time fits. Adjust the short_time so the thread wakes up when the time is reached.
+*   schedule a task to run in "time" microseconds. The scheduled tasks are
+*   kept in a skiplist ordered by time, so insertion is O(log n) and the next
+*   task to run is always the first. Adjust the short_time so the thread wakes
+*   up when the time is reached.
 */
 static apr_status_t schedule_task(apr_thread_pool_t *me,
                                   apr_thread_start_t func, void *param,
                                   void *owner, apr_interval_time_t time)
 {
     apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
-    apr_thread_t *thd;
     apr_status_t rv = APR_SUCCESS;
 
+    APR_PROBE3(thread_pool__push, me, func, param);
+
     apr_thread_mutex_lock(me->lock);
     apr_pool_owner_set(me->pool, 0);
 
@@ -569,34 +1406,22 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
         apr_thread_mutex_unlock(me->lock);
         return APR_ENOMEM;
     }
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (NULL != t_loc) {
-        /* if the time is less than the entry insert ahead of it */
-        if (t->dispatch.time < t_loc->dispatch.time) {
-            ++me->scheduled_task_cnt;
-            APR_RING_INSERT_BEFORE(t_loc, t, link);
-            break;
-        }
-        else {
-            t_loc = APR_RING_NEXT(t_loc, link);
-            if (t_loc ==
-                APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                  link)) {
-                ++me->scheduled_task_cnt;
-                APR_RING_INSERT_TAIL(me->scheduled_tasks, t,
-                                     apr_thread_pool_task, link);
-                break;
-            }
-        }
+    if (time <= 0) {
+        t->dispatch.time = apr_time_monotonic();
+        t->band = TASK_PRIORITY_SEGS;
+    }
+    /* same time tasks run in scheduling order */
+    t->seq = me->scheduled_seq++;
+    if (!apr_skiplist_insert(me->scheduled_tasks, t)) {
+        APR_RING_INSERT_TAIL(me->recycled_tasks, t,
+                             apr_thread_pool_task, link);
+        apr_thread_mutex_unlock(me->lock);
+        return APR_ENOMEM;
     }
+    ++me->scheduled_task_cnt;
     /* there should be at least one thread for scheduled tasks */
     if (0 == me->thd_cnt) {
-        rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
-        if (APR_SUCCESS == rv) {
-            ++me->thd_cnt;
-            if (me->thd_cnt > me->thd_high)
-                me->thd_high = me->thd_cnt;
-        }
+        rv = thread_pool_spawn(me);
     }
     apr_thread_cond_signal(me->more_work);
     apr_thread_mutex_unlock(me->lock);
@@ -604,15 +1429,61 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
     return rv;
 }
 
+/*
+ * Insert the task in the pool's queue, at the bottom (push) or the top of
+ * the tasks of same priority.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void insert_task(apr_thread_pool_t *me, apr_thread_pool_task_t *t,
+                        int push)
+{
+    apr_thread_pool_task_t *t_loc;
+
+    if (me->hists) {
+        hist_add(&me->hists->depth, me->task_cnt);
+    }
+
+    t_loc = add_if_empty(me, t);
+    if (NULL == t_loc) {
+        goto FINAL_EXIT;
+    }
+
+    if (push) {
+        while (APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) !=
+               t_loc && t_loc->dispatch.priority >= t->dispatch.priority) {
+            t_loc = APR_RING_NEXT(t_loc, link);
+        }
+    }
+    APR_RING_INSERT_BEFORE(t_loc, t, link);
+    if (!push) {
+        if (t_loc == me->task_idx[TASK_PRIORITY_SEG(t)]) {
+            me->task_idx[TASK_PRIORITY_SEG(t)] = t;
+        }
+    }
+
+  FINAL_EXIT:
+    me->task_cnt++;
+    if (me->task_cnt > me->tasks_high)
+        me->tasks_high = me->task_cnt;
+}
+
 static apr_status_t add_task(apr_thread_pool_t *me, apr_thread_start_t func,
                              void *param, apr_byte_t priority, int push,
                              void *owner)
 {
-    apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
-    apr_thread_t *thd;
+    apr_thread_pool_task_t *t;
     apr_status_t rv = APR_SUCCESS;
 
+    APR_PROBE3(thread_pool__push, me, func, param);
+
+#if APR_THREAD_POOL_HAS_WS
+    if (me->ws && ws_current && ws_current->me == me) {
+        return ws_push_local(me, ws_current, func, param, priority, push,
+                             owner);
+    }
+#endif
+
     apr_thread_mutex_lock(me->lock);
     apr_pool_owner_set(me->pool, 0);
 
@@ -631,36 +1502,11 @@ static apr_status_t add_task(apr_thread_pool_t *me, apr_thread_start_t func,
         return APR_ENOMEM;
     }
 
-    t_loc = add_if_empty(me, t);
-    if (NULL == t_loc) {
-        goto FINAL_EXIT;
-    }
-
-    if (push) {
-        while (APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) !=
-               t_loc && t_loc->dispatch.priority >= t->dispatch.priority) {
-            t_loc = APR_RING_NEXT(t_loc, link);
-        }
-    }
-    APR_RING_INSERT_BEFORE(t_loc, t, link);
-    if (!push) {
-        if (t_loc == me->task_idx[TASK_PRIORITY_SEG(t)]) {
-            me->task_idx[TASK_PRIORITY_SEG(t)] = t;
-        }
-    }
+    insert_task(me, t, push);
 
-  FINAL_EXIT:
-    me->task_cnt++;
-    if (me->task_cnt > me->tasks_high)
-        me->tasks_high = me->task_cnt;
     if (0 == me->thd_cnt || (0 == me->idle_cnt && me->thd_cnt < me->thd_max &&
                              me->task_cnt > me->threshold)) {
-        rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
-        if (APR_SUCCESS == rv) {
-            ++me->thd_cnt;
-            if (me->thd_cnt > me->thd_high)
-                me->thd_high = me->thd_cnt;
-        }
+        rv = thread_pool_spawn(me);
     }
 
     apr_thread_cond_signal(me->more_work);
@@ -700,19 +1546,30 @@ static apr_status_t remove_scheduled_tasks(apr_thread_pool_t *me,
                                            void *owner)
 {
     apr_thread_pool_task_t *t_loc;
-    apr_thread_pool_task_t *next;
+    apr_skiplistnode *iter, *next;
 
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (t_loc !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link)) {
-        next = APR_RING_NEXT(t_loc, link);
+    if (!owner) {
+        while ((t_loc = apr_skiplist_pop(me->scheduled_tasks, NULL))) {
+            APR_RING_INSERT_TAIL(me->recycled_tasks, t_loc,
+                                 apr_thread_pool_task, link);
+        }
+        me->scheduled_task_cnt = 0;
+        return APR_SUCCESS;
+    }
+
+    iter = apr_skiplist_getlist(me->scheduled_tasks);
+    while (iter) {
+        next = iter;
+        apr_skiplist_next(me->scheduled_tasks, &next);
+        t_loc = apr_skiplist_element(iter);
         /* if this is the owner remove it */
-        if (!owner || t_loc->owner == owner) {
+        if (t_loc->owner == owner) {
             --me->scheduled_task_cnt;
-            APR_RING_REMOVE(t_loc, link);
+            apr_skiplist_remove_node(me->scheduled_tasks, iter, NULL);
+            APR_RING_INSERT_TAIL(me->recycled_tasks, t_loc,
+                                 apr_thread_pool_task, link);
         }
-        t_loc = next;
+        iter = next;
     }
     return APR_SUCCESS;
 }
@@ -721,24 +1578,12 @@ static apr_status_t remove_tasks(apr_thread_pool_t *me, void *owner)
 {
     apr_thread_pool_task_t *t_loc;
     apr_thread_pool_task_t *next;
-    int seg;
 
     t_loc = APR_RING_FIRST(me->tasks);
     while (t_loc != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link)) {
         next = APR_RING_NEXT(t_loc, link);
         if (!owner || t_loc->owner == owner) {
-            --me->task_cnt;
-            seg = TASK_PRIORITY_SEG(t_loc);
-            if (t_loc == me->task_idx[seg]) {
-                me->task_idx[seg] = APR_RING_NEXT(t_loc, link);
-                if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
-                                                           apr_thread_pool_task,
-                                                           link)
-                    || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
-                    me->task_idx[seg] = NULL;
-                }
-            }
-            APR_RING_REMOVE(t_loc, link);
+            unlink_task(me, t_loc);
         }
         t_loc = next;
     }
@@ -755,7 +1600,18 @@ static void wait_on_busy_threads(apr_thread_pool_t *me, void *owner)
 
     elt = APR_RING_FIRST(me->busy_thds);
     while (elt != APR_RING_SENTINEL(me->busy_thds, apr_thread_list_elt, link)) {
+#if APR_THREAD_POOL_HAS_WS
+        /* The worker may update current_owner with its ws_lock only */
+        if (me->ws) {
+            apr_thread_mutex_lock(elt->ws_lock);
+        }
+#endif
         if (owner ? owner != elt->current_owner : !elt->current_owner) {
+#if APR_THREAD_POOL_HAS_WS
+            if (me->ws) {
+                apr_thread_mutex_unlock(elt->ws_lock);
+            }
+#endif
             elt = APR_RING_NEXT(elt, link);
             continue;
         }
@@ -772,6 +1628,11 @@ static void wait_on_busy_threads(apr_thread_pool_t *me, void *owner)
 #endif
 
         elt->signal_work_done = 1;
+#if APR_THREAD_POOL_HAS_WS
+        if (me->ws) {
+            apr_thread_mutex_unlock(elt->ws_lock);
+        }
+#endif
         apr_thread_cond_wait(me->work_done, me->lock);
         apr_pool_owner_set(me->pool, 0);
 
@@ -797,6 +1658,12 @@ APR_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
     if (me->scheduled_task_cnt > 0) {
         rv = remove_scheduled_tasks(me, owner);
     }
+#if APR_THREAD_POOL_HAS_WS
+    if (me->ws) {
+        ws_remove_owner_tasks(me, me->busy_thds, owner);
+        ws_remove_owner_tasks(me, me->idle_thds, owner);
+    }
+#endif
 
     wait_on_busy_threads(me, owner);
 
@@ -807,7 +1674,7 @@ APR_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
 
 APR_DECLARE(apr_size_t) apr_thread_pool_tasks_count(apr_thread_pool_t *me)
 {
-    return me->task_cnt;
+    return me->task_cnt + apr_atomic_read32(&me->ws_task_cnt);
 }
 
 APR_DECLARE(apr_size_t)
@@ -834,6 +1701,27 @@ APR_DECLARE(apr_size_t) apr_thread_pool_idle_count(apr_thread_pool_t *me)
 APR_DECLARE(apr_size_t)
     apr_thread_pool_tasks_run_count(apr_thread_pool_t * me)
 {
+#if APR_THREAD_POOL_HAS_WS
+    if (me->ws) {
+        struct apr_thread_list_elt *elt;
+        apr_size_t n;
+
+        apr_thread_mutex_lock(me->lock);
+        n = me->tasks_run;
+        for (elt = APR_RING_FIRST(me->busy_thds);
+             elt != APR_RING_SENTINEL(me->busy_thds, apr_thread_list_elt, link);
+             elt = APR_RING_NEXT(elt, link)) {
+            n += elt->ws_run;
+        }
+        for (elt = APR_RING_FIRST(me->idle_thds);
+             elt != APR_RING_SENTINEL(me->idle_thds, apr_thread_list_elt, link);
+             elt = APR_RING_NEXT(elt, link)) {
+            n += elt->ws_run;
+        }
+        apr_thread_mutex_unlock(me->lock);
+        return n;
+    }
+#endif
     return me->tasks_run;
 }
 
@@ -855,6 +1743,69 @@ APR_DECLARE(apr_size_t)
     return me->thd_timed_out;
 }
 
+APR_DECLARE(apr_status_t) apr_thread_pool_stats_get(apr_thread_pool_t *me,
+                                            apr_thread_pool_stats_t *stats)
+{
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->tasks_run = apr_thread_pool_tasks_run_count(me);
+
+    apr_thread_mutex_lock(me->lock);
+    stats->tasks = me->task_cnt + apr_atomic_read32(&me->ws_task_cnt);
+    stats->scheduled_tasks = me->scheduled_task_cnt;
+    stats->threads = me->thd_cnt;
+    stats->busy = me->busy_cnt;
+    stats->idle = me->idle_cnt;
+    stats->tasks_high = me->tasks_high;
+    stats->threads_high = me->thd_high;
+    stats->idle_timeouts = me->thd_timed_out;
+    apr_thread_mutex_unlock(me->lock);
+
+    if (me->hists) {
+        for (i = 0; i < TASK_PRIORITY_SEGS; i++) {
+            hist_get(&stats->wait[i], &me->hists->wait[i]);
+            hist_get(&stats->run[i], &me->hists->run[i]);
+        }
+        hist_get(&stats->scheduled_wait, &me->hists->wait[i]);
+        hist_get(&stats->scheduled_run, &me->hists->run[i]);
+        hist_get(&stats->queue_depth, &me->hists->depth);
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_uint64_t) apr_thread_pool_histogram_value_at(
+                                    const apr_thread_pool_histogram_t *hist,
+                                    double percentile)
+{
+    apr_uint64_t target, seen = 0, value;
+    int i;
+
+    if (!hist->count) {
+        return 0;
+    }
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    }
+    if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+    target = (apr_uint64_t)(hist->count * percentile / 100.0 + 0.5);
+    if (!target) {
+        target = 1;
+    }
+
+    for (i = 0; i < APR_THREAD_POOL_HISTOGRAM_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            break;
+        }
+    }
+    value = hist_value(i);
+    return value < hist->max ? value : hist->max;
+}
+
 
 APR_DECLARE(apr_size_t) apr_thread_pool_idle_max_get(apr_thread_pool_t *me)
 {
@@ -1019,6 +1970,395 @@ APR_DECLARE(apr_status_t) apr_thread_pool_task_owner_get(apr_thread_t *thd,
     return APR_SUCCESS;
 }
 
+/*
+ * Task groups: the group is the owner of its tasks in the thread pool, so
+ * that a waiting thread can take them back from the queues and run them.
+ */
+
+typedef struct parallel_for_t parallel_for_t;
+
+typedef struct task_group_task_t task_group_task_t;
+struct task_group_task_t
+{
+    apr_task_group_t *group;
+    apr_task_group_fn_t *func;
+    void *baton;
+    parallel_for_t *pf;         /* or the range of an apr_parallel_for() */
+    apr_size_t begin, end;
+    task_group_task_t *next;    /* recycled */
+};
+
+struct apr_task_group_t
+{
+    apr_thread_pool_t *tp;
+    apr_pool_t *pool;
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *cond;
+    apr_size_t pending;
+    int waiters;
+    apr_status_t status;
+    volatile apr_uint32_t cancelled;
+    task_group_task_t *recycled;
+};
+
+struct parallel_for_t
+{
+    apr_task_group_t *group;
+    apr_parallel_for_fn_t *func;
+    void *baton;
+    apr_size_t grain;
+};
+
+#if APR_THREAD_POOL_HAS_WS
+/*
+ * Take a task of the owner from the worker's queue.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_thread_pool_task_t *ws_take_owner_task(apr_thread_pool_t *me,
+                                        struct apr_thread_list_elt *elt,
+                                        void *owner)
+{
+    apr_thread_pool_task_t *t_loc = NULL;
+    int seg;
+
+    apr_thread_mutex_lock(elt->ws_lock);
+    for (seg = TASK_PRIORITY_SEGS - 1; seg >= 0 && elt->ws_cnt; seg--) {
+        for (t_loc = APR_RING_FIRST(&elt->ws_tasks[seg]);
+             t_loc != APR_RING_SENTINEL(&elt->ws_tasks[seg],
+                                        apr_thread_pool_task, link);
+             t_loc = APR_RING_NEXT(t_loc, link)) {
+            if (t_loc->owner == owner) {
+                APR_RING_REMOVE(t_loc, link);
+                elt->ws_cnt--;
+                apr_atomic_dec32(&me->ws_task_cnt);
+                apr_thread_mutex_unlock(elt->ws_lock);
+                return t_loc;
+            }
+        }
+    }
+    apr_thread_mutex_unlock(elt->ws_lock);
+
+    return NULL;
+}
+#endif
+
+/*
+ * Take a queued task of the owner, from the current worker's queue first.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_thread_pool_task_t *take_owner_task(apr_thread_pool_t *me,
+                                               void *owner)
+{
+    apr_thread_pool_task_t *t_loc;
+
+#if APR_THREAD_POOL_HAS_WS
+    if (me->ws && apr_atomic_read32(&me->ws_task_cnt)) {
+        struct apr_thread_list *thds[2];
+        struct apr_thread_list_elt *elt;
+        int i;
+
+        if (ws_current && ws_current->me == me) {
+            t_loc = ws_take_owner_task(me, ws_current, owner);
+            if (t_loc) {
+                return t_loc;
+            }
+        }
+        thds[0] = me->busy_thds;
+        thds[1] = me->idle_thds;
+        for (i = 0; i < 2; i++) {
+            for (elt = APR_RING_FIRST(thds[i]);
+                 elt != APR_RING_SENTINEL(thds[i], apr_thread_list_elt, link);
+                 elt = APR_RING_NEXT(elt, link)) {
+                t_loc = ws_take_owner_task(me, elt, owner);
+                if (t_loc) {
+                    return t_loc;
+                }
+            }
+        }
+    }
+#endif
+
+    if (me->task_cnt) {
+        for (t_loc = APR_RING_FIRST(me->tasks);
+             t_loc != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link);
+             t_loc = APR_RING_NEXT(t_loc, link)) {
+            if (t_loc->owner == owner) {
+                unlink_task(me, t_loc);
+                return t_loc;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Run a queued task of the owner in the calling thread, if any.
+ */
+static int run_owner_task(apr_thread_pool_t *me, void *owner)
+{
+    apr_thread_pool_task_t *task;
+    apr_thread_t *t = NULL;
+
+    apr_thread_mutex_lock(me->lock);
+    apr_pool_owner_set(me->pool, 0);
+    task = take_owner_task(me, owner);
+    if (task) {
+        ++me->tasks_run;
+    }
+    apr_thread_mutex_unlock(me->lock);
+    if (!task) {
+        return 0;
+    }
+
+#if APR_THREAD_POOL_HAS_WS
+    if (ws_current && ws_current->me == me) {
+        t = ws_current->thd;
+    }
+#endif
+    task->func(t, task->param);
+
+    apr_thread_mutex_lock(me->lock);
+    apr_pool_owner_set(me->pool, 0);
+    APR_RING_INSERT_TAIL(me->recycled_tasks, task, apr_thread_pool_task, link);
+    apr_thread_mutex_unlock(me->lock);
+
+    return 1;
+}
+
+static apr_status_t parallel_range(parallel_for_t *pf, apr_size_t begin,
+                                   apr_size_t end);
+
+static void *APR_THREAD_FUNC task_group_func(apr_thread_t *thd, void *param)
+{
+    task_group_task_t *gt = param;
+    apr_task_group_t *group = gt->group;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (!apr_atomic_read32(&group->cancelled)) {
+        if (gt->pf) {
+            rv = parallel_range(gt->pf, gt->begin, gt->end);
+        }
+        else {
+            rv = gt->func(gt->baton);
+        }
+    }
+
+    apr_thread_mutex_lock(group->lock);
+    if (rv != APR_SUCCESS) {
+        if (group->status == APR_SUCCESS) {
+            group->status = rv;
+        }
+        /* A loop stops at the first failure */
+        if (gt->pf) {
+            apr_atomic_set32(&group->cancelled, 1);
+        }
+    }
+    gt->next = group->recycled;
+    group->recycled = gt;
+    /* The group may be gone once unlocked, if it was the last task */
+    if (--group->pending == 0 && group->waiters) {
+        apr_thread_cond_broadcast(group->cond);
+    }
+    apr_thread_mutex_unlock(group->lock);
+
+    return NULL;
+}
+
+static apr_status_t task_group_push(apr_task_group_t *group,
+                                    apr_task_group_fn_t *func, void *baton,
+                                    parallel_for_t *pf, apr_size_t begin,
+                                    apr_size_t end)
+{
+    task_group_task_t *gt;
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(group->lock);
+    if (apr_atomic_read32(&group->cancelled)) {
+        apr_thread_mutex_unlock(group->lock);
+        return APR_INCOMPLETE;
+    }
+    gt = group->recycled;
+    if (gt) {
+        group->recycled = gt->next;
+    }
+    else {
+        gt = apr_palloc(group->pool, sizeof(*gt));
+    }
+    gt->group = group;
+    gt->func = func;
+    gt->baton = baton;
+    gt->pf = pf;
+    gt->begin = begin;
+    gt->end = end;
+    group->pending++;
+    apr_thread_mutex_unlock(group->lock);
+
+    rv = apr_thread_pool_push(group->tp, task_group_func, gt,
+                              APR_THREAD_TASK_PRIORITY_NORMAL, group);
+
+    apr_thread_mutex_lock(group->lock);
+    if (rv != APR_SUCCESS) {
+        gt->next = group->recycled;
+        group->recycled = gt;
+        group->pending--;
+    }
+    /* Let the waiters help */
+    if (group->waiters) {
+        apr_thread_cond_broadcast(group->cond);
+    }
+    apr_thread_mutex_unlock(group->lock);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_task_group_create(apr_task_group_t **group,
+                                                apr_thread_pool_t *tp,
+                                                apr_pool_t *p)
+{
+    apr_task_group_t *new_group;
+    apr_status_t rv;
+
+    new_group = apr_pcalloc(p, sizeof(*new_group));
+    new_group->tp = tp;
+
+    /* The tasks are allocated from there with the group's lock */
+    rv = apr_pool_create(&new_group->pool, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_thread_mutex_create(&new_group->lock, APR_THREAD_MUTEX_DEFAULT,
+                                 p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_thread_cond_create(&new_group->cond, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    *group = new_group;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_task_group_spawn(apr_task_group_t *group,
+                                               apr_task_group_fn_t *func,
+                                               void *baton)
+{
+    return task_group_push(group, func, baton, NULL, 0, 0);
+}
+
+APR_DECLARE(apr_status_t) apr_task_group_wait(apr_task_group_t *group)
+{
+    apr_status_t rv;
+
+    apr_thread_mutex_lock(group->lock);
+    while (group->pending) {
+        int ran;
+
+        /* Help rather than sleep */
+        apr_thread_mutex_unlock(group->lock);
+        ran = run_owner_task(group->tp, group);
+        apr_thread_mutex_lock(group->lock);
+
+        if (!ran && group->pending) {
+            group->waiters++;
+            apr_thread_cond_wait(group->cond, group->lock);
+            group->waiters--;
+        }
+    }
+    rv = group->status;
+    if (rv == APR_SUCCESS && apr_atomic_read32(&group->cancelled)) {
+        rv = APR_INCOMPLETE;
+    }
+    /* Reusable */
+    group->status = APR_SUCCESS;
+    apr_atomic_set32(&group->cancelled, 0);
+    apr_thread_mutex_unlock(group->lock);
+
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_task_group_cancel(apr_task_group_t *group)
+{
+    apr_atomic_set32(&group->cancelled, 1);
+    return APR_SUCCESS;
+}
+
+/*
+ * Run a range of the loop, leaving the upper halves to the other workers
+ * (they are stolen first) down to the grain.
+ */
+static apr_status_t parallel_range(parallel_for_t *pf, apr_size_t begin,
+                                   apr_size_t end)
+{
+    while (end - begin > pf->grain) {
+        apr_size_t mid = begin + (end - begin) / 2;
+
+        if (task_group_push(pf->group, NULL, NULL, pf, mid, end)
+                != APR_SUCCESS) {
+            break;
+        }
+        end = mid;
+    }
+    if (apr_atomic_read32(&pf->group->cancelled)) {
+        return APR_SUCCESS;
+    }
+    return pf->func(begin, end, pf->baton);
+}
+
+APR_DECLARE(apr_status_t) apr_parallel_for(apr_thread_pool_t *tp,
+                                           apr_size_t begin, apr_size_t end,
+                                           apr_size_t grain,
+                                           apr_parallel_for_fn_t *func,
+                                           void *baton, apr_pool_t *p)
+{
+    parallel_for_t pf;
+    apr_pool_t *subpool;
+    apr_status_t rv, rv2;
+
+    if (begin >= end) {
+        return APR_SUCCESS;
+    }
+    if (!grain) {
+        /* About eight ranges per thread */
+        apr_size_t n = tp->thd_max ? tp->thd_max * 8 : 1;
+
+        grain = (end - begin) / n;
+        if (!grain) {
+            grain = 1;
+        }
+    }
+
+    rv = apr_pool_create(&subpool, p);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_task_group_create(&pf.group, tp, subpool);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(subpool);
+        return rv;
+    }
+    pf.func = func;
+    pf.baton = baton;
+    pf.grain = grain;
+
+    /* The caller runs the first range, then helps with the others */
+    rv = parallel_range(&pf, begin, end);
+    if (rv != APR_SUCCESS) {
+        apr_task_group_cancel(pf.group);
+    }
+    rv2 = apr_task_group_wait(pf.group);
+    if (rv == APR_SUCCESS) {
+        rv = rv2;
+    }
+
+    apr_pool_destroy(subpool);
+    return rv;
+}
+
 #endif /* APR_HAS_THREADS */
 
 /* vim: set ts=4 sw=4 et cin tw=80: */
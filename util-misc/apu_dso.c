@@ -122,9 +122,12 @@ apr_status_t apu_dso_init(apr_pool_t *pool)
     return ret;
 }
 
+/* The modules loaded, by name, each with the symbols resolved from it */
 struct dso_entry {
+    struct dso_entry *next;
     apr_dso_handle_t *handle;
-    apr_dso_handle_sym_t *sym;
+    const char *modsym;
+    apr_dso_handle_sym_t sym;
 };
 
 apr_status_t apu_dso_load(apr_dso_handle_t **dlhandleptr,
@@ -143,16 +146,34 @@ apr_status_t apu_dso_load(apr_dso_handle_t **dlhandleptr,
     char *eos = NULL;
     int i;
 
+    /* The driver DSO must have exactly the same lifetime as the
+     * drivers hash table; ignore the passed-in pool */
+    global = apr_hash_pool_get(dsos);
+
     entry = apr_hash_get(dsos, module, APR_HASH_KEY_STRING);
     if (entry) {
+        struct dso_entry *first = entry;
+
         *dlhandleptr = entry->handle;
-        *dsoptr = entry->sym;
-        return APR_EINIT;
-    }
+        for (; entry; entry = entry->next) {
+            if (!strcmp(entry->modsym, modsym)) {
+                *dsoptr = entry->sym;
+                return APR_EINIT;
+            }
+        }
 
-    /* The driver DSO must have exactly the same lifetime as the
-     * drivers hash table; ignore the passed-in pool */
-    global = apr_hash_pool_get(dsos);
+        /* Already loaded, only resolve this symbol (once) */
+        rv = apr_dso_sym(dsoptr, first->handle, modsym);
+        if (rv == APR_SUCCESS) {
+            entry = apr_palloc(global, sizeof(*entry));
+            entry->handle = first->handle;
+            entry->modsym = apr_pstrdup(global, modsym);
+            entry->sym = *dsoptr;
+            entry->next = first->next;
+            first->next = entry;
+        }
+        return rv;
+    }
 
     /* Retrieve our path search list or prepare for a single search */
     if ((apr_env_get(&pathlist, APR_DSOPATH, pool) != APR_SUCCESS)
@@ -224,12 +245,47 @@ apr_status_t apu_dso_load(apr_dso_handle_t **dlhandleptr,
     else {
         module = apr_pstrdup(global, module);
         entry = apr_palloc(global, sizeof(*entry));
+        entry->next = NULL;
         entry->handle = dlhandle;
+        entry->modsym = apr_pstrdup(global, modsym);
         entry->sym = *dsoptr;
         apr_hash_set(dsos, module, APR_HASH_KEY_STRING, entry);
     }
     return rv;
 }
 
+struct apu_dso_driver_t {
+    apu_dso_driver_t *next;
+    const char *name;
+    const void *driver;
+};
+
+const void *apu_dso_driver_get(apu_dso_driver_t *volatile *list,
+                               const char *name)
+{
+    apu_dso_driver_t *d;
+
+    /* The entries are never modified once published, and are published
+     * (by the exchange's barrier) only when complete.
+     */
+    for (d = *list; d; d = d->next) {
+        if (!strcmp(d->name, name)) {
+            return d->driver;
+        }
+    }
+    return NULL;
+}
+
+void apu_dso_driver_set(apu_dso_driver_t *volatile *list, const char *name,
+                        const void *driver, apr_pool_t *pool)
+{
+    apu_dso_driver_t *d = apr_palloc(pool, sizeof(*d));
+
+    d->next = *list;
+    d->name = apr_pstrdup(pool, name);
+    d->driver = driver;
+    apr_atomic_xchgptr((void *volatile *)list, d);
+}
+
 #endif /* APR_DSO_BUILD */
 
@@ -20,6 +20,7 @@
 #include "apr_strings.h"
 #include "apr_portable.h"
 #include "apr_xlate.h"
+#include "apr_encode_private.h"
 
 /* If no implementation is available, don't generate code here since
  * apr_xlate.h emitted macros which return APR_ENOTIMPL.
@@ -50,11 +51,22 @@
 #define min(x,y) ((x) <= (y) ? (x) : (y))
 #endif
 
+/* The charsets converted without iconv */
+typedef enum {
+    XLATE_NONE = 0,
+    XLATE_UTF8,
+    XLATE_LATIN1,
+    XLATE_UTF16LE,
+    XLATE_UTF16BE
+} xlate_builtin_e;
+
 struct apr_xlate_t {
     apr_pool_t *pool;
     char *frompage;
     char *topage;
     char *sbcs_table;
+    xlate_builtin_e from_builtin;
+    xlate_builtin_e to_builtin;
 #if APU_HAVE_ICONV
     iconv_t ich;
 #endif
@@ -181,6 +193,316 @@ static void check_sbcs(apr_xlate_t *convset)
 }
 #endif /* APU_HAVE_APR_ICONV */
 
+/* Recognize the charsets having a built-in converter, ignoring case,
+ * dashes and underscores.  UTF-16 without an explicit byte order is left
+ * to iconv, which handles the BOM.
+ */
+static xlate_builtin_e builtin_charset(const char *page)
+{
+    char name[16];
+    apr_size_t i = 0;
+
+    for (; *page; ++page) {
+        if (*page == '-' || *page == '_') {
+            continue;
+        }
+        if (i == sizeof(name) - 1) {
+            return XLATE_NONE;
+        }
+        name[i++] = apr_toupper(*page);
+    }
+    name[i] = '\0';
+
+    if (!strcmp(name, "UTF8")) {
+        return XLATE_UTF8;
+    }
+    if (!strcmp(name, "ISO88591") || !strcmp(name, "LATIN1")) {
+        return XLATE_LATIN1;
+    }
+    if (!strcmp(name, "UTF16LE")) {
+        return XLATE_UTF16LE;
+    }
+    if (!strcmp(name, "UTF16BE")) {
+        return XLATE_UTF16BE;
+    }
+    return XLATE_NONE;
+}
+
+/* Decode one character from in, returning its length or 0 with *status
+ * set: APR_INCOMPLETE for a truncated sequence, APR_EINVAL for an
+ * invalid one.
+ */
+static apr_size_t builtin_decode(xlate_builtin_e cs,
+                                 const unsigned char *in, apr_size_t len,
+                                 apr_uint32_t *c, apr_status_t *status)
+{
+    apr_size_t n, i;
+    apr_uint32_t low;
+
+    switch (cs) {
+    case XLATE_LATIN1:
+        *c = *in;
+        return 1;
+
+    case XLATE_UTF16LE:
+    case XLATE_UTF16BE:
+        if (len < 2) {
+            *status = APR_INCOMPLETE;
+            return 0;
+        }
+        if (cs == XLATE_UTF16LE) {
+            *c = in[0] | (in[1] << 8);
+        }
+        else {
+            *c = (in[0] << 8) | in[1];
+        }
+        if (*c < 0xD800 || *c > 0xDFFF) {
+            return 2;
+        }
+        if (*c > 0xDBFF) {
+            *status = APR_EINVAL; /* lone low surrogate */
+            return 0;
+        }
+        if (len < 4) {
+            *status = APR_INCOMPLETE;
+            return 0;
+        }
+        if (cs == XLATE_UTF16LE) {
+            low = in[2] | (in[3] << 8);
+        }
+        else {
+            low = (in[2] << 8) | in[3];
+        }
+        if (low < 0xDC00 || low > 0xDFFF) {
+            *status = APR_EINVAL;
+            return 0;
+        }
+        *c = 0x10000 + ((*c - 0xD800) << 10) + (low - 0xDC00);
+        return 4;
+
+    case XLATE_UTF8:
+        if (*in < 0x80) {
+            *c = *in;
+            return 1;
+        }
+        if (*in < 0xC2 || *in > 0xF4) {
+            *status = APR_EINVAL; /* continuation, overlong or too large */
+            return 0;
+        }
+        if (*in < 0xE0) {
+            n = 2;
+            *c = *in & 0x1F;
+            low = 0x80;
+        }
+        else if (*in < 0xF0) {
+            n = 3;
+            *c = *in & 0x0F;
+            low = 0x800;
+        }
+        else {
+            n = 4;
+            *c = *in & 0x07;
+            low = 0x10000;
+        }
+        for (i = 1; i < n; ++i) {
+            if (i == len) {
+                *status = APR_INCOMPLETE;
+                return 0;
+            }
+            if ((in[i] & 0xC0) != 0x80) {
+                *status = APR_EINVAL;
+                return 0;
+            }
+            *c = (*c << 6) | (in[i] & 0x3F);
+            /* Reject overlongs, surrogates and beyond U+10FFFF as soon as
+             * the second byte tells, rather than as incomplete.
+             */
+            if (i == 1) {
+                apr_uint32_t shift = 6 * (n - 2);
+
+                if (*c < (low >> shift)
+                    || (n == 3 && *c >= (0xD800 >> shift)
+                               && *c <= (0xDFFF >> shift))
+                    || (n == 4 && *c > (0x10FFFF >> shift))) {
+                    *status = APR_EINVAL;
+                    return 0;
+                }
+            }
+        }
+        return n;
+
+    default:
+        *status = APR_EINVAL;
+        return 0;
+    }
+}
+
+/* Encode c in *outbuf, returning its length, or 0 if it does not fit
+ * (with *status unchanged) or else is not representable (APR_EINVAL).
+ */
+static apr_size_t builtin_encode(xlate_builtin_e cs, apr_uint32_t c,
+                                 unsigned char *out, apr_size_t len,
+                                 apr_status_t *status)
+{
+    switch (cs) {
+    case XLATE_LATIN1:
+        if (len < 1) {
+            return 0;
+        }
+        if (c > 0xFF) {
+            *status = APR_EINVAL;
+            return 0;
+        }
+        out[0] = c;
+        return 1;
+
+    case XLATE_UTF16LE:
+    case XLATE_UTF16BE:
+        {
+            apr_uint32_t w[2];
+            apr_size_t i, n = 1;
+
+            if (c < 0x10000) {
+                w[0] = c;
+            }
+            else {
+                w[0] = 0xD800 + ((c - 0x10000) >> 10);
+                w[1] = 0xDC00 + ((c - 0x10000) & 0x3FF);
+                n = 2;
+            }
+            if (len < n * 2) {
+                return 0;
+            }
+            for (i = 0; i < n; ++i) {
+                if (cs == XLATE_UTF16LE) {
+                    out[i * 2] = w[i] & 0xFF;
+                    out[i * 2 + 1] = w[i] >> 8;
+                }
+                else {
+                    out[i * 2] = w[i] >> 8;
+                    out[i * 2 + 1] = w[i] & 0xFF;
+                }
+            }
+            return n * 2;
+        }
+
+    case XLATE_UTF8:
+        if (c < 0x80) {
+            if (len < 1) {
+                return 0;
+            }
+            out[0] = c;
+            return 1;
+        }
+        if (c < 0x800) {
+            if (len < 2) {
+                return 0;
+            }
+            out[0] = 0xC0 | (c >> 6);
+            out[1] = 0x80 | (c & 0x3F);
+            return 2;
+        }
+        if (c < 0x10000) {
+            if (len < 3) {
+                return 0;
+            }
+            out[0] = 0xE0 | (c >> 12);
+            out[1] = 0x80 | ((c >> 6) & 0x3F);
+            out[2] = 0x80 | (c & 0x3F);
+            return 3;
+        }
+        if (len < 4) {
+            return 0;
+        }
+        out[0] = 0xF0 | (c >> 18);
+        out[1] = 0x80 | ((c >> 12) & 0x3F);
+        out[2] = 0x80 | ((c >> 6) & 0x3F);
+        out[3] = 0x80 | (c & 0x3F);
+        return 4;
+
+    default:
+        *status = APR_EINVAL;
+        return 0;
+    }
+}
+
+/* The length of the ASCII run starting at in, up to len, tested by
+ * vectors then a word at a time.
+ */
+static apr_size_t ascii_run(const unsigned char *in, apr_size_t len)
+{
+    const apr_uint64_t high = APR_UINT64_C(0x8080808080808080);
+    apr_size_t n = apr__utf8_ascii(in, len);
+
+    while (len - n >= sizeof(apr_uint64_t)) {
+        apr_uint64_t w;
+
+        memcpy(&w, in + n, sizeof w);
+        if (w & high) {
+            break;
+        }
+        n += sizeof(apr_uint64_t);
+    }
+    while (n < len && in[n] < 0x80) {
+        ++n;
+    }
+    return n;
+}
+
+/* Convert between two built-in charsets, with the semantics of iconv():
+ * stop without error when the output is full, before an incomplete or
+ * invalid input character otherwise.
+ */
+static apr_status_t builtin_conv(apr_xlate_t *convset,
+                                 const char *inbuf,
+                                 apr_size_t *inbytes_left,
+                                 char *outbuf,
+                                 apr_size_t *outbytes_left)
+{
+    const unsigned char *in = (const unsigned char *)inbuf;
+    unsigned char *out = (unsigned char *)outbuf;
+    apr_size_t inlen = *inbytes_left, outlen = *outbytes_left;
+    xlate_builtin_e from = convset->from_builtin, to = convset->to_builtin;
+    int ascii = (from == XLATE_UTF8 || from == XLATE_LATIN1)
+                && (to == XLATE_UTF8 || to == XLATE_LATIN1);
+    apr_status_t status = APR_SUCCESS;
+
+    while (inlen) {
+        apr_uint32_t c;
+        apr_size_t n, m;
+
+        /* Both sides are ASCII compatible, copy the ASCII runs as is */
+        if (ascii) {
+            n = ascii_run(in, min(inlen, outlen));
+            memcpy(out, in, n);
+            in += n;
+            inlen -= n;
+            out += n;
+            outlen -= n;
+            if (!inlen) {
+                break;
+            }
+        }
+
+        n = builtin_decode(from, in, inlen, &c, &status);
+        if (!n) {
+            break;
+        }
+        m = builtin_encode(to, c, out, outlen, &status);
+        if (!m) {
+            break;
+        }
+        in += n;
+        inlen -= n;
+        out += m;
+        outlen -= m;
+    }
+
+    *inbytes_left = inlen;
+    *outbytes_left = outlen;
+    return status;
+}
+
 static void make_identity_table(apr_xlate_t *convset)
 {
   int i;
@@ -230,6 +552,18 @@ APR_DECLARE(apr_status_t) apr_xlate_open(apr_xlate_t **convset,
         make_identity_table(new);
     }
 
+    if (!found) {
+        new->from_builtin = builtin_charset(frompage);
+        new->to_builtin = builtin_charset(topage);
+        if (new->from_builtin && new->to_builtin) {
+            /* no iconv descriptor, nor its per call overhead */
+            found = 1;
+        }
+        else {
+            new->from_builtin = new->to_builtin = XLATE_NONE;
+        }
+    }
+
 #if APU_HAVE_APR_ICONV
     if (!found) {
         rv = apr_iconv_open(topage, frompage, pool, &new->ich);
@@ -283,6 +617,14 @@ APR_DECLARE(apr_status_t) apr_xlate_conv_buffer(apr_xlate_t *convset,
 {
     apr_status_t status = APR_SUCCESS;
 
+    if (convset->from_builtin) {
+        /* stateless, so nothing to terminate */
+        if (inbuf) {
+            status = builtin_conv(convset, inbuf, inbytes_left,
+                                  outbuf, outbytes_left);
+        }
+    }
+    else
 #if APU_HAVE_ICONV
     if (convset->ich != (iconv_t)-1) {
         const char *inbufptr = inbuf;
@@ -17,6 +17,7 @@
 #include "apr.h"
 #include "apr_private.h"
 #include "apr_strings.h"
+#include "apr_hash.h"
 
 #define APR_WANT_STDIO          /* for sprintf() */
 #define APR_WANT_STRFUNC
@@ -44,42 +45,101 @@ static const char APR_KW_xmlns_lang[] = { 0x78, 0x6D, 0x6C, 0x3A, 0x6C, 0x61, 0x
           (name[2] == 0x4C || name[2] == 0x6C) )
 
 
+/* the names interned by a parser, past which they are copied per element
+ * (a streamed document could otherwise grow the table without bound)
+ */
+#define APR_XML_MAX_NAMES 1024
+
 /* struct for scoping namespace declarations */
 typedef struct apr_xml_ns_scope {
     const char *prefix;         /* prefix used for this ns */
     int ns;                     /* index into namespace table */
     int emptyURI;               /* the namespace URI is the empty string */
     struct apr_xml_ns_scope *next;      /* next scoped namespace */
+    struct apr_xml_ns_scope *shadowed;  /* outer scope of the same prefix */
 } apr_xml_ns_scope;
 
 
-/* return namespace table index for a given prefix */
-static int find_prefix(apr_xml_parser *parser, const char *prefix)
+/* set up the tables of the names and namespaces seen by the parser */
+static void init_tables(apr_xml_parser *parser)
 {
-    apr_xml_elem *elem = parser->cur_elem;
+    apr_array_header_t *namespaces = parser->doc->namespaces;
+    int i;
 
-    /*
-    ** Walk up the tree, looking for a namespace scope that defines this
-    ** prefix.
-    */
-    for (; elem; elem = elem->parent) {
-        apr_xml_ns_scope *ns_scope;
-
-        for (ns_scope = elem->ns_scope; ns_scope; ns_scope = ns_scope->next) {
-            if (strcmp(prefix, ns_scope->prefix) == 0) {
-                if (ns_scope->emptyURI) {
-                    /*
-                    ** It is possible to set the default namespace to an
-                    ** empty URI string; this resets the default namespace
-                    ** to mean "no namespace." We just found the prefix
-                    ** refers to an empty URI, so return "no namespace."
-                    */
-                    return APR_XML_NS_NONE;
-                }
+    parser->names = apr_hash_make(parser->p);
+    parser->prefixes = apr_hash_make(parser->p);
+    parser->uris = apr_hash_make(parser->p);
+    for (i = 0; i < namespaces->nelts; i++) {
+        int *ns = apr_palloc(parser->p, sizeof(*ns));
 
-                return ns_scope->ns;
-            }
+        *ns = i;
+        apr_hash_set(parser->uris, APR_XML_GET_URI_ITEM(namespaces, i),
+                     APR_HASH_KEY_STRING, ns);
+    }
+}
+
+/* return the copy of a name shared by all its occurrences, made once */
+static const char *intern_name(apr_xml_parser *parser, apr_pool_t *pool,
+                               const char *name, apr_size_t len)
+{
+    const char *s;
+
+#if APR_CHARSET_EBCDIC
+    /* the names are converted in place after the parsing */
+    s = apr_pstrmemdup(pool, name, len);
+#else
+    s = apr_hash_get(parser->names, name, len);
+    if (s == NULL) {
+        if (apr_hash_count(parser->names) >= APR_XML_MAX_NAMES) {
+            return apr_pstrmemdup(pool, name, len);
         }
+        s = apr_pstrmemdup(parser->p, name, len);
+        apr_hash_set(parser->names, s, len, s);
+    }
+#endif
+    return s;
+}
+
+/* return namespace table index for a given URI, adding it if new */
+static int intern_uri(apr_xml_parser *parser, const char *uri)
+{
+    int *ns;
+
+    /* never insert an empty URI; this index is always APR_XML_NS_NONE */
+    if (*uri == '\0')
+        return APR_XML_NS_NONE;
+
+    ns = apr_hash_get(parser->uris, uri, APR_HASH_KEY_STRING);
+    if (ns == NULL) {
+        /* a new URI outlives the element */
+        uri = apr_pstrdup(parser->p, uri);
+        ns = apr_palloc(parser->p, sizeof(*ns));
+        *ns = parser->doc->namespaces->nelts;
+        APR_ARRAY_PUSH(parser->doc->namespaces, const char *) = uri;
+        apr_hash_set(parser->uris, uri, APR_HASH_KEY_STRING, ns);
+    }
+    return *ns;
+}
+
+/* return namespace table index for a given prefix */
+static int find_prefix(apr_xml_parser *parser, const char *prefix,
+                       apr_size_t len)
+{
+    /* the innermost scope declaring this prefix */
+    apr_xml_ns_scope *ns_scope = apr_hash_get(parser->prefixes, prefix, len);
+
+    if (ns_scope) {
+        if (ns_scope->emptyURI) {
+            /*
+            ** It is possible to set the default namespace to an
+            ** empty URI string; this resets the default namespace
+            ** to mean "no namespace." We just found the prefix
+            ** refers to an empty URI, so return "no namespace."
+            */
+            return APR_XML_NS_NONE;
+        }
+
+        return ns_scope->ns;
     }
 
     /*
@@ -89,7 +149,7 @@ static int find_prefix(apr_xml_parser *parser, const char *prefix)
      * into ns_scope with an empty prefix). This means the element/attribute
      * has "no namespace". We have a reserved value for this.
      */
-    if (*prefix == '\0') {
+    if (len == 0) {
         return APR_XML_NS_NONE;
     }
 
@@ -97,6 +157,17 @@ static int find_prefix(apr_xml_parser *parser, const char *prefix)
     return APR_XML_NS_ERROR_UNKNOWN_PREFIX;
 }
 
+/* put the prefixes declared by an element ending out of scope */
+static void end_scope(apr_xml_parser *parser, const apr_xml_elem *elem)
+{
+    apr_xml_ns_scope *ns_scope;
+
+    for (ns_scope = elem->ns_scope; ns_scope; ns_scope = ns_scope->next) {
+        apr_hash_set(parser->prefixes, ns_scope->prefix, APR_HASH_KEY_STRING,
+                     ns_scope->shadowed);
+    }
+}
+
 /* return original prefix given ns index */
 static const char * find_prefix_name(const apr_xml_elem *elem, int ns, int parent)
 {
@@ -116,36 +187,63 @@ static const char * find_prefix_name(const apr_xml_elem *elem, int ns, int paren
     return "";
 }
 
+/* stop the parsing on the error of a streaming callback */
+static void callback_error(apr_xml_parser *parser, apr_status_t status)
+{
+    parser->error = APR_XML_ERROR_CALLBACK;
+    parser->cb_status = status;
+}
+
 static void start_handler(void *userdata, const char *name, const char **attrs)
 {
     apr_xml_parser *parser = userdata;
+    apr_pool_t *pool = parser->p;
     apr_xml_elem *elem;
     apr_xml_attr *attr;
     apr_xml_attr *prev;
-    char *colon;
+    const char *colon;
     const char *quoted;
-    char *elem_name;
 
     /* punt once we find an error */
     if (parser->error)
         return;
 
-    elem = apr_pcalloc(parser->p, sizeof(*elem));
+    if (parser->names == NULL)
+        init_tables(parser);
+
+    if (parser->elem_pools) {
+        /* streaming: the element lives until its end in a subpool */
+        if (parser->depth == parser->elem_pools->nelts) {
+            apr_pool_t *subpool;
 
-    /* prep the element */
-    elem->name = elem_name = apr_pstrdup(parser->p, name);
+            apr_pool_create(&subpool, parser->p);
+            APR_ARRAY_PUSH(parser->elem_pools, apr_pool_t *) = subpool;
+        }
+        pool = APR_ARRAY_IDX(parser->elem_pools, parser->depth++,
+                             apr_pool_t *);
+    }
+
+    elem = apr_pcalloc(pool, sizeof(*elem));
+
+    /* prep the element; the names are interned once split below */
+    elem->name = name;
 
     /* fill in the attributes (note: ends up in reverse order) */
     while (attrs && *attrs) {
-        attr = apr_palloc(parser->p, sizeof(*attr));
-        attr->name = apr_pstrdup(parser->p, *attrs++);
-        attr->value = apr_pstrdup(parser->p, *attrs++);
+        attr = apr_palloc(pool, sizeof(*attr));
+        attr->name = *attrs++;
+        attr->value = apr_pstrdup(pool, *attrs++);
         attr->next = elem->attr;
         elem->attr = attr;
     }
 
     /* hook the element into the tree */
-    if (parser->cur_elem == NULL) {
+    if (parser->elem_pools) {
+        /* streaming: only the way up to the root is kept */
+        elem->parent = parser->cur_elem;
+        parser->cur_elem = elem;
+    }
+    else if (parser->cur_elem == NULL) {
         /* no current element; this also becomes the root */
         parser->cur_elem = parser->doc->root = elem;
     }
@@ -193,15 +291,21 @@ static void start_handler(void *userdata, const char *name, const char **attrs)
             }
 
             /* quote the URI before we ever start working with it */
-            quoted = apr_xml_quote_string(parser->p, attr->value, 1);
+            quoted = apr_xml_quote_string(pool, attr->value, 1);
 
-            /* build and insert the new scope */
-            ns_scope = apr_pcalloc(parser->p, sizeof(*ns_scope));
-            ns_scope->prefix = prefix;
-            ns_scope->ns = apr_xml_insert_uri(parser->doc->namespaces, quoted);
+            /* build and insert the new scope, shadowing any outer one */
+            ns_scope = apr_pcalloc(pool, sizeof(*ns_scope));
+            ns_scope->prefix = intern_name(parser, pool, prefix,
+                                           strlen(prefix));
+            ns_scope->ns = intern_uri(parser, quoted);
             ns_scope->emptyURI = *quoted == '\0';
             ns_scope->next = elem->ns_scope;
             elem->ns_scope = ns_scope;
+            ns_scope->shadowed = apr_hash_get(parser->prefixes,
+                                              ns_scope->prefix,
+                                              APR_HASH_KEY_STRING);
+            apr_hash_set(parser->prefixes, ns_scope->prefix,
+                         APR_HASH_KEY_STRING, ns_scope);
 
             /* remove this attribute from the element */
             if (prev == NULL)
@@ -213,7 +317,7 @@ static void start_handler(void *userdata, const char *name, const char **attrs)
         }
         else if (strcmp(attr->name, APR_KW_xmlns_lang) == 0) {
             /* save away the language (in quoted form) */
-            elem->lang = apr_xml_quote_string(parser->p, attr->value, 1);
+            elem->lang = apr_xml_quote_string(pool, attr->value, 1);
 
             /* remove this attribute from the element */
             if (prev == NULL)
@@ -239,22 +343,23 @@ static void start_handler(void *userdata, const char *name, const char **attrs)
         elem->lang = elem->parent->lang;
 
     /* adjust the element's namespace */
-    colon = strchr(elem_name, 0x3A);
+    colon = strchr(name, 0x3A);
     if (colon == NULL) {
         /*
          * The element is using the default namespace, which will always
          * be found. Either it will be "no namespace", or a default
          * namespace URI has been specified at some point.
          */
-        elem->ns = find_prefix(parser, "");
+        elem->ns = find_prefix(parser, "", 0);
+        elem->name = intern_name(parser, pool, name, strlen(name));
     }
-    else if (APR_XML_NS_IS_RESERVED(elem->name)) {
+    else if (APR_XML_NS_IS_RESERVED(name)) {
         elem->ns = APR_XML_NS_NONE;
+        elem->name = intern_name(parser, pool, name, strlen(name));
     }
     else {
-        *colon = '\0';
-        elem->ns = find_prefix(parser, elem->name);
-        elem->name = colon + 1;
+        elem->ns = find_prefix(parser, name, colon - name);
+        elem->name = intern_name(parser, pool, colon + 1, strlen(colon + 1));
 
         if (APR_XML_NS_IS_ERROR(elem->ns)) {
             parser->error = elem->ns;
@@ -264,12 +369,7 @@ static void start_handler(void *userdata, const char *name, const char **attrs)
 
     /* adjust all remaining attributes' namespaces */
     for (attr = elem->attr; attr; attr = attr->next) {
-        /*
-         * apr_xml_attr defines this as "const" but we dup'd it, so we
-         * know that we can change it. a bit hacky, but the existing
-         * structure def is best.
-         */
-        char *attr_name = (char *)attr->name;
+        const char *attr_name = attr->name;
 
         colon = strchr(attr_name, 0x3A);
         if (colon == NULL) {
@@ -279,18 +379,25 @@ static void start_handler(void *userdata, const char *name, const char **attrs)
              */
             attr->ns = APR_XML_NS_NONE;
         }
-        else if (APR_XML_NS_IS_RESERVED(attr->name)) {
+        else if (APR_XML_NS_IS_RESERVED(attr_name)) {
             attr->ns = APR_XML_NS_NONE;
         }
         else {
-            *colon = '\0';
-            attr->ns = find_prefix(parser, attr->name);
-            attr->name = colon + 1;
+            attr->ns = find_prefix(parser, attr_name, colon - attr_name);
+            attr_name = colon + 1;
+        }
+        attr->name = intern_name(parser, pool, attr_name, strlen(attr_name));
 
-            if (APR_XML_NS_IS_ERROR(attr->ns)) {
-                parser->error = attr->ns;
-                return;
-            }
+        if (APR_XML_NS_IS_ERROR(attr->ns)) {
+            parser->error = attr->ns;
+            return;
+        }
+    }
+
+    if (parser->start_fn) {
+        apr_status_t status = parser->start_fn(parser->baton, elem);
+        if (status != APR_SUCCESS) {
+            callback_error(parser, status);
         }
     }
 }
@@ -303,7 +410,25 @@ static void end_handler(void *userdata, const char *name)
     if (parser->error)
         return;
 
+    if (parser->elem_pools) {
+        apr_xml_elem *elem = parser->cur_elem;
+
+        if (parser->end_fn) {
+            apr_status_t status = parser->end_fn(parser->baton, elem);
+            if (status != APR_SUCCESS) {
+                callback_error(parser, status);
+                return;
+            }
+        }
+        end_scope(parser, elem);
+        parser->cur_elem = elem->parent;
+        apr_pool_clear(APR_ARRAY_IDX(parser->elem_pools, --parser->depth,
+                                     apr_pool_t *));
+        return;
+    }
+
     /* pop up one level */
+    end_scope(parser, parser->cur_elem);
     parser->cur_elem = parser->cur_elem->parent;
 }
 
@@ -319,6 +444,17 @@ static void cdata_handler(void *userdata, const char *data, int len)
         return;
 
     elem = parser->cur_elem;
+    if (parser->elem_pools) {
+        if (parser->cdata_fn && elem) {
+            apr_status_t status = parser->cdata_fn(parser->baton, elem, data,
+                                                   len);
+            if (status != APR_SUCCESS) {
+                callback_error(parser, status);
+            }
+        }
+        return;
+    }
+
     s = apr_pstrndup(parser->p, data, len);
 
     if (elem->last_child == NULL) {
@@ -338,11 +474,40 @@ APR_DECLARE(apr_xml_parser *) apr_xml_parser_create(apr_pool_t *pool)
     return apr_xml_parser_create_internal(pool, &start_handler, &end_handler, &cdata_handler);
 }
 
+APR_DECLARE(apr_xml_parser *) apr_xml_parser_create_stream(apr_pool_t *pool,
+                                                   apr_xml_start_fn *start_fn,
+                                                   apr_xml_cdata_fn *cdata_fn,
+                                                   apr_xml_end_fn *end_fn,
+                                                   void *baton)
+{
+    apr_xml_parser *parser = apr_xml_parser_create(pool);
+
+    if (parser) {
+        parser->start_fn = start_fn;
+        parser->cdata_fn = cdata_fn;
+        parser->end_fn = end_fn;
+        parser->baton = baton;
+        parser->elem_pools = apr_array_make(pool, 8, sizeof(apr_pool_t *));
+    }
+    return parser;
+}
+
+APR_DECLARE(apr_array_header_t *) apr_xml_parser_namespaces(
+                                                   apr_xml_parser *parser)
+{
+    return parser->doc->namespaces;
+}
+
 APR_DECLARE(apr_status_t) apr_xml_parser_feed(apr_xml_parser *parser,
                                               const char *data,
                                               apr_size_t len)
 {
-    return parser->impl->Parse(parser, data, len, 0 /* is_final */);
+    apr_status_t status = parser->impl->Parse(parser, data, len,
+                                              0 /* is_final */);
+
+    if (parser->error == APR_XML_ERROR_CALLBACK)
+        return parser->cb_status;
+    return status;
 }
 
 APR_DECLARE(apr_status_t) apr_xml_parser_done(apr_xml_parser *parser,
@@ -350,6 +515,9 @@ APR_DECLARE(apr_status_t) apr_xml_parser_done(apr_xml_parser *parser,
 {
     apr_status_t status = parser->impl->Parse(parser, "", 0, 1 /* is_final */);
 
+    if (parser->error == APR_XML_ERROR_CALLBACK)
+        status = parser->cb_status;
+
     /* get rid of the parser */
     (void) apr_pool_cleanup_run(parser->p, parser, parser->impl->cleanup);
 
@@ -394,6 +562,10 @@ APR_DECLARE(char *) apr_xml_parser_geterror(apr_xml_parser *parser,
         msg = "The parser is not active.";
         break;
 
+    case APR_XML_ERROR_CALLBACK:
+        msg = "A callback stopped the parsing.";
+        break;
+
     default:
         msg = "There was an unknown error within the XML body.";
         break;
@@ -844,13 +1016,235 @@ APR_DECLARE(void) apr_xml_to_text(apr_pool_t * p, const apr_xml_elem *elem,
     /* get the exact size, plus a null terminator */
     apr_size_t size = elem_size(elem, style, namespaces, ns_map) + 1;
     char *s = apr_palloc(p, size);
+    char *end = write_elem(s, elem, style, namespaces, ns_map);
 
-    (void) write_elem(s, elem, style, namespaces, ns_map);
-    s[size - 1] = '\0';
+    /* the size is an upper bound, with namespaces in the end tag too */
+    *end = '\0';
 
     *pbuf = s;
     if (psize)
-        *psize = size;
+        *psize = end - s + 1;
+}
+
+/* where and how apr_xml_to_brigade() writes */
+typedef struct {
+    apr_bucket_brigade *bb;
+    apr_brigade_flush flush;
+    void *ctx;
+    int quote;
+} xml_writer_t;
+
+#define XML_WRITE(w, s, len) \
+    apr_brigade_write((w)->bb, (w)->flush, (w)->ctx, (s), (len))
+
+/* write text, quoted as apr_xml_quote_string() does if asked for */
+static apr_status_t xml_write_quoted(xml_writer_t *w, const char *s,
+                                     int quotes)
+{
+    apr_status_t rv;
+
+    if (!w->quote) {
+        return apr_brigade_puts(w->bb, w->flush, w->ctx, s);
+    }
+    for (;;) {
+        apr_size_t len = strcspn(s, quotes ? "<>&\"" : "<>&");
+
+        if (len) {
+            rv = XML_WRITE(w, s, len);
+            if (rv != APR_SUCCESS)
+                return rv;
+            s += len;
+        }
+        switch (*s++) {
+        case '<':
+            rv = XML_WRITE(w, "&lt;", 4);
+            break;
+        case '>':
+            rv = XML_WRITE(w, "&gt;", 4);
+            break;
+        case '&':
+            rv = XML_WRITE(w, "&amp;", 5);
+            break;
+        case '"':
+            rv = XML_WRITE(w, "&quot;", 6);
+            break;
+        default:
+            return APR_SUCCESS;
+        }
+        if (rv != APR_SUCCESS)
+            return rv;
+    }
+}
+
+static apr_status_t xml_write_text(xml_writer_t *w, const apr_text *t)
+{
+    apr_status_t rv;
+
+    for (; t; t = t->next) {
+        rv = xml_write_quoted(w, t->text, 0);
+        if (rv != APR_SUCCESS)
+            return rv;
+    }
+    return APR_SUCCESS;
+}
+
+/* write "<name" or "</name" with the prefix for the style */
+static apr_status_t xml_write_tag(xml_writer_t *w, const apr_xml_elem *elem,
+                                  int style, int *ns_map, const char *open)
+{
+    if (elem->ns == APR_XML_NS_NONE) {
+        return apr_brigade_putstrs(w->bb, w->flush, w->ctx, open, elem->name,
+                                   NULL);
+    }
+    if (style == APR_XML_X2T_PARSED) {
+        return apr_brigade_putstrs(w->bb, w->flush, w->ctx, open,
+                                   find_prefix_name(elem, elem->ns, 1), ":",
+                                   elem->name, NULL);
+    }
+    return apr_brigade_printf(w->bb, w->flush, w->ctx, "%sns%d:%s", open,
+                              ns_map ? ns_map[elem->ns] : elem->ns,
+                              elem->name);
+}
+
+/* the brigade counterpart of write_elem() */
+static apr_status_t xml_write_elem(xml_writer_t *w, const apr_xml_elem *elem,
+                                   int style, apr_array_header_t *namespaces,
+                                   int *ns_map)
+{
+    const apr_xml_elem *child;
+    apr_status_t rv;
+
+    if (style == APR_XML_X2T_FULL || style == APR_XML_X2T_FULL_NS_LANG ||
+        style == APR_XML_X2T_PARSED) {
+        const apr_xml_attr *attr;
+
+        rv = xml_write_tag(w, elem, style, ns_map, "<");
+        if (rv != APR_SUCCESS)
+            return rv;
+
+        for (attr = elem->attr; attr; attr = attr->next) {
+            if (attr->ns == APR_XML_NS_NONE) {
+                rv = apr_brigade_putstrs(w->bb, w->flush, w->ctx,
+                                         " ", attr->name, "=\"", NULL);
+            }
+            else if (style == APR_XML_X2T_PARSED) {
+                rv = apr_brigade_putstrs(w->bb, w->flush, w->ctx, " ",
+                                         find_prefix_name(elem, attr->ns, 1),
+                                         ":", attr->name, "=\"", NULL);
+            }
+            else {
+                rv = apr_brigade_printf(w->bb, w->flush, w->ctx,
+                                        " ns%d:%s=\"",
+                                        ns_map ? ns_map[attr->ns] : attr->ns,
+                                        attr->name);
+            }
+            if (rv == APR_SUCCESS)
+                rv = xml_write_quoted(w, attr->value, 1);
+            if (rv == APR_SUCCESS)
+                rv = XML_WRITE(w, "\"", 1);
+            if (rv != APR_SUCCESS)
+                return rv;
+        }
+
+        /* add the xml:lang value if necessary */
+        if (elem->lang != NULL &&
+            (style == APR_XML_X2T_FULL_NS_LANG ||
+             elem->parent == NULL ||
+             elem->lang != elem->parent->lang)) {
+            rv = apr_brigade_putstrs(w->bb, w->flush, w->ctx,
+                                     " xml:lang=\"", elem->lang, "\"", NULL);
+            if (rv != APR_SUCCESS)
+                return rv;
+        }
+
+        /* add namespace definitions, if required */
+        if (style == APR_XML_X2T_FULL_NS_LANG) {
+            int i;
+
+            for (i = namespaces->nelts; i--;) {
+                rv = apr_brigade_printf(w->bb, w->flush, w->ctx,
+                                        " xmlns:ns%d=\"%s\"", i,
+                                        APR_XML_GET_URI_ITEM(namespaces, i));
+                if (rv != APR_SUCCESS)
+                    return rv;
+            }
+        }
+        else if (style == APR_XML_X2T_PARSED) {
+            apr_xml_ns_scope *ns_scope = elem->ns_scope;
+
+            for (; ns_scope; ns_scope = ns_scope->next) {
+                const char *prefix = find_prefix_name(elem, ns_scope->ns, 0);
+
+                rv = apr_brigade_putstrs(w->bb, w->flush, w->ctx, " xmlns",
+                                         *prefix ? ":" : "", prefix, "=\"",
+                                         APR_XML_GET_URI_ITEM(namespaces,
+                                                              ns_scope->ns),
+                                         "\"", NULL);
+                if (rv != APR_SUCCESS)
+                    return rv;
+            }
+        }
+
+        /* no more to do. close it up and go. */
+        if (APR_XML_ELEM_IS_EMPTY(elem)) {
+            return XML_WRITE(w, "/>", 2);
+        }
+
+        /* just close it */
+        rv = XML_WRITE(w, ">", 1);
+        if (rv != APR_SUCCESS)
+            return rv;
+    }
+    else if (style == APR_XML_X2T_LANG_INNER) {
+        /* prepend the xml:lang value */
+        rv = XML_WRITE(w, elem->lang ? elem->lang : "",
+                       elem->lang ? strlen(elem->lang) + 1 : 1);
+        if (rv != APR_SUCCESS)
+            return rv;
+    }
+
+    rv = xml_write_text(w, elem->first_cdata.first);
+    if (rv != APR_SUCCESS)
+        return rv;
+
+    for (child = elem->first_child; child; child = child->next) {
+        rv = xml_write_elem(w, child,
+                            style == APR_XML_X2T_PARSED ? APR_XML_X2T_PARSED
+                                                        : APR_XML_X2T_FULL,
+                            NULL, ns_map);
+        if (rv == APR_SUCCESS)
+            rv = xml_write_text(w, child->following_cdata.first);
+        if (rv != APR_SUCCESS)
+            return rv;
+    }
+
+    if (style == APR_XML_X2T_FULL || style == APR_XML_X2T_FULL_NS_LANG ||
+        style == APR_XML_X2T_PARSED) {
+        rv = xml_write_tag(w, elem, style, ns_map, "</");
+        if (rv == APR_SUCCESS)
+            rv = XML_WRITE(w, ">", 1);
+        return rv;
+    }
+
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_xml_to_brigade(apr_bucket_brigade *bb,
+                                             apr_brigade_flush flush,
+                                             void *ctx,
+                                             const apr_xml_elem *elem,
+                                             int style,
+                                             apr_array_header_t *namespaces,
+                                             int *ns_map, int quote)
+{
+    xml_writer_t w;
+
+    w.bb = bb;
+    w.flush = flush;
+    w.ctx = ctx;
+    w.quote = quote;
+
+    return xml_write_elem(&w, elem, style, namespaces, ns_map);
 }
 
 APR_DECLARE(const char *) apr_xml_empty_elem(apr_pool_t * p,
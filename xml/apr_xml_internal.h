@@ -17,6 +17,8 @@
 #ifndef APR_XML_INTERNAL_H
 #define APR_XML_INTERNAL_H
 
+#include "apr_hash.h"
+
 
 struct XMLParserImpl {
     /** parse callback */
@@ -40,6 +42,7 @@ struct apr_xml_parser {
     int error;
 #define APR_XML_ERROR_EXPAT             1
 #define APR_XML_ERROR_PARSE_DONE        2
+#define APR_XML_ERROR_CALLBACK          3
 /* also: public APR_XML_NS_ERROR_* values (if any) */
 
     /** the actual (Expat) XML parser */
@@ -50,6 +53,24 @@ struct apr_xml_parser {
     const char *xp_msg;
     /** XML parser implementation */
     XMLParserImpl *impl;
+
+    /** streaming callbacks, the document being built when all are NULL */
+    apr_xml_start_fn *start_fn;
+    apr_xml_cdata_fn *cdata_fn;
+    apr_xml_end_fn *end_fn;
+    void *baton;
+    /** status of the callback which stopped the parsing */
+    apr_status_t cb_status;
+    /** streaming: the subpools of the open elements, then spare ones */
+    apr_array_header_t *elem_pools;
+    /** streaming: the number of open elements */
+    int depth;
+    /** the element and attribute names, interned */
+    apr_hash_t *names;
+    /** the innermost namespace scope of each prefix in scope */
+    apr_hash_t *prefixes;
+    /** the index of each namespace URI in doc->namespaces */
+    apr_hash_t *uris;
 };
 
 apr_xml_parser* apr_xml_parser_create_internal(apr_pool_t*, void*, void*, void*);